@@ -0,0 +1,526 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/binary_log.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/spsc_ring.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/time_delta.h"
+
+// A binary log file is |kMagic|, then records, all starting with the same
+// header (as |internal::BinaryLogSite::Log()| writes them): the site's id, and
+// the record's size (with the header). A record with id 0 defines a site,
+// ahead of its first message: its id, severity, line and argument count (all
+// 32 bits), the argument types (a byte each), and the file and the format
+// (each as a 32-bit size and the characters). Other records hold a message's
+// arguments: 64 bits each, except strings (a 32-bit size and the characters)
+// and |Hex|es (the value and the width, 64 bits each). Everything is in the
+// writer's byte order.
+
+namespace ftl {
+namespace {
+
+constexpr char kMagic[8] = {'F', 'T', 'L', 'B', 'L', 'O', 'G', '1'};
+constexpr size_t kHeaderSize = 2u * sizeof(uint32_t);
+constexpr size_t kBufferSize = 256u * 1024u;
+
+using internal::BinaryLogArgType;
+using internal::BinaryLogSite;
+
+// What's needed to format a site's messages.
+struct SiteInfo {
+  LogSeverity severity;
+  StringView file;
+  int line;
+  StringView format;
+  const BinaryLogArgType* arg_types;
+  size_t arg_count;
+};
+
+// Reads |T|s (or strings) from a record, failing if it's too short.
+class Reader final {
+ public:
+  Reader(const char* data, size_t size) : data_(data), end_(data + size) {}
+
+  bool at_end() const { return data_ == end_; }
+
+  template <typename T>
+  bool Read(T* value) {
+    if (static_cast<size_t>(end_ - data_) < sizeof(T))
+      return false;
+    memcpy(value, data_, sizeof(T));
+    data_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadString(StringView* string) {
+    uint32_t size;
+    if (!Read(&size) || static_cast<size_t>(end_ - data_) < size)
+      return false;
+    *string = StringView(data_, size);
+    data_ += size;
+    return true;
+  }
+
+  bool ReadBytes(size_t size, const char** bytes) {
+    if (static_cast<size_t>(end_ - data_) < size)
+      return false;
+    *bytes = data_;
+    data_ += size;
+    return true;
+  }
+
+ private:
+  const char* data_;
+  const char* const end_;
+};
+
+const char* StripDots(const char* path) {
+  while (strncmp(path, "../", 3) == 0)
+    path += 3;
+  return path;
+}
+
+const char* StripPath(const char* path) {
+  const char* slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+// Formats a message, with arguments |args|, as a line like |FTL_LOG()|'s.
+// Returns false if the arguments are malformed.
+bool FormatMessage(const SiteInfo& site, Reader args, std::string* output) {
+  std::vector<internal::FormatArgument> arguments;
+  arguments.reserve(site.arg_count);
+  for (size_t i = 0u; i < site.arg_count; i++) {
+    uint64_t value = 0u;
+    if (site.arg_types[i] == BinaryLogArgType::kString) {
+      StringView string;
+      if (!args.ReadString(&string))
+        return false;
+      arguments.emplace_back(string);
+      continue;
+    }
+    if (!args.Read(&value))
+      return false;
+    switch (site.arg_types[i]) {
+      case BinaryLogArgType::kInt64:
+        arguments.emplace_back(static_cast<int64_t>(value));
+        break;
+      case BinaryLogArgType::kUint64:
+        arguments.emplace_back(value);
+        break;
+      case BinaryLogArgType::kDouble: {
+        double number;
+        memcpy(&number, &value, sizeof(number));
+        arguments.emplace_back(number);
+        break;
+      }
+      case BinaryLogArgType::kBool:
+        arguments.emplace_back(value != 0u);
+        break;
+      case BinaryLogArgType::kChar:
+        arguments.emplace_back(static_cast<char>(value));
+        break;
+      case BinaryLogArgType::kPointer:
+        arguments.emplace_back(
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(value)));
+        break;
+      case BinaryLogArgType::kHex: {
+        uint64_t width;
+        if (!args.Read(&width) || width > 16u)
+          return false;
+        arguments.emplace_back(Hex(value, static_cast<size_t>(width)));
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  if (!args.at_end())
+    return false;
+
+  // The prefix is as |LogMessage|'s.
+  static const char* const kSeverityNames[LOG_NUM_SEVERITIES] = {
+      "INFO", "WARNING", "ERROR", "FATAL"};
+  const std::string file = site.file.ToString();
+  output->push_back('[');
+  if (site.severity < LOG_INFO)
+    FormatAppend(output, "VERBOSE{}", -site.severity);
+  else if (site.severity < LOG_NUM_SEVERITIES)
+    output->append(kSeverityNames[site.severity]);
+  else
+    output->append("UNKNOWN");
+  FormatAppend(output, ":{}({})] ",
+               site.severity > LOG_INFO ? StripDots(file.c_str())
+                                        : StripPath(file.c_str()),
+               site.line);
+  internal::FormatAppend(output, site.format, arguments.data(),
+                         arguments.size());
+  output->push_back('\n');
+  return true;
+}
+
+bool IsValidArgType(uint8_t type) {
+  return type <= static_cast<uint8_t>(BinaryLogArgType::kHex);
+}
+
+// Each thread which logs has a record with a ring of bytes, which it alone
+// pushes (whole log records) to. These are never freed, but are reused by new
+// threads (as for |Epoch|).
+struct ThreadBuffer {
+  SpscRing<char, kBufferSize> ring;
+  std::atomic<bool> in_use;
+  // Immutable once the buffer is published.
+  ThreadBuffer* next;
+  // Popped bytes which don't make up a complete log record yet. Guarded by
+  // the output mutex.
+  std::string partial;
+};
+
+std::atomic<ThreadBuffer*> g_buffers(nullptr);
+thread_local ThreadBuffer* g_current_buffer = nullptr;
+std::atomic<uint64_t> g_dropped_count(0u);
+
+void OnForkInChild();
+
+// Never destroyed, since the writer thread runs until the process exits.
+struct State {
+  State()
+      : fork_handlers(
+            [this]() FTL_NO_THREAD_SAFETY_ANALYSIS {
+              output_mutex.Lock();
+              sites_mutex.Lock();
+            },
+            [this]() FTL_NO_THREAD_SAFETY_ANALYSIS {
+              sites_mutex.Unlock();
+              output_mutex.Unlock();
+            },
+            &OnForkInChild) {}
+
+  // Guards |sites|, which are indexed by their ids minus one, and
+  // |writer_started|.
+  Mutex sites_mutex;
+  std::vector<const BinaryLogSite*> sites;
+  // (Cleared in the child of a fork(), which has to start its own.)
+  bool writer_started = false;
+
+  // Guards draining the buffers, and the output.
+  Mutex output_mutex;
+  // The file set by |SetBinaryLogFile()|, if any, and which sites it has
+  // definitions for.
+  UniqueFD file;
+  std::vector<bool> defined_sites;
+
+  // Both locks are held across fork()s.
+  ForkHandlers fork_handlers;
+};
+
+State* GetState() {
+  static State* state = new State();
+  return state;
+}
+
+void AppendSiteDefinition(const BinaryLogSite& site,
+                          uint32_t id,
+                          std::string* output) {
+  const size_t file_size = strlen(site.file());
+  const size_t format_size = strlen(site.format());
+  const uint32_t fields[] = {static_cast<uint32_t>(site.severity()),
+                             static_cast<uint32_t>(site.line()),
+                             static_cast<uint32_t>(site.arg_count())};
+  const uint32_t header[] = {
+      0u, static_cast<uint32_t>(kHeaderSize + sizeof(id) + sizeof(fields) +
+                                site.arg_count() + 2u * sizeof(uint32_t) +
+                                file_size + format_size)};
+  output->append(reinterpret_cast<const char*>(header), sizeof(header));
+  output->append(reinterpret_cast<const char*>(&id), sizeof(id));
+  output->append(reinterpret_cast<const char*>(fields), sizeof(fields));
+  output->append(reinterpret_cast<const char*>(site.arg_types()),
+                 site.arg_count());
+  for (StringView string : {StringView(site.file(), file_size),
+                            StringView(site.format(), format_size)}) {
+    const uint32_t size = static_cast<uint32_t>(string.size());
+    output->append(reinterpret_cast<const char*>(&size), sizeof(size));
+    output->append(string.data(), string.size());
+  }
+}
+
+// Pops everything buffered, and writes out the complete records. Returns
+// whether there were any. The caller must hold the output mutex.
+bool DrainBuffers() {
+  State* state = GetState();
+  std::string output;
+  char chunk[4096];
+  for (ThreadBuffer* buffer = g_buffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    while (size_t size = buffer->ring.PopBatch(chunk, sizeof(chunk)))
+      buffer->partial.append(chunk, size);
+    const std::string& partial = buffer->partial;
+    size_t position = 0u;
+    while (partial.size() - position >= kHeaderSize) {
+      uint32_t header[2];
+      memcpy(header, partial.data() + position, sizeof(header));
+      if (partial.size() - position < header[1])
+        break;
+      // Sites are registered before their first message is pushed.
+      const BinaryLogSite* site;
+      {
+        MutexLocker locker(&state->sites_mutex);
+        site = state->sites[header[0] - 1u];
+      }
+      if (state->file.is_valid()) {
+        if (state->defined_sites.size() < header[0])
+          state->defined_sites.resize(header[0]);
+        if (!state->defined_sites[header[0] - 1u]) {
+          AppendSiteDefinition(*site, header[0], &output);
+          state->defined_sites[header[0] - 1u] = true;
+        }
+        output.append(partial, position, header[1]);
+      } else {
+        const SiteInfo info = {site->severity(),   StringView(site->file()),
+                               site->line(),       StringView(site->format()),
+                               site->arg_types(), site->arg_count()};
+        FormatMessage(info,
+                      Reader(partial.data() + position + kHeaderSize,
+                             header[1] - kHeaderSize),
+                      &output);
+      }
+      position += header[1];
+    }
+    buffer->partial.erase(0u, position);
+  }
+  if (output.empty())
+    return false;
+  if (state->file.is_valid()) {
+    WriteFileDescriptor(state->file.get(), output.data(), output.size());
+  } else {
+    internal::WriteLogOutput(output.data(), output.size());
+  }
+  return true;
+}
+
+void RunWriter() {
+  // Poll, backing off while there's nothing to write, so that logging never
+  // has to wake this.
+  constexpr int64_t kMaxIntervalMicros = 50000;
+  int64_t interval_micros = 1000;
+  for (;;) {
+    bool drained;
+    {
+      MutexLocker locker(&GetState()->output_mutex);
+      drained = DrainBuffers();
+    }
+    interval_micros =
+        drained ? 1000 : std::min(2 * interval_micros, kMaxIntervalMicros);
+    SleepFor(TimeDelta::FromMicroseconds(interval_micros));
+  }
+}
+
+void StartWriter() {
+  State* state = GetState();
+  MutexLocker locker(&state->sites_mutex);
+  if (state->writer_started)
+    return;
+  Thread* thread = new Thread(&RunWriter);
+  Thread::Options options;
+  options.name = "binary-log";
+  FTL_CHECK(thread->Run(options));
+  static const bool registered = atexit(&FlushBinaryLog) == 0;
+  (void)registered;
+  state->writer_started = true;
+}
+
+// In the child of a fork(), which has only the fork()ing thread: the records
+// buffered so far are the parent's to write, and the writer thread has to be
+// restarted (by the thread's next message, which takes a buffer, since its
+// old one is released).
+void OnForkInChild() FTL_NO_THREAD_SAFETY_ANALYSIS {
+  State* state = GetState();
+  char chunk[4096];
+  for (ThreadBuffer* buffer = g_buffers.load(std::memory_order_acquire);
+       buffer; buffer = buffer->next) {
+    while (buffer->ring.PopBatch(chunk, sizeof(chunk))) {
+    }
+    buffer->partial.clear();
+    buffer->in_use.store(false, std::memory_order_relaxed);
+  }
+  g_current_buffer = nullptr;
+  state->writer_started = false;
+  state->sites_mutex.UnlockAfterFork();
+  state->output_mutex.UnlockAfterFork();
+}
+
+// Releases the current thread's buffer when it exits. (Whatever it still holds
+// is written out as usual.)
+class ThreadBufferReleaser final {
+ public:
+  ThreadBufferReleaser() {}
+
+  ~ThreadBufferReleaser() {
+    // (It may have none, after a fork().)
+    if (g_current_buffer)
+      g_current_buffer->in_use.store(false, std::memory_order_release);
+    g_current_buffer = nullptr;
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadBufferReleaser);
+};
+
+ThreadBuffer* AcquireThreadBuffer() {
+  // (In case the process has forked since the writer started.)
+  StartWriter();
+  ThreadBuffer* buffer = g_buffers.load(std::memory_order_acquire);
+  for (; buffer; buffer = buffer->next) {
+    bool in_use = false;
+    if (!buffer->in_use.load(std::memory_order_relaxed) &&
+        buffer->in_use.compare_exchange_strong(in_use, true,
+                                               std::memory_order_acquire)) {
+      break;
+    }
+  }
+  if (!buffer) {
+    buffer = new ThreadBuffer();
+    buffer->in_use.store(true, std::memory_order_relaxed);
+    buffer->next = g_buffers.load(std::memory_order_relaxed);
+    while (!g_buffers.compare_exchange_weak(buffer->next, buffer,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+    }
+  }
+  static thread_local ThreadBufferReleaser releaser;
+  g_current_buffer = buffer;
+  return buffer;
+}
+
+}  // namespace
+
+bool SetBinaryLogFile(const std::string& path) {
+  UniqueFD fd;
+  if (!path.empty()) {
+    fd.reset(HANDLE_EINTR(
+        open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)));
+    if (!fd.is_valid() ||
+        !WriteFileDescriptor(fd.get(), kMagic, sizeof(kMagic))) {
+      return false;
+    }
+  }
+  State* state = GetState();
+  MutexLocker locker(&state->output_mutex);
+  // What was logged before goes to the previous output.
+  DrainBuffers();
+  state->file = std::move(fd);
+  state->defined_sites.clear();
+  return true;
+}
+
+void FlushBinaryLog() {
+  MutexLocker locker(&GetState()->output_mutex);
+  DrainBuffers();
+}
+
+uint64_t GetDroppedBinaryLogCount() {
+  return g_dropped_count.load(std::memory_order_relaxed);
+}
+
+bool DecodeBinaryLog(StringView data, std::string* output) {
+  if (data.size() < sizeof(kMagic) ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  // Indexed by the sites' ids minus one.
+  std::vector<SiteInfo> sites;
+  Reader reader(data.data() + sizeof(kMagic), data.size() - sizeof(kMagic));
+  while (!reader.at_end()) {
+    uint32_t header[2];
+    const char* body;
+    if (!reader.Read(&header) || header[1] < kHeaderSize ||
+        !reader.ReadBytes(header[1] - kHeaderSize, &body)) {
+      return true;
+    }
+    Reader record(body, header[1] - kHeaderSize);
+    if (header[0]) {
+      if (header[0] > sites.size() || !sites[header[0] - 1u].arg_types ||
+          !FormatMessage(sites[header[0] - 1u], record, output)) {
+        return false;
+      }
+      continue;
+    }
+
+    uint32_t id;
+    uint32_t fields[3];
+    const char* arg_types;
+    SiteInfo site;
+    if (!record.Read(&id) || !id || !record.Read(&fields) ||
+        !record.ReadBytes(fields[2], &arg_types) ||
+        !record.ReadString(&site.file) || !record.ReadString(&site.format) ||
+        !record.at_end()) {
+      return false;
+    }
+    for (uint32_t i = 0u; i < fields[2]; i++) {
+      if (!IsValidArgType(static_cast<uint8_t>(arg_types[i])))
+        return false;
+    }
+    site.severity = static_cast<LogSeverity>(static_cast<int32_t>(fields[0]));
+    site.line = static_cast<int>(static_cast<int32_t>(fields[1]));
+    site.arg_types = reinterpret_cast<const BinaryLogArgType*>(arg_types);
+    site.arg_count = fields[2];
+    // (Ids count up from 1.)
+    if (id > (1u << 24))
+      return false;
+    if (sites.size() < id)
+      sites.resize(id, SiteInfo{0, StringView(), 0, StringView(), nullptr, 0u});
+    sites[id - 1u] = site;
+  }
+  return true;
+}
+
+namespace internal {
+
+uint32_t BinaryLogSite::Register(const char* format,
+                                 const BinaryLogArgType* arg_types,
+                                 size_t arg_count) {
+  StartWriter();
+  State* state = GetState();
+  MutexLocker locker(&state->sites_mutex);
+  uint32_t id = id_.load(std::memory_order_relaxed);
+  if (id)
+    return id;
+  format_ = format;
+  arg_types_ = arg_types;
+  arg_count_ = arg_count;
+  state->sites.push_back(this);
+  id = static_cast<uint32_t>(state->sites.size());
+  id_.store(id, std::memory_order_release);
+  return id;
+}
+
+// static
+void BinaryLogSite::Commit(char* record, size_t size) {
+  ThreadBuffer* buffer = g_current_buffer;
+  if (!buffer)
+    buffer = AcquireThreadBuffer();
+  if (!buffer->ring.TryPushAll(record, size))
+    g_dropped_count.fetch_add(1u, std::memory_order_relaxed);
+}
+
+}  // namespace internal
+}  // namespace ftl
@@ -0,0 +1,326 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Deferred-format ("binary") logging, for tracing at millions of messages per
+// second, e.g.:
+//
+//   FTL_BINARY_VLOG(2, "request {} took {} us on {}", id, micros, host);
+//
+// The calling thread only copies the call site's id and the arguments' raw
+// bytes into a (256 KiB) buffer of its own, without locking. A background
+// thread formats them (with the "{}" syntax of |Format()|), and writes them
+// where other log messages go; or, after |SetBinaryLogFile()|, writes the
+// raw records to a file, which |DecodeBinaryLog()| (or the decode_binary_log
+// tool) formats offline.
+//
+// Arguments may be integers, |bool|s, |char|s, floating-point numbers, strings
+// (which are copied, up to the record's limit of 4 KiB), pointers and |Hex|es.
+// Messages from one thread stay in order, but messages from different threads
+// may be written out of order. A message which doesn't fit in its thread's
+// buffer is dropped (see |GetDroppedBinaryLogCount()|), rather than waited for.
+
+#ifndef LIB_FTL_BINARY_LOG_H_
+#define LIB_FTL_BINARY_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/log_level.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/format.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// Sends binary log records to the file at |path| (which is truncated) from now
+// on, instead of formatting them, or (if |path| is empty) goes back to
+// formatting them. Returns false if the file can't be opened.
+FTL_EXPORT bool SetBinaryLogFile(const std::string& path);
+
+// Writes out the binary log records buffered so far. This also runs at exit.
+FTL_EXPORT void FlushBinaryLog();
+
+// The number of messages dropped because a binary log buffer was full.
+FTL_EXPORT uint64_t GetDroppedBinaryLogCount();
+
+// Formats the contents of a binary log file into |*output|, one message per
+// line, as they'd have been logged without |SetBinaryLogFile()|. Returns
+// false (after formatting what it could) if |data| isn't a well-formed binary
+// log; a truncated last record is ignored.
+FTL_EXPORT bool DecodeBinaryLog(StringView data, std::string* output);
+
+namespace internal {
+
+enum class BinaryLogArgType : uint8_t {
+  kInt64,
+  kUint64,
+  kDouble,
+  kBool,
+  kChar,
+  kPointer,
+  kString,
+  kHex,
+};
+
+// The largest record, with its header.
+constexpr size_t kMaxBinaryLogRecordSize = 4096u;
+
+// Writes a record's arguments, truncating strings which don't fit.
+class BinaryLogEncoder final {
+ public:
+  BinaryLogEncoder(char* data, char* end) : data_(data), end_(end) {}
+
+  char* data() const { return data_; }
+
+  // Sets the room to leave for the fixed-size parts of the arguments after
+  // the current one.
+  void set_reserved(size_t reserved) { reserved_ = reserved; }
+
+  // (There's always room for the fixed-size parts.)
+  void Put(uint64_t value) {
+    memcpy(data_, &value, sizeof(value));
+    data_ += sizeof(value);
+  }
+
+  void PutString(const char* string, size_t size) {
+    const size_t room =
+        static_cast<size_t>(end_ - data_) - sizeof(uint32_t) - reserved_;
+    const uint32_t length = static_cast<uint32_t>(size < room ? size : room);
+    memcpy(data_, &length, sizeof(length));
+    memcpy(data_ + sizeof(length), string, length);
+    data_ += sizeof(length) + length;
+  }
+
+ private:
+  char* data_;
+  char* const end_;
+  size_t reserved_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BinaryLogEncoder);
+};
+
+template <typename T, typename Enable = void>
+struct BinaryLogArg;
+
+template <typename T>
+struct BinaryLogArg<
+    T,
+    typename std::enable_if<std::is_integral<T>::value &&
+                            std::is_signed<T>::value>::type> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kInt64;
+  static void Encode(BinaryLogEncoder* encoder, T value) {
+    encoder->Put(static_cast<uint64_t>(static_cast<int64_t>(value)));
+  }
+};
+
+template <typename T>
+struct BinaryLogArg<
+    T,
+    typename std::enable_if<std::is_integral<T>::value &&
+                            !std::is_signed<T>::value>::type> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kUint64;
+  static void Encode(BinaryLogEncoder* encoder, T value) {
+    encoder->Put(static_cast<uint64_t>(value));
+  }
+};
+
+template <typename T>
+struct BinaryLogArg<
+    T,
+    typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kDouble;
+  static void Encode(BinaryLogEncoder* encoder, T value) {
+    double number = static_cast<double>(value);
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    encoder->Put(bits);
+  }
+};
+
+template <>
+struct BinaryLogArg<bool> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kBool;
+  static void Encode(BinaryLogEncoder* encoder, bool value) {
+    encoder->Put(value ? 1u : 0u);
+  }
+};
+
+template <>
+struct BinaryLogArg<char> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kChar;
+  static void Encode(BinaryLogEncoder* encoder, char value) {
+    encoder->Put(static_cast<unsigned char>(value));
+  }
+};
+
+template <typename T>
+struct BinaryLogArg<T*> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kPointer;
+  static void Encode(BinaryLogEncoder* encoder, const T* value) {
+    encoder->Put(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+  }
+};
+
+struct BinaryLogStringArg {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kString;
+  static void Encode(BinaryLogEncoder* encoder, const char* value) {
+    if (!value)
+      value = "(null)";
+    encoder->PutString(value, strlen(value));
+  }
+  static void Encode(BinaryLogEncoder* encoder, StringView value) {
+    encoder->PutString(value.data(), value.size());
+  }
+};
+
+template <>
+struct BinaryLogArg<const char*> : BinaryLogStringArg {};
+template <>
+struct BinaryLogArg<char*> : BinaryLogStringArg {};
+template <>
+struct BinaryLogArg<std::string> : BinaryLogStringArg {};
+template <>
+struct BinaryLogArg<StringView> : BinaryLogStringArg {};
+
+template <>
+struct BinaryLogArg<Hex> {
+  static constexpr BinaryLogArgType kType = BinaryLogArgType::kHex;
+  static void Encode(BinaryLogEncoder* encoder, Hex value) {
+    encoder->Put(value.value);
+    encoder->Put(static_cast<uint64_t>(value.width));
+  }
+};
+
+template <typename T>
+using BinaryLogArgFor = BinaryLogArg<typename std::decay<T>::type>;
+
+// The (fixed) bytes a record's arguments take, besides strings' contents.
+template <typename T>
+constexpr size_t FixedArgSize() {
+  return BinaryLogArgFor<T>::kType == BinaryLogArgType::kString
+             ? sizeof(uint32_t)
+             : BinaryLogArgFor<T>::kType == BinaryLogArgType::kHex
+                   ? 2u * sizeof(uint64_t)
+                   : sizeof(uint64_t);
+}
+
+constexpr size_t SumSizes() {
+  return 0u;
+}
+
+template <typename... Sizes>
+constexpr size_t SumSizes(size_t size, Sizes... sizes) {
+  return size + SumSizes(sizes...);
+}
+
+template <typename... Args>
+struct BinaryLogArgTypes {
+  static constexpr BinaryLogArgType kTypes[sizeof...(Args) + 1u] = {
+      BinaryLogArgFor<Args>::kType..., BinaryLogArgType::kInt64};
+};
+
+template <typename... Args>
+constexpr BinaryLogArgType
+    BinaryLogArgTypes<Args...>::kTypes[sizeof...(Args) + 1u];
+
+// A call site of |FTL_BINARY_LOG()|. These have static storage duration (and
+// are constant-initialized), and are registered (gaining an id) on first use.
+class FTL_EXPORT BinaryLogSite final {
+ public:
+  constexpr BinaryLogSite(LogSeverity severity, const char* file, int line)
+      : severity_(severity), file_(file), line_(line), id_(0u) {}
+
+  template <typename... Args>
+  void Log(const char* format, const Args&... args) {
+    static_assert(sizeof...(Args) <= 255u, "Too many arguments");
+    uint32_t id = id_.load(std::memory_order_acquire);
+    if (!id) {
+      id = Register(format, BinaryLogArgTypes<Args...>::kTypes,
+                    sizeof...(Args));
+    }
+    static_assert(kHeaderSize + SumSizes(FixedArgSize<Args>()...) <=
+                      kMaxBinaryLogRecordSize,
+                  "Too many arguments");
+    char record[kMaxBinaryLogRecordSize];
+    BinaryLogEncoder encoder(record + kHeaderSize,
+                             record + kMaxBinaryLogRecordSize);
+    EncodeArgs(&encoder, args...);
+    const uint32_t header[2] = {
+        id, static_cast<uint32_t>(encoder.data() - record)};
+    memcpy(record, header, sizeof(header));
+    Commit(record, header[1]);
+  }
+
+  LogSeverity severity() const { return severity_; }
+  const char* file() const { return file_; }
+  int line() const { return line_; }
+  // These are set once the site is registered.
+  const char* format() const { return format_; }
+  const BinaryLogArgType* arg_types() const { return arg_types_; }
+  size_t arg_count() const { return arg_count_; }
+
+ private:
+  // A record starts with the site's id and the record's size.
+  static constexpr size_t kHeaderSize = 2u * sizeof(uint32_t);
+
+  static void EncodeArgs(BinaryLogEncoder*) {}
+
+  template <typename T, typename... Rest>
+  static void EncodeArgs(BinaryLogEncoder* encoder,
+                         const T& arg,
+                         const Rest&... rest) {
+    encoder->set_reserved(SumSizes(FixedArgSize<Rest>()...));
+    BinaryLogArgFor<T>::Encode(encoder, arg);
+    EncodeArgs(encoder, rest...);
+  }
+
+  uint32_t Register(const char* format,
+                    const BinaryLogArgType* arg_types,
+                    size_t arg_count);
+  static void Commit(char* record, size_t size);
+
+  const LogSeverity severity_;
+  const char* const file_;
+  const int line_;
+  std::atomic<uint32_t> id_;
+  // Set by |Register()|.
+  const char* format_ = nullptr;
+  const BinaryLogArgType* arg_types_ = nullptr;
+  size_t arg_count_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BinaryLogSite);
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#define FTL_BINARY_LOG_AT(severity, ...)                                       \
+  do {                                                                         \
+    static ::ftl::internal::BinaryLogSite ftl_binary_log_site(                 \
+        (severity), __FILE__, __LINE__);                                       \
+    ftl_binary_log_site.Log(__VA_ARGS__);                                      \
+  } while (false)
+
+// Logs |format| (a string literal) with the arguments that follow it, as
+// above.
+#define FTL_BINARY_LOG(severity, ...)                                          \
+  do {                                                                         \
+    if (FTL_LOG_IS_ON(severity))                                               \
+      FTL_BINARY_LOG_AT(::ftl::LOG_##severity, __VA_ARGS__);                   \
+  } while (false)
+
+#define FTL_BINARY_VLOG(verbose_level, ...)                                    \
+  do {                                                                         \
+    if (FTL_VLOG_IS_ON(verbose_level))                                         \
+      FTL_BINARY_LOG_AT(-(verbose_level), __VA_ARGS__);                        \
+  } while (false)
+
+#endif  // LIB_FTL_BINARY_LOG_H_
@@ -0,0 +1,192 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/binary_log.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/portable_unistd.h"
+
+namespace ftl {
+namespace {
+
+// Logs to a binary log file in a temporary directory, in each test.
+class BinaryLogTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = temp_dir_.path() + "/log";
+    ASSERT_TRUE(SetBinaryLogFile(path_));
+  }
+
+  void TearDown() override { EXPECT_TRUE(SetBinaryLogFile(std::string())); }
+
+  // Returns the messages logged so far, formatted.
+  std::string Decode() {
+    FlushBinaryLog();
+    std::string data;
+    std::string output;
+    EXPECT_TRUE(files::ReadFileToString(path_, &data));
+    EXPECT_TRUE(DecodeBinaryLog(data, &output));
+    return output;
+  }
+
+  files::ScopedTempDir temp_dir_;
+  std::string path_;
+};
+
+TEST_F(BinaryLogTest, Arguments) {
+  const std::string string = "string";
+  const int line = __LINE__ + 1;
+  FTL_BINARY_LOG(INFO, "{} {} {} {} {} {} {} {} {}", -5, 7u, 2.5, true, 'c',
+                 "literal", string, StringView("view"), Hex(255, 4));
+  FTL_BINARY_LOG(WARNING, "no arguments, {{braces}}");
+  FTL_BINARY_VLOG(0, "int64 {}, uint64 {}", INT64_MIN, UINT64_MAX);
+  const char* null = nullptr;
+  FTL_BINARY_LOG(ERROR, "null {}", null);
+
+  std::string output = Decode();
+  EXPECT_NE(std::string::npos,
+            output.find("[INFO:binary_log_unittest.cc(" +
+                        std::to_string(line) +
+                        ")] -5 7 2.5 true c literal string view 00FF\n"))
+      << output;
+  EXPECT_NE(std::string::npos, output.find(")] no arguments, {braces}\n"));
+  EXPECT_NE(std::string::npos,
+            output.find("int64 -9223372036854775808, "
+                        "uint64 18446744073709551615\n"));
+  EXPECT_NE(std::string::npos, output.find(")] null (null)\n"));
+}
+
+TEST_F(BinaryLogTest, RepeatedSites) {
+  for (int i = 0; i < 100; i++)
+    FTL_BINARY_LOG(INFO, "first {}", i);
+  for (int i = 0; i < 100; i++)
+    FTL_BINARY_LOG(INFO, "second {}", -i);
+
+  std::istringstream lines(Decode());
+  std::string line;
+  int first = 0;
+  int second = 0;
+  while (std::getline(lines, line)) {
+    if (line.find("] first ") != std::string::npos) {
+      EXPECT_NE(std::string::npos, line.find(std::to_string(first++)));
+    }
+    if (line.find("] second ") != std::string::npos) {
+      EXPECT_NE(std::string::npos, line.find(std::to_string(-second++)));
+    }
+  }
+  EXPECT_EQ(100, first);
+  EXPECT_EQ(100, second);
+}
+
+TEST_F(BinaryLogTest, LongStringsAreTruncated) {
+  const std::string long_string(10000u, 'x');
+  FTL_BINARY_LOG(INFO, "{} {} {}", long_string, long_string, 42);
+
+  std::string output = Decode();
+  size_t start = output.find("] x");
+  ASSERT_NE(std::string::npos, start);
+  // The first string takes what room there is, and the rest still fit.
+  size_t end = output.find(" ", start + 2u);
+  ASSERT_NE(std::string::npos, end);
+  EXPECT_LT(end - start, internal::kMaxBinaryLogRecordSize);
+  EXPECT_GT(end - start, internal::kMaxBinaryLogRecordSize - 100u);
+  EXPECT_NE(std::string::npos, output.find("  42\n", end));
+}
+
+TEST_F(BinaryLogTest, Threads) {
+  constexpr int kThreads = 4;
+  constexpr int kMessages = 1000;
+  const uint64_t dropped = GetDroppedBinaryLogCount();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < kMessages; i++)
+        FTL_BINARY_LOG(INFO, "thread {} message {}", t, i);
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  // Each thread's messages are in order (though some may have been dropped).
+  std::istringstream lines(Decode());
+  std::string line;
+  int next[kThreads] = {};
+  uint64_t count = 0u;
+  while (std::getline(lines, line)) {
+    size_t position = line.find("] thread ");
+    if (position == std::string::npos)
+      continue;
+    int t = -1;
+    int i = -1;
+    ASSERT_EQ(2, sscanf(line.c_str() + position, "] thread %d message %d", &t,
+                        &i));
+    ASSERT_TRUE(t >= 0 && t < kThreads);
+    EXPECT_LE(next[t], i);
+    next[t] = i + 1;
+    count++;
+  }
+  EXPECT_EQ(static_cast<uint64_t>(kThreads * kMessages),
+            count + GetDroppedBinaryLogCount() - dropped);
+}
+
+TEST_F(BinaryLogTest, Formatted) {
+  // Without a file, messages are formatted to stderr.
+  const std::string stderr_path = temp_dir_.path() + "/stderr";
+  ASSERT_TRUE(files::WriteFile(stderr_path, "", 0));
+  ASSERT_TRUE(SetBinaryLogFile(std::string()));
+  FTL_BINARY_LOG(INFO, "before");
+  FlushBinaryLog();
+  int old_stderr = dup(STDERR_FILENO);
+  FILE* file = fopen(stderr_path.c_str(), "w");
+  ASSERT_TRUE(file);
+  dup2(fileno(file), STDERR_FILENO);
+  FTL_BINARY_LOG(ERROR, "formatted {}", 1);
+  FlushBinaryLog();
+  dup2(old_stderr, STDERR_FILENO);
+  close(old_stderr);
+  fclose(file);
+
+  std::string output;
+  ASSERT_TRUE(files::ReadFileToString(stderr_path, &output));
+  EXPECT_EQ(0u, output.find("[ERROR:"));
+  EXPECT_NE(std::string::npos, output.find(")] formatted 1\n"));
+  EXPECT_EQ(std::string::npos, output.find("before"));
+}
+
+TEST_F(BinaryLogTest, Malformed) {
+  FTL_BINARY_LOG(INFO, "message {}", 1);
+  FTL_BINARY_LOG(INFO, "message {}", 2);
+  FlushBinaryLog();
+  std::string data;
+  ASSERT_TRUE(files::ReadFileToString(path_, &data));
+
+  std::string output;
+  EXPECT_FALSE(DecodeBinaryLog("not a log", &output));
+  // A truncated last record is ignored.
+  output.clear();
+  EXPECT_TRUE(
+      DecodeBinaryLog(StringView(data.data(), data.size() - 1u), &output));
+  EXPECT_NE(std::string::npos, output.find("message 1\n"));
+  EXPECT_EQ(std::string::npos, output.find("message 2"));
+  // A message from an undefined site isn't.
+  output.clear();
+  std::string bad = data.substr(0u, 8u);
+  const uint32_t header[2] = {12345u, 16u};
+  bad.append(reinterpret_cast<const char*>(header), sizeof(header));
+  bad.append(8u, '\0');
+  EXPECT_FALSE(DecodeBinaryLog(bad, &output));
+}
+
+}  // namespace
+}  // namespace ftl
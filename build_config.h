@@ -11,6 +11,8 @@
 //  Processor:
 //    ARCH_CPU_X86 / ARCH_CPU_X86_64 / ARCH_CPU_X86_FAMILY (X86 or X86_64)
 //    ARCH_CPU_32_BITS / ARCH_CPU_64_BITS
+//  Cache line size (in bytes):
+//    FTL_CACHELINE_SIZE
 
 #ifndef LIB_FTL_BUILD_CONFIG_H_
 #define LIB_FTL_BUILD_CONFIG_H_
@@ -107,4 +109,12 @@
 #error Please add support for your architecture in build/build_config.h
 #endif
 
+// The granularity of false sharing: data written by different threads should
+// be at least this far apart. (Apple's ARM64 cores have 128-byte lines.)
+#if defined(ARCH_CPU_ARM64) && defined(OS_MACOSX)
+#define FTL_CACHELINE_SIZE 128
+#else
+#define FTL_CACHELINE_SIZE 64
+#endif
+
 #endif  // LIB_FTL_BUILD_CONFIG_H_
@@ -4,7 +4,61 @@
 
 #include "lib/ftl/command_line.h"
 
+#include <limits>
+#include <type_traits>
+
+#include "lib/ftl/strings/string_number_conversions.h"
+
 namespace ftl {
+namespace {
+
+internal::ParsedOptionValue ParseOptionValue(StringView value) {
+  internal::ParsedOptionValue parsed;
+  parsed.has_int64 = StringToNumberWithError(value, &parsed.int64_value);
+  parsed.has_uint64 = StringToNumberWithError(value, &parsed.uint64_value);
+  parsed.has_float = StringToNumberWithError(value, &parsed.float_value);
+  parsed.has_double = StringToNumberWithError(value, &parsed.double_value);
+  return parsed;
+}
+
+// Every value that parses as a narrower integer type also parses as the 64-bit
+// one (and vice versa, if it's in range).
+template <typename NumberType>
+typename std::enable_if<std::is_signed<NumberType>::value, bool>::type
+GetParsedValue(const internal::ParsedOptionValue& parsed, NumberType* value) {
+  if (!parsed.has_int64 ||
+      parsed.int64_value < std::numeric_limits<NumberType>::min() ||
+      parsed.int64_value > std::numeric_limits<NumberType>::max())
+    return false;
+  *value = static_cast<NumberType>(parsed.int64_value);
+  return true;
+}
+
+template <typename NumberType>
+typename std::enable_if<std::is_unsigned<NumberType>::value, bool>::type
+GetParsedValue(const internal::ParsedOptionValue& parsed, NumberType* value) {
+  if (!parsed.has_uint64 ||
+      parsed.uint64_value > std::numeric_limits<NumberType>::max())
+    return false;
+  *value = static_cast<NumberType>(parsed.uint64_value);
+  return true;
+}
+
+bool GetParsedValue(const internal::ParsedOptionValue& parsed, float* value) {
+  if (!parsed.has_float)
+    return false;
+  *value = parsed.float_value;
+  return true;
+}
+
+bool GetParsedValue(const internal::ParsedOptionValue& parsed, double* value) {
+  if (!parsed.has_double)
+    return false;
+  *value = parsed.double_value;
+  return true;
+}
+
+}  // namespace
 
 // CommandLine -----------------------------------------------------------------
 
@@ -15,7 +69,14 @@ CommandLine::Option::Option(const std::string& name, const std::string& value)
 
 CommandLine::CommandLine() = default;
 
-CommandLine::CommandLine(const CommandLine& from) = default;
+CommandLine::CommandLine(const CommandLine& from)
+    : has_argv0_(from.has_argv0_),
+      argv0_(from.argv0_),
+      options_(from.options_),
+      positional_args_(from.positional_args_),
+      option_info_(from.option_info_) {
+  BuildOptionIndex();
+}
 
 CommandLine::CommandLine(CommandLine&& from) = default;
 
@@ -26,22 +87,34 @@ CommandLine::CommandLine(const std::string& argv0,
       argv0_(argv0),
       options_(options),
       positional_args_(positional_args) {
+  option_info_.resize(options_.size());
   for (size_t i = 0; i < options_.size(); i++)
-    option_index_[options_[i].name] = i;
+    option_info_[i].parsed_value = ParseOptionValue(options_[i].value);
+  BuildOptionIndex();
 }
 
 CommandLine::~CommandLine() = default;
 
-CommandLine& CommandLine::operator=(const CommandLine& from) = default;
+CommandLine& CommandLine::operator=(const CommandLine& from) {
+  if (this != &from) {
+    has_argv0_ = from.has_argv0_;
+    argv0_ = from.argv0_;
+    options_ = from.options_;
+    positional_args_ = from.positional_args_;
+    option_info_ = from.option_info_;
+    BuildOptionIndex();
+  }
+  return *this;
+}
 
 CommandLine& CommandLine::operator=(CommandLine&& from) = default;
 
 bool CommandLine::HasOption(StringView name, size_t* index) const {
-  auto it = option_index_.find(name.ToString());
+  auto it = option_index_.find(name);
   if (it == option_index_.end())
     return false;
   if (index)
-    *index = it->second;
+    *index = it->second.last;
   return true;
 }
 
@@ -56,10 +129,12 @@ bool CommandLine::GetOptionValue(StringView name, std::string* value) const {
 std::vector<ftl::StringView> CommandLine::GetOptionValues(
     StringView name) const {
   std::vector<ftl::StringView> ret;
-  for (const auto& option : options_) {
-    if (option.name == name)
-      ret.push_back(option.value);
-  }
+  auto it = option_index_.find(name);
+  if (it == option_index_.end())
+    return ret;
+  for (size_t i = it->second.first; i < options_.size();
+       i = option_info_[i].next_occurrence)
+    ret.push_back(options_[i].value);
   return ret;
 }
 
@@ -72,6 +147,57 @@ std::string CommandLine::GetOptionValueWithDefault(
   return options_[index].value;
 }
 
+template <typename NumberType>
+bool CommandLine::GetOptionValueAsNumber(StringView name,
+                                         NumberType* value) const {
+  size_t index;
+  if (!HasOption(name, &index))
+    return false;
+  return GetParsedValue(option_info_[index].parsed_value, value);
+}
+
+template bool CommandLine::GetOptionValueAsNumber<int8_t>(
+    StringView name,
+    int8_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<uint8_t>(
+    StringView name,
+    uint8_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<int16_t>(
+    StringView name,
+    int16_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<uint16_t>(
+    StringView name,
+    uint16_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<int32_t>(
+    StringView name,
+    int32_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<uint32_t>(
+    StringView name,
+    uint32_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<int64_t>(
+    StringView name,
+    int64_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<uint64_t>(
+    StringView name,
+    uint64_t* value) const;
+template bool CommandLine::GetOptionValueAsNumber<float>(StringView name,
+                                                         float* value) const;
+template bool CommandLine::GetOptionValueAsNumber<double>(StringView name,
+                                                          double* value) const;
+
+void CommandLine::BuildOptionIndex() {
+  option_index_.clear();
+  for (size_t i = 0; i < options_.size(); i++) {
+    option_info_[i].next_occurrence = options_.size();
+    auto result = option_index_.try_emplace(StringView(options_[i].name),
+                                            OptionIndexEntry{i, i});
+    if (!result.second) {
+      option_info_[result.first->second.last].next_occurrence = i;
+      result.first->second.last = i;
+    }
+  }
+}
+
 // Factory functions (etc.) ----------------------------------------------------
 
 namespace internal {
@@ -95,7 +221,7 @@ bool CommandLineBuilder::ProcessArg(const std::string& arg) {
   }
 
   // Anything that doesn't start with "--" is a positional argument.
-  if (arg.size() < 2u || arg[0] != '-' || arg[1] != '-') {
+  if (!StringView(arg).starts_with("--")) {
     bool rv = positional_args_.empty();
     started_positional_args_ = true;
     positional_args_.push_back(arg);
@@ -152,8 +278,7 @@ std::vector<std::string> CommandLineToArgv(const CommandLine& command_line) {
 
   if (!positional_args.empty()) {
     // Insert a "--" if necessary.
-    if (positional_args[0].size() >= 2u && positional_args[0][0] == '-' &&
-        positional_args[0][1] == '-')
+    if (StringView(positional_args[0]).starts_with("--"))
       argv.push_back("--");
 
     argv.insert(argv.end(), positional_args.begin(), positional_args.end());
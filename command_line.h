@@ -37,18 +37,35 @@
 #define LIB_FTL_COMMAND_LINE_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <initializer_list>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+#include "lib/ftl/containers/flat_hash_map.h"
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/strings/string_view.h"
 
 namespace ftl {
 
+namespace internal {
+
+// An option's value as each kind of number (in base 10), if it is one.
+struct ParsedOptionValue {
+  bool has_int64 = false;
+  bool has_uint64 = false;
+  bool has_float = false;
+  bool has_double = false;
+  int64_t int64_value = 0;
+  uint64_t uint64_value = 0u;
+  float float_value = 0.0f;
+  double double_value = 0.0;
+};
+
+}  // namespace internal
+
 // CommandLine -----------------------------------------------------------------
 
 // Class that stores processed command lines ("argv[0]", options, and positional
@@ -99,7 +116,7 @@ class FTL_EXPORT CommandLine final {
   }
 
   bool operator==(const CommandLine& other) const {
-    // No need to compare |option_index_|.
+    // No need to compare |option_index_| or |option_info_|.
     return has_argv0_ == other.has_argv0_ && argv0_ == other.argv0_ &&
            options_ == other.options_ &&
            positional_args_ == other.positional_args_;
@@ -125,16 +142,44 @@ class FTL_EXPORT CommandLine final {
   std::string GetOptionValueWithDefault(StringView name,
                                         StringView default_value) const;
 
+  // Gets the value of the option |name| as a number, as
+  // |StringToNumberWithError()| would convert it (in base 10). Returns true
+  // (and sets |*value|) on success and false (leaving |*value| alone) if the
+  // option is not specified or isn't a |NumberType|. Values are parsed once, on
+  // construction, so this is as cheap as |HasOption()|. This is available for
+  // the same |NumberType|s as |StringToNumberWithError()|.
+  template <typename NumberType>
+  bool GetOptionValueAsNumber(StringView name, NumberType* value) const;
+
  private:
+  struct OptionInfo {
+    // The index in |options_| of the next occurrence of this option's name
+    // (or |options_.size()| if none).
+    size_t next_occurrence;
+    internal::ParsedOptionValue parsed_value;
+  };
+
+  struct OptionIndexEntry {
+    size_t first;
+    size_t last;
+  };
+
+  // (Re)builds |option_index_| to point into |options_|.
+  void BuildOptionIndex();
+
   bool has_argv0_ = false;
   // The following should all be empty if |has_argv0_| is false.
   std::string argv0_;
   std::vector<Option> options_;
   std::vector<std::string> positional_args_;
 
-  // Maps option names to position in |options_|. If a given name occurs
-  // multiple times, the index will be to the *last* occurrence.
-  std::unordered_map<std::string, size_t> option_index_;
+  // Parallel to |options_|.
+  std::vector<OptionInfo> option_info_;
+
+  // Maps option names (the strings in |options_|, which moving doesn't
+  // relocate, but copying does) to the positions in |options_| of their first
+  // and last occurrences.
+  FlatHashMap<StringView, OptionIndexEntry> option_index_;
 
   // Allow copy and assignment.
 };
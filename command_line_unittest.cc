@@ -4,6 +4,7 @@
 
 #include "lib/ftl/command_line.h"
 
+#include <memory>
 #include <utility>
 
 #include "gtest/gtest.h"
@@ -319,6 +320,51 @@ TEST(CommandLineTest, MultipleOccurrencesOfOption) {
   ASSERT_EQ(2u, values.size());
   EXPECT_EQ("value1", values[0]);
   EXPECT_EQ("value3", values[1]);
+  EXPECT_TRUE(cl.GetOptionValues("flag3").empty());
+}
+
+TEST(CommandLineTest, GetOptionValueAsNumber) {
+  auto cl = CommandLineFromInitializerList(
+      {"my_program", "--count=7", "--negative=-300", "--big=4294967296",
+       "--ratio=0.25", "--name=abc", "--empty", "--count=42"});
+
+  int32_t int32_value = 0;
+  EXPECT_TRUE(cl.GetOptionValueAsNumber("count", &int32_value));
+  EXPECT_EQ(42, int32_value);
+  uint8_t uint8_value = 0u;
+  EXPECT_TRUE(cl.GetOptionValueAsNumber("count", &uint8_value));
+  EXPECT_EQ(42u, uint8_value);
+  double double_value = 0.0;
+  EXPECT_TRUE(cl.GetOptionValueAsNumber("count", &double_value));
+  EXPECT_EQ(42.0, double_value);
+
+  // Out of range, or the wrong kind of number.
+  int8_t int8_value = 1;
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("negative", &int8_value));
+  EXPECT_EQ(1, int8_value);
+  int16_t int16_value = 0;
+  EXPECT_TRUE(cl.GetOptionValueAsNumber("negative", &int16_value));
+  EXPECT_EQ(-300, int16_value);
+  uint64_t uint64_value = 1u;
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("negative", &uint64_value));
+  EXPECT_EQ(1u, uint64_value);
+  uint32_t uint32_value = 1u;
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("big", &uint32_value));
+  EXPECT_EQ(1u, uint32_value);
+  int64_t int64_value = 0;
+  EXPECT_TRUE(cl.GetOptionValueAsNumber("big", &int64_value));
+  EXPECT_EQ(4294967296, int64_value);
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("ratio", &int64_value));
+  float float_value = 0.0f;
+  EXPECT_TRUE(cl.GetOptionValueAsNumber("ratio", &float_value));
+  EXPECT_EQ(0.25f, float_value);
+
+  // Not numbers, or not specified.
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("name", &double_value));
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("empty", &int32_value));
+  EXPECT_FALSE(cl.GetOptionValueAsNumber("missing", &int32_value));
+  EXPECT_EQ(42, int32_value);
+  EXPECT_EQ(42.0, double_value);
 }
 
 // |cl1| and |cl2| should be not equal.
@@ -408,6 +454,24 @@ TEST(CommandLineTest, MoveAndCopy) {
   cl5 = std::move(cl4);
   EXPECT_EQ(cl, cl5);
   EXPECT_EQ("value1", cl5.GetOptionValueWithDefault("flag1", "nope"));
+
+  // Copies don't depend on the original.
+  auto original = std::make_unique<CommandLine>(CommandLineFromInitializerList(
+      {"my_program", "--flag=1", "--other", "--flag=2"}));
+  CommandLine cl6(*original);
+  CommandLine cl7;
+  cl7 = *original;
+  original.reset();
+  for (const CommandLine* copy : {&cl6, &cl7}) {
+    std::vector<StringView> values = copy->GetOptionValues("flag");
+    ASSERT_EQ(2u, values.size());
+    EXPECT_EQ("1", values[0]);
+    EXPECT_EQ("2", values[1]);
+    int value = 0;
+    EXPECT_TRUE(copy->GetOptionValueAsNumber("flag", &value));
+    EXPECT_EQ(2, value);
+    EXPECT_TRUE(copy->HasOption("other"));
+  }
 }
 
 void ToArgvHelper(const char* message, std::initializer_list<std::string> c) {
@@ -5,6 +5,8 @@
 #ifndef LIB_FTL_COMPILER_SPECIFIC_H_
 #define LIB_FTL_COMPILER_SPECIFIC_H_
 
+#include "lib/ftl/build_config.h"
+
 #if !defined(__GNUC__) && !defined(__clang__) && !defined(_MSC_VER)
 #error Unsupported compiler.
 #endif
@@ -35,6 +37,48 @@
 #define FTL_NOINLINE __declspec(noinline)
 #endif
 
+// Annotate a function indicating it's rarely called (e.g., on an error path),
+// so that it's optimized for size and placed away from hot code, and branches
+// to calls of it are predicted not taken.
+// Use like:
+//   COLD void ReportFailure() { ... }
+#if defined(__GNUC__) || defined(__clang__)
+#define FTL_COLD __attribute__((cold))
+#else
+#define FTL_COLD
+#endif
+
+// Annotate a condition with whether it's expected to hold, for code layout
+// (the unexpected case is moved out of the straight-line path).
+// Use like:
+//   if (FTL_UNLIKELY(size > capacity)) { ... }
+#if defined(__GNUC__) || defined(__clang__)
+#define FTL_LIKELY(x) __builtin_expect(!!(x), 1)
+#define FTL_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define FTL_LIKELY(x) (x)
+#define FTL_UNLIKELY(x) (x)
+#endif
+
+// Whether the enclosing expression is being evaluated as a constant (at compile
+// time), for constexpr functions which use plain loops then, but faster library
+// functions (which aren't constexpr) at run time. Compilers which can't tell
+// (before GCC 9 and Clang 9) always take the run-time path, so such functions
+// can't be used in constant expressions with them.
+// Use like:
+//   if (!FTL_IS_CONSTANT_EVALUATED())
+//     return memcmp(a, b, size);
+#if defined(__clang__)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define FTL_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#elif defined(__GNUC__) && __GNUC__ >= 9
+#define FTL_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#if !defined(FTL_IS_CONSTANT_EVALUATED)
+#define FTL_IS_CONSTANT_EVALUATED() false
+#endif
+
 // Specify memory alignment for structs, classes, etc.
 // Use like:
 //   class ALIGNAS(16) MyClass { ... }
@@ -45,6 +89,14 @@
 #define FTL_ALIGNAS(byte_alignment) __declspec(align(byte_alignment))
 #endif
 
+// Aligns a struct, class, or variable to a cache line, so that it doesn't share
+// one with what precedes it (see also memory/cache_line_padded.h). Only use
+// this for static, thread-local or stack storage: before C++17, |new| doesn't
+// honor alignments beyond |max_align_t|'s.
+// Use like:
+//   FTL_CACHELINE_ALIGNED std::atomic<uint64_t> g_counter;
+#define FTL_CACHELINE_ALIGNED FTL_ALIGNAS(FTL_CACHELINE_SIZE)
+
 // Return the byte alignment of the given type (available at compile time).
 // Use like:
 //   ALIGNOF(int32)  // this would be 4
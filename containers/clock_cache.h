@@ -0,0 +1,199 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_CLOCK_CACHE_H_
+#define LIB_FTL_CONTAINERS_CLOCK_CACHE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <utility>
+
+#include "lib/ftl/containers/flat_hash_table.h"
+#include "lib/ftl/containers/intrusive_hash_table.h"
+#include "lib/ftl/containers/intrusive_list.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// A cache like |LruCache| (with the same interface), but which approximates
+// LRU with the CLOCK algorithm: a hit just sets the entry's "referenced" flag
+// (instead of moving it in a list), and eviction sweeps a "hand" around the
+// entries, clearing the flags, and evicting the first entry whose flag was
+// already clear.
+//
+// Since |Get()| only sets a (relaxed atomic) flag, concurrent |Get()|s (and
+// other lookups) are safe, e.g., under a |ReaderMutexLocker|, as long as
+// nothing modifies the cache meanwhile. Hits also don't write to the shared
+// list, so they're cheaper.
+template <typename Key,
+          typename Value,
+          typename Hash = FlatHash<Key>,
+          typename KeyEqual = FlatEqual<Key>>
+class ClockCache final {
+ public:
+  // Called with each entry which is evicted to make room (but not ones which
+  // are removed, replaced or cleared). It mustn't modify the cache.
+  using EvictionCallback = std::function<void(const Key& key, Value value)>;
+
+  explicit ClockCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+  ~ClockCache() { Clear(); }
+
+  void set_on_evict(EvictionCallback on_evict) {
+    on_evict_ = std::move(on_evict);
+  }
+
+  // Returns the value for |key| (marking it as referenced), or null if there
+  // isn't one. The value stays valid until it's evicted or removed.
+  template <typename K>
+  Value* Get(const K& key) {
+    Entry* entry = entries_.Find(key);
+    if (!entry)
+      return nullptr;
+    if (!entry->referenced.load(std::memory_order_relaxed))
+      entry->referenced.store(true, std::memory_order_relaxed);
+    return &entry->value;
+  }
+
+  // Like |Get()|, but doesn't mark the value as referenced.
+  template <typename K>
+  Value* Peek(const K& key) const {
+    Entry* entry = entries_.Find(key);
+    return entry ? &entry->value : nullptr;
+  }
+
+  template <typename K>
+  bool Contains(const K& key) const {
+    return !!entries_.Find(key);
+  }
+
+  // Sets the value for |key| (replacing any previous one), which takes |bytes|
+  // of the budget, evicting entries to make room. Returns the value, or null if
+  // it's bigger than the whole budget (in which case it isn't cached, and any
+  // previous value is removed).
+  Value* Put(Key key, Value value, size_t bytes = 1u) {
+    if (Entry* old_entry = entries_.Find(key))
+      Erase(old_entry);
+    if (bytes > max_bytes_)
+      return nullptr;
+    EvictToFit(max_bytes_ - bytes);
+    Entry* entry = new Entry(std::move(key), std::move(value), bytes);
+    entries_.Insert(entry);
+    // Insert it just behind the hand, so that it's the last to be swept.
+    if (hand_)
+      ring_.insert(ring_.IteratorTo(hand_), entry);
+    else
+      ring_.push_back(hand_ = entry);
+    bytes_ += bytes;
+    return &entry->value;
+  }
+
+  // Removes the value for |key|, returning true if there was one.
+  template <typename K>
+  bool Remove(const K& key) {
+    Entry* entry = entries_.Find(key);
+    if (!entry)
+      return false;
+    Erase(entry);
+    return true;
+  }
+
+  // Removes all the entries.
+  void Clear() {
+    while (!ring_.empty())
+      Erase(ring_.back());
+  }
+
+  // Changes the budget, evicting entries if it shrinks.
+  void set_max_bytes(size_t max_bytes) {
+    max_bytes_ = max_bytes;
+    EvictToFit(max_bytes_);
+  }
+  size_t max_bytes() const { return max_bytes_; }
+
+  // The number of entries, and their total size.
+  size_t size() const { return ring_.size(); }
+  size_t bytes() const { return bytes_; }
+  bool empty() const { return ring_.empty(); }
+
+  // Calls |function(key, value)| for each entry, in no particular order. It
+  // mustn't modify the cache.
+  template <typename Function>
+  void ForEach(Function function) const {
+    for (const Entry& entry : ring_)
+      function(entry.key, entry.value);
+  }
+
+ private:
+  struct Entry : public IntrusiveListNode<> {
+    Entry(Key key, Value value, size_t bytes)
+        : key(std::move(key)),
+          value(std::move(value)),
+          bytes(bytes),
+          referenced(false) {}
+
+    const Key key;
+    Value value;
+    const size_t bytes;
+    std::atomic<bool> referenced;
+  };
+  struct EntryKey {
+    const Key& operator()(const Entry& entry) const { return entry.key; }
+  };
+
+  void EvictToFit(size_t max_bytes) {
+    while (bytes_ > max_bytes) {
+      Entry* entry = hand_;
+      if (entry->referenced.load(std::memory_order_relaxed)) {
+        entry->referenced.store(false, std::memory_order_relaxed);
+        AdvanceHand();
+        continue;
+      }
+      Unlink(entry);
+      if (on_evict_)
+        on_evict_(entry->key, std::move(entry->value));
+      delete entry;
+    }
+  }
+
+  void AdvanceHand() {
+    auto next = std::next(ring_.IteratorTo(hand_));
+    hand_ = next == ring_.end() ? ring_.front() : &*next;
+  }
+
+  void Erase(Entry* entry) {
+    Unlink(entry);
+    delete entry;
+  }
+
+  void Unlink(Entry* entry) {
+    if (entry == hand_) {
+      AdvanceHand();
+      if (hand_ == entry)
+        hand_ = nullptr;
+    }
+    entries_.Erase(entry->key);
+    ring_.erase(entry);
+    FTL_DCHECK(bytes_ >= entry->bytes);
+    bytes_ -= entry->bytes;
+  }
+
+  size_t max_bytes_;
+  size_t bytes_ = 0u;
+  EvictionCallback on_evict_;
+  IntrusiveHashTable<Key, Entry, EntryKey, Hash, KeyEqual> entries_;
+  // The entries, swept from |hand_| (wrapping around), which is null if there
+  // are none.
+  IntrusiveList<Entry> ring_;
+  Entry* hand_ = nullptr;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ClockCache);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_CLOCK_CACHE_H_
@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/clock_cache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TEST(ClockCacheTest, EvictsUnreferenced) {
+  ClockCache<std::string, int> cache(3u);
+  std::vector<std::string> evicted;
+  cache.set_on_evict([&evicted](const std::string& key, int value) {
+    evicted.push_back(key);
+  });
+
+  cache.Put("a", 1);
+  cache.Put("b", 2);
+  cache.Put("c", 3);
+
+  // Nothing is referenced, so the oldest goes first.
+  cache.Put("d", 4);
+  EXPECT_EQ((std::vector<std::string>{"a"}), evicted);
+
+  // "b" gets a second chance.
+  EXPECT_EQ(2, *cache.Get("b"));
+  cache.Put("e", 5);
+  EXPECT_EQ((std::vector<std::string>{"a", "c"}), evicted);
+  EXPECT_TRUE(cache.Contains("b"));
+  EXPECT_EQ(3u, cache.size());
+
+  // Removing the entry at the hand moves the hand on.
+  EXPECT_TRUE(cache.Remove("d"));
+  cache.Put("f", 6);
+  cache.Put("g", 7);
+  EXPECT_EQ((std::vector<std::string>{"a", "c", "b"}), evicted);
+  EXPECT_FALSE(cache.Get("d"));
+
+  cache.Clear();
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(0u, cache.bytes());
+}
+
+TEST(ClockCacheTest, Bytes) {
+  ClockCache<int, std::string> cache(10u);
+  EXPECT_TRUE(cache.Put(1, "one", 3u));
+  EXPECT_TRUE(cache.Put(2, "two", 3u));
+  EXPECT_FALSE(cache.Put(3, "three", 11u));
+  EXPECT_EQ(6u, cache.bytes());
+
+  // Everything is referenced, so a whole sweep clears the flags first.
+  cache.Get(1);
+  cache.Get(2);
+  EXPECT_TRUE(cache.Put(4, "four", 8u));
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ("four", *cache.Peek(4));
+
+  cache.Put(4, "FOUR", 2u);
+  EXPECT_EQ(2u, cache.bytes());
+  cache.set_max_bytes(1u);
+  EXPECT_TRUE(cache.empty());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,327 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_CONCURRENT_HASH_MAP_H_
+#define LIB_FTL_CONTAINERS_CONCURRENT_HASH_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/containers/flat_hash_map.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+
+// A thread-safe hash map from |Key|s to reference-counted |T|s (e.g., a
+// |RefCountedThreadSafe| subclass), for tables shared by many threads, e.g.:
+//
+//   ConcurrentHashMap<std::string, Session> sessions;
+//   sessions.Insert(id, MakeRefCounted<Session>(...));
+//   ...
+//   RefPtr<Session> session = sessions.Find(id);
+//   if (session)
+//     session->Touch();
+//
+// The map is split into shards (by hash), each a |FlatHashMap| with its own
+// mutex on its own cache line, so threads using different keys mostly don't
+// contend. Every operation on a key locks just its shard, briefly: lookups
+// return a reference to the value, which stays valid after it's erased (or
+// replaced). (Readers take the lock rather than using a seqlock, since taking
+// a reference to a value that may be concurrently released isn't safe without
+// one.) The bulk operations (e.g., |FindMany()|) lock each shard once.
+//
+// Operations which visit the whole map (|size()|, |ForEach()|, |EraseIf()|)
+// lock one shard at a time, so they don't see a consistent snapshot.
+template <typename Key,
+          typename T,
+          typename Hash = FlatHash<Key>,
+          typename KeyEqual = FlatEqual<Key>>
+class ConcurrentHashMap final {
+ public:
+  // The default number of shards, several per hardware thread (rounded up to a
+  // power of two).
+  static size_t DefaultShardCount() {
+    return RoundUpToPowerOfTwo(
+        4u * std::max(1u, std::thread::hardware_concurrency()));
+  }
+
+  // |shard_count| is rounded up to a power of two.
+  explicit ConcurrentHashMap(size_t shard_count = DefaultShardCount(),
+                             const Hash& hash = Hash())
+      : shard_count_(RoundUpToPowerOfTwo(shard_count)),
+        shards_(new CacheLinePadded<Shard>[shard_count_]),
+        hash_(hash) {
+    while ((size_t{1} << shard_bits_) < shard_count_)
+      shard_bits_++;
+  }
+  ~ConcurrentHashMap() {}
+
+  size_t shard_count() const { return shard_count_; }
+
+  // Returns the value for |key|, or null if there isn't one. |key| may be a
+  // |Key|, or anything |FlatHashMap<Key, ...>::find()| accepts (e.g., a
+  // |StringView|, if |Key| is |std::string|).
+  template <typename K>
+  RefPtr<T> Find(const K& key) const {
+    const Shard& shard = ShardFor(key);
+    MutexLocker locker(&shard.mutex);
+    auto it = shard.map.find(key);
+    return it == shard.map.end() ? nullptr : it->second;
+  }
+
+  template <typename K>
+  bool Contains(const K& key) const {
+    const Shard& shard = ShardFor(key);
+    MutexLocker locker(&shard.mutex);
+    return shard.map.contains(key);
+  }
+
+  // Inserts |value| (which mustn't be null) for |key|, unless there's already
+  // a value for |key|. Returns true if it was inserted.
+  bool Insert(Key key, RefPtr<T> value) {
+    FTL_DCHECK(value);
+    Shard& shard = ShardFor(key);
+    MutexLocker locker(&shard.mutex);
+    return shard.map.try_emplace(std::move(key), std::move(value)).second;
+  }
+
+  // Sets the value for |key| to |value| (which mustn't be null), returning the
+  // previous value (or null if there wasn't one).
+  RefPtr<T> InsertOrReplace(Key key, RefPtr<T> value) {
+    FTL_DCHECK(value);
+    Shard& shard = ShardFor(key);
+    MutexLocker locker(&shard.mutex);
+    auto result = shard.map.try_emplace(std::move(key), value);
+    if (result.second)
+      return nullptr;
+    result.first->second.swap(value);
+    return value;
+  }
+
+  // Returns the value for |key|, first inserting |make_value()| (which must
+  // return a non-null |RefPtr<T>|) if there isn't one. |make_value()| runs with
+  // |key|'s shard locked, so that concurrent callers for the same key get the
+  // same value, so it should be quick, and mustn't use the map.
+  template <typename MakeValue>
+  RefPtr<T> FindOrInsert(const Key& key, MakeValue make_value) {
+    Shard& shard = ShardFor(key);
+    MutexLocker locker(&shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+      RefPtr<T> value = make_value();
+      FTL_DCHECK(value);
+      it = shard.map.try_emplace(key, std::move(value)).first;
+    }
+    return it->second;
+  }
+
+  // Removes the value for |key|, returning it (or null if there wasn't one).
+  template <typename K>
+  RefPtr<T> Erase(const K& key) {
+    Shard& shard = ShardFor(key);
+    MutexLocker locker(&shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end())
+      return nullptr;
+    RefPtr<T> value = std::move(it->second);
+    shard.map.erase(it);
+    return value;
+  }
+
+  // Bulk operations -----------------------------------------------------------
+
+  // Returns the values for |keys| (in the same order, with null for missing
+  // ones).
+  template <typename K>
+  std::vector<RefPtr<T>> FindMany(const std::vector<K>& keys) const {
+    std::vector<RefPtr<T>> values(keys.size());
+    ForEachShardOf(keys, [&keys, &values](const Shard& shard, size_t i)
+                             FTL_NO_THREAD_SAFETY_ANALYSIS {
+                               auto it = shard.map.find(keys[i]);
+                               if (it != shard.map.end())
+                                 values[i] = it->second;
+                             });
+    return values;
+  }
+
+  // Like |Insert()| for each of |entries|, returning how many were inserted.
+  size_t InsertMany(std::vector<std::pair<Key, RefPtr<T>>> entries) {
+    size_t count = 0u;
+    ForEachShardOf(entries, [&entries, &count](Shard& shard, size_t i)
+                                FTL_NO_THREAD_SAFETY_ANALYSIS {
+                                  auto& entry = entries[i];
+                                  FTL_DCHECK(entry.second);
+                                  if (shard.map
+                                          .try_emplace(std::move(entry.first),
+                                                       std::move(entry.second))
+                                          .second)
+                                    count++;
+                                });
+    return count;
+  }
+
+  // Like |Erase()| for each of |keys|, returning how many were erased.
+  template <typename K>
+  size_t EraseMany(const std::vector<K>& keys) {
+    // Release the values after unlocking (since that may run destructors).
+    std::vector<RefPtr<T>> erased;
+    ForEachShardOf(keys, [&keys, &erased](Shard& shard, size_t i)
+                             FTL_NO_THREAD_SAFETY_ANALYSIS {
+                               auto it = shard.map.find(keys[i]);
+                               if (it == shard.map.end())
+                                 return;
+                               erased.push_back(std::move(it->second));
+                               shard.map.erase(it);
+                             });
+    return erased.size();
+  }
+
+  // Calls |function(key, value)| for each element, with its shard locked (so
+  // it mustn't use the map).
+  template <typename Function>
+  void ForEach(Function function) const {
+    for (size_t i = 0; i < shard_count_; i++) {
+      const Shard& shard = *shards_[i];
+      MutexLocker locker(&shard.mutex);
+      for (const auto& entry : shard.map)
+        function(entry.first, entry.second);
+    }
+  }
+
+  // Removes the elements for which |predicate(key, value)| (called with their
+  // shard locked, so it mustn't use the map) is true, returning how many.
+  template <typename Predicate>
+  size_t EraseIf(Predicate predicate) {
+    size_t count = 0u;
+    std::vector<RefPtr<T>> erased;
+    for (size_t i = 0; i < shard_count_; i++) {
+      Shard& shard = *shards_[i];
+      {
+        MutexLocker locker(&shard.mutex);
+        for (auto it = shard.map.begin(); it != shard.map.end();) {
+          if (predicate(it->first,
+                        static_cast<const RefPtr<T>&>(it->second))) {
+            erased.push_back(std::move(it->second));
+            shard.map.erase(it++);
+          } else {
+            ++it;
+          }
+        }
+      }
+      // Release the values after unlocking (since that may run destructors).
+      count += erased.size();
+      erased.clear();
+    }
+    return count;
+  }
+
+  // Removes all the elements.
+  void Clear() {
+    for (size_t i = 0; i < shard_count_; i++) {
+      Shard& shard = *shards_[i];
+      // Release the values after unlocking (since that may run destructors).
+      FlatHashMap<Key, RefPtr<T>, Hash, KeyEqual> map;
+      {
+        MutexLocker locker(&shard.mutex);
+        map.swap(shard.map);
+      }
+    }
+  }
+
+  // The number of elements (which may be out of date by the time it returns,
+  // if other threads are using the map).
+  size_t size() const {
+    size_t size = 0u;
+    for (size_t i = 0; i < shard_count_; i++) {
+      const Shard& shard = *shards_[i];
+      MutexLocker locker(&shard.mutex);
+      size += shard.map.size();
+    }
+    return size;
+  }
+  bool empty() const { return size() == 0u; }
+
+ private:
+  struct Shard {
+    mutable Mutex mutex;
+    FlatHashMap<Key, RefPtr<T>, Hash, KeyEqual> map FTL_GUARDED_BY(mutex);
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    size_t result = 1u;
+    while (result < n)
+      result *= 2u;
+    return result;
+  }
+
+  // Picks the shard with the top bits of the (mixed) hash, which the shards'
+  // maps mostly don't use.
+  template <typename K>
+  size_t ShardIndex(const K& key) const {
+    if (!shard_bits_)
+      return 0u;
+    uint64_t hash =
+        static_cast<uint64_t>(hash_(key)) * UINT64_C(0x9e3779b97f4a7c15);
+    return static_cast<size_t>(hash >> (64u - shard_bits_));
+  }
+  template <typename K>
+  Shard& ShardFor(const K& key) {
+    return *shards_[ShardIndex(key)];
+  }
+  template <typename K>
+  const Shard& ShardFor(const K& key) const {
+    return *shards_[ShardIndex(key)];
+  }
+
+  static const Key& KeyOfItem(const Key& key) { return key; }
+  template <typename K>
+  static const K& KeyOfItem(const K& key) {
+    return key;
+  }
+  template <typename V>
+  static const Key& KeyOfItem(const std::pair<Key, V>& entry) {
+    return entry.first;
+  }
+
+  // Calls |function(shard, i)| for each index |i| of |items| (keys, or
+  // entries), with |shard| (|items[i]|'s) locked, locking each shard once.
+  template <typename Items, typename Function>
+  void ForEachShardOf(const Items& items, Function function) const {
+    std::vector<std::pair<size_t, size_t>> order(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+      order[i] = {ShardIndex(KeyOfItem(items[i])), i};
+    std::sort(order.begin(), order.end());
+    for (size_t begin = 0; begin < order.size();) {
+      Shard& shard = *shards_[order[begin].first];
+      MutexLocker locker(&shard.mutex);
+      size_t end = begin;
+      for (; end < order.size() && order[end].first == order[begin].first;
+           end++)
+        function(shard, order[end].second);
+      begin = end;
+    }
+  }
+
+  const size_t shard_count_;
+  size_t shard_bits_ = 0u;
+  const std::unique_ptr<CacheLinePadded<Shard>[]> shards_;
+  const Hash hash_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ConcurrentHashMap);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_CONCURRENT_HASH_MAP_H_
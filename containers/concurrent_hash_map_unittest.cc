@@ -0,0 +1,186 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/concurrent_hash_map.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace {
+
+class Value : public RefCountedThreadSafe<Value> {
+ public:
+  int value() const { return value_; }
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(Value);
+  FRIEND_REF_COUNTED_THREAD_SAFE(Value);
+
+  explicit Value(int value) : value_(value) {}
+  ~Value() {}
+
+  const int value_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Value);
+};
+
+using Map = ConcurrentHashMap<std::string, Value>;
+
+TEST(ConcurrentHashMapTest, Basic) {
+  Map map(3u);
+  EXPECT_EQ(4u, map.shard_count());
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.Find("a"));
+
+  EXPECT_TRUE(map.Insert("a", MakeRefCounted<Value>(1)));
+  EXPECT_FALSE(map.Insert("a", MakeRefCounted<Value>(2)));
+  EXPECT_EQ(1, map.Find("a")->value());
+  EXPECT_TRUE(map.Contains(StringView("abc").substr(0, 1)));
+
+  RefPtr<Value> old = map.InsertOrReplace("a", MakeRefCounted<Value>(3));
+  ASSERT_TRUE(old);
+  EXPECT_EQ(1, old->value());
+  EXPECT_EQ(3, map.Find("a")->value());
+  EXPECT_FALSE(map.InsertOrReplace("b", MakeRefCounted<Value>(4)));
+
+  int made = 0;
+  auto make_value = [&made] {
+    made++;
+    return MakeRefCounted<Value>(5);
+  };
+  EXPECT_EQ(4, map.FindOrInsert("b", make_value)->value());
+  EXPECT_EQ(5, map.FindOrInsert("c", make_value)->value());
+  EXPECT_EQ(1, made);
+  EXPECT_EQ(3u, map.size());
+
+  // A value stays valid once it's erased.
+  RefPtr<Value> a = map.Find("a");
+  RefPtr<Value> erased = map.Erase(StringView("a"));
+  EXPECT_EQ(a, erased);
+  EXPECT_EQ(3, a->value());
+  EXPECT_FALSE(map.Erase("a"));
+  EXPECT_EQ(2u, map.size());
+
+  map.Clear();
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(ConcurrentHashMapTest, Bulk) {
+  Map map(8u);
+  std::vector<std::pair<std::string, RefPtr<Value>>> entries;
+  for (int i = 0; i < 100; i++)
+    entries.emplace_back(NumberToString(i), MakeRefCounted<Value>(i));
+  entries.emplace_back("0", MakeRefCounted<Value>(-1));
+  EXPECT_EQ(100u, map.InsertMany(std::move(entries)));
+  EXPECT_EQ(100u, map.size());
+
+  std::vector<StringView> keys = {"7", "missing", "42"};
+  std::vector<RefPtr<Value>> values = map.FindMany(keys);
+  ASSERT_EQ(3u, values.size());
+  EXPECT_EQ(7, values[0]->value());
+  EXPECT_FALSE(values[1]);
+  EXPECT_EQ(42, values[2]->value());
+
+  int sum = 0;
+  map.ForEach([&sum](const std::string& key, const RefPtr<Value>& value) {
+    EXPECT_EQ(NumberToString(value->value()), key);
+    sum += value->value();
+  });
+  EXPECT_EQ(4950, sum);
+
+  EXPECT_EQ(50u, map.EraseIf([](const std::string& key,
+                                const RefPtr<Value>& value) {
+    return value->value() % 2 == 1;
+  }));
+  EXPECT_EQ(2u, map.EraseMany(std::vector<std::string>{"0", "1", "2"}));
+  EXPECT_EQ(48u, map.size());
+}
+
+// Uses the map it's in when it's destroyed.
+class MapUser : public RefCountedThreadSafe<MapUser> {
+ public:
+  using UserMap = ConcurrentHashMap<std::string, MapUser>;
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(MapUser);
+  FRIEND_REF_COUNTED_THREAD_SAFE(MapUser);
+
+  MapUser(UserMap* map, int* destroyed) : map_(map), destroyed_(destroyed) {}
+  ~MapUser() {
+    map_->Erase("other");
+    (*destroyed_)++;
+  }
+
+  UserMap* const map_;
+  int* const destroyed_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MapUser);
+};
+
+TEST(ConcurrentHashMapTest, ValuesReleasedAfterUnlocking) {
+  // (With one shard, the destructors would deadlock if they ran under a lock.)
+  MapUser::UserMap map(1u);
+  int destroyed = 0;
+  for (int i = 0; i < 6; i++)
+    map.Insert(NumberToString(i), MakeRefCounted<MapUser>(&map, &destroyed));
+
+  EXPECT_EQ(2u, map.EraseMany(std::vector<std::string>{"0", "1"}));
+  EXPECT_EQ(2, destroyed);
+  EXPECT_EQ(2u, map.EraseIf([](const std::string& key,
+                               const RefPtr<MapUser>& value) {
+    return key == "2" || key == "3";
+  }));
+  EXPECT_EQ(4, destroyed);
+  map.Erase("4");
+  EXPECT_EQ(5, destroyed);
+  map.Clear();
+  EXPECT_EQ(6, destroyed);
+}
+
+TEST(ConcurrentHashMapTest, Threads) {
+  constexpr int kThreadCount = 8;
+  constexpr int kKeyCount = 256;
+  Map map;
+  std::atomic<int> found(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadCount; t++) {
+    threads.emplace_back([&map, &found, t] {
+      for (int i = 0; i < 4000; i++) {
+        std::string key = NumberToString((i * 7 + t) % kKeyCount);
+        switch (i % 4) {
+          case 0:
+            map.Insert(key, MakeRefCounted<Value>(i));
+            break;
+          case 1:
+            map.FindOrInsert(key, [i] { return MakeRefCounted<Value>(i); });
+            break;
+          case 2:
+            if (map.Find(key))
+              found.fetch_add(1, std::memory_order_relaxed);
+            break;
+          case 3:
+            if (t % 2)
+              map.Erase(key);
+            break;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_LE(map.size(), static_cast<size_t>(kKeyCount));
+  EXPECT_GT(found.load(), 0);
+}
+
+}  // namespace
+}  // namespace ftl
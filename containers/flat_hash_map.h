@@ -0,0 +1,152 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_FLAT_HASH_MAP_H_
+#define LIB_FTL_CONTAINERS_FLAT_HASH_MAP_H_
+
+#include <stddef.h>
+
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+
+#include "lib/ftl/containers/flat_hash_table.h"
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace internal {
+
+template <typename K, typename V>
+struct FlatHashMapPolicy {
+  using Key = K;
+  using Slot = std::pair<const K, V>;
+  using IteratorSlot = Slot;
+
+  static const K& KeyOf(const Slot& slot) { return slot.first; }
+
+  // Moves |*src| to (uninitialized) |*dst|, and destroys |*src|. (Its key is
+  // const, but it's about to be destroyed, so it may as well be moved.)
+  static void Transfer(Slot* dst, Slot* src) {
+    new (dst) Slot(std::move(const_cast<K&>(src->first)),
+                   std::move(src->second));
+    src->~Slot();
+  }
+};
+
+}  // namespace internal
+
+// A hash map with (most of) the interface of |std::unordered_map|, but which
+// keeps its elements in one array (with open addressing), instead of one
+// allocation per element, so lookups touch few cache lines and (for string
+// keys) needn't build a |std::string|, e.g.:
+//
+//   FlatHashMap<std::string, int> counts;
+//   counts["apple"]++;
+//   auto it = counts.find(StringView(line).substr(0, 5));
+//
+// Unlike with |std::unordered_map|, inserting may move the elements (so it
+// invalidates pointers and references to them, as well as iterators), and
+// there are no buckets. Erasing invalidates only iterators to the erased
+// element. Iteration is in no particular order.
+template <typename Key,
+          typename T,
+          typename Hash = FlatHash<Key>,
+          typename KeyEqual = FlatEqual<Key>>
+class FlatHashMap
+    : public internal::FlatHashTable<internal::FlatHashMapPolicy<Key, T>,
+                                     Hash,
+                                     KeyEqual> {
+  using Base = internal::FlatHashTable<internal::FlatHashMapPolicy<Key, T>,
+                                       Hash,
+                                       KeyEqual>;
+
+ public:
+  using mapped_type = T;
+  using typename Base::iterator;
+  using typename Base::key_type;
+  using typename Base::value_type;
+
+  using Base::Base;
+  FlatHashMap() {}
+  FlatHashMap(std::initializer_list<value_type> values) : Base(values) {}
+
+  FlatHashMap& operator=(std::initializer_list<value_type> values) {
+    Base::clear();
+    Base::insert(values);
+    return *this;
+  }
+
+  // Inserts an element with |key| and a value constructed from |args|, unless
+  // there's already an element with |key| (in which case |args| are unused).
+  // Returns the element with |key|, and whether it was inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    return TryEmplace(key, std::forward<Args>(args)...);
+  }
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(key_type&& key, Args&&... args) {
+    return TryEmplace(std::move(key), std::forward<Args>(args)...);
+  }
+
+  // Like |try_emplace()|, but assigns |value| to the existing element, if
+  // there is one.
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const key_type& key, M&& value) {
+    auto result = TryEmplace(key, std::forward<M>(value));
+    if (!result.second)
+      result.first->second = std::forward<M>(value);
+    return result;
+  }
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(key_type&& key, M&& value) {
+    auto result = TryEmplace(std::move(key), std::forward<M>(value));
+    if (!result.second)
+      result.first->second = std::forward<M>(value);
+    return result;
+  }
+
+  // Returns the value for |key|, inserting a value-initialized one if there
+  // isn't one.
+  T& operator[](const key_type& key) { return TryEmplace(key).first->second; }
+  T& operator[](key_type&& key) {
+    return TryEmplace(std::move(key)).first->second;
+  }
+
+  // Returns the value for |key|, which must be in the map.
+  template <typename K>
+  T& at(const K& key) {
+    auto it = Base::find(key);
+    FTL_CHECK(it != Base::end());
+    return it->second;
+  }
+  template <typename K>
+  const T& at(const K& key) const {
+    auto it = Base::find(key);
+    FTL_CHECK(it != Base::end());
+    return it->second;
+  }
+
+ private:
+  template <typename K, typename... Args>
+  std::pair<iterator, bool> TryEmplace(K&& key, Args&&... args) {
+    auto result = Base::FindOrPrepareInsert(key);
+    if (result.second) {
+      new (Base::SlotAt(result.first))
+          value_type(std::piecewise_construct,
+                     std::forward_as_tuple(std::forward<K>(key)),
+                     std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+    return {Base::IteratorAt(result.first), result.second};
+  }
+};
+
+template <typename Key, typename T, typename Hash, typename KeyEqual>
+void swap(FlatHashMap<Key, T, Hash, KeyEqual>& a,
+          FlatHashMap<Key, T, Hash, KeyEqual>& b) {
+  a.swap(b);
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_FLAT_HASH_MAP_H_
@@ -0,0 +1,168 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/flat_hash_map.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace {
+
+TEST(FlatHashMapTest, Basic) {
+  FlatHashMap<std::string, int> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.end(), map.find("a"));
+
+  EXPECT_TRUE(map.insert({"a", 1}).second);
+  EXPECT_FALSE(map.insert({"a", 2}).second);
+  EXPECT_TRUE(map.emplace("b", 2).second);
+  EXPECT_TRUE(map.try_emplace("c", 3).second);
+  EXPECT_FALSE(map.try_emplace("c", 4).second);
+  map["d"] = 4;
+  map["a"] += 10;
+  EXPECT_EQ(4u, map.size());
+  EXPECT_EQ(11, map.at("a"));
+  EXPECT_EQ(3, map.at("c"));
+
+  EXPECT_FALSE(map.insert_or_assign("c", 5).second);
+  EXPECT_EQ(5, map["c"]);
+
+  EXPECT_EQ(1u, map.erase("b"));
+  EXPECT_EQ(0u, map.erase("b"));
+  EXPECT_FALSE(map.contains("b"));
+  EXPECT_EQ(3u, map.size());
+
+  std::map<std::string, int> sorted(map.begin(), map.end());
+  EXPECT_EQ((std::map<std::string, int>{{"a", 11}, {"c", 5}, {"d", 4}}),
+            sorted);
+
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(FlatHashMapTest, HeterogeneousLookup) {
+  FlatHashMap<std::string, int> map = {{"apple", 1}, {"banana", 2}};
+  std::string text = "apple pie";
+  StringView word = StringView(text).substr(0, 5);
+  ASSERT_NE(map.end(), map.find(word));
+  EXPECT_EQ(1, map.find(word)->second);
+  EXPECT_TRUE(map.contains("banana"));
+  EXPECT_EQ(0u, map.count(StringView(text)));
+
+  const FlatHashMap<std::string, int>& const_map = map;
+  EXPECT_EQ(2, const_map.at(StringView("banana")));
+  EXPECT_EQ(1u, map.erase(word));
+  EXPECT_EQ(1u, map.size());
+
+  // A map keyed by |StringView|s can be looked up by |std::string|s.
+  FlatHashMap<StringView, int> views = {{"banana", 2}};
+  EXPECT_TRUE(views.contains(std::string("banana")));
+}
+
+TEST(FlatHashMapTest, MoveOnlyValues) {
+  FlatHashMap<int, std::unique_ptr<int>> map;
+  for (int i = 0; i < 100; i++)
+    map.try_emplace(i, new int(i * i));
+  EXPECT_EQ(100u, map.size());
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(i * i, *map.at(i));
+
+  FlatHashMap<int, std::unique_ptr<int>> moved(std::move(map));
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(100u, moved.size());
+  map = std::move(moved);
+  EXPECT_EQ(81, *map.at(9));
+}
+
+TEST(FlatHashMapTest, CopyAndCompare) {
+  FlatHashMap<int, std::string> map = {{1, "one"}, {2, "two"}};
+  FlatHashMap<int, std::string> copy = map;
+  EXPECT_EQ(map, copy);
+  copy[2] = "deux";
+  EXPECT_NE(map, copy);
+  copy = map;
+  EXPECT_EQ(map, copy);
+  swap(map, copy);
+  EXPECT_EQ(map, copy);
+}
+
+TEST(FlatHashMapTest, EraseWhileIterating) {
+  FlatHashMap<int, int> map;
+  for (int i = 0; i < 1000; i++)
+    map[i] = i;
+  for (auto it = map.begin(); it != map.end();) {
+    if (it->first % 3)
+      map.erase(it++);
+    else
+      ++it;
+  }
+  EXPECT_EQ(334u, map.size());
+  for (const auto& entry : map)
+    EXPECT_EQ(0, entry.first % 3);
+}
+
+TEST(FlatHashMapTest, Reserve) {
+  FlatHashMap<int, int> map;
+  map.reserve(1000u);
+  size_t capacity = map.capacity();
+  EXPECT_GE(capacity, 1000u);
+  for (int i = 0; i < 1000; i++)
+    map[i] = i;
+  EXPECT_EQ(capacity, map.capacity());
+
+  // Churn (which leaves tombstones) doesn't make it grow.
+  for (int i = 1000; i < 100000; i++) {
+    map.erase(i - 1000);
+    map[i] = i;
+  }
+  EXPECT_EQ(1000u, map.size());
+  EXPECT_EQ(capacity, map.capacity());
+}
+
+// Compares with |std::unordered_map| under random insertions and erasures,
+// with a weak hash (so that there are many collisions).
+TEST(FlatHashMapTest, Random) {
+  struct WeakHash {
+    size_t operator()(uint32_t key) const { return key % 64u; }
+  };
+  FlatHashMap<uint32_t, uint32_t, WeakHash> map;
+  std::unordered_map<uint32_t, uint32_t> expected;
+  std::mt19937 generator(42);
+  for (int i = 0; i < 20000; i++) {
+    uint32_t key = generator() % 512u;
+    switch (generator() % 3u) {
+      case 0:
+      case 1:
+        map[key] = static_cast<uint32_t>(i);
+        expected[key] = static_cast<uint32_t>(i);
+        break;
+      case 2:
+        EXPECT_EQ(expected.erase(key), map.erase(key));
+        break;
+    }
+    ASSERT_EQ(expected.size(), map.size());
+  }
+  for (const auto& entry : expected) {
+    auto it = map.find(entry.first);
+    ASSERT_NE(map.end(), it);
+    EXPECT_EQ(entry.second, it->second);
+  }
+  size_t count = 0u;
+  for (auto it = map.cbegin(); it != map.cend(); ++it)
+    count++;
+  EXPECT_EQ(expected.size(), count);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,74 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_FLAT_HASH_SET_H_
+#define LIB_FTL_CONTAINERS_FLAT_HASH_SET_H_
+
+#include <initializer_list>
+#include <utility>
+
+#include "lib/ftl/containers/flat_hash_table.h"
+
+namespace ftl {
+namespace internal {
+
+template <typename K>
+struct FlatHashSetPolicy {
+  using Key = K;
+  using Slot = K;
+  // Elements can't be modified through iterators (which would change keys).
+  using IteratorSlot = const K;
+
+  static const K& KeyOf(const Slot& slot) { return slot; }
+
+  // Moves |*src| to (uninitialized) |*dst|, and destroys |*src|.
+  static void Transfer(Slot* dst, Slot* src) {
+    new (dst) Slot(std::move(*src));
+    src->~Slot();
+  }
+};
+
+}  // namespace internal
+
+// A hash set with (most of) the interface of |std::unordered_set|, but which
+// keeps its elements in one array (see |FlatHashMap|, whose caveats apply),
+// e.g.:
+//
+//   FlatHashSet<std::string> names = {"apple", "banana"};
+//   if (names.contains(StringView(line).substr(0, 5)))
+//     ...
+template <typename Key,
+          typename Hash = FlatHash<Key>,
+          typename KeyEqual = FlatEqual<Key>>
+class FlatHashSet
+    : public internal::FlatHashTable<internal::FlatHashSetPolicy<Key>,
+                                     Hash,
+                                     KeyEqual> {
+  using Base = internal::FlatHashTable<internal::FlatHashSetPolicy<Key>,
+                                       Hash,
+                                       KeyEqual>;
+
+ public:
+  using typename Base::value_type;
+
+  using Base::Base;
+  FlatHashSet() {}
+  FlatHashSet(std::initializer_list<value_type> values) : Base(values) {}
+
+  FlatHashSet& operator=(std::initializer_list<value_type> values) {
+    Base::clear();
+    Base::insert(values);
+    return *this;
+  }
+};
+
+template <typename Key, typename Hash, typename KeyEqual>
+void swap(FlatHashSet<Key, Hash, KeyEqual>& a,
+          FlatHashSet<Key, Hash, KeyEqual>& b) {
+  a.swap(b);
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_FLAT_HASH_SET_H_
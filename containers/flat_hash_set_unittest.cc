@@ -0,0 +1,82 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/flat_hash_set.h"
+
+#include <set>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace {
+
+// Counts the live instances, to check that every element is destroyed.
+struct Counted {
+  explicit Counted(int value) : value(value) { count++; }
+  Counted(const Counted& other) : value(other.value) { count++; }
+  ~Counted() { count--; }
+
+  bool operator==(const Counted& other) const { return value == other.value; }
+
+  int value;
+  static int count;
+};
+
+int Counted::count = 0;
+
+struct CountedHash {
+  size_t operator()(const Counted& counted) const {
+    return static_cast<size_t>(counted.value);
+  }
+};
+
+TEST(FlatHashSetTest, Basic) {
+  FlatHashSet<std::string> set = {"a", "b"};
+  EXPECT_EQ(2u, set.size());
+  EXPECT_TRUE(set.insert("c").second);
+  EXPECT_FALSE(set.insert("a").second);
+  EXPECT_TRUE(set.contains(StringView("abc").substr(1, 1)));
+  EXPECT_EQ(1u, set.erase("a"));
+  EXPECT_EQ(std::set<std::string>({"b", "c"}),
+            std::set<std::string>(set.begin(), set.end()));
+
+  set = {"x"};
+  EXPECT_EQ(1u, set.size());
+  EXPECT_EQ("x", *set.begin());
+}
+
+TEST(FlatHashSetTest, Grows) {
+  FlatHashSet<int> set;
+  for (int i = 0; i < 10000; i++)
+    EXPECT_TRUE(set.insert(i).second);
+  EXPECT_EQ(10000u, set.size());
+  EXPECT_LE(set.size(), set.capacity() - set.capacity() / 8u);
+  for (int i = 0; i < 10000; i++)
+    EXPECT_TRUE(set.contains(i));
+  EXPECT_FALSE(set.contains(10000));
+}
+
+TEST(FlatHashSetTest, DestroysElements) {
+  {
+    FlatHashSet<Counted, CountedHash> set;
+    for (int i = 0; i < 100; i++)
+      set.emplace(i);
+    // Not inserted, but constructed (and destroyed).
+    set.emplace(0);
+    EXPECT_EQ(100, Counted::count);
+    EXPECT_EQ(1u, set.erase(Counted(5)));
+    EXPECT_EQ(99, Counted::count);
+
+    FlatHashSet<Counted, CountedHash> copy(set);
+    EXPECT_EQ(198, Counted::count);
+    copy.clear();
+    EXPECT_EQ(99, Counted::count);
+  }
+  EXPECT_EQ(0, Counted::count);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,676 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The open-addressing hash table underlying |FlatHashMap| and |FlatHashSet|
+// (see flat_hash_map.h and flat_hash_set.h), which should be used instead.
+
+#ifndef LIB_FTL_CONTAINERS_FLAT_HASH_TABLE_H_
+#define LIB_FTL_CONTAINERS_FLAT_HASH_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_view.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ftl {
+
+// The default hash function for |FlatHashMap| and |FlatHashSet|: |std::hash|,
+// except that tables of strings (|std::string| or |StringView|) hash with
+// |std::hash<StringView>| (i.e., |HashString()|), and can be looked up by any
+// string (e.g., a |StringView| or a literal) without building a |std::string|.
+template <typename Key>
+struct FlatHash : std::hash<Key> {};
+
+template <>
+struct FlatHash<std::string> {
+  using is_transparent = void;
+  size_t operator()(StringView str) const {
+    return std::hash<StringView>()(str);
+  }
+};
+
+template <>
+struct FlatHash<StringView> : FlatHash<std::string> {};
+
+// The default key comparison for |FlatHashMap| and |FlatHashSet| (see
+// |FlatHash|).
+template <typename Key>
+struct FlatEqual : std::equal_to<Key> {};
+
+template <>
+struct FlatEqual<std::string> {
+  using is_transparent = void;
+  bool operator()(StringView lhs, StringView rhs) const { return lhs == rhs; }
+};
+
+template <>
+struct FlatEqual<StringView> : FlatEqual<std::string> {};
+
+namespace internal {
+
+// Each slot of the table has a control byte: either |kFlatHashEmpty|,
+// |kFlatHashDeleted| (a tombstone) or, if the slot is full, 7 bits of its
+// element's hash (|H2()|). A lookup compares a whole group of control bytes
+// with its key's 7 bits at once, so it only compares keys (about) when they're
+// likely to be equal, and stops at the first group with an empty slot.
+using FlatHashCtrl = int8_t;
+constexpr FlatHashCtrl kFlatHashEmpty = -128;
+constexpr FlatHashCtrl kFlatHashDeleted = -2;
+
+// A set of positions in a group, from matching control bytes. (Each position
+// has |1 << kShift| bits in |mask_|.)
+template <typename Mask, int kShift, size_t kWidth>
+class FlatHashBitMask {
+ public:
+  explicit FlatHashBitMask(Mask mask) : mask_(mask) {}
+
+  explicit operator bool() const { return mask_ != 0u; }
+
+  // The first position in the set (which mustn't be empty).
+  size_t Lowest() const {
+    return static_cast<size_t>(__builtin_ctzll(mask_)) >> kShift;
+  }
+  void RemoveLowest() { mask_ &= mask_ - 1u; }
+
+  // The number of positions before the first (or after the last) in the set,
+  // or |kWidth| if the set is empty.
+  size_t TrailingZeros() const { return mask_ ? Lowest() : kWidth; }
+  size_t LeadingZeros() const {
+    if (!mask_)
+      return kWidth;
+    size_t total_bits = sizeof(unsigned long long) * 8u;
+    size_t unused_bits = total_bits - (kWidth << kShift);
+    return (static_cast<size_t>(__builtin_clzll(mask_)) - unused_bits) >>
+           kShift;
+  }
+
+ private:
+  Mask mask_;
+};
+
+#if defined(__SSE2__)
+
+// 16 control bytes, compared with SSE2.
+class FlatHashGroup {
+ public:
+  static constexpr size_t kWidth = 16u;
+  using BitMask = FlatHashBitMask<uint32_t, 0, kWidth>;
+
+  explicit FlatHashGroup(const FlatHashCtrl* ctrl)
+      : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+  // The positions whose control bytes are |h2|.
+  BitMask Match(FlatHashCtrl h2) const {
+    return BitMask(static_cast<uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_))));
+  }
+  BitMask MatchEmpty() const { return Match(kFlatHashEmpty); }
+  // Empty and deleted control bytes are the negative ones.
+  BitMask MatchEmptyOrDeleted() const {
+    return BitMask(static_cast<uint32_t>(_mm_movemask_epi8(ctrl_)));
+  }
+
+ private:
+  __m128i ctrl_;
+};
+
+#else
+
+// 8 control bytes, compared a word at a time.
+class FlatHashGroup {
+ public:
+  static constexpr size_t kWidth = 8u;
+  using BitMask = FlatHashBitMask<uint64_t, 3, kWidth>;
+
+  explicit FlatHashGroup(const FlatHashCtrl* ctrl) {
+    memcpy(&ctrl_, ctrl, sizeof(ctrl_));
+  }
+
+  // The positions whose control bytes are |h2|. (This may also include a
+  // position just after a match whose control byte differs from |h2| only in
+  // its lowest bit, which is harmless, since the keys are compared anyway.)
+  BitMask Match(FlatHashCtrl h2) const {
+    uint64_t x = ctrl_ ^ (kEachByte * static_cast<uint8_t>(h2));
+    return BitMask((x - kEachByte) & ~x & kHighBits);
+  }
+  // Of the control bytes, only |kFlatHashEmpty| has its high bit set and its
+  // second-lowest bit clear.
+  BitMask MatchEmpty() const {
+    return BitMask((ctrl_ & ~(ctrl_ << 6)) & kHighBits);
+  }
+  BitMask MatchEmptyOrDeleted() const { return BitMask(ctrl_ & kHighBits); }
+
+ private:
+  static constexpr uint64_t kEachByte = UINT64_C(0x0101010101010101);
+  static constexpr uint64_t kHighBits = UINT64_C(0x8080808080808080);
+
+  uint64_t ctrl_;
+};
+
+#endif
+
+// An iterator over the full slots of a table, which are |Slot|s (or const
+// |Slot|s, for a |const_iterator|).
+template <typename Slot>
+class FlatHashIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename std::remove_const<Slot>::type;
+  using difference_type = ptrdiff_t;
+  using pointer = Slot*;
+  using reference = Slot&;
+
+  FlatHashIterator() {}
+  // Converts an |iterator| to a |const_iterator|.
+  template <typename OtherSlot,
+            typename = typename std::enable_if<
+                std::is_convertible<OtherSlot*, Slot*>::value>::type>
+  FlatHashIterator(const FlatHashIterator<OtherSlot>& other)
+      : ctrl_(other.ctrl_), end_(other.end_), slot_(other.slot_) {}
+
+  reference operator*() const { return *slot_; }
+  pointer operator->() const { return slot_; }
+
+  FlatHashIterator& operator++() {
+    ++ctrl_;
+    ++slot_;
+    SkipEmpty();
+    return *this;
+  }
+  FlatHashIterator operator++(int) {
+    FlatHashIterator result = *this;
+    ++*this;
+    return result;
+  }
+
+  bool operator==(const FlatHashIterator& other) const {
+    return slot_ == other.slot_;
+  }
+  bool operator!=(const FlatHashIterator& other) const {
+    return slot_ != other.slot_;
+  }
+
+ private:
+  template <typename OtherSlot>
+  friend class FlatHashIterator;
+  template <typename Policy, typename Hash, typename KeyEqual>
+  friend class FlatHashTable;
+
+  FlatHashIterator(const FlatHashCtrl* ctrl,
+                   const FlatHashCtrl* end,
+                   Slot* slot)
+      : ctrl_(ctrl), end_(end), slot_(slot) {
+    SkipEmpty();
+  }
+
+  void SkipEmpty() {
+    while (ctrl_ != end_ && *ctrl_ < 0) {
+      ++ctrl_;
+      ++slot_;
+    }
+  }
+
+  const FlatHashCtrl* ctrl_ = nullptr;
+  const FlatHashCtrl* end_ = nullptr;
+  Slot* slot_ = nullptr;
+};
+
+// Whether |T| has an |is_transparent| member type.
+template <typename T, typename = void>
+struct FlatHashIsTransparent : std::false_type {};
+template <typename T>
+struct FlatHashIsTransparent<T,
+                             decltype(void(std::declval<
+                                           typename T::is_transparent*>()))>
+    : std::true_type {};
+
+// A hash table of |Policy::Slot|s, which have keys of type |Policy::Key|
+// (|Policy::KeyOf(slot)|). The slots are in one array, after their control
+// bytes, so a lookup typically touches two cache lines. The table has a
+// power-of-two capacity, at least a group, and is kept at most 7/8 full (of
+// elements and tombstones). The |kWidth| control bytes after the last are
+// copies of the first |kWidth|, so that a group can be loaded at any slot.
+//
+// Groups are probed quadratically (by the triangular numbers of groups), which
+// visits every group once. Erasing an element leaves a tombstone, unless no
+// probe can ever have passed over it (in which case its slot is just emptied).
+template <typename Policy, typename Hash, typename KeyEqual>
+class FlatHashTable {
+  using ConstIterator = FlatHashIterator<const typename Policy::Slot>;
+
+  // |EnableIfTransparent<K>| is |K| if keys can be looked up without
+  // converting them to |key_type|s (and |K| isn't an iterator, for |erase()|).
+  template <typename K>
+  using EnableIfTransparent = typename std::enable_if<
+      FlatHashIsTransparent<Hash>::value &&
+          FlatHashIsTransparent<KeyEqual>::value &&
+          !std::is_convertible<K, ConstIterator>::value,
+      K>::type;
+
+ public:
+  using key_type = typename Policy::Key;
+  using value_type = typename Policy::Slot;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using iterator = FlatHashIterator<typename Policy::IteratorSlot>;
+  using const_iterator = FlatHashIterator<const value_type>;
+
+  FlatHashTable() {}
+  explicit FlatHashTable(size_t count,
+                         const Hash& hash = Hash(),
+                         const KeyEqual& key_equal = KeyEqual())
+      : hash_(hash), key_equal_(key_equal) {
+    reserve(count);
+  }
+  template <typename InputIterator>
+  FlatHashTable(InputIterator first, InputIterator last) {
+    insert(first, last);
+  }
+  FlatHashTable(std::initializer_list<value_type> values) {
+    insert(values.begin(), values.end());
+  }
+
+  FlatHashTable(const FlatHashTable& other)
+      : hash_(other.hash_), key_equal_(other.key_equal_) {
+    reserve(other.size_);
+    for (const value_type& value : other)
+      emplace(value);
+  }
+  FlatHashTable(FlatHashTable&& other)
+      : hash_(std::move(other.hash_)), key_equal_(std::move(other.key_equal_)) {
+    TakeFrom(&other);
+  }
+
+  ~FlatHashTable() { Destroy(); }
+
+  FlatHashTable& operator=(const FlatHashTable& other) {
+    if (this != &other) {
+      FlatHashTable copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+  FlatHashTable& operator=(FlatHashTable&& other) {
+    if (this != &other) {
+      Destroy();
+      hash_ = std::move(other.hash_);
+      key_equal_ = std::move(other.key_equal_);
+      TakeFrom(&other);
+    }
+    return *this;
+  }
+
+  iterator begin() { return IteratorAt(0u); }
+  const_iterator begin() const { return IteratorAt(0u); }
+  const_iterator cbegin() const { return begin(); }
+  iterator end() { return IteratorAt(capacity_); }
+  const_iterator end() const { return IteratorAt(capacity_); }
+  const_iterator cend() const { return end(); }
+
+  bool empty() const { return size_ == 0u; }
+  size_t size() const { return size_; }
+  // The number of slots (of which at most 7/8 are used).
+  size_t capacity() const { return capacity_; }
+
+  hasher hash_function() const { return hash_; }
+  key_equal key_eq() const { return key_equal_; }
+
+  // Makes room for |count| elements without growing (or rehashing).
+  void reserve(size_t count) {
+    if (count <= size_ + growth_left_)
+      return;
+    size_t capacity = FlatHashGroup::kWidth;
+    while (GrowthCapacity(capacity) < count)
+      capacity *= 2u;
+    Rehash(capacity);
+  }
+
+  // Removes all the elements (keeping the capacity).
+  void clear() {
+    DestroySlots();
+    if (capacity_)
+      ResetCtrl();
+  }
+
+  // Inserts |value|, unless there's already an element with its key. Returns
+  // the element with the key, and whether it was inserted.
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return emplace(value);
+  }
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return emplace(std::move(value));
+  }
+  template <typename InputIterator>
+  void insert(InputIterator first, InputIterator last) {
+    for (; first != last; ++first)
+      emplace(*first);
+  }
+  void insert(std::initializer_list<value_type> values) {
+    insert(values.begin(), values.end());
+  }
+
+  // Like |insert()|, but constructs the element from |args| (even if it isn't
+  // inserted).
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    typename std::aligned_storage<sizeof(value_type),
+                                  alignof(value_type)>::type storage;
+    value_type* value = new (&storage) value_type(std::forward<Args>(args)...);
+    auto result = FindOrPrepareInsert(Policy::KeyOf(*value));
+    if (result.second)
+      Policy::Transfer(SlotAt(result.first), value);
+    else
+      value->~value_type();
+    return {IteratorAt(result.first), result.second};
+  }
+
+  // Lookups take a |key_type|, or, if |Hash| and |KeyEqual| both have an
+  // |is_transparent| member type (see |FlatHash|), anything they accept.
+  iterator find(const key_type& key) { return IteratorAt(FindIndex(key)); }
+  const_iterator find(const key_type& key) const {
+    return IteratorAt(FindIndex(key));
+  }
+  bool contains(const key_type& key) const {
+    return FindIndex(key) != capacity_;
+  }
+  size_t count(const key_type& key) const { return contains(key) ? 1u : 0u; }
+
+  template <typename K, typename = EnableIfTransparent<K>>
+  iterator find(const K& key) {
+    return IteratorAt(FindIndex(key));
+  }
+  template <typename K, typename = EnableIfTransparent<K>>
+  const_iterator find(const K& key) const {
+    return IteratorAt(FindIndex(key));
+  }
+  template <typename K, typename = EnableIfTransparent<K>>
+  bool contains(const K& key) const {
+    return FindIndex(key) != capacity_;
+  }
+  template <typename K, typename = EnableIfTransparent<K>>
+  size_t count(const K& key) const {
+    return contains(key) ? 1u : 0u;
+  }
+
+  // Removes the element with the given key, returning the number removed.
+  size_t erase(const key_type& key) { return EraseKey(key); }
+  template <typename K, typename = EnableIfTransparent<K>>
+  size_t erase(const K& key) {
+    return EraseKey(key);
+  }
+  // Removes the element at |position|. This invalidates only iterators to it,
+  // so elements can be erased while iterating, with |table.erase(it++)|.
+  void erase(const_iterator position) {
+    FTL_DCHECK(position != end());
+    EraseAt(static_cast<size_t>(position.slot_ - slots_));
+  }
+
+  void swap(FlatHashTable& other) {
+    using std::swap;
+    swap(hash_, other.hash_);
+    swap(key_equal_, other.key_equal_);
+    swap(ctrl_, other.ctrl_);
+    swap(slots_, other.slots_);
+    swap(capacity_, other.capacity_);
+    swap(size_, other.size_);
+    swap(growth_left_, other.growth_left_);
+  }
+
+  // Tables are equal if they have equal elements (in any order).
+  bool operator==(const FlatHashTable& other) const {
+    if (size_ != other.size_)
+      return false;
+    for (const value_type& value : *this) {
+      auto it = other.find(Policy::KeyOf(value));
+      if (it == other.end() || !(*it == value))
+        return false;
+    }
+    return true;
+  }
+  bool operator!=(const FlatHashTable& other) const {
+    return !(*this == other);
+  }
+
+ protected:
+  // Returns the index of the slot with the given key, or |capacity_|.
+  template <typename K>
+  size_t FindIndex(const K& key) const {
+    return capacity_ ? FindIndex(key, Mix(hash_(key))) : capacity_;
+  }
+  template <typename K>
+  size_t FindIndex(const K& key, size_t hash) const {
+    FlatHashCtrl h2 = H2(hash);
+    size_t mask = capacity_ - 1u;
+    size_t position = H1(hash) & mask;
+    for (size_t step = FlatHashGroup::kWidth;;
+         step += FlatHashGroup::kWidth) {
+      FlatHashGroup group(ctrl_ + position);
+      for (auto match = group.Match(h2); match; match.RemoveLowest()) {
+        size_t index = (position + match.Lowest()) & mask;
+        if (key_equal_(Policy::KeyOf(slots_[index]), key))
+          return index;
+      }
+      if (group.MatchEmpty())
+        return capacity_;
+      position = (position + step) & mask;
+    }
+  }
+
+  // Returns the index of the slot with the given key (and false), or else
+  // marks a slot for it as full (the caller must construct the element there)
+  // and returns its index (and true).
+  template <typename K>
+  std::pair<size_t, bool> FindOrPrepareInsert(const K& key) {
+    size_t hash = Mix(hash_(key));
+    size_t index = 0u;
+    if (capacity_) {
+      index = FindIndex(key, hash);
+      if (index != capacity_)
+        return {index, false};
+      index = FindFirstNonFull(hash);
+    }
+    if (!capacity_) {
+      Rehash(FlatHashGroup::kWidth);
+      index = FindFirstNonFull(hash);
+    } else if (growth_left_ == 0u && ctrl_[index] != kFlatHashDeleted) {
+      // Grow, unless enough of the room is taken by tombstones that just
+      // dropping them will do.
+      Rehash(size_ <= capacity_ * 25u / 32u ? capacity_ : capacity_ * 2u);
+      index = FindFirstNonFull(hash);
+    }
+    if (ctrl_[index] == kFlatHashEmpty)
+      growth_left_--;
+    SetCtrl(index, H2(hash));
+    size_++;
+    return {index, true};
+  }
+
+  value_type* SlotAt(size_t index) { return slots_ + index; }
+
+  iterator IteratorAt(size_t index) {
+    return iterator(ctrl_ + index, ctrl_ + capacity_, slots_ + index);
+  }
+  const_iterator IteratorAt(size_t index) const {
+    return const_iterator(ctrl_ + index, ctrl_ + capacity_, slots_ + index);
+  }
+
+ private:
+  static_assert(alignof(value_type) <= alignof(max_align_t),
+                "FlatHashTable doesn't support over-aligned elements");
+
+  static size_t GrowthCapacity(size_t capacity) {
+    return capacity - capacity / 8u;
+  }
+
+  // Mixes the hash (since |std::hash| is often the identity), whose low 7 bits
+  // are |H2()| and the rest |H1()|.
+  static size_t Mix(size_t hash) {
+    uint64_t h = static_cast<uint64_t>(hash);
+    h ^= h >> 33;
+    h *= UINT64_C(0xff51afd7ed558ccd);
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+  static size_t H1(size_t hash) { return hash >> 7; }
+  static FlatHashCtrl H2(size_t hash) {
+    return static_cast<FlatHashCtrl>(hash & 0x7f);
+  }
+
+  // Returns the index of the first empty or deleted slot in |hash|'s probe
+  // sequence.
+  size_t FindFirstNonFull(size_t hash) const {
+    size_t mask = capacity_ - 1u;
+    size_t position = H1(hash) & mask;
+    for (size_t step = FlatHashGroup::kWidth;;
+         step += FlatHashGroup::kWidth) {
+      auto match = FlatHashGroup(ctrl_ + position).MatchEmptyOrDeleted();
+      if (match)
+        return (position + match.Lowest()) & mask;
+      position = (position + step) & mask;
+    }
+  }
+
+  void SetCtrl(size_t index, FlatHashCtrl ctrl) {
+    ctrl_[index] = ctrl;
+    if (index < FlatHashGroup::kWidth)
+      ctrl_[capacity_ + index] = ctrl;
+  }
+
+  void ResetCtrl() {
+    memset(ctrl_, static_cast<uint8_t>(kFlatHashEmpty),
+           capacity_ + FlatHashGroup::kWidth);
+    growth_left_ = GrowthCapacity(capacity_);
+  }
+
+  template <typename K>
+  size_t EraseKey(const K& key) {
+    size_t index = FindIndex(key);
+    if (index == capacity_)
+      return 0u;
+    EraseAt(index);
+    return 1u;
+  }
+
+  void EraseAt(size_t index) {
+    slots_[index].~value_type();
+    size_--;
+    // If the empty slots nearest before and after |index| are less than a
+    // group apart, every group containing |index| has had an empty slot, so no
+    // probe can have continued past it, and it needn't be a tombstone.
+    size_t mask = capacity_ - 1u;
+    size_t before = (index - FlatHashGroup::kWidth) & mask;
+    auto empty_after = FlatHashGroup(ctrl_ + index).MatchEmpty();
+    auto empty_before = FlatHashGroup(ctrl_ + before).MatchEmpty();
+    if (empty_after && empty_before &&
+        empty_after.TrailingZeros() + empty_before.LeadingZeros() <
+            FlatHashGroup::kWidth) {
+      SetCtrl(index, kFlatHashEmpty);
+      growth_left_++;
+    } else {
+      SetCtrl(index, kFlatHashDeleted);
+    }
+  }
+
+  // Moves the elements to a new array of |capacity| slots.
+  void Rehash(size_t capacity) {
+    FTL_DCHECK(capacity >= FlatHashGroup::kWidth &&
+               !(capacity & (capacity - 1u)));
+    FTL_DCHECK(GrowthCapacity(capacity) >= size_);
+    FlatHashCtrl* old_ctrl = ctrl_;
+    value_type* old_slots = slots_;
+    size_t old_capacity = capacity_;
+
+    size_t slots_offset = SlotsOffset(capacity);
+    char* memory = static_cast<char*>(
+        ::operator new(slots_offset + capacity * sizeof(value_type)));
+    ctrl_ = reinterpret_cast<FlatHashCtrl*>(memory);
+    slots_ = reinterpret_cast<value_type*>(memory + slots_offset);
+    capacity_ = capacity;
+    ResetCtrl();
+    growth_left_ -= size_;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_ctrl[i] < 0)
+        continue;
+      size_t hash = Mix(hash_(Policy::KeyOf(old_slots[i])));
+      size_t index = FindFirstNonFull(hash);
+      SetCtrl(index, H2(hash));
+      Policy::Transfer(slots_ + index, old_slots + i);
+    }
+    ::operator delete(old_ctrl);
+  }
+
+  // The slots follow the control bytes (and their copies).
+  static size_t SlotsOffset(size_t capacity) {
+    size_t ctrl_size = capacity + FlatHashGroup::kWidth;
+    return (ctrl_size + alignof(value_type) - 1u) &
+           ~(alignof(value_type) - 1u);
+  }
+
+  void DestroySlots() {
+    for (size_t i = 0; i < capacity_; i++) {
+      if (ctrl_[i] >= 0)
+        slots_[i].~value_type();
+    }
+    size_ = 0u;
+  }
+
+  void Destroy() {
+    DestroySlots();
+    ::operator delete(ctrl_);
+    ctrl_ = nullptr;
+    slots_ = nullptr;
+    capacity_ = 0u;
+    growth_left_ = 0u;
+  }
+
+  // Takes |other|'s elements, leaving it empty. |this| must be empty.
+  void TakeFrom(FlatHashTable* other) {
+    ctrl_ = other->ctrl_;
+    slots_ = other->slots_;
+    capacity_ = other->capacity_;
+    size_ = other->size_;
+    growth_left_ = other->growth_left_;
+    other->ctrl_ = nullptr;
+    other->slots_ = nullptr;
+    other->capacity_ = 0u;
+    other->size_ = 0u;
+    other->growth_left_ = 0u;
+  }
+
+  Hash hash_;
+  KeyEqual key_equal_;
+  // A single allocation (null if |capacity_| is zero).
+  FlatHashCtrl* ctrl_ = nullptr;
+  value_type* slots_ = nullptr;
+  size_t capacity_ = 0u;
+  size_t size_ = 0u;
+  // The number of elements which can be inserted into empty slots before the
+  // table is 7/8 full.
+  size_t growth_left_ = 0u;
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_FLAT_HASH_TABLE_H_
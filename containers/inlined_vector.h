@@ -0,0 +1,342 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_INLINED_VECTOR_H_
+#define LIB_FTL_CONTAINERS_INLINED_VECTOR_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+
+// A vector which keeps up to |N| elements inline (in the object itself, e.g.,
+// on the stack), only allocating once it grows beyond that, for the common
+// case of small sequences (e.g., the fields of a short line; see
+// |SplitString()|). Once it has spilled to the heap, it stays there (until
+// |shrink_to_fit()|).
+//
+// It has (most of) the interface of |std::vector|. Unlike with |std::vector|,
+// moving an inlined vector moves its elements (if they're inline), so moves are
+// O(|N|) and invalidate iterators.
+template <typename T, size_t N>
+class InlinedVector {
+  static_assert(N > 0u, "InlinedVector needs inline capacity");
+
+  static constexpr bool kNothrowMove =
+      std::is_nothrow_move_constructible<T>::value;
+
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using difference_type = ptrdiff_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using iterator = T*;
+  using const_iterator = const T*;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  InlinedVector() {}
+  explicit InlinedVector(size_t count) { resize(count); }
+  InlinedVector(size_t count, const T& value) { Fill(count, value); }
+  InlinedVector(std::initializer_list<T> values) {
+    Append(values.begin(), values.end());
+  }
+  template <typename InputIterator,
+            typename = typename std::iterator_traits<
+                InputIterator>::iterator_category>
+  InlinedVector(InputIterator first, InputIterator last) {
+    Append(first, last);
+  }
+
+  InlinedVector(const InlinedVector& other) {
+    Append(other.begin(), other.end());
+  }
+  // (Not throwing lets |std::vector| move, rather than copy, inlined vectors
+  // when it reallocates.)
+  InlinedVector(InlinedVector&& other) noexcept(kNothrowMove) {
+    MoveFrom(&other);
+  }
+
+  ~InlinedVector() {
+    clear();
+    FreeHeap();
+  }
+
+  InlinedVector& operator=(const InlinedVector& other) {
+    if (this != &other) {
+      clear();
+      Append(other.begin(), other.end());
+    }
+    return *this;
+  }
+  InlinedVector& operator=(InlinedVector&& other) noexcept(kNothrowMove) {
+    if (this != &other) {
+      clear();
+      FreeHeap();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+  InlinedVector& operator=(std::initializer_list<T> values) {
+    clear();
+    Append(values.begin(), values.end());
+    return *this;
+  }
+
+  // Like those of |std::vector|, these may be given (a range of) this vector's
+  // own elements, which are copied before the old contents are destroyed.
+  void assign(size_t count, const T& value) {
+    T copy(value);
+    clear();
+    Fill(count, copy);
+  }
+  template <typename InputIterator,
+            typename = typename std::iterator_traits<
+                InputIterator>::iterator_category>
+  void assign(InputIterator first, InputIterator last) {
+    InlinedVector values;
+    values.Append(first, last);
+    *this = std::move(values);
+  }
+
+  // Returns the number of elements which fit inline.
+  static constexpr size_t inlined_capacity() { return N; }
+  // Returns true if the elements are inline (rather than on the heap).
+  bool is_inlined() const { return data_ == InlineData(); }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  bool empty() const { return size_ == 0u; }
+
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+
+  T& operator[](size_t index) {
+    FTL_DCHECK(index < size_);
+    return data_[index];
+  }
+  const T& operator[](size_t index) const {
+    FTL_DCHECK(index < size_);
+    return data_[index];
+  }
+  T& front() { return (*this)[0]; }
+  const T& front() const { return (*this)[0]; }
+  T& back() { return (*this)[size_ - 1u]; }
+  const T& back() const { return (*this)[size_ - 1u]; }
+
+  iterator begin() { return data_; }
+  const_iterator begin() const { return data_; }
+  const_iterator cbegin() const { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator end() const { return data_ + size_; }
+  const_iterator cend() const { return data_ + size_; }
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const {
+    return const_reverse_iterator(end());
+  }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  void reserve(size_t capacity) {
+    if (capacity > capacity_)
+      Reallocate(capacity);
+  }
+
+  // Moves the elements back inline if they fit, or otherwise to a heap
+  // allocation of exactly |size()|.
+  void shrink_to_fit() {
+    if (!is_inlined() && size_ < capacity_)
+      Reallocate(size_);
+  }
+
+  void push_back(const T& value) { emplace_back(value); }
+  void push_back(T&& value) { emplace_back(std::move(value)); }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      // Construct the element first, since |args| may refer to an element.
+      T value(std::forward<Args>(args)...);
+      Reallocate(capacity_ * 2u);
+      new (data_ + size_) T(std::move(value));
+    } else {
+      new (data_ + size_) T(std::forward<Args>(args)...);
+    }
+    return data_[size_++];
+  }
+
+  void pop_back() {
+    FTL_DCHECK(size_ > 0u);
+    data_[--size_].~T();
+  }
+
+  iterator insert(const_iterator position, const T& value) {
+    return emplace(position, value);
+  }
+  iterator insert(const_iterator position, T&& value) {
+    return emplace(position, std::move(value));
+  }
+
+  template <typename... Args>
+  iterator emplace(const_iterator position, Args&&... args) {
+    size_t index = static_cast<size_t>(position - data_);
+    FTL_DCHECK(index <= size_);
+    emplace_back(std::forward<Args>(args)...);
+    std::rotate(data_ + index, data_ + size_ - 1u, data_ + size_);
+    return data_ + index;
+  }
+
+  iterator erase(const_iterator position) {
+    return erase(position, position + 1);
+  }
+  iterator erase(const_iterator first, const_iterator last) {
+    size_t index = static_cast<size_t>(first - data_);
+    size_t count = static_cast<size_t>(last - first);
+    FTL_DCHECK(index + count <= size_);
+    std::move(data_ + index + count, data_ + size_, data_ + index);
+    DestroyFrom(size_ - count);
+    return data_ + index;
+  }
+
+  void resize(size_t size) {
+    if (size < size_) {
+      DestroyFrom(size);
+      return;
+    }
+    reserve(size);
+    for (size_t i = size_; i < size; i++)
+      new (data_ + i) T();
+    size_ = size;
+  }
+  void resize(size_t size, const T& value) {
+    if (size < size_) {
+      DestroyFrom(size);
+      return;
+    }
+    while (size_ < size)
+      push_back(value);
+  }
+
+  void clear() { DestroyFrom(0u); }
+
+  void swap(InlinedVector& other) noexcept(kNothrowMove) {
+    InlinedVector temp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(temp);
+  }
+
+  bool operator==(const InlinedVector& other) const {
+    return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+  }
+  bool operator!=(const InlinedVector& other) const {
+    return !(*this == other);
+  }
+  bool operator<(const InlinedVector& other) const {
+    return std::lexicographical_compare(begin(), end(), other.begin(),
+                                        other.end());
+  }
+
+ private:
+  T* InlineData() { return reinterpret_cast<T*>(&inline_storage_); }
+  const T* InlineData() const {
+    return reinterpret_cast<const T*>(&inline_storage_);
+  }
+
+  // Moves the elements to storage for |capacity| (at least |size_|) elements:
+  // inline, if they fit, or else on the heap.
+  void Reallocate(size_t capacity) {
+    FTL_DCHECK(capacity >= size_);
+    T* new_data = capacity <= N ? InlineData()
+                                : static_cast<T*>(::operator new(
+                                      capacity * sizeof(T)));
+    if (new_data == data_)
+      return;
+    for (size_t i = 0; i < size_; i++) {
+      new (new_data + i) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    FreeHeap();
+    data_ = new_data;
+    capacity_ = std::max(capacity, N);
+  }
+
+  // Appends copies of the elements from |first| to |last| (which must not be
+  // this vector's).
+  template <typename InputIterator>
+  void Append(InputIterator first, InputIterator last) {
+    for (; first != last; ++first)
+      emplace_back(*first);
+  }
+
+  // Sets the (empty) vector to |count| copies of |value| (which must not be
+  // an element).
+  void Fill(size_t count, const T& value) {
+    FTL_DCHECK(empty());
+    reserve(count);
+    for (size_t i = 0; i < count; i++)
+      new (data_ + i) T(value);
+    size_ = count;
+  }
+
+  void FreeHeap() {
+    if (!is_inlined())
+      ::operator delete(data_);
+  }
+
+  // Takes |other|'s elements, leaving it empty (and inline). |this| must be
+  // empty and inline.
+  void MoveFrom(InlinedVector* other) {
+    if (other->is_inlined()) {
+      for (size_t i = 0; i < other->size_; i++)
+        new (InlineData() + i) T(std::move(other->data_[i]));
+      data_ = InlineData();
+      capacity_ = N;
+      size_ = other->size_;
+      other->clear();
+      return;
+    }
+    data_ = other->data_;
+    size_ = other->size_;
+    capacity_ = other->capacity_;
+    other->data_ = other->InlineData();
+    other->size_ = 0u;
+    other->capacity_ = N;
+  }
+
+  // Destroys the elements from |size| on.
+  void DestroyFrom(size_t size) {
+    for (size_t i = size; i < size_; i++)
+      data_[i].~T();
+    size_ = std::min(size, size_);
+  }
+
+  typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type
+      inline_storage_;
+  T* data_ = InlineData();
+  size_t size_ = 0u;
+  size_t capacity_ = N;
+};
+
+template <typename T, size_t N>
+void swap(InlinedVector<T, N>& a,
+          InlinedVector<T, N>& b) noexcept(noexcept(a.swap(b))) {
+  a.swap(b);
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_INLINED_VECTOR_H_
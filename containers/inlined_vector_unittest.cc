@@ -0,0 +1,160 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/inlined_vector.h"
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+// Counts the live instances, to check that every element is destroyed.
+class Counted {
+ public:
+  explicit Counted(int value = 0) : value_(value) { count_++; }
+  Counted(const Counted& other) : value_(other.value_) { count_++; }
+  Counted& operator=(const Counted& other) = default;
+  ~Counted() { count_--; }
+
+  int value() const { return value_; }
+  static int count() { return count_; }
+
+ private:
+  int value_;
+  static int count_;
+};
+
+int Counted::count_ = 0;
+
+TEST(InlinedVectorTest, StaysInlineUntilFull) {
+  InlinedVector<int, 4> v;
+  EXPECT_TRUE(v.empty());
+  EXPECT_EQ(4u, v.capacity());
+  for (int i = 0; i < 4; i++)
+    v.push_back(i);
+  EXPECT_TRUE(v.is_inlined());
+  EXPECT_EQ(4u, v.capacity());
+
+  v.push_back(4);
+  EXPECT_FALSE(v.is_inlined());
+  EXPECT_GE(v.capacity(), 5u);
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}),
+            std::vector<int>(v.begin(), v.end()));
+
+  v.pop_back();
+  v.shrink_to_fit();
+  EXPECT_TRUE(v.is_inlined());
+  EXPECT_EQ((InlinedVector<int, 4>{0, 1, 2, 3}), v);
+}
+
+TEST(InlinedVectorTest, InsertAndErase) {
+  InlinedVector<std::string, 2> v = {"b", "d"};
+  v.insert(v.begin(), "a");
+  v.insert(v.begin() + 2, "c");
+  v.emplace(v.end(), 2u, 'e');
+  EXPECT_EQ((InlinedVector<std::string, 2>{"a", "b", "c", "d", "ee"}), v);
+
+  EXPECT_EQ(v.begin() + 1, v.erase(v.begin() + 1));
+  EXPECT_EQ(v.begin() + 1, v.erase(v.begin() + 1, v.begin() + 3));
+  EXPECT_EQ((InlinedVector<std::string, 2>{"a", "ee"}), v);
+
+  // An element of the vector itself may be pushed, even when that
+  // reallocates.
+  v.push_back(v[0]);
+  EXPECT_EQ("a", v.back());
+}
+
+TEST(InlinedVectorTest, Resize) {
+  InlinedVector<int, 2> v(3u, 7);
+  EXPECT_EQ((InlinedVector<int, 2>{7, 7, 7}), v);
+  v.resize(1u);
+  v.resize(3u);
+  EXPECT_EQ((InlinedVector<int, 2>{7, 0, 0}), v);
+  v.resize(4u, 1);
+  EXPECT_EQ((InlinedVector<int, 2>{7, 0, 0, 1}), v);
+  v.clear();
+  EXPECT_TRUE(v.empty());
+}
+
+TEST(InlinedVectorTest, CopyAndMove) {
+  for (size_t size : {2u, 5u}) {
+    InlinedVector<std::unique_ptr<int>, 3> v;
+    for (size_t i = 0; i < size; i++)
+      v.emplace_back(new int(static_cast<int>(i)));
+
+    InlinedVector<std::unique_ptr<int>, 3> moved(std::move(v));
+    EXPECT_TRUE(v.empty());
+    ASSERT_EQ(size, moved.size());
+    EXPECT_EQ(1, *moved[1]);
+
+    v = std::move(moved);
+    EXPECT_TRUE(moved.empty());
+    ASSERT_EQ(size, v.size());
+    EXPECT_EQ(static_cast<int>(size) - 1, *v.back());
+  }
+
+  InlinedVector<std::string, 1> a = {"x", "y"};
+  InlinedVector<std::string, 1> b = {"z"};
+  InlinedVector<std::string, 1> c = a;
+  EXPECT_EQ(a, c);
+  swap(a, b);
+  EXPECT_EQ((InlinedVector<std::string, 1>{"z"}), a);
+  EXPECT_EQ(c, b);
+  EXPECT_TRUE(b < a);
+}
+
+TEST(InlinedVectorTest, NothrowMove) {
+  using Vector = InlinedVector<std::string, 2>;
+  static_assert(std::is_nothrow_move_constructible<Vector>::value, "");
+  static_assert(std::is_nothrow_move_assignable<Vector>::value, "");
+
+  // So |std::vector| moves the inline elements when it reallocates.
+  std::vector<InlinedVector<std::unique_ptr<int>, 2>> vectors(1u);
+  vectors[0].emplace_back(new int(1));
+  const int* value = vectors[0][0].get();
+  vectors.resize(vectors.capacity() + 1u);
+  EXPECT_EQ(value, vectors[0][0].get());
+}
+
+TEST(InlinedVectorTest, AssignOwnElements) {
+  for (size_t size : {3u, 6u}) {
+    InlinedVector<std::string, 4> v;
+    for (size_t i = 0; i < size; i++)
+      v.push_back(std::string(20u, static_cast<char>('a' + i)));
+    v.assign(v.begin() + 1, v.end());
+    ASSERT_EQ(size - 1u, v.size());
+    EXPECT_EQ(std::string(20u, 'b'), v.front());
+    EXPECT_EQ(std::string(20u, static_cast<char>('a' + size - 1u)), v.back());
+
+    v.assign(2u, v.back());
+    EXPECT_EQ((InlinedVector<std::string, 4>(
+                  2u, std::string(20u, static_cast<char>('a' + size - 1u)))),
+              v);
+  }
+}
+
+TEST(InlinedVectorTest, DestroysElements) {
+  {
+    InlinedVector<Counted, 2> v;
+    for (int i = 0; i < 10; i++)
+      v.emplace_back(i);
+    EXPECT_EQ(10, Counted::count());
+    v.erase(v.begin(), v.begin() + 5);
+    EXPECT_EQ(5, Counted::count());
+    EXPECT_EQ(5, v.front().value());
+
+    InlinedVector<Counted, 2> copy(v);
+    EXPECT_EQ(10, Counted::count());
+  }
+  EXPECT_EQ(0, Counted::count());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,255 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_INTRUSIVE_HASH_TABLE_H_
+#define LIB_FTL_CONTAINERS_INTRUSIVE_HASH_TABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// An open-addressing hash table of caller-owned |T|s, which hold their own keys
+// (|KeyOf()(element)| returns |element|'s key, which mustn't change while it's
+// in the table), e.g.:
+//
+//   struct Entry {
+//     std::string name;
+//     ...
+//   };
+//   struct EntryName {
+//     const std::string& operator()(const Entry& entry) const {
+//       return entry.name;
+//     }
+//   };
+//   IntrusiveHashTable<std::string, Entry, EntryName> entries;
+//
+// The table is a single array of pointers (with linear probing, and no
+// tombstones), so insertion and removal never allocate except to grow it (see
+// |reserve()|), and lookups touch few cache lines. Keys are unique. The table
+// doesn't own its elements. Iteration is in no particular order, and inserting
+// or removing elements invalidates iterators.
+template <typename Key,
+          typename T,
+          typename KeyOf,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class IntrusiveHashTable {
+ public:
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+    using pointer = T*;
+    using reference = T&;
+
+    iterator() : slot_(nullptr), end_(nullptr) {}
+
+    reference operator*() const { return **slot_; }
+    pointer operator->() const { return *slot_; }
+
+    iterator& operator++() {
+      ++slot_;
+      SkipEmpty();
+      return *this;
+    }
+    iterator operator++(int) {
+      iterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    bool operator==(const iterator& other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const iterator& other) const {
+      return slot_ != other.slot_;
+    }
+
+   private:
+    friend class IntrusiveHashTable;
+
+    iterator(T* const* slot, T* const* end) : slot_(slot), end_(end) {
+      SkipEmpty();
+    }
+
+    void SkipEmpty() {
+      while (slot_ != end_ && !*slot_)
+        ++slot_;
+    }
+
+    T* const* slot_;
+    T* const* end_;
+  };
+
+  using const_iterator = iterator;
+
+  explicit IntrusiveHashTable(KeyOf key_of = KeyOf(),
+                              Hash hash = Hash(),
+                              KeyEqual key_equal = KeyEqual())
+      : key_of_(std::move(key_of)),
+        hash_(std::move(hash)),
+        key_equal_(std::move(key_equal)) {}
+
+  bool empty() const { return size_ == 0u; }
+  size_t size() const { return size_; }
+
+  iterator begin() const {
+    return iterator(slots_.data(), slots_.data() + slots_.size());
+  }
+  iterator end() const {
+    return iterator(slots_.data() + slots_.size(),
+                    slots_.data() + slots_.size());
+  }
+
+  // Makes room for |count| elements without growing.
+  void reserve(size_t count) {
+    size_t capacity = kMinCapacity;
+    while (!HasRoom(count, capacity))
+      capacity *= 2u;
+    if (capacity > slots_.size())
+      Rehash(capacity);
+  }
+
+  // Returns the element with the given key, or null if there isn't one. (The
+  // key may be of any type |Hash| and |KeyEqual| accept, e.g., a |StringView|
+  // with |FlatHash| and |FlatEqual|.)
+  template <typename K = Key>
+  T* Find(const K& key) const {
+    if (slots_.empty())
+      return nullptr;
+    for (size_t i = HomeSlot(key);; i = (i + 1u) & mask()) {
+      T* element = slots_[i];
+      if (!element)
+        return nullptr;
+      if (key_equal_(key_of_(*element), key))
+        return element;
+    }
+  }
+
+  // Inserts |element|, unless there's already an element with its key (in
+  // which case this returns false).
+  bool Insert(T* element) {
+    FTL_DCHECK(element);
+    if (!HasRoom(size_ + 1u, slots_.size()))
+      Rehash(slots_.empty() ? kMinCapacity : 2u * slots_.size());
+    const Key& key = key_of_(*element);
+    size_t i = HomeSlot(key);
+    for (; slots_[i]; i = (i + 1u) & mask()) {
+      if (key_equal_(key_of_(*slots_[i]), key))
+        return false;
+    }
+    slots_[i] = element;
+    size_++;
+    return true;
+  }
+
+  // Removes and returns the element with the given key, or returns null if
+  // there isn't one.
+  template <typename K = Key>
+  T* Erase(const K& key) {
+    if (slots_.empty())
+      return nullptr;
+    size_t i = HomeSlot(key);
+    for (; slots_[i]; i = (i + 1u) & mask()) {
+      if (key_equal_(key_of_(*slots_[i]), key))
+        break;
+    }
+    T* element = slots_[i];
+    if (!element)
+      return nullptr;
+    RemoveSlot(i);
+    return element;
+  }
+
+  // Removes all the elements (keeping the capacity).
+  void clear() {
+    std::fill(slots_.begin(), slots_.end(), nullptr);
+    size_ = 0u;
+  }
+
+ private:
+  static constexpr size_t kMinCapacity = 8u;
+
+  // The table is kept at most 3/4 full.
+  static bool HasRoom(size_t count, size_t capacity) {
+    return count <= capacity - capacity / 4u;
+  }
+
+  size_t mask() const { return slots_.size() - 1u; }
+
+  template <typename K>
+  size_t HomeSlot(const K& key) const {
+    // Mix the hash (Fibonacci hashing), since |std::hash| is often the
+    // identity, and take the top bits.
+    uint64_t hash =
+        static_cast<uint64_t>(hash_(key)) * UINT64_C(0x9e3779b97f4a7c15);
+    return static_cast<size_t>(hash >> (64u - capacity_bits_));
+  }
+
+  // Empties slot |i|, shifting back the elements after it that it displaced
+  // (so that lookups needn't skip tombstones).
+  void RemoveSlot(size_t i) {
+    slots_[i] = nullptr;
+    size_--;
+    for (size_t j = (i + 1u) & mask(); slots_[j]; j = (j + 1u) & mask()) {
+      size_t home = HomeSlot(key_of_(*slots_[j]));
+      // Move it to |i| if |i| is at or after its home slot (cyclically).
+      if (((j - home) & mask()) >= ((j - i) & mask())) {
+        slots_[i] = slots_[j];
+        slots_[j] = nullptr;
+        i = j;
+      }
+    }
+  }
+
+  void Rehash(size_t capacity) {
+    FTL_DCHECK(capacity >= kMinCapacity && !(capacity & (capacity - 1u)));
+    std::vector<T*> old_slots(capacity, nullptr);
+    old_slots.swap(slots_);
+    capacity_bits_ = 0u;
+    while ((size_t{1} << capacity_bits_) < capacity)
+      capacity_bits_++;
+    for (T* element : old_slots) {
+      if (!element)
+        continue;
+      size_t i = HomeSlot(key_of_(*element));
+      while (slots_[i])
+        i = (i + 1u) & mask();
+      slots_[i] = element;
+    }
+  }
+
+  KeyOf key_of_;
+  Hash hash_;
+  KeyEqual key_equal_;
+  // The capacity is zero or a power of two, 2^|capacity_bits_|.
+  std::vector<T*> slots_;
+  size_t capacity_bits_ = 0u;
+  size_t size_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IntrusiveHashTable);
+};
+
+template <typename Key,
+          typename T,
+          typename KeyOf,
+          typename Hash,
+          typename KeyEqual>
+constexpr size_t
+    IntrusiveHashTable<Key, T, KeyOf, Hash, KeyEqual>::kMinCapacity;
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_INTRUSIVE_HASH_TABLE_H_
@@ -0,0 +1,99 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/intrusive_hash_table.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+struct Entry {
+  Entry(std::string name, int value) : name(std::move(name)), value(value) {}
+  std::string name;
+  int value;
+};
+
+struct EntryName {
+  const std::string& operator()(const Entry& entry) const {
+    return entry.name;
+  }
+};
+
+using EntryTable = IntrusiveHashTable<std::string, Entry, EntryName>;
+
+TEST(IntrusiveHashTableTest, Basic) {
+  Entry a("a", 1), b("b", 2), other_a("a", 3);
+  EntryTable table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.Find("a"));
+  EXPECT_EQ(nullptr, table.Erase("a"));
+
+  EXPECT_TRUE(table.Insert(&a));
+  EXPECT_TRUE(table.Insert(&b));
+  EXPECT_FALSE(table.Insert(&other_a));
+  EXPECT_EQ(2u, table.size());
+  EXPECT_EQ(&a, table.Find("a"));
+  EXPECT_EQ(&b, table.Find("b"));
+  EXPECT_EQ(nullptr, table.Find("c"));
+
+  std::set<int> values;
+  for (const Entry& entry : table)
+    values.insert(entry.value);
+  EXPECT_EQ((std::set<int>{1, 2}), values);
+
+  EXPECT_EQ(&a, table.Erase("a"));
+  EXPECT_EQ(nullptr, table.Find("a"));
+  EXPECT_TRUE(table.Insert(&other_a));
+  EXPECT_EQ(&other_a, table.Find("a"));
+
+  table.clear();
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(nullptr, table.Find("b"));
+}
+
+struct Number {
+  explicit Number(int key) : key(key) {}
+  int key;
+};
+
+struct NumberKey {
+  int operator()(const Number& number) const { return number.key; }
+};
+
+TEST(IntrusiveHashTableTest, ManyElements) {
+  constexpr int kCount = 10000;
+  std::vector<std::unique_ptr<Number>> numbers;
+  IntrusiveHashTable<int, Number, NumberKey> table;
+  table.reserve(kCount / 2);
+  for (int i = 0; i < kCount; i++) {
+    numbers.emplace_back(new Number(i * 16));
+    EXPECT_TRUE(table.Insert(numbers.back().get()));
+  }
+  EXPECT_EQ(static_cast<size_t>(kCount), table.size());
+
+  // Erasing shifts back the elements in the same probe sequences.
+  for (int i = 0; i < kCount; i += 2)
+    EXPECT_EQ(numbers[i].get(), table.Erase(i * 16));
+  EXPECT_EQ(static_cast<size_t>(kCount / 2), table.size());
+  for (int i = 0; i < kCount; i++) {
+    EXPECT_EQ(i % 2 ? numbers[i].get() : nullptr, table.Find(i * 16));
+  }
+
+  size_t count = 0u;
+  for (const Number& number : table) {
+    EXPECT_EQ(16, number.key % 32);
+    count++;
+  }
+  EXPECT_EQ(table.size(), count);
+}
+
+}  // namespace
+}  // namespace ftl
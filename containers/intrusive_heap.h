@@ -0,0 +1,196 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_INTRUSIVE_HEAP_H_
+#define LIB_FTL_CONTAINERS_INTRUSIVE_HEAP_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+template <typename T, typename Compare, typename Tag>
+class IntrusiveHeap;
+
+// The linkage for an |IntrusiveHeap<T, Compare, Tag>|, which |T| inherits from
+// (publicly): it records the object's position in the heap, so that it can be
+// removed or re-sorted in O(log n) given just a pointer to it. As with
+// |IntrusiveListNode|, an object may be in one heap per |Tag|, copying it
+// doesn't copy its membership, and it must be removed before it's destroyed.
+template <typename Tag = void>
+class IntrusiveHeapNode {
+ public:
+  IntrusiveHeapNode() {}
+  IntrusiveHeapNode(const IntrusiveHeapNode&) {}
+  IntrusiveHeapNode& operator=(const IntrusiveHeapNode&) { return *this; }
+  ~IntrusiveHeapNode() { FTL_DCHECK(!InHeap()); }
+
+  // Returns true if the object is in a heap (for this |Tag|).
+  bool InHeap() const { return heap_index_ != kNotInHeap; }
+
+ private:
+  template <typename T, typename Compare, typename U>
+  friend class IntrusiveHeap;
+
+  static constexpr size_t kNotInHeap = static_cast<size_t>(-1);
+
+  size_t heap_index_ = kNotInHeap;
+};
+
+template <typename Tag>
+constexpr size_t IntrusiveHeapNode<Tag>::kNotInHeap;
+
+// A binary min-heap of caller-owned |T|s: |top()| is the smallest according to
+// |Compare| (unlike |std::priority_queue|, whose top is the largest). The
+// elements are the handles: since each records its own position (in its
+// |IntrusiveHeapNode<Tag>| base), |Remove()| (e.g., to cancel a timer) and
+// |Update()| (after changing an element's key, e.g., to reschedule it) are
+// O(log n), with no searching. The heap doesn't own its elements, and only
+// allocates to grow its array of pointers (see |reserve()|); it must be empty
+// when it's destroyed.
+template <typename T, typename Compare = std::less<T>, typename Tag = void>
+class IntrusiveHeap {
+  using Node = IntrusiveHeapNode<Tag>;
+
+ public:
+  explicit IntrusiveHeap(Compare compare = Compare())
+      : compare_(std::move(compare)) {
+    static_assert(std::is_base_of<Node, T>::value,
+                  "T must inherit from IntrusiveHeapNode<Tag>");
+  }
+
+  ~IntrusiveHeap() { FTL_DCHECK(empty()); }
+
+  bool empty() const { return elements_.empty(); }
+  size_t size() const { return elements_.size(); }
+  void reserve(size_t capacity) { elements_.reserve(capacity); }
+
+  // Returns the first element, which must exist.
+  T* top() const {
+    FTL_DCHECK(!empty());
+    return elements_.front();
+  }
+
+  // Adds |element|, which must not be in a heap (for this |Tag|).
+  void Push(T* element) {
+    FTL_DCHECK(element);
+    FTL_DCHECK(!AsNode(element)->InHeap());
+    elements_.push_back(element);
+    SetIndex(elements_.size() - 1u);
+    SiftUp(elements_.size() - 1u);
+  }
+
+  // Removes and returns the first element, which must exist.
+  T* Pop() {
+    T* element = top();
+    Remove(element);
+    return element;
+  }
+
+  // Removes |element|, which must be in this heap.
+  void Remove(T* element) {
+    size_t index = IndexOf(element);
+    AsNode(element)->heap_index_ = Node::kNotInHeap;
+    T* last = elements_.back();
+    elements_.pop_back();
+    if (index == elements_.size())
+      return;
+    elements_[index] = last;
+    SetIndex(index);
+    Restore(index);
+  }
+
+  // Restores the order after |element|'s key has changed.
+  void Update(T* element) { Restore(IndexOf(element)); }
+
+  // Returns true if |element| is in this heap.
+  bool Contains(const T* element) const {
+    const Node* node = AsNode(element);
+    return node->InHeap() && node->heap_index_ < elements_.size() &&
+           elements_[node->heap_index_] == element;
+  }
+
+  // Removes all the elements (in no particular order).
+  void clear() {
+    for (T* element : elements_)
+      AsNode(element)->heap_index_ = Node::kNotInHeap;
+    elements_.clear();
+  }
+
+ private:
+  static Node* AsNode(T* element) { return static_cast<Node*>(element); }
+  static const Node* AsNode(const T* element) {
+    return static_cast<const Node*>(element);
+  }
+
+  size_t IndexOf(T* element) const {
+    FTL_DCHECK(Contains(element));
+    return AsNode(element)->heap_index_;
+  }
+
+  void SetIndex(size_t index) {
+    AsNode(elements_[index])->heap_index_ = index;
+  }
+
+  bool Before(size_t a, size_t b) const {
+    return compare_(*elements_[a], *elements_[b]);
+  }
+
+  void Swap(size_t a, size_t b) {
+    std::swap(elements_[a], elements_[b]);
+    SetIndex(a);
+    SetIndex(b);
+  }
+
+  // Moves the element at |index| up or down as needed.
+  void Restore(size_t index) {
+    if (index > 0u && Before(index, (index - 1u) / 2u))
+      SiftUp(index);
+    else
+      SiftDown(index);
+  }
+
+  void SiftUp(size_t index) {
+    while (index > 0u) {
+      size_t parent = (index - 1u) / 2u;
+      if (!Before(index, parent))
+        break;
+      Swap(index, parent);
+      index = parent;
+    }
+  }
+
+  void SiftDown(size_t index) {
+    const size_t count = elements_.size();
+    for (;;) {
+      size_t first = index;
+      size_t left = 2u * index + 1u;
+      size_t right = left + 1u;
+      if (left < count && Before(left, first))
+        first = left;
+      if (right < count && Before(right, first))
+        first = right;
+      if (first == index)
+        break;
+      Swap(index, first);
+      index = first;
+    }
+  }
+
+  Compare compare_;
+  std::vector<T*> elements_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IntrusiveHeap);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_INTRUSIVE_HEAP_H_
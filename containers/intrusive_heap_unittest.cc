@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/intrusive_heap.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+struct Timer : public IntrusiveHeapNode<> {
+  explicit Timer(int deadline) : deadline(deadline) {}
+  int deadline;
+};
+
+struct EarlierDeadline {
+  bool operator()(const Timer& a, const Timer& b) const {
+    return a.deadline < b.deadline;
+  }
+};
+
+using TimerHeap = IntrusiveHeap<Timer, EarlierDeadline>;
+
+TEST(IntrusiveHeapTest, PushAndPop) {
+  Timer a(3), b(1), c(2);
+  TimerHeap heap;
+  EXPECT_TRUE(heap.empty());
+  heap.Push(&a);
+  heap.Push(&b);
+  heap.Push(&c);
+  EXPECT_EQ(3u, heap.size());
+  EXPECT_TRUE(heap.Contains(&a));
+  EXPECT_TRUE(a.InHeap());
+
+  EXPECT_EQ(&b, heap.top());
+  EXPECT_EQ(&b, heap.Pop());
+  EXPECT_FALSE(b.InHeap());
+  EXPECT_FALSE(heap.Contains(&b));
+  EXPECT_EQ(&c, heap.Pop());
+  EXPECT_EQ(&a, heap.Pop());
+  EXPECT_TRUE(heap.empty());
+}
+
+TEST(IntrusiveHeapTest, RemoveAndUpdate) {
+  Timer a(1), b(2), c(3), d(4);
+  TimerHeap heap;
+  heap.Push(&a);
+  heap.Push(&b);
+  heap.Push(&c);
+  heap.Push(&d);
+
+  // Cancel.
+  heap.Remove(&b);
+  EXPECT_FALSE(b.InHeap());
+  EXPECT_EQ(3u, heap.size());
+
+  // Decrease a key.
+  d.deadline = 0;
+  heap.Update(&d);
+  EXPECT_EQ(&d, heap.top());
+
+  // Increase a key.
+  d.deadline = 10;
+  heap.Update(&d);
+  EXPECT_EQ(&a, heap.Pop());
+  EXPECT_EQ(&c, heap.Pop());
+  EXPECT_EQ(&d, heap.Pop());
+
+  heap.Push(&a);
+  heap.Push(&b);
+  heap.clear();
+  EXPECT_TRUE(heap.empty());
+  EXPECT_FALSE(a.InHeap());
+  EXPECT_FALSE(b.InHeap());
+}
+
+TEST(IntrusiveHeapTest, Random) {
+  srand(42);
+  std::vector<std::unique_ptr<Timer>> timers;
+  TimerHeap heap;
+  for (int i = 0; i < 1000; i++) {
+    timers.emplace_back(new Timer(rand() % 500));
+    heap.Push(timers.back().get());
+  }
+  // Cancel and reschedule some.
+  for (size_t i = 0u; i < timers.size(); i += 3u)
+    heap.Remove(timers[i].get());
+  for (size_t i = 1u; i < timers.size(); i += 3u) {
+    timers[i]->deadline = rand() % 500;
+    heap.Update(timers[i].get());
+  }
+
+  std::vector<int> expected;
+  for (const auto& timer : timers) {
+    if (timer->InHeap())
+      expected.push_back(timer->deadline);
+  }
+  std::sort(expected.begin(), expected.end());
+  std::vector<int> actual;
+  while (!heap.empty())
+    actual.push_back(heap.Pop()->deadline);
+  EXPECT_EQ(expected, actual);
+}
+
+}  // namespace
+}  // namespace ftl
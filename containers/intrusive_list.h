@@ -0,0 +1,233 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_INTRUSIVE_LIST_H_
+#define LIB_FTL_CONTAINERS_INTRUSIVE_LIST_H_
+
+#include <stddef.h>
+
+#include <iterator>
+#include <type_traits>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+template <typename T, typename Tag>
+class IntrusiveList;
+
+// The linkage for an |IntrusiveList<T, Tag>|, which |T| inherits from
+// (publicly). An object may be in one list per |Tag| at a time, e.g.:
+//
+//   struct LruTag {};
+//   struct PendingTag {};
+//   class Entry : public IntrusiveListNode<LruTag>,
+//                 public IntrusiveListNode<PendingTag> { ... };
+//
+// Copying an object doesn't copy its membership. An object must be removed
+// from its lists before it's destroyed.
+template <typename Tag = void>
+class IntrusiveListNode {
+ public:
+  IntrusiveListNode() {}
+  IntrusiveListNode(const IntrusiveListNode&) {}
+  IntrusiveListNode& operator=(const IntrusiveListNode&) { return *this; }
+  ~IntrusiveListNode() { FTL_DCHECK(!InList()); }
+
+  // Returns true if the object is in a list (for this |Tag|).
+  bool InList() const { return !!next_; }
+
+ private:
+  template <typename T, typename U>
+  friend class IntrusiveList;
+
+  IntrusiveListNode* prev_ = nullptr;
+  IntrusiveListNode* next_ = nullptr;
+};
+
+// A doubly-linked list of caller-owned |T|s, linked through their
+// |IntrusiveListNode<Tag>| bases, so that insertion and removal (of any
+// element, given a pointer to it) are O(1) and never allocate. The list doesn't
+// own its elements; it must be empty when it's destroyed.
+//
+// E.g., for an LRU cache, |MoveToFront()| an entry on each use, and evict from
+// the |back()|.
+template <typename T, typename Tag = void>
+class IntrusiveList {
+  using Node = IntrusiveListNode<Tag>;
+
+ public:
+  template <typename Value>
+  class IteratorImpl {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    IteratorImpl() : node_(nullptr) {}
+    // (For converting an |iterator| to a |const_iterator|. As a template, this
+    // isn't a copy constructor, so the implicit ones are still declared.)
+    template <typename OtherValue,
+              typename = typename std::enable_if<
+                  std::is_convertible<OtherValue*, Value*>::value>::type>
+    IteratorImpl(const IteratorImpl<OtherValue>& other)
+        : node_(other.node()) {}
+
+    reference operator*() const { return *operator->(); }
+    pointer operator->() const { return static_cast<pointer>(node_); }
+
+    IteratorImpl& operator++() {
+      node_ = node_->next_;
+      return *this;
+    }
+    IteratorImpl operator++(int) {
+      IteratorImpl result = *this;
+      ++*this;
+      return result;
+    }
+    IteratorImpl& operator--() {
+      node_ = node_->prev_;
+      return *this;
+    }
+    IteratorImpl operator--(int) {
+      IteratorImpl result = *this;
+      --*this;
+      return result;
+    }
+
+    bool operator==(const IteratorImpl& other) const {
+      return node_ == other.node_;
+    }
+    bool operator!=(const IteratorImpl& other) const {
+      return node_ != other.node_;
+    }
+
+    Node* node() const { return node_; }
+
+   private:
+    friend class IntrusiveList;
+
+    explicit IteratorImpl(Node* node) : node_(node) {}
+
+    Node* node_;
+  };
+
+  using iterator = IteratorImpl<T>;
+  using const_iterator = IteratorImpl<const T>;
+
+  IntrusiveList() {
+    static_assert(std::is_base_of<Node, T>::value,
+                  "T must inherit from IntrusiveListNode<Tag>");
+    head_.prev_ = &head_;
+    head_.next_ = &head_;
+  }
+
+  ~IntrusiveList() {
+    FTL_DCHECK(empty());
+    // (So that |head_|'s destructor doesn't complain.)
+    head_.prev_ = nullptr;
+    head_.next_ = nullptr;
+  }
+
+  bool empty() const { return head_.next_ == &head_; }
+  size_t size() const { return size_; }
+
+  T* front() const {
+    FTL_DCHECK(!empty());
+    return static_cast<T*>(head_.next_);
+  }
+  T* back() const {
+    FTL_DCHECK(!empty());
+    return static_cast<T*>(head_.prev_);
+  }
+
+  iterator begin() { return iterator(head_.next_); }
+  iterator end() { return iterator(&head_); }
+  const_iterator begin() const { return const_iterator(head_.next_); }
+  const_iterator end() const {
+    return const_iterator(const_cast<Node*>(&head_));
+  }
+
+  // Returns an iterator to |element|, which must be in this list.
+  iterator IteratorTo(T* element) { return iterator(AsNode(element)); }
+
+  void push_front(T* element) { InsertBefore(head_.next_, AsNode(element)); }
+  void push_back(T* element) { InsertBefore(&head_, AsNode(element)); }
+
+  // Inserts |element| before |position|, and returns an iterator to it.
+  iterator insert(const_iterator position, T* element) {
+    InsertBefore(position.node(), AsNode(element));
+    return iterator(AsNode(element));
+  }
+
+  T* pop_front() {
+    T* element = front();
+    erase(element);
+    return element;
+  }
+  T* pop_back() {
+    T* element = back();
+    erase(element);
+    return element;
+  }
+
+  // Removes |element|, which must be in this list.
+  void erase(T* element) {
+    Node* node = AsNode(element);
+    FTL_DCHECK(node->InList());
+    FTL_DCHECK(size_ > 0u);
+    node->prev_->next_ = node->next_;
+    node->next_->prev_ = node->prev_;
+    node->prev_ = nullptr;
+    node->next_ = nullptr;
+    size_--;
+  }
+
+  // Removes the element at |position|, and returns an iterator to the next one.
+  iterator erase(iterator position) {
+    iterator next = std::next(position);
+    erase(&*position);
+    return next;
+  }
+
+  // Moves |element|, which must be in this list, to the front.
+  void MoveToFront(T* element) {
+    erase(element);
+    push_front(element);
+  }
+
+  // Removes all the elements.
+  void clear() {
+    while (!empty())
+      pop_front();
+  }
+
+ private:
+  static Node* AsNode(T* element) {
+    FTL_DCHECK(element);
+    return static_cast<Node*>(element);
+  }
+
+  void InsertBefore(Node* position, Node* node) {
+    FTL_DCHECK(!node->InList());
+    node->prev_ = position->prev_;
+    node->next_ = position;
+    position->prev_->next_ = node;
+    position->prev_ = node;
+    size_++;
+  }
+
+  // The sentinel, whose |next_| and |prev_| are the first and last elements.
+  Node head_;
+  size_t size_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IntrusiveList);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_INTRUSIVE_LIST_H_
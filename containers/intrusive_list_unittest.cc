@@ -0,0 +1,116 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/intrusive_list.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+struct LruTag {};
+
+struct Item : public IntrusiveListNode<>, public IntrusiveListNode<LruTag> {
+  explicit Item(int value) : value(value) {}
+  int value;
+};
+
+std::vector<int> Values(const IntrusiveList<Item>& list) {
+  std::vector<int> values;
+  for (const Item& item : list)
+    values.push_back(item.value);
+  return values;
+}
+
+TEST(IntrusiveListTest, PushAndPop) {
+  Item a(1), b(2), c(3);
+  IntrusiveList<Item> list;
+  EXPECT_TRUE(list.empty());
+  EXPECT_EQ(0u, list.size());
+
+  list.push_back(&b);
+  list.push_front(&a);
+  list.push_back(&c);
+  EXPECT_FALSE(list.empty());
+  EXPECT_EQ(3u, list.size());
+  EXPECT_EQ(&a, list.front());
+  EXPECT_EQ(&c, list.back());
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), Values(list));
+  EXPECT_TRUE(b.IntrusiveListNode<>::InList());
+
+  EXPECT_EQ(&a, list.pop_front());
+  EXPECT_FALSE(a.IntrusiveListNode<>::InList());
+  EXPECT_EQ(&c, list.pop_back());
+  EXPECT_EQ((std::vector<int>{2}), Values(list));
+  list.clear();
+  EXPECT_TRUE(list.empty());
+  EXPECT_FALSE(b.IntrusiveListNode<>::InList());
+}
+
+TEST(IntrusiveListTest, EraseAndInsert) {
+  Item a(1), b(2), c(3), d(4);
+  IntrusiveList<Item> list;
+  list.push_back(&a);
+  list.push_back(&b);
+  list.push_back(&c);
+
+  list.erase(&b);
+  EXPECT_EQ((std::vector<int>{1, 3}), Values(list));
+  list.insert(list.IteratorTo(&c), &b);
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), Values(list));
+  list.insert(list.end(), &d);
+  EXPECT_EQ((std::vector<int>{1, 2, 3, 4}), Values(list));
+
+  // Erase the odd ones while iterating.
+  for (auto it = list.begin(); it != list.end();) {
+    if (it->value % 2)
+      it = list.erase(it);
+    else
+      ++it;
+  }
+  EXPECT_EQ((std::vector<int>{2, 4}), Values(list));
+  EXPECT_EQ(4, (--list.end())->value);
+  list.clear();
+}
+
+TEST(IntrusiveListTest, MultipleLists) {
+  Item a(1), b(2), c(3);
+  IntrusiveList<Item> list;
+  IntrusiveList<Item, LruTag> lru;
+  list.push_back(&a);
+  list.push_back(&b);
+  list.push_back(&c);
+  lru.push_back(&c);
+  lru.push_back(&a);
+
+  // Using |a| moves it to the front of the LRU list only.
+  lru.MoveToFront(&a);
+  EXPECT_EQ(&a, lru.front());
+  EXPECT_EQ(&c, lru.back());
+  EXPECT_EQ((std::vector<int>{1, 2, 3}), Values(list));
+  EXPECT_FALSE(b.IntrusiveListNode<LruTag>::InList());
+
+  // Evict the least recently used.
+  Item* evicted = lru.pop_back();
+  EXPECT_EQ(&c, evicted);
+  list.erase(evicted);
+  EXPECT_EQ((std::vector<int>{1, 2}), Values(list));
+  lru.clear();
+  list.clear();
+}
+
+TEST(IntrusiveListTest, CopyDoesNotCopyMembership) {
+  Item a(1);
+  IntrusiveList<Item> list;
+  list.push_back(&a);
+  Item copy = a;
+  EXPECT_EQ(1, copy.value);
+  EXPECT_FALSE(copy.IntrusiveListNode<>::InList());
+  list.clear();
+}
+
+}  // namespace
+}  // namespace ftl
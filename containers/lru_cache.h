@@ -0,0 +1,184 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_CONTAINERS_LRU_CACHE_H_
+#define LIB_FTL_CONTAINERS_LRU_CACHE_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <utility>
+
+#include "lib/ftl/containers/flat_hash_table.h"
+#include "lib/ftl/containers/intrusive_hash_table.h"
+#include "lib/ftl/containers/intrusive_list.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// A cache of |Value|s by |Key|, within a budget of |max_bytes()|, which evicts
+// the least recently used entries to make room, e.g.:
+//
+//   LruCache<std::string, Image> images(64u * 1024u * 1024u);
+//   images.set_on_evict([](const std::string& path, Image image) { ... });
+//   ...
+//   Image* image = images.Get(path);
+//   if (!image) {
+//     Image loaded = Load(path);
+//     size_t bytes = loaded.bytes();
+//     image = images.Put(path, std::move(loaded), bytes);
+//   }
+//
+// Each entry's size is whatever the caller says it is (by default 1, so that
+// the budget is a number of entries). Entries are found with an (open
+// addressing) |IntrusiveHashTable|, and kept in use order in an
+// |IntrusiveList|, so each entry is a single allocation.
+//
+// Lookups take a |Key| or, with the default |Hash| and |KeyEqual|, anything
+// those accept (e.g., a |StringView| for a |std::string| key).
+//
+// This isn't thread-safe. (See |ClockCache| for a cache whose lookups don't
+// modify it.)
+template <typename Key,
+          typename Value,
+          typename Hash = FlatHash<Key>,
+          typename KeyEqual = FlatEqual<Key>>
+class LruCache final {
+ public:
+  // Called with each entry which is evicted to make room (but not ones which
+  // are removed, replaced or cleared). It mustn't modify the cache.
+  using EvictionCallback = std::function<void(const Key& key, Value value)>;
+
+  explicit LruCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+  ~LruCache() { Clear(); }
+
+  void set_on_evict(EvictionCallback on_evict) {
+    on_evict_ = std::move(on_evict);
+  }
+
+  // Returns the value for |key| (marking it as the most recently used), or null
+  // if there isn't one. The value stays valid until it's evicted or removed.
+  template <typename K>
+  Value* Get(const K& key) {
+    Entry* entry = entries_.Find(key);
+    if (!entry)
+      return nullptr;
+    lru_.MoveToFront(entry);
+    return &entry->value;
+  }
+
+  // Like |Get()|, but doesn't mark the value as used.
+  template <typename K>
+  Value* Peek(const K& key) const {
+    Entry* entry = entries_.Find(key);
+    return entry ? &entry->value : nullptr;
+  }
+
+  template <typename K>
+  bool Contains(const K& key) const {
+    return !!entries_.Find(key);
+  }
+
+  // Sets the value for |key| (replacing any previous one), which takes |bytes|
+  // of the budget, evicting the least recently used entries to make room.
+  // Returns the value, or null if it's bigger than the whole budget (in which
+  // case it isn't cached, and any previous value is removed).
+  Value* Put(Key key, Value value, size_t bytes = 1u) {
+    if (Entry* old_entry = entries_.Find(key))
+      Erase(old_entry);
+    if (bytes > max_bytes_)
+      return nullptr;
+    EvictToFit(max_bytes_ - bytes);
+    Entry* entry = new Entry(std::move(key), std::move(value), bytes);
+    entries_.Insert(entry);
+    lru_.push_front(entry);
+    bytes_ += bytes;
+    return &entry->value;
+  }
+
+  // Removes the value for |key|, returning true if there was one.
+  template <typename K>
+  bool Remove(const K& key) {
+    Entry* entry = entries_.Find(key);
+    if (!entry)
+      return false;
+    Erase(entry);
+    return true;
+  }
+
+  // Removes all the entries.
+  void Clear() {
+    while (!lru_.empty())
+      Erase(lru_.back());
+  }
+
+  // Changes the budget, evicting entries if it shrinks.
+  void set_max_bytes(size_t max_bytes) {
+    max_bytes_ = max_bytes;
+    EvictToFit(max_bytes_);
+  }
+  size_t max_bytes() const { return max_bytes_; }
+
+  // The number of entries, and their total size.
+  size_t size() const { return lru_.size(); }
+  size_t bytes() const { return bytes_; }
+  bool empty() const { return lru_.empty(); }
+
+  // Calls |function(key, value)| for each entry, from the most recently used.
+  // It mustn't modify the cache.
+  template <typename Function>
+  void ForEach(Function function) const {
+    for (const Entry& entry : lru_)
+      function(entry.key, entry.value);
+  }
+
+ private:
+  struct Entry : public IntrusiveListNode<> {
+    Entry(Key key, Value value, size_t bytes)
+        : key(std::move(key)), value(std::move(value)), bytes(bytes) {}
+
+    const Key key;
+    Value value;
+    const size_t bytes;
+  };
+  struct EntryKey {
+    const Key& operator()(const Entry& entry) const { return entry.key; }
+  };
+
+  void EvictToFit(size_t max_bytes) {
+    while (bytes_ > max_bytes) {
+      Entry* entry = lru_.back();
+      Unlink(entry);
+      if (on_evict_)
+        on_evict_(entry->key, std::move(entry->value));
+      delete entry;
+    }
+  }
+
+  void Erase(Entry* entry) {
+    Unlink(entry);
+    delete entry;
+  }
+
+  void Unlink(Entry* entry) {
+    entries_.Erase(entry->key);
+    lru_.erase(entry);
+    FTL_DCHECK(bytes_ >= entry->bytes);
+    bytes_ -= entry->bytes;
+  }
+
+  size_t max_bytes_;
+  size_t bytes_ = 0u;
+  EvictionCallback on_evict_;
+  IntrusiveHashTable<Key, Entry, EntryKey, Hash, KeyEqual> entries_;
+  // Most recently used first.
+  IntrusiveList<Entry> lru_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LruCache);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_CONTAINERS_LRU_CACHE_H_
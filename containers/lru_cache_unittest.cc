@@ -0,0 +1,77 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/containers/lru_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace {
+
+std::vector<std::string> Keys(const LruCache<std::string, int>& cache) {
+  std::vector<std::string> keys;
+  cache.ForEach(
+      [&keys](const std::string& key, int value) { keys.push_back(key); });
+  return keys;
+}
+
+TEST(LruCacheTest, EvictsLeastRecentlyUsed) {
+  LruCache<std::string, int> cache(3u);
+  std::vector<std::pair<std::string, int>> evicted;
+  cache.set_on_evict([&evicted](const std::string& key, int value) {
+    evicted.emplace_back(key, value);
+  });
+
+  EXPECT_EQ(1, *cache.Put("a", 1));
+  cache.Put("b", 2);
+  cache.Put("c", 3);
+  EXPECT_EQ((std::vector<std::string>{"c", "b", "a"}), Keys(cache));
+
+  // Using "a" makes "b" the least recently used (but peeking doesn't).
+  EXPECT_EQ(1, *cache.Get(StringView("a")));
+  EXPECT_EQ(2, *cache.Peek("b"));
+  cache.Put("d", 4);
+  EXPECT_EQ((std::vector<std::pair<std::string, int>>{{"b", 2}}), evicted);
+  EXPECT_EQ((std::vector<std::string>{"d", "a", "c"}), Keys(cache));
+  EXPECT_FALSE(cache.Get("b"));
+
+  // Replacing, removing and clearing don't count as evictions.
+  cache.Put("c", 30);
+  EXPECT_EQ(30, *cache.Get("c"));
+  EXPECT_TRUE(cache.Remove("d"));
+  EXPECT_FALSE(cache.Remove("d"));
+  EXPECT_EQ(2u, cache.size());
+  cache.Clear();
+  EXPECT_TRUE(cache.empty());
+  EXPECT_EQ(1u, evicted.size());
+}
+
+TEST(LruCacheTest, Bytes) {
+  LruCache<int, std::unique_ptr<int>> cache(100u);
+  EXPECT_TRUE(cache.Put(1, std::unique_ptr<int>(new int(1)), 40u));
+  EXPECT_TRUE(cache.Put(2, std::unique_ptr<int>(new int(2)), 40u));
+  EXPECT_EQ(80u, cache.bytes());
+
+  // Too big to cache.
+  EXPECT_FALSE(cache.Put(3, std::unique_ptr<int>(new int(3)), 101u));
+  EXPECT_EQ(2u, cache.size());
+
+  EXPECT_TRUE(cache.Put(4, std::unique_ptr<int>(new int(4)), 30u));
+  EXPECT_FALSE(cache.Contains(1));
+  EXPECT_EQ(70u, cache.bytes());
+
+  cache.set_max_bytes(30u);
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(4, **cache.Get(4));
+  EXPECT_EQ(30u, cache.bytes());
+}
+
+}  // namespace
+}  // namespace ftl
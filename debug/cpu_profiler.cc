@@ -0,0 +1,487 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/cpu_profiler.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/debug/stack_trace.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/spsc_ring.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+
+#if defined(OS_LINUX) && (defined(ARCH_CPU_X86_64) || defined(ARCH_CPU_ARM64))
+#define FTL_HAS_CPU_PROFILER 1
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// (Older C libraries don't name this field.)
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+namespace ftl {
+namespace {
+
+#if defined(FTL_HAS_CPU_PROFILER)
+
+// How often the background thread collects the samples from the rings.
+constexpr TimeDelta kCollectionInterval = TimeDelta::FromMilliseconds(50);
+
+// Each sample is its number of frames, followed by the frames. (This holds
+// about 250 samples of 64 frames, i.e., 2.5 seconds of them at 100 Hz.)
+using SampleRing = SpscRing<uintptr_t, 16384u>;
+
+// A registered thread (or one which was: these are reused, and never freed, so
+// that the signal handler never sees one go away).
+struct ThreadRecord {
+  pid_t thread_id = 0;
+  pthread_t thread;
+  std::string name;
+  bool registered = false;
+  // The thread's |SIGPROF| timer, if it has one (while the profiler runs).
+  bool has_timer = false;
+  timer_t timer;
+  // The thread's samples, which its signal handler pushes, and which are
+  // popped with the profiler's mutex held. Allocated the first time the
+  // profiler runs, and kept after.
+  std::atomic<SampleRing*> ring{nullptr};
+};
+
+// The calling thread's record, if it's registered (for the signal handler).
+thread_local std::atomic<ThreadRecord*> g_current_thread_record{nullptr};
+
+std::atomic<bool> g_running{false};
+std::atomic<uint64_t> g_dropped_samples{0u};
+
+// The |SIGPROF| handler from before the profiler's, to which other |SIGPROF|s
+// (e.g., from |setitimer()|) are passed on.
+struct sigaction g_previous_action;
+
+void GetInterruptedRegisters(void* context,
+                             const void** pc,
+                             const void** frame_pointer) {
+  const mcontext_t& registers = static_cast<ucontext_t*>(context)->uc_mcontext;
+#if defined(ARCH_CPU_X86_64)
+  *pc = reinterpret_cast<const void*>(registers.gregs[REG_RIP]);
+  *frame_pointer = reinterpret_cast<const void*>(registers.gregs[REG_RBP]);
+#else
+  *pc = reinterpret_cast<const void*>(registers.pc);
+  *frame_pointer = reinterpret_cast<const void*>(registers.regs[29]);
+#endif
+}
+
+void HandleProfilingSignal(int signal, siginfo_t* info, void* context) {
+  if (info->si_code != SI_TIMER) {
+    if (g_previous_action.sa_flags & SA_SIGINFO)
+      g_previous_action.sa_sigaction(signal, info, context);
+    else if (g_previous_action.sa_handler != SIG_DFL &&
+             g_previous_action.sa_handler != SIG_IGN)
+      g_previous_action.sa_handler(signal);
+    return;
+  }
+
+  const int saved_errno = errno;
+  ThreadRecord* record =
+      g_current_thread_record.load(std::memory_order_relaxed);
+  SampleRing* ring =
+      record ? record->ring.load(std::memory_order_acquire) : nullptr;
+  if (ring && g_running.load(std::memory_order_relaxed)) {
+    const void* pc;
+    const void* frame_pointer;
+    GetInterruptedRegisters(context, &pc, &frame_pointer);
+    const void* frames[kMaxCpuProfileStackFrames];
+    const size_t count = CaptureInterruptedStackTrace(
+        pc, frame_pointer, frames, kMaxCpuProfileStackFrames);
+    uintptr_t sample[1u + kMaxCpuProfileStackFrames];
+    sample[0] = count;
+    for (size_t i = 0u; i < count; i++)
+      sample[1u + i] = reinterpret_cast<uintptr_t>(frames[i]);
+    if (count && !ring->TryPushAll(sample, 1u + count))
+      g_dropped_samples.fetch_add(1u, std::memory_order_relaxed);
+  }
+  errno = saved_errno;
+}
+
+class CpuProfiler final {
+ public:
+  static CpuProfiler* Get() {
+    static CpuProfiler* profiler = new CpuProfiler();
+    return profiler;
+  }
+
+  ThreadRecord* AddThread() {
+    char name[17] = {};
+    prctl(PR_GET_NAME, name, 0, 0, 0);
+
+    MutexLocker locker(&mutex_);
+    ThreadRecord* record = nullptr;
+    for (const auto& free_record : threads_) {
+      if (!free_record->registered) {
+        record = free_record.get();
+        break;
+      }
+    }
+    if (!record) {
+      threads_.emplace_back(new ThreadRecord());
+      record = threads_.back().get();
+    }
+    record->thread_id = static_cast<pid_t>(syscall(SYS_gettid));
+    record->thread = pthread_self();
+    record->name = name;
+    record->registered = true;
+    if (running_)
+      StartSampling(record);
+    return record;
+  }
+
+  void RemoveThread(ThreadRecord* record) {
+    MutexLocker locker(&mutex_);
+    StopSampling(record);
+    Collect(record);
+    record->registered = false;
+  }
+
+  bool Start(const CpuProfilerOptions& options) {
+    FTL_DCHECK(options.interval > TimeDelta());
+    MutexLocker locker(&mutex_);
+    if (running_)
+      return false;
+    if (!installed_handler_) {
+      struct sigaction action = {};
+      action.sa_sigaction = &HandleProfilingSignal;
+      action.sa_flags = SA_SIGINFO | SA_RESTART;
+      sigemptyset(&action.sa_mask);
+      if (sigaction(SIGPROF, &action, &g_previous_action)) {
+        FTL_LOG(ERROR) << "Failed to install the CPU profiler's handler";
+        return false;
+      }
+      installed_handler_ = true;
+    }
+
+    samples_.clear();
+    g_dropped_samples.store(0u, std::memory_order_relaxed);
+    interval_ = options.interval;
+    running_ = true;
+    g_running.store(true, std::memory_order_relaxed);
+    for (const auto& record : threads_) {
+      if (record->registered)
+        StartSampling(record.get());
+    }
+
+    stop_collecting_.reset(new ManualResetWaitableEvent());
+    ManualResetWaitableEvent* stop_collecting = stop_collecting_.get();
+    collector_ = std::thread([this, stop_collecting] {
+      while (stop_collecting->WaitWithTimeout(kCollectionInterval)) {
+        MutexLocker locker(&mutex_);
+        CollectAll();
+      }
+    });
+    return true;
+  }
+
+  void Stop() {
+    std::thread collector;
+    std::unique_ptr<ManualResetWaitableEvent> stop_collecting;
+    {
+      MutexLocker locker(&mutex_);
+      if (!running_)
+        return;
+      running_ = false;
+      g_running.store(false, std::memory_order_relaxed);
+      for (const auto& record : threads_)
+        StopSampling(record.get());
+      CollectAll();
+      collector = std::move(collector_);
+      stop_collecting = std::move(stop_collecting_);
+    }
+    stop_collecting->Signal();
+    collector.join();
+  }
+
+  bool IsRunning() {
+    MutexLocker locker(&mutex_);
+    return running_;
+  }
+
+  TimeDelta interval() {
+    MutexLocker locker(&mutex_);
+    return interval_;
+  }
+
+  std::vector<CpuProfileEntry> GetProfile() {
+    std::vector<CpuProfileEntry> entries;
+    {
+      MutexLocker locker(&mutex_);
+      CollectAll();
+      entries.reserve(samples_.size());
+      for (const auto& sample : samples_) {
+        CpuProfileEntry entry;
+        entry.thread_id = sample.first.first;
+        entry.thread_name = thread_names_[entry.thread_id];
+        entry.stack = sample.first.second;
+        entry.samples = sample.second;
+        entries.push_back(std::move(entry));
+      }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const CpuProfileEntry& a, const CpuProfileEntry& b) {
+                       return a.samples > b.samples;
+                     });
+    return entries;
+  }
+
+ private:
+  // The samples of each stack, by thread ID.
+  using SampleMap =
+      std::map<std::pair<uint64_t, std::vector<const void*>>, uint64_t>;
+
+  CpuProfiler() = default;
+
+  void StartSampling(ThreadRecord* record)
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    if (!record->ring.load(std::memory_order_relaxed))
+      record->ring.store(new SampleRing(), std::memory_order_release);
+    thread_names_[record->thread_id] = record->name;
+
+    clockid_t clock;
+    if (pthread_getcpuclockid(record->thread, &clock)) {
+      FTL_LOG(ERROR) << "Failed to get thread " << record->thread_id
+                     << "'s CPU clock";
+      return;
+    }
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGPROF;
+    event.sigev_notify_thread_id = record->thread_id;
+    if (timer_create(clock, &event, &record->timer)) {
+      FTL_LOG(ERROR) << "Failed to create a profiling timer for thread "
+                     << record->thread_id;
+      return;
+    }
+    record->has_timer = true;
+    struct itimerspec spec = {};
+    spec.it_interval = interval_.ToTimespec();
+    spec.it_value = spec.it_interval;
+    timer_settime(record->timer, 0, &spec, nullptr);
+  }
+
+  void StopSampling(ThreadRecord* record) FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    if (!record->has_timer)
+      return;
+    timer_delete(record->timer);
+    record->has_timer = false;
+  }
+
+  // Moves the samples in |record|'s ring to |samples_|.
+  void Collect(ThreadRecord* record) FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    SampleRing* ring = record->ring.load(std::memory_order_relaxed);
+    if (!ring)
+      return;
+    uintptr_t count;
+    while (ring->TryPop(&count)) {
+      // (Each sample was pushed all at once, so its frames are all there.)
+      uintptr_t frames[kMaxCpuProfileStackFrames];
+      ring->PopBatch(frames, count);
+      std::vector<const void*> stack(count);
+      for (size_t i = 0u; i < count; i++)
+        stack[i] = reinterpret_cast<const void*>(frames[i]);
+      samples_[std::make_pair(static_cast<uint64_t>(record->thread_id),
+                              std::move(stack))]++;
+    }
+  }
+
+  void CollectAll() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    for (const auto& record : threads_)
+      Collect(record.get());
+  }
+
+  Mutex mutex_;
+  std::vector<std::unique_ptr<ThreadRecord>> threads_ FTL_GUARDED_BY(mutex_);
+  bool installed_handler_ FTL_GUARDED_BY(mutex_) = false;
+  bool running_ FTL_GUARDED_BY(mutex_) = false;
+  TimeDelta interval_ FTL_GUARDED_BY(mutex_);
+  SampleMap samples_ FTL_GUARDED_BY(mutex_);
+  // The names of the threads in |samples_|, by ID.
+  std::map<uint64_t, std::string> thread_names_ FTL_GUARDED_BY(mutex_);
+  std::thread collector_ FTL_GUARDED_BY(mutex_);
+  std::unique_ptr<ManualResetWaitableEvent> stop_collecting_
+      FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CpuProfiler);
+};
+
+// Registers a thread for as long as it exists.
+class ThreadRegistration final {
+ public:
+  ThreadRegistration() {
+    // Look up the stack's bounds now, so that the signal handler doesn't have
+    // to.
+    const void* frame;
+    CaptureStackTraceFromFramePointers(&frame, 1u);
+    record_ = CpuProfiler::Get()->AddThread();
+    g_current_thread_record.store(record_, std::memory_order_relaxed);
+  }
+
+  ~ThreadRegistration() {
+    g_current_thread_record.store(nullptr, std::memory_order_relaxed);
+    CpuProfiler::Get()->RemoveThread(record_);
+  }
+
+ private:
+  ThreadRecord* record_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadRegistration);
+};
+
+#endif  // defined(FTL_HAS_CPU_PROFILER)
+
+void AppendWord(uintptr_t word, std::string* output) {
+  output->append(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+}  // namespace
+
+bool IsCpuProfilerSupported() {
+#if defined(FTL_HAS_CPU_PROFILER)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void RegisterThreadForCpuProfiling() {
+#if defined(FTL_HAS_CPU_PROFILER)
+  thread_local ThreadRegistration registration;
+#endif
+}
+
+bool StartCpuProfiler(const CpuProfilerOptions& options) {
+#if defined(FTL_HAS_CPU_PROFILER)
+  return CpuProfiler::Get()->Start(options);
+#else
+  return false;
+#endif
+}
+
+void StopCpuProfiler() {
+#if defined(FTL_HAS_CPU_PROFILER)
+  CpuProfiler::Get()->Stop();
+#endif
+}
+
+bool IsCpuProfilerRunning() {
+#if defined(FTL_HAS_CPU_PROFILER)
+  return CpuProfiler::Get()->IsRunning();
+#else
+  return false;
+#endif
+}
+
+std::vector<CpuProfileEntry> GetCpuProfile() {
+#if defined(FTL_HAS_CPU_PROFILER)
+  return CpuProfiler::Get()->GetProfile();
+#else
+  return std::vector<CpuProfileEntry>();
+#endif
+}
+
+uint64_t GetDroppedCpuProfileSampleCount() {
+#if defined(FTL_HAS_CPU_PROFILER)
+  return g_dropped_samples.load(std::memory_order_relaxed);
+#else
+  return 0u;
+#endif
+}
+
+std::string EncodeCpuProfileForPprof(
+    const std::vector<CpuProfileEntry>& entries,
+    TimeDelta interval) {
+  // The header: no count, 3 more header words, version 0, the sampling period
+  // in microseconds, and padding.
+  std::string output;
+  AppendWord(0u, &output);
+  AppendWord(3u, &output);
+  AppendWord(0u, &output);
+  AppendWord(static_cast<uintptr_t>(interval.ToMicroseconds()), &output);
+  AppendWord(0u, &output);
+  // Each stack: its samples, its depth, and its frames.
+  for (const CpuProfileEntry& entry : entries) {
+    AppendWord(static_cast<uintptr_t>(entry.samples), &output);
+    AppendWord(entry.stack.size(), &output);
+    for (const void* frame : entry.stack)
+      AppendWord(reinterpret_cast<uintptr_t>(frame), &output);
+  }
+  // The trailer (a stack of one frame, 0, with no samples).
+  AppendWord(0u, &output);
+  AppendWord(1u, &output);
+  AppendWord(0u, &output);
+  std::string maps;
+  if (files::ReadFileToString("/proc/self/maps", &maps))
+    output += maps;
+  return output;
+}
+
+std::string DumpCpuProfile(size_t max_stacks) {
+  const std::vector<CpuProfileEntry> entries = GetCpuProfile();
+#if defined(FTL_HAS_CPU_PROFILER)
+  const TimeDelta interval = CpuProfiler::Get()->interval();
+#else
+  const TimeDelta interval;
+#endif
+  uint64_t total = 0u;
+  // The samples and name of each thread, by ID.
+  std::map<uint64_t, std::pair<uint64_t, std::string>> threads;
+  for (const CpuProfileEntry& entry : entries) {
+    total += entry.samples;
+    auto& thread = threads[entry.thread_id];
+    thread.first += entry.samples;
+    thread.second = entry.thread_name;
+  }
+  const double percent = total ? 100.0 / static_cast<double>(total) : 0.0;
+
+  std::string result = StringPrintf(
+      "%" PRIu64 " samples (one per %" PRId64 " us of CPU time), %" PRIu64
+      " dropped\n",
+      total, interval.ToMicroseconds(), GetDroppedCpuProfileSampleCount());
+  for (const auto& thread : threads) {
+    result += StringPrintf("  thread %" PRIu64 " (%s): %" PRIu64
+                           " samples (%.1f%%)\n",
+                           thread.first, thread.second.second.c_str(),
+                           thread.second.first,
+                           static_cast<double>(thread.second.first) * percent);
+  }
+  for (size_t i = 0u; i < entries.size() && i < max_stacks; i++) {
+    const CpuProfileEntry& entry = entries[i];
+    result += StringPrintf("%" PRIu64 " samples (%.1f%%) on thread %" PRIu64
+                           " (%s):\n",
+                           entry.samples,
+                           static_cast<double>(entry.samples) * percent,
+                           entry.thread_id, entry.thread_name.c_str());
+    result += StackTraceToString(entry.stack.data(), entry.stack.size());
+  }
+  return result;
+}
+
+}  // namespace ftl
@@ -0,0 +1,103 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A sampling CPU profiler, which can be started and stopped from within the
+// process (e.g., from a debug handler), for where attaching an external
+// profiler isn't possible:
+//
+//   ftl::StartCpuProfiler();
+//   ...
+//   ftl::StopCpuProfiler();
+//   FTL_LOG(INFO) << ftl::DumpCpuProfile();
+//   const std::string profile = ftl::EncodeCpuProfileForPprof(
+//       ftl::GetCpuProfile(), ftl::CpuProfilerOptions().interval);
+//   files::WriteFile("/tmp/cpu.prof", profile.data(), profile.size());
+//
+// Only threads registered with |RegisterThreadForCpuProfiling()| (which every
+// |ftl::Thread| is) are sampled. While the profiler is running, each of them
+// gets a |SIGPROF| every |CpuProfilerOptions::interval| of the CPU time that it
+// uses, whose handler records the interrupted stack (following frame pointers,
+// see debug/stack_trace.h, so code compiled without them gives truncated
+// stacks) into a lock-free ring for that thread, which a background thread
+// collects. (So system calls in sampled threads may fail with |EINTR| more
+// often, as they may under any profiler.) Samples are attributed to the
+// threads they were taken on.
+//
+// This is only supported on Linux; elsewhere, |StartCpuProfiler()| fails.
+
+#ifndef LIB_FTL_DEBUG_CPU_PROFILER_H_
+#define LIB_FTL_DEBUG_CPU_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+
+struct CpuProfilerOptions {
+  // The CPU time between samples of each thread. (Intervals shorter than the
+  // kernel's scheduler tick, typically 1-4 ms, give one sample per tick.)
+  TimeDelta interval = TimeDelta::FromMilliseconds(10);
+};
+
+// The samples of one stack on one thread.
+struct CpuProfileEntry {
+  // The thread's kernel thread ID and its name when it was registered.
+  uint64_t thread_id = 0u;
+  std::string thread_name;
+  // The sampled code address, followed by the return addresses of the frames
+  // it was called from.
+  std::vector<const void*> stack;
+  uint64_t samples = 0u;
+};
+
+// The most frames recorded for each sample.
+constexpr size_t kMaxCpuProfileStackFrames = 64u;
+
+// Returns true if |StartCpuProfiler()| can work on this platform.
+FTL_EXPORT bool IsCpuProfilerSupported();
+
+// Makes the calling thread be sampled whenever the profiler is running, until
+// it exits. (Threads should call this after naming themselves.) Calling this
+// again for the same thread does nothing.
+FTL_EXPORT void RegisterThreadForCpuProfiling();
+
+// Discards the samples of any earlier run and starts sampling, returning true,
+// or returns false if the profiler is already running or isn't supported.
+FTL_EXPORT bool StartCpuProfiler(
+    const CpuProfilerOptions& options = CpuProfilerOptions());
+
+// Stops sampling (keeping the samples), if the profiler is running.
+FTL_EXPORT void StopCpuProfiler();
+
+// Returns true if the profiler is running.
+FTL_EXPORT bool IsCpuProfilerRunning();
+
+// Returns the samples of the current (or last) run, most sampled first.
+FTL_EXPORT std::vector<CpuProfileEntry> GetCpuProfile();
+
+// Returns the number of samples of the current (or last) run that were
+// dropped, because their threads' rings were full.
+FTL_EXPORT uint64_t GetDroppedCpuProfileSampleCount();
+
+// Returns |entries| in pprof's (legacy, binary) CPU profile format, for a run
+// sampling every |interval|, followed by the process's memory mappings, so
+// that pprof can symbolize it, e.g., |pprof --text my_program cpu.prof|.
+FTL_EXPORT std::string EncodeCpuProfileForPprof(
+    const std::vector<CpuProfileEntry>& entries,
+    TimeDelta interval);
+
+// Returns a human-readable summary of the current (or last) run: the samples
+// on each thread, followed by (up to |max_stacks| of) the most sampled stacks,
+// symbolized.
+FTL_EXPORT std::string DumpCpuProfile(size_t max_stacks = 10u);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_DEBUG_CPU_PROFILER_H_
@@ -0,0 +1,136 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/cpu_profiler.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/compiler_specific.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/time_point.h"
+
+#if defined(OS_LINUX)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// The bounds of the section holding just |Burn()| (defined by the linker).
+extern "C" const char __start_ftl_cpu_profiler_burn[];
+extern "C" const char __stop_ftl_cpu_profiler_burn[];
+
+namespace ftl {
+namespace {
+
+// Uses the CPU for |duration|, mostly in a loop with no calls or memory
+// accesses (so that sampled code addresses are in this function, even with
+// sanitizers). It's in its own section, so that |IsInBurn()| knows its extent
+// (however the compiler lays it out).
+FTL_NOINLINE __attribute__((section("ftl_cpu_profiler_burn"))) void Burn(
+    TimeDelta duration) {
+  const TimePoint deadline = TimePoint::Now() + duration;
+  uint64_t value = 0u;
+  while (TimePoint::Now() < deadline) {
+    for (int i = 0; i < 100000; i++)
+      __asm__ volatile("" : "+r"(value));
+  }
+}
+
+bool IsInBurn(const void* pc) {
+  const char* address = static_cast<const char*>(pc);
+  return address >= __start_ftl_cpu_profiler_burn &&
+         address < __stop_ftl_cpu_profiler_burn;
+}
+
+CpuProfilerOptions FastOptions() {
+  CpuProfilerOptions options;
+  options.interval = TimeDelta::FromMilliseconds(1);
+  return options;
+}
+
+TEST(CpuProfilerTest, SamplesRegisteredThreads) {
+  if (!IsCpuProfilerSupported()) {
+    EXPECT_FALSE(StartCpuProfiler());
+    return;
+  }
+
+  RegisterThreadForCpuProfiling();
+  // Again does nothing.
+  RegisterThreadForCpuProfiling();
+  ASSERT_TRUE(StartCpuProfiler(FastOptions()));
+  EXPECT_TRUE(IsCpuProfilerRunning());
+  EXPECT_FALSE(StartCpuProfiler(FastOptions()));
+  Burn(TimeDelta::FromMilliseconds(200));
+  StopCpuProfiler();
+  EXPECT_FALSE(IsCpuProfilerRunning());
+
+  const uint64_t thread_id = static_cast<uint64_t>(syscall(SYS_gettid));
+  uint64_t samples = 0u;
+  uint64_t samples_in_burn = 0u;
+  const std::vector<CpuProfileEntry> entries = GetCpuProfile();
+  for (size_t i = 0u; i < entries.size(); i++) {
+    if (i > 0u) {
+      EXPECT_GE(entries[i - 1u].samples, entries[i].samples);
+    }
+    ASSERT_FALSE(entries[i].stack.empty());
+    if (entries[i].thread_id != thread_id)
+      continue;
+    samples += entries[i].samples;
+    if (IsInBurn(entries[i].stack[0]))
+      samples_in_burn += entries[i].samples;
+  }
+  // (About 200 are expected, but CPU time may be short on a busy machine.)
+  EXPECT_LE(20u, samples);
+  EXPECT_LE(10u, samples_in_burn);
+  EXPECT_EQ(0u, GetDroppedCpuProfileSampleCount());
+
+  // The samples are kept after stopping, and discarded by starting again.
+  EXPECT_EQ(entries.size(), GetCpuProfile().size());
+  ASSERT_TRUE(StartCpuProfiler(FastOptions()));
+  StopCpuProfiler();
+  EXPECT_GT(entries.size(), GetCpuProfile().size());
+}
+
+TEST(CpuProfilerTest, AttributesSamplesToThreads) {
+  if (!IsCpuProfilerSupported())
+    return;
+
+  ASSERT_TRUE(StartCpuProfiler(FastOptions()));
+  Thread::Options options;
+  options.name = "profiled";
+  Thread thread([] { Burn(TimeDelta::FromMilliseconds(100)); });
+  ASSERT_TRUE(thread.Run(options));
+  ASSERT_TRUE(thread.Join());
+  StopCpuProfiler();
+
+  uint64_t samples = 0u;
+  for (const CpuProfileEntry& entry : GetCpuProfile()) {
+    if (entry.thread_name == "profiled")
+      samples += entry.samples;
+  }
+  EXPECT_LE(10u, samples);
+  EXPECT_NE(std::string::npos, DumpCpuProfile().find(" (profiled): "));
+}
+
+TEST(CpuProfilerTest, EncodeCpuProfileForPprof) {
+  CpuProfileEntry entry;
+  entry.samples = 5u;
+  entry.stack = {reinterpret_cast<const void*>(0x1234),
+                 reinterpret_cast<const void*>(0x5678)};
+  const std::string profile =
+      EncodeCpuProfileForPprof({entry}, TimeDelta::FromMilliseconds(10));
+
+  const uintptr_t expected[] = {0u, 3u, 0u, 10000u, 0u,  5u,
+                                2u, 0x1234u, 0x5678u, 0u, 1u, 0u};
+  ASSERT_LE(sizeof(expected), profile.size());
+  EXPECT_EQ(0, memcmp(expected, profile.data(), sizeof(expected)));
+#if defined(OS_LINUX)
+  // Followed by the mappings.
+  EXPECT_NE(std::string::npos, profile.find(" r-xp ", sizeof(expected)));
+#endif
+}
+
+}  // namespace
+}  // namespace ftl
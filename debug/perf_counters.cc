@@ -0,0 +1,177 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/perf_counters.h"
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/strings/string_printf.h"
+
+#if defined(OS_LINUX)
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "lib/ftl/files/eintr_wrapper.h"
+#endif
+
+namespace ftl {
+namespace {
+
+#if defined(OS_LINUX)
+
+constexpr uint64_t kEvents[] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+};
+constexpr size_t kEventCount = sizeof(kEvents) / sizeof(kEvents[0]);
+
+// A thread's group of events (with the cycles' as the leader), which it opens
+// on first use.
+class EventGroup final {
+ public:
+  EventGroup() {
+    for (size_t i = 0u; i < kEventCount; i++) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = kEvents[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                         i ? fds_[0] : -1, 0));
+      if (fds_[i] < 0) {
+        Close();
+        return;
+      }
+    }
+  }
+
+  ~EventGroup() { Close(); }
+
+  bool is_valid() const { return fds_[0] >= 0; }
+
+  bool Read(PerfCounterValues* values) {
+    if (!is_valid())
+      return false;
+    // The number of events, the times enabled and running, then the counts.
+    uint64_t data[3u + kEventCount];
+    if (HANDLE_EINTR(read(fds_[0], data, sizeof(data))) !=
+            static_cast<ssize_t>(sizeof(data)) ||
+        data[0] != kEventCount) {
+      return false;
+    }
+    // Scale the counts up from the time they were counting, if less.
+    const uint64_t enabled = data[1];
+    const uint64_t running = data[2];
+    uint64_t counts[kEventCount];
+    for (size_t i = 0u; i < kEventCount; i++) {
+      counts[i] = data[3u + i];
+      if (running && running < enabled) {
+        counts[i] = static_cast<uint64_t>(static_cast<double>(counts[i]) *
+                                          enabled / running);
+      }
+    }
+    values->cycles = counts[0];
+    values->instructions = counts[1];
+    values->cache_misses = counts[2];
+    values->branch_misses = counts[3];
+    return true;
+  }
+
+ private:
+  void Close() {
+    for (int& fd : fds_) {
+      if (fd >= 0)
+        close(fd);
+      fd = -1;
+    }
+  }
+
+  int fds_[kEventCount] = {-1, -1, -1, -1};
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EventGroup);
+};
+
+EventGroup* GetEventGroup() {
+  thread_local EventGroup group;
+  return &group;
+}
+
+#endif  // defined(OS_LINUX)
+
+uint64_t SubtractToZero(uint64_t a, uint64_t b) {
+  return a > b ? a - b : 0u;
+}
+
+}  // namespace
+
+double PerfCounterValues::InstructionsPerCycle() const {
+  return cycles ? static_cast<double>(instructions) / cycles : 0.0;
+}
+
+PerfCounterValues& PerfCounterValues::operator+=(
+    const PerfCounterValues& other) {
+  cycles += other.cycles;
+  instructions += other.instructions;
+  cache_misses += other.cache_misses;
+  branch_misses += other.branch_misses;
+  return *this;
+}
+
+PerfCounterValues& PerfCounterValues::operator-=(
+    const PerfCounterValues& other) {
+  cycles = SubtractToZero(cycles, other.cycles);
+  instructions = SubtractToZero(instructions, other.instructions);
+  cache_misses = SubtractToZero(cache_misses, other.cache_misses);
+  branch_misses = SubtractToZero(branch_misses, other.branch_misses);
+  return *this;
+}
+
+std::string PerfCounterValues::ToString() const {
+  return StringPrintf(
+      "cycles=%llu instructions=%llu ipc=%.3g cache_misses=%llu "
+      "branch_misses=%llu",
+      static_cast<unsigned long long>(cycles),
+      static_cast<unsigned long long>(instructions), InstructionsPerCycle(),
+      static_cast<unsigned long long>(cache_misses),
+      static_cast<unsigned long long>(branch_misses));
+}
+
+bool ArePerfCountersSupported() {
+#if defined(OS_LINUX)
+  return GetEventGroup()->is_valid();
+#else
+  return false;
+#endif
+}
+
+bool ReadPerfCounters(PerfCounterValues* values) {
+  *values = PerfCounterValues();
+#if defined(OS_LINUX)
+  if (GetEventGroup()->Read(values))
+    return true;
+#endif
+  return false;
+}
+
+PerfCounterScope::PerfCounterScope(PerfCounterValues* total)
+    : total_(total), valid_(ReadPerfCounters(&start_)) {}
+
+PerfCounterScope::~PerfCounterScope() {
+  if (total_)
+    *total_ += Elapsed();
+}
+
+PerfCounterValues PerfCounterScope::Elapsed() const {
+  PerfCounterValues values;
+  if (valid_ && ReadPerfCounters(&values))
+    values -= start_;
+  return values;
+}
+
+}  // namespace ftl
@@ -0,0 +1,87 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Hardware performance counters (cycles, instructions, cache misses and branch
+// misses) of the calling thread, around a region of code, e.g.:
+//
+//   ftl::PerfCounterValues values;
+//   {
+//     ftl::PerfCounterScope scope(&values);
+//     Frobnicate();
+//   }
+//   FTL_LOG(INFO) << values.ToString();
+//
+// The counters are read from a group of |perf_event_open()| events, which is
+// opened the first time a thread uses them (and closed when it exits), so
+// a scope costs only a couple of |read()|s. They count user-space events
+// only. Where they aren't supported (on other systems, in most VMs, or if
+// /proc/sys/kernel/perf_event_paranoid forbids them), scopes read all zeros.
+//
+// If the kernel has more events than hardware counters to count them on, it
+// takes turns, and the counts are scaled up from the time each was counting,
+// so they're estimates.
+
+#ifndef LIB_FTL_DEBUG_PERF_COUNTERS_H_
+#define LIB_FTL_DEBUG_PERF_COUNTERS_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+struct FTL_EXPORT PerfCounterValues {
+  uint64_t cycles = 0u;
+  uint64_t instructions = 0u;
+  uint64_t cache_misses = 0u;
+  uint64_t branch_misses = 0u;
+
+  // (Zero if there are no cycles.)
+  double InstructionsPerCycle() const;
+
+  PerfCounterValues& operator+=(const PerfCounterValues& other);
+  // (Each count stops at zero.)
+  PerfCounterValues& operator-=(const PerfCounterValues& other);
+
+  // E.g., "cycles=1200 instructions=3000 ipc=2.5 cache_misses=4
+  // branch_misses=1".
+  std::string ToString() const;
+};
+
+// Whether the counters can be read on the calling thread (which opens them,
+// if they aren't already).
+FTL_EXPORT bool ArePerfCountersSupported();
+
+// Reads the calling thread's counts since it opened its counters into
+// |*values|. Returns false (and zeros) if they aren't supported.
+FTL_EXPORT bool ReadPerfCounters(PerfCounterValues* values);
+
+// Counts the events on the calling thread from its construction to its
+// destruction, and then adds them to |*total| (if it isn't null). It must be
+// destroyed on the same thread.
+class FTL_EXPORT PerfCounterScope final {
+ public:
+  explicit PerfCounterScope(PerfCounterValues* total = nullptr);
+  ~PerfCounterScope();
+
+  // Whether the counters are supported.
+  bool is_valid() const { return valid_; }
+
+  // Returns the counts so far.
+  PerfCounterValues Elapsed() const;
+
+ private:
+  PerfCounterValues* const total_;
+  PerfCounterValues start_;
+  const bool valid_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PerfCounterScope);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_DEBUG_PERF_COUNTERS_H_
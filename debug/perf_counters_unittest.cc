@@ -0,0 +1,65 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/perf_counters.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TEST(PerfCounters, Values) {
+  PerfCounterValues values;
+  EXPECT_EQ(0.0, values.InstructionsPerCycle());
+  values.cycles = 100u;
+  values.instructions = 250u;
+  values.cache_misses = 3u;
+  values.branch_misses = 1u;
+  EXPECT_EQ(2.5, values.InstructionsPerCycle());
+  EXPECT_EQ("cycles=100 instructions=250 ipc=2.5 cache_misses=3 "
+            "branch_misses=1",
+            values.ToString());
+
+  PerfCounterValues more = values;
+  more += values;
+  EXPECT_EQ(200u, more.cycles);
+  EXPECT_EQ(2u, more.branch_misses);
+  more -= values;
+  EXPECT_EQ(values.ToString(), more.ToString());
+  PerfCounterValues none;
+  none -= values;
+  EXPECT_EQ(0u, none.instructions);
+}
+
+TEST(PerfCounters, Scope) {
+  PerfCounterValues total;
+  volatile uint64_t sum = 0u;
+  {
+    PerfCounterScope scope(&total);
+    EXPECT_EQ(ArePerfCountersSupported(), scope.is_valid());
+    for (uint64_t i = 0u; i < 1000000u; i++)
+      sum += i;
+  }
+  if (!ArePerfCountersSupported()) {
+    // Everything reads zero.
+    EXPECT_EQ(0u, total.cycles);
+    EXPECT_EQ(0u, total.instructions);
+    PerfCounterValues values;
+    EXPECT_FALSE(ReadPerfCounters(&values));
+    return;
+  }
+  EXPECT_LT(0u, total.cycles);
+  EXPECT_LE(1000000u, total.instructions);
+
+  // Each thread has its own counters.
+  std::thread([] {
+    PerfCounterValues values;
+    EXPECT_TRUE(ReadPerfCounters(&values));
+  }).join();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,246 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/stack_trace.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/compiler_specific.h"
+
+#if defined(OS_WIN)
+#include <windows.h>
+#else
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <unwind.h>
+#endif
+
+namespace ftl {
+namespace {
+
+#if !defined(OS_WIN)
+
+struct UnwindState {
+  const void** frames;
+  size_t max_frames;
+  size_t skip_frames;
+  size_t count;
+};
+
+_Unwind_Reason_Code UnwindCallback(struct _Unwind_Context* context,
+                                   void* arg) {
+  UnwindState* state = static_cast<UnwindState*>(arg);
+  const uintptr_t pc = _Unwind_GetIP(context);
+  if (!pc)
+    return _URC_END_OF_STACK;
+  if (state->skip_frames) {
+    state->skip_frames--;
+    return _URC_NO_REASON;
+  }
+  state->frames[state->count++] = reinterpret_cast<const void*>(pc);
+  return state->count == state->max_frames ? _URC_END_OF_STACK
+                                           : _URC_NO_REASON;
+}
+
+#endif  // !defined(OS_WIN)
+
+#if !defined(OS_WIN) && (defined(ARCH_CPU_X86_64) || defined(ARCH_CPU_ARM64))
+#define FTL_HAS_FRAME_POINTER_UNWINDER 1
+
+// On these, a frame pointer points at the caller's frame pointer, followed by
+// the return address.
+//
+// Frames are assumed to be at most this big, where the stack's end isn't
+// known.
+constexpr uintptr_t kMaxFrameSize = 1024u * 1024u;
+
+// Returns the end (the highest address) of the calling thread's stack, or 0 if
+// it isn't known. (This is looked up once per thread.)
+uintptr_t GetStackEnd() {
+  thread_local uintptr_t stack_end = 0u;
+  thread_local bool looked_up = false;
+  if (!looked_up) {
+    looked_up = true;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    pthread_attr_t attr;
+    if (!pthread_getattr_np(pthread_self(), &attr)) {
+      void* stack_address;
+      size_t stack_size;
+      if (!pthread_attr_getstack(&attr, &stack_address, &stack_size))
+        stack_end = reinterpret_cast<uintptr_t>(stack_address) + stack_size;
+      pthread_attr_destroy(&attr);
+    }
+#elif defined(OS_MACOSX)
+    stack_end =
+        reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(pthread_self()));
+#endif
+  }
+  return stack_end;
+}
+
+// Follows the frame pointers from |frame|, as above, if it's at or above
+// |stack_position| (on the calling thread's stack).
+size_t WalkFramePointers(uintptr_t frame,
+                         uintptr_t stack_position,
+                         const void** frames,
+                         size_t max_frames,
+                         size_t skip_frames) {
+  const uintptr_t stack_end = GetStackEnd();
+  size_t count = 0u;
+  while (count < max_frames) {
+    if (frame < stack_position || frame % sizeof(uintptr_t) ||
+        (stack_end && frame + 2u * sizeof(uintptr_t) > stack_end))
+      break;
+    const uintptr_t* words = reinterpret_cast<const uintptr_t*>(frame);
+    const uintptr_t next_frame = words[0];
+    const uintptr_t pc = words[1];
+    if (!pc)
+      break;
+    if (skip_frames)
+      skip_frames--;
+    else
+      frames[count++] = reinterpret_cast<const void*>(pc);
+    // Callers' frames are further up the stack (where a frame pointer isn't
+    // one, this usually stops the walk).
+    if (next_frame <= frame ||
+        (!stack_end && next_frame - frame > kMaxFrameSize))
+      break;
+    frame = next_frame;
+  }
+  return count;
+}
+
+#endif
+
+// Writes |value| in hexadecimal (with "0x") to |buffer|, which has room for
+// |size| characters, and returns the number written (truncated to fit).
+size_t FormatHex(uintptr_t value, char* buffer, size_t size) {
+  const int written = snprintf(buffer, size, "0x%llx",
+                               static_cast<unsigned long long>(value));
+  if (written < 0)
+    return 0u;
+  return static_cast<size_t>(written) < size ? static_cast<size_t>(written)
+                                             : size - 1u;
+}
+
+std::string WithOffset(const char* name, uintptr_t offset) {
+  char buffer[32];
+  buffer[0] = '+';
+  const size_t size = 1u + FormatHex(offset, buffer + 1, sizeof(buffer) - 1u);
+  return std::string(name) + std::string(buffer, size);
+}
+
+}  // namespace
+
+FTL_NOINLINE size_t CaptureStackTrace(const void** frames,
+                                      size_t max_frames,
+                                      size_t skip_frames) {
+  if (!max_frames)
+    return 0u;
+#if defined(OS_WIN)
+  return RtlCaptureStackBackTrace(static_cast<DWORD>(skip_frames + 1u),
+                                  static_cast<DWORD>(max_frames),
+                                  const_cast<void**>(frames), nullptr);
+#else
+  // (Skipping this function's own frame, too.)
+  UnwindState state = {frames, max_frames, skip_frames + 1u, 0u};
+  _Unwind_Backtrace(&UnwindCallback, &state);
+  return state.count;
+#endif
+}
+
+FTL_NOINLINE size_t CaptureStackTraceFromFramePointers(const void** frames,
+                                                       size_t max_frames,
+                                                       size_t skip_frames) {
+#if defined(FTL_HAS_FRAME_POINTER_UNWINDER)
+  // From this function's own frame, whose return address is into the caller.
+  const uintptr_t frame =
+      reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+  return WalkFramePointers(frame, frame, frames, max_frames, skip_frames);
+#else
+  return CaptureStackTrace(frames, max_frames, skip_frames + 1u);
+#endif
+}
+
+size_t CaptureInterruptedStackTrace(const void* pc,
+                                    const void* frame_pointer,
+                                    const void** frames,
+                                    size_t max_frames) {
+#if defined(FTL_HAS_FRAME_POINTER_UNWINDER)
+  if (!max_frames || !pc)
+    return 0u;
+  frames[0] = pc;
+  // Without knowing where the stack ends, |frame_pointer| (which may not be
+  // one) can't be checked.
+  if (!GetStackEnd())
+    return 1u;
+  // The interrupted frames are above this one (unless this is on a
+  // |sigaltstack()|, in which case they can't be found).
+  const uintptr_t stack_position =
+      reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+  return 1u + WalkFramePointers(reinterpret_cast<uintptr_t>(frame_pointer),
+                                stack_position, frames + 1, max_frames - 1u,
+                                0u);
+#else
+  return 0u;
+#endif
+}
+
+std::string SymbolizeStackFrame(const void* pc) {
+#if !defined(OS_WIN)
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pc);
+  // (A return address may be just past the end of its function, e.g., after a
+  // call that doesn't return, so look up the call instead.)
+  Dl_info info;
+  if (!address || !dladdr(reinterpret_cast<const void*>(address - 1u), &info))
+    return std::string();
+  if (info.dli_sname && info.dli_saddr) {
+    const uintptr_t offset =
+        address - reinterpret_cast<uintptr_t>(info.dli_saddr);
+    int status = -1;
+    char* demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string result =
+        WithOffset(status == 0 && demangled ? demangled : info.dli_sname,
+                   offset);
+    free(demangled);
+    return result;
+  }
+  if (info.dli_fname && info.dli_fbase) {
+    const char* name = info.dli_fname;
+    for (const char* p = info.dli_fname; *p; p++) {
+      if (*p == '/')
+        name = p + 1;
+    }
+    return WithOffset(name,
+                      address - reinterpret_cast<uintptr_t>(info.dli_fbase));
+  }
+#endif
+  return std::string();
+}
+
+std::string StackTraceToString(const void* const* frames, size_t count) {
+  std::string result;
+  for (size_t i = 0u; i < count; i++) {
+    char buffer[64];
+    int size = snprintf(buffer, sizeof(buffer), "#%zu ", i);
+    result.append(buffer, static_cast<size_t>(size));
+    result.append(buffer,
+                  FormatHex(reinterpret_cast<uintptr_t>(frames[i]), buffer,
+                            sizeof(buffer)));
+    const std::string symbol = SymbolizeStackFrame(frames[i]);
+    if (!symbol.empty()) {
+      result += ' ';
+      result += symbol;
+    }
+    result += '\n';
+  }
+  return result;
+}
+
+}  // namespace ftl
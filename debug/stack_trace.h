@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Stack traces of the calling thread, captured cheaply enough to sample, e.g.:
+//
+//   const void* frames[32];
+//   size_t count = ftl::CaptureStackTrace(frames, arraysize(frames));
+//   ...
+//   FTL_LOG(INFO) << ftl::StackTraceToString(frames, count);
+//
+// Capturing only records return addresses; symbolizing them (which is much
+// slower) is separate, so it can be done later, and only for the stacks that
+// are looked at.
+
+#ifndef LIB_FTL_DEBUG_STACK_TRACE_H_
+#define LIB_FTL_DEBUG_STACK_TRACE_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace ftl {
+
+// Writes the return addresses of (up to |max_frames| of) the calling thread's
+// frames to |frames|, innermost first (the first being the address in the
+// caller just after its call to this), after skipping |skip_frames| of them,
+// and returns how many it wrote. This uses the unwind tables, so it works
+// however the code was compiled, in a few microseconds for a typical stack
+// (about 300 ns per frame). It doesn't allocate.
+FTL_EXPORT size_t CaptureStackTrace(const void** frames,
+                                    size_t max_frames,
+                                    size_t skip_frames = 0u);
+
+// Like |CaptureStackTrace()|, but follows the chain of frame pointers instead,
+// which takes a few nanoseconds per frame, but only finds all the frames in
+// code that keeps frame pointers (e.g., compiled with
+// -fno-omit-frame-pointer); it stops (or may skip frames) at code that
+// doesn't. It never reads outside the
+// thread's stack. (Where this isn't supported, it's |CaptureStackTrace()|.)
+FTL_EXPORT size_t CaptureStackTraceFromFramePointers(const void** frames,
+                                                     size_t max_frames,
+                                                     size_t skip_frames = 0u);
+
+// Like |CaptureStackTraceFromFramePointers()|, but for the calling thread's
+// stack as it was when interrupted (e.g., by a signal) at |pc|, with the frame
+// pointer register holding |frame_pointer| (the first frame is |pc| itself).
+// This is async-signal-safe, if the thread has already called one of the
+// frame pointer functions outside of a signal handler (the first call looks up
+// the stack's bounds). Returns 0 where frame pointers aren't supported.
+FTL_EXPORT size_t CaptureInterruptedStackTrace(const void* pc,
+                                               const void* frame_pointer,
+                                               const void** frames,
+                                               size_t max_frames);
+
+// Returns the (demangled) symbol and offset of the code address |pc|, e.g.,
+// "ftl::Foo()+0x1c", or its module and offset, e.g., "libfoo.so+0x1234", if
+// its symbol isn't known (e.g., if it's not exported: link with -rdynamic), or
+// an empty string if neither is.
+FTL_EXPORT std::string SymbolizeStackFrame(const void* pc);
+
+// Returns a line for each of the |count| |frames|, e.g.,
+// "#0 0x55d1e3a4b1c6 ftl::Foo()+0x1c\n".
+FTL_EXPORT std::string StackTraceToString(const void* const* frames,
+                                          size_t count);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_DEBUG_STACK_TRACE_H_
@@ -0,0 +1,140 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/stack_trace.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+#include "lib/ftl/compiler_specific.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/split_string.h"
+
+namespace ftl {
+namespace {
+
+constexpr size_t kMaxFrames = 64u;
+
+struct Capture {
+  const void* frames[kMaxFrames];
+  size_t count;
+  // Where the capturing function returns to.
+  const void* return_address;
+};
+
+FTL_NOINLINE void CaptureHere(bool frame_pointers,
+                              size_t skip_frames,
+                              Capture* capture) {
+  capture->return_address = __builtin_return_address(0);
+  const size_t count =
+      frame_pointers ? CaptureStackTraceFromFramePointers(
+                           capture->frames, kMaxFrames, skip_frames)
+                     : CaptureStackTrace(capture->frames, kMaxFrames,
+                                         skip_frames);
+  // (Not a tail call, so that this function's frame is still there.)
+  *static_cast<volatile size_t*>(&capture->count) = count;
+}
+
+// Whether |pc| is (probably) in |function|.
+bool IsIn(const void* pc,
+          void (*function)(bool, size_t, Capture*)) {
+  const uintptr_t start = reinterpret_cast<uintptr_t>(function);
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pc);
+  return address > start && address - start < 1024u;
+}
+
+FTL_NOINLINE void Recurse(int depth, bool frame_pointers, Capture* capture) {
+  if (depth)
+    Recurse(depth - 1, frame_pointers, capture);
+  else
+    CaptureHere(frame_pointers, 0u, capture);
+  // (Not a tail call.)
+  *static_cast<volatile size_t*>(&capture->count) += 0u;
+}
+
+TEST(StackTraceTest, CaptureStackTrace) {
+  Capture capture;
+  CaptureHere(false, 0u, &capture);
+  ASSERT_LE(2u, capture.count);
+  EXPECT_TRUE(IsIn(capture.frames[0], &CaptureHere));
+  EXPECT_EQ(capture.return_address, capture.frames[1]);
+
+  Capture skipped;
+  CaptureHere(false, 1u, &skipped);
+  ASSERT_LE(1u, skipped.count);
+  EXPECT_EQ(skipped.return_address, skipped.frames[0]);
+  EXPECT_EQ(capture.count - 1u, skipped.count);
+
+  const void* frames[2];
+  EXPECT_EQ(0u, CaptureStackTrace(frames, 0u));
+  EXPECT_EQ(2u, CaptureStackTrace(frames, arraysize(frames)));
+
+  Capture deep;
+  Recurse(20, false, &deep);
+  EXPECT_LE(capture.count + 20u, deep.count);
+}
+
+TEST(StackTraceTest, CaptureStackTraceFromFramePointers) {
+  // Without frame pointers, only the first frame is reliable.
+  Capture capture;
+  CaptureHere(true, 0u, &capture);
+  ASSERT_LE(1u, capture.count);
+  EXPECT_TRUE(IsIn(capture.frames[0], &CaptureHere));
+
+  Capture deep;
+  Recurse(20, true, &deep);
+  ASSERT_LE(1u, deep.count);
+  EXPECT_TRUE(IsIn(deep.frames[0], &CaptureHere));
+
+  const void* frames[1];
+  EXPECT_EQ(0u, CaptureStackTraceFromFramePointers(frames, 0u));
+  EXPECT_EQ(1u, CaptureStackTraceFromFramePointers(frames, 1u));
+
+  // On other threads too (whose stacks end elsewhere).
+  std::thread thread([] {
+    Capture capture;
+    CaptureHere(true, 0u, &capture);
+    EXPECT_LE(1u, capture.count);
+    CaptureHere(false, 0u, &capture);
+    EXPECT_LE(2u, capture.count);
+  });
+  thread.join();
+}
+
+TEST(StackTraceTest, SymbolizeStackFrame) {
+  EXPECT_EQ("", SymbolizeStackFrame(nullptr));
+
+  // An exported symbol (from the C library).
+  const void* pc = reinterpret_cast<const char*>(&abort) + 1;
+  const std::string symbol = SymbolizeStackFrame(pc);
+  EXPECT_EQ(0u, symbol.find("abort+0x1")) << symbol;
+
+  Capture capture;
+  CaptureHere(false, 0u, &capture);
+  EXPECT_NE("", SymbolizeStackFrame(capture.frames[0]));
+}
+
+TEST(StackTraceTest, StackTraceToString) {
+  Capture capture;
+  CaptureHere(false, 0u, &capture);
+  const std::string trace = StackTraceToString(capture.frames, capture.count);
+  std::vector<std::string> lines =
+      SplitStringCopy(trace, "\n", kKeepWhitespace, kSplitWantNonEmpty);
+  ASSERT_EQ(capture.count, lines.size());
+  EXPECT_EQ(0u, lines[0].find("#0 0x"));
+  EXPECT_EQ(0u, lines[1].find("#1 0x"));
+  EXPECT_EQ("", StackTraceToString(capture.frames, 0u));
+}
+
+TEST(StackTraceTest, FatalLogsStackTrace) {
+  EXPECT_DEATH_IF_SUPPORTED(FTL_LOG(FATAL) << "Oops",
+                            "Oops\nStack trace:\n#0 0x");
+}
+
+}  // namespace
+}  // namespace ftl
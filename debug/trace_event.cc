@@ -0,0 +1,367 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/trace_event.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/time/fast_clock.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(OS_MACOSX)
+#include <pthread.h>
+#endif
+
+#if defined(OS_WIN)
+#include <process.h>
+#define getpid _getpid
+#endif
+
+namespace ftl {
+namespace {
+
+static_assert((kTraceBufferEventCount & (kTraceBufferEventCount - 1u)) == 0u,
+              "kTraceBufferEventCount must be a power of two");
+
+// An event in a buffer. Its fields are atomics (but accessed without
+// ordering) since it's read while it may be being overwritten: readers check
+// afterwards whether it was (see |TraceBuffer::Read()|).
+struct TraceSlot {
+  std::atomic<int64_t> timestamp;
+  std::atomic<const char*> category;
+  std::atomic<const char*> name;
+  std::atomic<char> phase;
+};
+
+// A thread's events, written only by it. These are reused (once their threads
+// exit), and never freed.
+class TraceBuffer final {
+ public:
+  TraceBuffer() : slots_(new TraceSlot[kTraceBufferEventCount]) {}
+
+  // Called by a thread which is taking over this buffer (with the lock held).
+  void Reset(uint64_t thread_id, std::string thread_name) {
+    thread_id_ = thread_id;
+    thread_name_ = std::move(thread_name);
+    first_.store(next_.load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+  }
+
+  uint64_t thread_id() const { return thread_id_; }
+  const std::string& thread_name() const { return thread_name_; }
+
+  void Add(TraceEvent::Phase phase,
+           const char* category,
+           const char* name,
+           TimePoint timestamp) {
+    const uint64_t index = next_.load(std::memory_order_relaxed);
+    TraceSlot& slot = slots_[index & (kTraceBufferEventCount - 1u)];
+    slot.timestamp.store(timestamp.ToEpochDelta().ToNanoseconds(),
+                         std::memory_order_relaxed);
+    slot.category.store(category, std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    next_.store(index + 1u, std::memory_order_release);
+    // (So that a reader which sees any of the next event's fields also sees
+    // the index above, and knows not to trust them.)
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  // Appends the events in the buffer to |events|.
+  void Read(std::vector<TraceEvent>* events) const {
+    const uint64_t end = next_.load(std::memory_order_acquire);
+    uint64_t begin = end > kTraceBufferEventCount
+                         ? end - kTraceBufferEventCount
+                         : 0u;
+    begin = std::max(begin, first_.load(std::memory_order_relaxed));
+    const size_t old_size = events->size();
+    for (uint64_t i = begin; i < end; i++) {
+      const TraceSlot& slot = slots_[i & (kTraceBufferEventCount - 1u)];
+      TraceEvent event;
+      event.phase = static_cast<TraceEvent::Phase>(
+          slot.phase.load(std::memory_order_relaxed));
+      event.category = slot.category.load(std::memory_order_relaxed);
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.timestamp = TimePoint::FromEpochDelta(TimeDelta::FromNanoseconds(
+          slot.timestamp.load(std::memory_order_relaxed)));
+      event.thread_id = thread_id_;
+      events->push_back(event);
+    }
+    // Drop the events which may have been overwritten while being read
+    // (including the slot of the event being added now, if any).
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t new_end = next_.load(std::memory_order_relaxed);
+    if (new_end >= begin + kTraceBufferEventCount) {
+      const uint64_t overwritten = std::min(
+          end - begin, new_end - (begin + kTraceBufferEventCount) + 1u);
+      events->erase(events->begin() + old_size,
+                    events->begin() + old_size + overwritten);
+    }
+  }
+
+  // Discards the events so far.
+  void Clear() {
+    first_.store(next_.load(std::memory_order_acquire),
+                 std::memory_order_relaxed);
+  }
+
+ private:
+  uint64_t thread_id_ = 0u;
+  std::string thread_name_;
+  // The index of the next event to be added (which goes in slot
+  // |next_ % kTraceBufferEventCount|).
+  std::atomic<uint64_t> next_{0u};
+  // The index of the first event which hasn't been cleared.
+  std::atomic<uint64_t> first_{0u};
+  std::unique_ptr<TraceSlot[]> slots_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TraceBuffer);
+};
+
+uint64_t GetCurrentThreadId() {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  return static_cast<uint64_t>(syscall(SYS_gettid));
+#else
+  static std::atomic<uint64_t> next_id(1u);
+  return next_id.fetch_add(1u, std::memory_order_relaxed);
+#endif
+}
+
+std::string GetCurrentThreadName() {
+  char name[17] = {};
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  prctl(PR_GET_NAME, name, 0, 0, 0);
+#elif defined(OS_MACOSX)
+  pthread_getname_np(pthread_self(), name, sizeof(name));
+#endif
+  return name;
+}
+
+class TraceLog final {
+ public:
+  static TraceLog* Get() {
+    static TraceLog* log = new TraceLog();
+    return log;
+  }
+
+  const std::atomic<bool>* GetCategoryFlag(const char* category) {
+    MutexLocker locker(&mutex_);
+    auto it = categories_.find(category);
+    if (it == categories_.end()) {
+      it = categories_.insert(std::make_pair(category,
+                                             new std::atomic<bool>(false)))
+               .first;
+      it->second->store(IsEnabledLocked(it->first), std::memory_order_relaxed);
+    }
+    return it->second;
+  }
+
+  void SetEnabledCategories(StringView categories) {
+    MutexLocker locker(&mutex_);
+    enabled_categories_.clear();
+    for (StringView category :
+         SplitString(categories, ",", kTrimWhitespace, kSplitWantNonEmpty))
+      enabled_categories_.insert(category.ToString());
+    for (const auto& category : categories_) {
+      category.second->store(IsEnabledLocked(category.first),
+                             std::memory_order_relaxed);
+    }
+  }
+
+  bool IsCategoryEnabled(StringView category) {
+    MutexLocker locker(&mutex_);
+    return IsEnabledLocked(category.ToString());
+  }
+
+  TraceBuffer* AcquireBuffer() {
+    std::string thread_name = GetCurrentThreadName();
+    MutexLocker locker(&mutex_);
+    TraceBuffer* buffer;
+    if (free_buffers_.empty()) {
+      buffers_.emplace_back(new TraceBuffer());
+      buffer = buffers_.back().get();
+    } else {
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+    buffer->Reset(GetCurrentThreadId(), std::move(thread_name));
+    return buffer;
+  }
+
+  void ReleaseBuffer(TraceBuffer* buffer) {
+    MutexLocker locker(&mutex_);
+    free_buffers_.push_back(buffer);
+  }
+
+  std::vector<TraceEvent> GetEvents() {
+    std::vector<TraceEvent> events;
+    {
+      MutexLocker locker(&mutex_);
+      for (const auto& buffer : buffers_)
+        buffer->Read(&events);
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const TraceEvent& a, const TraceEvent& b) {
+                       return a.timestamp < b.timestamp;
+                     });
+    return events;
+  }
+
+  void Clear() {
+    MutexLocker locker(&mutex_);
+    for (const auto& buffer : buffers_)
+      buffer->Clear();
+  }
+
+  // Returns the names of the threads of the buffers, by thread ID.
+  std::map<uint64_t, std::string> GetThreadNames() {
+    MutexLocker locker(&mutex_);
+    std::map<uint64_t, std::string> names;
+    for (const auto& buffer : buffers_)
+      names[buffer->thread_id()] = buffer->thread_name();
+    return names;
+  }
+
+ private:
+  TraceLog() : fork_handlers_(&mutex_) {}
+
+  bool IsEnabledLocked(const std::string& category)
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return enabled_categories_.count("*") ||
+           enabled_categories_.count(category);
+  }
+
+  Mutex mutex_;
+  std::map<std::string, std::atomic<bool>*> categories_ FTL_GUARDED_BY(mutex_);
+  std::set<std::string> enabled_categories_ FTL_GUARDED_BY(mutex_);
+  std::vector<std::unique_ptr<TraceBuffer>> buffers_ FTL_GUARDED_BY(mutex_);
+  std::vector<TraceBuffer*> free_buffers_ FTL_GUARDED_BY(mutex_);
+  ForkHandlers fork_handlers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TraceLog);
+};
+
+// The calling thread's buffer, for as long as it exists.
+class ThreadTraceBuffer final {
+ public:
+  ThreadTraceBuffer() : buffer_(TraceLog::Get()->AcquireBuffer()) {}
+  ~ThreadTraceBuffer() { TraceLog::Get()->ReleaseBuffer(buffer_); }
+
+  TraceBuffer* buffer() const { return buffer_; }
+
+ private:
+  TraceBuffer* const buffer_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadTraceBuffer);
+};
+
+void AppendJsonString(const char* string, std::string* json) {
+  *json += '"';
+  for (const char* c = string; *c; c++) {
+    switch (*c) {
+      case '"':
+        *json += "\\\"";
+        break;
+      case '\\':
+        *json += "\\\\";
+        break;
+      default:
+        if (static_cast<unsigned char>(*c) < 0x20u)
+          StringAppendf(json, "\\u%04x", static_cast<unsigned char>(*c));
+        else
+          *json += *c;
+    }
+  }
+  *json += '"';
+}
+
+}  // namespace
+
+void SetEnabledTraceCategories(StringView categories) {
+  TraceLog::Get()->SetEnabledCategories(categories);
+}
+
+bool IsTraceCategoryEnabled(StringView category) {
+  return TraceLog::Get()->IsCategoryEnabled(category);
+}
+
+std::vector<TraceEvent> GetTraceEvents() {
+  return TraceLog::Get()->GetEvents();
+}
+
+void ClearTraceEvents() {
+  TraceLog::Get()->Clear();
+}
+
+std::string ExportTraceAsJson(const std::vector<TraceEvent>& events) {
+  const int pid = static_cast<int>(getpid());
+  std::string json = "{\"traceEvents\":[";
+  std::set<uint64_t> thread_ids;
+  for (const TraceEvent& event : events) {
+    if (!thread_ids.empty())
+      json += ',';
+    json += "\n{\"name\":";
+    AppendJsonString(event.name, &json);
+    json += ",\"cat\":";
+    AppendJsonString(event.category, &json);
+    const int64_t nanoseconds = event.timestamp.ToEpochDelta().ToNanoseconds();
+    // (In microseconds, as the format wants.)
+    StringAppendf(&json,
+                  ",\"ph\":\"%c\",\"ts\":%" PRId64 ".%03d,\"pid\":%d,"
+                  "\"tid\":%" PRIu64,
+                  static_cast<char>(event.phase), nanoseconds / 1000,
+                  static_cast<int>(nanoseconds % 1000), pid, event.thread_id);
+    // (Instant events are scoped to their threads.)
+    if (event.phase == TraceEvent::kInstant)
+      json += ",\"s\":\"t\"";
+    json += '}';
+    thread_ids.insert(event.thread_id);
+  }
+  const std::map<uint64_t, std::string> thread_names =
+      TraceLog::Get()->GetThreadNames();
+  for (uint64_t thread_id : thread_ids) {
+    auto it = thread_names.find(thread_id);
+    if (it == thread_names.end() || it->second.empty())
+      continue;
+    StringAppendf(&json,
+                  ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                  "\"tid\":%" PRIu64 ",\"args\":{\"name\":",
+                  pid, thread_id);
+    AppendJsonString(it->second.c_str(), &json);
+    json += "}}";
+  }
+  json += "\n],\"displayTimeUnit\":\"ns\"}\n";
+  return json;
+}
+
+namespace internal {
+
+const std::atomic<bool>* GetTraceCategoryEnabledFlag(const char* category) {
+  return TraceLog::Get()->GetCategoryFlag(category);
+}
+
+void AddTraceEvent(TraceEvent::Phase phase,
+                   const char* category,
+                   const char* name) {
+  thread_local ThreadTraceBuffer buffer;
+  buffer.buffer()->Add(phase, category, name, FastClock::Now());
+}
+
+}  // namespace internal
+}  // namespace ftl
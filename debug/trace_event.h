@@ -0,0 +1,149 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Lightweight in-process tracing, for timelines of what each thread was doing,
+// e.g.:
+//
+//   void Frobnicate() {
+//     FTL_TRACE_EVENT("my_component", "Frobnicate");
+//     ...
+//   }
+//
+//   ftl::SetEnabledTraceCategories("my_component,ftl");
+//   ...
+//   const std::string trace = ftl::ExportTraceAsJson(ftl::GetTraceEvents());
+//   files::WriteFile("/tmp/trace.json", trace.data(), trace.size());
+//
+// and load the file into chrome://tracing or https://ui.perfetto.dev.
+//
+// Each thread records its events into a ring buffer of its own (of about the
+// last |kTraceBufferEventCount| events), without locking, so tracing is always
+// running for the enabled categories, and the trace is of the recent past. The
+// events of a thread which has exited are kept until another thread reuses its
+// buffer. The tasks run by |MessageLoop|, |ThreadPool| and
+// |SequencedTaskRunner| are traced in the "ftl" category.
+//
+// When a category is disabled (as they all are to begin with), an event in it
+// costs one relaxed atomic load (and the check that the site's static is
+// initialized). When enabled, it costs a clock read (see |FastClock|) and a
+// few stores, at each end.
+
+#ifndef LIB_FTL_DEBUG_TRACE_EVENT_H_
+#define LIB_FTL_DEBUG_TRACE_EVENT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_point.h"
+
+// Records the span of the enclosing scope as an event called |name| (a string
+// literal, or any string that lives forever) in the category |category|
+// (likewise), if the category is enabled.
+#define FTL_TRACE_EVENT(category, name) \
+  FTL_TRACE_EVENT_INTERNAL_(category, name, __LINE__)
+
+// Records an instant (zero-length) event, if |category| is enabled.
+#define FTL_TRACE_INSTANT(category, name)                                  \
+  do {                                                                     \
+    static const std::atomic<bool>* const ftl_trace_category_enabled =     \
+        ::ftl::internal::GetTraceCategoryEnabledFlag(category);            \
+    if (ftl_trace_category_enabled->load(std::memory_order_relaxed))       \
+      ::ftl::internal::AddTraceEvent(::ftl::TraceEvent::kInstant, category, \
+                                     name);                                \
+  } while (0)
+
+namespace ftl {
+
+// The number of events each thread's buffer holds.
+constexpr size_t kTraceBufferEventCount = 8192u;
+
+struct TraceEvent {
+  enum Phase : char {
+    kBegin = 'B',
+    kEnd = 'E',
+    kInstant = 'i',
+  };
+
+  Phase phase;
+  const char* category;
+  const char* name;
+  TimePoint timestamp;
+  // The recording thread's (kernel) id, where there is one; otherwise a number
+  // unique to the thread within the process.
+  uint64_t thread_id;
+};
+
+// Enables the categories in the comma-separated list |categories| (or all of
+// them, if it's "*"), and disables all others.
+FTL_EXPORT void SetEnabledTraceCategories(StringView categories);
+
+FTL_EXPORT bool IsTraceCategoryEnabled(StringView category);
+
+// Returns the events in all the threads' buffers, in order of their
+// timestamps. (A thread's buffer may have wrapped around, so that the first
+// events of a thread may be the ends of spans whose beginnings are lost.)
+FTL_EXPORT std::vector<TraceEvent> GetTraceEvents();
+
+// Discards the events recorded so far.
+FTL_EXPORT void ClearTraceEvents();
+
+// Returns |events| in the JSON trace event format (which both chrome://tracing
+// and Perfetto load), with the name of each thread which recorded any.
+FTL_EXPORT std::string ExportTraceAsJson(const std::vector<TraceEvent>& events);
+
+namespace internal {
+
+// Returns the category's flag, which lives forever.
+FTL_EXPORT const std::atomic<bool>* GetTraceCategoryEnabledFlag(
+    const char* category);
+
+FTL_EXPORT void AddTraceEvent(TraceEvent::Phase phase,
+                              const char* category,
+                              const char* name);
+
+class ScopedTraceEvent final {
+ public:
+  ScopedTraceEvent(const std::atomic<bool>* enabled,
+                   const char* category,
+                   const char* name)
+      : category_(enabled->load(std::memory_order_relaxed) ? category
+                                                            : nullptr),
+        name_(name) {
+    if (category_)
+      AddTraceEvent(TraceEvent::kBegin, category_, name_);
+  }
+
+  // (The end is recorded whenever the beginning was, even if the category has
+  // since been disabled.)
+  ~ScopedTraceEvent() {
+    if (category_)
+      AddTraceEvent(TraceEvent::kEnd, category_, name_);
+  }
+
+ private:
+  const char* const category_;
+  const char* const name_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ScopedTraceEvent);
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#define FTL_TRACE_EVENT_INTERNAL_(category, name, line) \
+  FTL_TRACE_EVENT_INTERNAL_2_(category, name, line)
+#define FTL_TRACE_EVENT_INTERNAL_2_(category, name, line)                   \
+  static const std::atomic<bool>* const ftl_trace_category_enabled_##line = \
+      ::ftl::internal::GetTraceCategoryEnabledFlag(category);               \
+  ::ftl::internal::ScopedTraceEvent ftl_trace_event_##line(                 \
+      ftl_trace_category_enabled_##line, category, name)
+
+#endif  // LIB_FTL_DEBUG_TRACE_EVENT_H_
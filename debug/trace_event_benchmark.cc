@@ -0,0 +1,31 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/trace_event.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_TraceEventDisabled(benchmark::State& state) {
+  SetEnabledTraceCategories("");
+  while (state.KeepRunning()) {
+    FTL_TRACE_EVENT("benchmark", "disabled");
+    benchmark::ClobberMemory();
+  }
+}
+FTL_BENCHMARK(BM_TraceEventDisabled);
+
+void BM_TraceEventEnabled(benchmark::State& state) {
+  SetEnabledTraceCategories("benchmark");
+  while (state.KeepRunning()) {
+    FTL_TRACE_EVENT("benchmark", "enabled");
+    benchmark::ClobberMemory();
+  }
+  SetEnabledTraceCategories("");
+}
+FTL_BENCHMARK(BM_TraceEventEnabled);
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,160 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/trace_event.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/tasks/thread_pool.h"
+#include "lib/ftl/threading/thread.h"
+
+namespace ftl {
+namespace {
+
+// Enables the test's categories, and disables them again afterwards.
+class TraceEventTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SetEnabledTraceCategories("test, test2");
+    ClearTraceEvents();
+  }
+  void TearDown() override {
+    SetEnabledTraceCategories("");
+    ClearTraceEvents();
+  }
+};
+
+// Returns the events in |category|.
+std::vector<TraceEvent> GetEventsIn(const char* category) {
+  std::vector<TraceEvent> events;
+  for (const TraceEvent& event : GetTraceEvents()) {
+    if (!strcmp(event.category, category))
+      events.push_back(event);
+  }
+  return events;
+}
+
+TEST_F(TraceEventTest, RecordsEnabledCategories) {
+  EXPECT_TRUE(IsTraceCategoryEnabled("test"));
+  EXPECT_TRUE(IsTraceCategoryEnabled("test2"));
+  EXPECT_FALSE(IsTraceCategoryEnabled("test3"));
+  {
+    FTL_TRACE_EVENT("test", "outer");
+    FTL_TRACE_EVENT("test3", "disabled");
+    {
+      FTL_TRACE_EVENT("test", "inner");
+      FTL_TRACE_INSTANT("test", "instant");
+      FTL_TRACE_INSTANT("test3", "disabled");
+    }
+  }
+
+  const std::vector<TraceEvent> events = GetEventsIn("test");
+  ASSERT_EQ(5u, events.size());
+  EXPECT_EQ(TraceEvent::kBegin, events[0].phase);
+  EXPECT_STREQ("outer", events[0].name);
+  EXPECT_EQ(TraceEvent::kBegin, events[1].phase);
+  EXPECT_STREQ("inner", events[1].name);
+  EXPECT_EQ(TraceEvent::kInstant, events[2].phase);
+  EXPECT_STREQ("instant", events[2].name);
+  EXPECT_EQ(TraceEvent::kEnd, events[3].phase);
+  EXPECT_STREQ("inner", events[3].name);
+  EXPECT_EQ(TraceEvent::kEnd, events[4].phase);
+  EXPECT_STREQ("outer", events[4].name);
+  for (size_t i = 1u; i < events.size(); i++) {
+    EXPECT_LE(events[i - 1u].timestamp, events[i].timestamp);
+    EXPECT_EQ(events[0].thread_id, events[i].thread_id);
+  }
+  EXPECT_TRUE(GetEventsIn("test3").empty());
+
+  ClearTraceEvents();
+  EXPECT_TRUE(GetEventsIn("test").empty());
+}
+
+TEST_F(TraceEventTest, EnablingAndDisabling) {
+  SetEnabledTraceCategories("*");
+  EXPECT_TRUE(IsTraceCategoryEnabled("test3"));
+  FTL_TRACE_INSTANT("test3", "enabled");
+  SetEnabledTraceCategories("");
+  FTL_TRACE_INSTANT("test3", "disabled");
+  {
+    SetEnabledTraceCategories("test3");
+    FTL_TRACE_EVENT("test3", "span");
+    // The end is recorded anyway.
+    SetEnabledTraceCategories("");
+  }
+
+  const std::vector<TraceEvent> events = GetEventsIn("test3");
+  ASSERT_EQ(3u, events.size());
+  EXPECT_STREQ("enabled", events[0].name);
+  EXPECT_EQ(TraceEvent::kBegin, events[1].phase);
+  EXPECT_EQ(TraceEvent::kEnd, events[2].phase);
+}
+
+TEST_F(TraceEventTest, KeepsTheLatestEvents) {
+  for (size_t i = 0u; i < kTraceBufferEventCount + 10u; i++)
+    FTL_TRACE_INSTANT("test", i < 10u ? "old" : "new");
+  // (The oldest event in a full buffer is the next to be overwritten, so it's
+  // left out, in case that's happening.)
+  const std::vector<TraceEvent> events = GetEventsIn("test");
+  ASSERT_EQ(kTraceBufferEventCount - 1u, events.size());
+  for (const TraceEvent& event : events)
+    EXPECT_STREQ("new", event.name);
+}
+
+TEST_F(TraceEventTest, ReadsWhileRecording) {
+  std::atomic<bool> stop(false);
+  std::thread thread([&stop] {
+    while (!stop.load(std::memory_order_relaxed)) {
+      FTL_TRACE_EVENT("test2", "span");
+    }
+  });
+  uint64_t thread_id = 0u;
+  for (int i = 0; i < 20; i++) {
+    const std::vector<TraceEvent> events = GetEventsIn("test2");
+    for (const TraceEvent& event : events) {
+      // (No torn events.)
+      ASSERT_STREQ("span", event.name);
+      ASSERT_TRUE(event.phase == TraceEvent::kBegin ||
+                  event.phase == TraceEvent::kEnd);
+      if (!thread_id)
+        thread_id = event.thread_id;
+      ASSERT_EQ(thread_id, event.thread_id);
+    }
+  }
+  stop.store(true);
+  thread.join();
+}
+
+TEST_F(TraceEventTest, TracesTasks) {
+  SetEnabledTraceCategories("ftl");
+  auto pool = MakeRefCounted<ThreadPool>(1u);
+  Thread::Options options;
+  options.name = "traced";
+  ASSERT_TRUE(pool->Start(options));
+  pool->PostTask([] {});
+  pool->Shutdown();
+
+  const std::vector<TraceEvent> events = GetEventsIn("ftl");
+  ASSERT_LE(2u, events.size());
+  EXPECT_STREQ("ThreadPool::RunTask", events[0].name);
+  EXPECT_EQ(TraceEvent::kBegin, events[0].phase);
+
+  const std::string json = ExportTraceAsJson(events);
+  EXPECT_EQ(0u, json.find("{\"traceEvents\":[\n{\"name\":"
+                          "\"ThreadPool::RunTask\",\"cat\":\"ftl\",\"ph\":"
+                          "\"B\",\"ts\":"));
+  // The worker's name.
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\":\"thread_name\",\"ph\":\"M\""));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"name\":\"traced-0\"}}"));
+  EXPECT_EQ("{\"traceEvents\":[\n],\"displayTimeUnit\":\"ns\"}\n",
+            ExportTraceAsJson(std::vector<TraceEvent>()));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,399 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/watchdog.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/debug/stack_trace.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/sleep.h"
+
+#if defined(OS_LINUX) && (defined(ARCH_CPU_X86_64) || defined(ARCH_CPU_ARM64))
+#define FTL_HAS_WATCHDOG_STACKS 1
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+namespace ftl {
+namespace internal {
+
+// A thread which has run |Watchdog::ScopedTask|s.
+struct WatchdogThreadSlot {
+  // When the current (outermost) |ScopedTask| started, in nanoseconds since
+  // the |TimePoint| epoch, or 0 if there isn't one.
+  std::atomic<int64_t> task_start{0};
+  // The number of nested |ScopedTask|s (only used on the thread itself).
+  int depth = 0;
+  std::thread::id thread;
+  uint64_t thread_id = 0u;
+  std::string name;
+  // The start of the task which was last reported (only used on the
+  // watchdog's thread), so that each one is reported once.
+  int64_t reported_task_start = 0;
+};
+
+}  // namespace internal
+
+namespace {
+
+// The most frames captured for a hung thread.
+constexpr size_t kMaxStackFrames = 64u;
+
+// How long to wait for a hung thread to capture its stack.
+constexpr TimeDelta kStackCaptureTimeout = TimeDelta::FromMilliseconds(100);
+
+std::atomic<uint64_t> g_next_watchdog_id{1u};
+
+// The calling thread's slot for the watchdog with id |g_cached_watchdog_id|.
+thread_local uint64_t g_cached_watchdog_id = 0u;
+thread_local internal::WatchdogThreadSlot* g_cached_slot = nullptr;
+
+int64_t NowNanoseconds() {
+  return TimePoint::Now().ToEpochDelta().ToNanoseconds();
+}
+
+#if defined(FTL_HAS_WATCHDOG_STACKS)
+
+uint64_t GetCurrentThreadId() {
+  return static_cast<uint64_t>(syscall(SYS_gettid));
+}
+
+std::string GetCurrentThreadName() {
+  char name[17] = {};
+  prctl(PR_GET_NAME, name, 0, 0, 0);
+  return name;
+}
+
+// Makes sure that |CaptureInterruptedStackTrace()| works in the calling
+// thread's signal handler (it needs the stack's bounds looked up first).
+void PrepareToCaptureStack() {
+  const void* frame;
+  CaptureStackTraceFromFramePointers(&frame, 1u);
+}
+
+// A request for a thread's stack, which it captures in its |SIGURG| handler.
+// Only one is made at a time (by whichever watchdog holds
+// |g_stack_request_mutex|).
+struct StackRequest {
+  // The thread to capture, until its handler claims the request (setting this
+  // to -1), or the requester gives up (setting it to 0).
+  std::atomic<int64_t> thread_id{0};
+  const void* frames[kMaxStackFrames];
+  size_t count = 0u;
+  std::atomic<bool> done{false};
+};
+
+StackRequest g_stack_request;
+Mutex g_stack_request_mutex;
+bool g_installed_handler FTL_GUARDED_BY(g_stack_request_mutex) = false;
+
+// The |SIGURG| handler from before ours, to which other |SIGURG|s are passed.
+struct sigaction g_previous_action;
+
+void GetInterruptedRegisters(void* context,
+                             const void** pc,
+                             const void** frame_pointer) {
+  const mcontext_t& registers = static_cast<ucontext_t*>(context)->uc_mcontext;
+#if defined(ARCH_CPU_X86_64)
+  *pc = reinterpret_cast<const void*>(registers.gregs[REG_RIP]);
+  *frame_pointer = reinterpret_cast<const void*>(registers.gregs[REG_RBP]);
+#else
+  *pc = reinterpret_cast<const void*>(registers.pc);
+  *frame_pointer = reinterpret_cast<const void*>(registers.regs[29]);
+#endif
+}
+
+void HandleStackSignal(int signal, siginfo_t* info, void* context) {
+  const int saved_errno = errno;
+  int64_t thread_id = static_cast<int64_t>(GetCurrentThreadId());
+  if (info->si_code == SI_TKILL &&
+      g_stack_request.thread_id.compare_exchange_strong(
+          thread_id, -1, std::memory_order_acquire)) {
+    const void* pc;
+    const void* frame_pointer;
+    GetInterruptedRegisters(context, &pc, &frame_pointer);
+    g_stack_request.count = CaptureInterruptedStackTrace(
+        pc, frame_pointer, g_stack_request.frames, kMaxStackFrames);
+    g_stack_request.done.store(true, std::memory_order_release);
+  } else if (g_previous_action.sa_flags & SA_SIGINFO) {
+    g_previous_action.sa_sigaction(signal, info, context);
+  } else if (g_previous_action.sa_handler != SIG_DFL &&
+             g_previous_action.sa_handler != SIG_IGN) {
+    g_previous_action.sa_handler(signal);
+  }
+  errno = saved_errno;
+}
+
+bool InstallStackSignalHandler()
+    FTL_EXCLUSIVE_LOCKS_REQUIRED(g_stack_request_mutex) {
+  if (g_installed_handler)
+    return true;
+  struct sigaction action = {};
+  action.sa_sigaction = &HandleStackSignal;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGURG, &action, &g_previous_action)) {
+    FTL_LOG(ERROR) << "Failed to install the watchdog's signal handler";
+    return false;
+  }
+  g_installed_handler = true;
+  return true;
+}
+
+// Captures the stack of the thread |thread_id| (of this process), or returns
+// an empty one if it doesn't respond in time.
+std::vector<const void*> CaptureThreadStack(uint64_t thread_id) {
+  MutexLocker locker(&g_stack_request_mutex);
+  if (!InstallStackSignalHandler())
+    return std::vector<const void*>();
+
+  g_stack_request.done.store(false, std::memory_order_relaxed);
+  g_stack_request.thread_id.store(static_cast<int64_t>(thread_id),
+                                  std::memory_order_release);
+  if (syscall(SYS_tgkill, getpid(), static_cast<pid_t>(thread_id), SIGURG)) {
+    g_stack_request.thread_id.store(0, std::memory_order_relaxed);
+    return std::vector<const void*>();
+  }
+
+  TimePoint deadline = TimePoint::Now() + kStackCaptureTimeout;
+  while (!g_stack_request.done.load(std::memory_order_acquire)) {
+    if (TimePoint::Now() >= deadline) {
+      int64_t expected = static_cast<int64_t>(thread_id);
+      if (g_stack_request.thread_id.compare_exchange_strong(
+              expected, 0, std::memory_order_relaxed)) {
+        return std::vector<const void*>();
+      }
+      // The handler has claimed the request, so it'll be done soon.
+    }
+    SleepFor(TimeDelta::FromMilliseconds(1));
+  }
+  g_stack_request.thread_id.store(0, std::memory_order_relaxed);
+  return std::vector<const void*>(
+      g_stack_request.frames, g_stack_request.frames + g_stack_request.count);
+}
+
+#else
+
+uint64_t GetCurrentThreadId() {
+  return 0u;
+}
+
+std::string GetCurrentThreadName() {
+  return std::string();
+}
+
+void PrepareToCaptureStack() {}
+
+std::vector<const void*> CaptureThreadStack(uint64_t thread_id) {
+  return std::vector<const void*>();
+}
+
+#endif
+
+// The state shared with a task runner's heartbeat tasks (which may outlive the
+// watchdog).
+struct Heartbeat : public RefCountedThreadSafe<Heartbeat> {
+  // True from when a heartbeat is posted until it runs.
+  std::atomic<bool> pending{false};
+  // The thread the last heartbeat ran on.
+  std::atomic<uint64_t> thread_id{0u};
+};
+
+}  // namespace
+
+struct Watchdog::WatchedTaskRunner {
+  RefPtr<TaskRunner> task_runner;
+  std::string name;
+  RefPtr<Heartbeat> heartbeat;
+  // When the pending heartbeat was posted.
+  TimePoint post_time;
+  // True if the pending heartbeat has been reported as late.
+  bool reported = false;
+};
+
+Watchdog::ScopedTask::ScopedTask(Watchdog* watchdog)
+    : slot_(watchdog->GetCurrentThreadSlot()) {
+  if (!slot_->depth++)
+    slot_->task_start.store(NowNanoseconds(), std::memory_order_relaxed);
+}
+
+Watchdog::ScopedTask::~ScopedTask() {
+  if (!--slot_->depth)
+    slot_->task_start.store(0, std::memory_order_relaxed);
+}
+
+Watchdog::Watchdog(const WatchdogOptions& options)
+    : options_(options), id_(g_next_watchdog_id.fetch_add(1u)) {
+  FTL_DCHECK(options_.check_interval > TimeDelta());
+}
+
+Watchdog::~Watchdog() {
+  Stop();
+#ifndef NDEBUG
+  MutexLocker locker(&mutex_);
+  for (const auto& slot : thread_slots_)
+    FTL_DCHECK(!slot->depth);
+#endif
+}
+
+bool Watchdog::Start() {
+  if (stop_)
+    return false;
+  stop_.reset(new ManualResetWaitableEvent());
+  ManualResetWaitableEvent* stop = stop_.get();
+  thread_ = std::thread([this, stop] {
+    while (stop->WaitWithTimeout(options_.check_interval))
+      CheckNow();
+  });
+  return true;
+}
+
+void Watchdog::Stop() {
+  if (!stop_)
+    return;
+  stop_->Signal();
+  thread_.join();
+  stop_.reset();
+}
+
+void Watchdog::Watch(RefPtr<TaskRunner> task_runner, const std::string& name) {
+  FTL_DCHECK(task_runner);
+  std::unique_ptr<WatchedTaskRunner> watched(new WatchedTaskRunner());
+  watched->task_runner = std::move(task_runner);
+  watched->name = name;
+  watched->heartbeat = MakeRefCounted<Heartbeat>();
+  MutexLocker locker(&mutex_);
+  task_runners_.push_back(std::move(watched));
+}
+
+void Watchdog::Unwatch(TaskRunner* task_runner) {
+  MutexLocker locker(&mutex_);
+  task_runners_.erase(
+      std::remove_if(
+          task_runners_.begin(), task_runners_.end(),
+          [task_runner](const std::unique_ptr<WatchedTaskRunner>& watched) {
+            return watched->task_runner.get() == task_runner;
+          }),
+      task_runners_.end());
+}
+
+size_t Watchdog::CheckNow() {
+  std::vector<WatchdogHang> hangs;
+  std::vector<RefPtr<TaskRunner>> to_post;
+  std::vector<RefPtr<Heartbeat>> heartbeats;
+  {
+    MutexLocker locker(&mutex_);
+    TimePoint now = TimePoint::Now();
+    for (const auto& watched : task_runners_) {
+      Heartbeat* heartbeat = watched->heartbeat.get();
+      if (!heartbeat->pending.load(std::memory_order_acquire)) {
+        heartbeat->pending.store(true, std::memory_order_relaxed);
+        watched->post_time = now;
+        watched->reported = false;
+        to_post.push_back(watched->task_runner);
+        heartbeats.push_back(watched->heartbeat);
+        continue;
+      }
+      TimeDelta late = now - watched->post_time;
+      if (watched->reported || late < options_.heartbeat_threshold)
+        continue;
+      watched->reported = true;
+      WatchdogHang hang;
+      hang.name = watched->name;
+      hang.duration = late;
+      hang.thread_id = heartbeat->thread_id.load(std::memory_order_relaxed);
+      hangs.push_back(std::move(hang));
+    }
+
+    int64_t now_nanoseconds = now.ToEpochDelta().ToNanoseconds();
+    for (const auto& slot : thread_slots_) {
+      int64_t task_start = slot->task_start.load(std::memory_order_relaxed);
+      if (!task_start || task_start == slot->reported_task_start)
+        continue;
+      TimeDelta running =
+          TimeDelta::FromNanoseconds(now_nanoseconds - task_start);
+      if (running < options_.task_threshold)
+        continue;
+      slot->reported_task_start = task_start;
+      WatchdogHang hang;
+      hang.name = slot->name;
+      hang.duration = running;
+      hang.thread_id = slot->thread_id;
+      hangs.push_back(std::move(hang));
+    }
+  }
+
+  // Post outside the lock, since posting may block (e.g., on a
+  // |BoundedTaskRunner|) or run arbitrary code.
+  for (size_t i = 0u; i < to_post.size(); i++) {
+    to_post[i]->PostTaskWithPriority(
+        [heartbeat = std::move(heartbeats[i])] {
+          uint64_t thread_id = GetCurrentThreadId();
+          if (heartbeat->thread_id.exchange(
+                  thread_id, std::memory_order_relaxed) != thread_id) {
+            PrepareToCaptureStack();
+          }
+          heartbeat->pending.store(false, std::memory_order_release);
+        },
+        TaskPriority::kUserBlocking);
+  }
+  for (auto& hang : hangs)
+    Report(&hang);
+  return hangs.size();
+}
+
+internal::WatchdogThreadSlot* Watchdog::GetCurrentThreadSlot() {
+  if (g_cached_watchdog_id == id_)
+    return g_cached_slot;
+
+  // The thread may already have a slot, if it has used another watchdog since.
+  std::thread::id thread = std::this_thread::get_id();
+  g_cached_watchdog_id = id_;
+  {
+    MutexLocker locker(&mutex_);
+    for (const auto& slot : thread_slots_) {
+      if (slot->thread == thread) {
+        g_cached_slot = slot.get();
+        return g_cached_slot;
+      }
+    }
+  }
+
+  PrepareToCaptureStack();
+  std::unique_ptr<internal::WatchdogThreadSlot> slot(
+      new internal::WatchdogThreadSlot());
+  slot->thread = thread;
+  slot->thread_id = GetCurrentThreadId();
+  slot->name = GetCurrentThreadName();
+  if (slot->name.empty())
+    slot->name = "unnamed thread";
+  g_cached_slot = slot.get();
+  MutexLocker locker(&mutex_);
+  thread_slots_.push_back(std::move(slot));
+  return g_cached_slot;
+}
+
+void Watchdog::Report(WatchdogHang* hang) {
+  if (hang->thread_id)
+    hang->stack = CaptureThreadStack(hang->thread_id);
+  if (options_.on_hang) {
+    options_.on_hang(*hang);
+    return;
+  }
+  FTL_LOG(ERROR) << "Watchdog: " << hang->name << " (thread "
+                 << hang->thread_id << ") has been stuck for "
+                 << hang->duration.ToMillisecondsF() << " ms\n"
+                 << StackTraceToString(hang->stack.data(), hang->stack.size());
+}
+
+}  // namespace ftl
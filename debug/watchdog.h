@@ -0,0 +1,150 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A watchdog which notices stalled task runners and long-running tasks while
+// they're happening (rather than once clients time out), and logs where the
+// stuck thread is, e.g.:
+//
+//   ftl::Watchdog watchdog;
+//   watchdog.Watch(io_loop->task_runner(), "io");
+//   watchdog.Start();
+//
+//   // And, in code that runs tasks (or around any other unit of work):
+//   {
+//     ftl::Watchdog::ScopedTask scoped_task(&watchdog);
+//     task();
+//   }
+//
+// Each watched task runner is posted a heartbeat task every
+// |WatchdogOptions::check_interval|; if one hasn't run within
+// |WatchdogOptions::heartbeat_threshold|, the task runner is reported as hung.
+// A |ScopedTask| which lasts longer than |WatchdogOptions::task_threshold| is
+// reported too. Each hang is reported once (with the thread's stack, where
+// possible), however long it lasts.
+//
+// The stack is captured by interrupting the thread with |SIGURG| (which is
+// otherwise ignored by default) and following frame pointers from where it was
+// interrupted (see debug/stack_trace.h); this is only supported on Linux (for
+// x86-64 and ARM64). Elsewhere, hangs are reported without stacks.
+
+#ifndef LIB_FTL_DEBUG_WATCHDOG_H_
+#define LIB_FTL_DEBUG_WATCHDOG_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+namespace internal {
+struct WatchdogThreadSlot;
+}  // namespace internal
+
+// A hang found by a |Watchdog|.
+struct WatchdogHang {
+  // The name the task runner was watched under, or (for a |ScopedTask|) the
+  // name of the thread it ran on.
+  std::string name;
+  // How long the heartbeat (or task) had been waiting (or running) for.
+  TimeDelta duration;
+  // The kernel's id for the stuck thread, or 0 if it isn't known (e.g., for a
+  // task runner which has never run a heartbeat).
+  uint64_t thread_id = 0u;
+  // The stuck thread's stack (innermost first), if it could be captured.
+  std::vector<const void*> stack;
+};
+
+struct WatchdogOptions {
+  // How often to post heartbeats and check for hangs.
+  TimeDelta check_interval = TimeDelta::FromSeconds(1);
+  // How long a heartbeat may take to run before its task runner is reported.
+  TimeDelta heartbeat_threshold = TimeDelta::FromSeconds(5);
+  // How long a |Watchdog::ScopedTask| may last before it is reported.
+  TimeDelta task_threshold = TimeDelta::FromSeconds(5);
+  // Called (on the watchdog's thread) with each hang. If null, hangs are
+  // logged (as errors).
+  std::function<void(const WatchdogHang&)> on_hang;
+};
+
+// This class is thread-safe.
+class FTL_EXPORT Watchdog final {
+ public:
+  // Marks the calling thread as running a task, from construction until
+  // destruction, for |WatchdogOptions::task_threshold|. (Nested |ScopedTask|s
+  // count as part of the outermost one.)
+  class FTL_EXPORT ScopedTask final {
+   public:
+    explicit ScopedTask(Watchdog* watchdog);
+    ~ScopedTask();
+
+   private:
+    internal::WatchdogThreadSlot* const slot_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(ScopedTask);
+  };
+
+  explicit Watchdog(const WatchdogOptions& options = WatchdogOptions());
+  // Stops the watchdog. All |ScopedTask|s must have been destroyed.
+  ~Watchdog();
+
+  // Starts the watchdog's thread. Returns false if it was already started.
+  bool Start();
+
+  // Stops (and joins) the watchdog's thread, if it's running.
+  void Stop();
+
+  // Posts heartbeats to |task_runner| (reporting it as |name|) from now on,
+  // until it's |Unwatch()|ed.
+  void Watch(RefPtr<TaskRunner> task_runner, const std::string& name);
+  void Unwatch(TaskRunner* task_runner);
+
+  // Checks for hangs now (as the watchdog's thread does periodically), and
+  // returns how many new ones were reported.
+  size_t CheckNow();
+
+ private:
+  struct WatchedTaskRunner;
+
+  // Returns the calling thread's slot, creating it if necessary.
+  internal::WatchdogThreadSlot* GetCurrentThreadSlot();
+
+  // Reports |hang|, first capturing its thread's stack (if it has one).
+  void Report(WatchdogHang* hang);
+
+  const WatchdogOptions options_;
+  // Distinguishes this watchdog from any others (even ones that were at the
+  // same address), for the calling thread's cached slot.
+  const uint64_t id_;
+
+  Mutex mutex_;
+  std::vector<std::unique_ptr<WatchedTaskRunner>> task_runners_
+      FTL_GUARDED_BY(mutex_);
+  // The threads which have run |ScopedTask|s, which are never freed (so that
+  // |ScopedTask|s only need the lock the first time on each thread).
+  std::vector<std::unique_ptr<internal::WatchdogThreadSlot>> thread_slots_
+      FTL_GUARDED_BY(mutex_);
+
+  std::unique_ptr<ManualResetWaitableEvent> stop_;
+  std::thread thread_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Watchdog);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_DEBUG_WATCHDOG_H_
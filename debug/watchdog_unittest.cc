@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/debug/watchdog.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace ftl {
+namespace {
+
+constexpr TimeDelta kThreshold = TimeDelta::FromMilliseconds(20);
+
+#if defined(OS_LINUX) && (defined(ARCH_CPU_X86_64) || defined(ARCH_CPU_ARM64))
+constexpr bool kCapturesStacks = true;
+#else
+constexpr bool kCapturesStacks = false;
+#endif
+
+class WatchdogTest : public ::testing::Test {
+ protected:
+  WatchdogOptions MakeOptions() {
+    WatchdogOptions options;
+    options.heartbeat_threshold = kThreshold;
+    options.task_threshold = kThreshold;
+    options.on_hang = [this](const WatchdogHang& hang) {
+      hangs_.push_back(hang);
+    };
+    return options;
+  }
+
+  // Only touched by |CheckNow()| on the test's thread.
+  std::vector<WatchdogHang> hangs_;
+};
+
+TEST_F(WatchdogTest, StartAndStop) {
+  Watchdog watchdog(MakeOptions());
+  EXPECT_TRUE(watchdog.Start());
+  EXPECT_FALSE(watchdog.Start());
+  watchdog.Stop();
+  watchdog.Stop();
+  EXPECT_TRUE(hangs_.empty());
+}
+
+TEST_F(WatchdogTest, HungTaskRunner) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  EXPECT_TRUE(pool->Start());
+  Watchdog watchdog(MakeOptions());
+  watchdog.Watch(pool, "pool");
+
+  // Posts a heartbeat, which runs before the task after it.
+  EXPECT_EQ(0u, watchdog.CheckNow());
+  ManualResetWaitableEvent started;
+  ManualResetWaitableEvent proceed;
+  pool->PostTask([&started, &proceed] {
+    started.Signal();
+    proceed.Wait();
+  });
+  started.Wait();
+
+  // Posts another heartbeat, which is stuck behind the task.
+  EXPECT_EQ(0u, watchdog.CheckNow());
+  SleepFor(kThreshold * 2);
+  EXPECT_EQ(1u, watchdog.CheckNow());
+  ASSERT_EQ(1u, hangs_.size());
+  EXPECT_EQ("pool", hangs_[0].name);
+  EXPECT_GE(hangs_[0].duration, kThreshold);
+  if (kCapturesStacks) {
+    EXPECT_NE(0u, hangs_[0].thread_id);
+    EXPECT_FALSE(hangs_[0].stack.empty());
+  }
+
+  // It's only reported once.
+  EXPECT_EQ(0u, watchdog.CheckNow());
+
+  proceed.Signal();
+  pool->Shutdown();
+  watchdog.Unwatch(pool.get());
+  EXPECT_EQ(0u, watchdog.CheckNow());
+}
+
+TEST_F(WatchdogTest, LongTask) {
+  Watchdog watchdog(MakeOptions());
+  ManualResetWaitableEvent started;
+  ManualResetWaitableEvent proceed;
+  std::thread thread([&watchdog, &started, &proceed] {
+    {
+      // A short task isn't reported.
+      Watchdog::ScopedTask scoped_task(&watchdog);
+    }
+    Watchdog::ScopedTask scoped_task(&watchdog);
+    Watchdog::ScopedTask nested_task(&watchdog);
+    started.Signal();
+    proceed.Wait();
+  });
+  started.Wait();
+
+  SleepFor(kThreshold * 2);
+  EXPECT_EQ(1u, watchdog.CheckNow());
+  ASSERT_EQ(1u, hangs_.size());
+  EXPECT_GE(hangs_[0].duration, kThreshold);
+  if (kCapturesStacks) {
+    EXPECT_FALSE(hangs_[0].stack.empty());
+  }
+  EXPECT_EQ(0u, watchdog.CheckNow());
+
+  proceed.Signal();
+  thread.join();
+  EXPECT_EQ(0u, watchdog.CheckNow());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,445 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/async_io.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/thread_pool.h"
+#include "lib/ftl/threading/thread.h"
+
+#if defined(OS_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define FTL_ASYNC_IO_URING
+#endif
+#endif
+#endif
+
+namespace files {
+namespace internal {
+
+struct AsyncIOOperation {
+  AsyncIO::Request request;
+  ftl::Promise<ssize_t> promise;
+  // For io_uring's vectored reads and writes.
+  struct iovec iov;
+};
+
+using OperationList = std::vector<std::unique_ptr<AsyncIOOperation>>;
+
+class AsyncIOBackend {
+ public:
+  virtual ~AsyncIOBackend() = default;
+
+  // Takes ownership of |operations|, setting each one's promise when it's
+  // done.
+  virtual void Submit(OperationList operations) = 0;
+};
+
+namespace {
+
+ssize_t RunBlocking(const AsyncIO::Request& request) {
+  ssize_t result = 0;
+  switch (request.type) {
+    case AsyncIO::Request::Type::kRead:
+      result = HANDLE_EINTR(pread(request.fd, request.buffer, request.size,
+                                  static_cast<off_t>(request.offset)));
+      break;
+    case AsyncIO::Request::Type::kWrite:
+      result = HANDLE_EINTR(pwrite(request.fd, request.buffer, request.size,
+                                   static_cast<off_t>(request.offset)));
+      break;
+    case AsyncIO::Request::Type::kFsync:
+      result = HANDLE_EINTR(fsync(request.fd));
+      break;
+  }
+  return result < 0 ? -errno : result;
+}
+
+class ThreadPoolBackend final : public AsyncIOBackend {
+ public:
+  static std::unique_ptr<ThreadPoolBackend> Create(size_t thread_count) {
+    std::unique_ptr<ThreadPoolBackend> backend(
+        new ThreadPoolBackend(std::max<size_t>(thread_count, 1u)));
+    ftl::Thread::Options options;
+    options.name = "async-io";
+    if (!backend->pool_->Start(options))
+      return nullptr;
+    return backend;
+  }
+
+  ~ThreadPoolBackend() override { pool_->Shutdown(); }
+
+  void Submit(OperationList operations) override {
+    std::vector<ftl::UniqueClosure> tasks;
+    tasks.reserve(operations.size());
+    for (auto& operation : operations) {
+      tasks.emplace_back([operation = std::move(operation)]() mutable {
+        operation->promise.SetValue(RunBlocking(operation->request));
+      });
+    }
+    pool_->PostTasks(std::move(tasks));
+  }
+
+ private:
+  explicit ThreadPoolBackend(size_t thread_count)
+      : pool_(ftl::MakeRefCounted<ftl::ThreadPool>(thread_count)) {}
+
+  ftl::RefPtr<ftl::ThreadPool> pool_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadPoolBackend);
+};
+
+#if defined(FTL_ASYNC_IO_URING)
+
+int IOUringSetup(unsigned entries, struct io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IOUringEnter(int fd, unsigned to_submit, unsigned min_complete,
+                 unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+// The largest queue that |Create()| asks for (the kernel's limit is larger,
+// but each entry pins memory).
+constexpr size_t kMaxQueueDepth = 4096u;
+
+// Submits operations on an io_uring's submission queue (under |mutex_|), and
+// waits for and dispatches their completions on a thread of its own. At most
+// |sq_entries_| operations are in the ring at once (the rest wait in
+// |queued_|), so the submission queue doesn't fill up and the completion queue
+// (which is twice as big) can't overflow.
+class IOUringBackend final : public AsyncIOBackend {
+ public:
+  static std::unique_ptr<IOUringBackend> Create(size_t queue_depth) {
+    std::unique_ptr<IOUringBackend> backend(new IOUringBackend());
+    if (!backend->Init(std::min(std::max<size_t>(queue_depth, 1u),
+                                kMaxQueueDepth)))
+      return nullptr;
+    return backend;
+  }
+
+  ~IOUringBackend() override {
+    if (completion_thread_) {
+      ftl::MutexLocker locker(&mutex_);
+      stopping_ = true;
+      while (in_flight_ || !queued_.empty())
+        idle_cv_.Wait(&mutex_);
+      // Wake up the completion thread with a no-op, which it knows by its null
+      // |user_data|.
+      unsigned tail = *sq_tail_;
+      struct io_uring_sqe* sqe = &sqes_[tail & sq_mask_];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_NOP;
+      sq_array_[tail & sq_mask_] = tail & sq_mask_;
+      __atomic_store_n(sq_tail_, tail + 1u, __ATOMIC_RELEASE);
+      unsubmitted_++;
+      SubmitLocked();
+    }
+    if (completion_thread_)
+      completion_thread_->Join();
+    if (sqes_ != MAP_FAILED)
+      munmap(sqes_, sqes_size_);
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != MAP_FAILED)
+      munmap(sq_ring_, sq_ring_size_);
+  }
+
+  void Submit(OperationList operations) override {
+    ftl::MutexLocker locker(&mutex_);
+    for (auto& operation : operations)
+      queued_.push_back(operation.release());
+    FlushLocked();
+  }
+
+ private:
+  IOUringBackend() = default;
+
+  bool Init(size_t queue_depth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_.reset(IOUringSetup(static_cast<unsigned>(queue_depth), &params));
+    if (!ring_fd_.is_valid())
+      return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = !!(params.features & IORING_FEAT_SINGLE_MMAP);
+    if (single_mmap)
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_.get(),
+                    IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED)
+      return false;
+    cq_ring_ = single_mmap
+                   ? sq_ring_
+                   : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_fd_.get(),
+                          IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED)
+      return false;
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_.get(),
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+      return false;
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    completion_thread_.reset(new ftl::Thread([this] { CompletionMain(); }));
+    ftl::Thread::Options options;
+    options.name = "async-io";
+    if (!completion_thread_->Run(options)) {
+      completion_thread_.reset();
+      return false;
+    }
+    return true;
+  }
+
+  // Moves operations from |queued_| to the submission queue while there's
+  // room, and submits them.
+  void FlushLocked() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    // Only this (under |mutex_|) writes the tail, so it needn't be atomic.
+    unsigned tail = *sq_tail_;
+    const unsigned old_tail = tail;
+    while (!queued_.empty() && in_flight_ < sq_entries_) {
+      AsyncIOOperation* operation = queued_.front();
+      queued_.pop_front();
+      const AsyncIO::Request& request = operation->request;
+      const unsigned index = tail & sq_mask_;
+      struct io_uring_sqe* sqe = &sqes_[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->fd = request.fd;
+      sqe->user_data = reinterpret_cast<uintptr_t>(operation);
+      if (request.type == AsyncIO::Request::Type::kFsync) {
+        sqe->opcode = IORING_OP_FSYNC;
+      } else {
+        sqe->opcode = request.type == AsyncIO::Request::Type::kRead
+                          ? IORING_OP_READV
+                          : IORING_OP_WRITEV;
+        operation->iov.iov_base = request.buffer;
+        operation->iov.iov_len = request.size;
+        sqe->addr = reinterpret_cast<uintptr_t>(&operation->iov);
+        sqe->len = 1u;
+        sqe->off = request.offset;
+      }
+      sq_array_[index] = index;
+      tail++;
+      in_flight_++;
+    }
+    if (tail == old_tail && !unsubmitted_)
+      return;
+    // Publish the entries before the kernel can see the new tail.
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+    unsubmitted_ += tail - old_tail;
+    SubmitLocked();
+  }
+
+  // Tells the kernel about the entries which have been put on the submission
+  // queue. If it can't take them all now (e.g., if it's out of memory), the
+  // rest are retried on the next submission or completion.
+  void SubmitLocked() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    while (unsubmitted_) {
+      int result = IOUringEnter(ring_fd_.get(), unsubmitted_, 0u, 0u);
+      if (result < 0 && errno == EINTR)
+        continue;
+      if (result <= 0) {
+        FTL_DCHECK(errno == EAGAIN || errno == EBUSY);
+        return;
+      }
+      unsubmitted_ -= static_cast<unsigned>(result);
+    }
+  }
+
+  void CompletionMain() {
+    std::vector<std::pair<AsyncIOOperation*, ssize_t>> completed;
+    bool stop = false;
+    while (!stop) {
+      int result =
+          IOUringEnter(ring_fd_.get(), 0u, 1u, IORING_ENTER_GETEVENTS);
+      FTL_DCHECK(result >= 0 || errno == EINTR || errno == EAGAIN ||
+                 errno == EBUSY);
+
+      // Only this thread reads the completion queue, so its head needn't be
+      // atomic.
+      unsigned head = *cq_head_;
+      const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; head++) {
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        if (!cqe.user_data) {
+          stop = true;
+          continue;
+        }
+        completed.emplace_back(
+            reinterpret_cast<AsyncIOOperation*>(
+                static_cast<uintptr_t>(cqe.user_data)),
+            cqe.res);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      if (completed.empty())
+        continue;
+
+      {
+        ftl::MutexLocker locker(&mutex_);
+        in_flight_ -= completed.size();
+        FlushLocked();
+        if (stopping_ && !in_flight_ && queued_.empty())
+          idle_cv_.SignalAll();
+      }
+      for (const auto& operation : completed) {
+        operation.first->promise.SetValue(operation.second);
+        delete operation.first;
+      }
+      completed.clear();
+    }
+  }
+
+  ftl::UniqueFD ring_fd_;
+  void* sq_ring_ = MAP_FAILED;
+  size_t sq_ring_size_ = 0u;
+  void* cq_ring_ = MAP_FAILED;
+  size_t cq_ring_size_ = 0u;
+  struct io_uring_sqe* sqes_ = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_size_ = 0u;
+
+  unsigned* sq_tail_ = nullptr;
+  unsigned sq_mask_ = 0u;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_entries_ = 0u;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0u;
+  struct io_uring_cqe* cqes_ = nullptr;
+
+  std::unique_ptr<ftl::Thread> completion_thread_;
+
+  ftl::Mutex mutex_;
+  // Signaled when the last operation completes, once |stopping_|.
+  ftl::CondVar idle_cv_;
+  std::deque<AsyncIOOperation*> queued_ FTL_GUARDED_BY(mutex_);
+  // Operations on the submission queue, or submitted to the kernel.
+  size_t in_flight_ FTL_GUARDED_BY(mutex_) = 0u;
+  // Entries on the submission queue which the kernel hasn't yet taken.
+  unsigned unsubmitted_ FTL_GUARDED_BY(mutex_) = 0u;
+  bool stopping_ FTL_GUARDED_BY(mutex_) = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IOUringBackend);
+};
+
+#endif  // defined(FTL_ASYNC_IO_URING)
+
+}  // namespace
+}  // namespace internal
+
+AsyncIO::Request AsyncIO::Request::Read(int fd,
+                                        void* buffer,
+                                        size_t size,
+                                        uint64_t offset) {
+  return Request{Type::kRead, fd, buffer, size, offset};
+}
+
+AsyncIO::Request AsyncIO::Request::Write(int fd,
+                                         const void* buffer,
+                                         size_t size,
+                                         uint64_t offset) {
+  // (The buffer is only read from.)
+  return Request{Type::kWrite, fd, const_cast<void*>(buffer), size, offset};
+}
+
+AsyncIO::Request AsyncIO::Request::Fsync(int fd) {
+  return Request{Type::kFsync, fd, nullptr, 0u, 0u};
+}
+
+// static
+std::unique_ptr<AsyncIO> AsyncIO::Create(size_t queue_depth,
+                                         size_t thread_count) {
+#if defined(FTL_ASYNC_IO_URING)
+  std::unique_ptr<internal::AsyncIOBackend> backend =
+      internal::IOUringBackend::Create(queue_depth);
+  if (backend) {
+    return std::unique_ptr<AsyncIO>(
+        new AsyncIO(std::move(backend), Backend::kIOUring));
+  }
+#endif
+  return CreateWithThreads(thread_count);
+}
+
+// static
+std::unique_ptr<AsyncIO> AsyncIO::CreateWithThreads(size_t thread_count) {
+  std::unique_ptr<internal::AsyncIOBackend> backend =
+      internal::ThreadPoolBackend::Create(thread_count);
+  if (!backend)
+    return nullptr;
+  return std::unique_ptr<AsyncIO>(
+      new AsyncIO(std::move(backend), Backend::kThreadPool));
+}
+
+AsyncIO::AsyncIO(std::unique_ptr<internal::AsyncIOBackend> backend,
+                 Backend backend_type)
+    : backend_(std::move(backend)), backend_type_(backend_type) {}
+
+AsyncIO::~AsyncIO() = default;
+
+void AsyncIO::Submit(const Request& request,
+                     ftl::RefPtr<ftl::TaskRunner> task_runner,
+                     Callback callback) {
+  FTL_DCHECK(callback);
+  Submit(request).Then(std::move(task_runner), std::move(callback));
+}
+
+ftl::Future<ssize_t> AsyncIO::Submit(const Request& request) {
+  return std::move(SubmitBatch(std::vector<Request>{request}).front());
+}
+
+std::vector<ftl::Future<ssize_t>> AsyncIO::SubmitBatch(
+    const std::vector<Request>& requests) {
+  internal::OperationList operations;
+  std::vector<ftl::Future<ssize_t>> futures;
+  operations.reserve(requests.size());
+  futures.reserve(requests.size());
+  for (const Request& request : requests) {
+    operations.emplace_back(new internal::AsyncIOOperation());
+    operations.back()->request = request;
+    futures.push_back(operations.back()->promise.GetFuture());
+  }
+  backend_->Submit(std::move(operations));
+  return futures;
+}
+
+}  // namespace files
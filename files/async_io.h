@@ -0,0 +1,109 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_ASYNC_IO_H_
+#define LIB_FTL_FILES_ASYNC_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/future.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace files {
+
+namespace internal {
+class AsyncIOBackend;
+}  // namespace internal
+
+// Reads, writes and syncs files without blocking the calling thread (e.g., a
+// |MessageLoop|'s), completing each operation through a callback posted to a
+// |TaskRunner| or through a |Future|:
+//
+//   auto io = AsyncIO::Create();
+//   io->Submit(AsyncIO::Request::Read(fd, buffer, size, 0u), loop_runner,
+//              [](ssize_t result) { ... });
+//
+// On Linux, this uses io_uring: requests go on a queue shared with the kernel
+// (so a batch of them costs one system call, see |SubmitBatch()|), and a
+// thread waits for their completions. Elsewhere (or if io_uring isn't
+// available, e.g., on older kernels), requests are run with blocking calls on
+// a |ThreadPool|.
+//
+// Operations are positioned (like |pread()|/|pwrite()|), and may run in any
+// order. The file descriptors and buffers must stay valid until they complete.
+// This is thread-safe.
+class FTL_EXPORT AsyncIO {
+ public:
+  struct Request {
+    enum class Type { kRead, kWrite, kFsync };
+
+    static Request Read(int fd, void* buffer, size_t size, uint64_t offset);
+    static Request Write(int fd,
+                         const void* buffer,
+                         size_t size,
+                         uint64_t offset);
+    static Request Fsync(int fd);
+
+    Type type;
+    int fd;
+    void* buffer;
+    size_t size;
+    uint64_t offset;
+  };
+
+  // Called with the result of an operation: the number of bytes read or
+  // written (which, as with |read()|, may be fewer than requested; 0 for a
+  // read at the end of the file), 0 for a successful sync, or -errno.
+  using Callback = std::function<void(ssize_t result)>;
+
+  enum class Backend { kIOUring, kThreadPool };
+
+  // Creates an engine which runs up to |queue_depth| operations at once
+  // (queueing any more), using io_uring if possible and otherwise
+  // |thread_count| threads. Returns null on failure.
+  static std::unique_ptr<AsyncIO> Create(size_t queue_depth = 64u,
+                                         size_t thread_count = 4u);
+  // Like |Create()|, but always uses threads.
+  static std::unique_ptr<AsyncIO> CreateWithThreads(size_t thread_count = 4u);
+
+  // Waits for the outstanding operations to complete (their callbacks are
+  // still posted).
+  ~AsyncIO();
+
+  Backend backend() const { return backend_type_; }
+
+  // Starts |request|, and posts |callback| to |task_runner| with its result.
+  void Submit(const Request& request,
+              ftl::RefPtr<ftl::TaskRunner> task_runner,
+              Callback callback);
+  // Starts |request|, returning a future for its result.
+  ftl::Future<ssize_t> Submit(const Request& request);
+
+  // Starts all of |requests| at once, returning futures for their results (in
+  // the same order; see |ftl::WhenAll()|).
+  std::vector<ftl::Future<ssize_t>> SubmitBatch(
+      const std::vector<Request>& requests);
+
+ private:
+  AsyncIO(std::unique_ptr<internal::AsyncIOBackend> backend,
+          Backend backend_type);
+
+  std::unique_ptr<internal::AsyncIOBackend> backend_;
+  const Backend backend_type_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(AsyncIO);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_ASYNC_IO_H_
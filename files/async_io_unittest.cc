@@ -0,0 +1,166 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/async_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/message_loop.h"
+
+namespace files {
+namespace {
+
+class AsyncIOTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loop_ = ftl::MakeRefCounted<ftl::MessageLoop>();
+    ASSERT_TRUE(loop_->Start());
+    ASSERT_TRUE(dir_.NewTempFile(&path_));
+    fd_.reset(open(path_.c_str(), O_RDWR));
+    ASSERT_TRUE(fd_.is_valid());
+  }
+
+  void TearDown() override { loop_->QuitAndJoin(); }
+
+  // Returns the default engine (which uses io_uring, if it's available) and
+  // one which uses threads.
+  static std::vector<std::unique_ptr<AsyncIO>> CreateEngines() {
+    std::vector<std::unique_ptr<AsyncIO>> engines;
+    engines.push_back(AsyncIO::Create(8u));
+    engines.push_back(AsyncIO::CreateWithThreads(2u));
+    EXPECT_EQ(AsyncIO::Backend::kThreadPool, engines.back()->backend());
+    return engines;
+  }
+
+  ssize_t Wait(ftl::Future<ssize_t> future) {
+    ftl::AutoResetWaitableEvent done;
+    ssize_t result = 0;
+    future.Then(loop_, [&done, &result](ssize_t value) {
+      result = value;
+      done.Signal();
+    });
+    done.Wait();
+    return result;
+  }
+
+  ftl::RefPtr<ftl::MessageLoop> loop_;
+  ScopedTempDir dir_;
+  std::string path_;
+  ftl::UniqueFD fd_;
+};
+
+TEST_F(AsyncIOTest, WriteFsyncRead) {
+  for (auto& io : CreateEngines()) {
+    const std::string content = "Hello World";
+    EXPECT_EQ(static_cast<ssize_t>(content.size()),
+              Wait(io->Submit(AsyncIO::Request::Write(
+                  fd_.get(), content.data(), content.size(), 0u))));
+    EXPECT_EQ(0, Wait(io->Submit(AsyncIO::Request::Fsync(fd_.get()))));
+
+    std::string read_content;
+    ASSERT_TRUE(ReadFileToString(path_, &read_content));
+    EXPECT_EQ(content, read_content);
+
+    char buffer[16];
+    EXPECT_EQ(5, Wait(io->Submit(
+                     AsyncIO::Request::Read(fd_.get(), buffer, 5u, 6u))));
+    EXPECT_EQ("World", std::string(buffer, 5u));
+    // Reads are short at the end of the file.
+    EXPECT_EQ(3, Wait(io->Submit(AsyncIO::Request::Read(
+                     fd_.get(), buffer, sizeof(buffer), 8u))));
+    EXPECT_EQ(0, Wait(io->Submit(AsyncIO::Request::Read(
+                     fd_.get(), buffer, sizeof(buffer), 100u))));
+  }
+}
+
+TEST_F(AsyncIOTest, Error) {
+  for (auto& io : CreateEngines()) {
+    char buffer[16];
+    EXPECT_EQ(-EBADF, Wait(io->Submit(
+                          AsyncIO::Request::Read(-1, buffer, 1u, 0u))));
+  }
+}
+
+TEST_F(AsyncIOTest, Callback) {
+  for (auto& io : CreateEngines()) {
+    const std::string content = "x";
+    ftl::AutoResetWaitableEvent done;
+    ssize_t result = 0;
+    bool ran_on_loop = false;
+    io->Submit(
+        AsyncIO::Request::Write(fd_.get(), content.data(), 1u, 0u), loop_,
+        [this, &done, &result, &ran_on_loop](ssize_t value) {
+          result = value;
+          ran_on_loop = loop_->RunsTasksOnCurrentThread();
+          done.Signal();
+        });
+    done.Wait();
+    EXPECT_EQ(1, result);
+    EXPECT_TRUE(ran_on_loop);
+  }
+}
+
+TEST_F(AsyncIOTest, Batch) {
+  // More blocks than the io_uring engine's queue depth, so that some wait
+  // their turn.
+  constexpr size_t kBlockCount = 100u;
+  constexpr size_t kBlockSize = 64u;
+  std::string content;
+  for (size_t i = 0; i < kBlockCount * kBlockSize; i++)
+    content.push_back(static_cast<char>('a' + i % 23));
+  ASSERT_TRUE(WriteFile(path_, content.data(), content.size()));
+
+  for (auto& io : CreateEngines()) {
+    std::string read_content(content.size(), '\0');
+    std::vector<AsyncIO::Request> requests;
+    for (size_t i = 0; i < kBlockCount; i++) {
+      requests.push_back(AsyncIO::Request::Read(
+          fd_.get(), &read_content[i * kBlockSize], kBlockSize,
+          i * kBlockSize));
+    }
+    std::vector<ftl::Future<ssize_t>> futures = io->SubmitBatch(requests);
+    ASSERT_EQ(kBlockCount, futures.size());
+
+    ftl::AutoResetWaitableEvent done;
+    std::vector<ssize_t> results;
+    ftl::WhenAll(std::move(futures))
+        .Then(loop_, [&done, &results](std::vector<ssize_t> values) {
+          results = std::move(values);
+          done.Signal();
+        });
+    done.Wait();
+    EXPECT_EQ(std::vector<ssize_t>(kBlockCount, kBlockSize), results);
+    EXPECT_EQ(content, read_content);
+  }
+}
+
+TEST_F(AsyncIOTest, DestructionWaitsForOperations) {
+  for (auto& io : CreateEngines()) {
+    constexpr size_t kCount = 50u;
+    std::vector<AsyncIO::Request> requests;
+    for (size_t i = 0; i < kCount; i++)
+      requests.push_back(AsyncIO::Request::Write(fd_.get(), "y", 1u, i));
+    std::vector<ftl::Future<ssize_t>> futures = io->SubmitBatch(requests);
+    io.reset();
+
+    for (auto& future : futures)
+      EXPECT_EQ(1, Wait(std::move(future)));
+    std::string read_content;
+    ASSERT_TRUE(ReadFileToString(path_, &read_content));
+    EXPECT_EQ(std::string(kCount, 'y'), read_content);
+  }
+}
+
+}  // namespace
+}  // namespace files
@@ -0,0 +1,158 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/buffered_writer.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/logging.h"
+
+namespace files {
+namespace {
+
+bool SyncData(int fd) {
+#if defined(OS_MACOSX) || defined(OS_IOS)
+  return HANDLE_EINTR(fsync(fd)) == 0;
+#else
+  return HANDLE_EINTR(fdatasync(fd)) == 0;
+#endif
+}
+
+}  // namespace
+
+BufferedWriter::BufferedWriter(ftl::UniqueFD fd)
+    : BufferedWriter(std::move(fd), Options()) {}
+
+BufferedWriter::BufferedWriter(ftl::UniqueFD fd, const Options& options)
+    : fd_(std::move(fd)), options_(options) {
+  FTL_DCHECK(fd_.is_valid());
+  FTL_DCHECK(options_.buffer_size > 0u);
+  buffer_.reserve(options_.buffer_size);
+}
+
+BufferedWriter::~BufferedWriter() {
+  ftl::MutexLocker locker(&mutex_);
+  FTL_DCHECK(!sync_in_progress_);
+  FlushLocked();
+}
+
+bool BufferedWriter::Append(ftl::StringView data) {
+  ftl::MutexLocker locker(&mutex_);
+  if (failed_)
+    return false;
+  bytes_appended_ += data.size();
+  if (buffer_.size() + data.size() > options_.buffer_size) {
+    // Write big appends along with the buffer, rather than copying them.
+    if (data.size() >= options_.buffer_size)
+      return WriteLocked(data);
+    if (!FlushLocked())
+      return false;
+  }
+
+  const bool has_max_delay = options_.max_delay != ftl::TimeDelta::Max();
+  const ftl::TimePoint now =
+      has_max_delay ? ftl::TimePoint::Now() : ftl::TimePoint();
+  if (buffer_.empty())
+    buffered_since_ = now;
+  buffer_.append(data.data(), data.size());
+  if (buffer_.size() == options_.buffer_size ||
+      (has_max_delay && IsDueLocked(now)))
+    return FlushLocked();
+  return true;
+}
+
+bool BufferedWriter::Flush() {
+  ftl::MutexLocker locker(&mutex_);
+  return FlushLocked();
+}
+
+bool BufferedWriter::FlushIfDue() {
+  ftl::MutexLocker locker(&mutex_);
+  if (failed_)
+    return false;
+  if (!IsDueLocked(ftl::TimePoint::Now()))
+    return true;
+  return FlushLocked();
+}
+
+bool BufferedWriter::Sync() {
+  ftl::MutexLocker locker(&mutex_);
+  const uint64_t target = bytes_appended_;
+  for (;;) {
+    if (failed_)
+      return false;
+    if (bytes_synced_ >= target)
+      return true;
+    if (!sync_in_progress_)
+      break;
+    // A sync is in progress, but it may not cover everything up to |target|.
+    sync_done_cv_.Wait(&mutex_);
+  }
+
+  // Lead a sync, which covers everything appended so far (including by
+  // callers waiting for this one).
+  if (!FlushLocked())
+    return false;
+  const uint64_t syncing = bytes_written_;
+  sync_in_progress_ = true;
+  // Sync without the lock, so that appends (and other callers' |Sync()|s,
+  // which will wait for this one) needn't wait.
+  mutex_.Unlock();
+  bool synced = SyncData(fd_.get());
+  mutex_.Lock();
+  sync_in_progress_ = false;
+  sync_count_++;
+  if (synced)
+    bytes_synced_ = std::max(bytes_synced_, syncing);
+  else
+    failed_ = true;
+  sync_done_cv_.SignalAll();
+  return synced;
+}
+
+uint64_t BufferedWriter::bytes_appended() const {
+  ftl::MutexLocker locker(&mutex_);
+  return bytes_appended_;
+}
+
+uint64_t BufferedWriter::sync_count() const {
+  ftl::MutexLocker locker(&mutex_);
+  return sync_count_;
+}
+
+bool BufferedWriter::FlushLocked() {
+  if (failed_)
+    return false;
+  if (buffer_.empty())
+    return true;
+  return WriteLocked(ftl::StringView());
+}
+
+bool BufferedWriter::WriteLocked(ftl::StringView data) {
+  struct iovec iov[2] = {
+      {&buffer_[0], buffer_.size()},
+      {const_cast<char*>(data.data()), data.size()},
+  };
+  if (!ftl::WriteFileDescriptorV(fd_.get(), iov, 2)) {
+    failed_ = true;
+    return false;
+  }
+  buffer_.clear();
+  bytes_written_ = bytes_appended_;
+  return true;
+}
+
+bool BufferedWriter::IsDueLocked(ftl::TimePoint now) const {
+  return !buffer_.empty() && options_.max_delay != ftl::TimeDelta::Max() &&
+         now - buffered_since_ >= options_.max_delay;
+}
+
+}  // namespace files
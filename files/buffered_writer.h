@@ -0,0 +1,107 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_BUFFERED_WRITER_H_
+#define LIB_FTL_FILES_BUFFERED_WRITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace files {
+
+// Appends to a file (e.g., a journal) through a buffer, so that small records
+// don't each cost a system call, e.g.:
+//
+//   BufferedWriter writer(ftl::UniqueFD(open(path, O_WRONLY | O_APPEND)));
+//   writer.Append(record);
+//   ...
+//   if (!writer.Sync()) { ... }  // All the records so far are durable.
+//
+// The buffer is written out once it's full, or on the first |Append()| (or
+// |FlushIfDue()|) once its oldest data has waited |Options::max_delay|.
+//
+// This is thread-safe. |Sync()| is a group commit: callers that arrive while a
+// sync is in progress wait for it to finish, and then one sync covers all of
+// them.
+//
+// After a write or sync fails, the writer stays failed: every call returns
+// false.
+class FTL_EXPORT BufferedWriter {
+ public:
+  struct Options {
+    // The buffer's capacity. Appends at least this big are written directly.
+    size_t buffer_size = 64u * 1024u;
+    // The longest data waits in the buffer (checked when an append arrives,
+    // or by |FlushIfDue()|), or |TimeDelta::Max()| for no limit.
+    ftl::TimeDelta max_delay = ftl::TimeDelta::Max();
+  };
+
+  // Writes to |fd| at its current offset.
+  explicit BufferedWriter(ftl::UniqueFD fd);
+  BufferedWriter(ftl::UniqueFD fd, const Options& options);
+
+  // Writes out the buffer (but doesn't sync it).
+  ~BufferedWriter();
+
+  // Appends |data|. Returns false if the writer has failed.
+  bool Append(ftl::StringView data);
+
+  // Writes out the buffer.
+  bool Flush();
+
+  // Writes out the buffer if its oldest data has waited |Options::max_delay|
+  // (e.g., for a repeating timer to call).
+  bool FlushIfDue();
+
+  // Writes out the buffer and waits until everything appended before this was
+  // called is durable (with |fdatasync()|).
+  bool Sync();
+
+  // The number of bytes appended so far.
+  uint64_t bytes_appended() const;
+  // The number of times the file has been synced, for monitoring how well
+  // |Sync()|s are grouped.
+  uint64_t sync_count() const;
+
+ private:
+  bool FlushLocked() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Writes out the buffer, followed by |data|.
+  bool WriteLocked(ftl::StringView data) FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool IsDueLocked(ftl::TimePoint now) const
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const ftl::UniqueFD fd_;
+  const Options options_;
+
+  mutable ftl::Mutex mutex_;
+  // Signaled when a sync finishes.
+  ftl::CondVar sync_done_cv_;
+  std::string buffer_ FTL_GUARDED_BY(mutex_);
+  // When the oldest data in |buffer_| was appended.
+  ftl::TimePoint buffered_since_ FTL_GUARDED_BY(mutex_);
+  uint64_t bytes_appended_ FTL_GUARDED_BY(mutex_) = 0u;
+  uint64_t bytes_written_ FTL_GUARDED_BY(mutex_) = 0u;
+  uint64_t bytes_synced_ FTL_GUARDED_BY(mutex_) = 0u;
+  uint64_t sync_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  bool sync_in_progress_ FTL_GUARDED_BY(mutex_) = false;
+  bool failed_ FTL_GUARDED_BY(mutex_) = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BufferedWriter);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_BUFFERED_WRITER_H_
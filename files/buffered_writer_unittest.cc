@@ -0,0 +1,147 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/buffered_writer.h"
+
+#include <fcntl.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/synchronization/sleep.h"
+
+namespace files {
+namespace {
+
+class BufferedWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ASSERT_TRUE(dir_.NewTempFile(&path_)); }
+
+  ftl::UniqueFD OpenForAppend() {
+    return ftl::UniqueFD(open(path_.c_str(), O_WRONLY | O_APPEND));
+  }
+
+  std::string ReadContents() {
+    std::string contents;
+    EXPECT_TRUE(ReadFileToString(path_, &contents));
+    return contents;
+  }
+
+  ScopedTempDir dir_;
+  std::string path_;
+};
+
+TEST_F(BufferedWriterTest, Buffers) {
+  BufferedWriter::Options options;
+  options.buffer_size = 8u;
+  BufferedWriter writer(OpenForAppend(), options);
+
+  EXPECT_TRUE(writer.Append(ftl::StringView("abc")));
+  EXPECT_TRUE(writer.Append(ftl::StringView("def")));
+  EXPECT_EQ("", ReadContents());
+  // This doesn't fit, so the buffer is written out first.
+  EXPECT_TRUE(writer.Append(ftl::StringView("ghi")));
+  EXPECT_EQ("abcdef", ReadContents());
+  // Filling the buffer writes it out.
+  EXPECT_TRUE(writer.Append(ftl::StringView("jklmn")));
+  EXPECT_EQ("abcdefghijklmn", ReadContents());
+
+  EXPECT_TRUE(writer.Append(ftl::StringView("o")));
+  EXPECT_TRUE(writer.Flush());
+  EXPECT_EQ("abcdefghijklmno", ReadContents());
+  EXPECT_EQ(15u, writer.bytes_appended());
+}
+
+TEST_F(BufferedWriterTest, BigAppend) {
+  BufferedWriter::Options options;
+  options.buffer_size = 8u;
+  BufferedWriter writer(OpenForAppend(), options);
+
+  EXPECT_TRUE(writer.Append(ftl::StringView("abc")));
+  std::string big(100u, 'x');
+  EXPECT_TRUE(writer.Append(big));
+  EXPECT_EQ("abc" + big, ReadContents());
+}
+
+TEST_F(BufferedWriterTest, FlushesOnDestruction) {
+  {
+    BufferedWriter writer(OpenForAppend());
+    EXPECT_TRUE(writer.Append(ftl::StringView("abc")));
+    EXPECT_EQ("", ReadContents());
+  }
+  EXPECT_EQ("abc", ReadContents());
+}
+
+TEST_F(BufferedWriterTest, MaxDelay) {
+  BufferedWriter::Options options;
+  options.max_delay = ftl::TimeDelta::FromMilliseconds(1);
+  BufferedWriter writer(OpenForAppend(), options);
+
+  EXPECT_TRUE(writer.FlushIfDue());
+  EXPECT_TRUE(writer.Append(ftl::StringView("abc")));
+  ftl::SleepFor(ftl::TimeDelta::FromMilliseconds(5));
+  EXPECT_TRUE(writer.FlushIfDue());
+  EXPECT_EQ("abc", ReadContents());
+
+  EXPECT_TRUE(writer.Append(ftl::StringView("def")));
+  ftl::SleepFor(ftl::TimeDelta::FromMilliseconds(5));
+  EXPECT_TRUE(writer.Append(ftl::StringView("ghi")));
+  EXPECT_EQ("abcdefghi", ReadContents());
+}
+
+TEST_F(BufferedWriterTest, Sync) {
+  BufferedWriter writer(OpenForAppend());
+  // There's nothing to sync yet.
+  EXPECT_TRUE(writer.Sync());
+  EXPECT_EQ(0u, writer.sync_count());
+
+  EXPECT_TRUE(writer.Append(ftl::StringView("abc")));
+  EXPECT_TRUE(writer.Sync());
+  EXPECT_EQ("abc", ReadContents());
+  EXPECT_EQ(1u, writer.sync_count());
+  EXPECT_TRUE(writer.Sync());
+  EXPECT_EQ(1u, writer.sync_count());
+}
+
+TEST_F(BufferedWriterTest, ConcurrentSyncs) {
+  constexpr size_t kThreadCount = 8u;
+  constexpr size_t kRecordCount = 50u;
+  BufferedWriter writer(OpenForAppend());
+
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kThreadCount; i++) {
+    threads.push_back(std::thread([&writer, i] {
+      std::string record(10u, static_cast<char>('a' + i));
+      for (size_t j = 0; j < kRecordCount; j++) {
+        EXPECT_TRUE(writer.Append(record));
+        EXPECT_TRUE(writer.Sync());
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_LE(writer.sync_count(), kThreadCount * kRecordCount);
+  std::string contents = ReadContents();
+  ASSERT_EQ(kThreadCount * kRecordCount * 10u, contents.size());
+  // Records aren't interleaved.
+  for (size_t i = 0; i < contents.size(); i += 10u)
+    EXPECT_EQ(std::string(10u, contents[i]), contents.substr(i, 10u));
+}
+
+TEST_F(BufferedWriterTest, Failure) {
+  // A read-only file descriptor can't be written.
+  BufferedWriter writer(ftl::UniqueFD(open(path_.c_str(), O_RDONLY)));
+  EXPECT_TRUE(writer.Append(ftl::StringView("abc")));
+  EXPECT_FALSE(writer.Flush());
+  EXPECT_FALSE(writer.Append(ftl::StringView("def")));
+  EXPECT_FALSE(writer.Sync());
+}
+
+}  // namespace
+}  // namespace files
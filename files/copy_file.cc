@@ -0,0 +1,156 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/copy_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+#include "lib/ftl/build_config.h"
+
+#if defined(OS_LINUX)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/unique_fd.h"
+
+namespace files {
+namespace {
+
+// The buffer for copying through user space.
+constexpr size_t kBufferSize = 1024u * 1024u;
+
+int64_t CopyThroughBuffer(int in_fd,
+                          int out_fd,
+                          uint64_t offset,
+                          uint64_t length) {
+  const size_t buffer_size =
+      static_cast<size_t>(std::min<uint64_t>(length, kBufferSize));
+  std::unique_ptr<char[]> buffer(new char[buffer_size]);
+  uint64_t total = 0u;
+  while (total < length) {
+    const size_t size =
+        static_cast<size_t>(std::min<uint64_t>(length - total, buffer_size));
+    ssize_t bytes_read = ftl::PReadFileDescriptor(
+        in_fd, buffer.get(), size, static_cast<off_t>(offset + total));
+    if (bytes_read < 0)
+      return -1;
+    if (bytes_read > 0 &&
+        !ftl::WriteFileDescriptor(out_fd, buffer.get(), bytes_read))
+      return -1;
+    total += bytes_read;
+    // |PReadFileDescriptor()| only stops short at the end of the file.
+    if (static_cast<size_t>(bytes_read) < size)
+      break;
+  }
+  return static_cast<int64_t>(total);
+}
+
+#if defined(OS_LINUX)
+
+// The most to ask the kernel to copy at once.
+constexpr size_t kMaxChunkSize = 1u << 30;
+
+// Copies with |transfer(position, size)| (which wraps |copy_file_range()| or
+// |sendfile()|, and returns the number of bytes copied or -1), like
+// |SendFile()|. If it fails (or reports the end of the file) before copying
+// anything, sets |*unsupported| and returns 0, since it may just not support
+// the file descriptors (e.g., for |copy_file_range()|, files on different file
+// systems on older kernels, or files in /proc, which it finds empty).
+template <typename Transfer>
+int64_t TransferAll(uint64_t offset,
+                    uint64_t length,
+                    Transfer transfer,
+                    bool* unsupported) {
+  *unsupported = false;
+  uint64_t total = 0u;
+  while (total < length) {
+    const size_t size =
+        static_cast<size_t>(std::min<uint64_t>(length - total, kMaxChunkSize));
+    ssize_t result = HANDLE_EINTR(transfer(offset + total, size));
+    if (result <= 0 && !total) {
+      *unsupported = true;
+      return 0;
+    }
+    if (result < 0)
+      return -1;
+    if (result == 0)
+      break;
+    total += static_cast<uint64_t>(result);
+  }
+  return static_cast<int64_t>(total);
+}
+
+#endif  // defined(OS_LINUX)
+
+}  // namespace
+
+bool CopyFile(const std::string& source, const std::string& destination) {
+  ftl::UniqueFD in_fd(HANDLE_EINTR(open(source.c_str(), O_RDONLY)));
+  if (!in_fd.is_valid())
+    return false;
+  struct stat stat_buffer;
+  if (fstat(in_fd.get(), &stat_buffer) != 0 || S_ISDIR(stat_buffer.st_mode))
+    return false;
+  ftl::UniqueFD out_fd(HANDLE_EINTR(open(destination.c_str(),
+                                         O_WRONLY | O_CREAT | O_TRUNC,
+                                         stat_buffer.st_mode & 0777)));
+  if (!out_fd.is_valid())
+    return false;
+
+#if defined(OS_LINUX) && defined(FICLONE)
+  if (S_ISREG(stat_buffer.st_mode) &&
+      ioctl(out_fd.get(), FICLONE, in_fd.get()) == 0)
+    return true;
+#endif
+
+  // Copy up to the end of the file, which may be past its size (e.g., in
+  // /proc, where files report a size of 0).
+  return SendFile(in_fd.get(), out_fd.get(), 0u,
+                  std::numeric_limits<int64_t>::max()) >= 0;
+}
+
+int64_t SendFile(int in_fd, int out_fd, uint64_t offset, uint64_t length) {
+  if (!length)
+    return 0;
+#if defined(OS_LINUX)
+  bool unsupported;
+  int64_t result;
+#if defined(__NR_copy_file_range)
+  result = TransferAll(
+      offset, length,
+      [in_fd, out_fd](uint64_t position, size_t size) {
+        loff_t in_offset = static_cast<loff_t>(position);
+        return static_cast<ssize_t>(syscall(__NR_copy_file_range, in_fd,
+                                            &in_offset, out_fd, nullptr,
+                                            size, 0u));
+      },
+      &unsupported);
+  if (!unsupported)
+    return result;
+#endif
+  result = TransferAll(offset, length,
+                       [in_fd, out_fd](uint64_t position, size_t size) {
+                         off_t in_offset = static_cast<off_t>(position);
+                         return sendfile(out_fd, in_fd, &in_offset, size);
+                       },
+                       &unsupported);
+  if (!unsupported)
+    return result;
+#endif
+  return CopyThroughBuffer(in_fd, out_fd, offset, length);
+}
+
+}  // namespace files
@@ -0,0 +1,37 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_COPY_FILE_H_
+#define LIB_FTL_FILES_COPY_FILE_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace files {
+
+// Copies the file at |source| to |destination| (replacing its contents, or
+// creating it with |source|'s permissions), without passing the data through
+// user space where possible: on Linux, by sharing its blocks (a reflink, on
+// file systems that support it), or with |copy_file_range()| or |sendfile()|.
+// Returns true if the whole file was copied.
+FTL_EXPORT bool CopyFile(const std::string& source,
+                         const std::string& destination);
+
+// Copies up to |length| bytes from |in_fd|, starting at |offset| (without
+// using or moving its file offset), to |out_fd| at its current offset, e.g., a
+// file to a socket. On Linux, this uses |copy_file_range()| or |sendfile()| if
+// they support the file descriptors; otherwise (or elsewhere), it reads and
+// writes through a large buffer. Returns the number of bytes copied, which is
+// less than |length| only if the end of |in_fd| was reached, or -1 on error.
+FTL_EXPORT int64_t SendFile(int in_fd,
+                            int out_fd,
+                            uint64_t offset,
+                            uint64_t length);
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_COPY_FILE_H_
@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/copy_file.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/files/unique_fd.h"
+
+namespace files {
+namespace {
+
+std::string MakeContent(size_t size) {
+  std::string content(size, '\0');
+  for (size_t i = 0; i < size; i++)
+    content[i] = static_cast<char>((i * 7u) % 251u);
+  return content;
+}
+
+TEST(CopyFile, Copies) {
+  ScopedTempDir dir;
+  const std::string source = dir.path() + "/source";
+  const std::string destination = dir.path() + "/destination";
+
+  // Sizes around the copy buffer's.
+  for (size_t size : {0u, 1u, 1024u * 1024u + 1u, 3u * 1024u * 1024u}) {
+    const std::string content = MakeContent(size);
+    ASSERT_TRUE(WriteFile(source, content.data(), content.size()));
+    EXPECT_TRUE(CopyFile(source, destination));
+    std::string copied;
+    ASSERT_TRUE(ReadFileToString(destination, &copied));
+    EXPECT_EQ(content, copied);
+  }
+}
+
+TEST(CopyFile, ReplacesAndKeepsPermissions) {
+  ScopedTempDir dir;
+  const std::string source = dir.path() + "/source";
+  const std::string destination = dir.path() + "/destination";
+  const std::string existing = dir.path() + "/existing";
+
+  ASSERT_TRUE(WriteFile(source, "abc", 3));
+  ASSERT_EQ(0, chmod(source.c_str(), 0640));
+  EXPECT_TRUE(CopyFile(source, destination));
+  struct stat stat_buffer;
+  ASSERT_EQ(0, stat(destination.c_str(), &stat_buffer));
+  EXPECT_EQ(0640u, stat_buffer.st_mode & 0777u);
+
+  // An existing file is truncated.
+  ASSERT_TRUE(WriteFile(existing, "a longer file", 13));
+  EXPECT_TRUE(CopyFile(source, existing));
+  std::string copied;
+  ASSERT_TRUE(ReadFileToString(existing, &copied));
+  EXPECT_EQ("abc", copied);
+
+  EXPECT_FALSE(CopyFile(dir.path() + "/missing", destination));
+  EXPECT_FALSE(CopyFile(dir.path(), destination));
+}
+
+#if defined(OS_LINUX)
+TEST(CopyFile, UnknownSize) {
+  // Files in /proc report a size of 0.
+  ScopedTempDir dir;
+  const std::string destination = dir.path() + "/status";
+  EXPECT_TRUE(CopyFile("/proc/self/status", destination));
+  std::string copied;
+  ASSERT_TRUE(ReadFileToString(destination, &copied));
+  EXPECT_NE(std::string::npos, copied.find("Name:"));
+}
+#endif
+
+TEST(SendFile, FileToFile) {
+  ScopedTempDir dir;
+  const std::string source = dir.path() + "/source";
+  const std::string destination = dir.path() + "/destination";
+  const std::string content = MakeContent(10000u);
+  ASSERT_TRUE(WriteFile(source, content.data(), content.size()));
+
+  ftl::UniqueFD in_fd(open(source.c_str(), O_RDONLY));
+  ftl::UniqueFD out_fd(open(destination.c_str(), O_WRONLY | O_CREAT, 0600));
+  ASSERT_TRUE(in_fd.is_valid());
+  ASSERT_TRUE(out_fd.is_valid());
+  EXPECT_EQ(1000, SendFile(in_fd.get(), out_fd.get(), 500u, 1000u));
+  // Stops at the end of the file.
+  EXPECT_EQ(500, SendFile(in_fd.get(), out_fd.get(), 9500u, 1000u));
+  EXPECT_EQ(0, SendFile(in_fd.get(), out_fd.get(), 20000u, 1000u));
+  EXPECT_EQ(0, SendFile(in_fd.get(), out_fd.get(), 0u, 0u));
+  // |in_fd|'s offset isn't used or moved.
+  EXPECT_EQ(0, lseek(in_fd.get(), 0, SEEK_CUR));
+  EXPECT_EQ(-1, SendFile(-1, out_fd.get(), 0u, 1000u));
+
+  std::string copied;
+  ASSERT_TRUE(ReadFileToString(destination, &copied));
+  EXPECT_EQ(content.substr(500u, 1000u) + content.substr(9500u), copied);
+}
+
+TEST(SendFile, FileToPipe) {
+  ScopedTempDir dir;
+  const std::string source = dir.path() + "/source";
+  const std::string content = MakeContent(200000u);
+  ASSERT_TRUE(WriteFile(source, content.data(), content.size()));
+  ftl::UniqueFD in_fd(open(source.c_str(), O_RDONLY));
+  ASSERT_TRUE(in_fd.is_valid());
+
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ftl::UniqueFD read_fd(fds[0]);
+  ftl::UniqueFD write_fd(fds[1]);
+  std::string received(content.size(), '\0');
+  std::thread reader([&read_fd, &received] {
+    EXPECT_EQ(static_cast<ssize_t>(received.size()),
+              ftl::ReadFileDescriptor(read_fd.get(), &received[0],
+                                      received.size()));
+  });
+  EXPECT_EQ(static_cast<int64_t>(content.size()),
+            SendFile(in_fd.get(), write_fd.get(), 0u, content.size()));
+  write_fd.reset();
+  reader.join();
+  EXPECT_EQ(content, received);
+}
+
+}  // namespace
+}  // namespace files
@@ -0,0 +1,181 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/direct_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/logging.h"
+
+namespace files {
+namespace {
+
+// The most to bounce (or to read past the expected end of a file) at once.
+constexpr size_t kChunkSize = 1024u * 1024u;
+
+bool IsAligned(uint64_t value) {
+  return value % kDirectIOAlignment == 0u;
+}
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + kDirectIOAlignment - 1u) & ~uint64_t{kDirectIOAlignment - 1u};
+}
+
+}  // namespace
+
+AlignedBuffer::AlignedBuffer() = default;
+
+AlignedBuffer::AlignedBuffer(size_t size, size_t alignment) : size_(size) {
+  FTL_DCHECK(alignment && !(alignment & (alignment - 1u)));
+  if (!size)
+    return;
+  void* data = nullptr;
+  FTL_CHECK(posix_memalign(&data, std::max(alignment, sizeof(void*)), size) ==
+            0);
+  data_ = static_cast<char*>(data);
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer&& other)
+    : data_(other.data_), size_(other.size_) {
+  other.data_ = nullptr;
+  other.size_ = 0u;
+}
+
+AlignedBuffer::~AlignedBuffer() {
+  free(data_);
+}
+
+AlignedBuffer& AlignedBuffer::operator=(AlignedBuffer&& other) {
+  if (this != &other) {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+  }
+  return *this;
+}
+
+DirectFile::DirectFile() = default;
+
+DirectFile::~DirectFile() = default;
+
+bool DirectFile::Open(const std::string& path, int flags, mode_t mode) {
+  fd_.reset();
+  direct_ = false;
+#if defined(O_DIRECT)
+  fd_.reset(
+      HANDLE_EINTR(open(path.c_str(), flags | O_DIRECT | O_CLOEXEC, mode)));
+  if (fd_.is_valid()) {
+    direct_ = true;
+    return true;
+  }
+  if (errno != EINVAL)
+    return false;
+  // The file system doesn't support |O_DIRECT|. (Linux checks that after
+  // creating the file, so it may exist now.)
+  flags &= ~O_EXCL;
+#endif
+  fd_.reset(HANDLE_EINTR(open(path.c_str(), flags | O_CLOEXEC, mode)));
+  if (!fd_.is_valid())
+    return false;
+#if defined(OS_MACOSX) || defined(OS_IOS)
+  fcntl(fd_.get(), F_NOCACHE, 1);
+#endif
+  return true;
+}
+
+ssize_t DirectFile::Read(void* buffer, size_t size, uint64_t offset) const {
+  char* data = static_cast<char*>(buffer);
+  if (!direct_ || (IsAligned(reinterpret_cast<uintptr_t>(data)) &&
+                   IsAligned(size) && IsAligned(offset))) {
+    ssize_t result = ftl::PReadFileDescriptor(fd_.get(), data, size,
+                                              static_cast<off_t>(offset));
+#if defined(OS_LINUX)
+    // Don't leave the pages in the cache.
+    if (!direct_ && result > 0) {
+      posix_fadvise(fd_.get(), static_cast<off_t>(offset),
+                    static_cast<off_t>(result), POSIX_FADV_DONTNEED);
+    }
+#endif
+    return result;
+  }
+
+  // Read whole aligned blocks, and copy out the part wanted.
+  AlignedBuffer bounce(static_cast<size_t>(
+      std::min<uint64_t>(AlignUp(offset % kDirectIOAlignment + size),
+                         kChunkSize)));
+  size_t total = 0u;
+  while (total < size) {
+    const uint64_t position = offset + total;
+    const size_t skip = static_cast<size_t>(position % kDirectIOAlignment);
+    const size_t wanted = static_cast<size_t>(
+        std::min<uint64_t>(AlignUp(skip + size - total), bounce.size()));
+    ssize_t result = ftl::PReadFileDescriptor(
+        fd_.get(), bounce.data(), wanted, static_cast<off_t>(position - skip));
+    if (result < 0)
+      return total ? static_cast<ssize_t>(total) : -1;
+    if (static_cast<size_t>(result) <= skip)
+      break;
+    const size_t copied =
+        std::min(static_cast<size_t>(result) - skip, size - total);
+    memcpy(data + total, bounce.data() + skip, copied);
+    total += copied;
+    if (static_cast<size_t>(result) < wanted)
+      break;
+  }
+  return static_cast<ssize_t>(total);
+}
+
+bool DirectFile::Write(const void* buffer, size_t size, uint64_t offset) const {
+  const char* data = static_cast<const char*>(buffer);
+  if (direct_ && !(IsAligned(reinterpret_cast<uintptr_t>(data)) &&
+                   IsAligned(size) && IsAligned(offset))) {
+    errno = EINVAL;
+    return false;
+  }
+  return ftl::PWriteFileDescriptor(fd_.get(), data, size,
+                                   static_cast<off_t>(offset));
+}
+
+bool DirectFile::Truncate(uint64_t size) const {
+  return HANDLE_EINTR(ftruncate(fd_.get(), static_cast<off_t>(size))) == 0;
+}
+
+bool ReadFileDirect(const std::string& path, std::vector<uint8_t>* result) {
+  result->clear();
+  DirectFile file;
+  struct stat stat_buffer;
+  if (!file.Open(path, O_RDONLY) || fstat(file.fd(), &stat_buffer) != 0)
+    return false;
+
+  // Read the expected size, then on until the end (in case it grew).
+  size_t total = 0u;
+  size_t wanted = static_cast<size_t>(std::max<off_t>(stat_buffer.st_size, 0));
+  for (;;) {
+    result->resize(total + wanted);
+    ssize_t size =
+        wanted ? file.Read(result->data() + total, wanted, total) : 0;
+    if (size < 0) {
+      result->clear();
+      return false;
+    }
+    total += static_cast<size_t>(size);
+    if (static_cast<size_t>(size) < wanted) {
+      result->resize(total);
+      return true;
+    }
+    wanted = kChunkSize;
+  }
+}
+
+}  // namespace files
@@ -0,0 +1,105 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_DIRECT_IO_H_
+#define LIB_FTL_FILES_DIRECT_IO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+namespace files {
+
+// The alignment direct I/O needs (of buffers, sizes and offsets); enough for
+// the logical block size of practically all devices.
+constexpr size_t kDirectIOAlignment = 4096u;
+
+// A heap buffer whose start is aligned (e.g., for |DirectFile|). Like a
+// |ftl::UniqueFD|, it can be moved but not copied.
+class FTL_EXPORT AlignedBuffer {
+ public:
+  AlignedBuffer();
+  // The contents are uninitialized. |alignment| must be a power of two.
+  explicit AlignedBuffer(size_t size, size_t alignment = kDirectIOAlignment);
+  AlignedBuffer(AlignedBuffer&& other);
+  ~AlignedBuffer();
+
+  AlignedBuffer& operator=(AlignedBuffer&& other);
+
+  char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  char* data_ = nullptr;
+  size_t size_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(AlignedBuffer);
+};
+
+// A file opened for I/O that bypasses the page cache, e.g., to scan a large
+// file once without evicting the hot working set:
+//
+//   DirectFile file;
+//   if (!file.Open(path, O_RDONLY))
+//     return false;
+//   AlignedBuffer buffer(1024u * 1024u);
+//   for (uint64_t offset = 0u;; offset += buffer.size()) {
+//     ssize_t size = file.Read(buffer.data(), buffer.size(), offset);
+//     ...
+//   }
+//
+// On Linux, this uses |O_DIRECT|, which requires buffers, sizes and offsets
+// aligned to |kDirectIOAlignment|: |Read()| goes through an aligned bounce
+// buffer if its arguments aren't, and |Write()| fails. If the file system
+// doesn't support |O_DIRECT| (e.g., tmpfs), the file is opened normally
+// instead (see |is_direct()|), and the pages read are dropped from the cache
+// afterwards. On Mac, caching is turned off with |F_NOCACHE|, which has no
+// alignment requirements.
+class FTL_EXPORT DirectFile {
+ public:
+  DirectFile();
+  ~DirectFile();
+
+  // Opens |path| with |flags| (as for |open()|, e.g., |O_RDONLY|, or
+  // |O_WRONLY| | |O_CREAT|). Returns false on failure.
+  bool Open(const std::string& path, int flags, mode_t mode = 0600);
+
+  bool is_valid() const { return fd_.is_valid(); }
+  int fd() const { return fd_.get(); }
+  // Whether the file uses |O_DIRECT| (and so has alignment requirements).
+  bool is_direct() const { return direct_; }
+
+  // Reads up to |size| bytes at |offset| into |buffer|. Returns the number of
+  // bytes read (fewer only at the end of the file), or -1 on error.
+  ssize_t Read(void* buffer, size_t size, uint64_t offset) const;
+
+  // Writes |size| bytes from |buffer| at |offset|, which must all be aligned if
+  // |is_direct()| (or this fails with |EINVAL|); see |Truncate()| for a file
+  // whose size isn't aligned. Returns false on error.
+  bool Write(const void* buffer, size_t size, uint64_t offset) const;
+
+  // Sets the file's size (e.g., after writing it in aligned blocks).
+  bool Truncate(uint64_t size) const;
+
+ private:
+  ftl::UniqueFD fd_;
+  bool direct_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DirectFile);
+};
+
+// Like |ReadFileToVector()|, but bypassing the page cache.
+FTL_EXPORT bool ReadFileDirect(const std::string& path,
+                               std::vector<uint8_t>* result);
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_DIRECT_IO_H_
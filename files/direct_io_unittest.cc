@@ -0,0 +1,177 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/direct_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+std::string MakeContent(size_t size) {
+  std::string content(size, '\0');
+  for (size_t i = 0; i < size; ++i)
+    content[i] = static_cast<char>('a' + i % 23);
+  return content;
+}
+
+TEST(AlignedBuffer, Alignment) {
+  AlignedBuffer buffer(100u);
+  EXPECT_EQ(100u, buffer.size());
+  EXPECT_EQ(0u,
+            reinterpret_cast<uintptr_t>(buffer.data()) % kDirectIOAlignment);
+  AlignedBuffer small(10u, 64u);
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(small.data()) % 64u);
+
+  char* data = buffer.data();
+  AlignedBuffer moved(std::move(buffer));
+  EXPECT_EQ(data, moved.data());
+  EXPECT_EQ(100u, moved.size());
+  EXPECT_EQ(nullptr, buffer.data());
+  EXPECT_EQ(0u, buffer.size());
+
+  AlignedBuffer empty;
+  EXPECT_EQ(nullptr, empty.data());
+  EXPECT_EQ(0u, empty.size());
+}
+
+TEST(DirectFile, ReadWrite) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  const size_t size = 3u * kDirectIOAlignment;
+  const std::string content = MakeContent(size);
+
+  DirectFile file;
+  ASSERT_TRUE(file.Open(path, O_RDWR | O_CREAT | O_EXCL));
+  EXPECT_TRUE(file.is_valid());
+  AlignedBuffer buffer(size);
+  memcpy(buffer.data(), content.data(), size);
+  ASSERT_TRUE(file.Write(buffer.data(), size, 0u));
+
+  AlignedBuffer read(size);
+  ASSERT_EQ(static_cast<ssize_t>(size), file.Read(read.data(), size, 0u));
+  EXPECT_EQ(content, std::string(read.data(), size));
+
+  // Reading past the end is short.
+  ASSERT_EQ(static_cast<ssize_t>(kDirectIOAlignment),
+            file.Read(read.data(), size, 2u * kDirectIOAlignment));
+  EXPECT_EQ(content.substr(2u * kDirectIOAlignment),
+            std::string(read.data(), kDirectIOAlignment));
+  EXPECT_EQ(0, file.Read(read.data(), size, size));
+
+  // Misaligned writes fail outright (if the file system takes |O_DIRECT|).
+  if (file.is_direct()) {
+    errno = 0;
+    EXPECT_FALSE(file.Write(buffer.data() + 1, kDirectIOAlignment, 0u));
+    EXPECT_EQ(EINVAL, errno);
+    EXPECT_FALSE(file.Write(buffer.data(), 100u, 0u));
+    EXPECT_FALSE(file.Write(buffer.data(), kDirectIOAlignment, 100u));
+  }
+}
+
+TEST(DirectFile, MisalignedRead) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  const std::string content = MakeContent(3000000u);
+  ASSERT_TRUE(WriteFile(path, content.data(), content.size()));
+
+  DirectFile file;
+  ASSERT_TRUE(file.Open(path, O_RDONLY));
+  const struct {
+    size_t size;
+    uint64_t offset;
+  } cases[] = {
+      {1u, 0u},         {100u, 1u},          {5000u, 4000u},
+      {4096u, 7u},      {2500000u, 12345u},  {100u, 2999950u},
+      {100u, 3000000u}, {100u, 4000000u},
+  };
+  std::vector<char> read(2500001u);
+  for (const auto& c : cases) {
+    SCOPED_TRACE(std::to_string(c.size) + " at " + std::to_string(c.offset));
+    const size_t expected =
+        c.offset < content.size()
+            ? std::min<size_t>(c.size, content.size() - c.offset)
+            : 0u;
+    // An odd address, too.
+    ASSERT_EQ(static_cast<ssize_t>(expected),
+              file.Read(read.data() + 1, c.size, c.offset));
+    EXPECT_EQ(content.substr(std::min<size_t>(c.offset, content.size()),
+                             expected),
+              std::string(read.data() + 1, expected));
+  }
+}
+
+TEST(DirectFile, Truncate) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  const std::string content = MakeContent(5000u);
+
+  DirectFile file;
+  ASSERT_TRUE(file.Open(path, O_WRONLY | O_CREAT));
+  AlignedBuffer buffer(2u * kDirectIOAlignment);
+  memset(buffer.data(), 0, buffer.size());
+  memcpy(buffer.data(), content.data(), content.size());
+  ASSERT_TRUE(file.Write(buffer.data(), buffer.size(), 0u));
+  ASSERT_TRUE(file.Truncate(content.size()));
+
+  std::vector<uint8_t> result;
+  ASSERT_TRUE(ReadFileDirect(path, &result));
+  EXPECT_EQ(content, std::string(result.begin(), result.end()));
+}
+
+TEST(DirectFile, Errors) {
+  ScopedTempDir dir;
+  DirectFile file;
+  EXPECT_FALSE(file.Open(dir.path() + "/missing", O_RDONLY));
+  EXPECT_FALSE(file.is_valid());
+  std::vector<uint8_t> result;
+  EXPECT_FALSE(ReadFileDirect(dir.path() + "/missing", &result));
+}
+
+TEST(ReadFileDirect, Contents) {
+  ScopedTempDir dir;
+  for (size_t size : {0u, 1u, 4096u, 4097u, 1500000u}) {
+    SCOPED_TRACE(size);
+    const std::string path = dir.path() + "/" + std::to_string(size);
+    const std::string content = MakeContent(size);
+    ASSERT_TRUE(WriteFile(path, content.data(), content.size()));
+    std::vector<uint8_t> result;
+    ASSERT_TRUE(ReadFileDirect(path, &result));
+    EXPECT_EQ(content, std::string(result.begin(), result.end()));
+  }
+}
+
+#if defined(OS_LINUX)
+TEST(DirectFile, Fallback) {
+  // procfs doesn't support |O_DIRECT|, and reports a size of 0.
+  DirectFile file;
+  ASSERT_TRUE(file.Open("/proc/self/status", O_RDONLY));
+  EXPECT_FALSE(file.is_direct());
+  char buffer[7];
+  ASSERT_EQ(5, file.Read(buffer + 1, 5u, 0u));
+  EXPECT_EQ("Name:", std::string(buffer + 1, 5u));
+
+  std::vector<uint8_t> result;
+  ASSERT_TRUE(ReadFileDirect("/proc/self/status", &result));
+  std::string status(result.begin(), result.end());
+  EXPECT_EQ(0u, status.find("Name:"));
+  EXPECT_NE(std::string::npos, status.find("\nPid:"));
+}
+#endif  // defined(OS_LINUX)
+
+}  // namespace
+}  // namespace files
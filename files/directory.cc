@@ -12,8 +12,52 @@
 #include "lib/ftl/logging.h"
 #include "lib/ftl/portable_unistd.h"
 
+#if !defined(OS_WIN)
+#include <errno.h>
+#include <fcntl.h>
+
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/unique_fd.h"
+#endif
+
 namespace files {
 
+#if !defined(OS_WIN)
+namespace {
+
+bool IsDirectoryAt(int dir_fd, const char* path) {
+  struct stat buf;
+  if (fstatat(dir_fd, path, &buf, 0) != 0)
+    return false;
+  return S_ISDIR(buf.st_mode);
+}
+
+// Creates the directory |path| relative to |dir_fd|, succeeding if it's
+// already there (which may be because another process just created it).
+bool MakeDirectoryAt(int dir_fd, const char* path) {
+  if (mkdirat(dir_fd, path, 0700) == 0)
+    return true;
+  return errno == EEXIST && IsDirectoryAt(dir_fd, path);
+}
+
+// Returns where the last component of the first |length| characters of
+// |path| starts, or 0 if there's only one component.
+size_t LastComponentStart(const char* path, size_t length) {
+  while (length > 0u && path[length - 1u] != '/')
+    length--;
+  return length;
+}
+
+// Returns |length| less any trailing slashes (keeping a leading one).
+size_t TrimSlashes(const char* path, size_t length) {
+  while (length > 1u && path[length - 1u] == '/')
+    length--;
+  return length;
+}
+
+}  // namespace
+#endif  // !defined(OS_WIN)
+
 std::string GetCurrentDirectory() {
   char buffer[PATH_MAX];
   FTL_CHECK(getcwd(buffer, sizeof(buffer)));
@@ -27,6 +71,8 @@ bool IsDirectory(const std::string& path) {
   return S_ISDIR(buf.st_mode);
 }
 
+#if defined(OS_WIN)
+
 bool CreateDirectory(const std::string& full_path) {
   std::vector<std::string> subpaths;
 
@@ -55,4 +101,87 @@ bool CreateDirectory(const std::string& full_path) {
   return true;
 }
 
+#else  // defined(OS_WIN)
+
+bool CreateDirectory(const std::string& path) {
+  return CreateDirectoryAt(AT_FDCWD, path);
+}
+
+bool CreateDirectoryAt(int dir_fd, const std::string& path) {
+  std::vector<char> buffer(path.begin(), path.end());
+  buffer.push_back('\0');
+  size_t length = TrimSlashes(buffer.data(), path.size());
+  if (length == 0u)
+    return false;
+  buffer[length] = '\0';
+
+  // Walk up until a directory can be created (or already exists), ...
+  std::vector<size_t> missing;
+  for (;;) {
+    if (mkdirat(dir_fd, buffer.data(), 0700) == 0)
+      break;
+    if (errno == EEXIST) {
+      if (!IsDirectoryAt(dir_fd, buffer.data()))
+        return false;
+      break;
+    }
+    if (errno != ENOENT)
+      return false;
+    const size_t parent_length = TrimSlashes(
+        buffer.data(), LastComponentStart(buffer.data(), length));
+    if (parent_length == 0u || buffer[parent_length - 1u] == '/')
+      return false;  // There's no parent to create.
+    missing.push_back(length);
+    length = parent_length;
+    buffer[length] = '\0';
+  }
+
+  // ... then create the ones below it.
+  while (!missing.empty()) {
+    buffer[length] = '/';
+    length = missing.back();
+    missing.pop_back();
+    if (!MakeDirectoryAt(dir_fd, buffer.data()))
+      return false;
+  }
+  return true;
+}
+
+bool CreateDirectoriesAt(int dir_fd, const std::vector<std::string>& paths) {
+  std::string parent;
+  ftl::UniqueFD parent_fd;
+  for (const std::string& path : paths) {
+    const size_t length = TrimSlashes(path.data(), path.size());
+    const size_t leaf_start = LastComponentStart(path.data(), length);
+    const size_t parent_length = TrimSlashes(path.data(), leaf_start);
+    if (parent_length == 0u || path[parent_length - 1u] == '/') {
+      // There's no parent directory to open (e.g., "a" or "/a").
+      if (!CreateDirectoryAt(dir_fd, path))
+        return false;
+      continue;
+    }
+
+    if (!parent_fd.is_valid() ||
+        parent.compare(0u, std::string::npos, path, 0u, parent_length) != 0) {
+      parent.assign(path, 0u, parent_length);
+      parent_fd.reset(HANDLE_EINTR(
+          openat(dir_fd, parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+      if (!parent_fd.is_valid()) {
+        if (errno != ENOENT || !CreateDirectoryAt(dir_fd, parent))
+          return false;
+        parent_fd.reset(HANDLE_EINTR(openat(
+            dir_fd, parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+        if (!parent_fd.is_valid())
+          return false;
+      }
+    }
+    const std::string leaf(path, leaf_start, length - leaf_start);
+    if (!MakeDirectoryAt(parent_fd.get(), leaf.c_str()))
+      return false;
+  }
+  return true;
+}
+
+#endif  // defined(OS_WIN)
+
 }  // namespace files
@@ -6,7 +6,9 @@
 #define LIB_FTL_FILES_DIRECTORY_H_
 
 #include <string>
+#include <vector>
 
+#include "lib/ftl/build_config.h"
 #include "lib/ftl/ftl_export.h"
 
 namespace files {
@@ -22,6 +24,25 @@ FTL_EXPORT bool IsDirectory(const std::string& path);
 // directory.
 FTL_EXPORT bool CreateDirectory(const std::string& path);
 
+#if !defined(OS_WIN)
+
+// Like |CreateDirectory()|, but for |path| relative to the directory |dir_fd|
+// (or the current directory if it's |AT_FDCWD|). This tries to create |path|
+// first, and only walks up to create its parents if they're missing, so it
+// takes one system call when only the last component is new (or none are).
+FTL_EXPORT bool CreateDirectoryAt(int dir_fd, const std::string& path);
+
+// Creates each of |paths| (relative to |dir_fd|, as |CreateDirectoryAt()|),
+// e.g., a sharded layout's "00/00" to "ff/ff". Each directory's parent is
+// opened once for as long as consecutive paths share it, so that creating its
+// children takes one |mkdirat()| each, without the kernel looking up the
+// parent again; list siblings together to benefit. Stops at the first
+// failure, returning false.
+FTL_EXPORT bool CreateDirectoriesAt(int dir_fd,
+                                    const std::vector<std::string>& paths);
+
+#endif  // !defined(OS_WIN)
+
 }  // namespace files
 
 #endif  // LIB_FTL_FILES_DIRECTORY_H_
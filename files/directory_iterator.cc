@@ -0,0 +1,179 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/directory_iterator.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(OS_LINUX)
+#include <sys/syscall.h>
+#endif
+
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/logging.h"
+
+namespace files {
+namespace {
+
+constexpr int kOpenFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+
+bool IsDotOrDotDot(const char* name) {
+  return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+#if defined(OS_LINUX)
+
+// The fixed part of the records that |getdents64()| returns, which is followed
+// by the (null-terminated) name, at |kNameOffset|.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+};
+
+constexpr size_t kNameOffset = offsetof(LinuxDirent64, d_type) + 1u;
+
+// Big enough for hundreds of entries.
+constexpr size_t kBufferSize = 32u * 1024u;
+
+#endif  // defined(OS_LINUX)
+
+}  // namespace
+
+DirectoryIterator::DirectoryIterator() = default;
+
+DirectoryIterator::~DirectoryIterator() {
+#if !defined(OS_LINUX)
+  if (dir_) {
+    // |closedir()| closes the file descriptor.
+    closedir(dir_);
+    fd_.release();
+  }
+#endif
+}
+
+bool DirectoryIterator::Open(const std::string& path) {
+  FTL_DCHECK(!fd_.is_valid());
+  fd_.reset(HANDLE_EINTR(open(path.c_str(), kOpenFlags)));
+  return Init();
+}
+
+bool DirectoryIterator::OpenAt(int dir_fd, const char* name) {
+  FTL_DCHECK(!fd_.is_valid());
+  fd_.reset(HANDLE_EINTR(openat(dir_fd, name, kOpenFlags | O_NOFOLLOW)));
+  return Init();
+}
+
+bool DirectoryIterator::Init() {
+  if (!fd_.is_valid()) {
+    error_ = errno;
+    return false;
+  }
+#if defined(OS_LINUX)
+  buffer_.reset(new char[kBufferSize]);
+#else
+  dir_ = fdopendir(fd_.get());
+  if (!dir_) {
+    error_ = errno;
+    fd_.reset();
+    return false;
+  }
+#endif
+  return true;
+}
+
+bool DirectoryIterator::Next(Entry* entry) {
+  FTL_DCHECK(entry);
+  if (!fd_.is_valid() || error_)
+    return false;
+  for (;;) {
+    const char* name;
+    unsigned char d_type;
+#if defined(OS_LINUX)
+    if (position_ == buffer_size_ && !ReadBatch())
+      return false;
+    LinuxDirent64 header;
+    memcpy(&header, &buffer_[position_], kNameOffset);
+    name = &buffer_[position_ + kNameOffset];
+    d_type = header.d_type;
+    position_ += header.d_reclen;
+#else
+    errno = 0;
+    struct dirent* dirent = readdir(dir_);
+    if (!dirent) {
+      error_ = errno;
+      return false;
+    }
+    name = dirent->d_name;
+    d_type = dirent->d_type;
+#endif
+    if (IsDotOrDotDot(name))
+      continue;
+
+    switch (d_type) {
+      case DT_REG:
+        entry->type = Type::kFile;
+        break;
+      case DT_DIR:
+        entry->type = Type::kDirectory;
+        break;
+      case DT_LNK:
+        entry->type = Type::kSymlink;
+        break;
+      case DT_UNKNOWN: {
+        // Some file systems don't record types in directories.
+        struct stat stat_buffer;
+        if (fstatat(fd_.get(), name, &stat_buffer, AT_SYMLINK_NOFOLLOW) != 0) {
+          // Skip entries removed since the directory was read.
+          if (errno == ENOENT)
+            continue;
+          error_ = errno;
+          return false;
+        }
+        entry->type = S_ISREG(stat_buffer.st_mode)
+                          ? Type::kFile
+                          : S_ISDIR(stat_buffer.st_mode)
+                                ? Type::kDirectory
+                                : S_ISLNK(stat_buffer.st_mode)
+                                      ? Type::kSymlink
+                                      : Type::kOther;
+        break;
+      }
+      default:
+        entry->type = Type::kOther;
+        break;
+    }
+    entry->name = ftl::StringView(name, strlen(name));
+    return true;
+  }
+}
+
+#if defined(OS_LINUX)
+bool DirectoryIterator::ReadBatch() {
+  if (at_end_)
+    return false;
+  long result =
+      HANDLE_EINTR(syscall(SYS_getdents64, fd_.get(), buffer_.get(),
+                           kBufferSize));
+  if (result <= 0) {
+    if (result < 0)
+      error_ = errno;
+    at_end_ = true;
+    return false;
+  }
+  buffer_size_ = static_cast<size_t>(result);
+  position_ = 0u;
+  return true;
+}
+#endif
+
+}  // namespace files
@@ -0,0 +1,97 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_DIRECTORY_ITERATOR_H_
+#define LIB_FTL_FILES_DIRECTORY_ITERATOR_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+#if !defined(OS_LINUX)
+#include <dirent.h>
+#endif
+
+namespace files {
+
+// Lists the entries of a directory (other than "." and ".."), with their
+// types, e.g.:
+//
+//   DirectoryIterator it;
+//   if (!it.Open(path)) { ... }
+//   DirectoryIterator::Entry entry;
+//   while (it.Next(&entry)) {
+//     if (entry.type == DirectoryIterator::Type::kFile)
+//       unlinkat(it.fd(), entry.name.data(), 0);
+//   }
+//   if (it.error()) { ... }
+//
+// Entries' names are relative to the directory, so that they may be used
+// with |it.fd()| and |openat()|, |fstatat()|, |unlinkat()| etc., rather than
+// building a path for each one. On Linux, entries are read in large batches
+// with |getdents64()|; elsewhere, with |readdir()|. Entries added or removed
+// while iterating may or may not be listed.
+class FTL_EXPORT DirectoryIterator {
+ public:
+  // An entry's type (without following symbolic links).
+  enum class Type { kFile, kDirectory, kSymlink, kOther };
+
+  struct Entry {
+    // Null-terminated, and valid until the next call to |Next()|.
+    ftl::StringView name;
+    Type type;
+  };
+
+  DirectoryIterator();
+  ~DirectoryIterator();
+
+  // Opens the directory at |path|. Returns false on failure.
+  bool Open(const std::string& path);
+  // Opens the directory |name| in the directory |dir_fd| (or relative to the
+  // current directory if it's |AT_FDCWD|), without following a symbolic link.
+  bool OpenAt(int dir_fd, const char* name);
+
+  // The directory's file descriptor (owned by this).
+  int fd() const { return fd_.get(); }
+
+  // Sets |*entry| to the next entry, or returns false at the end (or on
+  // failure, see |error()|).
+  bool Next(Entry* entry);
+
+  // The |errno| with which reading the directory (or finding out an entry's
+  // type) failed, or 0.
+  int error() const { return error_; }
+
+ private:
+  bool Init();
+#if defined(OS_LINUX)
+  bool ReadBatch();
+#endif
+
+  ftl::UniqueFD fd_;
+  int error_ = 0;
+#if defined(OS_LINUX)
+  // The last batch read by |getdents64()|, and the position of the next entry
+  // in it.
+  std::unique_ptr<char[]> buffer_;
+  size_t buffer_size_ = 0u;
+  size_t position_ = 0u;
+  bool at_end_ = false;
+#else
+  DIR* dir_ = nullptr;
+#endif
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(DirectoryIterator);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_DIRECTORY_ITERATOR_H_
@@ -0,0 +1,117 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/directory_iterator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+using Type = DirectoryIterator::Type;
+
+std::map<std::string, Type> ListEntries(DirectoryIterator* it) {
+  std::map<std::string, Type> entries;
+  DirectoryIterator::Entry entry;
+  while (it->Next(&entry)) {
+    EXPECT_EQ('\0', entry.name.data()[entry.name.size()]);
+    EXPECT_TRUE(entries.emplace(entry.name.ToString(), entry.type).second);
+  }
+  EXPECT_EQ(0, it->error());
+  return entries;
+}
+
+TEST(DirectoryIterator, Types) {
+  ScopedTempDir dir;
+  ASSERT_TRUE(WriteFile(dir.path() + "/file", "x", 1));
+  ASSERT_TRUE(CreateDirectory(dir.path() + "/dir"));
+  ASSERT_EQ(0, symlink("dir", (dir.path() + "/link").c_str()));
+  ASSERT_EQ(0, mkfifo((dir.path() + "/fifo").c_str(), 0600));
+
+  DirectoryIterator it;
+  ASSERT_TRUE(it.Open(dir.path()));
+  std::map<std::string, Type> expected = {{"file", Type::kFile},
+                                          {"dir", Type::kDirectory},
+                                          {"link", Type::kSymlink},
+                                          {"fifo", Type::kOther}};
+  EXPECT_EQ(expected, ListEntries(&it));
+
+  // It stays at the end.
+  DirectoryIterator::Entry entry;
+  EXPECT_FALSE(it.Next(&entry));
+}
+
+TEST(DirectoryIterator, Empty) {
+  ScopedTempDir dir;
+  DirectoryIterator it;
+  ASSERT_TRUE(it.Open(dir.path()));
+  EXPECT_TRUE(ListEntries(&it).empty());
+}
+
+TEST(DirectoryIterator, ManyEntries) {
+  // Enough for several batches.
+  constexpr int kCount = 3000;
+  ScopedTempDir dir;
+  const std::string prefix = "a_file_with_a_fairly_long_name_";
+  for (int i = 0; i < kCount; i++) {
+    ASSERT_TRUE(
+        WriteFile(dir.path() + "/" + prefix + std::to_string(i), "", 0));
+  }
+
+  DirectoryIterator it;
+  ASSERT_TRUE(it.Open(dir.path()));
+  std::map<std::string, Type> entries = ListEntries(&it);
+  EXPECT_EQ(static_cast<size_t>(kCount), entries.size());
+  for (int i = 0; i < kCount; i++)
+    EXPECT_EQ(1u, entries.count(prefix + std::to_string(i)));
+}
+
+TEST(DirectoryIterator, OpenAt) {
+  ScopedTempDir dir;
+  ASSERT_TRUE(CreateDirectory(dir.path() + "/dir"));
+  ASSERT_TRUE(WriteFile(dir.path() + "/dir/file", "x", 1));
+  ASSERT_EQ(0, symlink("dir", (dir.path() + "/link").c_str()));
+
+  DirectoryIterator parent;
+  ASSERT_TRUE(parent.Open(dir.path()));
+  DirectoryIterator it;
+  ASSERT_TRUE(it.OpenAt(parent.fd(), "dir"));
+  std::map<std::string, Type> expected = {{"file", Type::kFile}};
+  EXPECT_EQ(expected, ListEntries(&it));
+
+  // Symbolic links aren't followed.
+  DirectoryIterator link;
+  EXPECT_FALSE(link.OpenAt(parent.fd(), "link"));
+  // (Linux reports ENOTDIR, since |O_DIRECTORY| is checked first.)
+  EXPECT_TRUE(link.error() == ELOOP || link.error() == ENOTDIR);
+}
+
+TEST(DirectoryIterator, OpenFailure) {
+  ScopedTempDir dir;
+  ASSERT_TRUE(WriteFile(dir.path() + "/file", "x", 1));
+
+  DirectoryIterator missing;
+  EXPECT_FALSE(missing.Open(dir.path() + "/missing"));
+  EXPECT_EQ(ENOENT, missing.error());
+  DirectoryIterator::Entry entry;
+  EXPECT_FALSE(missing.Next(&entry));
+
+  DirectoryIterator file;
+  EXPECT_FALSE(file.Open(dir.path() + "/file"));
+  EXPECT_EQ(ENOTDIR, file.error());
+}
+
+}  // namespace
+}  // namespace files
@@ -3,9 +3,15 @@
 // found in the LICENSE file.
 
 #include "lib/ftl/files/directory.h"
+
+#include <fcntl.h>
+
 #include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
 #include "lib/ftl/files/path.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/strings/string_printf.h"
 
 namespace files {
 namespace {
@@ -35,5 +41,47 @@ TEST(Directory, CreateDirectory) {
   EXPECT_TRUE(IsDirectory(abs_path));
 }
 
+TEST(Directory, CreateDirectoryAt) {
+  ScopedTempDir dir;
+  ftl::UniqueFD dir_fd(open(dir.path().c_str(), O_RDONLY | O_DIRECTORY));
+  ASSERT_TRUE(dir_fd.is_valid());
+
+  EXPECT_TRUE(CreateDirectoryAt(dir_fd.get(), "foo//bar/baz/"));
+  EXPECT_TRUE(IsDirectory(dir.path() + "/foo/bar/baz"));
+  EXPECT_TRUE(CreateDirectoryAt(dir_fd.get(), "foo/bar"));
+  EXPECT_TRUE(CreateDirectoryAt(dir_fd.get(), "foo/qux"));
+  EXPECT_TRUE(IsDirectory(dir.path() + "/foo/qux"));
+  EXPECT_TRUE(CreateDirectoryAt(dir_fd.get(), dir.path() + "/abs/path"));
+  EXPECT_TRUE(IsDirectory(dir.path() + "/abs/path"));
+
+  // A file is in the way.
+  ASSERT_TRUE(WriteFile(dir.path() + "/file", "", 0));
+  EXPECT_FALSE(CreateDirectoryAt(dir_fd.get(), "file"));
+  EXPECT_FALSE(CreateDirectoryAt(dir_fd.get(), "file/sub"));
+  EXPECT_FALSE(CreateDirectoryAt(dir_fd.get(), ""));
+}
+
+TEST(Directory, CreateDirectoriesAt) {
+  ScopedTempDir dir;
+  ftl::UniqueFD dir_fd(open(dir.path().c_str(), O_RDONLY | O_DIRECTORY));
+  ASSERT_TRUE(dir_fd.is_valid());
+
+  std::vector<std::string> paths;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++)
+      paths.push_back(ftl::StringPrintf("shards/%02x/%02x", i, j));
+  }
+  paths.push_back("top");
+  paths.push_back("shards/00/00/");  // Already there.
+  EXPECT_TRUE(CreateDirectoriesAt(dir_fd.get(), paths));
+  for (const std::string& path : paths)
+    EXPECT_TRUE(IsDirectory(dir.path() + "/" + path)) << path;
+
+  ASSERT_TRUE(WriteFile(dir.path() + "/file", "", 0));
+  EXPECT_FALSE(CreateDirectoriesAt(dir_fd.get(), {"a/b", "file/c", "d/e"}));
+  EXPECT_TRUE(IsDirectory(dir.path() + "/a/b"));
+  EXPECT_FALSE(IsDirectory(dir.path() + "/d"));
+}
+
 }  // namespace
 }  // namespace files
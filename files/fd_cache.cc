@@ -0,0 +1,95 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/fd_cache.h"
+
+#include <sys/stat.h>
+
+#include <utility>
+
+#include "lib/ftl/files/eintr_wrapper.h"
+
+namespace files {
+namespace {
+
+uint64_t DeviceOf(const struct stat& stat_buffer) {
+  return static_cast<uint64_t>(stat_buffer.st_dev);
+}
+
+uint64_t InodeOf(const struct stat& stat_buffer) {
+  return static_cast<uint64_t>(stat_buffer.st_ino);
+}
+
+}  // namespace
+
+CachedFD::CachedFD(ftl::UniqueFD fd) : fd_(std::move(fd)) {}
+
+CachedFD::~CachedFD() = default;
+
+FDCache::FDCache() : FDCache(Options()) {}
+
+FDCache::FDCache(const Options& options)
+    : options_(options), entries_(options.max_open) {}
+
+FDCache::~FDCache() {}
+
+ftl::RefPtr<CachedFD> FDCache::Get(const std::string& path) {
+  struct stat stat_buffer;
+  if (options_.check_inode && stat(path.c_str(), &stat_buffer) != 0) {
+    Remove(path);
+    return nullptr;
+  }
+  {
+    ftl::MutexLocker locker(&mutex_);
+    Entry* entry = entries_.Get(path);
+    if (entry && (!options_.check_inode ||
+                  (entry->device == DeviceOf(stat_buffer) &&
+                   entry->inode == InodeOf(stat_buffer)))) {
+      hit_count_++;
+      return entry->fd;
+    }
+    miss_count_++;
+  }
+
+  // Open without holding the lock, so that other files can be served
+  // meanwhile.
+  ftl::UniqueFD fd(
+      HANDLE_EINTR(open(path.c_str(), options_.open_flags | O_CLOEXEC)));
+  if (!fd.is_valid() || fstat(fd.get(), &stat_buffer) != 0) {
+    Remove(path);
+    return nullptr;
+  }
+  auto cached = ftl::MakeRefCounted<CachedFD>(std::move(fd));
+  ftl::MutexLocker locker(&mutex_);
+  entries_.Put(path,
+               Entry{DeviceOf(stat_buffer), InodeOf(stat_buffer), cached});
+  return cached;
+}
+
+void FDCache::Remove(const std::string& path) {
+  ftl::MutexLocker locker(&mutex_);
+  entries_.Remove(path);
+}
+
+void FDCache::Clear() {
+  ftl::MutexLocker locker(&mutex_);
+  entries_.Clear();
+}
+
+size_t FDCache::size() const {
+  ftl::MutexLocker locker(&mutex_);
+  return entries_.size();
+}
+
+uint64_t FDCache::hit_count() const {
+  ftl::MutexLocker locker(&mutex_);
+  return hit_count_;
+}
+
+uint64_t FDCache::miss_count() const {
+  ftl::MutexLocker locker(&mutex_);
+  return miss_count_;
+}
+
+}  // namespace files
@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_FD_CACHE_H_
+#define LIB_FTL_FILES_FD_CACHE_H_
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/containers/lru_cache.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace files {
+
+// A file descriptor opened by an |FDCache|. It stays open while referenced,
+// even once the cache has dropped it.
+class FTL_EXPORT CachedFD final : public ftl::RefCountedThreadSafe<CachedFD> {
+ public:
+  int get() const { return fd_.get(); }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(CachedFD);
+  FRIEND_MAKE_REF_COUNTED(CachedFD);
+
+  explicit CachedFD(ftl::UniqueFD fd);
+  ~CachedFD();
+
+  const ftl::UniqueFD fd_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CachedFD);
+};
+
+// Keeps files open for reuse, for code which reads (or writes) the same files
+// repeatedly at offsets (e.g., with |ftl::PReadFileDescriptor()|), so that it
+// needn't open and close them each time:
+//
+//   FDCache cache;
+//   ...
+//   ftl::RefPtr<CachedFD> fd = cache.Get(segment_path);
+//   if (!fd || ftl::PReadFileDescriptor(fd->get(), buffer, size, offset) < 0)
+//     return false;
+//
+// Since the file descriptors are shared, they mustn't be used in ways which
+// depend on (or change) their offset, e.g., with |read()|.
+//
+// By default, each |Get()| stats the path, and opens it again if it's now a
+// different file (by device and inode) from the one opened, e.g., because it's
+// been replaced; that's still cheaper than opening and closing it. (Without
+// |Options::check_inode|, a hit takes no system calls, but a replaced file is
+// only noticed once it's evicted or removed.) The least recently used files
+// are closed to stay within |Options::max_open|, once nothing references them.
+//
+// This is thread-safe.
+class FTL_EXPORT FDCache final {
+ public:
+  struct Options {
+    // The number of files to keep open (not counting ones which have been
+    // dropped but are still referenced).
+    size_t max_open = 64u;
+    // The flags to open the files with (|O_CLOEXEC| is added).
+    int open_flags = O_RDONLY;
+    bool check_inode = true;
+  };
+
+  FDCache();
+  explicit FDCache(const Options& options);
+  ~FDCache();
+
+  // Returns a file descriptor for the file at |path|, opening it only if there
+  // isn't one cached (or, see above, it's out of date), or null on error.
+  ftl::RefPtr<CachedFD> Get(const std::string& path);
+
+  // Drops the file descriptor for |path|, if any (e.g., once it's deleted).
+  void Remove(const std::string& path);
+  void Clear();
+
+  // The number of files cached.
+  size_t size() const;
+
+  // The numbers of |Get()|s served from the cache, and not.
+  uint64_t hit_count() const;
+  uint64_t miss_count() const;
+
+ private:
+  struct Entry {
+    uint64_t device;
+    uint64_t inode;
+    ftl::RefPtr<CachedFD> fd;
+  };
+
+  const Options options_;
+
+  mutable ftl::Mutex mutex_;
+  ftl::LruCache<std::string, Entry> entries_ FTL_GUARDED_BY(mutex_);
+  uint64_t hit_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  uint64_t miss_count_ FTL_GUARDED_BY(mutex_) = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FDCache);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_FD_CACHE_H_
@@ -0,0 +1,99 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/fd_cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+std::string ReadAt(const CachedFD& fd, size_t size, off_t offset) {
+  std::string data(size, '\0');
+  ssize_t read = ftl::PReadFileDescriptor(fd.get(), &data[0], size, offset);
+  data.resize(read < 0 ? 0u : static_cast<size_t>(read));
+  return data;
+}
+
+TEST(FDCache, ReusesFileDescriptors) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  ASSERT_TRUE(WriteFile(path, "hello, world", 12));
+
+  FDCache cache;
+  ftl::RefPtr<CachedFD> fd = cache.Get(path);
+  ASSERT_TRUE(fd);
+  EXPECT_EQ("world", ReadAt(*fd, 5u, 7));
+  EXPECT_EQ(fd, cache.Get(path));
+  EXPECT_EQ(1u, cache.hit_count());
+  EXPECT_EQ(1u, cache.miss_count());
+  EXPECT_EQ(1u, cache.size());
+
+  // Writing to the file (in place) doesn't matter ...
+  ASSERT_TRUE(WriteFile(path, "HELLO, WORLD", 12));
+  EXPECT_EQ(fd, cache.Get(path));
+  EXPECT_EQ("WORLD", ReadAt(*fd, 5u, 7));
+
+  // ... but replacing it does.
+  ASSERT_TRUE(WriteFileInTwoPhases(path, "goodbye, all", dir.path()));
+  ftl::RefPtr<CachedFD> new_fd = cache.Get(path);
+  ASSERT_TRUE(new_fd);
+  EXPECT_NE(fd, new_fd);
+  EXPECT_EQ("all", ReadAt(*new_fd, 3u, 9));
+  // (The old one is still open.)
+  EXPECT_EQ("WORLD", ReadAt(*fd, 5u, 7));
+  EXPECT_EQ(2u, cache.miss_count());
+
+  ASSERT_EQ(0, unlink(path.c_str()));
+  EXPECT_FALSE(cache.Get(path));
+  EXPECT_EQ(0u, cache.size());
+}
+
+TEST(FDCache, Options) {
+  ScopedTempDir dir;
+  const std::string path1 = dir.path() + "/1";
+  const std::string path2 = dir.path() + "/2";
+  ASSERT_TRUE(WriteFile(path1, "1", 1));
+  ASSERT_TRUE(WriteFile(path2, "2", 1));
+
+  FDCache::Options options;
+  options.max_open = 1u;
+  options.open_flags = O_RDWR;
+  options.check_inode = false;
+  FDCache cache(options);
+  ftl::RefPtr<CachedFD> fd1 = cache.Get(path1);
+  ASSERT_TRUE(fd1);
+  EXPECT_TRUE(ftl::PWriteFileDescriptor(fd1->get(), "x", 1, 1));
+  std::string contents;
+  ASSERT_TRUE(ReadFileToString(path1, &contents));
+  EXPECT_EQ("1x", contents);
+
+  // Without |check_inode|, a replaced file isn't noticed.
+  ASSERT_TRUE(WriteFileInTwoPhases(path1, "one", dir.path()));
+  EXPECT_EQ(fd1, cache.Get(path1));
+
+  // Only one file is kept open.
+  ASSERT_TRUE(cache.Get(path2));
+  EXPECT_EQ(1u, cache.size());
+  ftl::RefPtr<CachedFD> new_fd1 = cache.Get(path1);
+  ASSERT_TRUE(new_fd1);
+  EXPECT_NE(fd1, new_fd1);
+  EXPECT_EQ("one", ReadAt(*new_fd1, 3u, 0));
+  EXPECT_EQ(3u, cache.miss_count());
+
+  cache.Clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_FALSE(cache.Get(dir.path() + "/missing"));
+}
+
+}  // namespace
+}  // namespace files
@@ -4,28 +4,146 @@
 
 #include "lib/ftl/files/file.h"
 
+#include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <limits>
+
 #if defined(OS_WIN)
 #define FILE_CREATE_MODE _S_IREAD | _S_IWRITE
 #else
 #define FILE_CREATE_MODE 0666
 #endif
 
+#include "lib/ftl/files/directory.h"
 #include "lib/ftl/files/eintr_wrapper.h"
 #include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/path.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/files/unique_fd.h"
 #include "lib/ftl/logging.h"
+#include "lib/ftl/memory/allocation_profiling.h"
 #include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/random/rand.h"
 
 namespace files {
 namespace {
 
+#if !defined(OS_WIN)
+
+// Creates a temporary file in |directory|: an unnamed one (with |O_TMPFILE|,
+// if |allow_unnamed| and it's supported), clearing |*temp_path|, or else a
+// named one, setting |*temp_path| to its path.
+ftl::UniqueFD CreateTempFile(const std::string& directory,
+                             bool allow_unnamed,
+                             std::string* temp_path) {
+  temp_path->clear();
+#if defined(O_TMPFILE)
+  if (allow_unnamed) {
+    // (With the same mode as |mkstemp()| gives.)
+    ftl::UniqueFD fd(HANDLE_EINTR(
+        open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)));
+    if (fd.is_valid() || errno == ENOENT)
+      return fd;
+  }
+#endif
+  // mkstemp replaces "XXXXXX" so that the resulting file path is unique.
+  *temp_path = directory + "/.tmp_XXXXXX";
+  ftl::UniqueFD fd(mkstemp(&(*temp_path)[0]));
+  if (!fd.is_valid())
+    temp_path->clear();
+  return fd;
+}
+
+// Gives the unnamed file |fd| a unique name in |directory|, setting
+// |*temp_path| to its path.
+bool LinkTempFile(int fd, const std::string& directory,
+                  std::string* temp_path) {
+#if defined(O_TMPFILE)
+  char fd_path[32];
+  snprintf(fd_path, sizeof(fd_path), "/proc/self/fd/%d", fd);
+  for (int attempt = 0; attempt < 8; attempt++) {
+    char name[32];
+    snprintf(name, sizeof(name), "/.tmp_%016" PRIx64, ftl::RandUint64());
+    *temp_path = directory + name;
+    if (linkat(AT_FDCWD, fd_path, AT_FDCWD, temp_path->c_str(),
+               AT_SYMLINK_FOLLOW) == 0)
+      return true;
+    if (errno != EEXIST)
+      break;
+  }
+#endif
+  temp_path->clear();
+  return false;
+}
+
+// Syncs the directory containing |path|, e.g., after renaming a file into it.
+bool SyncDirectoryOf(const std::string& path) {
+  std::string directory = GetDirectoryName(path);
+  ftl::UniqueFD fd(HANDLE_EINTR(
+      open(directory.empty() ? "." : directory.c_str(), O_RDONLY)));
+  return fd.is_valid() && HANDLE_EINTR(fsync(fd.get())) == 0;
+}
+
+#endif  // !defined(OS_WIN)
+
+// Resizes |result| to |size|, recording any allocation.
+template <typename T>
+void ResizeBuffer(T* result,
+                  size_t size,
+                  const char* entry_point,
+                  const void* caller) {
+#if defined(FTL_ALLOCATION_PROFILING)
+  size_t old_capacity = result->capacity();
+  result->resize(size);
+  if (result->capacity() != old_capacity) {
+    FTL_RECORD_ALLOCATION(entry_point, caller,
+                          result->capacity() * sizeof((*result)[0]));
+  }
+#else
+  result->resize(size);
+#endif
+}
+
+// Returns the size of the file open as |fd| if it's a regular file, or 0 if
+// it's unknown (e.g., for a pipe, or a file in /proc, which reports 0).
+size_t GetExpectedSize(int fd) {
+  struct stat stat_buffer;
+  if (fstat(fd, &stat_buffer) != 0 || !S_ISREG(stat_buffer.st_mode) ||
+      stat_buffer.st_size <= 0 ||
+      static_cast<uint64_t>(stat_buffer.st_size) >
+          std::numeric_limits<size_t>::max())
+    return 0;
+  return static_cast<size_t>(stat_buffer.st_size);
+}
+
+// Reads from |fd| until end of file, and returns true if there's nothing left
+// (checking with a one-byte read, which it stores in |*byte| if there is).
+// Returns false, setting |*error|, if the read fails.
+bool AtEndOfFile(int fd, char* byte, bool* error) {
+  ssize_t bytes_read = HANDLE_EINTR(read(fd, byte, 1));
+  *error = bytes_read < 0;
+  return bytes_read <= 0;
+}
+
+// |entry_point| and |caller| are the public function which was called and its
+// return address (or null), for allocation profiling.
+//
+// The result is sized to the file, if that's known, so that it's usually
+// allocated (and zero-filled, by |resize()|) just once, and the last read
+// (which finds the end of the file) goes to the stack. Otherwise, it grows
+// geometrically.
 template <typename T>
-bool ReadFile(const std::string& path, T* result) {
+bool ReadFile(const std::string& path,
+              T* result,
+              const char* entry_point,
+              const void* caller) {
   FTL_DCHECK(result);
   result->clear();
 
@@ -33,21 +151,43 @@ bool ReadFile(const std::string& path, T* result) {
   if (!fd.is_valid())
     return false;
 
-  constexpr size_t kBufferSize = 1 << 16;
+  constexpr size_t kMinBufferSize = 4096;
+  const size_t expected_size = GetExpectedSize(fd.get());
+  ResizeBuffer(result, expected_size ? expected_size : kMinBufferSize,
+               entry_point, caller);
   size_t offset = 0;
-  ssize_t bytes_read = 0;
-  do {
+  for (;;) {
+    if (offset == result->size()) {
+      char byte = 0;
+      if (offset == expected_size) {
+        bool error;
+        if (AtEndOfFile(fd.get(), &byte, &error)) {
+          if (error) {
+            result->clear();
+            return false;
+          }
+          break;
+        }
+      }
+      // The file is bigger than expected (or its size is unknown).
+      ResizeBuffer(result, std::max(2 * offset, kMinBufferSize), entry_point,
+                   caller);
+      if (offset == expected_size)
+        (*result)[offset++] = byte;
+      continue;
+    }
+    ssize_t bytes_read = HANDLE_EINTR(
+        read(fd.get(), &(*result)[offset], result->size() - offset));
+    if (bytes_read < 0) {
+      result->clear();
+      return false;
+    }
+    if (bytes_read == 0)
+      break;
     offset += bytes_read;
-    result->resize(offset + kBufferSize);
-    bytes_read = HANDLE_EINTR(read(fd.get(), &(*result)[offset], kBufferSize));
-  } while (bytes_read > 0);
-
-  if (bytes_read < 0) {
-    result->clear();
-    return false;
   }
 
-  result->resize(offset + bytes_read);
+  result->resize(offset);
   return true;
 }
 
@@ -63,6 +203,14 @@ bool WriteFile(const std::string& path, const char* data, ssize_t size) {
 bool WriteFileInTwoPhases(const std::string& path,
                           ftl::StringView data,
                           const std::string& temp_root) {
+  return WriteFileInTwoPhases(path, data, temp_root, WriteFileOptions());
+}
+
+bool WriteFileInTwoPhases(const std::string& path,
+                          ftl::StringView data,
+                          const std::string& temp_root,
+                          const WriteFileOptions& options) {
+#if defined(OS_WIN)
   ScopedTempDir temp_dir(temp_root);
 
   std::string temp_file_path;
@@ -79,14 +227,80 @@ bool WriteFileInTwoPhases(const std::string& path,
   }
 
   return true;
+#else
+  std::string directory = temp_root.empty() ? GetDirectoryName(path)
+                                            : temp_root;
+  if (directory.empty())
+    directory = ".";
+
+  // If the file can't be linked (e.g., if /proc isn't mounted), start again
+  // with a named one.
+  for (bool allow_unnamed : {true, false}) {
+    std::string temp_path;
+    ftl::UniqueFD fd = CreateTempFile(directory, allow_unnamed, &temp_path);
+    if (!fd.is_valid() && errno == ENOENT && CreateDirectory(directory))
+      fd = CreateTempFile(directory, allow_unnamed, &temp_path);
+    if (!fd.is_valid())
+      return false;
+
+    if (!ftl::WriteFileDescriptor(fd.get(), data.data(), data.size()) ||
+        (options.durable && HANDLE_EINTR(fsync(fd.get())) != 0)) {
+      if (!temp_path.empty())
+        unlink(temp_path.c_str());
+      return false;
+    }
+    if (temp_path.empty() && !LinkTempFile(fd.get(), directory, &temp_path))
+      continue;
+    fd.reset();
+
+    if (rename(temp_path.c_str(), path.c_str()) != 0) {
+      unlink(temp_path.c_str());
+      return false;
+    }
+    return !options.durable || SyncDirectoryOf(path);
+  }
+  return false;
+#endif
 }
 
 bool ReadFileToString(const std::string& path, std::string* result) {
-  return ReadFile(path, result);
+  return ReadFile(path, result, "files::ReadFileToString",
+                  FTL_ALLOCATION_CALLER());
 }
 
 bool ReadFileToVector(const std::string& path, std::vector<uint8_t>* result) {
-  return ReadFile(path, result);
+  return ReadFile(path, result, "files::ReadFileToVector",
+                  FTL_ALLOCATION_CALLER());
+}
+
+bool ReadFileInto(const std::string& path,
+                  char* buffer,
+                  size_t buffer_size,
+                  size_t* size) {
+  FTL_DCHECK(buffer || !buffer_size);
+  FTL_DCHECK(size);
+  ftl::UniqueFD fd(open(path.c_str(), O_RDONLY));
+  if (!fd.is_valid())
+    return false;
+
+  size_t offset = 0;
+  while (offset < buffer_size) {
+    ssize_t bytes_read =
+        HANDLE_EINTR(read(fd.get(), buffer + offset, buffer_size - offset));
+    if (bytes_read < 0)
+      return false;
+    if (bytes_read == 0) {
+      *size = offset;
+      return true;
+    }
+    offset += bytes_read;
+  }
+  char byte;
+  bool error;
+  if (!AtEndOfFile(fd.get(), &byte, &error) || error)
+    return false;
+  *size = offset;
+  return true;
 }
 
 bool IsFile(const std::string& path) {
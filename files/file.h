@@ -20,20 +20,38 @@ FTL_EXPORT bool WriteFile(const std::string& path,
                           const char* data,
                           ssize_t size);
 
+// Options for |WriteFileInTwoPhases()|.
+struct WriteFileOptions {
+  // Whether to sync the data to storage before moving it into place, and then
+  // the directory entry, so that the new file survives a crash (rather than
+  // just replacing the old one atomically). This waits for the device.
+  bool durable = false;
+};
+
 // Writes the given data a temporary file under |temp_root| and then moves the
 // temporary file to |path|, ensuring write atomicity. Returns true if the data
 // was successfully written, otherwise returns false.
 //
+// The temporary file is created directly in |temp_root| (or, if it's empty, in
+// |path|'s directory), so one |temp_root| may be used for many files. On
+// Linux, the file is unnamed (see |O_TMPFILE|) until it's complete, so nothing
+// is left behind if writing it fails.
+//
 // Note that |path| and |temp_root| must be within the same filesystem for the
 // move to work. For example, it will not work to use |path| under /data and
 // |temp_root| under /tmp.
 FTL_EXPORT bool WriteFileInTwoPhases(const std::string& path,
                                      ftl::StringView data,
                                      const std::string& temp_root);
+FTL_EXPORT bool WriteFileInTwoPhases(const std::string& path,
+                                     ftl::StringView data,
+                                     const std::string& temp_root,
+                                     const WriteFileOptions& options);
 
 // Reads the contents of the file at the given path and stores the data in
 // result. Returns true if the file was read successfully, otherwise returns
 // false. If this function returns false, |result| will be the empty string.
+// (To use a large file without copying it, see |MappedFile|.)
 FTL_EXPORT bool ReadFileToString(const std::string& path, std::string* result);
 
 // Reads the contents of the file at the given path and stores the data in
@@ -42,6 +60,16 @@ FTL_EXPORT bool ReadFileToString(const std::string& path, std::string* result);
 FTL_EXPORT bool ReadFileToVector(const std::string& path,
                                  std::vector<uint8_t>* result);
 
+// Reads the contents of the file at the given path into |buffer|, which holds
+// |buffer_size| bytes, and sets |*size| to its size, without allocating (e.g.,
+// to reuse one buffer for many small files). Returns false if the file can't
+// be read or doesn't fit, in which case the contents of |buffer| are
+// unspecified.
+FTL_EXPORT bool ReadFileInto(const std::string& path,
+                             char* buffer,
+                             size_t buffer_size,
+                             size_t* size);
+
 // Returns whether the given path is a file.
 FTL_EXPORT bool IsFile(const std::string& path);
 
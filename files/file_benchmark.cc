@@ -0,0 +1,30 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace files {
+namespace {
+
+void BM_ReadFileToString(benchmark::State& state) {
+  ScopedTempDir dir;
+  std::string path;
+  FTL_CHECK(dir.NewTempFile(&path));
+  const std::string contents(static_cast<size_t>(state.range(0)), 'x');
+  FTL_CHECK(WriteFile(path, contents.data(), contents.size()));
+  std::string result;
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(ReadFileToString(path, &result));
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(contents.size()));
+}
+FTL_BENCHMARK(BM_ReadFileToString)->Arg(64)->Arg(1 << 20);
+
+}  // namespace
+}  // namespace files
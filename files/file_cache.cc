@@ -0,0 +1,166 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/memory_stats.h"
+
+namespace files {
+namespace {
+
+int64_t ToNanoseconds(const struct timespec& time) {
+  return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+}  // namespace
+
+FileContents::FileContents(std::string string) : string_(std::move(string)) {}
+
+FileContents::FileContents(MappedFile mapped_file)
+    : mapped_file_(std::move(mapped_file)) {}
+
+FileContents::~FileContents() = default;
+
+bool FileCache::Version::operator==(const Version& other) const {
+  return device == other.device && inode == other.inode &&
+         size == other.size && modified == other.modified &&
+         changed == other.changed;
+}
+
+FileCache::FileCache() : FileCache(Options()) {}
+
+FileCache::FileCache(const Options& options)
+    : options_(options), entries_(options.max_bytes) {
+  if (!options_.memory_stats_name.empty()) {
+    memory_stats_source_.reset(new ftl::MemoryStatsSource(
+        options_.memory_stats_name, [this] { return bytes(); }));
+  }
+}
+
+FileCache::~FileCache() {}
+
+ftl::RefPtr<FileContents> FileCache::Get(const std::string& path) {
+  Version version;
+  if (!GetVersion(-1, path, &version)) {
+    Remove(path);
+    return nullptr;
+  }
+  {
+    ftl::MutexLocker locker(&mutex_);
+    Entry* entry = entries_.Get(path);
+    if (entry && entry->version == version) {
+      hit_count_++;
+      return entry->contents;
+    }
+    miss_count_++;
+  }
+
+  // Read without holding the lock, so that other files can be served
+  // meanwhile.
+  bool changed = false;
+  ftl::RefPtr<FileContents> contents = Read(path, &version, &changed);
+  ftl::MutexLocker locker(&mutex_);
+  if (contents && !changed) {
+    size_t bytes = contents->size();
+    entries_.Put(path, Entry{version, contents}, bytes);
+  } else {
+    entries_.Remove(path);
+  }
+  return contents;
+}
+
+void FileCache::Remove(const std::string& path) {
+  ftl::MutexLocker locker(&mutex_);
+  entries_.Remove(path);
+}
+
+void FileCache::Clear() {
+  ftl::MutexLocker locker(&mutex_);
+  entries_.Clear();
+}
+
+size_t FileCache::size() const {
+  ftl::MutexLocker locker(&mutex_);
+  return entries_.size();
+}
+
+size_t FileCache::bytes() const {
+  ftl::MutexLocker locker(&mutex_);
+  return entries_.bytes();
+}
+
+uint64_t FileCache::hit_count() const {
+  ftl::MutexLocker locker(&mutex_);
+  return hit_count_;
+}
+
+uint64_t FileCache::miss_count() const {
+  ftl::MutexLocker locker(&mutex_);
+  return miss_count_;
+}
+
+// static
+bool FileCache::GetVersion(int fd, const std::string& path, Version* version) {
+  struct stat stat_buffer;
+  int result =
+      fd >= 0 ? fstat(fd, &stat_buffer) : stat(path.c_str(), &stat_buffer);
+  if (result != 0 || !S_ISREG(stat_buffer.st_mode))
+    return false;
+  version->device = static_cast<uint64_t>(stat_buffer.st_dev);
+  version->inode = static_cast<uint64_t>(stat_buffer.st_ino);
+  version->size = static_cast<uint64_t>(stat_buffer.st_size);
+#if defined(OS_MACOSX) || defined(OS_IOS)
+  version->modified = ToNanoseconds(stat_buffer.st_mtimespec);
+  version->changed = ToNanoseconds(stat_buffer.st_ctimespec);
+#else
+  version->modified = ToNanoseconds(stat_buffer.st_mtim);
+  version->changed = ToNanoseconds(stat_buffer.st_ctim);
+#endif
+  return true;
+}
+
+// Reads the file, setting |*version| to the version read, and |*changed| if
+// the file changed meanwhile (in which case the contents may be a mixture).
+ftl::RefPtr<FileContents> FileCache::Read(const std::string& path,
+                                          Version* version,
+                                          bool* changed) {
+  ftl::UniqueFD fd(HANDLE_EINTR(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+  if (!fd.is_valid() || !GetVersion(fd.get(), path, version))
+    return nullptr;
+
+  ftl::RefPtr<FileContents> contents;
+  if (version->size >= options_.map_threshold) {
+    MappedFile mapped_file;
+    if (!mapped_file.Map(fd))
+      return nullptr;
+    contents = ftl::MakeRefCounted<FileContents>(std::move(mapped_file));
+  } else {
+    std::string string(static_cast<size_t>(version->size), '\0');
+    ssize_t size = string.empty() ? 0 : ftl::PReadFileDescriptor(
+                                             fd.get(), &string[0],
+                                             string.size(), 0);
+    if (size < 0)
+      return nullptr;
+    string.resize(static_cast<size_t>(size));
+    contents = ftl::MakeRefCounted<FileContents>(std::move(string));
+  }
+
+  Version after;
+  *changed = !GetVersion(fd.get(), path, &after) || !(after == *version) ||
+             contents->size() != version->size;
+  return contents;
+}
+
+}  // namespace files
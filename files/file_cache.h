@@ -0,0 +1,148 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_FILE_CACHE_H_
+#define LIB_FTL_FILES_FILE_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <limits>
+#include <memory>
+#include <string>
+
+#include "lib/ftl/containers/lru_cache.h"
+#include "lib/ftl/files/mapped_file.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+class MemoryStatsSource;
+}  // namespace ftl
+
+namespace files {
+
+// The contents of a file, as read (or mapped) by a |FileCache|. They stay valid
+// while referenced, even once the cache has dropped them.
+class FTL_EXPORT FileContents final
+    : public ftl::RefCountedThreadSafe<FileContents> {
+ public:
+  const char* data() const { return view().data(); }
+  size_t size() const { return view().size(); }
+  ftl::StringView view() const {
+    return is_mapped() ? mapped_file_.view() : ftl::StringView(string_);
+  }
+
+  // Whether the contents are a |MappedFile| (rather than a copy).
+  bool is_mapped() const { return mapped_file_.is_valid(); }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(FileContents);
+  FRIEND_MAKE_REF_COUNTED(FileContents);
+
+  explicit FileContents(std::string string);
+  explicit FileContents(MappedFile mapped_file);
+  ~FileContents();
+
+  const std::string string_;
+  const MappedFile mapped_file_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FileContents);
+};
+
+// A read-through cache of regular files' contents, for files which are read
+// often but rarely change (e.g., templates and schemas):
+//
+//   FileCache cache;
+//   ftl::RefPtr<FileContents> schema = cache.Get(path);
+//   if (!schema)
+//     return false;
+//   Parse(schema->view());
+//
+// Each |Get()| still stats the file, and reads it again if its inode, size,
+// modification time or status change time differ from the cached copy's. (A
+// change that keeps the size, within the file system's timestamp granularity of
+// the previous read, can be missed.) The least recently used files are dropped
+// to stay within |Options::max_bytes|.
+//
+// Files of at least |Options::map_threshold| bytes are mapped (see
+// |MappedFile|), rather than copied into the heap; they should only be replaced
+// (e.g., with |WriteFileInTwoPhases()|), not modified in place, since a mapping
+// sees changes to the file, and accessing it past the end of a truncated file
+// crashes.
+//
+// This is thread-safe.
+class FTL_EXPORT FileCache final {
+ public:
+  struct Options {
+    size_t max_bytes = 64u * 1024u * 1024u;
+    // By default, files are never mapped.
+    size_t map_threshold = std::numeric_limits<size_t>::max();
+    // If not empty, |bytes()| is reported under this name by
+    // |ftl::GetMemoryStats()|.
+    std::string memory_stats_name;
+  };
+
+  FileCache();
+  explicit FileCache(const Options& options);
+  ~FileCache();
+
+  // Returns the contents of the (regular) file at |path|, reading them only if
+  // the cached copy is missing or out of date, or null on error.
+  ftl::RefPtr<FileContents> Get(const std::string& path);
+
+  // Drops the cached copy of |path|, if any.
+  void Remove(const std::string& path);
+  void Clear();
+
+  // The number of files cached, and their total size.
+  size_t size() const;
+  size_t bytes() const;
+
+  // The numbers of |Get()|s served from the cache, and not.
+  uint64_t hit_count() const;
+  uint64_t miss_count() const;
+
+ private:
+  // What identifies a version of a file.
+  struct Version {
+    uint64_t device = 0u;
+    uint64_t inode = 0u;
+    uint64_t size = 0u;
+    int64_t modified = 0;
+    int64_t changed = 0;
+
+    bool operator==(const Version& other) const;
+  };
+  struct Entry {
+    Version version;
+    ftl::RefPtr<FileContents> contents;
+  };
+
+  static bool GetVersion(int fd, const std::string& path, Version* version);
+  ftl::RefPtr<FileContents> Read(const std::string& path,
+                                 Version* version,
+                                 bool* changed);
+
+  const Options options_;
+
+  mutable ftl::Mutex mutex_;
+  // Each entry's size is its contents'.
+  ftl::LruCache<std::string, Entry> entries_ FTL_GUARDED_BY(mutex_);
+  uint64_t hit_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  uint64_t miss_count_ FTL_GUARDED_BY(mutex_) = 0u;
+
+  std::unique_ptr<ftl::MemoryStatsSource> memory_stats_source_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FileCache);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_FILE_CACHE_H_
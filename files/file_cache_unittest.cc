@@ -0,0 +1,150 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+TEST(FileCache, ServesUnchangedFiles) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  ASSERT_TRUE(WriteFile(path, "hello", 5));
+
+  FileCache cache;
+  ftl::RefPtr<FileContents> contents = cache.Get(path);
+  ASSERT_TRUE(contents);
+  EXPECT_EQ("hello", contents->view());
+  EXPECT_FALSE(contents->is_mapped());
+  EXPECT_EQ(contents, cache.Get(path));
+  EXPECT_EQ(1u, cache.hit_count());
+  EXPECT_EQ(1u, cache.miss_count());
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(5u, cache.bytes());
+
+  // A different size.
+  ASSERT_TRUE(WriteFile(path, "hello, world", 12));
+  contents = cache.Get(path);
+  ASSERT_TRUE(contents);
+  EXPECT_EQ("hello, world", contents->view());
+  EXPECT_EQ(12u, cache.bytes());
+
+  // A different file.
+  ASSERT_TRUE(WriteFileInTwoPhases(path, "goodbye, all", dir.path()));
+  contents = cache.Get(path);
+  ASSERT_TRUE(contents);
+  EXPECT_EQ("goodbye, all", contents->view());
+  EXPECT_EQ(1u, cache.hit_count());
+  EXPECT_EQ(3u, cache.miss_count());
+  EXPECT_EQ(1u, cache.size());
+}
+
+TEST(FileCache, SameSizeRewrite) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  ASSERT_TRUE(WriteFile(path, "abc", 3));
+  FileCache cache;
+  ASSERT_TRUE(cache.Get(path));
+
+  ASSERT_TRUE(WriteFile(path, "xyz", 3));
+  // Make sure the modification time differs, whatever its granularity.
+  struct timespec times[2] = {{1, 0}, {1, 0}};
+  ASSERT_EQ(0, utimensat(AT_FDCWD, path.c_str(), times, 0));
+  ftl::RefPtr<FileContents> contents = cache.Get(path);
+  ASSERT_TRUE(contents);
+  EXPECT_EQ("xyz", contents->view());
+}
+
+TEST(FileCache, Errors) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  ASSERT_TRUE(WriteFile(path, "abc", 3));
+  FileCache cache;
+  ASSERT_TRUE(cache.Get(path));
+  EXPECT_EQ(1u, cache.size());
+
+  ASSERT_EQ(0, unlink(path.c_str()));
+  EXPECT_FALSE(cache.Get(path));
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0u, cache.bytes());
+  EXPECT_FALSE(cache.Get(dir.path()));
+}
+
+TEST(FileCache, EvictsLeastRecentlyUsed) {
+  ScopedTempDir dir;
+  const std::string a = dir.path() + "/a";
+  const std::string b = dir.path() + "/b";
+  const std::string c = dir.path() + "/c";
+  const std::string big = dir.path() + "/big";
+  for (const std::string& path : {a, b, c})
+    ASSERT_TRUE(WriteFile(path, "1234", 4));
+  ASSERT_TRUE(WriteFile(big, "12345678901", 11));
+
+  FileCache::Options options;
+  options.max_bytes = 10u;
+  FileCache cache(options);
+  ASSERT_TRUE(cache.Get(a));
+  ASSERT_TRUE(cache.Get(b));
+  ASSERT_TRUE(cache.Get(a));
+  ASSERT_TRUE(cache.Get(c));
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(8u, cache.bytes());
+
+  uint64_t misses = cache.miss_count();
+  ASSERT_TRUE(cache.Get(a));
+  ASSERT_TRUE(cache.Get(c));
+  EXPECT_EQ(misses, cache.miss_count());
+  ASSERT_TRUE(cache.Get(b));
+  EXPECT_EQ(misses + 1u, cache.miss_count());
+
+  // Files bigger than the budget are read, but not cached.
+  ftl::RefPtr<FileContents> contents = cache.Get(big);
+  ASSERT_TRUE(contents);
+  EXPECT_EQ("12345678901", contents->view());
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_EQ(8u, cache.bytes());
+
+  cache.Remove(b);
+  EXPECT_EQ(1u, cache.size());
+  cache.Clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_EQ(0u, cache.bytes());
+}
+
+TEST(FileCache, Mapped) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  const std::string empty = dir.path() + "/empty";
+  const std::string content(100000u, 'x');
+  ASSERT_TRUE(WriteFile(path, content.data(), content.size()));
+  ASSERT_TRUE(WriteFile(empty, "", 0));
+
+  FileCache::Options options;
+  options.map_threshold = 0u;
+  FileCache cache(options);
+  ftl::RefPtr<FileContents> contents = cache.Get(path);
+  ASSERT_TRUE(contents);
+  EXPECT_TRUE(contents->is_mapped());
+  EXPECT_EQ(content, contents->view());
+  ftl::RefPtr<FileContents> empty_contents = cache.Get(empty);
+  ASSERT_TRUE(empty_contents);
+  EXPECT_EQ(0u, empty_contents->size());
+
+  // The contents outlive their entry.
+  cache.Clear();
+  EXPECT_EQ(content, contents->view());
+}
+
+}  // namespace
+}  // namespace files
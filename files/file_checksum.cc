@@ -0,0 +1,66 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_checksum.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "lib/ftl/files/mapped_file.h"
+#include "lib/ftl/strings/crc32c.h"
+#include "lib/ftl/tasks/parallel_for.h"
+
+namespace files {
+namespace {
+
+// The size of the chunks checksummed in parallel: big enough that combining
+// their checksums is negligible.
+constexpr size_t kChunkSize = 4u * 1024u * 1024u;
+
+}  // namespace
+
+bool ChecksumFile(const std::string& path,
+                  uint32_t* crc32c,
+                  ftl::ThreadPool* pool) {
+  MappedFile file;
+  if (!file.Open(path))
+    return false;
+  const char* data = file.data();
+  size_t size = file.size();
+  size_t chunk_count = (size + kChunkSize - 1u) / kChunkSize;
+  if (!pool || chunk_count < 2u) {
+    file.Advise(MappedFile::Advice::kSequential);
+    *crc32c = ftl::Crc32c(data, size);
+    return true;
+  }
+
+  // The chunks' checksums have to be combined in order, so compute them all
+  // and then combine them (rather than with |ParallelReduce()|).
+  file.Advise(MappedFile::Advice::kWillNeed);
+  std::vector<uint32_t> chunk_crcs(chunk_count);
+  ftl::ParallelFor(pool, 0u, chunk_count, 1u,
+                   [data, size, &chunk_crcs](size_t begin, size_t end) {
+                     for (size_t i = begin; i < end; i++) {
+                       size_t offset = i * kChunkSize;
+                       chunk_crcs[i] = ftl::Crc32c(
+                           data + offset, std::min(kChunkSize, size - offset));
+                     }
+                   });
+  uint32_t crc = chunk_crcs[0];
+  for (size_t i = 1u; i < chunk_count; i++) {
+    size_t chunk_size = std::min(kChunkSize, size - i * kChunkSize);
+    crc = ftl::Crc32cCombine(crc, chunk_crcs[i], chunk_size);
+  }
+  *crc32c = crc;
+  return true;
+}
+
+bool VerifyFileChecksum(const std::string& path,
+                        uint32_t expected_crc32c,
+                        ftl::ThreadPool* pool) {
+  uint32_t crc32c;
+  return ChecksumFile(path, &crc32c, pool) && crc32c == expected_crc32c;
+}
+
+}  // namespace files
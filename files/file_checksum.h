@@ -0,0 +1,39 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_FILE_CHECKSUM_H_
+#define LIB_FTL_FILES_FILE_CHECKSUM_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace ftl {
+class ThreadPool;
+}  // namespace ftl
+
+namespace files {
+
+// Computes the CRC-32C (see |ftl::Crc32c()|) of the contents of the file at
+// |path|, e.g., to check a file written by |WriteFileInTwoPhases()| against
+// a checksum stored elsewhere. Returns false on error.
+//
+// The file is mapped rather than read into a buffer. If |pool| is non-null,
+// large files are checksummed in chunks on its workers (and the calling
+// thread), and the chunks' checksums combined.
+FTL_EXPORT bool ChecksumFile(const std::string& path,
+                             uint32_t* crc32c,
+                             ftl::ThreadPool* pool = nullptr);
+
+// Returns whether the file at |path| can be read, and has the CRC-32C
+// |expected_crc32c|.
+FTL_EXPORT bool VerifyFileChecksum(const std::string& path,
+                                   uint32_t expected_crc32c,
+                                   ftl::ThreadPool* pool = nullptr);
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_FILE_CHECKSUM_H_
@@ -0,0 +1,59 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_checksum.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/strings/crc32c.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace files {
+namespace {
+
+TEST(FileChecksum, SmallAndEmptyFiles) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  uint32_t crc = 1u;
+  ASSERT_TRUE(ChecksumFile(path, &crc));
+  EXPECT_EQ(0u, crc);
+
+  ASSERT_TRUE(WriteFile(path, "123456789", 9));
+  ASSERT_TRUE(ChecksumFile(path, &crc));
+  EXPECT_EQ(0xe3069283u, crc);
+  EXPECT_TRUE(VerifyFileChecksum(path, 0xe3069283u));
+  EXPECT_FALSE(VerifyFileChecksum(path, 0xe3069284u));
+
+  EXPECT_FALSE(ChecksumFile(dir.path() + "/missing", &crc));
+  EXPECT_FALSE(VerifyFileChecksum(dir.path() + "/missing", 0u));
+}
+
+TEST(FileChecksum, Parallel) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  // A few (uneven) chunks.
+  std::string content(10u * 1024u * 1024u + 123u, '\0');
+  for (size_t i = 0u; i < content.size(); i++)
+    content[i] = static_cast<char>(i * 7u + (i >> 12));
+  ASSERT_TRUE(WriteFileInTwoPhases(path, content, dir.path()));
+  uint32_t expected = ftl::Crc32c(content);
+
+  auto pool = ftl::MakeRefCounted<ftl::ThreadPool>(3u);
+  uint32_t crc = 0u;
+  ASSERT_TRUE(ChecksumFile(path, &crc, pool.get()));
+  EXPECT_EQ(expected, crc);
+  ASSERT_TRUE(ChecksumFile(path, &crc));
+  EXPECT_EQ(expected, crc);
+  EXPECT_TRUE(VerifyFileChecksum(path, expected, pool.get()));
+  pool->Shutdown();
+}
+
+}  // namespace
+}  // namespace files
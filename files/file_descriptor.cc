@@ -4,10 +4,62 @@
 
 #include "lib/ftl/files/file_descriptor.h"
 
+#if !defined(OS_WIN)
+#include <limits.h>
+
+#include <algorithm>
+#include <vector>
+#endif
+
 #include "lib/ftl/files/eintr_wrapper.h"
 #include "lib/ftl/logging.h"
 
 namespace ftl {
+namespace {
+
+#if !defined(OS_WIN)
+
+// Calls |transfer| (|readv()| or |writev()| on some buffers) until all of the
+// |iov_count| buffers of |iov| are done or it returns 0 or fails, and returns
+// the number of bytes transferred (or what it returned, if that's none).
+template <typename Transfer>
+ssize_t TransferAll(const struct iovec* iov, int iov_count, Transfer transfer) {
+  FTL_DCHECK(iov_count >= 0);
+  // A copy of the rest of |iov|, made on the first partial transfer (since
+  // then the first buffer must be adjusted).
+  std::vector<struct iovec> remaining;
+  const struct iovec* current = iov;
+  size_t count = static_cast<size_t>(iov_count);
+  ssize_t total = 0;
+  while (count > 0u) {
+    ssize_t partial = HANDLE_EINTR(
+        transfer(current, static_cast<int>(std::min<size_t>(count, IOV_MAX))));
+    if (partial <= 0)
+      return total ? total : partial;
+    total += partial;
+
+    size_t bytes = static_cast<size_t>(partial);
+    while (count > 0u && bytes >= current->iov_len) {
+      bytes -= current->iov_len;
+      current++;
+      count--;
+    }
+    if (bytes > 0u) {
+      if (remaining.empty()) {
+        remaining.assign(current, current + count);
+        current = remaining.data();
+      }
+      struct iovec* first = &remaining[remaining.size() - count];
+      first->iov_base = static_cast<char*>(first->iov_base) + bytes;
+      first->iov_len -= bytes;
+    }
+  }
+  return total;
+}
+
+#endif  // !defined(OS_WIN)
+
+}  // namespace
 
 bool WriteFileDescriptor(int fd, const char* data, ssize_t size) {
   ssize_t total = 0;
@@ -29,4 +81,56 @@ ssize_t ReadFileDescriptor(int fd, char* data, ssize_t max_size) {
   return total;
 }
 
+#if !defined(OS_WIN)
+
+bool PWriteFileDescriptor(int fd,
+                          const char* data,
+                          ssize_t size,
+                          off_t offset) {
+  ssize_t total = 0;
+  for (ssize_t partial = 0; total < size; total += partial) {
+    partial =
+        HANDLE_EINTR(pwrite(fd, data + total, size - total, offset + total));
+    if (partial < 0)
+      return false;
+  }
+  return true;
+}
+
+ssize_t PReadFileDescriptor(int fd,
+                            char* data,
+                            ssize_t max_size,
+                            off_t offset) {
+  ssize_t total = 0;
+  for (ssize_t partial = 0; total < max_size; total += partial) {
+    partial =
+        HANDLE_EINTR(pread(fd, data + total, max_size - total, offset + total));
+    if (partial <= 0)
+      return total ? total : partial;
+  }
+  return total;
+}
+
+bool WriteFileDescriptorV(int fd, const struct iovec* iov, int iov_count) {
+  size_t size = 0u;
+  for (int i = 0; i < iov_count; i++)
+    size += iov[i].iov_len;
+  if (!size)
+    return true;
+  ssize_t written =
+      TransferAll(iov, iov_count, [fd](const struct iovec* buffers, int count) {
+        return writev(fd, buffers, count);
+      });
+  return written >= 0 && static_cast<size_t>(written) == size;
+}
+
+ssize_t ReadFileDescriptorV(int fd, const struct iovec* iov, int iov_count) {
+  return TransferAll(iov, iov_count,
+                     [fd](const struct iovec* buffers, int count) {
+                       return readv(fd, buffers, count);
+                     });
+}
+
+#endif  // !defined(OS_WIN)
+
 }  // namespace ftl
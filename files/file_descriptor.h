@@ -5,15 +5,47 @@
 #ifndef LIB_FTL_FILES_FILE_DESCRIPTOR_H_
 #define LIB_FTL_FILES_FILE_DESCRIPTOR_H_
 
+#include "lib/ftl/build_config.h"
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/inttypes.h"
 #include "lib/ftl/portable_unistd.h"
 
+#if !defined(OS_WIN)
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+
 namespace ftl {
 
 FTL_EXPORT bool WriteFileDescriptor(int fd, const char* data, ssize_t size);
 FTL_EXPORT ssize_t ReadFileDescriptor(int fd, char* data, ssize_t max_size);
 
+#if !defined(OS_WIN)
+
+// Like |WriteFileDescriptor()| and |ReadFileDescriptor()|, but at |offset| in
+// the file, without using or moving the file descriptor's offset (so that
+// several threads may use it at once).
+FTL_EXPORT bool PWriteFileDescriptor(int fd,
+                                     const char* data,
+                                     ssize_t size,
+                                     off_t offset);
+FTL_EXPORT ssize_t PReadFileDescriptor(int fd,
+                                       char* data,
+                                       ssize_t max_size,
+                                       off_t offset);
+
+// Like |WriteFileDescriptor()| and |ReadFileDescriptor()|, but for the
+// |iov_count| buffers of |iov| in turn, with as few system calls as possible
+// (usually one, e.g., to write a header and a body). |iov| isn't modified.
+FTL_EXPORT bool WriteFileDescriptorV(int fd,
+                                     const struct iovec* iov,
+                                     int iov_count);
+FTL_EXPORT ssize_t ReadFileDescriptorV(int fd,
+                                       const struct iovec* iov,
+                                       int iov_count);
+
+#endif  // !defined(OS_WIN)
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_FILES_FILE_DESCRIPTOR_H_
@@ -9,6 +9,7 @@
 #include <sys/types.h>
 
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -37,5 +38,85 @@ TEST(FileDescriptor, WriteAndRead) {
   EXPECT_EQ(string, buffer.data());
 }
 
+#if !defined(OS_WIN)
+
+TEST(FileDescriptor, PWriteAndPRead) {
+  files::ScopedTempDir temp_dir;
+  std::string path;
+  ASSERT_TRUE(temp_dir.NewTempFile(&path));
+
+  ftl::UniqueFD fd(open(path.c_str(), O_RDWR));
+  ASSERT_TRUE(fd.is_valid());
+
+  EXPECT_TRUE(PWriteFileDescriptor(fd.get(), "three", 5, 10));
+  EXPECT_TRUE(PWriteFileDescriptor(fd.get(), "one, two, ", 10, 0));
+  // The file descriptor's offset isn't used or moved.
+  EXPECT_EQ(0, lseek(fd.get(), 0, SEEK_CUR));
+
+  char buffer[16];
+  EXPECT_EQ(3, PReadFileDescriptor(fd.get(), buffer, 3, 5));
+  EXPECT_EQ("two", std::string(buffer, 3));
+  EXPECT_EQ(15, PReadFileDescriptor(fd.get(), buffer, sizeof(buffer), 0));
+  EXPECT_EQ("one, two, three", std::string(buffer, 15));
+  EXPECT_EQ(0, PReadFileDescriptor(fd.get(), buffer, sizeof(buffer), 100));
+  EXPECT_EQ(0, lseek(fd.get(), 0, SEEK_CUR));
+}
+
+TEST(FileDescriptor, WriteAndReadV) {
+  files::ScopedTempDir temp_dir;
+  std::string path;
+  ASSERT_TRUE(temp_dir.NewTempFile(&path));
+
+  ftl::UniqueFD fd(open(path.c_str(), O_RDWR));
+  ASSERT_TRUE(fd.is_valid());
+
+  std::string header = "header:";
+  std::string body(100000, 'x');
+  struct iovec write_iov[3] = {
+      {&header[0], header.size()}, {nullptr, 0u}, {&body[0], body.size()}};
+  EXPECT_TRUE(WriteFileDescriptorV(fd.get(), write_iov, 3));
+  EXPECT_EQ(&header[0], write_iov[0].iov_base);
+  EXPECT_EQ(header.size(), write_iov[0].iov_len);
+  EXPECT_TRUE(WriteFileDescriptorV(fd.get(), write_iov, 0));
+  EXPECT_EQ(0, lseek(fd.get(), 0, SEEK_SET));
+
+  std::string read_header(3, '\0');
+  std::string read_body(header.size() - 3 + body.size() + 10, '\0');
+  struct iovec read_iov[2] = {{&read_header[0], read_header.size()},
+                              {&read_body[0], read_body.size()}};
+  EXPECT_EQ(static_cast<ssize_t>(header.size() + body.size()),
+            ReadFileDescriptorV(fd.get(), read_iov, 2));
+  EXPECT_EQ("hea", read_header);
+  EXPECT_EQ("der:" + body, read_body.substr(0, 4 + body.size()));
+  EXPECT_EQ(0, ReadFileDescriptorV(fd.get(), read_iov, 2));
+}
+
+TEST(FileDescriptor, WriteAndReadVPipe) {
+  // A pipe's writes and reads may be partial, so this shows that the rest of
+  // a buffer is carried over.
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ftl::UniqueFD read_fd(fds[0]);
+  ftl::UniqueFD write_fd(fds[1]);
+
+  std::string data(1000000, '\0');
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = static_cast<char>(i % 251);
+  std::string read_data(data.size(), '\0');
+  std::thread reader([&read_fd, &read_data] {
+    struct iovec iov[2] = {{&read_data[0], 12345u},
+                           {&read_data[12345], read_data.size() - 12345u}};
+    EXPECT_EQ(static_cast<ssize_t>(read_data.size()),
+              ReadFileDescriptorV(read_fd.get(), iov, 2));
+  });
+  struct iovec iov[2] = {{&data[0], 777u}, {&data[777], data.size() - 777u}};
+  EXPECT_TRUE(WriteFileDescriptorV(write_fd.get(), iov, 2));
+  write_fd.reset();
+  reader.join();
+  EXPECT_EQ(data, read_data);
+}
+
+#endif  // !defined(OS_WIN)
+
 }  // namespace
 }  // namespace ftl
@@ -0,0 +1,130 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_info.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <atomic>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/tasks/parallel_for.h"
+
+namespace files {
+namespace {
+
+// How many paths each task of |GetFileInfos()| queries, at least.
+constexpr size_t kBatchGrain = 16u;
+
+FileInfo::Type TypeOfMode(uint32_t mode) {
+  if (S_ISREG(mode))
+    return FileInfo::Type::kFile;
+  if (S_ISDIR(mode))
+    return FileInfo::Type::kDirectory;
+  if (S_ISLNK(mode))
+    return FileInfo::Type::kSymlink;
+  return FileInfo::Type::kOther;
+}
+
+#if defined(OS_LINUX) && defined(STATX_BASIC_STATS)
+
+// Cleared if |statx()| turns out not to be supported (by the kernel, or a
+// seccomp policy).
+std::atomic<bool> g_has_statx(true);
+
+bool Statx(int dir_fd,
+           const char* name,
+           FileInfo* info,
+           uint32_t fields,
+           bool follow_symlinks,
+           bool* supported) {
+  unsigned mask = 0u;
+  if (fields & kFileInfoType)
+    mask |= STATX_TYPE;
+  if (fields & kFileInfoSize)
+    mask |= STATX_SIZE;
+  if (fields & kFileInfoModificationTime)
+    mask |= STATX_MTIME;
+  const int flags =
+      AT_STATX_SYNC_AS_STAT | (follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW);
+  struct statx buffer;
+  if (statx(dir_fd, name, flags, mask, &buffer) != 0) {
+    *supported = errno != ENOSYS && errno != EPERM;
+    return false;
+  }
+  *supported = true;
+  info->type = TypeOfMode(buffer.stx_mode);
+  info->size = buffer.stx_size;
+  info->modification_time_ns =
+      static_cast<int64_t>(buffer.stx_mtime.tv_sec) * 1000000000 +
+      buffer.stx_mtime.tv_nsec;
+  return true;
+}
+
+#endif  // defined(OS_LINUX) && defined(STATX_BASIC_STATS)
+
+bool Stat(int dir_fd,
+          const char* name,
+          FileInfo* info,
+          bool follow_symlinks) {
+  struct stat buffer;
+  if (fstatat(dir_fd, name, &buffer,
+              follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+    return false;
+  info->type = TypeOfMode(buffer.st_mode);
+  info->size = static_cast<uint64_t>(buffer.st_size);
+#if defined(OS_MACOSX) || defined(OS_IOS)
+  const struct timespec& mtime = buffer.st_mtimespec;
+#else
+  const struct timespec& mtime = buffer.st_mtim;
+#endif
+  info->modification_time_ns =
+      static_cast<int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec;
+  return true;
+}
+
+}  // namespace
+
+bool GetFileInfo(const std::string& path, FileInfo* info, uint32_t fields) {
+  return GetFileInfoAt(AT_FDCWD, path.c_str(), info, fields, true);
+}
+
+bool GetFileInfoAt(int dir_fd,
+                   const char* name,
+                   FileInfo* info,
+                   uint32_t fields,
+                   bool follow_symlinks) {
+  *info = FileInfo();
+#if defined(OS_LINUX) && defined(STATX_BASIC_STATS)
+  if (g_has_statx.load(std::memory_order_relaxed)) {
+    bool supported = true;
+    if (Statx(dir_fd, name, info, fields, follow_symlinks, &supported))
+      return true;
+    if (supported)
+      return false;
+    // (Maybe only |statx()| was refused; fall back to |fstatat()|.)
+    g_has_statx.store(false, std::memory_order_relaxed);
+  }
+#endif
+  return Stat(dir_fd, name, info, follow_symlinks);
+}
+
+std::vector<FileInfo> GetFileInfos(const std::vector<std::string>& paths,
+                                   uint32_t fields,
+                                   ftl::ThreadPool* pool) {
+  std::vector<FileInfo> infos(paths.size());
+  auto query = [&paths, &infos, fields](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++)
+      GetFileInfo(paths[i], &infos[i], fields);
+  };
+  if (pool)
+    ftl::ParallelFor(pool, 0u, paths.size(), kBatchGrain, query);
+  else
+    query(0u, paths.size());
+  return infos;
+}
+
+}  // namespace files
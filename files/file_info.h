@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_FILE_INFO_H_
+#define LIB_FTL_FILES_FILE_INFO_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace ftl {
+class ThreadPool;
+}  // namespace ftl
+
+namespace files {
+
+// A file's metadata, as returned by |GetFileInfo()|.
+struct FileInfo {
+  enum class Type {
+    // The query failed (e.g., the file doesn't exist).
+    kNone,
+    kFile,
+    kDirectory,
+    kSymlink,
+    kOther,
+  };
+
+  Type type = Type::kNone;
+  uint64_t size = 0u;
+  // The last modification time, in nanoseconds since the Unix epoch.
+  int64_t modification_time_ns = 0;
+};
+
+// Which of |FileInfo|'s fields to fetch (a combination of these), so that the
+// file system needn't produce the others. (Fields which aren't asked for may
+// or may not be set.)
+enum FileInfoFields : uint32_t {
+  kFileInfoType = 1u << 0,
+  kFileInfoSize = 1u << 1,
+  kFileInfoModificationTime = 1u << 2,
+  kFileInfoAllFields =
+      kFileInfoType | kFileInfoSize | kFileInfoModificationTime,
+};
+
+// Sets |*info| to the metadata of the file at |path| (following symbolic
+// links) with one system call (|statx()| on Linux, where it's available, with
+// just |fields|), rather than one each for |IsFile()|, |GetFileSize()| and so
+// on. Returns false on error (setting |info->type| to |FileInfo::Type::kNone|).
+FTL_EXPORT bool GetFileInfo(const std::string& path,
+                            FileInfo* info,
+                            uint32_t fields = kFileInfoAllFields);
+
+// Like |GetFileInfo()|, but for the file |name| in the directory |dir_fd| (or
+// relative to the current directory if it's |AT_FDCWD|), e.g., for an entry
+// listed by a |DirectoryIterator|. Symbolic links are only followed if
+// |follow_symlinks|.
+FTL_EXPORT bool GetFileInfoAt(int dir_fd,
+                              const char* name,
+                              FileInfo* info,
+                              uint32_t fields = kFileInfoAllFields,
+                              bool follow_symlinks = false);
+
+// Returns the metadata of each of |paths| (as |GetFileInfo()|, with failures
+// having type |FileInfo::Type::kNone|). If |pool| is non-null, the queries are
+// spread over its workers (and the calling thread), which helps when the
+// metadata isn't cached (e.g., on a network file system).
+FTL_EXPORT std::vector<FileInfo> GetFileInfos(
+    const std::vector<std::string>& paths,
+    uint32_t fields = kFileInfoAllFields,
+    ftl::ThreadPool* pool = nullptr);
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_FILE_INFO_H_
@@ -0,0 +1,111 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_info.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/directory_iterator.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace files {
+namespace {
+
+TEST(FileInfo, GetFileInfo) {
+  ScopedTempDir dir;
+  const std::string file = dir.path() + "/file";
+  ASSERT_TRUE(WriteFile(file, "hello", 5));
+  ASSERT_EQ(0, symlink("file", (dir.path() + "/link").c_str()));
+
+  FileInfo info;
+  ASSERT_TRUE(GetFileInfo(file, &info));
+  EXPECT_EQ(FileInfo::Type::kFile, info.type);
+  EXPECT_EQ(5u, info.size);
+  struct stat stat_buffer;
+  ASSERT_EQ(0, stat(file.c_str(), &stat_buffer));
+  EXPECT_EQ(static_cast<int64_t>(stat_buffer.st_mtime),
+            info.modification_time_ns / 1000000000);
+
+  ASSERT_TRUE(GetFileInfo(dir.path(), &info, kFileInfoType));
+  EXPECT_EQ(FileInfo::Type::kDirectory, info.type);
+
+  // Symbolic links are followed.
+  ASSERT_TRUE(GetFileInfo(dir.path() + "/link", &info));
+  EXPECT_EQ(FileInfo::Type::kFile, info.type);
+  EXPECT_EQ(5u, info.size);
+
+  EXPECT_FALSE(GetFileInfo(dir.path() + "/missing", &info));
+  EXPECT_EQ(FileInfo::Type::kNone, info.type);
+}
+
+TEST(FileInfo, GetFileInfoAt) {
+  ScopedTempDir dir;
+  ASSERT_TRUE(WriteFile(dir.path() + "/file", "hello", 5));
+  ASSERT_TRUE(CreateDirectory(dir.path() + "/subdir"));
+  ASSERT_EQ(0, symlink("file", (dir.path() + "/link").c_str()));
+
+  DirectoryIterator it;
+  ASSERT_TRUE(it.Open(dir.path()));
+  DirectoryIterator::Entry entry;
+  size_t count = 0u;
+  while (it.Next(&entry)) {
+    FileInfo info;
+    ASSERT_TRUE(GetFileInfoAt(it.fd(), entry.name.data(), &info));
+    count++;
+    if (entry.name == "file") {
+      EXPECT_EQ(FileInfo::Type::kFile, info.type);
+      EXPECT_EQ(5u, info.size);
+    } else if (entry.name == "subdir") {
+      EXPECT_EQ(FileInfo::Type::kDirectory, info.type);
+    } else {
+      EXPECT_EQ("link", entry.name);
+      EXPECT_EQ(FileInfo::Type::kSymlink, info.type);
+      ASSERT_TRUE(GetFileInfoAt(it.fd(), entry.name.data(), &info,
+                                kFileInfoAllFields, true));
+      EXPECT_EQ(FileInfo::Type::kFile, info.type);
+    }
+  }
+  EXPECT_EQ(3u, count);
+}
+
+TEST(FileInfo, GetFileInfos) {
+  ScopedTempDir dir;
+  std::vector<std::string> paths;
+  for (size_t i = 0u; i < 100u; i++) {
+    paths.push_back(dir.path() + "/" + std::to_string(i));
+    // (Every third one is missing.)
+    if (i % 3u != 0u) {
+      ASSERT_TRUE(WriteFile(paths.back(), std::string(i, 'x').data(), i));
+    }
+  }
+
+  auto pool = ftl::MakeRefCounted<ftl::ThreadPool>(2u);
+  for (ftl::ThreadPool* p : {static_cast<ftl::ThreadPool*>(nullptr),
+                             pool.get()}) {
+    std::vector<FileInfo> infos = GetFileInfos(paths, kFileInfoAllFields, p);
+    ASSERT_EQ(paths.size(), infos.size());
+    for (size_t i = 0u; i < paths.size(); i++) {
+      if (i % 3u == 0u) {
+        EXPECT_EQ(FileInfo::Type::kNone, infos[i].type);
+      } else {
+        EXPECT_EQ(FileInfo::Type::kFile, infos[i].type);
+        EXPECT_EQ(i, infos[i].size);
+      }
+    }
+  }
+  pool->Shutdown();
+}
+
+}  // namespace
+}  // namespace files
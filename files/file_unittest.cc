@@ -3,7 +3,16 @@
 // found in the LICENSE file.
 
 #include "lib/ftl/files/file.h"
+
+#include <string>
+#include <vector>
+
+#if !defined(OS_WIN)
+#include <dirent.h>
+#endif
+
 #include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 
 namespace files {
@@ -37,5 +46,121 @@ TEST(File, WriteFileInTwoPhases) {
   EXPECT_EQ(read_content, content);
 }
 
+#if !defined(OS_WIN)
+// Returns the names of the entries in |path|.
+std::vector<std::string> ListDirectory(const std::string& path) {
+  std::vector<std::string> names;
+  DIR* dir = opendir(path.c_str());
+  EXPECT_TRUE(dir);
+  if (!dir)
+    return names;
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..")
+      names.push_back(name);
+  }
+  closedir(dir);
+  return names;
+}
+
+TEST(File, WriteFileInTwoPhasesReusesTempRoot) {
+  ScopedTempDir dir;
+  std::string temp_root = dir.path() + "/temp";
+  std::string path = dir.path() + "/destination";
+
+  // |temp_root| is created if need be, and left empty.
+  for (const char* content : {"one", "two", "three"}) {
+    ASSERT_TRUE(WriteFileInTwoPhases(path, ftl::StringView(content),
+                                     temp_root));
+    std::string read_content;
+    ASSERT_TRUE(ReadFileToString(path, &read_content));
+    EXPECT_EQ(content, read_content);
+    EXPECT_TRUE(ListDirectory(temp_root).empty());
+  }
+
+  EXPECT_FALSE(WriteFileInTwoPhases(dir.path() + "/missing/destination",
+                                    ftl::StringView("x"), temp_root));
+  EXPECT_TRUE(ListDirectory(temp_root).empty());
+}
+
+TEST(File, WriteFileInTwoPhasesDurable) {
+  ScopedTempDir dir;
+  std::string path = dir.path() + "/destination";
+
+  WriteFileOptions options;
+  options.durable = true;
+  // With no |temp_root|, the temporary file goes in |path|'s directory.
+  ASSERT_TRUE(WriteFileInTwoPhases(path, ftl::StringView("Hello World"),
+                                   std::string(), options));
+  std::string read_content;
+  ASSERT_TRUE(ReadFileToString(path, &read_content));
+  EXPECT_EQ("Hello World", read_content);
+  EXPECT_EQ(std::vector<std::string>{"destination"},
+            ListDirectory(dir.path()));
+}
+#endif
+
+TEST(File, ReadFileToString) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+
+  std::string content;
+  EXPECT_TRUE(ReadFileToString(path, &content));
+  EXPECT_EQ("", content);
+
+  // Sizes around the initial buffer size (for a file of unknown size) and its
+  // multiples.
+  for (size_t size : {1u, 4095u, 4096u, 4097u, 100000u}) {
+    std::string written;
+    for (size_t i = 0; i < size; i++)
+      written.push_back(static_cast<char>('a' + i % 26));
+    ASSERT_TRUE(WriteFile(path, written.data(), written.size()));
+    EXPECT_TRUE(ReadFileToString(path, &content));
+    EXPECT_EQ(written, content);
+
+    std::vector<uint8_t> vector;
+    EXPECT_TRUE(ReadFileToVector(path, &vector));
+    EXPECT_EQ(written, std::string(vector.begin(), vector.end()));
+  }
+
+  EXPECT_FALSE(ReadFileToString(dir.path() + "/missing", &content));
+  EXPECT_EQ("", content);
+}
+
+#if defined(OS_LINUX)
+TEST(File, ReadFileToStringUnknownSize) {
+  // Files in /proc report a size of 0.
+  std::string content;
+  EXPECT_TRUE(ReadFileToString("/proc/self/status", &content));
+  EXPECT_NE(std::string::npos, content.find("Name:"));
+}
+#endif
+
+TEST(File, ReadFileInto) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+
+  char buffer[16];
+  size_t size = 123u;
+  EXPECT_TRUE(ReadFileInto(path, buffer, sizeof(buffer), &size));
+  EXPECT_EQ(0u, size);
+  EXPECT_TRUE(ReadFileInto(path, nullptr, 0u, &size));
+  EXPECT_EQ(0u, size);
+
+  std::string content = "Hello World";
+  ASSERT_TRUE(WriteFile(path, content.data(), content.size()));
+  EXPECT_TRUE(ReadFileInto(path, buffer, sizeof(buffer), &size));
+  EXPECT_EQ(content, std::string(buffer, size));
+  EXPECT_TRUE(ReadFileInto(path, buffer, content.size(), &size));
+  EXPECT_EQ(content, std::string(buffer, size));
+
+  EXPECT_FALSE(ReadFileInto(path, buffer, content.size() - 1u, &size));
+  EXPECT_FALSE(ReadFileInto(path, nullptr, 0u, &size));
+  EXPECT_FALSE(ReadFileInto(dir.path() + "/missing", buffer, sizeof(buffer),
+                            &size));
+}
+
 }  // namespace
 }  // namespace files
@@ -0,0 +1,334 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_watcher.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#if defined(OS_LINUX)
+#include <sys/inotify.h>
+#endif
+
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/path.h"
+#include "lib/ftl/logging.h"
+
+namespace files {
+
+struct FileWatcher::WatchState {
+  std::string path;
+  // |path|'s last component, as reported by inotify.
+  std::string name;
+  ftl::RefPtr<ftl::TaskRunner> task_runner;
+  Callback callback;
+  // Cleared by |Unwatch()|, so posted callbacks don't run after it.
+  std::atomic<bool> active{true};
+#if defined(OS_LINUX)
+  int watch_descriptor = -1;
+#endif
+  // For polling (only used on the watcher's thread, once added).
+  FileState file_state;
+};
+
+namespace {
+
+#if defined(OS_LINUX)
+
+// Events for the files in a watched directory.
+constexpr uint32_t kInotifyMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                  IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE |
+                                  IN_ATTRIB | IN_ONLYDIR;
+
+FileWatcher::Event GetEvent(uint32_t mask) {
+  if (mask & (IN_CREATE | IN_MOVED_TO))
+    return FileWatcher::Event::kCreated;
+  if (mask & (IN_DELETE | IN_MOVED_FROM))
+    return FileWatcher::Event::kDeleted;
+  return FileWatcher::Event::kModified;
+}
+
+#endif  // defined(OS_LINUX)
+
+}  // namespace
+
+std::unique_ptr<FileWatcher> FileWatcher::Create() {
+  return Create(Options());
+}
+
+std::unique_ptr<FileWatcher> FileWatcher::Create(const Options& options) {
+  std::unique_ptr<FileWatcher> watcher(new FileWatcher(options));
+  if (!watcher->Init())
+    return nullptr;
+  return watcher;
+}
+
+FileWatcher::FileWatcher(const Options& options)
+#if defined(OS_LINUX)
+    : polling_(options.force_polling),
+#else
+    : polling_(true),
+#endif
+      poll_interval_(options.poll_interval) {
+}
+
+FileWatcher::~FileWatcher() {
+  {
+    ftl::MutexLocker locker(&mutex_);
+    quit_ = true;
+  }
+  quit_cv_.Signal();
+#if defined(OS_LINUX)
+  if (poller_)
+    poller_->Wakeup();
+#endif
+  if (thread_)
+    thread_->Join();
+}
+
+bool FileWatcher::Init() {
+#if defined(OS_LINUX)
+  if (!polling_) {
+    inotify_fd_.reset(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+    if (!inotify_fd_.is_valid())
+      return false;
+    poller_ = ftl::internal::IOPoller::Create();
+    if (!poller_ || !poller_->Add(inotify_fd_.get(),
+                                  ftl::internal::IOPoller::kReadable, 1u))
+      return false;
+  }
+#endif
+  thread_.reset(new ftl::Thread([this] { ThreadMain(); }));
+  ftl::Thread::Options options;
+  options.name = "file_watcher";
+  return thread_->Run(options);
+}
+
+uint64_t FileWatcher::Watch(const std::string& path,
+                            ftl::RefPtr<ftl::TaskRunner> task_runner,
+                            Callback callback) {
+  FTL_DCHECK(task_runner);
+  FTL_DCHECK(callback);
+  auto state = std::make_shared<WatchState>();
+  state->path = path;
+  state->name = GetBaseName(path);
+  state->task_runner = std::move(task_runner);
+  state->callback = std::move(callback);
+  if (state->name.empty())
+    return 0u;
+  std::string directory = GetDirectoryName(path);
+  if (directory.empty())
+    directory = ".";
+
+  if (polling_) {
+    if (!IsDirectory(directory))
+      return 0u;
+    state->file_state = GetFileState(path);
+    ftl::MutexLocker locker(&mutex_);
+    uint64_t id = next_id_++;
+    watches_[id] = std::move(state);
+    return id;
+  }
+
+#if defined(OS_LINUX)
+  ftl::MutexLocker locker(&mutex_);
+  // This returns the same descriptor for a directory that's already watched.
+  int watch_descriptor =
+      inotify_add_watch(inotify_fd_.get(), directory.c_str(), kInotifyMask);
+  if (watch_descriptor < 0)
+    return 0u;
+  state->watch_descriptor = watch_descriptor;
+  directory_watches_[watch_descriptor].push_back(state);
+  uint64_t id = next_id_++;
+  watches_[id] = std::move(state);
+  return id;
+#else
+  return 0u;
+#endif
+}
+
+void FileWatcher::Unwatch(uint64_t id) {
+  ftl::MutexLocker locker(&mutex_);
+  auto it = watches_.find(id);
+  if (it == watches_.end())
+    return;
+  std::shared_ptr<WatchState> state = std::move(it->second);
+  watches_.erase(it);
+  state->active = false;
+
+#if defined(OS_LINUX)
+  if (polling_)
+    return;
+  // The directory's entry is gone if the directory was (and reported).
+  auto directory_it = directory_watches_.find(state->watch_descriptor);
+  if (directory_it == directory_watches_.end())
+    return;
+  std::vector<std::shared_ptr<WatchState>>& states = directory_it->second;
+  states.erase(std::find(states.begin(), states.end(), state));
+  if (states.empty()) {
+    inotify_rm_watch(inotify_fd_.get(), state->watch_descriptor);
+    directory_watches_.erase(directory_it);
+  }
+#endif
+}
+
+void FileWatcher::ThreadMain() {
+  std::vector<Notification> notifications;
+#if defined(OS_LINUX)
+  std::vector<ftl::internal::IOPoller::Event> events;
+#endif
+  for (;;) {
+    notifications.clear();
+    if (polling_) {
+      {
+        ftl::MutexLocker locker(&mutex_);
+        if (!quit_)
+          quit_cv_.WaitWithTimeout(&mutex_, poll_interval_);
+        if (quit_)
+          return;
+      }
+      Poll(&notifications);
+    } else {
+#if defined(OS_LINUX)
+      events.clear();
+      poller_->Wait(ftl::TimeDelta::Max(), &events);
+      {
+        ftl::MutexLocker locker(&mutex_);
+        if (quit_)
+          return;
+      }
+      ReadEvents(&notifications);
+#endif
+    }
+    Notify(notifications);
+  }
+}
+
+void FileWatcher::Poll(std::vector<Notification>* notifications) {
+  std::vector<std::shared_ptr<WatchState>> states;
+  {
+    ftl::MutexLocker locker(&mutex_);
+    states.reserve(watches_.size());
+    for (const auto& watch : watches_)
+      states.push_back(watch.second);
+  }
+
+  for (const auto& state : states) {
+    FileState current = GetFileState(state->path);
+    const FileState& last = state->file_state;
+    if (current.exists != last.exists) {
+      notifications->emplace_back(
+          state, current.exists ? Event::kCreated : Event::kDeleted);
+    } else if (current.exists) {
+      // A different file may have been moved into place.
+      if (current.inode != last.inode) {
+        notifications->emplace_back(state, Event::kCreated);
+      } else if (current.size != last.size ||
+                 current.modified != last.modified) {
+        notifications->emplace_back(state, Event::kModified);
+      }
+    }
+    state->file_state = current;
+  }
+}
+
+// static
+FileWatcher::FileState FileWatcher::GetFileState(const std::string& path) {
+  FileState file_state;
+  struct stat stat_buffer;
+  if (stat(path.c_str(), &stat_buffer) != 0)
+    return file_state;
+  file_state.exists = true;
+  file_state.inode = static_cast<uint64_t>(stat_buffer.st_ino);
+  file_state.size = static_cast<uint64_t>(stat_buffer.st_size);
+#if defined(OS_MACOSX) || defined(OS_IOS)
+  const struct timespec& modified = stat_buffer.st_mtimespec;
+#else
+  const struct timespec& modified = stat_buffer.st_mtim;
+#endif
+  file_state.modified =
+      static_cast<int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec;
+  return file_state;
+}
+
+#if defined(OS_LINUX)
+
+void FileWatcher::ReadEvents(std::vector<Notification>* notifications) {
+  // The last event reported for each watch, to coalesce repeats (e.g., one
+  // |IN_MODIFY| per write).
+  std::map<WatchState*, Event> last_events;
+  auto add = [notifications, &last_events](
+                 const std::shared_ptr<WatchState>& state, Event event) {
+    auto result = last_events.emplace(state.get(), event);
+    if (!result.second) {
+      if (result.first->second == event)
+        return;
+      result.first->second = event;
+    }
+    notifications->emplace_back(state, event);
+  };
+
+  alignas(struct inotify_event) char buffer[16384];
+  for (;;) {
+    ssize_t size =
+        HANDLE_EINTR(read(inotify_fd_.get(), buffer, sizeof(buffer)));
+    if (size <= 0)
+      break;
+
+    ftl::MutexLocker locker(&mutex_);
+    for (ssize_t offset = 0; offset < size;) {
+      const struct inotify_event* event =
+          reinterpret_cast<const struct inotify_event*>(buffer + offset);
+      offset += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, so anything may have changed.
+        for (const auto& directory : directory_watches_) {
+          for (const auto& state : directory.second)
+            add(state, Event::kModified);
+        }
+        continue;
+      }
+      auto directory_it = directory_watches_.find(event->wd);
+      if (directory_it == directory_watches_.end())
+        continue;
+      if (event->mask & IN_IGNORED) {
+        // The directory was deleted (or unmounted), and with it the files.
+        for (const auto& state : directory_it->second)
+          add(state, Event::kDeleted);
+        directory_watches_.erase(directory_it);
+        continue;
+      }
+      if (!event->len)
+        continue;
+      // |event->name| is null-terminated (and maybe padded with more nulls).
+      const char* name = event->name;
+      for (const auto& state : directory_it->second) {
+        if (state->name == name)
+          add(state, GetEvent(event->mask));
+      }
+    }
+  }
+}
+
+#endif  // defined(OS_LINUX)
+
+// static
+void FileWatcher::Notify(const std::vector<Notification>& notifications) {
+  for (const auto& notification : notifications) {
+    std::shared_ptr<WatchState> state = notification.first;
+    Event event = notification.second;
+    state->task_runner->PostTask([state, event] {
+      if (state->active)
+        state->callback(event);
+    });
+  }
+}
+
+}  // namespace files
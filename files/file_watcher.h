@@ -0,0 +1,132 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_FILE_WATCHER_H_
+#define LIB_FTL_FILES_FILE_WATCHER_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/io_poller.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace files {
+
+// Watches files for changes, posting a callback to a |TaskRunner| for each,
+// e.g.:
+//
+//   auto watcher = FileWatcher::Create();
+//   watcher->Watch(config_path, loop, [](FileWatcher::Event event) {
+//     ReloadConfig();
+//   });
+//
+// A watched file needn't exist (but its directory must): creating it, or
+// moving another file into its place (as |WriteFileInTwoPhases()| does), is
+// reported as |Event::kCreated|. Changes to a watched directory's contents are
+// not reported. If the directory is deleted, so is the file: with inotify, its
+// watch then reports nothing more.
+//
+// On Linux, this uses inotify (watching each file's directory, so that
+// replacing the file doesn't lose the watch), so changes are reported within
+// milliseconds. Elsewhere (or with |Options::force_polling|), it checks each
+// file's status every |Options::poll_interval|. Either way, it uses one thread
+// for all its watches. Bursts of changes (e.g., a series of writes) may be
+// reported as one event; a change may also be reported as several.
+//
+// This is thread-safe.
+class FTL_EXPORT FileWatcher {
+ public:
+  enum class Event { kCreated, kModified, kDeleted };
+
+  using Callback = std::function<void(Event event)>;
+
+  struct Options {
+    bool force_polling = false;
+    ftl::TimeDelta poll_interval = ftl::TimeDelta::FromSeconds(1);
+  };
+
+  // Returns null on failure (e.g., if out of file descriptors).
+  static std::unique_ptr<FileWatcher> Create();
+  static std::unique_ptr<FileWatcher> Create(const Options& options);
+
+  ~FileWatcher();
+
+  // Whether this polls (rather than using inotify).
+  bool is_polling() const { return polling_; }
+
+  // Starts watching |path|, calling |callback| on |task_runner| for each
+  // change. Returns an id for |Unwatch()|, or 0 on failure (e.g., if |path|'s
+  // directory doesn't exist).
+  uint64_t Watch(const std::string& path,
+                 ftl::RefPtr<ftl::TaskRunner> task_runner,
+                 Callback callback);
+
+  // Stops watching; callbacks which have been posted but not run yet are
+  // dropped (when they run) from then on.
+  void Unwatch(uint64_t id);
+
+ private:
+  struct WatchState;
+  struct FileState {
+    bool exists = false;
+    uint64_t inode = 0u;
+    uint64_t size = 0u;
+    int64_t modified = 0;
+  };
+  using Notification = std::pair<std::shared_ptr<WatchState>, Event>;
+
+  explicit FileWatcher(const Options& options);
+
+  bool Init();
+  void ThreadMain();
+  void Poll(std::vector<Notification>* notifications);
+  static FileState GetFileState(const std::string& path);
+#if defined(OS_LINUX)
+  void ReadEvents(std::vector<Notification>* notifications);
+#endif
+  static void Notify(const std::vector<Notification>& notifications);
+
+  const bool polling_;
+  const ftl::TimeDelta poll_interval_;
+
+  std::unique_ptr<ftl::Thread> thread_;
+
+  ftl::Mutex mutex_;
+  // For polling: signaled when |quit_| is set.
+  ftl::CondVar quit_cv_;
+  bool quit_ FTL_GUARDED_BY(mutex_) = false;
+  uint64_t next_id_ FTL_GUARDED_BY(mutex_) = 1u;
+  std::map<uint64_t, std::shared_ptr<WatchState>> watches_
+      FTL_GUARDED_BY(mutex_);
+
+#if defined(OS_LINUX)
+  ftl::UniqueFD inotify_fd_;
+  std::unique_ptr<ftl::internal::IOPoller> poller_;
+  // The watches (other than when polling) for each inotify watch descriptor
+  // (i.e., directory).
+  std::map<int, std::vector<std::shared_ptr<WatchState>>> directory_watches_
+      FTL_GUARDED_BY(mutex_);
+#endif
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FileWatcher);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_FILE_WATCHER_H_
@@ -0,0 +1,180 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/file_watcher.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/tasks/thread_pool.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace files {
+namespace {
+
+using Event = FileWatcher::Event;
+
+// Records the events for a watch.
+class EventRecorder {
+ public:
+  FileWatcher::Callback callback() {
+    return [this](Event event) {
+      ftl::MutexLocker locker(&mutex_);
+      events_.push_back(event);
+      cv_.SignalAll();
+    };
+  }
+
+  // Waits for |event|, then forgets it and the events before it. Returns false
+  // on timeout.
+  bool WaitFor(Event event) {
+    const ftl::TimePoint deadline =
+        ftl::TimePoint::Now() + ftl::TimeDelta::FromSeconds(10);
+    ftl::MutexLocker locker(&mutex_);
+    for (;;) {
+      auto it = std::find(events_.begin(), events_.end(), event);
+      if (it != events_.end()) {
+        events_.erase(events_.begin(), it + 1);
+        return true;
+      }
+      if (cv_.WaitUntil(&mutex_, deadline))
+        return false;
+    }
+  }
+
+  std::vector<Event> events() {
+    ftl::MutexLocker locker(&mutex_);
+    return events_;
+  }
+
+ private:
+  ftl::Mutex mutex_;
+  ftl::CondVar cv_;
+  std::vector<Event> events_ FTL_GUARDED_BY(mutex_);
+};
+
+std::unique_ptr<FileWatcher> CreateWatcher(bool force_polling) {
+  FileWatcher::Options options;
+  options.force_polling = force_polling;
+  options.poll_interval = ftl::TimeDelta::FromMilliseconds(10);
+  auto watcher = FileWatcher::Create(options);
+  EXPECT_TRUE(watcher);
+  return watcher;
+}
+
+ftl::RefPtr<ftl::ThreadPool> CreatePool() {
+  auto pool = ftl::MakeRefCounted<ftl::ThreadPool>(1u);
+  EXPECT_TRUE(pool->Start());
+  return pool;
+}
+
+TEST(FileWatcher, CreateModifyDelete) {
+  for (bool force_polling : {false, true}) {
+    SCOPED_TRACE(force_polling);
+    ScopedTempDir dir;
+    const std::string path = dir.path() + "/file";
+    auto pool = CreatePool();
+    EventRecorder recorder;
+    {
+      auto watcher = CreateWatcher(force_polling);
+      ASSERT_TRUE(watcher);
+#if !defined(OS_LINUX)
+      EXPECT_TRUE(watcher->is_polling());
+#endif
+      ASSERT_NE(0u, watcher->Watch(path, pool, recorder.callback()));
+
+      ASSERT_TRUE(WriteFile(path, "a", 1));
+      EXPECT_TRUE(recorder.WaitFor(Event::kCreated));
+      ASSERT_TRUE(WriteFile(path, "abc", 3));
+      EXPECT_TRUE(recorder.WaitFor(Event::kModified));
+      ASSERT_EQ(0, unlink(path.c_str()));
+      EXPECT_TRUE(recorder.WaitFor(Event::kDeleted));
+    }
+    pool->Shutdown();
+  }
+}
+
+TEST(FileWatcher, Replace) {
+  for (bool force_polling : {false, true}) {
+    SCOPED_TRACE(force_polling);
+    ScopedTempDir dir;
+    const std::string path = dir.path() + "/file";
+    ASSERT_TRUE(WriteFile(path, "a", 1));
+    auto pool = CreatePool();
+    EventRecorder recorder;
+    {
+      auto watcher = CreateWatcher(force_polling);
+      ASSERT_TRUE(watcher);
+      ASSERT_NE(0u, watcher->Watch(path, pool, recorder.callback()));
+
+      // This moves a new file (of the same size) into place.
+      ASSERT_TRUE(WriteFileInTwoPhases(path, "b", dir.path()));
+      EXPECT_TRUE(recorder.WaitFor(Event::kCreated));
+    }
+    pool->Shutdown();
+  }
+}
+
+TEST(FileWatcher, OnlyWatchedFilesUntilUnwatched) {
+  for (bool force_polling : {false, true}) {
+    SCOPED_TRACE(force_polling);
+    ScopedTempDir dir;
+    auto pool = CreatePool();
+    EventRecorder unwatched_recorder;
+    EventRecorder recorder;
+    {
+      auto watcher = CreateWatcher(force_polling);
+      ASSERT_TRUE(watcher);
+      uint64_t unwatched_id = watcher->Watch(dir.path() + "/unwatched", pool,
+                                             unwatched_recorder.callback());
+      ASSERT_NE(0u, unwatched_id);
+      uint64_t id =
+          watcher->Watch(dir.path() + "/watched", pool, recorder.callback());
+      ASSERT_NE(0u, id);
+      EXPECT_NE(unwatched_id, id);
+      watcher->Unwatch(unwatched_id);
+      // Unknown ids are ignored.
+      watcher->Unwatch(unwatched_id);
+      watcher->Unwatch(0u);
+
+      ASSERT_TRUE(WriteFile(dir.path() + "/other", "x", 1));
+      ASSERT_TRUE(WriteFile(dir.path() + "/unwatched", "x", 1));
+      ASSERT_TRUE(WriteFile(dir.path() + "/watched", "x", 1));
+      // Events are reported in order, so any for the other files would have
+      // been by now.
+      EXPECT_TRUE(recorder.WaitFor(Event::kCreated));
+    }
+    pool->Shutdown();
+    EXPECT_TRUE(unwatched_recorder.events().empty());
+  }
+}
+
+TEST(FileWatcher, DirectoryMustExist) {
+  for (bool force_polling : {false, true}) {
+    SCOPED_TRACE(force_polling);
+    ScopedTempDir dir;
+    auto pool = CreatePool();
+    EventRecorder recorder;
+    {
+      auto watcher = CreateWatcher(force_polling);
+      ASSERT_TRUE(watcher);
+      EXPECT_EQ(0u, watcher->Watch(dir.path() + "/missing/file", pool,
+                                   recorder.callback()));
+      EXPECT_EQ(0u, watcher->Watch(dir.path() + "/", pool,
+                                   recorder.callback()));
+    }
+    pool->Shutdown();
+  }
+}
+
+}  // namespace
+}  // namespace files
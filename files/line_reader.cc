@@ -0,0 +1,94 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/line_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+
+namespace files {
+
+LineReader::LineReader(ftl::UniqueFD fd)
+    : LineReader(std::move(fd), Options()) {}
+
+LineReader::LineReader(ftl::UniqueFD fd, const Options& options)
+    : fd_(std::move(fd)),
+      capacity_(std::max<size_t>(options.buffer_size, 1u)) {
+  buffer_.reset(new char[capacity_]);
+#if defined(OS_LINUX)
+  // Read ahead more (this fails harmlessly on pipes).
+  if (fd_.is_valid())
+    posix_fadvise(fd_.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+LineReader::~LineReader() = default;
+
+bool LineReader::Next(ftl::StringView* line) {
+  for (;;) {
+    const char* newline = static_cast<const char*>(
+        memchr(buffer_.get() + scanned_, '\n', end_ - scanned_));
+    size_t size;
+    if (newline) {
+      size = static_cast<size_t>(newline - buffer_.get()) - begin_;
+      scanned_ = begin_ + size + 1u;
+    } else if (!Fill()) {
+      if (error_ || begin_ == end_)
+        return false;
+      // The last line, without a "\n".
+      size = end_ - begin_;
+      scanned_ = end_;
+    } else {
+      continue;
+    }
+
+    const char* start = buffer_.get() + begin_;
+    begin_ = scanned_;
+    if (newline && size && start[size - 1u] == '\r')
+      size--;
+    *line = ftl::StringView(start, size);
+    line_count_++;
+    return true;
+  }
+}
+
+bool LineReader::Fill() {
+  if (at_end_)
+    return false;
+  // Only the start of a line is left, so this moves little.
+  if (begin_ > 0u) {
+    memmove(buffer_.get(), buffer_.get() + begin_, end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0u;
+  }
+  if (end_ == capacity_) {
+    // The line doesn't fit.
+    std::unique_ptr<char[]> buffer(new char[capacity_ * 2u]);
+    memcpy(buffer.get(), buffer_.get(), end_);
+    buffer_ = std::move(buffer);
+    capacity_ *= 2u;
+  }
+  scanned_ = end_;
+
+  ssize_t result =
+      HANDLE_EINTR(read(fd_.get(), buffer_.get() + end_, capacity_ - end_));
+  if (result <= 0) {
+    if (result < 0)
+      error_ = errno;
+    at_end_ = true;
+    return false;
+  }
+  end_ += static_cast<size_t>(result);
+  return true;
+}
+
+}  // namespace files
@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_LINE_READER_H_
+#define LIB_FTL_FILES_LINE_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace files {
+
+// Reads a file (or pipe, etc.) a line at a time, through a buffer that's
+// reused for every line, so that memory use is bounded by the longest line
+// rather than the file's size, e.g.:
+//
+//   LineReader reader(ftl::UniqueFD(open(path, O_RDONLY)));
+//   ftl::StringView line;
+//   while (reader.Next(&line))
+//     Process(line);
+//   if (reader.error()) { ... }
+//
+// Lines end with "\n" or "\r\n" (which aren't included in them; a lone "\r"
+// is kept). The last line needn't end with either.
+class FTL_EXPORT LineReader {
+ public:
+  struct Options {
+    // The size of each read. The buffer grows beyond this to hold a longer
+    // line.
+    size_t buffer_size = 64u * 1024u;
+  };
+
+  // Reads from |fd| at its current offset.
+  explicit LineReader(ftl::UniqueFD fd);
+  LineReader(ftl::UniqueFD fd, const Options& options);
+  ~LineReader();
+
+  // Sets |*line| to the next line (valid until the next call), or returns
+  // false at the end (or on failure, see |error()|).
+  bool Next(ftl::StringView* line);
+
+  // The |errno| with which reading failed, or 0.
+  int error() const { return error_; }
+
+  // The number of lines returned so far.
+  uint64_t line_count() const { return line_count_; }
+
+ private:
+  // Reads more data after the unconsumed part of the buffer (moving it to the
+  // front, or growing the buffer, to make room). Returns false at the end or
+  // on failure.
+  bool Fill();
+
+  ftl::UniqueFD fd_;
+  std::unique_ptr<char[]> buffer_;
+  size_t capacity_;
+  // The unconsumed data is [|begin_|, |end_|), and has no "\n" before
+  // |scanned_|.
+  size_t begin_ = 0u;
+  size_t scanned_ = 0u;
+  size_t end_ = 0u;
+  bool at_end_ = false;
+  int error_ = 0;
+  uint64_t line_count_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LineReader);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_LINE_READER_H_
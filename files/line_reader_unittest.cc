@@ -0,0 +1,102 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/line_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/file_descriptor.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+std::vector<std::string> ReadLines(const std::string& content,
+                                   size_t buffer_size) {
+  ScopedTempDir dir;
+  const std::string path = dir.path() + "/file";
+  EXPECT_TRUE(WriteFile(path, content.data(), content.size()));
+  LineReader::Options options;
+  options.buffer_size = buffer_size;
+  LineReader reader(ftl::UniqueFD(open(path.c_str(), O_RDONLY)), options);
+  std::vector<std::string> lines;
+  ftl::StringView line;
+  while (reader.Next(&line))
+    lines.push_back(line.ToString());
+  EXPECT_EQ(0, reader.error());
+  EXPECT_EQ(lines.size(), reader.line_count());
+  // It stays at the end.
+  EXPECT_FALSE(reader.Next(&line));
+  return lines;
+}
+
+TEST(LineReader, Lines) {
+  using Lines = std::vector<std::string>;
+  // Buffer sizes around the lines' sizes, so that lines and "\r\n"s span
+  // reads.
+  for (size_t buffer_size : {1u, 2u, 3u, 5u, 64u * 1024u}) {
+    SCOPED_TRACE(buffer_size);
+    EXPECT_EQ(Lines(), ReadLines("", buffer_size));
+    EXPECT_EQ(Lines({""}), ReadLines("\n", buffer_size));
+    EXPECT_EQ(Lines({"a", "bc", "", "def"}),
+              ReadLines("a\nbc\n\ndef\n", buffer_size));
+    EXPECT_EQ(Lines({"a", "bc"}), ReadLines("a\nbc", buffer_size));
+    EXPECT_EQ(Lines({"a", "", "b\rc", "d\r"}),
+              ReadLines("a\r\n\r\nb\rc\r\nd\r", buffer_size));
+  }
+}
+
+TEST(LineReader, LongLines) {
+  const std::string long_line(100000u, 'x');
+  std::vector<std::string> lines =
+      ReadLines("short\n" + long_line + "\nshort\n" + long_line, 4096u);
+  ASSERT_EQ(4u, lines.size());
+  EXPECT_EQ("short", lines[0]);
+  EXPECT_EQ(long_line, lines[1]);
+  EXPECT_EQ("short", lines[2]);
+  EXPECT_EQ(long_line, lines[3]);
+}
+
+TEST(LineReader, Pipe) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ftl::UniqueFD write_fd(fds[1]);
+  std::thread writer([&write_fd] {
+    for (int i = 0; i < 1000; i++) {
+      std::string line = std::to_string(i) + "\n";
+      EXPECT_TRUE(ftl::WriteFileDescriptor(write_fd.get(), line.data(),
+                                           line.size()));
+    }
+    write_fd.reset();
+  });
+
+  LineReader reader((ftl::UniqueFD(fds[0])));
+  ftl::StringView line;
+  int count = 0;
+  while (reader.Next(&line)) {
+    EXPECT_EQ(std::to_string(count), line.ToString());
+    count++;
+  }
+  writer.join();
+  EXPECT_EQ(1000, count);
+  EXPECT_EQ(0, reader.error());
+}
+
+TEST(LineReader, Error) {
+  LineReader reader((ftl::UniqueFD()));
+  ftl::StringView line;
+  EXPECT_FALSE(reader.Next(&line));
+  EXPECT_EQ(EBADF, reader.error());
+}
+
+}  // namespace
+}  // namespace files
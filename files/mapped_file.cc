@@ -0,0 +1,129 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <limits>
+#include <utility>
+
+#include "lib/ftl/files/eintr_wrapper.h"
+
+namespace files {
+
+MappedFile::MappedFile() = default;
+
+MappedFile::MappedFile(MappedFile&& other)
+    : data_(other.data_),
+      size_(other.size_),
+      valid_(other.valid_),
+      mode_(other.mode_) {
+  other.data_ = nullptr;
+  other.size_ = 0u;
+  other.valid_ = false;
+}
+
+MappedFile::~MappedFile() {
+  Reset();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  if (this != &other) {
+    Reset();
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(valid_, other.valid_);
+    mode_ = other.mode_;
+  }
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& path, Mode mode) {
+  Reset();
+  ftl::UniqueFD fd(HANDLE_EINTR(
+      open(path.c_str(), mode == Mode::kReadWrite ? O_RDWR : O_RDONLY)));
+  if (!fd.is_valid())
+    return false;
+  return Map(fd, mode);
+}
+
+bool MappedFile::Map(const ftl::UniqueFD& fd, Mode mode) {
+  Reset();
+  if (!fd.is_valid())
+    return false;
+  struct stat stat_buffer;
+  if (fstat(fd.get(), &stat_buffer) != 0 || !S_ISREG(stat_buffer.st_mode))
+    return false;
+  if (static_cast<uint64_t>(stat_buffer.st_size) >
+      std::numeric_limits<size_t>::max())
+    return false;
+  const size_t size = static_cast<size_t>(stat_buffer.st_size);
+
+  // (|mmap()| rejects empty mappings.)
+  if (size) {
+    int protection =
+        mode == Mode::kReadWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* data = mmap(nullptr, size, protection, MAP_SHARED, fd.get(), 0);
+    if (data == MAP_FAILED)
+      return false;
+    data_ = static_cast<char*>(data);
+  }
+  size_ = size;
+  valid_ = true;
+  mode_ = mode;
+  return true;
+}
+
+void MappedFile::Reset() {
+  if (data_) {
+    int result = munmap(data_, size_);
+    FTL_DCHECK(result == 0);
+  }
+  data_ = nullptr;
+  size_ = 0u;
+  valid_ = false;
+}
+
+bool MappedFile::Advise(Advice advice) const {
+  FTL_DCHECK(valid_);
+  if (!data_)
+    return true;
+  int value;
+  switch (advice) {
+    case Advice::kNormal:
+      value = MADV_NORMAL;
+      break;
+    case Advice::kSequential:
+      value = MADV_SEQUENTIAL;
+      break;
+    case Advice::kRandom:
+      value = MADV_RANDOM;
+      break;
+    case Advice::kWillNeed:
+      value = MADV_WILLNEED;
+      break;
+    case Advice::kHugePage:
+#if defined(MADV_HUGEPAGE)
+      value = MADV_HUGEPAGE;
+      break;
+#else
+      return false;
+#endif
+    default:
+      return false;
+  }
+  return madvise(data_, size_, value) == 0;
+}
+
+bool MappedFile::Sync() const {
+  FTL_DCHECK(valid_);
+  if (!data_ || mode_ != Mode::kReadWrite)
+    return true;
+  return msync(data_, size_, MS_SYNC) == 0;
+}
+
+}  // namespace files
@@ -0,0 +1,105 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_MAPPED_FILE_H_
+#define LIB_FTL_FILES_MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace files {
+
+// A memory mapping of a whole file, e.g., to use a large file in place rather
+// than copying it into the heap with |ReadFileToString()|: pages are read in
+// on demand (and may be shared with other processes, and dropped under memory
+// pressure). The mapping is unmapped when this object is destroyed; like a
+// |ftl::UniqueFD|, it can be moved but not copied.
+//
+//   files::MappedFile index;
+//   if (!index.Open(path))
+//     return false;
+//   index.Advise(files::MappedFile::Advice::kWillNeed);
+//   ftl::StringView contents = index.view();
+//
+// An empty file maps to an empty (but valid) |MappedFile|. The file mustn't be
+// truncated while it's mapped (accessing pages past its end raises SIGBUS).
+class FTL_EXPORT MappedFile {
+ public:
+  enum class Mode {
+    kReadOnly,
+    // Writes to |mutable_data()| go to the file (see |Sync()|).
+    kReadWrite,
+  };
+
+  // Hints (to |madvise()|) about how the mapping will be used.
+  enum class Advice {
+    kNormal,
+    // Read ahead aggressively, and free pages soon after they're read.
+    kSequential,
+    // Don't read ahead.
+    kRandom,
+    // Start reading in the whole file now.
+    kWillNeed,
+    // Use huge pages, where supported (e.g., for anonymous or tmpfs files on
+    // Linux).
+    kHugePage,
+  };
+
+  MappedFile();
+  MappedFile(MappedFile&& other);
+  ~MappedFile();
+
+  MappedFile& operator=(MappedFile&& other);
+
+  // Maps the file at |path| (replacing any previous mapping). Returns false,
+  // leaving this object invalid, on error.
+  bool Open(const std::string& path, Mode mode = Mode::kReadOnly);
+
+  // Like |Open()|, but for an open file (which must have been opened for
+  // writing for |Mode::kReadWrite|). |fd| needn't stay open after this returns.
+  bool Map(const ftl::UniqueFD& fd, Mode mode = Mode::kReadOnly);
+
+  // Unmaps the file.
+  void Reset();
+
+  bool is_valid() const { return valid_; }
+  Mode mode() const { return mode_; }
+
+  const char* data() const { return data_; }
+  // Only for |Mode::kReadWrite|.
+  char* mutable_data() const {
+    FTL_DCHECK(mode_ == Mode::kReadWrite);
+    return data_;
+  }
+  const uint8_t* bytes() const { return reinterpret_cast<uint8_t*>(data_); }
+  size_t size() const { return size_; }
+  ftl::StringView view() const { return ftl::StringView(data_, size_); }
+
+  // Returns false if the hint isn't supported.
+  bool Advise(Advice advice) const;
+
+  // Writes the changes (for |Mode::kReadWrite|) to the file, returning when
+  // they're written. (They're written eventually anyway.)
+  bool Sync() const;
+
+ private:
+  char* data_ = nullptr;
+  size_t size_ = 0u;
+  bool valid_ = false;
+  Mode mode_ = Mode::kReadOnly;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_MAPPED_FILE_H_
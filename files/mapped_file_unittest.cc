@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/mapped_file.h"
+
+#include <fcntl.h>
+
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+TEST(MappedFile, ReadOnly) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  std::string content(10000u, 'x');
+  content += "Hello World";
+  ASSERT_TRUE(WriteFile(path, content.data(), content.size()));
+
+  MappedFile file;
+  EXPECT_FALSE(file.is_valid());
+  ASSERT_TRUE(file.Open(path));
+  EXPECT_TRUE(file.is_valid());
+  EXPECT_EQ(MappedFile::Mode::kReadOnly, file.mode());
+  EXPECT_EQ(content.size(), file.size());
+  EXPECT_EQ(content, file.view());
+  EXPECT_EQ('H', file.data()[10000]);
+  EXPECT_EQ('W', file.bytes()[10006]);
+
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kSequential));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kWillNeed));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kRandom));
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kNormal));
+  // (Huge pages may not be supported for this file.)
+  file.Advise(MappedFile::Advice::kHugePage);
+  EXPECT_EQ(content, file.view());
+
+  file.Reset();
+  EXPECT_FALSE(file.is_valid());
+  EXPECT_EQ(0u, file.size());
+}
+
+TEST(MappedFile, ReadWrite) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  std::string content = "Hello World";
+  ASSERT_TRUE(WriteFile(path, content.data(), content.size()));
+
+  {
+    MappedFile file;
+    ASSERT_TRUE(file.Open(path, MappedFile::Mode::kReadWrite));
+    EXPECT_EQ(MappedFile::Mode::kReadWrite, file.mode());
+    file.mutable_data()[0] = 'J';
+    EXPECT_TRUE(file.Sync());
+    EXPECT_EQ("Jello World", file.view());
+  }
+
+  std::string read_content;
+  ASSERT_TRUE(ReadFileToString(path, &read_content));
+  EXPECT_EQ("Jello World", read_content);
+}
+
+TEST(MappedFile, Map) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  ASSERT_TRUE(WriteFile(path, "abc", 3));
+
+  MappedFile file;
+  {
+    ftl::UniqueFD fd(open(path.c_str(), O_RDONLY));
+    ASSERT_TRUE(fd.is_valid());
+    ASSERT_TRUE(file.Map(fd));
+  }
+  // The mapping outlives the descriptor.
+  EXPECT_EQ("abc", file.view());
+
+  EXPECT_FALSE(file.Map(ftl::UniqueFD()));
+  EXPECT_FALSE(file.is_valid());
+}
+
+TEST(MappedFile, Empty) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+
+  MappedFile file;
+  ASSERT_TRUE(file.Open(path));
+  EXPECT_TRUE(file.is_valid());
+  EXPECT_EQ(0u, file.size());
+  EXPECT_TRUE(file.view().empty());
+  EXPECT_TRUE(file.Advise(MappedFile::Advice::kWillNeed));
+  EXPECT_TRUE(file.Sync());
+}
+
+TEST(MappedFile, Errors) {
+  ScopedTempDir dir;
+  MappedFile file;
+  EXPECT_FALSE(file.Open(dir.path() + "/missing"));
+  EXPECT_FALSE(file.is_valid());
+  // Directories can't be mapped.
+  EXPECT_FALSE(file.Open(dir.path()));
+  EXPECT_FALSE(file.is_valid());
+}
+
+TEST(MappedFile, Move) {
+  ScopedTempDir dir;
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  ASSERT_TRUE(WriteFile(path, "abc", 3));
+
+  MappedFile a;
+  ASSERT_TRUE(a.Open(path));
+  MappedFile b(std::move(a));
+  EXPECT_FALSE(a.is_valid());
+  EXPECT_TRUE(b.is_valid());
+  EXPECT_EQ("abc", b.view());
+
+  a = std::move(b);
+  EXPECT_TRUE(a.is_valid());
+  EXPECT_FALSE(b.is_valid());
+  EXPECT_EQ("abc", a.view());
+}
+
+}  // namespace
+}  // namespace files
@@ -5,9 +5,12 @@
 #ifndef LIB_FTL_FILES_PATH_H_
 #define LIB_FTL_FILES_PATH_H_
 
+#include <stddef.h>
+
 #include <string>
 
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
 
 namespace files {
 
@@ -15,6 +18,11 @@ namespace files {
 // the file system.
 FTL_EXPORT std::string SimplifyPath(std::string path);
 
+// Like |SimplifyPath()|, but simplifies the |size| characters at |path| in
+// place, without allocating. Returns the result, which starts at |path| (or is
+// "." if it would be empty) and isn't null-terminated.
+FTL_EXPORT ftl::StringView SimplifyPathInPlace(char* path, size_t size);
+
 // Returns the absolute path of a possibly relative path.
 // It doesn't consult the filesystem or simplify the path.
 FTL_EXPORT std::string AbsolutePath(const std::string& path);
@@ -26,10 +34,22 @@ FTL_EXPORT std::string GetDirectoryName(const std::string& path);
 // to and including the last slash.
 FTL_EXPORT std::string GetBaseName(const std::string& path);
 
+// Like |GetDirectoryName()| and |GetBaseName()|, but return views of |path|
+// (or of a constant) rather than copies.
+FTL_EXPORT ftl::StringView GetDirectoryNameView(ftl::StringView path);
+FTL_EXPORT ftl::StringView GetBaseNameView(ftl::StringView path);
+
 // Delete the file or directly at the given path. If recursive is true, and path
 // is a directory, also delete the directory's content.
 FTL_EXPORT bool DeletePath(const std::string& path, bool recursive);
 
+// Like |DeletePath(path, true)|, but deletes subdirectories concurrently on
+// |thread_count| threads (e.g., for a tree with very many files). If a
+// directory can't be read or removed, this deletes as much as it can and then
+// returns false.
+FTL_EXPORT bool DeletePathInParallel(const std::string& path,
+                                     size_t thread_count);
+
 }  // namespace files
 
 #endif  // LIB_FTL_FILES_PATH_H_
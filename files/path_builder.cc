@@ -0,0 +1,45 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/path_builder.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace files {
+
+PathBuilder::PathBuilder() = default;
+
+PathBuilder::PathBuilder(ftl::StringView path)
+    : path_(path.data(), path.size()) {}
+
+PathBuilder::~PathBuilder() = default;
+
+void PathBuilder::Append(ftl::StringView component) {
+  if (component.empty())
+    return;
+  const bool needs_separator =
+      !path_.empty() && path_.back() != '/' && component.front() != '/';
+  if (needs_separator)
+    path_.push_back('/');
+  path_.append(component.data(), component.size());
+}
+
+void PathBuilder::Truncate(size_t size) {
+  FTL_DCHECK(size <= path_.size());
+  path_.resize(size);
+}
+
+void PathBuilder::Reserve(size_t capacity) {
+  path_.reserve(capacity);
+}
+
+std::string PathBuilder::TakePath() {
+  std::string path = std::move(path_);
+  path_.clear();
+  return path;
+}
+
+}  // namespace files
@@ -0,0 +1,60 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FILES_PATH_BUILDER_H_
+#define LIB_FTL_FILES_PATH_BUILDER_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace files {
+
+// Joins path components in one buffer, so that building many paths (e.g., for
+// the entries of a directory tree) doesn't allocate a string for each:
+//
+//   PathBuilder builder(root);
+//   for (...) {
+//     size_t root_size = builder.size();
+//     builder.Append(name);
+//     Use(builder.c_str());
+//     builder.Truncate(root_size);
+//   }
+class FTL_EXPORT PathBuilder {
+ public:
+  PathBuilder();
+  explicit PathBuilder(ftl::StringView path);
+  ~PathBuilder();
+
+  // Appends |component| (which may itself have several components), with a
+  // "/" before it unless the path is empty or ends in one, or |component|
+  // starts with one. Does nothing if |component| is empty.
+  void Append(ftl::StringView component);
+
+  // Shortens the path to its first |size| characters (which must be at most
+  // |size()|), e.g., to undo |Append()|s.
+  void Truncate(size_t size);
+
+  // Makes room for a path of |capacity| characters.
+  void Reserve(size_t capacity);
+
+  size_t size() const { return path_.size(); }
+  bool empty() const { return path_.empty(); }
+  const char* c_str() const { return path_.c_str(); }
+  ftl::StringView view() const { return path_; }
+  const std::string& path() const { return path_; }
+
+  // Returns the path, leaving this empty.
+  std::string TakePath();
+
+ private:
+  std::string path_;
+};
+
+}  // namespace files
+
+#endif  // LIB_FTL_FILES_PATH_BUILDER_H_
@@ -0,0 +1,60 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/path_builder.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace files {
+namespace {
+
+TEST(PathBuilder, Append) {
+  PathBuilder builder;
+  EXPECT_TRUE(builder.empty());
+  builder.Append("foo");
+  EXPECT_EQ("foo", builder.path());
+  builder.Append("bar/baz");
+  EXPECT_EQ("foo/bar/baz", builder.path());
+  builder.Append("");
+  EXPECT_EQ("foo/bar/baz", builder.path());
+  builder.Append("/qux");
+  EXPECT_EQ("foo/bar/baz/qux", builder.path());
+
+  PathBuilder root("/");
+  root.Append("foo");
+  EXPECT_EQ("/foo", root.path());
+  PathBuilder directory("foo/");
+  directory.Append("bar");
+  EXPECT_EQ("foo/bar", directory.path());
+  EXPECT_STREQ("foo/bar", directory.c_str());
+  EXPECT_EQ(7u, directory.view().size());
+}
+
+TEST(PathBuilder, TruncateReusesBuffer) {
+  PathBuilder builder("/some/root");
+  builder.Reserve(100u);
+  const char* data = builder.c_str();
+  const size_t root_size = builder.size();
+  for (const char* name : {"a", "bb", "a_longer_name"}) {
+    builder.Append(ftl::StringView(name));
+    EXPECT_EQ(std::string("/some/root/") + name, builder.path());
+    EXPECT_EQ(data, builder.c_str());
+    builder.Truncate(root_size);
+  }
+  EXPECT_EQ("/some/root", builder.path());
+}
+
+TEST(PathBuilder, TakePath) {
+  PathBuilder builder("foo");
+  builder.Append("bar");
+  EXPECT_EQ("foo/bar", builder.TakePath());
+  EXPECT_TRUE(builder.empty());
+  builder.Append("baz");
+  EXPECT_EQ("baz", builder.path());
+}
+
+}  // namespace
+}  // namespace files
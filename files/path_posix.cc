@@ -4,26 +4,33 @@
 
 #include "lib/ftl/files/path.h"
 
-#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
-#include <functional>
-#include <list>
-#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <utility>
 
 #include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/directory_iterator.h"
+#include "lib/ftl/files/path_builder.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/tasks/thread_pool.h"
 
 namespace files {
 namespace {
 
-size_t ResolveParentDirectoryTraversal(const std::string& path, size_t put) {
+size_t ResolveParentDirectoryTraversal(ftl::StringView path, size_t put) {
   if (put >= 2) {
     size_t previous_separator = path.rfind('/', put - 2);
-    if (previous_separator != std::string::npos) return previous_separator + 1;
+    if (previous_separator != ftl::StringView::npos)
+      return previous_separator + 1;
   }
   if (put == 1 && path[0] == '/') {
     return put;
@@ -31,36 +38,95 @@ size_t ResolveParentDirectoryTraversal(const std::string& path, size_t put) {
   return 0;
 }
 
-void SafeCloseDir(DIR* dir) {
-  if (dir) closedir(dir);
+// Like |unlinkat()|, but succeeds if the entry is already gone.
+bool UnlinkAt(int dir_fd, const char* name, int flags) {
+  return unlinkat(dir_fd, name, flags) == 0 || errno == ENOENT;
 }
 
-bool ForEachEntry(const std::string& path,
-                  std::function<bool(const std::string& path)> callback) {
-  std::unique_ptr<DIR, decltype(&SafeCloseDir)> dir(opendir(path.c_str()),
-                                                    SafeCloseDir);
-  if (!dir.get()) return false;
-  for (struct dirent* entry = readdir(dir.get()); entry != nullptr;
-       entry = readdir(dir.get())) {
-    char* name = entry->d_name;
-    if (name[0]) {
-      if (name[0] == '.') {
-        if (!name[1] || (name[1] == '.' && !name[2])) {
-          // . or ..
+// Deletes the contents of the directory |name| in |dir_fd|, depth first.
+bool DeleteContentsAt(int dir_fd, const char* name) {
+  DirectoryIterator it;
+  if (!it.OpenAt(dir_fd, name))
+    return false;
+  DirectoryIterator::Entry entry;
+  while (it.Next(&entry)) {
+    if (entry.type == DirectoryIterator::Type::kDirectory) {
+      if (!DeleteContentsAt(it.fd(), entry.name.data()) ||
+          !UnlinkAt(it.fd(), entry.name.data(), AT_REMOVEDIR))
+        return false;
+    } else if (!UnlinkAt(it.fd(), entry.name.data(), 0)) {
+      return false;
+    }
+  }
+  return !it.error();
+}
+
+// A directory being deleted by |DeletePathInParallel()|.
+struct PendingDirectory {
+  PendingDirectory(std::string path, PendingDirectory* parent)
+      : path(std::move(path)), parent(parent) {}
+
+  const std::string path;
+  PendingDirectory* const parent;
+  // The listing of its entries, and each of its subdirectories, which must be
+  // done before it can be removed.
+  std::atomic<size_t> pending{1u};
+};
+
+struct ParallelDeletion {
+  ftl::RefPtr<ftl::ThreadPool> pool;
+  std::atomic<bool> failed{false};
+};
+
+// Removes |directory| if that was the last thing it was waiting for, and so
+// on up the tree.
+void FinishDirectory(ParallelDeletion* deletion, PendingDirectory* directory) {
+  while (directory && directory->pending.fetch_sub(1u) == 1u) {
+    if (rmdir(directory->path.c_str()) != 0 && errno != ENOENT)
+      deletion->failed = true;
+    PendingDirectory* parent = directory->parent;
+    delete directory;
+    directory = parent;
+  }
+}
+
+// Deletes the files in |directory|, and posts a task for each subdirectory.
+void DeleteDirectory(ParallelDeletion* deletion, PendingDirectory* directory) {
+  {
+    DirectoryIterator it;
+    if (!it.OpenAt(AT_FDCWD, directory->path.c_str())) {
+      deletion->failed = true;
+    } else {
+      DirectoryIterator::Entry entry;
+      while (it.Next(&entry)) {
+        if (entry.type != DirectoryIterator::Type::kDirectory) {
+          if (!UnlinkAt(it.fd(), entry.name.data(), 0))
+            deletion->failed = true;
           continue;
         }
+        PathBuilder child_path;
+        child_path.Reserve(directory->path.size() + 1 + entry.name.size());
+        child_path.Append(directory->path);
+        child_path.Append(entry.name);
+        PendingDirectory* child =
+            new PendingDirectory(child_path.TakePath(), directory);
+        directory->pending++;
+        deletion->pool->PostTask(
+            [deletion, child] { DeleteDirectory(deletion, child); });
       }
-      if (!callback(path + "/" + name)) return false;
+      if (it.error())
+        deletion->failed = true;
     }
   }
-  return true;
+  FinishDirectory(deletion, directory);
 }
 
 }  // namespace
 
-std::string SimplifyPath(std::string path) {
-  if (path.empty()) return ".";
+ftl::StringView SimplifyPathInPlace(char* path, size_t size) {
+  if (!size) return ".";
 
+  const ftl::StringView view(path, size);
   size_t put = 0;
   size_t get = 0;
   size_t traversal_root = 0;
@@ -72,7 +138,7 @@ std::string SimplifyPath(std::string path) {
     component_start = 1;
   }
 
-  while (get < path.size()) {
+  while (get < size) {
     char c = path[get];
 
     if (c == '.' && (get == component_start || get == component_start + 1)) {
@@ -98,7 +164,7 @@ std::string SimplifyPath(std::string path) {
           path[put++] = '/';
           traversal_root = put;
         } else {
-          put = ResolveParentDirectoryTraversal(path, put);
+          put = ResolveParentDirectoryTraversal(view, put);
         }
         ++get;
         component_start = get;
@@ -106,24 +172,21 @@ std::string SimplifyPath(std::string path) {
       }
     }
 
-    size_t next_separator = path.find('/', get);
-    if (next_separator == std::string::npos) {
+    size_t next_separator = view.find('/', get);
+    if (next_separator == ftl::StringView::npos) {
       // We've reached the last component.
       break;
     }
     size_t next_component_start = next_separator + 1;
-    ++next_separator;
     size_t component_size = next_component_start - component_start;
-    if (put != component_start && component_size > 0) {
-      path.replace(put, component_size,
-                   path.substr(component_start, component_size));
-    }
+    if (put != component_start)
+      memmove(path + put, path + component_start, component_size);
     put += component_size;
     get = next_component_start;
     component_start = next_component_start;
   }
 
-  size_t last_component_size = path.size() - component_start;
+  size_t last_component_size = size - component_start;
   if (last_component_size == 1 && path[component_start] == '.') {
     // The last component is ".", which we can elide.
   } else if (last_component_size == 2 && path[component_start] == '.' &&
@@ -131,19 +194,16 @@ std::string SimplifyPath(std::string path) {
     // The last component is "..", which means we need to remove the previous
     // component.
     if (put == traversal_root) {
+      // (There's no room for the trailing "/", which is trimmed anyway.)
       path[put++] = '.';
       path[put++] = '.';
-      path[put++] = '/';
-      traversal_root = put;
     } else {
-      put = ResolveParentDirectoryTraversal(path, put);
+      put = ResolveParentDirectoryTraversal(view, put);
     }
   } else {
     // Otherwise, we need to copy over the last component.
-    if (put != component_start && last_component_size > 0) {
-      path.replace(put, last_component_size,
-                   path.substr(component_start, last_component_size));
-    }
+    if (put != component_start && last_component_size > 0)
+      memmove(path + put, path + component_start, last_component_size);
     put += last_component_size;
   }
 
@@ -152,64 +212,84 @@ std::string SimplifyPath(std::string path) {
   else if (put == 0)
     return ".";  // Use . for otherwise empty paths to treat them as relative.
 
-  path.resize(put);
+  return ftl::StringView(path, put);
+}
+
+std::string SimplifyPath(std::string path) {
+  if (path.empty()) return ".";
+  ftl::StringView simplified = SimplifyPathInPlace(&path[0], path.size());
+  if (simplified.data() != path.data()) return simplified.ToString();
+  path.resize(simplified.size());
   return path;
 }
 
 std::string AbsolutePath(const std::string& path) {
-  if (path.size() > 0) {
-    if (path[0] == '/') {
-      // Path is already absolute.
-      return path;
-    }
-    return GetCurrentDirectory() + "/" + path;
-  } else {
-    // Path is empty.
-    return GetCurrentDirectory();
+  if (!path.empty() && path[0] == '/') {
+    // Path is already absolute.
+    return path;
   }
+  // (Build the result in one allocation, rather than copying
+  // |GetCurrentDirectory()|'s.)
+  char current_directory[PATH_MAX];
+  FTL_CHECK(getcwd(current_directory, sizeof(current_directory)));
+  const size_t current_directory_size = strlen(current_directory);
+  std::string absolute_path;
+  absolute_path.reserve(current_directory_size + 1 + path.size());
+  absolute_path.append(current_directory, current_directory_size);
+  if (!path.empty()) {
+    absolute_path.push_back('/');
+    absolute_path.append(path);
+  }
+  return absolute_path;
 }
 
-std::string GetDirectoryName(const std::string& path) {
+ftl::StringView GetDirectoryNameView(ftl::StringView path) {
   size_t separator = path.rfind('/');
-  if (separator == 0u) return "/";
-  if (separator == std::string::npos) return std::string();
-  return path.substr(0, separator);
+  if (separator == 0u) return path.substr(0u, 1u);
+  if (separator == ftl::StringView::npos) return ftl::StringView();
+  return path.substr(0u, separator);
 }
 
-std::string GetBaseName(const std::string& path) {
+ftl::StringView GetBaseNameView(ftl::StringView path) {
   size_t separator = path.rfind('/');
-  if (separator == std::string::npos) return path;
+  if (separator == ftl::StringView::npos) return path;
   return path.substr(separator + 1);
 }
 
+std::string GetDirectoryName(const std::string& path) {
+  return GetDirectoryNameView(path).ToString();
+}
+
+std::string GetBaseName(const std::string& path) {
+  return GetBaseNameView(path).ToString();
+}
+
 bool DeletePath(const std::string& path, bool recursive) {
   struct stat stat_buffer;
   if (lstat(path.c_str(), &stat_buffer) != 0)
     return (errno == ENOENT || errno == ENOTDIR);
   if (!S_ISDIR(stat_buffer.st_mode)) return (unlink(path.c_str()) == 0);
   if (!recursive) return (rmdir(path.c_str()) == 0);
+  return DeleteContentsAt(AT_FDCWD, path.c_str()) &&
+         rmdir(path.c_str()) == 0;
+}
 
-  // Use std::list, as ForEachEntry callback will modify the container. If the
-  // container is a vector, this will invalidate the reference to the content.
-  std::list<std::string> directories;
-  directories.push_back(path);
-  for (auto it = directories.begin(); it != directories.end(); ++it) {
-    if (!ForEachEntry(*it,
-                      [&directories](const std::string& child) {
-                        if (IsDirectory(child)) {
-                          directories.push_back(child);
-                        } else {
-                          if (unlink(child.c_str()) != 0) return false;
-                        }
-                        return true;
-                      })) {
-      return false;
-    }
-  }
-  for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
-    if (rmdir(it->c_str()) != 0) return false;
-  }
-  return true;
+bool DeletePathInParallel(const std::string& path, size_t thread_count) {
+  struct stat stat_buffer;
+  if (lstat(path.c_str(), &stat_buffer) != 0 || !S_ISDIR(stat_buffer.st_mode))
+    return DeletePath(path, true);
+
+  ParallelDeletion deletion;
+  deletion.pool = ftl::MakeRefCounted<ftl::ThreadPool>(
+      std::max<size_t>(thread_count, 1u));
+  if (!deletion.pool->Start())
+    return DeletePath(path, true);
+  PendingDirectory* root = new PendingDirectory(path, nullptr);
+  deletion.pool->PostTask(
+      [&deletion, root] { DeleteDirectory(&deletion, root); });
+  // This waits for all the tasks, including the ones they post.
+  deletion.pool->Shutdown();
+  return !deletion.failed;
 }
 
 }  // namespace files
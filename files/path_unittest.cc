@@ -3,10 +3,16 @@
 // found in the LICENSE file.
 
 #include "lib/ftl/files/path.h"
+
+#include <string>
+
 #include "gtest/gtest.h"
 #include "lib/ftl/build_config.h"
 #include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/file.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/strings/string_view.h"
 
 namespace files {
 namespace {
@@ -199,6 +205,39 @@ TEST(Path, GetBaseName) {
 #endif
 }
 
+TEST(Path, SimplifyPathInPlace) {
+  for (const char* path :
+       {"", ".", "..", "/", "/..", "foo", "foo/", "foo/..", "/foo/../bar",
+        "../foo/../../bar", "abc//./../def", "abc/../../././../def",
+        "abc/def/../../../ghi/jkl/../../../mno", "//abc//"}) {
+    SCOPED_TRACE(path);
+    // It doesn't go past the end of the path.
+    std::string buffer = std::string(path) + "#";
+    ftl::StringView simplified =
+        SimplifyPathInPlace(&buffer[0], buffer.size() - 1u);
+    EXPECT_EQ(SimplifyPath(path), simplified.ToString());
+    EXPECT_EQ('#', buffer.back());
+    if (simplified != ".") {
+      EXPECT_EQ(buffer.data(), simplified.data());
+    }
+  }
+}
+
+TEST(Path, GetDirectoryNameAndBaseNameViews) {
+  for (const char* path : {"foo", "foo/", "foo/bar", "/", "/a", "/a/"}) {
+    SCOPED_TRACE(path);
+    const std::string string(path);
+    ftl::StringView directory = GetDirectoryNameView(string);
+    ftl::StringView base = GetBaseNameView(string);
+    EXPECT_EQ(GetDirectoryName(string), directory.ToString());
+    EXPECT_EQ(GetBaseName(string), base.ToString());
+    if (!directory.empty()) {
+      EXPECT_EQ(string.data(), directory.data());
+    }
+    EXPECT_EQ(string.data() + string.size(), base.data() + base.size());
+  }
+}
+
 TEST(Path, DeletePath) {
   ScopedTempDir dir;
 
@@ -232,5 +271,59 @@ TEST(Path, DeletePathRecursively) {
   EXPECT_FALSE(IsDirectory(sub_sub_dir1));
 }
 
+// Creates a tree of directories |depth| deep under |path|, each with |fanout|
+// subdirectories and a few files.
+void CreateTree(const std::string& path, int depth, int fanout) {
+  ASSERT_TRUE(CreateDirectory(path));
+  for (int i = 0; i < 3; i++) {
+    std::string file = path + "/file" + std::to_string(i);
+    ASSERT_TRUE(WriteFile(file, "x", 1));
+  }
+  if (depth > 0) {
+    for (int i = 0; i < fanout; i++)
+      CreateTree(path + "/dir" + std::to_string(i), depth - 1, fanout);
+  }
+}
+
+TEST(Path, DeletePathInParallel) {
+  ScopedTempDir dir;
+
+  std::string sub_dir = dir.path() + "/dir";
+  CreateTree(sub_dir, 3, 4);
+  EXPECT_TRUE(DeletePathInParallel(sub_dir, 4u));
+  EXPECT_FALSE(IsDirectory(sub_dir));
+  // It's already gone.
+  EXPECT_TRUE(DeletePathInParallel(sub_dir, 4u));
+
+  std::string file = dir.path() + "/file";
+  ASSERT_TRUE(WriteFile(file, "x", 1));
+  EXPECT_TRUE(DeletePathInParallel(file, 4u));
+  EXPECT_FALSE(IsFile(file));
+}
+
+#if !defined(OS_WIN)
+TEST(Path, DeletePathDoesNotFollowSymlinks) {
+  ScopedTempDir dir;
+
+  std::string target = dir.path() + "/target";
+  CreateTree(target, 1, 2);
+  std::string sub_dir = dir.path() + "/dir";
+  CreateTree(sub_dir, 1, 2);
+  ASSERT_EQ(0, symlink(target.c_str(), (sub_dir + "/link").c_str()));
+  ASSERT_EQ(0, symlink(target.c_str(), (sub_dir + "/dir0/link").c_str()));
+
+  std::string parallel_sub_dir = dir.path() + "/parallel_dir";
+  CreateTree(parallel_sub_dir, 1, 2);
+  ASSERT_EQ(0, symlink(target.c_str(), (parallel_sub_dir + "/link").c_str()));
+
+  EXPECT_TRUE(DeletePath(sub_dir, true));
+  EXPECT_TRUE(DeletePathInParallel(parallel_sub_dir, 2u));
+  EXPECT_FALSE(IsDirectory(sub_dir));
+  EXPECT_FALSE(IsDirectory(parallel_sub_dir));
+  EXPECT_TRUE(IsFile(target + "/file0"));
+  EXPECT_TRUE(IsFile(target + "/dir1/file2"));
+}
+#endif
+
 }  // namespace
 }  // namespace files
@@ -24,7 +24,7 @@
 namespace files {
 namespace {
 
-size_t RootLength(const std::string& path) {
+size_t RootLength(ftl::StringView path) {
   if (path.size() == 0)
     return 0;
   if (path[0] == '/')
@@ -44,7 +44,7 @@ size_t RootLength(const std::string& path) {
   }
   // If the path is of the form 'C:/' or 'C:\', with C being any letter, it's
   // a root part.
-  if (path.length() >= 2 && path[1] == ':' &&
+  if (path.size() >= 2 && path[1] == ':' &&
       (path[2] == '/' || path[2] == '\\') &&
       ((path[0] >= 'A' && path[0] <= 'Z') ||
        (path[0] >= 'a' && path[0] <= 'z'))) {
@@ -57,11 +57,11 @@ size_t IsSeparator(const char sep) {
   return sep == '/' || sep == '\\';
 }
 
-size_t LastSeparator(const std::string& path) {
+size_t LastSeparator(ftl::StringView path) {
   return path.find_last_of("/\\");
 }
 
-size_t LastSeparator(const std::string& path, size_t pos) {
+size_t LastSeparator(ftl::StringView path, size_t pos) {
   return path.find_last_of("/\\", pos);
 }
 
@@ -183,29 +183,46 @@ std::string SimplifyPath(std::string path) {
   return path;
 }
 
+ftl::StringView SimplifyPathInPlace(char* path, size_t size) {
+  // The result is never longer than |path|.
+  std::string simplified = SimplifyPath(std::string(path, size));
+  if (simplified == ".")
+    return ".";
+  memcpy(path, simplified.data(), simplified.size());
+  return ftl::StringView(path, simplified.size());
+}
+
 std::string AbsolutePath(const std::string& path) {
   char absPath[MAX_PATH];
   _fullpath(absPath, path.c_str(), MAX_PATH);
   return std::string(absPath);
 }
 
-std::string GetDirectoryName(const std::string& path) {
+ftl::StringView GetDirectoryNameView(ftl::StringView path) {
   size_t rootLength = RootLength(path);
   size_t separator = LastSeparator(path);
   if (separator < rootLength)
     separator = rootLength;
-  if (separator == std::string::npos)
-    return std::string();
+  if (separator == ftl::StringView::npos)
+    return ftl::StringView();
   return path.substr(0, separator);
 }
 
-std::string GetBaseName(const std::string& path) {
+ftl::StringView GetBaseNameView(ftl::StringView path) {
   size_t separator = LastSeparator(path);
-  if (separator == std::string::npos)
+  if (separator == ftl::StringView::npos)
     return path;
   return path.substr(separator + 1);
 }
 
+std::string GetDirectoryName(const std::string& path) {
+  return GetDirectoryNameView(path).ToString();
+}
+
+std::string GetBaseName(const std::string& path) {
+  return GetBaseNameView(path).ToString();
+}
+
 bool DeletePath(const std::string& path, bool recursive) {
   // SimplifyPath because SHFileOperation has trouble with double slashes.
   std::string simple_path = SimplifyPath(path);
@@ -228,4 +245,8 @@ bool DeletePath(const std::string& path, bool recursive) {
   return (a == 0);
 }
 
+bool DeletePathInParallel(const std::string& path, size_t thread_count) {
+  return DeletePath(path, true);
+}
+
 }  // namespace files
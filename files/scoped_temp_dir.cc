@@ -7,27 +7,71 @@
 #include "lib/ftl/build_config.h"
 
 // mkdtemp - required include file
-#if defined(OS_MACOSX)
-#include <unistd.h>
-#elif defined(OS_WIN)
+#if defined(OS_WIN)
 #include <windows.h>
 #undef CreateDirectory
 #include "lib/ftl/random/uuid.h"
 #include "lib/ftl/files/file.h"
 #else
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #endif
 
+#if defined(OS_LINUX)
+#include <sys/syscall.h>
+#endif
+
+#include <utility>
+
 #include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/eintr_wrapper.h"
 #include "lib/ftl/files/path.h"
-#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/files/path_builder.h"
 #include "lib/ftl/logging.h"
 
 namespace files {
+namespace {
+
+#if defined(OS_LINUX)
+// A RAM-backed file system, on most Linux systems.
+constexpr char kInMemoryParentPath[] = "/dev/shm";
+// From <linux/memfd.h>.
+constexpr unsigned kMemfdCloexec = 1u;
+#endif
+
+ScopedTempDir::Options ParentPathOptions(ftl::StringView parent_path) {
+  ScopedTempDir::Options options;
+  options.parent_path = parent_path;
+  return options;
+}
+
+void DeleteTempDir(const std::string& path) {
+  if (!DeletePath(path, true)) {
+    FTL_LOG(WARNING) << "Unable to delete: " << path;
+  }
+}
+
+#if !defined(OS_WIN)
+std::string GetTempRoot() {
+  const char* env_var = getenv("TMPDIR");
+  return env_var ? env_var : "/tmp";
+}
+#endif
+
+}  // namespace
 
-ScopedTempDir::ScopedTempDir() : ScopedTempDir(ftl::StringView()) {}
+ScopedTempDir::ScopedTempDir() : ScopedTempDir(Options()) {}
 
-ScopedTempDir::ScopedTempDir(ftl::StringView parent_path) {
+ScopedTempDir::ScopedTempDir(ftl::StringView parent_path)
+    : ScopedTempDir(ParentPathOptions(parent_path)) {}
+
+ScopedTempDir::ScopedTempDir(const Options& options)
+    : cleanup_runner_(options.cleanup_runner) {
+  ftl::StringView parent_path = options.parent_path;
 #if defined(OS_WIN)
   if (parent_path.empty()) {
     char buffer[MAX_PATH];
@@ -45,11 +89,15 @@ ScopedTempDir::ScopedTempDir(ftl::StringView parent_path) {
     directory_path_ = "";
   }
 #else
-  if (parent_path.empty()) {
-    const char* env_var = getenv("TMPDIR");
-    parent_path = ftl::StringView(env_var ? env_var : "/tmp");
+  std::string parent_path_str = parent_path.ToString();
+  if (parent_path_str.empty()) {
+#if defined(OS_LINUX)
+    if (options.in_memory && IsDirectory(kInMemoryParentPath))
+      parent_path_str = kInMemoryParentPath;
+#endif
+    if (parent_path_str.empty())
+      parent_path_str = GetTempRoot();
   }
-  const std::string parent_path_str = parent_path.ToString();
   // mkdtemp replaces "XXXXXX" so that the resulting directory path is unique.
   directory_path_ = parent_path_str + "/temp_dir_XXXXXX";
   if (!CreateDirectory(parent_path_str) || !mkdtemp(&directory_path_[0])) {
@@ -59,10 +107,16 @@ ScopedTempDir::ScopedTempDir(ftl::StringView parent_path) {
 }
 
 ScopedTempDir::~ScopedTempDir() {
-  if (directory_path_.size()) {
-    if (!DeletePath(directory_path_, true)) {
-      FTL_LOG(WARNING) << "Unable to delete: " << directory_path_;
-    }
+  if (directory_path_.empty())
+    return;
+#if !defined(OS_WIN)
+  directory_fd_.reset();
+#endif
+  if (cleanup_runner_) {
+    std::string path = std::move(directory_path_);
+    cleanup_runner_->PostTask([path] { DeleteTempDir(path); });
+  } else {
+    DeleteTempDir(directory_path_);
   }
 }
 
@@ -88,4 +142,75 @@ bool ScopedTempDir::NewTempFile(std::string* output) {
 #endif
 }
 
+bool ScopedTempDir::NewTempFiles(size_t count,
+                                 std::vector<std::string>* output) {
+#if defined(OS_WIN)
+  for (size_t i = 0; i < count; i++) {
+    std::string path;
+    if (!NewTempFile(&path))
+      return false;
+    output->push_back(std::move(path));
+  }
+  return true;
+#else
+  if (directory_path_.empty())
+    return false;
+  if (!directory_fd_.is_valid()) {
+    directory_fd_.reset(HANDLE_EINTR(
+        open(directory_path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)));
+    if (!directory_fd_.is_valid())
+      return false;
+  }
+
+  output->reserve(output->size() + count);
+  PathBuilder path(directory_path_);
+  const size_t directory_size = path.size();
+  char name[32];
+  for (size_t i = 0; i < count;) {
+    snprintf(name, sizeof(name), "temp_%" PRIu64, next_file_id_++);
+    int fd = HANDLE_EINTR(openat(directory_fd_.get(), name,
+                                 O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                 0600));
+    if (fd < 0) {
+      // (E.g., a file created with that name by someone else.)
+      if (errno == EEXIST)
+        continue;
+      return false;
+    }
+    close(fd);
+    path.Append(ftl::StringView(name));
+    output->push_back(path.path());
+    path.Truncate(directory_size);
+    i++;
+  }
+  return true;
+#endif
+}
+
+ftl::UniqueFD CreateAnonymousTempFile() {
+#if defined(OS_WIN)
+  return ftl::UniqueFD();
+#else
+#if defined(OS_LINUX) && defined(__NR_memfd_create)
+  int memfd = static_cast<int>(
+      syscall(__NR_memfd_create, "ftl_anonymous_temp_file", kMemfdCloexec));
+  if (memfd >= 0)
+    return ftl::UniqueFD(memfd);
+#endif
+  const std::string root = GetTempRoot();
+#if defined(O_TMPFILE)
+  ftl::UniqueFD fd(HANDLE_EINTR(
+      open(root.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)));
+  if (fd.is_valid())
+    return fd;
+#endif
+  // mkstemp replaces "XXXXXX" so that the resulting file path is unique.
+  std::string path = root + "/anonymous_XXXXXX";
+  ftl::UniqueFD named_fd(mkstemp(&path[0]));
+  if (named_fd.is_valid())
+    unlink(path.c_str());
+  return named_fd;
+#endif
+}
+
 }  // namespace files
@@ -5,27 +5,66 @@
 #ifndef LIB_FTL_FILES_SCOPED_TEMP_DIR_H_
 #define LIB_FTL_FILES_SCOPED_TEMP_DIR_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <string>
+#include <vector>
 
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/unique_fd.h"
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/memory/ref_ptr.h"
 #include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/tasks/task_runner.h"
 
 namespace files {
 
 class FTL_EXPORT ScopedTempDir {
  public:
+  struct Options {
+    // The directory to create the temporary directory in (created if need
+    // be), or empty for $TMPDIR (or /tmp).
+    ftl::StringView parent_path;
+    // If |parent_path| is empty, use a RAM-backed file system (/dev/shm, on
+    // Linux), if there is one, so that creating and deleting files doesn't
+    // touch the disk.
+    bool in_memory = false;
+    // If set, the directory is deleted by a task posted to this when this
+    // object is destroyed, rather than right away.
+    ftl::RefPtr<ftl::TaskRunner> cleanup_runner;
+  };
+
   ScopedTempDir();
   explicit ScopedTempDir(ftl::StringView parent_path);
+  explicit ScopedTempDir(const Options& options);
   ~ScopedTempDir();
 
   const std::string& path();
 
   bool NewTempFile(std::string* output);
 
+  // Creates |count| new (empty) files, appending their paths to |*output|.
+  // This is cheaper than |NewTempFile()| for each: files are created relative
+  // to the directory's file descriptor, with sequential names. Returns false if
+  // not all could be created.
+  bool NewTempFiles(size_t count, std::vector<std::string>* output);
+
  private:
   std::string directory_path_;
+  ftl::RefPtr<ftl::TaskRunner> cleanup_runner_;
+#if !defined(OS_WIN)
+  ftl::UniqueFD directory_fd_;
+  uint64_t next_file_id_ = 0u;
+#endif
 };
 
+// Creates an anonymous temporary file: one with no name, deleted once the
+// returned file descriptor (and any duplicates of it) are closed. On Linux, it
+// lives in memory (see |memfd_create()|); elsewhere, it's in $TMPDIR (or
+// /tmp). Returns an invalid file descriptor on failure (or on Windows).
+FTL_EXPORT ftl::UniqueFD CreateAnonymousTempFile();
+
 }  // namespace files
 
 #endif  // LIB_FTL_FILES_SCOPED_TEMP_DIR_H_
@@ -3,9 +3,21 @@
 // found in the LICENSE file.
 
 #include "lib/ftl/files/scoped_temp_dir.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
 #include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/file.h"
 #include "lib/ftl/files/path.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+#if !defined(OS_WIN)
+#include "lib/ftl/files/file_descriptor.h"
+#endif
 
 namespace files {
 namespace {
@@ -54,5 +66,68 @@ TEST(ScopedTempDir, CustomParent) {
   EXPECT_TRUE(IsDirectory(parent));
 }
 
+TEST(ScopedTempDir, NewTempFiles) {
+  ScopedTempDir dir;
+  // A name that may clash.
+  ASSERT_TRUE(WriteFile(dir.path() + "/temp_0", "x", 1));
+
+  std::vector<std::string> paths;
+  EXPECT_TRUE(dir.NewTempFiles(1000u, &paths));
+  EXPECT_TRUE(dir.NewTempFiles(10u, &paths));
+  ASSERT_EQ(1010u, paths.size());
+  EXPECT_EQ(1010u, std::set<std::string>(paths.begin(), paths.end()).size());
+  for (const std::string& path : paths) {
+    EXPECT_EQ(dir.path(), GetDirectoryName(path));
+    std::string content;
+    EXPECT_TRUE(ReadFileToString(path, &content));
+    EXPECT_TRUE(content.empty());
+  }
+  std::string content;
+  EXPECT_TRUE(ReadFileToString(dir.path() + "/temp_0", &content));
+  EXPECT_EQ("x", content);
+}
+
+TEST(ScopedTempDir, InMemory) {
+  ScopedTempDir::Options options;
+  options.in_memory = true;
+  ScopedTempDir dir(options);
+  EXPECT_TRUE(IsDirectory(dir.path()));
+#if defined(OS_LINUX)
+  if (IsDirectory("/dev/shm")) {
+    EXPECT_EQ("/dev/shm", GetDirectoryName(dir.path()));
+  }
+#endif
+  std::vector<std::string> paths;
+  EXPECT_TRUE(dir.NewTempFiles(3u, &paths));
+}
+
+TEST(ScopedTempDir, CleanupRunner) {
+  auto pool = ftl::MakeRefCounted<ftl::ThreadPool>(1u);
+  ASSERT_TRUE(pool->Start());
+  std::string path;
+  {
+    ScopedTempDir::Options options;
+    options.cleanup_runner = pool;
+    ScopedTempDir dir(options);
+    path = dir.path();
+    std::vector<std::string> paths;
+    EXPECT_TRUE(dir.NewTempFiles(100u, &paths));
+  }
+  // Waits for the cleanup.
+  pool->Shutdown();
+  EXPECT_FALSE(IsDirectory(path));
+}
+
+#if !defined(OS_WIN)
+TEST(ScopedTempDir, CreateAnonymousTempFile) {
+  ftl::UniqueFD fd = CreateAnonymousTempFile();
+  ASSERT_TRUE(fd.is_valid());
+  EXPECT_TRUE(ftl::PWriteFileDescriptor(fd.get(), "hello", 5, 0));
+  char buffer[5];
+  EXPECT_EQ(5, ftl::PReadFileDescriptor(fd.get(), buffer, 5, 0));
+  EXPECT_EQ("hello", std::string(buffer, 5));
+}
+#endif
+
 }  // namespace
 }  // namespace files
@@ -5,9 +5,15 @@
 #ifndef LIB_FTL_FILES_SYMLINK_H_
 #define LIB_FTL_FILES_SYMLINK_H_
 
+#include <stddef.h>
+
 #include <string>
+#include <vector>
 
+#include "lib/ftl/containers/flat_hash_map.h"
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
 
 namespace files {
 
@@ -21,6 +27,42 @@ FTL_EXPORT bool ReadSymbolicLink(const std::string& path,
 // directory traversals.
 FTL_EXPORT std::string GetAbsoluteFilePath(const std::string& path);
 
+// Resolves paths like |GetAbsoluteFilePath()|, but with fewer system calls, for
+// resolving very many of them: it caches the directories it resolves, so
+// resolving a path in a directory it's already seen just takes an |lstat()| of
+// the path (unless it's a symbolic link), rather than one per component.
+//
+// It doesn't notice the file system changing (e.g., a symbolic link in a
+// cached directory's path being replaced), or the working directory (which
+// relative paths are resolved against) changing, so use one for a batch of
+// paths, and then |Clear()| it or throw it away. It's not thread-safe.
+class FTL_EXPORT PathResolver {
+ public:
+  PathResolver();
+  ~PathResolver();
+
+  // Returns the real path for |path|, or an empty string if it doesn't exist
+  // (or can't be resolved).
+  std::string Resolve(const std::string& path);
+
+  // Forgets the cached directories.
+  void Clear() { directories_.clear(); }
+
+  size_t cached_directory_count() const { return directories_.size(); }
+
+ private:
+  // Returns the real path of |directory| (or an empty string), caching it.
+  const std::string& ResolveDirectory(ftl::StringView directory);
+
+  ftl::FlatHashMap<std::string, std::string> directories_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(PathResolver);
+};
+
+// Returns the real paths for |paths| (see |PathResolver|).
+FTL_EXPORT std::vector<std::string> GetAbsoluteFilePaths(
+    const std::vector<std::string>& paths);
+
 }  // namespace files
 
 #endif  // LIB_FTL_FILES_SYMLINK_H_
@@ -5,6 +5,7 @@
 #include "lib/ftl/files/symlink.h"
 
 #include <limits.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "lib/ftl/build_config.h"
@@ -41,4 +42,60 @@ std::string GetAbsoluteFilePath(const std::string& path) {
 #endif  // defined(OS_FUCHSIA)
 }
 
+PathResolver::PathResolver() {}
+
+PathResolver::~PathResolver() {}
+
+std::string PathResolver::Resolve(const std::string& path) {
+#if defined(OS_FUCHSIA)
+  return GetAbsoluteFilePath(path);
+#else
+  if (path.empty())
+    return std::string();
+  const ftl::StringView name = GetBaseNameView(path);
+  // (Leave paths ending in a "." or ".." component, or a slash, to
+  // |realpath()|.)
+  if (name.empty() || name == "." || name == "..")
+    return GetAbsoluteFilePath(path);
+  const ftl::StringView directory = name.size() == path.size()
+                                        ? ftl::StringView(".")
+                                        : GetDirectoryNameView(path);
+  const std::string& resolved_directory = ResolveDirectory(directory);
+  if (resolved_directory.empty())
+    return std::string();
+
+  std::string resolved;
+  resolved.reserve(resolved_directory.size() + 1u + name.size());
+  resolved.append(resolved_directory);
+  if (resolved.back() != '/')
+    resolved.push_back('/');
+  resolved.append(name.data(), name.size());
+  struct stat stat_buffer;
+  if (lstat(resolved.c_str(), &stat_buffer) != 0)
+    return std::string();
+  if (S_ISLNK(stat_buffer.st_mode))
+    return GetAbsoluteFilePath(resolved);
+  return resolved;
+#endif  // defined(OS_FUCHSIA)
+}
+
+const std::string& PathResolver::ResolveDirectory(ftl::StringView directory) {
+  auto it = directories_.find(directory);
+  if (it == directories_.end()) {
+    const std::string key = directory.ToString();
+    it = directories_.try_emplace(key, GetAbsoluteFilePath(key)).first;
+  }
+  return it->second;
+}
+
+std::vector<std::string> GetAbsoluteFilePaths(
+    const std::vector<std::string>& paths) {
+  PathResolver resolver;
+  std::vector<std::string> resolved;
+  resolved.reserve(paths.size());
+  for (const std::string& path : paths)
+    resolved.push_back(resolver.Resolve(path));
+  return resolved;
+}
+
 }  // namespace files
@@ -0,0 +1,97 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/files/symlink.h"
+
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+
+namespace files {
+namespace {
+
+class PathResolverTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // (The temporary directory may itself be under a symbolic link.)
+    root_ = GetAbsoluteFilePath(dir_.path());
+    ASSERT_FALSE(root_.empty());
+    ASSERT_TRUE(CreateDirectory(root_ + "/a/b"));
+    ASSERT_TRUE(WriteFile(root_ + "/a/b/file", "x", 1));
+    ASSERT_TRUE(WriteFile(root_ + "/a/other", "y", 1));
+    ASSERT_EQ(0, symlink("a/b", (root_ + "/dir_link").c_str()));
+    ASSERT_EQ(0, symlink("b/file", (root_ + "/a/file_link").c_str()));
+  }
+
+  ScopedTempDir dir_;
+  std::string root_;
+};
+
+TEST_F(PathResolverTest, MatchesGetAbsoluteFilePath) {
+  const std::vector<std::string> paths = {
+      root_ + "/a/b/file",
+      root_ + "/a/./b/../b/file",
+      root_ + "/dir_link/file",
+      root_ + "/a/file_link",
+      root_ + "/a/other",
+      root_ + "/a/b",
+      root_ + "/a/b/",
+      root_ + "/a/b/..",
+      root_ + "/dir_link",
+      root_ + "/a/missing",
+      root_ + "/missing/file",
+      root_ + "/a/other/file",
+      "/",
+  };
+  PathResolver resolver;
+  for (const std::string& path : paths)
+    EXPECT_EQ(GetAbsoluteFilePath(path), resolver.Resolve(path)) << path;
+  EXPECT_EQ(root_ + "/a/b/file", resolver.Resolve(root_ + "/dir_link/file"));
+  EXPECT_EQ(root_ + "/a/b/file", resolver.Resolve(root_ + "/a/file_link"));
+  EXPECT_EQ("", resolver.Resolve(root_ + "/a/missing"));
+  EXPECT_EQ("", resolver.Resolve(""));
+
+  std::vector<std::string> resolved = GetAbsoluteFilePaths(paths);
+  ASSERT_EQ(paths.size(), resolved.size());
+  for (size_t i = 0u; i < paths.size(); i++)
+    EXPECT_EQ(GetAbsoluteFilePath(paths[i]), resolved[i]) << paths[i];
+}
+
+TEST_F(PathResolverTest, CachesDirectories) {
+  PathResolver resolver;
+  EXPECT_EQ(root_ + "/a/b/file", resolver.Resolve(root_ + "/a/b/file"));
+  EXPECT_EQ(root_ + "/a/b", resolver.Resolve(root_ + "/a/b"));
+  EXPECT_EQ(root_ + "/a/other", resolver.Resolve(root_ + "/a/other"));
+  EXPECT_EQ(2u, resolver.cached_directory_count());
+
+  // Changes to cached directories' paths aren't noticed until |Clear()|.
+  EXPECT_EQ(root_ + "/a/b/file", resolver.Resolve(root_ + "/dir_link/file"));
+  EXPECT_EQ(3u, resolver.cached_directory_count());
+  ASSERT_EQ(0, unlink((root_ + "/dir_link").c_str()));
+  ASSERT_EQ(0, symlink("a", (root_ + "/dir_link").c_str()));
+  EXPECT_EQ("", resolver.Resolve(root_ + "/dir_link/other"));
+  resolver.Clear();
+  EXPECT_EQ(0u, resolver.cached_directory_count());
+  EXPECT_EQ(root_ + "/a/other", resolver.Resolve(root_ + "/dir_link/other"));
+}
+
+TEST_F(PathResolverTest, RelativePaths) {
+  const std::string old_directory = GetCurrentDirectory();
+  ASSERT_EQ(0, chdir(root_.c_str()));
+  PathResolver resolver;
+  EXPECT_EQ(root_ + "/a/b/file", resolver.Resolve("a/b/file"));
+  EXPECT_EQ(root_ + "/a", resolver.Resolve("a"));
+  EXPECT_EQ(root_ + "/a/b/file", resolver.Resolve("dir_link/file"));
+  EXPECT_EQ(root_ + "/a", resolver.Resolve("dir_link/.."));
+  ASSERT_EQ(0, chdir(old_directory.c_str()));
+}
+
+}  // namespace
+}  // namespace files
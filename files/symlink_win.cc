@@ -44,4 +44,22 @@ std::string GetAbsoluteFilePath(const std::string& path) {
   return result;
 }
 
+PathResolver::PathResolver() {}
+
+PathResolver::~PathResolver() {}
+
+std::string PathResolver::Resolve(const std::string& path) {
+  // (Nothing is cached.)
+  return GetAbsoluteFilePath(path);
+}
+
+std::vector<std::string> GetAbsoluteFilePaths(
+    const std::vector<std::string>& paths) {
+  std::vector<std::string> resolved;
+  resolved.reserve(paths.size());
+  for (const std::string& path : paths)
+    resolved.push_back(GetAbsoluteFilePath(path));
+  return resolved;
+}
+
 }  // namespace files
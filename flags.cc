@@ -0,0 +1,258 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/flags.h"
+
+#include <algorithm>
+#include <map>
+
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+namespace {
+
+struct Flag {
+  const char* type_name;
+  const char* description;
+  std::string default_value;
+  bool (*set)(void* flag, StringView value);
+  std::string (*get)(const void* flag);
+  void* flag;
+};
+
+class FlagRegistry final {
+ public:
+  static FlagRegistry* Get() {
+    static FlagRegistry* registry = new FlagRegistry();
+    return registry;
+  }
+
+  Mutex mutex;
+  // By name.
+  std::map<std::string, Flag> flags FTL_GUARDED_BY(mutex);
+};
+
+const char* TypeName(const bool*) {
+  return "bool";
+}
+const char* TypeName(const int32_t*) {
+  return "int32";
+}
+const char* TypeName(const uint32_t*) {
+  return "uint32";
+}
+const char* TypeName(const int64_t*) {
+  return "int64";
+}
+const char* TypeName(const uint64_t*) {
+  return "uint64";
+}
+const char* TypeName(const double*) {
+  return "double";
+}
+const char* TypeName(const std::string*) {
+  return "string";
+}
+
+bool ParseValue(StringView string, bool* value) {
+  if (string.empty() || string == "true" || string == "1") {
+    *value = true;
+    return true;
+  }
+  if (string == "false" || string == "0") {
+    *value = false;
+    return true;
+  }
+  return false;
+}
+
+template <typename T>
+bool ParseValue(StringView string, T* value) {
+  return StringToNumberWithError(string, value);
+}
+
+bool ParseValue(StringView string, std::string* value) {
+  *value = string.ToString();
+  return true;
+}
+
+std::string FormatValue(bool value) {
+  return value ? "true" : "false";
+}
+
+template <typename T>
+std::string FormatValue(T value) {
+  return NumberToString(value);
+}
+
+std::string FormatValue(const std::string& value) {
+  return value;
+}
+
+template <typename T>
+bool SetValue(void* flag, StringView string) {
+  T value;
+  if (!ParseValue(string, &value))
+    return false;
+  *static_cast<T*>(flag) = value;
+  return true;
+}
+
+template <typename T>
+bool SetAtomicValue(void* flag, StringView string) {
+  T value;
+  if (!ParseValue(string, &value))
+    return false;
+  static_cast<std::atomic<T>*>(flag)->store(value, std::memory_order_relaxed);
+  return true;
+}
+
+template <typename T>
+std::string GetValue(const void* flag) {
+  return FormatValue(*static_cast<const T*>(flag));
+}
+
+template <typename T>
+std::string GetAtomicValue(const void* flag) {
+  const std::atomic<T>* atomic_flag = static_cast<const std::atomic<T>*>(flag);
+  return FormatValue(atomic_flag->load(std::memory_order_relaxed));
+}
+
+void AddFlag(const char* name, Flag flag) {
+  FlagRegistry* registry = FlagRegistry::Get();
+  MutexLocker locker(&registry->mutex);
+  const bool inserted =
+      registry->flags.insert(std::make_pair(std::string(name), flag)).second;
+  FTL_CHECK(inserted) << "Flag --" << name << " is defined twice";
+}
+
+template <typename T>
+void RegisterFlag(const char* name, const char* description, T* flag) {
+  AddFlag(name, Flag{TypeName(flag), description, FormatValue(*flag),
+                     &SetValue<T>, &GetValue<T>, flag});
+}
+
+template <typename T>
+void RegisterFlag(const char* name,
+                  const char* description,
+                  std::atomic<T>* flag) {
+  const T* type = nullptr;
+  AddFlag(name, Flag{TypeName(type), description,
+                     FormatValue(flag->load(std::memory_order_relaxed)),
+                     &SetAtomicValue<T>, &GetAtomicValue<T>, flag});
+}
+
+// Flags are named like identifiers, but options are often hyphenated.
+std::string NormalizeName(StringView name) {
+  std::string result = name.ToString();
+  std::replace(result.begin(), result.end(), '-', '_');
+  return result;
+}
+
+}  // namespace
+
+bool SetFlagsFromCommandLine(const CommandLine& command_line) {
+  FlagRegistry* registry = FlagRegistry::Get();
+  MutexLocker locker(&registry->mutex);
+  bool success = true;
+  for (const auto& entry : registry->flags) {
+    const std::string& name = entry.first;
+    std::string hyphenated_name = name;
+    std::replace(hyphenated_name.begin(), hyphenated_name.end(), '_', '-');
+    // The last occurrence, under either name.
+    size_t index;
+    bool found = command_line.HasOption(name, &index);
+    size_t hyphenated_index;
+    if (hyphenated_name != name &&
+        command_line.HasOption(hyphenated_name, &hyphenated_index) &&
+        (!found || hyphenated_index > index)) {
+      index = hyphenated_index;
+      found = true;
+    }
+    if (!found)
+      continue;
+    const CommandLine::Option& option = command_line.options()[index];
+    if (!entry.second.set(entry.second.flag, option.value)) {
+      FTL_LOG(ERROR) << "Error parsing --" << option.name << " option: \""
+                     << option.value << "\" isn't a "
+                     << entry.second.type_name << ".";
+      success = false;
+    }
+  }
+  return success;
+}
+
+bool SetFlag(StringView name, StringView value) {
+  FlagRegistry* registry = FlagRegistry::Get();
+  MutexLocker locker(&registry->mutex);
+  auto it = registry->flags.find(NormalizeName(name));
+  if (it == registry->flags.end())
+    return false;
+  return it->second.set(it->second.flag, value);
+}
+
+bool GetFlag(StringView name, std::string* value) {
+  FlagRegistry* registry = FlagRegistry::Get();
+  MutexLocker locker(&registry->mutex);
+  auto it = registry->flags.find(NormalizeName(name));
+  if (it == registry->flags.end())
+    return false;
+  *value = it->second.get(it->second.flag);
+  return true;
+}
+
+std::string GetFlagsHelp() {
+  FlagRegistry* registry = FlagRegistry::Get();
+  MutexLocker locker(&registry->mutex);
+  std::string help;
+  for (const auto& entry : registry->flags) {
+    help += "  --" + entry.first + "=<" + entry.second.type_name +
+            "> (default: " + entry.second.default_value + ")\n      " +
+            entry.second.description + "\n";
+  }
+  return help;
+}
+
+namespace internal {
+
+template <typename T>
+FlagRegistrar::FlagRegistrar(const char* name,
+                             const char* description,
+                             T* flag) {
+  RegisterFlag(name, description, flag);
+}
+
+template FlagRegistrar::FlagRegistrar(const char*, const char*, bool*);
+template FlagRegistrar::FlagRegistrar(const char*, const char*, int32_t*);
+template FlagRegistrar::FlagRegistrar(const char*, const char*, uint32_t*);
+template FlagRegistrar::FlagRegistrar(const char*, const char*, int64_t*);
+template FlagRegistrar::FlagRegistrar(const char*, const char*, uint64_t*);
+template FlagRegistrar::FlagRegistrar(const char*, const char*, double*);
+template FlagRegistrar::FlagRegistrar(const char*, const char*, std::string*);
+template FlagRegistrar::FlagRegistrar(const char*,
+                                      const char*,
+                                      std::atomic<bool>*);
+template FlagRegistrar::FlagRegistrar(const char*,
+                                      const char*,
+                                      std::atomic<int32_t>*);
+template FlagRegistrar::FlagRegistrar(const char*,
+                                      const char*,
+                                      std::atomic<uint32_t>*);
+template FlagRegistrar::FlagRegistrar(const char*,
+                                      const char*,
+                                      std::atomic<int64_t>*);
+template FlagRegistrar::FlagRegistrar(const char*,
+                                      const char*,
+                                      std::atomic<uint64_t>*);
+template FlagRegistrar::FlagRegistrar(const char*,
+                                      const char*,
+                                      std::atomic<double>*);
+
+}  // namespace internal
+
+}  // namespace ftl
@@ -0,0 +1,103 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Typed flags that modules declare where they're used, and that are parsed
+// once from the command line at startup, e.g.:
+//
+//   // In server.cc:
+//   FTL_FLAG(int32_t, max_conns, 1024, "Maximum concurrent connections.");
+//   FTL_ATOMIC_FLAG(bool, log_requests, false, "Log each request.");
+//
+//   void Server::Accept() {
+//     if (connections_.size() >= static_cast<size_t>(FLAG_max_conns)) ...
+//     if (FLAG_log_requests.load(std::memory_order_relaxed)) ...
+//   }
+//
+//   // In main.cc:
+//   int main(int argc, char** argv) {
+//     auto command_line = ftl::CommandLineFromArgcArgv(argc, argv);
+//     if (!ftl::SetFlagsFromCommandLine(command_line))
+//       return 1;
+//     ...
+//   }
+//
+// Then "my_server --max_conns=10" (or "--max-conns=10") sets |FLAG_max_conns|
+// to 10 before anything reads it, after which reading it is a plain load.
+//
+// Flags may be |bool|, |int32_t|, |uint32_t|, |int64_t|, |uint64_t|, |double|,
+// or (except for atomic flags) |std::string|. Numbers are parsed as by
+// |StringToNumberWithError()|, and bools from "true", "1", "false", "0" (or
+// nothing, as in "--log_requests", for true).
+//
+// Plain flags should only be set before other threads start. Flags defined
+// with |FTL_ATOMIC_FLAG()| are |std::atomic|s, so they can also be changed
+// while running (e.g., from a debug console, with |SetFlag()|).
+
+#ifndef LIB_FTL_FLAGS_H_
+#define LIB_FTL_FLAGS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+class CommandLine;
+
+// Defines the flag |FLAG_<name>|, of type |type|, in the current namespace.
+// (|name| should be unique in the program.)
+#define FTL_FLAG(type, name, default_value, description)             \
+  type FLAG_##name = default_value;                                  \
+  static ::ftl::internal::FlagRegistrar g_ftl_flag_registrar_##name( \
+      #name, description, &FLAG_##name)
+
+// Defines the flag |FLAG_<name>|, an |std::atomic<type>|.
+#define FTL_ATOMIC_FLAG(type, name, default_value, description)      \
+  std::atomic<type> FLAG_##name(default_value);                      \
+  static ::ftl::internal::FlagRegistrar g_ftl_flag_registrar_##name( \
+      #name, description, &FLAG_##name)
+
+// Declare flags defined elsewhere (e.g., in a header), in the same namespace.
+#define FTL_DECLARE_FLAG(type, name) extern type FLAG_##name
+#define FTL_DECLARE_ATOMIC_FLAG(type, name) extern std::atomic<type> FLAG_##name
+
+// Sets each defined flag that |command_line| has an option for (ignoring other
+// options), from its last occurrence. Returns false, after logging an error,
+// if any of those values don't parse (but still sets the others).
+FTL_EXPORT bool SetFlagsFromCommandLine(const CommandLine& command_line);
+
+// Sets the flag |name| (in which '-' and '_' are the same) from |value|.
+// Returns false if there's no such flag or |value| doesn't parse as its type.
+FTL_EXPORT bool SetFlag(StringView name, StringView value);
+
+// Gets the current value of the flag |name| as a string (in the form that
+// |SetFlag()| accepts). Returns false if there's no such flag.
+FTL_EXPORT bool GetFlag(StringView name, std::string* value);
+
+// Returns a description of all the flags, one per line, sorted by name, e.g.,
+// "  --max_conns=<int32> (default: 1024)\n      Maximum ...\n".
+FTL_EXPORT std::string GetFlagsHelp();
+
+namespace internal {
+
+// Registers a flag (for the macros above).
+class FTL_EXPORT FlagRegistrar final {
+ public:
+  template <typename T>
+  FlagRegistrar(const char* name, const char* description, T* flag);
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(FlagRegistrar);
+};
+
+}  // namespace internal
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_FLAGS_H_
@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/flags.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+
+namespace ftl {
+namespace {
+
+FTL_FLAG(int32_t, test_int, 1024, "An int.");
+FTL_FLAG(bool, test_bool, false, "A bool.");
+FTL_FLAG(double, test_double, 0.5, "A double.");
+FTL_FLAG(std::string, test_string, "default", "A string.");
+FTL_ATOMIC_FLAG(uint64_t, test_atomic, 7u, "An atomic uint64.");
+
+// Restores the flags' defaults.
+class FlagsTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    FLAG_test_int = 1024;
+    FLAG_test_bool = false;
+    FLAG_test_double = 0.5;
+    FLAG_test_string = "default";
+    FLAG_test_atomic.store(7u);
+  }
+};
+
+TEST_F(FlagsTest, Defaults) {
+  EXPECT_EQ(1024, FLAG_test_int);
+  EXPECT_FALSE(FLAG_test_bool);
+  EXPECT_EQ(0.5, FLAG_test_double);
+  EXPECT_EQ("default", FLAG_test_string);
+  EXPECT_EQ(7u, FLAG_test_atomic.load());
+}
+
+TEST_F(FlagsTest, SetFlagsFromCommandLine) {
+  EXPECT_TRUE(SetFlagsFromCommandLine(CommandLineFromInitializerList(
+      {"my_program", "--test_int=10", "--test-bool", "--test_string=",
+       "--unknown=x", "--test-int=20", "arg", "--test_double=2"})));
+  // The last occurrence (under either name) counts, and options after the
+  // first positional argument aren't options.
+  EXPECT_EQ(20, FLAG_test_int);
+  EXPECT_TRUE(FLAG_test_bool);
+  EXPECT_EQ("", FLAG_test_string);
+  EXPECT_EQ(0.5, FLAG_test_double);
+
+  EXPECT_TRUE(SetFlagsFromCommandLine(CommandLineFromInitializerList(
+      {"my_program", "--test_bool=false", "--test_double=-1.5e3"})));
+  EXPECT_FALSE(FLAG_test_bool);
+  EXPECT_EQ(-1500.0, FLAG_test_double);
+
+  // Values that don't parse are reported, and leave their flags alone.
+  EXPECT_FALSE(SetFlagsFromCommandLine(CommandLineFromInitializerList(
+      {"my_program", "--test_int=4294967296", "--test_bool=yes",
+       "--test_atomic=-1", "--test_string=set"})));
+  EXPECT_EQ(20, FLAG_test_int);
+  EXPECT_FALSE(FLAG_test_bool);
+  EXPECT_EQ(7u, FLAG_test_atomic.load());
+  EXPECT_EQ("set", FLAG_test_string);
+}
+
+TEST_F(FlagsTest, SetAndGetFlag) {
+  EXPECT_TRUE(SetFlag("test_atomic", "9"));
+  EXPECT_EQ(9u, FLAG_test_atomic.load());
+  EXPECT_TRUE(SetFlag("test-int", "-3"));
+  EXPECT_EQ(-3, FLAG_test_int);
+  EXPECT_FALSE(SetFlag("test_int", "3.5"));
+  EXPECT_FALSE(SetFlag("no_such_flag", "1"));
+  EXPECT_EQ(-3, FLAG_test_int);
+
+  std::string value;
+  EXPECT_TRUE(GetFlag("test_atomic", &value));
+  EXPECT_EQ("9", value);
+  EXPECT_TRUE(GetFlag("test_bool", &value));
+  EXPECT_EQ("false", value);
+  EXPECT_TRUE(GetFlag("test_double", &value));
+  EXPECT_EQ("0.5", value);
+  EXPECT_TRUE(GetFlag("test-string", &value));
+  EXPECT_EQ("default", value);
+  EXPECT_FALSE(GetFlag("no_such_flag", &value));
+  EXPECT_EQ("default", value);
+}
+
+TEST_F(FlagsTest, AtomicUpdates) {
+  std::thread reader([] {
+    uint64_t last = 0u;
+    while (last != 1000u) {
+      const uint64_t value = FLAG_test_atomic.load(std::memory_order_relaxed);
+      EXPECT_TRUE(value == 7u || value >= last);
+      last = value;
+    }
+  });
+  for (uint64_t i = 8u; i <= 1000u; i++)
+    EXPECT_TRUE(SetFlag("test_atomic", NumberToString(i)));
+  reader.join();
+}
+
+TEST_F(FlagsTest, GetFlagsHelp) {
+  const std::string help = GetFlagsHelp();
+  EXPECT_NE(std::string::npos,
+            help.find("  --test_int=<int32> (default: 1024)\n      An int.\n"));
+  EXPECT_NE(std::string::npos,
+            help.find("  --test_atomic=<uint64> (default: 7)\n"
+                      "      An atomic uint64.\n"));
+  EXPECT_NE(std::string::npos,
+            help.find("  --test_string=<string> (default: default)\n"));
+  // Sorted by name.
+  EXPECT_LT(help.find("--test_atomic"), help.find("--test_bool"));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,103 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/flight_recorder.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <new>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+constexpr char kMagic[8] = {'F', 'T', 'L', 'F', 'R', 'E', 'C', '1'};
+
+// Where the ring starts (leaving the header a cache line of its own).
+constexpr size_t kHeaderSize = 64u;
+
+}  // namespace
+
+// static
+std::shared_ptr<FlightRecorder> FlightRecorder::Create(const std::string& path,
+                                                       size_t capacity) {
+  static_assert(sizeof(Header) <= kHeaderSize, "");
+  FTL_DCHECK(capacity > 0u);
+  UniqueFD fd(HANDLE_EINTR(
+      open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)));
+  if (!fd.is_valid())
+    return nullptr;
+  const off_t size = static_cast<off_t>(kHeaderSize + capacity);
+  if (HANDLE_EINTR(ftruncate(fd.get(), size)) != 0)
+    return nullptr;
+#if defined(OS_LINUX)
+  // Allocate the blocks now, so that writing to the mapping can't fail (with
+  // SIGBUS) if the disk fills up.
+  if (posix_fallocate(fd.get(), 0, size) != 0)
+    return nullptr;
+#endif
+  files::MappedFile file;
+  if (!file.Map(fd, files::MappedFile::Mode::kReadWrite))
+    return nullptr;
+  return std::shared_ptr<FlightRecorder>(
+      new FlightRecorder(std::move(file), capacity));
+}
+
+FlightRecorder::FlightRecorder(files::MappedFile file, size_t capacity)
+    : file_(std::move(file)),
+      capacity_(capacity),
+      header_(new (file_.mutable_data()) Header),
+      ring_(file_.mutable_data() + kHeaderSize) {
+  memcpy(header_->magic, kMagic, sizeof(kMagic));
+  header_->capacity = capacity;
+  header_->position.store(0u, std::memory_order_relaxed);
+}
+
+FlightRecorder::~FlightRecorder() {}
+
+void FlightRecorder::Write(const LogRecord* records, size_t count) {
+  for (size_t i = 0u; i < count; i++)
+    Append(records[i].formatted);
+}
+
+bool ReadFlightRecorder(const std::string& path, std::string* contents) {
+  using Header = FlightRecorder::Header;
+  std::string data;
+  if (!files::ReadFileToString(path, &data) || data.size() < kHeaderSize ||
+      memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+    return false;
+  uint64_t capacity;
+  uint64_t position;
+  memcpy(&capacity, data.data() + offsetof(Header, capacity),
+         sizeof(capacity));
+  memcpy(&position, data.data() + offsetof(Header, position),
+         sizeof(position));
+  if (capacity != data.size() - kHeaderSize)
+    return false;
+
+  const StringView ring = StringView(data).substr(kHeaderSize);
+  if (position <= capacity) {
+    *contents = ring.substr(0u, static_cast<size_t>(position)).ToString();
+    return true;
+  }
+  // The ring has wrapped: the oldest data starts where the next append goes,
+  // probably partway through a line.
+  const size_t offset = static_cast<size_t>(position % capacity);
+  std::string ordered = ring.substr(offset).ToString();
+  ordered.append(ring.data(), offset);
+  const size_t newline = ordered.find('\n');
+  contents->assign(newline == std::string::npos ? std::string()
+                                                : ordered.substr(newline + 1u));
+  return true;
+}
+
+}  // namespace ftl
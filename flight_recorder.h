@@ -0,0 +1,109 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FLIGHT_RECORDER_H_
+#define LIB_FTL_FLIGHT_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "lib/ftl/files/mapped_file.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/log_sink.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// Keeps the most recent log output in a fixed-size ring in a memory-mapped
+// file, so that it survives the process crashing (or being killed): the
+// mapping is shared with the file, so what's been written is in the page
+// cache, and the kernel writes it out whatever happens to the process. (It
+// doesn't survive the machine crashing, unless it happens to have been
+// written out by then.)
+//
+// Appending is just copying into the mapping (no system calls or locks), so
+// it's cheap enough to record verbose messages which are too expensive to
+// write out, e.g.:
+//
+//   std::string previous;
+//   if (ReadFlightRecorder(path, &previous))
+//     SavePreviousRunsLog(previous);
+//   LogSettings settings = GetLogSettings();
+//   settings.flight_recorder = FlightRecorder::Create(path, 16u << 20);
+//   settings.flight_recorder_min_level = -2;  // Also FTL_VLOG(2) and below.
+//   SetLogSettings(settings);
+//
+// (See |LogSettings::flight_recorder|.) It can also be used as a
+// |LogSettings::sink|, to record messages instead of writing them out.
+//
+// This is thread-safe: concurrent appends reserve space with an atomic
+// increment. (A thread which is preempted for as long as it takes other
+// threads to fill the whole ring may leave a garbled record.)
+class FTL_EXPORT FlightRecorder final : public LogSink {
+ public:
+  // Creates (or truncates) the file at |path|, with room for the last
+  // |capacity| bytes of output. Returns null on error.
+  static std::shared_ptr<FlightRecorder> Create(const std::string& path,
+                                                size_t capacity);
+
+  ~FlightRecorder() override;
+
+  size_t capacity() const { return capacity_; }
+
+  // Appends |data|, overwriting the oldest data if the ring is full. (If
+  // |data| is bigger than the ring, only its end is kept.)
+  void Append(StringView data) {
+    if (data.size() > capacity_)
+      data = data.substr(data.size() - capacity_);
+    const uint64_t start =
+        header_->position.fetch_add(data.size(), std::memory_order_relaxed);
+    const size_t offset = static_cast<size_t>(start % capacity_);
+    const size_t first = std::min(data.size(), capacity_ - offset);
+    memcpy(ring_ + offset, data.data(), first);
+    memcpy(ring_, data.data() + first, data.size() - first);
+  }
+
+  // |LogSink| implementation (appending each record's |formatted| line):
+  void Write(const LogRecord* records, size_t count) override;
+
+ private:
+  // At the start of the file, followed by the ring.
+  struct Header {
+    char magic[8];
+    uint64_t capacity;
+    // How many bytes have ever been appended (so, where the next append goes,
+    // modulo |capacity|).
+    std::atomic<uint64_t> position;
+  };
+
+  FlightRecorder(files::MappedFile file, size_t capacity);
+
+  friend bool ReadFlightRecorder(const std::string& path,
+                                 std::string* contents);
+
+  files::MappedFile file_;
+  const size_t capacity_;
+  Header* const header_;
+  char* const ring_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FlightRecorder);
+};
+
+// Reads what's in the flight recorder file at |path| (written by this process
+// or, say, one that crashed), oldest first, to |*contents|, starting at a line
+// boundary (dropping the oldest line if it was partly overwritten). Returns
+// false if the file can't be read or isn't a flight recorder file.
+FTL_EXPORT bool ReadFlightRecorder(const std::string& path,
+                                   std::string* contents);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_FLIGHT_RECORDER_H_
@@ -0,0 +1,169 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/flight_recorder.h"
+
+#include <stdio.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/log_settings.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/split_string.h"
+
+namespace ftl {
+namespace {
+
+TEST(FlightRecorder, AppendAndRead) {
+  files::ScopedTempDir dir;
+  const std::string path = dir.path() + "/recorder";
+  std::shared_ptr<FlightRecorder> recorder = FlightRecorder::Create(path, 20u);
+  ASSERT_TRUE(recorder);
+  EXPECT_EQ(20u, recorder->capacity());
+
+  std::string contents = "x";
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("", contents);
+
+  recorder->Append("one\n");
+  recorder->Append("two\n");
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("one\ntwo\n", contents);
+
+  // Wrapping around drops the partly overwritten line.
+  recorder->Append("three\n");
+  recorder->Append("four\n");
+  recorder->Append("five\n");
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("three\nfour\nfive\n", contents);
+  recorder->Append("six\n");
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("four\nfive\nsix\n", contents);
+
+  // Only the end of an append bigger than the ring is kept.
+  recorder->Append("0123456789\n0123456789\n");
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("0123456789\n", contents);
+
+  // The file outlives the recorder (as it would the process).
+  recorder.reset();
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("0123456789\n", contents);
+
+  // Creating a recorder again starts afresh.
+  recorder = FlightRecorder::Create(path, 100u);
+  ASSERT_TRUE(recorder);
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  EXPECT_EQ("", contents);
+}
+
+TEST(FlightRecorder, Errors) {
+  files::ScopedTempDir dir;
+  std::string contents;
+  EXPECT_FALSE(FlightRecorder::Create(dir.path() + "/missing/recorder", 10u));
+  EXPECT_FALSE(ReadFlightRecorder(dir.path() + "/missing", &contents));
+  std::string path;
+  ASSERT_TRUE(dir.NewTempFile(&path));
+  const std::string kNotARecorder(100u, 'x');
+  ASSERT_TRUE(files::WriteFile(path, kNotARecorder.data(),
+                               kNotARecorder.size()));
+  EXPECT_FALSE(ReadFlightRecorder(path, &contents));
+}
+
+TEST(FlightRecorder, ConcurrentAppends) {
+  constexpr int kThreads = 4;
+  constexpr int kLines = 10000;
+  // Equal-sized lines, so that they fill the ring exactly.
+  constexpr size_t kLineSize = sizeof("t=0 i=00000\n") - 1u;
+
+  files::ScopedTempDir dir;
+  const std::string path = dir.path() + "/recorder";
+  auto recorder = FlightRecorder::Create(path, 1000u * kLineSize);
+  ASSERT_TRUE(recorder);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&recorder, t] {
+      // (Sized for any ints, so the compiler can tell it never truncates.)
+      char line[sizeof("t=-2147483648 i=-2147483648\n")];
+      for (int i = 0; i < kLines; i++) {
+        ASSERT_EQ(static_cast<int>(kLineSize),
+                  snprintf(line, sizeof(line), "t=%d i=%05d\n", t, i));
+        recorder->Append(StringView(line, kLineSize));
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  std::string contents;
+  ASSERT_TRUE(ReadFlightRecorder(path, &contents));
+  std::vector<StringView> lines = SplitString(
+      contents, "\n", kKeepWhitespace, kSplitWantNonEmpty);
+  EXPECT_EQ(999u, lines.size());
+  for (StringView line : lines) {
+    EXPECT_EQ(kLineSize - 1u, line.size()) << line;
+    EXPECT_EQ("t=", line.substr(0u, 2u));
+  }
+}
+
+class FlightRecorderLogging : public ::testing::Test {
+ public:
+  FlightRecorderLogging() : old_settings_(GetLogSettings()) {}
+  ~FlightRecorderLogging() { SetLogSettings(old_settings_); }
+
+ private:
+  LogSettings old_settings_;
+};
+
+TEST_F(FlightRecorderLogging, RecordsVerboseMessages) {
+  files::ScopedTempDir dir;
+  LogSettings settings;
+  settings.min_log_level = LOG_WARNING;
+  ASSERT_TRUE(dir.NewTempFile(&settings.log_file));
+  const std::string path = dir.path() + "/recorder";
+  settings.flight_recorder = FlightRecorder::Create(path, 4096u);
+  ASSERT_TRUE(settings.flight_recorder);
+  settings.flight_recorder_min_level = -2;
+  SetLogSettings(settings);
+  EXPECT_EQ(-2, GetMinLogLevel());
+  EXPECT_EQ(LOG_WARNING, GetLogSettings().min_log_level);
+
+  FTL_VLOG(3) << "nowhere";
+  FTL_VLOG(2) << "verbose";
+  FTL_LOG(INFO) << "info";
+  FTL_LOG(WARNING) << "warning";
+  FlushLog();
+
+  std::string recorded;
+  ASSERT_TRUE(ReadFlightRecorder(path, &recorded));
+  EXPECT_EQ(std::string::npos, recorded.find("nowhere"));
+  EXPECT_NE(std::string::npos, recorded.find(")] verbose\n"));
+  EXPECT_NE(std::string::npos, recorded.find(")] info\n"));
+  EXPECT_NE(std::string::npos, recorded.find(")] warning\n"));
+
+  // Only the warning is written out.
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(settings.log_file, &log));
+  EXPECT_EQ(std::string::npos, log.find("verbose"));
+  EXPECT_EQ(std::string::npos, log.find("info"));
+  EXPECT_NE(std::string::npos, log.find(")] warning\n"));
+
+  // Unless |vmodule| turns a message on.
+  settings.vmodule = "flight_recorder_unittest=1";
+  SetLogSettings(settings);
+  FTL_VLOG(1) << "vmodule";
+  FlushLog();
+  ASSERT_TRUE(files::ReadFileToString(settings.log_file, &log));
+  EXPECT_NE(std::string::npos, log.find(")] vmodule\n"));
+  ASSERT_TRUE(ReadFlightRecorder(path, &recorded));
+  EXPECT_NE(std::string::npos, recorded.find(")] vmodule\n"));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FUNCTIONAL_BIND_ONCE_H_
+#define LIB_FTL_FUNCTIONAL_BIND_ONCE_H_
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/functional/apply.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+namespace internal {
+
+template <typename F, typename... BoundArgs>
+class OnceCallable {
+ public:
+  explicit OnceCallable(F f, BoundArgs... bound_args)
+      : f_(std::move(f)), bound_args_(std::move(bound_args)...) {}
+
+  OnceCallable(OnceCallable&& other) = default;
+  OnceCallable& operator=(OnceCallable&& other) = default;
+
+  template <typename... CallArgs>
+  decltype(auto) operator()(CallArgs&&... call_args) {
+#ifndef NDEBUG
+    FTL_DCHECK(!was_called_) << "A BindOnce() callable was called twice";
+    was_called_ = true;
+#endif
+    return Apply(std::move(f_),
+                 std::tuple_cat(std::move(bound_args_),
+                                std::forward_as_tuple(
+                                    std::forward<CallArgs>(call_args)...)));
+  }
+
+ private:
+  F f_;
+  std::tuple<BoundArgs...> bound_args_;
+#ifndef NDEBUG
+  bool was_called_ = false;
+#endif
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(OnceCallable);
+};
+
+}  // namespace internal
+
+// Returns a move-only callable which, when called (at most once), calls |f|
+// with |bound_args| (moved into the call) followed by its own arguments.
+// |f| and |bound_args| are stored by value in the callable itself, so it fits
+// in a |UniqueClosure| (and |TaskRunner::PostTask()|'s task) without a heap
+// allocation if they're small, e.g.:
+//
+//   std::unique_ptr<Request> request = ...;
+//   task_runner->PostTask(
+//       BindOnce(&HandleRequest, std::move(request), deadline));
+//
+// (Prefer this, or a lambda with move captures, to |MakeCopyable()| wherever
+// the destination is a |UniqueClosure|: |MakeCopyable()| moves the lambda to a
+// shared, ref-counted heap object so that it can be copied.)
+template <typename F, typename... BoundArgs>
+internal::OnceCallable<std::decay_t<F>, std::decay_t<BoundArgs>...> BindOnce(
+    F&& f,
+    BoundArgs&&... bound_args) {
+  return internal::OnceCallable<std::decay_t<F>, std::decay_t<BoundArgs>...>(
+      std::forward<F>(f), std::forward<BoundArgs>(bound_args)...);
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_FUNCTIONAL_BIND_ONCE_H_
@@ -0,0 +1,64 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/functional/bind_once.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/functional/inline_closure.h"
+
+namespace ftl {
+namespace {
+
+int Add(std::unique_ptr<int> a, int b) {
+  return *a + b;
+}
+
+void Store(std::unique_ptr<std::string> value, std::string* result) {
+  *result = *value;
+}
+
+TEST(BindOnceTest, BoundArguments) {
+  auto callable = BindOnce(&Add, std::unique_ptr<int>(new int(40)), 2);
+  EXPECT_EQ(42, callable());
+}
+
+TEST(BindOnceTest, CallArguments) {
+  auto callable = BindOnce(&Add, std::unique_ptr<int>(new int(40)));
+  auto moved = std::move(callable);
+  EXPECT_EQ(45, moved(5));
+}
+
+TEST(BindOnceTest, Lambda) {
+  std::unique_ptr<int> value(new int(7));
+  auto callable = BindOnce(
+      [](std::unique_ptr<int> v, int factor) { return *v * factor; },
+      std::move(value), 6);
+  EXPECT_EQ(42, callable());
+}
+
+TEST(BindOnceTest, StoresInlineInUniqueClosure) {
+  std::string result;
+  auto callable = BindOnce(
+      &Store, std::unique_ptr<std::string>(new std::string("hello")), &result);
+  static_assert(UniqueClosure::StoresInline<decltype(callable)>(),
+                "BindOnce() callables should be stored inline");
+  UniqueClosure closure(std::move(callable));
+  closure();
+  EXPECT_EQ("hello", result);
+}
+
+#ifndef NDEBUG
+TEST(BindOnceTest, CalledTwice) {
+  auto callable = BindOnce([](int value) { return value; }, 1);
+  EXPECT_EQ(1, callable());
+  EXPECT_DEATH_IF_SUPPORTED(callable(), "called twice");
+}
+#endif
+
+}  // namespace
+}  // namespace ftl
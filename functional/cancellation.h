@@ -0,0 +1,158 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides cancellation flags which may be set and checked on any thread.
+
+#ifndef LIB_FTL_FUNCTIONAL_CANCELLATION_H_
+#define LIB_FTL_FUNCTIONAL_CANCELLATION_H_
+
+#include <atomic>
+#include <functional>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/pool_allocated.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+
+namespace ftl {
+namespace internal {
+
+class CancellationFlag : public RefCountedThreadSafe<CancellationFlag> {
+ public:
+  FTL_POOL_ALLOCATED(CancellationFlag);
+
+  bool IsSet() const { return is_set_.load(std::memory_order_acquire); }
+  void Set() { is_set_.store(true, std::memory_order_release); }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(CancellationFlag);
+  FRIEND_MAKE_REF_COUNTED(CancellationFlag);
+
+  CancellationFlag() : is_set_(false) {}
+  ~CancellationFlag() {}
+
+  std::atomic<bool> is_set_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CancellationFlag);
+};
+
+}  // namespace internal
+
+// CancellationToken -----------------------------------------------------------
+
+// A handle on a |CancellationSource|'s flag, for the work it may cancel to
+// check (e.g., between the steps of a long computation). Tokens are cheap to
+// copy, and may be copied, checked and destroyed on any thread (regardless of
+// the source's lifetime). A default-constructed token is never canceled.
+class CancellationToken {
+ public:
+  CancellationToken() {}
+
+  // Returns true once the source has been canceled. Effects on the canceling
+  // thread before |CancellationSource::Cancel()| are visible after this
+  // returns true.
+  bool IsCanceled() const { return flag_ && flag_->IsSet(); }
+
+ private:
+  friend class CancellationSource;
+
+  explicit CancellationToken(RefPtr<internal::CancellationFlag> flag)
+      : flag_(std::move(flag)) {}
+
+  RefPtr<internal::CancellationFlag> flag_;
+};
+
+// CancellationSource ----------------------------------------------------------
+
+// Vends |CancellationToken|s, and cancels them all (once and for all) when
+// |Cancel()| is called, e.g.:
+//
+//   CancellationSource source;
+//   thread_pool->PostCancelableTask([] { ExpensiveWork(); }, source.token());
+//   ...
+//   source.Cancel();  // From any thread; the task won't start after this.
+//
+// Unlike |CancelableCallback|, this may be canceled on any thread (and
+// concurrently with the tokens being checked). Destroying the source doesn't
+// cancel it. A source may be moved, but not copied.
+class CancellationSource {
+ public:
+  CancellationSource()
+      : flag_(MakeRefCounted<internal::CancellationFlag>()) {}
+
+  CancellationSource(CancellationSource&& other) = default;
+  CancellationSource& operator=(CancellationSource&& other) = default;
+
+  // Cancels the tokens (this may be called more than once, on any thread).
+  void Cancel() {
+    FTL_DCHECK(flag_);
+    flag_->Set();
+  }
+
+  bool IsCanceled() const {
+    FTL_DCHECK(flag_);
+    return flag_->IsSet();
+  }
+
+  CancellationToken token() const {
+    FTL_DCHECK(flag_);
+    return CancellationToken(flag_);
+  }
+
+ private:
+  RefPtr<internal::CancellationFlag> flag_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CancellationSource);
+};
+
+// ThreadSafeCancelableCallback ------------------------------------------------
+
+// Like |CancelableCallback|, but may be canceled (or destroyed) on any thread,
+// and may be posted to any thread: the wrappers returned by |callback()| do
+// nothing once |Cancel()| has been called. (A wrapper which has already started
+// running the callback isn't interrupted; the callback may check |token()| to
+// stop early.) The wrappers hold a reference to the wrapped callback, so it's
+// only destroyed once they all are.
+template <typename Sig>
+class ThreadSafeCancelableCallback;
+
+template <typename... Args>
+class ThreadSafeCancelableCallback<void(Args...)> {
+ public:
+  explicit ThreadSafeCancelableCallback(
+      std::function<void(Args...)> callback) {
+    FTL_DCHECK(callback);
+    wrapper_ = [token = source_.token(),
+                callback = std::move(callback)](Args... args) {
+      if (!token.IsCanceled())
+        callback(std::forward<Args>(args)...);
+    };
+  }
+
+  ~ThreadSafeCancelableCallback() { Cancel(); }
+
+  void Cancel() { source_.Cancel(); }
+
+  bool IsCanceled() const { return source_.IsCanceled(); }
+
+  // Returns a callback which runs the wrapped callback unless this has been
+  // canceled.
+  const std::function<void(Args...)>& callback() const { return wrapper_; }
+
+  CancellationToken token() const { return source_.token(); }
+
+ private:
+  CancellationSource source_;
+  std::function<void(Args...)> wrapper_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadSafeCancelableCallback);
+};
+
+using ThreadSafeCancelableClosure = ThreadSafeCancelableCallback<void(void)>;
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_FUNCTIONAL_CANCELLATION_H_
@@ -0,0 +1,95 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/functional/cancellation.h"
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TEST(CancellationTest, Basic) {
+  CancellationToken null_token;
+  EXPECT_FALSE(null_token.IsCanceled());
+
+  CancellationSource source;
+  CancellationToken token = source.token();
+  EXPECT_FALSE(source.IsCanceled());
+  EXPECT_FALSE(token.IsCanceled());
+
+  source.Cancel();
+  EXPECT_TRUE(source.IsCanceled());
+  EXPECT_TRUE(token.IsCanceled());
+  EXPECT_TRUE(source.token().IsCanceled());
+  source.Cancel();
+  EXPECT_TRUE(token.IsCanceled());
+}
+
+TEST(CancellationTest, TokenOutlivesSource) {
+  CancellationToken token;
+  {
+    CancellationSource source;
+    token = source.token();
+  }
+  EXPECT_FALSE(token.IsCanceled());
+
+  {
+    CancellationSource source;
+    token = source.token();
+    CancellationSource moved(std::move(source));
+    moved.Cancel();
+  }
+  EXPECT_TRUE(token.IsCanceled());
+}
+
+TEST(CancellationTest, CancelFromAnotherThread) {
+  CancellationSource source;
+  std::atomic<int> iterations(0);
+  int data = 0;
+  std::thread worker([token = source.token(), &iterations, &data] {
+    while (!token.IsCanceled())
+      iterations.fetch_add(1, std::memory_order_relaxed);
+    // The write before |Cancel()| is visible.
+    EXPECT_EQ(42, data);
+  });
+  while (!iterations.load(std::memory_order_relaxed))
+    std::this_thread::yield();
+  data = 42;
+  source.Cancel();
+  worker.join();
+}
+
+TEST(ThreadSafeCancelableCallbackTest, Basic) {
+  int sum = 0;
+  ThreadSafeCancelableCallback<void(int)> cancelable(
+      [&sum](int value) { sum += value; });
+  std::function<void(int)> callback = cancelable.callback();
+  callback(1);
+  cancelable.callback()(2);
+  EXPECT_EQ(3, sum);
+  EXPECT_FALSE(cancelable.IsCanceled());
+
+  std::thread([&cancelable] { cancelable.Cancel(); }).join();
+  EXPECT_TRUE(cancelable.IsCanceled());
+  EXPECT_TRUE(cancelable.token().IsCanceled());
+  callback(4);
+  EXPECT_EQ(3, sum);
+}
+
+TEST(ThreadSafeCancelableCallbackTest, DestructionCancels) {
+  bool did_run = false;
+  ThreadSafeCancelableClosure* cancelable =
+      new ThreadSafeCancelableClosure([&did_run] { did_run = true; });
+  std::function<void()> callback = cancelable->callback();
+  delete cancelable;
+  callback();
+  EXPECT_FALSE(did_run);
+}
+
+}  // namespace
+}  // namespace ftl
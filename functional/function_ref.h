@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FUNCTIONAL_FUNCTION_REF_H_
+#define LIB_FTL_FUNCTIONAL_FUNCTION_REF_H_
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace ftl {
+
+template <typename Signature>
+class FunctionRef;
+
+// A non-owning reference to a callable, for parameters of functions which only
+// call it before they return (e.g., visitors), e.g.:
+//
+//   void ForEachEntry(FunctionRef<void(const Entry&)> visitor);
+//   ...
+//   ForEachEntry([&count](const Entry& entry) { count += entry.size; });
+//
+// It's two pointers (the callable, and a function to call it through), so,
+// unlike |std::function|, it never allocates, and it's cheap to pass by value.
+// The callable must outlive the |FunctionRef|, so a |FunctionRef| shouldn't be
+// stored (e.g., in a variable initialized from a temporary lambda, or for an
+// asynchronous callback; use |std::function| or |UniqueClosure| instead).
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> final {
+ public:
+  // Refers to |callable| (which may be a function pointer, which mustn't be
+  // null, a lambda or any other callable, but not another |FunctionRef|).
+  template <typename F,
+            typename = typename std::enable_if<
+                !std::is_same<typename std::decay<F>::type,
+                              FunctionRef>::value>::type>
+  FunctionRef(F&& callable)
+      : callable_(const_cast<void*>(
+            static_cast<const void*>(std::addressof(callable)))),
+        invoke_(&Invoke<typename std::remove_reference<F>::type>) {}
+
+  // Refers to function |function| directly, rather than to a pointer to it
+  // (which may not outlive this).
+  FunctionRef(R (*function)(Args...))
+      : callable_(reinterpret_cast<void*>(function)),
+        invoke_(&InvokeFunction) {}
+
+  FunctionRef(const FunctionRef& other) = default;
+  FunctionRef& operator=(const FunctionRef& other) = default;
+
+  R operator()(Args... args) const {
+    return invoke_(callable_, std::forward<Args>(args)...);
+  }
+
+ private:
+  template <typename F>
+  static R Invoke(void* callable, Args... args) {
+    // (The cast discards the result, if |R| is void.)
+    return static_cast<R>(
+        (*static_cast<F*>(callable))(std::forward<Args>(args)...));
+  }
+
+  static R InvokeFunction(void* function, Args... args) {
+    return reinterpret_cast<R (*)(Args...)>(function)(
+        std::forward<Args>(args)...);
+  }
+
+  void* callable_;
+  R (*invoke_)(void* callable, Args... args);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_FUNCTIONAL_FUNCTION_REF_H_
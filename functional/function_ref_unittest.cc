@@ -0,0 +1,82 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/functional/function_ref.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+int Square(int x) {
+  return x * x;
+}
+
+int CallTwice(FunctionRef<int(int)> f, int x) {
+  return f(f(x));
+}
+
+TEST(FunctionRefTest, Lambdas) {
+  int calls = 0;
+  auto add_one = [&calls](int x) {
+    calls++;
+    return x + 1;
+  };
+  EXPECT_EQ(3, CallTwice(add_one, 1));
+  EXPECT_EQ(2, calls);
+
+  // A temporary lives until the end of the full expression.
+  EXPECT_EQ(12, CallTwice([](int x) { return x * 2; }, 3));
+
+  // Mutable lambdas are called in place.
+  int total = 0;
+  auto accumulate = [total](int x) mutable { return total += x; };
+  EXPECT_EQ(4, CallTwice(accumulate, 2));
+  EXPECT_EQ(6, accumulate(2));
+}
+
+TEST(FunctionRefTest, FunctionPointers) {
+  EXPECT_EQ(16, CallTwice(Square, 2));
+  EXPECT_EQ(16, CallTwice(&Square, 2));
+
+  int (*function)(int) = Square;
+  FunctionRef<int(int)> ref = function;
+  // It refers to the function, not the pointer.
+  function = nullptr;
+  EXPECT_EQ(9, ref(3));
+}
+
+TEST(FunctionRefTest, Conversions) {
+  // The result is discarded.
+  std::vector<int> values;
+  auto push_back = [&values](int x) {
+    values.push_back(x);
+    return values.size();
+  };
+  FunctionRef<void(int)> push = push_back;
+  push(1);
+  push(2);
+  EXPECT_EQ((std::vector<int>{1, 2}), values);
+
+  // Arguments are forwarded (so move-only ones work).
+  std::unique_ptr<int> taken;
+  auto take = [&taken](std::unique_ptr<int> p) { taken = std::move(p); };
+  FunctionRef<void(std::unique_ptr<int>)> take_ref = take;
+  take_ref(std::unique_ptr<int>(new int(5)));
+  ASSERT_TRUE(taken);
+  EXPECT_EQ(5, *taken);
+
+  // Copies refer to the same callable.
+  FunctionRef<void(int)> copy = push;
+  copy(3);
+  EXPECT_EQ(3u, values.size());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,212 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_FUNCTIONAL_INLINE_CLOSURE_H_
+#define LIB_FTL_FUNCTIONAL_INLINE_CLOSURE_H_
+
+#include <stddef.h>
+
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ftl {
+
+template <size_t InlineSize>
+class InlineClosure;
+
+namespace internal {
+
+// The type-specific operations of an |InlineClosure|, which operate on its
+// storage.
+struct InlineClosureOps {
+  void (*invoke)(void* storage);
+  // Moves the callable from |from| to |to|, leaving |from| uninitialized.
+  void (*relocate)(void* from, void* to);
+  void (*destroy)(void* storage);
+};
+
+// For callables stored directly in the storage.
+template <typename F, bool Inline>
+struct InlineClosureOpsFor {
+  static void Invoke(void* storage) { (*static_cast<F*>(storage))(); }
+
+  static void Relocate(void* from, void* to) {
+    F* f = static_cast<F*>(from);
+    new (to) F(std::move(*f));
+    f->~F();
+  }
+
+  static void Destroy(void* storage) { static_cast<F*>(storage)->~F(); }
+
+  static const InlineClosureOps ops;
+};
+
+template <typename F, bool Inline>
+const InlineClosureOps InlineClosureOpsFor<F, Inline>::ops = {
+    &Invoke, &Relocate, &Destroy};
+
+// For callables on the heap, with the storage holding a pointer to them.
+template <typename F>
+struct InlineClosureOpsFor<F, false> {
+  static F*& Get(void* storage) { return *static_cast<F**>(storage); }
+
+  static void Invoke(void* storage) { (*Get(storage))(); }
+
+  static void Relocate(void* from, void* to) {
+    new (to) F*(Get(from));
+  }
+
+  static void Destroy(void* storage) { delete Get(storage); }
+
+  static const InlineClosureOps ops;
+};
+
+template <typename F>
+const InlineClosureOps InlineClosureOpsFor<F, false>::ops = {
+    &Invoke, &Relocate, &Destroy};
+
+// Returns true if |f| is a "null" callable, which should result in an empty
+// |InlineClosure|.
+template <typename F>
+bool IsNullCallable(const F& f) {
+  return false;
+}
+
+template <typename R, typename... Args>
+bool IsNullCallable(R (*f)(Args...)) {
+  return !f;
+}
+
+template <typename R, typename... Args>
+bool IsNullCallable(const std::function<R(Args...)>& f) {
+  return !f;
+}
+
+template <size_t InlineSize>
+bool IsNullCallable(const InlineClosure<InlineSize>& f) {
+  return !f;
+}
+
+}  // namespace internal
+
+// A move-only, type-erased |void()| callable, like a |Closure| that doesn't
+// need to be copyable and that stores callables of up to |InlineSize| bytes
+// (e.g., lambdas with a few captures) inline, without any heap allocation.
+// Larger callables (and ones which could throw when moved) are stored on the
+// heap.
+//
+// Since it doesn't need to copy the callable, it can hold lambdas which capture
+// move-only types directly (without |MakeCopyable()|):
+//
+//   std::unique_ptr<Foo> foo = ...;
+//   UniqueClosure closure([foo = std::move(foo)] { foo->Bar(); });
+//
+// As with |Closure|, it is an error to call an empty |InlineClosure|.
+template <size_t InlineSize>
+class InlineClosure final {
+  static_assert(InlineSize >= sizeof(void*),
+                "InlineSize must be at least the size of a pointer");
+
+  template <typename F>
+  using EnableIfCallable = typename std::enable_if<
+      !std::is_same<typename std::decay<F>::type, InlineClosure>::value,
+      decltype(std::declval<typename std::decay<F>::type&>()(),
+               void())>::type;
+
+ public:
+  // Returns true if a callable of type |F| would be stored inline.
+  template <typename F>
+  static constexpr bool StoresInline() {
+    return sizeof(F) <= InlineSize && alignof(F) <= kAlignment &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+  InlineClosure() {}
+  InlineClosure(std::nullptr_t) {}
+
+  template <typename F, typename = EnableIfCallable<F>>
+  InlineClosure(F&& f) {
+    using Callable = typename std::decay<F>::type;
+    if (internal::IsNullCallable(f))
+      return;
+    Init<Callable>(std::forward<F>(f),
+                   std::integral_constant<bool, StoresInline<Callable>()>());
+  }
+
+  InlineClosure(InlineClosure&& other) { MoveFrom(&other); }
+
+  ~InlineClosure() { Reset(); }
+
+  InlineClosure& operator=(InlineClosure&& other) {
+    if (this != &other) {
+      Reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  InlineClosure& operator=(std::nullptr_t) {
+    Reset();
+    return *this;
+  }
+
+  void operator()() const {
+    // Like |std::function| (and |Closure|), calling is const even though the
+    // callable may not be.
+    ops_->invoke(&storage_);
+  }
+
+  explicit operator bool() const { return !!ops_; }
+
+  void swap(InlineClosure& other) {
+    InlineClosure temp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(temp);
+  }
+
+ private:
+  // Pointer alignment, so that |UniqueClosure| is exactly 64 bytes on 64-bit
+  // platforms. Callables which need more are stored on the heap.
+  static constexpr size_t kAlignment = alignof(void*);
+
+  template <typename Callable, typename F>
+  void Init(F&& f, std::true_type /* inline */) {
+    new (&storage_) Callable(std::forward<F>(f));
+    ops_ = &internal::InlineClosureOpsFor<Callable, true>::ops;
+  }
+
+  template <typename Callable, typename F>
+  void Init(F&& f, std::false_type /* inline */) {
+    new (&storage_) Callable*(new Callable(std::forward<F>(f)));
+    ops_ = &internal::InlineClosureOpsFor<Callable, false>::ops;
+  }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+  void MoveFrom(InlineClosure* other) {
+    if (other->ops_) {
+      other->ops_->relocate(&other->storage_, &storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  const internal::InlineClosureOps* ops_ = nullptr;
+  mutable typename std::aligned_storage<InlineSize, kAlignment>::type storage_;
+};
+
+// The default |InlineClosure|, which (on 64-bit platforms) is 64 bytes in all,
+// and can hold a |Closure| or a lambda capturing up to seven pointers inline.
+using UniqueClosure = InlineClosure<7 * sizeof(void*)>;
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_FUNCTIONAL_INLINE_CLOSURE_H_
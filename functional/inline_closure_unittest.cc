@@ -0,0 +1,140 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/functional/inline_closure.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/functional/closure.h"
+
+namespace ftl {
+namespace {
+
+// Counts how many instances are alive.
+class Counted {
+ public:
+  explicit Counted(int* count) : count_(count) { (*count_)++; }
+  Counted(const Counted& other) : count_(other.count_) { (*count_)++; }
+  ~Counted() { (*count_)--; }
+
+ private:
+  int* count_;
+};
+
+TEST(InlineClosureTest, Empty) {
+  UniqueClosure closure;
+  EXPECT_FALSE(closure);
+  UniqueClosure null_closure(nullptr);
+  EXPECT_FALSE(null_closure);
+
+  // Empty |Closure|s and function pointers result in empty closures.
+  UniqueClosure from_closure{Closure()};
+  EXPECT_FALSE(from_closure);
+  void (*function)() = nullptr;
+  UniqueClosure from_function(function);
+  EXPECT_FALSE(from_function);
+}
+
+TEST(InlineClosureTest, Call) {
+  int value = 0;
+  UniqueClosure closure([&value] { value++; });
+  EXPECT_TRUE(closure);
+  closure();
+  closure();
+  EXPECT_EQ(2, value);
+
+  Closure function = [&value] { value += 10; };
+  UniqueClosure from_closure(function);
+  from_closure();
+  EXPECT_EQ(12, value);
+}
+
+TEST(InlineClosureTest, MoveOnlyCapture) {
+  std::unique_ptr<int> ptr(new int(42));
+  int result = 0;
+  UniqueClosure closure(
+      [&result, ptr = std::move(ptr)] { result = *ptr; });
+  EXPECT_FALSE(ptr);
+  UniqueClosure moved(std::move(closure));
+  EXPECT_FALSE(closure);
+  moved();
+  EXPECT_EQ(42, result);
+}
+
+TEST(InlineClosureTest, MutableState) {
+  int result = 0;
+  UniqueClosure closure([&result, count = 0]() mutable { result = ++count; });
+  closure();
+  closure();
+  EXPECT_EQ(2, result);
+}
+
+TEST(InlineClosureTest, Storage) {
+  EXPECT_EQ(8 * sizeof(void*), sizeof(UniqueClosure));
+
+  struct Small {
+    void* pointers[7];
+    void operator()() {}
+  };
+  struct Large {
+    void* pointers[8];
+    void operator()() {}
+  };
+  EXPECT_TRUE(UniqueClosure::StoresInline<Small>());
+  EXPECT_TRUE(UniqueClosure::StoresInline<Closure>());
+  EXPECT_FALSE(UniqueClosure::StoresInline<Large>());
+  EXPECT_TRUE(InlineClosure<8 * sizeof(void*)>::StoresInline<Large>());
+}
+
+TEST(InlineClosureTest, DestroysCallable) {
+  for (size_t padding_size : {1u, 100u}) {
+    int count = 0;
+    {
+      Counted counted(&count);
+      std::vector<uint8_t> unused(padding_size);
+      UniqueClosure closure;
+      if (padding_size == 1u) {
+        closure = [counted] {};
+      } else {
+        // Stored on the heap.
+        uint8_t padding[100] = {};
+        closure = [counted, padding] {};
+      }
+      EXPECT_EQ(2, count);
+
+      UniqueClosure moved(std::move(closure));
+      EXPECT_EQ(2, count);
+      UniqueClosure assigned;
+      assigned = std::move(moved);
+      EXPECT_EQ(2, count);
+      assigned = nullptr;
+      EXPECT_EQ(1, count);
+    }
+    EXPECT_EQ(0, count);
+  }
+}
+
+TEST(InlineClosureTest, Swap) {
+  int a = 0;
+  int b = 0;
+  UniqueClosure closure_a([&a] { a++; });
+  UniqueClosure closure_b([&b] { b++; });
+  closure_a.swap(closure_b);
+  closure_a();
+  EXPECT_EQ(0, a);
+  EXPECT_EQ(1, b);
+
+  UniqueClosure empty;
+  empty.swap(closure_a);
+  EXPECT_FALSE(closure_a);
+  empty();
+  EXPECT_EQ(2, b);
+}
+
+}  // namespace
+}  // namespace ftl
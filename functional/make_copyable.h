@@ -7,6 +7,7 @@
 
 #include <utility>
 
+#include "lib/ftl/memory/allocation_profiling.h"
 #include "lib/ftl/memory/ref_counted.h"
 #include "lib/ftl/memory/ref_ptr.h"
 
@@ -16,8 +17,11 @@ namespace internal {
 template <typename T>
 class CopyableLambda {
  public:
-  explicit CopyableLambda(T func)
-      : impl_(MakeRefCounted<Impl>(std::move(func))) {}
+  // (This doesn't use |MakeRefCounted()|, so that the allocation is only
+  // recorded (when profiling) as |MakeCopyable()|'s.)
+  explicit CopyableLambda(T func) : impl_(AdoptRef(new Impl(std::move(func)))) {
+    FTL_RECORD_INLINE_ALLOCATION(sizeof(Impl));
+  }
 
   template <typename... ArgType>
   auto operator()(ArgType&&... args) const {
@@ -53,6 +57,11 @@ class CopyableLambda {
 // Notice that the return type of MakeCopyable is rarely used directly. Instead,
 // callers typically erase the type by implicitly converting the return value
 // to an std::function.
+//
+// The wrapper holds the lambda in a ref-counted heap object, so don't use it
+// where a move-only callable will do: |UniqueClosure| (and so
+// |TaskRunner::PostTask()|) accepts the lambda (or the result of |BindOnce()|)
+// directly, without allocating if it's small.
 template <typename T>
 internal::CopyableLambda<T> MakeCopyable(T lambda) {
   return internal::CopyableLambda<T>(std::move(lambda));
@@ -4,53 +4,91 @@
 
 #include "lib/ftl/log_settings.h"
 
-#include <fcntl.h>
 #include <string.h>
 
 #include <algorithm>
 #include <iostream>
+#include <memory>
+#include <utility>
 
 #include "lib/ftl/logging.h"
-#include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/synchronization/epoch.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/rcu_ptr.h"
 
 namespace ftl {
-namespace state {
+namespace internal {
 
-// Defined in log_settings_state.cc.
-extern LogSettings g_log_settings;
+// Defined in logging.cc. Returns 0, or (if the file can't be opened) errno.
+int SetLogFile(const LogSettings& settings);
 
-}  // namespace state
+// Defined in logging.cc. Sets which fields |LogMessage| prefixes have.
+void SetLogPrefixFields(const LogSettings& settings);
+
+}  // namespace internal
+
+namespace {
+
+// Never destroyed, since messages may be logged during exit.
+RcuPtr<const LogSettings>* GetLogSettingsPtr() {
+  static RcuPtr<const LogSettings>* settings =
+      new RcuPtr<const LogSettings>(std::make_unique<const LogSettings>());
+  return settings;
+}
+
+// Serializes |SetLogSettings()|.
+Mutex* GetSetLogSettingsMutex() {
+  static Mutex* mutex = new Mutex();
+  return mutex;
+}
+
+}  // namespace
 
 void SetLogSettings(const LogSettings& settings) {
+  MutexLocker locker(GetSetLogSettingsMutex());
+  const LogSettings old_settings = GetLogSettings();
+  auto new_settings = std::make_unique<LogSettings>(settings);
   // Validate the new settings as we set them.
-  state::g_log_settings.min_log_level =
-      std::min(LOG_FATAL, settings.min_log_level);
-
-  if (state::g_log_settings.log_file != settings.log_file) {
-    if (!settings.log_file.empty()) {
-      // Redirect stderr to file.
-      int fd = open(settings.log_file.c_str(), O_WRONLY | O_CREAT | O_APPEND);
-      if (fd < 0) {
-        std::cerr << "Could not open log file: " << settings.log_file << " ("
-                  << strerror(errno) << ")" << std::endl;
-      } else {
-        if (dup2(fd, STDERR_FILENO) < 0)
-          std::cerr << "Could not set stderr to log file: " << settings.log_file
-                    << " (" << strerror(errno) << ")" << std::endl;
-        else
-          state::g_log_settings.log_file = settings.log_file;
-        close(fd);
-      }
-    }
+  new_settings->min_log_level = std::min(LOG_FATAL, settings.min_log_level);
+
+  // Write out what was logged asynchronously before the output changes.
+  if (old_settings.async &&
+      (!settings.async || old_settings.log_file != settings.log_file ||
+       old_settings.sink != settings.sink))
+    FlushLog();
+
+  if (int error = internal::SetLogFile(settings)) {
+    std::cerr << "Could not open log file: " << settings.log_file << " ("
+              << strerror(error) << ")" << std::endl;
+    new_settings->log_file = old_settings.log_file;
   }
+
+  internal::SetLogPrefixFields(settings);
+  // Readers see either the old snapshot or the new one, never a mix.
+  GetLogSettingsPtr()->Update(std::move(new_settings));
+  // Messages are created if they're on for the output or the recorder.
+  LogSeverity min_level = settings.min_log_level;
+  if (settings.flight_recorder)
+    min_level = std::min(min_level, settings.flight_recorder_min_level);
+  state::g_min_log_level.store(std::min(LOG_FATAL, min_level),
+                               std::memory_order_relaxed);
+  internal::VlogSite::UpdateAll();
 }
 
 LogSettings GetLogSettings() {
-  return state::g_log_settings;
+  Epoch epoch;
+  return *GetLogSettingsPtr()->Get();
 }
 
 int GetMinLogLevel() {
-  return std::min(state::g_log_settings.min_log_level, LOG_FATAL);
+  return state::g_min_log_level.load(std::memory_order_relaxed);
+}
+
+namespace internal {
+
+const LogSettings* GetCurrentLogSettings() {
+  return GetLogSettingsPtr()->Get();
 }
 
+}  // namespace internal
 }  // namespace ftl
@@ -7,12 +7,39 @@
 
 #include "lib/ftl/log_level.h"
 
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
 #include <string>
 
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace ftl {
 
+class FlightRecorder;
+class LogSink;
+
+// What a thread logging with |LogSettings::async| does when its buffer is
+// full.
+enum class LogOverflowPolicy {
+  // Wait until the writer thread has made room.
+  kBlock,
+  // Drop the message (see |GetDroppedLogMessageCount()|).
+  kDrop,
+  // Drop the message, and have the writer log how many were dropped.
+  kCount,
+};
+
+// How |FTL_SLOG()| messages are written (see lib/ftl/structured_log.h).
+enum class StructuredLogFormat {
+  // key=value pairs, separated by spaces.
+  kLogfmt,
+  // A JSON object.
+  kJson,
+};
+
 // Settings which control the behavior of FTL logging.
 struct LogSettings {
   // The minimum logging level.
@@ -26,23 +53,103 @@ struct LogSettings {
   // verbose logging.
   LogSeverity min_log_level = LOG_INFO;
 
-  // The name of a file to which the log should be written.
-  // When non-empty, the previous log output is closed and logging is
-  // redirected to the specified file.  It is not possible to revert to
-  // the previous log output through this interface.
+  // Whether each message's prefix starts with the logging thread's id (see
+  // |LogRecord::thread_id|), and then the local time, to the microsecond, as
+  // in "[12345:1014/153012.123456:INFO:file.cc(12)] ". Neither calls for more
+  // than a clock read per message: the thread's id and the formatted date are
+  // cached (the latter until the second changes).
+  bool log_thread_ids = false;
+  bool log_timestamps = false;
+
+  // The name of a file to which the log should be written (appended to),
+  // instead of stderr. When empty, logging goes back to stderr. (stderr itself
+  // isn't redirected.)
   std::string log_file;
+
+  // When non-zero, |log_file| is rotated before a write would make it larger
+  // than this many bytes: it's renamed to |log_file|.1, and what was
+  // |log_file|.1 to |log_file|.2, and so on (see |max_rotated_log_files|).
+  // A single write of complete lines is never split across files.
+  uint64_t max_log_file_size = 0u;
+
+  // When non-zero, |log_file| is also rotated (as above) once it's been
+  // written to for this long.
+  TimeDelta log_file_rotation_interval;
+
+  // How many rotated log files to keep (so, |log_file|.1 to
+  // |log_file|.<max_rotated_log_files>); older ones are removed.
+  int max_rotated_log_files = 5;
+
+  // Whether rotated log files are compressed (with gzip, to |log_file|.1.gz and
+  // so on). Renumbering and compressing rotated files is done on a background
+  // thread (which |FlushLog()| waits for). Only where gzip can be run (Linux
+  // and Mac), otherwise they're left uncompressed.
+  bool compress_rotated_log_files = false;
+
+  // See |StructuredLogFormat|.
+  StructuredLogFormat structured_log_format = StructuredLogFormat::kLogfmt;
+
+  // Whether messages below LOG_FATAL are written asynchronously: the logging
+  // thread only copies the message into a (64 KiB, lock-free) buffer of its
+  // own, and a background thread writes the buffers out, so a slow stderr
+  // doesn't stall it. Messages from one thread stay in order, but messages
+  // from different threads may be written out of order. A LOG_FATAL message
+  // (and |FlushLog()|, which also runs at exit) first writes out everything
+  // buffered. Only applies where the log goes to stderr (not Android or iOS).
+  bool async = false;
+
+  // See |LogOverflowPolicy|. (Whatever the policy, a message longer than the
+  // buffer is waited for.)
+  LogOverflowPolicy overflow_policy = LogOverflowPolicy::kBlock;
+
+  // Per-file FTL_VLOG verbosities, as a comma-separated list of
+  // <pattern>=<level>, e.g., "message_loop=2,*_io*=1": FTL_VLOG(x) in a file
+  // matching a pattern is on if x <= level (whatever |min_log_level| is). A
+  // pattern is matched against the file's name without its extension, or, if
+  // it has a '/', against its path without the extension; '*' matches any
+  // characters, and '?' any one. The first matching pattern applies.
+  std::string vmodule;
+
+  // Where messages go, if set, instead of |log_file| or stderr (or the system
+  // log, on Android and iOS). See lib/ftl/log_sink.h.
+  std::shared_ptr<LogSink> sink;
+
+  // If set, messages at or above |flight_recorder_min_level| are also appended
+  // to it (see lib/ftl/flight_recorder.h), as they're logged, whether or not
+  // they're written out. Messages below |min_log_level| (which
+  // |flight_recorder_min_level| may be lower than, e.g., -2 to record
+  // FTL_VLOG(2) too) only go to the recorder, unless |vmodule| turns them on.
+  // (The recorder gets each line as it would be written out, so set
+  // |log_timestamps| to record when messages were logged.)
+  std::shared_ptr<FlightRecorder> flight_recorder;
+  LogSeverity flight_recorder_min_level = LOG_INFO;
 };
 
-// Gets the active log settings for the current process.
+// Sets the active log settings for the current process. This is safe to call
+// while other threads log (or call it).
 FTL_EXPORT void SetLogSettings(const LogSettings& settings);
 
-// Sets the active log settings for the current process.
+// Gets the active log settings for the current process.
 FTL_EXPORT LogSettings GetLogSettings();
 
-// Gets the minimum log level for the current process. Never returs a value
-// higher than LOG_FATAL.
+// Gets the minimum log level for the current process (the lower of
+// |LogSettings::min_log_level| and, if there's a flight recorder,
+// |LogSettings::flight_recorder_min_level|). Never returs a value higher than
+// LOG_FATAL.
 FTL_EXPORT int GetMinLogLevel();
 
+namespace state {
+
+// |GetMinLogLevel()|, which |FTL_LOG_IS_ON()| loads inline. Only
+// |SetLogSettings()| stores to it.
+FTL_EXPORT extern std::atomic<int> g_min_log_level;
+
+}  // namespace state
+
+// Returns true if |vmodule| is well-formed (see |LogSettings::vmodule|).
+// (|SetLogSettings()| ignores malformed entries.)
+FTL_EXPORT bool IsValidVmodule(const std::string& vmodule);
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_LOG_SETTINGS_H_
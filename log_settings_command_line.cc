@@ -44,6 +44,35 @@ bool ParseLogSettings(const ftl::CommandLine& command_line,
     settings.log_file = file;
   }
 
+  // --log-thread-ids, --log-timestamps
+  if (command_line.HasOption("log-thread-ids"))
+    settings.log_thread_ids = true;
+  if (command_line.HasOption("log-timestamps"))
+    settings.log_timestamps = true;
+
+  // --vmodule=<pattern>=<level>,...
+  std::string vmodule;
+  if (command_line.GetOptionValue("vmodule", &vmodule)) {
+    if (!IsValidVmodule(vmodule)) {
+      FTL_LOG(ERROR) << "Error parsing --vmodule option.";
+      return false;
+    }
+    settings.vmodule = vmodule;
+  }
+
+  // --structured-log-format=<logfmt|json>
+  std::string format;
+  if (command_line.GetOptionValue("structured-log-format", &format)) {
+    if (format == "logfmt") {
+      settings.structured_log_format = StructuredLogFormat::kLogfmt;
+    } else if (format == "json") {
+      settings.structured_log_format = StructuredLogFormat::kJson;
+    } else {
+      FTL_LOG(ERROR) << "Error parsing --structured-log-format option.";
+      return false;
+    }
+  }
+
   *out_settings = settings;
   return true;
 }
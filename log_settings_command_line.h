@@ -21,6 +21,10 @@ struct LogSettings;
 //   --quiet           : sets |min_log_level| to +1 (LOG_WARNING)
 //   --quiet=<level>   : sets |min_log_level| to +level
 //   --log-file=<file> : sets |log_file| to file, uses default output if empty
+//   --log-thread-ids  : sets |log_thread_ids|
+//   --log-timestamps  : sets |log_timestamps|
+//   --vmodule=<pattern>=<level>,... : sets |vmodule| (per-file verbosities)
+//   --structured-log-format=<logfmt|json> : sets |structured_log_format|
 //
 // Quiet supersedes verbose if both are specified.
 //
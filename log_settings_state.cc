@@ -7,8 +7,8 @@
 namespace ftl {
 namespace state {
 
-// Declared in log_settings.cc.
-LogSettings g_log_settings;
+// Declared in log_settings.h. (The other settings are in log_settings.cc.)
+std::atomic<int> g_min_log_level(LOG_INFO);
 
 }  // namespace state
 }  // namespace ftl
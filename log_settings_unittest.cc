@@ -4,13 +4,34 @@
 
 #include "lib/ftl/log_settings.h"
 
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "lib/ftl/command_line.h"
 #include "lib/ftl/files/file.h"
 #include "lib/ftl/files/scoped_temp_dir.h"
 #include "lib/ftl/log_settings_command_line.h"
+#include "lib/ftl/log_sink.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/structured_log.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/test/forked_child.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace ftl {
 namespace {
@@ -32,7 +53,15 @@ class LogSettingsFixture : public ::testing::Test {
 TEST(LogSettings, DefaultOptions) {
   LogSettings settings;
   EXPECT_EQ(LOG_INFO, settings.min_log_level);
+  EXPECT_FALSE(settings.log_thread_ids);
+  EXPECT_FALSE(settings.log_timestamps);
   EXPECT_EQ(std::string(), settings.log_file);
+  EXPECT_FALSE(settings.async);
+  EXPECT_EQ(LogOverflowPolicy::kBlock, settings.overflow_policy);
+  EXPECT_EQ(0u, settings.max_log_file_size);
+  EXPECT_EQ(TimeDelta::Zero(), settings.log_file_rotation_interval);
+  EXPECT_EQ(5, settings.max_rotated_log_files);
+  EXPECT_FALSE(settings.compress_rotated_log_files);
 }
 
 TEST(LogSettings, ParseValidOptions) {
@@ -71,6 +100,23 @@ TEST(LogSettings, ParseValidOptions) {
       CommandLineFromInitializerList({"argv0", "--log-file=custom.log"}),
       &settings));
   EXPECT_EQ("custom.log", settings.log_file);
+
+  EXPECT_TRUE(ParseLogSettings(
+      CommandLineFromInitializerList(
+          {"argv0", "--log-thread-ids", "--log-timestamps"}),
+      &settings));
+  EXPECT_TRUE(settings.log_thread_ids);
+  EXPECT_TRUE(settings.log_timestamps);
+
+  EXPECT_TRUE(ParseLogSettings(
+      CommandLineFromInitializerList({"argv0", "--vmodule=foo*=2,a/b=0"}),
+      &settings));
+  EXPECT_EQ("foo*=2,a/b=0", settings.vmodule);
+
+  EXPECT_TRUE(ParseLogSettings(
+      CommandLineFromInitializerList({"argv0", "--structured-log-format=json"}),
+      &settings));
+  EXPECT_EQ(StructuredLogFormat::kJson, settings.structured_log_format);
 }
 
 TEST(LogSettings, ParseInvalidOptions) {
@@ -94,6 +140,20 @@ TEST(LogSettings, ParseInvalidOptions) {
       CommandLineFromInitializerList({"argv0", "--quiet=123garbage"}),
       &settings));
   EXPECT_EQ(LOG_FATAL, settings.min_log_level);
+
+  EXPECT_FALSE(ParseLogSettings(
+      CommandLineFromInitializerList({"argv0", "--structured-log-format=xml"}),
+      &settings));
+  EXPECT_EQ(StructuredLogFormat::kLogfmt, settings.structured_log_format);
+
+  for (const char* vmodule : {"--vmodule=foo", "--vmodule=foo=", "--vmodule==1",
+                              "--vmodule=foo=-1", "--vmodule=foo=1,",
+                              "--vmodule=foo=1x", "--vmodule=foo=1,,bar=2"}) {
+    EXPECT_FALSE(ParseLogSettings(
+        CommandLineFromInitializerList({"argv0", vmodule}), &settings))
+        << vmodule;
+    EXPECT_EQ(std::string(), settings.vmodule);
+  }
 }
 
 TEST_F(LogSettingsFixture, SetAndGet) {
@@ -126,6 +186,87 @@ TEST_F(LogSettingsFixture, SetInvalidOptions) {
   EXPECT_EQ(old_settings.min_log_level, GetMinLogLevel());
 }
 
+TEST_F(LogSettingsFixture, Vmodule) {
+  auto vlog_is_on = [](int verbose_level) {
+    return FTL_VLOG_IS_ON(verbose_level);
+  };
+  LogSettings settings;
+  settings.min_log_level = LOG_INFO;
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(0));
+  EXPECT_FALSE(vlog_is_on(1));
+
+  // Sites already checked are updated.
+  settings.vmodule = "other=5,log_settings_unit*=2";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(2));
+  EXPECT_FALSE(vlog_is_on(3));
+  // As are sites checked for the first time.
+  EXPECT_TRUE(FTL_VLOG_IS_ON(2));
+  EXPECT_FALSE(FTL_VLOG_IS_ON(3));
+
+  // The first match applies, even if it's below |min_log_level|.
+  settings.min_log_level = -4;
+  settings.vmodule = "log_settings_unittest=1,*=3";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(1));
+  EXPECT_FALSE(vlog_is_on(2));
+
+  // Patterns with a '/' match the path; '?' matches one character.
+  settings.vmodule = "*/log_settings_unittes?=3";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(3));
+  EXPECT_FALSE(vlog_is_on(4));
+  settings.vmodule = "no/such/dir/*=0,log_settings_unittes?=3";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(3));
+  settings.vmodule = "log_settings=3,log_settings_unittest.cc=3";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(4));
+  EXPECT_FALSE(vlog_is_on(5));
+
+  // Malformed entries are ignored.
+  settings.min_log_level = LOG_INFO;
+  settings.vmodule = "log_settings_unittest,log_settings_unittest=1";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(1));
+  EXPECT_FALSE(vlog_is_on(2));
+
+  // Without a match, |min_log_level| applies.
+  settings.vmodule = "other=5";
+  SetLogSettings(settings);
+  EXPECT_TRUE(vlog_is_on(0));
+  EXPECT_FALSE(vlog_is_on(1));
+}
+
+TEST_F(LogSettingsFixture, SetWhileLogging) {
+  files::ScopedTempDir temp_dir;
+  LogSettings new_settings;
+  new_settings.log_file = temp_dir.path() + "/log";
+  new_settings.vmodule = "a=1";
+  SetLogSettings(new_settings);
+
+  std::atomic<bool> done(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&done] {
+      while (!done.load()) {
+        FTL_LOG(INFO) << "RACING";
+        LogSettings settings = GetLogSettings();
+        EXPECT_TRUE(settings.vmodule == "a=1" || settings.vmodule == "b=2");
+      }
+    });
+  }
+  for (int i = 0; i < 200; i++) {
+    new_settings.min_log_level = i % 2 ? LOG_INFO : LOG_WARNING;
+    new_settings.vmodule = i % 2 ? "a=1" : "b=2";
+    SetLogSettings(new_settings);
+  }
+  done.store(true);
+  for (auto& thread : threads)
+    thread.join();
+}
+
 TEST_F(LogSettingsFixture, SetValidLogFile) {
   const char kTestMessage[] = "TEST MESSAGE";
 
@@ -157,5 +298,502 @@ TEST_F(LogSettingsFixture, SetInvalidLogFile) {
   EXPECT_NE(0, access(new_settings.log_file.c_str(), R_OK));
 }
 
+TEST_F(LogSettingsFixture, LogFileLeavesStderr) {
+  files::ScopedTempDir temp_dir;
+  const std::string stderr_path = temp_dir.path() + "/stderr";
+  int stderr_fd = open(stderr_path.c_str(), O_WRONLY | O_CREAT, 0600);
+  ASSERT_LE(0, stderr_fd);
+  dup2(stderr_fd, STDERR_FILENO);
+  close(stderr_fd);
+
+  LogSettings new_settings;
+  new_settings.log_file = temp_dir.path() + "/log";
+  SetLogSettings(new_settings);
+  FTL_LOG(INFO) << "TO FILE";
+  std::cerr << "NOT LOGGED" << std::endl;
+  // Going back to stderr.
+  new_settings.log_file.clear();
+  SetLogSettings(new_settings);
+  FTL_LOG(INFO) << "TO STDERR";
+
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(temp_dir.path() + "/log", &log));
+  EXPECT_NE(std::string::npos, log.find("] TO FILE\n"));
+  EXPECT_EQ(std::string::npos, log.find("NOT LOGGED"));
+  EXPECT_EQ(std::string::npos, log.find("TO STDERR"));
+  struct stat info;
+  ASSERT_EQ(0, stat((temp_dir.path() + "/log").c_str(), &info));
+  EXPECT_EQ(0600, info.st_mode & 0600);
+
+  std::string err;
+  ASSERT_TRUE(files::ReadFileToString(stderr_path, &err));
+  EXPECT_EQ(std::string::npos, err.find("TO FILE"));
+  EXPECT_NE(std::string::npos, err.find("NOT LOGGED\n"));
+  EXPECT_NE(std::string::npos, err.find("] TO STDERR\n"));
+}
+
+TEST_F(LogSettingsFixture, RotateBySize) {
+  files::ScopedTempDir temp_dir;
+  const std::string path = temp_dir.path() + "/log";
+  LogSettings new_settings;
+  new_settings.log_file = path;
+  new_settings.max_log_file_size = 1000u;
+  new_settings.max_rotated_log_files = 2;
+  SetLogSettings(new_settings);
+  for (int i = 0; i < 100; i++)
+    FTL_LOG(INFO) << "ROTATED " << i << " " << std::string(50u, 'r');
+  FlushLog();
+
+  // The files hold whole messages, the newest in |path|; the oldest are gone.
+  int last = 100;
+  for (const std::string& file : {path, path + ".1", path + ".2"}) {
+    std::string log;
+    ASSERT_TRUE(files::ReadFileToString(file, &log)) << file;
+    EXPECT_LE(log.size(), 1000u);
+    std::istringstream lines(log);
+    std::string line;
+    std::vector<int> numbers;
+    while (std::getline(lines, line)) {
+      size_t position = line.find("] ROTATED ");
+      ASSERT_NE(std::string::npos, position) << line;
+      numbers.push_back(std::stoi(line.substr(position + 10u)));
+    }
+    ASSERT_FALSE(numbers.empty());
+    EXPECT_EQ(last - 1, numbers.back());
+    for (size_t i = 1u; i < numbers.size(); i++)
+      EXPECT_EQ(numbers[i - 1u] + 1, numbers[i]);
+    last = numbers.front();
+  }
+  EXPECT_NE(0, access((path + ".3").c_str(), F_OK));
+}
+
+TEST_F(LogSettingsFixture, RotateByTime) {
+  files::ScopedTempDir temp_dir;
+  const std::string path = temp_dir.path() + "/log";
+  LogSettings new_settings;
+  new_settings.log_file = path;
+  new_settings.log_file_rotation_interval = TimeDelta::FromMilliseconds(1);
+  SetLogSettings(new_settings);
+  FTL_LOG(INFO) << "FIRST";
+  SleepFor(TimeDelta::FromMilliseconds(5));
+  FTL_LOG(INFO) << "SECOND";
+  FlushLog();
+
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(path + ".1", &log));
+  EXPECT_NE(std::string::npos, log.find("] FIRST\n"));
+  ASSERT_TRUE(files::ReadFileToString(path, &log));
+  EXPECT_NE(std::string::npos, log.find("] SECOND\n"));
+  EXPECT_EQ(std::string::npos, log.find("FIRST"));
+}
+
+TEST_F(LogSettingsFixture, CompressRotated) {
+  if (system("gzip --version > /dev/null 2>&1") != 0)
+    return;  // No gzip to compress with.
+  files::ScopedTempDir temp_dir;
+  const std::string path = temp_dir.path() + "/log";
+  LogSettings new_settings;
+  new_settings.log_file = path;
+  new_settings.max_log_file_size = 100u;
+  new_settings.compress_rotated_log_files = true;
+  SetLogSettings(new_settings);
+  for (int i = 0; i < 3; i++)
+    FTL_LOG(INFO) << "COMPRESSED " << std::string(100u, 'c');
+  FlushLog();
+
+  for (const std::string& file : {path + ".1.gz", path + ".2.gz"}) {
+    std::string data;
+    ASSERT_TRUE(files::ReadFileToString(file, &data)) << file;
+    ASSERT_LE(2u, data.size());
+    EXPECT_EQ('\x1f', data[0]);
+    EXPECT_EQ('\x8b', data[1]);
+  }
+  EXPECT_NE(0, access((path + ".1").c_str(), F_OK));
+}
+
+// Nests a message in the formatting of another's.
+struct Nested {};
+
+std::ostream& operator<<(std::ostream& os, const Nested&) {
+  FTL_LOG(INFO) << "INNER";
+  return os << "NESTED";
+}
+
+TEST_F(LogSettingsFixture, MessageFormatting) {
+  LogSettings new_settings;
+  files::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.NewTempFile(&new_settings.log_file));
+  SetLogSettings(new_settings);
+
+  // The stream is reset between messages.
+  FTL_LOG(INFO) << "HEX " << std::hex << 255 << std::setw(6)
+                << std::setfill('*') << 1;
+  FTL_LOG(INFO) << "DEC " << 255 << " " << 3.14159265;
+  FTL_LOG(INFO) << "OUTER " << Nested() << " END";
+  const std::string medium(1000u, 'm');
+  const std::string large(100000u, 'l');
+  FTL_LOG(INFO) << "MEDIUM " << medium;
+  FTL_LOG(INFO) << "LARGE " << large;
+  FTL_LOG(INFO) << "SMALL";
+
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(new_settings.log_file, &log));
+  EXPECT_NE(std::string::npos, log.find("] HEX ff*****1\n"));
+  EXPECT_NE(std::string::npos, log.find("] DEC 255 3.14159\n"));
+  EXPECT_NE(std::string::npos, log.find("] INNER\n"));
+  EXPECT_NE(std::string::npos, log.find("] OUTER NESTED END\n"));
+  EXPECT_LT(log.find("] INNER\n"), log.find("] OUTER NESTED END\n"));
+  EXPECT_NE(std::string::npos, log.find("] MEDIUM " + medium + "\n"));
+  EXPECT_NE(std::string::npos, log.find("] LARGE " + large + "\n"));
+  EXPECT_NE(std::string::npos, log.find("] SMALL\n"));
+}
+
+// Returns how many of |line|'s characters from |*position| on are digits,
+// and moves past them.
+size_t SkipDigits(const std::string& line, size_t* position) {
+  const size_t start = *position;
+  while (*position < line.size() && line[*position] >= '0' &&
+         line[*position] <= '9')
+    ++*position;
+  return *position - start;
+}
+
+TEST_F(LogSettingsFixture, PrefixFields) {
+  LogSettings new_settings;
+  files::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.NewTempFile(&new_settings.log_file));
+  new_settings.log_thread_ids = true;
+  new_settings.log_timestamps = true;
+  SetLogSettings(new_settings);
+  const time_t before = time(nullptr);
+  FTL_LOG(INFO) << "BOTH";
+  const time_t after = time(nullptr);
+  new_settings.log_timestamps = false;
+  SetLogSettings(new_settings);
+  FTL_LOG(INFO) << "THREAD";
+  new_settings.log_thread_ids = false;
+  new_settings.log_timestamps = true;
+  SetLogSettings(new_settings);
+  FTL_LOG(INFO) << "TIME";
+  new_settings.log_timestamps = false;
+  SetLogSettings(new_settings);
+  FTL_LOG(INFO) << "NEITHER";
+
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(new_settings.log_file, &log));
+  std::istringstream lines(log);
+  std::string line;
+
+  // "[<thread id>:MMDD/HHMMSS.uuuuuu:INFO:..."
+  ASSERT_TRUE(std::getline(lines, line));
+  size_t position = 1u;
+  EXPECT_EQ('[', line[0]);
+  EXPECT_LT(0u, SkipDigits(line, &position)) << line;
+  const std::string thread_id = line.substr(1u, position - 1u);
+  EXPECT_EQ(':', line[position++]) << line;
+  // (The date may have changed since |before|.)
+  std::string dates[2];
+  for (int i = 0; i < 2; i++) {
+    const time_t when = i ? after : before;
+    struct tm local;
+    localtime_r(&when, &local);
+    char date[32];
+    snprintf(date, sizeof(date), "%02d%02d/", local.tm_mon + 1,
+             local.tm_mday);
+    dates[i] = date;
+  }
+  const std::string date = line.substr(position, 5u);
+  EXPECT_TRUE(date == dates[0] || date == dates[1]) << line;
+  position += 5u;
+  EXPECT_EQ(6u, SkipDigits(line, &position)) << line;
+  EXPECT_EQ('.', line[position++]) << line;
+  EXPECT_EQ(6u, SkipDigits(line, &position)) << line;
+  EXPECT_EQ(":INFO:", line.substr(position, 6u)) << line;
+  EXPECT_NE(std::string::npos, line.find(")] BOTH"));
+
+  ASSERT_TRUE(std::getline(lines, line));
+  EXPECT_EQ("[" + thread_id + ":INFO:", line.substr(0u, thread_id.size() + 7u));
+
+  ASSERT_TRUE(std::getline(lines, line));
+  position = 1u;
+  EXPECT_EQ(4u, SkipDigits(line, &position)) << line;
+  EXPECT_EQ('/', line[position]) << line;
+  EXPECT_NE(std::string::npos, line.find(":INFO:")) << line;
+  EXPECT_NE(std::string::npos, line.find(")] TIME"));
+
+  ASSERT_TRUE(std::getline(lines, line));
+  EXPECT_EQ(0u, line.find("[INFO:")) << line;
+}
+
+TEST_F(LogSettingsFixture, AsyncLogFile) {
+  constexpr int kThreads = 4;
+  constexpr int kMessages = 2000;
+
+  LogSettings new_settings;
+  new_settings.async = true;
+  files::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.NewTempFile(&new_settings.log_file));
+  SetLogSettings(new_settings);
+  EXPECT_TRUE(GetLogSettings().async);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < kMessages; i++)
+        FTL_LOG(INFO) << "ASYNC " << t << " " << i;
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  FlushLog();
+
+  // Every message is there, whole, and in order for its thread.
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(new_settings.log_file, &log));
+  std::istringstream lines(log);
+  std::string line;
+  int next[kThreads] = {};
+  while (std::getline(lines, line)) {
+    size_t position = line.find("] ASYNC ");
+    if (position == std::string::npos)
+      continue;
+    EXPECT_EQ(0u, line.find("[INFO:"));
+    std::istringstream fields(line.substr(position + 8u));
+    int t = -1, i = -1;
+    fields >> t >> i;
+    ASSERT_TRUE(t >= 0 && t < kThreads) << line;
+    EXPECT_EQ(next[t]++, i);
+  }
+  for (int t = 0; t < kThreads; t++)
+    EXPECT_EQ(kMessages, next[t]);
+}
+
+TEST_F(LogSettingsFixture, AsyncOverflow) {
+  constexpr int kMessages = 20000;
+
+  for (LogOverflowPolicy policy :
+       {LogOverflowPolicy::kDrop, LogOverflowPolicy::kCount}) {
+    SCOPED_TRACE(static_cast<int>(policy));
+    LogSettings new_settings;
+    new_settings.async = true;
+    new_settings.overflow_policy = policy;
+    files::ScopedTempDir temp_dir;
+    ASSERT_TRUE(temp_dir.NewTempFile(&new_settings.log_file));
+    SetLogSettings(new_settings);
+
+    uint64_t dropped = GetDroppedLogMessageCount();
+    for (int i = 0; i < kMessages; i++)
+      FTL_LOG(INFO) << "OVERFLOW " << i;
+    FlushLog();
+    dropped = GetDroppedLogMessageCount() - dropped;
+
+    // Whatever was dropped is accounted for.
+    std::string log;
+    ASSERT_TRUE(files::ReadFileToString(new_settings.log_file, &log));
+    std::istringstream lines(log);
+    std::string line;
+    uint64_t written = 0u;
+    uint64_t reported = 0u;
+    while (std::getline(lines, line)) {
+      if (line.find("] OVERFLOW ") != std::string::npos)
+        written++;
+      const char kDropped[] = "[WARNING] Dropped ";
+      if (line.compare(0u, sizeof(kDropped) - 1u, kDropped) == 0)
+        reported += std::stoull(line.substr(sizeof(kDropped) - 1u));
+    }
+    EXPECT_EQ(static_cast<uint64_t>(kMessages), written + dropped);
+    EXPECT_EQ(policy == LogOverflowPolicy::kCount ? dropped : 0u, reported);
+  }
+}
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+TEST_F(LogSettingsFixture, AsyncLogFileAcrossFork) {
+  constexpr int kMessages = 100;
+  // More than fit in a thread's buffer, so the child's writer has to drain it.
+  constexpr int kChildMessages = 5000;
+
+  LogSettings new_settings;
+  new_settings.async = true;
+  files::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.NewTempFile(&new_settings.log_file));
+  SetLogSettings(new_settings);
+  ASSERT_EQ(LogOverflowPolicy::kBlock, GetLogSettings().overflow_policy);
+
+  for (int i = 0; i < kMessages; i++)
+    FTL_LOG(INFO) << "PARENT " << i;
+  // (Possibly still buffered: the child mustn't write them again.)
+  EXPECT_TRUE(RunInForkedChild([] {
+    for (int i = 0; i < kChildMessages; i++)
+      FTL_LOG(INFO) << "CHILD " << i;
+    FlushLog();
+    return true;
+  }));
+  FlushLog();
+
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(new_settings.log_file, &log));
+  std::istringstream lines(log);
+  std::string line;
+  int next_parent = 0;
+  int next_child = 0;
+  while (std::getline(lines, line)) {
+    if (line.find("] PARENT ") != std::string::npos) {
+      EXPECT_EQ(next_parent++, std::stoi(line.substr(line.find("T ") + 2u)));
+    } else if (line.find("] CHILD ") != std::string::npos) {
+      EXPECT_EQ(next_child++, std::stoi(line.substr(line.find("D ") + 2u)));
+    }
+  }
+  EXPECT_EQ(kMessages, next_parent);
+  EXPECT_EQ(kChildMessages, next_child);
+}
+#endif  // !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+// Keeps copies of the records it's sent.
+class RecordingSink : public LogSink {
+ public:
+  struct Record {
+    LogSeverity severity;
+    std::string file;
+    int line;
+    int64_t timestamp_ns;
+    uint64_t thread_id;
+    std::string message;
+    std::string formatted;
+  };
+
+  void Write(const LogRecord* records, size_t count) override {
+    MutexLocker locker(&mutex_);
+    EXPECT_LT(0u, count);
+    batch_count_++;
+    for (size_t i = 0u; i < count; i++) {
+      const LogRecord& r = records[i];
+      records_.push_back(Record{r.severity, r.file, r.line, r.timestamp_ns,
+                                r.thread_id, r.message.ToString(),
+                                r.formatted.ToString()});
+    }
+  }
+
+  void Flush() override {
+    MutexLocker locker(&mutex_);
+    flush_count_++;
+  }
+
+  std::vector<Record> records() {
+    MutexLocker locker(&mutex_);
+    return records_;
+  }
+
+  size_t batch_count() {
+    MutexLocker locker(&mutex_);
+    return batch_count_;
+  }
+
+  size_t flush_count() {
+    MutexLocker locker(&mutex_);
+    return flush_count_;
+  }
+
+ private:
+  Mutex mutex_;
+  std::vector<Record> records_;
+  size_t batch_count_ = 0u;
+  size_t flush_count_ = 0u;
+};
+
+int64_t NowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+TEST_F(LogSettingsFixture, Sink) {
+  auto sink = std::make_shared<RecordingSink>();
+  LogSettings new_settings;
+  new_settings.sink = sink;
+  files::ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.NewTempFile(&new_settings.log_file));
+  SetLogSettings(new_settings);
+
+  const int64_t before = NowNanoseconds();
+  const int line = __LINE__ + 1;
+  FTL_LOG(WARNING) << "to the sink " << 42;
+  FTL_SLOG(INFO).With("n", 1);
+  std::thread([] { FTL_LOG(ERROR) << "other"; }).join();
+  const int64_t after = NowNanoseconds();
+  FlushLog();
+
+  // Nothing goes to the file.
+  std::string log;
+  ASSERT_TRUE(files::ReadFileToString(new_settings.log_file, &log));
+  EXPECT_EQ(std::string(), log);
+
+  std::vector<RecordingSink::Record> records = sink->records();
+  ASSERT_EQ(3u, records.size());
+  EXPECT_EQ(3u, sink->batch_count());
+  EXPECT_EQ(1u, sink->flush_count());
+
+  EXPECT_EQ(LOG_WARNING, records[0].severity);
+  EXPECT_EQ(__FILE__, records[0].file);
+  EXPECT_EQ(line, records[0].line);
+  EXPECT_LE(before, records[0].timestamp_ns);
+  EXPECT_GE(after, records[0].timestamp_ns);
+  EXPECT_EQ("to the sink 42", records[0].message);
+  EXPECT_EQ(0u, records[0].formatted.find("[WARNING:"));
+  EXPECT_NE(std::string::npos,
+            records[0].formatted.find(")] to the sink 42\n"));
+
+  EXPECT_EQ(LOG_INFO, records[1].severity);
+  EXPECT_EQ(line + 1, records[1].line);
+  EXPECT_EQ(0u, records[1].message.find("severity=INFO file="));
+  EXPECT_EQ(records[1].message + "\n", records[1].formatted);
+  EXPECT_EQ(records[0].thread_id, records[1].thread_id);
+
+  EXPECT_EQ("other", records[2].message);
+  EXPECT_NE(records[0].thread_id, records[2].thread_id);
+}
+
+TEST_F(LogSettingsFixture, AsyncSink) {
+  constexpr int kThreads = 4;
+  constexpr int kMessages = 1000;
+
+  auto sink = std::make_shared<RecordingSink>();
+  LogSettings new_settings;
+  new_settings.async = true;
+  new_settings.sink = sink;
+  SetLogSettings(new_settings);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < kMessages; i++)
+        FTL_LOG(INFO) << t << " " << i;
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  // Changing the sink writes out what's buffered to the old one.
+  SetLogSettings(LogSettings());
+
+  // Every message is there, and in order for its thread, which each record
+  // carries the id of.
+  std::vector<RecordingSink::Record> records = sink->records();
+  ASSERT_EQ(static_cast<size_t>(kThreads * kMessages), records.size());
+  EXPECT_GT(records.size(), sink->batch_count());
+  int next[kThreads] = {};
+  uint64_t thread_ids[kThreads] = {};
+  for (const RecordingSink::Record& record : records) {
+    EXPECT_EQ(LOG_INFO, record.severity);
+    EXPECT_EQ(__FILE__, record.file);
+    std::istringstream fields(record.message);
+    int t = -1, i = -1;
+    fields >> t >> i;
+    ASSERT_TRUE(t >= 0 && t < kThreads) << record.message;
+    EXPECT_EQ(next[t]++, i);
+    if (!thread_ids[t])
+      thread_ids[t] = record.thread_id;
+    EXPECT_EQ(thread_ids[t], record.thread_id);
+  }
+}
+
 }  // namespace
 }  // namespace ftl
@@ -0,0 +1,64 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_LOG_SINK_H_
+#define LIB_FTL_LOG_SINK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/log_level.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// A message, as delivered to a |LogSink|. The views (and |file|) are only
+// valid during |LogSink::Write()|.
+struct LogRecord {
+  LogSeverity severity;
+  // As passed to the macro (so, __FILE__), or "" for messages the logging
+  // library writes itself.
+  const char* file;
+  int line;
+  // When the message was logged, in nanoseconds since the Unix epoch.
+  int64_t timestamp_ns;
+  // The logging thread's (kernel) id, where there is one; otherwise a number
+  // unique to the thread within the process.
+  uint64_t thread_id;
+  // The message itself, without the "[SEVERITY:file(line)] " prefix or the
+  // trailing newline. (For |FTL_SLOG()| messages, the logfmt or JSON.)
+  StringView message;
+  // The whole line, as it would have been written to stderr (with its
+  // newline).
+  StringView formatted;
+};
+
+// Where messages go instead of stderr (or |LogSettings::log_file|), when set
+// as |LogSettings::sink|: say, a socket to a log collector. Messages logged
+// with |LogSettings::async| arrive in batches, one |Write()| per drain of the
+// buffers, so that a sink can write them out with one system call.
+//
+// Calls are serialized (so a sink needn't lock), but may come from any
+// thread: the logging thread, the writer thread, or one calling |FlushLog()|.
+// Since a sink may be called while a thread is logging, it mustn't log (with
+// FTL_LOG() and such) itself.
+//
+// Binary log messages (see lib/ftl/binary_log.h) don't go to the sink.
+class FTL_EXPORT LogSink {
+ public:
+  virtual ~LogSink();
+
+  // Delivers |records[0]|, ..., |records[count - 1]| (with |count| > 0), in
+  // the order the messages were written out.
+  virtual void Write(const LogRecord* records, size_t count) = 0;
+
+  // Called by |FlushLog()| (so, also at exit), after everything buffered has
+  // been written.
+  virtual void Flush();
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_LOG_SINK_H_
@@ -2,13 +2,46 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "lib/ftl/build_config.h"
+#include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/debug/debugger.h"
+#include "lib/ftl/debug/stack_trace.h"
+#include "lib/ftl/flight_recorder.h"
 #include "lib/ftl/log_settings.h"
+#include "lib/ftl/log_sink.h"
 #include "lib/ftl/logging.h"
+#include "lib/ftl/memory/memory_stats.h"
+#include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/epoch.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/spsc_ring.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/synchronization/wait_on_address.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
 
 #if defined(OS_ANDROID)
 #include <android/log.h>
@@ -16,7 +49,23 @@
 #include <syslog.h>
 #endif
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/syscall.h>
+#elif defined(OS_MACOSX)
+#include <pthread.h>
+#endif
+
+#if defined(OS_LINUX) || defined(OS_MACOSX)
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+#define FTL_CAN_COMPRESS_LOG_FILES 1
+#endif
+
 namespace ftl {
+
 namespace {
 
 const char* const kLogSeverityNames[LOG_NUM_SEVERITIES] = {"INFO", "WARNING",
@@ -42,32 +91,1012 @@ const char* StripPath(const char* path) {
     return path;
 }
 
+// Log sinks ------------------------------------------------------------------
+
+// A message's metadata, as |LogRecord| has it.
+struct LogMessageHeader {
+  // The size of the message (which follows it, in an asynchronous buffer).
+  uint32_t size;
+  uint32_t prefix_size;
+  LogSeverity severity;
+  int line;
+  const char* file;
+  int64_t timestamp_ns;
+  uint64_t thread_id;
+};
+
+uint64_t GetCurrentThreadId() {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  thread_local uint64_t id = static_cast<uint64_t>(syscall(SYS_gettid));
+#elif defined(OS_MACOSX)
+  thread_local uint64_t id = [] {
+    uint64_t id = 0u;
+    pthread_threadid_np(nullptr, &id);
+    return id;
+  }();
+#else
+  static std::atomic<uint64_t> g_next_id(1u);
+  thread_local uint64_t id = g_next_id.fetch_add(1u);
+#endif
+  return id;
+}
+
+LogMessageHeader MakeLogMessageHeader(LogSeverity severity,
+                                      const char* file,
+                                      int line,
+                                      size_t size,
+                                      size_t prefix_size) {
+  LogMessageHeader header;
+  header.size = static_cast<uint32_t>(size);
+  header.prefix_size = static_cast<uint32_t>(prefix_size);
+  header.severity = severity;
+  header.line = line;
+  header.file = file ? file : "";
+  header.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+  header.thread_id = GetCurrentThreadId();
+  return header;
+}
+
+LogRecord MakeLogRecord(const LogMessageHeader& header, const char* data) {
+  LogRecord record;
+  record.severity = header.severity;
+  record.file = header.file;
+  record.line = header.line;
+  record.timestamp_ns = header.timestamp_ns;
+  record.thread_id = header.thread_id;
+  const size_t prefix_size = std::min(header.prefix_size, header.size);
+  size_t end = header.size;
+  if (end > prefix_size && data[end - 1u] == '\n')
+    end--;
+  record.message = StringView(data + prefix_size, end - prefix_size);
+  record.formatted = StringView(data, header.size);
+  return record;
+}
+
+// Serializes calls to sinks. Never destroyed, since messages may be logged
+// during exit.
+Mutex* GetSinkMutex() {
+  static Mutex* mutex = new Mutex();
+  return mutex;
+}
+
+void WriteToSink(LogSink* sink, const LogRecord* records, size_t count) {
+  MutexLocker locker(GetSinkMutex());
+  sink->Write(records, count);
+}
+
+std::shared_ptr<LogSink> GetCurrentSink() {
+  Epoch epoch;
+  return internal::GetCurrentLogSettings()->sink;
+}
+
+// Asynchronous logging -------------------------------------------------------
+//
+// Each logging thread has a record with a ring of bytes, which it alone pushes
+// to: each message's |LogMessageHeader|, then the message. The records are
+// never freed, but are reused by new threads (as for |Epoch|). Whoever holds
+// the drain mutex (the writer thread, or a thread in |FlushLog()|) pops from
+// all the rings, and writes out the complete messages, in one batch.
+
+constexpr size_t kAsyncBufferSize = 64u * 1024u;
+
+struct AsyncLogRecord {
+  SpscRing<char, kAsyncBufferSize> ring;
+  std::atomic<bool> in_use;
+  // Immutable once the record is published.
+  AsyncLogRecord* next;
+  // Popped bytes which don't make up a complete message yet. Guarded by the
+  // drain mutex.
+  std::string partial;
+};
+
+std::atomic<AsyncLogRecord*> g_async_records(nullptr);
+thread_local AsyncLogRecord* g_current_async_record = nullptr;
+
+// Registers the records' memory (the first time a record is made).
+void RegisterAsyncLogMemoryStats() {
+  // Leaked, like the records.
+  static MemoryStatsSource* source =
+      new MemoryStatsSource("ftl.log_buffers", [] {
+        uint64_t bytes = 0u;
+        for (AsyncLogRecord* record =
+                 g_async_records.load(std::memory_order_acquire);
+             record; record = record->next) {
+          bytes += sizeof(AsyncLogRecord);
+        }
+        return bytes;
+      });
+  FTL_ALLOW_UNUSED_LOCAL(source);
+}
+
+// Never destroyed, since the writer thread runs until the process exits.
+Mutex* GetDrainMutex() {
+  static Mutex* mutex = new Mutex();
+  return mutex;
+}
+
+// Whether the writer thread has been started (in this process: it's cleared in
+// the child of a fork(), which has to start its own). Guarded by the drain
+// mutex.
+bool g_writer_started = false;
+
+// Incremented to wake the writer, while |g_writer_sleeping|.
+std::atomic<uint32_t> g_writer_signal(0u);
+std::atomic<bool> g_writer_sleeping(false);
+
+std::atomic<uint64_t> g_dropped_count(0u);
+// Drops yet to be reported, with |LogOverflowPolicy::kCount|.
+std::atomic<uint64_t> g_unreported_drop_count(0u);
+
+// Log file -------------------------------------------------------------------
+//
+// Messages go to |LogSettings::log_file| through a descriptor of its own
+// (opened with O_APPEND), each batch of complete lines in one write(), or to
+// stderr without one. To rotate it, the writing thread only renames it out of
+// the way and reopens it; the rotator thread then renumbers the older files,
+// and compresses the rotated one.
+
+struct RotationJob {
+  // Where the writing thread renamed the file to.
+  std::string rotated_path;
+  std::string path;
+  int max_files;
+  bool compress;
+};
+
+struct LogFileState {
+  Mutex mutex;
+  int fd = -1;
+  std::string path;
+  uint64_t size = 0u;
+  TimePoint opened;
+  uint64_t max_size = 0u;
+  TimeDelta rotation_interval;
+  int max_files = 0;
+  bool compress = false;
+  uint64_t rotation_count = 0u;
+};
+
+// Never destroyed, since messages may be logged during exit.
+LogFileState* GetLogFileState() {
+  static LogFileState* state = new LogFileState();
+  return state;
+}
+
+struct RotatorState {
+  Mutex mutex;
+  // (Replaced in the child of a fork(), since the parent's threads may have
+  // been waiting on it.)
+  CondVar* idle = new CondVar();
+  std::deque<RotationJob> jobs;
+  // Whether a job has been popped, but isn't done yet.
+  bool busy = false;
+  bool started = false;
+};
+
+RotatorState* GetRotatorState() {
+  static RotatorState* state = new RotatorState();
+  return state;
+}
+
+int OpenLogFile(const std::string& path) {
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+}
+
+std::string GetRotatedLogFilePath(const std::string& path,
+                                  int number,
+                                  bool compressed) {
+  return path + "." + std::to_string(number) + (compressed ? ".gz" : "");
+}
+
+// Compresses |path| to |path|.gz (removing |path|), returning false if it
+// couldn't be.
+bool CompressLogFile(const std::string& path) {
+#if defined(FTL_CAN_COMPRESS_LOG_FILES)
+  const char* const argv[] = {"gzip", "-f", "-q", path.c_str(), nullptr};
+  pid_t pid;
+  if (posix_spawnp(&pid, "gzip", nullptr, nullptr, const_cast<char**>(argv),
+                   environ) != 0)
+    return false;
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR)
+      return false;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+  return false;
+#endif
+}
+
+void RunRotationJob(const RotationJob& job) {
+  if (job.max_files <= 0) {
+    unlink(job.rotated_path.c_str());
+    return;
+  }
+  // |path|.N (or |path|.N.gz) is replaced, and so removed.
+  for (int number = job.max_files - 1; number > 0; number--) {
+    for (bool compressed : {false, true}) {
+      rename(GetRotatedLogFilePath(job.path, number, compressed).c_str(),
+             GetRotatedLogFilePath(job.path, number + 1, compressed).c_str());
+    }
+  }
+  const std::string newest = GetRotatedLogFilePath(job.path, 1, false);
+  if (rename(job.rotated_path.c_str(), newest.c_str()) != 0)
+    return;
+  // The older compressed file would otherwise stay (as well).
+  unlink(GetRotatedLogFilePath(job.path, 1, true).c_str());
+  if (job.compress)
+    CompressLogFile(newest);
+}
+
+void RunRotator() {
+  RotatorState* state = GetRotatorState();
+  for (;;) {
+    RotationJob job;
+    {
+      MutexLocker locker(&state->mutex);
+      state->busy = false;
+      state->idle->SignalAll();
+      while (state->jobs.empty())
+        state->idle->Wait(&state->mutex);
+      job = std::move(state->jobs.front());
+      state->jobs.pop_front();
+      state->busy = true;
+    }
+    RunRotationJob(job);
+  }
+}
+
+void PostRotationJob(RotationJob job) {
+  RotatorState* state = GetRotatorState();
+  {
+    MutexLocker locker(&state->mutex);
+    if (!state->started) {
+      Thread* thread = new Thread(&RunRotator);
+      Thread::Options options;
+      options.name = "log-rotator";
+      state->started = thread->Run(options);
+      if (!state->started)
+        delete thread;
+    }
+    if (state->started) {
+      state->jobs.push_back(std::move(job));
+      // (The rotator waits on the same condition variable as |FlushLog()|.)
+      state->idle->SignalAll();
+      return;
+    }
+  }
+  RunRotationJob(job);
+}
+
+// Waits until the rotator has done the jobs posted so far.
+void WaitForRotations() {
+  RotatorState* state = GetRotatorState();
+  MutexLocker locker(&state->mutex);
+  while (!state->jobs.empty() || state->busy)
+    state->idle->Wait(&state->mutex);
+}
+
+// Rotates the log file, if writing |size| more bytes to it calls for it.
+void MaybeRotateLogFile(LogFileState* state, size_t size) {
+  const bool too_large = state->max_size && state->size &&
+                         state->size + size > state->max_size;
+  const bool too_old = state->rotation_interval > TimeDelta::Zero() &&
+                       state->size &&
+                       TimePoint::Now() - state->opened >=
+                           state->rotation_interval;
+  if (!too_large && !too_old)
+    return;
+
+  state->size = 0u;
+  state->opened = TimePoint::Now();
+  RotationJob job;
+  job.rotated_path = state->path + ".rotating-" + std::to_string(getpid()) +
+                     "-" + std::to_string(++state->rotation_count);
+  if (rename(state->path.c_str(), job.rotated_path.c_str()) != 0)
+    return;  // Keep writing to it, and try again later.
+  int fd = OpenLogFile(state->path);
+  if (fd >= 0) {
+    close(state->fd);
+    state->fd = fd;
+  }
+  job.path = state->path;
+  job.max_files = state->max_files;
+  job.compress = state->compress;
+  PostRotationJob(std::move(job));
+}
+
+// Writes |data| to the log file, or returns false if there's none.
+bool WriteToLogFile(const char* data, size_t size) {
+  LogFileState* state = GetLogFileState();
+  MutexLocker locker(&state->mutex);
+  if (state->fd < 0)
+    return false;
+  MaybeRotateLogFile(state, size);
+  while (size) {
+    ssize_t written = write(state->fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+    state->size += static_cast<uint64_t>(written);
+  }
+  return true;
+}
+
+// Pops everything buffered, and writes out the complete messages (to the sink,
+// or as one write of lines). Returns whether there were any. The caller must
+// hold the drain mutex.
+bool DrainAsyncRecords() {
+  const std::shared_ptr<LogSink> sink = GetCurrentSink();
+  std::vector<LogRecord> records;
+  std::string output;
+  char chunk[4096];
+  AsyncLogRecord* const first =
+      g_async_records.load(std::memory_order_acquire);
+  // How much of each record's |partial| was written out.
+  std::vector<size_t> consumed;
+  for (AsyncLogRecord* record = first; record; record = record->next) {
+    while (size_t size = record->ring.PopBatch(chunk, sizeof(chunk)))
+      record->partial.append(chunk, size);
+    const std::string& partial = record->partial;
+    size_t position = 0u;
+    LogMessageHeader header;
+    while (partial.size() - position >= sizeof(header)) {
+      memcpy(&header, partial.data() + position, sizeof(header));
+      if (partial.size() - position - sizeof(header) < header.size)
+        break;
+      const char* data = partial.data() + position + sizeof(header);
+      if (sink)
+        records.push_back(MakeLogRecord(header, data));
+      else
+        output.append(data, header.size);
+      position += sizeof(header) + header.size;
+    }
+    consumed.push_back(position);
+  }
+
+  std::string dropped_message;
+  if (uint64_t dropped = g_unreported_drop_count.exchange(0u)) {
+    static const char kPrefix[] = "[WARNING] ";
+    dropped_message = kPrefix + ("Dropped " + std::to_string(dropped) +
+                                 " log messages: the buffer was full.\n");
+    const LogMessageHeader header =
+        MakeLogMessageHeader(LOG_WARNING, nullptr, 0, dropped_message.size(),
+                             sizeof(kPrefix) - 1u);
+    if (sink)
+      records.push_back(MakeLogRecord(header, dropped_message.data()));
+    else
+      output += dropped_message;
+  }
+
+  const bool wrote = sink ? !records.empty() : !output.empty();
+  if (sink && wrote)
+    WriteToSink(sink.get(), records.data(), records.size());
+  else if (wrote)
+    internal::WriteLogOutput(output.data(), output.size());
+
+  // (The records refer to the buffers until now.)
+  size_t index = 0u;
+  for (AsyncLogRecord* record = first; record; record = record->next)
+    record->partial.erase(0u, consumed[index++]);
+  return wrote;
+}
+
+void WakeWriter(bool force) {
+  // Pairs with the fence in |RunWriter()|: either it sees the pushed bytes, or
+  // this sees it sleeping.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (force || g_writer_sleeping.load(std::memory_order_relaxed)) {
+    g_writer_signal.fetch_add(1u, std::memory_order_release);
+    internal::WakeByAddressSingle(&g_writer_signal);
+  }
+}
+
+void RunWriter() {
+  for (;;) {
+    uint32_t signal = g_writer_signal.load(std::memory_order_acquire);
+    {
+      MutexLocker locker(GetDrainMutex());
+      if (DrainAsyncRecords())
+        continue;
+    }
+    g_writer_sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool drained;
+    {
+      MutexLocker locker(GetDrainMutex());
+      drained = DrainAsyncRecords();
+    }
+    // The timeout is only a backstop.
+    if (!drained) {
+      internal::WaitOnAddress(
+          &g_writer_signal, signal,
+          TimePoint::Now() + TimeDelta::FromMilliseconds(100));
+    }
+    g_writer_sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+// In the child of a fork(), which has only the fork()ing thread: the messages
+// buffered so far, and the rotations posted so far, are the parent's to do,
+// and the writer and rotator threads have to be restarted (by the next message
+// and rotation: the thread's next message takes a record, since its old one
+// is released).
+void OnForkInChild() FTL_NO_THREAD_SAFETY_ANALYSIS {
+  char chunk[4096];
+  for (AsyncLogRecord* record = g_async_records.load(std::memory_order_acquire);
+       record; record = record->next) {
+    while (record->ring.PopBatch(chunk, sizeof(chunk))) {
+    }
+    record->partial.clear();
+    record->in_use.store(false, std::memory_order_relaxed);
+  }
+  g_current_async_record = nullptr;
+  g_unreported_drop_count.store(0u, std::memory_order_relaxed);
+  g_writer_started = false;
+  g_writer_sleeping.store(false, std::memory_order_relaxed);
+
+  RotatorState* rotator = GetRotatorState();
+  rotator->jobs.clear();
+  rotator->busy = false;
+  rotator->started = false;
+  // (The old one is leaked: it may not be destroyed while it has waiters.)
+  rotator->idle = new CondVar();
+
+  rotator->mutex.UnlockAfterFork();
+  GetLogFileState()->mutex.UnlockAfterFork();
+  GetSinkMutex()->UnlockAfterFork();
+  GetDrainMutex()->UnlockAfterFork();
+}
+
+// Registers (once, before the writer or rotator thread is started) handlers
+// which hold the locks those threads take across fork()s, and reset their
+// state in the child. This mustn't be called with any of those locks held.
+void RegisterForkHandlers() {
+  static ForkHandlers* fork_handlers = new ForkHandlers(
+      []() FTL_NO_THREAD_SAFETY_ANALYSIS {
+        GetDrainMutex()->Lock();
+        GetSinkMutex()->Lock();
+        GetLogFileState()->mutex.Lock();
+        GetRotatorState()->mutex.Lock();
+      },
+      []() FTL_NO_THREAD_SAFETY_ANALYSIS {
+        GetRotatorState()->mutex.Unlock();
+        GetLogFileState()->mutex.Unlock();
+        GetSinkMutex()->Unlock();
+        GetDrainMutex()->Unlock();
+      },
+      &OnForkInChild);
+  FTL_ALLOW_UNUSED_LOCAL(fork_handlers);
+}
+
+// Starts the writer thread (if it isn't running in this process), returning
+// false if it couldn't be.
+bool StartWriter() {
+  RegisterForkHandlers();
+  MutexLocker locker(GetDrainMutex());
+  if (g_writer_started)
+    return true;
+  Thread* thread = new Thread(&RunWriter);
+  Thread::Options options;
+  options.name = "log-writer";
+  if (!thread->Run(options)) {
+    delete thread;
+    return false;
+  }
+  static const bool registered = atexit(&FlushLog) == 0;
+  FTL_ALLOW_UNUSED_LOCAL(registered);
+  g_writer_started = true;
+  return true;
+}
+
+// Releases the current thread's record when it exits. (Whatever it still
+// holds is written out as usual.)
+class AsyncLogRecordReleaser final {
+ public:
+  AsyncLogRecordReleaser() {}
+
+  ~AsyncLogRecordReleaser() {
+    // (It may have none, after a fork().)
+    if (g_current_async_record)
+      g_current_async_record->in_use.store(false, std::memory_order_release);
+    g_current_async_record = nullptr;
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(AsyncLogRecordReleaser);
+};
+
+// Returns the current thread's record, or null if there's no writer thread.
+AsyncLogRecord* CurrentAsyncRecord() {
+  if (g_current_async_record)
+    return g_current_async_record;
+  // (In case the process has forked since the writer started.)
+  if (!StartWriter())
+    return nullptr;
+  AsyncLogRecord* record = g_async_records.load(std::memory_order_acquire);
+  for (; record; record = record->next) {
+    bool in_use = false;
+    if (!record->in_use.load(std::memory_order_relaxed) &&
+        record->in_use.compare_exchange_strong(in_use, true,
+                                               std::memory_order_acquire)) {
+      break;
+    }
+  }
+  if (!record) {
+    RegisterAsyncLogMemoryStats();
+    record = new AsyncLogRecord();
+    record->in_use.store(true, std::memory_order_relaxed);
+    record->next = g_async_records.load(std::memory_order_relaxed);
+    while (!g_async_records.compare_exchange_weak(record->next, record,
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
+    }
+  }
+  static thread_local AsyncLogRecordReleaser releaser;
+  g_current_async_record = record;
+  return record;
+}
+
+// Pushes all |size| bytes of |data|, waiting for the writer thread to make
+// room as needed.
+void PushAsyncBlocking(AsyncLogRecord* record, char* data, size_t size) {
+  size_t pushed = record->ring.PushBatch(data, size);
+  while (pushed < size) {
+    WakeWriter(true);
+    SleepFor(TimeDelta::FromMicroseconds(100));
+    pushed += record->ring.PushBatch(data + pushed, size - pushed);
+  }
+}
+
+// Buffers |header| and the message (which ends with a newline) for the writer
+// thread, or returns false if there's none.
+bool WriteAsync(LogMessageHeader header,
+                char* message,
+                LogOverflowPolicy policy) {
+  AsyncLogRecord* record = CurrentAsyncRecord();
+  if (!record)
+    return false;
+  char* header_data = reinterpret_cast<char*>(&header);
+  const size_t size = sizeof(header) + header.size;
+  if (policy != LogOverflowPolicy::kBlock && size <= kAsyncBufferSize) {
+    if (!record->ring.HasRoomFor(size)) {
+      g_dropped_count.fetch_add(1u, std::memory_order_relaxed);
+      if (policy == LogOverflowPolicy::kCount)
+        g_unreported_drop_count.fetch_add(1u, std::memory_order_relaxed);
+      return true;
+    }
+    record->ring.PushBatch(header_data, sizeof(header));
+    record->ring.PushBatch(message, header.size);
+    WakeWriter(false);
+    return true;
+  }
+
+  PushAsyncBlocking(record, header_data, sizeof(header));
+  PushAsyncBlocking(record, message, header.size);
+  WakeWriter(false);
+  return true;
+}
+
+}  // namespace
+
+namespace internal {
+
+// The stream a |LogMessage| formats into: an |std::ostream| writing to an
+// inline buffer, which moves to the heap if the message outgrows it. Each
+// thread reuses one (unless messages nest, e.g., when formatting a value logs
+// something), so that a message doesn't construct a stream (with its locale)
+// and allocate a buffer every time.
+class LogStream final : private std::streambuf, public std::ostream {
+ public:
+  explicit LogStream(bool heap_allocated)
+      : std::ostream(this), heap_allocated_(heap_allocated) {
+    Reset();
+  }
+  ~LogStream() override {}
+
+  bool heap_allocated() const { return heap_allocated_; }
+
+  // Empties the buffer, and restores the stream's default state (in case the
+  // last message changed it, e.g., with |std::hex|).
+  void Reset() {
+    setp(inline_buffer_, inline_buffer_ + sizeof(inline_buffer_));
+    if (heap_buffer_.capacity() > kMaxKeptCapacity)
+      std::string().swap(heap_buffer_);
+    clear();
+    flags(std::ios_base::skipws | std::ios_base::dec);
+    width(0);
+    precision(6);
+    fill(' ');
+  }
+
+  char* data() const { return pbase(); }
+  size_t size() const { return static_cast<size_t>(pptr() - pbase()); }
+
+  // Whether a |LogMessage| is using the thread's stream.
+  bool in_use = false;
+
+ private:
+  static constexpr size_t kInlineSize = 512u;
+  // A thread keeps a bigger heap buffer than this only until its next message.
+  static constexpr size_t kMaxKeptCapacity = 64u * 1024u;
+
+  using Traits = std::char_traits<char>;
+
+  Traits::int_type overflow(Traits::int_type c) override {
+    size_t size = this->size();
+    if (pbase() == inline_buffer_) {
+      heap_buffer_.resize(std::max(heap_buffer_.capacity(), 2u * kInlineSize));
+      memcpy(&heap_buffer_[0], inline_buffer_, size);
+    } else {
+      heap_buffer_.resize(2u * heap_buffer_.size());
+    }
+    setp(&heap_buffer_[0], &heap_buffer_[0] + heap_buffer_.size());
+    pbump(static_cast<int>(size));
+    if (!Traits::eq_int_type(c, Traits::eof())) {
+      *pptr() = Traits::to_char_type(c);
+      pbump(1);
+    }
+    return Traits::not_eof(c);
+  }
+
+  const bool heap_allocated_;
+  char inline_buffer_[kInlineSize];
+  std::string heap_buffer_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LogStream);
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::LogStream;
+
+thread_local LogStream* g_log_stream = nullptr;
+// Set once the thread's stream is destroyed, as it exits.
+thread_local bool g_log_stream_released = false;
+
+class LogStreamReleaser final {
+ public:
+  LogStreamReleaser() {}
+
+  ~LogStreamReleaser() {
+    delete g_log_stream;
+    g_log_stream = nullptr;
+    g_log_stream_released = true;
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(LogStreamReleaser);
+};
+
+LogStream* AcquireLogStream() {
+  LogStream* stream = g_log_stream;
+  if (!stream && !g_log_stream_released) {
+    stream = g_log_stream = new LogStream(false);
+    static thread_local LogStreamReleaser releaser;
+  }
+  if (!stream || stream->in_use)
+    return new LogStream(true);
+  stream->Reset();
+  stream->in_use = true;
+  return stream;
+}
+
+void ReleaseLogStream(LogStream* stream) {
+  if (stream->heap_allocated())
+    delete stream;
+  else
+    stream->in_use = false;
+}
+
+// Per-file verbosity -------------------------------------------------------
+
+struct VmoduleEntry {
+  std::string pattern;
+  int verbosity;
+};
+
+// Parses a non-negative decimal verbosity.
+bool ParseVerbosity(const char* level, int* verbosity) {
+  if (!*level)
+    return false;
+  int64_t value = 0;
+  for (; *level; level++) {
+    if (*level < '0' || *level > '9')
+      return false;
+    value = value * 10 + (*level - '0');
+    if (value >= INT_MAX)
+      return false;
+  }
+  *verbosity = static_cast<int>(value);
+  return true;
+}
+
+// Parses |vmodule|, skipping malformed entries (and returning false if there
+// are any).
+bool ParseVmodule(const std::string& vmodule,
+                  std::vector<VmoduleEntry>* entries) {
+  if (vmodule.empty())
+    return true;
+  bool valid = true;
+  size_t start = 0u;
+  for (;;) {
+    const size_t end = std::min(vmodule.find(',', start), vmodule.size());
+    const std::string entry = vmodule.substr(start, end - start);
+    const size_t equals = entry.rfind('=');
+    int verbosity = 0;
+    if (equals != std::string::npos && equals > 0u &&
+        ParseVerbosity(entry.c_str() + equals + 1u, &verbosity)) {
+      entries->push_back(VmoduleEntry{entry.substr(0u, equals), verbosity});
+    } else {
+      valid = false;
+    }
+    if (end == vmodule.size())
+      break;
+    start = end + 1u;
+  }
+  return valid;
+}
+
+// Matches |pattern| against all of |text|, where '*' matches any characters,
+// and '?' any one.
+bool MatchPattern(const char* pattern, const char* text, const char* text_end) {
+  // Where to resume after the last '*', if what follows it doesn't match.
+  const char* star = nullptr;
+  const char* star_text = nullptr;
+  while (text < text_end) {
+    if (*pattern == '*') {
+      star = ++pattern;
+      star_text = text;
+    } else if (*pattern && (*pattern == '?' || *pattern == *text)) {
+      pattern++;
+      text++;
+    } else if (star) {
+      pattern = star;
+      text = ++star_text;
+    } else {
+      return false;
+    }
+  }
+  while (*pattern == '*')
+    pattern++;
+  return !*pattern;
+}
+
+struct VlogState {
+  Mutex mutex;
+  std::vector<VmoduleEntry> entries;
+  internal::VlogSite* sites = nullptr;
+};
+
+// Never destroyed, since sites may be checked during exit.
+VlogState* GetVlogState() {
+  static VlogState* state = new VlogState();
+  return state;
+}
+
+// Returns the first of |entries| matching |file|, or null.
+const VmoduleEntry* FindVmoduleEntry(const std::vector<VmoduleEntry>& entries,
+                                     const char* file) {
+  const char* path = StripDots(file);
+  const char* name = StripPath(path);
+  const char* extension = strrchr(name, '.');
+  const char* end = extension ? extension : name + strlen(name);
+  for (const VmoduleEntry& entry : entries) {
+    const bool has_slash = entry.pattern.find('/') != std::string::npos;
+    if (MatchPattern(entry.pattern.c_str(), has_slash ? path : name, end))
+      return &entry;
+  }
+  return nullptr;
+}
+
+int GetVerbosityForFile(const std::vector<VmoduleEntry>& entries,
+                        const char* file) {
+  const VmoduleEntry* entry = FindVmoduleEntry(entries, file);
+  return entry ? entry->verbosity : GetVlogVerbosity();
+}
+
+// Whether |LogSettings::vmodule| turns on FTL_VLOG(|verbose_level|) in |file|.
+bool IsOnByVmodule(const char* file, int verbose_level) {
+  VlogState* state = GetVlogState();
+  MutexLocker locker(&state->mutex);
+  const VmoduleEntry* entry = FindVmoduleEntry(state->entries, file);
+  return entry && verbose_level <= entry->verbosity;
+}
+
+// How much of the stack FATAL messages show.
+constexpr size_t kMaxFatalStackFrames = 64u;
+
+// Message prefixes -----------------------------------------------------------
+
+constexpr uint32_t kThreadIdField = 1u << 0;
+constexpr uint32_t kTimestampField = 1u << 1;
+
+// Which optional fields prefixes have, as set by |SetLogPrefixFields()|.
+std::atomic<uint32_t> g_log_prefix_fields(0u);
+
+// Formats |value| in decimal at |buffer| (which must have room for 20 digits),
+// and returns how many digits it took.
+size_t FormatDecimal(uint64_t value, char* buffer) {
+  char digits[20];
+  size_t size = 0u;
+  do {
+    digits[sizeof(digits) - ++size] = static_cast<char>('0' + value % 10u);
+    value /= 10u;
+  } while (value);
+  memcpy(buffer, digits + sizeof(digits) - size, size);
+  return size;
+}
+
+// The local time, as MMDD/HHMMSS.uuuuuu.
+constexpr size_t kTimestampSize = 18u;
+
+void FormatTimestamp(char* buffer) {
+  // The thread's last formatted "MMDD/HHMMSS.", and its second.
+  struct DateCache {
+    int64_t second;
+    char date[kTimestampSize - 6u];
+  };
+  thread_local DateCache cache = {INT64_MIN, {}};
+
+  const int64_t micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  int64_t second = micros / 1000000;
+  int64_t fraction = micros % 1000000;
+  if (fraction < 0) {
+    second--;
+    fraction += 1000000;
+  }
+  if (second != cache.second) {
+    const time_t time = static_cast<time_t>(second);
+    struct tm local;
+    localtime_r(&time, &local);
+    char date[64];
+    snprintf(date, sizeof(date), "%02d%02d/%02d%02d%02d.", local.tm_mon + 1,
+             local.tm_mday, local.tm_hour, local.tm_min, local.tm_sec);
+    memcpy(cache.date, date, sizeof(cache.date));
+    cache.second = second;
+  }
+  memcpy(buffer, cache.date, sizeof(cache.date));
+  for (size_t i = kTimestampSize; i > kTimestampSize - 6u; i--) {
+    buffer[i - 1u] = static_cast<char>('0' + fraction % 10);
+    fraction /= 10;
+  }
+}
+
 }  // namespace
 
 LogMessage::LogMessage(LogSeverity severity,
                        const char* file,
                        int line,
                        const char* condition)
-    : severity_(severity), file_(file), line_(line) {
-  stream_ << "[";
+    : LogMessage(severity, internal::LogFile(file), line, condition) {}
+
+LogMessage::LogMessage(LogSeverity severity,
+                       const internal::LogFile& file,
+                       int line,
+                       const char* condition)
+    : stream_(AcquireLogStream()),
+      severity_(severity),
+      file_(file.file()),
+      line_(line) {
+  // "[" and the optional fields: "<thread id>:<timestamp>:".
+  char start[1u + 20u + 1u + kTimestampSize + 1u];
+  size_t start_size = 0u;
+  start[start_size++] = '[';
+  const uint32_t fields = g_log_prefix_fields.load(std::memory_order_relaxed);
+  if (fields & kThreadIdField) {
+    start_size += FormatDecimal(GetCurrentThreadId(), start + start_size);
+    start[start_size++] = ':';
+  }
+  if (fields & kTimestampField) {
+    FormatTimestamp(start + start_size);
+    start_size += kTimestampSize;
+    start[start_size++] = ':';
+  }
+  stream_->write(start, static_cast<std::streamsize>(start_size));
   if (severity >= LOG_INFO)
-    stream_ << GetNameForLogSeverity(severity);
+    *stream_ << GetNameForLogSeverity(severity);
   else
-    stream_ << "VERBOSE" << -severity;
-  stream_ << ":" << (severity > LOG_INFO ? StripDots(file_) : StripPath(file_))
-          << "(" << line_ << ")] ";
+    *stream_ << "VERBOSE" << -severity;
+  size_t file_size;
+  const char* file_part = file.ForSeverity(severity, &file_size);
+  stream_->put(':');
+  stream_->write(file_part, static_cast<std::streamsize>(file_size));
+  *stream_ << "(" << line_ << ")] ";
+  prefix_size_ = static_cast<LogStream*>(stream_)->size();
 
   if (condition)
-    stream_ << "Check failed: " << condition << ". ";
+    *stream_ << "Check failed: " << condition << ". ";
 }
 
 LogMessage::~LogMessage() {
-  stream_ << std::endl;
+  LogStream* stream = static_cast<LogStream*>(stream_);
+  if (severity_ >= LOG_FATAL) {
+    // (From this destructor's caller on.)
+    const void* frames[kMaxFatalStackFrames];
+    const size_t count = CaptureStackTrace(frames, kMaxFatalStackFrames);
+    *stream << "\nStack trace:\n" << StackTraceToString(frames, count);
+  } else {
+    *stream << '\n';
+  }
 
+  internal::WriteLogMessage(severity_, file_, line_, stream->data(),
+                            stream->size(), prefix_size_);
+
+  ReleaseLogStream(stream);
+  if (severity_ >= LOG_FATAL)
+    BreakDebugger();
+}
+
+void FlushLog() {
+  {
+    MutexLocker locker(GetDrainMutex());
+    DrainAsyncRecords();
+  }
+  if (std::shared_ptr<LogSink> sink = GetCurrentSink()) {
+    MutexLocker locker(GetSinkMutex());
+    sink->Flush();
+  }
+  WaitForRotations();
+}
+
+uint64_t GetDroppedLogMessageCount() {
+  return g_dropped_count.load(std::memory_order_relaxed);
+}
+
+int GetVlogVerbosity() {
+  return std::max(-1, LOG_INFO - GetMinLogLevel());
+}
+
+bool ShouldCreateLogMessage(LogSeverity severity) {
+  return severity >= state::g_min_log_level.load(std::memory_order_relaxed);
+}
+
+bool IsValidVmodule(const std::string& vmodule) {
+  std::vector<VmoduleEntry> entries;
+  return ParseVmodule(vmodule, &entries);
+}
+
+namespace internal {
+
+CheckFailedMessage::CheckFailedMessage(const LogFile& file,
+                                       int line,
+                                       const char* condition)
+    : message_(LOG_FATAL, file, line, condition) {}
+
+CheckFailedMessage::~CheckFailedMessage() {
+  message_.~LogMessage();
+  // (Not reached.)
+  abort();
+}
+
+void WriteLogOutput(const char* data, size_t size) {
+  if (WriteToLogFile(data, size))
+    return;
+  std::cerr.write(data, static_cast<std::streamsize>(size));
+  std::cerr.flush();
+}
+
+namespace {
+
+// Writes to the system log (or, elsewhere, as |WriteLogOutput()|).
+void WritePlatformLog(LogSeverity severity, const char* data, size_t size) {
 #if defined(OS_ANDROID)
   android_LogPriority priority =
-      (severity_ < 0) ? ANDROID_LOG_VERBOSE : ANDROID_LOG_UNKNOWN;
-  switch (severity_) {
+      (severity < 0) ? ANDROID_LOG_VERBOSE : ANDROID_LOG_UNKNOWN;
+  switch (severity) {
     case LOG_INFO:
       priority = ANDROID_LOG_INFO;
       break;
@@ -81,24 +1110,167 @@ LogMessage::~LogMessage() {
       priority = ANDROID_LOG_FATAL;
       break;
   }
-  __android_log_write(priority, ANDROID_LOG_TAG, stream_.str().c_str());
+  __android_log_write(priority, ANDROID_LOG_TAG,
+                      std::string(data, size).c_str());
 #elif defined(OS_IOS)
-  syslog(LOG_ALERT, "%s", stream_.str().c_str());
+  syslog(LOG_ALERT, "%.*s", static_cast<int>(size), data);
 #else
-  std::cerr << stream_.str();
-  std::cerr.flush();
+  WriteLogOutput(data, size);
 #endif
+}
 
-  if (severity_ >= LOG_FATAL)
-    BreakDebugger();
+}  // namespace
+
+void WriteLogMessage(LogSeverity severity,
+                     const char* file,
+                     int line,
+                     char* data,
+                     size_t size,
+                     size_t prefix_size) {
+  bool async;
+  LogOverflowPolicy overflow_policy;
+  std::shared_ptr<LogSink> sink;
+  {
+    Epoch epoch;
+    const LogSettings* settings = GetCurrentLogSettings();
+    if (FlightRecorder* recorder = settings->flight_recorder.get()) {
+      if (severity >= settings->flight_recorder_min_level)
+        recorder->Append(StringView(data, size));
+      // Messages below |min_log_level| are only on for the recorder (unless
+      // |vmodule| turned them on).
+      if (severity < settings->min_log_level &&
+          (severity >= 0 || settings->vmodule.empty() || !file ||
+           !IsOnByVmodule(file, -severity)))
+        return;
+    }
+    async = settings->async;
+    overflow_policy = settings->overflow_policy;
+    if (settings->sink)
+      sink = settings->sink;
+  }
+#if defined(OS_ANDROID) || defined(OS_IOS)
+  // (The system log is written to directly.)
+  if (!sink)
+    async = false;
+#endif
+  if (!async && !sink) {
+    WritePlatformLog(severity, data, size);
+    return;
+  }
+
+  const LogMessageHeader header =
+      MakeLogMessageHeader(severity, file, line, size, prefix_size);
+  if (async && severity < LOG_FATAL &&
+      WriteAsync(header, data, overflow_policy))
+    return;
+  if (async) {
+    // (Without waiting for rotated log files to be compressed.)
+    MutexLocker locker(GetDrainMutex());
+    DrainAsyncRecords();
+  }
+  if (sink) {
+    const LogRecord record = MakeLogRecord(header, data);
+    WriteToSink(sink.get(), &record, 1u);
+  } else {
+    WritePlatformLog(severity, data, size);
+  }
 }
 
-int GetVlogVerbosity() {
-  return std::max(-1, LOG_INFO - GetMinLogLevel());
+void SetLogPrefixFields(const LogSettings& settings) {
+  g_log_prefix_fields.store(
+      (settings.log_thread_ids ? kThreadIdField : 0u) |
+          (settings.log_timestamps ? kTimestampField : 0u),
+      std::memory_order_relaxed);
 }
 
-bool ShouldCreateLogMessage(LogSeverity severity) {
-  return severity >= GetMinLogLevel();
+int SetLogFile(const LogSettings& settings) {
+  // (Before the log file's lock, which they hold across fork()s.)
+  RegisterForkHandlers();
+  LogFileState* state = GetLogFileState();
+  MutexLocker locker(&state->mutex);
+  state->max_size = settings.max_log_file_size;
+  state->rotation_interval = settings.log_file_rotation_interval;
+  state->max_files = settings.max_rotated_log_files;
+  state->compress = settings.compress_rotated_log_files;
+  if (settings.log_file == state->path)
+    return 0;
+
+  int fd = -1;
+  uint64_t size = 0u;
+  if (!settings.log_file.empty()) {
+    fd = OpenLogFile(settings.log_file);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      const int error = errno;
+      if (fd >= 0)
+        close(fd);
+      return error;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+  }
+  if (state->fd >= 0)
+    close(state->fd);
+  state->fd = fd;
+  state->path = settings.log_file;
+  state->size = size;
+  state->opened = TimePoint::Now();
+  return 0;
 }
 
+bool LogSiteTimer::EveryT(TimeDelta interval) {
+  const int64_t now = TimePoint::Now().ToEpochDelta().ToNanoseconds();
+  int64_t next = next_.load(std::memory_order_relaxed);
+  return now >= next &&
+         next_.compare_exchange_strong(next, now + interval.ToNanoseconds(),
+                                       std::memory_order_relaxed);
+}
+
+bool ShouldSampleLog(uint32_t n) {
+  // xorshift64*, seeded from the clock and the thread (by its state's
+  // address).
+  thread_local uint64_t state = 0u;
+  if (!state) {
+    const int64_t now = TimePoint::Now().ToEpochDelta().ToNanoseconds();
+    state = (static_cast<uint64_t>(now) ^ reinterpret_cast<uintptr_t>(&state)) |
+            1u;
+  }
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return (state * UINT64_C(2685821657736338717)) % n == 0u;
+}
+
+void VlogSite::UpdateAll() {
+  VlogState* state = GetVlogState();
+  MutexLocker locker(&state->mutex);
+  state->entries.clear();
+  {
+    Epoch epoch;
+    ParseVmodule(GetCurrentLogSettings()->vmodule, &state->entries);
+  }
+  for (VlogSite* site = state->sites; site; site = site->next_) {
+    site->verbosity_.store(GetVerbosityForFile(state->entries, site->file_),
+                           std::memory_order_relaxed);
+  }
+}
+
+int VlogSite::Register() {
+  VlogState* state = GetVlogState();
+  MutexLocker locker(&state->mutex);
+  int verbosity = verbosity_.load(std::memory_order_relaxed);
+  if (verbosity == kUninitialized) {
+    verbosity = GetVerbosityForFile(state->entries, file_);
+    next_ = state->sites;
+    state->sites = this;
+    verbosity_.store(verbosity, std::memory_order_relaxed);
+  }
+  return verbosity;
+}
+
+}  // namespace internal
+
+LogSink::~LogSink() {}
+
+void LogSink::Flush() {}
+
 }  // namespace ftl
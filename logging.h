@@ -5,14 +5,89 @@
 #ifndef LIB_FTL_LOGGING_H_
 #define LIB_FTL_LOGGING_H_
 
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
 #include <sstream>
+#include <type_traits>
 
+#include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/log_level.h"
+#include "lib/ftl/log_settings.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace ftl {
 
+namespace internal {
+
+// The size of |file|, the offset of its path without leading "../"s, and the
+// offset of its base name (after its last '/').
+constexpr size_t LogFileSize(const char* file) {
+  size_t size = 0u;
+  while (file[size])
+    size++;
+  return size;
+}
+
+constexpr size_t LogFilePathOffset(const char* file) {
+  size_t offset = 0u;
+  while (file[offset] == '.' && file[offset + 1u] == '.' &&
+         file[offset + 2u] == '/')
+    offset += 3u;
+  return offset;
+}
+
+constexpr size_t LogFileNameOffset(const char* file) {
+  size_t offset = 0u;
+  for (size_t i = 0u; file[i]; i++) {
+    if (file[i] == '/')
+      offset = i + 1u;
+  }
+  return offset;
+}
+
+// A log statement's source file (|__FILE__|), and the parts of it which
+// message prefixes show: its path (without leading "../"s) for warnings and
+// above, or else its base name. |FTL_LOG_FILE| finds those at compile time.
+class LogFile final {
+ public:
+  // Finds the parts at run time.
+  explicit LogFile(const char* file)
+      : LogFile(file,
+                LogFileSize(file),
+                LogFilePathOffset(file),
+                LogFileNameOffset(file)) {}
+  constexpr LogFile(const char* file,
+                    size_t size,
+                    size_t path_offset,
+                    size_t name_offset)
+      : file_(file),
+        size_(size),
+        path_offset_(path_offset),
+        name_offset_(name_offset) {}
+
+  const char* file() const { return file_; }
+
+  // The part shown for |severity|, which is |*size| bytes long.
+  const char* ForSeverity(LogSeverity severity, size_t* size) const {
+    const size_t offset = severity > LOG_INFO ? path_offset_ : name_offset_;
+    *size = size_ - offset;
+    return file_ + offset;
+  }
+
+ private:
+  const char* file_;
+  size_t size_;
+  size_t path_offset_;
+  size_t name_offset_;
+};
+
+}  // namespace internal
+
 class LogMessageVoidify {
  public:
   void operator&(std::ostream&) {}
@@ -24,19 +99,35 @@ class FTL_EXPORT LogMessage {
              const char* file,
              int line,
              const char* condition);
+  // (As the macros construct it, with |FTL_LOG_FILE|.)
+  LogMessage(LogSeverity severity,
+             const internal::LogFile& file,
+             int line,
+             const char* condition);
   ~LogMessage();
 
-  std::ostream& stream() { return stream_; }
+  std::ostream& stream() { return *stream_; }
 
  private:
-  std::ostringstream stream_;
+  // An |internal::LogStream|, usually the thread's (reused) one.
+  std::ostream* const stream_;
   const LogSeverity severity_;
   const char* file_;
   const int line_;
+  // The size of the "[SEVERITY:file(line)] " prefix.
+  size_t prefix_size_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(LogMessage);
 };
 
+// Writes out the messages logged asynchronously (see |LogSettings::async|) so
+// far, and waits for rotated log files to be renumbered and compressed.
+FTL_EXPORT void FlushLog();
+
+// The number of messages dropped because an asynchronous log buffer was full
+// (see |LogOverflowPolicy|).
+FTL_EXPORT uint64_t GetDroppedLogMessageCount();
+
 // Gets the FTL_VLOG default verbosity level.
 FTL_EXPORT int GetVlogVerbosity();
 
@@ -44,10 +135,147 @@ FTL_EXPORT int GetVlogVerbosity();
 // LOG_FATAL and above is always true.
 FTL_EXPORT bool ShouldCreateLogMessage(LogSeverity severity);
 
+namespace internal {
+
+// The message of a failed |FTL_CHECK()|, a |LOG_FATAL| one (so destroying it
+// aborts). Its constructor and destructor are out of line and cold, so that
+// a check costs its call site only the test and a (not taken) branch to them.
+class FTL_EXPORT CheckFailedMessage final {
+ public:
+  FTL_COLD FTL_NOINLINE CheckFailedMessage(const LogFile& file,
+                                           int line,
+                                           const char* condition);
+  [[noreturn]] FTL_COLD ~CheckFailedMessage();
+
+  std::ostream& stream() { return message_.stream(); }
+
+ private:
+  // (In a union, so that the destructor can destroy it before not returning.)
+  union {
+    LogMessage message_;
+  };
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CheckFailedMessage);
+};
+
+// Writes complete lines to where the log goes (|LogSettings::log_file|, or
+// stderr).
+FTL_EXPORT void WriteLogOutput(const char* data, size_t size);
+
+// The current settings, which may only be used until the end of the caller's
+// |Epoch| (see lib/ftl/synchronization/epoch.h).
+FTL_EXPORT const LogSettings* GetCurrentLogSettings();
+
+// Sends a formatted message (ending with a newline) at |severity| to the log,
+// as |LogMessage| does (so, asynchronously with |LogSettings::async|, and to
+// |LogSettings::sink| if there's one). The message's first |prefix_size|
+// bytes are its "[SEVERITY:file(line)] " prefix.
+FTL_EXPORT void WriteLogMessage(LogSeverity severity,
+                                const char* file,
+                                int line,
+                                char* data,
+                                size_t size,
+                                size_t prefix_size);
+
+// A call site of |FTL_VLOG_IS_ON()|, which caches the verbosity for its file
+// (see |LogSettings::vmodule|), so that checking it is a single load. These
+// have static storage duration (and are constant-initialized), and are
+// registered on first use, after which |SetLogSettings()| keeps them updated.
+class FTL_EXPORT VlogSite final {
+ public:
+  constexpr explicit VlogSite(const char* file)
+      : file_(file), verbosity_(kUninitialized) {}
+
+  bool IsOn(int verbose_level) {
+    const int verbosity = verbosity_.load(std::memory_order_relaxed);
+    if (verbose_level > verbosity)
+      return false;
+    return verbosity != kUninitialized || Register() >= verbose_level;
+  }
+
+  // Recomputes the verbosity of every registered site, after the settings
+  // change.
+  static void UpdateAll();
+
+ private:
+  static constexpr int kUninitialized = INT_MAX;
+
+  // Registers the site, and returns its verbosity.
+  int Register();
+
+  const char* const file_;
+  std::atomic<int> verbosity_;
+  // Set by |Register()|.
+  VlogSite* next_ = nullptr;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(VlogSite);
+};
+
+// The count of a call site of |FTL_LOG_EVERY_N()| or |FTL_LOG_FIRST_N()|.
+class LogSiteCounter final {
+ public:
+  constexpr LogSiteCounter() : count_(0u) {}
+
+  // True for the first of every |n| calls.
+  bool EveryN(uint64_t n) {
+    return count_.fetch_add(1u, std::memory_order_relaxed) % n == 0u;
+  }
+
+  // True for the first |n| calls.
+  bool FirstN(uint64_t n) {
+    // Stop counting (and writing to the count) once past |n|.
+    return count_.load(std::memory_order_relaxed) < n &&
+           count_.fetch_add(1u, std::memory_order_relaxed) < n;
+  }
+
+ private:
+  std::atomic<uint64_t> count_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LogSiteCounter);
+};
+
+// When a call site of |FTL_LOG_EVERY_T()| next logs.
+class FTL_EXPORT LogSiteTimer final {
+ public:
+  constexpr LogSiteTimer() : next_(INT64_MIN) {}
+
+  // True if at least |interval| has passed since it was last true (and when
+  // called first). Of threads calling it at once, only one gets true.
+  bool EveryT(TimeDelta interval);
+
+ private:
+  // In nanoseconds since |TimePoint()|.
+  std::atomic<int64_t> next_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LogSiteTimer);
+};
+
+// True with probability 1 / |n|, from a random number generator of the
+// calling thread's.
+FTL_EXPORT bool ShouldSampleLog(uint32_t n);
+
+}  // namespace internal
 }  // namespace ftl
 
-#define FTL_LOG_STREAM(severity) \
-  ::ftl::LogMessage(::ftl::LOG_##severity, __FILE__, __LINE__, nullptr).stream()
+// The call site's |::ftl::internal::LogFile|. (MSVC lacks C++14 constexpr, so
+// there it's computed at run time.)
+#if defined(_MSC_VER)
+#define FTL_LOG_FILE ::ftl::internal::LogFile(__FILE__)
+#else
+#define FTL_LOG_FILE                                                      \
+  ::ftl::internal::LogFile(                                              \
+      __FILE__,                                                          \
+      std::integral_constant<size_t, ::ftl::internal::LogFileSize(       \
+                                         __FILE__)>::value,              \
+      std::integral_constant<size_t, ::ftl::internal::LogFilePathOffset( \
+                                         __FILE__)>::value,              \
+      std::integral_constant<size_t, ::ftl::internal::LogFileNameOffset( \
+                                         __FILE__)>::value)
+#endif
+
+#define FTL_LOG_STREAM(severity)                                           \
+  ::ftl::LogMessage(::ftl::LOG_##severity, FTL_LOG_FILE, __LINE__, nullptr) \
+      .stream()
 
 #define FTL_LAZY_STREAM(stream, condition) \
   !(condition) ? (void)0 : ::ftl::LogMessageVoidify() & (stream)
@@ -58,28 +286,85 @@ FTL_EXPORT bool ShouldCreateLogMessage(LogSeverity severity);
       : ::ftl::LogMessageVoidify() &       \
             ::ftl::LogMessage(::ftl::LOG_FATAL, 0, 0, nullptr).stream()
 
-#define FTL_LOG_IS_ON(severity) \
-  (::ftl::ShouldCreateLogMessage(::ftl::LOG_##severity))
+// Log statements below FTL_LOG_COMPILE_MIN_LEVEL (a severity, e.g., 1 for
+// LOG_WARNING, or -2 to keep FTL_VLOG(1) and FTL_VLOG(2)), which the build can
+// define (see the ftl_log_compile_min_level build argument), compile to
+// nothing: their conditions are constant, so neither they nor their arguments
+// are emitted. LOG_FATAL and above is always compiled in.
+#ifndef FTL_LOG_COMPILE_MIN_LEVEL
+#define FTL_LOG_COMPILE_MIN_LEVEL INT_MIN
+#endif
+
+#define FTL_LOG_IS_COMPILED_IN(severity) \
+  ((severity) >= ::ftl::LOG_FATAL || (severity) >= FTL_LOG_COMPILE_MIN_LEVEL)
+
+// (As |ShouldCreateLogMessage()|, but inline.)
+#define FTL_LOG_IS_ON(severity)                      \
+  (FTL_LOG_IS_COMPILED_IN(::ftl::LOG_##severity) &&  \
+   ::ftl::LOG_##severity >=                          \
+       ::ftl::state::g_min_log_level.load(std::memory_order_relaxed))
 
 #define FTL_LOG(severity) \
   FTL_LAZY_STREAM(FTL_LOG_STREAM(severity), FTL_LOG_IS_ON(severity))
 
-#define FTL_CHECK(condition)                                              \
-  FTL_LAZY_STREAM(                                                        \
-      ::ftl::LogMessage(::ftl::LOG_FATAL, __FILE__, __LINE__, #condition) \
-          .stream(),                                                      \
-      !(condition))
+#define FTL_CHECK(condition)                                                  \
+  FTL_LAZY_STREAM(                                                            \
+      ::ftl::internal::CheckFailedMessage(FTL_LOG_FILE, __LINE__,             \
+                                          #condition)                         \
+          .stream(),                                                          \
+      FTL_UNLIKELY(!(condition)))
+
+// A pointer to a (constant-initialized) static |type| of the call site's,
+// constructed from the remaining arguments.
+#define FTL_LOG_SITE_STATE(type, ...)            \
+  ([]() -> type* {                               \
+    static type ftl_log_site_state{__VA_ARGS__}; \
+    return &ftl_log_site_state;                  \
+  }())
 
-#define FTL_VLOG_IS_ON(verbose_level) \
-  ((verbose_level) <= ::ftl::GetVlogVerbosity())
+#define FTL_VLOG_IS_ON(verbose_level)                      \
+  (FTL_LOG_IS_COMPILED_IN(-(verbose_level)) &&             \
+   FTL_LOG_SITE_STATE(::ftl::internal::VlogSite, __FILE__) \
+       ->IsOn(verbose_level))
 
 // The VLOG macros log with negative verbosities.
 #define FTL_VLOG_STREAM(verbose_level) \
-  ::ftl::LogMessage(-verbose_level, __FILE__, __LINE__, nullptr).stream()
+  ::ftl::LogMessage(-verbose_level, FTL_LOG_FILE, __LINE__, nullptr).stream()
 
 #define FTL_VLOG(verbose_level) \
   FTL_LAZY_STREAM(FTL_VLOG_STREAM(verbose_level), FTL_VLOG_IS_ON(verbose_level))
 
+// Rate-limited logging, for messages which may repeat many times (say, while
+// a peer is down). These only count calls made while the severity is on.
+//
+// FTL_LOG_EVERY_N(severity, n) logs the first of every |n| (> 0) times it's
+// reached; FTL_LOG_FIRST_N(severity, n), the first |n| times; and
+// FTL_LOG_EVERY_T(severity, interval) (with a |TimeDelta|), at most once per
+// |interval|. FTL_LOG_IF_SAMPLED(severity, n) logs a random one in |n| (> 0)
+// of the times it's reached, on average.
+#define FTL_LOG_EVERY_N(severity, n)                                      \
+  FTL_LAZY_STREAM(FTL_LOG_STREAM(severity),                               \
+                  FTL_LOG_IS_ON(severity) &&                              \
+                      FTL_LOG_SITE_STATE(::ftl::internal::LogSiteCounter) \
+                          ->EveryN(n))
+
+#define FTL_LOG_FIRST_N(severity, n)                                      \
+  FTL_LAZY_STREAM(FTL_LOG_STREAM(severity),                               \
+                  FTL_LOG_IS_ON(severity) &&                              \
+                      FTL_LOG_SITE_STATE(::ftl::internal::LogSiteCounter) \
+                          ->FirstN(n))
+
+#define FTL_LOG_EVERY_T(severity, interval)                             \
+  FTL_LAZY_STREAM(FTL_LOG_STREAM(severity),                             \
+                  FTL_LOG_IS_ON(severity) &&                            \
+                      FTL_LOG_SITE_STATE(::ftl::internal::LogSiteTimer) \
+                          ->EveryT(interval))
+
+#define FTL_LOG_IF_SAMPLED(severity, n)      \
+  FTL_LAZY_STREAM(FTL_LOG_STREAM(severity),  \
+                  FTL_LOG_IS_ON(severity) && \
+                      ::ftl::internal::ShouldSampleLog(n))
+
 #ifndef NDEBUG
 #define FTL_DLOG(severity) FTL_LOG(severity)
 #define FTL_DCHECK(condition) FTL_CHECK(condition)
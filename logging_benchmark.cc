@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <memory>
+
+#include "lib/ftl/log_settings.h"
+#include "lib/ftl/log_sink.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+// Discards messages, so that the benchmarks measure formatting rather than
+// the terminal.
+class NullSink : public LogSink {
+ public:
+  void Write(const LogRecord* records, size_t count) override {
+    benchmark::DoNotOptimize(records);
+  }
+};
+
+// Sends the log to a |NullSink| (with |settings|' other options) for as long
+// as it exists.
+class ScopedNullSink {
+ public:
+  explicit ScopedNullSink(LogSettings settings = LogSettings())
+      : old_settings_(GetLogSettings()) {
+    settings.sink = std::make_shared<NullSink>();
+    SetLogSettings(settings);
+  }
+  ~ScopedNullSink() { SetLogSettings(old_settings_); }
+
+ private:
+  const LogSettings old_settings_;
+};
+
+void BM_LogDisabled(benchmark::State& state) {
+  ScopedNullSink sink;
+  int value = 42;
+  while (state.KeepRunning())
+    FTL_VLOG(10) << "Not logged: " << value;
+}
+FTL_BENCHMARK(BM_LogDisabled);
+
+void BM_LogInfo(benchmark::State& state) {
+  ScopedNullSink sink;
+  int value = 42;
+  while (state.KeepRunning())
+    FTL_LOG(INFO) << "Logged: " << value;
+}
+FTL_BENCHMARK(BM_LogInfo);
+
+void BM_LogInfoWithPrefix(benchmark::State& state) {
+  LogSettings settings;
+  settings.log_thread_ids = true;
+  settings.log_timestamps = true;
+  ScopedNullSink sink(settings);
+  int value = 42;
+  while (state.KeepRunning())
+    FTL_LOG(INFO) << "Logged: " << value;
+}
+FTL_BENCHMARK(BM_LogInfoWithPrefix);
+
+}  // namespace
+}  // namespace ftl
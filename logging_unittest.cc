@@ -0,0 +1,163 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Log statements below LOG_WARNING are compiled out of this file.
+#define FTL_LOG_COMPILE_MIN_LEVEL 1
+
+#include "lib/ftl/logging.h"
+
+#include <fcntl.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/log_settings.h"
+#include "lib/ftl/portable_unistd.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+namespace {
+
+class LoggingTest : public ::testing::Test {
+ protected:
+  LoggingTest()
+      : old_settings_(GetLogSettings()), old_stderr_(dup(STDERR_FILENO)) {
+    LogSettings settings;
+    settings.min_log_level = -10;
+    SetLogSettings(settings);
+    // Discard what's logged.
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDERR_FILENO);
+    close(null);
+  }
+  ~LoggingTest() {
+    SetLogSettings(old_settings_);
+    dup2(old_stderr_, STDERR_FILENO);
+    close(old_stderr_);
+  }
+
+  int Count() { return ++count_; }
+
+  int count_ = 0;
+
+ private:
+  LogSettings old_settings_;
+  int old_stderr_;
+};
+
+TEST_F(LoggingTest, CompiledOut) {
+  EXPECT_FALSE(FTL_LOG_IS_ON(INFO));
+  EXPECT_FALSE(FTL_VLOG_IS_ON(1));
+  FTL_LOG(INFO) << Count();
+  FTL_VLOG(2) << Count();
+  FTL_DLOG(INFO) << Count();
+  EXPECT_EQ(0, count_);
+}
+
+TEST_F(LoggingTest, CompiledIn) {
+  EXPECT_TRUE(FTL_LOG_IS_ON(WARNING));
+  EXPECT_TRUE(FTL_LOG_IS_ON(FATAL));
+  FTL_LOG(WARNING) << "Compiled in: " << Count();
+  EXPECT_EQ(1, count_);
+  FTL_CHECK(Count() == 2);
+  EXPECT_EQ(2, count_);
+}
+
+TEST_F(LoggingTest, CheckStreamsOnlyOnFailure) {
+  FTL_CHECK(Count() == 1) << Count();
+  EXPECT_EQ(1, count_);
+}
+
+static_assert(internal::LogFileSize("../../lib/ftl/logging.cc") == 24u, "");
+static_assert(internal::LogFilePathOffset("../../lib/ftl/logging.cc") == 6u,
+              "");
+static_assert(internal::LogFileNameOffset("../../lib/ftl/logging.cc") == 14u,
+              "");
+static_assert(internal::LogFileNameOffset("logging.cc") == 0u, "");
+
+TEST(LogFile, ForSeverity) {
+  const internal::LogFile file("../../lib/ftl/logging.cc");
+  size_t size = 0u;
+  const char* part = file.ForSeverity(LOG_WARNING, &size);
+  EXPECT_EQ("lib/ftl/logging.cc", std::string(part, size));
+  part = file.ForSeverity(LOG_INFO, &size);
+  EXPECT_EQ("logging.cc", std::string(part, size));
+  part = file.ForSeverity(-1, &size);
+  EXPECT_EQ("logging.cc", std::string(part, size));
+}
+
+TEST(LoggingDeathTest, CheckFailed) {
+  EXPECT_DEATH_IF_SUPPORTED(FTL_CHECK(1 + 1 == 3) << "Oops",
+                            "Check failed: 1 \\+ 1 == 3\\. Oops");
+}
+
+TEST_F(LoggingTest, EveryN) {
+  for (int i = 0; i < 10; i++)
+    FTL_LOG_EVERY_N(WARNING, 3) << Count();
+  // The 1st, 4th, 7th and 10th.
+  EXPECT_EQ(4, count_);
+
+  // Each site has its own count.
+  count_ = 0;
+  for (int i = 0; i < 10; i++) {
+    FTL_LOG_EVERY_N(WARNING, 5) << Count();
+    FTL_LOG_EVERY_N(WARNING, 1) << Count();
+  }
+  EXPECT_EQ(12, count_);
+
+  // Calls aren't counted while the severity is off.
+  FTL_LOG_EVERY_N(INFO, 1) << Count();
+  EXPECT_EQ(12, count_);
+}
+
+TEST_F(LoggingTest, EveryNThreads) {
+  std::atomic<int> count(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&count] {
+      for (int i = 0; i < 1000; i++)
+        FTL_LOG_EVERY_N(ERROR, 10) << ++count;
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(400, count.load());
+}
+
+TEST_F(LoggingTest, FirstN) {
+  for (int i = 0; i < 10; i++)
+    FTL_LOG_FIRST_N(WARNING, 3) << Count();
+  EXPECT_EQ(3, count_);
+  for (int i = 0; i < 10; i++)
+    FTL_LOG_FIRST_N(WARNING, 0) << Count();
+  EXPECT_EQ(3, count_);
+}
+
+TEST_F(LoggingTest, EveryT) {
+  for (int i = 0; i < 10; i++)
+    FTL_LOG_EVERY_T(WARNING, TimeDelta::FromSeconds(3600)) << Count();
+  EXPECT_EQ(1, count_);
+  for (int i = 0; i < 10; i++)
+    FTL_LOG_EVERY_T(WARNING, TimeDelta::Zero()) << Count();
+  EXPECT_EQ(11, count_);
+}
+
+TEST_F(LoggingTest, IfSampled) {
+  for (int i = 0; i < 10; i++)
+    FTL_LOG_IF_SAMPLED(WARNING, 1) << Count();
+  EXPECT_EQ(10, count_);
+
+  count_ = 0;
+  for (int i = 0; i < 10000; i++)
+    FTL_LOG_IF_SAMPLED(WARNING, 4) << Count();
+  // About 2500 (with a standard deviation of about 43).
+  EXPECT_GT(count_, 2000);
+  EXPECT_LT(count_, 3000);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,186 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/allocation_profiling.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "lib/ftl/debug/stack_trace.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+namespace internal {
+
+// The counters for one site, updated without locking.
+class AllocationSiteStats {
+ public:
+  static constexpr size_t kMaxStackFrames = 16u;
+
+  AllocationSiteStats(const char* entry_point,
+                      const void* caller,
+                      const void* const* stack,
+                      size_t stack_size)
+      : entry_point_(entry_point), caller_(caller),
+        stack_(stack, stack + stack_size), allocations_(0u), bytes_(0u) {}
+
+  void Record(size_t bytes) {
+    allocations_.fetch_add(1u, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  void AddTo(AllocationProfile* profile) const {
+    profile->allocations += allocations_.load(std::memory_order_relaxed);
+    profile->bytes += bytes_.load(std::memory_order_relaxed);
+  }
+
+  void Reset() {
+    allocations_.store(0u, std::memory_order_relaxed);
+    bytes_.store(0u, std::memory_order_relaxed);
+  }
+
+  const char* entry_point() const { return entry_point_; }
+  const void* caller() const { return caller_; }
+  const std::vector<const void*>& stack() const { return stack_; }
+
+ private:
+  const char* const entry_point_;
+  const void* const caller_;
+  const std::vector<const void*> stack_;
+
+  std::atomic<uint64_t> allocations_;
+  std::atomic<uint64_t> bytes_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(AllocationSiteStats);
+};
+
+constexpr size_t AllocationSiteStats::kMaxStackFrames;
+
+namespace {
+
+// All the sites, keyed by the entry point's string (by address, so the same
+// entry point may have more than one key) and the caller. (This uses
+// |std::mutex| since |ftl::Mutex| may be profiled, which allocates.)
+struct AllocationSiteRegistry {
+  using Key = std::pair<const char*, const void*>;
+
+  std::mutex mutex;
+  std::map<Key, std::unique_ptr<AllocationSiteStats>> sites;
+};
+
+AllocationSiteRegistry* GetRegistry() {
+  // Leaked, so that allocations can be recorded during static destruction.
+  static AllocationSiteRegistry* registry = new AllocationSiteRegistry();
+  return registry;
+}
+
+}  // namespace
+
+AllocationSiteStats* GetAllocationSiteStats(const char* entry_point,
+                                            const void* caller) {
+  AllocationSiteRegistry* registry = GetRegistry();
+  std::lock_guard<std::mutex> locker(registry->mutex);
+  auto& stats = registry->sites[std::make_pair(entry_point, caller)];
+  if (!stats) {
+    // From the entry point out.
+    const void* frames[AllocationSiteStats::kMaxStackFrames];
+    const size_t count =
+        CaptureStackTrace(frames, AllocationSiteStats::kMaxStackFrames, 1u);
+    stats.reset(new AllocationSiteStats(entry_point, caller, frames, count));
+  }
+  return stats.get();
+}
+
+void RecordAllocation(AllocationSiteStats* stats, size_t bytes) {
+  stats->Record(bytes);
+}
+
+}  // namespace internal
+
+bool IsAllocationProfilingEnabled() {
+#if defined(FTL_ALLOCATION_PROFILING)
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::vector<AllocationProfile> GetAllocationProfiles() {
+  // Merge the sites with the same entry point (by value) and caller.
+  std::map<std::pair<std::string, const void*>, AllocationProfile> merged;
+  {
+    internal::AllocationSiteRegistry* registry = internal::GetRegistry();
+    std::lock_guard<std::mutex> locker(registry->mutex);
+    for (const auto& site : registry->sites) {
+      const internal::AllocationSiteStats* stats = site.second.get();
+      AllocationProfile& profile = merged[std::make_pair(
+          std::string(stats->entry_point()), stats->caller())];
+      stats->AddTo(&profile);
+      if (profile.stack.empty())
+        profile.stack = stats->stack();
+    }
+  }
+
+  std::vector<AllocationProfile> profiles;
+  for (auto& site : merged) {
+    AllocationProfile& profile = site.second;
+    if (!profile.allocations)
+      continue;
+    profile.entry_point = site.first.first;
+    profile.caller = site.first.second;
+    if (profile.caller)
+      profile.caller_symbol = SymbolizeStackFrame(profile.caller);
+    profiles.push_back(std::move(profile));
+  }
+  std::stable_sort(profiles.begin(), profiles.end(),
+                   [](const AllocationProfile& a, const AllocationProfile& b) {
+                     return a.bytes > b.bytes;
+                   });
+  return profiles;
+}
+
+std::string DumpAllocationProfiles(size_t max_sites) {
+  if (!IsAllocationProfilingEnabled())
+    return "Allocation profiling is not enabled in this build.\n";
+
+  std::vector<AllocationProfile> profiles = GetAllocationProfiles();
+  std::string result = StringPrintf("%12s %14s  %s\n", "allocations", "bytes",
+                                    "site");
+  for (size_t i = 0u; i < profiles.size() && i < max_sites; i++) {
+    const AllocationProfile& profile = profiles[i];
+    StringAppendf(&result, "%12llu %14llu  %s",
+                  static_cast<unsigned long long>(profile.allocations),
+                  static_cast<unsigned long long>(profile.bytes),
+                  profile.entry_point.c_str());
+    if (!profile.caller_symbol.empty())
+      StringAppendf(&result, " from %s", profile.caller_symbol.c_str());
+    else if (profile.caller)
+      StringAppendf(&result, " from %p", profile.caller);
+    result += "\n";
+    for (size_t j = 0u; j < profile.stack.size(); j++) {
+      const void* frame = profile.stack[j];
+      StringAppendf(&result, "    #%zu %p %s\n", j, frame,
+                    SymbolizeStackFrame(frame).c_str());
+    }
+  }
+  if (profiles.size() > max_sites)
+    StringAppendf(&result, "(%zu more sites)\n", profiles.size() - max_sites);
+  return result;
+}
+
+void ResetAllocationProfiles() {
+  internal::AllocationSiteRegistry* registry = internal::GetRegistry();
+  std::lock_guard<std::mutex> locker(registry->mutex);
+  for (auto& site : registry->sites)
+    site.second->Reset();
+}
+
+}  // namespace ftl
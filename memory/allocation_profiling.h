@@ -0,0 +1,111 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Allocation counters for the library's allocating entry points.
+//
+// These are only recorded in builds with |FTL_ALLOCATION_PROFILING| defined
+// (e.g., with the |ftl_allocation_profiling| GN arg), in which the following
+// count their heap allocations (and the bytes allocated) per call site:
+//  - |MakeRefCounted()| and |MakeCopyable()|, per type (since they are inline,
+//    the site is the template instantiation rather than the caller);
+//  - |StringPrintf()| and friends, when the output doesn't fit in their stack
+//    buffer;
+//  - |SplitStringCopy()|;
+//  - |files::ReadFileToString()| and |files::ReadFileToVector()|.
+// In other builds, these functions are available but report nothing, so tools
+// can call them unconditionally.
+
+#ifndef LIB_FTL_MEMORY_ALLOCATION_PROFILING_H_
+#define LIB_FTL_MEMORY_ALLOCATION_PROFILING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace ftl {
+
+// A snapshot of the counters for one call site.
+struct AllocationProfile {
+  // The library entry point which allocated (for templates, its signature,
+  // including the type).
+  std::string entry_point;
+  // The return address into the code which called |entry_point|, or null if
+  // the site is just the entry point. |caller_symbol| is its symbol (or module)
+  // and offset, if known.
+  const void* caller = nullptr;
+  std::string caller_symbol;
+
+  uint64_t allocations = 0u;
+  uint64_t bytes = 0u;
+
+  // The stack (see debug/stack_trace.h) of the site's first allocation, from
+  // |entry_point| out (or empty if it couldn't be captured).
+  std::vector<const void*> stack;
+};
+
+// Returns true if this is a build which records allocation profiles.
+FTL_EXPORT bool IsAllocationProfilingEnabled();
+
+// Returns the profiles of all the sites which have allocated, most bytes first.
+FTL_EXPORT std::vector<AllocationProfile> GetAllocationProfiles();
+
+// Returns a human-readable table of (up to |max_sites| of) the profiles from
+// |GetAllocationProfiles()|, each followed by its (symbolized) stack.
+FTL_EXPORT std::string DumpAllocationProfiles(size_t max_sites = 20u);
+
+// Clears the counters of all sites.
+FTL_EXPORT void ResetAllocationProfiles();
+
+namespace internal {
+
+class AllocationSiteStats;
+
+// Returns the counters for |entry_point| (which must be a string literal)
+// called from |caller|, creating them if necessary. They live forever.
+FTL_EXPORT AllocationSiteStats* GetAllocationSiteStats(const char* entry_point,
+                                                       const void* caller);
+
+FTL_EXPORT void RecordAllocation(AllocationSiteStats* stats, size_t bytes);
+
+}  // namespace internal
+}  // namespace ftl
+
+#if defined(FTL_ALLOCATION_PROFILING)
+
+#if defined(_MSC_VER)
+#error "FTL_ALLOCATION_PROFILING isn't supported with this compiler"
+#endif
+
+// Evaluates to the return address of the current (out-of-line) function.
+#define FTL_ALLOCATION_CALLER() __builtin_return_address(0)
+
+// Records an allocation of |bytes| by |entry_point| (a string literal), called
+// from |caller| (see |FTL_ALLOCATION_CALLER()|).
+#define FTL_RECORD_ALLOCATION(entry_point, caller, bytes) \
+  ::ftl::internal::RecordAllocation(                      \
+      ::ftl::internal::GetAllocationSiteStats(entry_point, caller), bytes)
+
+// Records an allocation of |bytes| by the current (inline) function, per
+// template instantiation.
+#define FTL_RECORD_INLINE_ALLOCATION(bytes)                            \
+  do {                                                                 \
+    static ::ftl::internal::AllocationSiteStats* const ftl_site_stats = \
+        ::ftl::internal::GetAllocationSiteStats(__PRETTY_FUNCTION__,   \
+                                                nullptr);              \
+    ::ftl::internal::RecordAllocation(ftl_site_stats, bytes);          \
+  } while (false)
+
+#else  // defined(FTL_ALLOCATION_PROFILING)
+
+#define FTL_ALLOCATION_CALLER() nullptr
+#define FTL_RECORD_ALLOCATION(entry_point, caller, bytes) ((void)0)
+#define FTL_RECORD_INLINE_ALLOCATION(bytes) ((void)0)
+
+#endif  // defined(FTL_ALLOCATION_PROFILING)
+
+#endif  // LIB_FTL_MEMORY_ALLOCATION_PROFILING_H_
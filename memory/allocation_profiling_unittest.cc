@@ -0,0 +1,143 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/allocation_profiling.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/functional/make_copyable.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+namespace {
+
+class Counted : public RefCountedThreadSafe<Counted> {
+ public:
+  char payload[100];
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(Counted);
+  FRIEND_MAKE_REF_COUNTED(Counted);
+
+  Counted() {}
+  ~Counted() {}
+};
+
+#if defined(FTL_ALLOCATION_PROFILING)
+
+// Returns the sum of the profiles whose entry points contain |entry_point|.
+AllocationProfile GetTotalProfile(const std::string& entry_point) {
+  AllocationProfile total;
+  for (const auto& profile : GetAllocationProfiles()) {
+    if (profile.entry_point.find(entry_point) == std::string::npos)
+      continue;
+    total.allocations += profile.allocations;
+    total.bytes += profile.bytes;
+    total.caller = profile.caller;
+    if (total.stack.empty())
+      total.stack = profile.stack;
+  }
+  return total;
+}
+
+TEST(AllocationProfilingTest, MakeRefCounted) {
+  EXPECT_TRUE(IsAllocationProfilingEnabled());
+  ResetAllocationProfiles();
+
+  for (int i = 0; i < 3; i++)
+    MakeRefCounted<Counted>();
+  AllocationProfile profile = GetTotalProfile("Counted");
+  EXPECT_EQ(3u, profile.allocations);
+  EXPECT_EQ(3u * sizeof(Counted), profile.bytes);
+  // It's inline, so the site is the instantiation.
+  EXPECT_EQ(nullptr, profile.caller);
+
+  ResetAllocationProfiles();
+  EXPECT_EQ(0u, GetTotalProfile("Counted").allocations);
+}
+
+TEST(AllocationProfilingTest, MakeCopyable) {
+  ResetAllocationProfiles();
+  std::unique_ptr<int> value(new int(42));
+  std::function<int()> func =
+      MakeCopyable([value = std::move(value)]() { return *value; });
+  EXPECT_EQ(42, func());
+  EXPECT_EQ(1u, GetTotalProfile("CopyableLambda").allocations);
+  EXPECT_EQ(0u, GetTotalProfile("MakeRefCounted").allocations);
+}
+
+TEST(AllocationProfilingTest, StringPrintf) {
+  ResetAllocationProfiles();
+  // Short output doesn't allocate (beyond the result).
+  EXPECT_EQ("42", StringPrintf("%d", 42));
+  EXPECT_EQ(0u, GetTotalProfile("ftl::StringPrintf").allocations);
+
+  std::string long_string(5000u, 'x');
+  EXPECT_EQ(long_string, StringPrintf("%s", long_string.c_str()));
+  AllocationProfile profile = GetTotalProfile("ftl::StringPrintf");
+  EXPECT_EQ(1u, profile.allocations);
+  EXPECT_EQ(5001u, profile.bytes);
+  EXPECT_NE(nullptr, profile.caller);
+  // From |StringPrintf()| (or whatever it inlined to) out, past the caller.
+  ASSERT_LE(2u, profile.stack.size());
+
+  std::string dump = DumpAllocationProfiles();
+  EXPECT_NE(std::string::npos, dump.find("ftl::StringPrintf from "));
+  EXPECT_NE(std::string::npos, dump.find("    #1 "));
+}
+
+TEST(AllocationProfilingTest, SplitStringCopy) {
+  ResetAllocationProfiles();
+  std::string long_piece(100u, 'x');
+  std::vector<std::string> pieces =
+      SplitStringCopy("a," + long_piece, ",", kKeepWhitespace, kSplitWantAll);
+  ASSERT_EQ(2u, pieces.size());
+  AllocationProfile profile = GetTotalProfile("ftl::SplitStringCopy");
+  // At least the vector and the long piece.
+  EXPECT_GE(profile.allocations, 2u);
+  EXPECT_GE(profile.bytes, 2u * sizeof(std::string) + 101u);
+}
+
+TEST(AllocationProfilingTest, ReadFile) {
+  files::ScopedTempDir temp_dir;
+  std::string path;
+  ASSERT_TRUE(temp_dir.NewTempFile(&path));
+  // (Big enough not to fit in a short string, since the result is sized to
+  // the file.)
+  std::string content(100u, 'x');
+  ASSERT_TRUE(files::WriteFile(path, content.data(), content.size()));
+
+  ResetAllocationProfiles();
+  std::string contents;
+  ASSERT_TRUE(files::ReadFileToString(path, &contents));
+  std::vector<uint8_t> bytes;
+  ASSERT_TRUE(files::ReadFileToVector(path, &bytes));
+  EXPECT_LE(1u, GetTotalProfile("files::ReadFileToString").allocations);
+  EXPECT_LE(1u, GetTotalProfile("files::ReadFileToVector").allocations);
+}
+
+#else  // defined(FTL_ALLOCATION_PROFILING)
+
+TEST(AllocationProfilingTest, Disabled) {
+  EXPECT_FALSE(IsAllocationProfilingEnabled());
+
+  MakeRefCounted<Counted>();
+  std::string long_string(5000u, 'x');
+  EXPECT_EQ(long_string, StringPrintf("%s", long_string.c_str()));
+  EXPECT_TRUE(GetAllocationProfiles().empty());
+  ResetAllocationProfiles();
+  EXPECT_FALSE(DumpAllocationProfiles().empty());
+}
+
+#endif  // defined(FTL_ALLOCATION_PROFILING)
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,225 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/arena.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/memory/memory_stats.h"
+
+#if defined(OS_LINUX)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ftl {
+namespace {
+
+Arena::Options MakeOptions(size_t chunk_size, int numa_node) {
+  Arena::Options options;
+  options.chunk_size = chunk_size;
+  options.numa_node = numa_node;
+  return options;
+}
+
+#if defined(OS_LINUX)
+// From <numaif.h> (which needs libnuma's headers).
+constexpr int kMpolPreferred = 1;
+
+constexpr int kProtection = PROT_READ | PROT_WRITE;
+constexpr int kFlags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+// Maps |size| bytes (a multiple of |Arena::kHugePageSize|) aligned to a huge
+// page, so that they can be backed by transparent huge pages.
+void* MapTransparentHugePages(size_t size) {
+  constexpr size_t kHugePageSize = Arena::kHugePageSize;
+  void* memory =
+      mmap(nullptr, size + kHugePageSize, kProtection, kFlags, -1, 0);
+  if (memory == MAP_FAILED)
+    return MAP_FAILED;
+  char* start = static_cast<char*>(memory);
+  char* aligned = reinterpret_cast<char*>(
+      (reinterpret_cast<uintptr_t>(start) + kHugePageSize - 1u) &
+      ~(kHugePageSize - 1u));
+  if (aligned != start)
+    munmap(start, static_cast<size_t>(aligned - start));
+  if (aligned + size != start + size + kHugePageSize) {
+    munmap(aligned + size,
+           static_cast<size_t>(start + size + kHugePageSize - aligned - size));
+  }
+  // Best effort: without transparent huge page support, this just fails.
+  madvise(aligned, size, MADV_HUGEPAGE);
+  return aligned;
+}
+#endif
+
+}  // namespace
+
+constexpr size_t Arena::kDefaultChunkSize;
+constexpr size_t Arena::kHugePageSize;
+
+Arena::Arena(size_t chunk_size, int numa_node)
+    : Arena(MakeOptions(chunk_size, numa_node)) {}
+
+Arena::Arena(const Options& options)
+    : options_(options),
+      chunks_(nullptr),
+      current_(nullptr),
+      end_(nullptr),
+      destructors_(nullptr),
+      bytes_reserved_(0u) {
+  FTL_DCHECK(options_.chunk_size > sizeof(Chunk));
+  if (!options_.memory_stats_name.empty()) {
+    memory_stats_source_.reset(new MemoryStatsSource(
+        options_.memory_stats_name, [this] { return bytes_reserved(); }));
+  }
+}
+
+Arena::~Arena() {
+  CallDestructors();
+  while (chunks_) {
+    Chunk* next = chunks_->next;
+    FreeChunk(chunks_);
+    chunks_ = next;
+  }
+}
+
+void Arena::Reset() {
+  CallDestructors();
+
+  // Keep the biggest chunk.
+  Chunk* kept = chunks_;
+  for (Chunk* chunk = chunks_; chunk; chunk = chunk->next) {
+    if (chunk->size > kept->size)
+      kept = chunk;
+  }
+  while (chunks_) {
+    Chunk* next = chunks_->next;
+    if (chunks_ != kept)
+      FreeChunk(chunks_);
+    chunks_ = next;
+  }
+
+  chunks_ = kept;
+  if (kept) {
+    kept->next = nullptr;
+    current_ = reinterpret_cast<char*>(kept + 1);
+    end_ = reinterpret_cast<char*>(kept) + kept->size;
+    bytes_reserved_.store(kept->size, std::memory_order_relaxed);
+  } else {
+    current_ = nullptr;
+    end_ = nullptr;
+    bytes_reserved_.store(0u, std::memory_order_relaxed);
+  }
+}
+
+void* Arena::AllocateSlow(size_t size, size_t alignment) {
+  // The chunk header keeps the data aligned to |alignof(max_align_t)|; more
+  // alignment needs padding.
+  size_t padding =
+      alignment > alignof(max_align_t) ? alignment - alignof(max_align_t) : 0u;
+  size_t needed = sizeof(Chunk) + padding + size;
+  Chunk* chunk = AllocateChunk(std::max(options_.chunk_size, needed));
+  size_t chunk_size = chunk->size;
+  bytes_reserved_.store(bytes_reserved() + chunk_size,
+                        std::memory_order_relaxed);
+  if (chunk_size - needed < static_cast<size_t>(end_ - current_)) {
+    // A big allocation, which would leave less free space than the current
+    // chunk has; insert its chunk behind the current one.
+    FTL_DCHECK(chunks_);
+    chunk->next = chunks_->next;
+    chunks_->next = chunk;
+  } else {
+    chunk->next = chunks_;
+    chunks_ = chunk;
+    current_ = reinterpret_cast<char*>(chunk + 1);
+    end_ = reinterpret_cast<char*>(chunk) + chunk_size;
+  }
+
+  uintptr_t aligned =
+      (reinterpret_cast<uintptr_t>(chunk + 1) + alignment - 1u) &
+      ~(alignment - 1u);
+  if (chunks_ == chunk)
+    current_ = reinterpret_cast<char*>(aligned + size);
+  return reinterpret_cast<void*>(aligned);
+}
+
+Arena::Chunk* Arena::AllocateChunk(size_t size) {
+#if defined(OS_LINUX)
+  if (MapsChunks()) {
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t rounding =
+        options_.huge_pages ? std::max(kHugePageSize, page_size) : page_size;
+    size = (size + rounding - 1u) & ~(rounding - 1u);
+    // |MAP_POPULATE| faults the pages in straight away, before |mbind()| could
+    // apply to them, so with a NUMA node they're touched afterwards instead.
+    const int populate =
+        options_.prefault && options_.numa_node < 0 ? MAP_POPULATE : 0;
+    void* memory = MAP_FAILED;
+    bool populated = false;
+    if (options_.huge_pages) {
+      // (This fails unless the system has reserved enough huge pages.)
+      memory = mmap(nullptr, size, kProtection, kFlags | MAP_HUGETLB | populate,
+                    -1, 0);
+      populated = memory != MAP_FAILED && populate;
+      if (memory == MAP_FAILED)
+        memory = MapTransparentHugePages(size);
+    } else {
+      memory = mmap(nullptr, size, kProtection, kFlags | populate, -1, 0);
+      populated = !!populate;
+    }
+    FTL_CHECK(memory != MAP_FAILED) << "Out of memory";
+    if (options_.numa_node >= 0) {
+      // Best effort: if this fails (e.g., without NUMA support), the pages are
+      // just allocated as usual.
+      constexpr size_t kBitsPerWord = sizeof(unsigned long) * 8u;
+      size_t node = static_cast<size_t>(options_.numa_node);
+      std::vector<unsigned long> node_mask(node / kBitsPerWord + 1u);
+      node_mask[node / kBitsPerWord] = 1ul << (node % kBitsPerWord);
+      // (The kernel takes one less than |maxnode| bits of the mask, so, like
+      // libnuma, pass one more than the bits up to and including |node|.)
+      syscall(SYS_mbind, memory, size, kMpolPreferred, node_mask.data(),
+              node + 2u, 0u);
+    }
+    if (options_.prefault && !populated) {
+      volatile char* pages = static_cast<volatile char*>(memory);
+      for (size_t offset = 0u; offset < size; offset += page_size)
+        pages[offset] = 0;
+    }
+    Chunk* chunk = static_cast<Chunk*>(memory);
+    chunk->size = size;
+    return chunk;
+  }
+#endif
+  Chunk* chunk = static_cast<Chunk*>(::operator new(size));
+  chunk->size = size;
+  return chunk;
+}
+
+void Arena::FreeChunk(Chunk* chunk) {
+#if defined(OS_LINUX)
+  if (MapsChunks()) {
+    munmap(chunk, chunk->size);
+    return;
+  }
+#endif
+  ::operator delete(chunk);
+}
+
+bool Arena::MapsChunks() const {
+  return options_.numa_node >= 0 || options_.huge_pages || options_.prefault;
+}
+
+void Arena::CallDestructors() {
+  while (destructors_) {
+    Destructor* destructor = destructors_;
+    destructors_ = destructor->next;
+    destructor->destroy(destructor->object);
+  }
+}
+
+}  // namespace ftl
@@ -0,0 +1,211 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides an arena (bump) allocator, for many objects with a common lifetime.
+
+#ifndef LIB_FTL_MEMORY_ARENA_H_
+#define LIB_FTL_MEMORY_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+class MemoryStatsSource;
+
+// Arena -----------------------------------------------------------------------
+
+// Allocates memory by bumping a pointer through chunks, and frees it all at
+// once (on |Reset()| or destruction), e.g., for the temporaries of handling one
+// request. Objects made with |Create()| are also destroyed then (in reverse
+// order of creation); the destructors of trivially destructible types aren't
+// registered, so those cost nothing extra. Use |ArenaAllocator| to put standard
+// containers in an arena.
+//
+// An arena may be given a NUMA node (e.g., |ThreadPool::current_numa_node()|),
+// in which case its chunks are mapped (on Linux) with a policy preferring that
+// node's memory, for data which is mostly used by threads on that node.
+//
+// For big, long-lived arenas (e.g., in-memory indexes), the chunks may also be
+// backed by huge pages, to save TLB misses, and pre-faulted, so that the first
+// touch of each page doesn't take a page fault (see |Options|).
+//
+// This class is not thread-safe.
+class FTL_EXPORT Arena final {
+ public:
+  static constexpr size_t kDefaultChunkSize = 4096u;
+
+  // The size chunks are rounded up to with |Options::huge_pages|.
+  static constexpr size_t kHugePageSize = 2u * 1024u * 1024u;
+
+  struct Options {
+    // The size of the chunks to allocate from (larger allocations get chunks
+    // of their own). With any of the options below, chunks are mapped, and
+    // rounded up to whole pages.
+    size_t chunk_size = kDefaultChunkSize;
+    // -1 for no preference.
+    int numa_node = -1;
+    // Whether to back the chunks (on Linux) with huge pages: explicit ones
+    // (|MAP_HUGETLB|) if the system has reserved some, and otherwise
+    // transparent ones (|MADV_HUGEPAGE|). Chunks are rounded up to
+    // |kHugePageSize|, so |chunk_size| should be a multiple of it.
+    bool huge_pages = false;
+    // Whether to fault the chunks' pages in (on Linux) when they're allocated,
+    // rather than on first use.
+    bool prefault = false;
+    // If not empty, |bytes_reserved()| is reported under this name by
+    // |GetMemoryStats()|.
+    std::string memory_stats_name;
+  };
+
+  explicit Arena(size_t chunk_size = kDefaultChunkSize, int numa_node = -1);
+  explicit Arena(const Options& options);
+  ~Arena();
+
+  // Returns |size| bytes aligned to |alignment| (which must be a power of two),
+  // valid until |Reset()| or destruction. This never returns null.
+  void* Allocate(size_t size, size_t alignment = alignof(max_align_t)) {
+    FTL_DCHECK(alignment && !(alignment & (alignment - 1u)));
+    uintptr_t aligned =
+        (reinterpret_cast<uintptr_t>(current_) + alignment - 1u) &
+        ~(alignment - 1u);
+    if (current_ && aligned <= reinterpret_cast<uintptr_t>(end_) &&
+        size <= reinterpret_cast<uintptr_t>(end_) - aligned) {
+      current_ = reinterpret_cast<char*>(aligned + size);
+      return reinterpret_cast<void*>(aligned);
+    }
+    return AllocateSlow(size, alignment);
+  }
+
+  // Allocates and constructs a |T| from |args|. It's destroyed on |Reset()| or
+  // destruction (and mustn't be deleted).
+  template <typename T, typename... Args>
+  T* Create(Args&&... args) {
+    if (std::is_trivially_destructible<T>::value) {
+      return new (Allocate(sizeof(T), alignof(T)))
+          T(std::forward<Args>(args)...);
+    }
+    // The record is only linked once the object is constructed, in case the
+    // constructor throws.
+    Destructor* destructor = static_cast<Destructor*>(
+        Allocate(sizeof(Destructor), alignof(Destructor)));
+    T* object = new (Allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    destructor->destroy = [](void* to_destroy) {
+      static_cast<T*>(to_destroy)->~T();
+    };
+    destructor->object = object;
+    destructor->next = destructors_;
+    destructors_ = destructor;
+    return object;
+  }
+
+  // Allocates (uninitialized) space for |count| |T|s.
+  template <typename T>
+  T* AllocateArray(size_t count) {
+    FTL_DCHECK(count <= static_cast<size_t>(-1) / sizeof(T));
+    return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  // Destroys the objects made with |Create()| and frees all the memory, except
+  // for one chunk which is kept for reuse.
+  void Reset();
+
+  // Returns the total size of the chunks currently allocated.
+  size_t bytes_reserved() const {
+    return bytes_reserved_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // (Aligned so that the data after it is maximally aligned.)
+  struct alignas(max_align_t) Chunk {
+    Chunk* next;
+    size_t size;
+  };
+
+  struct Destructor {
+    void (*destroy)(void*);
+    void* object;
+    Destructor* next;
+  };
+
+  void* AllocateSlow(size_t size, size_t alignment);
+  void CallDestructors();
+  // Allocates (as |options_| say) and frees a chunk of at least |size| bytes
+  // (which sets |Chunk::size| to the actual size).
+  Chunk* AllocateChunk(size_t size);
+  void FreeChunk(Chunk* chunk);
+  // Whether chunks are mapped (rather than allocated with |operator new|).
+  bool MapsChunks() const;
+
+  const Options options_;
+  // The chunks, most recently allocated first.
+  Chunk* chunks_;
+  // The free part of the current chunk.
+  char* current_;
+  char* end_;
+  // The registered destructors, most recent first.
+  Destructor* destructors_;
+  // (Atomic only so that it may be read for |GetMemoryStats()|.)
+  std::atomic<size_t> bytes_reserved_;
+  std::unique_ptr<MemoryStatsSource> memory_stats_source_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Arena);
+};
+
+// ArenaAllocator --------------------------------------------------------------
+
+// A standard allocator which allocates from an |Arena| (and whose
+// |deallocate()| does nothing), e.g.:
+//
+//   Arena arena;
+//   ArenaAllocator<StringView> allocator(&arena);
+//   std::vector<StringView, ArenaAllocator<StringView>> pieces(allocator);
+//
+// The containers must not outlive the arena's next |Reset()|. Containers which
+// grow by reallocating (like |std::vector|) leave the old storage in the arena,
+// so |reserve()| them where possible.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) { FTL_DCHECK(arena_); }
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(size_t count) { return arena_->AllocateArray<T>(count); }
+  void deallocate(T*, size_t) {}
+
+  Arena* arena() const { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return arena_ == other.arena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return arena_ != other.arena();
+  }
+
+ private:
+  Arena* arena_;
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_MEMORY_ARENA_H_
@@ -0,0 +1,173 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/arena.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+bool IsAligned(const void* p, size_t alignment) {
+  return !(reinterpret_cast<uintptr_t>(p) % alignment);
+}
+
+// Appends its name to |*log| when destroyed.
+class Logger {
+ public:
+  Logger(std::vector<std::string>* log, const std::string& name)
+      : log_(log), name_(name) {}
+  ~Logger() { log_->push_back(name_); }
+
+ private:
+  std::vector<std::string>* const log_;
+  const std::string name_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Logger);
+};
+
+struct alignas(64) CacheLine {
+  char data[64];
+};
+
+TEST(ArenaTest, Allocate) {
+  Arena arena(256u);
+  EXPECT_EQ(0u, arena.bytes_reserved());
+
+  char* a = static_cast<char*>(arena.Allocate(10u, 1u));
+  char* b = static_cast<char*>(arena.Allocate(10u, 1u));
+  EXPECT_EQ(a + 10, b);
+  EXPECT_EQ(256u, arena.bytes_reserved());
+
+  EXPECT_TRUE(IsAligned(arena.Allocate(1u), alignof(max_align_t)));
+  EXPECT_TRUE(IsAligned(arena.Allocate(1u, 8u), 8u));
+  EXPECT_TRUE(IsAligned(arena.Create<CacheLine>(), 64u));
+
+  // A big allocation gets its own chunk, and the current chunk keeps being
+  // used.
+  arena.Allocate(1000u, 1u);
+  EXPECT_GE(arena.bytes_reserved(), 1256u);
+  char* c = static_cast<char*>(arena.Allocate(1u, 1u));
+  char* d = static_cast<char*>(arena.Allocate(1u, 1u));
+  EXPECT_EQ(c + 1, d);
+
+  // Lots of small allocations fill several chunks.
+  for (int i = 0; i < 100; i++)
+    memset(arena.Allocate(100u), 0, 100u);
+  EXPECT_GE(arena.bytes_reserved(), 10000u);
+
+  uint64_t* array = arena.AllocateArray<uint64_t>(5u);
+  EXPECT_TRUE(IsAligned(array, alignof(uint64_t)));
+  array[4] = 123u;
+}
+
+TEST(ArenaTest, CreateAndReset) {
+  std::vector<std::string> log;
+  {
+    Arena arena;
+    Logger* first = arena.Create<Logger>(&log, "first");
+    EXPECT_TRUE(first);
+    arena.Create<Logger>(&log, "second");
+    int* value = arena.Create<int>(42);
+    EXPECT_EQ(42, *value);
+
+    arena.Reset();
+    EXPECT_EQ((std::vector<std::string>{"second", "first"}), log);
+    EXPECT_GE(arena.bytes_reserved(), Arena::kDefaultChunkSize);
+
+    log.clear();
+    arena.Create<Logger>(&log, "third");
+  }
+  EXPECT_EQ((std::vector<std::string>{"third"}), log);
+}
+
+TEST(ArenaTest, ResetKeepsBiggestChunk) {
+  Arena arena(256u);
+  arena.Allocate(100u);
+  arena.Allocate(5000u);
+  arena.Allocate(200u);
+  arena.Reset();
+  size_t reserved = arena.bytes_reserved();
+  EXPECT_GE(reserved, 5000u);
+  EXPECT_LT(reserved, 5256u);
+
+  // That chunk is reused.
+  for (int i = 0; i < 40; i++)
+    arena.Allocate(100u);
+  EXPECT_EQ(reserved, arena.bytes_reserved());
+}
+
+TEST(ArenaTest, NumaNode) {
+  std::vector<std::string> log;
+  Arena arena(1000u, 0);
+  char* small = static_cast<char*>(arena.Allocate(100u));
+  memset(small, 1, 100u);
+  char* big = static_cast<char*>(arena.Allocate(100000u));
+  memset(big, 2, 100000u);
+  EXPECT_TRUE(IsAligned(arena.Create<CacheLine>(), 64u));
+  arena.Create<Logger>(&log, "logger");
+  EXPECT_GE(arena.bytes_reserved(), 101000u);
+  arena.Reset();
+  EXPECT_EQ((std::vector<std::string>{"logger"}), log);
+  EXPECT_GE(arena.bytes_reserved(), 100000u);
+}
+
+TEST(ArenaTest, HugePagesAndPrefaulting) {
+  for (int numa_node : {-1, 0}) {
+    Arena::Options options;
+    options.chunk_size = Arena::kHugePageSize;
+    options.numa_node = numa_node;
+    options.huge_pages = true;
+    options.prefault = true;
+    Arena arena(options);
+    char* small = static_cast<char*>(arena.Allocate(100u));
+    memset(small, 1, 100u);
+    EXPECT_EQ(Arena::kHugePageSize, arena.bytes_reserved());
+    // Chunks are rounded up to whole huge pages.
+    char* big = static_cast<char*>(arena.Allocate(3u * 1024u * 1024u));
+    memset(big, 2, 3u * 1024u * 1024u);
+    EXPECT_EQ(3u * Arena::kHugePageSize, arena.bytes_reserved());
+    EXPECT_EQ(1, small[99]);
+    arena.Reset();
+    EXPECT_EQ(2u * Arena::kHugePageSize, arena.bytes_reserved());
+  }
+
+  // Pre-faulting alone.
+  Arena::Options options;
+  options.prefault = true;
+  Arena arena(options);
+  EXPECT_TRUE(IsAligned(arena.Create<CacheLine>(), 64u));
+  EXPECT_GE(arena.bytes_reserved(), Arena::kDefaultChunkSize);
+}
+
+TEST(ArenaTest, Allocator) {
+  Arena arena;
+  ArenaAllocator<int> allocator(&arena);
+  std::vector<int, ArenaAllocator<int>> numbers(allocator);
+  for (int i = 0; i < 100; i++)
+    numbers.push_back(i);
+  EXPECT_EQ(99, numbers.back());
+  EXPECT_EQ(allocator, numbers.get_allocator());
+
+  using Map = std::map<int, int, std::less<int>,
+                       ArenaAllocator<std::pair<const int, int>>>;
+  Map map{ArenaAllocator<std::pair<const int, int>>(&arena)};
+  map[1] = 2;
+  map[3] = 4;
+  EXPECT_EQ(4, map[3]);
+  EXPECT_TRUE(ArenaAllocator<int>(map.get_allocator()) == allocator);
+
+  Arena other_arena;
+  EXPECT_NE(allocator, ArenaAllocator<int>(&other_arena));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,132 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides a |RefPtr| which can be loaded and replaced concurrently.
+
+#ifndef LIB_FTL_MEMORY_ATOMIC_REF_PTR_H_
+#define LIB_FTL_MEMORY_ATOMIC_REF_PTR_H_
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/epoch.h"
+
+namespace ftl {
+
+// A |RefPtr<T>| (for a |RefCountedThreadSafe| |T|) which threads may load,
+// store, exchange and compare-and-exchange concurrently without a lock, like
+// |std::atomic<std::shared_ptr<T>>|. E.g., to publish a new routing table
+// while readers take references they keep across tasks:
+//
+//   AtomicRefPtr<const RoutingTable> g_table;
+//
+//   // Reader:
+//   RefPtr<const RoutingTable> table = g_table.Load();
+//   task_runner->PostTask([table] { ... });
+//
+//   // Writer:
+//   g_table.Store(MakeRefCounted<const RoutingTable>(...));
+//
+// A reader loads the pointer inside an |Epoch|, and a replaced value's
+// reference is only released once no reader can still be about to add one
+// (see |Retire()|), so a |Load()| is just an epoch, a load and an increment.
+// (Replaced values may thus be destroyed a little later, on whichever thread
+// reclaims them. If readers only need the object briefly, |RcuPtr| is cheaper:
+// it has no reference count for every reader to write.)
+template <typename T>
+class AtomicRefPtr final {
+ public:
+  AtomicRefPtr() : ptr_(nullptr) {}
+  explicit AtomicRefPtr(RefPtr<T> value) : ptr_(Take(std::move(value))) {}
+
+  // Releases the current value immediately, so there may be no concurrent
+  // users left.
+  ~AtomicRefPtr() {
+    if (T* ptr = ptr_.load(std::memory_order_relaxed))
+      ptr->Release();
+  }
+
+  // Returns (a reference to) the current value, which may be null.
+  RefPtr<T> Load() const {
+    Epoch epoch;
+    return RefPtr<T>(ptr_.load(std::memory_order_acquire));
+  }
+
+  // Replaces the current value with |value|.
+  void Store(RefPtr<T> value) {
+    RetireReference(ptr_.exchange(Take(std::move(value)),
+                                  std::memory_order_acq_rel));
+  }
+
+  // Replaces the current value with |value|, returning the old value.
+  RefPtr<T> Exchange(RefPtr<T> value) {
+    T* old_ptr =
+        ptr_.exchange(Take(std::move(value)), std::memory_order_acq_rel);
+    // (Readers may still be about to add a reference to |old_ptr|, so its
+    // reference can't be handed over; add one for the caller instead.)
+    RefPtr<T> old_value(old_ptr);
+    RetireReference(old_ptr);
+    return old_value;
+  }
+
+  // If the current value is |*expected| (by identity), replaces it with
+  // |desired| and returns true; otherwise sets |*expected| to the current
+  // value and returns false. E.g., to update the value based on the current
+  // one:
+  //
+  //   RefPtr<const Table> table = g_table.Load();
+  //   while (!g_table.CompareExchange(&table, table->WithRoute(route))) {}
+  bool CompareExchange(RefPtr<T>* expected, RefPtr<T> desired) {
+    T* old_ptr = expected->get();
+    // (The reference for this object must be added before |desired_ptr| is
+    // published: once it is, another thread may replace it, and retire that
+    // reference.)
+    T* const desired_ptr = Take(std::move(desired));
+    {
+      Epoch epoch;
+      if (!ptr_.compare_exchange_strong(old_ptr, desired_ptr,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+        *expected = RefPtr<T>(old_ptr);
+        if (desired_ptr)
+          desired_ptr->Release();
+        return false;
+      }
+    }
+    RetireReference(old_ptr);
+    return true;
+  }
+
+ private:
+  using MutableT = typename std::remove_cv<T>::type;
+
+  // Returns |value|'s pointer, with a reference for this object.
+  static T* Take(RefPtr<T> value) {
+    T* ptr = value.get();
+    if (ptr)
+      ptr->AddRef();
+    return ptr;
+  }
+
+  // Releases this object's reference to |ptr| once no reader can be using
+  // it.
+  static void RetireReference(T* ptr) {
+    if (!ptr)
+      return;
+    internal::RetireObject(const_cast<MutableT*>(ptr), [](void* to_release) {
+      static_cast<MutableT*>(to_release)->Release();
+    });
+  }
+
+  std::atomic<T*> ptr_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(AtomicRefPtr);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_MEMORY_ATOMIC_REF_PTR_H_
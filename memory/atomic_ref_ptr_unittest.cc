@@ -0,0 +1,158 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/atomic_ref_ptr.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/memory/ref_counted.h"
+
+namespace ftl {
+namespace {
+
+std::atomic<int> g_live_tables(0);
+
+// Fields that are always equal, unless a reader sees a destroyed version.
+class Table : public RefCountedThreadSafe<Table> {
+ public:
+  int64_t a;
+  int64_t b;
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(Table);
+  FRIEND_MAKE_REF_COUNTED(Table);
+
+  explicit Table(int64_t value) : a(value), b(value) { g_live_tables++; }
+  ~Table() {
+    a = -1;
+    b = -2;
+    g_live_tables--;
+  }
+};
+
+TEST(AtomicRefPtrTest, Basic) {
+  {
+    AtomicRefPtr<const Table> ptr;
+    EXPECT_FALSE(ptr.Load());
+
+    RefPtr<const Table> one = MakeRefCounted<Table>(1);
+    ptr.Store(one);
+    EXPECT_EQ(one, ptr.Load());
+
+    RefPtr<const Table> old = ptr.Exchange(MakeRefCounted<Table>(2));
+    EXPECT_EQ(one, old);
+    EXPECT_EQ(2, ptr.Load()->a);
+
+    // A stale expectation fails, and is updated.
+    RefPtr<const Table> expected = one;
+    EXPECT_FALSE(ptr.CompareExchange(&expected, MakeRefCounted<Table>(3)));
+    EXPECT_EQ(2, expected->a);
+    EXPECT_TRUE(ptr.CompareExchange(&expected, MakeRefCounted<Table>(3)));
+    EXPECT_EQ(3, ptr.Load()->a);
+
+    ptr.Store(nullptr);
+    EXPECT_FALSE(ptr.Load());
+    old = nullptr;
+    expected = nullptr;
+    SynchronizeEpochs();
+    // Only |one| is left.
+    EXPECT_EQ(1, g_live_tables.load());
+    ptr.Store(std::move(one));
+  }
+  SynchronizeEpochs();
+  EXPECT_EQ(0, g_live_tables.load());
+}
+
+TEST(AtomicRefPtrTest, ConcurrentReadersAndWriters) {
+  constexpr int kNumReaders = 4;
+  constexpr int kNumWriters = 2;
+  constexpr int64_t kNumUpdates = 2000;
+  {
+    AtomicRefPtr<const Table> ptr(MakeRefCounted<Table>(0));
+    std::atomic<int> writers_done(0);
+    std::atomic<int64_t> increments(0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumWriters; i++) {
+      threads.push_back(std::thread([&ptr, &writers_done, &increments]() {
+        for (int64_t j = 1; j <= kNumUpdates; j++) {
+          if (j % 2) {
+            ptr.Store(MakeRefCounted<Table>(j));
+            continue;
+          }
+          RefPtr<const Table> table = ptr.Load();
+          while (!ptr.CompareExchange(&table,
+                                      MakeRefCounted<Table>(table->a + 1))) {
+          }
+          increments++;
+        }
+        writers_done.fetch_add(1);
+      }));
+    }
+    for (int i = 0; i < kNumReaders; i++) {
+      threads.push_back(std::thread([&ptr, &writers_done]() {
+        // Hold on to some tables for a while, as if across tasks.
+        std::vector<RefPtr<const Table>> held;
+        while (writers_done.load() < kNumWriters) {
+          RefPtr<const Table> table = ptr.Load();
+          ASSERT_TRUE(table);
+          EXPECT_GE(table->a, 0);
+          EXPECT_EQ(table->a, table->b);
+          held.push_back(std::move(table));
+          if (held.size() == 100u) {
+            for (const auto& old : held)
+              EXPECT_EQ(old->a, old->b);
+            held.clear();
+          }
+        }
+      }));
+    }
+    for (auto& thread : threads)
+      thread.join();
+    EXPECT_EQ(kNumWriters * kNumUpdates / 2, increments.load());
+  }
+  // Each thread's retired tables were reclaimed (or orphaned, and reclaimed
+  // here) when it exited.
+  SynchronizeEpochs();
+  EXPECT_EQ(0, g_live_tables.load());
+}
+
+TEST(AtomicRefPtrTest, ConcurrentCompareExchangeAndStore) {
+  // Values published by |CompareExchange()| are replaced (and reclaimed) as
+  // soon as possible, by other threads.
+  constexpr int kNumThreads = 4;
+  constexpr int kNumUpdates = 5000;
+  {
+    AtomicRefPtr<const Table> ptr(MakeRefCounted<Table>(0));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++) {
+      threads.push_back(std::thread([&ptr, i]() {
+        for (int j = 1; j <= kNumUpdates; j++) {
+          if (i % 2) {
+            ptr.Store(MakeRefCounted<Table>(j));
+            SynchronizeEpochs();
+            continue;
+          }
+          RefPtr<const Table> table = ptr.Load();
+          ptr.CompareExchange(&table, MakeRefCounted<Table>(j));
+          EXPECT_EQ(table->a, table->b);
+        }
+      }));
+    }
+    for (auto& thread : threads)
+      thread.join();
+    RefPtr<const Table> table = ptr.Load();
+    EXPECT_EQ(table->a, table->b);
+  }
+  SynchronizeEpochs();
+  EXPECT_EQ(0, g_live_tables.load());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,71 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Helpers for keeping data written by different threads on different cache
+// lines (so that they don't slow each other down by "false sharing").
+
+#ifndef LIB_FTL_MEMORY_CACHE_LINE_PADDED_H_
+#define LIB_FTL_MEMORY_CACHE_LINE_PADDED_H_
+
+#include <stddef.h>
+
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/compiler_specific.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+constexpr size_t kCacheLineSize = FTL_CACHELINE_SIZE;
+
+// What the standard library's |std::hardware_destructive_interference_size| and
+// |std::hardware_constructive_interference_size| would be (which not all of our
+// standard libraries have, and whose values may vary with compiler flags, so
+// shouldn't be used in headers).
+constexpr size_t kHardwareDestructiveInterferenceSize = kCacheLineSize;
+constexpr size_t kHardwareConstructiveInterferenceSize = kCacheLineSize;
+
+// A |T| padded to a whole number of cache lines, so that an array of them (or
+// whatever follows one in a struct) doesn't share its lines, e.g.:
+//
+//   CacheLinePadded<std::atomic<uint64_t>> counts_[kShardCount];
+//   ...
+//   counts_[shard]->fetch_add(1u, std::memory_order_relaxed);
+//
+// It's padded rather than aligned (see |FTL_CACHELINE_ALIGNED|), so that it
+// can be allocated with |new|. (So its first line may be shared with what
+// precedes it.) Default construction value-initializes the |T| (so, e.g.,
+// atomics are zeroed).
+template <typename T>
+class CacheLinePadded final {
+ public:
+  CacheLinePadded() : value_() {}
+  template <typename... Args>
+  explicit CacheLinePadded(Args&&... args)
+      : value_(std::forward<Args>(args)...) {}
+  ~CacheLinePadded() { value_.~T(); }
+
+  T* get() { return &value_; }
+  const T* get() const { return &value_; }
+
+  T& operator*() { return value_; }
+  const T& operator*() const { return value_; }
+
+  T* operator->() { return &value_; }
+  const T* operator->() const { return &value_; }
+
+ private:
+  union {
+    T value_;
+    char storage_[(sizeof(T) + kCacheLineSize - 1u) / kCacheLineSize *
+                  kCacheLineSize];
+  };
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CacheLinePadded);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_MEMORY_CACHE_LINE_PADDED_H_
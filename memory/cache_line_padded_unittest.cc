@@ -0,0 +1,54 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/cache_line_padded.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+struct TwoLines {
+  char bytes[kCacheLineSize + 1u];
+};
+
+static_assert(sizeof(CacheLinePadded<char>) == kCacheLineSize, "");
+static_assert(sizeof(CacheLinePadded<std::atomic<uint64_t>>) == kCacheLineSize,
+              "");
+static_assert(sizeof(CacheLinePadded<TwoLines>) == 2u * kCacheLineSize, "");
+static_assert(kHardwareDestructiveInterferenceSize >= kCacheLineSize, "");
+
+TEST(CacheLinePadded, ValueInitialized) {
+  CacheLinePadded<std::atomic<uint64_t>> counts[4];
+  for (const auto& count : counts)
+    EXPECT_EQ(0u, count->load());
+  counts[1]->fetch_add(2u);
+  EXPECT_EQ(2u, counts[1]->load());
+  EXPECT_EQ(0u, counts[0]->load());
+  EXPECT_EQ(kCacheLineSize, reinterpret_cast<uintptr_t>(counts[1].get()) -
+                                reinterpret_cast<uintptr_t>(counts[0].get()));
+}
+
+TEST(CacheLinePadded, Constructs) {
+  std::unique_ptr<CacheLinePadded<std::string>> padded(
+      new CacheLinePadded<std::string>(3u, 'x'));
+  EXPECT_EQ("xxx", **padded);
+  EXPECT_EQ(3u, (*padded)->size());
+  padded->get()->append("y");
+  EXPECT_EQ("xxxy", *padded->get());
+}
+
+TEST(CacheLinePadded, Aligned) {
+  FTL_CACHELINE_ALIGNED char byte = 0;
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(&byte) % kCacheLineSize);
+}
+
+}  // namespace
+}  // namespace ftl
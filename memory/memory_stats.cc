@@ -0,0 +1,188 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/memory_stats.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/files/unique_fd.h"
+#elif defined(OS_MACOSX)
+#include <mach/mach.h>
+#endif
+
+namespace ftl {
+namespace {
+
+struct Registry {
+  Mutex mutex;
+  std::vector<const MemoryStatsSource*> sources FTL_GUARDED_BY(mutex);
+};
+
+// Never destroyed, since sources may be registered by objects which are.
+Registry* GetRegistry() {
+  static Registry* registry = new Registry();
+  return registry;
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+// Both files are about 1 KiB.
+constexpr size_t kProcFileBufferSize = 4096u;
+
+// Reads (up to |kProcFileBufferSize| bytes of) the file at |path| into
+// |buffer|, returning its contents, or an empty view on error.
+StringView ReadProcFile(const char* path, char* buffer) {
+  UniqueFD fd(HANDLE_EINTR(open(path, O_RDONLY | O_CLOEXEC)));
+  if (!fd.is_valid())
+    return StringView();
+  size_t size = 0u;
+  while (size < kProcFileBufferSize) {
+    ssize_t result = HANDLE_EINTR(
+        read(fd.get(), buffer + size, kProcFileBufferSize - size));
+    if (result < 0)
+      return StringView();
+    if (result == 0)
+      break;
+    size += static_cast<size_t>(result);
+  }
+  return StringView(buffer, size);
+}
+
+// Calls |fn(key, bytes)| for each "Key:   123 kB" line of |contents|.
+template <typename Fn>
+void ForEachKilobyteField(StringView contents, Fn fn) {
+  while (!contents.empty()) {
+    size_t end = contents.find('\n');
+    StringView line = contents.substr(0u, end);
+    contents =
+        end == StringView::npos ? StringView() : contents.substr(end + 1u);
+    if (!line.ends_with(" kB"))
+      continue;
+    size_t colon = line.find(':');
+    if (colon == StringView::npos)
+      continue;
+    uint64_t kilobytes = 0u;
+    for (char c : line.substr(colon + 1u)) {
+      if (c >= '0' && c <= '9')
+        kilobytes = kilobytes * 10u + static_cast<uint64_t>(c - '0');
+    }
+    fn(line.substr(0u, colon), kilobytes * 1024u);
+  }
+}
+
+bool GetProcessMemoryStats(MemoryStats* stats) {
+  char buffer[kProcFileBufferSize];
+  StringView contents = ReadProcFile("/proc/self/smaps_rollup", buffer);
+  if (!contents.empty()) {
+    ForEachKilobyteField(contents, [stats](StringView key, uint64_t bytes) {
+      if (key == "Rss")
+        stats->resident_bytes = bytes;
+      else if (key == "Pss")
+        stats->proportional_bytes = bytes;
+      else if (key == "Anonymous")
+        stats->anonymous_bytes = bytes;
+      else if (key == "Swap")
+        stats->swap_bytes = bytes;
+    });
+    stats->file_bytes =
+        stats->resident_bytes -
+        std::min(stats->anonymous_bytes, stats->resident_bytes);
+    return stats->resident_bytes > 0u;
+  }
+
+  // Before Linux 4.14.
+  contents = ReadProcFile("/proc/self/status", buffer);
+  ForEachKilobyteField(contents, [stats](StringView key, uint64_t bytes) {
+    if (key == "VmRSS")
+      stats->resident_bytes = bytes;
+    else if (key == "RssAnon")
+      stats->anonymous_bytes = bytes;
+    else if (key == "RssFile" || key == "RssShmem")
+      stats->file_bytes += bytes;
+    else if (key == "VmSwap")
+      stats->swap_bytes = bytes;
+  });
+  return stats->resident_bytes > 0u;
+}
+
+#elif defined(OS_MACOSX)
+
+bool GetProcessMemoryStats(MemoryStats* stats) {
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+    return false;
+  stats->resident_bytes = info.resident_size;
+  return true;
+}
+
+#else
+
+bool GetProcessMemoryStats(MemoryStats* stats) {
+  return false;
+}
+
+#endif
+
+}  // namespace
+
+MemoryStatsSource::MemoryStatsSource(std::string name,
+                                     std::function<uint64_t()> bytes)
+    : name_(std::move(name)), bytes_(std::move(bytes)) {
+  FTL_DCHECK(bytes_);
+  Registry* registry = GetRegistry();
+  MutexLocker locker(&registry->mutex);
+  registry->sources.push_back(this);
+}
+
+MemoryStatsSource::~MemoryStatsSource() {
+  Registry* registry = GetRegistry();
+  MutexLocker locker(&registry->mutex);
+  auto it =
+      std::find(registry->sources.begin(), registry->sources.end(), this);
+  FTL_DCHECK(it != registry->sources.end());
+  registry->sources.erase(it);
+}
+
+bool GetMemoryStats(MemoryStats* stats) {
+  FTL_DCHECK(stats);
+  *stats = MemoryStats();
+  const bool result = GetProcessMemoryStats(stats);
+
+  std::vector<MemoryStats::Source> sources;
+  {
+    Registry* registry = GetRegistry();
+    MutexLocker locker(&registry->mutex);
+    sources.reserve(registry->sources.size());
+    for (const MemoryStatsSource* source : registry->sources)
+      sources.push_back({source->name_, source->bytes_()});
+  }
+  std::stable_sort(
+      sources.begin(), sources.end(),
+      [](const MemoryStats::Source& a, const MemoryStats::Source& b) {
+        return a.name < b.name;
+      });
+  for (MemoryStats::Source& source : sources) {
+    if (!stats->sources.empty() && stats->sources.back().name == source.name)
+      stats->sources.back().bytes += source.bytes;
+    else
+      stats->sources.push_back(std::move(source));
+  }
+  return result;
+}
+
+}  // namespace ftl
@@ -0,0 +1,83 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_MEMORY_MEMORY_STATS_H_
+#define LIB_FTL_MEMORY_MEMORY_STATS_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// How much memory the process uses, according to the OS, and how much of it
+// is held by the (registered) users of memory within it, e.g., to set cache
+// budgets, or to export as metrics to catch bloat without heap profiling:
+//
+//   MemoryStats stats;
+//   if (GetMemoryStats(&stats) && stats.resident_bytes > kBudget)
+//     cache->set_max_bytes(cache->max_bytes() / 2u);
+//
+// The process's numbers come from /proc/self/smaps_rollup (or, before Linux
+// 4.14, /proc/self/status, which has no PSS) on Linux, and |task_info()| on
+// Mac (which has only the resident size); the others are zero where they're
+// unknown. They're read without allocating.
+struct MemoryStats {
+  // The resident set size (RSS).
+  uint64_t resident_bytes = 0u;
+  // The proportional set size (PSS): resident memory, with shared pages
+  // divided between the processes sharing them.
+  uint64_t proportional_bytes = 0u;
+  // The resident anonymous (e.g., heap and stack) memory, and the rest
+  // (mapped files, including shared memory).
+  uint64_t anonymous_bytes = 0u;
+  uint64_t file_bytes = 0u;
+  uint64_t swap_bytes = 0u;
+
+  // What each |MemoryStatsSource| reported, by name (adding up sources with
+  // the same name), in order of name.
+  struct Source {
+    std::string name;
+    uint64_t bytes;
+  };
+  std::vector<Source> sources;
+};
+
+// Fills in |*stats|. Returns false if the process's numbers couldn't be read
+// (the sources are still filled in).
+FTL_EXPORT bool GetMemoryStats(MemoryStats* stats);
+
+// Registers |bytes| (a function returning a number of bytes, e.g., an arena's
+// or a cache's size) under |name|, to be reported by |GetMemoryStats()|, until
+// this is destroyed. Within the library, |Arena|s and |files::FileCache|s (if
+// given a |memory_stats_name| option), |FTL_POOL_ALLOCATED| classes'
+// pools ("ftl.pool_allocated") and asynchronous logging's buffers
+// ("ftl.log_buffers") are registered.
+//
+// |bytes| is called on the thread calling |GetMemoryStats()|, with a lock held
+// (which this class's destructor also takes, so it isn't called after that
+// returns), so it must be thread-safe, and mustn't register or unregister a
+// source.
+class FTL_EXPORT MemoryStatsSource final {
+ public:
+  MemoryStatsSource(std::string name, std::function<uint64_t()> bytes);
+  ~MemoryStatsSource();
+
+ private:
+  friend bool GetMemoryStats(MemoryStats* stats);
+
+  const std::string name_;
+  const std::function<uint64_t()> bytes_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MemoryStatsSource);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_MEMORY_MEMORY_STATS_H_
@@ -0,0 +1,95 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/memory_stats.h"
+
+#include <string.h>
+
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/memory/arena.h"
+
+namespace ftl {
+namespace {
+
+const MemoryStats::Source* FindSource(const MemoryStats& stats,
+                                      const std::string& name) {
+  for (const auto& source : stats.sources) {
+    if (source.name == name)
+      return &source;
+  }
+  return nullptr;
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+TEST(MemoryStats, Process) {
+  MemoryStats before;
+  ASSERT_TRUE(GetMemoryStats(&before));
+  EXPECT_GT(before.resident_bytes, 0u);
+  EXPECT_GT(before.anonymous_bytes, 0u);
+  EXPECT_LE(before.anonymous_bytes, before.resident_bytes);
+  EXPECT_LE(before.anonymous_bytes + before.file_bytes,
+            before.resident_bytes + 4096u);
+
+  // Touching 64 MiB of heap shows up.
+  constexpr size_t kSize = 64u * 1024u * 1024u;
+  std::unique_ptr<char[]> memory(new char[kSize]);
+  memset(memory.get(), 1, kSize);
+  MemoryStats after;
+  ASSERT_TRUE(GetMemoryStats(&after));
+  EXPECT_GE(after.resident_bytes, before.resident_bytes + kSize / 2u);
+  EXPECT_GE(after.anonymous_bytes, before.anonymous_bytes + kSize / 2u);
+}
+#endif
+
+TEST(MemoryStats, Sources) {
+  MemoryStats stats;
+  GetMemoryStats(&stats);
+  EXPECT_FALSE(FindSource(stats, "test.a"));
+
+  uint64_t a_bytes = 10u;
+  {
+    MemoryStatsSource a("test.a", [&a_bytes] { return a_bytes; });
+    MemoryStatsSource b1("test.b", [] { return uint64_t(1); });
+    MemoryStatsSource b2("test.b", [] { return uint64_t(2); });
+    GetMemoryStats(&stats);
+    ASSERT_TRUE(FindSource(stats, "test.a"));
+    EXPECT_EQ(10u, FindSource(stats, "test.a")->bytes);
+    a_bytes = 20u;
+    GetMemoryStats(&stats);
+    EXPECT_EQ(20u, FindSource(stats, "test.a")->bytes);
+    // Sources with the same name are added up.
+    ASSERT_TRUE(FindSource(stats, "test.b"));
+    EXPECT_EQ(3u, FindSource(stats, "test.b")->bytes);
+    for (size_t i = 1u; i < stats.sources.size(); i++)
+      EXPECT_LT(stats.sources[i - 1u].name, stats.sources[i].name);
+  }
+  GetMemoryStats(&stats);
+  EXPECT_FALSE(FindSource(stats, "test.a"));
+  EXPECT_FALSE(FindSource(stats, "test.b"));
+}
+
+TEST(MemoryStats, Arena) {
+  Arena::Options options;
+  options.memory_stats_name = "test.arena";
+  Arena arena(options);
+  arena.Allocate(100000u);
+  MemoryStats stats;
+  GetMemoryStats(&stats);
+  ASSERT_TRUE(FindSource(stats, "test.arena"));
+  EXPECT_EQ(arena.bytes_reserved(), FindSource(stats, "test.arena")->bytes);
+  EXPECT_GE(arena.bytes_reserved(), 100000u);
+
+  // Unnamed arenas aren't reported.
+  Arena unnamed;
+  unnamed.Allocate(1u);
+  MemoryStats unchanged;
+  GetMemoryStats(&unchanged);
+  EXPECT_EQ(stats.sources.size(), unchanged.sources.size());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,243 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/object_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+namespace internal {
+
+// The state of a pool which the threads' caches share (and which outlives the
+// |ObjectPool| if they still have objects from it).
+class ObjectPoolShared : public RefCountedThreadSafe<ObjectPoolShared> {
+ public:
+  using DestroyFunction = void (*)(void* object);
+
+  // Returns a free object, or null if there aren't any.
+  void* Take() {
+    MutexLocker locker(&mutex_);
+    if (objects_.empty())
+      return nullptr;
+    void* object = objects_.back();
+    objects_.pop_back();
+    return object;
+  }
+
+  // Keeps |objects| for reuse, up to |max_shared_|, and destroys the rest (or
+  // all of them, once closed).
+  void Give(void* const* objects, size_t count) {
+    size_t kept = 0u;
+    {
+      MutexLocker locker(&mutex_);
+      if (!closed_.load(std::memory_order_relaxed)) {
+        kept = std::min(count, max_shared_ - std::min(max_shared_,
+                                                      objects_.size()));
+        objects_.insert(objects_.end(), objects, objects + kept);
+      }
+    }
+    // (Destroyed outside the lock, since that may be slow.)
+    for (size_t i = kept; i < count; i++)
+      destroy_(objects[i]);
+  }
+
+  // Destroys the free objects.
+  void Trim() {
+    std::vector<void*> objects;
+    {
+      MutexLocker locker(&mutex_);
+      objects.swap(objects_);
+    }
+    DestroyAll(&objects);
+  }
+
+  // Destroys the free objects, and any given back from now on.
+  void Close() {
+    std::vector<void*> objects;
+    {
+      MutexLocker locker(&mutex_);
+      closed_.store(true, std::memory_order_relaxed);
+      objects.swap(objects_);
+    }
+    DestroyAll(&objects);
+  }
+
+  // Returns true if |Close()| has been called. As a hint, this may be checked
+  // without the lock.
+  bool is_closed() const { return closed_.load(std::memory_order_relaxed); }
+
+  size_t max_cached_per_thread() const { return max_cached_per_thread_; }
+
+  void DestroyAll(std::vector<void*>* objects) {
+    for (void* object : *objects)
+      destroy_(object);
+    objects->clear();
+  }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(ObjectPoolShared);
+  FRIEND_MAKE_REF_COUNTED(ObjectPoolShared);
+
+  ObjectPoolShared(size_t max_cached_per_thread,
+                   size_t max_shared,
+                   DestroyFunction destroy)
+      : max_cached_per_thread_(max_cached_per_thread),
+        max_shared_(max_shared),
+        destroy_(destroy),
+        closed_(false) {
+    FTL_DCHECK(destroy_);
+  }
+
+  ~ObjectPoolShared() { FTL_DCHECK(objects_.empty()); }
+
+  const size_t max_cached_per_thread_;
+  const size_t max_shared_;
+  const DestroyFunction destroy_;
+
+  Mutex mutex_;
+  std::vector<void*> objects_ FTL_GUARDED_BY(mutex_);
+  // (Only written with |mutex_| held.)
+  std::atomic<bool> closed_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectPoolShared);
+};
+
+namespace {
+
+// A thread's free objects for one pool.
+struct CacheEntry {
+  RefPtr<ObjectPoolShared> pool;
+  std::vector<void*> objects;
+};
+
+// A thread's caches, which are given back to the pools when it exits.
+class ThreadCaches {
+ public:
+  ThreadCaches() {}
+
+  ~ThreadCaches() {
+    for (auto& entry : entries_)
+      entry.pool->Give(entry.objects.data(), entry.objects.size());
+  }
+
+  // Returns the cache for |pool|, or null if there isn't one.
+  CacheEntry* Find(ObjectPoolShared* pool) {
+    for (auto& entry : entries_) {
+      if (entry.pool.get() == pool)
+        return &entry;
+    }
+    return nullptr;
+  }
+
+  CacheEntry* FindOrAdd(ObjectPoolShared* pool) {
+    if (CacheEntry* entry = Find(pool))
+      return entry;
+    // Drop the caches of pools that have since been destroyed.
+    auto closed = std::partition(
+        entries_.begin(), entries_.end(),
+        [](const CacheEntry& entry) { return !entry.pool->is_closed(); });
+    for (auto it = closed; it != entries_.end(); ++it)
+      it->pool->DestroyAll(&it->objects);
+    entries_.erase(closed, entries_.end());
+
+    entries_.push_back(CacheEntry{RefPtr<ObjectPoolShared>(pool), {}});
+    entries_.back().objects.reserve(pool->max_cached_per_thread());
+    return &entries_.back();
+  }
+
+ private:
+  std::vector<CacheEntry> entries_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadCaches);
+};
+
+thread_local ThreadCaches* g_thread_caches = nullptr;
+// Set once the current thread's caches have been destroyed (during thread
+// exit).
+thread_local bool g_thread_caches_destroyed = false;
+
+// Owns the current thread's |ThreadCaches|.
+class ThreadCachesOwner final {
+ public:
+  ThreadCachesOwner() { g_thread_caches = &caches_; }
+  ~ThreadCachesOwner() {
+    g_thread_caches = nullptr;
+    g_thread_caches_destroyed = true;
+  }
+
+ private:
+  ThreadCaches caches_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadCachesOwner);
+};
+
+// Returns the current thread's caches, or null if they have already been
+// destroyed.
+ThreadCaches* GetThreadCaches() {
+  if (!g_thread_caches && !g_thread_caches_destroyed) {
+    static thread_local ThreadCachesOwner owner;
+  }
+  return g_thread_caches;
+}
+
+}  // namespace
+
+ObjectPoolBase::ObjectPoolBase(size_t max_cached_per_thread,
+                               size_t max_shared,
+                               DestroyFunction destroy)
+    : shared_(MakeRefCounted<ObjectPoolShared>(max_cached_per_thread,
+                                               max_shared,
+                                               destroy)) {}
+
+ObjectPoolBase::~ObjectPoolBase() {
+  if (ThreadCaches* caches = GetThreadCaches()) {
+    if (CacheEntry* entry = caches->Find(shared_.get()))
+      shared_->DestroyAll(&entry->objects);
+  }
+  shared_->Close();
+}
+
+void ObjectPoolBase::Trim() {
+  if (ThreadCaches* caches = GetThreadCaches()) {
+    if (CacheEntry* entry = caches->Find(shared_.get()))
+      shared_->DestroyAll(&entry->objects);
+  }
+  shared_->Trim();
+}
+
+void* ObjectPoolBase::TakeFree() {
+  if (ThreadCaches* caches = GetThreadCaches()) {
+    CacheEntry* entry = caches->Find(shared_.get());
+    if (entry && !entry->objects.empty()) {
+      void* object = entry->objects.back();
+      entry->objects.pop_back();
+      return object;
+    }
+  }
+  return shared_->Take();
+}
+
+void ObjectPoolBase::GiveBack(void* object) {
+  FTL_DCHECK(object);
+  if (shared_->max_cached_per_thread()) {
+    if (ThreadCaches* caches = GetThreadCaches()) {
+      CacheEntry* entry = caches->FindOrAdd(shared_.get());
+      if (entry->objects.size() < shared_->max_cached_per_thread()) {
+        entry->objects.push_back(object);
+        return;
+      }
+    }
+  }
+  shared_->Give(&object, 1u);
+}
+
+}  // namespace internal
+}  // namespace ftl
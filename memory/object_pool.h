@@ -0,0 +1,126 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides a pool of reusable objects, with per-thread caches.
+
+#ifndef LIB_FTL_MEMORY_OBJECT_POOL_H_
+#define LIB_FTL_MEMORY_OBJECT_POOL_H_
+
+#include <stddef.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/memory/unique_object.h"
+
+namespace ftl {
+namespace internal {
+
+class ObjectPoolShared;
+
+// The type-independent part of |ObjectPool<T>|.
+class FTL_EXPORT ObjectPoolBase {
+ public:
+  // Destroys the objects in the shared list and in the current thread's cache.
+  void Trim();
+
+ protected:
+  using DestroyFunction = void (*)(void* object);
+
+  ObjectPoolBase(size_t max_cached_per_thread,
+                 size_t max_shared,
+                 DestroyFunction destroy);
+  ~ObjectPoolBase();
+
+  // Returns a free object, or null if there aren't any.
+  void* TakeFree();
+  // Gives |object| back, to be reused or (if there are too many free objects)
+  // destroyed.
+  void GiveBack(void* object);
+
+ private:
+  RefPtr<ObjectPoolShared> shared_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectPoolBase);
+};
+
+}  // namespace internal
+
+// A pool of |T|s (which are default-constructed when the pool is empty), for
+// objects which are expensive to make ready for use, e.g., large buffers which
+// would be page-faulted in anew each time. |Take()| returns a |UniqueObject|
+// handle which gives the object back when it's destroyed:
+//
+//   ObjectPool<std::vector<char>> buffers;
+//   ...
+//   ObjectPool<std::vector<char>>::Handle buffer = buffers.Take();
+//   buffer.get()->resize(kBufferSize);
+//   ReadInto(buffer.get());
+//
+// Objects are reused as they were given back (e.g., with their contents), so
+// the user must reset whatever state they rely on.
+//
+// Objects may be taken and given back on any thread: each thread keeps up to
+// |max_cached_per_thread| free objects for the pool, and beyond that they go
+// to a shared list (which takes a lock) of up to |max_shared|; objects beyond
+// that are destroyed, so that a burst of use doesn't keep memory in the pool
+// indefinitely. A thread's cached objects are given back when it exits.
+//
+// Handles must not outlive the pool. When the pool is destroyed, the objects
+// cached by other (still-running) threads are destroyed when those threads
+// exit (or next add a pool to their caches).
+template <typename T>
+class ObjectPool final : public internal::ObjectPoolBase {
+ public:
+  // The |UniqueObject| traits for |Handle|s.
+  class Traits {
+   public:
+    Traits() : pool_(nullptr) {}
+    explicit Traits(ObjectPool* pool) : pool_(pool) {}
+
+    static T* InvalidValue() { return nullptr; }
+    static bool IsValid(T* object) { return !!object; }
+    void Free(T* object) {
+      FTL_DCHECK(pool_);
+      pool_->GiveBack(object);
+    }
+
+    ObjectPool* pool() const { return pool_; }
+
+   private:
+    ObjectPool* pool_;
+  };
+
+  using Handle = UniqueObject<T*, Traits>;
+
+  static constexpr size_t kDefaultMaxCachedPerThread = 4u;
+  static constexpr size_t kDefaultMaxShared = 16u;
+
+  explicit ObjectPool(size_t max_cached_per_thread = kDefaultMaxCachedPerThread,
+                      size_t max_shared = kDefaultMaxShared)
+      : ObjectPoolBase(max_cached_per_thread, max_shared, &Destroy) {}
+
+  // Returns a free object, or a new one if there aren't any.
+  Handle Take() {
+    T* object = static_cast<T*>(TakeFree());
+    if (!object)
+      object = new T();
+    return Handle(object, Traits(this));
+  }
+
+ private:
+  static void Destroy(void* object) { delete static_cast<T*>(object); }
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ObjectPool);
+};
+
+template <typename T>
+constexpr size_t ObjectPool<T>::kDefaultMaxCachedPerThread;
+template <typename T>
+constexpr size_t ObjectPool<T>::kDefaultMaxShared;
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_MEMORY_OBJECT_POOL_H_
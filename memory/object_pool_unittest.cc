@@ -0,0 +1,154 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/object_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumThreads = 8;
+constexpr int kNumTakes = 10000;
+
+std::atomic<int> g_live_buffers(0);
+
+struct Buffer {
+  Buffer() { g_live_buffers++; }
+  ~Buffer() { g_live_buffers--; }
+
+  std::vector<char> data;
+};
+
+using BufferPool = ObjectPool<Buffer>;
+
+TEST(ObjectPoolTest, ReusesObjects) {
+  {
+    BufferPool pool;
+    Buffer* buffer;
+    {
+      BufferPool::Handle handle = pool.Take();
+      ASSERT_TRUE(handle.is_valid());
+      buffer = handle.get();
+      buffer->data.resize(1000u);
+    }
+    EXPECT_EQ(1, g_live_buffers.load());
+
+    BufferPool::Handle handle = pool.Take();
+    EXPECT_EQ(buffer, handle.get());
+    EXPECT_EQ(1000u, handle.get()->data.size());
+    BufferPool::Handle other = pool.Take();
+    EXPECT_NE(buffer, other.get());
+    EXPECT_EQ(2, g_live_buffers.load());
+
+    // Handles may be moved (with their pool).
+    BufferPool::Handle moved;
+    moved = std::move(handle);
+    EXPECT_FALSE(handle.is_valid());
+    EXPECT_EQ(buffer, moved.get());
+    EXPECT_EQ(&pool, moved.get_traits().pool());
+    BufferPool::Handle moved_again(std::move(moved));
+    EXPECT_EQ(buffer, moved_again.get());
+  }
+  EXPECT_EQ(0, g_live_buffers.load());
+}
+
+TEST(ObjectPoolTest, DestroysExcessObjects) {
+  BufferPool pool(2u, 3u);
+  {
+    std::vector<BufferPool::Handle> handles;
+    for (int i = 0; i < 10; i++)
+      handles.push_back(pool.Take());
+    EXPECT_EQ(10, g_live_buffers.load());
+  }
+  // Two are cached by this thread, and three shared.
+  EXPECT_EQ(5, g_live_buffers.load());
+
+  pool.Trim();
+  EXPECT_EQ(0, g_live_buffers.load());
+}
+
+TEST(ObjectPoolTest, NoThreadCache) {
+  BufferPool pool(0u, 1u);
+  { BufferPool::Handle handle = pool.Take(); }
+  EXPECT_EQ(1, g_live_buffers.load());
+  // Another thread gets the shared object.
+  std::thread([&pool] {
+    BufferPool::Handle handle = pool.Take();
+    EXPECT_EQ(1, g_live_buffers.load());
+  }).join();
+  EXPECT_EQ(1, g_live_buffers.load());
+  pool.Trim();
+  EXPECT_EQ(0, g_live_buffers.load());
+}
+
+TEST(ObjectPoolTest, ThreadExitGivesBackCachedObjects) {
+  BufferPool pool(4u, 16u);
+  std::thread([&pool] {
+    std::vector<BufferPool::Handle> handles;
+    for (int i = 0; i < 4; i++)
+      handles.push_back(pool.Take());
+  }).join();
+  EXPECT_EQ(4, g_live_buffers.load());
+
+  std::vector<BufferPool::Handle> handles;
+  for (int i = 0; i < 4; i++)
+    handles.push_back(pool.Take());
+  EXPECT_EQ(4, g_live_buffers.load());
+  handles.clear();
+  pool.Trim();
+  EXPECT_EQ(0, g_live_buffers.load());
+}
+
+TEST(ObjectPoolTest, DestroyedWhileCachedOnAnotherThread) {
+  std::unique_ptr<BufferPool> pool(new BufferPool());
+  AutoResetWaitableEvent cached;
+  AutoResetWaitableEvent destroyed;
+  std::thread thread([&] {
+    { BufferPool::Handle handle = pool->Take(); }
+    cached.Signal();
+    destroyed.Wait();
+  });
+  cached.Wait();
+  pool.reset();
+  EXPECT_EQ(1, g_live_buffers.load());
+  destroyed.Signal();
+  thread.join();
+  EXPECT_EQ(0, g_live_buffers.load());
+}
+
+TEST(ObjectPoolTest, ManyThreads) {
+  {
+    BufferPool pool;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; i++) {
+      threads.push_back(std::thread([&pool]() {
+        std::vector<BufferPool::Handle> handles;
+        for (int j = 0; j < kNumTakes; j++) {
+          handles.push_back(pool.Take());
+          handles.back().get()->data.assign(16u, 'x');
+          if (handles.size() > 6u)
+            handles.erase(handles.begin());
+        }
+        // Give some back on another thread.
+        std::thread([handles = std::move(handles)]() {}).join();
+      }));
+    }
+    for (auto& thread : threads)
+      thread.join();
+    EXPECT_LE(g_live_buffers.load(),
+              static_cast<int>(BufferPool::kDefaultMaxShared));
+  }
+  EXPECT_EQ(0, g_live_buffers.load());
+}
+
+}  // namespace
+}  // namespace ftl
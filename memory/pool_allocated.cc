@@ -0,0 +1,233 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/pool_allocated.h"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "lib/ftl/compiler_specific.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/memory_stats.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+// Blocks are a multiple of |kPoolAlignment| in size, with a pool for each.
+constexpr size_t kSizeClassCount = kMaxPoolObjectSize / kPoolAlignment;
+// Blocks move between the threads' caches and the shared pools in batches of
+// this many.
+constexpr size_t kBatchSize = 32u;
+// A thread gives a batch back once it has this many free blocks of a size.
+constexpr size_t kMaxCachedBlocks = 2u * kBatchSize;
+
+// The total size of the blocks allocated for the pools (free or not).
+std::atomic<uint64_t> g_pool_bytes(0u);
+
+void AddPoolBytes(size_t bytes) {
+  // Leaked, like the pools.
+  static MemoryStatsSource* source =
+      new MemoryStatsSource("ftl.pool_allocated", [] {
+        return g_pool_bytes.load(std::memory_order_relaxed);
+      });
+  FTL_ALLOW_UNUSED_LOCAL(source);
+  g_pool_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct FreeList {
+  FreeBlock* head = nullptr;
+  size_t count = 0u;
+
+  void Push(void* block) {
+    FreeBlock* free_block = static_cast<FreeBlock*>(block);
+    free_block->next = head;
+    head = free_block;
+    count++;
+  }
+
+  void* Pop() {
+    FTL_DCHECK(head);
+    FreeBlock* block = head;
+    head = block->next;
+    count--;
+    return block;
+  }
+
+  // Moves |n| blocks from this list to a new one.
+  FreeList Split(size_t n) {
+    FTL_DCHECK(n && n <= count);
+    FreeList result;
+    result.head = head;
+    FreeBlock* last = head;
+    for (size_t i = 1u; i < n; i++)
+      last = last->next;
+    head = last->next;
+    last->next = nullptr;
+    result.count = n;
+    count -= n;
+    return result;
+  }
+};
+
+// The shared free blocks of one size, in batches.
+class SharedPool {
+ public:
+  SharedPool() {}
+
+  // Returns a batch of free blocks of |block_size| bytes, allocating more
+  // memory if there aren't any.
+  FreeList TakeBatch(size_t block_size) {
+    {
+      MutexLocker locker(&mutex_);
+      if (!batches_.empty()) {
+        FreeList batch = batches_.back();
+        batches_.pop_back();
+        return batch;
+      }
+    }
+    char* memory = static_cast<char*>(::operator new(block_size * kBatchSize));
+    AddPoolBytes(block_size * kBatchSize);
+    FreeList batch;
+    for (size_t i = kBatchSize; i > 0u; i--)
+      batch.Push(memory + (i - 1u) * block_size);
+    return batch;
+  }
+
+  void GiveBatch(const FreeList& batch) {
+    if (!batch.count)
+      return;
+    MutexLocker locker(&mutex_);
+    batches_.push_back(batch);
+  }
+
+ private:
+  Mutex mutex_;
+  std::vector<FreeList> batches_ FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SharedPool);
+};
+
+SharedPool* GetSharedPools() {
+  // Leaked, since objects may be freed during static destruction.
+  static SharedPool* pools = new SharedPool[kSizeClassCount];
+  return pools;
+}
+
+// A thread's free blocks, which are given back to the shared pools when it
+// exits.
+class ThreadCache {
+ public:
+  ThreadCache() {}
+
+  ~ThreadCache() {
+    for (size_t i = 0u; i < kSizeClassCount; i++) {
+      FreeList& list = lists_[i];
+      while (list.count) {
+        GetSharedPools()[i].GiveBatch(
+            list.Split(std::min(list.count, kBatchSize)));
+      }
+    }
+  }
+
+  void* Allocate(size_t size_class) {
+    FreeList& list = lists_[size_class];
+    if (!list.count)
+      list = GetSharedPools()[size_class].TakeBatch(BlockSize(size_class));
+    return list.Pop();
+  }
+
+  void Free(void* block, size_t size_class) {
+    FreeList& list = lists_[size_class];
+    list.Push(block);
+    if (list.count >= kMaxCachedBlocks)
+      GetSharedPools()[size_class].GiveBatch(list.Split(kBatchSize));
+  }
+
+  static size_t BlockSize(size_t size_class) {
+    return (size_class + 1u) * kPoolAlignment;
+  }
+
+ private:
+  FreeList lists_[kSizeClassCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadCache);
+};
+
+thread_local ThreadCache* g_thread_cache = nullptr;
+// Set once the current thread's cache has been destroyed (during thread exit).
+thread_local bool g_thread_cache_destroyed = false;
+
+// Owns the current thread's |ThreadCache|.
+class ThreadCacheOwner final {
+ public:
+  ThreadCacheOwner() { g_thread_cache = &cache_; }
+  ~ThreadCacheOwner() {
+    g_thread_cache = nullptr;
+    g_thread_cache_destroyed = true;
+  }
+
+ private:
+  ThreadCache cache_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadCacheOwner);
+};
+
+// Returns the current thread's cache, or null if it has already been
+// destroyed.
+ThreadCache* GetThreadCache() {
+  if (!g_thread_cache && !g_thread_cache_destroyed) {
+    static thread_local ThreadCacheOwner owner;
+  }
+  return g_thread_cache;
+}
+
+size_t SizeClassFor(size_t size) {
+  return size ? (size - 1u) / kPoolAlignment : 0u;
+}
+
+}  // namespace
+
+void* PoolAllocate(size_t size) {
+  if (size > kMaxPoolObjectSize)
+    return ::operator new(size);
+  size_t size_class = SizeClassFor(size);
+  if (ThreadCache* cache = GetThreadCache())
+    return cache->Allocate(size_class);
+  // This thread is exiting, so take a whole batch and give back the rest.
+  FreeList batch = GetSharedPools()[size_class].TakeBatch(
+      ThreadCache::BlockSize(size_class));
+  void* block = batch.Pop();
+  GetSharedPools()[size_class].GiveBatch(batch);
+  return block;
+}
+
+void PoolFree(void* object, size_t size) {
+  if (!object)
+    return;
+  if (size > kMaxPoolObjectSize) {
+    ::operator delete(object);
+    return;
+  }
+  size_t size_class = SizeClassFor(size);
+  if (ThreadCache* cache = GetThreadCache()) {
+    cache->Free(object, size_class);
+    return;
+  }
+  FreeList batch;
+  batch.Push(object);
+  GetSharedPools()[size_class].GiveBatch(batch);
+}
+
+}  // namespace internal
+}  // namespace ftl
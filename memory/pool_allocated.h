@@ -0,0 +1,56 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides a macro for allocating a class's objects from thread-caching pools.
+
+#ifndef LIB_FTL_MEMORY_POOL_ALLOCATED_H_
+#define LIB_FTL_MEMORY_POOL_ALLOCATED_H_
+
+#include <stddef.h>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace ftl {
+namespace internal {
+
+// The alignment of pool-allocated objects.
+constexpr size_t kPoolAlignment = 16u;
+// Objects larger than this are allocated with the global |operator new|.
+constexpr size_t kMaxPoolObjectSize = 1024u;
+
+FTL_EXPORT void* PoolAllocate(size_t size);
+FTL_EXPORT void PoolFree(void* object, size_t size);
+
+}  // namespace internal
+}  // namespace ftl
+
+// Put this in the public section of a class's definition to allocate its
+// objects (which |new| and |delete| do, including in |MakeRefCounted()| and
+// |RefCountedThreadSafe<T>::Release()|) from pools of same-sized blocks instead
+// of with malloc. This is worthwhile for small objects which are created and
+// destroyed at a high rate, e.g.:
+//
+//   class Message : public RefCountedThreadSafe<Message> {
+//    public:
+//     FTL_POOL_ALLOCATED(Message);
+//     ...
+//   };
+//
+// Each thread caches free blocks of each size, so most allocations and frees
+// don't lock (or even do atomic operations); blocks move between threads, and
+// an object may be freed on any thread. Memory in the pools isn't returned to
+// the system. Subclasses inherit this (and get pools for their own size), but
+// if they're deleted through a pointer to the base class, its destructor must
+// be virtual.
+#define FTL_POOL_ALLOCATED(TypeName)                                    \
+  static void* operator new(size_t size) {                              \
+    static_assert(alignof(TypeName) <= ::ftl::internal::kPoolAlignment, \
+                  "Over-aligned types can't be pool-allocated");        \
+    return ::ftl::internal::PoolAllocate(size);                         \
+  }                                                                     \
+  static void operator delete(void* object, size_t size) {              \
+    ::ftl::internal::PoolFree(object, size);                            \
+  }
+
+#endif  // LIB_FTL_MEMORY_POOL_ALLOCATED_H_
@@ -0,0 +1,108 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/pool_allocated.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/memory/ref_counted.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumThreads = 8;
+constexpr int kNumObjects = 10000;
+
+std::atomic<int> g_live_messages(0);
+
+class Message : public RefCountedThreadSafe<Message> {
+ public:
+  FTL_POOL_ALLOCATED(Message);
+
+  int value() const { return value_; }
+
+ protected:
+  explicit Message(int value) : value_(value) { g_live_messages++; }
+  virtual ~Message() { g_live_messages--; }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(Message);
+  FRIEND_MAKE_REF_COUNTED(Message);
+
+  int value_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Message);
+};
+
+// A bigger subclass, which gets blocks of its own size.
+class BigMessage final : public Message {
+ public:
+  uint64_t payload[16];
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(BigMessage);
+
+  explicit BigMessage(int value) : Message(value) {}
+  ~BigMessage() override {}
+};
+
+// A class too big for the pools.
+struct Huge {
+  FTL_POOL_ALLOCATED(Huge);
+
+  char data[internal::kMaxPoolObjectSize + 1u];
+};
+
+TEST(PoolAllocatedTest, Basic) {
+  RefPtr<Message> message = MakeRefCounted<Message>(123);
+  EXPECT_EQ(123, message->value());
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(message.get()) %
+                    internal::kPoolAlignment);
+  Message* address = message.get();
+  message = nullptr;
+  EXPECT_EQ(0, g_live_messages.load());
+
+  // Blocks are reused, most recently freed first.
+  message = MakeRefCounted<Message>(456);
+  EXPECT_EQ(address, message.get());
+
+  RefPtr<Message> big = MakeRefCounted<BigMessage>(789);
+  EXPECT_EQ(789, big->value());
+  EXPECT_EQ(2, g_live_messages.load());
+  big = nullptr;
+  message = nullptr;
+  EXPECT_EQ(0, g_live_messages.load());
+
+  Huge* huge = new Huge();
+  huge->data[internal::kMaxPoolObjectSize] = 1;
+  delete huge;
+}
+
+TEST(PoolAllocatedTest, ManyThreads) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.push_back(std::thread([i]() {
+      std::vector<RefPtr<Message>> messages;
+      for (int j = 0; j < kNumObjects; j++)
+        messages.push_back(MakeRefCounted<Message>(i * kNumObjects + j));
+      // Free them on another thread.
+      std::thread([i, &messages]() {
+        for (int j = 0; j < kNumObjects; j++)
+          EXPECT_EQ(i * kNumObjects + j, messages[j]->value());
+        messages.clear();
+      }).join();
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(0, g_live_messages.load());
+}
+
+}  // namespace
+}  // namespace ftl
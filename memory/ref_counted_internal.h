@@ -7,10 +7,13 @@
 #ifndef LIB_FTL_MEMORY_REF_COUNTED_INTERNAL_H_
 #define LIB_FTL_MEMORY_REF_COUNTED_INTERNAL_H_
 
+#include <stdint.h>
+
 #include <atomic>
 
 #include "lib/ftl/logging.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/synchronization/thread_checker.h"
 
 namespace ftl {
 namespace internal {
@@ -101,6 +104,85 @@ inline RefCountedThreadSafeBase::~RefCountedThreadSafeBase() {
 #endif
 }
 
+// See ref_counted.h for comments on the public methods. This is the same as
+// |RefCountedThreadSafeBase|, but with a plain count (and, in Debug builds, a
+// check that it's only used on the creation thread).
+class RefCountedBase {
+ public:
+  void AddRef() const {
+#ifndef NDEBUG
+    FTL_DCHECK(!adoption_required_);
+    FTL_DCHECK(!destruction_started_);
+#endif
+    FTL_DCHECK_CREATION_THREAD_IS_CURRENT(thread_checker_);
+    ref_count_++;
+  }
+
+  bool HasOneRef() const {
+    FTL_DCHECK_CREATION_THREAD_IS_CURRENT(thread_checker_);
+    return ref_count_ == 1u;
+  }
+
+  void AssertHasOneRef() const { FTL_DCHECK(HasOneRef()); }
+
+ protected:
+  RefCountedBase();
+  ~RefCountedBase();
+
+  // Returns true if the object should self-delete.
+  bool Release() const {
+#ifndef NDEBUG
+    FTL_DCHECK(!adoption_required_);
+    FTL_DCHECK(!destruction_started_);
+#endif
+    FTL_DCHECK_CREATION_THREAD_IS_CURRENT(thread_checker_);
+    FTL_DCHECK(ref_count_ != 0u);
+    if (--ref_count_ == 0u) {
+#ifndef NDEBUG
+      destruction_started_ = true;
+#endif
+      return true;
+    }
+    return false;
+  }
+
+#ifndef NDEBUG
+  void Adopt() {
+    FTL_DCHECK(adoption_required_);
+    adoption_required_ = false;
+  }
+#endif
+
+ private:
+  mutable uint_fast32_t ref_count_;
+
+#ifndef NDEBUG
+  mutable bool adoption_required_;
+  mutable bool destruction_started_;
+#endif
+  FTL_DECLARE_THREAD_CHECKER(thread_checker_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RefCountedBase);
+};
+
+inline RefCountedBase::RefCountedBase()
+    : ref_count_(1u)
+#ifndef NDEBUG
+      ,
+      adoption_required_(true),
+      destruction_started_(false)
+#endif
+{
+}
+
+inline RefCountedBase::~RefCountedBase() {
+#ifndef NDEBUG
+  FTL_DCHECK(!adoption_required_);
+  // Should only be destroyed as a result of |Release()|.
+  FTL_DCHECK(destruction_started_);
+#endif
+}
+
 }  // namespace internal
 }  // namespace ftl
 
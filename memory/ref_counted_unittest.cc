@@ -8,6 +8,8 @@
 
 #include "lib/ftl/memory/ref_counted.h"
 
+#include <thread>
+
 #include "lib/ftl/macros.h"
 #include "gtest/gtest.h"
 
@@ -601,6 +603,53 @@ TEST(RefCountedTest, DebugChecks) {
 }
 #endif
 
+class MySingleThreadedClass : public RefCounted<MySingleThreadedClass> {
+ private:
+  FRIEND_REF_COUNTED(MySingleThreadedClass);
+  FRIEND_MAKE_REF_COUNTED(MySingleThreadedClass);
+
+  explicit MySingleThreadedClass(bool* was_destroyed)
+      : was_destroyed_(was_destroyed) {}
+  ~MySingleThreadedClass() { *was_destroyed_ = true; }
+
+  bool* const was_destroyed_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MySingleThreadedClass);
+};
+
+TEST(RefCountedTest, SingleThreaded) {
+  bool was_destroyed = false;
+  RefPtr<MySingleThreadedClass> r1 =
+      MakeRefCounted<MySingleThreadedClass>(&was_destroyed);
+  EXPECT_TRUE(r1->HasOneRef());
+  r1->AssertHasOneRef();
+
+  RefPtr<MySingleThreadedClass> r2 = r1;
+  EXPECT_FALSE(r1->HasOneRef());
+  r2->AddRef();
+  r2->Release();
+  r1 = nullptr;
+  EXPECT_FALSE(was_destroyed);
+  EXPECT_TRUE(r2->HasOneRef());
+
+  r2 = nullptr;
+  EXPECT_TRUE(was_destroyed);
+}
+
+#ifndef NDEBUG
+TEST(RefCountedTest, SingleThreadedDebugChecks) {
+  bool was_destroyed = false;
+  RefPtr<MySingleThreadedClass> r =
+      MakeRefCounted<MySingleThreadedClass>(&was_destroyed);
+  EXPECT_DEATH_IF_SUPPORTED(
+      {
+        std::thread thread([&r]() { RefPtr<MySingleThreadedClass> r2 = r; });
+        thread.join();
+      },
+      "IsCreationThreadCurrent");
+}
+#endif
+
 // TODO(vtl): Add (threaded) stress tests.
 
 }  // namespace
@@ -15,12 +15,13 @@
 #include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/logging.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/allocation_profiling.h"
 #include "lib/ftl/memory/ref_ptr_internal.h"
 
 namespace ftl {
 
 // A smart pointer class for intrusively reference-counted objects (e.g., those
-// subclassing |RefCountedThreadSafe| -- see ref_counted.h).
+// subclassing |RefCounted| or |RefCountedThreadSafe| -- see ref_counted.h).
 //
 // Such objects require *adoption* to obtain the first |RefPtr|, which is
 // accomplished using |AdoptRef| (see below). (This is due to such objects being
@@ -229,6 +230,7 @@ inline RefPtr<T> Ref(T* ptr) {
 // (|my_foo| will be of type |RefPtr<Foo>|.)
 template <typename T, typename... Args>
 RefPtr<T> MakeRefCounted(Args&&... args) {
+  FTL_RECORD_INLINE_ALLOCATION(sizeof(T));
   return internal::MakeRefCountedHelper<T>::MakeRefCounted(
       std::forward<Args>(args)...);
 }
@@ -0,0 +1,45 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <utility>
+
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+class Counted : public RefCountedThreadSafe<Counted> {};
+
+void BM_RefPtrCopy(benchmark::State& state) {
+  RefPtr<Counted> original = MakeRefCounted<Counted>();
+  while (state.KeepRunning()) {
+    RefPtr<Counted> copy = original;
+    benchmark::DoNotOptimize(copy.get());
+  }
+}
+FTL_BENCHMARK(BM_RefPtrCopy);
+
+void BM_RefPtrMove(benchmark::State& state) {
+  RefPtr<Counted> a = MakeRefCounted<Counted>();
+  RefPtr<Counted> b;
+  while (state.KeepRunning()) {
+    b = std::move(a);
+    a = std::move(b);
+    benchmark::DoNotOptimize(a.get());
+  }
+}
+FTL_BENCHMARK(BM_RefPtrMove);
+
+void BM_MakeRefCounted(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    RefPtr<Counted> ptr = MakeRefCounted<Counted>();
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+FTL_BENCHMARK(BM_MakeRefCounted);
+
+}  // namespace
+}  // namespace ftl
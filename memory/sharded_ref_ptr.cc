@@ -0,0 +1,51 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/sharded_ref_ptr.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+constexpr size_t kUnassignedShard = static_cast<size_t>(-1);
+
+// Threads are assigned shards round-robin, on first use.
+std::atomic<size_t> g_next_shard(0u);
+thread_local size_t g_shard = kUnassignedShard;
+
+}  // namespace
+
+constexpr size_t RefShardsBase::kShardCount;
+
+RefShardsBase::RefShardsBase(size_t* shard) : active_shard_count_(0u) {
+  *shard = AddRef();
+}
+
+RefShardsBase::~RefShardsBase() {
+  FTL_DCHECK(!active_shard_count_.load(std::memory_order_relaxed));
+}
+
+size_t RefShardsBase::AddRef() {
+  if (g_shard == kUnassignedShard)
+    g_shard = g_next_shard.fetch_add(1u, std::memory_order_relaxed);
+  size_t shard = g_shard % kShardCount;
+  // The caller has a reference (in some shard), so the set can't be released
+  // concurrently; only the first reference in a shard adds one to the set.
+  if (!shards_[shard]->fetch_add(1u, std::memory_order_relaxed))
+    active_shard_count_.fetch_add(1u, std::memory_order_relaxed);
+  return shard;
+}
+
+bool RefShardsBase::Release(size_t shard) {
+  FTL_DCHECK(shard < kShardCount);
+  FTL_DCHECK(shards_[shard]->load(std::memory_order_relaxed));
+  // As with |RefCountedThreadSafeBase|, the releases must happen before the
+  // destruction, which the last one acquires.
+  if (shards_[shard]->fetch_sub(1u, std::memory_order_acq_rel) != 1u)
+    return false;
+  return active_shard_count_.fetch_sub(1u, std::memory_order_acq_rel) == 1u;
+}
+
+}  // namespace internal
+}  // namespace ftl
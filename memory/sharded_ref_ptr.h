@@ -0,0 +1,175 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides a smart pointer class for reference-counted objects which are
+// referenced from many threads.
+
+#ifndef LIB_FTL_MEMORY_SHARDED_REF_PTR_H_
+#define LIB_FTL_MEMORY_SHARDED_REF_PTR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+#include "lib/ftl/memory/ref_ptr.h"
+
+namespace ftl {
+namespace internal {
+
+// The reference counts shared by a set of |ShardedRefPtr|s, which are split
+// into shards on separate cache lines. Each thread uses one of the shards, and
+// a shard going from zero to nonzero (or back) adds (or removes) one
+// reference to the whole set.
+class FTL_EXPORT RefShardsBase {
+ public:
+  // Adds a reference in the current thread's shard, and returns the shard
+  // (which must be passed to |Release()|).
+  size_t AddRef();
+
+  // Releases a reference in |shard|, returning true if it was the last
+  // reference to the set.
+  bool Release(size_t shard);
+
+ protected:
+  // Starts with one reference, whose shard is |*shard|.
+  explicit RefShardsBase(size_t* shard);
+  ~RefShardsBase();
+
+ private:
+  static constexpr size_t kShardCount = 16u;
+
+  // A count, padded so that each is on its own cache line.
+  using Shard = CacheLinePadded<std::atomic<uint32_t>>;
+
+  Shard shards_[kShardCount];
+  // The number of shards with a nonzero count.
+  std::atomic<uint32_t> active_shard_count_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RefShardsBase);
+};
+
+// The (single) ordinary reference which the set holds.
+template <typename T>
+class RefShards final : public RefShardsBase {
+ public:
+  RefShards(RefPtr<T> object, size_t* shard)
+      : RefShardsBase(shard), object_(std::move(object)) {}
+  ~RefShards() {}
+
+ private:
+  RefPtr<T> object_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RefShards);
+};
+
+}  // namespace internal
+
+// A smart pointer class for reference-counted objects (anything that |RefPtr|
+// works with, e.g., subclasses of |RefCountedThreadSafe|) which are copied and
+// released concurrently on many threads (e.g., a shared |TaskRunner|). Copying
+// a |RefPtr| is an atomic operation on the object's one reference count, whose
+// cache line bounces between the cores doing so; copies of a |ShardedRefPtr|
+// instead update one of several counts (chosen per thread), and only touch
+// the shared count occasionally.
+//
+// A |ShardedRefPtr| holds a single ordinary reference to its object on behalf
+// of all its copies, which is dropped (so that the object is destroyed, unless
+// it has other references) when the last copy goes away:
+//
+//   ShardedRefPtr<TaskRunner> runner(loop.task_runner());
+//   for (...)
+//     threads.emplace_back([runner]() { ... });
+//
+// Each |ShardedRefPtr| created from a |RefPtr| has its own counts (which take
+// about a kilobyte), so create one per shared object, and copy that. Converting
+// to a |RefPtr| (see |ToRefPtr()|) adds an ordinary reference.
+template <typename T>
+class ShardedRefPtr final {
+ public:
+  ShardedRefPtr() : ptr_(nullptr), shards_(nullptr), shard_(0u) {}
+  ShardedRefPtr(std::nullptr_t) : ShardedRefPtr() {}
+
+  // Takes over |ptr|'s reference (so the object must have already been
+  // adopted; see |AdoptRef()|).
+  explicit ShardedRefPtr(RefPtr<T> ptr)
+      : ptr_(ptr.get()), shards_(nullptr), shard_(0u) {
+    if (ptr_)
+      shards_ = new internal::RefShards<T>(std::move(ptr), &shard_);
+  }
+
+  ShardedRefPtr(const ShardedRefPtr<T>& r)
+      : ptr_(r.ptr_), shards_(r.shards_), shard_(0u) {
+    if (shards_)
+      shard_ = shards_->AddRef();
+  }
+
+  ShardedRefPtr(ShardedRefPtr<T>&& r)
+      : ptr_(r.ptr_), shards_(r.shards_), shard_(r.shard_) {
+    r.ptr_ = nullptr;
+    r.shards_ = nullptr;
+  }
+
+  ~ShardedRefPtr() {
+    if (shards_ && shards_->Release(shard_))
+      delete shards_;
+  }
+
+  T* get() const { return ptr_; }
+
+  T& operator*() const {
+    FTL_DCHECK(ptr_);
+    return *ptr_;
+  }
+
+  T* operator->() const {
+    FTL_DCHECK(ptr_);
+    return ptr_;
+  }
+
+  ShardedRefPtr<T>& operator=(const ShardedRefPtr<T>& r) {
+    ShardedRefPtr<T>(r).swap(*this);
+    return *this;
+  }
+
+  ShardedRefPtr<T>& operator=(ShardedRefPtr<T>&& r) {
+    ShardedRefPtr<T>(std::move(r)).swap(*this);
+    return *this;
+  }
+
+  void swap(ShardedRefPtr<T>& r) {
+    std::swap(ptr_, r.ptr_);
+    std::swap(shards_, r.shards_);
+    std::swap(shard_, r.shard_);
+  }
+
+  // Returns an ordinary |RefPtr| to the object.
+  RefPtr<T> ToRefPtr() const { return RefPtr<T>(ptr_); }
+
+  explicit operator bool() const { return !!ptr_; }
+
+  bool operator==(const ShardedRefPtr<T>& rhs) const {
+    return ptr_ == rhs.ptr_;
+  }
+
+  bool operator!=(const ShardedRefPtr<T>& rhs) const {
+    return !operator==(rhs);
+  }
+
+ private:
+  T* ptr_;
+  internal::RefShards<T>* shards_;
+  // The shard of |*shards_| which holds this pointer's reference.
+  size_t shard_;
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_MEMORY_SHARDED_REF_PTR_H_
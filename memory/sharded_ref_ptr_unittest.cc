@@ -0,0 +1,107 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/sharded_ref_ptr.h"
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/memory/ref_counted.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumThreads = 32;
+constexpr int kNumCopies = 10000;
+
+class MyClass : public RefCountedThreadSafe<MyClass> {
+ public:
+  int value() const { return 42; }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(MyClass);
+  FRIEND_MAKE_REF_COUNTED(MyClass);
+
+  explicit MyClass(std::atomic<bool>* was_destroyed)
+      : was_destroyed_(was_destroyed) {}
+  ~MyClass() { was_destroyed_->store(true); }
+
+  std::atomic<bool>* const was_destroyed_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MyClass);
+};
+
+TEST(ShardedRefPtrTest, Basic) {
+  std::atomic<bool> was_destroyed(false);
+  RefPtr<MyClass> ref = MakeRefCounted<MyClass>(&was_destroyed);
+  MyClass* object = ref.get();
+
+  ShardedRefPtr<MyClass> r1(ref);
+  EXPECT_EQ(object, r1.get());
+  EXPECT_EQ(42, r1->value());
+  EXPECT_TRUE(r1);
+  EXPECT_FALSE(object->HasOneRef());
+
+  ref = nullptr;
+  EXPECT_FALSE(was_destroyed.load());
+  // The |ShardedRefPtr|s share one ordinary reference.
+  EXPECT_TRUE(object->HasOneRef());
+
+  ShardedRefPtr<MyClass> r2 = r1;
+  EXPECT_TRUE(r1 == r2);
+  EXPECT_TRUE(object->HasOneRef());
+  ShardedRefPtr<MyClass> r3(std::move(r1));
+  EXPECT_FALSE(r1);
+  EXPECT_EQ(object, r3.get());
+
+  RefPtr<MyClass> ref2 = r3.ToRefPtr();
+  EXPECT_FALSE(object->HasOneRef());
+  ref2 = nullptr;
+
+  r2 = nullptr;
+  EXPECT_FALSE(was_destroyed.load());
+  r1 = r3;
+  r3 = nullptr;
+  EXPECT_FALSE(was_destroyed.load());
+  r1 = ShardedRefPtr<MyClass>();
+  EXPECT_TRUE(was_destroyed.load());
+
+  ShardedRefPtr<MyClass> null_ptr(RefPtr<MyClass>(nullptr));
+  EXPECT_FALSE(null_ptr);
+  ShardedRefPtr<MyClass> null_copy = null_ptr;
+  EXPECT_TRUE(null_copy == nullptr);
+}
+
+TEST(ShardedRefPtrTest, ManyThreads) {
+  std::atomic<bool> was_destroyed(false);
+  ShardedRefPtr<MyClass> shared(MakeRefCounted<MyClass>(&was_destroyed));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    // Each thread gets a copy, and copies and releases it a lot (some of the
+    // copies are released on other threads).
+    threads.push_back(std::thread([copy = shared]() {
+      std::vector<ShardedRefPtr<MyClass>> copies;
+      for (int j = 0; j < kNumCopies; j++) {
+        copies.push_back(copy);
+        if (copies.size() > 8u)
+          copies.erase(copies.begin());
+      }
+      std::thread([copies = std::move(copies)]() {
+        for (const auto& c : copies)
+          EXPECT_EQ(42, c->value());
+      }).join();
+    }));
+  }
+  shared = nullptr;
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_TRUE(was_destroyed.load());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -55,7 +55,9 @@ class UniqueObject {
   ~UniqueObject() { FreeIfNecessary(); }
 
   UniqueObject& operator=(UniqueObject&& other) {
+    // The current value (if any) is freed with the current traits.
     reset(other.release());
+    get_traits() = other.get_traits();
     return *this;
   }
 
@@ -140,7 +140,10 @@ template <typename T>
 class WeakPtrFactory {
  public:
   explicit WeakPtrFactory(T* ptr) : ptr_(ptr) { FTL_DCHECK(ptr_); }
-  ~WeakPtrFactory() { InvalidateWeakPtrs(); }
+  ~WeakPtrFactory() {
+    if (flag_)
+      flag_->Invalidate();
+  }
 
   // Gets a new weak pointer, which will be valid until either
   // |InvalidateWeakPtrs()| is called or this object is destroyed.
@@ -153,7 +156,10 @@ class WeakPtrFactory {
   // Call this method to invalidate all existing weak pointers. (Note that
   // additional weak pointers can be produced even after this is called.)
   void InvalidateWeakPtrs() {
-    if (!flag_)
+    // If there are no weak pointers, there's nothing to invalidate, and the
+    // flag can be reused (which saves allocating a new one, e.g., when a timer
+    // is restarted after it has fired).
+    if (!HasWeakPtrs())
       return;
     flag_->Invalidate();
     flag_ = nullptr;
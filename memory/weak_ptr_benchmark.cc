@@ -0,0 +1,43 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_GetWeakPtr(benchmark::State& state) {
+  int data = 0;
+  WeakPtrFactory<int> factory(&data);
+  while (state.KeepRunning()) {
+    WeakPtr<int> ptr = factory.GetWeakPtr();
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+FTL_BENCHMARK(BM_GetWeakPtr);
+
+void BM_WeakPtrFactoryAndGetWeakPtr(benchmark::State& state) {
+  int data = 0;
+  while (state.KeepRunning()) {
+    WeakPtrFactory<int> factory(&data);
+    WeakPtr<int> ptr = factory.GetWeakPtr();
+    benchmark::DoNotOptimize(ptr.get());
+  }
+}
+FTL_BENCHMARK(BM_WeakPtrFactoryAndGetWeakPtr);
+
+void BM_WeakPtrDereference(benchmark::State& state) {
+  int data = 0;
+  WeakPtrFactory<int> factory(&data);
+  WeakPtr<int> ptr = factory.GetWeakPtr();
+  while (state.KeepRunning()) {
+    if (ptr)
+      benchmark::DoNotOptimize(*ptr);
+  }
+}
+FTL_BENCHMARK(BM_WeakPtrDereference);
+
+}  // namespace
+}  // namespace ftl
@@ -6,6 +6,7 @@
 #define LIB_FTL_MEMORY_WEAK_PTR_INTERNAL_H_
 
 #include "lib/ftl/macros.h"
+#include "lib/ftl/memory/pool_allocated.h"
 #include "lib/ftl/memory/ref_counted.h"
 
 namespace ftl {
@@ -18,9 +19,12 @@ namespace internal {
 //
 // This class in not thread-safe, though references may be released on any
 // thread (allowing weak pointers to be destroyed/reset/reassigned on any
-// thread).
+// thread). Flags are pool-allocated, since they're small and may be replaced on
+// every invalidation.
 class FTL_EXPORT WeakPtrFlag : public RefCountedThreadSafe<WeakPtrFlag> {
  public:
+  FTL_POOL_ALLOCATED(WeakPtrFlag);
+
   WeakPtrFlag();
   ~WeakPtrFlag();
 
@@ -193,6 +193,40 @@ TEST(WeakPtrTest, HasWeakPtrs) {
   EXPECT_FALSE(factory.HasWeakPtrs());
 }
 
+TEST(WeakPtrTest, InvalidateWithoutWeakPtrs) {
+  int data = 0;
+  WeakPtrFactory<int> factory(&data);
+  factory.InvalidateWeakPtrs();
+  {
+    WeakPtr<int> ptr = factory.GetWeakPtr();
+    EXPECT_EQ(&data, ptr.get());
+  }
+  // There are no weak pointers left, so this does nothing.
+  factory.InvalidateWeakPtrs();
+  EXPECT_FALSE(factory.HasWeakPtrs());
+
+  WeakPtr<int> ptr = factory.GetWeakPtr();
+  EXPECT_EQ(&data, ptr.get());
+  factory.InvalidateWeakPtrs();
+  EXPECT_EQ(nullptr, ptr.get());
+  WeakPtr<int> ptr2 = factory.GetWeakPtr();
+  EXPECT_EQ(&data, ptr2.get());
+  EXPECT_EQ(nullptr, ptr.get());
+}
+
+TEST(WeakPtrTest, OutlivesFactory) {
+  WeakPtr<int> ptr;
+  {
+    int data = 0;
+    WeakPtrFactory<int> factory(&data);
+    ptr = factory.GetWeakPtr();
+    factory.InvalidateWeakPtrs();
+    ptr = factory.GetWeakPtr();
+    EXPECT_EQ(&data, ptr.get());
+  }
+  EXPECT_EQ(nullptr, ptr.get());
+}
+
 // TODO(vtl): Copy/convert the various threaded tests from Chromium's
 // //base/memory/weak_ptr_unittest.cc.
 
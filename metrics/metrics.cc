@@ -0,0 +1,429 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/metrics/metrics.h"
+
+#include <string.h>
+
+#include <map>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/threading/fork_handlers.h"
+
+namespace ftl {
+namespace metrics {
+namespace {
+
+constexpr size_t kUnassignedShard = static_cast<size_t>(-1);
+
+// Threads are assigned shards round-robin, on first use.
+std::atomic<size_t> g_next_shard(0u);
+thread_local size_t g_shard = kUnassignedShard;
+
+// The binary form is the magic, then for each metric its type (a byte), name
+// and help (each a length, then the bytes), then its value: a counter's or
+// gauge's (8 bytes), or a histogram's total, min and max (8 bytes each, in
+// nanoseconds) and nonzero buckets (a count, then each one's index and
+// count). Integers are little-endian; lengths, counts of buckets and bucket
+// indices are 4 bytes.
+constexpr char kMagic[] = "FTLMETR1";
+constexpr size_t kMagicSize = sizeof(kMagic) - 1u;
+
+// The percentiles histograms are exported with.
+constexpr double kPercentiles[] = {50.0, 90.0, 99.0, 99.9};
+
+struct Metric {
+  MetricType type;
+  std::string help;
+  const void* metric;
+};
+
+class Registry final {
+ public:
+  static Registry* Get() {
+    static Registry* registry = new Registry();
+    return registry;
+  }
+
+  void Register(MetricType type,
+                const std::string& name,
+                const std::string& help,
+                const void* metric) {
+    MutexLocker locker(&mutex_);
+    const bool inserted =
+        metrics_.insert(std::make_pair(name, Metric{type, help, metric}))
+            .second;
+    FTL_CHECK(inserted) << "Duplicate metric: " << name;
+  }
+
+  void Unregister(const std::string& name, const void* metric) {
+    MutexLocker locker(&mutex_);
+    auto it = metrics_.find(name);
+    FTL_DCHECK(it != metrics_.end() && it->second.metric == metric);
+    metrics_.erase(it);
+  }
+
+  std::vector<MetricSnapshot> GetSnapshot() {
+    std::vector<MetricSnapshot> snapshots;
+    MutexLocker locker(&mutex_);
+    for (const auto& pair : metrics_) {
+      MetricSnapshot snapshot;
+      snapshot.type = pair.second.type;
+      snapshot.name = pair.first;
+      snapshot.help = pair.second.help;
+      switch (pair.second.type) {
+        case MetricType::kCounter:
+          snapshot.counter_value =
+              static_cast<const Counter*>(pair.second.metric)->Value();
+          break;
+        case MetricType::kGauge:
+          snapshot.gauge_value =
+              static_cast<const Gauge*>(pair.second.metric)->Value();
+          break;
+        case MetricType::kHistogram:
+          snapshot.histogram.reset(new LatencyHistogram::Snapshot(
+              static_cast<const Histogram*>(pair.second.metric)
+                  ->histogram()
+                  ->GetSnapshot()));
+          break;
+      }
+      snapshots.push_back(std::move(snapshot));
+    }
+    return snapshots;
+  }
+
+ private:
+  Registry() : fork_handlers_(&mutex_) {}
+  ~Registry() = delete;
+
+  Mutex mutex_;
+  // By name (so sorted).
+  std::map<std::string, Metric> metrics_ FTL_GUARDED_BY(mutex_);
+  ForkHandlers fork_handlers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Registry);
+};
+
+template <typename T>
+T SumShards(const internal::Shard<T> (&shards)[internal::kShardCount]) {
+  T sum = 0;
+  for (const auto& shard : shards)
+    sum += shard->load(std::memory_order_relaxed);
+  return sum;
+}
+
+const char* TypeName(MetricType type) {
+  switch (type) {
+    case MetricType::kCounter:
+      return "counter";
+    case MetricType::kGauge:
+      return "gauge";
+    case MetricType::kHistogram:
+      return "summary";
+  }
+  return "untyped";
+}
+
+// Escapes |help| as the text format requires.
+std::string EscapeHelp(const std::string& help) {
+  std::string escaped;
+  for (char c : help) {
+    if (c == '\\')
+      escaped += "\\\\";
+    else if (c == '\n')
+      escaped += "\\n";
+    else
+      escaped += c;
+  }
+  return escaped;
+}
+
+std::string FormatSeconds(TimeDelta duration) {
+  return StringPrintf("%.9g", duration.ToSecondsF());
+}
+
+void AppendUint32(uint32_t value, std::string* output) {
+  for (size_t i = 0u; i < 4u; i++)
+    output->push_back(static_cast<char>(value >> (8u * i)));
+}
+
+void AppendUint64(uint64_t value, std::string* output) {
+  for (size_t i = 0u; i < 8u; i++)
+    output->push_back(static_cast<char>(value >> (8u * i)));
+}
+
+void AppendString(const std::string& value, std::string* output) {
+  AppendUint32(static_cast<uint32_t>(value.size()), output);
+  output->append(value);
+}
+
+// Reads the binary form, failing (for good) once it runs out of data.
+class Reader final {
+ public:
+  explicit Reader(StringView data) : data_(data) {}
+
+  bool at_end() const { return data_.empty(); }
+
+  bool ReadByte(uint8_t* value) {
+    if (data_.empty())
+      return false;
+    *value = static_cast<uint8_t>(data_[0]);
+    data_.remove_prefix(1u);
+    return true;
+  }
+
+  bool ReadUint32(uint32_t* value) {
+    uint64_t wide;
+    if (!ReadLittleEndian(4u, &wide))
+      return false;
+    *value = static_cast<uint32_t>(wide);
+    return true;
+  }
+
+  bool ReadUint64(uint64_t* value) { return ReadLittleEndian(8u, value); }
+
+  bool ReadInt64(int64_t* value) {
+    uint64_t bits;
+    if (!ReadUint64(&bits))
+      return false;
+    *value = static_cast<int64_t>(bits);
+    return true;
+  }
+
+  bool ReadString(std::string* value) {
+    uint32_t size;
+    if (!ReadUint32(&size) || size > data_.size())
+      return false;
+    *value = data_.substr(0u, size).ToString();
+    data_.remove_prefix(size);
+    return true;
+  }
+
+ private:
+  bool ReadLittleEndian(size_t size, uint64_t* value) {
+    if (data_.size() < size)
+      return false;
+    *value = 0u;
+    for (size_t i = 0u; i < size; i++)
+      *value |= uint64_t{static_cast<uint8_t>(data_[i])} << (8u * i);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  StringView data_;
+};
+
+bool DecodeHistogram(Reader* reader, MetricSnapshot* snapshot) {
+  int64_t total;
+  int64_t min;
+  int64_t max;
+  uint32_t bucket_count;
+  if (!reader->ReadInt64(&total) || !reader->ReadInt64(&min) ||
+      !reader->ReadInt64(&max) || !reader->ReadUint32(&bucket_count) ||
+      bucket_count > LatencyHistogram::kBucketCount) {
+    return false;
+  }
+  std::vector<uint64_t> buckets(LatencyHistogram::kBucketCount, 0u);
+  for (uint32_t i = 0u; i < bucket_count; i++) {
+    uint32_t index;
+    uint64_t count;
+    if (!reader->ReadUint32(&index) || !reader->ReadUint64(&count) ||
+        index >= LatencyHistogram::kBucketCount) {
+      return false;
+    }
+    buckets[index] = count;
+  }
+  snapshot->histogram.reset(
+      new LatencyHistogram::Snapshot(LatencyHistogram::Snapshot::FromCounts(
+          std::move(buckets), TimeDelta::FromNanoseconds(total),
+          TimeDelta::FromNanoseconds(min),
+          TimeDelta::FromNanoseconds(max))));
+  return true;
+}
+
+}  // namespace
+
+namespace internal {
+
+size_t GetShardIndex() {
+  if (g_shard == kUnassignedShard) {
+    g_shard =
+        g_next_shard.fetch_add(1u, std::memory_order_relaxed) % kShardCount;
+  }
+  return g_shard;
+}
+
+}  // namespace internal
+
+Counter::Counter(const std::string& name, const std::string& help)
+    : name_(name) {
+  Registry::Get()->Register(MetricType::kCounter, name, help, this);
+}
+
+Counter::~Counter() {
+  Registry::Get()->Unregister(name_, this);
+}
+
+uint64_t Counter::Value() const {
+  return SumShards(shards_);
+}
+
+Gauge::Gauge(const std::string& name, const std::string& help) : name_(name) {
+  Registry::Get()->Register(MetricType::kGauge, name, help, this);
+}
+
+Gauge::~Gauge() {
+  Registry::Get()->Unregister(name_, this);
+}
+
+void Gauge::Set(int64_t value) {
+  Add(value - Value());
+}
+
+int64_t Gauge::Value() const {
+  return SumShards(shards_);
+}
+
+Histogram::Histogram(const std::string& name, const std::string& help)
+    : name_(name) {
+  Registry::Get()->Register(MetricType::kHistogram, name, help, this);
+}
+
+Histogram::~Histogram() {
+  Registry::Get()->Unregister(name_, this);
+}
+
+MetricSnapshot::MetricSnapshot() {}
+
+MetricSnapshot::~MetricSnapshot() {}
+
+MetricSnapshot::MetricSnapshot(MetricSnapshot&& other) = default;
+
+MetricSnapshot& MetricSnapshot::operator=(MetricSnapshot&& other) = default;
+
+std::vector<MetricSnapshot> GetSnapshot() {
+  return Registry::Get()->GetSnapshot();
+}
+
+std::string ExportPrometheusText(const std::vector<MetricSnapshot>& metrics) {
+  std::string output;
+  for (const MetricSnapshot& metric : metrics) {
+    const char* name = metric.name.c_str();
+    if (!metric.help.empty()) {
+      output +=
+          StringPrintf("# HELP %s %s\n", name, EscapeHelp(metric.help).c_str());
+    }
+    output += StringPrintf("# TYPE %s %s\n", name, TypeName(metric.type));
+    switch (metric.type) {
+      case MetricType::kCounter:
+        output += StringPrintf(
+            "%s %llu\n", name,
+            static_cast<unsigned long long>(metric.counter_value));
+        break;
+      case MetricType::kGauge:
+        output += StringPrintf("%s %lld\n", name,
+                               static_cast<long long>(metric.gauge_value));
+        break;
+      case MetricType::kHistogram: {
+        FTL_DCHECK(metric.histogram);
+        const LatencyHistogram::Snapshot& histogram = *metric.histogram;
+        for (double percentile : kPercentiles) {
+          output += StringPrintf(
+              "%s{quantile=\"%g\"} %s\n", name, percentile / 100.0,
+              histogram.count()
+                  ? FormatSeconds(histogram.Percentile(percentile)).c_str()
+                  : "NaN");
+        }
+        output += StringPrintf("%s_sum %s\n", name,
+                               FormatSeconds(histogram.total()).c_str());
+        output += StringPrintf(
+            "%s_count %llu\n", name,
+            static_cast<unsigned long long>(histogram.count()));
+        break;
+      }
+    }
+  }
+  return output;
+}
+
+std::string EncodeSnapshot(const std::vector<MetricSnapshot>& metrics) {
+  std::string output(kMagic, kMagicSize);
+  for (const MetricSnapshot& metric : metrics) {
+    output.push_back(static_cast<char>(metric.type));
+    AppendString(metric.name, &output);
+    AppendString(metric.help, &output);
+    switch (metric.type) {
+      case MetricType::kCounter:
+        AppendUint64(metric.counter_value, &output);
+        break;
+      case MetricType::kGauge:
+        AppendUint64(static_cast<uint64_t>(metric.gauge_value), &output);
+        break;
+      case MetricType::kHistogram: {
+        FTL_DCHECK(metric.histogram);
+        const LatencyHistogram::Snapshot& histogram = *metric.histogram;
+        AppendUint64(static_cast<uint64_t>(histogram.total().ToNanoseconds()),
+                     &output);
+        AppendUint64(static_cast<uint64_t>(histogram.min().ToNanoseconds()),
+                     &output);
+        AppendUint64(static_cast<uint64_t>(histogram.max().ToNanoseconds()),
+                     &output);
+        uint32_t bucket_count = 0u;
+        for (size_t i = 0u; i < LatencyHistogram::kBucketCount; i++) {
+          if (histogram.bucket(i))
+            bucket_count++;
+        }
+        AppendUint32(bucket_count, &output);
+        for (size_t i = 0u; i < LatencyHistogram::kBucketCount; i++) {
+          if (histogram.bucket(i)) {
+            AppendUint32(static_cast<uint32_t>(i), &output);
+            AppendUint64(histogram.bucket(i), &output);
+          }
+        }
+        break;
+      }
+    }
+  }
+  return output;
+}
+
+bool DecodeSnapshot(StringView data, std::vector<MetricSnapshot>* metrics) {
+  metrics->clear();
+  if (data.size() < kMagicSize || memcmp(data.data(), kMagic, kMagicSize))
+    return false;
+  Reader reader(data.substr(kMagicSize));
+  while (!reader.at_end()) {
+    MetricSnapshot metric;
+    uint8_t type;
+    if (!reader.ReadByte(&type) ||
+        type > static_cast<uint8_t>(MetricType::kHistogram) ||
+        !reader.ReadString(&metric.name) || !reader.ReadString(&metric.help)) {
+      return false;
+    }
+    metric.type = static_cast<MetricType>(type);
+    switch (metric.type) {
+      case MetricType::kCounter:
+        if (!reader.ReadUint64(&metric.counter_value))
+          return false;
+        break;
+      case MetricType::kGauge:
+        if (!reader.ReadInt64(&metric.gauge_value))
+          return false;
+        break;
+      case MetricType::kHistogram:
+        if (!DecodeHistogram(&reader, &metric))
+          return false;
+        break;
+    }
+    metrics->push_back(std::move(metric));
+  }
+  return true;
+}
+
+}  // namespace metrics
+}  // namespace ftl
@@ -0,0 +1,175 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Named metrics which hot paths can update without contending with each
+// other, and which can be exported all at once, e.g.:
+//
+//   ftl::metrics::Counter g_requests("server_requests_total",
+//                                    "Requests handled.");
+//   ftl::metrics::Gauge g_connections("server_connections",
+//                                     "Open connections.");
+//   ftl::metrics::Histogram g_latency("server_request_seconds",
+//                                     "Time to handle a request.");
+//
+//   void Server::Handle(...) {
+//     ftl::ScopedTimer timer(g_latency.histogram());
+//     g_requests.Increment();
+//     ...
+//   }
+//
+//   // E.g., on "GET /metrics":
+//   return ftl::metrics::ExportPrometheusText(ftl::metrics::GetSnapshot());
+//
+// A counter or gauge is split into shards, each on its own cache line, and
+// each thread updates one of them (with a relaxed atomic add), so threads
+// updating the same metric rarely share a cache line; reading the value adds
+// up the shards. Histograms are |LatencyHistogram|s, which are sharded the
+// same way.
+//
+// Metrics register themselves (by name, which must be unique among the live
+// metrics) when constructed, and unregister when destroyed. Names should be
+// valid Prometheus names ([a-zA-Z_:][a-zA-Z0-9_:]*).
+
+#ifndef LIB_FTL_METRICS_METRICS_H_
+#define LIB_FTL_METRICS_METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/latency_histogram.h"
+
+namespace ftl {
+namespace metrics {
+namespace internal {
+
+constexpr size_t kShardCount = 16u;
+
+// A value, padded so that each is on its own cache line.
+template <typename T>
+using Shard = CacheLinePadded<std::atomic<T>>;
+
+// The current thread's shard (threads are assigned shards round-robin).
+FTL_EXPORT size_t GetShardIndex();
+
+}  // namespace internal
+
+enum class MetricType : uint8_t {
+  kCounter,
+  kGauge,
+  kHistogram,
+};
+
+// A count of things that have happened, which only goes up.
+class FTL_EXPORT Counter final {
+ public:
+  Counter(const std::string& name, const std::string& help);
+  ~Counter();
+
+  void Increment(uint64_t delta = 1u) {
+    shards_[internal::GetShardIndex()]->fetch_add(
+        delta, std::memory_order_relaxed);
+  }
+
+  uint64_t Value() const;
+
+ private:
+  const std::string name_;
+  internal::Shard<uint64_t> shards_[internal::kShardCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Counter);
+};
+
+// A value which goes up and down (e.g., a number of open connections).
+class FTL_EXPORT Gauge final {
+ public:
+  Gauge(const std::string& name, const std::string& help);
+  ~Gauge();
+
+  void Add(int64_t delta) {
+    shards_[internal::GetShardIndex()]->fetch_add(
+        delta, std::memory_order_relaxed);
+  }
+  void Subtract(int64_t delta) { Add(-delta); }
+
+  // Sets the value, by adding the difference from the current value, so
+  // |Add()|s concurrent with it may or may not be reflected afterwards.
+  void Set(int64_t value);
+
+  int64_t Value() const;
+
+ private:
+  const std::string name_;
+  internal::Shard<int64_t> shards_[internal::kShardCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Gauge);
+};
+
+// A histogram of durations (exported in seconds).
+class FTL_EXPORT Histogram final {
+ public:
+  Histogram(const std::string& name, const std::string& help);
+  ~Histogram();
+
+  void Record(TimeDelta duration) { histogram_.Record(duration); }
+
+  // E.g., for a |ScopedTimer|.
+  LatencyHistogram* histogram() { return &histogram_; }
+  const LatencyHistogram* histogram() const { return &histogram_; }
+
+ private:
+  const std::string name_;
+  LatencyHistogram histogram_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
+
+// One metric's value at some point.
+struct FTL_EXPORT MetricSnapshot {
+  MetricSnapshot();
+  ~MetricSnapshot();
+  MetricSnapshot(MetricSnapshot&& other);
+  MetricSnapshot& operator=(MetricSnapshot&& other);
+
+  MetricType type = MetricType::kCounter;
+  std::string name;
+  std::string help;
+  // For a |Counter|.
+  uint64_t counter_value = 0u;
+  // For a |Gauge|.
+  int64_t gauge_value = 0;
+  // For a |Histogram| (otherwise null).
+  std::unique_ptr<LatencyHistogram::Snapshot> histogram;
+};
+
+// Returns the values of all the live metrics, sorted by name.
+FTL_EXPORT std::vector<MetricSnapshot> GetSnapshot();
+
+// Returns |metrics| in the Prometheus text exposition format. Histograms are
+// exported as summaries, with the 50th, 90th, 99th and 99.9th percentiles.
+FTL_EXPORT std::string ExportPrometheusText(
+    const std::vector<MetricSnapshot>& metrics);
+
+// Returns |metrics| in a compact binary form (which keeps histograms' buckets)
+// for |DecodeSnapshot()|, e.g., on another machine.
+FTL_EXPORT std::string EncodeSnapshot(
+    const std::vector<MetricSnapshot>& metrics);
+
+// Decodes the output of |EncodeSnapshot()| into |*metrics|. Returns false if
+// |data| isn't well-formed.
+FTL_EXPORT bool DecodeSnapshot(StringView data,
+                               std::vector<MetricSnapshot>* metrics);
+
+}  // namespace metrics
+}  // namespace ftl
+
+#endif  // LIB_FTL_METRICS_METRICS_H_
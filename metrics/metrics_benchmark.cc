@@ -0,0 +1,39 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+
+#include "lib/ftl/metrics/metrics.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace metrics {
+namespace {
+
+void BM_CounterIncrement(benchmark::State& state) {
+  static Counter* counter = new Counter("benchmark_counter", "");
+  while (state.KeepRunning())
+    counter->Increment();
+}
+FTL_BENCHMARK(BM_CounterIncrement)->ThreadRange(1, 8);
+
+// A plain shared atomic, for comparison.
+void BM_AtomicIncrement(benchmark::State& state) {
+  static std::atomic<uint64_t> counter(0u);
+  while (state.KeepRunning())
+    counter.fetch_add(1u, std::memory_order_relaxed);
+}
+FTL_BENCHMARK(BM_AtomicIncrement)->ThreadRange(1, 8);
+
+void BM_GetSnapshot(benchmark::State& state) {
+  static Gauge* gauge = new Gauge("benchmark_gauge", "");
+  gauge->Set(1);
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(GetSnapshot());
+}
+FTL_BENCHMARK(BM_GetSnapshot);
+
+}  // namespace
+}  // namespace metrics
+}  // namespace ftl
@@ -0,0 +1,177 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/metrics/metrics.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace metrics {
+namespace {
+
+// Returns the snapshot of the metric |name|, or null.
+const MetricSnapshot* Find(const std::vector<MetricSnapshot>& metrics,
+                           const std::string& name) {
+  for (const MetricSnapshot& metric : metrics) {
+    if (metric.name == name)
+      return &metric;
+  }
+  return nullptr;
+}
+
+TEST(Metrics, Counter) {
+  Counter counter("test_counter", "A counter.");
+  EXPECT_EQ(0u, counter.Value());
+  counter.Increment();
+  counter.Increment(41u);
+  EXPECT_EQ(42u, counter.Value());
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&counter] {
+      for (int i = 0; i < 10000; i++)
+        counter.Increment();
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(80042u, counter.Value());
+}
+
+TEST(Metrics, Gauge) {
+  Gauge gauge("test_gauge", "A gauge.");
+  gauge.Add(10);
+  gauge.Subtract(3);
+  EXPECT_EQ(7, gauge.Value());
+  std::thread([&gauge] { gauge.Subtract(10); }).join();
+  EXPECT_EQ(-3, gauge.Value());
+  gauge.Set(100);
+  EXPECT_EQ(100, gauge.Value());
+}
+
+TEST(Metrics, Registration) {
+  {
+    Counter counter("test_b", "");
+    Gauge gauge("test_a", "");
+    Histogram histogram("test_c", "");
+    counter.Increment(3u);
+    gauge.Set(-5);
+    histogram.Record(TimeDelta::FromMilliseconds(2));
+
+    const std::vector<MetricSnapshot> metrics = GetSnapshot();
+    const MetricSnapshot* a = Find(metrics, "test_a");
+    const MetricSnapshot* b = Find(metrics, "test_b");
+    const MetricSnapshot* c = Find(metrics, "test_c");
+    ASSERT_TRUE(a && b && c);
+    EXPECT_LT(a, b);
+    EXPECT_LT(b, c);
+    EXPECT_EQ(MetricType::kGauge, a->type);
+    EXPECT_EQ(-5, a->gauge_value);
+    EXPECT_FALSE(a->histogram);
+    EXPECT_EQ(MetricType::kCounter, b->type);
+    EXPECT_EQ(3u, b->counter_value);
+    EXPECT_EQ(MetricType::kHistogram, c->type);
+    ASSERT_TRUE(c->histogram);
+    EXPECT_EQ(1u, c->histogram->count());
+  }
+  const std::vector<MetricSnapshot> metrics = GetSnapshot();
+  EXPECT_FALSE(Find(metrics, "test_a"));
+  EXPECT_FALSE(Find(metrics, "test_b"));
+  EXPECT_FALSE(Find(metrics, "test_c"));
+}
+
+TEST(Metrics, ExportPrometheusText) {
+  Counter counter("test_requests_total", "Requests.\nAll of them.");
+  Gauge gauge("test_connections", "");
+  Histogram histogram("test_latency_seconds", "Latency.");
+  Histogram empty("test_empty_seconds", "");
+  counter.Increment(12u);
+  gauge.Set(-2);
+  histogram.Record(TimeDelta::FromMilliseconds(1));
+  histogram.Record(TimeDelta::FromMilliseconds(1));
+
+  std::vector<MetricSnapshot> metrics;
+  for (const char* name : {"test_connections", "test_empty_seconds",
+                           "test_latency_seconds", "test_requests_total"}) {
+    for (MetricSnapshot& metric : GetSnapshot()) {
+      if (metric.name == name)
+        metrics.push_back(std::move(metric));
+    }
+  }
+  ASSERT_EQ(4u, metrics.size());
+  EXPECT_EQ(
+      "# TYPE test_connections gauge\n"
+      "test_connections -2\n"
+      "# TYPE test_empty_seconds summary\n"
+      "test_empty_seconds{quantile=\"0.5\"} NaN\n"
+      "test_empty_seconds{quantile=\"0.9\"} NaN\n"
+      "test_empty_seconds{quantile=\"0.99\"} NaN\n"
+      "test_empty_seconds{quantile=\"0.999\"} NaN\n"
+      "test_empty_seconds_sum 0\n"
+      "test_empty_seconds_count 0\n"
+      "# HELP test_latency_seconds Latency.\n"
+      "# TYPE test_latency_seconds summary\n"
+      "test_latency_seconds{quantile=\"0.5\"} 0.001\n"
+      "test_latency_seconds{quantile=\"0.9\"} 0.001\n"
+      "test_latency_seconds{quantile=\"0.99\"} 0.001\n"
+      "test_latency_seconds{quantile=\"0.999\"} 0.001\n"
+      "test_latency_seconds_sum 0.002\n"
+      "test_latency_seconds_count 2\n"
+      "# HELP test_requests_total Requests.\\nAll of them.\n"
+      "# TYPE test_requests_total counter\n"
+      "test_requests_total 12\n",
+      ExportPrometheusText(metrics));
+}
+
+TEST(Metrics, EncodeAndDecode) {
+  std::vector<MetricSnapshot> metrics;
+  metrics.emplace_back();
+  metrics.back().type = MetricType::kCounter;
+  metrics.back().name = "counter";
+  metrics.back().help = "Help.";
+  metrics.back().counter_value = UINT64_MAX;
+  metrics.emplace_back();
+  metrics.back().type = MetricType::kGauge;
+  metrics.back().name = "gauge";
+  metrics.back().gauge_value = INT64_MIN;
+  metrics.emplace_back();
+  metrics.back().type = MetricType::kHistogram;
+  metrics.back().name = "histogram";
+  metrics.back().histogram.reset(new LatencyHistogram::Snapshot());
+  for (int i = 1; i <= 1000; i++)
+    metrics.back().histogram->Record(TimeDelta::FromMicroseconds(i));
+
+  const std::string data = EncodeSnapshot(metrics);
+  std::vector<MetricSnapshot> decoded;
+  ASSERT_TRUE(DecodeSnapshot(StringView(data), &decoded));
+  ASSERT_EQ(3u, decoded.size());
+  EXPECT_EQ(ExportPrometheusText(metrics), ExportPrometheusText(decoded));
+  EXPECT_EQ(UINT64_MAX, decoded[0].counter_value);
+  EXPECT_EQ("Help.", decoded[0].help);
+  EXPECT_EQ(INT64_MIN, decoded[1].gauge_value);
+  ASSERT_TRUE(decoded[2].histogram);
+  EXPECT_EQ(metrics[2].histogram->ToString(), decoded[2].histogram->ToString());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1), decoded[2].histogram->min());
+
+  // No metrics is fine, but a truncated one isn't: the prefixes that decode
+  // are only those which end between metrics.
+  ASSERT_TRUE(DecodeSnapshot(StringView(EncodeSnapshot({})), &decoded));
+  EXPECT_TRUE(decoded.empty());
+  size_t decodable_prefixes = 0u;
+  for (size_t size = 0u; size < data.size(); size++) {
+    if (DecodeSnapshot(StringView(data.data(), size), &decoded))
+      decodable_prefixes++;
+  }
+  EXPECT_EQ(3u, decodable_prefixes);
+  std::string bad_type = data;
+  bad_type[8] = 7;
+  EXPECT_FALSE(DecodeSnapshot(StringView(bad_type), &decoded));
+}
+
+}  // namespace
+}  // namespace metrics
+}  // namespace ftl
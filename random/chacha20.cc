@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/random/chacha20.h"
+
+namespace ftl {
+namespace {
+
+inline uint32_t LoadLittleEndian(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) |
+         static_cast<uint32_t>(bytes[1]) << 8 |
+         static_cast<uint32_t>(bytes[2]) << 16 |
+         static_cast<uint32_t>(bytes[3]) << 24;
+}
+
+inline void StoreLittleEndian(uint32_t value, uint8_t* bytes) {
+  bytes[0] = static_cast<uint8_t>(value);
+  bytes[1] = static_cast<uint8_t>(value >> 8);
+  bytes[2] = static_cast<uint8_t>(value >> 16);
+  bytes[3] = static_cast<uint8_t>(value >> 24);
+}
+
+inline uint32_t RotateLeft(uint32_t value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+inline void QuarterRound(uint32_t* x, int a, int b, int c, int d) {
+  x[a] += x[b];
+  x[d] = RotateLeft(x[d] ^ x[a], 16);
+  x[c] += x[d];
+  x[b] = RotateLeft(x[b] ^ x[c], 12);
+  x[a] += x[b];
+  x[d] = RotateLeft(x[d] ^ x[a], 8);
+  x[c] += x[d];
+  x[b] = RotateLeft(x[b] ^ x[c], 7);
+}
+
+}  // namespace
+
+void ChaCha20Blocks(const uint8_t key[kChaCha20KeySize],
+                    const uint8_t nonce[kChaCha20NonceSize],
+                    uint32_t counter,
+                    uint8_t* output,
+                    size_t block_count) {
+  // "expand 32-byte k", the key, the counter and the nonce.
+  uint32_t state[16] = {0x61707865u, 0x3320646eu, 0x79622d32u, 0x6b206574u};
+  for (int i = 0; i < 8; i++)
+    state[4 + i] = LoadLittleEndian(key + 4 * i);
+  for (int i = 0; i < 3; i++)
+    state[13 + i] = LoadLittleEndian(nonce + 4 * i);
+
+  for (size_t block = 0u; block < block_count; block++) {
+    state[12] = counter + static_cast<uint32_t>(block);
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++)
+      x[i] = state[i];
+    for (int round = 0; round < 10; round++) {
+      // A column round, then a diagonal round.
+      QuarterRound(x, 0, 4, 8, 12);
+      QuarterRound(x, 1, 5, 9, 13);
+      QuarterRound(x, 2, 6, 10, 14);
+      QuarterRound(x, 3, 7, 11, 15);
+      QuarterRound(x, 0, 5, 10, 15);
+      QuarterRound(x, 1, 6, 11, 12);
+      QuarterRound(x, 2, 7, 8, 13);
+      QuarterRound(x, 3, 4, 9, 14);
+    }
+    for (int i = 0; i < 16; i++)
+      StoreLittleEndian(x[i] + state[i], output + 4 * i);
+    output += kChaCha20BlockSize;
+  }
+}
+
+}  // namespace ftl
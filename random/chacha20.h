@@ -0,0 +1,33 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The ChaCha20 block function (RFC 7539), which |RandBytes()| generates its
+// output with. This only produces keystream: it doesn't authenticate, so
+// isn't, by itself, a way to encrypt messages.
+
+#ifndef LIB_FTL_RANDOM_CHACHA20_H_
+#define LIB_FTL_RANDOM_CHACHA20_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/ftl/ftl_export.h"
+
+namespace ftl {
+
+constexpr size_t kChaCha20KeySize = 32u;
+constexpr size_t kChaCha20NonceSize = 12u;
+constexpr size_t kChaCha20BlockSize = 64u;
+
+// Writes the |block_count| blocks of keystream for |key| and |nonce| starting
+// at block |counter| (which mustn't wrap around) to |output|.
+FTL_EXPORT void ChaCha20Blocks(const uint8_t key[kChaCha20KeySize],
+                               const uint8_t nonce[kChaCha20NonceSize],
+                               uint32_t counter,
+                               uint8_t* output,
+                               size_t block_count);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_RANDOM_CHACHA20_H_
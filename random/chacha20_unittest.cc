@@ -0,0 +1,59 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/random/chacha20.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+// RFC 7539, section 2.3.2.
+TEST(ChaCha20, Rfc7539Block) {
+  uint8_t key[kChaCha20KeySize];
+  for (size_t i = 0u; i < sizeof(key); i++)
+    key[i] = static_cast<uint8_t>(i);
+  const uint8_t nonce[kChaCha20NonceSize] = {0, 0, 0, 9, 0, 0, 0, 0x4a, 0, 0,
+                                             0, 0};
+  const uint8_t expected[kChaCha20BlockSize] = {
+      0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd,
+      0x1f, 0xa3, 0x20, 0x71, 0xc4, 0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0,
+      0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e, 0xd2,
+      0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05,
+      0xd9, 0x8b, 0x02, 0xa2, 0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e,
+      0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e};
+
+  uint8_t output[kChaCha20BlockSize];
+  ChaCha20Blocks(key, nonce, 1u, output, 1u);
+  EXPECT_EQ(0, memcmp(expected, output, sizeof(output)));
+}
+
+// RFC 7539, appendix A.1, test vectors #1 and #2.
+TEST(ChaCha20, ZeroKeyBlocks) {
+  const uint8_t key[kChaCha20KeySize] = {};
+  const uint8_t nonce[kChaCha20NonceSize] = {};
+  const uint8_t expected_first[16] = {0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1,
+                                      0x3d, 0x90, 0x40, 0x5d, 0x6a, 0xe5,
+                                      0x53, 0x86, 0xbd, 0x28};
+  const uint8_t expected_second[16] = {0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51,
+                                       0x38, 0x7a, 0x98, 0xba, 0x97, 0x7c,
+                                       0x73, 0x2d, 0x08, 0x0d};
+
+  uint8_t output[2u * kChaCha20BlockSize];
+  ChaCha20Blocks(key, nonce, 0u, output, 2u);
+  EXPECT_EQ(0, memcmp(expected_first, output, sizeof(expected_first)));
+  EXPECT_EQ(0, memcmp(expected_second, output + kChaCha20BlockSize,
+                      sizeof(expected_second)));
+
+  // Blocks don't depend on the ones before them.
+  uint8_t second[kChaCha20BlockSize];
+  ChaCha20Blocks(key, nonce, 1u, second, 1u);
+  EXPECT_EQ(0, memcmp(output + kChaCha20BlockSize, second, sizeof(second)));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,129 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/random/fast_random.h"
+
+#include "lib/ftl/random/rand.h"
+#include "lib/ftl/threading/fork_handlers.h"
+
+namespace ftl {
+namespace {
+
+// SplitMix64, which spreads a seed over xoshiro's state (which mustn't be all
+// zero).
+uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+struct ThreadRandom {
+  ThreadRandom() {
+    TrackForks();
+    fork_generation = GetForkGeneration();
+  }
+
+  FastRandom random;
+  uint32_t fork_generation;
+};
+
+}  // namespace
+
+FastRandom::FastRandom() {
+  Seed(RandUint64());
+}
+
+FastRandom* FastRandom::ForCurrentThread() {
+  thread_local ThreadRandom thread_random;
+  const uint32_t fork_generation = GetForkGeneration();
+  if (thread_random.fork_generation != fork_generation) {
+    thread_random.random.Seed(RandUint64());
+    thread_random.fork_generation = fork_generation;
+  }
+  return &thread_random.random;
+}
+
+void FastRandom::Seed(uint64_t seed) {
+  for (uint64_t& word : state_)
+    word = SplitMix64(&seed);
+}
+
+int64_t FastRandom::UniformInt(int64_t min, int64_t max) {
+  FTL_DCHECK(min <= max);
+  const uint64_t range =
+      static_cast<uint64_t>(max) - static_cast<uint64_t>(min);
+  const uint64_t offset =
+      range == UINT64_MAX ? Next() : UniformUint64(range + 1u);
+  return static_cast<int64_t>(static_cast<uint64_t>(min) + offset);
+}
+
+size_t FastRandom::WeightedIndex(const double* weights, size_t count) {
+  FTL_DCHECK(count > 0u);
+  double total = 0.0;
+  for (size_t i = 0u; i < count; i++) {
+    FTL_DCHECK(weights[i] >= 0.0);
+    total += weights[i];
+  }
+  FTL_DCHECK(total > 0.0);
+  double target = UniformDouble() * total;
+  size_t last = 0u;
+  for (size_t i = 0u; i < count; i++) {
+    if (weights[i] <= 0.0)
+      continue;
+    if (target < weights[i])
+      return i;
+    target -= weights[i];
+    last = i;
+  }
+  // (Rounding can leave |target| just past the last weight.)
+  return last;
+}
+
+WeightedSampler::WeightedSampler(const std::vector<double>& weights)
+    : probabilities_(weights.size()), aliases_(weights.size()) {
+  const size_t count = weights.size();
+  FTL_DCHECK(count > 0u);
+  double total = 0.0;
+  for (double weight : weights) {
+    FTL_DCHECK(weight >= 0.0);
+    total += weight;
+  }
+  FTL_DCHECK(total > 0.0);
+
+  // Scale the weights to average 1, then fill each column with an underfull
+  // ("small") weight topped up from an overfull ("large") one.
+  std::vector<double> scaled(count);
+  std::vector<size_t> small;
+  std::vector<size_t> large;
+  for (size_t i = 0u; i < count; i++) {
+    scaled[i] = weights[i] * static_cast<double>(count) / total;
+    (scaled[i] < 1.0 ? small : large).push_back(i);
+  }
+  while (!small.empty() && !large.empty()) {
+    const size_t less = small.back();
+    small.pop_back();
+    const size_t more = large.back();
+    probabilities_[less] = scaled[less];
+    aliases_[less] = more;
+    scaled[more] -= 1.0 - scaled[less];
+    if (scaled[more] < 1.0) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  // What's left is (up to rounding) exactly full.
+  for (size_t i : large) {
+    probabilities_[i] = 1.0;
+    aliases_[i] = i;
+  }
+  for (size_t i : small) {
+    probabilities_[i] = 1.0;
+    aliases_[i] = i;
+  }
+}
+
+WeightedSampler::~WeightedSampler() {}
+
+}  // namespace ftl
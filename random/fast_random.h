@@ -0,0 +1,154 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A fast, non-cryptographic random number generator, for jitter, sampling,
+// backoff and such, e.g.:
+//
+//   TimeDelta delay = base * FastRandom::ForCurrentThread()->UniformDouble(
+//                                0.5, 1.5);
+//
+// Its output is predictable from a little of it, so use |RandBytes()| (see
+// rand.h) for anything an adversary mustn't guess, like keys or tokens.
+
+#ifndef LIB_FTL_RANDOM_FAST_RANDOM_H_
+#define LIB_FTL_RANDOM_FAST_RANDOM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// xoshiro256**: 256 bits of state, a period of 2^256 - 1, and about a
+// nanosecond per number. Not thread-safe: use one per thread (e.g., the
+// thread's own, from |ForCurrentThread()|). This meets the requirements of a
+// UniformRandomBitGenerator, so also works with <random>'s distributions.
+class FTL_EXPORT FastRandom final {
+ public:
+  using result_type = uint64_t;
+
+  // Seeded from |RandUint64()|.
+  FastRandom();
+  // Seeded from |seed|, for a reproducible sequence.
+  explicit FastRandom(uint64_t seed) { Seed(seed); }
+
+  // The calling thread's generator, seeded (from |RandUint64()|) on its first
+  // use by the thread, and reseeded in the child after a fork(), so that
+  // forked processes don't all make the same choices.
+  static FastRandom* ForCurrentThread();
+
+  void Seed(uint64_t seed);
+
+  static constexpr uint64_t min() { return 0u; }
+  static constexpr uint64_t max() { return UINT64_MAX; }
+  uint64_t operator()() { return Next(); }
+
+  // Returns a number in [0, UINT64_MAX].
+  uint64_t Next() {
+    const uint64_t result = RotateLeft(state_[1] * 5u, 7) * 9u;
+    const uint64_t t = state_[1] << 17;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = RotateLeft(state_[3], 45);
+    return result;
+  }
+
+  // Returns a number in [0, |bound|), uniformly (without modulo bias), for
+  // |bound| > 0.
+  uint64_t UniformUint64(uint64_t bound) {
+    FTL_DCHECK(bound > 0u);
+#if defined(__SIZEOF_INT128__)
+    // Lemire's method: take the high half of a 64x64->128-bit product,
+    // rejecting the (few) products which would make it biased.
+    unsigned __int128 product =
+        static_cast<unsigned __int128>(Next()) * bound;
+    uint64_t low = static_cast<uint64_t>(product);
+    if (low < bound) {
+      const uint64_t threshold = (0u - bound) % bound;
+      while (low < threshold) {
+        product = static_cast<unsigned __int128>(Next()) * bound;
+        low = static_cast<uint64_t>(product);
+      }
+    }
+    return static_cast<uint64_t>(product >> 64);
+#else
+    const uint64_t threshold = (0u - bound) % bound;
+    for (;;) {
+      const uint64_t value = Next();
+      if (value >= threshold)
+        return value % bound;
+    }
+#endif
+  }
+
+  // Returns a number in [|min|, |max|], uniformly, for |min| <= |max|.
+  int64_t UniformInt(int64_t min, int64_t max);
+
+  // Returns a number in [0, 1), uniformly (from 53 random bits).
+  double UniformDouble() {
+    return static_cast<double>(Next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // Returns a number in [|min|, |max|), uniformly, for |min| < |max|.
+  double UniformDouble(double min, double max) {
+    return min + (max - min) * UniformDouble();
+  }
+
+  // Returns true with probability |p| (so never if |p| <= 0, and always if
+  // |p| >= 1).
+  bool Bernoulli(double p) { return UniformDouble() < p; }
+
+  // Returns an index in [0, |count|), |i| with probability |weights[i]| over
+  // the sum of the weights, which must be non-negative, and not all zero. This
+  // takes time linear in |count|; for many samples from the same weights, use
+  // |WeightedSampler|.
+  size_t WeightedIndex(const double* weights, size_t count);
+
+ private:
+  static uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
+
+  uint64_t state_[4];
+};
+
+// Samples indices with given weights in constant time, after linear-time set
+// up (Vose's alias method).
+class FTL_EXPORT WeightedSampler final {
+ public:
+  // |weights| must be non-empty, non-negative and not all zero.
+  explicit WeightedSampler(const std::vector<double>& weights);
+  ~WeightedSampler();
+
+  size_t size() const { return probabilities_.size(); }
+
+  // Returns an index in [0, |size()|), |i| with probability |weights[i]| over
+  // the sum of the weights.
+  size_t Sample(FastRandom* random) const {
+    const size_t column =
+        static_cast<size_t>(random->UniformUint64(probabilities_.size()));
+    return random->UniformDouble() < probabilities_[column] ? column
+                                                            : aliases_[column];
+  }
+
+ private:
+  // For each column, the probability of choosing it (rather than its alias)
+  // once it's been picked.
+  std::vector<double> probabilities_;
+  std::vector<size_t> aliases_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WeightedSampler);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_RANDOM_FAST_RANDOM_H_
@@ -0,0 +1,199 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/random/fast_random.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace ftl {
+namespace {
+
+constexpr int kSamples = 100000;
+
+TEST(FastRandom, Seeded) {
+  FastRandom a(42u);
+  FastRandom b(42u);
+  FastRandom c(43u);
+  std::set<uint64_t> numbers;
+  for (int i = 0; i < 1000; i++) {
+    const uint64_t number = a.Next();
+    EXPECT_EQ(number, b.Next());
+    numbers.insert(number);
+    numbers.insert(c.Next());
+  }
+  EXPECT_EQ(2000u, numbers.size());
+
+  a.Seed(7u);
+  b.Seed(7u);
+  EXPECT_EQ(a(), b());
+}
+
+TEST(FastRandom, Unseeded) {
+  FastRandom a;
+  FastRandom b;
+  EXPECT_NE(a.Next(), b.Next());
+}
+
+TEST(FastRandom, UniformUint64) {
+  FastRandom random(1u);
+  int counts[10] = {};
+  for (int i = 0; i < kSamples; i++) {
+    const uint64_t value = random.UniformUint64(10u);
+    ASSERT_LT(value, 10u);
+    counts[value]++;
+  }
+  for (int count : counts) {
+    EXPECT_LT(kSamples / 10 * 9 / 10, count);
+    EXPECT_GT(kSamples / 10 * 11 / 10, count);
+  }
+  EXPECT_EQ(0u, random.UniformUint64(1u));
+  // (The largest bounds reject the most.)
+  for (int i = 0; i < 100; i++)
+    EXPECT_LT(random.UniformUint64(UINT64_MAX), UINT64_MAX);
+}
+
+TEST(FastRandom, UniformInt) {
+  FastRandom random(2u);
+  bool seen[7] = {};
+  for (int i = 0; i < 1000; i++) {
+    const int64_t value = random.UniformInt(-3, 3);
+    ASSERT_TRUE(value >= -3 && value <= 3);
+    seen[value + 3] = true;
+  }
+  for (bool s : seen)
+    EXPECT_TRUE(s);
+  EXPECT_EQ(5, random.UniformInt(5, 5));
+  // The full range.
+  std::set<int64_t> values;
+  for (int i = 0; i < 100; i++)
+    values.insert(random.UniformInt(INT64_MIN, INT64_MAX));
+  EXPECT_EQ(100u, values.size());
+  EXPECT_LE(random.UniformInt(INT64_MAX - 1, INT64_MAX), INT64_MAX);
+}
+
+TEST(FastRandom, UniformDouble) {
+  FastRandom random(3u);
+  double sum = 0.0;
+  for (int i = 0; i < kSamples; i++) {
+    const double value = random.UniformDouble();
+    ASSERT_TRUE(value >= 0.0 && value < 1.0);
+    sum += value;
+  }
+  EXPECT_NEAR(0.5, sum / kSamples, 0.01);
+  for (int i = 0; i < 1000; i++) {
+    const double value = random.UniformDouble(-2.0, 6.0);
+    ASSERT_TRUE(value >= -2.0 && value < 6.0);
+  }
+}
+
+TEST(FastRandom, Bernoulli) {
+  FastRandom random(4u);
+  int trues = 0;
+  for (int i = 0; i < kSamples; i++) {
+    EXPECT_FALSE(random.Bernoulli(0.0));
+    EXPECT_TRUE(random.Bernoulli(1.0));
+    trues += random.Bernoulli(0.25);
+  }
+  EXPECT_NEAR(0.25, static_cast<double>(trues) / kSamples, 0.01);
+}
+
+TEST(FastRandom, WeightedIndex) {
+  FastRandom random(5u);
+  const double weights[] = {1.0, 0.0, 3.0, 6.0};
+  int counts[4] = {};
+  for (int i = 0; i < kSamples; i++)
+    counts[random.WeightedIndex(weights, 4u)]++;
+  EXPECT_EQ(0, counts[1]);
+  EXPECT_NEAR(0.1, static_cast<double>(counts[0]) / kSamples, 0.01);
+  EXPECT_NEAR(0.3, static_cast<double>(counts[2]) / kSamples, 0.01);
+  EXPECT_NEAR(0.6, static_cast<double>(counts[3]) / kSamples, 0.01);
+}
+
+TEST(FastRandom, WeightedSampler) {
+  FastRandom random(6u);
+  WeightedSampler sampler({0.0, 2.0, 0.5, 0.0, 7.5});
+  EXPECT_EQ(5u, sampler.size());
+  int counts[5] = {};
+  for (int i = 0; i < kSamples; i++)
+    counts[sampler.Sample(&random)]++;
+  EXPECT_EQ(0, counts[0]);
+  EXPECT_EQ(0, counts[3]);
+  EXPECT_NEAR(0.2, static_cast<double>(counts[1]) / kSamples, 0.01);
+  EXPECT_NEAR(0.05, static_cast<double>(counts[2]) / kSamples, 0.01);
+  EXPECT_NEAR(0.75, static_cast<double>(counts[4]) / kSamples, 0.01);
+
+  WeightedSampler single({3.0});
+  EXPECT_EQ(0u, single.Sample(&random));
+}
+
+TEST(FastRandom, StandardDistributions) {
+  FastRandom random(7u);
+  std::vector<int> values = {1, 2, 3, 4, 5, 6, 7, 8};
+  std::shuffle(values.begin(), values.end(), random);
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ((std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8}), values);
+  std::uniform_int_distribution<int> distribution(1, 6);
+  const int roll = distribution(random);
+  EXPECT_TRUE(roll >= 1 && roll <= 6);
+}
+
+TEST(FastRandom, ForCurrentThread) {
+  FastRandom* random = FastRandom::ForCurrentThread();
+  EXPECT_EQ(random, FastRandom::ForCurrentThread());
+  std::vector<uint64_t> numbers(4u);
+  std::vector<std::thread> threads;
+  for (size_t t = 0u; t < numbers.size(); t++) {
+    threads.emplace_back([&numbers, random, t] {
+      EXPECT_NE(random, FastRandom::ForCurrentThread());
+      numbers[t] = FastRandom::ForCurrentThread()->Next();
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  numbers.push_back(random->Next());
+  EXPECT_EQ(numbers.size(),
+            std::set<uint64_t>(numbers.begin(), numbers.end()).size());
+}
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+TEST(FastRandom, Fork) {
+  // The child mustn't repeat what its parent generates next.
+  FastRandom::ForCurrentThread()->Next();
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  pid_t pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    uint64_t number = FastRandom::ForCurrentThread()->Next();
+    _exit(write(fds[1], &number, sizeof(number)) == sizeof(number) ? 0 : 1);
+  }
+  close(fds[1]);
+  const uint64_t number = FastRandom::ForCurrentThread()->Next();
+  uint64_t child_number = 0u;
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(child_number)),
+            read(fds[0], &child_number, sizeof(child_number)));
+  close(fds[0]);
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  EXPECT_NE(number, child_number);
+}
+#endif
+
+}  // namespace
+}  // namespace ftl
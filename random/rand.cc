@@ -23,17 +23,192 @@
 #include <algorithm>
 #include <limits>
 
+#elif defined(OS_MACOSX) || defined(OS_BSD)
+// arc4random_buf() is already a (ChaCha20) generator in the process, seeded
+// from the kernel, and reseeded after a fork().
+#include <stdlib.h>
+
+#define FTL_HAS_ARC4RANDOM 1
+
 #else
 #include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+
 #include "lib/ftl/files/file_descriptor.h"
-#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/random/chacha20.h"
+#include "lib/ftl/threading/fork_handlers.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/syscall.h>
+#endif
 #endif
 
 namespace ftl {
 
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN) && !defined(FTL_HAS_ARC4RANDOM)
+namespace {
+
+#if defined(SYS_getrandom)
+// Cleared once getrandom() turns out not to exist (before Linux 3.17).
+std::atomic<bool> g_has_getrandom(true);
+#endif
+
+// /dev/urandom, opened once (so that reading it doesn't need a free
+// descriptor every time), or -1 until it's opened.
+std::atomic<int> g_urandom_fd(-1);
+
+// Returns the process's descriptor for /dev/urandom, opening it if it isn't
+// yet, or -1 if it can't be (in which case, a later call tries again).
+int GetUrandomFD() {
+  int fd = g_urandom_fd.load(std::memory_order_acquire);
+  if (fd >= 0)
+    return fd;
+  int opened = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+  if (opened < 0)
+    return -1;
+  if (g_urandom_fd.compare_exchange_strong(fd, opened,
+                                           std::memory_order_acq_rel)) {
+    return opened;
+  }
+  // Another thread opened it first.
+  close(opened);
+  return fd;
+}
+
+// Reads |size| bytes from the system's generator: getrandom() where there's
+// one, otherwise /dev/urandom.
+bool SystemRandBytes(unsigned char* output, size_t size) {
+#if defined(SYS_getrandom)
+  while (size && g_has_getrandom.load(std::memory_order_relaxed)) {
+    long read = syscall(SYS_getrandom, output, size, 0);
+    if (read < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno != ENOSYS)
+        return false;
+      g_has_getrandom.store(false, std::memory_order_relaxed);
+      break;
+    }
+    output += read;
+    size -= static_cast<size_t>(read);
+  }
+  if (!size)
+    return true;
+#endif
+  const int fd = GetUrandomFD();
+  if (fd < 0)
+    return false;
+  return ReadFileDescriptor(fd, reinterpret_cast<char*>(output),
+                            static_cast<ssize_t>(size)) ==
+         static_cast<ssize_t>(size);
+}
+
+// Overwrites |size| bytes at |data| with zeros, in a way the compiler won't
+// optimize away.
+void SecureZero(void* data, size_t size) {
+  memset(data, 0, size);
+  // (The compiler has to assume that the zeros are read.)
+  __asm__ __volatile__("" : : "r"(data) : "memory");
+}
+
+// A thread's generator: ChaCha20 keystream, with "fast key erasure" (each
+// refill of the buffer starts with the next key, and bytes are erased as
+// they're handed out), so that its state never reveals past output. It's
+// seeded from the system, and reseeded after every |kReseedInterval| bytes,
+// and after a fork().
+class RandomGenerator final {
+ public:
+  // (A child of a fork() mustn't repeat its parent's output.)
+  RandomGenerator() { TrackForks(); }
+
+  ~RandomGenerator() { SecureZero(this, sizeof(*this)); }
+
+  bool Generate(unsigned char* output, size_t size) {
+    if (!until_reseed_ ||
+        fork_generation_ != GetForkGeneration()) {
+      if (!Reseed())
+        return false;
+    }
+    while (size) {
+      if (!available_)
+        Refill();
+      const size_t chunk = std::min(size, available_);
+      unsigned char* bytes = buffer_ + sizeof(buffer_) - available_;
+      memcpy(output, bytes, chunk);
+      SecureZero(bytes, chunk);
+      available_ -= chunk;
+      output += chunk;
+      size -= chunk;
+      until_reseed_ -= std::min(until_reseed_, static_cast<uint64_t>(chunk));
+    }
+    return true;
+  }
+
+ private:
+  static constexpr size_t kBufferBlocks = 16u;
+  static constexpr uint64_t kReseedInterval = 1024u * 1024u;
+
+  bool Reseed() {
+    unsigned char seed[kChaCha20KeySize];
+    if (!SystemRandBytes(seed, sizeof(seed)))
+      return false;
+    // (Mixed into the old key, which can't hurt.)
+    for (size_t i = 0u; i < sizeof(seed); i++)
+      key_[i] ^= seed[i];
+    SecureZero(seed, sizeof(seed));
+    SecureZero(buffer_, sizeof(buffer_));
+    available_ = 0u;
+    until_reseed_ = kReseedInterval;
+    fork_generation_ = GetForkGeneration();
+    return true;
+  }
+
+  void Refill() {
+    // Each key generates one buffer (so, the nonce can stay zero).
+    static const uint8_t kNonce[kChaCha20NonceSize] = {};
+    ChaCha20Blocks(key_, kNonce, 0u, buffer_, kBufferBlocks);
+    memcpy(key_, buffer_, sizeof(key_));
+    SecureZero(buffer_, sizeof(key_));
+    available_ = sizeof(buffer_) - sizeof(key_);
+  }
+
+  uint8_t key_[kChaCha20KeySize] = {};
+  uint8_t buffer_[kBufferBlocks * kChaCha20BlockSize];
+  // The unused bytes at the end of |buffer_|.
+  size_t available_ = 0u;
+  uint64_t until_reseed_ = 0u;
+  uint32_t fork_generation_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RandomGenerator);
+};
+
+thread_local RandomGenerator* g_generator = nullptr;
+// Set once the thread's generator is destroyed, as it exits.
+thread_local bool g_generator_released = false;
+
+class RandomGeneratorReleaser final {
+ public:
+  RandomGeneratorReleaser() {}
+
+  ~RandomGeneratorReleaser() {
+    delete g_generator;
+    g_generator = nullptr;
+    g_generator_released = true;
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(RandomGeneratorReleaser);
+};
+
+}  // namespace
+#endif
+
 uint64_t RandUint64() {
   uint64_t number;
   bool success =
@@ -79,14 +254,19 @@ bool RandBytes(unsigned char* output, size_t output_length) {
     output += output_bytes_this_pass;
   }
   return success;
+#elif defined(FTL_HAS_ARC4RANDOM)
+  arc4random_buf(output, output_length);
+  return true;
 #else
-  ftl::UniqueFD fd(open("/dev/urandom", O_RDONLY | O_CLOEXEC));
-  if (!fd.is_valid())
-    return false;
-
-  const bool success =
-    ReadFileDescriptor(fd.get(), reinterpret_cast<char*>(output), output_length);
-
+  if (!g_generator) {
+    // (Once the thread's generator is gone, as the thread exits, straight
+    // from the system.)
+    if (g_generator_released)
+      return SystemRandBytes(output, output_length);
+    g_generator = new RandomGenerator();
+    static thread_local RandomGeneratorReleaser releaser;
+  }
+  const bool success = g_generator->Generate(output, output_length);
   FTL_DCHECK(success);
   return success;
 #endif
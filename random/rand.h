@@ -17,6 +17,12 @@ namespace ftl {
 // Returns a random number in range [0, UINT64_MAX]
 FTL_EXPORT uint64_t RandUint64();
 
+// Fills |output| with cryptographically secure random bytes, returning false
+// if the system's generator can't be read. Most calls don't make a system
+// call: on Mac and the BSDs, these come from arc4random_buf(); on Linux (and
+// other POSIX systems), from a generator of the calling thread's (ChaCha20,
+// seeded from getrandom(), or else /dev/urandom, which is opened once, and
+// reseeded after each MiB and after a fork()).
 FTL_EXPORT bool RandBytes(unsigned char* output, size_t output_length);
 
 }  // namespace ftl
@@ -0,0 +1,29 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <vector>
+
+#include "lib/ftl/random/rand.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_RandBytes(benchmark::State& state) {
+  std::vector<unsigned char> buffer(static_cast<size_t>(state.range(0)));
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(RandBytes(buffer.data(), buffer.size()));
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(buffer.size()));
+}
+FTL_BENCHMARK(BM_RandBytes)->Arg(16)->Arg(4096);
+
+void BM_RandUint64(benchmark::State& state) {
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(RandUint64());
+}
+FTL_BENCHMARK(BM_RandUint64);
+
+}  // namespace
+}  // namespace ftl
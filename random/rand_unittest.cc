@@ -6,10 +6,21 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 namespace ftl {
 namespace {
@@ -31,5 +42,83 @@ TEST(Random, RandBytes) {
   }
 }
 
+TEST(Random, RandBytesLarge) {
+  // More than the generator buffers, and than its reseed interval.
+  std::vector<uint8_t> buf(3u * 1024u * 1024u + 1u);
+  EXPECT_TRUE(RandBytes(buf.data(), buf.size()));
+  // (Each byte value turns up, in about 12k places, if it's random.)
+  size_t counts[256] = {};
+  for (uint8_t byte : buf)
+    counts[byte]++;
+  for (size_t count : counts)
+    EXPECT_LT(10000u, count);
+}
+
+TEST(Random, Distinct) {
+  std::set<uint64_t> numbers;
+  for (int i = 0; i < 1000; ++i)
+    numbers.insert(RandUint64());
+  // Other threads have generators of their own.
+  std::vector<std::thread> threads;
+  std::vector<uint64_t> thread_numbers(4u);
+  for (size_t t = 0u; t < thread_numbers.size(); ++t)
+    threads.emplace_back([&thread_numbers, t] {
+      thread_numbers[t] = RandUint64();
+    });
+  for (auto& thread : threads)
+    thread.join();
+  numbers.insert(thread_numbers.begin(), thread_numbers.end());
+  EXPECT_EQ(1004u, numbers.size());
+}
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+TEST(Random, Fork) {
+  // The child mustn't repeat what its parent generates next.
+  RandUint64();
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  pid_t pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    uint64_t number = RandUint64();
+    _exit(write(fds[1], &number, sizeof(number)) == sizeof(number) ? 0 : 1);
+  }
+  close(fds[1]);
+  const uint64_t number = RandUint64();
+  uint64_t child_number = 0u;
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(child_number)),
+            read(fds[0], &child_number, sizeof(child_number)));
+  close(fds[0]);
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  EXPECT_NE(number, child_number);
+}
+
+TEST(Random, NoFreeDescriptors) {
+  // Use up the descriptors (under a lowered limit).
+  struct rlimit old_limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &old_limit));
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = std::min<rlim_t>(old_limit.rlim_cur, 256u);
+  ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+  std::vector<int> fds;
+  for (int fd; (fd = open("/dev/null", O_RDONLY | O_CLOEXEC)) >= 0;)
+    fds.push_back(fd);
+
+  // A new thread seeds a generator of its own.
+  bool success = false;
+  std::thread([&success] {
+    unsigned char bytes[16];
+    success = RandBytes(bytes, sizeof(bytes));
+  }).join();
+  EXPECT_TRUE(success);
+
+  for (int fd : fds)
+    close(fd);
+  EXPECT_EQ(0, setrlimit(RLIMIT_NOFILE, &old_limit));
+}
+#endif
+
 }  // namespace
 }  // namespace ftl
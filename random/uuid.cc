@@ -6,66 +6,296 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <chrono>
 #include <string>
+#include <vector>
 
+#include "lib/ftl/logging.h"
 #include "lib/ftl/random/rand.h"
-#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/strings/hash.h"
+#include "lib/ftl/strings/hex.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 namespace {
 
-inline bool IsHexDigit(char c) {
-  return (c >= '0' && c <= '9') ||
-         (c >= 'A' && c <= 'F') ||
-         (c >= 'a' && c <= 'f');
+// The string form's groups of hex digits: where each starts, and how many
+// bytes it encodes.
+struct Group {
+  size_t offset;
+  size_t size;
+};
+
+constexpr Group kGroups[] = {{0u, 4u}, {9u, 2u}, {14u, 2u}, {19u, 2u},
+                             {24u, 6u}};
+
+// Sets the version (4, random) and variant (RFC 4122) bits, as described in
+// RFC 4122, section 4.4.
+void MakeVersion4(uint8_t* bytes) {
+  bytes[6] = static_cast<uint8_t>((bytes[6] & 0x0f) | 0x40);
+  bytes[8] = static_cast<uint8_t>((bytes[8] & 0x3f) | 0x80);
+}
+
+// Crockford's base 32 digits, for ULIDs.
+constexpr char kBase32Digits[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";
+
+// The values of the letters 'A' to 'Z' as base 32 digits, or -1 for those left
+// out (I, L, O and U).
+constexpr int8_t kBase32LetterValues[26] = {
+    10, 11, 12, 13, 14, 15, 16, 17, -1, 18, 19, -1, 20,
+    21, -1, 22, 23, 24, 25, 26, -1, 27, 28, 29, 30, 31};
+
+int Base32DigitValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'z')
+    c = static_cast<char>(c - 'a' + 'A');
+  if (c >= 'A' && c <= 'Z')
+    return kBase32LetterValues[c - 'A'];
+  return -1;
+}
+
+uint64_t LoadBigEndian64(const uint8_t* bytes) {
+  uint64_t value = 0u;
+  for (int i = 0; i < 8; i++)
+    value = value << 8 | bytes[i];
+  return value;
+}
+
+void StoreBigEndian64(uint64_t value, uint8_t* bytes) {
+  for (int i = 7; i >= 0; i--) {
+    bytes[i] = static_cast<uint8_t>(value);
+    value >>= 8;
+  }
+}
+
+// The 48-bit millisecond timestamp both UUIDv7s and ULIDs start with.
+uint64_t LoadTimestamp(const uint8_t* bytes) {
+  return LoadBigEndian64(bytes) >> 16;
+}
+
+void StoreTimestamp(uint64_t timestamp_ms, uint8_t* bytes) {
+  for (int i = 5; i >= 0; i--) {
+    bytes[i] = static_cast<uint8_t>(timestamp_ms);
+    timestamp_ms >>= 8;
+  }
+}
+
+// The Unix time in milliseconds, as |TimePoint::Now()| (which is monotonic)
+// plus its offset from the system clock when first called, so that a system
+// clock set back doesn't take time-ordered ids back with it.
+uint64_t GetUnixTimeMs() {
+  static const int64_t offset_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count() -
+      TimePoint::Now().ToEpochDelta().ToNanoseconds();
+  return static_cast<uint64_t>(
+      (TimePoint::Now().ToEpochDelta().ToNanoseconds() + offset_ns) /
+      1000000);
 }
 
-inline bool IsLowerHexDigit(char c) {
-  return (c >= '0' && c <= '9') ||
-         (c >= 'a' && c <= 'f');
+// A thread's last time-ordered ids, which its next ones must follow. (Reset in
+// the child of a fork(), so that it doesn't continue its parent's sequences,
+// to generate the same ids.)
+struct TimeOrderedState {
+  TimeOrderedState() {
+    TrackForks();
+    fork_generation = GetForkGeneration();
+  }
+
+  uint64_t uuid_timestamp_ms = 0u;
+  uint32_t uuid_counter = 0u;
+  uint64_t ulid_timestamp_ms = 0u;
+  uint8_t ulid_random[10] = {};
+  uint32_t fork_generation;
+};
+
+TimeOrderedState* GetTimeOrderedState() {
+  thread_local TimeOrderedState state;
+  const uint32_t fork_generation = GetForkGeneration();
+  if (state.fork_generation != fork_generation) {
+    state.uuid_timestamp_ms = 0u;
+    state.ulid_timestamp_ms = 0u;
+    state.fork_generation = fork_generation;
+  }
+  return &state;
 }
 
 bool IsValidUUIDInternal(const std::string& guid, bool strict) {
-  const size_t kUUIDLength = 36U;
-  if (guid.length() != kUUIDLength)
+  Uuid uuid;
+  if (!Uuid::Parse(guid, &uuid))
     return false;
-  for (size_t i = 0; i < guid.length(); ++i) {
-    char current = guid[i];
-    if (i == 8 || i == 13 || i == 18 || i == 23) {
-      if (current != '-')
-        return false;
-    } else {
-      if ((strict && !IsLowerHexDigit(current)) || !IsHexDigit(current))
-        return false;
+  if (!strict)
+    return true;
+  // (The output is all lowercase.)
+  char output[Uuid::kStringSize];
+  uuid.ToString(output);
+  return memcmp(output, guid.data(), sizeof(output)) == 0;
+}
+
+}  // namespace
+
+Uuid Uuid::Generate() {
+  Uuid uuid;
+  GenerateUUIDs(&uuid, 1u);
+  return uuid;
+}
+
+Uuid Uuid::GenerateV7() {
+  TimeOrderedState* state = GetTimeOrderedState();
+  // Two bytes to start a counter with, then the 62 random bits.
+  uint8_t random[10];
+  FTL_CHECK(RandBytes(random, sizeof(random)));
+  const uint64_t now_ms = GetUnixTimeMs();
+  // Counters start in their lower half, leaving room to count up.
+  const uint32_t start = (static_cast<uint32_t>(random[0]) << 8 | random[1]) &
+                         0x7ffu;
+  if (now_ms > state->uuid_timestamp_ms) {
+    state->uuid_timestamp_ms = now_ms;
+    state->uuid_counter = start;
+  } else if (++state->uuid_counter > 0xfffu) {
+    // Out of counter: borrow the next millisecond (RFC 9562, section 6.2).
+    state->uuid_timestamp_ms++;
+    state->uuid_counter = start;
+  }
+
+  Uuid uuid;
+  StoreTimestamp(state->uuid_timestamp_ms, uuid.bytes_);
+  uuid.bytes_[6] = static_cast<uint8_t>(0x70 | state->uuid_counter >> 8);
+  uuid.bytes_[7] = static_cast<uint8_t>(state->uuid_counter);
+  memcpy(uuid.bytes_ + 8, random + 2, 8u);
+  uuid.bytes_[8] = static_cast<uint8_t>((uuid.bytes_[8] & 0x3f) | 0x80);
+  return uuid;
+}
+
+bool Uuid::Parse(StringView string, Uuid* uuid) {
+  if (string.size() != kStringSize || string[8] != '-' ||
+      string[13] != '-' || string[18] != '-' || string[23] != '-')
+    return false;
+  // Decode the 32 digits at once.
+  char digits[32];
+  char* end = digits;
+  for (const Group& group : kGroups) {
+    memcpy(end, string.data() + group.offset, 2u * group.size);
+    end += 2u * group.size;
+  }
+  uint8_t bytes[16];
+  if (!HexDecode(StringView(digits, sizeof(digits)), bytes))
+    return false;
+  memcpy(uuid->bytes_, bytes, sizeof(bytes));
+  return true;
+}
+
+void Uuid::ToString(char* buffer) const {
+  // Encode the 32 digits at once.
+  char digits[32];
+  HexEncode(bytes_, sizeof(bytes_), digits);
+  const char* start = digits;
+  for (const Group& group : kGroups) {
+    if (group.offset)
+      buffer[group.offset - 1u] = '-';
+    memcpy(buffer + group.offset, start, 2u * group.size);
+    start += 2u * group.size;
+  }
+}
+
+std::string Uuid::ToString() const {
+  std::string result(kStringSize, '\0');
+  ToString(&result[0]);
+  return result;
+}
+
+uint64_t Uuid::timestamp_ms() const {
+  return LoadTimestamp(bytes_);
+}
+
+Ulid Ulid::Generate() {
+  TimeOrderedState* state = GetTimeOrderedState();
+  const uint64_t now_ms = GetUnixTimeMs();
+  bool fresh = now_ms > state->ulid_timestamp_ms;
+  if (fresh) {
+    state->ulid_timestamp_ms = now_ms;
+  } else {
+    // Increment the random bits, borrowing the next millisecond (with fresh
+    // ones) if they overflow.
+    int i = sizeof(state->ulid_random) - 1;
+    while (i >= 0 && ++state->ulid_random[i] == 0u)
+      i--;
+    if (i < 0) {
+      state->ulid_timestamp_ms++;
+      fresh = true;
     }
   }
+  if (fresh) {
+    FTL_CHECK(RandBytes(state->ulid_random, sizeof(state->ulid_random)));
+  }
+
+  Ulid ulid;
+  StoreTimestamp(state->ulid_timestamp_ms, ulid.bytes_);
+  memcpy(ulid.bytes_ + 6, state->ulid_random, sizeof(state->ulid_random));
+  return ulid;
+}
+
+bool Ulid::Parse(StringView string, Ulid* ulid) {
+  if (string.size() != kStringSize)
+    return false;
+  // The 130 bits of digits, of which the top two must be zero.
+  uint64_t high = 0u;
+  uint64_t low = 0u;
+  for (size_t i = 0u; i < kStringSize; i++) {
+    const int value = Base32DigitValue(string[i]);
+    if (value < 0 || (i == 0u && value > 7))
+      return false;
+    high = high << 5 | low >> 59;
+    low = low << 5 | static_cast<uint64_t>(value);
+  }
+  StoreBigEndian64(high, ulid->bytes_);
+  StoreBigEndian64(low, ulid->bytes_ + 8);
   return true;
 }
 
-}  // namespace
+uint64_t Ulid::timestamp_ms() const {
+  return LoadTimestamp(bytes_);
+}
 
-std::string GenerateUUID() {
-  uint64_t bytes[2] = {ftl::RandUint64(), ftl::RandUint64()};
+void Ulid::ToString(char* buffer) const {
+  uint64_t high = LoadBigEndian64(bytes_);
+  uint64_t low = LoadBigEndian64(bytes_ + 8);
+  for (size_t i = kStringSize; i-- > 0u;) {
+    buffer[i] = kBase32Digits[low & 0x1fu];
+    low = low >> 5 | high << 59;
+    high >>= 5;
+  }
+}
+
+std::string Ulid::ToString() const {
+  std::string result(kStringSize, '\0');
+  ToString(&result[0]);
+  return result;
+}
 
-  // Set the UUID to version 4 as described in RFC 4122, section 4.4.
-  // The format of UUID version 4 must be xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx,
-  // where y is one of [8, 9, A, B].
-  // Clear the version bits and set the version to 4:
-  bytes[0] &= 0xffffffffffff0fffULL;
-  bytes[0] |= 0x0000000000004000ULL;
+void GenerateUUIDs(Uuid* uuids, size_t count) {
+  static_assert(sizeof(Uuid) == 16u, "");
+  if (count == 0u)
+    return;
+  uint8_t* bytes = reinterpret_cast<uint8_t*>(uuids);
+  FTL_CHECK(RandBytes(bytes, 16u * count));
+  for (size_t i = 0u; i < count; i++)
+    MakeVersion4(bytes + 16u * i);
+}
 
-  // Set the two most significant bits (bits 6 and 7) of the
-  // clock_seq_hi_and_reserved to zero and one, respectively:
-  bytes[1] &= 0x3fffffffffffffffULL;
-  bytes[1] |= 0x8000000000000000ULL;
+std::vector<Uuid> GenerateUUIDs(size_t count) {
+  std::vector<Uuid> uuids(count);
+  GenerateUUIDs(uuids.data(), count);
+  return uuids;
+}
 
-  return StringPrintf("%08x-%04x-%04x-%04x-%012llx",
-                      static_cast<unsigned int>(bytes[0] >> 32),
-                      static_cast<unsigned int>((bytes[0] >> 16) & 0x0000ffff),
-                      static_cast<unsigned int>(bytes[0] & 0x0000ffff),
-                      static_cast<unsigned int>(bytes[1] >> 48),
-                      bytes[1] & 0x0000ffffffffffffULL);
+std::string GenerateUUID() {
+  return Uuid::Generate().ToString();
 }
 
 bool IsValidUUID(const std::string& guid) {
@@ -77,3 +307,17 @@ bool IsValidUUIDOutputString(const std::string& guid) {
 }
 
 }  // namespace ftl
+
+namespace std {
+
+size_t hash<ftl::Uuid>::operator()(const ftl::Uuid& uuid) const {
+  return static_cast<size_t>(ftl::HashString(
+      ftl::StringView(reinterpret_cast<const char*>(uuid.bytes()), 16u)));
+}
+
+size_t hash<ftl::Ulid>::operator()(const ftl::Ulid& ulid) const {
+  return static_cast<size_t>(ftl::HashString(
+      ftl::StringView(reinterpret_cast<const char*>(ulid.bytes()), 16u)));
+}
+
+}  // namespace std
@@ -5,14 +5,120 @@
 #ifndef FTL_RANDOM_UUID_H_
 #define FTL_RANDOM_UUID_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
 
 namespace ftl {
 
+// A UUID, as its 16 bytes (in the order RFC 4122 formats them), e.g., to keep
+// in a table instead of its 36-character string.
+class FTL_EXPORT Uuid final {
+ public:
+  // The size of the string form, e.g., "9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6d".
+  static constexpr size_t kStringSize = 36u;
+
+  // The nil UUID (all zeros).
+  constexpr Uuid() : bytes_{} {}
+  explicit Uuid(const uint8_t bytes[16]) { memcpy(bytes_, bytes, 16u); }
+
+  // Returns a random (version 4) UUID.
+  static Uuid Generate();
+
+  // Returns a time-ordered (version 7, RFC 9562) UUID: the Unix time in
+  // milliseconds (48 bits), a counter (12 bits), then 62 random bits. Those
+  // from one thread strictly increase (the counter orders those within a
+  // millisecond); those from different threads are ordered to the
+  // millisecond. Unlike random UUIDs, these keep inserts into an ordered index
+  // (e.g., a B-tree) at its end.
+  static Uuid GenerateV7();
+
+  // Parses a UUID's string form (with hex digits of either case, and any
+  // version) into |*uuid|, or returns false (leaving |*uuid| alone) if
+  // |string| isn't one.
+  static bool Parse(StringView string, Uuid* uuid);
+
+  const uint8_t* bytes() const { return bytes_; }
+  bool is_nil() const { return *this == Uuid(); }
+  // (4 for random UUIDs, 7 for time-ordered ones.)
+  int version() const { return bytes_[6] >> 4; }
+  // The Unix time, in milliseconds, of a version 7 UUID.
+  uint64_t timestamp_ms() const;
+
+  // Writes the |kStringSize| characters of the string form (with lowercase
+  // hex digits) to |buffer|, without a terminating null.
+  void ToString(char* buffer) const;
+  std::string ToString() const;
+
+  bool operator==(const Uuid& other) const {
+    return memcmp(bytes_, other.bytes_, 16u) == 0;
+  }
+  bool operator!=(const Uuid& other) const { return !(*this == other); }
+  // (The same order as the string forms'.)
+  bool operator<(const Uuid& other) const {
+    return memcmp(bytes_, other.bytes_, 16u) < 0;
+  }
+
+ private:
+  uint8_t bytes_[16];
+};
+
+static_assert(sizeof(Uuid) == 16u, "Uuid isn't just its bytes");
+
+// A ULID (https://github.com/ulid/spec): the Unix time in milliseconds (48
+// bits) then 80 random bits, written as 26 digits of Crockford's base 32,
+// e.g., "01ARYZ6S41TSV4RRFFQ69G5FAV". Those from one thread strictly increase:
+// later ones within a millisecond increment the random bits (so are
+// predictable from earlier ones). Those from different threads are ordered to
+// the millisecond.
+class FTL_EXPORT Ulid final {
+ public:
+  static constexpr size_t kStringSize = 26u;
+
+  // All zeros.
+  constexpr Ulid() : bytes_{} {}
+  // From the 16 bytes, most significant (the time's) first.
+  explicit Ulid(const uint8_t bytes[16]) { memcpy(bytes_, bytes, 16u); }
+
+  static Ulid Generate();
+
+  // Parses a ULID's string form (with letters of either case) into |*ulid|,
+  // or returns false (leaving |*ulid| alone) if |string| isn't one.
+  static bool Parse(StringView string, Ulid* ulid);
+
+  const uint8_t* bytes() const { return bytes_; }
+  uint64_t timestamp_ms() const;
+
+  // Writes the |kStringSize| characters of the string form (with uppercase
+  // letters) to |buffer|, without a terminating null.
+  void ToString(char* buffer) const;
+  std::string ToString() const;
+
+  bool operator==(const Ulid& other) const {
+    return memcmp(bytes_, other.bytes_, 16u) == 0;
+  }
+  bool operator!=(const Ulid& other) const { return !(*this == other); }
+  // (The same order as the string forms'.)
+  bool operator<(const Ulid& other) const {
+    return memcmp(bytes_, other.bytes_, 16u) < 0;
+  }
+
+ private:
+  uint8_t bytes_[16];
+};
+
+// Writes |count| random (version 4) UUIDs to |uuids|, drawing the random bytes
+// for all of them at once.
+FTL_EXPORT void GenerateUUIDs(Uuid* uuids, size_t count);
+FTL_EXPORT std::vector<Uuid> GenerateUUIDs(size_t count);
+
 // Generate a 128-bit (pseudo) random UUID in the form of version 4 as described
 // in RFC 4122, section 4.4.
 // The format of UUID version 4 must be xxxxxxxx-xxxx-4xxx-yxxx-xxxxxxxxxxxx,
@@ -35,4 +141,20 @@ FTL_EXPORT bool IsValidUUIDOutputString(const std::string& guid);
 
 }  // namespace ftl
 
+namespace std {
+
+// These hash the bytes (see |ftl::HashString()|), e.g., for
+// |std::unordered_map<ftl::Uuid, ...>|.
+template <>
+struct hash<ftl::Uuid> {
+  FTL_EXPORT size_t operator()(const ftl::Uuid& uuid) const;
+};
+
+template <>
+struct hash<ftl::Ulid> {
+  FTL_EXPORT size_t operator()(const ftl::Ulid& ulid) const;
+};
+
+}  // namespace std
+
 #endif  // FTL_RANDOM_UUID_H_
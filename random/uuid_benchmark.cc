@@ -0,0 +1,30 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/random/uuid.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_GenerateUUID(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    std::string uuid = GenerateUUID();
+    benchmark::DoNotOptimize(uuid.data());
+  }
+}
+FTL_BENCHMARK(BM_GenerateUUID);
+
+void BM_GenerateUUIDs(benchmark::State& state) {
+  Uuid uuids[64];
+  while (state.KeepRunning()) {
+    GenerateUUIDs(uuids, 64u);
+    benchmark::DoNotOptimize(uuids);
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+FTL_BENCHMARK(BM_GenerateUUIDs);
+
+}  // namespace
+}  // namespace ftl
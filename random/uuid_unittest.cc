@@ -5,11 +5,23 @@
 #include "lib/ftl/random/uuid.h"
 
 #include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
+#include <chrono>
+#include <set>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 namespace ftl {
 namespace {
@@ -22,5 +34,207 @@ TEST(Random, Uuid) {
   }
 }
 
+TEST(Random, UuidValidity) {
+  EXPECT_TRUE(IsValidUUID("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6d"));
+  EXPECT_TRUE(IsValidUUIDOutputString("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6d"));
+  EXPECT_TRUE(IsValidUUID("9B1DEB4D-3B7D-4BAD-9BDD-2B0D7B3DCB6D"));
+  EXPECT_FALSE(IsValidUUIDOutputString("9B1DEB4D-3b7d-4bad-9bdd-2b0d7b3dcb6d"));
+  EXPECT_FALSE(IsValidUUID(""));
+  EXPECT_FALSE(IsValidUUID("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6"));
+  EXPECT_FALSE(IsValidUUID("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6d0"));
+  EXPECT_FALSE(IsValidUUID("9b1deb4d03b7d-4bad-9bdd-2b0d7b3dcb6d"));
+  EXPECT_FALSE(IsValidUUID("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6g"));
+  EXPECT_FALSE(IsValidUUID("9b1deb4-d3b7d-4bad-9bdd-2b0d7b3dcb6d"));
+  EXPECT_FALSE(IsValidUUID(std::string("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb\0d",
+                                       36u)));
+}
+
+TEST(Uuid, ParseAndFormat) {
+  const uint8_t bytes[16] = {0x9b, 0x1d, 0xeb, 0x4d, 0x3b, 0x7d, 0x4b, 0xad,
+                             0x9b, 0xdd, 0x2b, 0x0d, 0x7b, 0x3d, 0xcb, 0x6d};
+  Uuid uuid;
+  EXPECT_TRUE(uuid.is_nil());
+  EXPECT_EQ("00000000-0000-0000-0000-000000000000", uuid.ToString());
+  ASSERT_TRUE(Uuid::Parse("9B1DEB4D-3b7d-4bad-9bdd-2b0d7b3dcb6d", &uuid));
+  EXPECT_FALSE(uuid.is_nil());
+  EXPECT_EQ(Uuid(bytes), uuid);
+  EXPECT_EQ(0, memcmp(bytes, uuid.bytes(), sizeof(bytes)));
+  EXPECT_EQ(4, uuid.version());
+  EXPECT_EQ("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6d", uuid.ToString());
+
+  char buffer[Uuid::kStringSize + 1u];
+  buffer[Uuid::kStringSize] = 'x';
+  uuid.ToString(buffer);
+  EXPECT_EQ("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcb6d",
+            std::string(buffer, Uuid::kStringSize));
+  EXPECT_EQ('x', buffer[Uuid::kStringSize]);
+
+  // Failing leaves the UUID alone.
+  EXPECT_FALSE(Uuid::Parse("not a uuid", &uuid));
+  EXPECT_FALSE(Uuid::Parse("9b1deb4d-3b7d-4bad-9bdd-2b0d7b3dcbzz", &uuid));
+  EXPECT_EQ(Uuid(bytes), uuid);
+}
+
+TEST(Uuid, Generate) {
+  std::vector<Uuid> uuids = GenerateUUIDs(1000u);
+  uuids.push_back(Uuid::Generate());
+  Uuid more[3];
+  GenerateUUIDs(more, 3u);
+  uuids.insert(uuids.end(), more, more + 3);
+  for (const Uuid& uuid : uuids) {
+    EXPECT_EQ(4, uuid.version());
+    // The RFC 4122 variant.
+    EXPECT_EQ(0x80, uuid.bytes()[8] & 0xc0);
+    EXPECT_TRUE(IsValidUUIDOutputString(uuid.ToString()));
+  }
+  EXPECT_EQ(uuids.size(), std::set<Uuid>(uuids.begin(), uuids.end()).size());
+  EXPECT_EQ(uuids.size(),
+            std::unordered_set<Uuid>(uuids.begin(), uuids.end()).size());
+  EXPECT_TRUE(GenerateUUIDs(0u).empty());
+}
+
+TEST(Uuid, Order) {
+  std::vector<Uuid> uuids = GenerateUUIDs(100u);
+  std::sort(uuids.begin(), uuids.end());
+  for (size_t i = 1u; i < uuids.size(); i++) {
+    EXPECT_LT(uuids[i - 1u].ToString(), uuids[i].ToString());
+    EXPECT_NE(uuids[i - 1u], uuids[i]);
+  }
+}
+
+uint64_t GetSystemTimeMs() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+// Checks that |ids| strictly increase (and so are distinct), in both their
+// binary and string forms.
+template <typename Id>
+void ExpectIncreasing(const std::vector<Id>& ids) {
+  for (size_t i = 1u; i < ids.size(); i++) {
+    ASSERT_LT(ids[i - 1u], ids[i]);
+    ASSERT_LT(ids[i - 1u].ToString(), ids[i].ToString());
+  }
+}
+
+TEST(Uuid, GenerateV7) {
+  const uint64_t start_ms = GetSystemTimeMs();
+  // Many share a millisecond (and some outrun the counter).
+  std::vector<Uuid> uuids;
+  for (int i = 0; i < 20000; i++)
+    uuids.push_back(Uuid::GenerateV7());
+  const uint64_t end_ms = GetSystemTimeMs();
+  ExpectIncreasing(uuids);
+  for (const Uuid& uuid : uuids) {
+    EXPECT_EQ(7, uuid.version());
+    EXPECT_EQ(0x80, uuid.bytes()[8] & 0xc0);
+    EXPECT_TRUE(IsValidUUID(uuid.ToString()));
+  }
+  // (Allowing for the clocks drifting apart, and borrowed milliseconds.)
+  EXPECT_LE(start_ms - 1000u, uuids.front().timestamp_ms());
+  EXPECT_GE(end_ms + 1000u, uuids.back().timestamp_ms());
+}
+
+TEST(Ulid, ParseAndFormat) {
+  Ulid ulid;
+  EXPECT_EQ("00000000000000000000000000", ulid.ToString());
+  ASSERT_TRUE(Ulid::Parse("01ARYZ6S41tsv4rrffq69g5fav", &ulid));
+  EXPECT_EQ(1469918176385u, ulid.timestamp_ms());
+  EXPECT_EQ("01ARYZ6S41TSV4RRFFQ69G5FAV", ulid.ToString());
+  EXPECT_EQ(ulid, Ulid(ulid.bytes()));
+
+  const uint8_t max[16] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                           0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+  EXPECT_EQ("7ZZZZZZZZZZZZZZZZZZZZZZZZZ", Ulid(max).ToString());
+  char buffer[Ulid::kStringSize + 1u];
+  buffer[Ulid::kStringSize] = 'x';
+  Ulid(max).ToString(buffer);
+  EXPECT_EQ("7ZZZZZZZZZZZZZZZZZZZZZZZZZ",
+            std::string(buffer, Ulid::kStringSize));
+  EXPECT_EQ('x', buffer[Ulid::kStringSize]);
+
+  // Failing leaves the ULID alone.
+  const Ulid parsed = ulid;
+  EXPECT_FALSE(Ulid::Parse("", &ulid));
+  EXPECT_FALSE(Ulid::Parse("01ARYZ6S41TSV4RRFFQ69G5FA", &ulid));
+  EXPECT_FALSE(Ulid::Parse("01ARYZ6S41TSV4RRFFQ69G5FAVV", &ulid));
+  EXPECT_FALSE(Ulid::Parse("01ARYZ6S41TSV4RRFFQ69G5FAU", &ulid));
+  EXPECT_FALSE(Ulid::Parse("01ARYZ6S41TSV4RRFFQ69G5FA-", &ulid));
+  // (Too big for 128 bits.)
+  EXPECT_FALSE(Ulid::Parse("80000000000000000000000000", &ulid));
+  EXPECT_EQ(parsed, ulid);
+}
+
+TEST(Ulid, Generate) {
+  const uint64_t start_ms = GetSystemTimeMs();
+  std::vector<Ulid> ulids;
+  for (int i = 0; i < 20000; i++)
+    ulids.push_back(Ulid::Generate());
+  const uint64_t end_ms = GetSystemTimeMs();
+  ExpectIncreasing(ulids);
+  for (const Ulid& ulid : ulids) {
+    Ulid parsed;
+    ASSERT_TRUE(Ulid::Parse(ulid.ToString(), &parsed));
+    EXPECT_EQ(ulid, parsed);
+  }
+  EXPECT_LE(start_ms - 1000u, ulids.front().timestamp_ms());
+  EXPECT_GE(end_ms + 1000u, ulids.back().timestamp_ms());
+  EXPECT_EQ(ulids.size(),
+            std::unordered_set<Ulid>(ulids.begin(), ulids.end()).size());
+}
+
+TEST(Uuid, TimeOrderedThreads) {
+  // Each thread's ids increase, and none are shared.
+  std::vector<std::vector<Uuid>> uuids(4u);
+  std::vector<std::vector<Ulid>> ulids(4u);
+  std::vector<std::thread> threads;
+  for (size_t t = 0u; t < uuids.size(); t++) {
+    threads.emplace_back([&uuids, &ulids, t] {
+      for (int i = 0; i < 2000; i++) {
+        uuids[t].push_back(Uuid::GenerateV7());
+        ulids[t].push_back(Ulid::Generate());
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  std::set<Uuid> all_uuids;
+  std::set<Ulid> all_ulids;
+  for (size_t t = 0u; t < uuids.size(); t++) {
+    ExpectIncreasing(uuids[t]);
+    ExpectIncreasing(ulids[t]);
+    all_uuids.insert(uuids[t].begin(), uuids[t].end());
+    all_ulids.insert(ulids[t].begin(), ulids[t].end());
+  }
+  EXPECT_EQ(8000u, all_uuids.size());
+  EXPECT_EQ(8000u, all_ulids.size());
+}
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+TEST(Ulid, Fork) {
+  // The child mustn't continue its parent's sequence (to the same ULID).
+  Ulid::Generate();
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  pid_t pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    Ulid ulid = Ulid::Generate();
+    _exit(write(fds[1], ulid.bytes(), 16u) == 16 ? 0 : 1);
+  }
+  close(fds[1]);
+  const Ulid ulid = Ulid::Generate();
+  uint8_t child_bytes[16] = {};
+  EXPECT_EQ(16, read(fds[0], child_bytes, sizeof(child_bytes)));
+  close(fds[0]);
+  int status = 0;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  EXPECT_NE(ulid, Ulid(child_bytes));
+}
+#endif
+
 }  // namespace
 }  // namespace ftl
@@ -4,16 +4,176 @@
 
 #include "lib/ftl/strings/ascii.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FTL_ASCII_VECTORS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTL_ASCII_VECTORS
+#endif
+
 namespace ftl {
+namespace {
+
+// The case conversions flip the 0x20 bit of the letters from |first| ('A' or
+// 'a') to |first + 25|, a 16-byte vector, an 8-byte word or a byte at a time.
+constexpr uint64_t kEachByte = UINT64_C(0x0101010101010101);
+constexpr uint64_t kHighBits = UINT64_C(0x8080808080808080);
+
+uint64_t LoadWord(const char* src) {
+  uint64_t word;
+  memcpy(&word, src, sizeof(word));
+  return word;
+}
+
+uint64_t FlipCase(uint64_t word, char first) {
+  // Adding to the low seven bits of each byte sets its high bit iff it's at
+  // least the addend's complement (without carrying into the next byte).
+  uint64_t low_bits = word & ~kHighBits;
+  uint64_t at_least_first = low_bits + (0x80u - first) * kEachByte;
+  uint64_t above_last = low_bits + (0x7fu - (first + 25)) * kEachByte;
+  uint64_t letters = (at_least_first ^ above_last) & ~word & kHighBits;
+  return word ^ (letters >> 2);
+}
+
+char FlipCase(char c, char first) {
+  return (c >= first && c <= first + 25) ? static_cast<char>(c ^ 0x20) : c;
+}
+
+#if defined(FTL_ASCII_VECTORS)
+constexpr size_t kVectorSize = 16u;
+
+#if defined(__SSE2__)
+using Vector = __m128i;
+
+Vector LoadVector(const char* src) {
+  return _mm_loadu_si128(reinterpret_cast<const Vector*>(src));
+}
+
+void StoreVector(char* dest, Vector v) {
+  _mm_storeu_si128(reinterpret_cast<Vector*>(dest), v);
+}
+
+Vector FlipCase(Vector v, char first) {
+  // Shift the letters to [-128, -103] (there are no unsigned comparisons).
+  Vector shifted =
+      _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - first)));
+  Vector letters = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+  return _mm_xor_si128(v, _mm_and_si128(letters, _mm_set1_epi8(0x20)));
+}
+
+bool Equal(Vector a, Vector b) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xffff;
+}
+#else   // NEON
+using Vector = uint8x16_t;
+
+Vector LoadVector(const char* src) {
+  return vld1q_u8(reinterpret_cast<const uint8_t*>(src));
+}
+
+void StoreVector(char* dest, Vector v) {
+  vst1q_u8(reinterpret_cast<uint8_t*>(dest), v);
+}
+
+Vector FlipCase(Vector v, char first) {
+  Vector letters = vcltq_u8(vsubq_u8(v, vdupq_n_u8(first)), vdupq_n_u8(26));
+  return veorq_u8(v, vandq_u8(letters, vdupq_n_u8(0x20)));
+}
+
+bool Equal(Vector a, Vector b) {
+  return vminvq_u8(vceqq_u8(a, b)) == 0xffu;
+}
+#endif  // defined(__SSE2__)
+#endif  // defined(FTL_ASCII_VECTORS)
+
+void ConvertCase(ftl::StringView src, char* dest, char first) {
+  const char* data = src.data();
+  const size_t size = src.size();
+  size_t i = 0u;
+#if defined(FTL_ASCII_VECTORS)
+  for (; size - i >= kVectorSize; i += kVectorSize)
+    StoreVector(dest + i, FlipCase(LoadVector(data + i), first));
+#endif
+  for (; size - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+    uint64_t word = FlipCase(LoadWord(data + i), first);
+    memcpy(dest + i, &word, sizeof(word));
+  }
+  for (; i < size; i++)
+    dest[i] = FlipCase(data[i], first);
+}
+
+}  // namespace
+
+void ToLowerASCII(ftl::StringView src, char* dest) {
+  ConvertCase(src, dest, 'A');
+}
+
+void ToUpperASCII(ftl::StringView src, char* dest) {
+  ConvertCase(src, dest, 'a');
+}
+
+std::string ToLowerASCII(ftl::StringView str) {
+  std::string result(str.size(), '\0');
+  ToLowerASCII(str, &result[0]);
+  return result;
+}
+
+std::string ToUpperASCII(ftl::StringView str) {
+  std::string result(str.size(), '\0');
+  ToUpperASCII(str, &result[0]);
+  return result;
+}
 
 bool EqualsCaseInsensitiveASCII(ftl::StringView v1, ftl::StringView v2) {
   if (v1.size() != v2.size())
     return false;
-  for (size_t i = 0; i < v1.size(); ++i) {
+  size_t i = 0;
+#if defined(FTL_ASCII_VECTORS)
+  for (; v1.size() - i >= kVectorSize; i += kVectorSize) {
+    if (!Equal(FlipCase(LoadVector(v1.data() + i), 'A'),
+               FlipCase(LoadVector(v2.data() + i), 'A')))
+      return false;
+  }
+#endif
+  for (; v1.size() - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+    if (FlipCase(LoadWord(v1.data() + i), 'A') !=
+        FlipCase(LoadWord(v2.data() + i), 'A'))
+      return false;
+  }
+  for (; i < v1.size(); ++i) {
     if (ToLowerASCII(v1[i]) != ToLowerASCII(v2[i]))
       return false;
   }
   return true;
 }
 
+size_t HashCaseInsensitiveASCII(ftl::StringView str) {
+  // Mix in the lower-cased words (and the null-padded final word) as in
+  // xxHash's rounds, then avalanche as in MurmurHash3's finalizer.
+  constexpr uint64_t kMultiplier = UINT64_C(0x9e3779b97f4a7c15);
+  auto mix = [](uint64_t hash, uint64_t word) {
+    hash ^= FlipCase(word, 'A') * kMultiplier;
+    return ((hash << 31) | (hash >> 33)) * kMultiplier;
+  };
+  uint64_t hash = str.size() * kMultiplier;
+  size_t i = 0u;
+  for (; str.size() - i >= sizeof(uint64_t); i += sizeof(uint64_t))
+    hash = mix(hash, LoadWord(str.data() + i));
+  if (i < str.size()) {
+    uint64_t word = 0u;
+    memcpy(&word, str.data() + i, str.size() - i);
+    hash = mix(hash, word);
+  }
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xff51afd7ed558ccd);
+  hash ^= hash >> 33;
+  hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+  hash ^= hash >> 33;
+  return static_cast<size_t>(hash);
+}
+
 }  // namespace ftl
@@ -5,6 +5,8 @@
 #ifndef LIB_FTL_STRINGS_ASCII_H_
 #define LIB_FTL_STRINGS_ASCII_H_
 
+#include <stddef.h>
+
 #include <string>
 
 #include "lib/ftl/ftl_export.h"
@@ -20,9 +22,40 @@ inline char ToUpperASCII(char c) {
   return (c >= 'a' && c <= 'z') ? (c + ('A' - 'a')) : c;
 }
 
+// Writes |src| to |dest| (which must have room for |src.size()| bytes, and
+// may be |src.data()|, to convert in place) with its ASCII letters converted to
+// lower (or upper) case. Other bytes are unchanged. This converts a block of
+// bytes at a time.
+FTL_EXPORT void ToLowerASCII(ftl::StringView src, char* dest);
+FTL_EXPORT void ToUpperASCII(ftl::StringView src, char* dest);
+
+// Like the above, but return a new string.
+FTL_EXPORT std::string ToLowerASCII(ftl::StringView str);
+FTL_EXPORT std::string ToUpperASCII(ftl::StringView str);
+
 FTL_EXPORT bool EqualsCaseInsensitiveASCII(ftl::StringView v1,
                                            ftl::StringView v2);
 
+// Returns a hash of |str| that ignores the case of ASCII letters (so that
+// strings that are |EqualsCaseInsensitiveASCII()| have the same hash).
+FTL_EXPORT size_t HashCaseInsensitiveASCII(ftl::StringView str);
+
+// Function objects for case-insensitive hash tables, e.g.:
+//
+//   std::unordered_map<std::string, std::string, CaseInsensitiveASCIIHash,
+//                      CaseInsensitiveASCIIEqual> headers;
+struct CaseInsensitiveASCIIHash {
+  size_t operator()(ftl::StringView str) const {
+    return HashCaseInsensitiveASCII(str);
+  }
+};
+
+struct CaseInsensitiveASCIIEqual {
+  bool operator()(ftl::StringView v1, ftl::StringView v2) const {
+    return EqualsCaseInsensitiveASCII(v1, v2);
+  }
+};
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_STRINGS_ASCII_H_
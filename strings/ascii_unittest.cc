@@ -2,8 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
-#include "gtest/gtest.h"
 #include "lib/ftl/strings/ascii.h"
+
+#include <stdlib.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "gtest/gtest.h"
 #include "lib/ftl/strings/string_view.h"
 
 namespace ftl {
@@ -21,6 +27,40 @@ TEST(StringUtil, ToUpperASCII) {
   EXPECT_EQ('A', ftl::ToUpperASCII('A'));
 }
 
+TEST(StringUtil, ToLowerAndUpperASCIIStrings) {
+  EXPECT_EQ("", ToLowerASCII(""));
+  EXPECT_EQ("content-type", ToLowerASCII("Content-Type"));
+  EXPECT_EQ("CONTENT-TYPE", ToUpperASCII("Content-Type"));
+  // Only ASCII letters change (e.g., not "@[`{" or bytes above 0x7f).
+  EXPECT_EQ("@az[`az{\xc3\x89\xe9", ToLowerASCII("@AZ[`az{\xc3\x89\xe9"));
+  EXPECT_EQ("@AZ[`AZ{\xc3\xa9\xc9", ToUpperASCII("@AZ[`az{\xc3\xa9\xc9"));
+
+  // In place, and at every length (with blocks and words).
+  std::string str;
+  for (size_t i = 0u; i < 40u; i++) {
+    str += static_cast<char>(i % 2 ? 'A' + i % 26 : 'a' + i % 26);
+    std::string lower = str;
+    ToLowerASCII(lower, &lower[0]);
+    std::string upper = str;
+    ToUpperASCII(upper, &upper[0]);
+    for (size_t j = 0u; j < str.size(); j++) {
+      EXPECT_EQ(ToLowerASCII(str[j]), lower[j]);
+      EXPECT_EQ(ToUpperASCII(str[j]), upper[j]);
+    }
+  }
+
+  // Compare with the single-character versions on all the bytes.
+  std::string bytes;
+  for (int i = 0; i < 256; i++)
+    bytes += static_cast<char>(i);
+  std::string lower = ToLowerASCII(bytes);
+  std::string upper = ToUpperASCII(bytes);
+  for (size_t i = 0u; i < bytes.size(); i++) {
+    EXPECT_EQ(ToLowerASCII(bytes[i]), lower[i]) << i;
+    EXPECT_EQ(ToUpperASCII(bytes[i]), upper[i]) << i;
+  }
+}
+
 TEST(StringUtil, EqualsCaseInsensitiveASCII) {
   EXPECT_TRUE(EqualsCaseInsensitiveASCII("", ""));
   EXPECT_TRUE(EqualsCaseInsensitiveASCII("abcd", "abcd"));
@@ -31,6 +71,53 @@ TEST(StringUtil, EqualsCaseInsensitiveASCII) {
   EXPECT_FALSE(EqualsCaseInsensitiveASCII("abcd", "abc"));
   EXPECT_FALSE(EqualsCaseInsensitiveASCII("abcd", "ABC"));
   EXPECT_FALSE(EqualsCaseInsensitiveASCII("abcd", "ABCDE"));
+
+  // Long strings (compared a block at a time).
+  EXPECT_TRUE(EqualsCaseInsensitiveASCII("Accept-Encoding: GZIP, Deflate",
+                                         "accept-encoding: gzip, deflate"));
+  EXPECT_FALSE(EqualsCaseInsensitiveASCII("Accept-Encoding: GZIP, Deflate",
+                                          "accept-encoding: gzip, deflatf"));
+  EXPECT_FALSE(EqualsCaseInsensitiveASCII("Accept-Encoding: GZIP, Deflate",
+                                          "bccept-encoding: gzip, deflate"));
+  // "@" and "`" differ from "A" and "a" in the same bit.
+  EXPECT_FALSE(EqualsCaseInsensitiveASCII(std::string(26u, '@'),
+                                          std::string(26u, '`')));
+  EXPECT_FALSE(EqualsCaseInsensitiveASCII("\xc1", "\xe1"));
+
+  srand(44);
+  for (int i = 0; i < 1000; i++) {
+    std::string v1;
+    size_t size = static_cast<size_t>(rand() % 40);
+    for (size_t j = 0u; j < size; j++)
+      v1 += static_cast<char>(rand() % 256);
+    std::string v2 = rand() % 2 ? ToUpperASCII(v1) : ToLowerASCII(v1);
+    EXPECT_TRUE(EqualsCaseInsensitiveASCII(v1, v2));
+    if (!v2.empty()) {
+      v2[rand() % v2.size()] ^= static_cast<char>(1 << (rand() % 8));
+      EXPECT_EQ(ToLowerASCII(v1) == ToLowerASCII(v2),
+                EqualsCaseInsensitiveASCII(v1, v2));
+    }
+  }
+}
+
+TEST(StringUtil, HashCaseInsensitiveASCII) {
+  EXPECT_EQ(HashCaseInsensitiveASCII("content-type"),
+            HashCaseInsensitiveASCII("Content-Type"));
+  EXPECT_EQ(HashCaseInsensitiveASCII("x-a-much-longer-header-name"),
+            HashCaseInsensitiveASCII("X-A-Much-Longer-Header-Name"));
+  EXPECT_NE(HashCaseInsensitiveASCII("content-type"),
+            HashCaseInsensitiveASCII("content-typf"));
+  // Trailing nulls matter.
+  EXPECT_NE(HashCaseInsensitiveASCII("a"),
+            HashCaseInsensitiveASCII(StringView("a\0", 2u)));
+
+  std::unordered_map<std::string, int, CaseInsensitiveASCIIHash,
+                     CaseInsensitiveASCIIEqual>
+      headers;
+  headers["Content-Length"] = 5;
+  headers["content-length"]++;
+  EXPECT_EQ(1u, headers.size());
+  EXPECT_EQ(6, headers["CONTENT-LENGTH"]);
 }
 
 }  // namespace
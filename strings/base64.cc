@@ -0,0 +1,445 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/base64.h"
+
+#include <string.h>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define FTL_BASE64_VECTORS
+#define FTL_BASE64_SSSE3
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FTL_BASE64_VECTORS
+#elif defined(ARCH_CPU_X86_64) && (defined(__GNUC__) || defined(__clang__))
+// The default x86-64 target doesn't have SSSE3, so the vector code is compiled
+// for it separately, and used if the CPU has it.
+#include <cpuid.h>
+#include <tmmintrin.h>
+#define FTL_BASE64_VECTORS
+#define FTL_BASE64_SSSE3
+#define FTL_BASE64_SSSE3_DISPATCH
+#endif
+
+namespace ftl {
+namespace {
+
+const char kStandardChars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char kUrlSafeChars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+const char* CharsFor(Base64Alphabet alphabet) {
+  return alphabet == Base64Alphabet::kStandard ? kStandardChars
+                                               : kUrlSafeChars;
+}
+
+// Maps characters to their values, or to 0xff if they're not in the alphabet.
+struct DecodeTable {
+  explicit DecodeTable(const char* chars) {
+    memset(values, 0xff, sizeof(values));
+    for (uint8_t i = 0u; i < 64u; i++)
+      values[static_cast<uint8_t>(chars[i])] = i;
+  }
+
+  uint8_t values[256];
+};
+
+const uint8_t* DecodeTableFor(Base64Alphabet alphabet) {
+  static const DecodeTable standard(kStandardChars);
+  static const DecodeTable url_safe(kUrlSafeChars);
+  return alphabet == Base64Alphabet::kStandard ? standard.values
+                                               : url_safe.values;
+}
+
+#if defined(FTL_BASE64_VECTORS)
+
+// Returns true if |EncodeBlocks()| and |DecodeBlocks()| can be used.
+bool UseVectors() {
+#if defined(FTL_BASE64_SSSE3_DISPATCH)
+  static const bool has_ssse3 = [] {
+    unsigned eax = 0u, ebx = 0u, ecx = 0u, edx = 0u;
+    return __get_cpuid(1u, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3);
+  }();
+  return has_ssse3;
+#else
+  return true;
+#endif
+}
+
+#if defined(FTL_BASE64_SSSE3_DISPATCH)
+// Everything up to |DecodeBlocks()| is compiled for SSSE3.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("ssse3"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+#endif
+#endif  // defined(FTL_BASE64_SSSE3_DISPATCH)
+
+#if defined(FTL_BASE64_SSSE3)
+
+// The encoder, and the decoder's packing of values into bytes, follow W. Mula
+// and D. Lemire, "Faster Base64 Encoding and Decoding using AVX2 Instructions"
+// (2018), with 16-byte vectors.
+
+// The size of the input that |EncodeBlock()| reads (of which it encodes 12
+// bytes, to 16 characters).
+constexpr size_t kEncodeReadSize = 16u;
+constexpr size_t kEncodeBlockSize = 12u;
+// The number of characters that |DecodeBlock()| decodes (to 12 bytes).
+constexpr size_t kDecodeBlockSize = 16u;
+
+// The alphabet-dependent vectors, made once per call (since making them takes
+// many instructions).
+struct AlphabetVectors {
+  explicit AlphabetVectors(const char* chars)
+      : encode_offsets(_mm_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            static_cast<char>(chars[62] - 62),
+            static_cast<char>(chars[63] - 63), 'A', 0, 0)),
+        char62(_mm_set1_epi8(chars[62])),
+        char63(_mm_set1_epi8(chars[63])),
+        decode_offset62(_mm_set1_epi8(static_cast<char>(62 - chars[62]))),
+        decode_offset63(_mm_set1_epi8(static_cast<char>(63 - chars[63]))) {}
+
+  // The offsets from indices to characters, by class (see |EncodeBlock()|).
+  __m128i encode_offsets;
+  __m128i char62;
+  __m128i char63;
+  __m128i decode_offset62;
+  __m128i decode_offset63;
+};
+
+void EncodeBlock(const uint8_t* src, char* dest, const AlphabetVectors& v) {
+  __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  // Put each group of 3 bytes (a, b, c) in a 32-bit lane as (b, a, c, b), so
+  // that the four 6-bit indices can be shifted into place by multiplication.
+  input = _mm_shuffle_epi8(
+      input, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i indices = _mm_or_si128(
+      _mm_mulhi_epu16(_mm_and_si128(input, _mm_set1_epi32(0x0fc0fc00)),
+                      _mm_set1_epi32(0x04000040)),
+      _mm_mullo_epi16(_mm_and_si128(input, _mm_set1_epi32(0x003f03f0)),
+                      _mm_set1_epi32(0x01000010)));
+  // Map each index to the offset from it to its character: classify it as
+  // 0 (26-51), 1-10 (52-61), 11 (62), 12 (63) or 13 (0-25).
+  __m128i classes = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  classes = _mm_or_si128(
+      classes, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices),
+                             _mm_set1_epi8(13)));
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(dest),
+      _mm_add_epi8(indices, _mm_shuffle_epi8(v.encode_offsets, classes)));
+}
+
+// Returns all ones (bytewise) where |lower <= c <= upper|, for ASCII bounds
+// (so that bytes of 0x80 and over, which are negative, never match).
+__m128i InRange(__m128i c, char lower, char upper) {
+  return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lower - 1)),
+                       _mm_cmpgt_epi8(_mm_set1_epi8(upper + 1), c));
+}
+
+bool DecodeBlock(const char* src, uint8_t* dest, const AlphabetVectors& v) {
+  __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  __m128i upper = InRange(input, 'A', 'Z');
+  __m128i lower = InRange(input, 'a', 'z');
+  __m128i digit = InRange(input, '0', '9');
+  __m128i char62 = _mm_cmpeq_epi8(input, v.char62);
+  __m128i char63 = _mm_cmpeq_epi8(input, v.char63);
+  __m128i valid =
+      _mm_or_si128(_mm_or_si128(upper, lower),
+                   _mm_or_si128(digit, _mm_or_si128(char62, char63)));
+  if (_mm_movemask_epi8(valid) != 0xffff)
+    return false;
+  __m128i offsets = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                   _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+      _mm_or_si128(
+          _mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+          _mm_or_si128(_mm_and_si128(char62, v.decode_offset62),
+                       _mm_and_si128(char63, v.decode_offset63))));
+  __m128i values = _mm_add_epi8(input, offsets);
+  // Combine the four 6-bit values in each 32-bit lane into 24 bits, and then
+  // gather the bytes (in big-endian order).
+  __m128i merged = _mm_madd_epi16(
+      _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)),
+      _mm_set1_epi32(0x00011000));
+  __m128i bytes = _mm_shuffle_epi8(
+      merged,
+      _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dest), bytes);
+  uint32_t last = static_cast<uint32_t>(_mm_cvtsi128_si32(
+      _mm_srli_si128(bytes, 8)));
+  memcpy(dest + 8, &last, sizeof(last));
+  return true;
+}
+
+#else  // aarch64
+
+// These deinterleave with |vld3q_u8()| (or |vld4q_u8()|), and look up
+// characters with |vqtbl4q_u8()|.
+
+constexpr size_t kEncodeReadSize = 48u;
+constexpr size_t kEncodeBlockSize = 48u;
+constexpr size_t kDecodeBlockSize = 64u;
+
+struct AlphabetVectors {
+  explicit AlphabetVectors(const char* chars)
+      : char62(vdupq_n_u8(static_cast<uint8_t>(chars[62]))),
+        char63(vdupq_n_u8(static_cast<uint8_t>(chars[63]))) {
+    const uint8_t* table_chars = reinterpret_cast<const uint8_t*>(chars);
+    table.val[0] = vld1q_u8(table_chars);
+    table.val[1] = vld1q_u8(table_chars + 16);
+    table.val[2] = vld1q_u8(table_chars + 32);
+    table.val[3] = vld1q_u8(table_chars + 48);
+  }
+
+  // The characters, by index.
+  uint8x16x4_t table;
+  uint8x16_t char62;
+  uint8x16_t char63;
+};
+
+void EncodeBlock(const uint8_t* src, char* dest, const AlphabetVectors& v) {
+  const uint8x16x4_t& table = v.table;
+  uint8x16x3_t input = vld3q_u8(src);
+  uint8x16_t a = input.val[0];
+  uint8x16_t b = input.val[1];
+  uint8x16_t c = input.val[2];
+  uint8x16x4_t output;
+  output.val[0] = vqtbl4q_u8(table, vshrq_n_u8(a, 2));
+  output.val[1] = vqtbl4q_u8(
+      table,
+      vorrq_u8(vandq_u8(vshlq_n_u8(a, 4), vdupq_n_u8(0x30)), vshrq_n_u8(b, 4)));
+  output.val[2] = vqtbl4q_u8(
+      table,
+      vorrq_u8(vandq_u8(vshlq_n_u8(b, 2), vdupq_n_u8(0x3c)), vshrq_n_u8(c, 6)));
+  output.val[3] = vqtbl4q_u8(table, vandq_u8(c, vdupq_n_u8(0x3f)));
+  vst4q_u8(reinterpret_cast<uint8_t*>(dest), output);
+}
+
+// Returns the values of the characters |c|, setting |*valid| to all ones
+// (bytewise) where they're in the alphabet.
+uint8x16_t DecodeChars(uint8x16_t c,
+                       const AlphabetVectors& v,
+                       uint8x16_t* valid) {
+  uint8x16_t upper = vsubq_u8(c, vdupq_n_u8('A'));
+  uint8x16_t is_upper = vcltq_u8(upper, vdupq_n_u8(26));
+  uint8x16_t lower = vsubq_u8(c, vdupq_n_u8('a' - 26));
+  uint8x16_t is_lower = vcltq_u8(vsubq_u8(c, vdupq_n_u8('a')), vdupq_n_u8(26));
+  uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0' - 52));
+  uint8x16_t is_digit = vcltq_u8(vsubq_u8(c, vdupq_n_u8('0')), vdupq_n_u8(10));
+  uint8x16_t is_62 = vceqq_u8(c, v.char62);
+  uint8x16_t is_63 = vceqq_u8(c, v.char63);
+  *valid = vorrq_u8(vorrq_u8(is_upper, is_lower),
+                    vorrq_u8(is_digit, vorrq_u8(is_62, is_63)));
+  return vbslq_u8(
+      is_upper, upper,
+      vbslq_u8(is_lower, lower,
+               vbslq_u8(is_digit, digit,
+                        vbslq_u8(is_62, vdupq_n_u8(62), vdupq_n_u8(63)))));
+}
+
+bool DecodeBlock(const char* src, uint8_t* dest, const AlphabetVectors& v) {
+  uint8x16x4_t input = vld4q_u8(reinterpret_cast<const uint8_t*>(src));
+  uint8x16_t valid0;
+  uint8x16_t valid1;
+  uint8x16_t valid2;
+  uint8x16_t valid3;
+  uint8x16_t v0 = DecodeChars(input.val[0], v, &valid0);
+  uint8x16_t v1 = DecodeChars(input.val[1], v, &valid1);
+  uint8x16_t v2 = DecodeChars(input.val[2], v, &valid2);
+  uint8x16_t v3 = DecodeChars(input.val[3], v, &valid3);
+  if (vminvq_u8(vandq_u8(vandq_u8(valid0, valid1), vandq_u8(valid2, valid3))) !=
+      0xff)
+    return false;
+  uint8x16x3_t output;
+  output.val[0] = vorrq_u8(vshlq_n_u8(v0, 2), vshrq_n_u8(v1, 4));
+  output.val[1] = vorrq_u8(vshlq_n_u8(v1, 4), vshrq_n_u8(v2, 2));
+  output.val[2] = vorrq_u8(vshlq_n_u8(v2, 6), v3);
+  vst3q_u8(dest, output);
+  return true;
+}
+
+#endif  // defined(FTL_BASE64_SSSE3)
+
+// Encodes the blocks at the start of the |size| bytes at |src| to |*dest|,
+// advancing it, and returns the number of bytes encoded.
+size_t EncodeBlocks(const uint8_t* src,
+                    size_t size,
+                    char** dest,
+                    const char* chars) {
+  const AlphabetVectors vectors(chars);
+  size_t i = 0u;
+  for (; i + kEncodeReadSize <= size; i += kEncodeBlockSize) {
+    EncodeBlock(src + i, *dest, vectors);
+    *dest += kEncodeBlockSize / 3u * 4u;
+  }
+  return i;
+}
+
+// Decodes the blocks at the start of the |length| characters at |src| to
+// |*dest|, advancing it, and sets |*decoded| to the number of characters
+// decoded. Returns false if a block has a character not in the alphabet.
+bool DecodeBlocks(const char* src,
+                  size_t length,
+                  uint8_t** dest,
+                  size_t* decoded,
+                  const char* chars) {
+  const AlphabetVectors vectors(chars);
+  size_t i = 0u;
+  for (; i + kDecodeBlockSize <= length; i += kDecodeBlockSize) {
+    if (!DecodeBlock(src + i, *dest, vectors))
+      return false;
+    *dest += kDecodeBlockSize / 4u * 3u;
+  }
+  *decoded = i;
+  return true;
+}
+
+#if defined(FTL_BASE64_SSSE3_DISPATCH)
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif  // defined(FTL_BASE64_SSSE3_DISPATCH)
+
+#endif  // defined(FTL_BASE64_VECTORS)
+
+}  // namespace
+
+size_t Base64Encode(const void* data,
+                    size_t size,
+                    char* dest,
+                    Base64Alphabet alphabet,
+                    Base64Padding padding) {
+  FTL_DCHECK(data || !size);
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  const char* chars = CharsFor(alphabet);
+  char* out = dest;
+  size_t i = 0u;
+#if defined(FTL_BASE64_VECTORS)
+  if (UseVectors())
+    i = EncodeBlocks(src, size, &out, chars);
+#endif
+  for (; i + 3u <= size; i += 3u) {
+    uint32_t group = (static_cast<uint32_t>(src[i]) << 16) |
+                     (static_cast<uint32_t>(src[i + 1u]) << 8) | src[i + 2u];
+    out[0] = chars[group >> 18];
+    out[1] = chars[(group >> 12) & 0x3f];
+    out[2] = chars[(group >> 6) & 0x3f];
+    out[3] = chars[group & 0x3f];
+    out += 4;
+  }
+  if (i < size) {
+    uint32_t group = static_cast<uint32_t>(src[i]) << 16;
+    if (i + 1u < size)
+      group |= static_cast<uint32_t>(src[i + 1u]) << 8;
+    *out++ = chars[group >> 18];
+    *out++ = chars[(group >> 12) & 0x3f];
+    if (i + 1u < size)
+      *out++ = chars[(group >> 6) & 0x3f];
+    else if (padding == Base64Padding::kInclude)
+      *out++ = '=';
+    if (padding == Base64Padding::kInclude)
+      *out++ = '=';
+  }
+  FTL_DCHECK(static_cast<size_t>(out - dest) ==
+             Base64EncodedLength(size, padding));
+  return static_cast<size_t>(out - dest);
+}
+
+std::string Base64Encode(const void* data,
+                         size_t size,
+                         Base64Alphabet alphabet,
+                         Base64Padding padding) {
+  std::string result(Base64EncodedLength(size, padding), '\0');
+  if (!result.empty())
+    Base64Encode(data, size, &result[0], alphabet, padding);
+  return result;
+}
+
+bool Base64Decode(StringView encoded,
+                  void* dest,
+                  size_t* size,
+                  Base64Alphabet alphabet) {
+  FTL_DCHECK(size);
+  const char* src = encoded.data();
+  size_t length = encoded.size();
+  // Strip the padding (whose absence is also allowed). Any other '=' is
+  // invalid.
+  if (length && length % 4u == 0u && src[length - 1u] == '=') {
+    length--;
+    if (src[length - 1u] == '=')
+      length--;
+  }
+  if (length % 4u == 1u)
+    return false;
+
+  const uint8_t* table = DecodeTableFor(alphabet);
+  uint8_t* out = static_cast<uint8_t*>(dest);
+  const size_t full_length = length - length % 4u;
+  size_t i = 0u;
+#if defined(FTL_BASE64_VECTORS)
+  if (UseVectors() &&
+      !DecodeBlocks(src, full_length, &out, &i, CharsFor(alphabet)))
+    return false;
+#endif
+  for (; i < full_length; i += 4u) {
+    uint32_t a = table[static_cast<uint8_t>(src[i])];
+    uint32_t b = table[static_cast<uint8_t>(src[i + 1u])];
+    uint32_t c = table[static_cast<uint8_t>(src[i + 2u])];
+    uint32_t d = table[static_cast<uint8_t>(src[i + 3u])];
+    if ((a | b | c | d) & 0x80u)
+      return false;
+    uint32_t group = (a << 18) | (b << 12) | (c << 6) | d;
+    out[0] = static_cast<uint8_t>(group >> 16);
+    out[1] = static_cast<uint8_t>(group >> 8);
+    out[2] = static_cast<uint8_t>(group);
+    out += 3;
+  }
+  if (i < length) {
+    // Two or three characters remain, for one or two bytes.
+    const bool two_bytes = i + 2u < length;
+    uint32_t a = table[static_cast<uint8_t>(src[i])];
+    uint32_t b = table[static_cast<uint8_t>(src[i + 1u])];
+    uint32_t c = two_bytes ? table[static_cast<uint8_t>(src[i + 2u])] : 0u;
+    if ((a | b | c) & 0x80u)
+      return false;
+    uint32_t group = (a << 18) | (b << 12) | (c << 6);
+    // The unused low bits must be zero (so that each byte string has one
+    // encoding).
+    if (group & (two_bytes ? 0xffu : 0xffffu))
+      return false;
+    *out++ = static_cast<uint8_t>(group >> 16);
+    if (two_bytes)
+      *out++ = static_cast<uint8_t>(group >> 8);
+  }
+  *size = static_cast<size_t>(out - static_cast<uint8_t*>(dest));
+  return true;
+}
+
+bool Base64Decode(StringView encoded,
+                  std::vector<uint8_t>* dest,
+                  Base64Alphabet alphabet) {
+  FTL_DCHECK(dest);
+  dest->resize(MaxBase64DecodedLength(encoded.size()));
+  size_t size = 0u;
+  if (!Base64Decode(encoded, dest->data(), &size, alphabet)) {
+    dest->clear();
+    return false;
+  }
+  dest->resize(size);
+  return true;
+}
+
+}  // namespace ftl
@@ -0,0 +1,81 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Base64 encoding and decoding (RFC 4648).
+
+#ifndef LIB_FTL_STRINGS_BASE64_H_
+#define LIB_FTL_STRINGS_BASE64_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+enum class Base64Alphabet {
+  // A-Z, a-z, 0-9, '+' and '/' (RFC 4648, section 4).
+  kStandard,
+  // A-Z, a-z, 0-9, '-' and '_', which are safe in URLs and file names (RFC
+  // 4648, section 5).
+  kUrlSafe,
+};
+
+enum class Base64Padding {
+  // Pad the encoding to a multiple of 4 characters with '='.
+  kInclude,
+  kOmit,
+};
+
+// Returns the length of the encoding of |size| bytes.
+constexpr size_t Base64EncodedLength(
+    size_t size,
+    Base64Padding padding = Base64Padding::kInclude) {
+  return padding == Base64Padding::kInclude ? (size + 2u) / 3u * 4u
+                                            : (size * 4u + 2u) / 3u;
+}
+
+// Returns the most bytes that |length| characters can decode to.
+constexpr size_t MaxBase64DecodedLength(size_t length) {
+  return length / 4u * 3u + length % 4u * 3u / 4u;
+}
+
+// Writes the encoding of the |size| bytes at |data| to |dest| (without a
+// terminating null), which must have room for |Base64EncodedLength()|
+// characters, and returns that length.
+FTL_EXPORT size_t
+Base64Encode(const void* data,
+             size_t size,
+             char* dest,
+             Base64Alphabet alphabet = Base64Alphabet::kStandard,
+             Base64Padding padding = Base64Padding::kInclude);
+FTL_EXPORT std::string Base64Encode(
+    const void* data,
+    size_t size,
+    Base64Alphabet alphabet = Base64Alphabet::kStandard,
+    Base64Padding padding = Base64Padding::kInclude);
+
+// Writes the bytes encoded by |encoded| to |dest|, which must have room for
+// |MaxBase64DecodedLength(encoded.size())| bytes, and stores their number in
+// |size|. Padding is optional, but if present must be complete. Returns false
+// if |encoded| isn't a valid (canonical) encoding, e.g., if it contains
+// characters not in |alphabet| (including whitespace), in which case the
+// contents of |dest| and |size| are unspecified.
+FTL_EXPORT bool Base64Decode(
+    StringView encoded,
+    void* dest,
+    size_t* size,
+    Base64Alphabet alphabet = Base64Alphabet::kStandard);
+FTL_EXPORT bool Base64Decode(
+    StringView encoded,
+    std::vector<uint8_t>* dest,
+    Base64Alphabet alphabet = Base64Alphabet::kStandard);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_BASE64_H_
@@ -0,0 +1,163 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/base64.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+
+namespace ftl {
+namespace {
+
+std::string Encode(StringView data,
+                   Base64Alphabet alphabet = Base64Alphabet::kStandard,
+                   Base64Padding padding = Base64Padding::kInclude) {
+  return Base64Encode(data.data(), data.size(), alphabet, padding);
+}
+
+// Returns the decoding of |encoded| as a string, or "<invalid>".
+std::string Decode(StringView encoded,
+                   Base64Alphabet alphabet = Base64Alphabet::kStandard) {
+  std::vector<uint8_t> bytes;
+  if (!Base64Decode(encoded, &bytes, alphabet))
+    return "<invalid>";
+  return std::string(bytes.begin(), bytes.end());
+}
+
+// The test vectors from RFC 4648, section 10.
+TEST(Base64, TestVectors) {
+  const struct {
+    const char* data;
+    const char* encoded;
+    const char* unpadded;
+  } kCases[] = {
+      {"", "", ""},
+      {"f", "Zg==", "Zg"},
+      {"fo", "Zm8=", "Zm8"},
+      {"foo", "Zm9v", "Zm9v"},
+      {"foob", "Zm9vYg==", "Zm9vYg"},
+      {"fooba", "Zm9vYmE=", "Zm9vYmE"},
+      {"foobar", "Zm9vYmFy", "Zm9vYmFy"},
+  };
+  for (size_t i = 0u; i < arraysize(kCases); i++) {
+    StringView data(kCases[i].data);
+    EXPECT_EQ(kCases[i].encoded, Encode(data));
+    EXPECT_EQ(kCases[i].unpadded,
+              Encode(data, Base64Alphabet::kStandard, Base64Padding::kOmit));
+    EXPECT_EQ(strlen(kCases[i].encoded), Base64EncodedLength(data.size()));
+    EXPECT_EQ(strlen(kCases[i].unpadded),
+              Base64EncodedLength(data.size(), Base64Padding::kOmit));
+    EXPECT_EQ(data, Decode(StringView(kCases[i].encoded)));
+    EXPECT_EQ(data, Decode(StringView(kCases[i].unpadded)));
+  }
+}
+
+TEST(Base64, UrlSafe) {
+  const char kData[] = "\xfb\xff\xbf";
+  StringView data(kData, 3u);
+  EXPECT_EQ("+/+/", Encode(data));
+  EXPECT_EQ("-_-_", Encode(data, Base64Alphabet::kUrlSafe));
+  EXPECT_EQ("-_8=", Encode(data.substr(0u, 2u), Base64Alphabet::kUrlSafe));
+  EXPECT_EQ("-_8", Encode(data.substr(0u, 2u), Base64Alphabet::kUrlSafe,
+                          Base64Padding::kOmit));
+  EXPECT_EQ(data, Decode("+/+/"));
+  EXPECT_EQ(data, Decode("-_-_", Base64Alphabet::kUrlSafe));
+  EXPECT_EQ("<invalid>", Decode("-_-_"));
+  EXPECT_EQ("<invalid>", Decode("+/+/", Base64Alphabet::kUrlSafe));
+}
+
+TEST(Base64, Invalid) {
+  EXPECT_EQ("<invalid>", Decode("Z"));
+  EXPECT_EQ("<invalid>", Decode("Zm9vY"));
+  // Incomplete or excess padding.
+  EXPECT_EQ("<invalid>", Decode("Zg="));
+  EXPECT_EQ("<invalid>", Decode("Zm9v="));
+  EXPECT_EQ("<invalid>", Decode("Zm8=="));
+  EXPECT_EQ("<invalid>", Decode("Zg==="));
+  EXPECT_EQ("<invalid>", Decode("Z==="));
+  EXPECT_EQ("<invalid>", Decode("===="));
+  EXPECT_EQ("<invalid>", Decode("Zg==Zg=="));
+  // Nonzero unused bits.
+  EXPECT_EQ("<invalid>", Decode("Zh=="));
+  EXPECT_EQ("<invalid>", Decode("Zm9="));
+  EXPECT_EQ("<invalid>", Decode("Zh"));
+  // Characters not in the alphabet.
+  EXPECT_EQ("<invalid>", Decode("Zm9v Yg=="));
+  EXPECT_EQ("<invalid>", Decode("Zm9v\nYg=="));
+  EXPECT_EQ("<invalid>", Decode("Zm9*"));
+  EXPECT_EQ("<invalid>", Decode("Zm9\xc3"));
+}
+
+// A simple reference encoder.
+std::string ReferenceEncode(const std::vector<uint8_t>& bytes,
+                            const char* chars) {
+  std::string result;
+  uint32_t bits = 0u;
+  int bit_count = 0;
+  for (uint8_t byte : bytes) {
+    bits = (bits << 8) | byte;
+    bit_count += 8;
+    while (bit_count >= 6) {
+      bit_count -= 6;
+      result += chars[(bits >> bit_count) & 0x3f];
+    }
+  }
+  if (bit_count)
+    result += chars[(bits << (6 - bit_count)) & 0x3f];
+  while (result.size() % 4u)
+    result += '=';
+  return result;
+}
+
+// Checks lengths that exercise the vectorized blocks and the tails, and
+// corruption at every position.
+TEST(Base64, Random) {
+  const char kStandardChars[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  const char kUrlSafeChars[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  srand(789);
+  for (size_t size = 0u; size < 200u; size++) {
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t& byte : bytes)
+      byte = static_cast<uint8_t>(rand());
+    for (Base64Alphabet alphabet :
+         {Base64Alphabet::kStandard, Base64Alphabet::kUrlSafe}) {
+      const char* chars = alphabet == Base64Alphabet::kStandard
+                              ? kStandardChars
+                              : kUrlSafeChars;
+      std::string encoded = Base64Encode(bytes.data(), size, alphabet);
+      EXPECT_EQ(ReferenceEncode(bytes, chars), encoded);
+
+      std::vector<uint8_t> decoded;
+      EXPECT_TRUE(Base64Decode(encoded, &decoded, alphabet));
+      EXPECT_EQ(bytes, decoded);
+
+      std::string unpadded = Base64Encode(bytes.data(), size, alphabet,
+                                          Base64Padding::kOmit);
+      EXPECT_EQ(encoded.substr(0u, unpadded.size()), unpadded);
+      EXPECT_TRUE(Base64Decode(unpadded, &decoded, alphabet));
+      EXPECT_EQ(bytes, decoded);
+
+      for (size_t i = 0u; i < unpadded.size(); i++) {
+        std::string bad = unpadded;
+        // (Except that '=' could make valid padding at the end.)
+        const char kBadChars[] = "*.\n \x80\xff=";
+        bad[i] = kBadChars[rand() % (i + 2u < unpadded.size() ? 7 : 6)];
+        EXPECT_FALSE(Base64Decode(bad, &decoded, alphabet)) << bad;
+        bad[i] = alphabet == Base64Alphabet::kStandard ? '-' : '+';
+        EXPECT_FALSE(Base64Decode(bad, &decoded, alphabet)) << bad;
+      }
+    }
+  }
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,160 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/binary_buffer.h"
+
+#include <limits>
+
+#include "lib/ftl/compiler_specific.h"
+
+namespace ftl {
+
+size_t EncodeVarint(uint64_t value, char* dest) {
+  size_t size = 0u;
+  while (value >= 0x80u) {
+    dest[size++] = static_cast<char>(value | 0x80u);
+    value >>= 7;
+  }
+  dest[size++] = static_cast<char>(value);
+  return size;
+}
+
+BufferWriter::BufferWriter(std::string* output)
+    : output_(output), buffer_(nullptr), capacity_(0u) {}
+
+BufferWriter::BufferWriter(char* buffer, size_t capacity)
+    : output_(nullptr), buffer_(buffer), capacity_(capacity) {}
+
+BufferWriter::~BufferWriter() {}
+
+void BufferWriter::WriteBytes(const void* data, size_t size) {
+  if (output_) {
+    output_->append(static_cast<const char*>(data), size);
+    return;
+  }
+  if (!ok_ || capacity_ - size_ < size) {
+    ok_ = false;
+    return;
+  }
+  memcpy(buffer_ + size_, data, size);
+  size_ += size;
+}
+
+void BufferWriter::WriteVarint(uint64_t value) {
+  char bytes[kMaxVarintSize];
+  WriteBytes(bytes, EncodeVarint(value, bytes));
+}
+
+void BufferWriter::WriteString(StringView string) {
+  WriteVarint(string.size());
+  WriteBytes(string.data(), string.size());
+}
+
+BufferReader::BufferReader(StringView data)
+    : data_(data.data()), end_(data.data() + data.size()) {}
+
+BufferReader::~BufferReader() {}
+
+bool BufferReader::ReadBytes(size_t size, StringView* bytes) {
+  if (static_cast<size_t>(end_ - data_) < size)
+    return false;
+  *bytes = StringView(data_, size);
+  data_ += size;
+  return true;
+}
+
+bool BufferReader::Skip(size_t size) {
+  if (static_cast<size_t>(end_ - data_) < size)
+    return false;
+  data_ += size;
+  return true;
+}
+
+bool BufferReader::ReadVarint(uint64_t* value) {
+  if (FTL_UNLIKELY(data_ == end_))
+    return false;
+  uint8_t first = static_cast<uint8_t>(*data_);
+  if (FTL_LIKELY(first < 0x80u)) {
+    *value = first;
+    data_++;
+    return true;
+  }
+  if (static_cast<size_t>(end_ - data_) < sizeof(uint64_t))
+    return ReadVarintSlow(value);
+
+  // Decode varints of up to 8 bytes from a single (unaligned) load: find the
+  // last byte (the first without its top bit set), and then squeeze out the
+  // top bits, halving the number of gaps at each step.
+  uint64_t word = LoadLittleEndian<uint64_t>(data_);
+  uint64_t last_bits = ~word & UINT64_C(0x8080808080808080);
+  if (!last_bits)
+    return ReadVarintSlow(value);
+  size_t bits = static_cast<size_t>(__builtin_ctzll(last_bits)) + 1u;
+  if (bits < 64u)
+    word &= (UINT64_C(1) << bits) - 1u;
+  word &= UINT64_C(0x7f7f7f7f7f7f7f7f);
+  word = ((word & UINT64_C(0x7f007f007f007f00)) >> 1) |
+         (word & UINT64_C(0x007f007f007f007f));
+  word = ((word & UINT64_C(0x3fff00003fff0000)) >> 2) |
+         (word & UINT64_C(0x00003fff00003fff));
+  word = ((word & UINT64_C(0x0fffffff00000000)) >> 4) |
+         (word & UINT64_C(0x000000000fffffff));
+  *value = word;
+  data_ += bits / 8u;
+  return true;
+}
+
+bool BufferReader::ReadVarint(uint32_t* value) {
+  const char* start = data_;
+  uint64_t value64;
+  if (!ReadVarint(&value64))
+    return false;
+  if (value64 > std::numeric_limits<uint32_t>::max()) {
+    data_ = start;
+    return false;
+  }
+  *value = static_cast<uint32_t>(value64);
+  return true;
+}
+
+bool BufferReader::ReadSignedVarint(int64_t* value) {
+  uint64_t encoded;
+  if (!ReadVarint(&encoded))
+    return false;
+  *value = ZigZagDecode(encoded);
+  return true;
+}
+
+bool BufferReader::ReadString(StringView* string) {
+  const char* start = data_;
+  uint64_t size;
+  if (!ReadVarint(&size))
+    return false;
+  if (static_cast<uint64_t>(end_ - data_) < size) {
+    data_ = start;
+    return false;
+  }
+  *string = StringView(data_, static_cast<size_t>(size));
+  data_ += size;
+  return true;
+}
+
+bool BufferReader::ReadVarintSlow(uint64_t* value) {
+  uint64_t result = 0u;
+  for (size_t i = 0; i < kMaxVarintSize && data_ + i < end_; i++) {
+    uint64_t byte = static_cast<uint8_t>(data_[i]);
+    // The 10th byte only has room for the top bit.
+    if (i == kMaxVarintSize - 1u && byte > 1u)
+      return false;
+    result |= (byte & 0x7fu) << (7u * i);
+    if (byte < 0x80u) {
+      *value = result;
+      data_ += i + 1u;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace ftl
@@ -0,0 +1,286 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Helpers for (de)serializing binary data: unaligned fixed-size integer loads
+// and stores of either byte order, and |BufferWriter| and |BufferReader|,
+// which also handle LEB128 varints and length-prefixed strings.
+
+#ifndef LIB_FTL_STRINGS_BINARY_BUFFER_H_
+#define LIB_FTL_STRINGS_BINARY_BUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <type_traits>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace internal {
+
+inline uint8_t ByteSwap(uint8_t value) {
+  return value;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+inline uint16_t ByteSwap(uint16_t value) {
+  return __builtin_bswap16(value);
+}
+inline uint32_t ByteSwap(uint32_t value) {
+  return __builtin_bswap32(value);
+}
+inline uint64_t ByteSwap(uint64_t value) {
+  return __builtin_bswap64(value);
+}
+#else
+inline uint16_t ByteSwap(uint16_t value) {
+  return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+inline uint32_t ByteSwap(uint32_t value) {
+  return (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) |
+         (value << 24);
+}
+inline uint64_t ByteSwap(uint64_t value) {
+  return (static_cast<uint64_t>(ByteSwap(static_cast<uint32_t>(value))) << 32) |
+         ByteSwap(static_cast<uint32_t>(value >> 32));
+}
+#endif
+
+// The unsigned integer type of |Size| bytes.
+template <size_t Size>
+struct UnsignedOfSize;
+template <>
+struct UnsignedOfSize<1u> {
+  using Type = uint8_t;
+};
+template <>
+struct UnsignedOfSize<2u> {
+  using Type = uint16_t;
+};
+template <>
+struct UnsignedOfSize<4u> {
+  using Type = uint32_t;
+};
+template <>
+struct UnsignedOfSize<8u> {
+  using Type = uint64_t;
+};
+
+template <typename T>
+using EnableIfInteger =
+    typename std::enable_if<std::is_integral<T>::value &&
+                                !std::is_same<T, bool>::value,
+                            T>::type;
+
+// Converts between native and little- (or big-) endian byte order (either
+// way, since it's its own inverse).
+template <typename T>
+T ToLittleEndian(T value) {
+#if defined(ARCH_CPU_LITTLE_ENDIAN)
+  return value;
+#else
+  using U = typename UnsignedOfSize<sizeof(T)>::Type;
+  return static_cast<T>(ByteSwap(static_cast<U>(value)));
+#endif
+}
+
+template <typename T>
+T ToBigEndian(T value) {
+  using U = typename UnsignedOfSize<sizeof(T)>::Type;
+#if defined(ARCH_CPU_LITTLE_ENDIAN)
+  return static_cast<T>(ByteSwap(static_cast<U>(value)));
+#else
+  return value;
+#endif
+}
+
+}  // namespace internal
+
+// Loads a little- (or big-) endian |T| (an integer type) from |src|, which
+// needn't be aligned.
+template <typename T>
+internal::EnableIfInteger<T> LoadLittleEndian(const void* src) {
+  T value;
+  memcpy(&value, src, sizeof(value));
+  return internal::ToLittleEndian(value);
+}
+
+template <typename T>
+internal::EnableIfInteger<T> LoadBigEndian(const void* src) {
+  T value;
+  memcpy(&value, src, sizeof(value));
+  return internal::ToBigEndian(value);
+}
+
+// Stores |value| (of an integer type) little- (or big-) endian at |dest|,
+// which needn't be aligned.
+template <typename T>
+void StoreLittleEndian(internal::EnableIfInteger<T> value, void* dest) {
+  value = internal::ToLittleEndian(value);
+  memcpy(dest, &value, sizeof(value));
+}
+
+template <typename T>
+void StoreBigEndian(internal::EnableIfInteger<T> value, void* dest) {
+  value = internal::ToBigEndian(value);
+  memcpy(dest, &value, sizeof(value));
+}
+
+// The most bytes a (64-bit) varint takes.
+constexpr size_t kMaxVarintSize = 10u;
+
+// Writes |value| as an (unsigned LEB128) varint to |dest|, which must have
+// room for |kMaxVarintSize| bytes, and returns the number of bytes written.
+FTL_EXPORT size_t EncodeVarint(uint64_t value, char* dest);
+
+// Maps signed integers to unsigned ones with small absolute values to small
+// values (0, -1, 1, -2, ... to 0, 1, 2, 3, ...), so that they make short
+// varints.
+inline uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+inline int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1u);
+}
+
+// Serializes values to a buffer, e.g.:
+//
+//   std::string data;
+//   BufferWriter writer(&data);
+//   writer.WriteLittleEndian<uint32_t>(kMagic);
+//   writer.WriteVarint(entries.size());
+//   for (const auto& entry : entries) {
+//     writer.WriteString(entry.name);
+//     writer.WriteSignedVarint(entry.delta);
+//   }
+//   WriteFile(path, data.data(), data.size());
+//
+// Writing to a fixed-size buffer which is too small fails: the write (and all
+// subsequent ones) are dropped, and |ok()| becomes false.
+class FTL_EXPORT BufferWriter final {
+ public:
+  // Appends to |*output|, which must outlive this.
+  explicit BufferWriter(std::string* output);
+  // Writes to the |capacity| bytes at |buffer|.
+  BufferWriter(char* buffer, size_t capacity);
+  ~BufferWriter();
+
+  // Whether all the writes succeeded (which they do, if this is appending to
+  // a string).
+  bool ok() const { return ok_; }
+
+  // The number of bytes written (including any that were already in the
+  // string).
+  size_t size() const { return output_ ? output_->size() : size_; }
+
+  void WriteBytes(const void* data, size_t size);
+  void WriteByte(uint8_t value) { WriteBytes(&value, 1u); }
+
+  template <typename T>
+  void WriteLittleEndian(internal::EnableIfInteger<T> value) {
+    char bytes[sizeof(T)];
+    StoreLittleEndian<T>(value, bytes);
+    WriteBytes(bytes, sizeof(bytes));
+  }
+
+  template <typename T>
+  void WriteBigEndian(internal::EnableIfInteger<T> value) {
+    char bytes[sizeof(T)];
+    StoreBigEndian<T>(value, bytes);
+    WriteBytes(bytes, sizeof(bytes));
+  }
+
+  // Writes |value| as an unsigned (or, for |WriteSignedVarint()|, zigzag)
+  // LEB128 varint.
+  void WriteVarint(uint64_t value);
+  void WriteSignedVarint(int64_t value) { WriteVarint(ZigZagEncode(value)); }
+
+  // Writes |string| prefixed by its length (as a varint).
+  void WriteString(StringView string);
+
+ private:
+  std::string* const output_;
+  char* const buffer_;
+  const size_t capacity_;
+  size_t size_ = 0u;
+  bool ok_ = true;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BufferWriter);
+};
+
+// Deserializes values written by a |BufferWriter| (or anything else), from
+// the start of a buffer, e.g.:
+//
+//   BufferReader reader(data);
+//   uint32_t magic;
+//   uint64_t count;
+//   if (!reader.ReadLittleEndian(&magic) || magic != kMagic ||
+//       !reader.ReadVarint(&count))
+//     return false;
+//
+// Each read returns false (leaving the position unchanged) if the rest of the
+// buffer is too short (or, for varints, malformed).
+class FTL_EXPORT BufferReader final {
+ public:
+  // Reads |data|, which must outlive this.
+  explicit BufferReader(StringView data);
+  ~BufferReader();
+
+  // The unread part of the buffer.
+  StringView remaining() const { return StringView(data_, end_ - data_); }
+  bool at_end() const { return data_ == end_; }
+
+  // Reads (a view of) the next |size| bytes (which stays valid as long as the
+  // buffer does).
+  bool ReadBytes(size_t size, StringView* bytes);
+  bool Skip(size_t size);
+  bool ReadByte(uint8_t* value) { return ReadFixed(value, false); }
+
+  template <typename T>
+  bool ReadLittleEndian(T* value) {
+    return ReadFixed(value, false);
+  }
+
+  template <typename T>
+  bool ReadBigEndian(T* value) {
+    return ReadFixed(value, true);
+  }
+
+  // Reads an unsigned LEB128 varint, failing if it doesn't fit in |*value|'s
+  // type (or is longer than |kMaxVarintSize| bytes).
+  bool ReadVarint(uint64_t* value);
+  bool ReadVarint(uint32_t* value);
+  // Reads a zigzag LEB128 varint.
+  bool ReadSignedVarint(int64_t* value);
+
+  // Reads (a view of) a string written by |BufferWriter::WriteString()|.
+  bool ReadString(StringView* string);
+
+ private:
+  template <typename T>
+  bool ReadFixed(T* value, bool big_endian) {
+    if (static_cast<size_t>(end_ - data_) < sizeof(T))
+      return false;
+    *value = big_endian ? LoadBigEndian<T>(data_) : LoadLittleEndian<T>(data_);
+    data_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadVarintSlow(uint64_t* value);
+
+  const char* data_;
+  const char* const end_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BufferReader);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_BINARY_BUFFER_H_
@@ -0,0 +1,171 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/binary_buffer.h"
+
+#include <stdint.h>
+
+#include <limits>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+
+namespace ftl {
+namespace {
+
+TEST(BinaryBuffer, LoadAndStore) {
+  const char kBytes[] = "\x01\x02\x03\x04\x05\x06\x07\x08\x09";
+  // Unaligned.
+  EXPECT_EQ(0x0504u, LoadLittleEndian<uint16_t>(kBytes + 3));
+  EXPECT_EQ(0x0405u, LoadBigEndian<uint16_t>(kBytes + 3));
+  EXPECT_EQ(0x05040302u, LoadLittleEndian<uint32_t>(kBytes + 1));
+  EXPECT_EQ(0x02030405u, LoadBigEndian<uint32_t>(kBytes + 1));
+  EXPECT_EQ(UINT64_C(0x0908070605040302),
+            LoadLittleEndian<uint64_t>(kBytes + 1));
+  EXPECT_EQ(UINT64_C(0x0203040506070809), LoadBigEndian<uint64_t>(kBytes + 1));
+  EXPECT_EQ(-2, LoadBigEndian<int16_t>("\xff\xfe"));
+
+  char buffer[9] = {};
+  StoreLittleEndian<uint32_t>(0x01020304u, buffer + 1);
+  EXPECT_EQ(std::string("\x00\x04\x03\x02\x01", 5), std::string(buffer, 5));
+  StoreBigEndian<uint64_t>(UINT64_C(0x0102030405060708), buffer + 1);
+  EXPECT_EQ(std::string("\x00\x01\x02\x03\x04\x05\x06\x07\x08", 9),
+            std::string(buffer, 9));
+}
+
+TEST(BinaryBuffer, ZigZag) {
+  EXPECT_EQ(0u, ZigZagEncode(0));
+  EXPECT_EQ(1u, ZigZagEncode(-1));
+  EXPECT_EQ(2u, ZigZagEncode(1));
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(),
+            ZigZagEncode(std::numeric_limits<int64_t>::min()));
+  const int64_t kValues[] = {0, 1, -1, 63, -64, 1000000,
+                             std::numeric_limits<int64_t>::max(),
+                             std::numeric_limits<int64_t>::min()};
+  for (int64_t value : kValues)
+    EXPECT_EQ(value, ZigZagDecode(ZigZagEncode(value)));
+}
+
+TEST(BinaryBuffer, WriteAndRead) {
+  std::string data = "header";
+  BufferWriter writer(&data);
+  writer.WriteByte(0xab);
+  writer.WriteLittleEndian<uint32_t>(0xdeadbeefu);
+  writer.WriteBigEndian<int16_t>(-2);
+  writer.WriteVarint(300u);
+  writer.WriteSignedVarint(-3);
+  writer.WriteString("hello");
+  writer.WriteString("");
+  EXPECT_TRUE(writer.ok());
+  EXPECT_EQ(data.size(), writer.size());
+  EXPECT_EQ(std::string("header\xab\xef\xbe\xad\xde\xff\xfe\xac\x02\x05"
+                        "\x05hello\x00",
+                        23),
+            data);
+
+  BufferReader reader(data);
+  StringView header;
+  uint8_t byte;
+  uint32_t u32;
+  int16_t i16;
+  uint64_t u64;
+  int64_t i64;
+  StringView string;
+  ASSERT_TRUE(reader.ReadBytes(6u, &header));
+  EXPECT_EQ("header", header);
+  ASSERT_TRUE(reader.ReadByte(&byte));
+  EXPECT_EQ(0xab, byte);
+  ASSERT_TRUE(reader.ReadLittleEndian(&u32));
+  EXPECT_EQ(0xdeadbeefu, u32);
+  ASSERT_TRUE(reader.ReadBigEndian(&i16));
+  EXPECT_EQ(-2, i16);
+  ASSERT_TRUE(reader.ReadVarint(&u64));
+  EXPECT_EQ(300u, u64);
+  ASSERT_TRUE(reader.ReadSignedVarint(&i64));
+  EXPECT_EQ(-3, i64);
+  ASSERT_TRUE(reader.ReadString(&string));
+  EXPECT_EQ("hello", string);
+  ASSERT_TRUE(reader.ReadString(&string));
+  EXPECT_EQ("", string);
+  EXPECT_TRUE(reader.at_end());
+  EXPECT_FALSE(reader.ReadByte(&byte));
+}
+
+TEST(BinaryBuffer, FixedBuffer) {
+  char buffer[6];
+  BufferWriter writer(buffer, sizeof(buffer));
+  writer.WriteLittleEndian<uint32_t>(1u);
+  writer.WriteVarint(1u);
+  EXPECT_TRUE(writer.ok());
+  EXPECT_EQ(5u, writer.size());
+  // Too big: dropped, as is everything after it.
+  writer.WriteVarint(300u);
+  EXPECT_FALSE(writer.ok());
+  writer.WriteByte(1u);
+  EXPECT_FALSE(writer.ok());
+  EXPECT_EQ(5u, writer.size());
+}
+
+TEST(BinaryBuffer, Varints) {
+  // Values around each length boundary, read both with the fast path (with
+  // padding after them) and the slow one (without).
+  for (int bits = 0; bits <= 64; bits++) {
+    uint64_t base = bits == 64 ? 0u : UINT64_C(1) << bits;
+    for (uint64_t value : {base - 1u, base, base + 1u}) {
+      std::string data;
+      BufferWriter writer(&data);
+      writer.WriteVarint(value);
+      size_t size = data.size();
+      EXPECT_LE(size, kMaxVarintSize);
+
+      std::string padded = data + std::string(16u, '\xff');
+      BufferReader padded_reader(padded);
+      uint64_t result = 0u;
+      ASSERT_TRUE(padded_reader.ReadVarint(&result)) << value;
+      EXPECT_EQ(value, result);
+      EXPECT_EQ(16u, padded_reader.remaining().size());
+
+      BufferReader reader(data);
+      result = 0u;
+      ASSERT_TRUE(reader.ReadVarint(&result)) << value;
+      EXPECT_EQ(value, result);
+      EXPECT_TRUE(reader.at_end());
+
+      // Truncated.
+      BufferReader truncated(StringView(data).substr(0, size - 1u));
+      EXPECT_FALSE(truncated.ReadVarint(&result));
+      EXPECT_EQ(size - 1u, truncated.remaining().size());
+    }
+  }
+}
+
+TEST(BinaryBuffer, MalformedVarints) {
+  uint64_t u64;
+  uint32_t u32;
+  StringView string;
+
+  // Too long, or too big (in the 10th byte).
+  const std::string too_long_data = std::string(10u, '\x80') + '\x01';
+  BufferReader too_long(too_long_data);
+  EXPECT_FALSE(too_long.ReadVarint(&u64));
+  const std::string too_big_data = std::string(9u, '\xff') + '\x02';
+  BufferReader too_big(too_big_data);
+  EXPECT_FALSE(too_big.ReadVarint(&u64));
+
+  // Too big for 32 bits (which leaves the position unchanged).
+  BufferReader reader("\x80\x80\x80\x80\x10\x05");
+  EXPECT_FALSE(reader.ReadVarint(&u32));
+  EXPECT_EQ(6u, reader.remaining().size());
+  ASSERT_TRUE(reader.ReadVarint(&u64));
+  EXPECT_EQ(UINT64_C(1) << 32, u64);
+
+  // A string longer than the rest of the buffer.
+  BufferReader short_string("\x05" "abc");
+  EXPECT_FALSE(short_string.ReadString(&string));
+  EXPECT_EQ(4u, short_string.remaining().size());
+}
+
+}  // namespace
+}  // namespace ftl
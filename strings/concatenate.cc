@@ -4,6 +4,10 @@
 
 #include "lib/ftl/strings/concatenate.h"
 
+#include <algorithm>
+
+#include "lib/ftl/logging.h"
+
 namespace ftl {
 
 std::string Concatenate(std::initializer_list<ftl::StringView> string_views) {
@@ -19,4 +23,24 @@ std::string Concatenate(std::initializer_list<ftl::StringView> string_views) {
   return result;
 }
 
+namespace internal {
+
+void StrAppend(std::string* dest,
+               std::initializer_list<FormatArgument> pieces) {
+  FTL_DCHECK(dest);
+
+  size_t size = dest->size();
+  for (const FormatArgument& piece : pieces)
+    size += piece.string().size();
+  // (Keep growing geometrically, in case this is called repeatedly.)
+  if (size > dest->capacity())
+    dest->reserve(std::max(size, 2u * dest->capacity()));
+  for (const FormatArgument& piece : pieces) {
+    StringView string = piece.string();
+    dest->append(string.data(), string.size());
+  }
+}
+
+}  // namespace internal
+
 }  // namespace ftl
@@ -8,7 +8,9 @@
 #include <initializer_list>
 #include <string>
 
+#include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/format.h"
 #include "lib/ftl/strings/string_view.h"
 
 namespace ftl {
@@ -17,6 +19,35 @@ namespace ftl {
 FTL_EXPORT std::string Concatenate(
     std::initializer_list<ftl::StringView> string_views);
 
+namespace internal {
+
+FTL_EXPORT void StrAppend(std::string* dest,
+                          std::initializer_list<FormatArgument> pieces);
+
+}  // namespace internal
+
+// Concatenates |args|, each of which may be a string, a number, a |Hex|, etc.
+// (formatted as by |Format()|), e.g.:
+//
+//   std::string key = StrCat(prefix, id, ":", Hex(shard, 4));
+//
+// The numbers are formatted on the stack, and the result is allocated once.
+template <typename... Args>
+std::string StrCat(const Args&... args) FTL_WARN_UNUSED_RESULT;
+
+template <typename... Args>
+std::string StrCat(const Args&... args) {
+  std::string result;
+  internal::StrAppend(&result, {args...});
+  return result;
+}
+
+// Like |StrCat()|, but appends to |*dest| (which mustn't be one of |args|).
+template <typename... Args>
+void StrAppend(std::string* dest, const Args&... args) {
+  internal::StrAppend(dest, {args...});
+}
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_STRINGS_CONCATENATE_H_
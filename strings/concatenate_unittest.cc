@@ -26,5 +26,35 @@ TEST(StringUtil, Concatenate) {
   EXPECT_EQ("abc\0def\0ghi"_s, Concatenate({with_zeroes, "\0ghi"_s}));
 }
 
+TEST(StringUtil, StrCat) {
+  EXPECT_EQ("", StrCat());
+  EXPECT_EQ("a", StrCat("a"));
+
+  std::string prefix = "user/";
+  EXPECT_EQ("user/12345:0A3F",
+            StrCat(prefix, 12345, ":", Hex(0xa3f, 4)));
+  EXPECT_EQ("-1 2 0.5 x true", StrCat(-1, " ", 2u, " ", 0.5, " ", 'x', " ",
+                                     true));
+  EXPECT_EQ("FF FFFFFFFF 0000000000000001",
+            StrCat(Hex(255), " ", Hex(-1), " ", Hex(1, 16)));
+  EXPECT_EQ("abc\0def"_s, StrCat("abc", "\0def"_s));
+}
+
+TEST(StringUtil, StrAppend) {
+  std::string result = "key";
+  StrAppend(&result, "/", 7, "/", StringView("shard"));
+  EXPECT_EQ("key/7/shard", result);
+  StrAppend(&result);
+  EXPECT_EQ("key/7/shard", result);
+
+  std::string expected;
+  result.clear();
+  for (int i = 0; i < 1000; i++) {
+    StrAppend(&result, i, ",");
+    expected += std::to_string(i) + ",";
+  }
+  EXPECT_EQ(expected, result);
+}
+
 }  // namespace
 }  // namespace ftl
@@ -0,0 +1,209 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/cord.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+
+namespace ftl {
+namespace internal {
+
+// The storage for |Cord|s' chunks. Once shared, its characters never change;
+// only a |Cord| with the sole reference may append to it, and then only within
+// its capacity (so that the characters never move).
+class CordBuffer final : public RefCountedThreadSafe<CordBuffer> {
+ public:
+  std::string& data() { return data_; }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(CordBuffer);
+  FRIEND_MAKE_REF_COUNTED(CordBuffer);
+
+  explicit CordBuffer(std::string data) : data_(std::move(data)) {}
+  ~CordBuffer() {}
+
+  std::string data_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(CordBuffer);
+};
+
+}  // namespace internal
+
+namespace {
+
+// The capacity of the buffers that small |StringView|s are appended to grows
+// with the |Cord| (so that the number of chunks grows logarithmically), between
+// these bounds.
+constexpr size_t kMinBufferCapacity = 128u;
+constexpr size_t kMaxBufferCapacity = 64u * 1024u;
+
+}  // namespace
+
+Cord::Cord() = default;
+
+Cord::Cord(StringView string) {
+  Append(string);
+}
+
+Cord::Cord(const Cord& other) = default;
+
+Cord::Cord(Cord&& other)
+    : pieces_(std::move(other.pieces_)), size_(other.size_) {
+  other.Clear();
+}
+
+Cord::~Cord() = default;
+
+Cord& Cord::operator=(const Cord& other) = default;
+
+Cord& Cord::operator=(Cord&& other) {
+  if (this != &other) {
+    pieces_ = std::move(other.pieces_);
+    size_ = other.size_;
+    other.Clear();
+  }
+  return *this;
+}
+
+void Cord::Append(StringView string) {
+  if (string.empty() || ExtendLastPiece(string))
+    return;
+  size_t capacity = std::max(
+      string.size(),
+      std::min(std::max(size_, kMinBufferCapacity), kMaxBufferCapacity));
+  RefPtr<internal::CordBuffer> buffer = NewBuffer(string, capacity);
+  const char* data = buffer->data().data();
+  PushBack(Piece{std::move(buffer), data, string.size()});
+}
+
+void Cord::AppendOwned(std::string&& string) {
+  if (string.empty())
+    return;
+  size_t size = string.size();
+  RefPtr<internal::CordBuffer> buffer =
+      MakeRefCounted<internal::CordBuffer>(std::move(string));
+  const char* data = buffer->data().data();
+  PushBack(Piece{std::move(buffer), data, size});
+}
+
+void Cord::Append(const Cord& other) {
+  if (&other == this) {
+    Cord copy(other);
+    Append(copy);
+    return;
+  }
+  for (const Piece& piece : other.pieces_)
+    PushBack(piece);
+}
+
+void Cord::Prepend(StringView string) {
+  if (string.empty())
+    return;
+  RefPtr<internal::CordBuffer> buffer = NewBuffer(string, string.size());
+  const char* data = buffer->data().data();
+  PushFront(Piece{std::move(buffer), data, string.size()});
+}
+
+void Cord::PrependOwned(std::string&& string) {
+  if (string.empty())
+    return;
+  size_t size = string.size();
+  RefPtr<internal::CordBuffer> buffer =
+      MakeRefCounted<internal::CordBuffer>(std::move(string));
+  const char* data = buffer->data().data();
+  PushFront(Piece{std::move(buffer), data, size});
+}
+
+void Cord::Prepend(const Cord& other) {
+  if (&other == this) {
+    Cord copy(other);
+    Prepend(copy);
+    return;
+  }
+  for (auto it = other.pieces_.rbegin(); it != other.pieces_.rend(); ++it)
+    PushFront(*it);
+}
+
+Cord Cord::Substr(size_t pos, size_t n) const {
+  FTL_DCHECK(pos <= size_);
+  n = std::min(n, size_ - pos);
+  Cord result;
+  auto it = pieces_.begin();
+  // Skip the pieces before |pos|.
+  for (; n > 0u && pos >= it->size; ++it)
+    pos -= it->size;
+  for (; n > 0u; ++it) {
+    size_t size = std::min(n, it->size - pos);
+    result.PushBack(Piece{it->buffer, it->data + pos, size});
+    n -= size;
+    pos = 0u;
+  }
+  return result;
+}
+
+void Cord::Clear() {
+  pieces_.clear();
+  size_ = 0u;
+}
+
+void Cord::CopyTo(char* dest) const {
+  for (const Piece& piece : pieces_) {
+    memcpy(dest, piece.data, piece.size);
+    dest += piece.size;
+  }
+}
+
+std::string Cord::ToString() const {
+  std::string result(size_, '\0');
+  if (size_)
+    CopyTo(&result[0]);
+  return result;
+}
+
+// static
+RefPtr<internal::CordBuffer> Cord::NewBuffer(StringView string,
+                                             size_t capacity) {
+  std::string data;
+  data.reserve(capacity);
+  data.append(string.data(), string.size());
+  return MakeRefCounted<internal::CordBuffer>(std::move(data));
+}
+
+bool Cord::ExtendLastPiece(StringView string) {
+  if (pieces_.empty())
+    return false;
+  Piece& last = pieces_.back();
+  // Only the sole owner of the buffer may write to it, and only if the piece
+  // ends at the end of the buffer's characters (and no reallocation is needed).
+  if (!last.buffer->HasOneRef())
+    return false;
+  std::string& data = last.buffer->data();
+  if (last.data + last.size != data.data() + data.size() ||
+      data.capacity() - data.size() < string.size())
+    return false;
+  data.append(string.data(), string.size());
+  last.size += string.size();
+  size_ += string.size();
+  return true;
+}
+
+void Cord::PushBack(Piece piece) {
+  FTL_DCHECK(piece.size > 0u);
+  size_ += piece.size;
+  pieces_.push_back(std::move(piece));
+}
+
+void Cord::PushFront(Piece piece) {
+  FTL_DCHECK(piece.size > 0u);
+  size_ += piece.size;
+  pieces_.push_front(std::move(piece));
+}
+
+}  // namespace ftl
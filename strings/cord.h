@@ -0,0 +1,167 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides |Cord|, a string made of shared chunks, for assembling large strings
+// without copying.
+
+#ifndef LIB_FTL_STRINGS_CORD_H_
+#define LIB_FTL_STRINGS_CORD_H_
+
+#include <stddef.h>
+
+#include <deque>
+#include <iterator>
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+namespace internal {
+class CordBuffer;
+}  // namespace internal
+
+// A string stored as a sequence of chunks of immutable, reference-counted
+// (thread-safe) buffers. Appending or prepending another |Cord|, or an owned
+// |std::string|, copies no characters; copying a |Cord| or taking a
+// |Substr()| just shares its buffers. Small appends of |StringView|s are copied
+// into the last buffer while it has room (and isn't shared), so building a
+// |Cord| from many small pieces doesn't make many tiny chunks.
+//
+// The chunks can be written without flattening, e.g., with |writev()|:
+//
+//   std::vector<struct iovec> iov;
+//   for (StringView chunk : cord.chunks())
+//     iov.push_back({const_cast<char*>(chunk.data()), chunk.size()});
+//
+// Operations that locate a position (|Substr()|) take time linear in the
+// number of chunks. Different |Cord|s may be used on different threads, even if
+// they share buffers, but a single |Cord| is not thread-safe.
+class FTL_EXPORT Cord final {
+  // A nonempty range of a buffer.
+  struct Piece {
+    RefPtr<internal::CordBuffer> buffer;
+    const char* data;
+    size_t size;
+  };
+
+ public:
+  // Iterates over the chunks (as |StringView|s, which are valid until the
+  // |Cord| is modified or destroyed); none is empty.
+  class ChunkIterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = StringView;
+    using difference_type = ptrdiff_t;
+    using pointer = const StringView*;
+    using reference = StringView;
+
+    ChunkIterator() {}
+
+    StringView operator*() const { return StringView(it_->data, it_->size); }
+
+    ChunkIterator& operator++() {
+      ++it_;
+      return *this;
+    }
+    ChunkIterator operator++(int) {
+      ChunkIterator result = *this;
+      ++*this;
+      return result;
+    }
+
+    bool operator==(const ChunkIterator& other) const {
+      return it_ == other.it_;
+    }
+    bool operator!=(const ChunkIterator& other) const {
+      return it_ != other.it_;
+    }
+
+   private:
+    friend class Cord;
+
+    explicit ChunkIterator(std::deque<Piece>::const_iterator it) : it_(it) {}
+
+    std::deque<Piece>::const_iterator it_;
+  };
+
+  // For range-based |for| loops over |chunks()|.
+  class Chunks {
+   public:
+    ChunkIterator begin() const { return begin_; }
+    ChunkIterator end() const { return end_; }
+
+   private:
+    friend class Cord;
+
+    Chunks(ChunkIterator begin, ChunkIterator end) : begin_(begin), end_(end) {}
+
+    ChunkIterator begin_;
+    ChunkIterator end_;
+  };
+
+  Cord();
+  // Copies |string|.
+  explicit Cord(StringView string);
+  Cord(const Cord& other);
+  Cord(Cord&& other);
+  ~Cord();
+
+  Cord& operator=(const Cord& other);
+  Cord& operator=(Cord&& other);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0u; }
+
+  size_t chunk_count() const { return pieces_.size(); }
+  Chunks chunks() const {
+    return Chunks(ChunkIterator(pieces_.begin()), ChunkIterator(pieces_.end()));
+  }
+
+  // These copy |string|.
+  void Append(StringView string);
+  void Prepend(StringView string);
+
+  // These take |string|'s buffer, without copying it.
+  void AppendOwned(std::string&& string);
+  void PrependOwned(std::string&& string);
+
+  // These share |other|'s buffers (|other| may be this |Cord|).
+  void Append(const Cord& other);
+  void Prepend(const Cord& other);
+
+  // Returns the part of this |Cord| starting at |pos| (which must be at most
+  // |size()|) of (at most) |n| characters, sharing its buffers.
+  Cord Substr(size_t pos, size_t n = StringView::npos) const;
+
+  void Clear();
+
+  // Copies the contents to |dest|, which must have room for |size()|
+  // characters.
+  void CopyTo(char* dest) const;
+
+  // Returns the contents, flattened.
+  std::string ToString() const;
+
+ private:
+  // Returns a new buffer holding a copy of |string|, with room for at least
+  // |capacity| characters.
+  static RefPtr<internal::CordBuffer> NewBuffer(StringView string,
+                                                size_t capacity);
+
+  // Tries to append |string| to the last piece's buffer, in place.
+  bool ExtendLastPiece(StringView string);
+
+  void PushBack(Piece piece);
+  void PushFront(Piece piece);
+
+  std::deque<Piece> pieces_;
+  size_t size_ = 0u;
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_CORD_H_
@@ -0,0 +1,204 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/cord.h"
+
+#include <stdlib.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+std::vector<std::string> ChunksOf(const Cord& cord) {
+  std::vector<std::string> result;
+  for (StringView chunk : cord.chunks())
+    result.push_back(chunk.ToString());
+  return result;
+}
+
+TEST(Cord, Empty) {
+  Cord cord;
+  EXPECT_TRUE(cord.empty());
+  EXPECT_EQ(0u, cord.size());
+  EXPECT_EQ(0u, cord.chunk_count());
+  EXPECT_EQ("", cord.ToString());
+  EXPECT_TRUE(cord.chunks().begin() == cord.chunks().end());
+
+  // Empty strings add no chunks.
+  cord.Append(StringView());
+  cord.AppendOwned(std::string());
+  cord.Prepend(StringView(""));
+  cord.Append(Cord());
+  EXPECT_EQ(0u, cord.chunk_count());
+  EXPECT_EQ(0u, Cord(StringView("")).chunk_count());
+}
+
+TEST(Cord, AppendAndPrepend) {
+  Cord cord(StringView("world"));
+  cord.Prepend(StringView("hello "));
+  cord.AppendOwned(std::string("!"));
+  EXPECT_EQ(12u, cord.size());
+  EXPECT_FALSE(cord.empty());
+  EXPECT_EQ("hello world!", cord.ToString());
+
+  char buffer[12];
+  cord.CopyTo(buffer);
+  EXPECT_EQ("hello world!", std::string(buffer, sizeof(buffer)));
+
+  cord.Clear();
+  EXPECT_TRUE(cord.empty());
+  EXPECT_EQ(0u, cord.chunk_count());
+}
+
+// Small appends are coalesced into the last buffer.
+TEST(Cord, SmallAppends) {
+  Cord cord;
+  std::string expected;
+  for (int i = 0; i < 1000; i++) {
+    cord.Append(StringView("abc"));
+    expected += "abc";
+  }
+  EXPECT_EQ(expected, cord.ToString());
+  EXPECT_LT(cord.chunk_count(), 20u);
+}
+
+// Appending a uniquely owned string just takes its buffer.
+TEST(Cord, AdoptString) {
+  std::string big(100000u, 'x');
+  const char* data = big.data();
+  Cord cord;
+  cord.AppendOwned(std::move(big));
+  ASSERT_EQ(1u, cord.chunk_count());
+  EXPECT_EQ(data, (*cord.chunks().begin()).data());
+
+  std::string big2(100000u, 'y');
+  data = big2.data();
+  cord.PrependOwned(std::move(big2));
+  ASSERT_EQ(2u, cord.chunk_count());
+  EXPECT_EQ(data, (*cord.chunks().begin()).data());
+  EXPECT_EQ(200000u, cord.size());
+}
+
+TEST(Cord, AppendCord) {
+  Cord a(StringView("foo"));
+  Cord b;
+  b.AppendOwned(std::string("bar"));
+  a.Append(b);
+  EXPECT_EQ("foobar", a.ToString());
+  EXPECT_EQ(std::vector<std::string>({"foo", "bar"}), ChunksOf(a));
+  a.Prepend(b);
+  EXPECT_EQ("barfoobar", a.ToString());
+  a.Append(a);
+  EXPECT_EQ("barfoobarbarfoobar", a.ToString());
+  a.Prepend(a);
+  EXPECT_EQ(36u, a.size());
+  EXPECT_EQ("barfoobarbarfoobarbarfoobarbarfoobar", a.ToString());
+  EXPECT_EQ("bar", b.ToString());
+}
+
+// A cord that shares its last buffer mustn't append to it in place (since the
+// other cord might too).
+TEST(Cord, SharedBuffers) {
+  Cord a(StringView("foo"));
+  Cord b(a);
+  a.Append(StringView("bar"));
+  b.Append(StringView("baz"));
+  EXPECT_EQ("foobar", a.ToString());
+  EXPECT_EQ("foobaz", b.ToString());
+
+  Cord c = a.Substr(0u, 3u);
+  a.Append(StringView("qux"));
+  c.Append(StringView("!"));
+  EXPECT_EQ("foobarqux", a.ToString());
+  EXPECT_EQ("foo!", c.ToString());
+}
+
+TEST(Cord, CopyAndMove) {
+  Cord a(StringView("foo"));
+  a.AppendOwned(std::string("bar"));
+  Cord b(a);
+  EXPECT_EQ("foobar", b.ToString());
+  Cord c(std::move(a));
+  EXPECT_EQ("foobar", c.ToString());
+  EXPECT_TRUE(a.empty());
+  EXPECT_EQ(0u, a.chunk_count());
+
+  a = c;
+  EXPECT_EQ("foobar", a.ToString());
+  b = std::move(c);
+  EXPECT_EQ("foobar", b.ToString());
+  EXPECT_TRUE(c.empty());
+}
+
+TEST(Cord, Substr) {
+  Cord cord;
+  cord.AppendOwned(std::string("012"));
+  cord.AppendOwned(std::string("3456"));
+  cord.AppendOwned(std::string("789"));
+  std::string expected = "0123456789";
+  for (size_t pos = 0u; pos <= expected.size(); pos++) {
+    for (size_t n = 0u; pos + n <= expected.size() + 1u; n++) {
+      Cord substr = cord.Substr(pos, n);
+      EXPECT_EQ(expected.substr(pos, n), substr.ToString());
+      EXPECT_EQ(std::min(n, expected.size() - pos), substr.size());
+    }
+  }
+  EXPECT_EQ(expected, cord.Substr(0u).ToString());
+  EXPECT_EQ("3456", cord.Substr(3u, 4u).ToString());
+  EXPECT_EQ(1u, cord.Substr(3u, 4u).chunk_count());
+  EXPECT_EQ(std::vector<std::string>({"56", "78"}),
+            ChunksOf(cord.Substr(5u, 4u)));
+  EXPECT_EQ(0u, cord.Substr(10u).chunk_count());
+}
+
+TEST(Cord, Random) {
+  srand(123);
+  for (int trial = 0; trial < 100; trial++) {
+    Cord cord;
+    std::string expected;
+    for (int i = 0; i < 20; i++) {
+      std::string piece(static_cast<size_t>(rand() % 300), 'a' + rand() % 26);
+      switch (rand() % 5) {
+        case 0:
+          cord.Append(StringView(piece));
+          expected += piece;
+          break;
+        case 1:
+          cord.Prepend(StringView(piece));
+          expected = piece + expected;
+          break;
+        case 2:
+          expected += piece;
+          cord.AppendOwned(std::move(piece));
+          break;
+        case 3: {
+          size_t pos = rand() % (expected.size() + 1u);
+          size_t n = rand() % (expected.size() + 1u);
+          cord = cord.Substr(pos, n);
+          expected = expected.substr(pos, n);
+          break;
+        }
+        case 4: {
+          if (expected.size() > 4096u)
+            break;
+          Cord copy = cord;
+          copy.Append(StringView(piece));
+          cord.Prepend(copy);
+          expected = expected + piece + expected;
+          break;
+        }
+      }
+      ASSERT_EQ(expected.size(), cord.size());
+      ASSERT_EQ(expected, cord.ToString());
+    }
+  }
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,169 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/crc32c.h"
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/strings/binary_buffer.h"
+
+#if defined(ARCH_CPU_X86_64) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <nmmintrin.h>
+#define FTL_CRC32C_SSE42 1
+#elif defined(ARCH_CPU_ARM64) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define FTL_CRC32C_ARM 1
+#endif
+
+namespace ftl {
+namespace {
+
+// The (bit-reversed) CRC-32C polynomial.
+constexpr uint32_t kPolynomial = 0x82f63b78u;
+
+// Returns |a| * |b| modulo the polynomial (in the bit-reversed
+// representation, where x^0 is the top bit).
+uint32_t MultiplyModP(uint32_t a, uint32_t b) {
+  uint32_t product = 0u;
+  for (uint32_t bit = 1u << 31; a; bit >>= 1) {
+    if (a & bit) {
+      product ^= b;
+      a ^= bit;
+    }
+    b = (b & 1u) ? (b >> 1) ^ kPolynomial : b >> 1;
+  }
+  return product;
+}
+
+struct Tables {
+  Tables() {
+    for (uint32_t i = 0u; i < 256u; i++) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc & 1u) ? (crc >> 1) ^ kPolynomial : crc >> 1;
+      slices[0][i] = crc;
+    }
+    for (uint32_t i = 0u; i < 256u; i++) {
+      for (size_t slice = 1u; slice < 8u; slice++) {
+        uint32_t previous = slices[slice - 1u][i];
+        slices[slice][i] = (previous >> 8) ^ slices[0][previous & 0xffu];
+      }
+    }
+    powers[0] = 1u << 30;  // x^1.
+    for (size_t i = 1u; i < kPowerCount; i++)
+      powers[i] = MultiplyModP(powers[i - 1u], powers[i - 1u]);
+  }
+
+  // |slices[k][b]| is the CRC of byte |b| followed by |k| zero bytes.
+  uint32_t slices[8][256];
+  // |powers[k]| is x^(2^k) modulo the polynomial (for any 64-bit number of
+  // bytes, i.e., 2^(64 + 3) bits).
+  static constexpr size_t kPowerCount = 67u;
+  uint32_t powers[kPowerCount];
+};
+
+constexpr size_t Tables::kPowerCount;
+
+const Tables& GetTables() {
+  static const Tables* tables = new Tables();
+  return *tables;
+}
+
+// These all take and return the CRC without the initial and final inversion.
+
+uint32_t ExtendPortable(uint32_t crc, const uint8_t* p, size_t size) {
+  const Tables& tables = GetTables();
+  const auto& t = tables.slices;
+  for (; size >= 8u; p += 8, size -= 8u) {
+    uint32_t low = LoadLittleEndian<uint32_t>(p) ^ crc;
+    uint32_t high = LoadLittleEndian<uint32_t>(p + 4);
+    crc = t[7][low & 0xffu] ^ t[6][(low >> 8) & 0xffu] ^
+          t[5][(low >> 16) & 0xffu] ^ t[4][low >> 24] ^ t[3][high & 0xffu] ^
+          t[2][(high >> 8) & 0xffu] ^ t[1][(high >> 16) & 0xffu] ^
+          t[0][high >> 24];
+  }
+  for (; size; p++, size--)
+    crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xffu];
+  return crc;
+}
+
+#if defined(FTL_CRC32C_SSE42)
+
+bool HasCrcInstructions() {
+  static const bool has_sse42 = [] {
+    unsigned eax = 0u, ebx = 0u, ecx = 0u, edx = 0u;
+    return __get_cpuid(1u, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2);
+  }();
+  return has_sse42;
+}
+
+__attribute__((target("sse4.2"))) uint32_t ExtendHardware(uint32_t crc,
+                                                          const uint8_t* p,
+                                                          size_t size) {
+  uint64_t crc64 = crc;
+  for (; size >= 8u; p += 8, size -= 8u)
+    crc64 = _mm_crc32_u64(crc64, LoadLittleEndian<uint64_t>(p));
+  crc = static_cast<uint32_t>(crc64);
+  for (; size; p++, size--)
+    crc = _mm_crc32_u8(crc, *p);
+  return crc;
+}
+
+#elif defined(FTL_CRC32C_ARM)
+
+bool HasCrcInstructions() {
+  return true;
+}
+
+uint32_t ExtendHardware(uint32_t crc, const uint8_t* p, size_t size) {
+  for (; size >= 8u; p += 8, size -= 8u)
+    crc = __crc32cd(crc, LoadLittleEndian<uint64_t>(p));
+  for (; size; p++, size--)
+    crc = __crc32cb(crc, *p);
+  return crc;
+}
+
+#else
+
+bool HasCrcInstructions() {
+  return false;
+}
+
+uint32_t ExtendHardware(uint32_t crc, const uint8_t* p, size_t size) {
+  return ExtendPortable(crc, p, size);
+}
+
+#endif
+
+}  // namespace
+
+uint32_t Crc32c(const void* data, size_t size) {
+  return Crc32cExtend(0u, data, size);
+}
+
+uint32_t Crc32cExtend(uint32_t crc, const void* data, size_t size) {
+  const uint8_t* p = static_cast<const uint8_t*>(data);
+  crc = ~crc;
+  crc = HasCrcInstructions() ? ExtendHardware(crc, p, size)
+                             : ExtendPortable(crc, p, size);
+  return ~crc;
+}
+
+uint32_t Crc32cCombine(uint32_t crc1, uint32_t crc2, uint64_t size2) {
+  // Appending |size2| bytes multiplies the first CRC by x^(8 * |size2|) (the
+  // inversions cancel out), so multiply by x^(2^k) for each bit k of it.
+  const Tables& tables = GetTables();
+  uint32_t shift = 1u << 31;  // x^0.
+  for (size_t k = 3u; size2; size2 >>= 1, k++) {
+    if (size2 & 1u)
+      shift = MultiplyModP(tables.powers[k], shift);
+  }
+  return MultiplyModP(shift, crc1) ^ crc2;
+}
+
+bool Crc32cIsHardwareAccelerated() {
+  return HasCrcInstructions();
+}
+
+}  // namespace ftl
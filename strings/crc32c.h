@@ -0,0 +1,50 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// CRC-32C (Castagnoli) checksums, e.g., for detecting corrupted files or
+// records. (See |files::ChecksumFile()| to checksum a whole file.)
+
+#ifndef LIB_FTL_STRINGS_CRC32C_H_
+#define LIB_FTL_STRINGS_CRC32C_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// Returns the CRC-32C of the |size| bytes at |data|.
+//
+// This uses the CPU's CRC-32C instructions where they're available (SSE4.2 on
+// x86-64, checked at run time, or ARMv8's CRC extension, if the compiler
+// targets it), and otherwise a slicing-by-8 table lookup.
+FTL_EXPORT uint32_t Crc32c(const void* data, size_t size);
+inline uint32_t Crc32c(StringView data) {
+  return Crc32c(data.data(), data.size());
+}
+
+// Returns the CRC-32C of the data whose CRC-32C is |crc| followed by the
+// |size| bytes at |data|, to checksum data which arrives in pieces, e.g.:
+//
+//   uint32_t crc = 0u;
+//   while (ReadBlock(&block))
+//     crc = Crc32cExtend(crc, block.data(), block.size());
+//
+// (The CRC-32C of no data is 0.)
+FTL_EXPORT uint32_t Crc32cExtend(uint32_t crc, const void* data, size_t size);
+
+// Returns the CRC-32C of the concatenation of two pieces of data, given their
+// CRC-32Cs (|crc1| and |crc2|) and the second's size, without the data, e.g.,
+// to combine the checksums of chunks checksummed in parallel. This takes time
+// logarithmic in |size2|.
+FTL_EXPORT uint32_t Crc32cCombine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+
+// Whether |Crc32c()| uses CRC instructions (rather than tables).
+FTL_EXPORT bool Crc32cIsHardwareAccelerated();
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_CRC32C_H_
@@ -0,0 +1,81 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/crc32c.h"
+
+#include <stdint.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+// A bit-at-a-time CRC-32C, to check against.
+uint32_t ReferenceCrc32c(StringView data) {
+  uint32_t crc = ~0u;
+  for (char c : data) {
+    crc ^= static_cast<uint8_t>(c);
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc & 1u) ? (crc >> 1) ^ 0x82f63b78u : crc >> 1;
+  }
+  return ~crc;
+}
+
+std::string TestData(size_t size) {
+  std::string data(size, '\0');
+  uint32_t state = 12345u;
+  for (char& c : data) {
+    state = state * 1103515245u + 12345u;
+    c = static_cast<char>(state >> 24);
+  }
+  return data;
+}
+
+// From RFC 3720, appendix B.4.
+TEST(Crc32c, TestVectors) {
+  EXPECT_EQ(0u, Crc32c(StringView()));
+  EXPECT_EQ(0xe3069283u, Crc32c("123456789"));
+  EXPECT_EQ(0x8a9136aau, Crc32c(std::string(32u, '\0')));
+  EXPECT_EQ(0x62a8ab43u, Crc32c(std::string(32u, '\xff')));
+  std::string ascending;
+  for (int i = 0; i < 32; i++)
+    ascending += static_cast<char>(i);
+  EXPECT_EQ(0x46dd794eu, Crc32c(ascending));
+}
+
+TEST(Crc32c, MatchesReference) {
+  // (Including unaligned starts, and sizes which aren't multiples of 8.)
+  std::string data = TestData(1000u);
+  for (size_t offset = 0u; offset < 9u; offset++) {
+    for (size_t size : {0u, 1u, 7u, 8u, 9u, 63u, 64u, 65u, 991u}) {
+      StringView piece = StringView(data).substr(offset, size);
+      EXPECT_EQ(ReferenceCrc32c(piece), Crc32c(piece)) << offset << " "
+                                                       << size;
+    }
+  }
+}
+
+TEST(Crc32c, ExtendAndCombine) {
+  std::string data = TestData(5000u);
+  uint32_t expected = Crc32c(data);
+  for (size_t split : {0u, 1u, 13u, 4096u, 4999u, 5000u}) {
+    StringView first = StringView(data).substr(0u, split);
+    StringView second = StringView(data).substr(split);
+    EXPECT_EQ(expected,
+              Crc32cExtend(Crc32c(first), second.data(), second.size()))
+        << split;
+    EXPECT_EQ(expected,
+              Crc32cCombine(Crc32c(first), Crc32c(second), second.size()))
+        << split;
+  }
+
+  // Combining with a huge run of zeros shouldn't take long.
+  EXPECT_NE(Crc32cCombine(1u, 0u, UINT64_C(1) << 40),
+            Crc32cCombine(1u, 0u, (UINT64_C(1) << 40) + 1u));
+}
+
+}  // namespace
+}  // namespace ftl
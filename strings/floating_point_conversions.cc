@@ -0,0 +1,878 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/floating_point_conversions.h"
+
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <limits>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/floating_point_tables.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+// The layouts of |float| and |double| (IEEE 754 binary32 and binary64).
+template <typename FloatType>
+struct FloatTraits;
+
+template <>
+struct FloatTraits<double> {
+  using Bits = uint64_t;
+  static constexpr int kMantissaBits = 52;
+  static constexpr int kExponentBits = 11;
+  static constexpr int kBias = 1023;
+  // The range of decimal exponents which parsing can see, below which a value
+  // (with at most 19 significant digits) is zero and above which it's
+  // infinite.
+  static constexpr int kMinPowerOfTen = -342;
+  static constexpr int kMaxPowerOfTen = 308;
+  // The largest power of ten which is exactly representable.
+  static constexpr int kMaxExactPowerOfTen = 22;
+  // The range of decimal exponents for which an exact tie is possible.
+  static constexpr int kMinRoundToEvenPowerOfTen = -4;
+  static constexpr int kMaxRoundToEvenPowerOfTen = 23;
+};
+
+template <>
+struct FloatTraits<float> {
+  using Bits = uint32_t;
+  static constexpr int kMantissaBits = 23;
+  static constexpr int kExponentBits = 8;
+  static constexpr int kBias = 127;
+  static constexpr int kMinPowerOfTen = -65;
+  static constexpr int kMaxPowerOfTen = 38;
+  static constexpr int kMaxExactPowerOfTen = 10;
+  static constexpr int kMinRoundToEvenPowerOfTen = -17;
+  static constexpr int kMaxRoundToEvenPowerOfTen = 10;
+};
+
+template <typename FloatType>
+typename FloatTraits<FloatType>::Bits ToBits(FloatType value) {
+  typename FloatTraits<FloatType>::Bits bits;
+  static_assert(sizeof(bits) == sizeof(value), "unexpected float size");
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+template <typename FloatType>
+FloatType FromBits(typename FloatTraits<FloatType>::Bits bits) {
+  FloatType value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+struct UInt128 {
+  uint64_t high;
+  uint64_t low;
+};
+
+UInt128 Multiply(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+  return {static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product)};
+#else
+  uint64_t a_low = a & 0xffffffffu;
+  uint64_t a_high = a >> 32;
+  uint64_t b_low = b & 0xffffffffu;
+  uint64_t b_high = b >> 32;
+  uint64_t low_low = a_low * b_low;
+  uint64_t high_low = a_high * b_low;
+  uint64_t low_high = a_low * b_high;
+  uint64_t cross = (low_low >> 32) + (high_low & 0xffffffffu) + low_high;
+  return {a_high * b_high + (high_low >> 32) + (cross >> 32),
+          (cross << 32) | (low_low & 0xffffffffu)};
+#endif
+}
+
+int CountLeadingZeros(uint64_t value) {
+  FTL_DCHECK(value);
+  return __builtin_clzll(value);
+}
+
+// Formatting ------------------------------------------------------------------
+//
+// This is Ryu (Ulf Adams, "Ryu: fast float-to-string conversion", PLDI 2018):
+// it finds the shortest decimal in the interval of reals that round to the
+// value, using 128-bit approximations of powers of five which are exact enough
+// that no bignums are needed. (|float|s use the same code and tables as
+// |double|s, which are more than precise enough for their shorter mantissas.)
+
+// The shortest decimal is |digits| * 10^|exponent|.
+struct Decimal {
+  uint64_t digits;
+  int exponent;
+};
+
+// ceil(log2(5^e)), or 1 for e = 0 (i.e., the bit length of 5^e), for e in [0,
+// 3528].
+int Pow5Bits(int e) {
+  return static_cast<int>((static_cast<uint32_t>(e) * 1217359u) >> 19) + 1;
+}
+
+// floor(log10(2^e)), for e in [0, 1650].
+int Log10Pow2(int e) {
+  return static_cast<int>((static_cast<uint32_t>(e) * 78913u) >> 18);
+}
+
+// floor(log10(5^e)), for e in [0, 2620].
+int Log10Pow5(int e) {
+  return static_cast<int>((static_cast<uint32_t>(e) * 732923u) >> 20);
+}
+
+bool IsMultipleOfPowerOf5(uint64_t value, int p) {
+  int count = 0;
+  for (; value && value % 5u == 0u; value /= 5u)
+    count++;
+  return count >= p;
+}
+
+bool IsMultipleOfPowerOf2(uint64_t value, int p) {
+  FTL_DCHECK(p < 64);
+  return !(value & ((uint64_t{1} << p) - 1u));
+}
+
+// Returns floor(|m| * |multiplier| / 2^|shift|), for a 128-bit |multiplier|
+// (as {high, low}).
+uint64_t MultiplyShift(uint64_t m, const uint64_t* multiplier, int shift) {
+  UInt128 low = Multiply(m, multiplier[1]);
+  UInt128 high = Multiply(m, multiplier[0]);
+  uint64_t sum_low = high.low + low.high;
+  uint64_t sum_high = high.high + (sum_low < low.high);
+  shift -= 64;
+  FTL_DCHECK(shift > 0 && shift < 64);
+  return (sum_high << (64 - shift)) | (sum_low >> shift);
+}
+
+template <typename FloatType>
+Decimal ShortestDecimal(typename FloatTraits<FloatType>::Bits bits) {
+  using Traits = FloatTraits<FloatType>;
+  const uint64_t ieee_mantissa =
+      bits & ((uint64_t{1} << Traits::kMantissaBits) - 1u);
+  const int ieee_exponent = static_cast<int>(
+      (bits >> Traits::kMantissaBits) & ((1u << Traits::kExponentBits) - 1u));
+
+  // The value is |m2| * 2^|e2|, less 2 for the bounds' extra bits below.
+  int e2;
+  uint64_t m2;
+  if (!ieee_exponent) {
+    e2 = 1 - Traits::kBias - Traits::kMantissaBits - 2;
+    m2 = ieee_mantissa;
+  } else {
+    e2 = ieee_exponent - Traits::kBias - Traits::kMantissaBits - 2;
+    m2 = (uint64_t{1} << Traits::kMantissaBits) | ieee_mantissa;
+  }
+  // With round-to-even parsing, the bounds are included for even mantissas.
+  const bool accept_bounds = !(m2 & 1u);
+
+  // The value and its bounds (halfway to its neighbours) are |mv|, |mv + 2|,
+  // and |mv - 1 - mm_shift|, times 2^|e2|. (The lower neighbour is closer at
+  // powers of two.)
+  const uint64_t mv = 4u * m2;
+  const uint32_t mm_shift = ieee_mantissa || ieee_exponent <= 1;
+
+  // Convert them to decimal, |vr|, |vp|, and |vm| times 10^|e10|, keeping
+  // track of whether they were exact (i.e., of whether the digits dropped
+  // were all zero).
+  uint64_t vr, vp, vm;
+  int e10;
+  bool vm_is_trailing_zeros = false;
+  bool vr_is_trailing_zeros = false;
+  if (e2 >= 0) {
+    const int q = Log10Pow2(e2) - (e2 > 3);
+    e10 = q;
+    const int k = 125 + Pow5Bits(q) - 1;
+    const int i = -e2 + q + k;
+    FTL_DCHECK(static_cast<size_t>(q) < kPow5InverseSplitSize);
+    const uint64_t* multiplier = kPow5InverseSplit[q];
+    vr = MultiplyShift(4u * m2, multiplier, i);
+    vp = MultiplyShift(4u * m2 + 2u, multiplier, i);
+    vm = MultiplyShift(4u * m2 - 1u - mm_shift, multiplier, i);
+    if (q <= 21) {
+      // At most one of them can be a multiple of 5.
+      if (mv % 5u == 0u)
+        vr_is_trailing_zeros = IsMultipleOfPowerOf5(mv, q);
+      else if (accept_bounds)
+        vm_is_trailing_zeros = IsMultipleOfPowerOf5(mv - 1u - mm_shift, q);
+      else
+        vp -= IsMultipleOfPowerOf5(mv + 2u, q);
+    }
+  } else {
+    const int q = Log10Pow5(-e2) - (-e2 > 1);
+    e10 = q + e2;
+    const int i = -e2 - q;
+    const int k = Pow5Bits(i) - 125;
+    const int j = q - k;
+    FTL_DCHECK(static_cast<size_t>(i) < kPow5SplitSize);
+    const uint64_t* multiplier = kPow5Split[i];
+    vr = MultiplyShift(4u * m2, multiplier, j);
+    vp = MultiplyShift(4u * m2 + 2u, multiplier, j);
+    vm = MultiplyShift(4u * m2 - 1u - mm_shift, multiplier, j);
+    if (q <= 1) {
+      // |mv| has at least q trailing zero bits, so all are exact.
+      vr_is_trailing_zeros = true;
+      if (accept_bounds)
+        vm_is_trailing_zeros = mm_shift == 1u;
+      else
+        vp--;
+    } else if (q < 63) {
+      vr_is_trailing_zeros = IsMultipleOfPowerOf2(mv, q);
+    }
+  }
+
+  // Drop digits while the bounds still differ, rounding |vr|.
+  int removed = 0;
+  uint64_t output;
+  if (vm_is_trailing_zeros || vr_is_trailing_zeros) {
+    // The general case, which is rare.
+    uint32_t last_removed_digit = 0u;
+    while (vp / 10u > vm / 10u) {
+      vm_is_trailing_zeros &= vm % 10u == 0u;
+      vr_is_trailing_zeros &= last_removed_digit == 0u;
+      last_removed_digit = static_cast<uint32_t>(vr % 10u);
+      vr /= 10u;
+      vp /= 10u;
+      vm /= 10u;
+      removed++;
+    }
+    if (vm_is_trailing_zeros) {
+      while (vm % 10u == 0u) {
+        vr_is_trailing_zeros &= last_removed_digit == 0u;
+        last_removed_digit = static_cast<uint32_t>(vr % 10u);
+        vr /= 10u;
+        vp /= 10u;
+        vm /= 10u;
+        removed++;
+      }
+    }
+    // Round ties (exactly ...50...0) to even.
+    if (vr_is_trailing_zeros && last_removed_digit == 5u && vr % 2u == 0u)
+      last_removed_digit = 4u;
+    output = vr + ((vr == vm && (!accept_bounds || !vm_is_trailing_zeros)) ||
+                   last_removed_digit >= 5u);
+  } else {
+    // The common case, in which there are no ties and the lower bound is
+    // excluded.
+    bool round_up = false;
+    if (vp / 100u > vm / 100u) {
+      round_up = vr % 100u >= 50u;
+      vr /= 100u;
+      vp /= 100u;
+      vm /= 100u;
+      removed += 2;
+    }
+    while (vp / 10u > vm / 10u) {
+      round_up = vr % 10u >= 5u;
+      vr /= 10u;
+      vp /= 10u;
+      vm /= 10u;
+      removed++;
+    }
+    output = vr + (vr == vm || round_up);
+  }
+  return {output, e10 + removed};
+}
+
+// Writes |decimal| like JavaScript's |Number.prototype.toString()|: in plain
+// notation if its decimal point is at most 21 digits after its first digit,
+// or at most 6 before it, and in exponential notation (e.g., "1e+21" or
+// "1.5e-7") otherwise.
+size_t FormatDecimal(Decimal decimal, char* buffer) {
+  FTL_DCHECK(decimal.digits);
+  while (decimal.digits % 10u == 0u) {
+    decimal.digits /= 10u;
+    decimal.exponent++;
+  }
+
+  char digits[20];
+  int digit_count = 0;
+  for (uint64_t rest = decimal.digits; rest; rest /= 10u)
+    digits[sizeof(digits) - 1 - digit_count++] = '0' + rest % 10u;
+  const char* first_digit = digits + sizeof(digits) - digit_count;
+  // The position of the decimal point, relative to the first digit.
+  const int point = digit_count + decimal.exponent;
+
+  char* out = buffer;
+  if (digit_count <= point && point <= 21) {
+    memcpy(out, first_digit, digit_count);
+    out += digit_count;
+    memset(out, '0', point - digit_count);
+    out += point - digit_count;
+  } else if (0 < point && point <= 21) {
+    memcpy(out, first_digit, point);
+    out += point;
+    *out++ = '.';
+    memcpy(out, first_digit + point, digit_count - point);
+    out += digit_count - point;
+  } else if (-6 < point && point <= 0) {
+    *out++ = '0';
+    *out++ = '.';
+    memset(out, '0', -point);
+    out += -point;
+    memcpy(out, first_digit, digit_count);
+    out += digit_count;
+  } else {
+    *out++ = first_digit[0];
+    if (digit_count > 1) {
+      *out++ = '.';
+      memcpy(out, first_digit + 1, digit_count - 1);
+      out += digit_count - 1;
+    }
+    *out++ = 'e';
+    int exponent = point - 1;
+    *out++ = exponent < 0 ? '-' : '+';
+    if (exponent < 0)
+      exponent = -exponent;
+    if (exponent >= 100)
+      *out++ = static_cast<char>('0' + exponent / 100);
+    if (exponent >= 10)
+      *out++ = static_cast<char>('0' + exponent / 10 % 10);
+    *out++ = static_cast<char>('0' + exponent % 10);
+  }
+  return static_cast<size_t>(out - buffer);
+}
+
+template <typename FloatType>
+size_t FormatShortestImpl(FloatType value, char* buffer) {
+  using Traits = FloatTraits<FloatType>;
+  using Bits = typename Traits::Bits;
+  FTL_DCHECK(buffer);
+
+  const Bits bits = ToBits(value);
+  const Bits exponent_mask = ((Bits{1} << Traits::kExponentBits) - 1u)
+                             << Traits::kMantissaBits;
+  const Bits mantissa_mask = (Bits{1} << Traits::kMantissaBits) - 1u;
+  if ((bits & exponent_mask) == exponent_mask && (bits & mantissa_mask)) {
+    memcpy(buffer, "nan", 3u);
+    return 3u;
+  }
+
+  char* out = buffer;
+  if (bits >> (Traits::kMantissaBits + Traits::kExponentBits))
+    *out++ = '-';
+  if ((bits & exponent_mask) == exponent_mask) {
+    memcpy(out, "inf", 3u);
+    out += 3;
+  } else if (!(bits & (exponent_mask | mantissa_mask))) {
+    *out++ = '0';
+  } else {
+    out += FormatDecimal(ShortestDecimal<FloatType>(bits), out);
+  }
+  FTL_DCHECK(static_cast<size_t>(out - buffer) <= kMaxFloatingPointLength);
+  return static_cast<size_t>(out - buffer);
+}
+
+// Parsing ---------------------------------------------------------------------
+//
+// Most numbers are parsed exactly with native arithmetic (Clinger's fast
+// path) or with the Eisel-Lemire algorithm (Daniel Lemire, "Number Parsing at
+// a Gigabyte per Second", 2021), which uses the truncated powers of five in
+// |kPow5Truncated128| and detects when they don't suffice; the rest (e.g.,
+// long inputs very close to a tie) are parsed exactly with bignums.
+
+// A decimal number, as parsed.
+struct DecimalString {
+  bool negative = false;
+  // Its first (up to) 19 significant digits, and the power of ten to scale
+  // them by.
+  uint64_t mantissa = 0u;
+  int64_t exponent = 0;
+  // Whether there were more significant digits (which weren't all zero).
+  bool truncated = false;
+  // All the (integer and fractional) digits, including any leading zeros, and
+  // the power of ten to scale them by.
+  StringView digits;
+  int64_t digits_exponent = 0;
+};
+
+constexpr int kMaxMantissaDigits = 19;
+// Exponents are only accumulated up to this (since larger ones, which are
+// nonetheless valid, only matter in that they're large).
+constexpr int64_t kMaxExplicitExponent = 1000000;
+
+bool IsDigit(char c) {
+  return static_cast<unsigned char>(c) - static_cast<unsigned>('0') < 10u;
+}
+
+// Parses |string| as [-]digits[.digits][(e|E)[+|-]digits] (with at least one
+// digit before the exponent).
+bool ParseDecimalString(StringView string, DecimalString* result) {
+  const char* s = string.data();
+  const char* const end = s + string.size();
+  if (s != end && *s == '-') {
+    result->negative = true;
+    s++;
+  }
+
+  const char* const digits_start = s;
+  int significant_digits = 0;
+  bool any_digits = false;
+  bool after_point = false;
+  for (; s != end; s++) {
+    if (*s == '.') {
+      if (after_point)
+        return false;
+      after_point = true;
+      continue;
+    }
+    if (!IsDigit(*s))
+      break;
+    any_digits = true;
+    const unsigned digit = static_cast<unsigned>(*s - '0');
+    if (after_point)
+      result->digits_exponent--;
+    if (!significant_digits && !digit) {
+      // A leading zero.
+      if (after_point)
+        result->exponent--;
+      continue;
+    }
+    if (significant_digits < kMaxMantissaDigits) {
+      result->mantissa = result->mantissa * 10u + digit;
+      if (after_point)
+        result->exponent--;
+    } else {
+      result->truncated |= digit != 0u;
+      if (!after_point)
+        result->exponent++;
+    }
+    significant_digits++;
+  }
+  if (!any_digits)
+    return false;
+  result->digits = StringView(digits_start, s - digits_start);
+
+  if (s != end && (*s == 'e' || *s == 'E')) {
+    s++;
+    bool exponent_negative = false;
+    if (s != end && (*s == '+' || *s == '-')) {
+      exponent_negative = *s == '-';
+      s++;
+    }
+    if (s == end)
+      return false;
+    int64_t exponent = 0;
+    for (; s != end && IsDigit(*s); s++) {
+      if (exponent < kMaxExplicitExponent)
+        exponent = exponent * 10 + (*s - '0');
+    }
+    if (exponent_negative)
+      exponent = -exponent;
+    result->exponent += exponent;
+    result->digits_exponent += exponent;
+  }
+  return s == end;
+}
+
+// A binary floating-point number, as its (biased) exponent and mantissa
+// fields. An exponent of -1 means that it couldn't be computed.
+struct BinaryFloat {
+  int exponent;
+  uint64_t mantissa;
+
+  bool operator==(const BinaryFloat& other) const {
+    return exponent == other.exponent && mantissa == other.mantissa;
+  }
+  bool operator!=(const BinaryFloat& other) const { return !(*this == other); }
+};
+
+template <typename FloatType>
+FloatType ToFloat(bool negative, BinaryFloat binary) {
+  using Traits = FloatTraits<FloatType>;
+  using Bits = typename Traits::Bits;
+  Bits bits = static_cast<Bits>(binary.mantissa) |
+              (static_cast<Bits>(binary.exponent) << Traits::kMantissaBits);
+  if (negative)
+    bits |= Bits{1} << (Traits::kMantissaBits + Traits::kExponentBits);
+  return FromBits<FloatType>(bits);
+}
+
+template <typename FloatType>
+constexpr int InfiniteExponent() {
+  return (1 << FloatTraits<FloatType>::kExponentBits) - 1;
+}
+
+const double kExactPowersOfTen[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Clinger's fast path: if the mantissa and the power of ten are exactly
+// representable, then one (correctly rounded) operation gives the result.
+// (This needs arithmetic in the type's own precision.)
+template <typename FloatType>
+bool ParseFastPath(const DecimalString& decimal, FloatType* value) {
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+  using Traits = FloatTraits<FloatType>;
+  if (decimal.truncated ||
+      decimal.mantissa > (uint64_t{1} << (Traits::kMantissaBits + 1)) ||
+      decimal.exponent < -Traits::kMaxExactPowerOfTen ||
+      decimal.exponent > Traits::kMaxExactPowerOfTen)
+    return false;
+  FloatType result = static_cast<FloatType>(decimal.mantissa);
+  const FloatType power = static_cast<FloatType>(
+      kExactPowersOfTen[decimal.exponent < 0 ? -decimal.exponent
+                                             : decimal.exponent]);
+  if (decimal.exponent < 0)
+    result /= power;
+  else
+    result *= power;
+  *value = decimal.negative ? -result : result;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Eisel-Lemire: computes |w| * 10^|q| from its product with a truncated power
+// of five, or returns an exponent of -1 if that's not precise enough.
+template <typename FloatType>
+BinaryFloat ComputeFloat(int64_t q, uint64_t w) {
+  using Traits = FloatTraits<FloatType>;
+  constexpr int kMantissaBits = Traits::kMantissaBits;
+  if (!w || q < Traits::kMinPowerOfTen)
+    return {0, 0u};
+  if (q > Traits::kMaxPowerOfTen)
+    return {InfiniteExponent<FloatType>(), 0u};
+
+  const int leading_zeros = CountLeadingZeros(w);
+  w <<= leading_zeros;
+
+  // Multiply by the power of five, using its low half only if the bits which
+  // matter (the mantissa, and the ones for rounding) may be affected.
+  const uint64_t* power = kPow5Truncated128[q - kPow5Truncated128MinQ];
+  UInt128 product = Multiply(w, power[0]);
+  constexpr uint64_t kPrecisionMask =
+      std::numeric_limits<uint64_t>::max() >> (kMantissaBits + 3);
+  if ((product.high & kPrecisionMask) == kPrecisionMask) {
+    UInt128 low_product = Multiply(w, power[1]);
+    product.low += low_product.high;
+    if (low_product.high > product.low)
+      product.high++;
+  }
+  if (product.low == std::numeric_limits<uint64_t>::max() &&
+      (q < -27 || q > 55))
+    return {-1, 0u};
+
+  const int upper_bit = static_cast<int>(product.high >> 63);
+  const int shift = upper_bit + 64 - kMantissaBits - 3;
+  uint64_t mantissa = product.high >> shift;
+  // floor(log2(10^q)) + 63, plus the bias, less the normalization.
+  int exponent = static_cast<int>(((152170 + 65536) * q) >> 16) + 63 +
+                 upper_bit - leading_zeros + Traits::kBias;
+
+  if (exponent <= 0) {
+    // Subnormal (unless it rounds up to the smallest normal).
+    if (-exponent + 1 >= 64)
+      return {0, 0u};
+    mantissa >>= -exponent + 1;
+    mantissa += mantissa & 1u;
+    mantissa >>= 1;
+    exponent = mantissa < (uint64_t{1} << kMantissaBits) ? 0 : 1;
+    return {exponent, mantissa & ((uint64_t{1} << kMantissaBits) - 1u)};
+  }
+
+  // For an exact tie, round to even rather than up.
+  if (product.low <= 1u && q >= Traits::kMinRoundToEvenPowerOfTen &&
+      q <= Traits::kMaxRoundToEvenPowerOfTen && (mantissa & 3u) == 1u &&
+      (mantissa << shift) == product.high)
+    mantissa &= ~uint64_t{1};
+  mantissa += mantissa & 1u;
+  mantissa >>= 1;
+  if (mantissa >= (uint64_t{2} << kMantissaBits)) {
+    mantissa = uint64_t{1} << kMantissaBits;
+    exponent++;
+  }
+  mantissa &= ~(uint64_t{1} << kMantissaBits);
+  if (exponent >= InfiniteExponent<FloatType>())
+    return {InfiniteExponent<FloatType>(), 0u};
+  return {exponent, mantissa};
+}
+
+// An unsigned integer of up to |kMaxWords| 32-bit words, for the slow path.
+class BigNumber {
+ public:
+  // Enough for 10^1200 shifted left by 200 bits, roughly.
+  static constexpr size_t kMaxWords = 140u;
+
+  BigNumber() : size_(0u) {}
+
+  bool IsZero() const { return !size_; }
+
+  size_t BitLength() const {
+    if (!size_)
+      return 0u;
+    return 32u * size_ - __builtin_clz(words_[size_ - 1u]);
+  }
+
+  void MultiplyAdd(uint32_t multiplier, uint32_t addend) {
+    uint64_t carry = addend;
+    for (size_t i = 0u; i < size_; i++) {
+      uint64_t product = static_cast<uint64_t>(words_[i]) * multiplier + carry;
+      words_[i] = static_cast<uint32_t>(product);
+      carry = product >> 32;
+    }
+    if (carry)
+      Push(static_cast<uint32_t>(carry));
+  }
+
+  void MultiplyByPowerOfTen(int64_t power) {
+    for (; power >= 9; power -= 9)
+      MultiplyAdd(1000000000u, 0u);
+    static const uint32_t kSmallPowers[] = {1u,      10u,      100u,
+                                            1000u,   10000u,   100000u,
+                                            1000000u, 10000000u, 100000000u};
+    if (power > 0)
+      MultiplyAdd(kSmallPowers[power], 0u);
+  }
+
+  void ShiftLeft(size_t bits) {
+    if (!size_ || !bits)
+      return;
+    const size_t words = bits / 32u;
+    const unsigned shift = bits % 32u;
+    FTL_CHECK(size_ + words + 1u <= kMaxWords);
+    if (shift) {
+      words_[size_] = 0u;
+      for (size_t i = size_; i > 0u; i--)
+        words_[i] = (words_[i] << shift) | (words_[i - 1u] >> (32u - shift));
+      words_[0] <<= shift;
+      size_++;
+    }
+    if (words) {
+      memmove(words_ + words, words_, size_ * sizeof(words_[0]));
+      memset(words_, 0, words * sizeof(words_[0]));
+      size_ += words;
+    }
+    Trim();
+  }
+
+  void ShiftRightOne() {
+    for (size_t i = 0u; i + 1u < size_; i++)
+      words_[i] = (words_[i] >> 1) | (words_[i + 1u] << 31);
+    if (size_)
+      words_[size_ - 1u] >>= 1;
+    Trim();
+  }
+
+  int Compare(const BigNumber& other) const {
+    if (size_ != other.size_)
+      return size_ < other.size_ ? -1 : 1;
+    for (size_t i = size_; i > 0u; i--) {
+      if (words_[i - 1u] != other.words_[i - 1u])
+        return words_[i - 1u] < other.words_[i - 1u] ? -1 : 1;
+    }
+    return 0;
+  }
+
+  // Requires |other| <= |*this|.
+  void Subtract(const BigNumber& other) {
+    FTL_DCHECK(Compare(other) >= 0);
+    int64_t borrow = 0;
+    for (size_t i = 0u; i < size_; i++) {
+      int64_t difference = static_cast<int64_t>(words_[i]) - borrow -
+                           (i < other.size_ ? other.words_[i] : 0u);
+      borrow = difference < 0;
+      words_[i] = static_cast<uint32_t>(difference);
+    }
+    Trim();
+  }
+
+ private:
+  void Push(uint32_t word) {
+    FTL_CHECK(size_ < kMaxWords);
+    words_[size_++] = word;
+  }
+
+  void Trim() {
+    while (size_ && !words_[size_ - 1u])
+      size_--;
+  }
+
+  size_t size_;
+  uint32_t words_[kMaxWords];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BigNumber);
+};
+
+// At most this many significant digits are needed to decide the rounding;
+// any more only matter in whether they're all zero.
+constexpr int kMaxSlowPathDigits = 800;
+
+// The slow path: computes the digits exactly as a 64-bit quotient (of the
+// digits, times a power of two, by a power of ten) and a remainder, and rounds
+// that.
+template <typename FloatType>
+BinaryFloat ComputeFloatSlowly(const DecimalString& decimal) {
+  using Traits = FloatTraits<FloatType>;
+  constexpr int kMantissaBits = Traits::kMantissaBits;
+
+  // Take the significant digits (with a 1 appended if any are dropped, which
+  // doesn't change the rounding).
+  BigNumber numerator;
+  int64_t exponent = decimal.digits_exponent;
+  int digit_count = 0;
+  bool dropped_nonzero = false;
+  for (char c : decimal.digits) {
+    if (c == '.')
+      continue;
+    if (digit_count == kMaxSlowPathDigits) {
+      dropped_nonzero |= c != '0';
+      exponent++;
+      continue;
+    }
+    if (digit_count || c != '0') {
+      numerator.MultiplyAdd(10u, static_cast<uint32_t>(c - '0'));
+      digit_count++;
+    }
+  }
+  if (dropped_nonzero) {
+    numerator.MultiplyAdd(10u, 1u);
+    exponent--;
+  }
+  if (numerator.IsZero())
+    return {0, 0u};
+  // The value is at least 10^(|digit_count| + |exponent| - 1), and less than
+  // 10^(|digit_count| + |exponent|).
+  if (digit_count + exponent - 1 > Traits::kMaxPowerOfTen)
+    return {InfiniteExponent<FloatType>(), 0u};
+  if (digit_count + exponent < Traits::kMinPowerOfTen)
+    return {0, 0u};
+
+  BigNumber denominator;
+  denominator.MultiplyAdd(0u, 1u);
+  if (exponent >= 0)
+    numerator.MultiplyByPowerOfTen(exponent);
+  else
+    denominator.MultiplyByPowerOfTen(-exponent);
+
+  // Scale so that the quotient is in [2^63, 2^64): the value is then
+  // (quotient + remainder / denominator) * 2^-|scale|.
+  int scale = 63 - (static_cast<int>(numerator.BitLength()) -
+                    static_cast<int>(denominator.BitLength()));
+  if (scale >= 0)
+    numerator.ShiftLeft(scale);
+  else
+    denominator.ShiftLeft(-scale);
+  denominator.ShiftLeft(63u);
+  if (numerator.Compare(denominator) < 0) {
+    numerator.ShiftLeft(1u);
+    scale++;
+  }
+  uint64_t quotient = 0u;
+  for (int bit = 63; bit >= 0; bit--) {
+    if (numerator.Compare(denominator) >= 0) {
+      numerator.Subtract(denominator);
+      quotient |= uint64_t{1} << bit;
+    }
+    denominator.ShiftRightOne();
+  }
+  FTL_DCHECK(quotient >> 63);
+  const bool sticky = !numerator.IsZero();
+
+  // Round to the mantissa's bits (fewer, if subnormal).
+  int biased_exponent = 63 - scale + Traits::kBias;
+  int drop = 63 - kMantissaBits;
+  if (biased_exponent <= 0) {
+    drop += 1 - biased_exponent;
+    biased_exponent = 0;
+  }
+  uint64_t mantissa;
+  bool round_up;
+  if (drop >= 65) {
+    mantissa = 0u;
+    round_up = false;
+  } else if (drop == 64) {
+    mantissa = 0u;
+    const uint64_t half = uint64_t{1} << 63;
+    round_up = quotient > half || (quotient == half && sticky);
+  } else {
+    mantissa = quotient >> drop;
+    const uint64_t rest = quotient & ((uint64_t{1} << drop) - 1u);
+    const uint64_t half = uint64_t{1} << (drop - 1);
+    round_up = rest > half || (rest == half && (sticky || (mantissa & 1u)));
+  }
+  if (round_up)
+    mantissa++;
+
+  if (!biased_exponent) {
+    // Subnormal, or just rounded up to the smallest normal (whose exponent
+    // field is exactly the carry into the hidden bit).
+    return {static_cast<int>(mantissa >> kMantissaBits),
+            mantissa & ((uint64_t{1} << kMantissaBits) - 1u)};
+  }
+  if (mantissa >> (kMantissaBits + 1)) {
+    mantissa >>= 1;
+    biased_exponent++;
+  }
+  if (biased_exponent >= InfiniteExponent<FloatType>())
+    return {InfiniteExponent<FloatType>(), 0u};
+  return {biased_exponent, mantissa & ((uint64_t{1} << kMantissaBits) - 1u)};
+}
+
+template <typename FloatType>
+bool ParseFloatingPointImpl(StringView string, FloatType* value) {
+  FTL_DCHECK(value);
+
+  StringView rest = string;
+  const bool negative = !rest.empty() && rest[0] == '-';
+  if (negative)
+    rest.remove_prefix(1u);
+  if (rest == "inf" || rest == "infinity") {
+    *value = negative ? -std::numeric_limits<FloatType>::infinity()
+                      : std::numeric_limits<FloatType>::infinity();
+    return true;
+  }
+  if (rest == "nan") {
+    *value = negative ? -std::numeric_limits<FloatType>::quiet_NaN()
+                      : std::numeric_limits<FloatType>::quiet_NaN();
+    return true;
+  }
+
+  DecimalString decimal;
+  if (!ParseDecimalString(string, &decimal))
+    return false;
+  if (ParseFastPath(decimal, value))
+    return true;
+
+  BinaryFloat binary = ComputeFloat<FloatType>(decimal.exponent,
+                                               decimal.mantissa);
+  if (decimal.truncated && binary.exponent >= 0 &&
+      binary != ComputeFloat<FloatType>(decimal.exponent,
+                                        decimal.mantissa + 1u))
+    binary.exponent = -1;
+  if (binary.exponent < 0)
+    binary = ComputeFloatSlowly<FloatType>(decimal);
+
+  if (binary.exponent == InfiniteExponent<FloatType>())
+    return false;
+  *value = ToFloat<FloatType>(decimal.negative, binary);
+  return true;
+}
+
+}  // namespace
+
+size_t FormatShortest(double value, char* buffer) {
+  return FormatShortestImpl(value, buffer);
+}
+
+size_t FormatShortest(float value, char* buffer) {
+  return FormatShortestImpl(value, buffer);
+}
+
+bool ParseFloatingPoint(StringView string, double* value) {
+  return ParseFloatingPointImpl(string, value);
+}
+
+bool ParseFloatingPoint(StringView string, float* value) {
+  return ParseFloatingPointImpl(string, value);
+}
+
+}  // namespace internal
+}  // namespace ftl
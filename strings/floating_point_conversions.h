@@ -0,0 +1,38 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Conversions between floating-point numbers and decimal strings, for
+// string_number_conversions.h.
+
+#ifndef LIB_FTL_STRINGS_FLOATING_POINT_CONVERSIONS_H_
+#define LIB_FTL_STRINGS_FLOATING_POINT_CONVERSIONS_H_
+
+#include <stddef.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace internal {
+
+// The most characters that |FormatShortest()| writes (e.g., for
+// "-0.0000022250738585072014").
+constexpr size_t kMaxFloatingPointLength = 25u;
+
+// Writes (without a terminating null) the shortest decimal representation of
+// |value| that |ParseFloatingPoint()| converts back to exactly |value|, and
+// returns its length. See |NumberToString()|.
+FTL_EXPORT size_t FormatShortest(double value, char* buffer);
+FTL_EXPORT size_t FormatShortest(float value, char* buffer);
+
+// Converts |string| to the nearest |double| (or |float|), rounding ties to
+// even. On error, or if the result is out of range, returns false. See
+// |StringToNumberWithError()|.
+FTL_EXPORT bool ParseFloatingPoint(StringView string, double* value);
+FTL_EXPORT bool ParseFloatingPoint(StringView string, float* value);
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_FLOATING_POINT_CONVERSIONS_H_
@@ -0,0 +1,38 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Tables of 128-bit approximations of powers of five, for converting between
+// floating-point numbers and decimal (see floating_point_conversions.cc). Each
+// entry is {high 64 bits, low 64 bits}.
+
+#ifndef LIB_FTL_STRINGS_FLOATING_POINT_TABLES_H_
+#define LIB_FTL_STRINGS_FLOATING_POINT_TABLES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ftl {
+namespace internal {
+
+// For formatting (Ryu): |kPow5InverseSplit[q]| is floor(2^k / 5^q) + 1 and
+// |kPow5Split[i]| is 5^i shifted to 125 bits (rounded down), where k is the
+// bit length of 5^q plus 124.
+constexpr size_t kPow5InverseSplitSize = 292u;
+constexpr size_t kPow5SplitSize = 326u;
+extern const uint64_t kPow5InverseSplit[kPow5InverseSplitSize][2];
+extern const uint64_t kPow5Split[kPow5SplitSize][2];
+
+// For parsing (Eisel-Lemire): |kPow5Truncated128[q - kPow5Truncated128MinQ]|
+// is 5^q, for q in [-342, 308], scaled by a power of two to have its top bit
+// set, and truncated to 128 bits (for negative q, after adding one to the
+// quotient 2^k / 5^-q).
+constexpr int kPow5Truncated128MinQ = -342;
+constexpr int kPow5Truncated128MaxQ = 308;
+constexpr size_t kPow5Truncated128Size = 651u;
+extern const uint64_t kPow5Truncated128[kPow5Truncated128Size][2];
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_FLOATING_POINT_TABLES_H_
@@ -0,0 +1,106 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/format.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+// Calls |output(piece)| for each piece of the result of formatting
+// |arguments| into |format|, in order.
+template <typename Output>
+void ForEachPiece(StringView format,
+                  const FormatArgument* arguments,
+                  size_t argument_count,
+                  bool check,
+                  Output output) {
+  const FormatArgument* next_argument = arguments;
+  const FormatArgument* const arguments_end = arguments + argument_count;
+  size_t literal_start = 0u;
+  for (size_t i = 0u; i < format.size(); i++) {
+    const char c = format[i];
+    if (c != '{' && c != '}')
+      continue;
+    output(format.substr(literal_start, i - literal_start));
+    literal_start = i + 1u;
+    if (i + 1u < format.size() && format[i + 1u] == c) {
+      // An escaped brace: output the second.
+      i++;
+      continue;
+    }
+    if (c == '{' && i + 1u < format.size() && format[i + 1u] == '}') {
+      i++;
+      literal_start = i + 1u;
+      if (next_argument == arguments_end) {
+        FTL_DCHECK(!check) << "Too few arguments for \"" << format << "\"";
+        continue;
+      }
+      output(next_argument->string());
+      next_argument++;
+      continue;
+    }
+    // A stray brace: output it.
+    FTL_DCHECK(!check) << "Unmatched '" << c << "' in \"" << format << "\"";
+    literal_start = i;
+  }
+  output(format.substr(literal_start));
+  FTL_DCHECK(!check || next_argument == arguments_end)
+      << "Too many arguments for \"" << format << "\"";
+}
+
+}  // namespace
+
+FormatArgument::FormatArgument(const void* pointer) {
+  buffer_[0] = '0';
+  buffer_[1] = 'x';
+  size_ = 2u +
+          NumberToBuffer(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(
+                             pointer)),
+                         buffer_ + 2, Base::k16);
+}
+
+FormatArgument::FormatArgument(Hex hex) {
+  FTL_DCHECK(hex.width <= 16u);
+  const size_t width = std::min(hex.width, size_t{16u});
+  char digits[kNumberToBufferSize];
+  const size_t digit_count = NumberToBuffer(hex.value, digits, Base::k16);
+  const size_t padding = width > digit_count ? width - digit_count : 0u;
+  memset(buffer_, '0', padding);
+  memcpy(buffer_ + padding, digits, digit_count);
+  size_ = padding + digit_count;
+}
+
+void FormatAppend(std::string* dest,
+                  StringView format,
+                  std::initializer_list<FormatArgument> arguments) {
+  FormatAppend(dest, format, arguments.begin(), arguments.size());
+}
+
+void FormatAppend(std::string* dest,
+                  StringView format,
+                  const FormatArgument* arguments,
+                  size_t argument_count) {
+  FTL_DCHECK(dest);
+
+  size_t size = 0u;
+  ForEachPiece(format, arguments, argument_count, true,
+               [&size](StringView piece) { size += piece.size(); });
+  // (Keep growing geometrically, in case this is called repeatedly.)
+  if (dest->size() + size > dest->capacity())
+    dest->reserve(std::max(dest->size() + size, 2u * dest->capacity()));
+  ForEachPiece(format, arguments, argument_count, false,
+               [dest](StringView piece) {
+                 dest->append(piece.data(), piece.size());
+               });
+}
+
+}  // namespace internal
+}  // namespace ftl
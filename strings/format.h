@@ -0,0 +1,138 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Type-safe string formatting, with "{}" placeholders which are replaced by
+// the arguments in order, e.g.:
+//
+//   std::string message =
+//       Format("{}: read {} of {} bytes", path, bytes_read, file_size);
+//
+// ("{{" and "}}" are literal braces.) Each argument is formatted according to
+// its type, so (unlike with |StringPrintf()|) the arguments and the format
+// can't mismatch:
+//  - strings (|StringView|s, |std::string|s, or C strings) and |char|s are
+//    copied;
+//  - |bool|s are "true" or "false";
+//  - integers are in decimal, and floating-point numbers are as from
+//    |NumberToString()| (i.e., the shortest representation that round trips);
+//  - other pointers are in hexadecimal, e.g., "0x7F0A2C";
+//  - |Hex|es are in hexadecimal.
+// Having more or fewer placeholders than arguments is a |FTL_DCHECK()| failure.
+// The output's size is computed before it's written, so these don't use
+// intermediate buffers, and allocate at most once.
+
+#ifndef LIB_FTL_STRINGS_FORMAT_H_
+#define LIB_FTL_STRINGS_FORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+
+#include "lib/ftl/compiler_specific.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+template <size_t N>
+class InlineString;
+
+// An integer to format in hexadecimal (without a prefix), zero-padded to at
+// least |width| (at most 16) digits, e.g., |Hex(255, 4)| is "00FF". Negative
+// numbers are formatted as their two's complement.
+struct Hex {
+  template <typename T,
+            typename =
+                typename std::enable_if<std::is_integral<T>::value>::type>
+  explicit Hex(T value, size_t width = 0u)
+      : value(static_cast<typename std::make_unsigned<T>::type>(value)),
+        width(width) {}
+
+  uint64_t value;
+  size_t width;
+};
+
+namespace internal {
+
+// An argument, converted to a string (in its own buffer, if necessary). (This
+// is also used by |StrCat()|.)
+class FTL_EXPORT FormatArgument {
+ public:
+  FormatArgument(StringView string) : string_(string) {}
+  FormatArgument(const std::string& string) : string_(string) {}
+  template <size_t N>
+  FormatArgument(const InlineString<N>& string) : string_(string.view()) {}
+  FormatArgument(const char* string)
+      : string_(string ? StringView(string) : StringView("(null)")) {}
+  FormatArgument(char c) : size_(1u) { buffer_[0] = c; }
+  FormatArgument(bool b) : string_(b ? "true" : "false") {}
+  FormatArgument(float number) : size_(NumberToBuffer(number, buffer_)) {}
+  FormatArgument(double number) : size_(NumberToBuffer(number, buffer_)) {}
+  FormatArgument(const void* pointer);
+  FormatArgument(Hex hex);
+
+  // Other integers are formatted as 64-bit ones (since only the (u)intN_t
+  // types are supported by |NumberToBuffer()|).
+  template <typename T,
+            typename = typename std::enable_if<std::is_integral<T>::value &&
+                                               std::is_signed<T>::value>::type>
+  FormatArgument(T number)
+      : size_(NumberToBuffer(static_cast<int64_t>(number), buffer_)) {}
+  template <typename T,
+            typename = typename std::enable_if<std::is_integral<T>::value &&
+                                               !std::is_signed<T>::value>::type,
+            typename = void>
+  FormatArgument(T number)
+      : size_(NumberToBuffer(static_cast<uint64_t>(number), buffer_)) {}
+
+  // (This is copyable, since |string()| points into |buffer_| only while it's
+  // in use.)
+  StringView string() const {
+    return size_ ? StringView(buffer_, size_) : string_;
+  }
+
+ private:
+  // Either |string_| or the first |size_| characters of |buffer_| (which has
+  // room for a "0x" prefix).
+  StringView string_;
+  size_t size_ = 0u;
+  char buffer_[2u + kNumberToBufferSize];
+};
+
+FTL_EXPORT void FormatAppend(std::string* dest,
+                             StringView format,
+                             std::initializer_list<FormatArgument> arguments);
+// (For a number of arguments only known at run time.)
+FTL_EXPORT void FormatAppend(std::string* dest,
+                             StringView format,
+                             const FormatArgument* arguments,
+                             size_t argument_count);
+
+}  // namespace internal
+
+// Formats |args| into |format| (as above), and returns the result.
+template <typename... Args>
+std::string Format(StringView format,
+                   const Args&... args) FTL_WARN_UNUSED_RESULT;
+
+template <typename... Args>
+std::string Format(StringView format, const Args&... args) {
+  std::string result;
+  internal::FormatAppend(&result, format, {args...});
+  return result;
+}
+
+// Formats |args| into |format| (as above), and appends the result to |*dest|.
+template <typename... Args>
+void FormatAppend(std::string* dest, StringView format, const Args&... args) {
+  internal::FormatAppend(dest, format, {args...});
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_FORMAT_H_
@@ -0,0 +1,99 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/format.h"
+
+#include <stdint.h>
+
+#include <limits>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+namespace {
+
+TEST(FormatTest, Basic) {
+  EXPECT_EQ("", Format(""));
+  EXPECT_EQ("no placeholders", Format("no placeholders"));
+  EXPECT_EQ("42", Format("{}", 42));
+  EXPECT_EQ("a1b2c", Format("a{}b{}c", 1, 2));
+  EXPECT_EQ("{} {literal}", Format("{{}} {{literal}}"));
+  EXPECT_EQ("{42}", Format("{{{}}}", 42));
+}
+
+TEST(FormatTest, Types) {
+  std::string string = "string";
+  EXPECT_EQ("string view c-string string",
+            Format("{} {} {}", StringView("string view"), "c-string", string));
+  const char* null_string = nullptr;
+  EXPECT_EQ("(null)", Format("{}", null_string));
+  EXPECT_EQ("x true false", Format("{} {} {}", 'x', true, false));
+
+  EXPECT_EQ("-128 255 -32768 65535",
+            Format("{} {} {} {}", static_cast<int8_t>(-128),
+                   static_cast<uint8_t>(255), static_cast<int16_t>(-32768),
+                   static_cast<uint16_t>(65535)));
+  EXPECT_EQ("-9223372036854775808 18446744073709551615",
+            Format("{} {}", std::numeric_limits<long long>::min(),
+                   std::numeric_limits<unsigned long long>::max()));
+  EXPECT_EQ("123 456", Format("{} {}", 123u, static_cast<size_t>(456u)));
+
+  EXPECT_EQ("0.1 2.5 1e+21 -0", Format("{} {} {} {}", 0.1, 2.5f, 1e21, -0.0));
+
+  EXPECT_EQ("0x0", Format("{}", static_cast<const void*>(nullptr)));
+  int* pointer = reinterpret_cast<int*>(0xABC123);
+  EXPECT_EQ("0xABC123", Format("{}", pointer));
+
+  // Strings may contain nulls.
+  EXPECT_EQ(std::string("a\0b", 3u), Format("{}", std::string("a\0b", 3u)));
+}
+
+TEST(FormatTest, Hex) {
+  EXPECT_EQ("0 FF 00ff", Format("{} {} 00{}", Hex(0), Hex(255u), "ff"));
+  EXPECT_EQ("0000CAFE FFFF", Format("{} {}", Hex(0xcafe, 8),
+                                   Hex(static_cast<int16_t>(-1))));
+  EXPECT_EQ("FFFFFFFFFFFFFFFF",
+            Format("{}", Hex(std::numeric_limits<uint64_t>::max(), 16)));
+  // The width is a minimum.
+  EXPECT_EQ("12345", Format("{}", Hex(0x12345, 2)));
+}
+
+TEST(FormatTest, FormatAppend) {
+  std::string result = "start";
+  FormatAppend(&result, " {}", 1);
+  FormatAppend(&result, " {} {}", "two", 3.0);
+  EXPECT_EQ("start 1 two 3", result);
+
+  // Also check that long outputs (and many appends) are fine.
+  result.clear();
+  std::string expected;
+  std::string long_string(5000, 'x');
+  for (int i = 0; i < 100; i++) {
+    FormatAppend(&result, "{}:{};", i, long_string);
+    expected += std::to_string(i) + ":" + long_string + ";";
+  }
+  EXPECT_EQ(expected, result);
+}
+
+#ifndef NDEBUG
+TEST(FormatTest, Mismatches) {
+  EXPECT_DEATH_IF_SUPPORTED(
+      { std::string result = Format("{} {}", 1); }, "Too few");
+  EXPECT_DEATH_IF_SUPPORTED(
+      { std::string result = Format("{}", 1, 2); }, "Too many");
+  EXPECT_DEATH_IF_SUPPORTED({ std::string result = Format("{", 1); },
+                            "Unmatched");
+}
+#else
+TEST(FormatTest, Mismatches) {
+  EXPECT_EQ("1 ", Format("{} {}", 1));
+  EXPECT_EQ("1", Format("{}", 1, 2));
+  EXPECT_EQ("{ }", Format("{ }", 1));
+}
+#endif
+
+}  // namespace
+}  // namespace ftl
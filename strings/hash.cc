@@ -0,0 +1,171 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/hash.h"
+
+#include <string.h>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/random/rand.h"
+
+namespace ftl {
+namespace {
+
+// Loads little-endian words (so that the hashes don't depend on the CPU).
+uint64_t Load64(const char* src) {
+  uint64_t value;
+  memcpy(&value, src, sizeof(value));
+#if !defined(ARCH_CPU_LITTLE_ENDIAN)
+  value = __builtin_bswap64(value);
+#endif
+  return value;
+}
+
+uint64_t Load32(const char* src) {
+  uint32_t value;
+  memcpy(&value, src, sizeof(value));
+#if !defined(ARCH_CPU_LITTLE_ENDIAN)
+  value = __builtin_bswap32(value);
+#endif
+  return value;
+}
+
+uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// Multiplies |*a| and |*b|, leaving the low and high halves of the product in
+// them.
+void Multiply128(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = static_cast<unsigned __int128>(*a) * *b;
+  *a = static_cast<uint64_t>(product);
+  *b = static_cast<uint64_t>(product >> 64);
+#else
+  uint64_t a_high = *a >> 32, a_low = static_cast<uint32_t>(*a);
+  uint64_t b_high = *b >> 32, b_low = static_cast<uint32_t>(*b);
+  uint64_t high_high = a_high * b_high, high_low = a_high * b_low;
+  uint64_t low_high = a_low * b_high, low_low = a_low * b_low;
+  uint64_t middle =
+      high_low + (low_low >> 32) + static_cast<uint32_t>(low_high);
+  *a = (middle << 32) | static_cast<uint32_t>(low_low);
+  *b = high_high + (middle >> 32) + (low_high >> 32);
+#endif
+}
+
+// Mixes |a| and |b| (by multiplying them, and folding the product).
+uint64_t Mix(uint64_t a, uint64_t b) {
+  Multiply128(&a, &b);
+  return a ^ b;
+}
+
+// (wyhash's default secret.)
+constexpr uint64_t kSecret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)};
+
+// One round of SipHash.
+void SipRound(uint64_t* v) {
+  v[0] += v[1];
+  v[1] = RotateLeft(v[1], 13) ^ v[0];
+  v[0] = RotateLeft(v[0], 32);
+  v[2] += v[3];
+  v[3] = RotateLeft(v[3], 16) ^ v[2];
+  v[0] += v[3];
+  v[3] = RotateLeft(v[3], 21) ^ v[0];
+  v[2] += v[1];
+  v[1] = RotateLeft(v[1], 17) ^ v[2];
+  v[2] = RotateLeft(v[2], 32);
+}
+
+}  // namespace
+
+uint64_t HashString(StringView str, uint64_t seed) {
+  const char* p = str.data();
+  const size_t size = str.size();
+  seed ^= Mix(seed ^ kSecret[0], kSecret[1]);
+
+  uint64_t a;
+  uint64_t b;
+  if (size <= 16u) {
+    if (size >= 4u) {
+      // Two (possibly overlapping) pairs of 32-bit words cover the bytes.
+      const size_t offset = (size >> 3) << 2;
+      a = (Load32(p) << 32) | Load32(p + offset);
+      b = (Load32(p + size - 4u) << 32) | Load32(p + size - 4u - offset);
+    } else if (size > 0u) {
+      a = (static_cast<uint64_t>(static_cast<uint8_t>(p[0])) << 16) |
+          (static_cast<uint64_t>(static_cast<uint8_t>(p[size >> 1])) << 8) |
+          static_cast<uint8_t>(p[size - 1u]);
+      b = 0u;
+    } else {
+      a = 0u;
+      b = 0u;
+    }
+  } else {
+    size_t remaining = size;
+    if (remaining > 48u) {
+      // Three independent lanes, for instruction-level parallelism.
+      uint64_t seed1 = seed;
+      uint64_t seed2 = seed;
+      do {
+        seed = Mix(Load64(p) ^ kSecret[1], Load64(p + 8) ^ seed);
+        seed1 = Mix(Load64(p + 16) ^ kSecret[2], Load64(p + 24) ^ seed1);
+        seed2 = Mix(Load64(p + 32) ^ kSecret[3], Load64(p + 40) ^ seed2);
+        p += 48;
+        remaining -= 48u;
+      } while (remaining > 48u);
+      seed ^= seed1 ^ seed2;
+    }
+    for (; remaining > 16u; remaining -= 16u, p += 16)
+      seed = Mix(Load64(p) ^ kSecret[1], Load64(p + 8) ^ seed);
+    // The last 16 bytes (which may overlap the previous ones).
+    a = Load64(p + remaining - 16u);
+    b = Load64(p + remaining - 8u);
+  }
+  a ^= kSecret[1];
+  b ^= seed;
+  Multiply128(&a, &b);
+  return Mix(a ^ kSecret[0] ^ size, b ^ kSecret[1]);
+}
+
+HashKey RandomHashKey() {
+  HashKey key;
+  key.k0 = RandUint64();
+  key.k1 = RandUint64();
+  return key;
+}
+
+uint64_t KeyedHashString(StringView str, const HashKey& key) {
+  uint64_t v[4] = {key.k0 ^ UINT64_C(0x736f6d6570736575),
+                   key.k1 ^ UINT64_C(0x646f72616e646f6d),
+                   key.k0 ^ UINT64_C(0x6c7967656e657261),
+                   key.k1 ^ UINT64_C(0x7465646279746573)};
+  const char* p = str.data();
+  const size_t size = str.size();
+  const char* end = p + (size & ~size_t{7});
+  for (; p != end; p += 8) {
+    uint64_t m = Load64(p);
+    v[3] ^= m;
+    SipRound(v);
+    SipRound(v);
+    v[0] ^= m;
+  }
+
+  // The last 0 to 7 bytes, and the size's low byte.
+  uint64_t m = static_cast<uint64_t>(size) << 56;
+  for (size_t i = 0u; i < (size & 7u); i++)
+    m |= static_cast<uint64_t>(static_cast<uint8_t>(p[i])) << (8u * i);
+  v[3] ^= m;
+  SipRound(v);
+  SipRound(v);
+  v[0] ^= m;
+
+  v[2] ^= 0xffu;
+  for (int i = 0; i < 4; i++)
+    SipRound(v);
+  return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+}  // namespace ftl
@@ -0,0 +1,63 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Hash functions for strings (and other bytes). For hash tables of strings,
+// |std::hash<StringView>| (see string_view.h) uses |HashString()|, e.g.:
+//
+//   std::unordered_map<StringView, Value> values;
+//
+// For tables keyed by untrusted input, use |KeyedStringHash| (which is a
+// little slower) instead, e.g.:
+//
+//   std::unordered_map<std::string, Value, KeyedStringHash> values;
+
+#ifndef LIB_FTL_STRINGS_HASH_H_
+#define LIB_FTL_STRINGS_HASH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// Returns a fast, well-mixed (but not cryptographic) 64-bit hash of |str| with
+// the given |seed|. This is the same in every process, but may change between
+// versions of this library, so don't persist it. (Its design is wyhash's:
+// 16 bytes are mixed at a time by a 64x64->128-bit multiplication.)
+FTL_EXPORT uint64_t HashString(StringView str, uint64_t seed = 0u);
+
+// A secret key for |KeyedHashString()|.
+struct HashKey {
+  uint64_t k0 = 0u;
+  uint64_t k1 = 0u;
+};
+
+// Returns a random |HashKey| (see |RandBytes()|).
+FTL_EXPORT HashKey RandomHashKey();
+
+// Returns the SipHash-2-4 of |str| with |key|: without |key|, it's infeasible
+// to find (many) strings with the same hash, so this resists "hash flooding"
+// of hash tables keyed by untrusted input.
+FTL_EXPORT uint64_t KeyedHashString(StringView str, const HashKey& key);
+
+// A hash function object using |KeyedHashString()|, with a random key per
+// object (i.e., per hash table).
+class FTL_EXPORT KeyedStringHash {
+ public:
+  KeyedStringHash() : key_(RandomHashKey()) {}
+  explicit KeyedStringHash(const HashKey& key) : key_(key) {}
+
+  size_t operator()(StringView str) const {
+    return static_cast<size_t>(KeyedHashString(str, key_));
+  }
+
+ private:
+  HashKey key_;
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_HASH_H_
@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/hash.h"
+
+#include <stdlib.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+int CountBits(uint64_t value) {
+  return __builtin_popcountll(value);
+}
+
+TEST(Hash, HashString) {
+  EXPECT_EQ(HashString("hello"), HashString(std::string("hello")));
+  EXPECT_NE(HashString("hello"), HashString("hellp"));
+  EXPECT_NE(HashString("hello"), HashString("hello", 1u));
+  EXPECT_NE(HashString(""), HashString(StringView("\0", 1u)));
+
+  // All the prefixes (of every length, for each way of loading the bytes) of a
+  // string, and the strings with one byte changed, have different hashes.
+  std::string str;
+  for (int i = 0; i < 200; i++)
+    str += static_cast<char>('a' + i % 26);
+  std::set<uint64_t> hashes;
+  size_t count = 0u;
+  for (size_t size = 0u; size <= str.size(); size++) {
+    std::string prefix = str.substr(0u, size);
+    hashes.insert(HashString(prefix));
+    count++;
+    for (size_t i = 0u; i < size; i++) {
+      std::string changed = prefix;
+      changed[i] ^= 1;
+      hashes.insert(HashString(changed));
+      count++;
+    }
+  }
+  EXPECT_EQ(count, hashes.size());
+}
+
+TEST(Hash, HashStringAvalanche) {
+  // Flipping any input bit should flip each output bit with probability 1/2.
+  srand(46);
+  for (size_t size : {1u, 3u, 4u, 8u, 15u, 16u, 17u, 48u, 49u, 100u}) {
+    int flipped_bits = 0;
+    int trials = 0;
+    for (int i = 0; i < 20; i++) {
+      std::string str;
+      for (size_t j = 0u; j < size; j++)
+        str += static_cast<char>(rand());
+      uint64_t hash = HashString(str);
+      for (size_t bit = 0u; bit < 8u * size; bit++) {
+        std::string changed = str;
+        changed[bit / 8u] ^= static_cast<char>(1 << (bit % 8u));
+        flipped_bits += CountBits(hash ^ HashString(changed));
+        trials++;
+      }
+    }
+    double average = static_cast<double>(flipped_bits) / trials;
+    EXPECT_GT(average, 31.0) << size;
+    EXPECT_LT(average, 33.0) << size;
+  }
+}
+
+TEST(Hash, KeyedHashString) {
+  // The test vectors from the SipHash paper.
+  HashKey key;
+  key.k0 = UINT64_C(0x0706050403020100);
+  key.k1 = UINT64_C(0x0f0e0d0c0b0a0908);
+  EXPECT_EQ(UINT64_C(0x726fdb47dd0e0e31), KeyedHashString("", key));
+  EXPECT_EQ(UINT64_C(0xa129ca6149be45e5),
+            KeyedHashString(StringView("\x00\x01\x02\x03\x04\x05\x06\x07"
+                                       "\x08\x09\x0a\x0b\x0c\x0d\x0e",
+                                       15u),
+                            key));
+
+  HashKey other_key = key;
+  other_key.k1++;
+  EXPECT_NE(KeyedHashString("hello", key), KeyedHashString("hello", other_key));
+}
+
+TEST(Hash, KeyedStringHash) {
+  HashKey key = RandomHashKey();
+  EXPECT_EQ(KeyedStringHash(key)("hello"), KeyedStringHash(key)("hello"));
+  EXPECT_EQ(KeyedHashString("hello", key), KeyedStringHash(key)("hello"));
+  // (This fails with probability 2^-64.)
+  EXPECT_NE(KeyedStringHash()("hello"), KeyedStringHash()("hello"));
+
+  std::unordered_map<std::string, int, KeyedStringHash> map;
+  map["one"] = 1;
+  map["two"] = 2;
+  EXPECT_EQ(2, map["two"]);
+}
+
+TEST(Hash, StdHashStringView) {
+  EXPECT_EQ(static_cast<size_t>(HashString("hello")),
+            std::hash<StringView>()("hello"));
+
+  // Look up views into a buffer without copying them.
+  std::string buffer = "key1=a key2=b";
+  std::unordered_map<StringView, StringView> map;
+  map[StringView(buffer.data(), 4u)] = StringView(buffer.data() + 5u, 1u);
+  map[StringView(buffer.data() + 7u, 4u)] = StringView(buffer.data() + 12u, 1u);
+  EXPECT_EQ("a", map[StringView("key1")]);
+  EXPECT_EQ("b", map[StringView("key2")]);
+  EXPECT_EQ(2u, map.size());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,201 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/hex.h"
+
+#include "lib/ftl/logging.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FTL_HEX_VECTORS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTL_HEX_VECTORS
+#endif
+
+namespace ftl {
+namespace {
+
+const char kLowerDigits[] = "0123456789abcdef";
+const char kUpperDigits[] = "0123456789ABCDEF";
+
+// Returns the value of the hex digit |c|, or -1 if it isn't one.
+int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+#if defined(FTL_HEX_VECTORS)
+
+// Bytes are encoded and decoded 16 (and 32 hex digits) at a time: each nibble
+// is converted to a digit by adding '0', and then the distance from '9' + 1 to
+// 'a' (or 'A') if it's over 9; digits are converted back (and validated) the
+// same way.
+#if defined(__SSE2__)
+
+void EncodeBlock(const uint8_t* src, char* dest, char letter_offset) {
+  __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  const __m128i low_bits = _mm_set1_epi8(0x0f);
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i offset = _mm_set1_epi8(letter_offset);
+  __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_bits);
+  __m128i low = _mm_and_si128(bytes, low_bits);
+  high = _mm_add_epi8(_mm_add_epi8(high, zero),
+                      _mm_and_si128(_mm_cmpgt_epi8(high, nine), offset));
+  low = _mm_add_epi8(_mm_add_epi8(low, zero),
+                     _mm_and_si128(_mm_cmpgt_epi8(low, nine), offset));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest),
+                   _mm_unpacklo_epi8(high, low));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16),
+                   _mm_unpackhi_epi8(high, low));
+}
+
+// Converts 16 hex digits to their values, and sets |*valid| to all ones
+// (bytewise) where they're valid.
+__m128i DecodeDigits(__m128i digits, __m128i* valid) {
+  __m128i digit = _mm_sub_epi8(digits, _mm_set1_epi8('0'));
+  __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+  __m128i letter = _mm_sub_epi8(_mm_or_si128(digits, _mm_set1_epi8(0x20)),
+                                _mm_set1_epi8('a'));
+  __m128i is_letter =
+      _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+  *valid = _mm_or_si128(is_digit, is_letter);
+  return _mm_or_si128(
+      _mm_and_si128(is_digit, digit),
+      _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+// Combines the (high, low) pairs of nibbles in |values| into 8 bytes (in the
+// low byte of each 16-bit lane).
+__m128i CombineNibbles(__m128i values) {
+  return _mm_or_si128(
+      _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 4),
+      _mm_srli_epi16(values, 8));
+}
+
+bool DecodeBlock(const char* src, uint8_t* dest) {
+  __m128i valid0;
+  __m128i valid1;
+  __m128i values0 = DecodeDigits(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)), &valid0);
+  __m128i values1 = DecodeDigits(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16)), &valid1);
+  if (_mm_movemask_epi8(_mm_and_si128(valid0, valid1)) != 0xffff)
+    return false;
+  _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(dest),
+      _mm_packus_epi16(CombineNibbles(values0), CombineNibbles(values1)));
+  return true;
+}
+
+#else  // NEON
+
+uint8x16_t NibblesToDigits(uint8x16_t nibbles, uint8x16_t offset) {
+  return vaddq_u8(vaddq_u8(nibbles, vdupq_n_u8('0')),
+                  vandq_u8(vcgtq_u8(nibbles, vdupq_n_u8(9)), offset));
+}
+
+void EncodeBlock(const uint8_t* src, char* dest, char letter_offset) {
+  uint8x16_t bytes = vld1q_u8(src);
+  uint8x16_t offset = vdupq_n_u8(static_cast<uint8_t>(letter_offset));
+  uint8x16x2_t digits;
+  digits.val[0] = NibblesToDigits(vshrq_n_u8(bytes, 4), offset);
+  digits.val[1] = NibblesToDigits(vandq_u8(bytes, vdupq_n_u8(0x0f)), offset);
+  // This interleaves the high and low digits.
+  vst2q_u8(reinterpret_cast<uint8_t*>(dest), digits);
+}
+
+uint8x16_t DecodeDigits(uint8x16_t digits, uint8x16_t* valid) {
+  uint8x16_t digit = vsubq_u8(digits, vdupq_n_u8('0'));
+  uint8x16_t is_digit = vcltq_u8(digit, vdupq_n_u8(10));
+  uint8x16_t letter =
+      vsubq_u8(vorrq_u8(digits, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+  uint8x16_t is_letter = vcltq_u8(letter, vdupq_n_u8(6));
+  *valid = vorrq_u8(is_digit, is_letter);
+  return vbslq_u8(is_digit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+}
+
+bool DecodeBlock(const char* src, uint8_t* dest) {
+  // This deinterleaves the high and low digits.
+  uint8x16x2_t digits = vld2q_u8(reinterpret_cast<const uint8_t*>(src));
+  uint8x16_t valid0;
+  uint8x16_t valid1;
+  uint8x16_t high = DecodeDigits(digits.val[0], &valid0);
+  uint8x16_t low = DecodeDigits(digits.val[1], &valid1);
+  uint64x2_t valid = vreinterpretq_u64_u8(vandq_u8(valid0, valid1));
+  if ((vgetq_lane_u64(valid, 0) & vgetq_lane_u64(valid, 1)) != ~UINT64_C(0))
+    return false;
+  vst1q_u8(dest, vorrq_u8(vshlq_n_u8(high, 4), low));
+  return true;
+}
+
+#endif  // defined(__SSE2__)
+
+#endif  // defined(FTL_HEX_VECTORS)
+
+}  // namespace
+
+void HexEncode(const void* data, size_t size, char* dest, bool uppercase) {
+  FTL_DCHECK(data || !size);
+  const uint8_t* src = static_cast<const uint8_t*>(data);
+  const char* digits = uppercase ? kUpperDigits : kLowerDigits;
+  size_t i = 0u;
+#if defined(FTL_HEX_VECTORS)
+  const char letter_offset = static_cast<char>(digits[10] - '9' - 1);
+  for (; i + 16u <= size; i += 16u)
+    EncodeBlock(src + i, dest + 2u * i, letter_offset);
+#endif
+  for (; i < size; i++) {
+    dest[2u * i] = digits[src[i] >> 4];
+    dest[2u * i + 1u] = digits[src[i] & 0x0f];
+  }
+}
+
+std::string HexEncode(const void* data, size_t size, bool uppercase) {
+  std::string result(2u * size, '\0');
+  if (size)
+    HexEncode(data, size, &result[0], uppercase);
+  return result;
+}
+
+bool HexDecode(StringView hex, void* dest) {
+  if (hex.size() % 2u)
+    return false;
+  const char* src = hex.data();
+  uint8_t* bytes = static_cast<uint8_t*>(dest);
+  const size_t size = hex.size() / 2u;
+  size_t i = 0u;
+#if defined(FTL_HEX_VECTORS)
+  for (; i + 16u <= size; i += 16u) {
+    if (!DecodeBlock(src + 2u * i, bytes + i))
+      return false;
+  }
+#endif
+  for (; i < size; i++) {
+    int high = HexDigitValue(src[2u * i]);
+    int low = HexDigitValue(src[2u * i + 1u]);
+    if (high < 0 || low < 0)
+      return false;
+    bytes[i] = static_cast<uint8_t>((high << 4) | low);
+  }
+  return true;
+}
+
+bool HexDecode(StringView hex, std::vector<uint8_t>* dest) {
+  FTL_DCHECK(dest);
+  dest->resize(hex.size() / 2u);
+  if (!HexDecode(hex, dest->data())) {
+    dest->clear();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ftl
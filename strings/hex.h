@@ -0,0 +1,40 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Conversions between bytes and hexadecimal strings.
+
+#ifndef LIB_FTL_STRINGS_HEX_H_
+#define LIB_FTL_STRINGS_HEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// Writes the 2 * |size| hex digits (lowercase, or uppercase if |uppercase|) of
+// the |size| bytes at |data| to |dest| (without a terminating null), e.g., for
+// a digest. (Use |NumberToString()| to format numbers.)
+FTL_EXPORT void HexEncode(const void* data,
+                          size_t size,
+                          char* dest,
+                          bool uppercase = false);
+FTL_EXPORT std::string HexEncode(const void* data,
+                                 size_t size,
+                                 bool uppercase = false);
+
+// Writes the |hex.size() / 2| bytes encoded by |hex| (hex digits, of either
+// case) to |dest|. Returns false if |hex| has an odd length or contains a
+// non-hex-digit (in which case the contents of |dest| are unspecified).
+FTL_EXPORT bool HexDecode(StringView hex, void* dest);
+FTL_EXPORT bool HexDecode(StringView hex, std::vector<uint8_t>* dest);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_HEX_H_
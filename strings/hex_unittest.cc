@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/hex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TEST(Hex, Encode) {
+  const uint8_t bytes[] = {0x00, 0x01, 0x7f, 0x80, 0xab, 0xcd, 0xef, 0xff};
+  EXPECT_EQ("", HexEncode(bytes, 0u));
+  EXPECT_EQ("00017f80abcdefff", HexEncode(bytes, sizeof(bytes)));
+  EXPECT_EQ("00017F80ABCDEFFF", HexEncode(bytes, sizeof(bytes), true));
+
+  char buffer[4] = {'x', 'x', 'x', 'x'};
+  HexEncode(bytes + 4, 1u, buffer);
+  EXPECT_EQ("abxx", std::string(buffer, sizeof(buffer)));
+}
+
+TEST(Hex, Decode) {
+  std::vector<uint8_t> bytes;
+  EXPECT_TRUE(HexDecode("", &bytes));
+  EXPECT_TRUE(bytes.empty());
+  EXPECT_TRUE(HexDecode("00017f80AbCdEfFF", &bytes));
+  EXPECT_EQ(std::vector<uint8_t>({0x00, 0x01, 0x7f, 0x80, 0xab, 0xcd, 0xef,
+                                  0xff}),
+            bytes);
+
+  EXPECT_FALSE(HexDecode("0", &bytes));
+  EXPECT_TRUE(bytes.empty());
+  EXPECT_FALSE(HexDecode("0g", &bytes));
+  EXPECT_FALSE(HexDecode("g0", &bytes));
+  EXPECT_FALSE(HexDecode(" 0", &bytes));
+  EXPECT_FALSE(HexDecode("0x00", &bytes));
+  EXPECT_FALSE(HexDecode("@0", &bytes));
+  EXPECT_FALSE(HexDecode("`0", &bytes));
+  EXPECT_FALSE(HexDecode("/0", &bytes));
+  EXPECT_FALSE(HexDecode(":0", &bytes));
+  EXPECT_FALSE(HexDecode("G0", &bytes));
+  EXPECT_FALSE(HexDecode("\xc1" "0", &bytes));
+}
+
+// Compares against |snprintf()| and checks every invalid digit at each
+// position, at lengths that exercise the vectorized blocks and the tails.
+TEST(Hex, Random) {
+  srand(456);
+  for (size_t size = 0u; size < 100u; size++) {
+    std::vector<uint8_t> bytes(size);
+    for (uint8_t& byte : bytes)
+      byte = static_cast<uint8_t>(rand());
+    std::string expected;
+    for (uint8_t byte : bytes) {
+      char digits[3];
+      snprintf(digits, sizeof(digits), "%02x", byte);
+      expected += digits;
+    }
+    std::string hex = HexEncode(bytes.data(), size);
+    EXPECT_EQ(expected, hex);
+
+    std::vector<uint8_t> decoded;
+    EXPECT_TRUE(HexDecode(hex, &decoded));
+    EXPECT_EQ(bytes, decoded);
+
+    if (size) {
+      std::string bad = hex;
+      bad[rand() % bad.size()] = "g/:@`G \xff"[rand() % 8];
+      EXPECT_FALSE(HexDecode(bad, &decoded)) << bad;
+    }
+  }
+
+  for (int c = 0; c < 256; c++) {
+    bool is_digit = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+                    (c >= 'A' && c <= 'F');
+    std::string hex(64u, '0');
+    hex[37] = static_cast<char>(c);
+    std::vector<uint8_t> decoded;
+    EXPECT_EQ(is_digit, HexDecode(hex, &decoded)) << c;
+  }
+}
+
+}  // namespace
+}  // namespace ftl
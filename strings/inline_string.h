@@ -0,0 +1,165 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_STRINGS_INLINE_STRING_H_
+#define LIB_FTL_STRINGS_INLINE_STRING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/format.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// A string of at most |N| characters, stored inline (in the object itself,
+// e.g., on the stack or in a hash table's slot), for strings with a known
+// maximum length which are too long for |std::string|'s small string buffer
+// (15 characters, with libstdc++), e.g., UUIDs, metric names and file
+// basenames. It never allocates, and copying it just copies its characters.
+//
+// It converts implicitly to a |StringView| (so compares, hashes and prints as
+// one), and may be built with |StrAppend()| (and passed to |StrCat()| and
+// |Format()|), e.g.:
+//
+//   InlineString<64> name;
+//   StrAppend(&name, "requests.", method, ".latency");
+//
+// Growing it beyond |N| characters is a |FTL_DCHECK()| failure (and otherwise
+// truncates it). It's always null-terminated (see |c_str()|).
+template <size_t N>
+class InlineString final {
+ public:
+  using size_type = size_t;
+  using iterator = char*;
+  using const_iterator = const char*;
+
+  InlineString() { SetSize(0u); }
+  explicit InlineString(StringView string) { assign(string); }
+  explicit InlineString(const char* string) { assign(StringView(string)); }
+
+  InlineString(const InlineString& other) { assign(other.view()); }
+  InlineString& operator=(const InlineString& other) {
+    assign(other.view());
+    return *this;
+  }
+  InlineString& operator=(StringView string) {
+    assign(string);
+    return *this;
+  }
+
+  void assign(StringView string) {
+    // (|string| may be part of this string.)
+    const size_t size = Clamp(string.size());
+    memmove(data_, string.data(), size);
+    SetSize(size);
+  }
+
+  // The maximum size.
+  static constexpr size_t capacity() { return N; }
+
+  size_t size() const { return size_; }
+  size_t length() const { return size_; }
+  bool empty() const { return size_ == 0u; }
+
+  const char* data() const { return data_; }
+  char* data() { return data_; }
+  const char* c_str() const { return data_; }
+
+  char& operator[](size_t index) {
+    FTL_DCHECK(index < size_);
+    return data_[index];
+  }
+  char operator[](size_t index) const {
+    FTL_DCHECK(index < size_);
+    return data_[index];
+  }
+
+  char* begin() { return data_; }
+  char* end() { return data_ + size_; }
+  const char* begin() const { return data_; }
+  const char* end() const { return data_ + size_; }
+
+  void clear() { SetSize(0u); }
+
+  // Sets the size to |size| (which must be at most |N|), padding with |c|.
+  void resize(size_t size, char c = '\0') {
+    size = Clamp(size);
+    if (size > size_)
+      memset(data_ + size_, c, size - size_);
+    SetSize(size);
+  }
+
+  void push_back(char c) {
+    if (Clamp(size_ + 1u) > size_) {
+      data_[size_] = c;
+      SetSize(size_ + 1u);
+    }
+  }
+
+  InlineString& append(StringView string) {
+    const size_t size = Clamp(size_ + string.size()) - size_;
+    memmove(data_ + size_, string.data(), size);
+    SetSize(size_ + size);
+    return *this;
+  }
+  InlineString& operator+=(StringView string) { return append(string); }
+  InlineString& operator+=(char c) {
+    push_back(c);
+    return *this;
+  }
+
+  StringView view() const { return StringView(data_, size_); }
+  operator StringView() const { return view(); }
+  std::string ToString() const { return std::string(data_, size_); }
+
+ private:
+  // The smallest type which can hold the size.
+  using Size = typename std::conditional<N <= 0xffu, uint8_t, size_t>::type;
+
+  size_t Clamp(size_t size) const {
+    FTL_DCHECK(size <= N) << "InlineString<" << N << "> overflow: " << size;
+    return std::min(size, N);
+  }
+
+  void SetSize(size_t size) {
+    size_ = static_cast<Size>(size);
+    data_[size] = '\0';
+  }
+
+  Size size_;
+  char data_[N + 1u];
+};
+
+// Appends |args| to |*dest|, as |StrAppend()| does to a |std::string|.
+template <size_t N, typename... Args>
+void StrAppend(InlineString<N>* dest, const Args&... args) {
+  FTL_DCHECK(dest);
+  const std::initializer_list<internal::FormatArgument> pieces = {args...};
+  for (const internal::FormatArgument& piece : pieces)
+    dest->append(piece.string());
+}
+
+}  // namespace ftl
+
+namespace std {
+
+template <size_t N>
+struct hash<ftl::InlineString<N>> {
+  size_t operator()(const ftl::InlineString<N>& string) const {
+    return hash<ftl::StringView>()(string.view());
+  }
+};
+
+}  // namespace std
+
+#endif  // LIB_FTL_STRINGS_INLINE_STRING_H_
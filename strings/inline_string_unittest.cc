@@ -0,0 +1,85 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/inline_string.h"
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/containers/flat_hash_map.h"
+#include "lib/ftl/strings/concatenate.h"
+
+namespace ftl {
+namespace {
+
+TEST(InlineString, Basic) {
+  InlineString<36> string;
+  EXPECT_TRUE(string.empty());
+  EXPECT_EQ(36u, string.capacity());
+  EXPECT_EQ("", string.view());
+  EXPECT_STREQ("", string.c_str());
+  static_assert(sizeof(InlineString<36>) == 38u, "");
+
+  string = "550e8400-e29b-41d4-a716";
+  string += '-';
+  string.append("446655440000");
+  EXPECT_EQ(36u, string.size());
+  EXPECT_EQ("550e8400-e29b-41d4-a716-446655440000", string.view());
+  EXPECT_STREQ("550e8400-e29b-41d4-a716-446655440000", string.c_str());
+  EXPECT_EQ('5', string[0]);
+  EXPECT_EQ("550e8400-e29b-41d4-a716-446655440000", string.ToString());
+
+  InlineString<36> copy = string;
+  copy[0] = '6';
+  EXPECT_NE(string, copy);
+  EXPECT_LT(string, copy);
+  EXPECT_EQ("650e8400-e29b-41d4-a716-446655440000", copy);
+
+  copy.resize(4u);
+  EXPECT_EQ("650e", copy);
+  copy.resize(6u, 'x');
+  EXPECT_EQ("650exx", copy);
+  copy.assign(copy.view().substr(2u));
+  EXPECT_EQ("0exx", copy);
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+  EXPECT_STREQ("", copy.c_str());
+
+  std::ostringstream stream;
+  stream << InlineString<8>("hello");
+  EXPECT_EQ("hello", stream.str());
+}
+
+TEST(InlineString, StrAppendAndFormat) {
+  InlineString<64> name;
+  StrAppend(&name, "requests.", 42, ".", Hex(255u, 4), ".latency");
+  EXPECT_EQ("requests.42.00FF.latency", name);
+  EXPECT_EQ("[requests.42.00FF.latency]", StrCat("[", name, "]"));
+  EXPECT_EQ("name=requests.42.00FF.latency", Format("name={}", name));
+}
+
+TEST(InlineString, HashMapKey) {
+  FlatHashMap<InlineString<16>, int> map;
+  map[InlineString<16>("one")] = 1;
+  map[InlineString<16>("two")] = 2;
+  EXPECT_EQ(2, map[InlineString<16>("two")]);
+  EXPECT_EQ(2u, map.size());
+}
+
+TEST(InlineString, Overflow) {
+#ifdef NDEBUG
+  // For non-Debug builds, the string is truncated.
+  InlineString<4> string("abcdef");
+  EXPECT_EQ("abcd", string);
+  string.push_back('e');
+  EXPECT_EQ("abcd", string);
+#else
+  InlineString<4> string("abcd");
+  EXPECT_DEATH_IF_SUPPORTED({ string.push_back('e'); }, "overflow");
+#endif  // NDEBUG
+}
+
+}  // namespace
+}  // namespace ftl
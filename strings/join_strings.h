@@ -5,42 +5,75 @@
 #ifndef LIB_FTL_STRINGS_JOIN_STRINGS_H_
 #define LIB_FTL_STRINGS_JOIN_STRINGS_H_
 
+#include <stddef.h>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_view.h"
+
 namespace ftl {
+namespace internal {
+
+// Returns the length of |strings| joined with a separator of |separator_size|
+// characters, if |strings| has a |size()| (so that measuring it is presumably
+// cheap); the |long| overload, which returns 0, is chosen otherwise.
+template <typename Range>
+auto JoinedLength(const Range& strings, size_t separator_size, int)
+    -> decltype(strings.size(), size_t()) {
+  if (strings.size() == 0)
+    return 0;
+  size_t length = (strings.size() - 1) * separator_size;
+  for (const auto& string : strings)
+    length += StringView(string).size();
+  return length;
+}
+
+template <typename Range>
+size_t JoinedLength(const Range&, size_t, long) {
+  return 0;
+}
+
+}  // namespace internal
+
+// Appends the elements of |strings|, separated by |separator|, to |*output|.
+// |strings| may be any range whose elements convert to |StringView|, including
+// one that produces them as it's iterated (e.g., a |StringSplitter|). If it has
+// a |size()|, the output is grown just once, so that, e.g., several ranges can
+// be joined into one buffer (after a |reserve()|) without reallocating.
+template <typename Range>
+void AppendJoined(std::string* output,
+                  const Range& strings,
+                  StringView separator = StringView()) {
+  FTL_DCHECK(output);
+  size_t needed =
+      output->size() + internal::JoinedLength(strings, separator.size(), 0);
+  // (Grow geometrically, so that repeated appends stay linear.)
+  if (needed > output->capacity())
+    output->reserve(std::max(needed, 2 * output->capacity()));
+
+  bool first = true;
+  for (const auto& string : strings) {
+    if (!first)
+      output->append(separator.data(), separator.size());
+    first = false;
+    StringView view(string);
+    output->append(view.data(), view.size());
+  }
+}
 
 // Join a container of strings with a separator. This is expected to work with
 // std::vector<std::string> and std::array<std::string> but will work with any
 // container class that supports iterators and basic capacity access (ie:
 // size()) as defined in the Containers library (see:
-// http://en.cppreference.com/w/cpp/container).
+// http://en.cppreference.com/w/cpp/container). See also |AppendJoined()|.
 template <typename StringContainer>
 std::string JoinStrings(const StringContainer& strings,
                         const std::string& separator = "") {
-  size_t output_length = 0;
-  // Add up the sizes of the strings.
-  for (const auto& i : strings) {
-    output_length += i.size();
-  }
-  // Add the sizes of the separators.
-  if (!strings.empty()) {
-    output_length += (strings.size() - 1) * separator.size();
-  }
-
   std::string joined;
-  joined.reserve(output_length);
-
-  bool first = true;
-  for (const auto& i : strings) {
-    if (!first) {
-      joined.append(separator);
-    } else {
-      first = false;
-    }
-    joined.append(i.begin(), i.end());
-  }
-
+  AppendJoined(&joined, strings, separator);
   return joined;
 }
 
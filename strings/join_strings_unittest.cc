@@ -7,6 +7,7 @@
 #include <array>
 
 #include "gtest/gtest.h"
+#include "lib/ftl/strings/split_string.h"
 #include "lib/ftl/strings/string_view.h"
 
 namespace ftl {
@@ -48,5 +49,44 @@ TEST(StringUtil, JoinStrings) {
   EXPECT_EQ("foo:bar", JoinStrings(sv, ":"));
 }
 
+TEST(StringUtil, AppendJoined) {
+  std::string output = "x=";
+  std::vector<std::string> v = {"foo", "bar"};
+  AppendJoined(&output, v, ", ");
+  EXPECT_EQ("x=foo, bar", output);
+  AppendJoined(&output, std::vector<StringView>(), ", ");
+  EXPECT_EQ("x=foo, bar", output);
+  AppendJoined(&output, v);
+  EXPECT_EQ("x=foo, barfoobar", output);
+
+  // Elements just need to convert to StringView.
+  const char* c_strings[] = {"a", "bc", ""};
+  output.clear();
+  AppendJoined(&output, c_strings, "/");
+  EXPECT_EQ("a/bc/", output);
+
+  // A range that has a size is measured first.
+  std::vector<std::string> long_strings(10u, std::string(100u, 'z'));
+  output = "start";
+  AppendJoined(&output, long_strings, "+");
+  EXPECT_EQ(5u + 1000u + 9u, output.size());
+  EXPECT_GE(output.capacity(), output.size());
+}
+
+// Joining the pieces from a |StringSplitter| doesn't need a vector of them.
+TEST(StringUtil, AppendJoinedSplitter) {
+  std::string output;
+  AppendJoined(&output,
+               StringSplitter(" a, b ,,c ", ",", kTrimWhitespace,
+                              kSplitWantNonEmpty),
+               ";");
+  EXPECT_EQ("a;b;c", output);
+
+  output.clear();
+  AppendJoined(&output,
+               StringSplitter("", ",", kKeepWhitespace, kSplitWantAll), ";");
+  EXPECT_EQ("", output);
+}
+
 }  // namespace
 }  // namespace ftl
@@ -4,47 +4,155 @@
 
 #include "lib/ftl/strings/split_string.h"
 
+#include <stdint.h>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/allocation_profiling.h"
 #include "lib/ftl/strings/string_view.h"
 #include "lib/ftl/strings/trim.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FTL_SPLIT_STRING_VECTORS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTL_SPLIT_STRING_VECTORS
+#endif
+
 namespace ftl {
 namespace {
 
-template <typename OutputType>
-OutputType PieceToOutputType(StringView view) {
-  return view;
-}
+// Finds the separators in a string, in order. Where the CPU has 16-byte vectors
+// (SSE2 or NEON) and there are few separators, it compares a block at a time,
+// keeping the block's mask of separators (in |*state|) so that the following
+// pieces in it don't rescan it; otherwise, it uses the |SeparatorSet| bitmap
+// (which, unlike |StringView::find_first_of()|'s table, is built once, not
+// once per piece).
+class SeparatorFinder {
+ public:
+  SeparatorFinder(StringView src,
+                  StringView separators,
+                  const internal::SeparatorSet& separator_set,
+                  internal::SeparatorScanState* state)
+      : src_(src), separator_set_(separator_set), state_(state) {
+#if defined(FTL_SPLIT_STRING_VECTORS)
+    if (separators.size() <= kMaxVectorSeparators) {
+      vector_separator_count_ = separators.size();
+      for (size_t i = 0u; i < vector_separator_count_; i++)
+        splats_[i] = Splat(separators[i]);
+    }
+#endif
+  }
 
-template <>
-std::string PieceToOutputType<std::string>(StringView view) {
-  return view.ToString();
-}
+  // Returns the position of the first separator at or after |pos| (which must
+  // not be less than in the previous call with the same |state|), or
+  // |StringView::npos|.
+  size_t Find(size_t pos) {
+#if defined(FTL_SPLIT_STRING_VECTORS)
+    if (vector_separator_count_)
+      return FindVector(pos);
+#endif
+    return FindScalar(pos);
+  }
 
-size_t FindFirstOf(StringView view, char c, size_t pos) {
-  return view.find(c, pos);
-}
+ private:
+  size_t FindScalar(size_t pos) const {
+    for (; pos < src_.size(); pos++) {
+      if (separator_set_.Contains(src_[pos]))
+        return pos;
+    }
+    return StringView::npos;
+  }
 
-size_t FindFirstOf(StringView view, StringView one_of, size_t pos) {
-  return view.find_first_of(one_of, pos);
-}
+#if defined(FTL_SPLIT_STRING_VECTORS)
+#if defined(__SSE2__)
+  using Vector = __m128i;
+  // The mask has one bit per byte.
+  static constexpr size_t kBitsPerByte = 1u;
+
+  static Vector Splat(char c) { return _mm_set1_epi8(c); }
+
+  uint64_t BlockMask(const char* block) const {
+    Vector bytes = _mm_loadu_si128(reinterpret_cast<const Vector*>(block));
+    Vector matches = _mm_cmpeq_epi8(bytes, splats_[0]);
+    for (size_t i = 1u; i < vector_separator_count_; i++)
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi8(bytes, splats_[i]));
+    return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+  }
+#else   // NEON
+  using Vector = uint8x16_t;
+  // The mask has four bits per byte (NEON has no byte "movemask").
+  static constexpr size_t kBitsPerByte = 4u;
+
+  static Vector Splat(char c) { return vdupq_n_u8(static_cast<uint8_t>(c)); }
+
+  uint64_t BlockMask(const char* block) const {
+    Vector bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(block));
+    Vector matches = vceqq_u8(bytes, splats_[0]);
+    for (size_t i = 1u; i < vector_separator_count_; i++)
+      matches = vorrq_u8(matches, vceqq_u8(bytes, splats_[i]));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+  }
+#endif  // defined(__SSE2__)
+
+  static constexpr size_t kBlockSize = 16u;
+  static constexpr size_t kMaxVectorSeparators = 4u;
+
+  size_t FindVector(size_t pos) {
+    const size_t block_start = state_->block_start;
+    if (pos >= block_start && pos - block_start < kBlockSize) {
+      uint64_t mask = state_->block_mask &
+                      (~uint64_t{0} << ((pos - block_start) * kBitsPerByte));
+      if (mask)
+        return block_start + __builtin_ctzll(mask) / kBitsPerByte;
+      pos = block_start + kBlockSize;
+    }
+    for (; pos + kBlockSize <= src_.size(); pos += kBlockSize) {
+      uint64_t mask = BlockMask(src_.data() + pos);
+      if (mask) {
+        state_->block_start = pos;
+        state_->block_mask = mask;
+        return pos + __builtin_ctzll(mask) / kBitsPerByte;
+      }
+    }
+    // The last partial block.
+    return FindScalar(pos);
+  }
+
+  size_t vector_separator_count_ = 0u;
+  Vector splats_[kMaxVectorSeparators];
+#endif  // defined(FTL_SPLIT_STRING_VECTORS)
+
+  const StringView src_;
+  const internal::SeparatorSet& separator_set_;
+  internal::SeparatorScanState* const state_;
 
-template <typename Str, typename OutputStringType, typename DelimiterType>
-std::vector<OutputStringType> SplitStringT(Str src,
-                                           DelimiterType delimiter,
-                                           WhiteSpaceHandling whitespace,
-                                           SplitResult result_type) {
-  std::vector<OutputStringType> result;
+  FTL_DISALLOW_COPY_AND_ASSIGN(SeparatorFinder);
+};
+
+// Calls |append(piece)| for each piece of |src|.
+template <typename Append>
+void SplitStringOnSeparators(StringView src,
+                             StringView separators,
+                             WhiteSpaceHandling whitespace,
+                             SplitResult result_type,
+                             Append append) {
   if (src.empty())
-    return result;
+    return;
 
+  internal::SeparatorSet separator_set(separators);
+  internal::SeparatorScanState state;
+  SeparatorFinder finder(src, separators, separator_set, &state);
   size_t start = 0;
-  while (start != Str::npos) {
-    size_t end = FindFirstOf(src, delimiter, start);
+  while (start != StringView::npos) {
+    size_t end = finder.Find(start);
 
     StringView view;
-    if (end == Str::npos) {
+    if (end == StringView::npos) {
       view = src.substr(start);
-      start = Str::npos;
+      start = StringView::npos;
     } else {
       view = src.substr(start, end - start);
       start = end + 1;
@@ -53,10 +161,9 @@ std::vector<OutputStringType> SplitStringT(Str src,
       view = TrimString(view, " \t\r\n");
     }
     if (result_type == kSplitWantAll || !view.empty()) {
-      result.push_back(PieceToOutputType<OutputStringType>(view));
+      append(view);
     }
   }
-  return result;
 }
 
 }  // namespace
@@ -65,23 +172,88 @@ std::vector<std::string> SplitStringCopy(StringView input,
                                          StringView separators,
                                          WhiteSpaceHandling whitespace,
                                          SplitResult result_type) {
-  if (separators.size() == 1) {
-    return SplitStringT<StringView, std::string, char>(input, separators[0],
-                                                       whitespace, result_type);
-  }
-  return SplitStringT<StringView, std::string, StringView>(
-      input, separators, whitespace, result_type);
+  std::vector<std::string> result;
+#if defined(FTL_ALLOCATION_PROFILING)
+  const void* caller = FTL_ALLOCATION_CALLER();
+  SplitStringOnSeparators(
+      input, separators, whitespace, result_type,
+      [&result, caller](StringView view) {
+        size_t old_capacity = result.capacity();
+        result.push_back(view.ToString());
+        if (result.capacity() != old_capacity) {
+          FTL_RECORD_ALLOCATION("ftl::SplitStringCopy", caller,
+                                result.capacity() * sizeof(std::string));
+        }
+        // Strings short enough to be stored inline don't allocate.
+        if (result.back().capacity() > std::string().capacity()) {
+          FTL_RECORD_ALLOCATION("ftl::SplitStringCopy", caller,
+                                result.back().capacity() + 1u);
+        }
+      });
+#else
+  SplitStringOnSeparators(
+      input, separators, whitespace, result_type,
+      [&result](StringView view) { result.push_back(view.ToString()); });
+#endif
+  return result;
 }
+
 std::vector<StringView> SplitString(StringView input,
                                     StringView separators,
                                     WhiteSpaceHandling whitespace,
                                     SplitResult result_type) {
-  if (separators.size() == 1) {
-    return SplitStringT<StringView, StringView, char>(input, separators[0],
-                                                      whitespace, result_type);
+  std::vector<StringView> result;
+  SplitStringOnSeparators(
+      input, separators, whitespace, result_type,
+      [&result](StringView view) { result.push_back(view); });
+  return result;
+}
+
+namespace internal {
+
+void SplitStringToCallback(StringView input,
+                           StringView separators,
+                           WhiteSpaceHandling whitespace,
+                           SplitResult result_type,
+                           FunctionRef<void(StringView)> callback) {
+  SplitStringOnSeparators(input, separators, whitespace, result_type,
+                          callback);
+}
+
+}  // namespace internal
+
+StringSplitter::const_iterator::const_iterator(const StringSplitter* splitter) {
+  if (splitter->input_.empty())
+    return;
+  splitter_ = splitter;
+  next_ = 0u;
+  Advance();
+}
+
+void StringSplitter::const_iterator::Advance() {
+  FTL_DCHECK(splitter_);
+  const StringView input = splitter_->input_;
+  SeparatorFinder finder(input, splitter_->separators_,
+                         splitter_->separator_set_, &scan_state_);
+  while (next_ != StringView::npos) {
+    start_ = next_;
+    size_t end = finder.Find(start_);
+
+    if (end == StringView::npos) {
+      piece_ = input.substr(start_);
+      next_ = StringView::npos;
+    } else {
+      piece_ = input.substr(start_, end - start_);
+      next_ = end + 1;
+    }
+    if (splitter_->whitespace_ == kTrimWhitespace) {
+      piece_ = TrimString(piece_, " \t\r\n");
+    }
+    if (splitter_->result_type_ == kSplitWantAll || !piece_.empty())
+      return;
   }
-  return SplitStringT<StringView, StringView, StringView>(
-      input, separators, whitespace, result_type);
+  // The end.
+  *this = const_iterator();
 }
 
 }  // namespace ftl
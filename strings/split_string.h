@@ -5,10 +5,16 @@
 #ifndef LIB_FTL_STRINGS_SPLIT_STRING_H_
 #define LIB_FTL_STRINGS_SPLIT_STRING_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "lib/ftl/containers/inlined_vector.h"
 #include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/function_ref.h"
 #include "lib/ftl/strings/string_view.h"
 
 namespace ftl {
@@ -41,6 +47,161 @@ FTL_EXPORT std::vector<StringView> SplitString(StringView input,
                                                WhiteSpaceHandling whitespace,
                                                SplitResult result_type);
 
+namespace internal {
+
+FTL_EXPORT void SplitStringToCallback(StringView input,
+                                      StringView separators,
+                                      WhiteSpaceHandling whitespace,
+                                      SplitResult result_type,
+                                      FunctionRef<void(StringView)> callback);
+
+}  // namespace internal
+
+// Like SplitString above except it appends the StringViews to |*result|, which
+// may use any allocator (e.g., an |ArenaAllocator|, for per-request
+// temporaries).
+template <typename Allocator>
+void SplitString(StringView input,
+                 StringView separators,
+                 WhiteSpaceHandling whitespace,
+                 SplitResult result_type,
+                 std::vector<StringView, Allocator>* result) {
+  internal::SplitStringToCallback(
+      input, separators, whitespace, result_type,
+      [result](StringView piece) { result->push_back(piece); });
+}
+
+// Like SplitString above except it appends the StringViews to |*result|,
+// which only allocates once there are more than |N| pieces, e.g.:
+//
+//   InlinedVector<StringView, 8> fields;
+//   SplitString(line, ",", kTrimWhitespace, kSplitWantAll, &fields);
+template <size_t N>
+void SplitString(StringView input,
+                 StringView separators,
+                 WhiteSpaceHandling whitespace,
+                 SplitResult result_type,
+                 InlinedVector<StringView, N>* result) {
+  internal::SplitStringToCallback(
+      input, separators, whitespace, result_type,
+      [result](StringView piece) { result->push_back(piece); });
+}
+
+namespace internal {
+
+// A set of separator characters.
+class SeparatorSet {
+ public:
+  explicit SeparatorSet(StringView separators) {
+    for (char c : separators) {
+      unsigned char u = static_cast<unsigned char>(c);
+      bits_[u / 64u] |= uint64_t{1} << (u % 64u);
+    }
+  }
+
+  bool Contains(char c) const {
+    unsigned char u = static_cast<unsigned char>(c);
+    return (bits_[u / 64u] >> (u % 64u)) & 1u;
+  }
+
+ private:
+  uint64_t bits_[4] = {};
+};
+
+// What a scan for separators remembers between pieces (see split_string.cc).
+struct SeparatorScanState {
+  size_t block_start = StringView::npos;
+  uint64_t block_mask = 0u;
+};
+
+}  // namespace internal
+
+// Like |SplitString()|, but a range whose iterators find the pieces as they
+// are advanced, rather than a vector of them, so it never allocates and only
+// scans as much of |input| as is used, e.g.:
+//
+//   for (StringView field : StringSplitter(line, ",", kTrimWhitespace,
+//                                          kSplitWantNonEmpty)) {
+//     if (field == "end")
+//       break;
+//     ...
+//   }
+//
+// |input| and |separators| aren't copied, so they must outlive the splitter,
+// which must outlive its iterators.
+class FTL_EXPORT StringSplitter {
+ public:
+  class FTL_EXPORT const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = StringView;
+    using difference_type = ptrdiff_t;
+    using pointer = const StringView*;
+    using reference = const StringView&;
+
+    const_iterator() {}
+
+    reference operator*() const { return piece_; }
+    pointer operator->() const { return &piece_; }
+
+    const_iterator& operator++() {
+      Advance();
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator result = *this;
+      Advance();
+      return result;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return splitter_ == other.splitter_ && start_ == other.start_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class StringSplitter;
+
+    explicit const_iterator(const StringSplitter* splitter);
+
+    // Moves to the next piece, or to the end.
+    void Advance();
+
+    // Null at the end.
+    const StringSplitter* splitter_ = nullptr;
+    StringView piece_;
+    // Where the current piece starts in |splitter_->input_| (before trimming),
+    // and where the next one does (or |StringView::npos| if this is the last).
+    size_t start_ = StringView::npos;
+    size_t next_ = StringView::npos;
+    internal::SeparatorScanState scan_state_;
+  };
+
+  using iterator = const_iterator;
+
+  StringSplitter(StringView input,
+                 StringView separators,
+                 WhiteSpaceHandling whitespace,
+                 SplitResult result_type)
+      : input_(input),
+        separators_(separators),
+        separator_set_(separators),
+        whitespace_(whitespace),
+        result_type_(result_type) {}
+
+  const_iterator begin() const { return const_iterator(this); }
+  const_iterator end() const { return const_iterator(); }
+
+ private:
+  const StringView input_;
+  const StringView separators_;
+  const internal::SeparatorSet separator_set_;
+  const WhiteSpaceHandling whitespace_;
+  const SplitResult result_type_;
+};
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_STRINGS_SPLIT_STRING_H_
@@ -0,0 +1,46 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+// |state.range(0)| comma-separated fields of a few characters each.
+std::string MakeFields(int count) {
+  std::string input;
+  for (int i = 0; i < count; i++)
+    input += i ? ", field" : "field";
+  return input;
+}
+
+void BM_SplitString(benchmark::State& state) {
+  const std::string input = MakeFields(static_cast<int>(state.range(0)));
+  while (state.KeepRunning()) {
+    std::vector<StringView> fields =
+        SplitString(input, ",", kTrimWhitespace, kSplitWantNonEmpty);
+    benchmark::DoNotOptimize(fields.data());
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(input.size()));
+}
+FTL_BENCHMARK(BM_SplitString)->Arg(4)->Arg(64);
+
+void BM_SplitStringCopy(benchmark::State& state) {
+  const std::string input = MakeFields(static_cast<int>(state.range(0)));
+  while (state.KeepRunning()) {
+    std::vector<std::string> fields =
+        SplitStringCopy(input, ",", kTrimWhitespace, kSplitWantNonEmpty);
+    benchmark::DoNotOptimize(fields.data());
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(input.size()));
+}
+FTL_BENCHMARK(BM_SplitStringCopy)->Arg(4)->Arg(64);
+
+}  // namespace
+}  // namespace ftl
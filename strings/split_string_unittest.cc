@@ -2,7 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "lib/ftl/memory/arena.h"
 #include "lib/ftl/strings/split_string.h"
 #include "lib/ftl/strings/string_view.h"
 
@@ -22,5 +29,120 @@ TEST(StringUtil, SplitString) {
   EXPECT_EQ(r4, SplitStringCopy(sw, ",", kKeepWhitespace, kSplitWantNonEmpty));
 }
 
+TEST(StringUtil, SplitStringWithAllocator) {
+  StringView sw = "a b,c;;d";
+  std::vector<StringView> expected = {"a", "b", "c", "d"};
+  EXPECT_EQ(expected, SplitString(sw, " ,;", kKeepWhitespace,
+                                  kSplitWantNonEmpty));
+
+  Arena arena;
+  ArenaAllocator<StringView> allocator(&arena);
+  std::vector<StringView, ArenaAllocator<StringView>> pieces(allocator);
+  pieces.push_back("z");
+  SplitString(sw, " ,;", kKeepWhitespace, kSplitWantNonEmpty, &pieces);
+  ASSERT_EQ(5u, pieces.size());
+  EXPECT_EQ("z", pieces[0]);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), pieces.begin() + 1));
+}
+
+TEST(StringUtil, SplitStringInlined) {
+  InlinedVector<StringView, 4> pieces;
+  SplitString("a b,c;;d", " ,;", kKeepWhitespace, kSplitWantNonEmpty, &pieces);
+  EXPECT_EQ((InlinedVector<StringView, 4>{"a", "b", "c", "d"}), pieces);
+  EXPECT_TRUE(pieces.is_inlined());
+
+  SplitString("e,f", ",", kKeepWhitespace, kSplitWantAll, &pieces);
+  EXPECT_EQ(6u, pieces.size());
+  EXPECT_EQ("f", pieces.back());
+  EXPECT_FALSE(pieces.is_inlined());
+}
+
+// A straightforward implementation, to check against.
+std::vector<std::string> ReferenceSplit(const std::string& input,
+                                        const std::string& separators,
+                                        WhiteSpaceHandling whitespace,
+                                        SplitResult result_type) {
+  std::vector<std::string> result;
+  if (input.empty())
+    return result;
+  std::string piece;
+  auto add_piece = [&]() {
+    std::string trimmed = piece;
+    if (whitespace == kTrimWhitespace) {
+      size_t first = trimmed.find_first_not_of(" \t\r\n");
+      size_t last = trimmed.find_last_not_of(" \t\r\n");
+      trimmed = first == std::string::npos
+                    ? std::string()
+                    : trimmed.substr(first, last - first + 1u);
+    }
+    if (result_type == kSplitWantAll || !trimmed.empty())
+      result.push_back(trimmed);
+    piece.clear();
+  };
+  for (char c : input) {
+    if (separators.find(c) != std::string::npos)
+      add_piece();
+    else
+      piece += c;
+  }
+  add_piece();
+  return result;
+}
+
+TEST(StringUtil, SplitStringMatchesReference) {
+  // Cover pieces and separators crossing (vector) block boundaries, and
+  // separator sets on both sides of the vectorized limit.
+  const char kAlphabet[] = "ab ,;:\t\n|x";
+  const std::string kSeparatorSets[] = {",", ",;", ",;:|", ",;:|\n", ""};
+  srand(42);
+  for (int i = 0; i < 500; i++) {
+    std::string input;
+    size_t length = static_cast<size_t>(rand() % 100);
+    for (size_t j = 0u; j < length; j++)
+      input += kAlphabet[rand() % (sizeof(kAlphabet) - 1)];
+    for (const std::string& separators : kSeparatorSets) {
+      for (auto whitespace : {kKeepWhitespace, kTrimWhitespace}) {
+        for (auto result_type : {kSplitWantAll, kSplitWantNonEmpty}) {
+          EXPECT_EQ(
+              ReferenceSplit(input, separators, whitespace, result_type),
+              SplitStringCopy(input, separators, whitespace, result_type))
+              << "\"" << input << "\" on \"" << separators << "\"";
+          StringSplitter splitter(input, separators, whitespace, result_type);
+          EXPECT_EQ(SplitString(input, separators, whitespace, result_type),
+                    std::vector<StringView>(splitter.begin(), splitter.end()))
+              << "\"" << input << "\" on \"" << separators << "\"";
+        }
+      }
+    }
+  }
+}
+
+TEST(StringUtil, StringSplitter) {
+  std::vector<StringView> pieces;
+  for (StringView piece :
+       StringSplitter("a, b,,c ,", ",", kTrimWhitespace, kSplitWantAll))
+    pieces.push_back(piece);
+  std::vector<StringView> expected = {"a", "b", "", "c", ""};
+  EXPECT_EQ(expected, pieces);
+
+  StringSplitter empty("", ",", kKeepWhitespace, kSplitWantAll);
+  EXPECT_TRUE(empty.begin() == empty.end());
+  StringSplitter all_empty(",,", ",", kKeepWhitespace, kSplitWantNonEmpty);
+  EXPECT_TRUE(all_empty.begin() == all_empty.end());
+
+  // Iterators are independent, and only scan as far as they're advanced.
+  std::string line = "GET /index.html HTTP/1.1";
+  StringSplitter splitter(line, " ", kKeepWhitespace, kSplitWantNonEmpty);
+  StringSplitter::const_iterator it = splitter.begin();
+  StringSplitter::const_iterator copy = it;
+  EXPECT_EQ("GET", *it);
+  EXPECT_EQ("/index.html", *++it);
+  EXPECT_EQ(line.data() + 4, it->data());
+  EXPECT_EQ("GET", *copy++);
+  EXPECT_TRUE(copy == it);
+  EXPECT_EQ("HTTP/1.1", *++it);
+  EXPECT_TRUE(++it == splitter.end());
+}
+
 }  // namespace
 }  // namespace ftl
@@ -0,0 +1,206 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_STRINGS_STATIC_STRING_MAP_H_
+#define LIB_FTL_STRINGS_STATIC_STRING_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// An entry of a |StaticStringMap|.
+template <typename Value>
+struct StaticStringMapEntry {
+  StringView key;
+  Value value;
+};
+
+namespace internal {
+
+// A (constexpr) FNV-1a hash of |key|, mixed by a multiplication so that its
+// low bits are usable modulo any table size.
+constexpr uint64_t StaticStringHash(StringView key) {
+  uint64_t hash = 0xcbf29ce484222325u;
+  for (size_t i = 0u; i < key.size(); i++)
+    hash = (hash ^ static_cast<unsigned char>(key[i])) * 0x100000001b3u;
+  hash ^= hash >> 32;
+  hash *= 0x9e3779b97f4a7c15u;
+  return hash ^ (hash >> 29);
+}
+
+// Rehashes |hash| with |seed| (which is nonzero).
+constexpr uint64_t StaticStringRehash(uint64_t hash, uint32_t seed) {
+  hash ^= seed * 0xc2b2ae3d27d4eb4fu;
+  hash *= 0x165667b19e3779f9u;
+  return hash ^ (hash >> 32);
+}
+
+// Called (from a constexpr function, so that it's a compile-time error) if a
+// |StaticStringMap| can't be built, i.e., if its keys aren't distinct.
+inline void StaticStringMapHasDuplicateKeys() {
+  abort();
+}
+
+}  // namespace internal
+
+// A fixed map from |N| distinct strings (e.g., the keywords of a protocol or
+// config file) to |Value|s, built at compile time (see
+// |MakeStaticStringMap()|) as a minimal perfect hash table: looking up a key is
+// one hash of it, and one comparison (with the only key it can be), e.g.:
+//
+//   enum class Method { kGet, kHead, kPost, kPut, kDelete };
+//   constexpr auto kMethods = MakeStaticStringMap<Method>({
+//       {"GET", Method::kGet},
+//       {"HEAD", Method::kHead},
+//       ...
+//   });
+//
+//   const Method* method = kMethods.Find(request_line.substr(0u, space));
+//   if (!method)
+//     return Status::kBadRequest;
+//
+// (Duplicate keys are a compile-time error.) |Value| must be a literal type,
+// e.g., an enum, integer or |StringView|, and the keys must outlive the map
+// (which they do if they're string literals).
+//
+// The table is built by "hash, displace and compress": the keys are put in
+// |N| buckets by hash, and, biggest bucket first, a seed is found for each
+// bucket which rehashes all its keys to free slots (or, for a bucket of just
+// one key, the free slot is stored directly). Looking up a key hashes it once,
+// then rehashes the hash with its bucket's seed.
+template <typename Value, size_t N>
+class StaticStringMap final {
+ public:
+  static_assert(N > 0u, "A StaticStringMap needs at least one key");
+
+  constexpr explicit StaticStringMap(
+      const StaticStringMapEntry<Value> (&entries)[N])
+      : entries_{}, seeds_{} {
+    // Each key's hash, and bucket.
+    uint64_t hashes[N] = {};
+    size_t buckets[N] = {};
+    size_t bucket_sizes[N] = {};
+    for (size_t i = 0u; i < N; i++) {
+      hashes[i] = internal::StaticStringHash(entries[i].key);
+      buckets[i] = static_cast<size_t>(hashes[i] % N);
+      bucket_sizes[buckets[i]]++;
+    }
+
+    // The buckets, biggest first (by insertion sort: this only runs once, at
+    // compile time).
+    size_t order[N] = {};
+    for (size_t i = 0u; i < N; i++) {
+      size_t j = i;
+      for (; j > 0u && bucket_sizes[order[j - 1u]] < bucket_sizes[i]; j--)
+        order[j] = order[j - 1u];
+      order[j] = i;
+    }
+
+    bool used[N] = {};
+    size_t next_free = 0u;
+    // The current bucket's keys, and their slots.
+    size_t keys[N] = {};
+    size_t slots[N] = {};
+    for (size_t b = 0u; b < N && bucket_sizes[order[b]] > 0u; b++) {
+      const size_t bucket = order[b];
+      size_t key_count = 0u;
+      for (size_t i = 0u; i < N; i++) {
+        if (buckets[i] == bucket)
+          keys[key_count++] = i;
+      }
+
+      if (key_count == 1u) {
+        while (used[next_free])
+          next_free++;
+        used[next_free] = true;
+        entries_[next_free] = entries[keys[0]];
+        seeds_[bucket] = -static_cast<int32_t>(next_free) - 1;
+        continue;
+      }
+
+      // (Keys with the same hash would collide with every seed.)
+      for (size_t i = 0u; i < key_count; i++) {
+        for (size_t j = i + 1u; j < key_count; j++) {
+          if (hashes[keys[i]] == hashes[keys[j]])
+            internal::StaticStringMapHasDuplicateKeys();
+        }
+      }
+
+      for (uint32_t seed = 1u;; seed++) {
+        size_t placed = 0u;
+        for (; placed < key_count; placed++) {
+          const size_t slot = static_cast<size_t>(
+              internal::StaticStringRehash(hashes[keys[placed]], seed) % N);
+          if (used[slot])
+            break;
+          used[slot] = true;
+          slots[placed] = slot;
+        }
+        if (placed == key_count) {
+          for (size_t i = 0u; i < key_count; i++)
+            entries_[slots[i]] = entries[keys[i]];
+          seeds_[bucket] = static_cast<int32_t>(seed);
+          break;
+        }
+        while (placed > 0u)
+          used[slots[--placed]] = false;
+      }
+    }
+  }
+
+  static constexpr size_t size() { return N; }
+
+  // Returns the value for |key|, or null if it isn't one of the keys.
+  constexpr const Value* Find(StringView key) const {
+    const uint64_t hash = internal::StaticStringHash(key);
+    const int32_t seed = seeds_[hash % N];
+    const size_t slot =
+        seed < 0 ? static_cast<size_t>(-(seed + 1))
+                 : static_cast<size_t>(internal::StaticStringRehash(
+                                           hash, static_cast<uint32_t>(seed)) %
+                                       N);
+    return entries_[slot].key == key ? &entries_[slot].value : nullptr;
+  }
+
+  // Returns the value for |key|, or |default_value| if it isn't one of the
+  // keys.
+  constexpr Value Get(StringView key, Value default_value) const {
+    const Value* value = Find(key);
+    return value ? *value : default_value;
+  }
+
+  constexpr bool Contains(StringView key) const {
+    return Find(key) != nullptr;
+  }
+
+  // The entries, in (arbitrary) table order.
+  constexpr const StaticStringMapEntry<Value>* begin() const {
+    return entries_;
+  }
+  constexpr const StaticStringMapEntry<Value>* end() const {
+    return entries_ + N;
+  }
+
+ private:
+  StaticStringMapEntry<Value> entries_[N];
+  // For each bucket, the seed to rehash its keys with or, if negative, minus
+  // one more than its (only) key's slot.
+  int32_t seeds_[N];
+};
+
+// Returns a |StaticStringMap| of |entries|, which can be declared constexpr
+// (see above).
+template <typename Value, size_t N>
+constexpr StaticStringMap<Value, N> MakeStaticStringMap(
+    const StaticStringMapEntry<Value> (&entries)[N]) {
+  return StaticStringMap<Value, N>(entries);
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_STATIC_STRING_MAP_H_
@@ -0,0 +1,109 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/static_string_map.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+namespace {
+
+enum class Method { kUnknown, kGet, kHead, kPost, kPut, kDelete, kOptions };
+
+constexpr auto kMethods = MakeStaticStringMap<Method>({
+    {"GET", Method::kGet},
+    {"HEAD", Method::kHead},
+    {"POST", Method::kPost},
+    {"PUT", Method::kPut},
+    {"DELETE", Method::kDelete},
+    {"OPTIONS", Method::kOptions},
+});
+
+// Enough keys for buckets of several keys.
+constexpr StaticStringMapEntry<int> kKeywords[] = {
+    {"alignas", 0}, {"alignof", 1}, {"asm", 2}, {"auto", 3}, {"bool", 4},
+    {"break", 5}, {"case", 6}, {"catch", 7}, {"char", 8}, {"class", 9},
+    {"const", 10}, {"constexpr", 11}, {"continue", 12}, {"decltype", 13},
+    {"default", 14}, {"delete", 15}, {"do", 16}, {"double", 17}, {"else", 18},
+    {"enum", 19}, {"explicit", 20}, {"export", 21}, {"extern", 22},
+    {"false", 23}, {"float", 24}, {"for", 25}, {"friend", 26}, {"goto", 27},
+    {"if", 28}, {"inline", 29}, {"int", 30}, {"long", 31}, {"mutable", 32},
+    {"namespace", 33}, {"new", 34}, {"noexcept", 35}, {"nullptr", 36},
+    {"operator", 37}, {"private", 38}, {"protected", 39}, {"public", 40},
+    {"register", 41}, {"return", 42}, {"short", 43}, {"signed", 44},
+    {"sizeof", 45}, {"static", 46}, {"struct", 47}, {"switch", 48},
+    {"template", 49}, {"this", 50}, {"throw", 51}, {"true", 52}, {"try", 53},
+    {"typedef", 54}, {"typeid", 55}, {"typename", 56}, {"union", 57},
+    {"unsigned", 58}, {"using", 59}, {"virtual", 60}, {"void", 61},
+    {"volatile", 62}, {"while", 63},
+};
+constexpr auto kKeywordMap = MakeStaticStringMap(kKeywords);
+
+TEST(StaticStringMap, Basic) {
+  EXPECT_EQ(6u, kMethods.size());
+  ASSERT_TRUE(kMethods.Find("GET"));
+  EXPECT_EQ(Method::kGet, *kMethods.Find("GET"));
+  EXPECT_EQ(Method::kOptions, *kMethods.Find("OPTIONS"));
+  EXPECT_FALSE(kMethods.Find("get"));
+  EXPECT_FALSE(kMethods.Find("GE"));
+  EXPECT_FALSE(kMethods.Find("GETS"));
+  EXPECT_FALSE(kMethods.Find(""));
+  const StringView request_line = "PUT /x HTTP/1.1";
+  EXPECT_EQ(Method::kPut,
+            kMethods.Get(request_line.substr(0u, 3u), Method::kUnknown));
+  EXPECT_EQ(Method::kUnknown, kMethods.Get("PATCH", Method::kUnknown));
+  EXPECT_TRUE(kMethods.Contains("DELETE"));
+  EXPECT_FALSE(kMethods.Contains("CONNECT"));
+
+  std::set<StringView> keys;
+  for (const auto& entry : kMethods)
+    keys.insert(entry.key);
+  EXPECT_EQ(6u, keys.size());
+}
+
+TEST(StaticStringMap, Constexpr) {
+  static_assert(kMethods.Get("HEAD", Method::kUnknown) == Method::kHead, "");
+  static_assert(!kMethods.Contains("PATCH"), "");
+  static_assert(kKeywordMap.Get("while", -1) == 63, "");
+  static_assert(kKeywordMap.Get("whilst", -1) == -1, "");
+
+  constexpr auto kOne = MakeStaticStringMap<int>({{"one", 1}});
+  static_assert(kOne.Get("one", 0) == 1, "");
+  static_assert(kOne.Get("two", 0) == 0, "");
+}
+
+TEST(StaticStringMap, AllKeys) {
+  for (size_t i = 0u; i < arraysize(kKeywords); i++) {
+    const int* value = kKeywordMap.Find(kKeywords[i].key);
+    ASSERT_TRUE(value) << kKeywords[i].key;
+    EXPECT_EQ(kKeywords[i].value, *value);
+    EXPECT_FALSE(kKeywordMap.Find(kKeywords[i].key.ToString() + "_"));
+  }
+}
+
+TEST(StaticStringMap, BuiltAtRunTime) {
+  // (It can be built at run time too, e.g., to test a bigger table.)
+  constexpr size_t kCount = 1000u;
+  std::vector<std::string> strings;
+  for (size_t i = 0u; i < kCount; i++)
+    strings.push_back(StringPrintf("key%zu", i));
+  static StaticStringMapEntry<size_t> entries[kCount];
+  for (size_t i = 0u; i < kCount; i++)
+    entries[i] = {strings[i], i};
+
+  const StaticStringMap<size_t, kCount> map(entries);
+  for (size_t i = 0u; i < kCount; i++)
+    EXPECT_EQ(i, map.Get(strings[i], kCount));
+  EXPECT_FALSE(map.Find("key1000"));
+  EXPECT_FALSE(map.Find("key"));
+}
+
+}  // namespace
+}  // namespace ftl
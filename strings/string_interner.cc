@@ -0,0 +1,121 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/string_interner.h"
+
+#include <string.h>
+
+#include <limits>
+
+#include "lib/ftl/strings/hash.h"
+
+namespace ftl {
+
+// StringInterner --------------------------------------------------------------
+
+StringInterner::StringInterner() = default;
+
+StringInterner::~StringInterner() = default;
+
+StringView StringInterner::Intern(StringView string) {
+  return InternEntry(string)->string;
+}
+
+uint32_t StringInterner::InternId(StringView string) {
+  return InternEntry(string)->id;
+}
+
+bool StringInterner::Find(StringView string, uint32_t* id) const {
+  const Entry* entry = table_.Find(string);
+  if (!entry)
+    return false;
+  if (id)
+    *id = entry->id;
+  return true;
+}
+
+StringInterner::Entry* StringInterner::InternEntry(StringView string) {
+  if (Entry* entry = table_.Find(string))
+    return entry;
+
+  FTL_CHECK(ids_.size() < std::numeric_limits<uint32_t>::max());
+  char* copy = arena_.AllocateArray<char>(string.size() + 1u);
+  if (!string.empty())
+    memcpy(copy, string.data(), string.size());
+  copy[string.size()] = '\0';
+  Entry* entry = arena_.Create<Entry>();
+  entry->string = StringView(copy, string.size());
+  entry->id = static_cast<uint32_t>(ids_.size());
+  ids_.push_back(entry);
+  table_.Insert(entry);
+  return entry;
+}
+
+// ConcurrentStringInterner ----------------------------------------------------
+
+constexpr size_t ConcurrentStringInterner::kShardCount;
+
+ConcurrentStringInterner::ConcurrentStringInterner() = default;
+
+ConcurrentStringInterner::~ConcurrentStringInterner() = default;
+
+size_t ConcurrentStringInterner::size() const {
+  size_t size = 0u;
+  for (const Shard& shard : shards_) {
+    MutexLocker locker(&shard.mutex);
+    size += shard.interner.size();
+  }
+  return size;
+}
+
+StringView ConcurrentStringInterner::Intern(StringView string) {
+  size_t index;
+  Shard& shard = ShardFor(string, &index);
+  MutexLocker locker(&shard.mutex);
+  return shard.interner.Intern(string);
+}
+
+uint32_t ConcurrentStringInterner::InternId(StringView string) {
+  size_t index;
+  Shard& shard = ShardFor(string, &index);
+  MutexLocker locker(&shard.mutex);
+  uint32_t id = shard.interner.InternId(string);
+  FTL_CHECK(id <= std::numeric_limits<uint32_t>::max() / kShardCount);
+  return id * kShardCount + static_cast<uint32_t>(index);
+}
+
+StringView ConcurrentStringInterner::Lookup(uint32_t id) const {
+  const Shard& shard = shards_[id % kShardCount];
+  MutexLocker locker(&shard.mutex);
+  return shard.interner.Lookup(id / kShardCount);
+}
+
+bool ConcurrentStringInterner::Find(StringView string, uint32_t* id) const {
+  size_t index;
+  const Shard& shard = ShardFor(string, &index);
+  MutexLocker locker(&shard.mutex);
+  uint32_t shard_id;
+  if (!shard.interner.Find(string, &shard_id))
+    return false;
+  if (id)
+    *id = shard_id * kShardCount + static_cast<uint32_t>(index);
+  return true;
+}
+
+ConcurrentStringInterner::Shard& ConcurrentStringInterner::ShardFor(
+    StringView string,
+    size_t* index) {
+  return const_cast<Shard&>(
+      static_cast<const ConcurrentStringInterner*>(this)->ShardFor(string,
+                                                                   index));
+}
+
+const ConcurrentStringInterner::Shard& ConcurrentStringInterner::ShardFor(
+    StringView string,
+    size_t* index) const {
+  *index = static_cast<size_t>(HashString(string) >> 32u) % kShardCount;
+  return shards_[*index];
+}
+
+}  // namespace ftl
@@ -0,0 +1,127 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Provides string interning: one stored copy per distinct string.
+
+#ifndef LIB_FTL_STRINGS_STRING_INTERNER_H_
+#define LIB_FTL_STRINGS_STRING_INTERNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "lib/ftl/containers/intrusive_hash_table.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/arena.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+
+// StringInterner --------------------------------------------------------------
+
+// Stores one copy of each distinct string given to it (in an |Arena|, so
+// interning many small strings costs little more than their characters), and
+// hands out stable handles to it: a |StringView| (valid, and null-terminated,
+// until the interner is destroyed), or a compact id (consecutive from zero, in
+// order of first interning). Equal strings get the same handle, so interned
+// strings can be compared by |data()| pointer or by id, e.g., for metric names
+// or log tags that repeat many times:
+//
+//   StringInterner interner;
+//   uint32_t id = interner.InternId(tag);
+//   ...
+//   if (id == interner.InternId("net")) ...
+//
+// This class is not thread-safe; see |ConcurrentStringInterner|.
+class FTL_EXPORT StringInterner final {
+ public:
+  StringInterner();
+  ~StringInterner();
+
+  size_t size() const { return ids_.size(); }
+
+  // Returns the interned copy of |string|, adding it if it's new.
+  StringView Intern(StringView string);
+
+  // Returns the id of |string|, adding it if it's new.
+  uint32_t InternId(StringView string);
+
+  // Returns the string with id |id|, which must have been returned by this
+  // interner.
+  StringView Lookup(uint32_t id) const {
+    FTL_DCHECK(id < ids_.size());
+    return ids_[id]->string;
+  }
+
+  // Stores the id of |string| in |id| (if non-null) and returns true if it has
+  // been interned; otherwise returns false (without adding it).
+  bool Find(StringView string, uint32_t* id) const;
+
+  // Returns the bytes of memory used for the strings and their table entries.
+  size_t bytes_reserved() const { return arena_.bytes_reserved(); }
+
+ private:
+  struct Entry {
+    StringView string;
+    uint32_t id;
+  };
+  struct EntryString {
+    StringView operator()(const Entry& entry) const { return entry.string; }
+  };
+
+  Entry* InternEntry(StringView string);
+
+  Arena arena_;
+  IntrusiveHashTable<StringView, Entry, EntryString> table_;
+  // The entries, by id.
+  std::vector<Entry*> ids_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StringInterner);
+};
+
+// ConcurrentStringInterner ----------------------------------------------------
+
+// A thread-safe |StringInterner|, split into independently locked shards (by
+// hash) so that threads interning different strings rarely contend. Its ids
+// are stable and unique, but not consecutive: they're the shard's (consecutive)
+// id, times |kShardCount|, plus the shard's index.
+class FTL_EXPORT ConcurrentStringInterner final {
+ public:
+  static constexpr size_t kShardCount = 16u;
+
+  ConcurrentStringInterner();
+  ~ConcurrentStringInterner();
+
+  // Returns the number of distinct strings interned (which may be stale as
+  // soon as it's returned, if other threads are interning).
+  size_t size() const;
+
+  // These are as in |StringInterner|.
+  StringView Intern(StringView string);
+  uint32_t InternId(StringView string);
+  StringView Lookup(uint32_t id) const;
+  bool Find(StringView string, uint32_t* id) const;
+
+ private:
+  struct Shard {
+    mutable Mutex mutex;
+    StringInterner interner FTL_GUARDED_BY(mutex);
+  };
+
+  Shard& ShardFor(StringView string, size_t* index);
+  const Shard& ShardFor(StringView string, size_t* index) const;
+
+  Shard shards_[kShardCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ConcurrentStringInterner);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_STRING_INTERNER_H_
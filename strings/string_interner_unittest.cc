@@ -0,0 +1,130 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/string_interner.h"
+
+#include <string.h>
+
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+namespace {
+
+TEST(StringInterner, Basic) {
+  StringInterner interner;
+  EXPECT_EQ(0u, interner.size());
+  EXPECT_FALSE(interner.Find("foo", nullptr));
+
+  std::string foo = "foo";
+  StringView interned = interner.Intern(foo);
+  EXPECT_EQ("foo", interned);
+  // It's a copy, and null-terminated.
+  EXPECT_NE(foo.data(), interned.data());
+  EXPECT_EQ('\0', interned.data()[3]);
+  foo[0] = 'g';
+  EXPECT_EQ("foo", interned);
+
+  EXPECT_EQ(interned.data(), interner.Intern("foo").data());
+  EXPECT_NE(interned.data(), interner.Intern("goo").data());
+  EXPECT_EQ(2u, interner.size());
+}
+
+TEST(StringInterner, Ids) {
+  StringInterner interner;
+  EXPECT_EQ(0u, interner.InternId("zero"));
+  EXPECT_EQ(1u, interner.InternId("one"));
+  EXPECT_EQ(0u, interner.InternId("zero"));
+  EXPECT_EQ(2u, interner.InternId(""));
+  EXPECT_EQ(2u, interner.InternId(StringView()));
+  interner.Intern("three");
+  EXPECT_EQ(3u, interner.InternId("three"));
+  EXPECT_EQ(4u, interner.size());
+
+  EXPECT_EQ("zero", interner.Lookup(0u));
+  EXPECT_EQ("one", interner.Lookup(1u));
+  EXPECT_EQ("", interner.Lookup(2u));
+  EXPECT_EQ(interner.Intern("three").data(), interner.Lookup(3u).data());
+
+  uint32_t id = 123u;
+  EXPECT_TRUE(interner.Find("one", &id));
+  EXPECT_EQ(1u, id);
+  EXPECT_TRUE(interner.Find("three", nullptr));
+  EXPECT_FALSE(interner.Find("four", &id));
+  EXPECT_EQ(1u, id);
+  EXPECT_EQ(4u, interner.size());
+}
+
+// Handles stay valid as the interner grows.
+TEST(StringInterner, Stable) {
+  StringInterner interner;
+  std::vector<StringView> views;
+  for (int i = 0; i < 10000; i++)
+    views.push_back(interner.Intern(StringPrintf("string %d", i)));
+  EXPECT_EQ(10000u, interner.size());
+  for (int i = 0; i < 10000; i++) {
+    std::string string = StringPrintf("string %d", i);
+    EXPECT_EQ(string, views[i]);
+    EXPECT_EQ(views[i].data(), interner.Intern(string).data());
+    EXPECT_EQ(views[i].data(), interner.Lookup(i).data());
+  }
+  EXPECT_EQ(10000u, interner.size());
+  EXPECT_GT(interner.bytes_reserved(), 0u);
+}
+
+TEST(ConcurrentStringInterner, Basic) {
+  ConcurrentStringInterner interner;
+  EXPECT_EQ(0u, interner.size());
+  uint32_t foo = interner.InternId("foo");
+  uint32_t bar = interner.InternId("bar");
+  EXPECT_NE(foo, bar);
+  EXPECT_EQ(foo, interner.InternId("foo"));
+  EXPECT_EQ("foo", interner.Lookup(foo));
+  EXPECT_EQ("bar", interner.Lookup(bar));
+  EXPECT_EQ(interner.Intern("bar").data(), interner.Lookup(bar).data());
+  EXPECT_EQ(2u, interner.size());
+
+  uint32_t id;
+  EXPECT_TRUE(interner.Find("foo", &id));
+  EXPECT_EQ(foo, id);
+  EXPECT_FALSE(interner.Find("baz", &id));
+}
+
+TEST(ConcurrentStringInterner, Threads) {
+  constexpr int kThreadCount = 8;
+  constexpr int kStringCount = 2000;
+  ConcurrentStringInterner interner;
+  std::vector<std::vector<uint32_t>> ids(kThreadCount);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadCount; t++) {
+    threads.push_back(std::thread([&interner, &ids, t]() {
+      // Each thread interns the same strings, in a different order.
+      ids[t].resize(kStringCount);
+      for (int i = 0; i < kStringCount; i++) {
+        int n = (i * 7 + t * 131) % kStringCount;
+        ids[t][n] = interner.InternId(StringPrintf("s%d", n));
+      }
+    }));
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(static_cast<size_t>(kStringCount), interner.size());
+  std::set<uint32_t> distinct;
+  for (int i = 0; i < kStringCount; i++) {
+    for (int t = 1; t < kThreadCount; t++)
+      EXPECT_EQ(ids[0][i], ids[t][i]);
+    EXPECT_EQ(StringPrintf("s%d", i), interner.Lookup(ids[0][i]));
+    distinct.insert(ids[0][i]);
+  }
+  EXPECT_EQ(static_cast<size_t>(kStringCount), distinct.size());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -5,43 +5,178 @@
 #include "lib/ftl/strings/string_number_conversions.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include <limits>
 #include <type_traits>
 
+#include "lib/ftl/build_config.h"
 #include "lib/ftl/logging.h"
+#include "lib/ftl/strings/floating_point_conversions.h"
 
 namespace ftl {
 namespace {
 
+// "00", "01", ..., "99", for formatting two decimal digits at a time.
+constexpr char kTwoDigits[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Writes the digits of |number| so that they end just before |end|, and
+// returns where they start.
+template <typename UnsignedNumberType>
+char* FormatDecimalBackwards(UnsignedNumberType number, char* end) {
+  while (number >= 100u) {
+    size_t pair = static_cast<size_t>(number % 100u) * 2u;
+    number /= 100u;
+    end -= 2;
+    end[0] = kTwoDigits[pair];
+    end[1] = kTwoDigits[pair + 1u];
+  }
+  if (number >= 10u) {
+    size_t pair = static_cast<size_t>(number) * 2u;
+    end -= 2;
+    end[0] = kTwoDigits[pair];
+    end[1] = kTwoDigits[pair + 1u];
+  } else {
+    *--end = static_cast<char>('0' + number);
+  }
+  return end;
+}
+
+template <typename UnsignedNumberType>
+char* FormatHexBackwards(UnsignedNumberType number, char* end) {
+  do {
+    *--end = "0123456789ABCDEF"[number % 16u];
+    number /= 16u;
+  } while (number);
+  return end;
+}
+
 template <typename NumberType>
 bool GetDigitValue(const char s, Base base, NumberType* out_digit) {
   FTL_DCHECK(out_digit);
 
-  if (s < '0')
-    return false;
-
-  if (s <= '9') {
-    *out_digit = static_cast<NumberType>(s - '0');
+  // (The casts to unsigned make each range check a single comparison.)
+  unsigned digit = static_cast<unsigned char>(s) - static_cast<unsigned>('0');
+  if (digit < 10u) {
+    *out_digit = static_cast<NumberType>(digit);
     return true;
   }
 
   if (base != Base::k16)
     return false;
 
-  if (s >= 'a' && s <= 'f') {
-    *out_digit = static_cast<NumberType>(s - 'a' + 10);
-    return true;
-  }
-
-  if (s >= 'A' && s <= 'F') {
-    *out_digit = static_cast<NumberType>(s - 'A' + 10);
+  // Fold 'A'-'F' onto 'a'-'f'.
+  digit = (static_cast<unsigned char>(s) | 0x20u) - static_cast<unsigned>('a');
+  if (digit < 6u) {
+    *out_digit = static_cast<NumberType>(digit + 10u);
     return true;
   }
 
   return false;
 }
 
+#if defined(ARCH_CPU_LITTLE_ENDIAN)
+
+#define FTL_PARSE_EIGHT_DIGITS
+
+constexpr uint32_t kEightDigitsBase = 100000000u;
+
+// If |s[0]|, ..., |s[7]| are all decimal digits, sets |*value| to their value
+// and returns true. This checks and combines them as one 64-bit word ("SWAR").
+bool ParseEightDigits(const char* s, uint32_t* value) {
+  uint64_t chunk;
+  memcpy(&chunk, s, sizeof(chunk));
+  // Each byte must be 0x30-0x39: its high nibble is 3, and adding 6 doesn't
+  // carry out of its low nibble.
+  if ((chunk & UINT64_C(0xf0f0f0f0f0f0f0f0)) != UINT64_C(0x3030303030303030) ||
+      ((chunk + UINT64_C(0x0606060606060606)) & UINT64_C(0xf0f0f0f0f0f0f0f0)) !=
+          UINT64_C(0x3030303030303030))
+    return false;
+  chunk -= UINT64_C(0x3030303030303030);
+  // The first digit is in the lowest byte. Combine adjacent pairs of digits,
+  // then of pairs, then of quads.
+  chunk = (chunk * 10u + (chunk >> 8)) & UINT64_C(0x00ff00ff00ff00ff);
+  chunk = (chunk * 100u + (chunk >> 16)) & UINT64_C(0x0000ffff0000ffff);
+  chunk = (chunk * 10000u + (chunk >> 32)) & UINT64_C(0x00000000ffffffff);
+  *value = static_cast<uint32_t>(chunk);
+  return true;
+}
+
+#endif  // defined(ARCH_CPU_LITTLE_ENDIAN)
+
+// Parses as many leading eight-digit chunks of |s| into |*number| as it can,
+// advancing |*i| past them, for |StringToPositiveNumberWithError()| (or, if
+// |negative|, |StringToNegativeNumberWithError()|). Returns false if the
+// number overflows. (This overload is used when the chunks can't be parsed
+// more quickly, or |NumberType| can't hold eight digits.)
+template <typename NumberType>
+bool ParseEightDigitChunks(const char* s,
+                           size_t length,
+                           bool negative,
+                           size_t* i,
+                           NumberType* number,
+                           std::false_type) {
+  return true;
+}
+
+#if defined(FTL_PARSE_EIGHT_DIGITS)
+
+template <typename NumberType>
+bool ParseEightDigitChunks(const char* s,
+                           size_t length,
+                           bool negative,
+                           size_t* i,
+                           NumberType* number,
+                           std::true_type) {
+  constexpr NumberType kChunkBase = static_cast<NumberType>(kEightDigitsBase);
+  constexpr NumberType kMaxAllowed = std::numeric_limits<NumberType>::max();
+  constexpr NumberType kMinAllowed = std::numeric_limits<NumberType>::min();
+
+  uint32_t chunk;
+  for (; *i + 8u <= length && ParseEightDigits(s + *i, &chunk); *i += 8u) {
+    if (negative) {
+      // This is really a check of "*number * 10^8 - chunk < kMinAllowed":
+      if (*number < kMinAllowed / kChunkBase ||
+          (*number == kMinAllowed / kChunkBase &&
+           chunk > static_cast<uint32_t>(-(kMinAllowed % kChunkBase))))
+        return false;
+      *number = *number * kChunkBase - static_cast<NumberType>(chunk);
+    } else {
+      // This is really a check of "*number * 10^8 + chunk > kMaxAllowed":
+      if (*number > kMaxAllowed / kChunkBase ||
+          (*number == kMaxAllowed / kChunkBase &&
+           chunk > static_cast<uint32_t>(kMaxAllowed % kChunkBase)))
+        return false;
+      *number = *number * kChunkBase + static_cast<NumberType>(chunk);
+    }
+  }
+  return true;
+}
+
+#endif  // defined(FTL_PARSE_EIGHT_DIGITS)
+
+// Selects the |ParseEightDigitChunks()| overload for |NumberType|.
+template <typename NumberType>
+using CanParseEightDigitChunks = std::integral_constant<
+    bool,
+#if defined(FTL_PARSE_EIGHT_DIGITS)
+    static_cast<uint64_t>(std::numeric_limits<NumberType>::max()) >=
+        kEightDigitsBase
+#else
+    false
+#endif
+    >;
+
 // Helper for |StringToNumberWithError()|. Note that this may modify |*number|
 // even on failure.
 template <typename NumberType>
@@ -57,7 +192,12 @@ bool StringToPositiveNumberWithError(const char* s,
   FTL_DCHECK(number);
 
   *number = 0;
-  for (size_t i = 0; i < length; i++) {
+  size_t i = 0;
+  if (base == Base::k10 &&
+      !ParseEightDigitChunks(s, length, false, &i, number,
+                             CanParseEightDigitChunks<NumberType>()))
+    return false;
+  for (; i < length; i++) {
     NumberType new_digit;
     if (!GetDigitValue(s[i], base, &new_digit))
       return false;
@@ -87,7 +227,12 @@ bool StringToNegativeNumberWithError(const char* s,
   FTL_DCHECK(number);
 
   *number = 0;
-  for (size_t i = 0; i < length; i++) {
+  size_t i = 0;
+  if (base == Base::k10 &&
+      !ParseEightDigitChunks(s, length, true, &i, number,
+                             CanParseEightDigitChunks<NumberType>()))
+    return false;
+  for (; i < length; i++) {
     NumberType new_digit;
     if (!GetDigitValue(s[i], base, &new_digit))
       return false;
@@ -105,12 +250,12 @@ bool StringToNegativeNumberWithError(const char* s,
 }  // namespace
 
 template <typename NumberType>
-std::string NumberToString(NumberType number, Base base) {
-  // Special-case zero (since nonzero cases naturally produce digits).
-  if (!number)
-    return std::string("0");
+size_t NumberToBuffer(NumberType number, char* buffer, Base base) {
+  FTL_DCHECK(buffer);
 
   using UnsignedNumberType = typename std::make_unsigned<NumberType>::type;
+  static_assert(std::numeric_limits<UnsignedNumberType>::digits <= 64,
+                "kNumberToBufferSize is too small");
   // Note: The negative case is safe, since the standard requires that, e.g.,
   // for n a negative int32_t, |static_cast<uint32_t>(n)| = 2^32 - n and for a
   // uint32_t m, |-m| = 2^32 - m.
@@ -119,25 +264,32 @@ std::string NumberToString(NumberType number, Base base) {
                                       ? -static_cast<UnsignedNumberType>(number)
                                       : static_cast<UnsignedNumberType>(number);
 
-  char buf[50];  // Big enough to hold the result from even a 128-bit number.
-  size_t i = sizeof(buf);
-  while (abs_number) {
-    i--;
-    if (base == Base::k10) {
-      buf[i] = '0' + abs_number % 10u;
-      abs_number /= 10u;
-    } else {
-      UnsignedNumberType val = abs_number % 16u;
-      buf[i] = (val < 10) ? ('0' + val) : ('A' + val % 10u);
-      abs_number /= 16u;
-    }
-  }
-  if (number_is_negative) {
-    i--;
-    buf[i] = '-';
-  }
+  // Format into the end of a scratch buffer, since the length isn't known
+  // until the end.
+  char scratch[kNumberToBufferSize];
+  char* end = scratch + sizeof(scratch);
+  char* start = base == Base::k10 ? FormatDecimalBackwards(abs_number, end)
+                                  : FormatHexBackwards(abs_number, end);
+  if (number_is_negative)
+    *--start = '-';
+
+  size_t length = static_cast<size_t>(end - start);
+  memcpy(buffer, start, length);
+  return length;
+}
 
-  return std::string(buf + i, buf + sizeof(buf));
+template <typename NumberType>
+void AppendNumber(std::string* dest, NumberType number, Base base) {
+  FTL_DCHECK(dest);
+
+  char buffer[kNumberToBufferSize];
+  dest->append(buffer, NumberToBuffer(number, buffer, base));
+}
+
+template <typename NumberType>
+std::string NumberToString(NumberType number, Base base) {
+  char buffer[kNumberToBufferSize];
+  return std::string(buffer, NumberToBuffer(number, buffer, base));
 }
 
 template <typename NumberType>
@@ -167,6 +319,38 @@ bool StringToNumberWithError(ftl::StringView string,
   return true;
 }
 
+// Specializations for floating-point types:
+template <>
+size_t NumberToBuffer<float>(float number, char* buffer, Base base) {
+  FTL_DCHECK(base == Base::k10);
+  return internal::FormatShortest(number, buffer);
+}
+
+template <>
+size_t NumberToBuffer<double>(double number, char* buffer, Base base) {
+  FTL_DCHECK(base == Base::k10);
+  return internal::FormatShortest(number, buffer);
+}
+
+template <>
+bool StringToNumberWithError<float>(ftl::StringView string,
+                                    float* number,
+                                    Base base) {
+  FTL_DCHECK(base == Base::k10);
+  return internal::ParseFloatingPoint(string, number);
+}
+
+template <>
+bool StringToNumberWithError<double>(ftl::StringView string,
+                                     double* number,
+                                     Base base) {
+  FTL_DCHECK(base == Base::k10);
+  return internal::ParseFloatingPoint(string, number);
+}
+
+static_assert(internal::kMaxFloatingPointLength <= kNumberToBufferSize,
+              "kNumberToBufferSize is too small");
+
 // Explicit instantiatiations for (u)intN_t; count on (unsigned) int being one
 // of these:
 template std::string NumberToString<int8_t>(int8_t number, Base base);
@@ -177,6 +361,54 @@ template std::string NumberToString<int32_t>(int32_t number, Base base);
 template std::string NumberToString<uint32_t>(uint32_t number, Base base);
 template std::string NumberToString<int64_t>(int64_t number, Base base);
 template std::string NumberToString<uint64_t>(uint64_t number, Base base);
+template std::string NumberToString<float>(float number, Base base);
+template std::string NumberToString<double>(double number, Base base);
+template size_t NumberToBuffer<int8_t>(int8_t number, char* buffer, Base base);
+template size_t NumberToBuffer<uint8_t>(uint8_t number,
+                                        char* buffer,
+                                        Base base);
+template size_t NumberToBuffer<int16_t>(int16_t number,
+                                        char* buffer,
+                                        Base base);
+template size_t NumberToBuffer<uint16_t>(uint16_t number,
+                                         char* buffer,
+                                         Base base);
+template size_t NumberToBuffer<int32_t>(int32_t number,
+                                        char* buffer,
+                                        Base base);
+template size_t NumberToBuffer<uint32_t>(uint32_t number,
+                                         char* buffer,
+                                         Base base);
+template size_t NumberToBuffer<int64_t>(int64_t number,
+                                        char* buffer,
+                                        Base base);
+template size_t NumberToBuffer<uint64_t>(uint64_t number,
+                                         char* buffer,
+                                         Base base);
+template void AppendNumber<int8_t>(std::string* dest, int8_t number, Base base);
+template void AppendNumber<uint8_t>(std::string* dest,
+                                    uint8_t number,
+                                    Base base);
+template void AppendNumber<int16_t>(std::string* dest,
+                                    int16_t number,
+                                    Base base);
+template void AppendNumber<uint16_t>(std::string* dest,
+                                     uint16_t number,
+                                     Base base);
+template void AppendNumber<int32_t>(std::string* dest,
+                                    int32_t number,
+                                    Base base);
+template void AppendNumber<uint32_t>(std::string* dest,
+                                     uint32_t number,
+                                     Base base);
+template void AppendNumber<int64_t>(std::string* dest,
+                                    int64_t number,
+                                    Base base);
+template void AppendNumber<uint64_t>(std::string* dest,
+                                     uint64_t number,
+                                     Base base);
+template void AppendNumber<float>(std::string* dest, float number, Base base);
+template void AppendNumber<double>(std::string* dest, double number, Base base);
 template bool StringToNumberWithError<int8_t>(ftl::StringView string,
                                               int8_t* number,
                                               Base base);
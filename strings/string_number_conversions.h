@@ -8,6 +8,8 @@
 #ifndef LIB_FTL_STRINGS_STRING_NUMBER_CONVERSIONS_H_
 #define LIB_FTL_STRINGS_STRING_NUMBER_CONVERSIONS_H_
 
+#include <stddef.h>
+
 #include <string>
 
 #include "lib/ftl/ftl_export.h"
@@ -22,9 +24,35 @@ enum class Base { k10, k16 };
 // Converts |number| to a string with a locale-independent decimal
 // representation of it. This is available for all |NumberType|s (u)intN_t (from
 // <stdint.h>) and also (unsigned) int.
+//
+// It's also available for |float| and |double| (only in base 10), for which
+// the result is the shortest decimal that |StringToNumberWithError()| converts
+// back to exactly |number|. It's in the format of JavaScript's
+// |Number.prototype.toString()| (e.g., "0.1", "-2.5e-7", or "1e+21"), except
+// that negative zero is "-0", and infinities and NaNs are "inf", "-inf", and
+// "nan".
 template <typename NumberType>
 FTL_EXPORT std::string NumberToString(NumberType number, Base base = Base::k10);
 
+// The most characters that |NumberToBuffer()| writes (e.g., for a double,
+// "-0.0000022250738585072014").
+constexpr size_t kNumberToBufferSize = 25u;
+
+// Like |NumberToString()|, but writes the representation (without a
+// terminating null) to |buffer|, which must have room for
+// |kNumberToBufferSize| characters, and returns its length. This doesn't
+// allocate.
+template <typename NumberType>
+FTL_EXPORT size_t NumberToBuffer(NumberType number,
+                                 char* buffer,
+                                 Base base = Base::k10);
+
+// Like |NumberToString()|, but appends the representation to |*dest|.
+template <typename NumberType>
+FTL_EXPORT void AppendNumber(std::string* dest,
+                             NumberType number,
+                             Base base = Base::k10);
+
 // Converts |string| containing a locale-independent representation of a
 // number to a numeric representation of that number. (On error, this returns
 // false and leaves |*number| alone.) This is available for all |NumberType|s
@@ -33,6 +61,12 @@ FTL_EXPORT std::string NumberToString(NumberType number, Base base = Base::k10);
 // Notes: Unary '+' is not allowed. Leading zeros are allowed (and ignored). For
 // unsigned types, unary '-' is not allowed. For signed types, "-0", "-00", etc.
 // are also allowed.
+//
+// It's also available for |float| and |double| (only in base 10), for which
+// |string| may have a fractional part and an exponent (e.g., "-1.5", ".5e-3",
+// or "2E+10"), or be "inf", "infinity", or "nan" (optionally negated). The
+// result is the nearest |NumberType| (ties are rounded to even); it's an error
+// if that's infinite (but not if it's zero).
 template <typename NumberType>
 FTL_EXPORT bool StringToNumberWithError(ftl::StringView string,
                                         NumberType* number,
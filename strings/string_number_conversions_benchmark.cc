@@ -0,0 +1,50 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_StringToInt32(benchmark::State& state) {
+  int32_t value = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(StringToNumberWithError("-123456", &value));
+    benchmark::DoNotOptimize(value);
+  }
+}
+FTL_BENCHMARK(BM_StringToInt32);
+
+void BM_StringToUint64(benchmark::State& state) {
+  uint64_t value = 0u;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(
+        StringToNumberWithError("18446744073709551615", &value));
+    benchmark::DoNotOptimize(value);
+  }
+}
+FTL_BENCHMARK(BM_StringToUint64);
+
+void BM_StringToNumberInvalid(benchmark::State& state) {
+  int32_t value = 0;
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(StringToNumberWithError("12ab", &value));
+  }
+}
+FTL_BENCHMARK(BM_StringToNumberInvalid);
+
+void BM_NumberToString(benchmark::State& state) {
+  uint64_t value = 1234567890123u;
+  while (state.KeepRunning()) {
+    std::string string = NumberToString(value);
+    benchmark::DoNotOptimize(string.data());
+  }
+}
+FTL_BENCHMARK(BM_NumberToString);
+
+}  // namespace
+}  // namespace ftl
@@ -4,9 +4,14 @@
 
 #include "lib/ftl/strings/string_number_conversions.h"
 
+#include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <limits>
+#include <random>
+#include <string>
 
 #include "gtest/gtest.h"
 
@@ -182,6 +187,217 @@ TEST(StringNumberConversionsTest, NumberToString_StdintTypes) {
                                      Base::k16));
 }
 
+TEST(StringNumberConversionsTest, NumberToBuffer) {
+  char buffer[kNumberToBufferSize];
+  EXPECT_EQ("0", std::string(buffer, NumberToBuffer<int32_t>(0, buffer)));
+  EXPECT_EQ("-9223372036854775808",
+            std::string(buffer, NumberToBuffer<int64_t>(
+                                    std::numeric_limits<int64_t>::min(),
+                                    buffer)));
+  EXPECT_EQ("18446744073709551615",
+            std::string(buffer, NumberToBuffer<uint64_t>(
+                                    std::numeric_limits<uint64_t>::max(),
+                                    buffer)));
+  EXPECT_EQ("-80", std::string(buffer, NumberToBuffer<int8_t>(-128, buffer,
+                                                              Base::k16)));
+
+  // Every number of digits (which are formatted in pairs).
+  int64_t number = 0;
+  for (int digit = 1; digit <= 18; digit++) {
+    number = number * 10 + digit % 10;
+    EXPECT_EQ(std::to_string(number), NumberToString<int64_t>(number));
+    EXPECT_EQ(std::to_string(-number), NumberToString<int64_t>(-number));
+  }
+}
+
+TEST(StringNumberConversionsTest, AppendNumber) {
+  std::string result = "x=";
+  AppendNumber<int32_t>(&result, -42);
+  result += ",y=";
+  AppendNumber<uint16_t>(&result, 0xbeef, Base::k16);
+  EXPECT_EQ("x=-42,y=BEEF", result);
+}
+
+TEST(StringNumberConversionsTest, NumberToString_FloatingPoint) {
+  EXPECT_EQ("0", NumberToString<double>(0.0));
+  EXPECT_EQ("-0", NumberToString<double>(-0.0));
+  EXPECT_EQ("1", NumberToString<double>(1.0));
+  EXPECT_EQ("-1.5", NumberToString<double>(-1.5));
+  EXPECT_EQ("0.1", NumberToString<double>(0.1));
+  EXPECT_EQ("0.30000000000000004", NumberToString<double>(0.1 + 0.2));
+  EXPECT_EQ("123.456", NumberToString<double>(123.456));
+  EXPECT_EQ("100", NumberToString<double>(100.0));
+  EXPECT_EQ("100000000000000000000", NumberToString<double>(1e20));
+  EXPECT_EQ("1e+21", NumberToString<double>(1e21));
+  EXPECT_EQ("1.5e+300", NumberToString<double>(1.5e300));
+  EXPECT_EQ("0.000001", NumberToString<double>(1e-6));
+  EXPECT_EQ("1e-7", NumberToString<double>(1e-7));
+  EXPECT_EQ("-2.5e-7", NumberToString<double>(-2.5e-7));
+  EXPECT_EQ("5e-324", NumberToString<double>(
+                          std::numeric_limits<double>::denorm_min()));
+  EXPECT_EQ("2.2250738585072014e-308",
+            NumberToString<double>(std::numeric_limits<double>::min()));
+  EXPECT_EQ("1.7976931348623157e+308",
+            NumberToString<double>(std::numeric_limits<double>::max()));
+  EXPECT_EQ("inf",
+            NumberToString<double>(std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("-inf",
+            NumberToString<double>(-std::numeric_limits<double>::infinity()));
+  EXPECT_EQ("nan",
+            NumberToString<double>(std::numeric_limits<double>::quiet_NaN()));
+
+  EXPECT_EQ("0.1", NumberToString<float>(0.1f));
+  EXPECT_EQ("16777216", NumberToString<float>(16777216.0f));
+  EXPECT_EQ("1e-45",
+            NumberToString<float>(std::numeric_limits<float>::denorm_min()));
+  EXPECT_EQ("1.1754944e-38",
+            NumberToString<float>(std::numeric_limits<float>::min()));
+  EXPECT_EQ("3.4028235e+38",
+            NumberToString<float>(std::numeric_limits<float>::max()));
+
+  char buffer[kNumberToBufferSize];
+  const double kLongest = -2.2250738585072014e-6;
+  EXPECT_EQ(kNumberToBufferSize, NumberToBuffer<double>(kLongest, buffer));
+  std::string result = "x=";
+  AppendNumber<double>(&result, 0.25);
+  EXPECT_EQ("x=0.25", result);
+}
+
+TEST(StringNumberConversionsTest, StringToNumberWithError_FloatingPoint) {
+  double number = 42.0;
+  EXPECT_TRUE(StringToNumberWithError<double>("0", &number));
+  EXPECT_EQ(0.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("-0", &number));
+  EXPECT_EQ(0.0, number);
+  EXPECT_TRUE(signbit(number));
+  EXPECT_TRUE(StringToNumberWithError<double>("1.5", &number));
+  EXPECT_EQ(1.5, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("-.5", &number));
+  EXPECT_EQ(-0.5, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("5.", &number));
+  EXPECT_EQ(5.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("00012.5e1", &number));
+  EXPECT_EQ(125.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("1E3", &number));
+  EXPECT_EQ(1000.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("1e+3", &number));
+  EXPECT_EQ(1000.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("25e-1", &number));
+  EXPECT_EQ(2.5, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("0.1", &number));
+  EXPECT_EQ(0.1, number);
+  EXPECT_TRUE(StringToNumberWithError<double>(
+      "0.1000000000000000055511151231257827021181583404541015625", &number));
+  EXPECT_EQ(0.1, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("1e-400", &number));
+  EXPECT_EQ(0.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("0e999999999999", &number));
+  EXPECT_EQ(0.0, number);
+  EXPECT_TRUE(StringToNumberWithError<double>("inf", &number));
+  EXPECT_EQ(std::numeric_limits<double>::infinity(), number);
+  EXPECT_TRUE(StringToNumberWithError<double>("-infinity", &number));
+  EXPECT_EQ(-std::numeric_limits<double>::infinity(), number);
+  EXPECT_TRUE(StringToNumberWithError<double>("nan", &number));
+  EXPECT_TRUE(isnan(number));
+
+  // Just below, at, and just above halfway between 0 and the smallest
+  // subnormal (which rounds to even, i.e., to 0).
+  EXPECT_TRUE(
+      StringToNumberWithError<double>("2.4703282292062327e-324", &number));
+  EXPECT_EQ(0.0, number);
+  const std::string kHalfway =
+      "2.4703282292062327208828439643411068618252990130716238221279284125033775"
+      "363510437593264991818081799618989828234772285886546332835517796989819938"
+      "739800539093906315035659515570226392290858392449105184435931802849936536"
+      "152500319370457678249219365623669863658480757001585769269903706311928279"
+      "558551332927834338409351978015531246597263579574622766465272827220056374"
+      "006485499977096599470454020828166226237857393450736339007967761930577506"
+      "740176324673600968951340535537458516661134223766678604162159680461914467"
+      "291840300530057530849048765391711386591646239524912623653881879636239373"
+      "280423891018672348497668235089863388587925628302755995657524455507255189"
+      "313690836254779186948667994968324049705821028513185451396213837722826145"
+      "437693412532098591327667236328125"
+      "e-324";
+  EXPECT_TRUE(StringToNumberWithError<double>(kHalfway, &number));
+  EXPECT_EQ(0.0, number);
+  std::string above_halfway = kHalfway;
+  above_halfway.insert(above_halfway.size() - 5u, "0000000001");
+  EXPECT_TRUE(StringToNumberWithError<double>(above_halfway, &number));
+  EXPECT_EQ(std::numeric_limits<double>::denorm_min(), number);
+  EXPECT_TRUE(
+      StringToNumberWithError<double>("2.4703282292062328e-324", &number));
+  EXPECT_EQ(std::numeric_limits<double>::denorm_min(), number);
+  EXPECT_TRUE(
+      StringToNumberWithError<double>("2.2250738585072011e-308", &number));
+  EXPECT_EQ(2.2250738585072011e-308, number);
+  EXPECT_TRUE(
+      StringToNumberWithError<double>("1.7976931348623158e308", &number));
+  EXPECT_EQ(std::numeric_limits<double>::max(), number);
+
+  number = 42.0;
+  EXPECT_FALSE(
+      StringToNumberWithError<double>("1.7976931348623159e308", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("1e400", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("-", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>(".", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("+1", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("--1", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>(" 1", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("1 ", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("1.2.3", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("1e", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("1e+", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("e1", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("0x10", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("1,5", &number));
+  EXPECT_FALSE(StringToNumberWithError<double>("INF", &number));
+  EXPECT_EQ(42.0, number);
+
+  float float_number = 42.0f;
+  EXPECT_TRUE(StringToNumberWithError<float>("0.1", &float_number));
+  EXPECT_EQ(0.1f, float_number);
+  EXPECT_TRUE(StringToNumberWithError<float>("3.4028235e38", &float_number));
+  EXPECT_EQ(std::numeric_limits<float>::max(), float_number);
+  EXPECT_TRUE(StringToNumberWithError<float>("1e-45", &float_number));
+  EXPECT_EQ(std::numeric_limits<float>::denorm_min(), float_number);
+  EXPECT_FALSE(StringToNumberWithError<float>("3.5e38", &float_number));
+  EXPECT_EQ(std::numeric_limits<float>::denorm_min(), float_number);
+  EXPECT_EQ(0.0f, StringToNumber<float>("x"));
+}
+
+// Round trips random floating-point numbers, and checks the parsing against
+// the C library.
+template <typename FloatType, typename Bits>
+void CheckFloatingPointRoundTrips(std::mt19937_64* random) {
+  for (int i = 0; i < 10000; i++) {
+    // Include plenty of subnormals.
+    Bits bits = static_cast<Bits>(i % 4 ? (*random)() : (*random)() % 100000u);
+    FloatType number;
+    memcpy(&number, &bits, sizeof(number));
+    if (isnan(number))
+      continue;
+    std::string string = NumberToString<FloatType>(number);
+    FloatType result = 0;
+    if (!isinf(number)) {
+      ASSERT_TRUE(StringToNumberWithError<FloatType>(string, &result))
+          << string;
+      EXPECT_EQ(0, memcmp(&result, &number, sizeof(number))) << string;
+      FloatType libc_result =
+          static_cast<FloatType>(sizeof(FloatType) == sizeof(float)
+                                     ? strtof(string.c_str(), nullptr)
+                                     : strtod(string.c_str(), nullptr));
+      EXPECT_EQ(0, memcmp(&libc_result, &number, sizeof(number))) << string;
+    }
+  }
+}
+
+TEST(StringNumberConversionsTest, FloatingPoint_RoundTrips) {
+  std::mt19937_64 random(42u);
+  CheckFloatingPointRoundTrips<double, uint64_t>(&random);
+  CheckFloatingPointRoundTrips<float, uint32_t>(&random);
+}
+
 TEST(StringNumberConversionsTest, StringToNumberWithError_Basic) {
   {
     int32_t number = 42;
@@ -295,6 +511,80 @@ TEST(StringNumberConversionsTest, StringToNumberWithError_LeadingZeros) {
   }
 }
 
+// Eight or more digits may be parsed a chunk at a time, so check chunks with
+// every kind of overflow and bad character.
+TEST(StringNumberConversionsTest, StringToNumberWithError_LongInputs) {
+  {
+    int64_t number = 42;
+    EXPECT_TRUE(
+        StringToNumberWithError<int64_t>("9223372036854775807", &number));
+    EXPECT_EQ(std::numeric_limits<int64_t>::max(), number);
+    EXPECT_TRUE(
+        StringToNumberWithError<int64_t>("-9223372036854775808", &number));
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), number);
+    EXPECT_TRUE(StringToNumberWithError<int64_t>(
+        "-000000009223372036854775808", &number));
+    EXPECT_EQ(std::numeric_limits<int64_t>::min(), number);
+    EXPECT_TRUE(StringToNumberWithError<int64_t>("12345678", &number));
+    EXPECT_EQ(12345678, number);
+    EXPECT_TRUE(StringToNumberWithError<int64_t>("1234567890123456", &number));
+    EXPECT_EQ(1234567890123456, number);
+    number = 42;
+    EXPECT_FALSE(
+        StringToNumberWithError<int64_t>("9223372036854775808", &number));
+    EXPECT_FALSE(
+        StringToNumberWithError<int64_t>("-9223372036854775809", &number));
+    EXPECT_FALSE(
+        StringToNumberWithError<int64_t>("92233720368547758070", &number));
+    EXPECT_FALSE(StringToNumberWithError<int64_t>(
+        "-0000092233720368547758080000000", &number));
+    EXPECT_FALSE(StringToNumberWithError<int64_t>("1234567x", &number));
+    EXPECT_FALSE(StringToNumberWithError<int64_t>("12345678x", &number));
+    EXPECT_FALSE(StringToNumberWithError<int64_t>("1234:678", &number));
+    EXPECT_FALSE(StringToNumberWithError<int64_t>("1234/678", &number));
+    EXPECT_EQ(42, number);
+  }
+
+  {
+    uint64_t number = 42u;
+    EXPECT_TRUE(
+        StringToNumberWithError<uint64_t>("18446744073709551615", &number));
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max(), number);
+    EXPECT_TRUE(StringToNumberWithError<uint64_t>(
+        "0000000000000000000018446744073709551615", &number));
+    EXPECT_EQ(std::numeric_limits<uint64_t>::max(), number);
+    number = 42u;
+    EXPECT_FALSE(
+        StringToNumberWithError<uint64_t>("18446744073709551616", &number));
+    EXPECT_FALSE(
+        StringToNumberWithError<uint64_t>("28446744073709551615", &number));
+    EXPECT_EQ(42u, number);
+  }
+
+  {
+    int32_t number = 42;
+    EXPECT_TRUE(StringToNumberWithError<int32_t>("2147483647", &number));
+    EXPECT_EQ(std::numeric_limits<int32_t>::max(), number);
+    EXPECT_TRUE(StringToNumberWithError<int32_t>("-2147483648", &number));
+    EXPECT_EQ(std::numeric_limits<int32_t>::min(), number);
+    number = 42;
+    EXPECT_FALSE(StringToNumberWithError<int32_t>("2147483648", &number));
+    EXPECT_FALSE(StringToNumberWithError<int32_t>("-2147483649", &number));
+    EXPECT_FALSE(
+        StringToNumberWithError<int32_t>("-000000214748364800000000", &number));
+    EXPECT_EQ(42, number);
+  }
+
+  {
+    // Too small for a chunk.
+    int16_t number = 42;
+    EXPECT_TRUE(StringToNumberWithError<int16_t>("0000000032767", &number));
+    EXPECT_EQ(32767, number);
+    EXPECT_FALSE(StringToNumberWithError<int16_t>("12345678", &number));
+    EXPECT_EQ(32767, number);
+  }
+}
+
 TEST(StringNumberConversionsTest, StringToNumberWithError_StdintTypes) {
   {
     int8_t number = 42;
@@ -12,10 +12,17 @@
 
 #include <memory>
 
+#include "lib/ftl/memory/allocation_profiling.h"
+
 namespace ftl {
 namespace {
 
-void StringVAppendfHelper(std::string* dest, const char* format, va_list ap) {
+// |caller| is the return address of the public function which was called (or
+// null), for allocation profiling.
+void StringVAppendfHelper(std::string* dest,
+                          const char* format,
+                          va_list ap,
+                          const void* caller) {
   // Size of the small stack buffer to use first. This should be kept in sync
   // with the numbers in StringPrintfTest.StringPrintf_Boundary.
   constexpr size_t kStackBufferSize = 1024u;
@@ -48,6 +55,7 @@ void StringVAppendfHelper(std::string* dest, const char* format, va_list ap) {
   // (Add 1 because |vsnprintf()| will always null-terminate.)
   size_t heap_buf_size = output_size + 1u;
   std::unique_ptr<char[]> heap_buf(new char[heap_buf_size]);
+  FTL_RECORD_ALLOCATION("ftl::StringPrintf", caller, heap_buf_size);
   result = vsnprintf(heap_buf.get(), heap_buf_size, format, ap);
   if (result < 0 || static_cast<size_t>(result) > output_size) {
     assert(false);
@@ -57,34 +65,41 @@ void StringVAppendfHelper(std::string* dest, const char* format, va_list ap) {
   dest->append(heap_buf.get(), static_cast<size_t>(result));
 }
 
+void StringVAppendfPreservingErrno(std::string* dest,
+                                   const char* format,
+                                   va_list ap,
+                                   const void* caller) {
+  int old_errno = errno;
+  StringVAppendfHelper(dest, format, ap, caller);
+  errno = old_errno;
+}
+
 }  // namespace
 
 std::string StringPrintf(const char* format, ...) {
   va_list ap;
   va_start(ap, format);
   std::string rv;
-  StringVAppendf(&rv, format, ap);
+  StringVAppendfPreservingErrno(&rv, format, ap, FTL_ALLOCATION_CALLER());
   va_end(ap);
   return rv;
 }
 
 std::string StringVPrintf(const char* format, va_list ap) {
   std::string rv;
-  StringVAppendf(&rv, format, ap);
+  StringVAppendfPreservingErrno(&rv, format, ap, FTL_ALLOCATION_CALLER());
   return rv;
 }
 
 void StringAppendf(std::string* dest, const char* format, ...) {
   va_list ap;
   va_start(ap, format);
-  StringVAppendf(dest, format, ap);
+  StringVAppendfPreservingErrno(dest, format, ap, FTL_ALLOCATION_CALLER());
   va_end(ap);
 }
 
 void StringVAppendf(std::string* dest, const char* format, va_list ap) {
-  int old_errno = errno;
-  StringVAppendfHelper(dest, format, ap);
-  errno = old_errno;
+  StringVAppendfPreservingErrno(dest, format, ap, FTL_ALLOCATION_CALLER());
 }
 
 }  // namespace ftl
@@ -0,0 +1,40 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_StringPrintfShort(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    std::string string = StringPrintf("%d:%s", 42, "short");
+    benchmark::DoNotOptimize(string.data());
+  }
+}
+FTL_BENCHMARK(BM_StringPrintfShort);
+
+// Longer than |StringPrintf()|'s stack buffer, so it formats twice.
+void BM_StringPrintfLong(benchmark::State& state) {
+  const std::string argument(2000, 'x');
+  while (state.KeepRunning()) {
+    std::string string = StringPrintf("%s/%d", argument.c_str(), 42);
+    benchmark::DoNotOptimize(string.data());
+  }
+}
+FTL_BENCHMARK(BM_StringPrintfLong);
+
+void BM_StringAppendf(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    std::string string;
+    for (int i = 0; i < 10; i++)
+      StringAppendf(&string, "%d,", i);
+    benchmark::DoNotOptimize(string.data());
+  }
+}
+FTL_BENCHMARK(BM_StringAppendf);
+
+}  // namespace
+}  // namespace ftl
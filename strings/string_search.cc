@@ -0,0 +1,198 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/string_search.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "lib/ftl/arraysize.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FTL_STRING_SEARCH_VECTORS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTL_STRING_SEARCH_VECTORS
+#endif
+
+namespace ftl {
+namespace {
+
+#if defined(FTL_STRING_SEARCH_VECTORS)
+constexpr size_t kBlockSize = 16u;
+
+#if defined(__SSE2__)
+using Vector = __m128i;
+// The mask has one bit per byte.
+constexpr size_t kBitsPerByte = 1u;
+
+Vector Splat(char c) { return _mm_set1_epi8(c); }
+
+Vector Matches(const char* block, Vector c) {
+  return _mm_cmpeq_epi8(
+      _mm_loadu_si128(reinterpret_cast<const Vector*>(block)), c);
+}
+
+Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+
+uint64_t ToMask(Vector matches) {
+  return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+}
+#else   // NEON
+using Vector = uint8x16_t;
+// The mask has four bits per byte (NEON has no byte "movemask"), of which just
+// the top one is kept.
+constexpr size_t kBitsPerByte = 4u;
+
+Vector Splat(char c) { return vdupq_n_u8(static_cast<uint8_t>(c)); }
+
+Vector Matches(const char* block, Vector c) {
+  return vceqq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(block)), c);
+}
+
+Vector And(Vector a, Vector b) { return vandq_u8(a, b); }
+
+uint64_t ToMask(Vector matches) {
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) &
+         UINT64_C(0x8888888888888888);
+}
+#endif  // defined(__SSE2__)
+#endif  // defined(FTL_STRING_SEARCH_VECTORS)
+
+// Finds |needle| (at least two bytes long) by first finding the positions where
+// its bytes at |offsets| (its "anchors") match, a block of positions at a time
+// where the CPU has vectors.
+template <size_t kAnchors>
+size_t FindWithAnchors(StringView haystack,
+                       StringView needle,
+                       const size_t (&offsets)[kAnchors]) {
+  FTL_DCHECK(needle.size() >= 2u);
+  if (needle.size() > haystack.size())
+    return StringView::npos;
+  const char* data = haystack.data();
+  // The candidate positions are [0, |end|).
+  const size_t end = haystack.size() - needle.size() + 1u;
+  size_t pos = 0u;
+#if defined(FTL_STRING_SEARCH_VECTORS)
+  Vector anchors[kAnchors];
+  for (size_t i = 0u; i < kAnchors; i++)
+    anchors[i] = Splat(needle[offsets[i]]);
+  for (; end - pos >= kBlockSize; pos += kBlockSize) {
+    Vector matches = Matches(data + pos + offsets[0], anchors[0]);
+    for (size_t i = 1u; i < kAnchors; i++)
+      matches = And(matches, Matches(data + pos + offsets[i], anchors[i]));
+    for (uint64_t mask = ToMask(matches); mask; mask &= mask - 1u) {
+      size_t candidate = pos + __builtin_ctzll(mask) / kBitsPerByte;
+      if (!memcmp(data + candidate, needle.data(), needle.size()))
+        return candidate;
+    }
+  }
+#endif  // defined(FTL_STRING_SEARCH_VECTORS)
+
+  // The rest, skipping to each occurrence of the first anchor.
+  const size_t offset = offsets[0];
+  while (pos < end) {
+    const char* found = static_cast<const char*>(
+        memchr(data + pos + offset, needle[offset], end - pos));
+    if (!found)
+      break;
+    pos = found - data - offset;
+    if (!memcmp(data + pos, needle.data(), needle.size()))
+      return pos;
+    pos++;
+  }
+  return StringView::npos;
+}
+
+// Roughly how common |c| is in text: 2 for lower-case letters, digits, spaces
+// and common punctuation, 1 for upper-case letters, and 0 for the rest (other
+// punctuation and control characters, and non-ASCII bytes).
+int Commonness(char c) {
+  if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+      (c && strchr(" \t\n.,:;=/-_", c)))
+    return 2;
+  if (c >= 'A' && c <= 'Z')
+    return 1;
+  return 0;
+}
+
+}  // namespace
+
+namespace internal {
+
+size_t FindSubstring(StringView haystack, StringView needle) {
+  FTL_DCHECK(!needle.empty());
+  if (needle.size() == 1u) {
+    const void* result = memchr(haystack.data(), needle[0], haystack.size());
+    return result ? static_cast<const char*>(result) - haystack.data()
+                  : StringView::npos;
+  }
+  const size_t offsets[] = {0u, needle.size() - 1u};
+  return FindWithAnchors(haystack, needle, offsets);
+}
+
+}  // namespace internal
+
+Searcher::Searcher(StringView needle) : needle_(needle.ToString()) {
+  FTL_DCHECK(needle_.size() <= std::numeric_limits<uint32_t>::max());
+  const uint32_t size = static_cast<uint32_t>(needle_.size());
+
+  // Anchor on the last byte and the first, unless another (before the last)
+  // is of a rarer kind.
+  for (size_t i = 1u; i + 1u < size; i++) {
+    if (Commonness(needle_[i]) < Commonness(needle_[anchor_]))
+      anchor_ = i;
+  }
+
+  std::fill_n(shifts_, arraysize(shifts_), size);
+  for (uint32_t i = 0u; i + 1u < size; i++)
+    shifts_[static_cast<unsigned char>(needle_[i])] = size - 1u - i;
+}
+
+Searcher::~Searcher() {}
+
+size_t Searcher::Find(StringView haystack, size_t pos) const {
+  if (pos > haystack.size())
+    return StringView::npos;
+  if (needle_.empty())
+    return pos;
+  haystack = haystack.substr(pos);
+
+  size_t result;
+#if defined(FTL_STRING_SEARCH_VECTORS)
+  const bool use_horspool = false;
+#else
+  // Horspool's algorithm (which may skip several bytes at a time) beats
+  // |memchr()| and checking for long needles.
+  const bool use_horspool = needle_.size() >= 16u;
+#endif
+  if (needle_.size() == 1u) {
+    result = internal::FindSubstring(haystack, needle_);
+  } else if (use_horspool) {
+    result = FindHorspool(haystack);
+  } else {
+    const size_t offsets[] = {anchor_, needle_.size() - 1u};
+    result = FindWithAnchors(haystack, needle_, offsets);
+  }
+  return result == StringView::npos ? result : pos + result;
+}
+
+size_t Searcher::FindHorspool(StringView haystack) const {
+  const char* data = haystack.data();
+  const size_t last_offset = needle_.size() - 1u;
+  const char last = needle_[last_offset];
+  for (size_t i = 0u; haystack.size() - i >= needle_.size();) {
+    char c = data[i + last_offset];
+    if (c == last && !memcmp(data + i, needle_.data(), last_offset))
+      return i;
+    i += shifts_[static_cast<unsigned char>(c)];
+  }
+  return StringView::npos;
+}
+
+}  // namespace ftl
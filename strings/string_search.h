@@ -0,0 +1,70 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_STRINGS_STRING_SEARCH_H_
+#define LIB_FTL_STRINGS_STRING_SEARCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// Searches for a fixed |needle| (which it copies) in any number of haystacks.
+// Construct one per needle and reuse it, e.g.:
+//
+//   Searcher error_searcher("ERROR");
+//   for (StringView line : lines) {
+//     if (error_searcher.Find(line) != StringView::npos)
+//       ...
+//   }
+//
+// Where the CPU has vectors, candidate positions are found 16 at a time by
+// comparing two "anchor" bytes of the needle: its last, and its first or
+// (chosen once, here) one of a rarer kind, e.g., the "E" in "dmaERR".
+// Otherwise, long needles are found by Horspool's algorithm (with its skip
+// table built once, here).
+class FTL_EXPORT Searcher {
+ public:
+  explicit Searcher(StringView needle);
+  ~Searcher();
+
+  const std::string& needle() const { return needle_; }
+
+  // Returns the position of the first occurrence of the needle in |haystack|
+  // at or after |pos|, or |StringView::npos|, as |StringView::find()| does.
+  size_t Find(StringView haystack, size_t pos = 0u) const;
+
+ private:
+  size_t FindHorspool(StringView haystack) const;
+
+  std::string needle_;
+  // The position of the anchor byte other than the last.
+  size_t anchor_ = 0u;
+  // For Horspool's algorithm: how far to move the needle
+  // along when the haystack's byte under its last byte is |c| (and it doesn't
+  // match), i.e., the distance from the last |c| in the rest of the needle to
+  // its end (or its length, if there isn't one).
+  uint32_t shifts_[256];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Searcher);
+};
+
+namespace internal {
+
+// Returns the position of the first occurrence of |needle| (which must not be
+// empty) in |haystack|, or |StringView::npos|, by comparing the needle's first
+// and last bytes with a block of positions at a time. (This implements
+// |StringView::find()|.)
+FTL_EXPORT size_t FindSubstring(StringView haystack, StringView needle);
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_STRINGS_STRING_SEARCH_H_
@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/string_search.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+size_t FindReference(const std::string& haystack,
+                     const std::string& needle,
+                     size_t pos) {
+  if (pos > haystack.size())
+    return StringView::npos;
+  auto result = std::search(haystack.begin() + pos, haystack.end(),
+                            needle.begin(), needle.end());
+  if (result == haystack.end())
+    return needle.empty() ? pos : StringView::npos;
+  return result - haystack.begin();
+}
+
+TEST(StringSearch, Searcher) {
+  Searcher searcher("ERROR");
+  EXPECT_EQ("ERROR", searcher.needle());
+  EXPECT_EQ(StringView::npos, searcher.Find(""));
+  EXPECT_EQ(StringView::npos, searcher.Find("ERRO"));
+  EXPECT_EQ(0u, searcher.Find("ERROR"));
+  EXPECT_EQ(13u, searcher.Find("[12:00:01] E ERROR: disk full"));
+  EXPECT_EQ(StringView::npos, searcher.Find("[12:00:01] E error: disk full"));
+  EXPECT_EQ(31u, searcher.Find("ERROR ERRORERROR ... ERROR ... ERROR", 27u));
+  EXPECT_EQ(StringView::npos, searcher.Find("ERROR", 6u));
+  EXPECT_EQ(19u, Searcher("dmaERR").Find("dmaERdmaEdmaERdmaERdmaERR"));
+
+  Searcher empty("");
+  EXPECT_EQ(0u, empty.Find(""));
+  EXPECT_EQ(3u, empty.Find("abc", 3u));
+  EXPECT_EQ(StringView::npos, empty.Find("abc", 4u));
+
+  // Long needles, with repeats (which limit Horspool's skips).
+  std::string long_needle = "abcabcabcabcabcabcabcabcabcabcabcabcX";
+  Searcher long_searcher(long_needle);
+  std::string haystack = std::string(100u, 'a') + "abcabc" + long_needle;
+  EXPECT_EQ(106u, long_searcher.Find(haystack));
+  EXPECT_EQ(106u, long_searcher.Find(haystack, 106u));
+  EXPECT_EQ(StringView::npos, long_searcher.Find(haystack, 107u));
+  EXPECT_EQ(StringView::npos,
+            long_searcher.Find(haystack.substr(0u, haystack.size() - 1u)));
+}
+
+TEST(StringSearch, MatchesReference) {
+  // Small alphabets, so that there are many near-matches (with bytes of each
+  // kind that |Searcher| may anchor on).
+  const char kAlphabet[] = "aB~c";
+  srand(45);
+  for (int i = 0; i < 3000; i++) {
+    int alphabet_size = 1 + rand() % 4;
+    std::string haystack;
+    size_t haystack_size = static_cast<size_t>(rand() % 200);
+    for (size_t j = 0u; j < haystack_size; j++)
+      haystack += kAlphabet[rand() % alphabet_size];
+    std::string needle;
+    size_t needle_size = static_cast<size_t>(rand() % (i % 2 ? 8 : 50));
+    for (size_t j = 0u; j < needle_size; j++)
+      needle += kAlphabet[rand() % alphabet_size];
+    size_t pos = static_cast<size_t>(rand() % 8);
+
+    size_t expected = FindReference(haystack, needle, pos);
+    EXPECT_EQ(expected, StringView(haystack).find(needle, pos))
+        << haystack << " " << needle;
+    EXPECT_EQ(expected, Searcher(needle).Find(haystack, pos))
+        << haystack << " " << needle;
+  }
+}
+
+TEST(StringSearch, BytesAbove0x7f) {
+  std::string haystack(64u, '\xff');
+  haystack += "\x80\x81\xfe";
+  EXPECT_EQ(64u, StringView(haystack).find("\x80\x81\xfe"));
+  EXPECT_EQ(65u, StringView(haystack).find('\x81'));
+  EXPECT_EQ(63u, Searcher("\xff\x80").Find(haystack));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -5,10 +5,14 @@
 #ifndef LIB_FTL_STRINGS_STRING_VIEW_H_
 #define LIB_FTL_STRINGS_STRING_VIEW_H_
 
+#include <string.h>
+
+#include <functional>
 #include <iosfwd>
 #include <string>
 #include <type_traits>
 
+#include "lib/ftl/compiler_specific.h"
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/logging.h"
 
@@ -21,8 +25,36 @@
 #endif
 
 namespace ftl {
+namespace internal {
+
+// Compares |size| characters of |a| and |b|, as |memcmp()| does (but returning
+// -1, 0 or 1).
+inline CONSTEXPR_IN_CPP14 int CompareChars(const char* a,
+                                           const char* b,
+                                           size_t size) {
+  if (!FTL_IS_CONSTANT_EVALUATED()) {
+    int result = size ? memcmp(a, b, size) : 0;
+    return result < 0 ? -1 : result > 0;
+  }
+  for (size_t i = 0; i < size; i++) {
+    if (a[i] != b[i]) {
+      return static_cast<unsigned char>(a[i]) < static_cast<unsigned char>(b[i])
+                 ? -1
+                 : 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace internal
 
 // A string-like object that points to a sized piece of memory.
+//
+// Everything but conversion to and from |std::string| is constexpr (with C++14
+// compilers which support |FTL_IS_CONSTANT_EVALUATED()|), e.g., for tables of
+// keywords built at compile time, and inline, so that comparisons with literals
+// can be folded. (At run time, comparisons and searches still use |memcmp()|,
+// |memchr()| and the like.)
 class FTL_EXPORT StringView {
  public:
   // Types.
@@ -53,7 +85,7 @@ class FTL_EXPORT StringView {
   StringView(const std::string& str) : data_(str.data()), size_(str.size()) {}
 
   // Copy operators.
-  StringView& operator=(const StringView& other) {
+  CONSTEXPR_IN_CPP14 StringView& operator=(const StringView& other) {
     data_ = other.data_;
     size_ = other.size_;
     return *this;
@@ -120,22 +152,138 @@ class FTL_EXPORT StringView {
     return StringView(data_ + pos, min(n, size_ - pos));
   }
 
-  int compare(StringView other);
-  size_t find(StringView s, size_t pos = 0) const;
-  size_t find(char c, size_t pos = 0) const;
-  size_t rfind(StringView s, size_t pos = npos) const;
-  size_t rfind(char c, size_t pos = npos) const;
-  size_t find_first_of(StringView s, size_t pos = 0) const;
-  size_t find_last_of(StringView s, size_t pos = npos) const;
-  size_t find_first_not_of(StringView s, size_t pos = 0) const;
-  size_t find_last_not_of(StringView s, size_t pos = npos) const;
+  CONSTEXPR_IN_CPP14 int compare(StringView other) const {
+    int result =
+        internal::CompareChars(data_, other.data_, min(size_, other.size_));
+    if (result)
+      return result;
+    return size_ == other.size_ ? 0 : (size_ < other.size_ ? -1 : 1);
+  }
+
+  CONSTEXPR_IN_CPP14 bool starts_with(StringView prefix) const {
+    return size_ >= prefix.size_ &&
+           internal::CompareChars(data_, prefix.data_, prefix.size_) == 0;
+  }
+  CONSTEXPR_IN_CPP14 bool ends_with(StringView suffix) const {
+    return size_ >= suffix.size_ &&
+           internal::CompareChars(data_ + size_ - suffix.size_, suffix.data_,
+                                  suffix.size_) == 0;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t find(StringView s, size_t pos = 0) const {
+    if (pos > size_)
+      return npos;
+    if (s.empty())
+      return pos;
+    if (!FTL_IS_CONSTANT_EVALUATED())
+      return FindSubstring(s, pos);
+    for (size_t i = pos; s.size_ <= size_ - i; i++) {
+      if (internal::CompareChars(data_ + i, s.data_, s.size_) == 0)
+        return i;
+    }
+    return npos;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t find(char c, size_t pos = 0) const {
+    if (pos >= size_)
+      return npos;
+    if (!FTL_IS_CONSTANT_EVALUATED()) {
+      const void* result = memchr(data_ + pos, c, size_ - pos);
+      return result ? static_cast<size_t>(static_cast<const char*>(result) -
+                                          data_)
+                    : npos;
+    }
+    for (size_t i = pos; i < size_; i++) {
+      if (data_[i] == c)
+        return i;
+    }
+    return npos;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t rfind(StringView s, size_t pos = npos) const {
+    if (size_ < s.size_)
+      return npos;
+    if (s.empty())
+      return min(pos, size_);
+    for (size_t i = min(size_ - s.size_, pos);; i--) {
+      if (internal::CompareChars(data_ + i, s.data_, s.size_) == 0)
+        return i;
+      if (i == 0)
+        break;
+    }
+    return npos;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t rfind(char c, size_t pos = npos) const {
+    if (size_ == 0)
+      return npos;
+    for (size_t i = min(size_ - 1, pos);; i--) {
+      if (data_[i] == c)
+        return i;
+      if (i == 0)
+        break;
+    }
+    return npos;
+  }
+
+  // (At run time, these look characters up in a table of |s|'s.)
+  CONSTEXPR_IN_CPP14 size_t find_first_of(StringView s, size_t pos = 0) const {
+    if (!FTL_IS_CONSTANT_EVALUATED())
+      return FindFirstOf(s, pos, true);
+    for (size_t i = pos; i < size_; i++) {
+      if (s.find(data_[i]) != npos)
+        return i;
+    }
+    return npos;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t find_last_of(StringView s,
+                                         size_t pos = npos) const {
+    if (!FTL_IS_CONSTANT_EVALUATED())
+      return FindLastOf(s, pos, true);
+    if (size_ == 0)
+      return npos;
+    for (size_t i = min(size_ - 1, pos);; i--) {
+      if (s.find(data_[i]) != npos)
+        return i;
+      if (i == 0)
+        break;
+    }
+    return npos;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t find_first_not_of(StringView s,
+                                              size_t pos = 0) const {
+    if (!FTL_IS_CONSTANT_EVALUATED())
+      return FindFirstOf(s, pos, false);
+    for (size_t i = pos; i < size_; i++) {
+      if (s.find(data_[i]) == npos)
+        return i;
+    }
+    return npos;
+  }
+
+  CONSTEXPR_IN_CPP14 size_t find_last_not_of(StringView s,
+                                             size_t pos = npos) const {
+    if (!FTL_IS_CONSTANT_EVALUATED())
+      return FindLastOf(s, pos, false);
+    if (size_ == 0)
+      return npos;
+    for (size_t i = min(size_ - 1, pos);; i--) {
+      if (s.find(data_[i]) == npos)
+        return i;
+      if (i == 0)
+        break;
+    }
+    return npos;
+  }
 
  private:
   constexpr static size_t min(size_t v1, size_t v2) {
     return v1 < v2 ? v1 : v2;
   }
 
-  constexpr static int constexpr_strlen(const char* str) {
+  constexpr static size_t constexpr_strlen(const char* str) {
 #if defined(_MSC_VER)
     return *str ? 1 + constexpr_strlen(str + 1) : 0;
 #else
@@ -143,22 +291,53 @@ class FTL_EXPORT StringView {
 #endif
   }
 
+  // The run-time implementations of the searches above: |find()| for a
+  // non-empty |s| at |pos| (at most |size_|), and |find_first_of()| and
+  // |find_last_of()| (or, if not |in_s|, the |_not_of()| versions).
+  size_t FindSubstring(StringView s, size_t pos) const;
+  size_t FindFirstOf(StringView s, size_t pos, bool in_s) const;
+  size_t FindLastOf(StringView s, size_t pos, bool in_s) const;
+
   const char* data_;
   size_t size_;
 };
 
 // Comparison.
 
-FTL_EXPORT bool operator==(StringView lhs, StringView rhs);
-FTL_EXPORT bool operator!=(StringView lhs, StringView rhs);
-FTL_EXPORT bool operator<(StringView lhs, StringView rhs);
-FTL_EXPORT bool operator>(StringView lhs, StringView rhs);
-FTL_EXPORT bool operator<=(StringView lhs, StringView rhs);
-FTL_EXPORT bool operator>=(StringView lhs, StringView rhs);
+inline CONSTEXPR_IN_CPP14 bool operator==(StringView lhs, StringView rhs) {
+  return lhs.size() == rhs.size() &&
+         internal::CompareChars(lhs.data(), rhs.data(), lhs.size()) == 0;
+}
+inline CONSTEXPR_IN_CPP14 bool operator!=(StringView lhs, StringView rhs) {
+  return !(lhs == rhs);
+}
+inline CONSTEXPR_IN_CPP14 bool operator<(StringView lhs, StringView rhs) {
+  return lhs.compare(rhs) < 0;
+}
+inline CONSTEXPR_IN_CPP14 bool operator>(StringView lhs, StringView rhs) {
+  return lhs.compare(rhs) > 0;
+}
+inline CONSTEXPR_IN_CPP14 bool operator<=(StringView lhs, StringView rhs) {
+  return lhs.compare(rhs) <= 0;
+}
+inline CONSTEXPR_IN_CPP14 bool operator>=(StringView lhs, StringView rhs) {
+  return lhs.compare(rhs) >= 0;
+}
 
 // IO.
 FTL_EXPORT std::ostream& operator<<(std::ostream& o, StringView string_view);
 
 }  // namespace ftl
 
+namespace std {
+
+// Hashes the contents (see |ftl::HashString()|), e.g., for
+// |std::unordered_map<ftl::StringView, ...>|.
+template <>
+struct hash<ftl::StringView> {
+  FTL_EXPORT size_t operator()(ftl::StringView string_view) const;
+};
+
+}  // namespace std
+
 #endif  // LIB_FTL_STRINGS_STRING_VIEW_H_
@@ -7,6 +7,7 @@
 #include <functional>
 
 #include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
 
 namespace ftl {
 namespace {
@@ -414,5 +415,59 @@ TEST(StringView, find_last_not_of) {
   LoopOverCharCombinations(sw, other_sw, test_callback);
 }
 
+TEST(StringView, starts_with_ends_with) {
+  StringView sw("--verbose");
+  EXPECT_TRUE(sw.starts_with("--"));
+  EXPECT_TRUE(sw.starts_with(""));
+  EXPECT_TRUE(sw.starts_with(sw));
+  EXPECT_FALSE(sw.starts_with("-v"));
+  EXPECT_FALSE(sw.starts_with("--verbose="));
+  EXPECT_TRUE(sw.ends_with("bose"));
+  EXPECT_TRUE(sw.ends_with(""));
+  EXPECT_FALSE(sw.ends_with("verb"));
+  EXPECT_FALSE(StringView().ends_with("e"));
+}
+
+// A table of keywords, searched at compile time.
+constexpr StringView kKeywords[] = {"break", "case", "continue", "default"};
+
+constexpr int FindKeyword(StringView word) {
+  for (int i = 0; i < static_cast<int>(arraysize(kKeywords)); i++) {
+    if (kKeywords[i] == word)
+      return i;
+  }
+  return -1;
+}
+
+TEST(StringView, Constexpr) {
+  static_assert(FindKeyword("continue") == 2, "");
+  static_assert(FindKeyword("cont") == -1, "");
+
+  constexpr StringView sw("hello, world");
+  static_assert(sw.size() == 12u, "");
+  static_assert(sw.substr(7) == "world", "");
+  static_assert(sw != "hello", "");
+  static_assert(sw.compare("hello, world!") == -1, "");
+  static_assert(StringView("b") > StringView("a\xff"), "");
+  static_assert(sw.starts_with("hello") && sw.ends_with("world"), "");
+  static_assert(sw.find("o") == 4u && sw.find("o", 5) == 8u, "");
+  static_assert(sw.find("xyz") == StringView::npos, "");
+  static_assert(sw.find('w') == 7u, "");
+  static_assert(sw.rfind("o") == 8u && sw.rfind('l', 9) == 3u, "");
+  static_assert(sw.find_first_of(", ") == 5u, "");
+  static_assert(sw.find_last_of("lo") == 10u, "");
+  static_assert(sw.find_first_not_of("leh") == 4u, "");
+  static_assert(sw.find_last_not_of("dlrow") == 6u, "");
+
+  // The same searches at run time.
+  StringView runtime_sw = sw;
+  EXPECT_EQ(4u, runtime_sw.find("o"));
+  EXPECT_EQ(5u, runtime_sw.find_first_of(", "));
+  EXPECT_EQ(10u, runtime_sw.find_last_of("lo"));
+  EXPECT_EQ(4u, runtime_sw.find_first_not_of("leh"));
+  EXPECT_EQ(6u, runtime_sw.find_last_not_of("dlrow"));
+  EXPECT_EQ(2, FindKeyword(std::string("continue")));
+}
+
 }  // namespace
 }  // namespace ftl
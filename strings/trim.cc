@@ -4,15 +4,156 @@
 
 #include "lib/ftl/strings/trim.h"
 
+#include <stdint.h>
+
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/split_string.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FTL_TRIM_VECTORS
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FTL_TRIM_VECTORS
+#endif
+
 namespace ftl {
+namespace {
+
+// Counts the characters to trim at either end of a string. For a few
+// characters (e.g., whitespace), it compares against each of them, a 16-byte
+// block at a time where the CPU has vectors (SSE2 or NEON); otherwise, it uses
+// a |SeparatorSet| bitmap, which (unlike |StringView::find_first_not_of()|'s
+// table) is built once for both ends.
+class TrimScanner {
+ public:
+  explicit TrimScanner(StringView chars)
+      : chars_(chars), set_(chars.size() > kMaxCompareChars
+                                ? chars
+                                : StringView()) {
+#if defined(FTL_TRIM_VECTORS)
+    // (Fewer characters are repeated, so that there are always
+    // |kMaxCompareChars| comparisons, with no loop.)
+    if (chars_.size() <= kMaxCompareChars) {
+      for (size_t i = 0u; i < kMaxCompareChars; i++)
+        splats_[i] = Splat(chars_[i < chars_.size() ? i : 0u]);
+    }
+#endif
+  }
+
+  size_t CountLeading(StringView str) const {
+    size_t i = 0u;
+#if defined(FTL_TRIM_VECTORS)
+    if (chars_.size() <= kMaxCompareChars) {
+      for (; i + kBlockSize <= str.size(); i += kBlockSize) {
+        uint64_t others = ~BlockMask(str.data() + i) & kFullMask;
+        if (others)
+          return i + __builtin_ctzll(others) / kBitsPerByte;
+      }
+    }
+#endif
+    while (i < str.size() && Contains(str[i]))
+      i++;
+    return i;
+  }
+
+  size_t CountTrailing(StringView str) const {
+    size_t count = 0u;
+#if defined(FTL_TRIM_VECTORS)
+    if (chars_.size() <= kMaxCompareChars) {
+      for (; count + kBlockSize <= str.size(); count += kBlockSize) {
+        uint64_t others =
+            ~BlockMask(str.data() + str.size() - count - kBlockSize) &
+            kFullMask;
+        if (others) {
+          size_t last_other = (63u - __builtin_clzll(others)) / kBitsPerByte;
+          return count + kBlockSize - 1u - last_other;
+        }
+      }
+    }
+#endif
+    while (count < str.size() && Contains(str[str.size() - count - 1u]))
+      count++;
+    return count;
+  }
+
+ private:
+  // (|BlockMask()| assumes that this is 4.)
+  static constexpr size_t kMaxCompareChars = 4u;
+
+  bool Contains(char c) const {
+    if (chars_.size() > kMaxCompareChars)
+      return set_.Contains(c);
+    for (char trim : chars_) {
+      if (c == trim)
+        return true;
+    }
+    return false;
+  }
+
+#if defined(FTL_TRIM_VECTORS)
+  static constexpr size_t kBlockSize = 16u;
+
+#if defined(__SSE2__)
+  using Vector = __m128i;
+  // The mask has one bit per byte.
+  static constexpr size_t kBitsPerByte = 1u;
+  static constexpr uint64_t kFullMask = 0xffffu;
+
+  static Vector Splat(char c) { return _mm_set1_epi8(c); }
+
+  // Returns the mask of the bytes of |block| that are in |chars_|.
+  uint64_t BlockMask(const char* block) const {
+    Vector bytes = _mm_loadu_si128(reinterpret_cast<const Vector*>(block));
+    Vector matches = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, splats_[0]),
+                     _mm_cmpeq_epi8(bytes, splats_[1])),
+        _mm_or_si128(_mm_cmpeq_epi8(bytes, splats_[2]),
+                     _mm_cmpeq_epi8(bytes, splats_[3])));
+    return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+  }
+#else   // NEON
+  using Vector = uint8x16_t;
+  // The mask has four bits per byte (NEON has no byte "movemask").
+  static constexpr size_t kBitsPerByte = 4u;
+  static constexpr uint64_t kFullMask = ~uint64_t{0};
+
+  static Vector Splat(char c) { return vdupq_n_u8(static_cast<uint8_t>(c)); }
+
+  uint64_t BlockMask(const char* block) const {
+    Vector bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(block));
+    Vector matches =
+        vorrq_u8(vorrq_u8(vceqq_u8(bytes, splats_[0]),
+                          vceqq_u8(bytes, splats_[1])),
+                 vorrq_u8(vceqq_u8(bytes, splats_[2]),
+                          vceqq_u8(bytes, splats_[3])));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+  }
+#endif  // defined(__SSE2__)
+
+  Vector splats_[kMaxCompareChars];
+#endif  // defined(FTL_TRIM_VECTORS)
+
+  const StringView chars_;
+  // Only used for more than |kMaxCompareChars| characters.
+  const internal::SeparatorSet set_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TrimScanner);
+};
+
+}  // namespace
 
 ftl::StringView TrimString(ftl::StringView str, ftl::StringView chars_to_trim) {
-  size_t start_index = str.find_first_not_of(chars_to_trim);
-  if (start_index == ftl::StringView::npos) {
+  if (chars_to_trim.empty())
+    return str;
+  TrimScanner scanner(chars_to_trim);
+  size_t leading = scanner.CountLeading(str);
+  if (leading == str.size())
     return ftl::StringView();
-  }
-  size_t end_index = str.find_last_not_of(chars_to_trim);
-  return str.substr(start_index, end_index - start_index + 1);
+  str.remove_prefix(leading);
+  str.remove_suffix(scanner.CountTrailing(str));
+  return str;
 }
 
 }  // namespace ftl
@@ -2,6 +2,11 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
 #include "gtest/gtest.h"
 #include "lib/ftl/strings/string_view.h"
 #include "lib/ftl/strings/trim.h"
@@ -23,5 +28,39 @@ TEST(StringUtil, TrimString) {
   EXPECT_EQ(std::string(), TrimString(sw, "HWorlde \t"));
 }
 
+// Compares against |find_first_not_of()| and |find_last_not_of()|, for sets
+// of characters (of various sizes) and lengths that exercise the vectorized
+// blocks.
+TEST(StringUtil, TrimStringRandom) {
+  const char* kSets[] = {" ", " \t", " \t\r\n", " \t\r\n\v", "ab\xff", "\0x"};
+  srand(321);
+  for (const char* set : kSets) {
+    StringView chars(set, set[0] ? strlen(set) : 2u);
+    for (int trial = 0; trial < 500; trial++) {
+      std::string str;
+      size_t leading = static_cast<size_t>(rand() % 40);
+      size_t middle = static_cast<size_t>(rand() % 40);
+      size_t trailing = static_cast<size_t>(rand() % 40);
+      for (size_t i = 0; i < leading + middle + trailing; i++) {
+        bool in_set = i < leading || i >= leading + middle || rand() % 2;
+        str += in_set ? chars[rand() % chars.size()]
+                      : "-yz\x80"[rand() % 4];
+      }
+      StringView view(str);
+      size_t first = view.find_first_not_of(chars);
+      StringView expected;
+      if (first != StringView::npos) {
+        expected =
+            view.substr(first, view.find_last_not_of(chars) - first + 1u);
+      }
+      StringView trimmed = TrimString(view, chars);
+      EXPECT_EQ(expected, trimmed);
+      if (!trimmed.empty()) {
+        EXPECT_EQ(str.data() + first, trimmed.data());
+      }
+    }
+  }
+}
+
 }  // namespace
 }  // namespace ftl
@@ -4,16 +4,322 @@
 
 #include "lib/ftl/strings/utf_codecs.h"
 
+#include <string.h>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/macros.h"
 #include "lib/ftl/third_party/icu/icu_utf.h"
 
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define FTL_UTF8_LOOKUP_VALIDATOR
+#define FTL_UTF8_SSSE3
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FTL_UTF8_LOOKUP_VALIDATOR
+#elif defined(ARCH_CPU_X86_64) && (defined(__GNUC__) || defined(__clang__))
+// The default x86-64 target doesn't have SSSE3, so the validator is compiled
+// for it separately, and used if the CPU has it.
+#include <cpuid.h>
+#include <tmmintrin.h>
+#define FTL_UTF8_LOOKUP_VALIDATOR
+#define FTL_UTF8_SSSE3
+#define FTL_UTF8_SSSE3_DISPATCH
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace ftl {
+namespace {
 
-bool IsStringUTF8(ftl::StringView str) {
-  const char *src = str.data();
-  size_t src_len = str.size();
+#if defined(FTL_UTF8_SSSE3_DISPATCH)
+bool HasSsse3() {
+  static const bool has_ssse3 = [] {
+    unsigned eax = 0u, ebx = 0u, ecx = 0u, edx = 0u;
+    return __get_cpuid(1u, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3);
+  }();
+  return has_ssse3;
+}
+
+// Everything up to |IsValidUTF8WithLookups()| is compiled for SSSE3.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("ssse3"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+#endif
+#endif  // defined(FTL_UTF8_SSSE3_DISPATCH)
+
+#if defined(FTL_UTF8_LOOKUP_VALIDATOR)
+
+// 16-byte vector operations (on unsigned bytes) for |Utf8Validator|.
+#if defined(FTL_UTF8_SSSE3)
+using Vector = __m128i;
+
+Vector Load(const void* src) {
+  return _mm_loadu_si128(static_cast<const Vector*>(src));
+}
+Vector Splat(uint8_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+Vector SaturatingSub(Vector a, Vector b) { return _mm_subs_epu8(a, b); }
+Vector Equal(Vector a, Vector b) { return _mm_cmpeq_epi8(a, b); }
+Vector AtLeast(Vector a, Vector b) {
+  return _mm_cmpeq_epi8(_mm_max_epu8(a, b), a);
+}
+Vector HighNibbles(Vector v) {
+  return _mm_and_si128(_mm_srli_epi16(v, 4), Splat(0x0f));
+}
+// Looks up each (4-bit) index in |table|.
+Vector Lookup(Vector table, Vector indices) {
+  return _mm_shuffle_epi8(table, indices);
+}
+// Returns |v| shifted |N| bytes later, with the last bytes of |previous|.
+template <int N>
+Vector Previous(Vector v, Vector previous) {
+  return _mm_alignr_epi8(v, previous, 16 - N);
+}
+bool IsAscii(Vector v) { return !_mm_movemask_epi8(v); }
+bool IsZero(Vector v) {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xffff;
+}
+#else   // NEON
+using Vector = uint8x16_t;
+
+Vector Load(const void* src) {
+  return vld1q_u8(static_cast<const uint8_t*>(src));
+}
+Vector Splat(uint8_t value) { return vdupq_n_u8(value); }
+Vector And(Vector a, Vector b) { return vandq_u8(a, b); }
+Vector Or(Vector a, Vector b) { return vorrq_u8(a, b); }
+Vector Xor(Vector a, Vector b) { return veorq_u8(a, b); }
+Vector SaturatingSub(Vector a, Vector b) { return vqsubq_u8(a, b); }
+Vector Equal(Vector a, Vector b) { return vceqq_u8(a, b); }
+Vector AtLeast(Vector a, Vector b) { return vcgeq_u8(a, b); }
+Vector HighNibbles(Vector v) { return vshrq_n_u8(v, 4); }
+Vector Lookup(Vector table, Vector indices) {
+  return vqtbl1q_u8(table, indices);
+}
+template <int N>
+Vector Previous(Vector v, Vector previous) {
+  return vextq_u8(previous, v, 16 - N);
+}
+bool IsAscii(Vector v) { return vmaxvq_u8(v) < 0x80u; }
+bool IsZero(Vector v) { return !vmaxvq_u8(v); }
+#endif  // defined(FTL_UTF8_SSSE3)
+
+// The error classes for the two-byte lookups of |Utf8Validator|. Each is an
+// invalid combination of the high nibble of a byte, the low nibble of the byte,
+// and the high nibble of the byte after it.
+constexpr uint8_t kTooShort = 1u << 0;   // 11______ 0_______ (or 11______)
+constexpr uint8_t kTooLong = 1u << 1;    // 0_______ 10______
+constexpr uint8_t kOverlong3 = 1u << 2;  // 11100000 100_____
+constexpr uint8_t kTooLarge = 1u << 3;   // 11110100 1001____ (or 101_____),
+                                         // or 11110101 etc. and 10______
+constexpr uint8_t kSurrogate = 1u << 4;  // 11101101 101_____
+constexpr uint8_t kOverlong2 = 1u << 5;  // 1100000_ 10______
+constexpr uint8_t kTooLarge1000 = 1u << 6;  // 11110101 etc. and 1000____
+constexpr uint8_t kOverlong4 = 1u << 6;     // 11110000 1000____
+constexpr uint8_t kTwoContinuations = 1u << 7;  // 10______ 10______
+constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoContinuations;
+
+// Indexed by the high nibble of the first byte.
+alignas(16) const uint8_t kFirstHighNibbleErrors[16] = {
+    // 0_______ (ASCII)
+    kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+    kTooLong,
+    // 10______ (continuation)
+    kTwoContinuations, kTwoContinuations, kTwoContinuations, kTwoContinuations,
+    // 1100____, 1101____ (two-byte lead)
+    kTooShort | kOverlong2, kTooShort,
+    // 1110____ (three-byte lead)
+    kTooShort | kOverlong3 | kSurrogate,
+    // 1111____ (four-byte lead, or invalid)
+    kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+};
+
+// Indexed by the low nibble of the first byte.
+alignas(16) const uint8_t kFirstLowNibbleErrors[16] = {
+    // ____0000
+    kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+    // ____0001
+    kCarry | kOverlong2,
+    // ____001_
+    kCarry, kCarry,
+    // ____0100
+    kCarry | kTooLarge,
+    // ____0101, ____011_, ____1___
+    kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+    // ____1101
+    kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+    kCarry | kTooLarge | kTooLarge1000, kCarry | kTooLarge | kTooLarge1000,
+};
+
+// Indexed by the high nibble of the second byte.
+alignas(16) const uint8_t kSecondHighNibbleErrors[16] = {
+    // 0_______ (ASCII)
+    kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+    kTooShort, kTooShort,
+    // 1000____
+    kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge1000 |
+        kOverlong4,
+    // 1001____
+    kTooLong | kOverlong2 | kTwoContinuations | kOverlong3 | kTooLarge,
+    // 101_____
+    kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+    kTooLong | kOverlong2 | kTwoContinuations | kSurrogate | kTooLarge,
+    // 11______ (lead)
+    kTooShort, kTooShort, kTooShort, kTooShort,
+};
+
+// The largest final bytes of a block that don't start an incomplete sequence.
+alignas(16) const uint8_t kMaxCompleteFinalBytes[16] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf,
+};
+
+// Validates UTF-8 a 16-byte block at a time, by Keiser and Lemire's algorithm
+// ("Validating UTF-8 In Less Than One Instruction Per Byte", 2021): three
+// 16-entry table lookups per block (see above) classify each pair of adjacent
+// bytes, a check of the two bytes before each continuation byte finds missing
+// or extra third and fourth bytes, and 32-byte chunks of ASCII are skipped.
+// It also rejects the non-characters that |IsValidCharacter()| excludes.
+class Utf8Validator {
+ public:
+  Utf8Validator()
+      : first_high_nibble_errors_(Load(kFirstHighNibbleErrors)),
+        first_low_nibble_errors_(Load(kFirstLowNibbleErrors)),
+        second_high_nibble_errors_(Load(kSecondHighNibbleErrors)),
+        max_complete_final_bytes_(Load(kMaxCompleteFinalBytes)),
+        previous_(Splat(0u)),
+        previous_incomplete_(Splat(0u)),
+        error_(Splat(0u)) {}
+
+  static constexpr size_t kChunkSize = 32u;
+
+  // Checks the next |kChunkSize| bytes.
+  void CheckChunk(const char* chunk) {
+    Vector first = Load(chunk);
+    Vector second = Load(chunk + 16);
+    if (IsAscii(Or(first, second))) {
+      error_ = Or(error_, previous_incomplete_);
+      previous_incomplete_ = Splat(0u);
+    } else {
+      CheckBlock(first, previous_);
+      CheckBlock(second, first);
+      previous_incomplete_ =
+          SaturatingSub(second, max_complete_final_bytes_);
+    }
+    previous_ = second;
+  }
+
+  // Returns true if all the chunks were valid (and the last was complete).
+  bool Finish() const { return IsZero(Or(error_, previous_incomplete_)); }
+
+ private:
+  void CheckBlock(Vector input, Vector previous) {
+    Vector previous1 = Previous<1>(input, previous);
+    Vector previous2 = Previous<2>(input, previous);
+    Vector previous3 = Previous<3>(input, previous);
+
+    Vector low_nibble_mask = Splat(0x0f);
+    Vector pair_errors =
+        And(And(Lookup(first_high_nibble_errors_, HighNibbles(previous1)),
+                Lookup(first_low_nibble_errors_,
+                       And(previous1, low_nibble_mask))),
+            Lookup(second_high_nibble_errors_, HighNibbles(input)));
+
+    // A byte must be a continuation (which is a |kTwoContinuations| "error"
+    // above) iff it's two after a lead of three or four bytes, or three after a
+    // lead of four.
+    Vector third_byte = SaturatingSub(previous2, Splat(0xe0 - 0x80));
+    Vector fourth_byte = SaturatingSub(previous3, Splat(0xf0 - 0x80));
+    Vector must_be_continuation = And(Or(third_byte, fourth_byte), Splat(0x80));
+    error_ = Or(error_, Xor(must_be_continuation, pair_errors));
+
+    // U+FDD0..U+FDEF are EF B7 90..AF.
+    Vector fdd0 = And(And(Equal(previous2, Splat(0xef)),
+                          Equal(previous1, Splat(0xb7))),
+                      And(AtLeast(input, Splat(0x90)),
+                          AtLeast(Splat(0xaf), input)));
+    // U+xFFFE and U+xFFFF end in BF BE or BF BF, after EF, or after a second
+    // byte (of four) ending in F.
+    Vector fffe = And(And(Equal(previous1, Splat(0xbf)),
+                          AtLeast(input, Splat(0xbe))),
+                      Or(Equal(previous2, Splat(0xef)),
+                         And(AtLeast(previous3, Splat(0xf0)),
+                             Equal(Or(previous2, Splat(0xf0)), Splat(0xff)))));
+    error_ = Or(error_, Or(fdd0, fffe));
+  }
+
+  const Vector first_high_nibble_errors_;
+  const Vector first_low_nibble_errors_;
+  const Vector second_high_nibble_errors_;
+  const Vector max_complete_final_bytes_;
+  // The previous block.
+  Vector previous_;
+  // Nonzero where the previous block ends with an incomplete sequence.
+  Vector previous_incomplete_;
+  Vector error_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Utf8Validator);
+};
+
+constexpr size_t Utf8Validator::kChunkSize;
+
+bool IsValidUTF8WithLookups(const char* src, size_t src_len) {
+  Utf8Validator validator;
+  size_t pos = 0;
+  for (; pos + Utf8Validator::kChunkSize <= src_len;
+       pos += Utf8Validator::kChunkSize)
+    validator.CheckChunk(src + pos);
+  if (pos < src_len) {
+    // Pad the last chunk with nulls (which are valid).
+    char chunk[Utf8Validator::kChunkSize] = {};
+    memcpy(chunk, src + pos, src_len - pos);
+    validator.CheckChunk(chunk);
+  }
+  return validator.Finish();
+}
+
+#endif  // defined(FTL_UTF8_LOOKUP_VALIDATOR)
+
+#if defined(FTL_UTF8_SSSE3_DISPATCH)
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif  // defined(FTL_UTF8_SSSE3_DISPATCH)
+
+#if !defined(FTL_UTF8_LOOKUP_VALIDATOR) || defined(FTL_UTF8_SSSE3_DISPATCH)
+
+// Returns true if the 16 bytes at |src| are all ASCII.
+bool IsAsciiBlock(const char* src) {
+#if defined(__SSE2__)
+  return !_mm_movemask_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+#else
+  uint64_t words[2];
+  memcpy(words, src, sizeof(words));
+  return !((words[0] | words[1]) & UINT64_C(0x8080808080808080));
+#endif
+}
+
+bool IsValidUTF8Scalar(const char* src, size_t src_len) {
   size_t char_index = 0;
 
   while (char_index < src_len) {
+    // Skip ASCII 16 bytes at a time.
+    if (src_len - char_index >= 16u && IsAsciiBlock(src + char_index)) {
+      char_index += 16u;
+      continue;
+    }
     int32_t code_point;
     FTL_U8_NEXT(src, char_index, src_len, code_point);
     if (!IsValidCharacter(code_point))
@@ -22,6 +328,171 @@ bool IsStringUTF8(ftl::StringView str) {
   return true;
 }
 
+#endif  // !defined(FTL_UTF8_LOOKUP_VALIDATOR) || ...
+
+// For the bulk conversions: these copy the longest prefix of |src| (of at most
+// |length| code units) that's a whole number of blocks of ASCII, converting
+// each character, and return its length.
+constexpr size_t kAsciiBlockSize = 16u;
+
+size_t CopyAsciiBlocks(const char* src, size_t length, char16_t* dest) {
+  size_t i = 0u;
+  for (; length - i >= kAsciiBlockSize; i += kAsciiBlockSize) {
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (_mm_movemask_epi8(bytes))
+      break;
+    __m128i zero = _mm_setzero_si128();
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_unpacklo_epi8(bytes, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8u),
+                     _mm_unpackhi_epi8(bytes, zero));
+#elif defined(__aarch64__)
+    uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+    if (vmaxvq_u8(bytes) >= 0x80u)
+      break;
+    uint16_t* out = reinterpret_cast<uint16_t*>(dest + i);
+    vst1q_u16(out, vmovl_u8(vget_low_u8(bytes)));
+    vst1q_u16(out + 8u, vmovl_u8(vget_high_u8(bytes)));
+#else
+    uint64_t words[2];
+    memcpy(words, src + i, sizeof(words));
+    if ((words[0] | words[1]) & UINT64_C(0x8080808080808080))
+      break;
+    for (size_t j = 0u; j < kAsciiBlockSize; j++)
+      dest[i + j] = static_cast<char16_t>(src[i + j]);
+#endif
+  }
+  return i;
+}
+
+size_t CopyAsciiBlocks(const char* src, size_t length, char32_t* dest) {
+  size_t i = 0u;
+  for (; length - i >= kAsciiBlockSize; i += kAsciiBlockSize) {
+#if defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    if (_mm_movemask_epi8(bytes))
+      break;
+    __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_unpacklo_epi8(bytes, zero);
+    __m128i high = _mm_unpackhi_epi8(bytes, zero);
+    __m128i* out = reinterpret_cast<__m128i*>(dest + i);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high, zero));
+#elif defined(__aarch64__)
+    uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+    if (vmaxvq_u8(bytes) >= 0x80u)
+      break;
+    uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+    uint32_t* out = reinterpret_cast<uint32_t*>(dest + i);
+    vst1q_u32(out, vmovl_u16(vget_low_u16(low)));
+    vst1q_u32(out + 4u, vmovl_u16(vget_high_u16(low)));
+    vst1q_u32(out + 8u, vmovl_u16(vget_low_u16(high)));
+    vst1q_u32(out + 12u, vmovl_u16(vget_high_u16(high)));
+#else
+    uint64_t words[2];
+    memcpy(words, src + i, sizeof(words));
+    if ((words[0] | words[1]) & UINT64_C(0x8080808080808080))
+      break;
+    for (size_t j = 0u; j < kAsciiBlockSize; j++)
+      dest[i + j] = static_cast<char32_t>(src[i + j]);
+#endif
+  }
+  return i;
+}
+
+size_t CopyAsciiBlocks(const char16_t* src, size_t length, char* dest) {
+  size_t i = 0u;
+  for (; length - i >= kAsciiBlockSize; i += kAsciiBlockSize) {
+#if defined(__SSE2__)
+    const __m128i* in = reinterpret_cast<const __m128i*>(src + i);
+    __m128i low = _mm_loadu_si128(in);
+    __m128i high = _mm_loadu_si128(in + 1);
+    __m128i non_ascii =
+        _mm_and_si128(_mm_or_si128(low, high), _mm_set1_epi16(0xff80));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, _mm_setzero_si128())) !=
+        0xffff)
+      break;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_packus_epi16(low, high));
+#elif defined(__aarch64__)
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src + i);
+    uint16x8_t low = vld1q_u16(in);
+    uint16x8_t high = vld1q_u16(in + 8u);
+    if (vmaxvq_u16(vorrq_u16(low, high)) >= 0x80u)
+      break;
+    vst1q_u8(reinterpret_cast<uint8_t*>(dest + i),
+             vcombine_u8(vmovn_u16(low), vmovn_u16(high)));
+#else
+    char16_t bits = 0u;
+    for (size_t j = 0u; j < kAsciiBlockSize; j++)
+      bits |= src[i + j];
+    if (bits >= 0x80u)
+      break;
+    for (size_t j = 0u; j < kAsciiBlockSize; j++)
+      dest[i + j] = static_cast<char>(src[i + j]);
+#endif
+  }
+  return i;
+}
+
+void AppendCodePoint(int32_t code_point, char16_t* dest, size_t* dest_index) {
+  FTL_U16_APPEND_UNSAFE(dest, *dest_index, code_point);
+}
+
+void AppendCodePoint(int32_t code_point, char32_t* dest, size_t* dest_index) {
+  dest[(*dest_index)++] = static_cast<char32_t>(code_point);
+}
+
+// Converts UTF-8 to UTF-16 or UTF-32 (see |UTF8ToUTF16()|).
+template <typename Char>
+bool ConvertUTF8(const char* src,
+                 size_t src_len,
+                 Char* dest,
+                 size_t* dest_len) {
+  bool valid = true;
+  size_t char_index = 0u;
+  size_t dest_index = 0u;
+  while (char_index < src_len) {
+    if (static_cast<uint8_t>(src[char_index]) < 0x80u) {
+      size_t length = CopyAsciiBlocks(src + char_index, src_len - char_index,
+                                      dest + dest_index);
+      char_index += length;
+      dest_index += length;
+      if (char_index == src_len)
+        break;
+    }
+    int32_t code_point;
+    FTL_U8_NEXT(src, char_index, src_len, code_point);
+    if (!IsValidCodepoint(code_point)) {
+      code_point = 0xfffd;
+      valid = false;
+    }
+    AppendCodePoint(code_point, dest, &dest_index);
+  }
+  *dest_len = dest_index;
+  return valid;
+}
+
+}  // namespace
+
+bool IsStringUTF8(ftl::StringView str) {
+  const char *src = str.data();
+  size_t src_len = str.size();
+
+#if defined(FTL_UTF8_SSSE3_DISPATCH)
+  return HasSsse3() ? IsValidUTF8WithLookups(src, src_len)
+                    : IsValidUTF8Scalar(src, src_len);
+#elif defined(FTL_UTF8_LOOKUP_VALIDATOR)
+  return IsValidUTF8WithLookups(src, src_len);
+#else
+  return IsValidUTF8Scalar(src, src_len);
+#endif
+}
+
 // ReadUnicodeCharacter --------------------------------------------------------
 
 bool ReadUnicodeCharacter(const char* src,
@@ -65,4 +536,72 @@ size_t WriteUnicodeCharacter(uint32_t code_point, std::string* output) {
   return char_offset - original_char_offset;
 }
 
+// Bulk conversions ------------------------------------------------------------
+
+bool UTF8ToUTF16(const char* src,
+                 size_t src_len,
+                 char16_t* dest,
+                 size_t* dest_len) {
+  return ConvertUTF8(src, src_len, dest, dest_len);
+}
+
+bool UTF16ToUTF8(const char16_t* src,
+                 size_t src_len,
+                 char* dest,
+                 size_t* dest_len) {
+  bool valid = true;
+  size_t char_index = 0u;
+  size_t dest_index = 0u;
+  while (char_index < src_len) {
+    if (src[char_index] < 0x80u) {
+      size_t length = CopyAsciiBlocks(src + char_index, src_len - char_index,
+                                      dest + dest_index);
+      char_index += length;
+      dest_index += length;
+      if (char_index == src_len)
+        break;
+    }
+    int32_t code_point;
+    FTL_U16_NEXT(src, char_index, src_len, code_point);
+    if (!IsValidCodepoint(code_point)) {
+      code_point = 0xfffd;
+      valid = false;
+    }
+    FTL_U8_APPEND_UNSAFE(dest, dest_index, code_point);
+  }
+  *dest_len = dest_index;
+  return valid;
+}
+
+bool UTF8ToUTF32(const char* src,
+                 size_t src_len,
+                 char32_t* dest,
+                 size_t* dest_len) {
+  return ConvertUTF8(src, src_len, dest, dest_len);
+}
+
+bool UTF8ToUTF16(StringView utf8, std::u16string* output) {
+  output->resize(MaxUTF16LengthForUTF8(utf8.size()));
+  size_t length;
+  bool valid = UTF8ToUTF16(utf8.data(), utf8.size(), &(*output)[0], &length);
+  output->resize(length);
+  return valid;
+}
+
+bool UTF16ToUTF8(const char16_t* src, size_t src_len, std::string* output) {
+  output->resize(MaxUTF8LengthForUTF16(src_len));
+  size_t length;
+  bool valid = UTF16ToUTF8(src, src_len, &(*output)[0], &length);
+  output->resize(length);
+  return valid;
+}
+
+bool UTF8ToUTF32(StringView utf8, std::u32string* output) {
+  output->resize(MaxUTF32LengthForUTF8(utf8.size()));
+  size_t length;
+  bool valid = UTF8ToUTF32(utf8.data(), utf8.size(), &(*output)[0], &length);
+  output->resize(length);
+  return valid;
+}
+
 }  // namespace ftl
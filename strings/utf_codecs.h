@@ -55,6 +55,56 @@ FTL_EXPORT bool ReadUnicodeCharacter(const char* src,
 FTL_EXPORT size_t WriteUnicodeCharacter(uint32_t code_point,
                                         std::string* output);
 
+// Bulk conversions ------------------------------------------------------------
+
+// These convert whole strings between UTF-8, UTF-16 (e.g., for Windows'
+// |wchar_t|) and UTF-32 (copying runs of ASCII a block at a time), into
+// caller-provided buffers or strings. They return false if the input isn't
+// valid, in which case each invalid sequence (or unpaired surrogate) is
+// replaced by U+FFFD. (Unlike |IsStringUTF8()|, they accept non-characters.)
+
+// The most code units that converting |length| code units from UTF-8 to
+// UTF-16 or UTF-32, or from UTF-16 to UTF-8, writes.
+constexpr size_t MaxUTF16LengthForUTF8(size_t length) {
+  return length;
+}
+constexpr size_t MaxUTF32LengthForUTF8(size_t length) {
+  return length;
+}
+constexpr size_t MaxUTF8LengthForUTF16(size_t length) {
+  return 3u * length;
+}
+
+// Converts the |src_len| bytes at |src| to |dest|, which must have room for
+// |MaxUTF16LengthForUTF8(src_len)| code units, and sets |*dest_len| to the
+// number written.
+FTL_EXPORT bool UTF8ToUTF16(const char* src,
+                            size_t src_len,
+                            char16_t* dest,
+                            size_t* dest_len);
+// Converts the |src_len| code units at |src| to |dest|, which must have room
+// for |MaxUTF8LengthForUTF16(src_len)| bytes, and sets |*dest_len| to the
+// number written.
+FTL_EXPORT bool UTF16ToUTF8(const char16_t* src,
+                            size_t src_len,
+                            char* dest,
+                            size_t* dest_len);
+// Converts the |src_len| bytes at |src| to |dest|, which must have room for
+// |MaxUTF32LengthForUTF8(src_len)| code points, and sets |*dest_len| to the
+// number written.
+FTL_EXPORT bool UTF8ToUTF32(const char* src,
+                            size_t src_len,
+                            char32_t* dest,
+                            size_t* dest_len);
+
+// Like the above, but replace the contents of |*output| (allocating at most
+// once).
+FTL_EXPORT bool UTF8ToUTF16(StringView utf8, std::u16string* output);
+FTL_EXPORT bool UTF16ToUTF8(const char16_t* src,
+                            size_t src_len,
+                            std::string* output);
+FTL_EXPORT bool UTF8ToUTF32(StringView utf8, std::u32string* output);
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_STRINGS_UTF_CODECS_H_
@@ -0,0 +1,35 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string>
+
+#include "lib/ftl/strings/utf_codecs.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_IsStringUTF8Ascii(benchmark::State& state) {
+  const std::string input(static_cast<size_t>(state.range(0)), 'a');
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(IsStringUTF8(input));
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(input.size()));
+}
+FTL_BENCHMARK(BM_IsStringUTF8Ascii)->Arg(16)->Arg(4096);
+
+void BM_IsStringUTF8Multibyte(benchmark::State& state) {
+  std::string input;
+  // "é", "€" and "😀", in turn.
+  while (input.size() < static_cast<size_t>(state.range(0)))
+    input += "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80";
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(IsStringUTF8(input));
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(input.size()));
+}
+FTL_BENCHMARK(BM_IsStringUTF8Multibyte)->Arg(16)->Arg(4096);
+
+}  // namespace
+}  // namespace ftl
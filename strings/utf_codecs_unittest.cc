@@ -0,0 +1,204 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/strings/utf_codecs.h"
+
+#include <stdlib.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+
+namespace ftl {
+namespace {
+
+// Validates |str| a code point at a time.
+bool IsStringUTF8Reference(const std::string& str) {
+  for (size_t i = 0; i < str.size(); i++) {
+    uint32_t code_point;
+    if (!ReadUnicodeCharacter(str.data(), str.size(), &i, &code_point) ||
+        !IsValidCharacter(code_point))
+      return false;
+  }
+  return true;
+}
+
+std::string Utf8(uint32_t code_point) {
+  std::string result;
+  WriteUnicodeCharacter(code_point, &result);
+  return result;
+}
+
+TEST(UtfCodecs, IsStringUTF8) {
+  EXPECT_TRUE(IsStringUTF8(""));
+  EXPECT_TRUE(IsStringUTF8("abc"));
+  EXPECT_TRUE(IsStringUTF8(std::string("a\0b", 3u)));
+  EXPECT_TRUE(IsStringUTF8("\xc2\x80 \xdf\xbf \xe0\xa0\x80 \xef\xbf\xbd"));
+  EXPECT_TRUE(IsStringUTF8("\xf0\x90\x80\x80 \xf4\x8f\xbf\xbd"));
+  // "ĥéłłø, 世界 👋"
+  EXPECT_TRUE(IsStringUTF8("\xc4\xa5\xc3\xa9\xc5\x82\xc5\x82\xc3\xb8, "
+                           "\xe4\xb8\x96\xe7\x95\x8c \xf0\x9f\x91\x8b"));
+
+  // Stray or missing continuation bytes.
+  EXPECT_FALSE(IsStringUTF8("\x80"));
+  EXPECT_FALSE(IsStringUTF8("a\xbf"));
+  EXPECT_FALSE(IsStringUTF8("\xc2"));
+  EXPECT_FALSE(IsStringUTF8("\xc2z"));
+  EXPECT_FALSE(IsStringUTF8("\xe0\xa0"));
+  EXPECT_FALSE(IsStringUTF8("\xf0\x90\x80"));
+  EXPECT_FALSE(IsStringUTF8("\xc2\x80\x80"));
+  // Invalid bytes.
+  EXPECT_FALSE(IsStringUTF8("\xf8\x88\x80\x80\x80"));
+  EXPECT_FALSE(IsStringUTF8("\xfe"));
+  EXPECT_FALSE(IsStringUTF8("\xff"));
+  // Overlong encodings.
+  EXPECT_FALSE(IsStringUTF8("\xc0\x80"));
+  EXPECT_FALSE(IsStringUTF8("\xc1\xbf"));
+  EXPECT_FALSE(IsStringUTF8("\xe0\x9f\xbf"));
+  EXPECT_FALSE(IsStringUTF8("\xf0\x8f\xbf\xbf"));
+  // Surrogates.
+  EXPECT_FALSE(IsStringUTF8("\xed\xa0\x80"));
+  EXPECT_FALSE(IsStringUTF8("\xed\xbf\xbf"));
+  EXPECT_TRUE(IsStringUTF8("\xed\x9f\xbf"));
+  // Beyond U+10FFFF.
+  EXPECT_FALSE(IsStringUTF8("\xf4\x90\x80\x80"));
+  EXPECT_FALSE(IsStringUTF8("\xf5\x80\x80\x80"));
+}
+
+TEST(UtfCodecs, IsStringUTF8NonCharacters) {
+  for (uint32_t code_point : {0xfdd0u, 0xfde5u, 0xfdefu, 0xfffeu, 0xffffu,
+                              0x1fffeu, 0x2ffffu, 0xffffeu, 0x10ffffu}) {
+    EXPECT_FALSE(IsStringUTF8(Utf8(code_point))) << code_point;
+    EXPECT_FALSE(IsStringUTF8(std::string(40u, 'a') + Utf8(code_point)))
+        << code_point;
+  }
+  for (uint32_t code_point : {0xfdcfu, 0xfdf0u, 0xfffdu, 0x1fffdu, 0x10fffdu,
+                              0xbffeu, 0x3bffu}) {
+    EXPECT_TRUE(IsStringUTF8(Utf8(code_point))) << code_point;
+  }
+}
+
+TEST(UtfCodecs, IsStringUTF8Lengths) {
+  // Put sequences at every offset (e.g., across the blocks that the validator
+  // may check at a time), and cut them off.
+  const std::string sequences[] = {"\xc3\xa9", "\xe4\xb8\x96",
+                                   "\xf0\x9f\x91\x8b"};
+  for (size_t offset = 0u; offset < 70u; offset++) {
+    for (const std::string& sequence : sequences) {
+      std::string str = std::string(offset, 'x') + sequence;
+      EXPECT_TRUE(IsStringUTF8(str)) << offset;
+      EXPECT_TRUE(IsStringUTF8(str + std::string(40u, 'y'))) << offset;
+      for (size_t cut = 1u; cut < sequence.size(); cut++) {
+        std::string truncated = str.substr(0u, str.size() - cut);
+        EXPECT_FALSE(IsStringUTF8(truncated)) << offset;
+        EXPECT_FALSE(IsStringUTF8(truncated + std::string(40u, 'y')))
+            << offset;
+      }
+    }
+  }
+}
+
+TEST(UtfCodecs, IsStringUTF8MatchesReference) {
+  const uint32_t kCodePoints[] = {0x0u,     0x41u,    0x7fu,    0x80u,
+                                  0x7ffu,   0x800u,   0xfffu,   0xd7ffu,
+                                  0xe000u,  0xfdcfu,  0xfdd0u,  0xfffdu,
+                                  0xfffeu,  0x10000u, 0x1fffeu, 0x10fffdu};
+  srand(42);
+  for (int i = 0; i < 20000; i++) {
+    std::string str;
+    size_t count = static_cast<size_t>(rand() % 40);
+    for (size_t j = 0u; j < count; j++) {
+      if (rand() % 2)
+        str += static_cast<char>(rand() % 0x80);
+      else
+        str += Utf8(kCodePoints[rand() % arraysize(kCodePoints)]);
+    }
+    // Corrupt some of the strings.
+    if (!str.empty() && rand() % 2)
+      str[rand() % str.size()] = static_cast<char>(rand() % 256);
+    EXPECT_EQ(IsStringUTF8Reference(str), IsStringUTF8(str)) << str;
+  }
+}
+
+TEST(UtfCodecs, UTF8ToUTF16) {
+  std::u16string utf16;
+  EXPECT_TRUE(UTF8ToUTF16("", &utf16));
+  EXPECT_EQ(u"", utf16);
+  EXPECT_TRUE(UTF8ToUTF16("hello, world", &utf16));
+  EXPECT_EQ(u"hello, world", utf16);
+  EXPECT_TRUE(UTF8ToUTF16("h\xc3\xa9llo \xe4\xb8\x96\xe7\x95\x8c "
+                          "\xf0\x9f\x91\x8b\xef\xbf\xbf",
+                          &utf16));
+  EXPECT_EQ(u"h\u00e9llo \u4e16\u754c \U0001f44b\uffff", utf16);
+
+  // Invalid sequences become U+FFFD.
+  EXPECT_FALSE(UTF8ToUTF16("a\x80" "b\xc3", &utf16));
+  EXPECT_EQ(u"a\ufffdb\ufffd", utf16);
+  EXPECT_FALSE(UTF8ToUTF16("\xed\xa0\x80!", &utf16));
+  EXPECT_EQ(u"\ufffd!", utf16);
+
+  // Into a buffer.
+  char16_t buffer[8];
+  size_t length = 0u;
+  EXPECT_TRUE(UTF8ToUTF16("\xf0\x9f\x91\x8b", 4u, buffer, &length));
+  ASSERT_EQ(2u, length);
+  EXPECT_EQ(0xd83du, buffer[0]);
+  EXPECT_EQ(0xdc4bu, buffer[1]);
+}
+
+TEST(UtfCodecs, UTF16ToUTF8) {
+  std::string utf8;
+  std::u16string utf16 = u"h\u00e9llo \u4e16\u754c \U0001f44b";
+  EXPECT_TRUE(UTF16ToUTF8(utf16.data(), utf16.size(), &utf8));
+  EXPECT_EQ("h\xc3\xa9llo \xe4\xb8\x96\xe7\x95\x8c \xf0\x9f\x91\x8b", utf8);
+  EXPECT_TRUE(UTF16ToUTF8(nullptr, 0u, &utf8));
+  EXPECT_EQ("", utf8);
+
+  // Unpaired surrogates become U+FFFD.
+  const char16_t unpaired[] = {'a', 0xd83d, 'b', 0xdc4b, 0xd83d};
+  EXPECT_FALSE(UTF16ToUTF8(unpaired, arraysize(unpaired), &utf8));
+  EXPECT_EQ("a\xef\xbf\xbd" "b\xef\xbf\xbd\xef\xbf\xbd", utf8);
+}
+
+TEST(UtfCodecs, UTF8ToUTF32) {
+  std::u32string utf32;
+  EXPECT_TRUE(UTF8ToUTF32("h\xc3\xa9llo \xf0\x9f\x91\x8b", &utf32));
+  EXPECT_EQ(U"h\u00e9llo \U0001f44b", utf32);
+  EXPECT_FALSE(UTF8ToUTF32("\xf4\x90\x80\x80", &utf32));
+  EXPECT_EQ(U"\ufffd", utf32);
+}
+
+TEST(UtfCodecs, BulkConversionsMatchReference) {
+  // Mix long runs of ASCII (which are copied a block at a time) with other
+  // characters, at every offset.
+  const uint32_t kCodePoints[] = {0x7fu, 0x80u, 0x7ffu, 0x800u, 0xfffeu,
+                                  0x10000u, 0x10ffffu};
+  srand(43);
+  for (int i = 0; i < 2000; i++) {
+    std::string utf8;
+    std::u32string expected;
+    size_t count = static_cast<size_t>(rand() % 80);
+    for (size_t j = 0u; j < count; j++) {
+      uint32_t code_point = rand() % 4
+                                ? static_cast<uint32_t>(rand() % 0x80)
+                                : kCodePoints[rand() % arraysize(kCodePoints)];
+      WriteUnicodeCharacter(code_point, &utf8);
+      expected += static_cast<char32_t>(code_point);
+    }
+
+    std::u32string utf32;
+    EXPECT_TRUE(UTF8ToUTF32(utf8, &utf32));
+    EXPECT_EQ(expected, utf32);
+
+    std::u16string utf16;
+    EXPECT_TRUE(UTF8ToUTF16(utf8, &utf16));
+    std::string round_trip;
+    EXPECT_TRUE(UTF16ToUTF8(utf16.data(), utf16.size(), &round_trip));
+    EXPECT_EQ(utf8, round_trip);
+  }
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,299 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/structured_log.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/ftl/debug/debugger.h"
+#include "lib/ftl/log_settings.h"
+#include "lib/ftl/synchronization/epoch.h"
+
+namespace ftl {
+
+namespace {
+
+// Builds a line on the stack, unless it gets long.
+class LineBuilder final {
+ public:
+  LineBuilder() {}
+
+  char* data() { return heap_.empty() ? stack_ : &heap_[0]; }
+  size_t size() const { return size_; }
+
+  void Append(const char* data, size_t size) {
+    if (heap_.empty() && size_ + size <= sizeof(stack_)) {
+      memcpy(stack_ + size_, data, size);
+    } else {
+      if (heap_.empty())
+        heap_.assign(stack_, size_);
+      heap_.append(data, size);
+    }
+    size_ += size;
+  }
+
+  void Append(StringView string) { Append(string.data(), string.size()); }
+  void Append(char c) { Append(&c, 1u); }
+
+ private:
+  char stack_[1024];
+  std::string heap_;
+  size_t size_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LineBuilder);
+};
+
+void AppendSeverity(LineBuilder* line, LogSeverity severity) {
+  static const char* const kNames[LOG_NUM_SEVERITIES] = {"INFO", "WARNING",
+                                                         "ERROR", "FATAL"};
+  if (severity >= LOG_INFO && severity < LOG_NUM_SEVERITIES) {
+    line->Append(StringView(kNames[severity]));
+  } else if (severity < LOG_INFO) {
+    char buffer[24];
+    line->Append(buffer, static_cast<size_t>(snprintf(
+                             buffer, sizeof(buffer), "VERBOSE%d", -severity)));
+  } else {
+    line->Append("UNKNOWN");
+  }
+}
+
+// As |LogMessage| does, only the name of the file for verbose and INFO
+// messages, or its path (without leading "../"s).
+StringView GetFileForSeverity(const internal::LogFile& file,
+                              LogSeverity severity) {
+  size_t size;
+  const char* part = file.ForSeverity(severity, &size);
+  return StringView(part, size);
+}
+
+void AppendUint64(LineBuilder* line, uint64_t value) {
+  char buffer[20];
+  char* end = buffer + sizeof(buffer);
+  char* digits = end;
+  do {
+    *--digits = static_cast<char>('0' + value % 10u);
+    value /= 10u;
+  } while (value);
+  line->Append(digits, static_cast<size_t>(end - digits));
+}
+
+void AppendInt64(LineBuilder* line, int64_t value) {
+  if (value < 0) {
+    line->Append('-');
+    AppendUint64(line, 0u - static_cast<uint64_t>(value));
+  } else {
+    AppendUint64(line, static_cast<uint64_t>(value));
+  }
+}
+
+// Appends the shortest of "%.15g" and "%.17g" which reads back as |value|.
+void AppendDouble(LineBuilder* line, double value) {
+  char buffer[32];
+  int size = snprintf(buffer, sizeof(buffer), "%.15g", value);
+  if (strtod(buffer, nullptr) != value)
+    size = snprintf(buffer, sizeof(buffer), "%.17g", value);
+  line->Append(buffer, static_cast<size_t>(size));
+}
+
+// logfmt ---------------------------------------------------------------------
+
+bool NeedsLogfmtQuotes(StringView value) {
+  if (value.empty())
+    return true;
+  for (char c : value) {
+    if (static_cast<unsigned char>(c) <= ' ' || c == '=' || c == '"' ||
+        c == '\\' || c == '\x7f')
+      return true;
+  }
+  return false;
+}
+
+void AppendLogfmtKey(LineBuilder* line, StringView key) {
+  for (char c : key) {
+    line->Append(static_cast<unsigned char>(c) <= ' ' || c == '=' || c == '"'
+                     ? '_'
+                     : c);
+  }
+}
+
+void AppendLogfmtString(LineBuilder* line, StringView value) {
+  if (!NeedsLogfmtQuotes(value)) {
+    line->Append(value);
+    return;
+  }
+  line->Append('"');
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        line->Append("\\\"");
+        break;
+      case '\\':
+        line->Append("\\\\");
+        break;
+      case '\n':
+        line->Append("\\n");
+        break;
+      case '\r':
+        line->Append("\\r");
+        break;
+      case '\t':
+        line->Append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < ' ' || c == '\x7f') {
+          char buffer[8];
+          line->Append(buffer, static_cast<size_t>(snprintf(
+                                   buffer, sizeof(buffer), "\\x%02x",
+                                   static_cast<unsigned char>(c))));
+        } else {
+          line->Append(c);
+        }
+    }
+  }
+  line->Append('"');
+}
+
+// JSON -----------------------------------------------------------------------
+
+void AppendJsonString(LineBuilder* line, StringView value) {
+  line->Append('"');
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        line->Append("\\\"");
+        break;
+      case '\\':
+        line->Append("\\\\");
+        break;
+      case '\n':
+        line->Append("\\n");
+        break;
+      case '\r':
+        line->Append("\\r");
+        break;
+      case '\t':
+        line->Append("\\t");
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < ' ') {
+          char buffer[8];
+          line->Append(buffer, static_cast<size_t>(snprintf(
+                                   buffer, sizeof(buffer), "\\u%04x",
+                                   static_cast<unsigned char>(c))));
+        } else {
+          line->Append(c);
+        }
+    }
+  }
+  line->Append('"');
+}
+
+}  // namespace
+
+StructuredLogMessage::StructuredLogMessage(LogSeverity severity,
+                                           const char* file,
+                                           int line)
+    : StructuredLogMessage(severity, internal::LogFile(file), line) {}
+
+StructuredLogMessage::StructuredLogMessage(LogSeverity severity,
+                                           const internal::LogFile& file,
+                                           int line)
+    : severity_(severity), file_(file), line_(line) {}
+
+StructuredLogMessage::~StructuredLogMessage() {
+  bool json;
+  {
+    Epoch epoch;
+    json = internal::GetCurrentLogSettings()->structured_log_format ==
+           StructuredLogFormat::kJson;
+  }
+  LineBuilder line;
+  if (json) {
+    line.Append("{\"severity\":\"");
+    AppendSeverity(&line, severity_);
+    line.Append("\",\"file\":");
+    AppendJsonString(&line, GetFileForSeverity(file_, severity_));
+    line.Append(",\"line\":");
+  } else {
+    line.Append("severity=");
+    AppendSeverity(&line, severity_);
+    line.Append(" file=");
+    AppendLogfmtString(&line, GetFileForSeverity(file_, severity_));
+    line.Append(" line=");
+  }
+  AppendInt64(&line, line_);
+
+  for (size_t i = 0u; i < field_count_; i++) {
+    const Field& f = field(i);
+    if (json) {
+      line.Append(',');
+      AppendJsonString(&line, f.key);
+      line.Append(':');
+    } else {
+      line.Append(' ');
+      AppendLogfmtKey(&line, f.key);
+      line.Append('=');
+    }
+    switch (f.type) {
+      case Field::Type::kInt64:
+        AppendInt64(&line, f.int64_value);
+        break;
+      case Field::Type::kUint64:
+        AppendUint64(&line, f.uint64_value);
+        break;
+      case Field::Type::kDouble:
+        if (isfinite(f.double_value))
+          AppendDouble(&line, f.double_value);
+        else if (json)
+          line.Append("null");
+        else if (isnan(f.double_value))
+          line.Append("NaN");
+        else
+          line.Append(f.double_value > 0.0 ? StringView("+Inf")
+                                            : StringView("-Inf"));
+        break;
+      case Field::Type::kBool:
+        line.Append(f.bool_value ? StringView("true") : StringView("false"));
+        break;
+      case Field::Type::kChar:
+      case Field::Type::kString: {
+        StringView value =
+            f.type == Field::Type::kChar
+                ? StringView(&f.char_value, 1u)
+                : StringView(f.string_value.data, f.string_value.size);
+        if (json)
+          AppendJsonString(&line, value);
+        else
+          AppendLogfmtString(&line, value);
+        break;
+      }
+    }
+  }
+  line.Append(json ? StringView("}\n") : StringView("\n"));
+
+  internal::WriteLogMessage(severity_, file_.file(), line_, line.data(),
+                            line.size(), 0u);
+  if (severity_ >= LOG_FATAL)
+    BreakDebugger();
+}
+
+StructuredLogMessage::Field* StructuredLogMessage::AddField(StringView key,
+                                                            Field::Type type) {
+  Field* field;
+  if (field_count_ < kInlineFields) {
+    field = &inline_fields_[field_count_];
+  } else {
+    more_fields_.emplace_back();
+    field = &more_fields_.back();
+  }
+  field_count_++;
+  field->key = key;
+  field->type = type;
+  return field;
+}
+
+}  // namespace ftl
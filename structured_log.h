@@ -0,0 +1,173 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Structured (key-value) logging, e.g.:
+//
+//   FTL_SLOG(INFO).With("msg", "request done").With("req", id).With("ms", ms);
+//
+// which logs one line of logfmt, or of JSON (see
+// |LogSettings::structured_log_format|), for log pipelines to parse:
+//
+//   severity=INFO file=server.cc line=12 msg="request done" req=42 ms=3.5
+//   {"severity":"INFO","file":"server.cc","line":12,"msg":"request done",...}
+//
+// Fields keep their types, and aren't formatted until the message is written:
+// strings are referred to rather than copied, so they (and the keys) must
+// outlive the statement, as temporaries do. As with FTL_LOG(), the fields
+// aren't evaluated if the severity is off.
+
+#ifndef LIB_FTL_STRUCTURED_LOG_H_
+#define LIB_FTL_STRUCTURED_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/log_level.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+class FTL_EXPORT StructuredLogMessage final {
+ public:
+  StructuredLogMessage(LogSeverity severity, const char* file, int line);
+  // (As the macros construct it, with |FTL_LOG_FILE|.)
+  StructuredLogMessage(LogSeverity severity,
+                       const internal::LogFile& file,
+                       int line);
+  ~StructuredLogMessage();
+
+  // Adds a field. Keys should be unique, and not "severity", "file" or
+  // "line".
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value &&
+                              std::is_signed<T>::value,
+                          StructuredLogMessage&>::type
+  With(StringView key, T value) {
+    Field* field = AddField(key, Field::Type::kInt64);
+    field->int64_value = value;
+    return *this;
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value &&
+                              !std::is_signed<T>::value,
+                          StructuredLogMessage&>::type
+  With(StringView key, T value) {
+    Field* field = AddField(key, Field::Type::kUint64);
+    field->uint64_value = value;
+    return *this;
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value,
+                          StructuredLogMessage&>::type
+  With(StringView key, T value) {
+    Field* field = AddField(key, Field::Type::kDouble);
+    field->double_value = static_cast<double>(value);
+    return *this;
+  }
+
+  StructuredLogMessage& With(StringView key, bool value) {
+    AddField(key, Field::Type::kBool)->bool_value = value;
+    return *this;
+  }
+
+  StructuredLogMessage& With(StringView key, char value) {
+    AddField(key, Field::Type::kChar)->char_value = value;
+    return *this;
+  }
+
+  StructuredLogMessage& With(StringView key, StringView value) {
+    Field* field = AddField(key, Field::Type::kString);
+    field->string_value.data = value.data();
+    field->string_value.size = value.size();
+    return *this;
+  }
+
+  StructuredLogMessage& With(StringView key, const char* value) {
+    return With(key, value ? StringView(value) : StringView("(null)"));
+  }
+
+  StructuredLogMessage& With(StringView key, const std::string& value) {
+    return With(key, StringView(value));
+  }
+
+ private:
+  struct Field {
+    enum class Type : uint8_t {
+      kInt64,
+      kUint64,
+      kDouble,
+      kBool,
+      kChar,
+      kString,
+    };
+
+    StringView key;
+    Type type;
+    union {
+      int64_t int64_value;
+      uint64_t uint64_value;
+      double double_value;
+      bool bool_value;
+      char char_value;
+      struct {
+        const char* data;
+        size_t size;
+      } string_value;
+    };
+  };
+
+  // Messages with more fields keep the rest in |more_fields_|.
+  static constexpr size_t kInlineFields = 8u;
+
+  Field* AddField(StringView key, Field::Type type);
+  const Field& field(size_t index) const {
+    return index < kInlineFields ? inline_fields_[index]
+                                 : more_fields_[index - kInlineFields];
+  }
+
+  const LogSeverity severity_;
+  const internal::LogFile file_;
+  const int line_;
+  size_t field_count_ = 0u;
+  Field inline_fields_[kInlineFields];
+  std::vector<Field> more_fields_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(StructuredLogMessage);
+};
+
+namespace internal {
+
+class StructuredLogMessageVoidify {
+ public:
+  void operator&(const StructuredLogMessage&) {}
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#define FTL_SLOG_AT(severity) \
+  ::ftl::StructuredLogMessage((severity), FTL_LOG_FILE, __LINE__)
+
+#define FTL_SLOG(severity)                                   \
+  !FTL_LOG_IS_ON(severity)                                   \
+      ? (void)0                                              \
+      : ::ftl::internal::StructuredLogMessageVoidify() &     \
+            FTL_SLOG_AT(::ftl::LOG_##severity)
+
+#define FTL_SVLOG(verbose_level)                             \
+  !FTL_VLOG_IS_ON(verbose_level)                             \
+      ? (void)0                                              \
+      : ::ftl::internal::StructuredLogMessageVoidify() &     \
+            FTL_SLOG_AT(-(verbose_level))
+
+#endif  // LIB_FTL_STRUCTURED_LOG_H_
@@ -0,0 +1,146 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/structured_log.h"
+
+#include <stdint.h>
+
+#include <limits>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/log_settings.h"
+
+namespace ftl {
+namespace {
+
+// Logs to a file in a temporary directory, in each test.
+class StructuredLogTest : public ::testing::Test {
+ protected:
+  StructuredLogTest() : old_settings_(GetLogSettings()) {}
+  ~StructuredLogTest() { SetLogSettings(old_settings_); }
+
+  void SetUp() override { SetFormat(StructuredLogFormat::kLogfmt); }
+
+  void SetFormat(StructuredLogFormat format) {
+    LogSettings settings;
+    settings.log_file = temp_dir_.path() + "/log";
+    settings.structured_log_format = format;
+    SetLogSettings(settings);
+  }
+
+  // Returns what was logged since the last call.
+  std::string TakeLog() {
+    FlushLog();
+    std::string log;
+    EXPECT_TRUE(files::ReadFileToString(temp_dir_.path() + "/log", &log));
+    std::string taken = log.substr(taken_);
+    taken_ = log.size();
+    return taken;
+  }
+
+ private:
+  LogSettings old_settings_;
+  files::ScopedTempDir temp_dir_;
+  size_t taken_ = 0u;
+};
+
+TEST_F(StructuredLogTest, Logfmt) {
+  const std::string name = "a name";
+  const int line = __LINE__ + 1;
+  FTL_SLOG(INFO)
+      .With("msg", "request done")
+      .With("req", 42)
+      .With("bytes", UINT64_MAX)
+      .With("ms", 3.5)
+      .With("ok", true)
+      .With("grade", 'b')
+      .With("name", name)
+      .With("view", StringView("v"));
+  EXPECT_EQ("severity=INFO file=structured_log_unittest.cc line=" +
+                std::to_string(line) +
+                " msg=\"request done\" req=42 bytes=18446744073709551615 "
+                "ms=3.5 ok=true grade=b name=\"a name\" view=v\n",
+            TakeLog());
+
+  FTL_SLOG(WARNING)
+      .With("quoted", "say \"hi\"\\\n")
+      .With("empty", "")
+      .With("control", "\x01")
+      .With("bad key=", 1)
+      .With("tenth", 0.1)
+      .With("nan", std::numeric_limits<double>::quiet_NaN())
+      .With("inf", -std::numeric_limits<double>::infinity());
+  std::string log = TakeLog();
+  EXPECT_EQ(0u, log.find("severity=WARNING file="));
+  EXPECT_NE(std::string::npos,
+            log.find(" quoted=\"say \\\"hi\\\"\\\\\\n\" empty=\"\" "
+                     "control=\"\\x01\" bad_key_=1 tenth=0.1 nan=NaN "
+                     "inf=-Inf\n"))
+      << log;
+}
+
+TEST_F(StructuredLogTest, Json) {
+  SetFormat(StructuredLogFormat::kJson);
+  const int line = __LINE__ + 1;
+  FTL_SLOG(ERROR)
+      .With("msg", "a \"b\"\n\x01")
+      .With("n", -7)
+      .With("x", 0.25)
+      .With("inf", std::numeric_limits<double>::infinity())
+      .With("no", false);
+  std::string log = TakeLog();
+  EXPECT_EQ(0u, log.find("{\"severity\":\"ERROR\",\"file\":\"")) << log;
+  EXPECT_NE(std::string::npos,
+            log.find("structured_log_unittest.cc\",\"line\":" +
+                     std::to_string(line) +
+                     ",\"msg\":\"a \\\"b\\\"\\n\\u0001\",\"n\":-7,"
+                     "\"x\":0.25,\"inf\":null,\"no\":false}\n"))
+      << log;
+}
+
+TEST_F(StructuredLogTest, ManyFields) {
+  FTL_SLOG(INFO)
+      .With("f0", 0)
+      .With("f1", 1)
+      .With("f2", 2)
+      .With("f3", 3)
+      .With("f4", 4)
+      .With("f5", 5)
+      .With("f6", 6)
+      .With("f7", 7)
+      .With("f8", 8)
+      .With("f9", 9);
+  std::string log = TakeLog();
+  EXPECT_NE(std::string::npos,
+            log.find(" f0=0 f1=1 f2=2 f3=3 f4=4 f5=5 f6=6 f7=7 f8=8 f9=9\n"))
+      << log;
+
+  const std::string large(5000u, 'x');
+  FTL_SLOG(INFO).With("large", large).With("after", 1);
+  EXPECT_NE(std::string::npos,
+            TakeLog().find(" large=" + large + " after=1\n"));
+}
+
+TEST_F(StructuredLogTest, Disabled) {
+  int evaluated = 0;
+  FTL_SVLOG(10).With("n", ++evaluated);
+  LogSettings settings = GetLogSettings();
+  settings.min_log_level = LOG_ERROR;
+  SetLogSettings(settings);
+  FTL_SLOG(WARNING).With("n", ++evaluated);
+  EXPECT_EQ(0, evaluated);
+  EXPECT_EQ(std::string(), TakeLog());
+
+  settings.min_log_level = -2;
+  SetLogSettings(settings);
+  FTL_SVLOG(2).With("n", ++evaluated);
+  EXPECT_EQ(1, evaluated);
+  EXPECT_EQ(0u, TakeLog().find("severity=VERBOSE2 "));
+}
+
+}  // namespace
+}  // namespace ftl
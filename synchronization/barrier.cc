@@ -0,0 +1,35 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/barrier.h"
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/synchronization/wait_on_address.h"
+
+namespace ftl {
+
+Barrier::Barrier(uint32_t thread_count)
+    : thread_count_(thread_count), remaining_(thread_count), phase_(0u) {
+  FTL_DCHECK(thread_count_ > 0u);
+}
+
+Barrier::~Barrier() {}
+
+bool Barrier::ArriveAndWait() {
+  // The phase can't end until we've arrived, so this is the current one.
+  uint32_t phase = phase_.load(std::memory_order_acquire);
+  if (remaining_.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+    // Threads only start the next phase once they see |phase_| change, so they
+    // see the reset count.
+    remaining_.store(thread_count_, std::memory_order_relaxed);
+    phase_.fetch_add(1u, std::memory_order_release);
+    internal::WakeByAddressAll(&phase_);
+    return true;
+  }
+  while (phase_.load(std::memory_order_acquire) == phase)
+    internal::WaitOnAddress(&phase_, phase, TimePoint::Max());
+  return false;
+}
+
+}  // namespace ftl
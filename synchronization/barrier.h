@@ -0,0 +1,47 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A reusable thread barrier class.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_BARRIER_H_
+#define LIB_FTL_SYNCHRONIZATION_BARRIER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// A barrier for a fixed number of threads, which each |ArriveAndWait()| until
+// all of them have arrived; then they're all released, and the barrier is
+// ready for the next phase (e.g., the next step of an iterative computation).
+// Arriving is a single atomic operation, and the waiters block on the phase
+// number itself (a futex on Linux). This class is thread-safe.
+class FTL_EXPORT Barrier final {
+ public:
+  // |thread_count| must be positive.
+  explicit Barrier(uint32_t thread_count);
+  ~Barrier();
+
+  // Blocks until |thread_count| threads (including this one) have called this
+  // in the current phase. Returns true in exactly one of them (the last to
+  // arrive), e.g., so that it can do per-phase work while the others go on.
+  bool ArriveAndWait();
+
+ private:
+  const uint32_t thread_count_;
+  // The number of threads yet to arrive in the current phase.
+  std::atomic<uint32_t> remaining_;
+  // Incremented (by the last thread to arrive) at the end of each phase.
+  std::atomic<uint32_t> phase_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Barrier);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_BARRIER_H_
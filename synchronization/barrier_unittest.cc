@@ -0,0 +1,54 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/barrier.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+constexpr uint32_t kNumThreads = 4u;
+constexpr uint32_t kNumPhases = 100u;
+
+TEST(BarrierTest, SingleThread) {
+  Barrier barrier(1u);
+  EXPECT_TRUE(barrier.ArriveAndWait());
+  EXPECT_TRUE(barrier.ArriveAndWait());
+}
+
+TEST(BarrierTest, Phases) {
+  Barrier barrier(kNumThreads);
+  std::atomic<uint32_t> arrived(0u);
+  std::atomic<uint32_t> serial_count(0u);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0u; i < kNumThreads; i++) {
+    threads.push_back(std::thread([&barrier, &arrived, &serial_count]() {
+      for (uint32_t phase = 0u; phase < kNumPhases; phase++) {
+        arrived.fetch_add(1u, std::memory_order_relaxed);
+        if (barrier.ArriveAndWait())
+          serial_count.fetch_add(1u, std::memory_order_relaxed);
+        // Everybody has arrived in this phase, but nobody can have arrived in
+        // the next one until we do.
+        uint32_t count = arrived.load(std::memory_order_relaxed);
+        EXPECT_GE(count, (phase + 1u) * kNumThreads);
+        EXPECT_LT(count, (phase + 2u) * kNumThreads);
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kNumPhases * kNumThreads, arrived.load());
+  // Exactly one thread per phase is told that it arrived last.
+  EXPECT_EQ(kNumPhases, serial_count.load());
+}
+
+}  // namespace
+}  // namespace ftl
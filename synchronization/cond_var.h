@@ -20,6 +20,7 @@
 #include "lib/ftl/macros.h"
 #include "lib/ftl/synchronization/thread_annotations.h"
 #include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 
@@ -47,13 +48,20 @@ class FTL_EXPORT CondVar final {
   // non-specific: the condition variable may or may not have been signaled and
   // |timeout_microseconds| may or may not have already elapsed (spurious
   // wakeups are possible).
-  // TODO(vtl): A version with an absolute deadline time would be more efficient
-  // for users who want to wait to be signaled or a timeout to have definitely
-  // elapsed. With this API, users have to recalculate the timeout when they
-  // detect a spurious wakeup.
   bool WaitWithTimeout(Mutex* mutex, TimeDelta timeout)
       FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
 
+  // Like |Wait()|, but will also unblock when |TimePoint::Now()| reaches
+  // |deadline| (|TimePoint::Max()| means never). Returns true on timeout, with
+  // the same caveat as |WaitWithTimeout()|; unlike with it, the same |deadline|
+  // can simply be passed again after a spurious wakeup:
+  //   while (!<my_condition>) {
+  //     if (cv.WaitUntil(&my_mutex, deadline))
+  //       <timed out>;
+  //   }
+  bool WaitUntil(Mutex* mutex, TimePoint deadline)
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex);
+
   // Signals this condition variable, waking at least one waiting thread if
   // there are any.
   void Signal();
@@ -21,42 +21,11 @@
 namespace ftl {
 namespace {
 
-// Helper for |CondVar::WaitWithTimeout()|. Returns true on (definite) time-out.
-// |timeout_rel| must be small enough to not overflow when added to
-// |TimePoint::now()|.
-bool RelativeTimedWait(TimeDelta timeout_rel,
-                       pthread_cond_t* posix_cond_var,
-                       pthread_mutex_t* posix_mutex) {
-// Mac has a function to do a relative timed wait directly.
-#if defined(OS_MACOSX)
-  struct timespec timespec_rel = timeout_rel.ToTimespec();
-
-  int error = pthread_cond_timedwait_relative_np(posix_cond_var, posix_mutex,
-                                                 &timespec_rel);
-  FTL_DCHECK_WITH_ERRNO(error == 0 || error == ETIMEDOUT || error == EINTR,
-                        "pthread_cond_timedwait_relative_np", error);
-  return error == ETIMEDOUT;
-#else
-  TimePoint timeout_abs = TimePoint::Now() + timeout_rel;
-
-  struct timespec timespec_abs = (timeout_abs - TimePoint()).ToTimespec();
-
-  int error;
-// Older Android doesn't have |pthread_condattr_setclock()|, but they have
-// |pthread_cond_timedwait_monotonic_np()|.
-#if defined(OS_ANDROID) && defined(HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC)
-  error = pthread_cond_timedwait_monotonic_np(posix_cond_var, posix_mutex,
-                                              &timespec_abs);
-  FTL_DCHECK_WITH_ERRNO(error == 0 || error == ETIMEDOUT || error == EINTR,
-                        "pthread_cond_timedwait_monotonic_np", error);
-#else
-  error = pthread_cond_timedwait(posix_cond_var, posix_mutex, &timespec_abs);
-  FTL_DCHECK_WITH_ERRNO(error == 0 || error == ETIMEDOUT || error == EINTR,
-                        "pthread_cond_timedwait", error);
-#endif  // defined(OS_ANDROID) && defined(HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC)
-  return error == ETIMEDOUT;
-#endif  // defined(OS_MACOSX)
-}
+// Turn very long waits into "forever". This isn't a huge concern if |time_t|
+// is 64-bit, but overflowing |time_t| is a real risk if it's only 32-bit.
+// (2^31 / 16 seconds = ~4.25 years, so we won't risk overflowing until 2033.)
+constexpr TimeDelta kForeverThreshold =
+    TimeDelta::FromSeconds(std::numeric_limits<int32_t>::max() / 16);
 
 }  // namespace
 
@@ -89,25 +58,78 @@ void CondVar::Wait(Mutex* mutex) {
   FTL_DCHECK(mutex);
   mutex->AssertHeld();
 
+#if defined(FTL_MUTEX_PROFILING)
+  mutex->WillWait();
+#endif
   int error = pthread_cond_wait(&impl_, &mutex->impl_);
   FTL_DCHECK_WITH_ERRNO(!error, "pthread_cond_wait", error);
+#if defined(FTL_MUTEX_PROFILING)
+  mutex->DidWait();
+#endif
 }
 
 bool CondVar::WaitWithTimeout(Mutex* mutex, TimeDelta timeout) {
-  // Turn very long waits into "forever". This isn't a huge concern if |time_t|
-  // is 64-bit, but overflowing |time_t| is a real risk if it's only 32-bit.
-  // (2^31 / 16 seconds = ~4.25 years, so we won't risk overflowing until 2033.)
-  constexpr TimeDelta kForeverThreshold =
-      TimeDelta::FromSeconds(std::numeric_limits<int32_t>::max() / 16);
   if (timeout >= kForeverThreshold) {
     Wait(mutex);
     return false;  // Did *not* time out.
   }
 
+  return WaitUntil(mutex, TimePoint::Now() + timeout);
+}
+
+bool CondVar::WaitUntil(Mutex* mutex, TimePoint deadline) {
   FTL_DCHECK(mutex);
   mutex->AssertHeld();
 
-  return RelativeTimedWait(timeout, &impl_, &mutex->impl_);
+  // Also turn deadlines that are very far in the future (in particular,
+  // |TimePoint::Max()|) into "forever"; see above. (This is by the time left,
+  // not by the deadline itself, which grows with the system's uptime.)
+  const TimePoint now = TimePoint::Now();
+  if (deadline > now && deadline - now >= kForeverThreshold) {
+    Wait(mutex);
+    return false;  // Did *not* time out.
+  }
+
+// Mac can't wait until a deadline on the monotonic clock, but has a function to
+// do a relative timed wait directly.
+#if defined(OS_MACOSX)
+  if (now >= deadline)
+    return true;
+#endif
+
+#if defined(FTL_MUTEX_PROFILING)
+  mutex->WillWait();
+#endif
+  int error;
+#if defined(OS_MACOSX)
+  struct timespec timespec_rel = (deadline - now).ToTimespec();
+  error = pthread_cond_timedwait_relative_np(&impl_, &mutex->impl_,
+                                             &timespec_rel);
+  FTL_DCHECK_WITH_ERRNO(error == 0 || error == ETIMEDOUT || error == EINTR,
+                        "pthread_cond_timedwait_relative_np", error);
+#else
+  // |TimePoint| is on the monotonic clock, which is the clock that |impl_| uses
+  // (see the constructor), so |deadline| can be used as is.
+  if (deadline < TimePoint())
+    deadline = TimePoint();
+  struct timespec timespec_abs = (deadline - TimePoint()).ToTimespec();
+// Older Android doesn't have |pthread_condattr_setclock()|, but they have
+// |pthread_cond_timedwait_monotonic_np()|.
+#if defined(OS_ANDROID) && defined(HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC)
+  error = pthread_cond_timedwait_monotonic_np(&impl_, &mutex->impl_,
+                                              &timespec_abs);
+  FTL_DCHECK_WITH_ERRNO(error == 0 || error == ETIMEDOUT || error == EINTR,
+                        "pthread_cond_timedwait_monotonic_np", error);
+#else
+  error = pthread_cond_timedwait(&impl_, &mutex->impl_, &timespec_abs);
+  FTL_DCHECK_WITH_ERRNO(error == 0 || error == ETIMEDOUT || error == EINTR,
+                        "pthread_cond_timedwait", error);
+#endif  // defined(OS_ANDROID) && defined(HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC)
+#endif  // defined(OS_MACOSX)
+#if defined(FTL_MUTEX_PROFILING)
+  mutex->DidWait();
+#endif
+  return error == ETIMEDOUT;
 }
 
 void CondVar::Signal() {
@@ -17,6 +17,7 @@
 #include "lib/ftl/synchronization/mutex.h"
 #include "lib/ftl/test/timeout_tolerance.h"
 #include "lib/ftl/time/stopwatch.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 namespace {
@@ -160,6 +161,49 @@ TEST(CondVarTest, Timeouts) {
   }
 }
 
+TEST(CondVarTest, WaitUntil) {
+  Mutex mu;
+  CondVar cv;
+
+  MutexLocker locker(&mu);
+
+  // Deadlines that have already passed time out immediately.
+  EXPECT_TRUE(cv.WaitUntil(&mu, TimePoint()));
+  EXPECT_TRUE(cv.WaitUntil(&mu, TimePoint::Now()));
+
+  // Keep waiting until the same deadline, as a caller dealing with spurious
+  // wakeups would.
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  TimePoint start = TimePoint::Now();
+  TimePoint deadline = start + timeout;
+  while (!cv.WaitUntil(&mu, deadline))
+    continue;
+  TimeDelta elapsed = TimePoint::Now() - start;
+  EXPECT_GE(elapsed, timeout - kTimeoutTolerance);
+  EXPECT_LT(elapsed, timeout + kEpsilonTimeout);
+}
+
+TEST(CondVarTest, WaitUntilSignaled) {
+  Mutex mu;
+  CondVar cv;
+  bool signaled = false;
+
+  std::thread thread([&mu, &cv, &signaled]() {
+    EpsilonRandomSleep();
+    MutexLocker locker(&mu);
+    signaled = true;
+    cv.Signal();
+  });
+
+  {
+    MutexLocker locker(&mu);
+    // Also checks that |TimePoint::Max()| doesn't overflow.
+    while (!signaled)
+      EXPECT_FALSE(cv.WaitUntil(&mu, TimePoint::Max()));
+  }
+  thread.join();
+}
+
 // TODO(vtl): Test that |Signal()| (usually) wakes only one waiter.
 
 }  // namespace
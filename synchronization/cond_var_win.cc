@@ -23,6 +23,9 @@ void CondVar::Wait(Mutex* mutex) {
 bool CondVar::WaitWithTimeout(Mutex* mutex, TimeDelta timeout) {
   int64_t duration = timeout.ToMilliseconds();
   bool timed_out = false;
+#if defined(FTL_MUTEX_PROFILING)
+  mutex->WillWait();
+#endif
 #ifndef NDEBUG
   mutex->CheckHeldAndUnmark();
 #endif
@@ -37,10 +40,27 @@ bool CondVar::WaitWithTimeout(Mutex* mutex, TimeDelta timeout) {
   }
 #ifndef NDEBUG
   mutex->CheckUnheldAndMark();
+#endif
+#if defined(FTL_MUTEX_PROFILING)
+  mutex->DidWait();
 #endif
   return timed_out;
 }
 
+bool CondVar::WaitUntil(Mutex* mutex, TimePoint deadline) {
+  if (deadline == TimePoint::Max()) {
+    Wait(mutex);
+    return false;  // Did *not* time out.
+  }
+
+  TimePoint now = TimePoint::Now();
+  if (now >= deadline)
+    return true;
+  // |WaitWithTimeout()| truncates to milliseconds, so it may return (with a
+  // timeout) slightly before |deadline|; don't report that as a timeout.
+  return WaitWithTimeout(mutex, deadline - now) && TimePoint::Now() >= deadline;
+}
+
 void CondVar::Signal() {
   WakeConditionVariable(&cv_);
 }
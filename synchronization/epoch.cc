@@ -0,0 +1,225 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/epoch.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+#include "lib/ftl/synchronization/mutex.h"
+
+// This is the classic scheme: there's a global epoch, and each thread in an
+// |Epoch| announces the global epoch it saw. The global epoch may only advance
+// when every such thread has seen the current one, so once it has advanced
+// twice past the epoch in which an object was retired, no reader which might
+// have loaded the object is left.
+
+namespace ftl {
+namespace internal {
+namespace {
+
+// Retire objects this often (per thread) before trying to reclaim them.
+constexpr size_t kReclaimInterval = 64u;
+
+struct RetiredObject {
+  void* object;
+  void (*deleter)(void*);
+  // The global epoch when |object| was retired.
+  uint64_t epoch;
+};
+
+// A thread's record. These are never freed, but are reused by new threads.
+struct EpochRecord {
+  // (The global epoch seen << 1) | 1 while the thread is in an |Epoch|, or 0.
+  std::atomic<uint64_t> state;
+  std::atomic<bool> in_use;
+  // Immutable once the record is published.
+  EpochRecord* next;
+
+  // Only used by the thread that owns the record:
+  uint32_t depth;
+  std::vector<RetiredObject> retired;
+
+  // Keeps the next allocation off |state|'s cache line.
+  char padding[kCacheLineSize];
+};
+
+std::atomic<uint64_t> g_epoch(1u);
+std::atomic<EpochRecord*> g_records(nullptr);
+
+thread_local EpochRecord* g_current_record = nullptr;
+
+// Objects retired by threads that exited before they could be deleted.
+struct Orphans {
+  Mutex mutex;
+  std::vector<RetiredObject> objects FTL_GUARDED_BY(mutex);
+  std::atomic<bool> empty{true};
+};
+
+Orphans* GetOrphans() {
+  static Orphans* orphans = new Orphans();
+  return orphans;
+}
+
+// Advances the global epoch if every thread in an |Epoch| has seen the current
+// one, returning true if it was (or is now) advanced.
+bool TryAdvanceEpoch() {
+  uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  for (EpochRecord* record = g_records.load(std::memory_order_acquire); record;
+       record = record->next) {
+    uint64_t state = record->state.load(std::memory_order_relaxed);
+    if ((state & 1u) && (state >> 1) != epoch)
+      return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  g_epoch.compare_exchange_strong(epoch, epoch + 1u,
+                                  std::memory_order_release,
+                                  std::memory_order_relaxed);
+  return true;
+}
+
+// Moves the objects in |objects| which can be deleted to the returned vector.
+std::vector<RetiredObject> TakeReclaimable(
+    std::vector<RetiredObject>* objects) {
+  uint64_t epoch = g_epoch.load(std::memory_order_acquire);
+  std::vector<RetiredObject> reclaimable;
+  size_t kept = 0u;
+  for (const auto& retired : *objects) {
+    if (retired.epoch + 2u <= epoch)
+      reclaimable.push_back(retired);
+    else
+      (*objects)[kept++] = retired;
+  }
+  objects->resize(kept);
+  return reclaimable;
+}
+
+void Delete(const std::vector<RetiredObject>& objects) {
+  // Deleters may retire more objects, which is why they're only run here.
+  for (const auto& retired : objects)
+    retired.deleter(retired.object);
+}
+
+void Reclaim(EpochRecord* record) {
+  TryAdvanceEpoch();
+  Delete(TakeReclaimable(&record->retired));
+
+  Orphans* orphans = GetOrphans();
+  if (orphans->empty.load(std::memory_order_relaxed))
+    return;
+  std::vector<RetiredObject> reclaimable;
+  {
+    MutexLocker locker(&orphans->mutex);
+    reclaimable = TakeReclaimable(&orphans->objects);
+    orphans->empty.store(orphans->objects.empty(), std::memory_order_relaxed);
+  }
+  Delete(reclaimable);
+}
+
+// Releases the current thread's record when it exits.
+class RecordReleaser final {
+ public:
+  RecordReleaser() {}
+
+  ~RecordReleaser() {
+    EpochRecord* record = g_current_record;
+    FTL_DCHECK(!record->depth);
+    Reclaim(record);
+    if (!record->retired.empty()) {
+      Orphans* orphans = GetOrphans();
+      MutexLocker locker(&orphans->mutex);
+      orphans->objects.insert(orphans->objects.end(), record->retired.begin(),
+                              record->retired.end());
+      orphans->empty.store(false, std::memory_order_relaxed);
+      record->retired.clear();
+    }
+    g_current_record = nullptr;
+    record->in_use.store(false, std::memory_order_release);
+  }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(RecordReleaser);
+};
+
+EpochRecord* AcquireRecord() {
+  EpochRecord* record = g_records.load(std::memory_order_acquire);
+  for (; record; record = record->next) {
+    bool in_use = false;
+    if (!record->in_use.load(std::memory_order_relaxed) &&
+        record->in_use.compare_exchange_strong(in_use, true,
+                                               std::memory_order_acquire)) {
+      break;
+    }
+  }
+  if (!record) {
+    record = new EpochRecord();
+    record->state.store(0u, std::memory_order_relaxed);
+    record->in_use.store(true, std::memory_order_relaxed);
+    record->depth = 0u;
+    record->next = g_records.load(std::memory_order_relaxed);
+    while (!g_records.compare_exchange_weak(record->next, record,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+    }
+  }
+
+  static thread_local RecordReleaser releaser;
+  return record;
+}
+
+EpochRecord* CurrentRecord() {
+  if (!g_current_record)
+    g_current_record = AcquireRecord();
+  return g_current_record;
+}
+
+}  // namespace
+
+void EnterEpoch() {
+  EpochRecord* record = CurrentRecord();
+  if (record->depth++)
+    return;
+  uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+  record->state.store((epoch << 1) | 1u, std::memory_order_relaxed);
+  // Orders the announcement before the reader's loads (this is a fence, not a
+  // read-modify-write on a shared cache line).
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void ExitEpoch() {
+  EpochRecord* record = g_current_record;
+  FTL_DCHECK(record && record->depth);
+  if (!--record->depth)
+    record->state.store(0u, std::memory_order_release);
+}
+
+void RetireObject(void* object, void (*deleter)(void*)) {
+  EpochRecord* record = CurrentRecord();
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  record->retired.push_back(
+      {object, deleter, g_epoch.load(std::memory_order_relaxed)});
+  if (record->retired.size() % kReclaimInterval == 0u)
+    Reclaim(record);
+}
+
+}  // namespace internal
+
+void SynchronizeEpochs() {
+  internal::EpochRecord* record = internal::CurrentRecord();
+  FTL_DCHECK(!record->depth);
+  uint64_t target = internal::g_epoch.load(std::memory_order_relaxed) + 2u;
+  while (internal::g_epoch.load(std::memory_order_relaxed) < target) {
+    if (!internal::TryAdvanceEpoch())
+      std::this_thread::yield();
+  }
+  internal::Reclaim(record);
+}
+
+}  // namespace ftl
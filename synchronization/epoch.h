@@ -0,0 +1,76 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Epoch-based reclamation, for freeing objects that lock-free readers may still
+// be using.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_EPOCH_H_
+#define LIB_FTL_SYNCHRONIZATION_EPOCH_H_
+
+#include <type_traits>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+namespace internal {
+
+FTL_EXPORT void EnterEpoch();
+FTL_EXPORT void ExitEpoch();
+FTL_EXPORT void RetireObject(void* object, void (*deleter)(void*));
+
+}  // namespace internal
+
+// Epoch -----------------------------------------------------------------------
+
+// A scoped read-side critical section: objects which are unlinked from a shared
+// structure and passed to |Retire()| aren't deleted until every |Epoch| which
+// was alive at the time has been destroyed. So a reader may load a pointer
+// from a shared structure (see, e.g., |RcuPtr|) and use it until the end of its
+// |Epoch|:
+//
+//   {
+//     Epoch epoch;
+//     const Config* config = g_config.Get();
+//     ... use |config| ...
+//   }
+//
+// Entering and leaving an epoch does no atomic read-modify-write operations:
+// it writes only a per-thread record, and otherwise just reads the (rarely
+// written) global epoch, so readers on different cores don't contend. |Epoch|s
+// may be nested. Blocking for a long time inside one delays all reclamation
+// (though it doesn't block writers).
+class FTL_EXPORT Epoch final {
+ public:
+  Epoch() { internal::EnterEpoch(); }
+  ~Epoch() { internal::ExitEpoch(); }
+
+ private:
+  FTL_DISALLOW_COPY_AND_ASSIGN(Epoch);
+};
+
+// Retire() --------------------------------------------------------------------
+
+// Deletes |object| (with |delete|) once no |Epoch| which might be using it is
+// alive. Call this only after |object| has been made unreachable for new
+// readers. Retired objects are reclaimed in batches, by the threads that retire
+// them; |object| may be deleted on another thread if this one exits first.
+template <typename T>
+void Retire(T* object) {
+  using MutableT = typename std::remove_cv<T>::type;
+  if (!object)
+    return;
+  internal::RetireObject(const_cast<MutableT*>(object), [](void* to_delete) {
+    delete static_cast<MutableT*>(to_delete);
+  });
+}
+
+// Waits until every |Epoch| which is alive has been destroyed, and then deletes
+// everything this thread has retired. This may not be called inside an
+// |Epoch|. (This is mostly useful for tests and shutdown, since it's slow.)
+FTL_EXPORT void SynchronizeEpochs();
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_EPOCH_H_
@@ -0,0 +1,115 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/epoch.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/latch.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+namespace {
+
+// Sets |*deleted| when deleted.
+class Tracked {
+ public:
+  explicit Tracked(std::atomic<bool>* deleted) : deleted_(deleted) {}
+  ~Tracked() { deleted_->store(true); }
+
+ private:
+  std::atomic<bool>* const deleted_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Tracked);
+};
+
+// Retires another |Tracked| when deleted.
+class RetiresOnDelete {
+ public:
+  explicit RetiresOnDelete(std::atomic<bool>* deleted) : deleted_(deleted) {}
+  ~RetiresOnDelete() { Retire(new Tracked(deleted_)); }
+
+ private:
+  std::atomic<bool>* const deleted_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RetiresOnDelete);
+};
+
+TEST(EpochTest, RetireAndSynchronize) {
+  std::atomic<bool> deleted(false);
+  {
+    Epoch epoch;
+    Epoch nested;
+    Retire(new Tracked(&deleted));
+    Retire(static_cast<Tracked*>(nullptr));
+  }
+  SynchronizeEpochs();
+  EXPECT_TRUE(deleted.load());
+
+  // Objects retired by deleters are also reclaimed.
+  std::atomic<bool> inner_deleted(false);
+  Retire(new RetiresOnDelete(&inner_deleted));
+  SynchronizeEpochs();
+  SynchronizeEpochs();
+  EXPECT_TRUE(inner_deleted.load());
+
+  const Tracked* const_object = new Tracked(&deleted);
+  deleted.store(false);
+  Retire(const_object);
+  SynchronizeEpochs();
+  EXPECT_TRUE(deleted.load());
+}
+
+TEST(EpochTest, WaitsForReaders) {
+  std::atomic<bool> deleted(false);
+  Latch entered(1u);
+  std::thread reader([&deleted, &entered]() {
+    Epoch epoch;
+    entered.CountDown();
+    SleepFor(TimeDelta::FromMilliseconds(20));
+    EXPECT_FALSE(deleted.load());
+  });
+  entered.Wait();
+  Retire(new Tracked(&deleted));
+  SynchronizeEpochs();
+  EXPECT_TRUE(deleted.load());
+  reader.join();
+}
+
+TEST(EpochTest, ReclaimsObjectsOfExitedThreads) {
+  constexpr int kNumObjects = 10;
+  std::atomic<bool> deleted[kNumObjects];
+  for (auto& flag : deleted)
+    flag.store(false);
+
+  // Leaves its objects behind (too few to trigger reclamation).
+  std::thread thread([&deleted]() {
+    for (auto& flag : deleted)
+      Retire(new Tracked(&flag));
+  });
+  thread.join();
+
+  SynchronizeEpochs();
+  for (const auto& flag : deleted)
+    EXPECT_TRUE(flag.load());
+}
+
+TEST(EpochTest, ReclaimsWithoutSynchronizing) {
+  constexpr int kNumObjects = 1000;
+  std::vector<std::atomic<bool>> deleted(kNumObjects);
+  for (auto& flag : deleted)
+    flag.store(false);
+  for (auto& flag : deleted)
+    Retire(new Tracked(&flag));
+  // Reclamation is batched, so at least the first objects have been deleted.
+  EXPECT_TRUE(deleted[0].load());
+  SynchronizeEpochs();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,89 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/event_count.h"
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/synchronization/wait_on_address.h"
+
+#if defined(OS_WIN)
+#include <windows.h>
+#endif
+
+namespace ftl {
+
+constexpr int EventCount::kSpinCount;
+
+EventCount::EventCount() : epoch_(0u), waiter_count_(0u) {}
+
+EventCount::~EventCount() {
+  FTL_DCHECK(!waiter_count_.load(std::memory_order_relaxed));
+}
+
+EventCount::Key EventCount::PrepareWait() {
+  waiter_count_.fetch_add(1u, std::memory_order_relaxed);
+  // Pairs with the fence in |NotifyInternal()|: either it sees our count, or
+  // we (when we check our condition after this) see what it was notifying of.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  return Key(epoch_.load(std::memory_order_acquire));
+}
+
+void EventCount::CancelWait() {
+  uint32_t old_count = waiter_count_.fetch_sub(1u, std::memory_order_relaxed);
+  FTL_DCHECK(old_count > 0u);
+}
+
+void EventCount::Wait(Key key) {
+  WaitUntil(key, TimePoint::Max());
+}
+
+bool EventCount::WaitUntil(Key key, TimePoint deadline) {
+  bool notified;
+  for (;;) {
+    if (epoch_.load(std::memory_order_acquire) != key.epoch_) {
+      notified = true;
+      break;
+    }
+    if (deadline != TimePoint::Max() && TimePoint::Now() >= deadline) {
+      notified = false;
+      break;
+    }
+    internal::WaitOnAddress(&epoch_, key.epoch_, deadline);
+  }
+  CancelWait();
+  return notified;
+}
+
+void EventCount::Notify() {
+  NotifyInternal(false);
+}
+
+void EventCount::NotifyAll() {
+  NotifyInternal(true);
+}
+
+// static
+void EventCount::Pause() {
+#if defined(OS_WIN)
+  YieldProcessor();
+#elif defined(ARCH_CPU_X86_FAMILY)
+  __builtin_ia32_pause();
+#elif defined(ARCH_CPU_ARM_FAMILY)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+void EventCount::NotifyInternal(bool all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!waiter_count_.load(std::memory_order_relaxed))
+    return;
+  epoch_.fetch_add(1u, std::memory_order_release);
+  if (all)
+    internal::WakeByAddressAll(&epoch_);
+  else
+    internal::WakeByAddressSingle(&epoch_);
+}
+
+}  // namespace ftl
@@ -0,0 +1,123 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// An "event count", for blocking until a condition on lock-free data (e.g., "a
+// queue is non-empty") becomes true.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_EVENT_COUNT_H_
+#define LIB_FTL_SYNCHRONIZATION_EVENT_COUNT_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Lets threads wait for a condition that other threads make true without
+// taking a lock (so that there's nothing to wait on with a |CondVar|), without
+// missing the wakeup if the condition becomes true just after they check it.
+// A consumer of a lock-free queue, for example, does:
+//
+//   T value;
+//   while (!queue.TryPop(&value)) {
+//     EventCount::Key key = event_count.PrepareWait();
+//     if (queue.TryPop(&value)) {
+//       event_count.CancelWait();
+//       break;
+//     }
+//     event_count.Wait(key);
+//   }
+//
+// (or, equivalently, |event_count.Await([&] { return queue.TryPop(&value); })|)
+// and a producer does:
+//
+//   queue.Push(value);
+//   event_count.Notify();
+//
+// |Notify()| is a fence and a load when nobody is waiting, so producers don't
+// pay much for consumers that are kept busy. Waiting blocks on a futex (or the
+// platform's equivalent; see synchronization/wait_on_address.h). This class is
+// thread-safe.
+class FTL_EXPORT EventCount final {
+ public:
+  // What |PrepareWait()| returns, to be passed to |Wait()|.
+  class Key final {
+   private:
+    friend class EventCount;
+    explicit Key(uint32_t epoch) : epoch_(epoch) {}
+    uint32_t epoch_;
+  };
+
+  EventCount();
+  ~EventCount();
+
+  // Announces that the calling thread is about to wait. It must then check its
+  // condition, and either call |CancelWait()| (if it's true) or |Wait()| with
+  // the returned key (if not); a |Notify()| made after the check can't be
+  // missed.
+  Key PrepareWait();
+
+  // Withdraws a |PrepareWait()|.
+  void CancelWait();
+
+  // Blocks until a |Notify()| or |NotifyAll()| made after |key| was returned
+  // by |PrepareWait()| (which may have been before this was called), and
+  // completes the wait.
+  void Wait(Key key);
+
+  // Like |Wait()|, but gives up at |deadline|. Returns true if it was
+  // notified (and false if it timed out). Either way, the wait is completed.
+  bool WaitUntil(Key key, TimePoint deadline);
+
+  // Wakes at least one (for |Notify()|) or all of the threads that are
+  // waiting, or between |PrepareWait()| and |Wait()|. This should be called
+  // after making the waiters' condition true.
+  void Notify();
+  void NotifyAll();
+
+  // Returns once |condition()| returns true, trying it a few times (spinning)
+  // before blocking. |condition| may be called any number of times.
+  template <typename Condition>
+  void Await(Condition condition) {
+    for (int i = 0; i < kSpinCount; i++) {
+      if (condition())
+        return;
+      Pause();
+    }
+    for (;;) {
+      if (condition())
+        return;
+      Key key = PrepareWait();
+      if (condition()) {
+        CancelWait();
+        return;
+      }
+      Wait(key);
+    }
+  }
+
+ private:
+  static constexpr int kSpinCount = 100;
+
+  // Tells the CPU that we're spinning.
+  static void Pause();
+
+  void NotifyInternal(bool all);
+
+  // Incremented by every |Notify()| (or |NotifyAll()|) that has anyone to
+  // wake, and waited on.
+  std::atomic<uint32_t> epoch_;
+  // The number of threads between |PrepareWait()| and the end of |Wait()|.
+  std::atomic<uint32_t> waiter_count_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(EventCount);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_EVENT_COUNT_H_
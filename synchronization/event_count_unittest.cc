@@ -0,0 +1,112 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/event_count.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/mpsc_queue.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumThreads = 4;
+constexpr int kItemsPerThread = 10000;
+
+TEST(EventCountTest, NotifyBeforeWait) {
+  EventCount event_count;
+  EventCount::Key key = event_count.PrepareWait();
+  event_count.Notify();
+  // Doesn't block, since the notification came after |PrepareWait()|.
+  event_count.Wait(key);
+}
+
+TEST(EventCountTest, CancelWait) {
+  EventCount event_count;
+  event_count.PrepareWait();
+  event_count.CancelWait();
+  // Nobody's waiting, so this shouldn't change anything.
+  event_count.Notify();
+  EventCount::Key key = event_count.PrepareWait();
+  EXPECT_FALSE(event_count.WaitUntil(key, TimePoint::Now()));
+}
+
+TEST(EventCountTest, WaitUntil) {
+  EventCount event_count;
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  TimePoint start = TimePoint::Now();
+  EXPECT_FALSE(
+      event_count.WaitUntil(event_count.PrepareWait(), start + timeout));
+  EXPECT_GE(TimePoint::Now() - start, timeout - kTimeoutTolerance);
+
+  std::atomic<bool> flag(false);
+  std::thread thread([&event_count, &flag]() {
+    flag.store(true, std::memory_order_release);
+    event_count.Notify();
+  });
+  while (!flag.load(std::memory_order_acquire)) {
+    EventCount::Key key = event_count.PrepareWait();
+    if (flag.load(std::memory_order_acquire)) {
+      event_count.CancelWait();
+      break;
+    }
+    EXPECT_TRUE(event_count.WaitUntil(key, TimePoint::Max()));
+  }
+  thread.join();
+}
+
+TEST(EventCountTest, NotifyAll) {
+  EventCount event_count;
+  std::atomic<bool> flag(false);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.push_back(std::thread([&event_count, &flag]() {
+      event_count.Await([&flag]() {
+        return flag.load(std::memory_order_acquire);
+      });
+    }));
+  }
+  flag.store(true, std::memory_order_release);
+  event_count.NotifyAll();
+  for (auto& thread : threads)
+    thread.join();
+}
+
+// A consumer of a lock-free queue, which blocks when it's empty, shouldn't
+// miss any wakeups.
+TEST(EventCountTest, QueueConsumer) {
+  MpscQueue<int> queue;
+  EventCount event_count;
+
+  std::vector<std::thread> producers;
+  for (int i = 0; i < kNumThreads; i++) {
+    producers.push_back(std::thread([&queue, &event_count]() {
+      for (int j = 0; j < kItemsPerThread; j++) {
+        queue.Push(j);
+        event_count.Notify();
+      }
+    }));
+  }
+
+  int64_t sum = 0;
+  for (int i = 0; i < kNumThreads * kItemsPerThread; i++) {
+    int value;
+    event_count.Await([&queue, &value]() { return queue.TryPop(&value); });
+    sum += value;
+  }
+  for (auto& producer : producers)
+    producer.join();
+
+  EXPECT_EQ(static_cast<int64_t>(kNumThreads) * kItemsPerThread *
+                (kItemsPerThread - 1) / 2,
+            sum);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,49 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/latch.h"
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/synchronization/wait_on_address.h"
+
+namespace ftl {
+
+Latch::Latch(uint32_t count) : count_(count) {}
+
+Latch::~Latch() {}
+
+void Latch::CountDown(uint32_t n) {
+  uint32_t old_count = count_.fetch_sub(n, std::memory_order_acq_rel);
+  FTL_DCHECK(old_count >= n) << "Latch counted down below zero";
+  if (old_count == n && n > 0u)
+    internal::WakeByAddressAll(&count_);
+}
+
+bool Latch::IsReady() const {
+  return count_.load(std::memory_order_acquire) == 0u;
+}
+
+void Latch::Wait() const {
+  WaitUntil(TimePoint::Max());
+}
+
+bool Latch::WaitUntil(TimePoint deadline) const {
+  for (;;) {
+    uint32_t count = count_.load(std::memory_order_acquire);
+    if (!count)
+      return false;
+    if (deadline != TimePoint::Max() && TimePoint::Now() >= deadline)
+      return true;
+    // This returns right away if the count has changed since we loaded it
+    // (in which case we check again).
+    internal::WaitOnAddress(&count_, count, deadline);
+  }
+}
+
+void Latch::CountDownAndWait() {
+  CountDown();
+  Wait();
+}
+
+}  // namespace ftl
@@ -0,0 +1,61 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A single-use count-down latch class.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_LATCH_H_
+#define LIB_FTL_SYNCHRONIZATION_LATCH_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A counter which threads count down, and which other threads can wait for to
+// reach zero; e.g., for fan-in, where a thread waits for N tasks to be done:
+//
+//   Latch latch(N);
+//   for (size_t i = 0; i < N; i++)
+//     pool->PostTask([&latch] { DoWork(); latch.CountDown(); });
+//   latch.Wait();
+//
+// Counting down is a single atomic operation (plus a wakeup, for the last
+// one), and all the waiters block on the counter itself. Once the count reaches
+// zero, it stays there (the latch can't be reused). This class is thread-safe.
+class FTL_EXPORT Latch final {
+ public:
+  explicit Latch(uint32_t count);
+  ~Latch();
+
+  // Decrements the count by |n| (which must be at most the current count),
+  // waking the waiting threads if it reaches zero.
+  void CountDown(uint32_t n = 1u);
+
+  // Returns true if the count has reached zero.
+  bool IsReady() const;
+
+  // Blocks until the count reaches zero.
+  void Wait() const;
+
+  // Like |Wait()|, but also unblocks when |deadline| passes, in which case it
+  // returns true (otherwise, it returns false).
+  bool WaitUntil(TimePoint deadline) const;
+
+  // Equivalent to |CountDown()| followed by |Wait()|.
+  void CountDownAndWait();
+
+ private:
+  std::atomic<uint32_t> count_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Latch);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_LATCH_H_
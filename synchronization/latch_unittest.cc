@@ -0,0 +1,76 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/latch.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+
+namespace ftl {
+namespace {
+
+constexpr uint32_t kNumThreads = 4u;
+
+TEST(LatchTest, Basic) {
+  Latch latch(3u);
+  EXPECT_FALSE(latch.IsReady());
+  latch.CountDown(2u);
+  EXPECT_FALSE(latch.IsReady());
+  EXPECT_TRUE(latch.WaitUntil(TimePoint::Now()));
+
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  TimePoint start = TimePoint::Now();
+  EXPECT_TRUE(latch.WaitUntil(start + timeout));
+  EXPECT_GE(TimePoint::Now() - start, timeout - kTimeoutTolerance);
+
+  latch.CountDown();
+  EXPECT_TRUE(latch.IsReady());
+  latch.Wait();
+  EXPECT_FALSE(latch.WaitUntil(TimePoint()));
+
+  Latch ready(0u);
+  EXPECT_TRUE(ready.IsReady());
+  ready.Wait();
+}
+
+TEST(LatchTest, FanIn) {
+  Latch latch(kNumThreads);
+  std::atomic<uint32_t> done(0u);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0u; i < kNumThreads; i++) {
+    threads.push_back(std::thread([&latch, &done]() {
+      done.fetch_add(1u, std::memory_order_relaxed);
+      latch.CountDown();
+    }));
+  }
+  latch.Wait();
+  EXPECT_EQ(kNumThreads, done.load(std::memory_order_relaxed));
+  for (auto& thread : threads)
+    thread.join();
+}
+
+TEST(LatchTest, CountDownAndWait) {
+  Latch latch(kNumThreads);
+  std::atomic<uint32_t> arrived(0u);
+
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0u; i < kNumThreads; i++) {
+    threads.push_back(std::thread([&latch, &arrived]() {
+      arrived.fetch_add(1u, std::memory_order_relaxed);
+      latch.CountDownAndWait();
+      // Nobody gets past the latch until everybody has arrived.
+      EXPECT_EQ(kNumThreads, arrived.load(std::memory_order_relaxed));
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -28,6 +28,10 @@ void Monitor::Wait() {
   cv_.Wait(&mutex_);
 }
 
+bool Monitor::WaitUntil(TimePoint deadline) {
+  return cv_.WaitUntil(&mutex_, deadline);
+}
+
 MonitorLocker::MonitorLocker(Monitor* monitor) : monitor_(monitor) {
   FTL_DCHECK(monitor_);
   monitor_->Enter();
@@ -41,6 +45,11 @@ void MonitorLocker::Wait() FTL_NO_THREAD_SAFETY_ANALYSIS {
   monitor_->Wait();
 }
 
+bool MonitorLocker::WaitUntil(TimePoint deadline)
+    FTL_NO_THREAD_SAFETY_ANALYSIS {
+  return monitor_->WaitUntil(deadline);
+}
+
 void MonitorLocker::Signal() {
   monitor_->Signal();
 }
@@ -8,6 +8,7 @@
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/synchronization/cond_var.h"
 #include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 
@@ -60,6 +61,11 @@ class FTL_LOCKABLE FTL_EXPORT Monitor {
   // either via |Enter| or by way of a |MonitorLocker|.
   void Wait() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Like |Wait|, but also wakes up when |TimePoint::Now()| reaches |deadline|,
+  // returning true if it did so. Since |deadline| is absolute, callers can keep
+  // passing the same one as they loop on their condition.
+  bool WaitUntil(TimePoint deadline) FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
  private:
   CondVar cv_;
   Mutex mutex_;
@@ -80,6 +86,9 @@ class FTL_EXPORT FTL_SCOPED_LOCKABLE MonitorLocker {
   // Calls |Wait| on the monitor given to this object's constructor.
   void Wait();
 
+  // Calls |WaitUntil| on the monitor given to this object's constructor.
+  bool WaitUntil(TimePoint deadline);
+
   // Calls |Signal| on the monitor given to this object's constructor.
   void Signal();
 
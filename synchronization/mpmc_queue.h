@@ -0,0 +1,219 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A bounded, lock-free multi-producer, multi-consumer queue.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_MPMC_QUEUE_H_
+#define LIB_FTL_SYNCHRONIZATION_MPMC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+#include "lib/ftl/synchronization/event_count.h"
+
+namespace ftl {
+
+// A queue of up to |capacity| |T|s (which must be default-constructible and
+// movable), stored in a ring buffer which is allocated up front, so pushing
+// and popping never allocate. Any number of threads may push and pop at once.
+//
+// The |Try...()| methods never block: |TryPush()| fails if the queue is full,
+// and |TryPop()| if it's empty. |Push()| and |Pop()| instead wait (parking on
+// an |EventCount|, after spinning briefly) for space or for a value, so that
+// the capacity bounds how far producers can get ahead of consumers. The
+// |...Batch()| methods move several values at once, claiming their slots
+// with a single atomic operation.
+//
+// Like |BoundedMpscQueue|, this is Dmitry Vyukov's bounded queue: each slot
+// has a sequence number which says whether it is ready to be written or read
+// on a given lap of the ring, so that producers (and consumers) only contend
+// on a single atomic counter each.
+template <typename T>
+class MpmcQueue final {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit MpmcQueue(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1u),
+        cells_(new Cell[mask_ + 1u]),
+        enqueue_position_(0u),
+        dequeue_position_(0u) {
+    for (size_t i = 0u; i <= mask_; i++)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  ~MpmcQueue() {}
+
+  size_t capacity() const { return mask_ + 1u; }
+
+  // The number of values in the queue (which may be out of date as soon as
+  // it's returned, if other threads are using the queue).
+  size_t ApproximateSize() const {
+    size_t dequeued = dequeue_position_->load(std::memory_order_relaxed);
+    size_t enqueued = enqueue_position_->load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0u;
+  }
+
+  // Adds |*value| to the back of the queue (moving from it) and returns true,
+  // or returns false (leaving |*value| alone) if the queue is full.
+  bool TryPush(T* value) { return TryPushBatch(value, 1u) == 1u; }
+
+  // Moves the front of the queue to |*value| and returns true, or returns
+  // false if the queue is empty (or its front is still being pushed).
+  bool TryPop(T* value) { return TryPopBatch(value, 1u) == 1u; }
+
+  // Adds |value| to the back of the queue, first waiting for there to be room
+  // if it's full.
+  void Push(T value) {
+    if (TryPush(&value))
+      return;
+    not_full_.Await([this, &value]() { return TryPush(&value); });
+  }
+
+  // Moves the front of the queue to |*value|, first waiting for there to be
+  // one if it's empty.
+  void Pop(T* value) {
+    if (TryPop(value))
+      return;
+    not_empty_.Await([this, value]() { return TryPop(value); });
+  }
+
+  // Adds as many of the |count| |values| (in order, moving from them) as there
+  // is room for to the back of the queue, and returns how many that was.
+  size_t TryPushBatch(T* values, size_t count) {
+    size_t position;
+    size_t claimed = Claim(&enqueue_position_, 0u, count, &position);
+    for (size_t i = 0u; i < claimed; i++) {
+      Cell* cell = &cells_[(position + i) & mask_];
+      cell->value = std::move(values[i]);
+      cell->sequence.store(position + i + 1u, std::memory_order_release);
+    }
+    if (claimed == 1u)
+      not_empty_.Notify();
+    else if (claimed)
+      not_empty_.NotifyAll();
+    return claimed;
+  }
+
+  // Moves up to |max_count| values from the front of the queue to |values|,
+  // and returns how many it moved.
+  size_t TryPopBatch(T* values, size_t max_count) {
+    size_t position;
+    size_t claimed = Claim(&dequeue_position_, 1u, max_count, &position);
+    for (size_t i = 0u; i < claimed; i++) {
+      Cell* cell = &cells_[(position + i) & mask_];
+      values[i] = std::move(cell->value);
+      // Free the cell for the next lap.
+      cell->sequence.store(position + i + mask_ + 1u,
+                           std::memory_order_release);
+    }
+    if (claimed == 1u)
+      not_full_.Notify();
+    else if (claimed)
+      not_full_.NotifyAll();
+    return claimed;
+  }
+
+  // Adds all |count| |values| to the back of the queue, waiting for room as
+  // necessary.
+  void PushBatch(T* values, size_t count) {
+    size_t pushed = TryPushBatch(values, count);
+    while (pushed < count) {
+      not_full_.Await([this, values, count, &pushed]() {
+        size_t n = TryPushBatch(values + pushed, count - pushed);
+        pushed += n;
+        return n > 0u;
+      });
+    }
+  }
+
+  // Like |TryPopBatch()|, but first waits for the queue to be non-empty (so it
+  // always moves at least one value, if |max_count| isn't zero).
+  size_t PopBatch(T* values, size_t max_count) {
+    size_t popped = TryPopBatch(values, max_count);
+    if (popped || !max_count)
+      return popped;
+    not_empty_.Await([this, values, max_count, &popped]() {
+      popped = TryPopBatch(values, max_count);
+      return popped > 0u;
+    });
+    return popped;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    FTL_DCHECK(n > 0u);
+    size_t result = 1u;
+    while (result < n)
+      result <<= 1;
+    return result;
+  }
+
+  // Claims up to |max_count| consecutive cells starting at |*position_counter|
+  // (setting |*position| to the first), which are ready for the side whose
+  // cells have sequence number |position + offset| (0 for producers and 1 for
+  // consumers), and returns how many it claimed. Only the thread that moves
+  // |*position_counter| past a ready cell can change it, so once the first
+  // cell is ready, so are the ones we checked after it.
+  size_t Claim(CacheLinePadded<std::atomic<size_t>>* position_counter,
+               size_t offset,
+               size_t max_count,
+               size_t* position) {
+    if (!max_count)
+      return 0u;
+    size_t start = (*position_counter)->load(std::memory_order_relaxed);
+    for (;;) {
+      size_t count = 0u;
+      for (; count < max_count && count <= mask_; count++) {
+        size_t sequence = cells_[(start + count) & mask_].sequence.load(
+            std::memory_order_acquire);
+        if (sequence != start + count + offset)
+          break;
+      }
+      if (count) {
+        if ((*position_counter)
+                ->compare_exchange_weak(start, start + count,
+                                        std::memory_order_relaxed)) {
+          *position = start;
+          return count;
+        }
+        // |start| was updated; retry.
+        continue;
+      }
+      size_t sequence =
+          cells_[start & mask_].sequence.load(std::memory_order_acquire);
+      if (sequence < start + offset) {
+        // The cell hasn't been freed (or filled) on this lap, so we're full
+        // (or empty).
+        return 0u;
+      }
+      // Another thread got the cell first.
+      start = (*position_counter)->load(std::memory_order_relaxed);
+    }
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  // Keep the two counters off of each other's (and the ring's) cache lines.
+  char padding_[kCacheLineSize];
+  CacheLinePadded<std::atomic<size_t>> enqueue_position_;
+  CacheLinePadded<std::atomic<size_t>> dequeue_position_;
+  EventCount not_empty_;
+  EventCount not_full_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MpmcQueue);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_MPMC_QUEUE_H_
@@ -0,0 +1,154 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/mpmc_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumProducers = 4;
+constexpr int kNumConsumers = 4;
+constexpr int kItemsPerProducer = 10000;
+
+TEST(MpmcQueueTest, Basic) {
+  MpmcQueue<int> queue(3u);
+  EXPECT_EQ(4u, queue.capacity());
+  EXPECT_EQ(0u, queue.ApproximateSize());
+
+  int value = 0;
+  EXPECT_FALSE(queue.TryPop(&value));
+  for (int i = 1; i <= 4; i++) {
+    value = i;
+    EXPECT_TRUE(queue.TryPush(&value));
+  }
+  value = 5;
+  EXPECT_FALSE(queue.TryPush(&value));
+  EXPECT_EQ(5, value);
+  EXPECT_EQ(4u, queue.ApproximateSize());
+
+  for (int i = 1; i <= 4; i++) {
+    EXPECT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(i, value);
+  }
+  EXPECT_FALSE(queue.TryPop(&value));
+}
+
+TEST(MpmcQueueTest, MoveOnly) {
+  MpmcQueue<std::unique_ptr<int>> queue(2u);
+  queue.Push(std::unique_ptr<int>(new int(42)));
+  std::unique_ptr<int> value;
+  queue.Pop(&value);
+  ASSERT_TRUE(value);
+  EXPECT_EQ(42, *value);
+}
+
+TEST(MpmcQueueTest, Batches) {
+  MpmcQueue<int> queue(8u);
+  int values[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  // Only 8 fit.
+  EXPECT_EQ(8u, queue.TryPushBatch(values, 10u));
+
+  int popped[10] = {};
+  EXPECT_EQ(3u, queue.TryPopBatch(popped, 3u));
+  EXPECT_EQ(0, popped[0]);
+  EXPECT_EQ(2, popped[2]);
+  // Wrap around the ring.
+  EXPECT_EQ(2u, queue.TryPushBatch(values + 8, 2u));
+  EXPECT_EQ(7u, queue.PopBatch(popped, 10u));
+  for (int i = 0; i < 7; i++)
+    EXPECT_EQ(i + 3, popped[i]);
+  EXPECT_EQ(0u, queue.TryPopBatch(popped, 10u));
+  EXPECT_EQ(0u, queue.PopBatch(popped, 0u));
+}
+
+// Blocking pushes should wait for room, rather than failing.
+TEST(MpmcQueueTest, Backpressure) {
+  MpmcQueue<int> queue(2u);
+  std::thread producer([&queue]() {
+    for (int i = 0; i < kItemsPerProducer; i++)
+      queue.Push(i);
+  });
+  for (int i = 0; i < kItemsPerProducer; i++) {
+    int value;
+    queue.Pop(&value);
+    EXPECT_EQ(i, value);
+    EXPECT_LE(queue.ApproximateSize(), queue.capacity());
+  }
+  producer.join();
+}
+
+// Checks that every item pushed by several producers (some in batches) is
+// popped exactly once by several consumers (some in batches), and that each
+// consumer sees each producer's items in order.
+TEST(MpmcQueueTest, ProducersAndConsumers) {
+  // Small enough that producers will often find it full.
+  MpmcQueue<std::pair<int, int>> queue(64u);
+  std::vector<std::atomic<int>> counts(kNumProducers * kItemsPerProducer);
+  for (auto& count : counts)
+    count.store(0, std::memory_order_relaxed);
+
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < kNumProducers; producer++) {
+    threads.push_back(std::thread([&queue, producer]() {
+      if (producer % 2) {
+        for (int i = 0; i < kItemsPerProducer; i++)
+          queue.Push(std::make_pair(producer, i));
+        return;
+      }
+      std::pair<int, int> batch[16];
+      for (int i = 0; i < kItemsPerProducer;) {
+        int n = std::min(16, kItemsPerProducer - i);
+        for (int j = 0; j < n; j++)
+          batch[j] = std::make_pair(producer, i + j);
+        queue.PushBatch(batch, static_cast<size_t>(n));
+        i += n;
+      }
+    }));
+  }
+  std::atomic<int> remaining(kNumProducers * kItemsPerProducer);
+  for (int consumer = 0; consumer < kNumConsumers; consumer++) {
+    threads.push_back(std::thread([&queue, &counts, &remaining, consumer]() {
+      std::vector<int> next(kNumProducers, 0);
+      std::pair<int, int> batch[8];
+      while (remaining.load(std::memory_order_relaxed) > 0) {
+        size_t n = consumer % 2 ? queue.TryPopBatch(batch, 8u)
+                                : queue.TryPopBatch(batch, 1u);
+        if (!n) {
+          std::this_thread::yield();
+          continue;
+        }
+        remaining.fetch_sub(static_cast<int>(n), std::memory_order_relaxed);
+        for (size_t j = 0u; j < n; j++) {
+          int producer = batch[j].first;
+          int i = batch[j].second;
+          ASSERT_GE(producer, 0);
+          ASSERT_LT(producer, kNumProducers);
+          EXPECT_LE(next[producer], i);
+          next[producer] = i + 1;
+          counts[producer * kItemsPerProducer + i].fetch_add(
+              1, std::memory_order_relaxed);
+        }
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (auto& count : counts)
+    EXPECT_EQ(1, count.load(std::memory_order_relaxed));
+  std::pair<int, int> value;
+  EXPECT_FALSE(queue.TryPop(&value));
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,241 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Lock-free multi-producer, single-consumer queues.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_MPSC_QUEUE_H_
+#define LIB_FTL_SYNCHRONIZATION_MPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+
+namespace ftl {
+
+// The link embedded in elements of an |IntrusiveMpscQueue|.
+struct MpscQueueNode {
+  std::atomic<MpscQueueNode*> next;
+};
+
+// IntrusiveMpscQueue ----------------------------------------------------------
+
+// An unbounded queue of |T|s (which must derive from |MpscQueueNode|), which
+// it doesn't own. Any number of threads may |Push()| at once, but only one
+// thread at a time may use the consumer methods (|Pop()| and |IsEmpty()|).
+//
+// This is Dmitry Vyukov's intrusive MPSC queue: a push is an atomic exchange
+// and a store, without any loops, so producers never wait for each other (or
+// for the consumer). In exchange, a |Pop()| that races with a |Push()| which
+// has only gotten halfway may find the queue temporarily empty (though
+// |IsEmpty()| won't), in which case the consumer should try again once the
+// producer is done (e.g., once it's woken up by it).
+template <typename T>
+class IntrusiveMpscQueue final {
+ public:
+  IntrusiveMpscQueue() : head_(&stub_), tail_(&stub_) {
+    stub_.next.store(nullptr, std::memory_order_relaxed);
+  }
+  ~IntrusiveMpscQueue() { FTL_DCHECK(IsEmpty()); }
+
+  // Adds |node| (which must not already be in a queue) to the back of the
+  // queue.
+  void Push(T* node) { PushNode(static_cast<MpscQueueNode*>(node)); }
+
+  // Removes and returns the front of the queue, or returns null if the queue
+  // is empty (see above).
+  T* Pop() {
+    MpscQueueNode* tail = tail_;
+    MpscQueueNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+      if (!next)
+        return nullptr;
+      tail_ = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    // |tail| is the last node, unless a producer is in the middle of a push.
+    if (tail != head_->load(std::memory_order_acquire))
+      return nullptr;
+    // Put the stub back, so that |tail| can be removed.
+    PushNode(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next) {
+      tail_ = next;
+      return static_cast<T*>(tail);
+    }
+    return nullptr;
+  }
+
+  // Returns true if the queue is empty, i.e., if nothing has been pushed
+  // (even partially) since the last |Pop()| that returned a node.
+  bool IsEmpty() const {
+    return tail_ == &stub_ && head_->load(std::memory_order_acquire) == &stub_;
+  }
+
+ private:
+  void PushNode(MpscQueueNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscQueueNode* prev = head_->exchange(node, std::memory_order_acq_rel);
+    // Until this store, the consumer can't get to |node|.
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // The most recently pushed node, written by producers.
+  // (Padded to keep the consumer's fields off of the producers' cache line.)
+  CacheLinePadded<std::atomic<MpscQueueNode*>> head_;
+  // The oldest node (possibly |stub_|), only used by the consumer.
+  MpscQueueNode* tail_;
+  // A placeholder which keeps the queue from ever being truly empty, so that
+  // producers never have to special-case it.
+  MpscQueueNode stub_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IntrusiveMpscQueue);
+};
+
+// MpscQueue -------------------------------------------------------------------
+
+// An unbounded queue of |T|s (which must be movable), with the same threading
+// rules as |IntrusiveMpscQueue| (on which it is built). Each |Push()| allocates
+// a node.
+template <typename T>
+class MpscQueue final {
+ public:
+  MpscQueue() {}
+  ~MpscQueue() {
+    while (Node* node = queue_.Pop())
+      delete node;
+  }
+
+  void Push(T value) { queue_.Push(new Node(std::move(value))); }
+
+  // Moves the front of the queue to |*value| and returns true, or returns
+  // false if the queue is empty (see |IntrusiveMpscQueue::Pop()|).
+  bool TryPop(T* value) {
+    std::unique_ptr<Node> node(queue_.Pop());
+    if (!node)
+      return false;
+    *value = std::move(node->value);
+    return true;
+  }
+
+  bool IsEmpty() const { return queue_.IsEmpty(); }
+
+ private:
+  struct Node : public MpscQueueNode {
+    explicit Node(T value) : value(std::move(value)) {}
+
+    T value;
+  };
+
+  IntrusiveMpscQueue<Node> queue_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+};
+
+// BoundedMpscQueue ------------------------------------------------------------
+
+// A queue of up to |capacity| |T|s (which must be default-constructible and
+// movable), stored in a ring buffer which is allocated up front, so pushing
+// and popping never allocate. |TryPush()| fails if the queue is full. Any
+// number of threads may |TryPush()| at once, but only one thread at a time may
+// |TryPop()|.
+//
+// This is Dmitry Vyukov's bounded queue: each slot has a sequence number which
+// says whether it is ready to be written or read on a given lap of the ring, so
+// that producers only contend on a single atomic counter.
+template <typename T>
+class BoundedMpscQueue final {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit BoundedMpscQueue(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1u),
+        cells_(new Cell[mask_ + 1u]),
+        enqueue_position_(0u) {
+    for (size_t i = 0u; i <= mask_; i++)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  ~BoundedMpscQueue() {}
+
+  size_t capacity() const { return mask_ + 1u; }
+
+  // Adds |*value| to the back of the queue (moving from it) and returns true,
+  // or returns false (leaving |*value| alone) if the queue is full.
+  bool TryPush(T* value) {
+    size_t position = enqueue_position_->load(std::memory_order_relaxed);
+    for (;;) {
+      Cell* cell = &cells_[position & mask_];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      if (sequence == position) {
+        // The cell is free on this lap; try to claim it.
+        if (enqueue_position_->compare_exchange_weak(
+                position, position + 1u, std::memory_order_relaxed)) {
+          cell->value = std::move(*value);
+          cell->sequence.store(position + 1u, std::memory_order_release);
+          return true;
+        }
+        // |position| was updated; retry.
+      } else if (sequence < position) {
+        // The cell still holds the value from the last lap, so we're full.
+        return false;
+      } else {
+        // Another producer got the cell first.
+        position = enqueue_position_->load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Moves the front of the queue to |*value| and returns true, or returns
+  // false if the queue is empty (or its front is still being pushed).
+  bool TryPop(T* value) {
+    Cell* cell = &cells_[dequeue_position_ & mask_];
+    if (cell->sequence.load(std::memory_order_acquire) !=
+        dequeue_position_ + 1u) {
+      return false;
+    }
+    *value = std::move(cell->value);
+    // Free the cell for the next lap.
+    cell->sequence.store(dequeue_position_ + mask_ + 1u,
+                         std::memory_order_release);
+    dequeue_position_++;
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    FTL_DCHECK(n > 0u);
+    size_t result = 1u;
+    while (result < n)
+      result <<= 1;
+    return result;
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  // Keep the producers' counter off of the consumer's cache line.
+  char padding_[kCacheLineSize];
+  CacheLinePadded<std::atomic<size_t>> enqueue_position_;
+  // Only used by the consumer.
+  size_t dequeue_position_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BoundedMpscQueue);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_MPSC_QUEUE_H_
@@ -0,0 +1,215 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/mpsc_queue.h"
+
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumProducers = 4;
+constexpr int kItemsPerProducer = 10000;
+
+struct TestNode : public MpscQueueNode {
+  TestNode(int producer, int value) : producer(producer), value(value) {}
+
+  int producer;
+  int value;
+};
+
+// Pushes |kItemsPerProducer| items from each of |kNumProducers| threads (with
+// |push(producer, i)|), popping them (with |pop(&producer, &i)|) on this
+// thread, and checks that each producer's items come out in order.
+template <typename PushFn, typename PopFn>
+void TestProducers(PushFn push, PopFn pop) {
+  std::vector<std::thread> threads;
+  for (int producer = 0; producer < kNumProducers; producer++) {
+    threads.push_back(std::thread([producer, &push]() {
+      for (int i = 0; i < kItemsPerProducer; i++)
+        push(producer, i);
+    }));
+  }
+
+  std::vector<int> next(kNumProducers, 0);
+  for (int popped = 0; popped < kNumProducers * kItemsPerProducer;) {
+    int producer;
+    int i;
+    if (!pop(&producer, &i)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_GE(producer, 0);
+    ASSERT_LT(producer, kNumProducers);
+    EXPECT_EQ(next[producer], i);
+    next[producer] = i + 1;
+    popped++;
+  }
+  for (auto& thread : threads)
+    thread.join();
+}
+
+TEST(IntrusiveMpscQueueTest, Basic) {
+  IntrusiveMpscQueue<TestNode> queue;
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_EQ(nullptr, queue.Pop());
+
+  TestNode nodes[] = {{0, 0}, {0, 1}, {0, 2}};
+  queue.Push(&nodes[0]);
+  EXPECT_FALSE(queue.IsEmpty());
+  queue.Push(&nodes[1]);
+  EXPECT_EQ(&nodes[0], queue.Pop());
+  queue.Push(&nodes[2]);
+  EXPECT_EQ(&nodes[1], queue.Pop());
+  EXPECT_EQ(&nodes[2], queue.Pop());
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_EQ(nullptr, queue.Pop());
+
+  // Nodes may be reused once popped.
+  queue.Push(&nodes[0]);
+  EXPECT_EQ(&nodes[0], queue.Pop());
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(IntrusiveMpscQueueTest, MultipleProducers) {
+  IntrusiveMpscQueue<TestNode> queue;
+  std::vector<std::unique_ptr<TestNode>> nodes;
+  for (int producer = 0; producer < kNumProducers; producer++) {
+    for (int i = 0; i < kItemsPerProducer; i++)
+      nodes.emplace_back(new TestNode(producer, i));
+  }
+
+  TestProducers(
+      [&queue, &nodes](int producer, int i) {
+        queue.Push(nodes[producer * kItemsPerProducer + i].get());
+      },
+      [&queue](int* producer, int* i) {
+        TestNode* node = queue.Pop();
+        if (!node)
+          return false;
+        *producer = node->producer;
+        *i = node->value;
+        return true;
+      });
+}
+
+TEST(MpscQueueTest, Basic) {
+  MpscQueue<std::unique_ptr<int>> queue;
+  std::unique_ptr<int> value;
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_FALSE(queue.TryPop(&value));
+
+  queue.Push(std::unique_ptr<int>(new int(1)));
+  queue.Push(std::unique_ptr<int>(new int(2)));
+  EXPECT_FALSE(queue.IsEmpty());
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(1, *value);
+  ASSERT_TRUE(queue.TryPop(&value));
+  EXPECT_EQ(2, *value);
+  EXPECT_TRUE(queue.IsEmpty());
+  EXPECT_FALSE(queue.TryPop(&value));
+
+  // Values left in the queue are destroyed with it.
+  queue.Push(std::unique_ptr<int>(new int(3)));
+}
+
+// A value which has no default constructor, and counts its destructions.
+class CountedValue {
+ public:
+  explicit CountedValue(int* destroyed) : destroyed_(destroyed) {}
+  CountedValue(CountedValue&& other) : destroyed_(other.destroyed_) {
+    other.destroyed_ = nullptr;
+  }
+  CountedValue& operator=(CountedValue&& other) {
+    destroyed_ = other.destroyed_;
+    other.destroyed_ = nullptr;
+    return *this;
+  }
+  ~CountedValue() {
+    if (destroyed_)
+      (*destroyed_)++;
+  }
+
+ private:
+  int* destroyed_;
+};
+
+TEST(MpscQueueTest, NotDefaultConstructible) {
+  int destroyed = 0;
+  {
+    MpscQueue<CountedValue> queue;
+    queue.Push(CountedValue(&destroyed));
+    queue.Push(CountedValue(&destroyed));
+    CountedValue value(nullptr);
+    ASSERT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(0, destroyed);
+  }
+  EXPECT_EQ(2, destroyed);
+}
+
+TEST(MpscQueueTest, MultipleProducers) {
+  MpscQueue<std::pair<int, int>> queue;
+  TestProducers(
+      [&queue](int producer, int i) {
+        queue.Push(std::make_pair(producer, i));
+      },
+      [&queue](int* producer, int* i) {
+        std::pair<int, int> value;
+        if (!queue.TryPop(&value))
+          return false;
+        *producer = value.first;
+        *i = value.second;
+        return true;
+      });
+}
+
+TEST(BoundedMpscQueueTest, Basic) {
+  BoundedMpscQueue<int> queue(3u);
+  EXPECT_EQ(4u, queue.capacity());
+
+  int value = 0;
+  EXPECT_FALSE(queue.TryPop(&value));
+  // Go around the ring a few times.
+  for (int lap = 0; lap < 3; lap++) {
+    for (int i = 0; i < 4; i++) {
+      value = i;
+      EXPECT_TRUE(queue.TryPush(&value));
+    }
+    value = 4;
+    EXPECT_FALSE(queue.TryPush(&value));
+    EXPECT_EQ(4, value);
+    for (int i = 0; i < 4; i++) {
+      ASSERT_TRUE(queue.TryPop(&value));
+      EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(queue.TryPop(&value));
+  }
+}
+
+TEST(BoundedMpscQueueTest, MultipleProducers) {
+  // Small enough that producers will often find it full.
+  BoundedMpscQueue<std::pair<int, int>> queue(64u);
+  TestProducers(
+      [&queue](int producer, int i) {
+        std::pair<int, int> value(producer, i);
+        while (!queue.TryPush(&value))
+          std::this_thread::yield();
+      },
+      [&queue](int* producer, int* i) {
+        std::pair<int, int> value;
+        if (!queue.TryPop(&value))
+          return false;
+        *producer = value.first;
+        *i = value.second;
+        return true;
+      });
+}
+
+}  // namespace
+}  // namespace ftl
@@ -21,20 +21,40 @@
 #include "lib/ftl/macros.h"
 #include "lib/ftl/synchronization/thread_annotations.h"
 
+#if defined(FTL_MUTEX_PROFILING)
+#include "lib/ftl/time/time_point.h"
+#endif
+
 namespace ftl {
 
 // Mutex -----------------------------------------------------------------------
 
 class CondVar;
 
+#if defined(FTL_MUTEX_PROFILING)
+namespace internal {
+class MutexSiteStats;
+}  // namespace internal
+#endif
+
+// In builds with |FTL_MUTEX_PROFILING| defined, mutexes record how often they
+// are taken, how often and for how long callers have to wait for them, and how
+// long they are held; see mutex_profiling.h.
 class FTL_LOCKABLE FTL_EXPORT Mutex final {
  public:
-#ifndef NDEBUG
+#if !defined(NDEBUG) || defined(FTL_MUTEX_PROFILING)
+#if defined(FTL_MUTEX_PROFILING)
+  // Profiles are kept per construction site, which is the caller's by default.
+  explicit Mutex(const char* file = __builtin_FILE(),
+                 int line = __builtin_LINE());
+#else
   Mutex();
+#endif
   ~Mutex();
 
   void Lock() FTL_EXCLUSIVE_LOCK_FUNCTION();
   void Unlock() FTL_UNLOCK_FUNCTION();
+  void UnlockAfterFork() FTL_UNLOCK_FUNCTION();
 
   bool TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true);
 
@@ -47,6 +67,8 @@ class FTL_LOCKABLE FTL_EXPORT Mutex final {
 
   void Unlock() FTL_UNLOCK_FUNCTION() { ReleaseSRWLockExclusive(&impl_); }
 
+  void UnlockAfterFork() FTL_UNLOCK_FUNCTION() { Unlock(); }
+
   bool TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
     return (TryAcquireSRWLockExclusive(&impl_) != 0);
   }
@@ -62,6 +84,12 @@ class FTL_LOCKABLE FTL_EXPORT Mutex final {
   // Releases a lock.
   void Unlock() FTL_UNLOCK_FUNCTION() { pthread_mutex_unlock(&impl_); }
 
+  // In the child of a fork(), releases the lock which the fork()ing thread
+  // held (e.g., having taken it in a |ForkHandlers| prepare handler). (In
+  // Debug builds, |Unlock()| and |AssertHeld()| would fail, since the thread
+  // has a new id in the child.)
+  void UnlockAfterFork() FTL_UNLOCK_FUNCTION() { Unlock(); }
+
   // Tries to take an exclusive lock, returning true if successful.
   bool TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
     return !pthread_mutex_trylock(&impl_);
@@ -70,11 +98,15 @@ class FTL_LOCKABLE FTL_EXPORT Mutex final {
   // Asserts that an exclusive lock is held by the calling thread. (Does nothing
   // for non-Debug builds.)
   void AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK() {}
-#endif  // NDEBUG
+#endif  // !defined(NDEBUG) || defined(FTL_MUTEX_PROFILING)
 
  private:
   friend class CondVar;
 
+#if !defined(OS_WIN) && (!defined(NDEBUG) || defined(FTL_MUTEX_PROFILING))
+  void Init();
+#endif
+
 #if defined(OS_WIN)
   SRWLOCK impl_;
 #ifndef NDEBUG
@@ -86,6 +118,24 @@ class FTL_LOCKABLE FTL_EXPORT Mutex final {
   pthread_mutex_t impl_;
 #endif  //  defined(OS_WIN)
 
+#if defined(FTL_MUTEX_PROFILING)
+  // Called (without the lock) when about to wait for it.
+  void RecordContention();
+  // Called (with the lock held) after taking the lock, having waited for
+  // |wait_time| if |contended|.
+  void RecordLocked(TimeDelta wait_time, bool contended);
+  // Called with the lock held, before releasing it.
+  void RecordUnlocking();
+  // Called by |CondVar| around the waits which release and retake the lock, so
+  // that those don't count as holding it.
+  void WillWait() { RecordUnlocking(); }
+  void DidWait() { locked_at_ = TimePoint::Now(); }
+
+  internal::MutexSiteStats* const stats_;
+  // When the lock was last taken; only touched while holding it.
+  TimePoint locked_at_;
+#endif  // defined(FTL_MUTEX_PROFILING)
+
   FTL_DISALLOW_COPY_AND_ASSIGN(Mutex);
 };
 
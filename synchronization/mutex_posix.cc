@@ -4,18 +4,31 @@
 
 #include "lib/ftl/synchronization/mutex.h"
 
-#ifndef NDEBUG
+#if !defined(NDEBUG) || defined(FTL_MUTEX_PROFILING)
 #include <errno.h>
 #include <string.h>
 
 #include "lib/ftl/logging.h"
+#if defined(FTL_MUTEX_PROFILING)
+#include "lib/ftl/synchronization/mutex_profiling.h"
+#endif
 
 #define FTL_DCHECK_WITH_ERRNO(condition, fn, error) \
   FTL_DCHECK(condition) << fn << ": " << strerror(error)
 
 namespace ftl {
 
+#if defined(FTL_MUTEX_PROFILING)
+Mutex::Mutex(const char* file, int line)
+    : stats_(internal::GetMutexSiteStats(file, line)) {
+#else
 Mutex::Mutex() {
+#endif
+  Init();
+}
+
+void Mutex::Init() {
+#ifndef NDEBUG
   pthread_mutexattr_t attr;
   int error = pthread_mutexattr_init(&attr);
   FTL_DCHECK_WITH_ERRNO(!error, "pthread_mutexattr_init", error);
@@ -25,6 +38,9 @@ Mutex::Mutex() {
   FTL_DCHECK_WITH_ERRNO(!error, "pthread_mutex_init", error);
   error = pthread_mutexattr_destroy(&attr);
   FTL_DCHECK_WITH_ERRNO(!error, "pthread_mutexattr_destroy", error);
+#else
+  pthread_mutex_init(&impl_, nullptr);
+#endif  // NDEBUG
 }
 
 Mutex::~Mutex() {
@@ -33,27 +49,62 @@ Mutex::~Mutex() {
 }
 
 void Mutex::Lock() FTL_EXCLUSIVE_LOCK_FUNCTION() {
+#if defined(FTL_MUTEX_PROFILING)
+  // Try first, so that only contended acquisitions pay for timing the wait.
+  if (!pthread_mutex_trylock(&impl_)) {
+    RecordLocked(TimeDelta::Zero(), false);
+    return;
+  }
+  RecordContention();
+  TimePoint start = TimePoint::Now();
+#endif
   int error = pthread_mutex_lock(&impl_);
   FTL_DCHECK_WITH_ERRNO(!error, "pthread_mutex_lock", error);
+#if defined(FTL_MUTEX_PROFILING)
+  RecordLocked(TimePoint::Now() - start, true);
+#endif
 }
 
 void Mutex::Unlock() FTL_UNLOCK_FUNCTION() {
+#if defined(FTL_MUTEX_PROFILING)
+  RecordUnlocking();
+#endif
   int error = pthread_mutex_unlock(&impl_);
   FTL_DCHECK_WITH_ERRNO(!error, "pthread_mutex_unlock", error);
 }
 
+void Mutex::UnlockAfterFork() FTL_UNLOCK_FUNCTION() {
+#if defined(FTL_MUTEX_PROFILING)
+  RecordUnlocking();
+#endif
+  // An error-checking mutex can only be unlocked by its owner's thread id, so
+  // it's reinitialized instead (which is fine, since the child has no other
+  // threads).
+#ifndef NDEBUG
+  Init();
+#else
+  pthread_mutex_unlock(&impl_);
+#endif
+}
+
 bool Mutex::TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
   int error = pthread_mutex_trylock(&impl_);
   FTL_DCHECK_WITH_ERRNO(!error || error == EBUSY, "pthread_mutex_trylock",
                         error);
+#if defined(FTL_MUTEX_PROFILING)
+  if (!error)
+    RecordLocked(TimeDelta::Zero(), false);
+#endif
   return !error;
 }
 
 void Mutex::AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK() {
+#ifndef NDEBUG
   int error = pthread_mutex_lock(&impl_);
   FTL_DCHECK_WITH_ERRNO(error == EDEADLK, "pthread_mutex_lock", error);
+#endif
 }
 
 }  // namespace ftl
 
-#endif  // NDEBUG
+#endif  // !defined(NDEBUG) || defined(FTL_MUTEX_PROFILING)
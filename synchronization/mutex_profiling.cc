@@ -0,0 +1,298 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/mutex_profiling.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include "lib/ftl/debug/stack_trace.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/synchronization/mutex.h"
+
+namespace ftl {
+namespace internal {
+
+// The statistics for one site, updated (racily with respect to each other, but
+// without locking) by every mutex constructed there.
+class MutexSiteStats {
+ public:
+  MutexSiteStats(const char* file, int line) : file_(file), line_(line) {
+    Reset();
+  }
+
+  static constexpr size_t kMaxContentionStackFrames = 32u;
+
+  // Returns true for one in every |kMutexContentionStackSamplingInterval|
+  // calls.
+  bool ShouldSampleContention() {
+    return contentions_.fetch_add(1u, std::memory_order_relaxed) %
+               kMutexContentionStackSamplingInterval ==
+           0u;
+  }
+
+  void SetContentionStack(const void* const* frames, size_t count) {
+    // (If another thread is using the stack, just drop this one.)
+    if (stack_busy_.exchange(true, std::memory_order_acquire))
+      return;
+    std::copy(frames, frames + count, stack_);
+    stack_size_ = count;
+    stack_busy_.store(false, std::memory_order_release);
+  }
+
+  void RecordAcquisition(TimeDelta wait_time, bool contended) {
+    acquisitions_.fetch_add(1u, std::memory_order_relaxed);
+    if (!contended)
+      return;
+    contended_acquisitions_.fetch_add(1u, std::memory_order_relaxed);
+    total_wait_nanoseconds_.fetch_add(ToNanoseconds(wait_time),
+                                      std::memory_order_relaxed);
+    wait_histogram_[BucketFor(wait_time)].fetch_add(1u,
+                                                    std::memory_order_relaxed);
+  }
+
+  void RecordHold(TimeDelta hold_time) {
+    total_hold_nanoseconds_.fetch_add(ToNanoseconds(hold_time),
+                                      std::memory_order_relaxed);
+    hold_histogram_[BucketFor(hold_time)].fetch_add(1u,
+                                                    std::memory_order_relaxed);
+  }
+
+  ftl::MutexProfile GetProfile() const {
+    ftl::MutexProfile profile;
+    profile.file = file_;
+    profile.line = line_;
+    profile.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+    profile.contended_acquisitions =
+        contended_acquisitions_.load(std::memory_order_relaxed);
+    profile.total_wait_time = TimeDelta::FromNanoseconds(static_cast<int64_t>(
+        total_wait_nanoseconds_.load(std::memory_order_relaxed)));
+    profile.total_hold_time = TimeDelta::FromNanoseconds(static_cast<int64_t>(
+        total_hold_nanoseconds_.load(std::memory_order_relaxed)));
+    for (size_t i = 0u; i < kMutexProfileHistogramSize; i++) {
+      profile.wait_histogram[i] =
+          wait_histogram_[i].load(std::memory_order_relaxed);
+      profile.hold_histogram[i] =
+          hold_histogram_[i].load(std::memory_order_relaxed);
+    }
+    if (!stack_busy_.exchange(true, std::memory_order_acquire)) {
+      profile.contention_stack.assign(stack_, stack_ + stack_size_);
+      stack_busy_.store(false, std::memory_order_release);
+    }
+    return profile;
+  }
+
+  void Reset() {
+    acquisitions_.store(0u, std::memory_order_relaxed);
+    contended_acquisitions_.store(0u, std::memory_order_relaxed);
+    total_wait_nanoseconds_.store(0u, std::memory_order_relaxed);
+    total_hold_nanoseconds_.store(0u, std::memory_order_relaxed);
+    for (size_t i = 0u; i < kMutexProfileHistogramSize; i++) {
+      wait_histogram_[i].store(0u, std::memory_order_relaxed);
+      hold_histogram_[i].store(0u, std::memory_order_relaxed);
+    }
+    contentions_.store(0u, std::memory_order_relaxed);
+    while (stack_busy_.exchange(true, std::memory_order_acquire)) {
+    }
+    stack_size_ = 0u;
+    stack_busy_.store(false, std::memory_order_release);
+  }
+
+ private:
+  static uint64_t ToNanoseconds(TimeDelta delta) {
+    return static_cast<uint64_t>(std::max<int64_t>(delta.ToNanoseconds(), 0));
+  }
+
+  // Returns floor(log2(|delta| in nanoseconds)), clamped to the histogram.
+  static size_t BucketFor(TimeDelta delta) {
+    uint64_t nanoseconds = ToNanoseconds(delta);
+    size_t bucket = 0u;
+    while (nanoseconds >>= 1)
+      bucket++;
+    return std::min(bucket, kMutexProfileHistogramSize - 1u);
+  }
+
+  const std::string file_;
+  const int line_;
+
+  std::atomic<uint64_t> acquisitions_;
+  std::atomic<uint64_t> contended_acquisitions_;
+  std::atomic<uint64_t> total_wait_nanoseconds_;
+  std::atomic<uint64_t> total_hold_nanoseconds_;
+  std::atomic<uint64_t> wait_histogram_[kMutexProfileHistogramSize];
+  std::atomic<uint64_t> hold_histogram_[kMutexProfileHistogramSize];
+
+  // Counts |ShouldSampleContention()|s.
+  std::atomic<uint64_t> contentions_;
+  // Guards |stack_| and |stack_size_|, which hold the last sampled stack.
+  mutable std::atomic<bool> stack_busy_{false};
+  const void* stack_[kMaxContentionStackFrames];
+  size_t stack_size_ = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MutexSiteStats);
+};
+
+constexpr size_t MutexSiteStats::kMaxContentionStackFrames;
+
+namespace {
+
+// All the sites, keyed by file and line. (This uses |std::mutex| since an
+// |ftl::Mutex| would itself need profiling.)
+struct MutexSiteRegistry {
+  std::mutex mutex;
+  std::map<std::pair<std::string, int>, std::unique_ptr<MutexSiteStats>> sites;
+};
+
+MutexSiteRegistry* GetRegistry() {
+  // Leaked, so that mutexes can be used during static destruction.
+  static MutexSiteRegistry* registry = new MutexSiteRegistry();
+  return registry;
+}
+
+// Returns the (approximate) |fraction| percentile of |histogram|, i.e., the
+// upper bound of the bucket containing it.
+TimeDelta HistogramPercentile(const uint64_t* histogram, double fraction) {
+  uint64_t total = 0u;
+  for (size_t i = 0u; i < kMutexProfileHistogramSize; i++)
+    total += histogram[i];
+  if (!total)
+    return TimeDelta::Zero();
+  uint64_t target = static_cast<uint64_t>(fraction * total);
+  uint64_t count = 0u;
+  for (size_t i = 0u; i < kMutexProfileHistogramSize; i++) {
+    count += histogram[i];
+    if (count > target)
+      return TimeDelta::FromNanoseconds(int64_t{1} << (i + 1u));
+  }
+  return TimeDelta::FromNanoseconds(int64_t{1} << kMutexProfileHistogramSize);
+}
+
+std::string FormatDuration(TimeDelta delta) {
+  int64_t nanoseconds = delta.ToNanoseconds();
+  if (nanoseconds < 10000)
+    return StringPrintf("%dns", static_cast<int>(nanoseconds));
+  if (nanoseconds < 10000000)
+    return StringPrintf("%.1fus", nanoseconds / 1e3);
+  if (nanoseconds < 10000000000)
+    return StringPrintf("%.1fms", nanoseconds / 1e6);
+  return StringPrintf("%.1fs", nanoseconds / 1e9);
+}
+
+}  // namespace
+
+MutexSiteStats* GetMutexSiteStats(const char* file, int line) {
+  MutexSiteRegistry* registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  auto& stats = registry->sites[std::make_pair(std::string(file), line)];
+  if (!stats)
+    stats.reset(new MutexSiteStats(file, line));
+  return stats.get();
+}
+
+}  // namespace internal
+
+#if defined(FTL_MUTEX_PROFILING)
+
+void Mutex::RecordContention() {
+  if (!stats_->ShouldSampleContention())
+    return;
+  // From |Lock()|'s caller out.
+  const void* frames[internal::MutexSiteStats::kMaxContentionStackFrames];
+  const size_t count = CaptureStackTrace(
+      frames, internal::MutexSiteStats::kMaxContentionStackFrames, 2u);
+  stats_->SetContentionStack(frames, count);
+}
+
+void Mutex::RecordLocked(TimeDelta wait_time, bool contended) {
+  stats_->RecordAcquisition(wait_time, contended);
+  locked_at_ = TimePoint::Now();
+}
+
+void Mutex::RecordUnlocking() {
+  stats_->RecordHold(TimePoint::Now() - locked_at_);
+}
+
+#endif  // defined(FTL_MUTEX_PROFILING)
+
+bool IsMutexProfilingEnabled() {
+#if defined(FTL_MUTEX_PROFILING)
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::vector<MutexProfile> GetMutexProfiles() {
+  std::vector<MutexProfile> profiles;
+  {
+    internal::MutexSiteRegistry* registry = internal::GetRegistry();
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    for (const auto& site : registry->sites) {
+      MutexProfile profile = site.second->GetProfile();
+      if (profile.acquisitions)
+        profiles.push_back(std::move(profile));
+    }
+  }
+  std::stable_sort(profiles.begin(), profiles.end(),
+                   [](const MutexProfile& a, const MutexProfile& b) {
+                     return a.total_wait_time > b.total_wait_time;
+                   });
+  return profiles;
+}
+
+std::string DumpMutexProfiles(size_t max_sites) {
+  if (!IsMutexProfilingEnabled())
+    return "Mutex profiling is not enabled in this build.\n";
+
+  std::vector<MutexProfile> profiles = GetMutexProfiles();
+  std::string result = StringPrintf(
+      "%-40s %12s %12s %10s %9s %9s %10s %9s %9s\n", "site", "acquired",
+      "contended", "wait", "wait p50", "wait p99", "hold", "hold p50",
+      "hold p99");
+  for (size_t i = 0u; i < profiles.size() && i < max_sites; i++) {
+    const MutexProfile& profile = profiles[i];
+    std::string site =
+        StringPrintf("%s:%d", profile.file.c_str(), profile.line);
+    // Keep the end of long paths, which is the informative part.
+    if (site.size() > 40u)
+      site = "..." + site.substr(site.size() - 37u);
+    StringAppendf(
+        &result, "%-40s %12llu %12llu %10s %9s %9s %10s %9s %9s\n",
+        site.c_str(), static_cast<unsigned long long>(profile.acquisitions),
+        static_cast<unsigned long long>(profile.contended_acquisitions),
+        internal::FormatDuration(profile.total_wait_time).c_str(),
+        internal::FormatDuration(
+            internal::HistogramPercentile(profile.wait_histogram, 0.5))
+            .c_str(),
+        internal::FormatDuration(
+            internal::HistogramPercentile(profile.wait_histogram, 0.99))
+            .c_str(),
+        internal::FormatDuration(profile.total_hold_time).c_str(),
+        internal::FormatDuration(
+            internal::HistogramPercentile(profile.hold_histogram, 0.5))
+            .c_str(),
+        internal::FormatDuration(
+            internal::HistogramPercentile(profile.hold_histogram, 0.99))
+            .c_str());
+    for (size_t j = 0u; j < profile.contention_stack.size(); j++) {
+      const void* frame = profile.contention_stack[j];
+      StringAppendf(&result, "    #%zu %p %s\n", j, frame,
+                    SymbolizeStackFrame(frame).c_str());
+    }
+  }
+  return result;
+}
+
+void ResetMutexProfiles() {
+  internal::MutexSiteRegistry* registry = internal::GetRegistry();
+  std::lock_guard<std::mutex> lock(registry->mutex);
+  for (auto& site : registry->sites)
+    site.second->Reset();
+}
+
+}  // namespace ftl
@@ -0,0 +1,85 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Lock contention profiles for |Mutex|.
+//
+// These are only recorded in builds with |FTL_MUTEX_PROFILING| defined (e.g.,
+// with the |ftl_mutex_profiling| GN arg), in which every |Mutex| records
+// statistics for the site (file and line) which constructed it: how often it
+// was taken, how often callers had to wait for it, and histograms of the wait
+// and hold times. In other builds, these functions are available but report
+// nothing, so tools can call them unconditionally.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_MUTEX_PROFILING_H_
+#define LIB_FTL_SYNCHRONIZATION_MUTEX_PROFILING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+
+// The number of buckets in |MutexProfile|'s histograms.
+constexpr size_t kMutexProfileHistogramSize = 32u;
+
+// A snapshot of the statistics for the mutexes constructed at a given site.
+struct MutexProfile {
+  std::string file;
+  int line = 0;
+
+  // How often the mutexes were taken (including by successful |TryLock()|s).
+  uint64_t acquisitions = 0u;
+  // How many of the acquisitions had to wait for another thread.
+  uint64_t contended_acquisitions = 0u;
+  TimeDelta total_wait_time;
+  TimeDelta total_hold_time;
+
+  // |wait_histogram[i]| counts the contended acquisitions which waited for
+  // [2^i, 2^(i + 1)) nanoseconds (the first bucket also counts shorter ones,
+  // the last bucket also counts longer ones). |hold_histogram| is the same,
+  // for the times that the mutexes were held.
+  uint64_t wait_histogram[kMutexProfileHistogramSize] = {};
+  uint64_t hold_histogram[kMutexProfileHistogramSize] = {};
+
+  // The stack (see debug/stack_trace.h) of a recent caller that had to wait,
+  // from its call to |Lock()| out, or empty if none has. (One in every
+  // |kMutexContentionStackSamplingInterval| contended acquisitions is sampled,
+  // starting with the first.)
+  std::vector<const void*> contention_stack;
+};
+
+constexpr uint64_t kMutexContentionStackSamplingInterval = 16u;
+
+// Returns true if this is a build which records mutex profiles.
+FTL_EXPORT bool IsMutexProfilingEnabled();
+
+// Returns the profiles of all the sites whose mutexes have been taken, most
+// waited-on first.
+FTL_EXPORT std::vector<MutexProfile> GetMutexProfiles();
+
+// Returns a human-readable table of (up to |max_sites| of) the profiles from
+// |GetMutexProfiles()|, with approximate percentiles of the wait and hold
+// times, each followed by its (symbolized) contention stack.
+FTL_EXPORT std::string DumpMutexProfiles(size_t max_sites = 20u);
+
+// Clears the statistics of all sites.
+FTL_EXPORT void ResetMutexProfiles();
+
+namespace internal {
+
+class MutexSiteStats;
+
+// Returns the statistics for the site |file|:|line|, creating them if
+// necessary. They live forever.
+FTL_EXPORT MutexSiteStats* GetMutexSiteStats(const char* file, int line);
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_MUTEX_PROFILING_H_
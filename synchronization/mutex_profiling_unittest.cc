@@ -0,0 +1,99 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/mutex_profiling.h"
+
+#include <string.h>
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+namespace {
+
+#if defined(FTL_MUTEX_PROFILING)
+
+// Returns the profile for the site |line| of this file, or one with no
+// acquisitions if there is none.
+MutexProfile GetProfileForLine(int line) {
+  for (const auto& profile : GetMutexProfiles()) {
+    if (profile.line == line &&
+        strstr(profile.file.c_str(), "mutex_profiling_unittest.cc"))
+      return profile;
+  }
+  return MutexProfile();
+}
+
+TEST(MutexProfilingTest, CountsAcquisitions) {
+  EXPECT_TRUE(IsMutexProfilingEnabled());
+
+  Mutex mutex;
+  const int line = __LINE__ - 1;
+  for (int i = 0; i < 3; i++) {
+    mutex.Lock();
+    mutex.Unlock();
+  }
+  EXPECT_TRUE(mutex.TryLock());
+  mutex.Unlock();
+
+  MutexProfile profile = GetProfileForLine(line);
+  EXPECT_EQ(line, profile.line);
+  EXPECT_EQ(4u, profile.acquisitions);
+  EXPECT_EQ(0u, profile.contended_acquisitions);
+  EXPECT_EQ(TimeDelta::Zero(), profile.total_wait_time);
+  uint64_t holds = 0u;
+  for (size_t i = 0u; i < kMutexProfileHistogramSize; i++)
+    holds += profile.hold_histogram[i];
+  EXPECT_EQ(4u, holds);
+
+  ResetMutexProfiles();
+  EXPECT_EQ(0u, GetProfileForLine(line).acquisitions);
+}
+
+TEST(MutexProfilingTest, RecordsContention) {
+  Mutex mutex;
+  const int line = __LINE__ - 1;
+  mutex.Lock();
+  std::thread thread([&mutex]() {
+    mutex.Lock();
+    mutex.Unlock();
+  });
+  SleepFor(TimeDelta::FromMilliseconds(20));
+  mutex.Unlock();
+  thread.join();
+
+  MutexProfile profile = GetProfileForLine(line);
+  EXPECT_EQ(2u, profile.acquisitions);
+  EXPECT_EQ(1u, profile.contended_acquisitions);
+  EXPECT_GT(profile.total_wait_time, TimeDelta::Zero());
+  EXPECT_GE(profile.total_hold_time, TimeDelta::FromMilliseconds(20));
+  // The (first, so sampled) waiter's, from the lambda out.
+  EXPECT_FALSE(profile.contention_stack.empty());
+
+  std::string dump = DumpMutexProfiles();
+  EXPECT_NE(std::string::npos, dump.find("mutex_profiling_unittest.cc:" +
+                                         std::to_string(line)));
+}
+
+#else  // defined(FTL_MUTEX_PROFILING)
+
+TEST(MutexProfilingTest, Disabled) {
+  EXPECT_FALSE(IsMutexProfilingEnabled());
+
+  Mutex mutex;
+  mutex.Lock();
+  mutex.Unlock();
+  EXPECT_TRUE(GetMutexProfiles().empty());
+  ResetMutexProfiles();
+  EXPECT_FALSE(DumpMutexProfiles().empty());
+}
+
+#endif  // defined(FTL_MUTEX_PROFILING)
+
+}  // namespace
+}  // namespace ftl
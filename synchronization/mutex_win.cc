@@ -4,40 +4,85 @@
 
 #include "lib/ftl/synchronization/mutex.h"
 
-#ifndef NDEBUG
+#if !defined(NDEBUG) || defined(FTL_MUTEX_PROFILING)
 
 #include "lib/ftl/logging.h"
+#if defined(FTL_MUTEX_PROFILING)
+#include "lib/ftl/synchronization/mutex_profiling.h"
+#endif
 
 namespace ftl {
 
+#if defined(FTL_MUTEX_PROFILING)
+Mutex::Mutex(const char* file, int line)
+    : impl_(SRWLOCK_INIT), stats_(internal::GetMutexSiteStats(file, line)) {}
+#else
 Mutex::Mutex() : impl_(SRWLOCK_INIT) {}
+#endif
 
 Mutex::~Mutex() {
+#ifndef NDEBUG
   FTL_DCHECK(owning_thread_id_ == NULL);
+#endif
 }
 
 void Mutex::Lock() FTL_EXCLUSIVE_LOCK_FUNCTION() {
+#if defined(FTL_MUTEX_PROFILING)
+  // Try first, so that only contended acquisitions pay for timing the wait.
+  if (TryAcquireSRWLockExclusive(&impl_) != 0) {
+#ifndef NDEBUG
+    CheckUnheldAndMark();
+#endif
+    RecordLocked(TimeDelta::Zero(), false);
+    return;
+  }
+  RecordContention();
+  TimePoint start = TimePoint::Now();
+#endif
   AcquireSRWLockExclusive(&impl_);
+#ifndef NDEBUG
   CheckUnheldAndMark();
+#endif
+#if defined(FTL_MUTEX_PROFILING)
+  RecordLocked(TimePoint::Now() - start, true);
+#endif
 }
 
 void Mutex::Unlock() FTL_UNLOCK_FUNCTION() {
+#if defined(FTL_MUTEX_PROFILING)
+  RecordUnlocking();
+#endif
+#ifndef NDEBUG
   CheckHeldAndUnmark();
+#endif
   ReleaseSRWLockExclusive(&impl_);
 }
 
+void Mutex::UnlockAfterFork() FTL_UNLOCK_FUNCTION() {
+  Unlock();
+}
+
 bool Mutex::TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
   if (TryAcquireSRWLockExclusive(&impl_) != 0) {
+#ifndef NDEBUG
     CheckUnheldAndMark();
+#endif
+#if defined(FTL_MUTEX_PROFILING)
+    RecordLocked(TimeDelta::Zero(), false);
+#endif
     return true;
   }
   return false;
 }
 
 void Mutex::AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK() {
+#ifndef NDEBUG
   FTL_DCHECK(owning_thread_id_ == GetCurrentThreadId()) << "pthread_mutex_lock";
+#endif
 }
 
+#ifndef NDEBUG
+
 void Mutex::CheckHeldAndUnmark() {
   FTL_DCHECK(owning_thread_id_ == GetCurrentThreadId());
   owning_thread_id_ = NULL;
@@ -48,6 +93,8 @@ void Mutex::CheckUnheldAndMark() {
   owning_thread_id_ = GetCurrentThreadId();
 }
 
+#endif  // NDEBUG
+
 }  // namespace ftl
 
-#endif  // NDEBUG
+#endif  // !defined(NDEBUG) || defined(FTL_MUTEX_PROFILING)
@@ -0,0 +1,93 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Benchmarks of handing control back and forth between two threads.
+
+#include <thread>
+
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/test/benchmark.h"
+
+namespace ftl {
+namespace {
+
+void BM_MutexLockUnlock(benchmark::State& state) {
+  Mutex mutex;
+  while (state.KeepRunning()) {
+    mutex.Lock();
+    mutex.Unlock();
+  }
+}
+FTL_BENCHMARK(BM_MutexLockUnlock);
+
+// With no other thread waiting, so neither blocks.
+void BM_WaitableEventSignalWait(benchmark::State& state) {
+  AutoResetWaitableEvent event;
+  while (state.KeepRunning()) {
+    event.Signal();
+    event.Wait();
+  }
+}
+FTL_BENCHMARK(BM_WaitableEventSignalWait);
+
+// Each iteration is a round trip: this thread passes the turn to the other,
+// which passes it back.
+void BM_CondVarPingPong(benchmark::State& state) {
+  Mutex mutex;
+  CondVar cv;
+  int turn = 0;
+  bool done = false;
+  std::thread other([&mutex, &cv, &turn, &done] {
+    MutexLocker locker(&mutex);
+    while (true) {
+      while (turn != 1 && !done)
+        cv.Wait(&mutex);
+      if (done)
+        return;
+      turn = 0;
+      cv.Signal();
+    }
+  });
+  while (state.KeepRunning()) {
+    MutexLocker locker(&mutex);
+    turn = 1;
+    cv.Signal();
+    while (turn != 0)
+      cv.Wait(&mutex);
+  }
+  {
+    MutexLocker locker(&mutex);
+    done = true;
+    cv.Signal();
+  }
+  other.join();
+}
+FTL_BENCHMARK(BM_CondVarPingPong)->UseRealTime();
+
+void BM_WaitableEventPingPong(benchmark::State& state) {
+  AutoResetWaitableEvent ping;
+  AutoResetWaitableEvent pong;
+  bool done = false;
+  std::thread other([&ping, &pong, &done] {
+    while (true) {
+      ping.Wait();
+      if (done)
+        return;
+      pong.Signal();
+    }
+  });
+  while (state.KeepRunning()) {
+    ping.Signal();
+    pong.Wait();
+  }
+  done = true;
+  ping.Signal();
+  other.join();
+}
+FTL_BENCHMARK(BM_WaitableEventPingPong)->UseRealTime();
+
+}  // namespace
+}  // namespace ftl
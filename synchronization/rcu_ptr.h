@@ -0,0 +1,69 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A pointer to read-mostly shared data, which readers load without locking.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_RCU_PTR_H_
+#define LIB_FTL_SYNCHRONIZATION_RCU_PTR_H_
+
+#include <atomic>
+#include <memory>
+
+#include "lib/ftl/macros.h"
+#include "lib/ftl/synchronization/epoch.h"
+
+namespace ftl {
+
+// An owning pointer to the current version of some shared data (e.g., a
+// configuration or a routing table), which writers replace with new versions
+// (read-copy-update). Readers load it inside an |Epoch|, which is a plain
+// load: unlike a |RefPtr| behind a mutex, there's no lock, no reference count,
+// and no cache line written by every reader. Old versions are retired (see
+// |Retire()|), and deleted once no reader can be using them.
+//
+// Example:
+//
+//   RcuPtr<const Config> g_config;
+//
+//   // Reader:
+//   {
+//     Epoch epoch;
+//     const Config* config = g_config.Get();
+//     ...
+//   }
+//
+//   // Writer:
+//   g_config.Update(std::make_unique<const Config>(...));
+//
+// Versions shouldn't be modified once published (hence |const| above): readers
+// may be using them concurrently.
+template <typename T>
+class RcuPtr final {
+ public:
+  RcuPtr() : ptr_(nullptr) {}
+  explicit RcuPtr(std::unique_ptr<T> value) : ptr_(value.release()) {}
+
+  // Deletes the current version immediately, so there may be no readers left.
+  ~RcuPtr() { delete ptr_.load(std::memory_order_relaxed); }
+
+  // Returns the current version (which may be null). This must be called
+  // inside an |Epoch|, and the result may only be used until its end.
+  T* Get() const { return ptr_.load(std::memory_order_acquire); }
+
+  // Publishes |value| as the new version, and retires the old one. Concurrent
+  // updates are safe, but one of them wins; to update based on the current
+  // version, serialize the writers (e.g., with a |Mutex|).
+  void Update(std::unique_ptr<T> value) {
+    Retire(ptr_.exchange(value.release(), std::memory_order_acq_rel));
+  }
+
+ private:
+  std::atomic<T*> ptr_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RcuPtr);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_RCU_PTR_H_
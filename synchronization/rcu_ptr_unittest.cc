@@ -0,0 +1,97 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/rcu_ptr.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumReaders = 4;
+constexpr int kNumWriters = 2;
+constexpr int64_t kNumUpdates = 2000;
+
+std::atomic<int> g_live_configs(0);
+
+// Fields that are always equal, unless a reader sees a deleted version.
+struct Config {
+  explicit Config(int64_t value) : a(value), b(value) { g_live_configs++; }
+  ~Config() {
+    a = -1;
+    b = -2;
+    g_live_configs--;
+  }
+
+  int64_t a;
+  int64_t b;
+};
+
+TEST(RcuPtrTest, Basic) {
+  {
+    RcuPtr<const Config> ptr;
+    {
+      Epoch epoch;
+      EXPECT_EQ(nullptr, ptr.Get());
+    }
+
+    ptr.Update(std::make_unique<const Config>(1));
+    {
+      Epoch epoch;
+      EXPECT_EQ(1, ptr.Get()->a);
+    }
+    ptr.Update(std::make_unique<const Config>(2));
+    {
+      Epoch epoch;
+      EXPECT_EQ(2, ptr.Get()->a);
+    }
+    SynchronizeEpochs();
+    EXPECT_EQ(1, g_live_configs.load());
+  }
+  EXPECT_EQ(0, g_live_configs.load());
+}
+
+TEST(RcuPtrTest, ConcurrentReadersAndWriters) {
+  {
+    RcuPtr<const Config> ptr(std::make_unique<const Config>(0));
+    std::atomic<int> writers_done(0);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumWriters; i++) {
+      threads.push_back(std::thread([&ptr, &writers_done]() {
+        for (int64_t j = 1; j <= kNumUpdates; j++)
+          ptr.Update(std::make_unique<const Config>(j));
+        writers_done.fetch_add(1);
+      }));
+    }
+    for (int i = 0; i < kNumReaders; i++) {
+      threads.push_back(std::thread([&ptr, &writers_done]() {
+        while (writers_done.load() < kNumWriters) {
+          Epoch epoch;
+          const Config* config = ptr.Get();
+          EXPECT_GE(config->a, 0);
+          EXPECT_LE(config->a, kNumUpdates);
+          EXPECT_EQ(config->a, config->b);
+        }
+      }));
+    }
+    for (auto& thread : threads)
+      thread.join();
+
+    // The writers' leftover versions are reclaimed here.
+    SynchronizeEpochs();
+    EXPECT_EQ(1, g_live_configs.load());
+  }
+  EXPECT_EQ(0, g_live_configs.load());
+}
+
+}  // namespace
+}  // namespace ftl
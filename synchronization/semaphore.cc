@@ -0,0 +1,58 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/semaphore.h"
+
+#include "lib/ftl/synchronization/wait_on_address.h"
+
+namespace ftl {
+
+Semaphore::Semaphore(uint32_t initial_count)
+    : count_(initial_count), waiter_count_(0u) {}
+
+Semaphore::~Semaphore() {}
+
+void Semaphore::Acquire() {
+  TryAcquireUntil(TimePoint::Max());
+}
+
+bool Semaphore::TryAcquire() {
+  uint32_t count = count_.load(std::memory_order_relaxed);
+  while (count > 0u) {
+    if (count_.compare_exchange_weak(count, count - 1u,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Semaphore::TryAcquireUntil(TimePoint deadline) {
+  for (;;) {
+    if (TryAcquire())
+      return true;
+    if (deadline != TimePoint::Max() && TimePoint::Now() >= deadline)
+      return false;
+    // Either |Release()| sees us in |waiter_count_|, or we see its permits
+    // (since the wait only blocks while |count_| is zero).
+    waiter_count_.fetch_add(1u, std::memory_order_seq_cst);
+    internal::WaitOnAddress(&count_, 0u, deadline);
+    waiter_count_.fetch_sub(1u, std::memory_order_relaxed);
+  }
+}
+
+void Semaphore::Release(uint32_t count) {
+  if (!count)
+    return;
+  count_.fetch_add(count, std::memory_order_seq_cst);
+  if (!waiter_count_.load(std::memory_order_seq_cst))
+    return;
+  if (count == 1u)
+    internal::WakeByAddressSingle(&count_);
+  else
+    internal::WakeByAddressAll(&count_);
+}
+
+}  // namespace ftl
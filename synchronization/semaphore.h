@@ -0,0 +1,54 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A counting semaphore class.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_SEMAPHORE_H_
+#define LIB_FTL_SYNCHRONIZATION_SEMAPHORE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A count of available permits (e.g., free buffers in a pool, or items in a
+// queue), which |Acquire()| waits for and takes one of, and |Release()| gives
+// back. Acquiring and releasing are a single atomic operation when there's no
+// need to wait (or to wake anyone); waiting blocks on the count itself (a futex
+// on Linux), not on a mutex and condition variable. This class is thread-safe.
+class FTL_EXPORT Semaphore final {
+ public:
+  explicit Semaphore(uint32_t initial_count = 0u);
+  ~Semaphore();
+
+  // Blocks until a permit is available, and takes it.
+  void Acquire();
+
+  // Takes a permit and returns true if one is available, or returns false.
+  bool TryAcquire();
+
+  // Like |Acquire()|, but gives up if no permit becomes available by
+  // |deadline|. Returns true if it took a permit.
+  bool TryAcquireUntil(TimePoint deadline);
+
+  // Adds |count| permits, waking waiting threads to take them.
+  void Release(uint32_t count = 1u);
+
+ private:
+  std::atomic<uint32_t> count_;
+  // The number of threads that are (about to be) blocked on |count_|, so that
+  // |Release()| only has to wake anyone when there are waiters.
+  std::atomic<uint32_t> waiter_count_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Semaphore);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_SEMAPHORE_H_
@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/semaphore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumThreads = 4;
+constexpr int kPermitsPerThread = 10000;
+
+TEST(SemaphoreTest, TryAcquire) {
+  Semaphore semaphore(2u);
+  EXPECT_TRUE(semaphore.TryAcquire());
+  EXPECT_TRUE(semaphore.TryAcquire());
+  EXPECT_FALSE(semaphore.TryAcquire());
+
+  semaphore.Release(3u);
+  semaphore.Acquire();
+  EXPECT_TRUE(semaphore.TryAcquire());
+  EXPECT_TRUE(semaphore.TryAcquireUntil(TimePoint()));
+  EXPECT_FALSE(semaphore.TryAcquire());
+}
+
+TEST(SemaphoreTest, TryAcquireUntil) {
+  Semaphore semaphore;
+  EXPECT_FALSE(semaphore.TryAcquireUntil(TimePoint::Now()));
+
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  TimePoint start = TimePoint::Now();
+  EXPECT_FALSE(semaphore.TryAcquireUntil(start + timeout));
+  EXPECT_GE(TimePoint::Now() - start, timeout - kTimeoutTolerance);
+
+  std::thread thread([&semaphore]() { semaphore.Release(); });
+  EXPECT_TRUE(semaphore.TryAcquireUntil(TimePoint::Max()));
+  thread.join();
+}
+
+TEST(SemaphoreTest, ProducersAndConsumers) {
+  Semaphore semaphore;
+  std::atomic<int> acquired(0);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.push_back(std::thread([&semaphore, &acquired]() {
+      for (int j = 0; j < kPermitsPerThread; j++) {
+        semaphore.Acquire();
+        acquired.fetch_add(1, std::memory_order_relaxed);
+      }
+    }));
+    threads.push_back(std::thread([&semaphore, i]() {
+      // Release in batches of varying sizes.
+      for (int j = 0; j < kPermitsPerThread; j += i + 1)
+        semaphore.Release(
+            static_cast<uint32_t>(std::min(i + 1, kPermitsPerThread - j)));
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kNumThreads * kPermitsPerThread, acquired.load());
+  EXPECT_FALSE(semaphore.TryAcquire());
+}
+
+}  // namespace
+}  // namespace ftl
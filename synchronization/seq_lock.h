@@ -0,0 +1,106 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A sequence lock, for values which are read far more often than written.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_SEQ_LOCK_H_
+#define LIB_FTL_SYNCHRONIZATION_SEQ_LOCK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+// Holds a small, trivially-copyable |T| (e.g., a clock offset or a set of rate
+// limits) which any number of threads may |Load()| while others |Store()| it.
+//
+// Readers don't write to shared memory at all, so they don't contend with each
+// other: a |Load()| reads a sequence number, copies the value, and then checks
+// that the sequence number hasn't changed (retrying if a |Store()| was in
+// progress). A |Store()| makes the sequence number odd while it writes. Since
+// readers spin while a store is in progress, this is only suitable if stores
+// are short and relatively rare. Concurrent |Store()|s are serialized.
+//
+// (The value is kept in relaxed atomics, so there's no data race even though
+// readers may copy it while it's being written.)
+template <typename T>
+class SeqLock final {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock requires a trivially-copyable type");
+
+  SeqLock() : SeqLock(T()) {}
+  explicit SeqLock(const T& value) : sequence_(0u) {
+    StoreWords(value);
+  }
+  ~SeqLock() {}
+
+  // Returns a consistent copy of the current value.
+  T Load() const {
+    for (;;) {
+      uint32_t sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1u)
+        continue;  // A |Store()| is in progress.
+      uint64_t words[kWordCount];
+      for (size_t i = 0u; i < kWordCount; i++)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      // Keep the loads above from moving below the check.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == sequence) {
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+      }
+    }
+  }
+
+  // Replaces the value with |value|.
+  void Store(const T& value) {
+    // Make the sequence number odd, waiting for any other store to finish.
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    for (;;) {
+      if (!(sequence & 1u) &&
+          sequence_.compare_exchange_weak(sequence, sequence + 1u,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed)) {
+        break;
+      }
+      sequence = sequence_.load(std::memory_order_relaxed);
+    }
+    // Keep the stores below from moving above the odd sequence number.
+    std::atomic_thread_fence(std::memory_order_release);
+    StoreWords(value);
+    sequence_.store(sequence + 2u, std::memory_order_release);
+  }
+
+ private:
+  static constexpr size_t kWordCount =
+      (sizeof(T) + sizeof(uint64_t) - 1u) / sizeof(uint64_t);
+
+  void StoreWords(const T& value) {
+    uint64_t words[kWordCount] = {};
+    memcpy(words, &value, sizeof(T));
+    for (size_t i = 0u; i < kWordCount; i++)
+      words_[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  // Odd while a |Store()| is in progress.
+  std::atomic<uint32_t> sequence_;
+  std::atomic<uint64_t> words_[kWordCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SeqLock);
+};
+
+template <typename T>
+constexpr size_t SeqLock<T>::kWordCount;
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_SEQ_LOCK_H_
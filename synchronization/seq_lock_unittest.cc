@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/seq_lock.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+constexpr int kNumReaders = 3;
+constexpr int kNumWriters = 2;
+constexpr int64_t kNumStores = 20000;
+
+// 32 bytes, which shouldn't be read torn.
+struct Snapshot {
+  int64_t a;
+  int64_t b;
+  int64_t c;
+  int64_t d;
+};
+
+// Not a multiple of the word size.
+struct Small {
+  uint8_t x;
+  uint16_t y;
+};
+
+TEST(SeqLockTest, Basic) {
+  SeqLock<Snapshot> lock;
+  Snapshot snapshot = lock.Load();
+  EXPECT_EQ(0, snapshot.a);
+  EXPECT_EQ(0, snapshot.d);
+
+  lock.Store(Snapshot{1, 2, 3, 4});
+  snapshot = lock.Load();
+  EXPECT_EQ(1, snapshot.a);
+  EXPECT_EQ(2, snapshot.b);
+  EXPECT_EQ(3, snapshot.c);
+  EXPECT_EQ(4, snapshot.d);
+
+  SeqLock<Small> small(Small{5u, 6u});
+  EXPECT_EQ(5u, small.Load().x);
+  EXPECT_EQ(6u, small.Load().y);
+  small.Store(Small{7u, 8u});
+  EXPECT_EQ(7u, small.Load().x);
+  EXPECT_EQ(8u, small.Load().y);
+
+  SeqLock<int> value(42);
+  EXPECT_EQ(42, value.Load());
+}
+
+TEST(SeqLockTest, NoTornReads) {
+  SeqLock<Snapshot> lock;
+  std::atomic<int> writers_done(0);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumWriters; i++) {
+    threads.push_back(std::thread([&lock, &writers_done]() {
+      for (int64_t j = 1; j <= kNumStores; j++)
+        lock.Store(Snapshot{j, j, j, j});
+      writers_done.fetch_add(1);
+    }));
+  }
+  for (int i = 0; i < kNumReaders; i++) {
+    threads.push_back(std::thread([&lock, &writers_done]() {
+      while (writers_done.load() < kNumWriters) {
+        Snapshot snapshot = lock.Load();
+        EXPECT_EQ(snapshot.a, snapshot.b);
+        EXPECT_EQ(snapshot.a, snapshot.c);
+        EXPECT_EQ(snapshot.a, snapshot.d);
+        // With two writers, values may go backwards, but stay in range.
+        EXPECT_GE(snapshot.a, 0);
+        EXPECT_LE(snapshot.a, kNumStores);
+      }
+    }));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(kNumStores, lock.Load().a);
+}
+
+}  // namespace
+}  // namespace ftl
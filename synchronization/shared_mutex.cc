@@ -0,0 +1,127 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/shared_mutex.h"
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+constexpr size_t kUnassignedReaderSlot = static_cast<size_t>(-1);
+
+// Threads are assigned reader slots round-robin, on first use.
+std::atomic<size_t> g_next_reader_slot(0u);
+thread_local size_t g_reader_slot = kUnassignedReaderSlot;
+
+}  // namespace
+
+constexpr size_t SharedMutex::kReaderSlotCount;
+
+SharedMutex::SharedMutex() : writer_(false) {}
+
+SharedMutex::~SharedMutex() {
+  FTL_DCHECK(!writer_.load(std::memory_order_relaxed));
+  FTL_DCHECK(!HasReaders());
+}
+
+void SharedMutex::Lock() FTL_EXCLUSIVE_LOCK_FUNCTION() {
+  MutexLocker locker(&mutex_);
+  while (writer_.load(std::memory_order_relaxed))
+    writer_done_cv_.Wait(&mutex_);
+  // From here on, new readers back off, so we only have to wait for the
+  // current ones to leave. (This and the readers' accesses are sequentially
+  // consistent, so either we see a reader's count or it sees |writer_|.)
+  writer_.store(true, std::memory_order_seq_cst);
+  while (HasReaders())
+    readers_drained_cv_.Wait(&mutex_);
+}
+
+void SharedMutex::Unlock() FTL_UNLOCK_FUNCTION() {
+  MutexLocker locker(&mutex_);
+  FTL_DCHECK(writer_.load(std::memory_order_relaxed));
+  writer_.store(false, std::memory_order_seq_cst);
+  writer_done_cv_.SignalAll();
+}
+
+bool SharedMutex::TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
+  MutexLocker locker(&mutex_);
+  if (writer_.load(std::memory_order_relaxed))
+    return false;
+  writer_.store(true, std::memory_order_seq_cst);
+  if (!HasReaders())
+    return true;
+  // Readers may have backed off in the meantime.
+  writer_.store(false, std::memory_order_seq_cst);
+  writer_done_cv_.SignalAll();
+  return false;
+}
+
+void SharedMutex::LockShared() FTL_SHARED_LOCK_FUNCTION() {
+  std::atomic<int32_t>* slot = CurrentReaderSlot();
+  for (;;) {
+    slot->fetch_add(1, std::memory_order_seq_cst);
+    if (!writer_.load(std::memory_order_seq_cst))
+      return;
+
+    // A writer holds the lock or is waiting for it, so back off until it's
+    // done.
+    ReleaseReaderSlot(slot);
+    MutexLocker locker(&mutex_);
+    while (writer_.load(std::memory_order_relaxed))
+      writer_done_cv_.Wait(&mutex_);
+  }
+}
+
+void SharedMutex::UnlockShared() FTL_UNLOCK_FUNCTION() {
+  ReleaseReaderSlot(CurrentReaderSlot());
+}
+
+bool SharedMutex::TryLockShared() FTL_SHARED_TRYLOCK_FUNCTION(true) {
+  std::atomic<int32_t>* slot = CurrentReaderSlot();
+  slot->fetch_add(1, std::memory_order_seq_cst);
+  if (!writer_.load(std::memory_order_seq_cst))
+    return true;
+  ReleaseReaderSlot(slot);
+  return false;
+}
+
+void SharedMutex::AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK() {
+#ifndef NDEBUG
+  FTL_DCHECK(writer_.load(std::memory_order_relaxed) && !HasReaders());
+#endif  // NDEBUG
+}
+
+void SharedMutex::AssertReaderHeld() FTL_ASSERT_SHARED_LOCK() {
+#ifndef NDEBUG
+  FTL_DCHECK(writer_.load(std::memory_order_relaxed) || HasReaders());
+#endif  // NDEBUG
+}
+
+std::atomic<int32_t>* SharedMutex::CurrentReaderSlot() {
+  if (g_reader_slot == kUnassignedReaderSlot) {
+    g_reader_slot = g_next_reader_slot.fetch_add(1u, std::memory_order_relaxed);
+  }
+  return reader_slots_[g_reader_slot % kReaderSlotCount].get();
+}
+
+void SharedMutex::ReleaseReaderSlot(std::atomic<int32_t>* slot) {
+  slot->fetch_sub(1, std::memory_order_seq_cst);
+  if (writer_.load(std::memory_order_seq_cst)) {
+    // Taking |mutex_| ensures that the writer is either waiting (and gets
+    // this signal) or hasn't checked the counts yet.
+    MutexLocker locker(&mutex_);
+    readers_drained_cv_.Signal();
+  }
+}
+
+bool SharedMutex::HasReaders() const {
+  for (const auto& slot : reader_slots_) {
+    if (slot->load(std::memory_order_seq_cst))
+      return true;
+  }
+  return false;
+}
+
+}  // namespace ftl
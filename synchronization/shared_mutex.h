@@ -0,0 +1,131 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A reader-writer mutex class, with support for thread annotations.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_SHARED_MUTEX_H_
+#define LIB_FTL_SYNCHRONIZATION_SHARED_MUTEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+
+// SharedMutex -----------------------------------------------------------------
+
+// A mutex which may be held by any number of readers (see |LockShared()|) or a
+// single writer (see |Lock()|), for read-mostly data (e.g., configuration
+// snapshots or routing tables). Use with |ReaderMutexLocker| and
+// |WriterMutexLocker|.
+//
+// Readers are counted in several counters on separate cache lines (each thread
+// uses one of them), so that readers on different cores mostly don't contend
+// with each other; uncontended reader locks and unlocks are a single atomic
+// operation each. In exchange, taking a writer lock is slower, since it has to
+// check every counter.
+//
+// Writers are preferred: once a writer is waiting, new readers wait for it
+// (rather than starving it).
+//
+// A shared lock must be released on the thread which took it, and may not be
+// taken recursively (a waiting writer would deadlock it).
+class FTL_LOCKABLE FTL_EXPORT SharedMutex final {
+ public:
+  SharedMutex();
+  ~SharedMutex();
+
+  // Takes an exclusive (writer) lock.
+  void Lock() FTL_EXCLUSIVE_LOCK_FUNCTION();
+  // Releases an exclusive lock.
+  void Unlock() FTL_UNLOCK_FUNCTION();
+  // Tries to take an exclusive lock, returning true if successful. This fails
+  // if the mutex is held by another writer or any reader.
+  bool TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true);
+
+  // Takes a shared (reader) lock.
+  void LockShared() FTL_SHARED_LOCK_FUNCTION();
+  // Releases a shared lock.
+  void UnlockShared() FTL_UNLOCK_FUNCTION();
+  // Tries to take a shared lock, returning true if successful.
+  bool TryLockShared() FTL_SHARED_TRYLOCK_FUNCTION(true);
+
+  // Asserts that an exclusive lock is held (though not necessarily by the
+  // calling thread). (Does nothing for non-Debug builds.)
+  void AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK();
+  // Asserts that a shared or exclusive lock is held (though not necessarily by
+  // the calling thread). (Does nothing for non-Debug builds.)
+  void AssertReaderHeld() FTL_ASSERT_SHARED_LOCK();
+
+ private:
+  static constexpr size_t kReaderSlotCount = 16u;
+
+  // A reader count, padded so that each is on its own cache line.
+  using ReaderSlot = CacheLinePadded<std::atomic<int32_t>>;
+
+  // Returns the reader count for the current thread.
+  std::atomic<int32_t>* CurrentReaderSlot();
+  // Decrements |*slot|, waking a writer waiting for the readers to drain.
+  void ReleaseReaderSlot(std::atomic<int32_t>* slot);
+  bool HasReaders() const;
+
+  ReaderSlot reader_slots_[kReaderSlotCount];
+  // Set while a writer holds (or is waiting for the readers to release) the
+  // lock; written under |mutex_|.
+  std::atomic<bool> writer_;
+
+  Mutex mutex_;
+  // Signaled when the last reader leaves while |writer_| is set.
+  CondVar readers_drained_cv_;
+  // Signaled when |writer_| is cleared.
+  CondVar writer_done_cv_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SharedMutex);
+};
+
+// ReaderMutexLocker -----------------------------------------------------------
+
+class FTL_SCOPED_LOCKABLE ReaderMutexLocker final {
+ public:
+  explicit ReaderMutexLocker(SharedMutex* mutex)
+      FTL_SHARED_LOCK_FUNCTION(mutex)
+      : mutex_(mutex) {
+    mutex_->LockShared();
+  }
+  ~ReaderMutexLocker() FTL_UNLOCK_FUNCTION() { mutex_->UnlockShared(); }
+
+ private:
+  SharedMutex* const mutex_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ReaderMutexLocker);
+};
+
+// WriterMutexLocker -----------------------------------------------------------
+
+class FTL_SCOPED_LOCKABLE WriterMutexLocker final {
+ public:
+  explicit WriterMutexLocker(SharedMutex* mutex)
+      FTL_EXCLUSIVE_LOCK_FUNCTION(mutex)
+      : mutex_(mutex) {
+    mutex_->Lock();
+  }
+  ~WriterMutexLocker() FTL_UNLOCK_FUNCTION() { mutex_->Unlock(); }
+
+ private:
+  SharedMutex* const mutex_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WriterMutexLocker);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_SHARED_MUTEX_H_
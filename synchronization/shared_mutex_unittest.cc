@@ -0,0 +1,107 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/shared_mutex.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TEST(SharedMutexTest, TryLock) FTL_NO_THREAD_SAFETY_ANALYSIS {
+  SharedMutex mutex;
+
+  // Any number of readers...
+  ASSERT_TRUE(mutex.TryLockShared());
+  mutex.AssertReaderHeld();
+  auto thread = std::thread([&mutex]() {
+    EXPECT_TRUE(mutex.TryLockShared());
+    mutex.UnlockShared();
+    // ... but no writer.
+    EXPECT_FALSE(mutex.TryLock());
+  });
+  thread.join();
+  mutex.UnlockShared();
+
+  ASSERT_TRUE(mutex.TryLock());
+  mutex.AssertHeld();
+  mutex.AssertReaderHeld();
+  thread = std::thread([&mutex]() {
+    EXPECT_FALSE(mutex.TryLockShared());
+    EXPECT_FALSE(mutex.TryLock());
+  });
+  thread.join();
+  mutex.Unlock();
+
+  ASSERT_TRUE(mutex.TryLockShared());
+  mutex.UnlockShared();
+}
+
+TEST(SharedMutexTest, Lockers) {
+  SharedMutex mutex;
+
+  {
+    ReaderMutexLocker locker1(&mutex);
+    ReaderMutexLocker locker2(&mutex);
+    mutex.AssertReaderHeld();
+  }
+  {
+    WriterMutexLocker locker(&mutex);
+    mutex.AssertHeld();
+  }
+}
+
+// Writers keep two values equal; readers (on more threads than there are
+// reader slots) check that they never see them differ.
+TEST(SharedMutexTest, Excludes) {
+  constexpr int kReaderThreadCount = 20;
+  constexpr int kWriterThreadCount = 2;
+  constexpr int kIterationCount = 2000;
+  SharedMutex mutex;
+  int value1 = 0;
+  int value2 = 0;
+  std::atomic<int> max_concurrent_readers(0);
+  std::atomic<int> concurrent_readers(0);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kReaderThreadCount; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < kIterationCount; j++) {
+        ReaderMutexLocker locker(&mutex);
+        int readers = concurrent_readers.fetch_add(1) + 1;
+        int max_readers = max_concurrent_readers.load();
+        while (readers > max_readers &&
+               !max_concurrent_readers.compare_exchange_weak(max_readers,
+                                                             readers)) {
+        }
+        EXPECT_EQ(value1, value2);
+        concurrent_readers.fetch_sub(1);
+      }
+    });
+  }
+  for (int i = 0; i < kWriterThreadCount; i++) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < kIterationCount; j++) {
+        WriterMutexLocker locker(&mutex);
+        EXPECT_EQ(0, concurrent_readers.load());
+        value1++;
+        std::this_thread::yield();
+        value2++;
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kWriterThreadCount * kIterationCount, value1);
+  EXPECT_EQ(value1, value2);
+  EXPECT_GE(max_concurrent_readers.load(), 1);
+}
+
+}  // namespace
+}  // namespace ftl
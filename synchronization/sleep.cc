@@ -4,13 +4,103 @@
 
 #include "lib/ftl/synchronization/sleep.h"
 
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
+#include "lib/ftl/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <errno.h>
+#include <sys/prctl.h>
+#include <time.h>
+#elif defined(OS_WIN)
+#include <windows.h>
+#endif
+
 namespace ftl {
+namespace {
+
+// Bounds on, and the initial value of, how long before its deadline
+// |SleepUntilPrecise()| stops sleeping and starts spinning.
+constexpr int64_t kMinSpinNanoseconds = 2 * 1000;
+constexpr int64_t kMaxSpinNanoseconds = 2 * 1000 * 1000;
+constexpr int64_t kInitialSpinNanoseconds = 100 * 1000;
+
+thread_local int64_t g_spin_nanoseconds = kInitialSpinNanoseconds;
+
+// Tells the CPU that this is a spin-wait loop (as in spinning_mutex.cc).
+inline void CpuRelax() {
+#if defined(OS_WIN)
+  YieldProcessor();
+#elif defined(ARCH_CPU_X86_FAMILY)
+  __builtin_ia32_pause();
+#elif defined(ARCH_CPU_ARM_FAMILY)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+}  // namespace
 
 void SleepFor(TimeDelta duration) {
   std::this_thread::sleep_for(std::chrono::nanoseconds(duration.ToNanoseconds()));
 }
 
+void SleepUntil(TimePoint deadline) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // |TimePoint::Now()| is |CLOCK_MONOTONIC| here, so the kernel can sleep
+  // until the deadline itself (which also holds across signals).
+  const int64_t nanoseconds = deadline.ToEpochDelta().ToNanoseconds();
+  if (nanoseconds <= 0)
+    return;
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(nanoseconds / 1000000000);
+  ts.tv_nsec = static_cast<long>(nanoseconds % 1000000000);
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+         EINTR) {
+  }
+#else
+  for (;;) {
+    const TimeDelta remaining = deadline - TimePoint::Now();
+    if (remaining <= TimeDelta::Zero())
+      return;
+    SleepFor(remaining);
+  }
+#endif
+}
+
+void SleepUntilPrecise(TimePoint deadline) {
+  const TimePoint wake_time =
+      deadline - TimeDelta::FromNanoseconds(g_spin_nanoseconds);
+  if (TimePoint::Now() < wake_time) {
+    SleepUntil(wake_time);
+    // Spin for a margin more than that sleep overslept, next time. (Follow
+    // later wakeups at once, but earlier ones only gradually.)
+    const int64_t late = (TimePoint::Now() - wake_time).ToNanoseconds();
+    const int64_t target = late + late / 4 + kMinSpinNanoseconds;
+    int64_t spin = target > g_spin_nanoseconds
+                       ? target
+                       : g_spin_nanoseconds - (g_spin_nanoseconds - target) / 8;
+    g_spin_nanoseconds =
+        std::min(std::max(spin, kMinSpinNanoseconds), kMaxSpinNanoseconds);
+  }
+  while (TimePoint::Now() < deadline)
+    CpuRelax();
+}
+
+void SleepForPrecise(TimeDelta duration) {
+  SleepUntilPrecise(TimePoint::Now() + duration);
+}
+
+bool SetCurrentThreadTimerSlack(TimeDelta slack) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // (A slack of zero would mean the thread's default, so use the least, 1 ns.)
+  const int64_t nanoseconds = std::max<int64_t>(slack.ToNanoseconds(), 1);
+  return prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(nanoseconds), 0,
+               0, 0) == 0;
+#else
+  return false;
+#endif
+}
+
 }  // namespace ftl
@@ -8,11 +8,30 @@
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 
 FTL_EXPORT void SleepFor(TimeDelta duration);
 
+// Sleeps until |TimePoint::Now()| reaches |deadline| (returning at once if it
+// has). Like |SleepFor()|, this may wake late, by the OS's timer slack (50 us
+// by default on Linux) plus scheduling delays.
+FTL_EXPORT void SleepUntil(TimePoint deadline);
+
+// These wake within a few microseconds of |deadline| (unless preempted): they
+// sleep until shortly before it (by how late this thread's recent sleeps have
+// woken), then spin. The spinning keeps a CPU busy, so only use these where
+// the precision is needed, e.g., for pacing.
+FTL_EXPORT void SleepUntilPrecise(TimePoint deadline);
+FTL_EXPORT void SleepForPrecise(TimeDelta duration);
+
+// Sets how late the OS may wake the calling thread from timed sleeps and waits
+// (e.g., to coalesce wakeups), with |PR_SET_TIMERSLACK| on Linux: less for
+// precision, or more to save power. Returns false if the OS doesn't support
+// this.
+FTL_EXPORT bool SetCurrentThreadTimerSlack(TimeDelta slack);
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_SYNCHRONIZATION_SLEEP_H_
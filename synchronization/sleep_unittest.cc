@@ -0,0 +1,74 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/sleep.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/prctl.h>
+#endif
+
+namespace ftl {
+namespace {
+
+TEST(Sleep, SleepFor) {
+  const TimePoint start = TimePoint::Now();
+  SleepFor(TimeDelta::FromMilliseconds(5));
+  EXPECT_GE(TimePoint::Now() - start, TimeDelta::FromMilliseconds(5));
+}
+
+TEST(Sleep, SleepUntil) {
+  const TimePoint deadline = TimePoint::Now() + TimeDelta::FromMilliseconds(5);
+  SleepUntil(deadline);
+  EXPECT_GE(TimePoint::Now(), deadline);
+
+  // Past deadlines return at once.
+  const TimePoint start = TimePoint::Now();
+  SleepUntil(start - TimeDelta::FromSeconds(1));
+  SleepUntil(TimePoint());
+  SleepUntil(TimePoint::Min());
+  EXPECT_LT(TimePoint::Now() - start, TimeDelta::FromMilliseconds(500));
+}
+
+TEST(Sleep, SleepUntilPrecise) {
+  TimeDelta best_lateness = TimeDelta::Max();
+  for (int i = 0; i < 20; i++) {
+    const TimePoint deadline =
+        TimePoint::Now() + TimeDelta::FromMilliseconds(2);
+    SleepUntilPrecise(deadline);
+    const TimeDelta lateness = TimePoint::Now() - deadline;
+    EXPECT_GE(lateness, TimeDelta::Zero());
+    best_lateness = std::min(best_lateness, lateness);
+  }
+  // (Loosely, since the machine may be busy.)
+  EXPECT_LT(best_lateness, TimeDelta::FromMicroseconds(50));
+
+  const TimePoint start = TimePoint::Now();
+  SleepForPrecise(TimeDelta::FromMilliseconds(1));
+  EXPECT_GE(TimePoint::Now() - start, TimeDelta::FromMilliseconds(1));
+  SleepForPrecise(TimeDelta::FromMilliseconds(-1));
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+TEST(Sleep, SetCurrentThreadTimerSlack) {
+  // On another thread, so as not to change this one's.
+  std::thread thread([] {
+    EXPECT_TRUE(SetCurrentThreadTimerSlack(TimeDelta::FromMicroseconds(1)));
+    EXPECT_EQ(1000, prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0));
+    EXPECT_TRUE(SetCurrentThreadTimerSlack(TimeDelta::Zero()));
+    EXPECT_EQ(1, prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0));
+  });
+  thread.join();
+}
+
+#endif
+
+}  // namespace
+}  // namespace ftl
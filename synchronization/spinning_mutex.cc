@@ -0,0 +1,156 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/spinning_mutex.h"
+
+#include <algorithm>
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(OS_WIN)
+#include <windows.h>
+#endif
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+// Bounds on how many times |LockSlow()| spins before blocking.
+constexpr int32_t kMinSpinCount = 10;
+constexpr int32_t kMaxSpinCount = 100;
+
+// Tells the CPU that this is a spin-wait loop (which, e.g., saves power and
+// frees up resources for a hyperthread sibling).
+inline void CpuRelax() {
+#if defined(OS_WIN)
+  YieldProcessor();
+#elif defined(ARCH_CPU_X86_FAMILY)
+  __builtin_ia32_pause();
+#elif defined(ARCH_CPU_ARM_FAMILY)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "std::atomic<uint32_t> can't be used as a futex");
+
+uint32_t* FutexAddress(std::atomic<uint32_t>* state) {
+  return reinterpret_cast<uint32_t*>(state);
+}
+
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+#ifndef NDEBUG
+
+// Returns something that uniquely identifies the current thread.
+const void* CurrentThreadToken() {
+  static thread_local char token;
+  return &token;
+}
+
+#endif  // NDEBUG
+
+}  // namespace
+
+SpinningMutex::SpinningMutex() : spin_estimate_(0) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  state_.store(kUnlocked, std::memory_order_relaxed);
+#endif
+#ifndef NDEBUG
+  owner_.store(nullptr, std::memory_order_relaxed);
+#endif
+}
+
+SpinningMutex::~SpinningMutex() {
+#ifndef NDEBUG
+  FTL_DCHECK(!owner_.load(std::memory_order_relaxed))
+      << "SpinningMutex destroyed while held";
+#endif
+}
+
+#ifndef NDEBUG
+
+void SpinningMutex::Lock() FTL_EXCLUSIVE_LOCK_FUNCTION() {
+  FTL_DCHECK(owner_.load(std::memory_order_relaxed) != CurrentThreadToken())
+      << "SpinningMutex is already held by this thread";
+  LockInternal();
+  owner_.store(CurrentThreadToken(), std::memory_order_relaxed);
+}
+
+void SpinningMutex::Unlock() FTL_UNLOCK_FUNCTION() {
+  AssertHeld();
+  owner_.store(nullptr, std::memory_order_relaxed);
+  UnlockInternal();
+}
+
+bool SpinningMutex::TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
+  if (!TryLockInternal())
+    return false;
+  owner_.store(CurrentThreadToken(), std::memory_order_relaxed);
+  return true;
+}
+
+void SpinningMutex::AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK() {
+  FTL_DCHECK(owner_.load(std::memory_order_relaxed) == CurrentThreadToken())
+      << "SpinningMutex is not held by this thread";
+}
+
+#endif  // NDEBUG
+
+void SpinningMutex::LockSlow() {
+  int32_t estimate = spin_estimate_.load(std::memory_order_relaxed);
+  int32_t max_spins = std::min(kMaxSpinCount, 2 * estimate + kMinSpinCount);
+  int32_t spins = 0;
+  bool locked = false;
+  for (; spins < max_spins; spins++) {
+    CpuRelax();
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+    // Only try to take the lock when it looks free, to avoid bouncing the
+    // cache line between spinning threads.
+    if (state_.load(std::memory_order_relaxed) == kUnlocked &&
+        TryLockInternal()) {
+      locked = true;
+      break;
+    }
+#else
+    if (TryLockInternal()) {
+      locked = true;
+      break;
+    }
+#endif
+  }
+  spin_estimate_.store(estimate + (spins - estimate) / 8,
+                       std::memory_order_relaxed);
+  if (locked)
+    return;
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Mark the lock as contended (so that |Unlock()| wakes a waiter), and block
+  // until it is released. Since we can't tell whether there are other waiters,
+  // the lock stays marked as contended once we get it.
+  while (state_.exchange(kLockedWithWaiters, std::memory_order_acquire) !=
+         kUnlocked) {
+    syscall(SYS_futex, FutexAddress(&state_), FUTEX_WAIT_PRIVATE,
+            kLockedWithWaiters, nullptr, nullptr, 0);
+  }
+#else
+  impl_.Lock();
+#endif
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+void SpinningMutex::WakeWaiter() {
+  syscall(SYS_futex, FutexAddress(&state_), FUTEX_WAKE_PRIVATE, 1, nullptr,
+          nullptr, 0);
+}
+
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+}  // namespace ftl
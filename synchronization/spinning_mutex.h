@@ -0,0 +1,151 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A mutex class which spins briefly before blocking, with support for thread
+// annotations.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_SPINNING_MUTEX_H_
+#define LIB_FTL_SYNCHRONIZATION_SPINNING_MUTEX_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+#if !defined(OS_LINUX) && !defined(OS_ANDROID)
+#include "lib/ftl/synchronization/mutex.h"
+#endif
+
+namespace ftl {
+
+// SpinningMutex ---------------------------------------------------------------
+
+// A mutex for short critical sections under contention (e.g., around shared
+// queues). Rather than blocking in the kernel as soon as the lock is found to
+// be held, |Lock()| spins for a while first, for up to about twice as long as
+// it has recently taken to get the lock (like glibc's adaptive mutexes, but
+// bounded). On Linux, it is implemented directly on a futex (a lock word which
+// is unlocked, locked, or locked with waiters, so that uncontended |Lock()|s
+// and |Unlock()|s are a single atomic operation each); elsewhere, it spins on
+// |Mutex::TryLock()|.
+//
+// Unlike |Mutex|, this can't be used with |CondVar|.
+class FTL_LOCKABLE FTL_EXPORT SpinningMutex final {
+ public:
+  SpinningMutex();
+  ~SpinningMutex();
+
+#ifndef NDEBUG
+  void Lock() FTL_EXCLUSIVE_LOCK_FUNCTION();
+  void Unlock() FTL_UNLOCK_FUNCTION();
+
+  bool TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true);
+
+  void AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK();
+#else
+  // Takes an exclusive lock.
+  void Lock() FTL_EXCLUSIVE_LOCK_FUNCTION() { LockInternal(); }
+
+  // Releases a lock.
+  void Unlock() FTL_UNLOCK_FUNCTION() { UnlockInternal(); }
+
+  // Tries to take an exclusive lock, returning true if successful.
+  bool TryLock() FTL_EXCLUSIVE_TRYLOCK_FUNCTION(true) {
+    return TryLockInternal();
+  }
+
+  // Asserts that an exclusive lock is held by the calling thread. (Does nothing
+  // for non-Debug builds.)
+  void AssertHeld() FTL_ASSERT_EXCLUSIVE_LOCK() {}
+#endif  // NDEBUG
+
+ private:
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  enum : uint32_t {
+    kUnlocked = 0u,
+    kLocked = 1u,
+    // Locked, and other threads may be blocked in |FUTEX_WAIT|.
+    kLockedWithWaiters = 2u,
+  };
+
+  void LockInternal() {
+    uint32_t expected = kUnlocked;
+    if (!state_.compare_exchange_strong(expected, kLocked,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+      LockSlow();
+    }
+  }
+
+  void UnlockInternal() {
+    if (state_.exchange(kUnlocked, std::memory_order_release) ==
+        kLockedWithWaiters) {
+      WakeWaiter();
+    }
+  }
+
+  bool TryLockInternal() {
+    uint32_t expected = kUnlocked;
+    return state_.compare_exchange_strong(expected, kLocked,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void WakeWaiter();
+
+  // The futex word.
+  std::atomic<uint32_t> state_;
+#else
+  void LockInternal() {
+    if (!impl_.TryLock())
+      LockSlow();
+  }
+
+  void UnlockInternal() { impl_.Unlock(); }
+
+  bool TryLockInternal() { return impl_.TryLock(); }
+
+  Mutex impl_;
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+  // Spins, then blocks, until the lock is taken.
+  void LockSlow();
+
+  // A moving average of how many spins it took to get the lock when |Lock()|
+  // found it held (or the limit, if spinning failed). This is just a hint, so
+  // it's updated racily.
+  std::atomic<int32_t> spin_estimate_;
+
+#ifndef NDEBUG
+  // Identifies the thread holding the lock, if any.
+  std::atomic<const void*> owner_;
+#endif  // NDEBUG
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SpinningMutex);
+};
+
+// SpinningMutexLocker ---------------------------------------------------------
+
+class FTL_SCOPED_LOCKABLE SpinningMutexLocker final {
+ public:
+  explicit SpinningMutexLocker(SpinningMutex* mutex)
+      FTL_EXCLUSIVE_LOCK_FUNCTION(mutex)
+      : mutex_(mutex) {
+    mutex_->Lock();
+  }
+  ~SpinningMutexLocker() FTL_UNLOCK_FUNCTION() { mutex_->Unlock(); }
+
+ private:
+  SpinningMutex* const mutex_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SpinningMutexLocker);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_SPINNING_MUTEX_H_
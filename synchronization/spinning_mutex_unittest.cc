@@ -0,0 +1,89 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/spinning_mutex.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TEST(SpinningMutexTest, TryLock) FTL_NO_THREAD_SAFETY_ANALYSIS {
+  SpinningMutex mutex;
+
+  ASSERT_TRUE(mutex.TryLock());
+  mutex.AssertHeld();
+  {
+    // Another thread can't get the mutex while it's held.
+    auto thread = std::thread([&mutex]() { EXPECT_FALSE(mutex.TryLock()); });
+    thread.join();
+  }
+  mutex.Unlock();
+
+  {
+    auto thread = std::thread([&mutex]() {
+      EXPECT_TRUE(mutex.TryLock());
+      mutex.AssertHeld();
+      mutex.Unlock();
+    });
+    thread.join();
+  }
+}
+
+TEST(SpinningMutexTest, AssertHeld) {
+  SpinningMutex mutex;
+
+#ifdef NDEBUG
+  // For non-Debug builds, |AssertHeld()| should do nothing.
+  mutex.AssertHeld();
+#else
+  EXPECT_DEATH_IF_SUPPORTED({ mutex.AssertHeld(); }, "not held");
+#endif  // NDEBUG
+}
+
+// Short critical sections under heavy contention, so that threads both spin
+// and block.
+TEST(SpinningMutexTest, Excludes) {
+  constexpr int kThreadCount = 8;
+  constexpr int kIterationCount = 20000;
+  SpinningMutex mutex;
+  int value = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; i++) {
+    threads.emplace_back([&mutex, &value]() {
+      for (int j = 0; j < kIterationCount; j++) {
+        SpinningMutexLocker locker(&mutex);
+        int v = value;
+        if (j % 1000 == 0)
+          std::this_thread::yield();
+        value = v + 1;
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+
+  EXPECT_EQ(kThreadCount * kIterationCount, value);
+}
+
+TEST(SpinningMutexTest, SpinningMutexLocker) {
+  SpinningMutex mutex;
+
+  {
+    SpinningMutexLocker locker(&mutex);
+    mutex.AssertHeld();
+  }
+
+  // The destruction of |locker| should unlock |mutex|.
+  ASSERT_TRUE(mutex.TryLock());
+  mutex.AssertHeld();
+  mutex.Unlock();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A lock-free single-producer, single-consumer ring buffer.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_SPSC_RING_H_
+#define LIB_FTL_SYNCHRONIZATION_SPSC_RING_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/cache_line_padded.h"
+
+namespace ftl {
+
+// A queue of up to |N| |T|s (which must be default-constructible and movable),
+// for handing values from one thread (the producer, which may only use the
+// push methods) to another (the consumer, which may only use the pop methods)
+// without locking. |N| must be a power of two. The values are stored inline, so
+// a ring with a large |N| should itself be allocated on the heap.
+//
+// The producer's and the consumer's positions are on separate cache lines, and
+// each thread keeps a copy of the other's position, which it only refreshes
+// when the ring looks full (or empty), so that they don't bounce cache lines
+// back and forth on every operation. The batch methods move many values with a
+// single publishing store, so they're the fastest way to move a lot of data.
+template <typename T, size_t N>
+class SpscRing final {
+ public:
+  static_assert(N > 0u && (N & (N - 1u)) == 0u,
+                "SpscRing's capacity must be a power of two");
+
+  SpscRing() : head_(0u), tail_(0u) {}
+  ~SpscRing() {}
+
+  static constexpr size_t capacity() { return N; }
+
+  // Producer methods ----------------------------------------------------------
+
+  // Moves from |*value| to the back of the ring and returns true, or returns
+  // false (leaving |*value| alone) if the ring is full.
+  bool TryPush(T* value) { return PushBatch(value, 1u) == 1u; }
+
+  // Moves as many of |values[0]|, ..., |values[count - 1]| as fit (in order)
+  // to the back of the ring, and returns how many it moved.
+  size_t PushBatch(T* values, size_t count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (N - (head - producer_cached_tail_) < count)
+      producer_cached_tail_ = tail_.load(std::memory_order_acquire);
+    count = std::min(count, N - (head - producer_cached_tail_));
+    // (In at most two runs, which are memmove()s for trivially-copyable |T|s.)
+    const size_t start = head & (N - 1u);
+    const size_t first = std::min(count, N - start);
+    std::move(values, values + first, buffer_ + start);
+    std::move(values + first, values + count, buffer_);
+    head_.store(head + count, std::memory_order_release);
+    return count;
+  }
+
+  // Moves all of |values[0]|, ..., |values[count - 1]| (in order) to the back
+  // of the ring and returns true, or returns false (moving none) if they don't
+  // all fit.
+  bool TryPushAll(T* values, size_t count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (N - (head - producer_cached_tail_) < count) {
+      producer_cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (N - (head - producer_cached_tail_) < count)
+        return false;
+    }
+    return PushBatch(values, count) == count;
+  }
+
+  // Returns true if |count| values can be pushed now (and so until the
+  // producer pushes some). Lets the producer push several batches all or
+  // nothing.
+  bool HasRoomFor(size_t count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (N - (head - producer_cached_tail_) < count)
+      producer_cached_tail_ = tail_.load(std::memory_order_acquire);
+    return N - (head - producer_cached_tail_) >= count;
+  }
+
+  // Consumer methods ----------------------------------------------------------
+
+  // Moves the front of the ring to |*value| and returns true, or returns false
+  // if the ring is empty.
+  bool TryPop(T* value) { return PopBatch(value, 1u) == 1u; }
+
+  // Moves up to |max_count| values (in order) from the front of the ring to
+  // |values[0]|, ..., and returns how many it moved.
+  size_t PopBatch(T* values, size_t max_count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (consumer_cached_head_ - tail < max_count)
+      consumer_cached_head_ = head_.load(std::memory_order_acquire);
+    size_t count = std::min(max_count, consumer_cached_head_ - tail);
+    const size_t start = tail & (N - 1u);
+    const size_t first = std::min(count, N - start);
+    std::move(buffer_ + start, buffer_ + start + first, values);
+    std::move(buffer_, buffer_ + (count - first), values + first);
+    tail_.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+ private:
+  // Positions count up forever (wrapping around harmlessly, since |N| is a
+  // power of two), so that a full ring can be told apart from an empty one.
+
+  // The position of the next value to be pushed, written by the producer.
+  std::atomic<size_t> head_;
+  // The last |tail_| seen by the producer.
+  size_t producer_cached_tail_ = 0u;
+  char padding1_[kCacheLineSize - sizeof(std::atomic<size_t>) -
+                  sizeof(size_t)];
+
+  // The position of the next value to be popped, written by the consumer.
+  std::atomic<size_t> tail_;
+  // The last |head_| seen by the consumer.
+  size_t consumer_cached_head_ = 0u;
+  char padding2_[kCacheLineSize - sizeof(std::atomic<size_t>) -
+                  sizeof(size_t)];
+
+  T buffer_[N];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SpscRing);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_SPSC_RING_H_
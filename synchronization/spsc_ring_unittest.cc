@@ -0,0 +1,131 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/spsc_ring.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/arraysize.h"
+
+namespace ftl {
+namespace {
+
+constexpr size_t kNumValues = 100000u;
+constexpr size_t kBatchSize = 7u;
+
+TEST(SpscRingTest, Basic) {
+  SpscRing<std::unique_ptr<int>, 2u> ring;
+  EXPECT_EQ(2u, ring.capacity());
+
+  std::unique_ptr<int> value;
+  EXPECT_FALSE(ring.TryPop(&value));
+
+  // Go around the ring a few times.
+  for (int lap = 0; lap < 3; lap++) {
+    value.reset(new int(1));
+    EXPECT_TRUE(ring.TryPush(&value));
+    EXPECT_FALSE(value);
+    value.reset(new int(2));
+    EXPECT_TRUE(ring.TryPush(&value));
+    value.reset(new int(3));
+    EXPECT_FALSE(ring.TryPush(&value));
+    ASSERT_TRUE(value);
+    EXPECT_EQ(3, *value);
+
+    ASSERT_TRUE(ring.TryPop(&value));
+    EXPECT_EQ(1, *value);
+    ASSERT_TRUE(ring.TryPop(&value));
+    EXPECT_EQ(2, *value);
+    EXPECT_FALSE(ring.TryPop(&value));
+  }
+}
+
+TEST(SpscRingTest, Batches) {
+  SpscRing<int, 8u> ring;
+  int values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+  // Only as many as fit are pushed.
+  EXPECT_EQ(5u, ring.PushBatch(values, 5u));
+  EXPECT_EQ(3u, ring.PushBatch(values + 5, 5u));
+  EXPECT_EQ(0u, ring.PushBatch(values + 8, 2u));
+
+  int popped[arraysize(values)] = {};
+  EXPECT_EQ(6u, ring.PopBatch(popped, 6u));
+  for (int i = 0; i < 6; i++)
+    EXPECT_EQ(i, popped[i]);
+
+  // Wrap around the end of the buffer.
+  EXPECT_EQ(2u, ring.PushBatch(values + 8, 2u));
+  EXPECT_EQ(4u, ring.PopBatch(popped, arraysize(popped)));
+  for (int i = 0; i < 4; i++)
+    EXPECT_EQ(i + 6, popped[i]);
+  EXPECT_EQ(0u, ring.PopBatch(popped, arraysize(popped)));
+}
+
+TEST(SpscRingTest, PushAll) {
+  SpscRing<int, 8u> ring;
+  int values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+  // All or nothing.
+  EXPECT_TRUE(ring.TryPushAll(values, 5u));
+  EXPECT_FALSE(ring.TryPushAll(values + 5, 5u));
+  EXPECT_TRUE(ring.TryPushAll(values + 5, 3u));
+  EXPECT_FALSE(ring.TryPushAll(values + 8, 1u));
+  EXPECT_TRUE(ring.TryPushAll(values + 8, 0u));
+
+  int popped[arraysize(values)] = {};
+  EXPECT_EQ(8u, ring.PopBatch(popped, arraysize(popped)));
+  for (int i = 0; i < 8; i++)
+    EXPECT_EQ(i, popped[i]);
+}
+
+TEST(SpscRingTest, HasRoomFor) {
+  SpscRing<int, 8u> ring;
+  int values[] = {0, 1, 2, 3, 4, 5};
+
+  EXPECT_TRUE(ring.HasRoomFor(8u));
+  EXPECT_FALSE(ring.HasRoomFor(9u));
+  EXPECT_EQ(6u, ring.PushBatch(values, 6u));
+  EXPECT_TRUE(ring.HasRoomFor(2u));
+  EXPECT_FALSE(ring.HasRoomFor(3u));
+
+  int popped[4] = {};
+  EXPECT_EQ(4u, ring.PopBatch(popped, 4u));
+  EXPECT_TRUE(ring.HasRoomFor(6u));
+  EXPECT_FALSE(ring.HasRoomFor(7u));
+}
+
+TEST(SpscRingTest, TwoThreads) {
+  std::unique_ptr<SpscRing<size_t, 64u>> ring(new SpscRing<size_t, 64u>());
+
+  std::thread producer([&ring]() {
+    size_t batch[kBatchSize];
+    for (size_t next = 0u; next < kNumValues;) {
+      size_t count = std::min(kBatchSize, kNumValues - next);
+      for (size_t i = 0u; i < count; i++)
+        batch[i] = next + i;
+      size_t pushed = ring->PushBatch(batch, count);
+      if (!pushed)
+        std::this_thread::yield();
+      next += pushed;
+    }
+  });
+
+  size_t batch[kBatchSize];
+  for (size_t next = 0u; next < kNumValues;) {
+    size_t count = ring->PopBatch(batch, kBatchSize);
+    if (!count)
+      std::this_thread::yield();
+    for (size_t i = 0u; i < count; i++)
+      ASSERT_EQ(next + i, batch[i]);
+    next += count;
+  }
+  producer.join();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,198 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/synchronization/wait_on_address.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "lib/ftl/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#elif defined(OS_WIN)
+#include <windows.h>
+#elif !defined(OS_MACOSX)
+#include <stddef.h>
+
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#endif
+
+namespace ftl {
+namespace internal {
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+namespace {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "std::atomic<uint32_t> can't be used as a futex");
+
+uint32_t* FutexAddress(const std::atomic<uint32_t>* address) {
+  return reinterpret_cast<uint32_t*>(
+      const_cast<std::atomic<uint32_t>*>(address));
+}
+
+void FutexWake(const std::atomic<uint32_t>* address, int count) {
+  syscall(SYS_futex, FutexAddress(address), FUTEX_WAKE_PRIVATE, count, nullptr,
+          nullptr, 0);
+}
+
+}  // namespace
+
+void WaitOnAddress(const std::atomic<uint32_t>* address,
+                   uint32_t expected,
+                   TimePoint deadline) {
+  if (deadline == TimePoint::Max()) {
+    syscall(SYS_futex, FutexAddress(address), FUTEX_WAIT_PRIVATE, expected,
+            nullptr, nullptr, 0);
+    return;
+  }
+  // |FUTEX_WAIT_BITSET| takes an absolute timeout on |CLOCK_MONOTONIC|, which
+  // is the clock |TimePoint::Now()| uses.
+  if (deadline <= TimePoint())
+    return;
+  struct timespec timespec_abs = (deadline - TimePoint()).ToTimespec();
+  syscall(SYS_futex, FutexAddress(address), FUTEX_WAIT_BITSET_PRIVATE, expected,
+          &timespec_abs, nullptr, FUTEX_BITSET_MATCH_ANY);
+}
+
+void WakeByAddressSingle(const std::atomic<uint32_t>* address) {
+  FutexWake(address, 1);
+}
+
+void WakeByAddressAll(const std::atomic<uint32_t>* address) {
+  FutexWake(address, std::numeric_limits<int>::max());
+}
+
+#elif defined(OS_WIN)
+
+void WaitOnAddress(const std::atomic<uint32_t>* address,
+                   uint32_t expected,
+                   TimePoint deadline) {
+  DWORD timeout_ms = INFINITE;
+  if (deadline != TimePoint::Max()) {
+    const TimeDelta remaining = deadline - TimePoint::Now();
+    if (remaining <= TimeDelta::Zero())
+      return;
+    // (Rounded up, and capped short of |INFINITE|; waking early is allowed.)
+    const int64_t ms = (remaining.ToNanoseconds() + 999999) / 1000000;
+    timeout_ms = static_cast<DWORD>(std::min<int64_t>(ms, INFINITE - 1));
+  }
+  ::WaitOnAddress(const_cast<std::atomic<uint32_t>*>(address), &expected,
+                  sizeof(expected), timeout_ms);
+}
+
+void WakeByAddressSingle(const std::atomic<uint32_t>* address) {
+  ::WakeByAddressSingle(const_cast<std::atomic<uint32_t>*>(address));
+}
+
+void WakeByAddressAll(const std::atomic<uint32_t>* address) {
+  ::WakeByAddressAll(const_cast<std::atomic<uint32_t>*>(address));
+}
+
+#elif defined(OS_MACOSX)
+
+// The kernel's (undocumented, but stable, and used by libc++) futex-like
+// interface, from xnu's bsd/sys/ulock.h.
+extern "C" {
+int __ulock_wait(uint32_t operation,
+                 void* address,
+                 uint64_t value,
+                 uint32_t timeout_us);
+int __ulock_wake(uint32_t operation, void* address, uint64_t wake_value);
+}
+
+namespace {
+
+constexpr uint32_t kUlCompareAndWait = 1u;
+constexpr uint32_t kUlfWakeAll = 0x100u;
+constexpr uint32_t kUlfNoErrno = 0x1000000u;
+
+void* UlockAddress(const std::atomic<uint32_t>* address) {
+  return const_cast<std::atomic<uint32_t>*>(address);
+}
+
+}  // namespace
+
+void WaitOnAddress(const std::atomic<uint32_t>* address,
+                   uint32_t expected,
+                   TimePoint deadline) {
+  // (A timeout of zero means forever.)
+  uint32_t timeout_us = 0u;
+  if (deadline != TimePoint::Max()) {
+    const TimeDelta remaining = deadline - TimePoint::Now();
+    if (remaining <= TimeDelta::Zero())
+      return;
+    // (Rounded up, and capped; waking early is allowed.)
+    const int64_t us = (remaining.ToNanoseconds() + 999) / 1000;
+    timeout_us = static_cast<uint32_t>(
+        std::min<int64_t>(us, std::numeric_limits<uint32_t>::max()));
+  }
+  __ulock_wait(kUlCompareAndWait | kUlfNoErrno, UlockAddress(address),
+               expected, timeout_us);
+}
+
+void WakeByAddressSingle(const std::atomic<uint32_t>* address) {
+  __ulock_wake(kUlCompareAndWait | kUlfNoErrno, UlockAddress(address), 0u);
+}
+
+void WakeByAddressAll(const std::atomic<uint32_t>* address) {
+  __ulock_wake(kUlCompareAndWait | kUlfWakeAll | kUlfNoErrno,
+               UlockAddress(address), 0u);
+}
+
+#else
+
+namespace {
+
+// The waiters on all addresses with the same hash share a bucket. Wakers take
+// the bucket's lock, which waiters hold while checking |*address|, so wakeups
+// can't be missed.
+struct WaitBucket {
+  Mutex mutex;
+  CondVar cv;
+};
+
+constexpr size_t kWaitBucketCount = 64u;
+
+WaitBucket* GetWaitBucket(const std::atomic<uint32_t>* address) {
+  // Leaked, so that it can be used during static destruction.
+  static WaitBucket* buckets = new WaitBucket[kWaitBucketCount];
+  uintptr_t value = reinterpret_cast<uintptr_t>(address);
+  return &buckets[value / sizeof(uint32_t) % kWaitBucketCount];
+}
+
+}  // namespace
+
+void WaitOnAddress(const std::atomic<uint32_t>* address,
+                   uint32_t expected,
+                   TimePoint deadline) {
+  WaitBucket* bucket = GetWaitBucket(address);
+  MutexLocker locker(&bucket->mutex);
+  if (address->load(std::memory_order_relaxed) != expected)
+    return;
+  bucket->cv.WaitUntil(&bucket->mutex, deadline);
+}
+
+void WakeByAddressSingle(const std::atomic<uint32_t>* address) {
+  // Other addresses' waiters may share the condition variable, so we can't
+  // just wake one.
+  WakeByAddressAll(address);
+}
+
+void WakeByAddressAll(const std::atomic<uint32_t>* address) {
+  WaitBucket* bucket = GetWaitBucket(address);
+  MutexLocker locker(&bucket->mutex);
+  bucket->cv.SignalAll();
+}
+
+#endif
+
+}  // namespace internal
+}  // namespace ftl
@@ -0,0 +1,44 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Blocking on (and waking) the value of a 32-bit atomic. This is what
+// |Semaphore|, |Latch|, |Barrier| and the waitable events are built on.
+
+#ifndef LIB_FTL_SYNCHRONIZATION_WAIT_ON_ADDRESS_H_
+#define LIB_FTL_SYNCHRONIZATION_WAIT_ON_ADDRESS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+namespace internal {
+
+// Blocks the calling thread until |WakeByAddressSingle()| or
+// |WakeByAddressAll()| is called on |address|, |deadline| passes
+// (|TimePoint::Max()| means never), or (spuriously) whenever, unless
+// |*address| isn't |expected|; that check is atomic with starting to wait, so
+// a wakeup that follows a change to |*address| can't be missed. Callers should
+// loop, checking their condition.
+//
+// On Linux, this is a futex wait; on Windows, |WaitOnAddress()|; and on macOS,
+// |__ulock_wait()|. Elsewhere, threads wait on one of a fixed set of condition
+// variables, picked by hashing |address|.
+FTL_EXPORT void WaitOnAddress(const std::atomic<uint32_t>* address,
+                              uint32_t expected,
+                              TimePoint deadline);
+
+// Wakes at least one (for |WakeByAddressSingle()|) or all of the threads
+// blocked in |WaitOnAddress()| on |address|, if there are any. This should be
+// called after changing |*address|.
+FTL_EXPORT void WakeByAddressSingle(const std::atomic<uint32_t>* address);
+FTL_EXPORT void WakeByAddressAll(const std::atomic<uint32_t>* address);
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_SYNCHRONIZATION_WAIT_ON_ADDRESS_H_
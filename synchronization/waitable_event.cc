@@ -4,7 +4,11 @@
 
 #include "lib/ftl/synchronization/waitable_event.h"
 
+#include <algorithm>
+
 #include "lib/ftl/logging.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/wait_on_address.h"
 #include "lib/ftl/time/time_delta.h"
 #include "lib/ftl/time/time_point.h"
 
@@ -13,152 +17,268 @@
 
 namespace ftl {
 
-// Waits with a timeout on |condition()|. Returns true on timeout, or false if
-// |condition()| ever returns true. |condition()| should have no side effects
-// (and will always be called with |*mutex| held).
-template <typename ConditionFn>
-bool WaitWithTimeoutImpl(Mutex* mutex,
-                         CondVar* cv,
-                         ConditionFn condition,
-                         TimeDelta timeout)
-    FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex) {
-  mutex->AssertHeld();
-
-  if (condition())
+namespace internal {
+
+// A thread blocked in |WaitMany()|, which the events it's waiting on notify
+// when they're signaled.
+class WaitManyWaiter {
+ public:
+  WaitManyWaiter() {}
+  ~WaitManyWaiter() {}
+
+  void Notify() {
+    MutexLocker locker(&mutex_);
+    notified_ = true;
+    cv_.Signal();
+  }
+
+  // Waits until |Notify()| is called or |deadline| passes (returning true in
+  // the latter case), and resets the notification.
+  bool WaitUntil(TimePoint deadline) {
+    MutexLocker locker(&mutex_);
+    while (!notified_) {
+      if (cv_.WaitUntil(&mutex_, deadline) && !notified_)
+        return true;
+    }
+    notified_ = false;
     return false;
+  }
 
-  // We may get spurious wakeups.
-  TimeDelta wait_remaining = timeout;
-  TimePoint start = TimePoint::Now();
-  while (true) {
-    if (cv->WaitWithTimeout(mutex, wait_remaining))
-      return true;  // Definitely timed out.
+ private:
+  CondVar cv_;
+  Mutex mutex_;
+  bool notified_ FTL_GUARDED_BY(mutex_) = false;
 
-    // We may have been awoken.
-    if (condition())
-      return false;
+  FTL_DISALLOW_COPY_AND_ASSIGN(WaitManyWaiter);
+};
 
-    // Or the wakeup may have been spurious.
-    TimePoint now = TimePoint::Now();
-    FTL_DCHECK(now >= start);
-    TimeDelta elapsed = now - start;
-    // It's possible that we may have timed out anyway.
-    if (elapsed >= timeout)
-      return true;
+}  // namespace internal
 
-    // Otherwise, recalculate the amount that we have left to wait.
-    wait_remaining = timeout - elapsed;
-  }
+namespace {
+
+// Returns the deadline for a wait with |timeout| starting now (saturating to
+// |TimePoint::Max()|, i.e., "forever").
+TimePoint DeadlineFromTimeout(TimeDelta timeout) {
+  TimePoint now = TimePoint::Now();
+  if (timeout >= TimePoint::Max() - now)
+    return TimePoint::Max();
+  return now + timeout;
+}
+
+void RemoveWaiterFrom(std::vector<internal::WaitManyWaiter*>* waiters,
+                      internal::WaitManyWaiter* waiter) {
+  auto it = std::find(waiters->begin(), waiters->end(), waiter);
+  FTL_DCHECK(it != waiters->end());
+  waiters->erase(it);
+}
+
+// The low bits of both events' states.
+constexpr uint32_t kSignaled = 1u;
+// Set while there are threads in |WaitMany()| on the event (so that |Signal()|
+// only has to take the lock when there are).
+constexpr uint32_t kHasWaitManyWaiters = 2u;
+
+bool DeadlinePassed(TimePoint deadline) {
+  return deadline != TimePoint::Max() && TimePoint::Now() >= deadline;
 }
 
+}  // namespace
+
 // AutoResetWaitableEvent ------------------------------------------------------
 
+constexpr uint32_t AutoResetWaitableEvent::kWaiterIncrement;
+
 void AutoResetWaitableEvent::Signal() {
-  MutexLocker locker(&mutex_);
-  signaled_ = true;
-  cv_.Signal();
+  const uint32_t state =
+      state_.fetch_or(kSignaled, std::memory_order_acq_rel);
+  if (state & kSignaled)
+    return;
+  // Whichever waiter gets to the signal first consumes it; the others go back
+  // to waiting.
+  if (state >= kWaiterIncrement)
+    internal::WakeByAddressSingle(&state_);
+  if (state & kHasWaitManyWaiters) {
+    MutexLocker locker(&mutex_);
+    for (auto* waiter : waiters_)
+      waiter->Notify();
+  }
 }
 
 void AutoResetWaitableEvent::Reset() {
-  MutexLocker locker(&mutex_);
-  signaled_ = false;
+  state_.fetch_and(~kSignaled, std::memory_order_relaxed);
 }
 
 void AutoResetWaitableEvent::Wait() {
-  MutexLocker locker(&mutex_);
-  while (!signaled_)
-    cv_.Wait(&mutex_);
-  signaled_ = false;
+  WaitUntil(TimePoint::Max());
 }
 
 bool AutoResetWaitableEvent::WaitWithTimeout(TimeDelta timeout) {
-  MutexLocker locker(&mutex_);
+  return WaitUntil(DeadlineFromTimeout(timeout));
+}
 
-  if (signaled_) {
-    signaled_ = false;
-    return false;
+bool AutoResetWaitableEvent::WaitUntil(TimePoint deadline) {
+  uint32_t state = state_.load(std::memory_order_relaxed);
+  for (;;) {
+    if (state & kSignaled) {
+      if (state_.compare_exchange_weak(state, state & ~kSignaled,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return false;
+      }
+      continue;
+    }
+    if (DeadlinePassed(deadline))
+      return true;
+    // Either |Signal()| sees us in the count (and wakes someone), or the wait
+    // sees its change to |state_| (and doesn't block).
+    const uint32_t waiting = state + kWaiterIncrement;
+    if (!state_.compare_exchange_weak(state, waiting,
+                                      std::memory_order_relaxed)) {
+      continue;
+    }
+    internal::WaitOnAddress(&state_, waiting, deadline);
+    state = state_.fetch_sub(kWaiterIncrement, std::memory_order_relaxed) -
+            kWaiterIncrement;
   }
+}
 
-  // We may get spurious wakeups.
-  TimeDelta wait_remaining = timeout;
-  TimePoint start = TimePoint::Now();
-  while (true) {
-    if (cv_.WaitWithTimeout(&mutex_, wait_remaining))
-      return true;  // Definitely timed out.
-
-    // We may have been awoken.
-    if (signaled_)
-      break;
-
-    // Or the wakeup may have been spurious.
-    TimePoint now = TimePoint::Now();
-    FTL_DCHECK(now >= start);
-    TimeDelta elapsed = now - start;
-    // It's possible that we may have timed out anyway.
-    if (elapsed >= timeout)
-      return true;
+bool AutoResetWaitableEvent::IsSignaledForTest() {
+  return state_.load(std::memory_order_relaxed) & kSignaled;
+}
 
-    // Otherwise, recalculate the amount that we have left to wait.
-    wait_remaining = timeout - elapsed;
+bool AutoResetWaitableEvent::ConsumeSignalOrAddWaiter(
+    internal::WaitManyWaiter* waiter) {
+  MutexLocker locker(&mutex_);
+  uint32_t state = state_.load(std::memory_order_relaxed);
+  for (;;) {
+    if (state & kSignaled) {
+      if (state_.compare_exchange_weak(state, state & ~kSignaled,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return true;
+      }
+    } else if (state_.compare_exchange_weak(state, state | kHasWaitManyWaiters,
+                                            std::memory_order_relaxed)) {
+      waiters_.push_back(waiter);
+      return false;
+    }
   }
-
-  signaled_ = false;
-  return false;
 }
 
-bool AutoResetWaitableEvent::IsSignaledForTest() {
+void AutoResetWaitableEvent::RemoveWaiter(internal::WaitManyWaiter* waiter) {
   MutexLocker locker(&mutex_);
-  return signaled_;
+  RemoveWaiterFrom(&waiters_, waiter);
+  if (waiters_.empty())
+    state_.fetch_and(~kHasWaitManyWaiters, std::memory_order_relaxed);
 }
 
 // ManualResetWaitableEvent ----------------------------------------------------
 
+constexpr uint32_t ManualResetWaitableEvent::kHasWaiters;
+constexpr uint32_t ManualResetWaitableEvent::kSignalIncrement;
+
 void ManualResetWaitableEvent::Signal() {
-  MutexLocker locker(&mutex_);
-  signaled_ = true;
-  signal_id_++;
-  cv_.SignalAll();
+  uint32_t state = state_.load(std::memory_order_relaxed);
+  do {
+    if (state & kSignaled)
+      return;
+  } while (!state_.compare_exchange_weak(
+      state, ((state + kSignalIncrement) | kSignaled) & ~kHasWaiters,
+      std::memory_order_release, std::memory_order_relaxed));
+  if (state & kHasWaiters)
+    internal::WakeByAddressAll(&state_);
+  if (state & kHasWaitManyWaiters) {
+    MutexLocker locker(&mutex_);
+    for (auto* waiter : waiters_)
+      waiter->Notify();
+  }
 }
 
 void ManualResetWaitableEvent::Reset() {
-  MutexLocker locker(&mutex_);
-  signaled_ = false;
+  state_.fetch_and(~kSignaled, std::memory_order_relaxed);
 }
 
 void ManualResetWaitableEvent::Wait() {
-  MutexLocker locker(&mutex_);
-
-  if (signaled_)
-    return;
-
-  auto last_signal_id = signal_id_;
-  do {
-    cv_.Wait(&mutex_);
-  } while (signal_id_ == last_signal_id);
+  WaitUntil(TimePoint::Max());
 }
 
 bool ManualResetWaitableEvent::WaitWithTimeout(TimeDelta timeout) {
-  MutexLocker locker(&mutex_);
+  return WaitUntil(DeadlineFromTimeout(timeout));
+}
 
-  auto last_signal_id = signal_id_;
-  // Disable thread-safety analysis for the lambda: We could annotate it with
-  // |FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_)|, but then the analyzer currently
-  // isn't able to figure out that |WaitWithTimeoutImpl()| calls it while
-  // holding |mutex_|.
-  bool rv = WaitWithTimeoutImpl(
-      &mutex_, &cv_,
-      [this, last_signal_id]() FTL_NO_THREAD_SAFETY_ANALYSIS {
-        // Also check |signaled_| in case we're already signaled.
-        return signaled_ || signal_id_ != last_signal_id;
-      },
-      timeout);
-  FTL_DCHECK(rv || signaled_ || signal_id_ != last_signal_id);
-  return rv;
+bool ManualResetWaitableEvent::WaitUntil(TimePoint deadline) {
+  uint32_t state = state_.load(std::memory_order_acquire);
+  // (The count of signals is above all the flags.)
+  const uint32_t signal_count = state / kSignalIncrement;
+  for (;;) {
+    if ((state & kSignaled) || state / kSignalIncrement != signal_count)
+      return false;
+    if (DeadlinePassed(deadline))
+      return true;
+    // Either |Signal()| sees |kHasWaiters| (and wakes us), or the wait sees its
+    // change to |state_| (and doesn't block).
+    if (!(state & kHasWaiters) &&
+        !state_.compare_exchange_weak(state, state | kHasWaiters,
+                                      std::memory_order_acquire)) {
+      continue;
+    }
+    internal::WaitOnAddress(&state_, state | kHasWaiters, deadline);
+    state = state_.load(std::memory_order_acquire);
+  }
 }
 
 bool ManualResetWaitableEvent::IsSignaledForTest() {
+  return state_.load(std::memory_order_relaxed) & kSignaled;
+}
+
+bool ManualResetWaitableEvent::ConsumeSignalOrAddWaiter(
+    internal::WaitManyWaiter* waiter) {
   MutexLocker locker(&mutex_);
-  return signaled_;
+  const uint32_t state =
+      state_.fetch_or(kHasWaitManyWaiters, std::memory_order_acquire);
+  if (state & kSignaled) {
+    if (waiters_.empty())
+      state_.fetch_and(~kHasWaitManyWaiters, std::memory_order_relaxed);
+    return true;
+  }
+  waiters_.push_back(waiter);
+  return false;
+}
+
+void ManualResetWaitableEvent::RemoveWaiter(internal::WaitManyWaiter* waiter) {
+  MutexLocker locker(&mutex_);
+  RemoveWaiterFrom(&waiters_, waiter);
+  if (waiters_.empty())
+    state_.fetch_and(~kHasWaitManyWaiters, std::memory_order_relaxed);
+}
+
+// WaitMany --------------------------------------------------------------------
+
+size_t WaitMany(const std::vector<internal::WaitManyEvent*>& events,
+                TimeDelta timeout) {
+  FTL_DCHECK(!events.empty());
+
+  TimePoint deadline = DeadlineFromTimeout(timeout);
+  internal::WaitManyWaiter waiter;
+  for (;;) {
+    // Find the first signaled event, or else get notified by all of them.
+    size_t registered = 0u;
+    for (; registered < events.size(); registered++) {
+      if (events[registered]->ConsumeSignalOrAddWaiter(&waiter))
+        break;
+    }
+    bool timed_out =
+        registered == events.size() ? waiter.WaitUntil(deadline) : false;
+    for (size_t i = 0u; i < registered; i++)
+      events[i]->RemoveWaiter(&waiter);
+
+    if (registered < events.size())
+      return registered;
+    if (timed_out)
+      return kWaitManyTimedOut;
+    // Some event was signaled, but it may have been reset (or, for an
+    // auto-reset event, consumed by another waiter) by now, so check again.
+  }
 }
 
 }  // namespace ftl
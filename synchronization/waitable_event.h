@@ -10,14 +10,42 @@
 #ifndef LIB_FTL_SYNCHRONIZATION_WAITABLE_EVENT_H_
 #define LIB_FTL_SYNCHRONIZATION_WAITABLE_EVENT_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/macros.h"
-#include "lib/ftl/synchronization/cond_var.h"
 #include "lib/ftl/synchronization/mutex.h"
 #include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 
+namespace internal {
+
+class WaitManyWaiter;
+
+// The interface through which |WaitMany()| waits on either kind of event.
+class FTL_EXPORT WaitManyEvent {
+ public:
+  // If the event is signaled, consumes the signal (for an auto-reset event) and
+  // returns true. Otherwise, arranges for |waiter| to be notified the next time
+  // the event is signaled, and returns false.
+  virtual bool ConsumeSignalOrAddWaiter(WaitManyWaiter* waiter) = 0;
+
+  // Undoes a |ConsumeSignalOrAddWaiter()| that returned false.
+  virtual void RemoveWaiter(WaitManyWaiter* waiter) = 0;
+
+ protected:
+  ~WaitManyEvent() {}
+};
+
+}  // namespace internal
+
 // AutoResetWaitableEvent ------------------------------------------------------
 
 // An event that can be signaled and waited on. This version automatically
@@ -25,9 +53,13 @@ namespace ftl {
 // to Windows's auto-reset Event, which is also imitated by Chromium's
 // auto-reset |base::WaitableEvent|. However, there are some limitations -- see
 // |Signal()|.) This class is thread-safe.
-class FTL_EXPORT AutoResetWaitableEvent final {
+//
+// An event is a single atomic word, which waiters block on (a futex on Linux):
+// signaling it when no thread is waiting is one atomic operation.
+class FTL_EXPORT AutoResetWaitableEvent final
+    : public internal::WaitManyEvent {
  public:
-  AutoResetWaitableEvent() {}
+  AutoResetWaitableEvent() : state_(0u) {}
   ~AutoResetWaitableEvent() {}
 
   // Put the event in the signaled state. Exactly one |Wait()| will be unblocked
@@ -38,7 +70,7 @@ class FTL_EXPORT AutoResetWaitableEvent final {
   //   call to |Signal()|.
   // * A |Signal()|, followed by a |Reset()|, may cause *no* waiting thread to
   //   be unblocked.
-  // * We rely on pthreads's queueing for picking which waiting thread to
+  // * We rely on the kernel's queueing for picking which waiting thread to
   //   unblock, rather than enforcing FIFO ordering.
   void Signal();
 
@@ -56,17 +88,32 @@ class FTL_EXPORT AutoResetWaitableEvent final {
   // false).
   bool WaitWithTimeout(TimeDelta timeout);
 
+  // Like |WaitWithTimeout()|, but with an absolute |deadline| (on the
+  // |TimePoint::Now()| clock) rather than a timeout. Returns true if |deadline|
+  // passes without the event being signaled.
+  bool WaitUntil(TimePoint deadline);
+
   // Returns whether this event is in a signaled state or not. For use in tests
   // only (in general, this is racy). Note: Unlike
   // |base::WaitableEvent::IsSignaled()|, this doesn't reset the signaled state.
   bool IsSignaledForTest();
 
+  // |internal::WaitManyEvent|:
+  bool ConsumeSignalOrAddWaiter(internal::WaitManyWaiter* waiter) override;
+  void RemoveWaiter(internal::WaitManyWaiter* waiter) override;
+
  private:
-  CondVar cv_;
-  Mutex mutex_;
+  // |state_| counts the threads (about to be) blocked on it from this bit up.
+  static constexpr uint32_t kWaiterIncrement = 4u;
+
+  // Whether the event is signaled, whether |waiters_| is nonempty, and the
+  // number of waiters (see above).
+  std::atomic<uint32_t> state_;
 
-  // True if this event is in the signaled state.
-  bool signaled_ FTL_GUARDED_BY(mutex_) = false;
+  // Only used by |WaitMany()| (and by |Signal()| when it's waiting).
+  Mutex mutex_;
+  // Threads in |WaitMany()| on this event, to be notified in |Signal()|.
+  std::vector<internal::WaitManyWaiter*> waiters_ FTL_GUARDED_BY(mutex_);
 
   FTL_DISALLOW_COPY_AND_ASSIGN(AutoResetWaitableEvent);
 };
@@ -76,10 +123,12 @@ class FTL_EXPORT AutoResetWaitableEvent final {
 // An event that can be signaled and waited on. This version remains signaled
 // until explicitly reset. (This is similar to Windows's manual-reset Event,
 // which is also imitated by Chromium's manual-reset |base::WaitableEvent|.)
-// This class is thread-safe.
-class FTL_EXPORT ManualResetWaitableEvent final {
+// This class is thread-safe. (As with |AutoResetWaitableEvent|, it's a single
+// atomic word.)
+class FTL_EXPORT ManualResetWaitableEvent final
+    : public internal::WaitManyEvent {
  public:
-  ManualResetWaitableEvent() {}
+  ManualResetWaitableEvent() : state_(0u) {}
   ~ManualResetWaitableEvent() {}
 
   // Put the event into the unsignaled state.
@@ -99,28 +148,56 @@ class FTL_EXPORT ManualResetWaitableEvent final {
   // false).
   bool WaitWithTimeout(TimeDelta timeout);
 
+  // Like |WaitWithTimeout()|, but with an absolute |deadline| (on the
+  // |TimePoint::Now()| clock) rather than a timeout. Returns true if |deadline|
+  // passes without the event being signaled.
+  bool WaitUntil(TimePoint deadline);
+
   // Returns whether this event is in a signaled state or not. For use in tests
   // only (in general, this is racy).
   bool IsSignaledForTest();
 
+  // |internal::WaitManyEvent|:
+  bool ConsumeSignalOrAddWaiter(internal::WaitManyWaiter* waiter) override;
+  void RemoveWaiter(internal::WaitManyWaiter* waiter) override;
+
  private:
-  CondVar cv_;
+  // Set (by waiters) when threads may be blocked on |state_|, and cleared when
+  // |Signal()| wakes them.
+  static constexpr uint32_t kHasWaiters = 4u;
+  // |state_| counts |Signal()|s from this bit up. Checking whether the event is
+  // signaled isn't enough for a waiter, since it may have been reset since the
+  // waiter was woken; it also returns if the count has changed since it started
+  // waiting.
+  static constexpr uint32_t kSignalIncrement = 8u;
+
+  // Whether the event is signaled, whether |waiters_| is nonempty, whether
+  // there are waiters, and the count of signals (see above).
+  std::atomic<uint32_t> state_;
+
+  // Only used by |WaitMany()| (and by |Signal()| when it's waiting).
   Mutex mutex_;
-
-  // True if this event is in the signaled state.
-  bool signaled_ FTL_GUARDED_BY(mutex_) = false;
-
-  // While |CondVar::SignalAll()| (|pthread_cond_broadcast()|) will wake all
-  // waiting threads, one has to deal with spurious wake-ups. Checking
-  // |signaled_| isn't sufficient, since another thread may have been awoken and
-  // (manually) reset |signaled_|. This is a counter that is incremented in
-  // |Signal()| before calling |CondVar::SignalAll()|. A waiting thread knows it
-  // was awoken if |signal_id_| is different from when it started waiting.
-  unsigned signal_id_ FTL_GUARDED_BY(mutex_) = 0u;
+  // Threads in |WaitMany()| on this event, to be notified in |Signal()|.
+  std::vector<internal::WaitManyWaiter*> waiters_ FTL_GUARDED_BY(mutex_);
 
   FTL_DISALLOW_COPY_AND_ASSIGN(ManualResetWaitableEvent);
 };
 
+// WaitMany --------------------------------------------------------------------
+
+// Returned by |WaitMany()| if it times out.
+constexpr size_t kWaitManyTimedOut = static_cast<size_t>(-1);
+
+// Blocks the calling thread until any of |events| (which must be nonempty) is
+// signaled, and returns its index (the lowest one, if several are signaled). As
+// with |Wait()|, the signal of an auto-reset event is consumed, so that each
+// |Signal()| unblocks exactly one waiter, whether in |Wait()| or |WaitMany()|.
+// Also unblocks if |timeout| elapses first (|TimeDelta::Max()| means never), in
+// which case it returns |kWaitManyTimedOut|. E.g.:
+//   size_t index = WaitMany({&data_ready, &shutdown}, TimeDelta::Max());
+FTL_EXPORT size_t WaitMany(const std::vector<internal::WaitManyEvent*>& events,
+                           TimeDelta timeout);
+
 }  // namespace ftl
 
 #endif  // LIB_FTL_SYNCHRONIZATION_WAITABLE_EVENT_H_
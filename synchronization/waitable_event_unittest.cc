@@ -18,6 +18,7 @@
 #include "lib/ftl/synchronization/sleep.h"
 #include "lib/ftl/test/timeout_tolerance.h"
 #include "lib/ftl/time/stopwatch.h"
+#include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 namespace {
@@ -141,8 +142,55 @@ TEST(AutoResetWaitableEventTest, Timeouts) {
   }
 }
 
+TEST(AutoResetWaitableEventTest, WaitUntil) {
+  AutoResetWaitableEvent ev;
+
+  EXPECT_TRUE(ev.WaitUntil(TimePoint()));
+  EXPECT_TRUE(ev.WaitUntil(TimePoint::Now()));
+
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  TimePoint start = TimePoint::Now();
+  EXPECT_TRUE(ev.WaitUntil(start + timeout));
+  TimeDelta elapsed = TimePoint::Now() - start;
+  EXPECT_GE(elapsed, timeout - kTimeoutTolerance);
+  EXPECT_LT(elapsed, timeout + kEpsilonTimeout);
+
+  ev.Signal();
+  EXPECT_FALSE(ev.WaitUntil(TimePoint()));
+  EXPECT_FALSE(ev.IsSignaledForTest());
+
+  std::thread thread([&ev]() {
+    EpsilonRandomSleep();
+    ev.Signal();
+  });
+  EXPECT_FALSE(ev.WaitUntil(TimePoint::Now() + kActionTimeout));
+  EXPECT_FALSE(ev.IsSignaledForTest());
+  thread.join();
+}
+
 // ManualResetWaitableEvent ----------------------------------------------------
 
+// Passing a turn back and forth many times can't lose a wakeup (which would
+// hang).
+TEST(AutoResetWaitableEventTest, PingPong) {
+  constexpr int kRoundTrips = 10000;
+  AutoResetWaitableEvent ping;
+  AutoResetWaitableEvent pong;
+  std::thread other([&ping, &pong] {
+    for (int i = 0; i < kRoundTrips; i++) {
+      ping.Wait();
+      pong.Signal();
+    }
+  });
+  for (int i = 0; i < kRoundTrips; i++) {
+    ping.Signal();
+    pong.Wait();
+  }
+  other.join();
+  EXPECT_FALSE(ping.IsSignaledForTest());
+  EXPECT_FALSE(pong.IsSignaledForTest());
+}
+
 TEST(ManualResetWaitableEventTest, Basic) {
   ManualResetWaitableEvent ev;
   EXPECT_FALSE(ev.IsSignaledForTest());
@@ -195,6 +243,29 @@ TEST(ManualResetWaitableEventTest, SignalMultiple) {
   }
 }
 
+TEST(ManualResetWaitableEventTest, WaitUntil) {
+  ManualResetWaitableEvent ev;
+
+  EXPECT_TRUE(ev.WaitUntil(TimePoint()));
+  EXPECT_TRUE(ev.WaitUntil(TimePoint::Now()));
+
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  TimePoint start = TimePoint::Now();
+  EXPECT_TRUE(ev.WaitUntil(start + timeout));
+  TimeDelta elapsed = TimePoint::Now() - start;
+  EXPECT_GE(elapsed, timeout - kTimeoutTolerance);
+  EXPECT_LT(elapsed, timeout + kEpsilonTimeout);
+
+  std::thread thread([&ev]() {
+    EpsilonRandomSleep();
+    ev.Signal();
+  });
+  EXPECT_FALSE(ev.WaitUntil(TimePoint::Max()));
+  EXPECT_TRUE(ev.IsSignaledForTest());
+  EXPECT_FALSE(ev.WaitUntil(TimePoint()));
+  thread.join();
+}
+
 // Tries to test that threads that are awoken may immediately call |Reset()|
 // without affecting other threads that are awoken.
 TEST(ManualResetWaitableEventTest, SignalMultipleWaitReset) {
@@ -252,5 +323,93 @@ TEST(ManualResetWaitableEventTest, Timeouts) {
   }
 }
 
+// WaitMany --------------------------------------------------------------------
+
+TEST(WaitManyTest, AlreadySignaled) {
+  AutoResetWaitableEvent auto_ev;
+  ManualResetWaitableEvent manual_ev;
+
+  manual_ev.Signal();
+  EXPECT_EQ(1u, WaitMany({&auto_ev, &manual_ev}, TimeDelta::Zero()));
+  EXPECT_TRUE(manual_ev.IsSignaledForTest());
+
+  // The lowest index wins, and auto-reset events are reset.
+  auto_ev.Signal();
+  EXPECT_EQ(0u, WaitMany({&auto_ev, &manual_ev}, TimeDelta::Zero()));
+  EXPECT_FALSE(auto_ev.IsSignaledForTest());
+  EXPECT_EQ(1u, WaitMany({&auto_ev, &manual_ev}, TimeDelta::Zero()));
+}
+
+TEST(WaitManyTest, Timeouts) {
+  AutoResetWaitableEvent ev1;
+  ManualResetWaitableEvent ev2;
+
+  EXPECT_EQ(kWaitManyTimedOut, WaitMany({&ev1, &ev2}, TimeDelta::Zero()));
+
+  TimeDelta timeout = TimeDelta::FromMilliseconds(40);
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  EXPECT_EQ(kWaitManyTimedOut, WaitMany({&ev1, &ev2}, timeout));
+  TimeDelta elapsed = stopwatch.Elapsed();
+  EXPECT_GE(elapsed, timeout - kTimeoutTolerance);
+  EXPECT_LT(elapsed, timeout + kEpsilonTimeout);
+}
+
+TEST(WaitManyTest, Signaled) {
+  for (size_t i = 0u; i < 3u; i++) {
+    AutoResetWaitableEvent ev0;
+    ManualResetWaitableEvent ev1;
+    AutoResetWaitableEvent ev2;
+
+    std::thread thread([i, &ev0, &ev1, &ev2]() {
+      EpsilonRandomSleep();
+      if (i == 0u)
+        ev0.Signal();
+      else if (i == 1u)
+        ev1.Signal();
+      else
+        ev2.Signal();
+    });
+    EXPECT_EQ(i, WaitMany({&ev0, &ev1, &ev2}, TimeDelta::Max()));
+    thread.join();
+
+    // Signals of auto-reset events are consumed.
+    EXPECT_EQ(i == 1u, ev1.IsSignaledForTest());
+    EXPECT_FALSE(ev0.IsSignaledForTest());
+    EXPECT_FALSE(ev2.IsSignaledForTest());
+  }
+}
+
+// Each signal of an auto-reset event should unblock exactly one waiter, whether
+// it's in |Wait()| or |WaitMany()|.
+TEST(WaitManyTest, AutoResetWakesOne) {
+  constexpr int kNumWaiters = 4;
+  AutoResetWaitableEvent ev;
+  ManualResetWaitableEvent never;
+  std::atomic<int> wakeups(0);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumWaiters; i++) {
+    threads.push_back(std::thread([&ev, &never, &wakeups, i]() {
+      if (i % 2 == 0)
+        ev.Wait();
+      else
+        EXPECT_EQ(1u, WaitMany({&never, &ev}, kActionTimeout));
+      wakeups.fetch_add(1);
+    }));
+  }
+
+  for (int i = 0; i < kNumWaiters; i++) {
+    EpsilonRandomSleep();
+    ev.Signal();
+    // Wait for this signal to be consumed before sending the next one.
+    while (ev.IsSignaledForTest())
+      SleepFor(TimeDelta::FromMilliseconds(1));
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(kNumWaiters, wakeups.load());
+}
+
 }  // namespace
 }  // namespace ftl
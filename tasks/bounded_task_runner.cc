@@ -0,0 +1,205 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/bounded_task_runner.h"
+
+#include <utility>
+
+#include "lib/ftl/debug/trace_event.h"
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+
+constexpr size_t BoundedTaskRunner::kPriorityCount;
+
+BoundedTaskRunner::BoundedTaskRunner(RefPtr<TaskRunner> task_runner,
+                                     const Options& options)
+    : task_runner_(std::move(task_runner)), options_(options) {
+  FTL_DCHECK(task_runner_);
+}
+
+BoundedTaskRunner::~BoundedTaskRunner() {}
+
+void BoundedTaskRunner::PostTask(UniqueClosure task) {
+  PostTaskWithPriority(std::move(task), TaskPriority::kNormal);
+}
+
+bool BoundedTaskRunner::TryPostTask(UniqueClosure task) {
+  return PostTaskWithSize(std::move(task), sizeof(UniqueClosure),
+                          TaskPriority::kNormal, true);
+}
+
+void BoundedTaskRunner::PostTaskForTime(UniqueClosure task,
+                                        TimePoint target_time) {
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task), target_time);
+
+  RefPtr<BoundedTaskRunner> self(this);
+  task_runner_->PostTaskForTime(
+      [ self, task = std::move(task) ]() mutable {
+        // Don't block (or drop the task); there's nobody to push back on.
+        self->Enqueue(std::move(task), sizeof(UniqueClosure),
+                      TaskPriority::kNormal, OverflowPolicy::kBlock, false);
+      },
+      target_time);
+}
+
+void BoundedTaskRunner::PostDelayedTask(UniqueClosure task, TimeDelta delay) {
+  PostTaskForTime(std::move(task), TimePoint::Now() + delay);
+}
+
+void BoundedTaskRunner::PostTaskWithPriority(UniqueClosure task,
+                                             TaskPriority priority) {
+  PostTaskWithSize(std::move(task), sizeof(UniqueClosure), priority);
+}
+
+bool BoundedTaskRunner::RunsTasksOnCurrentThread() {
+  return task_runner_->RunsTasksOnCurrentThread();
+}
+
+bool BoundedTaskRunner::PostTaskWithSize(UniqueClosure task,
+                                         size_t size,
+                                         TaskPriority priority,
+                                         bool try_only) {
+  FTL_DCHECK(task);
+  return Enqueue(TraceTask(std::move(task)), size, priority,
+                 try_only ? OverflowPolicy::kReject : options_.overflow_policy,
+                 true);
+}
+
+size_t BoundedTaskRunner::pending_task_count() const {
+  MutexLocker locker(&mutex_);
+  return pending_task_count_;
+}
+
+size_t BoundedTaskRunner::pending_bytes() const {
+  MutexLocker locker(&mutex_);
+  return pending_bytes_;
+}
+
+uint64_t BoundedTaskRunner::dropped_task_count() const {
+  MutexLocker locker(&mutex_);
+  return dropped_task_count_;
+}
+
+bool BoundedTaskRunner::Enqueue(UniqueClosure task,
+                                size_t size,
+                                TaskPriority priority,
+                                OverflowPolicy policy,
+                                bool may_block) {
+  // Dropped tasks are destroyed outside the lock (their destructors may post
+  // more tasks).
+  std::vector<UniqueClosure> dropped;
+  bool accepted = true;
+  bool post_run = false;
+  {
+    MutexLocker locker(&mutex_);
+    if (!Fits(pending_task_count_, pending_bytes_, size)) {
+      switch (policy) {
+        case OverflowPolicy::kBlock:
+          // Tasks posted from the underlying task runner's threads are
+          // accepted anyway, since waiting for it could deadlock.
+          if (may_block && !task_runner_->RunsTasksOnCurrentThread()) {
+            while (!Fits(pending_task_count_, pending_bytes_, size))
+              space_available_cv_.Wait(&mutex_);
+          }
+          break;
+        case OverflowPolicy::kReject:
+          accepted = false;
+          break;
+        case OverflowPolicy::kShedLowestPriority:
+          accepted = Shed(size, priority, &dropped);
+          break;
+      }
+      if (!accepted)
+        dropped.push_back(std::move(task));
+      dropped_task_count_ += dropped.size();
+    }
+    if (accepted) {
+      queues_[static_cast<size_t>(priority)].push_back(
+          PendingTask{std::move(task), size});
+      pending_task_count_++;
+      pending_bytes_ += size;
+      // After tasks are shed, there are already enough |RunOne()|s posted.
+      if (posted_run_count_ < pending_task_count_) {
+        posted_run_count_++;
+        post_run = true;
+      }
+    }
+  }
+
+  if (post_run) {
+    RefPtr<BoundedTaskRunner> self(this);
+    task_runner_->PostTaskWithPriority([self] { self->RunOne(); }, priority);
+  }
+  return accepted;
+}
+
+bool BoundedTaskRunner::Fits(size_t task_count,
+                             size_t bytes,
+                             size_t size) const {
+  if (!task_count)
+    return true;
+  if (options_.max_pending_tasks && task_count >= options_.max_pending_tasks)
+    return false;
+  if (options_.max_pending_bytes && bytes + size > options_.max_pending_bytes)
+    return false;
+  return true;
+}
+
+bool BoundedTaskRunner::Shed(size_t size,
+                             TaskPriority priority,
+                             std::vector<UniqueClosure>* shed) {
+  // First count how many tasks would have to be shed (oldest first, from the
+  // lowest-priority queue up to |priority|'s), without shedding any.
+  size_t task_count = pending_task_count_;
+  size_t bytes = pending_bytes_;
+  for (size_t p = kPriorityCount; p-- > static_cast<size_t>(priority);) {
+    for (const auto& pending : queues_[p]) {
+      if (Fits(task_count, bytes, size))
+        break;
+      task_count--;
+      bytes -= pending.size;
+    }
+  }
+  if (!Fits(task_count, bytes, size))
+    return false;
+
+  for (size_t p = kPriorityCount; pending_task_count_ > task_count;) {
+    auto& queue = queues_[--p];
+    while (pending_task_count_ > task_count && !queue.empty()) {
+      PendingTask& pending = queue.front();
+      shed->push_back(std::move(pending.task));
+      pending_task_count_--;
+      pending_bytes_ -= pending.size;
+      queue.pop_front();
+    }
+  }
+  return true;
+}
+
+void BoundedTaskRunner::RunOne() {
+  UniqueClosure task;
+  {
+    MutexLocker locker(&mutex_);
+    FTL_DCHECK(posted_run_count_ > 0u);
+    posted_run_count_--;
+    for (auto& queue : queues_) {
+      if (queue.empty())
+        continue;
+      task = std::move(queue.front().task);
+      pending_task_count_--;
+      pending_bytes_ -= queue.front().size;
+      queue.pop_front();
+      space_available_cv_.SignalAll();
+      break;
+    }
+  }
+  if (task) {
+    FTL_TRACE_EVENT("ftl", "BoundedTaskRunner::RunTask");
+    task();
+  }
+}
+
+}  // namespace ftl
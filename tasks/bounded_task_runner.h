@@ -0,0 +1,160 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_BOUNDED_TASK_RUNNER_H_
+#define LIB_FTL_TASKS_BOUNDED_TASK_RUNNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A |TaskRunner| which limits how much work may be queued on another one, so
+// that an overloaded consumer pushes back on its producers instead of its
+// queue growing without bound. Use like:
+//
+//   BoundedTaskRunner::Options options;
+//   options.max_pending_tasks = 1000u;
+//   options.overflow_policy = BoundedTaskRunner::OverflowPolicy::kReject;
+//   auto bounded = MakeRefCounted<BoundedTaskRunner>(loop, options);
+//   if (!bounded->TryPostTask([] { ... }))
+//     ...  // Overloaded: fail the request.
+//
+// Tasks are held here until the underlying task runner is ready to run them
+// (it's posted one small task per pending task, which runs the most urgent
+// one), so they count as pending until they start running. What happens to a
+// |PostTask()| when the limits would be exceeded depends on the
+// |OverflowPolicy|; |TryPostTask()| always fails instead.
+//
+// A task's size (for |Options::max_pending_bytes|) is |sizeof(UniqueClosure)|
+// unless it's posted with |PostTaskWithSize()|, e.g., with the size of the
+// buffer it captures. Delayed tasks only count once they're due, and are then
+// accepted regardless of the limits (since there's nobody to push back on).
+class FTL_EXPORT BoundedTaskRunner : public TaskRunner {
+ public:
+  // What |PostTask()| (and friends) do when the limits would be exceeded.
+  enum class OverflowPolicy {
+    // Wait until enough pending tasks have run. (Except on threads where the
+    // underlying task runner runs tasks, where waiting could deadlock: there,
+    // the task is accepted anyway.)
+    kBlock,
+    // Drop (destroy without running) the new task.
+    kReject,
+    // Drop the oldest pending tasks of the lowest priority, as long as it's
+    // no higher than the new task's, to make room; if there aren't enough of
+    // those, drop the new task.
+    kShedLowestPriority,
+  };
+
+  struct Options {
+    // The most tasks that may be pending, or 0 for no limit.
+    size_t max_pending_tasks = 0u;
+    // The most bytes of tasks that may be pending, or 0 for no limit. A single
+    // task larger than this is still accepted when nothing else is pending.
+    size_t max_pending_bytes = 0u;
+    OverflowPolicy overflow_policy = OverflowPolicy::kBlock;
+  };
+
+  // |TaskRunner|:
+  using TaskRunner::PostDelayedTask;
+  using TaskRunner::PostTask;
+  void PostTask(UniqueClosure task) override;
+  bool TryPostTask(UniqueClosure task) override;
+  void PostTaskForTime(UniqueClosure task, TimePoint target_time) override;
+  void PostDelayedTask(UniqueClosure task, TimeDelta delay) override;
+  void PostTaskWithPriority(UniqueClosure task, TaskPriority priority) override;
+  bool RunsTasksOnCurrentThread() override;
+
+  // Like |PostTaskWithPriority()| (or, if |try_only| is true, |TryPostTask()|
+  // with a priority), but counting the task as |size| bytes. Returns false if
+  // the task was dropped.
+  bool PostTaskWithSize(UniqueClosure task,
+                        size_t size,
+                        TaskPriority priority = TaskPriority::kNormal,
+                        bool try_only = false);
+
+  // The number of tasks (and bytes of them) which have been posted but haven't
+  // started running.
+  size_t pending_task_count() const;
+  size_t pending_bytes() const;
+
+  // The number of tasks which have been dropped (including by |TryPostTask()|)
+  // because of the limits.
+  uint64_t dropped_task_count() const;
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(BoundedTaskRunner);
+  FRIEND_REF_COUNTED_THREAD_SAFE(BoundedTaskRunner);
+
+  struct PendingTask {
+    UniqueClosure task;
+    size_t size;
+  };
+
+  static constexpr size_t kPriorityCount =
+      static_cast<size_t>(TaskPriority::kBestEffort) + 1u;
+
+  BoundedTaskRunner(RefPtr<TaskRunner> task_runner, const Options& options);
+  ~BoundedTaskRunner() override;
+
+  // Adds |task| to the queue (with |policy| applied if it doesn't fit, except
+  // that |kBlock| only blocks if |may_block| is true), and returns true, or
+  // returns false if it was dropped.
+  bool Enqueue(UniqueClosure task,
+               size_t size,
+               TaskPriority priority,
+               OverflowPolicy policy,
+               bool may_block);
+
+  // Returns true if a task of |size| bytes fits within the limits with
+  // |task_count| tasks of |bytes| bytes already pending.
+  bool Fits(size_t task_count, size_t bytes, size_t size) const;
+
+  // Moves the oldest pending tasks of the lowest priority (no higher than
+  // |priority|) to |*shed| until a task of |size| bytes fits, and returns true,
+  // or returns false (leaving the queue alone) if it still wouldn't fit.
+  bool Shed(size_t size,
+            TaskPriority priority,
+            std::vector<UniqueClosure>* shed)
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Runs the most urgent pending task (if any).
+  void RunOne();
+
+  const RefPtr<TaskRunner> task_runner_;
+  const Options options_;
+
+  mutable Mutex mutex_;
+  // Signaled when pending tasks are taken to run (for |kBlock|).
+  CondVar space_available_cv_;
+  // Pending tasks, by priority.
+  std::deque<PendingTask> queues_[kPriorityCount] FTL_GUARDED_BY(mutex_);
+  size_t pending_task_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  size_t pending_bytes_ FTL_GUARDED_BY(mutex_) = 0u;
+  // The number of |RunOne()| tasks posted to |task_runner_| which haven't run.
+  // This exceeds |pending_task_count_| after tasks have been shed.
+  size_t posted_run_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  uint64_t dropped_task_count_ FTL_GUARDED_BY(mutex_) = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(BoundedTaskRunner);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_BOUNDED_TASK_RUNNER_H_
@@ -0,0 +1,148 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/bounded_task_runner.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace ftl {
+namespace {
+
+BoundedTaskRunner::Options MakeOptions(
+    size_t max_pending_tasks,
+    size_t max_pending_bytes,
+    BoundedTaskRunner::OverflowPolicy overflow_policy) {
+  BoundedTaskRunner::Options options;
+  options.max_pending_tasks = max_pending_tasks;
+  options.max_pending_bytes = max_pending_bytes;
+  options.overflow_policy = overflow_policy;
+  return options;
+}
+
+TEST(BoundedTaskRunnerTest, Reject) {
+  // Tasks stay pending until the pool is started.
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  auto bounded = MakeRefCounted<BoundedTaskRunner>(
+      pool, MakeOptions(2u, 0u, BoundedTaskRunner::OverflowPolicy::kReject));
+
+  std::vector<int> order;
+  EXPECT_TRUE(bounded->TryPostTask([&order] { order.push_back(0); }));
+  bounded->PostTask([&order] { order.push_back(1); });
+  EXPECT_EQ(2u, bounded->pending_task_count());
+  EXPECT_FALSE(bounded->TryPostTask([&order] { order.push_back(2); }));
+  bounded->PostTask([&order] { order.push_back(3); });
+  EXPECT_EQ(2u, bounded->pending_task_count());
+  EXPECT_EQ(2u, bounded->dropped_task_count());
+
+  EXPECT_TRUE(pool->Start());
+  pool->Shutdown();
+  EXPECT_EQ((std::vector<int>{0, 1}), order);
+  EXPECT_EQ(0u, bounded->pending_task_count());
+  EXPECT_EQ(0u, bounded->pending_bytes());
+}
+
+TEST(BoundedTaskRunnerTest, ByteBudget) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  auto bounded = MakeRefCounted<BoundedTaskRunner>(
+      pool, MakeOptions(0u, 100u, BoundedTaskRunner::OverflowPolicy::kReject));
+
+  int run_count = 0;
+  EXPECT_TRUE(bounded->PostTaskWithSize([&run_count] { run_count++; }, 60u));
+  EXPECT_FALSE(bounded->PostTaskWithSize([&run_count] { run_count++; }, 60u));
+  EXPECT_TRUE(bounded->PostTaskWithSize([&run_count] { run_count++; }, 40u));
+  EXPECT_EQ(100u, bounded->pending_bytes());
+
+  EXPECT_TRUE(pool->Start());
+  pool->Shutdown();
+  EXPECT_EQ(2, run_count);
+}
+
+TEST(BoundedTaskRunnerTest, ShedLowestPriority) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  auto bounded = MakeRefCounted<BoundedTaskRunner>(
+      pool,
+      MakeOptions(2u, 0u,
+                  BoundedTaskRunner::OverflowPolicy::kShedLowestPriority));
+
+  std::vector<char> order;
+  bounded->PostTaskWithPriority([&order] { order.push_back('a'); },
+                                TaskPriority::kBestEffort);
+  bounded->PostTask([&order] { order.push_back('b'); });
+  // Sheds 'a'.
+  bounded->PostTask([&order] { order.push_back('c'); });
+  // Sheds 'b' (the oldest of the lowest priority).
+  bounded->PostTaskWithPriority([&order] { order.push_back('d'); },
+                                TaskPriority::kUserBlocking);
+  // Nothing of lower (or the same) priority is left to shed, so this is
+  // dropped.
+  bounded->PostTaskWithPriority([&order] { order.push_back('e'); },
+                                TaskPriority::kBestEffort);
+  EXPECT_EQ(2u, bounded->pending_task_count());
+  EXPECT_EQ(3u, bounded->dropped_task_count());
+
+  EXPECT_TRUE(pool->Start());
+  pool->Shutdown();
+  EXPECT_EQ((std::vector<char>{'d', 'c'}), order);
+}
+
+TEST(BoundedTaskRunnerTest, Block) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  EXPECT_TRUE(pool->Start());
+  auto bounded = MakeRefCounted<BoundedTaskRunner>(
+      pool, MakeOptions(1u, 0u, BoundedTaskRunner::OverflowPolicy::kBlock));
+
+  ManualResetWaitableEvent started;
+  ManualResetWaitableEvent proceed;
+  std::atomic<int> run_count(0);
+  bounded->PostTask([&started, &proceed, &run_count] {
+    started.Signal();
+    proceed.Wait();
+    run_count++;
+  });
+  started.Wait();
+  bounded->PostTask([&run_count] { run_count++; });
+  EXPECT_EQ(1u, bounded->pending_task_count());
+
+  std::atomic<bool> posted(false);
+  std::thread thread([&bounded, &posted, &run_count] {
+    bounded->PostTask([&run_count] { run_count++; });
+    posted.store(true);
+  });
+  SleepFor(TimeDelta::FromMilliseconds(20));
+  EXPECT_FALSE(posted.load());
+  // But |TryPostTask()| doesn't wait.
+  EXPECT_FALSE(bounded->TryPostTask([&run_count] { run_count++; }));
+
+  proceed.Signal();
+  thread.join();
+  EXPECT_TRUE(posted.load());
+  pool->Shutdown();
+  EXPECT_EQ(3, run_count.load());
+  EXPECT_EQ(1u, bounded->dropped_task_count());
+}
+
+TEST(BoundedTaskRunnerTest, DelayedTasksAreAlwaysAccepted) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  auto bounded = MakeRefCounted<BoundedTaskRunner>(
+      pool, MakeOptions(1u, 0u, BoundedTaskRunner::OverflowPolicy::kReject));
+
+  std::atomic<int> run_count(0);
+  bounded->PostTask([&run_count] { run_count++; });
+  bounded->PostDelayedTask([&run_count] { run_count++; }, TimeDelta::Zero());
+  EXPECT_TRUE(pool->Start());
+  SleepFor(TimeDelta::FromMilliseconds(20));
+  pool->Shutdown();
+  EXPECT_EQ(2, run_count.load());
+  EXPECT_EQ(0u, bounded->dropped_task_count());
+}
+
+}  // namespace
+}  // namespace ftl
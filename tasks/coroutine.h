@@ -0,0 +1,269 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// C++20 coroutine support for |TaskRunner|s. This is only available (and
+// |FTL_HAS_COROUTINES| is only defined) when compiling with coroutine support;
+// otherwise this header is empty.
+
+#ifndef LIB_FTL_TASKS_COROUTINE_H_
+#define LIB_FTL_TASKS_COROUTINE_H_
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#define FTL_HAS_COROUTINES 1
+
+#include <coroutine>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/future.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Suspends the awaiting coroutine and resumes it from a task posted to a
+// |TaskRunner|, optionally at some target time. See |Schedule()|, |SleepFor()|
+// and |SleepUntil()|.
+class FTL_EXPORT ScheduleAwaiter final {
+ public:
+  ScheduleAwaiter(RefPtr<TaskRunner> task_runner, TimePoint target_time)
+      : task_runner_(std::move(task_runner)), target_time_(target_time) {
+    FTL_DCHECK(task_runner_);
+  }
+
+  bool await_ready() const { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    if (target_time_ == TimePoint::Min())
+      task_runner_->PostTask([handle] { handle.resume(); });
+    else
+      task_runner_->PostTaskForTime([handle] { handle.resume(); },
+                                    target_time_);
+  }
+
+  void await_resume() {}
+
+ private:
+  RefPtr<TaskRunner> task_runner_;
+  // |TimePoint::Min()| for "as soon as possible".
+  TimePoint target_time_;
+};
+
+// Continues the awaiting coroutine on |task_runner|:
+//
+//   co_await Schedule(io_runner);
+//   // Now running on |io_runner|.
+//
+// Note: If |task_runner| drops the task (e.g., a |MessageLoop| which is quit),
+// the coroutine is never resumed, and its frame is leaked.
+inline ScheduleAwaiter Schedule(RefPtr<TaskRunner> task_runner) {
+  return ScheduleAwaiter(std::move(task_runner), TimePoint::Min());
+}
+
+// Continues the awaiting coroutine on |task_runner| once |target_time| has been
+// reached.
+inline ScheduleAwaiter SleepUntil(RefPtr<TaskRunner> task_runner,
+                                  TimePoint target_time) {
+  return ScheduleAwaiter(std::move(task_runner), target_time);
+}
+
+// Continues the awaiting coroutine on |task_runner| after |delay|.
+inline ScheduleAwaiter SleepFor(RefPtr<TaskRunner> task_runner,
+                                TimeDelta delay) {
+  return SleepUntil(std::move(task_runner), TimePoint::Now() + delay);
+}
+
+template <typename T = void>
+class Task;
+
+namespace internal {
+
+template <typename T>
+class TaskPromiseBase {
+ public:
+  class FinalAwaiter {
+   public:
+    bool await_ready() noexcept { return false; }
+
+    // Transfers control to whatever is awaiting the task, if anything
+    // (otherwise, the coroutine just stays suspended until it's destroyed).
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<typename Task<T>::promise_type> handle) noexcept {
+      std::coroutine_handle<> continuation = handle.promise().continuation_;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() noexcept {}
+  };
+
+  // Tasks are lazy: they start when awaited (or started).
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+
+  void unhandled_exception() {
+    FTL_CHECK(false) << "Unhandled exception in coroutine";
+  }
+
+  void set_continuation(std::coroutine_handle<> continuation) {
+    continuation_ = continuation;
+  }
+
+ private:
+  std::coroutine_handle<> continuation_;
+};
+
+template <typename T>
+class TaskPromise : public TaskPromiseBase<T> {
+ public:
+  Task<T> get_return_object();
+
+  template <typename U>
+  void return_value(U&& value) {
+    result_.emplace(std::forward<U>(value));
+  }
+
+  T TakeResult() {
+    FTL_DCHECK(result_);
+    return std::move(*result_);
+  }
+
+ private:
+  std::optional<T> result_;
+};
+
+template <>
+class TaskPromise<void> : public TaskPromiseBase<void> {
+ public:
+  Task<void> get_return_object();
+
+  void return_void() {}
+
+  void TakeResult() {}
+};
+
+// A coroutine which starts immediately and destroys itself when done, used to
+// run a |Task| from non-coroutine code.
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {
+      FTL_CHECK(false) << "Unhandled exception in coroutine";
+    }
+  };
+};
+
+template <typename T>
+DetachedTask RunTask(Task<T> task,
+                     Promise<T> promise,
+                     RefPtr<TaskRunner> task_runner) {
+  co_await Schedule(std::move(task_runner));
+  if (promise.IsCanceled())
+    co_return;
+  if constexpr (std::is_void<T>::value) {
+    co_await task;
+    promise.SetValue();
+  } else {
+    promise.SetValue(co_await task);
+  }
+}
+
+}  // namespace internal
+
+// A coroutine returning a |T|. Coroutines which |co_await| |Schedule()| (or
+// |SleepFor()|, etc.) hop between task runners, so they can be written
+// linearly instead of as chains of callbacks, with one allocation (for the
+// coroutine frame) instead of one per callback:
+//
+//   Task<std::string> Fetch(RefPtr<TaskRunner> io_runner) {
+//     co_await Schedule(io_runner);
+//     std::string data = ReadData();
+//     co_await SleepFor(io_runner, TimeDelta::FromMilliseconds(10));
+//     co_return data + ReadData();
+//   }
+//
+// A task doesn't run until it is either awaited by another coroutine (in which
+// case it starts on the awaiting thread, and the awaiting coroutine resumes on
+// whichever thread the task finishes), or started with |Start()|.
+template <typename T>
+class Task final {
+ public:
+  using promise_type = internal::TaskPromise<T>;
+
+  Task(Task&& other) : handle_(other.handle_) { other.handle_ = nullptr; }
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  Task& operator=(Task&& other) {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = other.handle_;
+      other.handle_ = nullptr;
+    }
+    return *this;
+  }
+
+  // Starts the task from a task posted to |task_runner|, returning a future
+  // for its result. (If the future is canceled before the task starts, it
+  // doesn't.)
+  Future<T> Start(RefPtr<TaskRunner> task_runner) {
+    FTL_DCHECK(handle_);
+    Promise<T> promise;
+    Future<T> future = promise.GetFuture();
+    internal::RunTask(std::move(*this), std::move(promise),
+                      std::move(task_runner));
+    return future;
+  }
+
+  // For |co_await|:
+  bool await_ready() const { return false; }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+    FTL_DCHECK(handle_);
+    handle_.promise().set_continuation(awaiter);
+    return handle_;
+  }
+
+  T await_resume() { return handle_.promise().TakeResult(); }
+
+ private:
+  friend class internal::TaskPromise<T>;
+
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Task);
+};
+
+namespace internal {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+  return Task<void>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+}
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#endif  // LIB_FTL_TASKS_COROUTINE_H_
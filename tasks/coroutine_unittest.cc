@@ -0,0 +1,127 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/coroutine.h"
+
+#if defined(FTL_HAS_COROUTINES)
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/message_loop.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+#include "lib/ftl/time/stopwatch.h"
+
+namespace ftl {
+namespace {
+
+class CoroutineTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loop_ = MakeRefCounted<MessageLoop>();
+    ASSERT_TRUE(loop_->Start());
+    other_loop_ = MakeRefCounted<MessageLoop>();
+    ASSERT_TRUE(other_loop_->Start());
+  }
+
+  void TearDown() override {
+    other_loop_->QuitAndJoin();
+    loop_->QuitAndJoin();
+  }
+
+  RefPtr<MessageLoop> loop_;
+  RefPtr<MessageLoop> other_loop_;
+};
+
+Task<int> HopBetweenLoops(RefPtr<MessageLoop> loop,
+                          RefPtr<MessageLoop> other_loop) {
+  int hops = 0;
+  EXPECT_TRUE(loop->RunsTasksOnCurrentThread());
+  co_await Schedule(other_loop);
+  if (other_loop->RunsTasksOnCurrentThread())
+    hops++;
+  co_await Schedule(loop);
+  if (loop->RunsTasksOnCurrentThread())
+    hops++;
+  co_return hops;
+}
+
+TEST_F(CoroutineTest, Schedule) {
+  AutoResetWaitableEvent done;
+  int result = 0;
+  HopBetweenLoops(loop_, other_loop_)
+      .Start(loop_)
+      .Then(loop_, [&result, &done](int hops) {
+        result = hops;
+        done.Signal();
+      });
+  done.Wait();
+  EXPECT_EQ(2, result);
+}
+
+Task<> Sleep(RefPtr<MessageLoop> loop, TimeDelta delay) {
+  co_await SleepFor(loop, delay);
+  EXPECT_TRUE(loop->RunsTasksOnCurrentThread());
+}
+
+TEST_F(CoroutineTest, SleepFor) {
+  const TimeDelta kDelay = TimeDelta::FromMilliseconds(20);
+  AutoResetWaitableEvent done;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  Sleep(loop_, kDelay).Start(loop_).Then(loop_, [&done] { done.Signal(); });
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(), kDelay - kTimeoutTolerance);
+}
+
+Task<std::unique_ptr<std::string>> Inner(RefPtr<MessageLoop> loop,
+                                         std::string value) {
+  co_await Schedule(loop);
+  co_return std::make_unique<std::string>(value + "!");
+}
+
+Task<std::string> Outer(RefPtr<MessageLoop> loop,
+                        RefPtr<MessageLoop> other_loop) {
+  std::string result;
+  for (int i = 0; i < 3; i++) {
+    std::unique_ptr<std::string> value = co_await Inner(other_loop, result);
+    result = *value;
+  }
+  // Awaiting a task resumes on the thread it finishes on.
+  EXPECT_TRUE(other_loop->RunsTasksOnCurrentThread());
+  co_return result;
+}
+
+TEST_F(CoroutineTest, AwaitTask) {
+  AutoResetWaitableEvent done;
+  std::string result;
+  Outer(loop_, other_loop_)
+      .Start(loop_)
+      .Then(loop_, [&result, &done](std::string value) {
+        result = std::move(value);
+        done.Signal();
+      });
+  done.Wait();
+  EXPECT_EQ("!!!", result);
+}
+
+Task<> SetFlag(bool* flag) {
+  *flag = true;
+  co_return;
+}
+
+TEST_F(CoroutineTest, NotStarted) {
+  bool ran = false;
+  { Task<> task = SetFlag(&ran); }
+  // Tasks are lazy, so destroying one that was never started never runs it.
+  EXPECT_FALSE(ran);
+}
+
+}  // namespace
+}  // namespace ftl
+
+#endif  // defined(FTL_HAS_COROUTINES)
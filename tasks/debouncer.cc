@@ -0,0 +1,73 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/debouncer.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+
+Debouncer::Debouncer(RefPtr<TaskRunner> task_runner,
+                     UniqueClosure task,
+                     TimeDelta delay)
+    : task_runner_(std::move(task_runner)),
+      task_(std::move(task)),
+      delay_(delay) {
+  FTL_DCHECK(task_runner_);
+  FTL_DCHECK(task_);
+  FTL_DCHECK(delay_ >= TimeDelta::Zero());
+}
+
+Debouncer::~Debouncer() {
+  if (destroyed_flag_)
+    *destroyed_flag_ = true;
+}
+
+void Debouncer::Call() {
+  pending_ = true;
+  deadline_ = task_runner_->Now() + delay_;
+  if (!timer_.is_started())
+    timer_.Start(task_runner_.get(), [this] { OnTimer(); }, delay_);
+}
+
+void Debouncer::Flush() {
+  FTL_DCHECK(task_);
+  if (pending_)
+    RunTask();
+}
+
+void Debouncer::Cancel() {
+  pending_ = false;
+  timer_.Stop();
+}
+
+void Debouncer::OnTimer() {
+  if (!pending_)
+    return;
+  TimePoint now = task_runner_->Now();
+  if (now < deadline_) {
+    timer_.Start(task_runner_.get(), [this] { OnTimer(); }, deadline_ - now);
+    return;
+  }
+  RunTask();
+}
+
+void Debouncer::RunTask() {
+  pending_ = false;
+  timer_.Stop();
+
+  // Run the task from a local, since it may call or destroy this.
+  UniqueClosure task = std::move(task_);
+  bool destroyed = false;
+  destroyed_flag_ = &destroyed;
+  task();
+  if (destroyed)
+    return;
+  destroyed_flag_ = nullptr;
+  task_ = std::move(task);
+}
+
+}  // namespace ftl
@@ -0,0 +1,67 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_DEBOUNCER_H_
+#define LIB_FTL_TASKS_DEBOUNCER_H_
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/one_shot_timer.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Runs a task once activity stops: |task| runs (on |task_runner|) |delay| after
+// the last of a burst of |Call()|s, e.g., to write a config file once it stops
+// changing.
+//
+// |Call()| only moves a deadline, so it's cheap enough to call on every event:
+// the underlying timer is started at most once per |delay| (when it fires
+// before the deadline, it's restarted for the remainder).
+//
+// It may only be used on the same thread as the task runner.
+class FTL_EXPORT Debouncer {
+ public:
+  Debouncer(RefPtr<TaskRunner> task_runner,
+            UniqueClosure task,
+            TimeDelta delay);
+  ~Debouncer();
+
+  // Returns true if the task is due to run.
+  bool is_pending() const { return pending_; }
+
+  // (Re)sets the task to run |delay| from now.
+  void Call();
+
+  // Runs the task now if it's pending (e.g., before shutting down). This may
+  // not be called by the task.
+  void Flush();
+
+  // Stops the task from running (until the next |Call()|).
+  void Cancel();
+
+ private:
+  void OnTimer();
+  void RunTask();
+
+  const RefPtr<TaskRunner> task_runner_;
+  UniqueClosure task_;
+  const TimeDelta delay_;
+
+  bool pending_ = false;
+  TimePoint deadline_;
+  // While the task is running, points to a flag set by the destructor.
+  bool* destroyed_flag_ = nullptr;
+  OneShotTimer timer_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Debouncer);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_DEBOUNCER_H_
@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/debouncer.h"
+
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/test/test_task_runner.h"
+
+namespace ftl {
+namespace {
+
+constexpr TimeDelta kDelay = TimeDelta::FromMilliseconds(100);
+constexpr TimeDelta kTick = TimeDelta::FromMilliseconds(1);
+
+TEST(DebouncerTest, RunsAfterActivityStops) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  int run_count = 0;
+  Debouncer debouncer(task_runner, [&run_count] { run_count++; }, kDelay);
+  EXPECT_FALSE(debouncer.is_pending());
+
+  // A thousand calls, a millisecond apart, only post the timer's task once
+  // per delay.
+  size_t task_count = 0u;
+  for (int i = 0; i < 1000; i++) {
+    debouncer.Call();
+    task_count += task_runner->AdvanceTimeBy(kTick);
+  }
+  EXPECT_EQ(0, run_count);
+  EXPECT_TRUE(debouncer.is_pending());
+  EXPECT_LE(task_count, 10u);
+
+  task_runner->AdvanceTimeBy(kDelay - kTick * 2);
+  EXPECT_EQ(0, run_count);
+  task_runner->AdvanceTimeBy(kTick);
+  EXPECT_EQ(1, run_count);
+  EXPECT_FALSE(debouncer.is_pending());
+  EXPECT_EQ(0u, task_runner->pending_task_count());
+
+  debouncer.Call();
+  task_runner->AdvanceTimeBy(kDelay);
+  EXPECT_EQ(2, run_count);
+}
+
+TEST(DebouncerTest, FlushAndCancel) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  int run_count = 0;
+  Debouncer debouncer(task_runner, [&run_count] { run_count++; }, kDelay);
+
+  debouncer.Flush();
+  EXPECT_EQ(0, run_count);
+  debouncer.Call();
+  debouncer.Flush();
+  EXPECT_EQ(1, run_count);
+  task_runner->AdvanceTimeBy(kDelay);
+  EXPECT_EQ(1, run_count);
+
+  debouncer.Call();
+  debouncer.Cancel();
+  EXPECT_FALSE(debouncer.is_pending());
+  task_runner->AdvanceTimeBy(kDelay);
+  EXPECT_EQ(1, run_count);
+}
+
+TEST(DebouncerTest, TaskDestroysDebouncer) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  std::unique_ptr<Debouncer> debouncer;
+  debouncer = std::make_unique<Debouncer>(
+      task_runner, [&debouncer] { debouncer.reset(); }, kDelay);
+  debouncer->Call();
+  task_runner->AdvanceTimeBy(kDelay);
+  EXPECT_FALSE(debouncer);
+}
+
+}  // namespace
+}  // namespace ftl
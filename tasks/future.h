@@ -0,0 +1,414 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_FUTURE_H_
+#define LIB_FTL_TASKS_FUTURE_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/future_internal.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace ftl {
+
+template <typename T>
+class Promise;
+
+namespace internal {
+struct FutureAccess;
+}  // namespace internal
+
+// A value of type |T| (or, for |Future<void>|, just completion) which will be
+// provided later by the corresponding |Promise<T>|. Rather than blocking to
+// wait for it, one chains continuations, which are posted to a |TaskRunner|
+// once the value is available:
+//
+//   Promise<std::string> promise;
+//   Future<size_t> size = promise.GetFuture().Then(
+//       io_runner, [](std::string data) { return data.size(); });
+//   size.Then(ui_runner, [](size_t size) { ... });
+//   ...
+//   promise.SetValue("...");
+//
+// A continuation may itself return a |Future<U>| (e.g., to start more
+// asynchronous work on another runner); the future returned by |Then()| is then
+// a |Future<U>| which is completed by that one.
+//
+// A future may instead end up without a value: if its promise is destroyed
+// without setting one, if it is canceled (see |Cancel()|), or if it results
+// from a continuation whose input future ended up without a value (or whose
+// task was dropped by its runner). Continuations of such futures are never
+// run.
+//
+// |Future| and |Promise| are move-only, and each must be used from one thread
+// at a time, but they may be on different threads.
+template <typename T>
+class Future final {
+ public:
+  // Creates an invalid future (with no promise).
+  Future() {}
+  Future(Future&& other) = default;
+  ~Future() {}
+
+  Future& operator=(Future&& other) = default;
+
+  // Returns whether this future has a promise (i.e., hasn't been
+  // default-constructed or consumed by |Then()| or |Cancel()|).
+  bool is_valid() const { return !!state_; }
+
+  // Consumes this future, returning a future for the result of running
+  // |continuation| (with this future's value as its argument, if any) on
+  // |task_runner| once this future's value is available.
+  template <typename F>
+  Future<typename internal::UnwrapFuture<
+      internal::ContinuationResult<T, F>>::Type>
+  Then(RefPtr<TaskRunner> task_runner, F continuation);
+
+  // Consumes this future, which ends up without a value: pending
+  // continuations will not be run, and the cancellation propagates up the
+  // chain of futures this one depends on (up to the promises providing them,
+  // see |Promise::SetCancelHandler()|).
+  void Cancel() {
+    FTL_DCHECK(state_);
+    state_->Cancel(true);
+    state_ = nullptr;
+  }
+
+ private:
+  friend class Promise<T>;
+  friend struct internal::FutureAccess;
+
+  explicit Future(RefPtr<internal::FutureState<T>> state)
+      : state_(std::move(state)) {}
+
+  RefPtr<internal::FutureState<T>> state_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Future);
+};
+
+// Provides the value for a |Future<T>|. If it is destroyed without having set
+// the value, the future ends up without one.
+template <typename T>
+class Promise final {
+ public:
+  using Value = typename internal::FutureValue<T>::Type;
+
+  Promise() : state_(MakeRefCounted<internal::FutureState<T>>()) {}
+  Promise(Promise&& other) = default;
+  ~Promise() { Abandon(); }
+
+  Promise& operator=(Promise&& other) {
+    if (this != &other) {
+      Abandon();
+      state_ = std::move(other.state_);
+      future_retrieved_ = other.future_retrieved_;
+    }
+    return *this;
+  }
+
+  // Returns the future for this promise. May only be called once.
+  Future<T> GetFuture() {
+    FTL_DCHECK(state_);
+    FTL_DCHECK(!future_retrieved_);
+    future_retrieved_ = true;
+    return Future<T>(state_);
+  }
+
+  // Sets the value (which is dropped if the future has been canceled). May only
+  // be called once.
+  void SetValue(Value value) {
+    FTL_DCHECK(state_);
+    state_->SetValue(std::move(value));
+    state_ = nullptr;
+  }
+
+  // For |Promise<void>|.
+  void SetValue() {
+    static_assert(std::is_void<T>::value, "SetValue() requires a value");
+    SetValue(Value());
+  }
+
+  // Returns whether the future has been canceled (in which case there's no
+  // point in computing the value).
+  bool IsCanceled() const { return state_ && state_->IsCanceled(); }
+
+  // Sets a function to be run if the future is canceled (on the thread calling
+  // |Future::Cancel()|) before the value has been set, replacing any previous
+  // one. Work that should stop when the future is canceled can be wrapped in a
+  // |CancelableCallback| (which must be canceled on the thread that runs it):
+  //
+  //   auto cancelable = std::make_shared<CancelableClosure>(...);
+  //   runner->PostTask(cancelable->callback());
+  //   promise.SetCancelHandler([runner, cancelable] {
+  //     runner->PostTask([cancelable] { cancelable->Cancel(); });
+  //   });
+  void SetCancelHandler(UniqueClosure cancel_handler) {
+    FTL_DCHECK(state_);
+    state_->SetCancelHandler(std::move(cancel_handler));
+  }
+
+ private:
+  void Abandon() {
+    if (state_) {
+      state_->Cancel(false);
+      state_ = nullptr;
+    }
+  }
+
+  RefPtr<internal::FutureState<T>> state_;
+  bool future_retrieved_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Promise);
+};
+
+namespace internal {
+
+struct FutureAccess {
+  template <typename T>
+  static RefPtr<FutureState<T>> TakeState(Future<T>* future) {
+    FTL_DCHECK(future->state_);
+    return std::move(future->state_);
+  }
+
+  template <typename T>
+  static Future<T> MakeFuture(RefPtr<FutureState<T>> state) {
+    return Future<T>(std::move(state));
+  }
+};
+
+// Runs a continuation which returns an |R|, and completes the promise for its
+// result.
+template <typename R>
+struct ContinuationRunner {
+  template <typename F, typename V>
+  static void Run(F* continuation, V value, Promise<R> promise) {
+    promise.SetValue(InvokeWithValue(*continuation, std::move(value)));
+  }
+};
+
+template <>
+struct ContinuationRunner<void> {
+  template <typename F, typename V>
+  static void Run(F* continuation, V value, Promise<void> promise) {
+    InvokeWithValue(*continuation, std::move(value));
+    promise.SetValue();
+  }
+};
+
+template <typename U>
+struct ContinuationRunner<Future<U>> {
+  template <typename F, typename V>
+  static void Run(F* continuation, V value, Promise<U> promise) {
+    Future<U> inner = InvokeWithValue(*continuation, std::move(value));
+    RefPtr<FutureState<U>> state = FutureAccess::TakeState(&inner);
+    promise.SetCancelHandler([state] { state->Cancel(true); });
+    FutureState<U>* raw_state = state.get();
+    raw_state->OnDone([ raw_state, promise = std::move(promise) ]() mutable {
+      // Otherwise, |promise| is abandoned.
+      if (raw_state->HasValue())
+        promise.SetValue(raw_state->TakeValue());
+    });
+  }
+};
+
+template <typename T>
+struct WhenAllTraits {
+  using Result = std::vector<T>;
+
+  static Result Collect(const std::vector<RefPtr<FutureState<T>>>& states) {
+    Result result;
+    result.reserve(states.size());
+    for (const auto& state : states)
+      result.push_back(state->TakeValue());
+    return result;
+  }
+};
+
+template <>
+struct WhenAllTraits<void> {
+  using Result = void;
+
+  static FutureVoid Collect(
+      const std::vector<RefPtr<FutureState<void>>>& states) {
+    return FutureVoid();
+  }
+};
+
+template <typename T>
+struct WhenAnyTraits {
+  using Result = std::pair<size_t, T>;
+
+  static Result Make(size_t index, FutureState<T>* state) {
+    return Result(index, state->TakeValue());
+  }
+};
+
+template <>
+struct WhenAnyTraits<void> {
+  using Result = size_t;
+
+  static Result Make(size_t index, FutureState<void>* state) { return index; }
+};
+
+// Tracks the inputs of |WhenAll()| or |WhenAny()|.
+template <typename T, typename R>
+class FutureCombinerState
+    : public RefCountedThreadSafe<FutureCombinerState<T, R>> {
+ public:
+  using Inputs = std::vector<RefPtr<FutureState<T>>>;
+
+  // Cancels all inputs.
+  void CancelInputs() {
+    for (const auto& input : inputs_)
+      input->Cancel(true);
+  }
+
+  const Inputs& inputs() const { return inputs_; }
+  FutureState<R>* result() const { return result_.get(); }
+
+  // Decrements the number of pending inputs, returning true if this was the
+  // last one.
+  bool DecrementPending() { return pending_.fetch_sub(1u) == 1u; }
+
+  // Returns true the first time it is called.
+  bool Claim() { return !claimed_.exchange(true); }
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(FutureCombinerState);
+  FRIEND_REF_COUNTED_THREAD_SAFE(FutureCombinerState);
+
+  FutureCombinerState(Inputs inputs, RefPtr<FutureState<R>> result)
+      : inputs_(std::move(inputs)),
+        result_(std::move(result)),
+        pending_(inputs_.size()),
+        claimed_(false) {}
+  ~FutureCombinerState() {}
+
+  const Inputs inputs_;
+  const RefPtr<FutureState<R>> result_;
+  std::atomic<size_t> pending_;
+  std::atomic<bool> claimed_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FutureCombinerState);
+};
+
+// Sets up a |FutureCombinerState| for |futures|, returning it and the result
+// future. Canceling the result cancels all the inputs.
+template <typename R, typename T>
+RefPtr<FutureCombinerState<T, R>> CombineFutures(
+    std::vector<Future<T>>* futures,
+    Future<R>* result_future) {
+  std::vector<RefPtr<FutureState<T>>> inputs;
+  inputs.reserve(futures->size());
+  for (auto& future : *futures)
+    inputs.push_back(FutureAccess::TakeState(&future));
+  auto result = MakeRefCounted<FutureState<R>>();
+  *result_future = FutureAccess::MakeFuture(result);
+  auto combiner =
+      MakeRefCounted<FutureCombinerState<T, R>>(std::move(inputs), result);
+  result->SetCancelHandler([combiner] { combiner->CancelInputs(); });
+  return combiner;
+}
+
+}  // namespace internal
+
+template <typename T>
+template <typename F>
+Future<typename internal::UnwrapFuture<
+    internal::ContinuationResult<T, F>>::Type>
+Future<T>::Then(RefPtr<TaskRunner> task_runner, F continuation) {
+  using Result = internal::ContinuationResult<T, F>;
+
+  FTL_DCHECK(state_);
+  FTL_DCHECK(task_runner);
+  Promise<typename internal::UnwrapFuture<Result>::Type> promise;
+  auto future = promise.GetFuture();
+  RefPtr<internal::FutureState<T>> state = std::move(state_);
+  promise.SetCancelHandler([state] { state->Cancel(true); });
+
+  internal::FutureState<T>* raw_state = state.get();
+  raw_state->OnDone([
+    raw_state, task_runner = std::move(task_runner),
+    continuation = std::move(continuation), promise = std::move(promise)
+  ]() mutable {
+    // Otherwise, |promise| is abandoned.
+    if (!raw_state->HasValue())
+      return;
+    task_runner->PostTask([
+      continuation = std::move(continuation), value = raw_state->TakeValue(),
+      promise = std::move(promise)
+    ]() mutable {
+      if (promise.IsCanceled())
+        return;
+      internal::ContinuationRunner<Result>::Run(
+          &continuation, std::move(value), std::move(promise));
+    });
+  });
+  return future;
+}
+
+// Returns a future for the values of all of |futures| (a |Future<void>| if
+// they are |Future<void>|s), in order. If any of them ends up without a value,
+// so does the result, and the others are canceled.
+template <typename T>
+Future<typename internal::WhenAllTraits<T>::Result> WhenAll(
+    std::vector<Future<T>> futures) {
+  using Traits = internal::WhenAllTraits<T>;
+
+  Future<typename Traits::Result> result_future;
+  auto combiner =
+      internal::CombineFutures<typename Traits::Result>(&futures,
+                                                        &result_future);
+  if (combiner->inputs().empty())
+    combiner->result()->SetValue(Traits::Collect(combiner->inputs()));
+  for (const auto& input : combiner->inputs()) {
+    internal::FutureState<T>* raw_input = input.get();
+    raw_input->OnDone([combiner, raw_input] {
+      if (!raw_input->HasValue())
+        combiner->result()->Cancel(true);
+      else if (combiner->DecrementPending())
+        combiner->result()->SetValue(Traits::Collect(combiner->inputs()));
+    });
+  }
+  return result_future;
+}
+
+// Returns a future for the index and value of the first of |futures| to get a
+// value (just the index if they are |Future<void>|s). The others are not
+// canceled. The result ends up without a value only if all of |futures| do.
+template <typename T>
+Future<typename internal::WhenAnyTraits<T>::Result> WhenAny(
+    std::vector<Future<T>> futures) {
+  using Traits = internal::WhenAnyTraits<T>;
+
+  FTL_DCHECK(!futures.empty());
+  Future<typename Traits::Result> result_future;
+  auto combiner =
+      internal::CombineFutures<typename Traits::Result>(&futures,
+                                                        &result_future);
+  for (size_t i = 0; i < combiner->inputs().size(); i++) {
+    internal::FutureState<T>* raw_input = combiner->inputs()[i].get();
+    raw_input->OnDone([combiner, raw_input, i] {
+      if (raw_input->HasValue() && combiner->Claim())
+        combiner->result()->SetValue(Traits::Make(i, raw_input));
+      if (combiner->DecrementPending())
+        combiner->result()->Cancel(false);
+    });
+  }
+  return result_future;
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_FUTURE_H_
@@ -0,0 +1,199 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Internal implementation details for future.h.
+
+#ifndef LIB_FTL_TASKS_FUTURE_INTERNAL_H_
+#define LIB_FTL_TASKS_FUTURE_INTERNAL_H_
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+
+template <typename T>
+class Future;
+
+namespace internal {
+
+// The value held by a |Future<void>|.
+struct FutureVoid {};
+
+template <typename T>
+struct FutureValue {
+  using Type = T;
+};
+
+template <>
+struct FutureValue<void> {
+  using Type = FutureVoid;
+};
+
+// The state shared by a |Promise<T>| and its |Future<T>|. It is either
+// pending, or done, with either a value or none (if it was canceled or the
+// promise was abandoned). This class is thread-safe.
+template <typename T>
+class FutureState : public RefCountedThreadSafe<FutureState<T>> {
+ public:
+  using Value = typename FutureValue<T>::Type;
+
+  // Sets the value, unless the state is already done (in that case, |value| is
+  // dropped), and runs the done callback.
+  void SetValue(Value value) {
+    UniqueClosure cancel_handler;
+    UniqueClosure callback;
+    {
+      MutexLocker locker(&mutex_);
+      if (status_ != Status::kPending)
+        return;
+      new (&value_storage_) Value(std::move(value));
+      status_ = Status::kValue;
+      cancel_handler = std::move(cancel_handler_);
+      callback = std::move(callback_);
+    }
+    if (callback)
+      callback();
+  }
+
+  // Marks the state done without a value, running the cancel handler (if
+  // |run_cancel_handler| is true) and then the done callback.
+  void Cancel(bool run_cancel_handler) {
+    UniqueClosure cancel_handler;
+    UniqueClosure callback;
+    {
+      MutexLocker locker(&mutex_);
+      if (status_ != Status::kPending)
+        return;
+      status_ = Status::kCanceled;
+      cancel_handler = std::move(cancel_handler_);
+      callback = std::move(callback_);
+    }
+    if (cancel_handler && run_cancel_handler)
+      cancel_handler();
+    if (callback)
+      callback();
+  }
+
+  bool IsCanceled() {
+    MutexLocker locker(&mutex_);
+    return status_ == Status::kCanceled;
+  }
+
+  // Sets the function to be run (on the thread calling |Cancel()|) if the
+  // state is canceled before it gets a value, replacing any previous one. If
+  // the state is already canceled, it is run immediately.
+  void SetCancelHandler(UniqueClosure cancel_handler) {
+    {
+      MutexLocker locker(&mutex_);
+      if (status_ == Status::kPending) {
+        cancel_handler_ = std::move(cancel_handler);
+        return;
+      }
+      if (status_ != Status::kCanceled)
+        return;
+    }
+    cancel_handler();
+  }
+
+  // Sets the callback to be run once the state is done (on the thread which
+  // makes it so, or immediately if it already is). There may only be one.
+  void OnDone(UniqueClosure callback) {
+    {
+      MutexLocker locker(&mutex_);
+      FTL_DCHECK(!callback_);
+      if (status_ == Status::kPending) {
+        callback_ = std::move(callback);
+        return;
+      }
+    }
+    callback();
+  }
+
+  // Whether the state is done with a value (which hasn't been taken). Only
+  // meaningful once the state is done.
+  bool HasValue() {
+    MutexLocker locker(&mutex_);
+    return status_ == Status::kValue;
+  }
+
+  // Moves the value out. May only be called once, if |HasValue()|.
+  Value TakeValue() {
+    MutexLocker locker(&mutex_);
+    FTL_DCHECK(status_ == Status::kValue);
+    Value* value = GetValue();
+    Value result(std::move(*value));
+    value->~Value();
+    status_ = Status::kTaken;
+    return result;
+  }
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(FutureState);
+  FRIEND_REF_COUNTED_THREAD_SAFE(FutureState);
+
+  enum class Status { kPending, kValue, kTaken, kCanceled };
+
+  FutureState() {}
+  ~FutureState() {
+    if (status_ == Status::kValue)
+      GetValue()->~Value();
+  }
+
+  Value* GetValue() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return reinterpret_cast<Value*>(&value_storage_);
+  }
+
+  Mutex mutex_;
+  Status status_ FTL_GUARDED_BY(mutex_) = Status::kPending;
+  // Holds a |Value| if |status_| is |Status::kValue|.
+  typename std::aligned_storage<sizeof(Value), alignof(Value)>::type
+      value_storage_ FTL_GUARDED_BY(mutex_);
+  UniqueClosure callback_ FTL_GUARDED_BY(mutex_);
+  UniqueClosure cancel_handler_ FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(FutureState);
+};
+
+// Calls |f| with |value|, or with no arguments for a |FutureVoid|.
+template <typename F, typename V>
+auto InvokeWithValue(F& f, V&& value) -> decltype(f(std::forward<V>(value))) {
+  return f(std::forward<V>(value));
+}
+
+template <typename F>
+auto InvokeWithValue(F& f, FutureVoid) -> decltype(f()) {
+  return f();
+}
+
+// The return type of a continuation |F| of a |Future<T>|.
+template <typename T, typename F>
+using ContinuationResult = decltype(
+    InvokeWithValue(std::declval<F&>(),
+                    std::declval<typename FutureValue<T>::Type>()));
+
+// The type of the future returned for a continuation returning |R|: a
+// continuation which returns a |Future<U>| results in a |Future<U>| (not a
+// |Future<Future<U>>|).
+template <typename R>
+struct UnwrapFuture {
+  using Type = R;
+};
+
+template <typename U>
+struct UnwrapFuture<Future<U>> {
+  using Type = U;
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_FUTURE_INTERNAL_H_
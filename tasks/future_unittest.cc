@@ -0,0 +1,235 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/future.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/functional/auto_call.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/message_loop.h"
+
+namespace ftl {
+namespace {
+
+class FutureTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loop_ = MakeRefCounted<MessageLoop>();
+    ASSERT_TRUE(loop_->Start());
+  }
+
+  void TearDown() override { loop_->QuitAndJoin(); }
+
+  RefPtr<MessageLoop> loop_;
+};
+
+TEST_F(FutureTest, ThenRunsOnTaskRunner) {
+  Promise<int> promise;
+  AutoResetWaitableEvent done;
+  int result = 0;
+  bool on_loop = false;
+  Future<void> future =
+      promise.GetFuture()
+          .Then(loop_, [](int value) { return value * 2; })
+          .Then(loop_, [ this, &result, &on_loop ](int value) {
+            result = value;
+            on_loop = loop_->RunsTasksOnCurrentThread();
+          })
+          .Then(loop_, [&done] { done.Signal(); });
+  EXPECT_TRUE(future.is_valid());
+  promise.SetValue(21);
+  done.Wait();
+  EXPECT_EQ(42, result);
+  EXPECT_TRUE(on_loop);
+}
+
+TEST_F(FutureTest, ValueSetBeforeThen) {
+  Promise<void> promise;
+  Future<void> future = promise.GetFuture();
+  promise.SetValue();
+
+  AutoResetWaitableEvent done;
+  future.Then(loop_, [&done] { done.Signal(); });
+  EXPECT_FALSE(future.is_valid());
+  done.Wait();
+}
+
+TEST_F(FutureTest, MoveOnlyValue) {
+  Promise<std::unique_ptr<int>> promise;
+  AutoResetWaitableEvent done;
+  int result = 0;
+  promise.GetFuture().Then(loop_,
+                           [&result, &done](std::unique_ptr<int> value) {
+                             result = *value;
+                             done.Signal();
+                           });
+  promise.SetValue(std::unique_ptr<int>(new int(5)));
+  done.Wait();
+  EXPECT_EQ(5, result);
+}
+
+TEST_F(FutureTest, ContinuationReturningFuture) {
+  auto other_loop = MakeRefCounted<MessageLoop>();
+  ASSERT_TRUE(other_loop->Start());
+
+  Promise<int> promise;
+  AutoResetWaitableEvent done;
+  std::string result;
+  promise.GetFuture()
+      .Then(loop_,
+            [other_loop](int value) {
+              Promise<std::string> inner;
+              Future<std::string> inner_future = inner.GetFuture();
+              other_loop->PostTask(
+                  [ value, inner = std::move(inner) ]() mutable {
+                    inner.SetValue(std::to_string(value));
+                  });
+              return inner_future;
+            })
+      .Then(loop_, [&result, &done](std::string value) {
+        result = value;
+        done.Signal();
+      });
+  promise.SetValue(123);
+  done.Wait();
+  EXPECT_EQ("123", result);
+  other_loop->QuitAndJoin();
+}
+
+TEST_F(FutureTest, AbandonedPromise) {
+  AutoResetWaitableEvent dropped;
+  bool ran = false;
+  {
+    Promise<int> promise;
+    auto signal_dropped = MakeAutoCall([&dropped] { dropped.Signal(); });
+    promise.GetFuture()
+        .Then(loop_, [&ran](int value) { ran = true; })
+        .Then(loop_, [&ran, signal_dropped = std::move(signal_dropped)] {
+          ran = true;
+        });
+  }
+  // Destroying the promise drops the continuations.
+  dropped.Wait();
+  EXPECT_FALSE(ran);
+}
+
+TEST_F(FutureTest, Cancel) {
+  Promise<int> promise;
+  bool cancel_handler_ran = false;
+  promise.SetCancelHandler([&cancel_handler_ran] {
+    cancel_handler_ran = true;
+  });
+  bool ran = false;
+  Future<void> future =
+      promise.GetFuture()
+          .Then(loop_, [](int value) { return value + 1; })
+          .Then(loop_, [&ran](int value) { ran = true; });
+  EXPECT_FALSE(promise.IsCanceled());
+
+  // Canceling the end of the chain cancels the promise at its start.
+  future.Cancel();
+  EXPECT_FALSE(future.is_valid());
+  EXPECT_TRUE(promise.IsCanceled());
+  EXPECT_TRUE(cancel_handler_ran);
+  promise.SetValue(1);
+
+  AutoResetWaitableEvent done;
+  loop_->PostTask([&done] { done.Signal(); });
+  done.Wait();
+  EXPECT_FALSE(ran);
+}
+
+TEST_F(FutureTest, WhenAll) {
+  std::vector<Promise<int>> promises(3);
+  std::vector<Future<int>> futures;
+  for (auto& promise : promises)
+    futures.push_back(promise.GetFuture());
+
+  AutoResetWaitableEvent done;
+  std::vector<int> result;
+  WhenAll(std::move(futures))
+      .Then(loop_, [&result, &done](std::vector<int> values) {
+        result = std::move(values);
+        done.Signal();
+      });
+  promises[2].SetValue(2);
+  promises[0].SetValue(0);
+  promises[1].SetValue(1);
+  done.Wait();
+  EXPECT_EQ((std::vector<int>{0, 1, 2}), result);
+
+  // With no futures, the result is ready immediately.
+  WhenAll(std::vector<Future<void>>()).Then(loop_, [&done] { done.Signal(); });
+  done.Wait();
+}
+
+TEST_F(FutureTest, WhenAllCancelsOthers) {
+  std::vector<Promise<void>> promises(3);
+  std::vector<Future<void>> futures;
+  for (auto& promise : promises)
+    futures.push_back(promise.GetFuture());
+
+  AutoResetWaitableEvent dropped;
+  bool ran = false;
+  auto signal_dropped = MakeAutoCall([&dropped] { dropped.Signal(); });
+  WhenAll(std::move(futures))
+      .Then(loop_, [&ran, signal_dropped = std::move(signal_dropped)] {
+        ran = true;
+      });
+  promises[0].SetValue();
+  // Abandoning one of the promises cancels the rest.
+  promises[1] = Promise<void>();
+  dropped.Wait();
+  EXPECT_FALSE(ran);
+  EXPECT_TRUE(promises[2].IsCanceled());
+}
+
+TEST_F(FutureTest, WhenAny) {
+  std::vector<Promise<std::string>> promises(3);
+  std::vector<Future<std::string>> futures;
+  for (auto& promise : promises)
+    futures.push_back(promise.GetFuture());
+
+  AutoResetWaitableEvent done;
+  std::pair<size_t, std::string> result;
+  WhenAny(std::move(futures))
+      .Then(loop_, [&result, &done](std::pair<size_t, std::string> value) {
+        result = std::move(value);
+        done.Signal();
+      });
+  // Abandoned promises are ignored (unless all of them are).
+  promises[0] = Promise<std::string>();
+  promises[2].SetValue("two");
+  promises[1].SetValue("one");
+  done.Wait();
+  EXPECT_EQ(2u, result.first);
+  EXPECT_EQ("two", result.second);
+  // The others are not canceled.
+  EXPECT_FALSE(promises[1].IsCanceled());
+}
+
+TEST_F(FutureTest, WhenAnyVoid) {
+  std::vector<Promise<void>> promises(2);
+  std::vector<Future<void>> futures;
+  for (auto& promise : promises)
+    futures.push_back(promise.GetFuture());
+
+  AutoResetWaitableEvent done;
+  size_t result = 0u;
+  WhenAny(std::move(futures)).Then(loop_, [&result, &done](size_t index) {
+    result = index;
+    done.Signal();
+  });
+  promises[1].SetValue();
+  done.Wait();
+  EXPECT_EQ(1u, result);
+}
+
+}  // namespace
+}  // namespace ftl
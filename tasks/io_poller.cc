@@ -0,0 +1,241 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/io_poller.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "lib/ftl/compiler_specific.h"
+#include "lib/ftl/files/eintr_wrapper.h"
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+// Converts |timeout| to milliseconds for |epoll_wait()|/|poll()|, rounding up
+// (so that the caller doesn't spin until a deadline that is less than a
+// millisecond away), or -1 for no timeout.
+int ToTimeoutMilliseconds(TimeDelta timeout) {
+  if (timeout == TimeDelta::Max())
+    return -1;
+  if (timeout <= TimeDelta::Zero())
+    return 0;
+  int64_t millis = (timeout.ToMicroseconds() + 999) / 1000;
+  return static_cast<int>(
+      std::min<int64_t>(millis, std::numeric_limits<int>::max()));
+}
+
+}  // namespace
+
+constexpr uint32_t IOPoller::kReadable;
+constexpr uint32_t IOPoller::kWritable;
+constexpr uint32_t IOPoller::kError;
+
+// static
+std::unique_ptr<IOPoller> IOPoller::Create() {
+  std::unique_ptr<IOPoller> poller(new IOPoller());
+  if (!poller->Init())
+    return nullptr;
+  return poller;
+}
+
+IOPoller::IOPoller() {}
+
+IOPoller::~IOPoller() {}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+namespace {
+
+// The id reported for |IOPoller::wakeup_fd_| (watches get positive ids).
+constexpr uint64_t kWakeupId = 0u;
+
+uint32_t ToEpollEvents(uint32_t events) {
+  uint32_t epoll_events = 0u;
+  if (events & IOPoller::kReadable)
+    epoll_events |= EPOLLIN;
+  if (events & IOPoller::kWritable)
+    epoll_events |= EPOLLOUT;
+  return epoll_events;
+}
+
+}  // namespace
+
+bool IOPoller::Init() {
+  epoll_fd_.reset(epoll_create1(EPOLL_CLOEXEC));
+  if (!epoll_fd_.is_valid())
+    return false;
+  wakeup_fd_.reset(eventfd(0u, EFD_CLOEXEC | EFD_NONBLOCK));
+  if (!wakeup_fd_.is_valid())
+    return false;
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = kWakeupId;
+  return epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, wakeup_fd_.get(), &event) ==
+         0;
+}
+
+bool IOPoller::Add(int fd, uint32_t events, uint64_t id) {
+  FTL_DCHECK(id != kWakeupId);
+  struct epoll_event event = {};
+  event.events = ToEpollEvents(events);
+  event.data.u64 = id;
+  return epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+void IOPoller::Remove(int fd) {
+  // This fails harmlessly if |fd| was already closed (which removes it).
+  epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void IOPoller::Wait(TimeDelta timeout, std::vector<Event>* events) {
+  constexpr int kMaxEvents = 64;
+  struct epoll_event epoll_events[kMaxEvents];
+  int count = HANDLE_EINTR(epoll_wait(epoll_fd_.get(), epoll_events,
+                                      kMaxEvents,
+                                      ToTimeoutMilliseconds(timeout)));
+  for (int i = 0; i < count; i++) {
+    if (epoll_events[i].data.u64 == kWakeupId) {
+      DrainWakeup();
+      continue;
+    }
+    uint32_t ready = 0u;
+    if (epoll_events[i].events & EPOLLIN)
+      ready |= kReadable;
+    if (epoll_events[i].events & EPOLLOUT)
+      ready |= kWritable;
+    if (epoll_events[i].events & (EPOLLERR | EPOLLHUP))
+      ready |= kError;
+    events->push_back(Event{epoll_events[i].data.u64, ready});
+  }
+}
+
+void IOPoller::Wakeup() {
+  uint64_t value = 1u;
+  // This only fails if the counter is saturated, in which case a wakeup is
+  // already pending.
+  ssize_t result = HANDLE_EINTR(write(wakeup_fd_.get(), &value, sizeof(value)));
+  FTL_ALLOW_UNUSED_LOCAL(result);
+}
+
+void IOPoller::DrainWakeup() {
+  uint64_t value;
+  ssize_t result = HANDLE_EINTR(read(wakeup_fd_.get(), &value, sizeof(value)));
+  FTL_ALLOW_UNUSED_LOCAL(result);
+}
+
+#else  // !defined(OS_LINUX) && !defined(OS_ANDROID)
+
+namespace {
+
+bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 &&
+         fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+short ToPollEvents(uint32_t events) {
+  short poll_events = 0;
+  if (events & IOPoller::kReadable)
+    poll_events |= POLLIN;
+  if (events & IOPoller::kWritable)
+    poll_events |= POLLOUT;
+  return poll_events;
+}
+
+}  // namespace
+
+bool IOPoller::Init() {
+  int fds[2];
+  if (pipe(fds) != 0)
+    return false;
+  wakeup_read_fd_.reset(fds[0]);
+  wakeup_write_fd_.reset(fds[1]);
+  if (!SetNonBlocking(wakeup_read_fd_.get()) ||
+      !SetNonBlocking(wakeup_write_fd_.get())) {
+    return false;
+  }
+  struct pollfd pollfd = {};
+  pollfd.fd = wakeup_read_fd_.get();
+  pollfd.events = POLLIN;
+  pollfds_.push_back(pollfd);
+  ids_.push_back(0u);
+  return true;
+}
+
+bool IOPoller::Add(int fd, uint32_t events, uint64_t id) {
+  FTL_DCHECK(std::none_of(
+      pollfds_.begin(), pollfds_.end(),
+      [fd](const struct pollfd& pollfd) { return pollfd.fd == fd; }));
+  struct pollfd pollfd = {};
+  pollfd.fd = fd;
+  pollfd.events = ToPollEvents(events);
+  pollfds_.push_back(pollfd);
+  ids_.push_back(id);
+  return true;
+}
+
+void IOPoller::Remove(int fd) {
+  for (size_t i = 1u; i < pollfds_.size(); i++) {
+    if (pollfds_[i].fd == fd) {
+      pollfds_[i] = pollfds_.back();
+      pollfds_.pop_back();
+      ids_[i] = ids_.back();
+      ids_.pop_back();
+      return;
+    }
+  }
+}
+
+void IOPoller::Wait(TimeDelta timeout, std::vector<Event>* events) {
+  int count = HANDLE_EINTR(poll(pollfds_.data(), pollfds_.size(),
+                                ToTimeoutMilliseconds(timeout)));
+  if (count <= 0)
+    return;
+  if (pollfds_[0].revents)
+    DrainWakeup();
+  for (size_t i = 1u; i < pollfds_.size(); i++) {
+    short revents = pollfds_[i].revents;
+    if (!revents)
+      continue;
+    uint32_t ready = 0u;
+    if (revents & POLLIN)
+      ready |= kReadable;
+    if (revents & POLLOUT)
+      ready |= kWritable;
+    if (revents & (POLLERR | POLLHUP | POLLNVAL))
+      ready |= kError;
+    events->push_back(Event{ids_[i], ready});
+  }
+}
+
+void IOPoller::Wakeup() {
+  char byte = 0;
+  // This only fails if the pipe is full, in which case a wakeup is already
+  // pending.
+  ssize_t result = HANDLE_EINTR(write(wakeup_write_fd_.get(), &byte, 1u));
+  FTL_ALLOW_UNUSED_LOCAL(result);
+}
+
+void IOPoller::DrainWakeup() {
+  char buffer[64];
+  while (HANDLE_EINTR(read(wakeup_read_fd_.get(), buffer, sizeof(buffer))) > 0)
+    continue;
+}
+
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+}  // namespace internal
+}  // namespace ftl
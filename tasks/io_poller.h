@@ -0,0 +1,93 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_IO_POLLER_H_
+#define LIB_FTL_TASKS_IO_POLLER_H_
+
+#include "lib/ftl/build_config.h"
+
+#if !defined(OS_WIN)
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+
+#if !defined(OS_LINUX) && !defined(OS_ANDROID)
+#include <poll.h>
+#endif
+
+namespace ftl {
+namespace internal {
+
+// Waits for file descriptors to become ready, or for a wakeup from another
+// thread, for |MessageLoop|. This uses epoll (with an eventfd for wakeups) on
+// Linux, and |poll()| (with a pipe) elsewhere.
+//
+// Except for |Wakeup()|, this is not thread-safe.
+class FTL_EXPORT IOPoller final {
+ public:
+  // Flags for |Add()| and |Event::events|.
+  static constexpr uint32_t kReadable = 1u << 0;
+  static constexpr uint32_t kWritable = 1u << 1;
+  // Only reported (it needn't be asked for): an error or hang-up.
+  static constexpr uint32_t kError = 1u << 2;
+
+  struct Event {
+    uint64_t id;
+    uint32_t events;
+  };
+
+  // Returns null on failure (e.g., if out of file descriptors).
+  static std::unique_ptr<IOPoller> Create();
+
+  ~IOPoller();
+
+  // Starts watching |fd| (which must not already be watched) for |events|,
+  // reporting them with |id|. Returns false on failure.
+  bool Add(int fd, uint32_t events, uint64_t id);
+  void Remove(int fd);
+
+  // Waits until some watched file descriptor is ready, |Wakeup()| is called,
+  // or |timeout| elapses (|TimeDelta::Max()| for no timeout), appending the
+  // ready file descriptors' events (if any) to |*events|. Watches are level
+  // triggered: a file descriptor is reported every time it is still ready.
+  void Wait(TimeDelta timeout, std::vector<Event>* events);
+
+  // Makes the current (or next) |Wait()| return. May be called from any
+  // thread.
+  void Wakeup();
+
+ private:
+  IOPoller();
+
+  bool Init();
+  void DrainWakeup();
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  UniqueFD epoll_fd_;
+  UniqueFD wakeup_fd_;
+#else
+  UniqueFD wakeup_read_fd_;
+  UniqueFD wakeup_write_fd_;
+  // |pollfds_[0]| is |wakeup_read_fd_|; the rest are watched, with their ids
+  // in the same positions of |ids_|.
+  std::vector<struct pollfd> pollfds_;
+  std::vector<uint64_t> ids_;
+#endif
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(IOPoller);
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // !defined(OS_WIN)
+
+#endif  // LIB_FTL_TASKS_IO_POLLER_H_
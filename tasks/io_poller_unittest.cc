@@ -0,0 +1,96 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/io_poller.h"
+
+#if !defined(OS_WIN)
+
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/unique_fd.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/stopwatch.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+TEST(IOPollerTest, Timeout) {
+  std::unique_ptr<IOPoller> poller = IOPoller::Create();
+  ASSERT_TRUE(poller);
+  std::vector<IOPoller::Event> events;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  poller->Wait(TimeDelta::FromMilliseconds(10), &events);
+  EXPECT_GE(stopwatch.Elapsed(),
+            TimeDelta::FromMilliseconds(10) - kTimeoutTolerance);
+  EXPECT_TRUE(events.empty());
+}
+
+TEST(IOPollerTest, Wakeup) {
+  std::unique_ptr<IOPoller> poller = IOPoller::Create();
+  ASSERT_TRUE(poller);
+  std::vector<IOPoller::Event> events;
+
+  // A wakeup before waiting isn't lost.
+  poller->Wakeup();
+  poller->Wakeup();
+  poller->Wait(TimeDelta::Max(), &events);
+  EXPECT_TRUE(events.empty());
+
+  Thread thread([&poller] { poller->Wakeup(); });
+  ASSERT_TRUE(thread.Run());
+  poller->Wait(TimeDelta::Max(), &events);
+  EXPECT_TRUE(thread.Join());
+  EXPECT_TRUE(events.empty());
+
+  // The wakeups have been consumed.
+  poller->Wait(TimeDelta::Zero(), &events);
+  EXPECT_TRUE(events.empty());
+}
+
+TEST(IOPollerTest, ReadableAndWritable) {
+  std::unique_ptr<IOPoller> poller = IOPoller::Create();
+  ASSERT_TRUE(poller);
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  UniqueFD read_fd(fds[0]);
+  UniqueFD write_fd(fds[1]);
+  ASSERT_TRUE(poller->Add(read_fd.get(), IOPoller::kReadable, 1u));
+  ASSERT_TRUE(poller->Add(write_fd.get(), IOPoller::kWritable, 2u));
+
+  std::vector<IOPoller::Event> events;
+  poller->Wait(TimeDelta::Max(), &events);
+  ASSERT_EQ(1u, events.size());
+  EXPECT_EQ(2u, events[0].id);
+  EXPECT_EQ(IOPoller::kWritable, events[0].events);
+
+  poller->Remove(write_fd.get());
+  ASSERT_EQ(1, write(write_fd.get(), "x", 1u));
+  events.clear();
+  poller->Wait(TimeDelta::Max(), &events);
+  ASSERT_EQ(1u, events.size());
+  EXPECT_EQ(1u, events[0].id);
+  EXPECT_EQ(IOPoller::kReadable, events[0].events);
+
+  // Closing the other end reports a hang-up.
+  write_fd.reset();
+  events.clear();
+  char buffer[2];
+  EXPECT_EQ(1, read(read_fd.get(), buffer, sizeof(buffer)));
+  poller->Wait(TimeDelta::Max(), &events);
+  ASSERT_EQ(1u, events.size());
+  EXPECT_TRUE(events[0].events & IOPoller::kError);
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // !defined(OS_WIN)
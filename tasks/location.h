@@ -0,0 +1,42 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_LOCATION_H_
+#define LIB_FTL_TASKS_LOCATION_H_
+
+namespace ftl {
+
+// A location in the source code, used to record where tasks were posted from
+// (see |TaskTracer|). Create one with |FTL_FROM_HERE|.
+class Location {
+ public:
+  // Creates a null location.
+  constexpr Location() {}
+  constexpr Location(const char* function_name,
+                     const char* file_name,
+                     int line_number)
+      : function_name_(function_name),
+        file_name_(file_name),
+        line_number_(line_number) {}
+
+  bool is_null() const { return !file_name_; }
+
+  // These are null for a null location. The strings must be string literals
+  // (or otherwise outlive the location).
+  const char* function_name() const { return function_name_; }
+  const char* file_name() const { return file_name_; }
+  int line_number() const { return line_number_; }
+
+ private:
+  const char* function_name_ = nullptr;
+  const char* file_name_ = nullptr;
+  int line_number_ = 0;
+};
+
+}  // namespace ftl
+
+// The current location in the source code, as a |Location|.
+#define FTL_FROM_HERE ::ftl::Location(__func__, __FILE__, __LINE__)
+
+#endif  // LIB_FTL_TASKS_LOCATION_H_
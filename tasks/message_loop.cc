@@ -0,0 +1,476 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/message_loop.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "lib/ftl/debug/trace_event.h"
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+// The maximum number of consecutive batches of other tasks which may pass over
+// pending best-effort tasks.
+constexpr uint32_t kMaxBestEffortSkipCount = 8u;
+
+thread_local MessageLoop* g_current_message_loop = nullptr;
+
+}  // namespace
+
+MessageLoop::DelayedTask::DelayedTask(UniqueClosure task,
+                                      TimePoint target_time,
+                                      uint64_t sequence_number)
+    : task(std::move(task)),
+      target_time(target_time),
+      sequence_number(sequence_number) {}
+
+bool MessageLoop::DelayedTask::operator>(const DelayedTask& other) const {
+  if (target_time != other.target_time)
+    return target_time > other.target_time;
+  return sequence_number > other.sequence_number;
+}
+
+MessageLoop::MessageLoop()
+    : has_user_blocking_tasks_(false), waiting_(false), quit_(false) {}
+
+MessageLoop::~MessageLoop() {
+  QuitAndJoin();
+}
+
+bool MessageLoop::Start(size_t stack_size) {
+  Thread::Options options;
+  options.stack_size = stack_size;
+  return Start(options);
+}
+
+bool MessageLoop::Start(const Thread::Options& options) {
+  if (thread_)
+    return false;
+
+  thread_.reset(new Thread([this] { Run(); }));
+  // (So that the child of a fork() can take the lock.)
+  fork_handlers_.reset(
+      new ForkHandlers(&mutex_, [this]() FTL_NO_THREAD_SAFETY_ANALYSIS {
+        // Nothing is run from now on. (In particular, |cv_| mustn't be
+        // signaled, since it still counts the loop thread as waiting.)
+        forked_ = true;
+        quit_.store(true, std::memory_order_relaxed);
+        waiting_.store(false, std::memory_order_relaxed);
+        polling_ = false;
+      }));
+  if (!thread_->Run(options)) {
+    fork_handlers_.reset();
+    thread_.reset();
+    return false;
+  }
+  return true;
+}
+
+void MessageLoop::QuitAndJoin() {
+  if (!thread_)
+    return;
+  FTL_DCHECK(!RunsTasksOnCurrentThread());
+
+  {
+    MutexLocker locker(&mutex_);
+    quit_.store(true, std::memory_order_seq_cst);
+    if (!forked_)
+      WakeUpLocked();
+  }
+  thread_->Join();
+  DropIncomingTasks();
+
+  // Destroy the pending tasks outside the lock, since their destructors may
+  // post tasks (which are dropped).
+  std::vector<UniqueClosure> user_blocking_tasks;
+  std::deque<UniqueClosure> best_effort_tasks;
+  std::vector<DelayedTask> delayed_tasks;
+  std::deque<IdleTask> idle_tasks;
+  {
+    MutexLocker locker(&mutex_);
+    user_blocking_tasks.swap(user_blocking_tasks_);
+    best_effort_tasks.swap(best_effort_tasks_);
+    delayed_tasks.swap(delayed_tasks_);
+    idle_tasks.swap(idle_tasks_);
+  }
+}
+
+// static
+MessageLoop* MessageLoop::GetCurrent() {
+  return g_current_message_loop;
+}
+
+#if !defined(OS_WIN)
+
+constexpr uint32_t MessageLoop::kFileDescriptorReadable;
+constexpr uint32_t MessageLoop::kFileDescriptorWritable;
+constexpr uint32_t MessageLoop::kFileDescriptorError;
+
+MessageLoop::FileDescriptorWatch::FileDescriptorWatch(RefPtr<MessageLoop> loop,
+                                                      int fd,
+                                                      uint64_t id)
+    : loop_(std::move(loop)), fd_(fd), id_(id) {}
+
+MessageLoop::FileDescriptorWatch::~FileDescriptorWatch() {
+  loop_->StopWatchingFileDescriptor(fd_, id_);
+}
+
+std::unique_ptr<MessageLoop::FileDescriptorWatch>
+MessageLoop::WatchFileDescriptor(int fd,
+                                 uint32_t events,
+                                 FileDescriptorCallback callback) {
+  FTL_DCHECK(RunsTasksOnCurrentThread());
+  FTL_DCHECK(callback);
+
+  if (!io_poller_) {
+    io_poller_ = internal::IOPoller::Create();
+    if (!io_poller_)
+      return nullptr;
+  }
+  uint64_t id = next_watch_id_++;
+  if (!io_poller_->Add(fd, events, id))
+    return nullptr;
+  watches_[id] = std::move(callback);
+  return std::unique_ptr<FileDescriptorWatch>(
+      new FileDescriptorWatch(RefPtr<MessageLoop>(this), fd, id));
+}
+
+void MessageLoop::StopWatchingFileDescriptor(int fd, uint64_t id) {
+  FTL_DCHECK(RunsTasksOnCurrentThread() || !thread_->IsRunning());
+  watches_.erase(id);
+  {
+    // The child of a fork() shares its parent's poller, so mustn't change it.
+    MutexLocker locker(&mutex_);
+    if (forked_)
+      return;
+  }
+  io_poller_->Remove(fd);
+}
+
+void MessageLoop::DispatchFileDescriptorEvent(
+    const internal::IOPoller::Event& event) {
+  // The watch may have been destroyed since the event was reported.
+  auto it = watches_.find(event.id);
+  if (it == watches_.end())
+    return;
+  // The callback may destroy its own watch, so run it from the stack.
+  FileDescriptorCallback callback = std::move(it->second);
+  callback(event.events);
+  it = watches_.find(event.id);
+  if (it != watches_.end())
+    it->second = std::move(callback);
+}
+
+#endif  // !defined(OS_WIN)
+
+void MessageLoop::PostTask(UniqueClosure task) {
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task));
+
+  incoming_tasks_.Push(std::move(task));
+  OnIncomingTasksPushed();
+}
+
+void MessageLoop::PostTaskForTime(UniqueClosure task, TimePoint target_time) {
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task), target_time);
+
+  MutexLocker locker(&mutex_);
+  if (quit_.load(std::memory_order_relaxed))
+    return;
+  delayed_tasks_.emplace_back(std::move(task), target_time,
+                              next_sequence_number_++);
+  std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(),
+                 std::greater<DelayedTask>());
+  // The loop only needs to wake up early if this is now the first task due.
+  if (waiting_.load(std::memory_order_relaxed) &&
+      delayed_tasks_.front().target_time == target_time) {
+    WakeUpLocked();
+  }
+}
+
+void MessageLoop::PostDelayedTask(UniqueClosure task, TimeDelta delay) {
+  PostTaskForTime(std::move(task), TimePoint::Now() + delay);
+}
+
+void MessageLoop::PostTaskWithPriority(UniqueClosure task,
+                                       TaskPriority priority) {
+  if (priority == TaskPriority::kNormal) {
+    PostTask(std::move(task));
+    return;
+  }
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task));
+
+  MutexLocker locker(&mutex_);
+  if (quit_.load(std::memory_order_relaxed))
+    return;
+  if (priority == TaskPriority::kUserBlocking) {
+    user_blocking_tasks_.push_back(std::move(task));
+    has_user_blocking_tasks_.store(true, std::memory_order_relaxed);
+  } else {
+    best_effort_tasks_.push_back(std::move(task));
+  }
+  if (waiting_.load(std::memory_order_relaxed))
+    WakeUpLocked();
+}
+
+void MessageLoop::PostTasks(std::vector<UniqueClosure> tasks) {
+  for (const auto& task : tasks)
+    FTL_DCHECK(task);
+  if (tasks.empty())
+    return;
+  TraceTasks(&tasks);
+
+  for (auto& task : tasks)
+    incoming_tasks_.Push(std::move(task));
+  OnIncomingTasksPushed();
+}
+
+void MessageLoop::PostTasksForTime(std::vector<UniqueClosure> tasks,
+                                   TimePoint target_time) {
+  if (tasks.empty())
+    return;
+  TraceTasks(&tasks, target_time);
+
+  MutexLocker locker(&mutex_);
+  if (quit_.load(std::memory_order_relaxed))
+    return;
+  for (auto& task : tasks) {
+    FTL_DCHECK(task);
+    delayed_tasks_.emplace_back(std::move(task), target_time,
+                                next_sequence_number_++);
+    std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(),
+                   std::greater<DelayedTask>());
+  }
+  if (waiting_.load(std::memory_order_relaxed) &&
+      delayed_tasks_.front().target_time == target_time) {
+    WakeUpLocked();
+  }
+}
+
+void MessageLoop::PostIdleTask(IdleTask task) {
+  FTL_DCHECK(task);
+
+  MutexLocker locker(&mutex_);
+  if (quit_.load(std::memory_order_relaxed))
+    return;
+  idle_tasks_.push_back(std::move(task));
+  if (waiting_.load(std::memory_order_relaxed))
+    WakeUpLocked();
+}
+
+bool MessageLoop::PostTaskCoalesced(uint64_t key, UniqueClosure task) {
+  FTL_DCHECK(task);
+  {
+    MutexLocker locker(&coalesced_mutex_);
+    if (!coalesced_keys_.insert(key).second)
+      return false;
+  }
+
+  // Only loop tasks touch |this|, so it outlives them.
+  PostTask([this, key, task = std::move(task)] {
+    {
+      MutexLocker locker(&coalesced_mutex_);
+      coalesced_keys_.erase(key);
+    }
+    task();
+  });
+  return true;
+}
+
+bool MessageLoop::RunsTasksOnCurrentThread() {
+  return g_current_message_loop == this;
+}
+
+TimerWheel* MessageLoop::GetTimerWheel() {
+  FTL_DCHECK(RunsTasksOnCurrentThread());
+  return &timer_wheel_;
+}
+
+void MessageLoop::Run() {
+  FTL_DCHECK(!g_current_message_loop);
+  g_current_message_loop = this;
+
+  std::vector<UniqueClosure> tasks;
+  for (;;) {
+    timer_wheel_.Advance(TimePoint::Now());
+#if !defined(OS_WIN)
+    // Check the file descriptors between batches too, so that a steady stream
+    // of tasks doesn't starve them.
+    if (!watches_.empty())
+      io_poller_->Wait(TimeDelta::Zero(), &ready_events_);
+#endif
+    if (!WaitForTasks(&tasks, timer_wheel_.NextExpirationTime()))
+      break;
+    for (auto& task : tasks) {
+      if (has_user_blocking_tasks_.load(std::memory_order_relaxed))
+        RunUserBlockingTasks();
+      FTL_TRACE_EVENT("ftl", "MessageLoop::RunTask");
+      task();
+    }
+    tasks.clear();
+  }
+
+  g_current_message_loop = nullptr;
+}
+
+void MessageLoop::SleepLocked(TimeDelta timeout) {
+#if !defined(OS_WIN)
+  if (io_poller_) {
+    // Wait without holding the lock, since posting threads need it to check
+    // |polling_|.
+    polling_ = true;
+    mutex_.Unlock();
+    io_poller_->Wait(timeout, &ready_events_);
+    mutex_.Lock();
+    polling_ = false;
+    return;
+  }
+#endif
+  if (timeout == TimeDelta::Max())
+    cv_.Wait(&mutex_);
+  else
+    cv_.WaitWithTimeout(&mutex_, timeout);
+}
+
+void MessageLoop::WakeUpLocked() {
+#if !defined(OS_WIN)
+  if (polling_) {
+    io_poller_->Wakeup();
+    return;
+  }
+#endif
+  cv_.Signal();
+}
+
+void MessageLoop::OnIncomingTasksPushed() {
+  // Pairs with the fence in |WaitForTasks()|: either the loop thread sees the
+  // pushed tasks before going to sleep, or we see that it is |waiting_|.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (quit_.load(std::memory_order_relaxed)) {
+    DropIncomingTasks();
+    return;
+  }
+  if (waiting_.load(std::memory_order_relaxed)) {
+    MutexLocker locker(&mutex_);
+    if (waiting_.load(std::memory_order_relaxed))
+      WakeUpLocked();
+  }
+}
+
+void MessageLoop::DropIncomingTasks() {
+  // Destroy the tasks outside the lock, since their destructors may post tasks
+  // (which are dropped).
+  std::vector<UniqueClosure> tasks;
+  {
+    MutexLocker locker(&mutex_);
+    UniqueClosure task;
+    while (incoming_tasks_.TryPop(&task))
+      tasks.push_back(std::move(task));
+  }
+}
+
+void MessageLoop::RunUserBlockingTasks() {
+  std::vector<UniqueClosure> tasks;
+  {
+    MutexLocker locker(&mutex_);
+    tasks.swap(user_blocking_tasks_);
+    has_user_blocking_tasks_.store(false, std::memory_order_relaxed);
+  }
+  for (auto& task : tasks) {
+    FTL_TRACE_EVENT("ftl", "MessageLoop::RunTask");
+    task();
+  }
+}
+
+bool MessageLoop::WaitForTasks(std::vector<UniqueClosure>* tasks,
+                               TimePoint timer_deadline) {
+  FTL_DCHECK(tasks->empty());
+
+  MutexLocker locker(&mutex_);
+  while (!quit_.load(std::memory_order_relaxed)) {
+    // User-blocking tasks go first.
+    tasks->swap(user_blocking_tasks_);
+    has_user_blocking_tasks_.store(false, std::memory_order_relaxed);
+
+    TimePoint now = TimePoint::Now();
+    while (!delayed_tasks_.empty() &&
+           delayed_tasks_.front().target_time <= now) {
+      std::pop_heap(delayed_tasks_.begin(), delayed_tasks_.end(),
+                    std::greater<DelayedTask>());
+      tasks->push_back(std::move(delayed_tasks_.back().task));
+      delayed_tasks_.pop_back();
+    }
+
+#if !defined(OS_WIN)
+    for (const auto& event : ready_events_)
+      tasks->push_back([this, event] { DispatchFileDescriptorEvent(event); });
+    ready_events_.clear();
+#endif
+
+    UniqueClosure task;
+    while (incoming_tasks_.TryPop(&task))
+      tasks->push_back(std::move(task));
+
+    // Best-effort tasks are taken one at a time, when there is nothing else to
+    // do (or they have been passed over for too many batches).
+    if (!best_effort_tasks_.empty() &&
+        (tasks->empty() ||
+         ++best_effort_skip_count_ >= kMaxBestEffortSkipCount)) {
+      tasks->push_back(std::move(best_effort_tasks_.front()));
+      best_effort_tasks_.pop_front();
+      best_effort_skip_count_ = 0u;
+    }
+
+    if (!tasks->empty() || timer_deadline <= now) {
+      in_idle_period_ = false;
+      return true;
+    }
+
+    TimePoint deadline = timer_deadline;
+    if (!delayed_tasks_.empty())
+      deadline = std::min(deadline, delayed_tasks_.front().target_time);
+
+    // Only the idle tasks which were pending when the idle period started may
+    // run in it, so that ones which repost themselves don't keep the loop busy.
+    if (!in_idle_period_) {
+      in_idle_period_ = true;
+      idle_period_task_count_ = idle_tasks_.size();
+    }
+    if (idle_period_task_count_ > 0u) {
+      idle_period_task_count_--;
+      TimePoint idle_deadline =
+          std::min(deadline, now + kMaxIdleTaskDuration);
+      tasks->push_back([
+        idle_task = std::move(idle_tasks_.front()), idle_deadline
+      ] { idle_task(idle_deadline); });
+      idle_tasks_.pop_front();
+      return true;
+    }
+
+    // Idle tasks left for the next idle period get one after at most
+    // |kMaxIdleTaskDuration|, even if nothing else wakes the loop.
+    if (!idle_tasks_.empty())
+      deadline = std::min(deadline, now + kMaxIdleTaskDuration);
+    waiting_.store(true, std::memory_order_relaxed);
+    // Pairs with the fence in |OnIncomingTasksPushed()|. (A task which is only
+    // partially pushed counts as incoming, so the loop spins briefly rather
+    // than miss it.)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (incoming_tasks_.IsEmpty()) {
+      SleepLocked(deadline == TimePoint::Max() ? TimeDelta::Max()
+                                               : deadline - now);
+    }
+    waiting_.store(false, std::memory_order_relaxed);
+    in_idle_period_ = false;
+  }
+  return false;
+}
+
+}  // namespace ftl
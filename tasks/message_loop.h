@@ -0,0 +1,288 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_MESSAGE_LOOP_H_
+#define LIB_FTL_TASKS_MESSAGE_LOOP_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mpsc_queue.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/io_poller.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/tasks/timer_wheel.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A |TaskRunner| that runs tasks, in order, on a dedicated thread which it
+// owns. Use like:
+//
+//   auto loop = MakeRefCounted<MessageLoop>();
+//   loop->Start();
+//   loop->PostTask([] { ... });
+//   ...
+//   loop->QuitAndJoin();
+//
+// Immediate tasks are run in the order they were posted. Delayed tasks are run
+// in order of their target time (ties are broken by posting order) once that
+// time has been reached. While there is nothing to do, the loop thread sleeps
+// until the next delayed task is due rather than polling.
+//
+// Tasks posted with |TaskPriority::kUserBlocking| jump the queue (running
+// before the next task of any other priority), while ones posted with
+// |TaskPriority::kBestEffort| run one at a time when there is nothing else to
+// do, or at least every few batches of other tasks.
+//
+// Idle tasks (see |PostIdleTask()|) run one at a time only when there is
+// nothing else to do: no immediate or best-effort tasks, and no delayed tasks
+// or timers due. Each is given a deadline of the next delayed task or timer
+// (or at most |kMaxIdleTaskDuration| away), which it should check since it
+// can't be preempted. Idle tasks posted while the loop is running idle tasks
+// (e.g., ones which repost themselves to continue their work) run in the
+// next idle period, which starts after the loop next sleeps or runs other
+// tasks.
+//
+// The loop also drives a |TimerWheel| (see |GetTimerWheel()|), which is the
+// cheaper option for large numbers of timeouts that are frequently rearmed or
+// canceled (|OneShotTimer| uses it automatically).
+//
+// Except on Windows, the loop can also watch file descriptors (see
+// |WatchFileDescriptor()|), waiting for them to become ready together with
+// tasks and timers in a single |epoll_wait()| (or |poll()|) call, so that a
+// single thread can serve sockets, timers and tasks without a separate thread
+// to poll.
+//
+// Tasks may be posted from any thread. Tasks posted before |Start()| are run
+// once the loop starts; tasks posted after |QuitAndJoin()| are dropped.
+// Posting a normal-priority immediate task (with |PostTask()| or
+// |PostTasks()|) is lock-free, unless the loop thread is asleep and has to be
+// woken up.
+//
+// Note: Tasks frequently hold references to the loop which runs them, so the
+// owner of the loop should call |QuitAndJoin()| (which drops pending tasks)
+// rather than relying on releasing its reference.
+//
+// In the child of a fork(), a loop which was started in the parent has quit
+// (without its thread): tasks posted to it are dropped, as are the ones it was
+// holding, by |QuitAndJoin()|.
+class FTL_EXPORT MessageLoop : public TaskRunner {
+ public:
+  // Starts the loop thread. Returns false if the loop was already started or
+  // the thread could not be created.
+  bool Start(size_t stack_size = Thread::default_stack_size);
+  // Like |Start()|, but creates the loop thread with the given |options|
+  // (e.g., to name it or pin it to particular CPUs).
+  bool Start(const Thread::Options& options);
+
+  // Stops the loop once the tasks it has already dequeued have run, waits for
+  // the loop thread to exit, and drops any pending tasks. Must not be called
+  // from the loop thread. Does nothing if the loop was never started.
+  void QuitAndJoin();
+
+  // Returns the loop whose thread is the current thread, or null if the current
+  // thread is not a loop thread.
+  static MessageLoop* GetCurrent();
+
+#if !defined(OS_WIN)
+  // Events for |WatchFileDescriptor()|.
+  static constexpr uint32_t kFileDescriptorReadable =
+      internal::IOPoller::kReadable;
+  static constexpr uint32_t kFileDescriptorWritable =
+      internal::IOPoller::kWritable;
+  // Only reported (it needn't be asked for): an error or hang-up.
+  static constexpr uint32_t kFileDescriptorError = internal::IOPoller::kError;
+
+  using FileDescriptorCallback = std::function<void(uint32_t events)>;
+
+  // Stops watching its file descriptor when destroyed (which must happen on
+  // the loop thread, or once the loop has quit).
+  class FTL_EXPORT FileDescriptorWatch final {
+   public:
+    ~FileDescriptorWatch();
+
+   private:
+    friend class MessageLoop;
+
+    FileDescriptorWatch(RefPtr<MessageLoop> loop, int fd, uint64_t id);
+
+    RefPtr<MessageLoop> loop_;
+    const int fd_;
+    const uint64_t id_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(FileDescriptorWatch);
+  };
+
+  // Calls |callback| (on the loop thread) with the events which are ready
+  // whenever |fd| is ready for any of |events| (a combination of
+  // |kFileDescriptorReadable| and |kFileDescriptorWritable|), until the
+  // returned watch is destroyed. Watches are level triggered: the callback is
+  // called again each time the loop waits while |fd| is still ready. Returns
+  // null on failure. Must be called on the loop thread, and each file
+  // descriptor may only have one watch at a time (which should be destroyed
+  // before the file descriptor is closed).
+  std::unique_ptr<FileDescriptorWatch> WatchFileDescriptor(
+      int fd,
+      uint32_t events,
+      FileDescriptorCallback callback);
+#endif  // !defined(OS_WIN)
+
+  // Posts |task| like |PostTask()|, unless a task posted with the same |key|
+  // hasn't started running yet, in which case |task| is dropped (destroyed
+  // without being run) and this returns false. This collapses bursts of posts
+  // of the same work (e.g., "flush dirty state" after each of many mutations)
+  // into a single run, which sees all the mutations made before it starts.
+  // Keys are up to the caller (e.g., the address of the object to flush).
+  bool PostTaskCoalesced(uint64_t key, UniqueClosure task);
+
+  // |TaskRunner|:
+  using TaskRunner::PostDelayedTask;
+  using TaskRunner::PostTask;
+  void PostTask(UniqueClosure task) override;
+  void PostTaskForTime(UniqueClosure task, TimePoint target_time) override;
+  void PostDelayedTask(UniqueClosure task, TimeDelta delay) override;
+  void PostTaskWithPriority(UniqueClosure task, TaskPriority priority) override;
+  void PostTasks(std::vector<UniqueClosure> tasks) override;
+  void PostTasksForTime(std::vector<UniqueClosure> tasks,
+                        TimePoint target_time) override;
+  void PostIdleTask(IdleTask task) override;
+  bool RunsTasksOnCurrentThread() override;
+  TimerWheel* GetTimerWheel() override;
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(MessageLoop);
+  FRIEND_REF_COUNTED_THREAD_SAFE(MessageLoop);
+
+  struct DelayedTask {
+    DelayedTask(UniqueClosure task,
+                TimePoint target_time,
+                uint64_t sequence_number);
+
+    // For the min-heap in |delayed_tasks_|: "greater" means "runs later".
+    bool operator>(const DelayedTask& other) const;
+
+    UniqueClosure task;
+    TimePoint target_time;
+    uint64_t sequence_number;
+  };
+
+  MessageLoop();
+  ~MessageLoop() override;
+
+  // The body of the loop thread.
+  void Run();
+
+  // Moves all runnable tasks into |*tasks| (or a single idle task, if there is
+  // nothing else to run), sleeping until there is at least one or
+  // |timer_deadline| is reached. Returns false if the loop should exit.
+  bool WaitForTasks(std::vector<UniqueClosure>* tasks,
+                    TimePoint timer_deadline);
+
+  // Runs the user-blocking tasks which were posted after the current batch of
+  // tasks was taken.
+  void RunUserBlockingTasks();
+
+  // Blocks the loop thread until |WakeUpLocked()| is called, |timeout| elapses
+  // (|TimeDelta::Max()| for no timeout), or (spuriously) whenever. Watched
+  // file descriptors which become ready are added to |ready_events_|.
+  void SleepLocked(TimeDelta timeout) FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Wakes the loop thread (which must be |waiting_|).
+  void WakeUpLocked() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Called after pushing onto |incoming_tasks_| without holding |mutex_|: wakes
+  // the loop thread if it's waiting, or drops the tasks if it has quit.
+  void OnIncomingTasksPushed();
+  // Destroys the tasks in |incoming_tasks_|.
+  void DropIncomingTasks();
+
+#if !defined(OS_WIN)
+  void StopWatchingFileDescriptor(int fd, uint64_t id);
+  void DispatchFileDescriptorEvent(const internal::IOPoller::Event& event);
+#endif
+
+  std::unique_ptr<Thread> thread_;
+  // Only used on the loop thread.
+  TimerWheel timer_wheel_;
+
+#if !defined(OS_WIN)
+  // Created on the loop thread by the first |WatchFileDescriptor()|, after
+  // which the loop waits on it instead of |cv_|. Other threads only use it
+  // (to wake the loop) while |polling_|.
+  std::unique_ptr<internal::IOPoller> io_poller_;
+  // Only used on the loop thread.
+  std::unordered_map<uint64_t, FileDescriptorCallback> watches_;
+  uint64_t next_watch_id_ = 1u;
+  std::vector<internal::IOPoller::Event> ready_events_;
+#endif
+
+  // The keys of the |PostTaskCoalesced()| tasks which haven't started running.
+  // (This has its own lock, so as not to contend with the loop's.)
+  Mutex coalesced_mutex_;
+  std::unordered_set<uint64_t> coalesced_keys_
+      FTL_GUARDED_BY(coalesced_mutex_);
+
+  // Immediate tasks of |TaskPriority::kNormal|, which are pushed without
+  // holding |mutex_|, but only popped with it held (by the loop thread, or by
+  // whoever drops them once the loop has quit).
+  MpscQueue<UniqueClosure> incoming_tasks_;
+
+  Mutex mutex_;
+  CondVar cv_;
+  // Immediate tasks of other priorities (|incoming_tasks_| has the
+  // |TaskPriority::kNormal| ones).
+  std::vector<UniqueClosure> user_blocking_tasks_ FTL_GUARDED_BY(mutex_);
+  std::deque<UniqueClosure> best_effort_tasks_ FTL_GUARDED_BY(mutex_);
+  // The number of consecutive batches which have passed over a non-empty
+  // |best_effort_tasks_|.
+  uint32_t best_effort_skip_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  // Whether |user_blocking_tasks_| is non-empty (written under |mutex_|), so
+  // that the loop can check between tasks without locking.
+  std::atomic<bool> has_user_blocking_tasks_;
+  // A min-heap (using |std::push_heap()|/|std::pop_heap()|) ordered by target
+  // time.
+  std::vector<DelayedTask> delayed_tasks_ FTL_GUARDED_BY(mutex_);
+  uint64_t next_sequence_number_ FTL_GUARDED_BY(mutex_) = 0u;
+  std::deque<IdleTask> idle_tasks_ FTL_GUARDED_BY(mutex_);
+  // Whether the loop has been running idle tasks since it last ran other
+  // tasks or slept.
+  bool in_idle_period_ FTL_GUARDED_BY(mutex_) = false;
+  // The number of tasks at the front of |idle_tasks_| which may still run in
+  // the current idle period.
+  size_t idle_period_task_count_ FTL_GUARDED_BY(mutex_) = 0u;
+  // True while the loop thread is blocked on |cv_|; posting only signals then.
+  // Written under |mutex_|, but read without it by |OnIncomingTasksPushed()|
+  // (see |WaitForTasks()|).
+  std::atomic<bool> waiting_;
+  // True while the loop thread is blocked on |io_poller_| (and |waiting_|).
+  bool polling_ FTL_GUARDED_BY(mutex_) = false;
+  // Written under |mutex_|, but read without it by |OnIncomingTasksPushed()|.
+  std::atomic<bool> quit_;
+  // Set in the child of a fork(), where the loop thread is gone.
+  bool forked_ FTL_GUARDED_BY(mutex_) = false;
+  // Once started, keep |mutex_| across fork()s.
+  std::unique_ptr<ForkHandlers> fork_handlers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(MessageLoop);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_MESSAGE_LOOP_H_
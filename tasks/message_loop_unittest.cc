@@ -0,0 +1,450 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/message_loop.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/one_shot_timer.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+#include "lib/ftl/time/stopwatch.h"
+
+#if !defined(OS_WIN)
+#include <unistd.h>
+
+#include "lib/ftl/files/unique_fd.h"
+#endif
+
+namespace ftl {
+namespace {
+
+TEST(MessageLoopTest, StartAndQuit) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  EXPECT_FALSE(loop->Start());
+  EXPECT_FALSE(loop->RunsTasksOnCurrentThread());
+  EXPECT_EQ(nullptr, MessageLoop::GetCurrent());
+  loop->QuitAndJoin();
+}
+
+TEST(MessageLoopTest, RunsTasksInOrder) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::vector<int> order;
+  ManualResetWaitableEvent done;
+
+  // Tasks posted before the loop starts are run once it does.
+  loop->PostTask([&order] { order.push_back(0); });
+  EXPECT_TRUE(loop->Start());
+  for (int i = 1; i < 100; i++)
+    loop->PostTask([&order, i] { order.push_back(i); });
+  loop->PostTask([&done] { done.Signal(); });
+  done.Wait();
+  loop->QuitAndJoin();
+
+  ASSERT_EQ(100u, order.size());
+  for (int i = 0; i < 100; i++)
+    EXPECT_EQ(i, order[i]);
+}
+
+TEST(MessageLoopTest, RunsTasksOnLoopThread) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  bool runs_tasks_on_current_thread = false;
+  MessageLoop* current = nullptr;
+  ManualResetWaitableEvent done;
+  loop->PostTask([&] {
+    runs_tasks_on_current_thread = loop->RunsTasksOnCurrentThread();
+    current = MessageLoop::GetCurrent();
+    done.Signal();
+  });
+  done.Wait();
+  loop->QuitAndJoin();
+  EXPECT_TRUE(runs_tasks_on_current_thread);
+  EXPECT_EQ(loop.get(), current);
+}
+
+TEST(MessageLoopTest, DelayedTasksRunInTargetTimeOrder) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::vector<int> order;
+  ManualResetWaitableEvent done;
+  TimePoint start = TimePoint::Now();
+
+  loop->PostTaskForTime([&order] { order.push_back(3); },
+                        start + TimeDelta::FromMilliseconds(30));
+  loop->PostTaskForTime([&order] { order.push_back(1); },
+                        start + TimeDelta::FromMilliseconds(10));
+  loop->PostTaskForTime([&order] { order.push_back(2); },
+                        start + TimeDelta::FromMilliseconds(10));
+  loop->PostTaskForTime([&order, &done] {
+    order.push_back(4);
+    done.Signal();
+  }, start + TimeDelta::FromMilliseconds(40));
+  loop->PostTask([&order] { order.push_back(0); });
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  EXPECT_GE(TimePoint::Now() - start,
+            TimeDelta::FromMilliseconds(40) - kTimeoutTolerance);
+  loop->QuitAndJoin();
+
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), order);
+}
+
+TEST(MessageLoopTest, DelayedTaskWakesIdleLoop) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  ManualResetWaitableEvent done;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  // The loop is already sleeping (with no deadline) when this is posted.
+  loop->PostDelayedTask([&done] { done.Signal(); },
+                        TimeDelta::FromMilliseconds(20));
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(),
+            TimeDelta::FromMilliseconds(20) - kTimeoutTolerance);
+  loop->QuitAndJoin();
+}
+
+TEST(MessageLoopTest, PostTasks) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::vector<int> order;
+  ManualResetWaitableEvent done;
+  TimePoint start = TimePoint::Now();
+
+  std::vector<UniqueClosure> delayed_tasks;
+  for (int i = 6; i < 9; i++)
+    delayed_tasks.push_back([&order, i] { order.push_back(i); });
+  delayed_tasks.push_back([&done] { done.Signal(); });
+  loop->PostTasksForTime(std::move(delayed_tasks),
+                         start + TimeDelta::FromMilliseconds(20));
+
+  for (int batch = 0; batch < 2; batch++) {
+    std::vector<UniqueClosure> tasks;
+    for (int i = 0; i < 3; i++) {
+      int n = batch * 3 + i;
+      tasks.push_back([&order, n] { order.push_back(n); });
+    }
+    loop->PostTasks(std::move(tasks));
+  }
+  loop->PostTasks(std::vector<UniqueClosure>());
+
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  EXPECT_GE(TimePoint::Now() - start,
+            TimeDelta::FromMilliseconds(20) - kTimeoutTolerance);
+  loop->QuitAndJoin();
+
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8}), order);
+}
+
+TEST(MessageLoopTest, PostTaskCoalesced) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::vector<int> order;
+
+  // Posted before the loop starts, so none of them have run.
+  EXPECT_TRUE(loop->PostTaskCoalesced(1u, [&order] { order.push_back(1); }));
+  EXPECT_TRUE(loop->PostTaskCoalesced(2u, [&order] { order.push_back(2); }));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_FALSE(loop->PostTaskCoalesced(1u, [] { ADD_FAILURE(); }));
+    EXPECT_FALSE(loop->PostTaskCoalesced(2u, [] { ADD_FAILURE(); }));
+  }
+  // Once the task has started, the key may be posted again.
+  ManualResetWaitableEvent done;
+  loop->PostTask([&loop, &order, &done] {
+    EXPECT_TRUE(loop->PostTaskCoalesced(1u, [&loop, &order, &done] {
+      order.push_back(3);
+      EXPECT_TRUE(loop->PostTaskCoalesced(1u, [&order, &done] {
+        order.push_back(4);
+        done.Signal();
+      }));
+    }));
+  });
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  loop->QuitAndJoin();
+
+  EXPECT_EQ((std::vector<int>{1, 2, 3, 4}), order);
+}
+
+TEST(MessageLoopTest, Priorities) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::vector<int> order;
+  ManualResetWaitableEvent done;
+
+  loop->PostTaskWithPriority([&order] { order.push_back(-1); },
+                             TaskPriority::kBestEffort);
+  loop->PostTask([&loop, &order] {
+    order.push_back(1);
+    // This runs before the rest of the current batch.
+    loop->PostTaskWithPriority([&order] { order.push_back(2); },
+                               TaskPriority::kUserBlocking);
+  });
+  loop->PostTask([&order] { order.push_back(3); });
+  loop->PostTaskWithPriority([&order] { order.push_back(0); },
+                             TaskPriority::kUserBlocking);
+  loop->PostTaskWithPriority([&done] { done.Signal(); },
+                             TaskPriority::kBestEffort);
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  loop->QuitAndJoin();
+
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, -1}), order);
+}
+
+TEST(MessageLoopTest, BestEffortTasksAreNotStarved) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  int best_effort_count = 0;
+  int best_effort_count_when_done = 0;
+  ManualResetWaitableEvent done;
+
+  for (int i = 0; i < 5; i++) {
+    loop->PostTaskWithPriority([&best_effort_count] { best_effort_count++; },
+                               TaskPriority::kBestEffort);
+  }
+  // Keep the loop busy with a chain of normal tasks, one per batch.
+  std::function<void(int)> chain = [&](int remaining) {
+    if (!remaining) {
+      best_effort_count_when_done = best_effort_count;
+      done.Signal();
+      return;
+    }
+    loop->PostTask([&chain, remaining] { chain(remaining - 1); });
+  };
+  loop->PostTask([&chain] { chain(100); });
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  loop->QuitAndJoin();
+
+  EXPECT_EQ(5, best_effort_count_when_done);
+}
+
+TEST(MessageLoopTest, IdleTasksRunWhenIdle) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::vector<int> order;
+  ManualResetWaitableEvent done;
+
+  loop->PostIdleTask([&order](TimePoint deadline) { order.push_back(3); });
+  loop->PostTaskWithPriority([&order] { order.push_back(2); },
+                             TaskPriority::kBestEffort);
+  loop->PostTask([&order] { order.push_back(0); });
+  loop->PostTask([&order] { order.push_back(1); });
+  loop->PostIdleTask([&order, &done](TimePoint deadline) {
+    order.push_back(4);
+    done.Signal();
+  });
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  loop->QuitAndJoin();
+
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), order);
+}
+
+TEST(MessageLoopTest, IdleTaskDeadline) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  TimePoint delayed_target_time;
+  TimePoint idle_deadline;
+  TimePoint idle_start_time;
+  ManualResetWaitableEvent done;
+  loop->PostTask([&] {
+    delayed_target_time = TimePoint::Now() + TimeDelta::FromMilliseconds(30);
+    loop->PostTaskForTime([] {}, delayed_target_time);
+    loop->PostIdleTask([&](TimePoint deadline) {
+      idle_deadline = deadline;
+      idle_start_time = TimePoint::Now();
+      done.Signal();
+    });
+  });
+  done.Wait();
+  loop->QuitAndJoin();
+
+  // The deadline is the next delayed task, if that is soon enough.
+  EXPECT_EQ(delayed_target_time, idle_deadline);
+  EXPECT_LT(idle_start_time, idle_deadline);
+
+  // Otherwise, it's at most |kMaxIdleTaskDuration| away.
+  loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  done.Reset();
+  loop->PostIdleTask([&](TimePoint deadline) {
+    idle_deadline = deadline;
+    idle_start_time = TimePoint::Now();
+    done.Signal();
+  });
+  done.Wait();
+  loop->QuitAndJoin();
+  EXPECT_LE(idle_deadline - idle_start_time, TaskRunner::kMaxIdleTaskDuration);
+  EXPECT_GT(idle_deadline, idle_start_time);
+}
+
+TEST(MessageLoopTest, RepostedIdleTaskRunsInNextIdlePeriod) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  int count = 0;
+  int other_count = 0;
+  int other_count_at_repost = -1;
+  ManualResetWaitableEvent done;
+  std::function<void(TimePoint)> idle_task = [&](TimePoint deadline) {
+    if (++count == 1) {
+      loop->PostIdleTask(idle_task);
+      return;
+    }
+    other_count_at_repost = other_count;
+    done.Signal();
+  };
+  loop->PostIdleTask(idle_task);
+  loop->PostIdleTask([&other_count](TimePoint deadline) { other_count++; });
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  loop->QuitAndJoin();
+
+  // The reposted task ran after the rest of the first idle period.
+  EXPECT_EQ(2, count);
+  EXPECT_EQ(1, other_count_at_repost);
+}
+
+TEST(MessageLoopTest, OneShotTimerUsesTimerWheel) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  OneShotTimer timer;
+  int fired = 0;
+  bool is_started = false;
+  size_t wheel_size = 0u;
+  ManualResetWaitableEvent done;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  loop->PostTask([&] {
+    // Restarting the timer reschedules it on the wheel rather than posting
+    // another task.
+    for (int i = 0; i < 100; i++) {
+      timer.Start(loop.get(), [&fired, &done] {
+        fired++;
+        done.Signal();
+      }, TimeDelta::FromMilliseconds(20));
+    }
+    is_started = timer.is_started();
+    wheel_size = loop->GetTimerWheel()->size();
+  });
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(),
+            TimeDelta::FromMilliseconds(20) - kTimeoutTolerance);
+  loop->QuitAndJoin();
+  EXPECT_TRUE(is_started);
+  EXPECT_EQ(1u, wheel_size);
+  EXPECT_EQ(1, fired);
+  EXPECT_FALSE(timer.is_started());
+}
+
+#if !defined(OS_WIN)
+TEST(MessageLoopTest, WatchFileDescriptor) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  UniqueFD read_fd(fds[0]);
+  UniqueFD write_fd(fds[1]);
+
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  std::unique_ptr<MessageLoop::FileDescriptorWatch> watch;
+  std::vector<char> received;
+  AutoResetWaitableEvent event;
+  loop->PostTask([&] {
+    watch = loop->WatchFileDescriptor(
+        read_fd.get(), MessageLoop::kFileDescriptorReadable,
+        [&](uint32_t events) {
+          EXPECT_TRUE(loop->RunsTasksOnCurrentThread());
+          EXPECT_TRUE(events & MessageLoop::kFileDescriptorReadable);
+          char c;
+          ASSERT_EQ(1, read(read_fd.get(), &c, 1u));
+          received.push_back(c);
+          event.Signal();
+        });
+    event.Signal();
+  });
+  event.Wait();
+  ASSERT_TRUE(watch);
+
+  ASSERT_EQ(1, write(write_fd.get(), "a", 1u));
+  event.Wait();
+  // Tasks and delayed tasks still wake the loop while it waits on the file
+  // descriptors.
+  loop->PostTask([&event] { event.Signal(); });
+  event.Wait();
+  loop->PostDelayedTask([&event] { event.Signal(); },
+                        TimeDelta::FromMilliseconds(10));
+  event.Wait();
+  ASSERT_EQ(1, write(write_fd.get(), "b", 1u));
+  event.Wait();
+
+  loop->PostTask([&] {
+    watch.reset();
+    event.Signal();
+  });
+  event.Wait();
+  // Once the watch is gone, the callback doesn't run.
+  ASSERT_EQ(1, write(write_fd.get(), "c", 1u));
+  loop->PostDelayedTask([&event] { event.Signal(); },
+                        TimeDelta::FromMilliseconds(20));
+  event.Wait();
+  loop->QuitAndJoin();
+
+  EXPECT_EQ((std::vector<char>{'a', 'b'}), received);
+}
+
+TEST(MessageLoopTest, FileDescriptorCallbackDestroysWatch) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  UniqueFD read_fd(fds[0]);
+  UniqueFD write_fd(fds[1]);
+  ASSERT_EQ(1, write(write_fd.get(), "a", 1u));
+
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  std::unique_ptr<MessageLoop::FileDescriptorWatch> watch;
+  int call_count = 0;
+  AutoResetWaitableEvent done;
+  loop->PostTask([&] {
+    watch = loop->WatchFileDescriptor(
+        read_fd.get(), MessageLoop::kFileDescriptorReadable,
+        [&](uint32_t events) {
+          // The data is never read, so this would be called repeatedly.
+          call_count++;
+          watch.reset();
+          loop->PostDelayedTask([&done] { done.Signal(); },
+                                TimeDelta::FromMilliseconds(10));
+        });
+  });
+  done.Wait();
+  loop->QuitAndJoin();
+
+  EXPECT_EQ(1, call_count);
+}
+#endif  // !defined(OS_WIN)
+
+TEST(MessageLoopTest, QuitDropsPendingTasks) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  bool did_run = false;
+  loop->PostDelayedTask([&did_run] { did_run = true; },
+                        TimeDelta::FromSeconds(100));
+  loop->QuitAndJoin();
+  loop->PostTask([&did_run] { did_run = true; });
+  EXPECT_FALSE(did_run);
+}
+
+TEST(MessageLoopTest, QuitFromDestructor) {
+  bool did_run = false;
+  {
+    auto loop = MakeRefCounted<MessageLoop>();
+    EXPECT_TRUE(loop->Start());
+    loop->PostDelayedTask([&did_run] { did_run = true; },
+                          TimeDelta::FromSeconds(100));
+  }
+  EXPECT_FALSE(did_run);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -4,24 +4,38 @@
 
 #include "lib/ftl/tasks/one_shot_timer.h"
 
+#include <utility>
+
 #include "lib/ftl/logging.h"
 
 namespace ftl {
 
-OneShotTimer::OneShotTimer() : weak_ptr_factory_(this) {}
+OneShotTimer::OneShotTimer()
+    : wheel_timer_([this] { RunTask(); }), weak_ptr_factory_(this) {}
 
 OneShotTimer::~OneShotTimer() {
   Stop();
 }
 
 void OneShotTimer::Start(TaskRunner* task_runner,
-                         const Closure& task,
+                         UniqueClosure task,
                          TimeDelta delay) {
   FTL_DCHECK(task_runner);
   FTL_DCHECK(task);
 
+  TimerWheel* timer_wheel = task_runner->RunsTasksOnCurrentThread()
+                                ? task_runner->GetTimerWheel()
+                                : nullptr;
+  if (timer_wheel) {
+    // Orphan any task posted by a previous |Start()| without a wheel.
+    weak_ptr_factory_.InvalidateWeakPtrs();
+    task_ = std::move(task);
+    timer_wheel->Schedule(&wheel_timer_, TimePoint::Now() + delay);
+    return;
+  }
+
   Stop();
-  task_ = task;
+  task_ = std::move(task);
   auto weak_ptr = weak_ptr_factory_.GetWeakPtr();
   task_runner->PostDelayedTask(
       [weak_ptr] {
@@ -33,14 +47,15 @@ void OneShotTimer::Start(TaskRunner* task_runner,
 
 void OneShotTimer::Stop() {
   if (task_) {
-    task_ = Closure();
+    task_ = nullptr;
+    wheel_timer_.Cancel();
     weak_ptr_factory_.InvalidateWeakPtrs();
   }
 }
 
 void OneShotTimer::RunTask() {
   if (task_) {
-    Closure task;
+    UniqueClosure task;
     task_.swap(task);
     task();
   }
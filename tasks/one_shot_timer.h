@@ -6,10 +6,11 @@
 #define LIB_FTL_TASKS_ONE_SHOT_TIMER_H_
 
 #include "lib/ftl/ftl_export.h"
-#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/functional/inline_closure.h"
 #include "lib/ftl/macros.h"
 #include "lib/ftl/memory/weak_ptr.h"
 #include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/tasks/timer_wheel.h"
 #include "lib/ftl/time/time_delta.h"
 
 namespace ftl {
@@ -26,7 +27,11 @@ class FTL_EXPORT OneShotTimer {
 
   // Posts |task| to |task_runner| to run after the given |delay| unless
   // the timer is stopped before the task runs.
-  void Start(TaskRunner* task_runner, const Closure& task, TimeDelta delay);
+  //
+  // If |task_runner| has a |TimerWheel| (see |TaskRunner::GetTimerWheel()|),
+  // the timer is scheduled on that instead, so that restarting the timer
+  // reschedules it in place rather than leaving a stale task behind.
+  void Start(TaskRunner* task_runner, UniqueClosure task, TimeDelta delay);
 
   // Stops the timer.
   // Does nothing if not started.
@@ -35,7 +40,8 @@ class FTL_EXPORT OneShotTimer {
  private:
   void RunTask();
 
-  Closure task_;
+  UniqueClosure task_;
+  TimerWheel::Timer wheel_timer_;
   WeakPtrFactory<OneShotTimer> weak_ptr_factory_;
 
   FTL_DISALLOW_COPY_AND_ASSIGN(OneShotTimer);
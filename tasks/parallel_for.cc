@@ -0,0 +1,146 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+// The state shared by the threads running a |RunParallelFor()|. Helper tasks
+// may start after the loop has finished (and |fn_| is gone), so they hold a
+// reference, and only touch |fn_| once they have claimed a chunk.
+class ParallelForState : public RefCountedThreadSafe<ParallelForState> {
+ public:
+  // Runs chunks as |participant| until there are none left to claim.
+  void RunChunks(size_t participant) {
+    size_t chunk_begin;
+    size_t chunk_end;
+    while (ClaimChunk(&chunk_begin, &chunk_end)) {
+      fn_(participant, chunk_begin, chunk_end);
+      size_t size = chunk_end - chunk_begin;
+      if (unfinished_count_.fetch_sub(size, std::memory_order_acq_rel) ==
+          size) {
+        MutexLocker locker(&mutex_);
+        done_ = true;
+        done_cv_.Signal();
+      }
+    }
+  }
+
+  // Waits for the chunks claimed by other threads to finish.
+  void WaitUntilDone() {
+    MutexLocker locker(&mutex_);
+    while (!done_)
+      done_cv_.Wait(&mutex_);
+  }
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(ParallelForState);
+  FRIEND_REF_COUNTED_THREAD_SAFE(ParallelForState);
+
+  ParallelForState(size_t begin,
+                   size_t end,
+                   size_t grain,
+                   size_t participant_count,
+                   FunctionRef<void(size_t, size_t, size_t)> fn)
+      : end_(end),
+        grain_(grain),
+        participant_count_(participant_count),
+        fn_(fn),
+        next_(begin),
+        unfinished_count_(end - begin) {}
+  ~ParallelForState() {}
+
+  // Claims the next chunk, about a (2 * |participant_count_|)th of what's left
+  // (so that there are always enough chunks to go around), but at least
+  // |grain_|.
+  bool ClaimChunk(size_t* chunk_begin, size_t* chunk_end) {
+    size_t next = next_.load(std::memory_order_relaxed);
+    size_t size;
+    do {
+      if (next >= end_)
+        return false;
+      size_t remaining = end_ - next;
+      size = std::min(
+          remaining, std::max(grain_, remaining / (2u * participant_count_)));
+    } while (!next_.compare_exchange_weak(next, next + size,
+                                          std::memory_order_relaxed));
+    *chunk_begin = next;
+    *chunk_end = next + size;
+    return true;
+  }
+
+  const size_t end_;
+  const size_t grain_;
+  const size_t participant_count_;
+  const FunctionRef<void(size_t, size_t, size_t)> fn_;
+
+  // The start of the next chunk to claim.
+  std::atomic<size_t> next_;
+  // The number of indices which haven't been run yet.
+  std::atomic<size_t> unfinished_count_;
+
+  Mutex mutex_;
+  CondVar done_cv_;
+  bool done_ FTL_GUARDED_BY(mutex_) = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ParallelForState);
+};
+
+}  // namespace
+
+void RunParallelFor(ThreadPool* pool,
+                    size_t begin,
+                    size_t end,
+                    size_t grain,
+                    FunctionRef<void(size_t, size_t, size_t)> fn) {
+  if (begin >= end)
+    return;
+  size_t participant_count =
+      ParallelForParticipantCount(pool, begin, end, grain);
+  if (participant_count == 1u) {
+    fn(0u, begin, end);
+    return;
+  }
+
+  auto state = MakeRefCounted<ParallelForState>(begin, end, grain,
+                                                participant_count, fn);
+  std::vector<UniqueClosure> helpers;
+  helpers.reserve(participant_count - 1u);
+  for (size_t i = 1u; i < participant_count; i++)
+    helpers.push_back([state, i] { state->RunChunks(i); });
+  pool->PostTasks(std::move(helpers));
+
+  state->RunChunks(0u);
+  state->WaitUntilDone();
+}
+
+size_t ParallelForParticipantCount(ThreadPool* pool,
+                                   size_t begin,
+                                   size_t end,
+                                   size_t grain) {
+  FTL_DCHECK(pool);
+  FTL_DCHECK(grain > 0u);
+  if (begin >= end)
+    return 1u;
+  size_t chunk_count = (end - begin - 1u) / grain + 1u;
+  return std::min(pool->thread_count() + 1u, chunk_count);
+}
+
+}  // namespace internal
+}  // namespace ftl
@@ -0,0 +1,115 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Data-parallel loops over index ranges, run on a |ThreadPool|.
+
+#ifndef LIB_FTL_TASKS_PARALLEL_FOR_H_
+#define LIB_FTL_TASKS_PARALLEL_FOR_H_
+
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/function_ref.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace ftl {
+namespace internal {
+
+// Runs |fn(participant, chunk_begin, chunk_end)| over chunks covering
+// [|begin|, |end|), on the calling thread and on helper tasks posted to |pool|,
+// returning once every chunk has run. |participant| is less than the value
+// returned by |ParallelForParticipantCount()| for the same arguments, and no
+// two chunks with the same |participant| run concurrently.
+FTL_EXPORT void RunParallelFor(
+    ThreadPool* pool,
+    size_t begin,
+    size_t end,
+    size_t grain,
+    FunctionRef<void(size_t, size_t, size_t)> fn);
+
+// Returns the number of threads (including the calling thread) which
+// |RunParallelFor()| may use.
+FTL_EXPORT size_t ParallelForParticipantCount(ThreadPool* pool,
+                                              size_t begin,
+                                              size_t end,
+                                              size_t grain);
+
+}  // namespace internal
+
+// Calls |fn(chunk_begin, chunk_end)| for disjoint chunks covering [|begin|,
+// |end|), concurrently on |pool|'s workers and the calling thread, and returns
+// once all of them have run:
+//
+//   ParallelFor(pool.get(), 0u, buffer.size(), 4096u,
+//               [&buffer](size_t begin, size_t end) {
+//                 for (size_t i = begin; i < end; i++)
+//                   buffer[i] = Transform(buffer[i]);
+//               });
+//
+// Rather than posting a task per chunk and blocking, the calling thread runs
+// chunks itself, along with helper tasks (up to one per worker) which claim
+// chunks until none are left. Chunks start large and shrink as the range is
+// used up (but are never smaller than |grain|, which must be nonzero), so that
+// threads that finish early take the remaining work instead of idling at the
+// tail. The calling thread only blocks while the last few chunks finish on
+// other threads.
+//
+// This may be called from one of |pool|'s workers (e.g., for nested loops). If
+// |pool| is busy or shut down, the calling thread just runs all of the chunks.
+template <typename Fn>
+void ParallelFor(ThreadPool* pool,
+                 size_t begin,
+                 size_t end,
+                 size_t grain,
+                 Fn fn) {
+  internal::RunParallelFor(
+      pool, begin, end, grain,
+      [&fn](size_t participant, size_t chunk_begin, size_t chunk_end) {
+        fn(chunk_begin, chunk_end);
+      });
+}
+
+// Like |ParallelFor()|, but combines the |T| values returned by |map(
+// chunk_begin, chunk_end)| for each chunk using |reduce(T, T)|, which must be
+// associative and commutative (chunks are combined in an unspecified order),
+// starting from |identity|:
+//
+//   uint64_t sum = ParallelReduce(
+//       pool.get(), 0u, data.size(), 4096u, uint64_t(0),
+//       [&data](size_t begin, size_t end) {
+//         return Checksum(&data[begin], end - begin);
+//       },
+//       [](uint64_t a, uint64_t b) { return a + b; });
+//
+// Each thread accumulates its own partial result, so |reduce| is only called
+// about once per chunk, without any synchronization.
+template <typename T, typename Map, typename Reduce>
+T ParallelReduce(ThreadPool* pool,
+                 size_t begin,
+                 size_t end,
+                 size_t grain,
+                 T identity,
+                 Map map,
+                 Reduce reduce) {
+  std::vector<T> partials(
+      internal::ParallelForParticipantCount(pool, begin, end, grain), identity);
+  internal::RunParallelFor(
+      pool, begin, end, grain,
+      [&partials, &map, &reduce](size_t participant, size_t chunk_begin,
+                                 size_t chunk_end) {
+        partials[participant] = reduce(std::move(partials[participant]),
+                                       map(chunk_begin, chunk_end));
+      });
+  T result = std::move(partials[0]);
+  for (size_t i = 1u; i < partials.size(); i++)
+    result = reduce(std::move(result), std::move(partials[i]));
+  return result;
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_PARALLEL_FOR_H_
@@ -0,0 +1,133 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/parallel_for.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+
+namespace ftl {
+namespace {
+
+class ParallelForTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = MakeRefCounted<ThreadPool>(4);
+    ASSERT_TRUE(pool_->Start());
+  }
+
+  void TearDown() override { pool_->Shutdown(); }
+
+  RefPtr<ThreadPool> pool_;
+};
+
+TEST_F(ParallelForTest, RunsEachIndexOnce) {
+  constexpr size_t kSize = 10007u;
+  std::unique_ptr<std::atomic<int>[]> counts(new std::atomic<int>[kSize]);
+  for (size_t i = 0u; i < kSize; i++)
+    counts[i].store(0);
+  std::atomic<size_t> min_chunk_size(kSize);
+
+  ParallelFor(pool_.get(), 0u, kSize, 16u, [&](size_t begin, size_t end) {
+    EXPECT_LT(begin, end);
+    // Only the last chunk may be smaller than the grain.
+    if (end != kSize) {
+      size_t size = end - begin;
+      size_t current = min_chunk_size.load();
+      while (size < current && !min_chunk_size.compare_exchange_weak(current,
+                                                                     size)) {
+      }
+    }
+    for (size_t i = begin; i < end; i++)
+      counts[i].fetch_add(1);
+  });
+
+  for (size_t i = 0u; i < kSize; i++)
+    EXPECT_EQ(1, counts[i].load()) << i;
+  EXPECT_GE(min_chunk_size.load(), 16u);
+}
+
+TEST_F(ParallelForTest, EmptyAndSmallRanges) {
+  int call_count = 0;
+  ParallelFor(pool_.get(), 5u, 5u, 1u,
+              [&call_count](size_t begin, size_t end) { call_count++; });
+  EXPECT_EQ(0, call_count);
+
+  // A range which fits in one grain runs on the calling thread.
+  bool on_worker = true;
+  ParallelFor(pool_.get(), 0u, 10u, 100u, [&](size_t begin, size_t end) {
+    call_count++;
+    EXPECT_EQ(0u, begin);
+    EXPECT_EQ(10u, end);
+    on_worker = pool_->RunsTasksOnCurrentThread();
+  });
+  EXPECT_EQ(1, call_count);
+  EXPECT_FALSE(on_worker);
+}
+
+TEST_F(ParallelForTest, NestedOnWorker) {
+  AutoResetWaitableEvent done;
+  std::atomic<int> count(0);
+  pool_->PostTask([this, &count, &done] {
+    ParallelFor(pool_.get(), 0u, 64u, 1u, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        ParallelFor(pool_.get(), 0u, 64u, 1u,
+                    [&count](size_t inner_begin, size_t inner_end) {
+                      count.fetch_add(static_cast<int>(inner_end -
+                                                       inner_begin));
+                    });
+      }
+    });
+    done.Signal();
+  });
+  done.Wait();
+  EXPECT_EQ(64 * 64, count.load());
+}
+
+TEST_F(ParallelForTest, AfterShutdown) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  ASSERT_TRUE(pool->Start());
+  pool->Shutdown();
+  // The calling thread runs everything.
+  int count = 0;
+  ParallelFor(pool.get(), 0u, 100u, 1u,
+              [&count](size_t begin, size_t end) {
+                count += static_cast<int>(end - begin);
+              });
+  EXPECT_EQ(100, count);
+}
+
+TEST_F(ParallelForTest, ParallelReduce) {
+  std::vector<uint32_t> data(100000u);
+  for (size_t i = 0u; i < data.size(); i++)
+    data[i] = static_cast<uint32_t>(i);
+
+  uint64_t sum = ParallelReduce(
+      pool_.get(), 0u, data.size(), 1000u, uint64_t(0),
+      [&data](size_t begin, size_t end) {
+        uint64_t chunk_sum = 0u;
+        for (size_t i = begin; i < end; i++)
+          chunk_sum += data[i];
+        return chunk_sum;
+      },
+      [](uint64_t a, uint64_t b) { return a + b; });
+  EXPECT_EQ(uint64_t(99999) * 100000 / 2, sum);
+
+  // An empty range gives the identity.
+  std::string joined = ParallelReduce(
+      pool_.get(), 0u, 0u, 1u, std::string("identity"),
+      [](size_t begin, size_t end) { return std::string("chunk"); },
+      [](std::string a, std::string b) { return a + b; });
+  EXPECT_EQ("identity", joined);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,286 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Sorting and merging on a |ThreadPool| (see parallel_for.h).
+
+#ifndef LIB_FTL_TASKS_PARALLEL_SORT_H_
+#define LIB_FTL_TASKS_PARALLEL_SORT_H_
+
+#include <stddef.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/tasks/parallel_for.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace ftl {
+namespace internal {
+
+// Ranges smaller than this are sorted or merged on the calling thread.
+constexpr size_t kParallelSortGrain = 16384u;
+
+// Assigns (or, if |Move| is |std::true_type|, moves) |*from| to |*to|.
+template <typename Iterator, typename OutputIterator>
+void Transfer(Iterator from, OutputIterator to, std::false_type) {
+  *to = *from;
+}
+template <typename Iterator, typename OutputIterator>
+void Transfer(Iterator from, OutputIterator to, std::true_type) {
+  *to = std::move(*from);
+}
+
+// Merges |runs| (which are modified) into |out|, on the calling thread: like
+// |std::merge()|, for any number of runs, taking equal elements from earlier
+// runs first.
+template <typename Iterator,
+          typename OutputIterator,
+          typename Compare,
+          typename Move>
+void MergeRuns(std::vector<std::pair<Iterator, Iterator>>* runs,
+               OutputIterator out,
+               Compare& cmp,
+               Move move) {
+  auto& r = *runs;
+  r.erase(std::remove_if(r.begin(), r.end(),
+                         [](const std::pair<Iterator, Iterator>& run) {
+                           return run.first == run.second;
+                         }),
+          r.end());
+  if (r.size() == 2u) {
+    Iterator a = r[0].first;
+    Iterator b = r[1].first;
+    for (; a != r[0].second && b != r[1].second; ++out) {
+      if (cmp(*b, *a))
+        Transfer(b++, out, move);
+      else
+        Transfer(a++, out, move);
+    }
+    r[0].first = a;
+    r[1].first = b;
+  } else if (r.size() > 2u) {
+    // A heap of the runs' indices, whose top is the run with the next
+    // element, until one run is left.
+    std::vector<size_t> heap(r.size());
+    for (size_t i = 0u; i < heap.size(); i++)
+      heap[i] = i;
+    auto after = [&r, &cmp](size_t a, size_t b) {
+      if (cmp(*r[b].first, *r[a].first))
+        return true;
+      return !cmp(*r[a].first, *r[b].first) && a > b;
+    };
+    std::make_heap(heap.begin(), heap.end(), after);
+    while (heap.size() > 1u) {
+      std::pop_heap(heap.begin(), heap.end(), after);
+      auto& run = r[heap.back()];
+      Transfer(run.first, out, move);
+      ++out;
+      if (++run.first == run.second)
+        heap.pop_back();
+      else
+        std::push_heap(heap.begin(), heap.end(), after);
+    }
+  }
+  // The rest of the last run.
+  for (auto& run : r) {
+    for (; run.first != run.second; ++run.first, ++out)
+      Transfer(run.first, out, move);
+  }
+}
+
+// Returns where the first |rank| elements of the merge of |runs| end in each
+// run, given that they're the elements before |splitter|, plus as many of
+// those equal to it as are needed (taken from earlier runs first).
+template <typename Iterator, typename T, typename Compare>
+std::vector<Iterator> SplitRuns(
+    const std::vector<std::pair<Iterator, Iterator>>& runs,
+    const T& splitter,
+    size_t rank,
+    Compare& cmp) {
+  std::vector<Iterator> lower(runs.size());
+  std::vector<Iterator> upper(runs.size());
+  size_t lower_rank = 0u;
+  for (size_t i = 0u; i < runs.size(); i++) {
+    lower[i] = std::lower_bound(runs[i].first, runs[i].second, splitter, cmp);
+    upper[i] = std::upper_bound(lower[i], runs[i].second, splitter, cmp);
+    lower_rank += static_cast<size_t>(lower[i] - runs[i].first);
+  }
+  size_t ties = rank > lower_rank ? rank - lower_rank : 0u;
+  for (size_t i = 0u; i < runs.size() && ties > 0u; i++) {
+    size_t taken = std::min(ties, static_cast<size_t>(upper[i] - lower[i]));
+    lower[i] += taken;
+    ties -= taken;
+  }
+  return lower;
+}
+
+// |ParallelMerge()|, moving the elements if |Move| is |std::true_type|.
+template <typename Iterator,
+          typename OutputIterator,
+          typename Compare,
+          typename Move>
+void ParallelMergeRuns(ThreadPool* pool,
+                       const std::vector<std::pair<Iterator, Iterator>>& runs,
+                       OutputIterator out,
+                       Compare& cmp,
+                       Move move) {
+  using Runs = std::vector<std::pair<Iterator, Iterator>>;
+  size_t size = 0u;
+  for (const auto& run : runs) {
+    FTL_DCHECK(run.first <= run.second);
+    size += static_cast<size_t>(run.second - run.first);
+  }
+  const size_t participant_count =
+      ParallelForParticipantCount(pool, 0u, size, kParallelSortGrain);
+  if (participant_count == 1u) {
+    Runs remaining = runs;
+    MergeRuns(&remaining, out, cmp, move);
+    return;
+  }
+
+  // Sample the runs (in proportion to their sizes), for the splitters.
+  const size_t piece_count = 4u * participant_count;
+  const size_t sample_count = 8u * piece_count;
+  std::vector<Iterator> samples;
+  samples.reserve(sample_count + runs.size());
+  for (const auto& run : runs) {
+    const size_t run_size = static_cast<size_t>(run.second - run.first);
+    const size_t run_samples = (run_size * sample_count + size - 1u) / size;
+    for (size_t i = 0u; i < run_samples; i++)
+      samples.push_back(run.first + i * run_size / run_samples);
+  }
+  std::sort(samples.begin(), samples.end(),
+            [&cmp](Iterator a, Iterator b) { return cmp(*a, *b); });
+
+  // Where each piece starts in each run (and, at the end, where they end).
+  std::vector<std::vector<Iterator>> starts(piece_count + 1u);
+  for (const auto& run : runs) {
+    starts.front().push_back(run.first);
+    starts.back().push_back(run.second);
+  }
+  ParallelFor(
+      pool, 1u, piece_count, 1u,
+      [&runs, &samples, &starts, &cmp, size, piece_count](size_t begin,
+                                                          size_t end) {
+        for (size_t piece = begin; piece < end; piece++) {
+          starts[piece] = SplitRuns(
+              runs, *samples[piece * samples.size() / piece_count],
+              piece * size / piece_count, cmp);
+        }
+      });
+
+  ParallelFor(pool, 0u, piece_count, 1u, [&runs, &starts, &cmp, out, move](
+                                             size_t begin, size_t end) {
+    for (size_t piece = begin; piece < end; piece++) {
+      Runs piece_runs(runs.size());
+      size_t offset = 0u;
+      for (size_t i = 0u; i < runs.size(); i++) {
+        piece_runs[i] = {starts[piece][i], starts[piece + 1u][i]};
+        offset += static_cast<size_t>(starts[piece][i] - runs[i].first);
+      }
+      MergeRuns(&piece_runs, out + offset, cmp, move);
+    }
+  });
+}
+
+}  // namespace internal
+
+// Merges the sorted |runs| (pairs of random-access iterators) into |out| (a
+// random-access iterator, with room for all of them), concurrently on |pool|'s
+// workers and the calling thread, e.g., to merge the sorted inputs of a
+// compaction:
+//
+//   std::vector<std::pair<Record*, Record*>> runs;
+//   for (auto& input : inputs)
+//     runs.emplace_back(input.data(), input.data() + input.size());
+//   ParallelMerge(pool.get(), runs, output.data(), CompareKeys);
+//
+// This is stable: equal elements are taken from earlier runs first.
+//
+// The output is split into pieces (a few per thread) by splitters sampled
+// from the runs, each of which is a sequential merge of the runs' elements
+// between two splitters, found by binary search. Equal elements are shared out
+// between pieces, so many duplicates don't unbalance them.
+template <typename Iterator,
+          typename OutputIterator,
+          typename Compare = std::less<>>
+void ParallelMerge(ThreadPool* pool,
+                   const std::vector<std::pair<Iterator, Iterator>>& runs,
+                   OutputIterator out,
+                   Compare cmp = Compare()) {
+  internal::ParallelMergeRuns(pool, runs, out, cmp, std::false_type());
+}
+
+// Sorts [|begin|, |end|) (random-access iterators) like |std::sort()|,
+// concurrently on |pool|'s workers and the calling thread:
+//
+//   ParallelSort(pool.get(), records.begin(), records.end(),
+//                [](const Record& a, const Record& b) {
+//                  return a.key < b.key;
+//                });
+//
+// The range is split into a chunk per thread, each of which is moved to a
+// temporary buffer and sorted there (with |std::sort()|), and then the chunks
+// are merged back into the range with |ParallelMerge()|. So this moves each
+// element twice, and uses as much memory again as the range. Like
+// |std::sort()|, it isn't stable. Small ranges are just sorted on the calling
+// thread.
+template <typename RandomAccessIterator, typename Compare = std::less<>>
+void ParallelSort(ThreadPool* pool,
+                  RandomAccessIterator begin,
+                  RandomAccessIterator end,
+                  Compare cmp = Compare()) {
+  using T = typename std::iterator_traits<RandomAccessIterator>::value_type;
+  const size_t size = static_cast<size_t>(end - begin);
+  const size_t chunk_count = internal::ParallelForParticipantCount(
+      pool, 0u, size, internal::kParallelSortGrain);
+  if (chunk_count == 1u) {
+    std::sort(begin, end, cmp);
+    return;
+  }
+
+  // (Uninitialized, so that the chunks can be moved into it concurrently.)
+  std::unique_ptr<void, void (*)(void*)> storage(
+      ::operator new(size * sizeof(T)), [](void* p) { ::operator delete(p); });
+  T* const buffer = static_cast<T*>(storage.get());
+  auto chunk_begin = [size, chunk_count](size_t chunk) {
+    return chunk * size / chunk_count;
+  };
+  ParallelFor(pool, 0u, chunk_count, 1u, [&](size_t first, size_t last) {
+    for (size_t chunk = first; chunk < last; chunk++) {
+      const size_t from = chunk_begin(chunk);
+      const size_t to = chunk_begin(chunk + 1u);
+      std::uninitialized_copy(std::make_move_iterator(begin + from),
+                              std::make_move_iterator(begin + to),
+                              buffer + from);
+      std::sort(buffer + from, buffer + to, cmp);
+    }
+  });
+
+  std::vector<std::pair<T*, T*>> runs;
+  for (size_t chunk = 0u; chunk < chunk_count; chunk++) {
+    runs.emplace_back(buffer + chunk_begin(chunk),
+                      buffer + chunk_begin(chunk + 1u));
+  }
+  internal::ParallelMergeRuns(pool, runs, begin, cmp, std::true_type());
+
+  if (!std::is_trivially_destructible<T>::value) {
+    ParallelFor(pool, 0u, size, internal::kParallelSortGrain,
+                [buffer](size_t first, size_t last) {
+                  for (size_t i = first; i < last; i++)
+                    buffer[i].~T();
+                });
+  }
+}
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_PARALLEL_SORT_H_
@@ -0,0 +1,134 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/parallel_sort.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+
+namespace ftl {
+namespace {
+
+class ParallelSortTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = MakeRefCounted<ThreadPool>(4);
+    ASSERT_TRUE(pool_->Start());
+  }
+
+  void TearDown() override { pool_->Shutdown(); }
+
+  RefPtr<ThreadPool> pool_;
+};
+
+std::vector<uint32_t> RandomNumbers(size_t count, uint32_t max) {
+  std::mt19937 random(static_cast<uint32_t>(count));
+  std::uniform_int_distribution<uint32_t> distribution(0u, max);
+  std::vector<uint32_t> numbers(count);
+  for (auto& number : numbers)
+    number = distribution(random);
+  return numbers;
+}
+
+TEST_F(ParallelSortTest, Sort) {
+  for (size_t size : {0u, 1u, 1000u, 100000u, 1000003u}) {
+    std::vector<uint32_t> numbers = RandomNumbers(size, 0xffffffffu);
+    std::vector<uint32_t> expected = numbers;
+    std::sort(expected.begin(), expected.end());
+    ParallelSort(pool_.get(), numbers.begin(), numbers.end());
+    EXPECT_EQ(expected, numbers) << size;
+  }
+}
+
+TEST_F(ParallelSortTest, SortDuplicatesAndComparator) {
+  // Few distinct values, in descending order.
+  std::vector<uint32_t> numbers = RandomNumbers(200000u, 3u);
+  ParallelSort(pool_.get(), numbers.begin(), numbers.end(),
+               [](uint32_t a, uint32_t b) { return a > b; });
+  EXPECT_TRUE(std::is_sorted(numbers.begin(), numbers.end(),
+                             [](uint32_t a, uint32_t b) { return a > b; }));
+  EXPECT_EQ(3u, numbers.front());
+  EXPECT_EQ(0u, numbers.back());
+
+  // All equal.
+  std::vector<uint32_t> same(100000u, 7u);
+  ParallelSort(pool_.get(), same.begin(), same.end());
+  EXPECT_EQ(std::vector<uint32_t>(100000u, 7u), same);
+}
+
+TEST_F(ParallelSortTest, SortMoveOnly) {
+  constexpr size_t kSize = 100000u;
+  std::vector<std::unique_ptr<std::string>> strings;
+  for (uint32_t number : RandomNumbers(kSize, 1000000u))
+    strings.emplace_back(new std::string(std::to_string(number)));
+  ParallelSort(pool_.get(), strings.begin(), strings.end(),
+               [](const std::unique_ptr<std::string>& a,
+                  const std::unique_ptr<std::string>& b) { return *a < *b; });
+  ASSERT_EQ(kSize, strings.size());
+  for (size_t i = 0u; i < kSize; i++) {
+    ASSERT_TRUE(strings[i]);
+    if (i > 0u) {
+      EXPECT_LE(*strings[i - 1u], *strings[i]);
+    }
+  }
+}
+
+TEST_F(ParallelSortTest, SortOnWorker) {
+  std::vector<uint32_t> numbers = RandomNumbers(100000u, 0xffffffffu);
+  AutoResetWaitableEvent done;
+  pool_->PostTask([this, &numbers, &done] {
+    ParallelSort(pool_.get(), numbers.begin(), numbers.end());
+    done.Signal();
+  });
+  done.Wait();
+  EXPECT_TRUE(std::is_sorted(numbers.begin(), numbers.end()));
+}
+
+TEST_F(ParallelSortTest, Merge) {
+  // Runs of different sizes (including empty ones), of (key, run) pairs, so
+  // that stability can be checked.
+  using Pair = std::pair<uint32_t, size_t>;
+  const size_t kSizes[] = {50000u, 0u, 1u, 120000u, 30000u};
+  std::vector<std::vector<Pair>> inputs;
+  std::vector<Pair> expected;
+  for (size_t size : kSizes) {
+    inputs.emplace_back();
+    for (uint32_t key : RandomNumbers(size, 1000u))
+      inputs.back().emplace_back(key, inputs.size() - 1u);
+    std::sort(inputs.back().begin(), inputs.back().end());
+    expected.insert(expected.end(), inputs.back().begin(),
+                    inputs.back().end());
+  }
+  std::sort(expected.begin(), expected.end());
+
+  std::vector<std::pair<const Pair*, const Pair*>> runs;
+  for (const auto& input : inputs)
+    runs.emplace_back(input.data(), input.data() + input.size());
+  std::vector<Pair> merged(expected.size());
+  ParallelMerge(pool_.get(), runs, merged.begin(),
+                [](const Pair& a, const Pair& b) { return a.first < b.first; });
+  EXPECT_EQ(expected, merged);
+
+  // Two runs, and one.
+  runs.resize(1u);
+  merged.assign(kSizes[0], Pair());
+  ParallelMerge(pool_.get(), runs, merged.begin());
+  EXPECT_EQ(inputs[0], merged);
+  runs.emplace_back(inputs[3].data(), inputs[3].data() + inputs[3].size());
+  merged.assign(kSizes[0] + kSizes[3], Pair());
+  ParallelMerge(pool_.get(), runs, merged.begin());
+  EXPECT_TRUE(std::is_sorted(merged.begin(), merged.end()));
+}
+
+}  // namespace
+}  // namespace ftl
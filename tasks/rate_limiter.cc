@@ -0,0 +1,84 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/rate_limiter.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+int64_t ToNanoseconds(TimePoint time) {
+  return time.ToEpochDelta().ToNanoseconds();
+}
+
+}  // namespace
+
+RateLimiter::RateLimiter(double tokens_per_second, int64_t burst)
+    : interval_(std::max<int64_t>(llround(1e9 / tokens_per_second), 1)),
+      burst_(burst),
+      fill_time_(interval_ * burst_),
+      empty_time_(ToNanoseconds(TimePoint::NowCoarse()) - fill_time_) {
+  FTL_DCHECK(tokens_per_second > 0.0);
+  FTL_DCHECK(burst_ > 0);
+}
+
+RateLimiter::~RateLimiter() {}
+
+bool RateLimiter::TryAcquire(int64_t count, TimePoint now) {
+  FTL_DCHECK(count >= 0 && count <= burst_);
+  const int64_t now_ns = ToNanoseconds(now);
+  int64_t empty_time = empty_time_.load(std::memory_order_relaxed);
+  for (;;) {
+    const int64_t new_empty_time = EmptyTimeAfter(empty_time, count, now_ns);
+    // (Otherwise taking the tokens would put the bucket in debt.)
+    if (new_empty_time > now_ns)
+      return false;
+    if (empty_time_.compare_exchange_weak(empty_time, new_empty_time,
+                                          std::memory_order_relaxed))
+      return true;
+  }
+}
+
+void RateLimiter::Acquire(TaskRunner* task_runner,
+                          int64_t count,
+                          UniqueClosure callback) {
+  FTL_DCHECK(task_runner);
+  FTL_DCHECK(count >= 0 && count <= burst_);
+  const int64_t now_ns = ToNanoseconds(task_runner->Now());
+  int64_t empty_time = empty_time_.load(std::memory_order_relaxed);
+  int64_t new_empty_time;
+  do {
+    new_empty_time = EmptyTimeAfter(empty_time, count, now_ns);
+  } while (!empty_time_.compare_exchange_weak(empty_time, new_empty_time,
+                                              std::memory_order_relaxed));
+  // The tokens are there once the bucket is empty (rather than in debt).
+  if (new_empty_time <= now_ns) {
+    task_runner->PostTask(std::move(callback));
+  } else {
+    task_runner->PostTaskForTime(
+        std::move(callback),
+        TimePoint::FromEpochDelta(TimeDelta::FromNanoseconds(new_empty_time)));
+  }
+}
+
+int64_t RateLimiter::available(TimePoint now) const {
+  const int64_t elapsed =
+      ToNanoseconds(now) - empty_time_.load(std::memory_order_relaxed);
+  return elapsed <= 0 ? 0 : std::min(elapsed / interval_, burst_);
+}
+
+int64_t RateLimiter::EmptyTimeAfter(int64_t empty_time,
+                                    int64_t count,
+                                    int64_t now) const {
+  // The bucket can't fill beyond |burst_| tokens.
+  return std::max(empty_time, now - fill_time_) + count * interval_;
+}
+
+}  // namespace ftl
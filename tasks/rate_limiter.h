@@ -0,0 +1,83 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_RATE_LIMITER_H_
+#define LIB_FTL_TASKS_RATE_LIMITER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A token bucket: tokens are added at |tokens_per_second|, up to |burst| of
+// them, and taken to admit work, e.g., to limit the rate of requests:
+//
+//   RateLimiter limiter(1000.0, 100);  // 1000 a second, or 100 at once.
+//   ...
+//   if (!limiter.TryAcquire())
+//     return Status::kResourceExhausted;
+//
+// This is thread-safe, and lock-free: the bucket is a single atomic time (when
+// it would be empty, in the manner of the "generic cell rate algorithm"), which
+// accounts for both the tokens and when they were last added, so taking tokens
+// is one compare-and-swap of it (and failing to is just a load). It starts
+// full.
+class FTL_EXPORT RateLimiter final {
+ public:
+  RateLimiter(double tokens_per_second, int64_t burst);
+  ~RateLimiter();
+
+  int64_t burst() const { return burst_; }
+
+  // The interval at which tokens are added.
+  TimeDelta interval() const { return TimeDelta::FromNanoseconds(interval_); }
+
+  // Takes |count| tokens (at most |burst()|) and returns true if there are that
+  // many; otherwise returns false (taking none). This reads the time with
+  // |TimePoint::NowCoarse()|, or uses |now|.
+  bool TryAcquire(int64_t count = 1) {
+    return TryAcquire(count, TimePoint::NowCoarse());
+  }
+  bool TryAcquire(int64_t count, TimePoint now);
+
+  // Takes |count| tokens (at most |burst()|), and posts |callback| to
+  // |task_runner| for when they're available (by the task runner's clock),
+  // which may be now. The tokens are taken immediately, so, while |callback|
+  // waits, later callers wait behind it (and |TryAcquire()| fails).
+  void Acquire(TaskRunner* task_runner, int64_t count, UniqueClosure callback);
+
+  // Returns the number of tokens available at |now| (which may be stale as
+  // soon as it's returned, if other threads are taking tokens).
+  int64_t available(TimePoint now = TimePoint::NowCoarse()) const;
+
+ private:
+  // Returns when the bucket would be empty after taking |count| tokens at
+  // |now|, given that it would otherwise be empty at |empty_time|.
+  int64_t EmptyTimeAfter(int64_t empty_time,
+                         int64_t count,
+                         int64_t now) const;
+
+  // Nanoseconds per token.
+  const int64_t interval_;
+  const int64_t burst_;
+  // |interval_| * |burst_|: how long the bucket takes to fill.
+  const int64_t fill_time_;
+  // When the bucket would be (or would have been) empty, if no more tokens
+  // were taken, in nanoseconds since |TimePoint|'s epoch.
+  std::atomic<int64_t> empty_time_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RateLimiter);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_RATE_LIMITER_H_
@@ -0,0 +1,96 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/rate_limiter.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/test/test_task_runner.h"
+
+namespace ftl {
+namespace {
+
+constexpr TimeDelta kInterval = TimeDelta::FromMilliseconds(10);
+
+TEST(RateLimiterTest, TryAcquire) {
+  RateLimiter limiter(100.0, 5);
+  EXPECT_EQ(kInterval, limiter.interval());
+  EXPECT_EQ(5, limiter.burst());
+
+  // It starts full.
+  const TimePoint start = TimePoint::NowCoarse();
+  EXPECT_EQ(5, limiter.available(start));
+  EXPECT_TRUE(limiter.TryAcquire(3, start));
+  EXPECT_FALSE(limiter.TryAcquire(3, start));
+  EXPECT_TRUE(limiter.TryAcquire(2, start));
+  EXPECT_FALSE(limiter.TryAcquire(1, start));
+  EXPECT_EQ(0, limiter.available(start));
+  EXPECT_TRUE(limiter.TryAcquire(0, start));
+
+  // Tokens are added every interval.
+  EXPECT_FALSE(limiter.TryAcquire(1, start + kInterval / 2));
+  EXPECT_TRUE(limiter.TryAcquire(1, start + kInterval));
+  EXPECT_FALSE(limiter.TryAcquire(1, start + kInterval));
+  EXPECT_EQ(2, limiter.available(start + kInterval * 3));
+
+  // But only up to |burst|.
+  const TimePoint later = start + TimeDelta::FromSeconds(10);
+  EXPECT_EQ(5, limiter.available(later));
+  EXPECT_TRUE(limiter.TryAcquire(5, later));
+  EXPECT_FALSE(limiter.TryAcquire(1, later));
+}
+
+TEST(RateLimiterTest, Acquire) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  RateLimiter limiter(100.0, 2);
+  // (Use up the tokens it starts with, whatever the clocks say.)
+  EXPECT_TRUE(limiter.TryAcquire(2, task_runner->Now()));
+
+  std::vector<int> acquired;
+  for (int i = 0; i < 3; i++)
+    limiter.Acquire(task_runner.get(), 1, [&acquired, i] {
+      acquired.push_back(i);
+    });
+  EXPECT_FALSE(limiter.TryAcquire(1, task_runner->Now() + kInterval));
+
+  task_runner->AdvanceTimeBy(kInterval - TimeDelta::FromMilliseconds(1));
+  EXPECT_TRUE(acquired.empty());
+  task_runner->AdvanceTimeBy(TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(std::vector<int>({0}), acquired);
+  task_runner->AdvanceTimeBy(kInterval * 2);
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), acquired);
+
+  // With tokens available, the callback is posted to run now.
+  task_runner->AdvanceTimeBy(kInterval * 2);
+  limiter.Acquire(task_runner.get(), 2, [&acquired] { acquired.push_back(3); });
+  EXPECT_EQ(1u, task_runner->RunUntilIdle());
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), acquired);
+}
+
+TEST(RateLimiterTest, Concurrent) {
+  constexpr int kThreads = 4;
+  constexpr int kAttempts = 10000;
+  // (A rate slow enough that no tokens are added during the test.)
+  RateLimiter limiter(1e-3, 1000);
+  const TimePoint now = TimePoint::NowCoarse();
+  std::atomic<int> acquired(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&limiter, &acquired, now] {
+      for (int i = 0; i < kAttempts; i++) {
+        if (limiter.TryAcquire(1, now))
+          acquired.fetch_add(1, std::memory_order_relaxed);
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(1000, acquired.load());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,113 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/repeating_timer.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+// Rounds |time| up to a multiple of |slack| (if positive).
+TimePoint ApplySlack(TimePoint time, TimeDelta slack) {
+  if (slack <= TimeDelta::Zero())
+    return time;
+  TimeDelta remainder = time.ToEpochDelta() % slack;
+  if (remainder < TimeDelta::Zero())
+    remainder = remainder + slack;
+  if (remainder == TimeDelta::Zero())
+    return time;
+  return time + (slack - remainder);
+}
+
+}  // namespace
+
+RepeatingTimer::RepeatingTimer()
+    : wheel_timer_([this] { RunTask(); }), weak_ptr_factory_(this) {}
+
+RepeatingTimer::~RepeatingTimer() {
+  Stop();
+  if (destroyed_flag_)
+    *destroyed_flag_ = true;
+}
+
+void RepeatingTimer::Start(TaskRunner* task_runner,
+                           UniqueClosure task,
+                           TimeDelta interval,
+                           TimeDelta slack) {
+  FTL_DCHECK(task_runner);
+  FTL_DCHECK(task);
+  FTL_DCHECK(interval > TimeDelta::Zero());
+  FTL_DCHECK(slack >= TimeDelta::Zero());
+
+  Stop();
+  task_runner_ = task_runner;
+  task_ = std::move(task);
+  started_ = true;
+  interval_ = interval;
+  slack_ = slack;
+  next_tick_time_ = task_runner->Now() + interval;
+  ScheduleTick();
+}
+
+void RepeatingTimer::Stop() {
+  if (started_) {
+    started_ = false;
+    generation_++;
+    task_runner_ = nullptr;
+    task_ = nullptr;
+    wheel_timer_.Cancel();
+    weak_ptr_factory_.InvalidateWeakPtrs();
+  }
+}
+
+void RepeatingTimer::ScheduleTick() {
+  TimePoint target_time = ApplySlack(next_tick_time_, slack_);
+  TimerWheel* timer_wheel = task_runner_->RunsTasksOnCurrentThread()
+                                ? task_runner_->GetTimerWheel()
+                                : nullptr;
+  if (timer_wheel) {
+    timer_wheel->Schedule(&wheel_timer_, target_time);
+    return;
+  }
+
+  auto weak_ptr = weak_ptr_factory_.GetWeakPtr();
+  task_runner_->PostTaskForTime(
+      [weak_ptr] {
+        if (weak_ptr)
+          weak_ptr->RunTask();
+      },
+      target_time);
+}
+
+void RepeatingTimer::RunTask() {
+  if (!started_)
+    return;
+
+  // Schedule the next tick first, from the ideal time of this one, skipping
+  // any that have already been missed.
+  TimePoint now = task_runner_->Now();
+  next_tick_time_ = next_tick_time_ + interval_;
+  if (next_tick_time_ <= now)
+    next_tick_time_ =
+        next_tick_time_ + interval_ * ((now - next_tick_time_) / interval_ + 1);
+  ScheduleTick();
+
+  // Run the task from a local, since it may stop or restart the timer (which
+  // replaces |task_|) or destroy it.
+  uint64_t generation = generation_;
+  UniqueClosure task = std::move(task_);
+  bool destroyed = false;
+  destroyed_flag_ = &destroyed;
+  task();
+  if (destroyed)
+    return;
+  destroyed_flag_ = nullptr;
+  if (generation == generation_)
+    task_ = std::move(task);
+}
+
+}  // namespace ftl
@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_REPEATING_TIMER_H_
+#define LIB_FTL_TASKS_REPEATING_TIMER_H_
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/weak_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/tasks/timer_wheel.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Posts tasks to a |TaskRunner| to run repeatedly at a fixed interval.
+// It may only be used on the same thread as the task runner.
+//
+// Each tick is scheduled relative to the ideal time of the previous one (the
+// start time plus a whole number of intervals) rather than to when it actually
+// ran, so the timer doesn't drift. If the task runner falls behind by more than
+// an interval, the missed ticks are skipped rather than run back to back.
+class FTL_EXPORT RepeatingTimer {
+ public:
+  RepeatingTimer();
+  ~RepeatingTimer();
+
+  // Returns true if the timer was started and has not been stopped.
+  bool is_started() const { return started_; }
+
+  // Posts |task| to |task_runner| to run every |interval| (starting |interval|
+  // from now) until the timer is stopped. |task| may stop, restart or destroy
+  // the timer.
+  //
+  // Each tick may be delayed by up to |slack|: its target time is rounded up to
+  // a multiple of |slack| (measured from the |TimePoint| epoch), so that timers
+  // with nearby deadlines on the same task runner wake it up once, together.
+  //
+  // Like |OneShotTimer|, this uses the task runner's |TimerWheel| if it has
+  // one.
+  void Start(TaskRunner* task_runner,
+             UniqueClosure task,
+             TimeDelta interval,
+             TimeDelta slack = TimeDelta::Zero());
+
+  // Stops the timer.
+  // Does nothing if not started.
+  void Stop();
+
+ private:
+  // Schedules the tick at |next_tick_time_| (rounded up per |slack_|).
+  void ScheduleTick();
+  void RunTask();
+
+  TaskRunner* task_runner_ = nullptr;
+  UniqueClosure task_;
+  bool started_ = false;
+  TimeDelta interval_;
+  TimeDelta slack_;
+  // The ideal time of the next tick.
+  TimePoint next_tick_time_;
+  // Incremented by |Start()| and |Stop()|, to detect them being called by the
+  // task.
+  uint64_t generation_ = 0u;
+  // While the task is running, points to a flag set by the destructor.
+  bool* destroyed_flag_ = nullptr;
+  TimerWheel::Timer wheel_timer_;
+  WeakPtrFactory<RepeatingTimer> weak_ptr_factory_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RepeatingTimer);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_REPEATING_TIMER_H_
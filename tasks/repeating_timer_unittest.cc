@@ -0,0 +1,145 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/repeating_timer.h"
+
+#include <queue>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/message_loop.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+#include "lib/ftl/time/stopwatch.h"
+
+namespace ftl {
+namespace {
+
+class FakeTaskRunner : public TaskRunner {
+ public:
+  bool has_tasks() const { return !tasks_.empty(); }
+  TimePoint last_target_time() const { return last_target_time_; }
+
+  void PostTask(UniqueClosure task) override {}
+
+  void PostTaskForTime(UniqueClosure task, TimePoint target_time) override {
+    tasks_.push(std::move(task));
+    last_target_time_ = target_time;
+  }
+
+  void PostDelayedTask(UniqueClosure task, TimeDelta delay) override {}
+
+  bool RunsTasksOnCurrentThread() override { return true; }
+
+  void RunOneTask() {
+    ASSERT_TRUE(has_tasks());
+    UniqueClosure task = std::move(tasks_.front());
+    tasks_.pop();
+    task();
+  }
+
+ private:
+  std::queue<UniqueClosure> tasks_;
+  TimePoint last_target_time_;
+};
+
+TEST(RepeatingTimerTest, Basic) {
+  auto task_runner = MakeRefCounted<FakeTaskRunner>();
+  RepeatingTimer timer;
+  int run_count = 0;
+
+  EXPECT_FALSE(timer.is_started());
+  TimePoint start_time = TimePoint::Now();
+  timer.Start(task_runner.get(), [&run_count] { run_count++; },
+              TimeDelta::FromMilliseconds(10));
+  EXPECT_TRUE(timer.is_started());
+  TimePoint first_target_time = task_runner->last_target_time();
+  EXPECT_GE(first_target_time, start_time + TimeDelta::FromMilliseconds(10));
+
+  // Ticks are scheduled from the previous target time rather than from when
+  // they ran, so they don't drift.
+  for (int i = 1; i <= 3; i++) {
+    task_runner->RunOneTask();
+    EXPECT_EQ(i, run_count);
+    EXPECT_TRUE(timer.is_started());
+    EXPECT_EQ(first_target_time + TimeDelta::FromMilliseconds(10) * i,
+              task_runner->last_target_time());
+  }
+
+  timer.Stop();
+  EXPECT_FALSE(timer.is_started());
+  task_runner->RunOneTask();
+  EXPECT_EQ(3, run_count);
+  EXPECT_FALSE(task_runner->has_tasks());
+}
+
+TEST(RepeatingTimerTest, Slack) {
+  auto task_runner = MakeRefCounted<FakeTaskRunner>();
+  const TimeDelta kSlack = TimeDelta::FromMilliseconds(8);
+  RepeatingTimer timer;
+
+  TimePoint start_time = TimePoint::Now();
+  timer.Start(task_runner.get(), [] {}, TimeDelta::FromMilliseconds(25),
+              kSlack);
+  for (int i = 1; i <= 3; i++) {
+    TimePoint ideal_time = start_time + TimeDelta::FromMilliseconds(25) * i;
+    TimePoint target_time = task_runner->last_target_time();
+    EXPECT_EQ(TimeDelta::Zero(), target_time.ToEpochDelta() % kSlack);
+    EXPECT_GE(target_time, ideal_time);
+    EXPECT_LT(target_time - ideal_time,
+              kSlack + TimeDelta::FromMilliseconds(1));
+    task_runner->RunOneTask();
+  }
+}
+
+TEST(RepeatingTimerTest, StopAndDestroyFromTask) {
+  auto task_runner = MakeRefCounted<FakeTaskRunner>();
+  RepeatingTimer timer;
+  int run_count = 0;
+  timer.Start(task_runner.get(),
+              [&timer, &run_count] {
+                if (++run_count == 2)
+                  timer.Stop();
+              },
+              TimeDelta::FromMilliseconds(10));
+  task_runner->RunOneTask();
+  task_runner->RunOneTask();
+  EXPECT_EQ(2, run_count);
+  EXPECT_FALSE(timer.is_started());
+  task_runner->RunOneTask();
+  EXPECT_EQ(2, run_count);
+
+  std::unique_ptr<RepeatingTimer> owned_timer(new RepeatingTimer());
+  owned_timer->Start(task_runner.get(), [&owned_timer] { owned_timer.reset(); },
+                     TimeDelta::FromMilliseconds(10));
+  task_runner->RunOneTask();
+  EXPECT_FALSE(owned_timer);
+}
+
+TEST(RepeatingTimerTest, OnMessageLoop) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+  const TimeDelta kInterval = TimeDelta::FromMilliseconds(5);
+  AutoResetWaitableEvent done;
+  Stopwatch stopwatch;
+  RepeatingTimer timer;
+  int run_count = 0;
+  loop->PostTask([&] {
+    stopwatch.Start();
+    timer.Start(loop.get(),
+                [&] {
+                  if (++run_count == 4) {
+                    timer.Stop();
+                    done.Signal();
+                  }
+                },
+                kInterval);
+  });
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(), kInterval * 4 - kTimeoutTolerance);
+  loop->QuitAndJoin();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,183 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/retry.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/tasks/task_context.h"
+
+namespace ftl {
+namespace {
+
+// The state of a |ScheduleWithRetry()| call, kept by its pending attempt.
+class RetryState : public RefCountedThreadSafe<RetryState> {
+ public:
+  void PostAttempt(TimeDelta delay) {
+    RefPtr<RetryState> self(this);
+    task_runner_->PostDelayedTask([self] { self->RunAttempt(); }, delay);
+  }
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(RetryState);
+  FRIEND_MAKE_REF_COUNTED(RetryState);
+
+  RetryState(RefPtr<TaskRunner> task_runner,
+             RetryAttempt attempt,
+             RetryPolicy policy,
+             RetryCallback callback)
+      : task_runner_(std::move(task_runner)),
+        attempt_(std::move(attempt)),
+        policy_(std::move(policy)),
+        callback_(std::move(callback)),
+        context_(CurrentTaskContext()) {}
+  ~RetryState() {}
+
+  bool IsCanceled() const {
+    return policy_.token.IsCanceled() || context_.token.IsCanceled();
+  }
+
+  TimePoint deadline() const {
+    return std::min(policy_.deadline, context_.deadline);
+  }
+
+  void RunAttempt() {
+    if (IsCanceled()) {
+      Finish(RetryResult::kCanceled);
+      return;
+    }
+    if (task_runner_->Now() >= deadline()) {
+      Finish(RetryResult::kDeadlineExceeded);
+      return;
+    }
+    attempt_count_++;
+    RefPtr<RetryState> self(this);
+    attempt_(attempt_count_,
+             [self](AttemptResult result) { self->OnAttemptDone(result); });
+  }
+
+  void OnAttemptDone(AttemptResult result) {
+    switch (result) {
+      case AttemptResult::kSucceeded:
+        if (policy_.budget)
+          policy_.budget->RecordSuccess();
+        Finish(RetryResult::kSucceeded);
+        return;
+      case AttemptResult::kFailedPermanently:
+        Finish(RetryResult::kFailedPermanently);
+        return;
+      case AttemptResult::kFailed:
+        break;
+    }
+
+    if (policy_.budget)
+      policy_.budget->RecordFailure();
+    if (IsCanceled()) {
+      Finish(RetryResult::kCanceled);
+      return;
+    }
+    if (policy_.max_attempts > 0 && attempt_count_ >= policy_.max_attempts) {
+      Finish(RetryResult::kAttemptsExhausted);
+      return;
+    }
+    if (policy_.budget && !policy_.budget->CanRetry()) {
+      Finish(RetryResult::kBudgetExhausted);
+      return;
+    }
+    delay_ = NextRetryDelay(policy_, delay_);
+    // (Don't wait just to miss the deadline.)
+    if (task_runner_->Now() + delay_ >= deadline()) {
+      Finish(RetryResult::kDeadlineExceeded);
+      return;
+    }
+    PostAttempt(delay_);
+  }
+
+  void Finish(RetryResult result) {
+    if (callback_)
+      callback_(result);
+  }
+
+  const RefPtr<TaskRunner> task_runner_;
+  const RetryAttempt attempt_;
+  const RetryPolicy policy_;
+  const RetryCallback callback_;
+  // The context when the retries were scheduled.
+  const TaskContext context_;
+
+  // Only one attempt is in progress at a time, so these are only used by one
+  // thread at a time.
+  int attempt_count_ = 0;
+  TimeDelta delay_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RetryState);
+};
+
+constexpr int64_t kMilliTokens = 1000;
+
+}  // namespace
+
+RetryBudget::RetryBudget(double max_tokens, double token_ratio)
+    : max_tokens_(static_cast<int64_t>(max_tokens * kMilliTokens)),
+      token_ratio_(static_cast<int64_t>(token_ratio * kMilliTokens)),
+      tokens_(max_tokens_) {
+  FTL_DCHECK(max_tokens_ > 0);
+  FTL_DCHECK(token_ratio_ >= 0);
+}
+
+RetryBudget::~RetryBudget() {}
+
+bool RetryBudget::CanRetry() const {
+  return tokens_.load(std::memory_order_relaxed) * 2 > max_tokens_;
+}
+
+void RetryBudget::RecordSuccess() {
+  Add(token_ratio_);
+}
+
+void RetryBudget::RecordFailure() {
+  Add(-kMilliTokens);
+}
+
+void RetryBudget::Add(int64_t delta) {
+  int64_t tokens = tokens_.load(std::memory_order_relaxed);
+  for (;;) {
+    const int64_t new_tokens =
+        std::max<int64_t>(0, std::min(max_tokens_, tokens + delta));
+    if (new_tokens == tokens ||
+        tokens_.compare_exchange_weak(tokens, new_tokens,
+                                      std::memory_order_relaxed)) {
+      return;
+    }
+  }
+}
+
+TimeDelta NextRetryDelay(const RetryPolicy& policy,
+                         TimeDelta previous_delay,
+                         FastRandom* random) {
+  FTL_DCHECK(random);
+  FTL_DCHECK(policy.initial_delay >= TimeDelta::Zero());
+  FTL_DCHECK(policy.max_delay >= policy.initial_delay);
+  const int64_t min = policy.initial_delay.ToNanoseconds();
+  const int64_t max_delay = policy.max_delay.ToNanoseconds();
+  const int64_t previous = previous_delay.ToNanoseconds();
+  const int64_t max =
+      previous > max_delay / 3 ? max_delay : std::max(min, previous * 3);
+  return TimeDelta::FromNanoseconds(random->UniformInt(min, max));
+}
+
+void ScheduleWithRetry(RefPtr<TaskRunner> task_runner,
+                       RetryAttempt attempt,
+                       RetryPolicy policy,
+                       RetryCallback callback) {
+  FTL_DCHECK(task_runner);
+  FTL_DCHECK(attempt);
+  MakeRefCounted<RetryState>(std::move(task_runner), std::move(attempt),
+                             std::move(policy), std::move(callback))
+      ->PostAttempt(TimeDelta::Zero());
+}
+
+}  // namespace ftl
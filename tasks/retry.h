@@ -0,0 +1,143 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_RETRY_H_
+#define LIB_FTL_TASKS_RETRY_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/cancellation.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/random/fast_random.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Limits retries across many callers (e.g., all of a client's requests to a
+// service), so that when the service is down, they don't multiply its load: a
+// failed attempt takes a token, and a successful one adds |token_ratio| of one
+// (up to |max_tokens|), and retrying is only allowed while more than half the
+// tokens are left. So retries stop when most attempts are failing, and start
+// again once enough succeed. (This is gRPC's retry throttling.) It starts full.
+//
+// This is thread-safe, and lock-free.
+class FTL_EXPORT RetryBudget final
+    : public RefCountedThreadSafe<RetryBudget> {
+ public:
+  // Returns true if retrying is allowed.
+  bool CanRetry() const;
+
+  void RecordSuccess();
+  void RecordFailure();
+
+ private:
+  FRIEND_REF_COUNTED_THREAD_SAFE(RetryBudget);
+  FRIEND_MAKE_REF_COUNTED(RetryBudget);
+
+  // E.g., 10 tokens and a ratio of 0.1 allows retries until failures exceed
+  // successes by five, plus one for every ten successes.
+  explicit RetryBudget(double max_tokens = 10.0, double token_ratio = 0.1);
+  ~RetryBudget();
+
+  // Adds |delta| thousandths of a token, within [0, |max_tokens_|].
+  void Add(int64_t delta);
+
+  // In thousandths of a token.
+  const int64_t max_tokens_;
+  const int64_t token_ratio_;
+  std::atomic<int64_t> tokens_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(RetryBudget);
+};
+
+// When, and how often, to retry (see |ScheduleWithRetry()|).
+struct RetryPolicy {
+  // The delay before the first retry, and the least delay before any.
+  TimeDelta initial_delay = TimeDelta::FromMilliseconds(100);
+  // The most delay before any retry.
+  TimeDelta max_delay = TimeDelta::FromSeconds(30);
+  // The most attempts (including the first), or zero for no limit.
+  int max_attempts = 5;
+  // No attempt is made at or after this (nor is a retry scheduled for after
+  // it).
+  TimePoint deadline = TimePoint::Max();
+  // No attempt is made once this is canceled.
+  CancellationToken token;
+  // If set, shared with other callers (see |RetryBudget|).
+  RefPtr<RetryBudget> budget;
+};
+
+// Returns the delay before the next retry, given the delay before the last one
+// (or zero, before the first retry), with "decorrelated jitter": random in
+// [|initial_delay|, 3 * |previous_delay|], within |max_delay|. So the delays
+// grow exponentially, but callers which failed together spread out rather
+// than retrying in step (which, after an outage, would be a storm of retries
+// at each step). This is for callers which schedule their own retries.
+FTL_EXPORT TimeDelta NextRetryDelay(
+    const RetryPolicy& policy,
+    TimeDelta previous_delay,
+    FastRandom* random = FastRandom::ForCurrentThread());
+
+// The result of an attempt.
+enum class AttemptResult {
+  kSucceeded,
+  // Failed, but may succeed if retried (e.g., a timeout).
+  kFailed,
+  // Failed, and would fail again (e.g., a bad request).
+  kFailedPermanently,
+};
+
+// The result of all the attempts.
+enum class RetryResult {
+  kSucceeded,
+  kFailedPermanently,
+  kAttemptsExhausted,
+  kDeadlineExceeded,
+  kBudgetExhausted,
+  kCanceled,
+};
+
+// Reports the result of an attempt (once).
+using AttemptCallback = std::function<void(AttemptResult result)>;
+// Makes attempt number |attempt| (from 1), calling |callback| (on any thread)
+// when it's done.
+using RetryAttempt =
+    std::function<void(int attempt, AttemptCallback callback)>;
+using RetryCallback = std::function<void(RetryResult result)>;
+
+// Makes attempts with |attempt| (on |task_runner|, starting with one posted
+// now) until one succeeds, retrying failures after |NextRetryDelay()|, within
+// |policy|, e.g.:
+//
+//   ScheduleWithRetry(
+//       task_runner,
+//       [this](int attempt, AttemptCallback callback) {
+//         client_->Connect([callback](Status status) {
+//           callback(status.ok() ? AttemptResult::kSucceeded
+//                                : AttemptResult::kFailed);
+//         });
+//       },
+//       policy,
+//       [this](RetryResult result) { OnConnected(result); });
+//
+// |callback| (if any) is called with the final result, on the thread the last
+// attempt reported its result on (or |task_runner|'s). The current
+// |TaskContext|'s deadline and cancellation token also apply (as does the
+// context itself, to the attempts).
+FTL_EXPORT void ScheduleWithRetry(RefPtr<TaskRunner> task_runner,
+                                  RetryAttempt attempt,
+                                  RetryPolicy policy = RetryPolicy(),
+                                  RetryCallback callback = nullptr);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_RETRY_H_
@@ -0,0 +1,211 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/retry.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/tasks/task_context.h"
+#include "lib/ftl/test/test_task_runner.h"
+
+namespace ftl {
+namespace {
+
+constexpr TimeDelta kInitialDelay = TimeDelta::FromMilliseconds(100);
+constexpr TimeDelta kMaxDelay = TimeDelta::FromSeconds(1);
+
+RetryPolicy TestPolicy() {
+  RetryPolicy policy;
+  policy.initial_delay = kInitialDelay;
+  policy.max_delay = kMaxDelay;
+  policy.max_attempts = 0;
+  return policy;
+}
+
+// Records the times of the attempts, which fail until |succeed_at| (if any).
+class Attempts {
+ public:
+  Attempts(TestTaskRunner* task_runner, int succeed_at = 0)
+      : task_runner_(task_runner), succeed_at_(succeed_at) {}
+
+  RetryAttempt attempt() {
+    return [this](int attempt, AttemptCallback callback) {
+      EXPECT_EQ(static_cast<int>(times.size()) + 1, attempt);
+      times.push_back(task_runner_->Now());
+      callback(attempt == succeed_at_ ? AttemptResult::kSucceeded
+                                      : AttemptResult::kFailed);
+    };
+  }
+
+  RetryCallback callback() {
+    return [this](RetryResult result) {
+      EXPECT_FALSE(done);
+      done = true;
+      this->result = result;
+    };
+  }
+
+  std::vector<TimePoint> times;
+  bool done = false;
+  RetryResult result = RetryResult::kSucceeded;
+
+ private:
+  TestTaskRunner* const task_runner_;
+  const int succeed_at_;
+};
+
+TEST(Retry, NextRetryDelay) {
+  RetryPolicy policy = TestPolicy();
+  FastRandom random(1u);
+  TimeDelta delay;
+  bool reached_max = false;
+  for (int i = 0; i < 100; i++) {
+    const TimeDelta previous = delay;
+    delay = NextRetryDelay(policy, previous, &random);
+    EXPECT_GE(delay, kInitialDelay);
+    EXPECT_LE(delay, kMaxDelay);
+    if (previous >= kInitialDelay && previous * 3 < kMaxDelay) {
+      EXPECT_LE(delay, previous * 3);
+    }
+    reached_max |= delay > kMaxDelay / 2;
+  }
+  EXPECT_TRUE(reached_max);
+
+  EXPECT_EQ(kInitialDelay, NextRetryDelay(policy, TimeDelta::Zero(), &random));
+  policy.max_delay = kInitialDelay;
+  EXPECT_EQ(kInitialDelay, NextRetryDelay(policy, kMaxDelay, &random));
+}
+
+TEST(Retry, SucceedsAfterFailures) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  Attempts attempts(task_runner.get(), 4);
+  const TimePoint start = task_runner->Now();
+  ScheduleWithRetry(task_runner, attempts.attempt(), TestPolicy(),
+                    attempts.callback());
+  EXPECT_TRUE(attempts.times.empty());
+  task_runner->RunUntilNoTasksRemain();
+
+  ASSERT_TRUE(attempts.done);
+  EXPECT_EQ(RetryResult::kSucceeded, attempts.result);
+  ASSERT_EQ(4u, attempts.times.size());
+  EXPECT_EQ(start, attempts.times[0]);
+  TimeDelta previous;
+  for (size_t i = 1u; i < attempts.times.size(); i++) {
+    const TimeDelta delay = attempts.times[i] - attempts.times[i - 1u];
+    EXPECT_GE(delay, kInitialDelay);
+    EXPECT_LE(delay, std::max(kInitialDelay, previous * 3));
+    previous = delay;
+  }
+}
+
+TEST(Retry, AttemptsExhaustedAndPermanentFailure) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  Attempts attempts(task_runner.get());
+  RetryPolicy policy = TestPolicy();
+  policy.max_attempts = 3;
+  ScheduleWithRetry(task_runner, attempts.attempt(), policy,
+                    attempts.callback());
+  task_runner->RunUntilNoTasksRemain();
+  EXPECT_EQ(RetryResult::kAttemptsExhausted, attempts.result);
+  EXPECT_EQ(3u, attempts.times.size());
+
+  int attempt_count = 0;
+  RetryResult result = RetryResult::kSucceeded;
+  ScheduleWithRetry(
+      task_runner,
+      [&attempt_count](int attempt, AttemptCallback callback) {
+        attempt_count++;
+        callback(AttemptResult::kFailedPermanently);
+      },
+      TestPolicy(), [&result](RetryResult r) { result = r; });
+  task_runner->RunUntilNoTasksRemain();
+  EXPECT_EQ(RetryResult::kFailedPermanently, result);
+  EXPECT_EQ(1, attempt_count);
+}
+
+TEST(Retry, Deadline) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  Attempts attempts(task_runner.get());
+  RetryPolicy policy = TestPolicy();
+  policy.deadline = task_runner->Now() + kMaxDelay * 5;
+  ScheduleWithRetry(task_runner, attempts.attempt(), policy,
+                    attempts.callback());
+  task_runner->RunUntilNoTasksRemain();
+  EXPECT_EQ(RetryResult::kDeadlineExceeded, attempts.result);
+  ASSERT_GE(attempts.times.size(), 2u);
+  // It gives up rather than retry too late.
+  EXPECT_LT(attempts.times.back(), policy.deadline);
+  EXPECT_LE(task_runner->Now(), policy.deadline);
+
+  // The current context's deadline applies too.
+  Attempts context_attempts(task_runner.get());
+  TaskContext context;
+  context.deadline = task_runner->Now();
+  {
+    ScopedTaskContext scoped_context(context);
+    ScheduleWithRetry(task_runner, context_attempts.attempt(), TestPolicy(),
+                      context_attempts.callback());
+  }
+  task_runner->RunUntilNoTasksRemain();
+  EXPECT_EQ(RetryResult::kDeadlineExceeded, context_attempts.result);
+  EXPECT_TRUE(context_attempts.times.empty());
+}
+
+TEST(Retry, Canceled) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  Attempts attempts(task_runner.get());
+  CancellationSource source;
+  RetryPolicy policy = TestPolicy();
+  policy.token = source.token();
+  ScheduleWithRetry(task_runner, attempts.attempt(), policy,
+                    attempts.callback());
+  task_runner->RunUntilIdle();
+  EXPECT_EQ(1u, attempts.times.size());
+  source.Cancel();
+  task_runner->RunUntilNoTasksRemain();
+  ASSERT_TRUE(attempts.done);
+  EXPECT_EQ(RetryResult::kCanceled, attempts.result);
+  EXPECT_EQ(1u, attempts.times.size());
+}
+
+TEST(Retry, Budget) {
+  auto budget = MakeRefCounted<RetryBudget>(10.0, 0.5);
+  EXPECT_TRUE(budget->CanRetry());
+  for (int i = 0; i < 4; i++)
+    budget->RecordFailure();
+  EXPECT_TRUE(budget->CanRetry());
+  budget->RecordFailure();
+  EXPECT_FALSE(budget->CanRetry());
+  budget->RecordFailure();
+  budget->RecordSuccess();
+  EXPECT_FALSE(budget->CanRetry());
+  budget->RecordSuccess();
+  budget->RecordSuccess();
+  EXPECT_TRUE(budget->CanRetry());
+  // It's full again after enough successes.
+  for (int i = 0; i < 100; i++)
+    budget->RecordSuccess();
+  for (int i = 0; i < 4; i++)
+    budget->RecordFailure();
+  EXPECT_TRUE(budget->CanRetry());
+
+  // Shared by two callers, which stop retrying once it runs out.
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  RetryPolicy policy = TestPolicy();
+  policy.budget = MakeRefCounted<RetryBudget>(10.0, 0.1);
+  Attempts attempts1(task_runner.get());
+  Attempts attempts2(task_runner.get());
+  ScheduleWithRetry(task_runner, attempts1.attempt(), policy,
+                    attempts1.callback());
+  ScheduleWithRetry(task_runner, attempts2.attempt(), policy,
+                    attempts2.callback());
+  task_runner->RunUntilNoTasksRemain();
+  EXPECT_EQ(RetryResult::kBudgetExhausted, attempts1.result);
+  EXPECT_EQ(RetryResult::kBudgetExhausted, attempts2.result);
+  EXPECT_EQ(6u, attempts1.times.size() + attempts2.times.size());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,128 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/sequenced_task_runner.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "lib/ftl/debug/trace_event.h"
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+// The maximum number of tasks run per turn on the underlying task runner, so
+// that a busy sequence doesn't monopolize one of its threads.
+constexpr size_t kMaxTasksPerSlice = 32u;
+
+thread_local SequencedTaskRunner* g_current_sequence = nullptr;
+
+}  // namespace
+
+SequencedTaskRunner::SequencedTaskRunner(RefPtr<TaskRunner> task_runner)
+    : task_runner_(std::move(task_runner)) {
+  FTL_DCHECK(task_runner_);
+}
+
+SequencedTaskRunner::~SequencedTaskRunner() {}
+
+// static
+SequencedTaskRunner* SequencedTaskRunner::GetCurrent() {
+  return g_current_sequence;
+}
+
+void SequencedTaskRunner::PostTask(UniqueClosure task) {
+  FTL_DCHECK(task);
+  Enqueue(TraceTask(std::move(task)));
+}
+
+void SequencedTaskRunner::PostTaskForTime(UniqueClosure task,
+                                          TimePoint target_time) {
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task), target_time);
+
+  RefPtr<SequencedTaskRunner> self(this);
+  task_runner_->PostTaskForTime(
+      [ self, task = std::move(task) ]() mutable {
+        self->Enqueue(std::move(task));
+      },
+      target_time);
+}
+
+void SequencedTaskRunner::PostDelayedTask(UniqueClosure task, TimeDelta delay) {
+  PostTaskForTime(std::move(task), TimePoint::Now() + delay);
+}
+
+void SequencedTaskRunner::PostTasks(std::vector<UniqueClosure> tasks) {
+  for (const auto& task : tasks)
+    FTL_DCHECK(task);
+  if (tasks.empty())
+    return;
+  TraceTasks(&tasks);
+
+  {
+    MutexLocker locker(&mutex_);
+    queue_.insert(queue_.end(), std::make_move_iterator(tasks.begin()),
+                  std::make_move_iterator(tasks.end()));
+    if (scheduled_)
+      return;
+    scheduled_ = true;
+  }
+  Schedule();
+}
+
+bool SequencedTaskRunner::RunsTasksOnCurrentThread() {
+  return g_current_sequence == this;
+}
+
+void SequencedTaskRunner::Enqueue(UniqueClosure task) {
+  {
+    MutexLocker locker(&mutex_);
+    queue_.push_back(std::move(task));
+    if (scheduled_)
+      return;
+    scheduled_ = true;
+  }
+  Schedule();
+}
+
+void SequencedTaskRunner::Schedule() {
+  RefPtr<SequencedTaskRunner> self(this);
+  task_runner_->PostTask([self] { self->RunTasks(); });
+}
+
+void SequencedTaskRunner::RunTasks() {
+  std::vector<UniqueClosure> tasks;
+  {
+    MutexLocker locker(&mutex_);
+    FTL_DCHECK(scheduled_);
+    size_t count = std::min(queue_.size(), kMaxTasksPerSlice);
+    tasks.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+      tasks.push_back(std::move(queue_.front()));
+      queue_.pop_front();
+    }
+  }
+
+  SequencedTaskRunner* previous_sequence = g_current_sequence;
+  g_current_sequence = this;
+  for (auto& task : tasks) {
+    FTL_TRACE_EVENT("ftl", "SequencedTaskRunner::RunTask");
+    task();
+  }
+  g_current_sequence = previous_sequence;
+
+  {
+    MutexLocker locker(&mutex_);
+    if (queue_.empty()) {
+      scheduled_ = false;
+      return;
+    }
+  }
+  Schedule();
+}
+
+}  // namespace ftl
@@ -0,0 +1,86 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_SEQUENCED_TASK_RUNNER_H_
+#define LIB_FTL_TASKS_SEQUENCED_TASK_RUNNER_H_
+
+#include <deque>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A |TaskRunner| which runs its tasks one at a time, in the order they were
+// posted, on threads borrowed from another (typically concurrent) task runner
+// such as a |ThreadPool|. This makes it cheap to have many independent
+// sequences of tasks (e.g., one per session) without dedicating a thread to
+// each. Use like:
+//
+//   auto sequence = MakeRefCounted<SequencedTaskRunner>(pool);
+//   sequence->PostTask([] { ... });
+//
+// While a task from the sequence is running, |RunsTasksOnCurrentThread()|
+// returns true (on that thread), so code which uses it to check that it is "on
+// the right thread" works unchanged. Each task runs with all memory effects of
+// the previous task in the sequence visible.
+//
+// Delayed tasks are posted to the sequence once due, so they are ordered with
+// respect to tasks posted at that time (and not necessarily with respect to
+// each other if they have the same target time).
+class FTL_EXPORT SequencedTaskRunner : public TaskRunner {
+ public:
+  // Returns the sequence whose task is running on the current thread, or null
+  // if there is none.
+  static SequencedTaskRunner* GetCurrent();
+
+  // |TaskRunner|:
+  using TaskRunner::PostDelayedTask;
+  using TaskRunner::PostTask;
+  void PostTask(UniqueClosure task) override;
+  void PostTaskForTime(UniqueClosure task, TimePoint target_time) override;
+  void PostDelayedTask(UniqueClosure task, TimeDelta delay) override;
+  void PostTasks(std::vector<UniqueClosure> tasks) override;
+  bool RunsTasksOnCurrentThread() override;
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(SequencedTaskRunner);
+  FRIEND_REF_COUNTED_THREAD_SAFE(SequencedTaskRunner);
+
+  // Tasks are posted to |task_runner|, which must run them eventually (though
+  // it may do so on any thread).
+  explicit SequencedTaskRunner(RefPtr<TaskRunner> task_runner);
+  ~SequencedTaskRunner() override;
+
+  // Adds |task| to the queue, scheduling |RunTasks()| if necessary.
+  void Enqueue(UniqueClosure task);
+
+  // Posts |RunTasks()| to |task_runner_|.
+  void Schedule();
+
+  // Runs a slice of queued tasks, then reschedules itself if there are more.
+  void RunTasks();
+
+  const RefPtr<TaskRunner> task_runner_;
+
+  Mutex mutex_;
+  std::deque<UniqueClosure> queue_ FTL_GUARDED_BY(mutex_);
+  // True if |RunTasks()| has been posted to |task_runner_| (or is running).
+  bool scheduled_ FTL_GUARDED_BY(mutex_) = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(SequencedTaskRunner);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_SEQUENCED_TASK_RUNNER_H_
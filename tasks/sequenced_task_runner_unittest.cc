@@ -0,0 +1,103 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/sequenced_task_runner.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/one_shot_timer.h"
+#include "lib/ftl/tasks/thread_pool.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+#include "lib/ftl/time/stopwatch.h"
+
+namespace ftl {
+namespace {
+
+TEST(SequencedTaskRunnerTest, RunsTasksInOrderWithoutConcurrency) {
+  constexpr size_t kSequenceCount = 16u;
+  constexpr int kTaskCount = 200;
+
+  auto pool = MakeRefCounted<ThreadPool>(4);
+  EXPECT_TRUE(pool->Start());
+
+  std::vector<RefPtr<SequencedTaskRunner>> sequences;
+  std::vector<std::vector<int>> orders(kSequenceCount);
+  std::vector<std::atomic<int>> running(kSequenceCount);
+  std::atomic<bool> overlapped(false);
+  for (size_t s = 0; s < kSequenceCount; s++) {
+    running[s].store(0);
+    sequences.push_back(MakeRefCounted<SequencedTaskRunner>(pool));
+  }
+
+  for (int i = 0; i < kTaskCount; i++) {
+    for (size_t s = 0; s < kSequenceCount; s++) {
+      sequences[s]->PostTask([&, s, i] {
+        if (running[s].fetch_add(1) != 0)
+          overlapped.store(true);
+        if (!sequences[s]->RunsTasksOnCurrentThread() ||
+            SequencedTaskRunner::GetCurrent() != sequences[s].get())
+          overlapped.store(true);
+        orders[s].push_back(i);
+        running[s].fetch_sub(1);
+      });
+    }
+  }
+  pool->Shutdown();
+
+  EXPECT_FALSE(overlapped.load());
+  for (size_t s = 0; s < kSequenceCount; s++) {
+    ASSERT_EQ(static_cast<size_t>(kTaskCount), orders[s].size());
+    for (int i = 0; i < kTaskCount; i++)
+      EXPECT_EQ(i, orders[s][i]);
+  }
+}
+
+TEST(SequencedTaskRunnerTest, PostTasksFromSequence) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  auto sequence = MakeRefCounted<SequencedTaskRunner>(pool);
+  EXPECT_FALSE(sequence->RunsTasksOnCurrentThread());
+
+  std::vector<int> order;
+  sequence->PostTask([&sequence, &order] {
+    order.push_back(0);
+    std::vector<UniqueClosure> tasks;
+    for (int i = 2; i < 5; i++)
+      tasks.push_back([&order, i] { order.push_back(i); });
+    sequence->PostTasks(std::move(tasks));
+  });
+  sequence->PostTask([&order] { order.push_back(1); });
+  EXPECT_TRUE(pool->Start());
+  pool->Shutdown();
+
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 4}), order);
+}
+
+TEST(SequencedTaskRunnerTest, DelayedTaskAndOneShotTimer) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  EXPECT_TRUE(pool->Start());
+  auto sequence = MakeRefCounted<SequencedTaskRunner>(pool);
+
+  OneShotTimer timer;
+  ManualResetWaitableEvent done;
+  bool on_sequence = false;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  sequence->PostTask([&] {
+    timer.Start(sequence.get(), [&] {
+      on_sequence = sequence->RunsTasksOnCurrentThread();
+      done.Signal();
+    }, TimeDelta::FromMilliseconds(20));
+  });
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(),
+            TimeDelta::FromMilliseconds(20) - kTimeoutTolerance);
+  EXPECT_TRUE(on_sequence);
+  pool->Shutdown();
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,38 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/task_context.h"
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+thread_local const TaskContext* g_current_context = nullptr;
+
+}  // namespace
+
+ScopedTaskContext::ScopedTaskContext(const TaskContext& context)
+    : context_(context), previous_(g_current_context) {
+  g_current_context = &context_;
+}
+
+ScopedTaskContext::~ScopedTaskContext() {
+  FTL_DCHECK(g_current_context == &context_);
+  g_current_context = previous_;
+}
+
+const TaskContext& CurrentTaskContext() {
+  static const TaskContext* default_context = new TaskContext();
+  return g_current_context ? *g_current_context : *default_context;
+}
+
+namespace internal {
+
+const TaskContext* GetCurrentTaskContext() {
+  return g_current_context;
+}
+
+}  // namespace internal
+}  // namespace ftl
@@ -0,0 +1,86 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_TASK_CONTEXT_H_
+#define LIB_FTL_TASKS_TASK_CONTEXT_H_
+
+#include <stdint.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/cancellation.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// What the work being done on a thread is for, e.g., a request: when it's no
+// longer wanted (a deadline, or a cancellation token), and an id to trace it
+// by. It's set for a scope with |ScopedTaskContext|, e.g., by a server when it
+// starts handling a request:
+//
+//   TaskContext context;
+//   context.deadline = TimePoint::Now() + request.timeout();
+//   context.token = connection.cancellation_token();
+//   context.trace_id = request.id();
+//   ScopedTaskContext scoped_context(context);
+//   Handle(request);
+//
+// and then follows the work through the tasks it posts: each |TaskRunner|
+// captures the current context when a task is posted, and sets it while the
+// task runs (as it does for |TaskTracer|s). So deep in the work, tasks can
+// find out whether it's still wanted, with |CurrentDeadline()| or
+// |CurrentTaskContext().IsExpired()|, and tasks posted with
+// |TaskRunner::PostExpiringTask()| are dropped (destroyed without being run)
+// if it isn't by the time they would run.
+struct TaskContext {
+  // The default context, which never expires.
+  TaskContext() {}
+
+  // Returns true if |deadline| has passed by |now|, or |token| is canceled.
+  bool IsExpired(TimePoint now = TimePoint::Now()) const {
+    return now >= deadline || token.IsCanceled();
+  }
+
+  TimePoint deadline = TimePoint::Max();
+  CancellationToken token;
+  // Zero for none.
+  uint64_t trace_id = 0u;
+};
+
+// Sets the current thread's context to |context| until destroyed (when the
+// previous one is restored). To narrow the current context, start from a copy
+// of it, e.g.:
+//
+//   TaskContext context = CurrentTaskContext();
+//   context.deadline = std::min(context.deadline, now + kBackendTimeout);
+//   ScopedTaskContext scoped_context(context);
+class FTL_EXPORT ScopedTaskContext final {
+ public:
+  explicit ScopedTaskContext(const TaskContext& context);
+  ~ScopedTaskContext();
+
+ private:
+  const TaskContext context_;
+  const TaskContext* const previous_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ScopedTaskContext);
+};
+
+// Returns the current thread's context (the default one if none is set).
+FTL_EXPORT const TaskContext& CurrentTaskContext();
+
+// Returns the current context's deadline (|TimePoint::Max()| if none).
+inline TimePoint CurrentDeadline() {
+  return CurrentTaskContext().deadline;
+}
+
+namespace internal {
+
+// Returns the current thread's context, or null if none is set.
+FTL_EXPORT const TaskContext* GetCurrentTaskContext();
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_TASK_CONTEXT_H_
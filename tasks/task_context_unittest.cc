@@ -0,0 +1,136 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/task_context.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/test/test_task_runner.h"
+
+namespace ftl {
+namespace {
+
+constexpr TimeDelta kTimeout = TimeDelta::FromMilliseconds(100);
+constexpr TimeDelta kTick = TimeDelta::FromMilliseconds(1);
+
+TEST(TaskContext, Scoped) {
+  EXPECT_FALSE(internal::GetCurrentTaskContext());
+  EXPECT_EQ(TimePoint::Max(), CurrentDeadline());
+  EXPECT_EQ(0u, CurrentTaskContext().trace_id);
+  EXPECT_FALSE(CurrentTaskContext().IsExpired());
+
+  const TimePoint deadline = TimePoint::Now() + kTimeout;
+  TaskContext context;
+  context.deadline = deadline;
+  context.trace_id = 1u;
+  {
+    ScopedTaskContext scoped_context(context);
+    EXPECT_EQ(deadline, CurrentDeadline());
+    EXPECT_EQ(1u, CurrentTaskContext().trace_id);
+    EXPECT_FALSE(CurrentTaskContext().IsExpired(deadline - kTick));
+    EXPECT_TRUE(CurrentTaskContext().IsExpired(deadline));
+
+    TaskContext narrower = CurrentTaskContext();
+    narrower.deadline = deadline - kTick;
+    {
+      ScopedTaskContext scoped_narrower(narrower);
+      EXPECT_EQ(deadline - kTick, CurrentDeadline());
+      EXPECT_EQ(1u, CurrentTaskContext().trace_id);
+
+      // It's per thread.
+      std::thread([] {
+        EXPECT_EQ(TimePoint::Max(), CurrentDeadline());
+      }).join();
+    }
+    EXPECT_EQ(deadline, CurrentDeadline());
+  }
+  EXPECT_FALSE(internal::GetCurrentTaskContext());
+
+  CancellationSource source;
+  context.token = source.token();
+  EXPECT_FALSE(context.IsExpired(TimePoint::Min()));
+  source.Cancel();
+  EXPECT_TRUE(context.IsExpired(TimePoint::Min()));
+}
+
+TEST(TaskContext, PropagatesThroughPostedTasks) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  TaskContext context;
+  context.deadline = task_runner->Now() + kTimeout;
+  context.trace_id = 42u;
+
+  uint64_t trace_id = 0u;
+  TimePoint deadline;
+  uint64_t nested_trace_id = 0u;
+  bool ran_without_context = false;
+  {
+    ScopedTaskContext scoped_context(context);
+    task_runner->PostTask([&] {
+      trace_id = CurrentTaskContext().trace_id;
+      task_runner->PostDelayedTask(
+          [&] {
+            nested_trace_id = CurrentTaskContext().trace_id;
+            deadline = CurrentDeadline();
+          },
+          kTick);
+    });
+  }
+  task_runner->PostTask([&] {
+    ran_without_context = !internal::GetCurrentTaskContext();
+  });
+  EXPECT_FALSE(internal::GetCurrentTaskContext());
+
+  EXPECT_EQ(3u, task_runner->AdvanceTimeBy(kTick));
+  EXPECT_EQ(42u, trace_id);
+  EXPECT_EQ(42u, nested_trace_id);
+  EXPECT_EQ(context.deadline, deadline);
+  EXPECT_TRUE(ran_without_context);
+  EXPECT_FALSE(internal::GetCurrentTaskContext());
+}
+
+TEST(TaskContext, ExpiringTasks) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  CancellationSource source;
+  TaskContext context;
+  context.deadline = task_runner->Now() + kTimeout;
+  context.token = source.token();
+
+  int run_count = 0;
+  int expiring_run_count = 0;
+  {
+    ScopedTaskContext scoped_context(context);
+    task_runner->PostExpiringTask([&] { expiring_run_count++; });
+    task_runner->PostExpiringDelayedTask([&] { expiring_run_count++; },
+                                         kTimeout - kTick);
+    // Past the deadline.
+    task_runner->PostExpiringDelayedTask([&] { expiring_run_count++; },
+                                         kTimeout);
+    // Other tasks still run.
+    task_runner->PostDelayedTask([&] { run_count++; }, kTimeout);
+  }
+  // Without a context, it's never dropped.
+  task_runner->PostExpiringDelayedTask([&] { run_count++; }, kTimeout * 2);
+
+  EXPECT_EQ(5u, task_runner->AdvanceTimeBy(kTimeout * 2));
+  EXPECT_EQ(2, expiring_run_count);
+  EXPECT_EQ(2, run_count);
+
+  // Canceling the token expires the context too.
+  {
+    ScopedTaskContext scoped_context(context);
+    task_runner->PostExpiringTask([&] { expiring_run_count++; });
+  }
+  context.deadline = TimePoint::Max();
+  {
+    ScopedTaskContext scoped_context(context);
+    task_runner->PostExpiringTask([&] { expiring_run_count++; });
+  }
+  source.Cancel();
+  EXPECT_EQ(2u, task_runner->RunUntilIdle());
+  EXPECT_EQ(2, expiring_run_count);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,176 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/task_group.h"
+
+#include <atomic>
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/event_count.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+namespace internal {
+
+// The state of a |TaskGroup|, which the tasks posted to task runners hold a
+// reference to, since they may run (finding nothing to do) after the group
+// has been waited for and destroyed.
+class TaskGroupState : public RefCountedThreadSafe<TaskGroupState> {
+ public:
+  bool Post(TaskRunner* task_runner, UniqueClosure task) {
+    FTL_DCHECK(task_runner);
+    FTL_DCHECK(task);
+    {
+      MutexLocker locker(&mutex_);
+      if (cancellation_.IsCanceled())
+        return false;
+      pending_count_.fetch_add(1u, std::memory_order_relaxed);
+      tasks_.push_back(std::move(task));
+    }
+    task_runner->PostTask([state = Ref(this)] { state->RunOne(); });
+    return true;
+  }
+
+  // Runs the next queued task, if there is one. Returns false if there
+  // wasn't.
+  bool RunOne() {
+    UniqueClosure task;
+    {
+      MutexLocker locker(&mutex_);
+      if (tasks_.empty())
+        return false;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+    task = nullptr;
+    Complete(1u);
+    return true;
+  }
+
+  void Wait() {
+    while (RunOne()) {
+    }
+    done_.Await([this] {
+      return pending_count_.load(std::memory_order_acquire) == 0u;
+    });
+  }
+
+  void OnComplete(TaskRunner* task_runner, UniqueClosure callback) {
+    FTL_DCHECK(task_runner);
+    FTL_DCHECK(callback);
+    {
+      MutexLocker locker(&mutex_);
+      if (pending_count_.load(std::memory_order_acquire) != 0u) {
+        callbacks_.emplace_back(task_runner, std::move(callback));
+        return;
+      }
+    }
+    task_runner->PostTask(std::move(callback));
+  }
+
+  void Cancel() {
+    std::deque<UniqueClosure> tasks;
+    {
+      MutexLocker locker(&mutex_);
+      cancellation_.Cancel();
+      tasks.swap(tasks_);
+    }
+    // Destroy the tasks before they're counted as done.
+    size_t count = tasks.size();
+    tasks.clear();
+    if (count)
+      Complete(count);
+  }
+
+  bool IsCanceled() const { return cancellation_.IsCanceled(); }
+  CancellationToken token() const { return cancellation_.token(); }
+
+  size_t pending_task_count() const {
+    return pending_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(TaskGroupState);
+  FRIEND_REF_COUNTED_THREAD_SAFE(TaskGroupState);
+
+  TaskGroupState() : pending_count_(0u) {}
+  ~TaskGroupState() {}
+
+  // Counts |count| tasks as done, and if that was the last of them, runs the
+  // completion callbacks and wakes up waiters.
+  void Complete(size_t count) {
+    if (pending_count_.fetch_sub(count, std::memory_order_acq_rel) != count)
+      return;
+
+    std::vector<std::pair<RefPtr<TaskRunner>, UniqueClosure>> callbacks;
+    {
+      MutexLocker locker(&mutex_);
+      // More tasks may have been posted since; the callbacks wait for them.
+      if (pending_count_.load(std::memory_order_relaxed) == 0u)
+        callbacks.swap(callbacks_);
+    }
+    for (auto& callback : callbacks)
+      callback.first->PostTask(std::move(callback.second));
+    done_.NotifyAll();
+  }
+
+  // The number of tasks which have been posted and not yet completed. It's
+  // only incremented under |mutex_|.
+  std::atomic<size_t> pending_count_;
+  CancellationSource cancellation_;
+  // Notified when |pending_count_| drops to zero.
+  EventCount done_;
+
+  Mutex mutex_;
+  // The tasks which haven't started yet.
+  std::deque<UniqueClosure> tasks_ FTL_GUARDED_BY(mutex_);
+  std::vector<std::pair<RefPtr<TaskRunner>, UniqueClosure>> callbacks_
+      FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TaskGroupState);
+};
+
+}  // namespace internal
+
+TaskGroup::TaskGroup() : state_(MakeRefCounted<internal::TaskGroupState>()) {}
+
+TaskGroup::~TaskGroup() {
+  Wait();
+}
+
+bool TaskGroup::Post(TaskRunner* task_runner, UniqueClosure task) {
+  return state_->Post(task_runner, std::move(task));
+}
+
+void TaskGroup::Wait() {
+  state_->Wait();
+}
+
+void TaskGroup::OnComplete(TaskRunner* task_runner, UniqueClosure callback) {
+  state_->OnComplete(task_runner, std::move(callback));
+}
+
+void TaskGroup::Cancel() {
+  state_->Cancel();
+}
+
+bool TaskGroup::IsCanceled() const {
+  return state_->IsCanceled();
+}
+
+CancellationToken TaskGroup::token() const {
+  return state_->token();
+}
+
+size_t TaskGroup::pending_task_count() const {
+  return state_->pending_task_count();
+}
+
+}  // namespace ftl
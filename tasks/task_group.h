@@ -0,0 +1,82 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_TASK_GROUP_H_
+#define LIB_FTL_TASKS_TASK_GROUP_H_
+
+#include <stddef.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/cancellation.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/task_runner.h"
+
+namespace ftl {
+namespace internal {
+class TaskGroupState;
+}  // namespace internal
+
+// Tracks a fan-out of tasks (posted to any task runners), so that they can be
+// waited for, or cancelled, together:
+//
+//   TaskGroup group;
+//   for (auto& shard : shards)
+//     group.Post(pool.get(), [&shard] { shard.Process(); });
+//   group.Wait();
+//
+// or, without blocking:
+//
+//   group.OnComplete(loop.get(), [] { FTL_LOG(INFO) << "Done"; });
+//
+// Tasks may post more tasks to the group (which are waited for too). The
+// group's tasks are queued in the group, and each task posted to a task runner
+// runs the next one: so |Wait()| can run them itself rather than just blocking
+// (which also makes it safe to wait for tasks posted to the task runner, e.g.,
+// a |ThreadPool|, whose thread is doing the waiting).
+//
+// |Cancel()| drops the tasks which haven't started (and any posted after it),
+// and cancels |token()|, which long-running tasks may check to stop early.
+//
+// This class is thread-safe.
+class FTL_EXPORT TaskGroup final {
+ public:
+  TaskGroup();
+  // Waits for the group (see |Wait()|).
+  ~TaskGroup();
+
+  // Posts |task| to run on |task_runner| as part of the group. Returns false
+  // (dropping |task|) if the group has been cancelled.
+  bool Post(TaskRunner* task_runner, UniqueClosure task);
+
+  // Returns once all of the group's tasks have completed (or been dropped),
+  // running the ones which haven't started on the calling thread meanwhile.
+  // Must not be called by one of the group's tasks.
+  void Wait();
+
+  // Posts |callback| to |task_runner| once all of the group's tasks have
+  // completed (or been dropped), which may be immediately. (If more tasks are
+  // posted first, it waits for those too.)
+  void OnComplete(TaskRunner* task_runner, UniqueClosure callback);
+
+  // Drops the tasks which haven't started, and any posted from now on, and
+  // cancels |token()|.
+  void Cancel();
+
+  bool IsCanceled() const;
+  CancellationToken token() const;
+
+  // Returns the number of tasks which haven't completed (or been dropped).
+  size_t pending_task_count() const;
+
+ private:
+  const RefPtr<internal::TaskGroupState> state_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_TASK_GROUP_H_
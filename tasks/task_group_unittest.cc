@@ -0,0 +1,114 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/task_group.h"
+
+#include <atomic>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/message_loop.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace ftl {
+namespace {
+
+TEST(TaskGroupTest, Wait) {
+  auto pool = MakeRefCounted<ThreadPool>(4);
+  EXPECT_TRUE(pool->Start());
+
+  std::atomic<int> run_count(0);
+  TaskGroup group;
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(group.Post(pool.get(), [&group, &pool, &run_count] {
+      // Tasks may add to the group.
+      group.Post(pool.get(), [&run_count] { run_count++; });
+      run_count++;
+    }));
+  }
+  group.Wait();
+  EXPECT_EQ(200, run_count.load());
+  EXPECT_EQ(0u, group.pending_task_count());
+
+  pool->Shutdown();
+}
+
+// Waiting on a task runner's only thread for tasks posted to it runs them.
+TEST(TaskGroupTest, WaitOnTaskRunnerThread) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  EXPECT_TRUE(pool->Start());
+
+  ManualResetWaitableEvent done;
+  int run_count = 0;
+  pool->PostTask([&pool, &done, &run_count] {
+    TaskGroup group;
+    for (int i = 0; i < 10; i++)
+      group.Post(pool.get(), [&run_count] { run_count++; });
+    group.Wait();
+    EXPECT_EQ(10, run_count);
+    done.Signal();
+  });
+  done.Wait();
+
+  pool->Shutdown();
+}
+
+TEST(TaskGroupTest, OnComplete) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  EXPECT_TRUE(pool->Start());
+  auto loop = MakeRefCounted<MessageLoop>();
+  EXPECT_TRUE(loop->Start());
+
+  std::atomic<int> run_count(0);
+  ManualResetWaitableEvent done;
+  TaskGroup group;
+  for (int i = 0; i < 10; i++)
+    group.Post(pool.get(), [&run_count] { run_count++; });
+  group.OnComplete(loop.get(), [&loop, &run_count, &done] {
+    EXPECT_TRUE(loop->RunsTasksOnCurrentThread());
+    EXPECT_EQ(10, run_count.load());
+    done.Signal();
+  });
+  done.Wait();
+
+  // Once the group is complete, the callback is posted immediately.
+  ManualResetWaitableEvent done_again;
+  group.OnComplete(loop.get(), [&done_again] { done_again.Signal(); });
+  done_again.Wait();
+
+  loop->QuitAndJoin();
+  pool->Shutdown();
+}
+
+TEST(TaskGroupTest, Cancel) {
+  auto loop = MakeRefCounted<MessageLoop>();
+  std::atomic<int> run_count(0);
+  TaskGroup group;
+  CancellationToken token = group.token();
+
+  // Nothing runs until the loop starts.
+  for (int i = 0; i < 10; i++)
+    group.Post(loop.get(), [&run_count] { run_count++; });
+  EXPECT_EQ(10u, group.pending_task_count());
+  bool completed = false;
+  group.OnComplete(loop.get(), [&completed] { completed = true; });
+
+  group.Cancel();
+  EXPECT_TRUE(group.IsCanceled());
+  EXPECT_TRUE(token.IsCanceled());
+  EXPECT_EQ(0u, group.pending_task_count());
+  EXPECT_FALSE(group.Post(loop.get(), [&run_count] { run_count++; }));
+  group.Wait();
+
+  EXPECT_TRUE(loop->Start());
+  ManualResetWaitableEvent done;
+  loop->PostTask([&done] { done.Signal(); });
+  done.Wait();
+  loop->QuitAndJoin();
+  EXPECT_EQ(0, run_count.load());
+  EXPECT_TRUE(completed);
+}
+
+}  // namespace
+}  // namespace ftl
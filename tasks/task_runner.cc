@@ -4,8 +4,176 @@
 
 #include "lib/ftl/tasks/task_runner.h"
 
+#include <utility>
+
+#include "lib/ftl/macros.h"
+
 namespace ftl {
+namespace {
+
+// The location passed to the current |PostTask()| (or |PostDelayedTask()|)
+// call on this thread, if any, until a tracer takes it.
+thread_local const Location* g_posted_from = nullptr;
+
+// Sets |g_posted_from| for the duration of a |PostTask()| call.
+class ScopedPostedFrom {
+ public:
+  explicit ScopedPostedFrom(const Location& posted_from)
+      : previous_(g_posted_from) {
+    g_posted_from = &posted_from;
+  }
+  ~ScopedPostedFrom() { g_posted_from = previous_; }
+
+ private:
+  const Location* const previous_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ScopedPostedFrom);
+};
+
+// Returns |task| wrapped to do nothing if |token| has been canceled.
+UniqueClosure MakeCancelable(UniqueClosure task, CancellationToken token) {
+  return [task = std::move(task), token = std::move(token)] {
+    if (!token.IsCanceled())
+      task();
+  };
+}
+
+// Returns |task| wrapped to do nothing if |context| has expired by
+// |task_runner|'s clock. (The task runner outlives the tasks it runs.)
+UniqueClosure MakeExpiring(UniqueClosure task,
+                           const TaskContext& context,
+                           TaskRunner* task_runner) {
+  return [task = std::move(task), context, task_runner] {
+    if (!context.IsExpired(task_runner->Now()))
+      task();
+  };
+}
+
+}  // namespace
+
+constexpr TimeDelta TaskRunner::kMaxIdleTaskDuration;
+
+TaskRunner::TaskRunner() {}
 
 TaskRunner::~TaskRunner() {}
 
+bool TaskRunner::TryPostTask(UniqueClosure task) {
+  PostTask(std::move(task));
+  return true;
+}
+
+void TaskRunner::PostTaskWithPriority(UniqueClosure task,
+                                      TaskPriority priority) {
+  PostTask(std::move(task));
+}
+
+void TaskRunner::PostIdleTask(IdleTask task) {
+  PostTaskWithPriority(
+      [task = std::move(task)] {
+        task(TimePoint::Now() + kMaxIdleTaskDuration);
+      },
+      TaskPriority::kBestEffort);
+}
+
+void TaskRunner::PostTasks(std::vector<UniqueClosure> tasks) {
+  for (auto& task : tasks)
+    PostTask(std::move(task));
+}
+
+void TaskRunner::PostTasksForTime(std::vector<UniqueClosure> tasks,
+                                  TimePoint target_time) {
+  for (auto& task : tasks)
+    PostTaskForTime(std::move(task), target_time);
+}
+
+void TaskRunner::PostDelayedTasks(std::vector<UniqueClosure> tasks,
+                                  TimeDelta delay) {
+  PostTasksForTime(std::move(tasks), TimePoint::Now() + delay);
+}
+
+void TaskRunner::PostTask(const Location& posted_from, UniqueClosure task) {
+  ScopedPostedFrom scoped_posted_from(posted_from);
+  PostTask(std::move(task));
+}
+
+void TaskRunner::PostDelayedTask(const Location& posted_from,
+                                 UniqueClosure task,
+                                 TimeDelta delay) {
+  ScopedPostedFrom scoped_posted_from(posted_from);
+  PostDelayedTask(std::move(task), delay);
+}
+
+void TaskRunner::PostCancelableTask(UniqueClosure task,
+                                    CancellationToken token) {
+  PostTask(MakeCancelable(std::move(task), std::move(token)));
+}
+
+void TaskRunner::PostCancelableDelayedTask(UniqueClosure task,
+                                           CancellationToken token,
+                                           TimeDelta delay) {
+  PostDelayedTask(MakeCancelable(std::move(task), std::move(token)), delay);
+}
+
+void TaskRunner::PostExpiringTask(UniqueClosure task) {
+  const TaskContext* context = internal::GetCurrentTaskContext();
+  if (!context) {
+    PostTask(std::move(task));
+    return;
+  }
+  PostTask(MakeExpiring(std::move(task), *context, this));
+}
+
+void TaskRunner::PostExpiringDelayedTask(UniqueClosure task, TimeDelta delay) {
+  const TaskContext* context = internal::GetCurrentTaskContext();
+  if (!context) {
+    PostDelayedTask(std::move(task), delay);
+    return;
+  }
+  PostDelayedTask(MakeExpiring(std::move(task), *context, this), delay);
+}
+
+TimePoint TaskRunner::Now() {
+  return TimePoint::Now();
+}
+
+TimerWheel* TaskRunner::GetTimerWheel() {
+  return nullptr;
+}
+
+void TaskRunner::SetTaskTracer(RefPtr<TaskTracer> task_tracer) {
+  task_tracer_ = std::move(task_tracer);
+}
+
+void TaskRunner::TraceTasks(std::vector<UniqueClosure>* tasks,
+                            TimePoint target_time) {
+  if (!task_tracer_ && !internal::GetCurrentTaskContext())
+    return;
+  for (auto& task : *tasks)
+    task = WrapTask(std::move(task), target_time);
+}
+
+UniqueClosure TaskRunner::WrapTask(UniqueClosure task, TimePoint target_time) {
+  if (task_tracer_)
+    task = WrapTaskForTracer(std::move(task), target_time);
+  const TaskContext* context = internal::GetCurrentTaskContext();
+  if (!context)
+    return task;
+  return [task = std::move(task), context = *context] {
+    ScopedTaskContext scoped_context(context);
+    task();
+  };
+}
+
+UniqueClosure TaskRunner::WrapTaskForTracer(UniqueClosure task,
+                                            TimePoint target_time) {
+  // The location only applies to the first task posted (e.g., not to ones
+  // posted by an implementation which posts to another task runner).
+  Location posted_from;
+  if (g_posted_from) {
+    posted_from = *g_posted_from;
+    g_posted_from = nullptr;
+  }
+  return task_tracer_->WrapTask(posted_from, target_time, std::move(task));
+}
+
 }  // namespace ftl
@@ -5,33 +5,158 @@
 #ifndef LIB_FTL_TASKS_TASK_RUNNER_H_
 #define LIB_FTL_TASKS_TASK_RUNNER_H_
 
+#include <functional>
+#include <vector>
+
 #include "lib/ftl/ftl_export.h"
-#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/functional/cancellation.h"
+#include "lib/ftl/functional/inline_closure.h"
 #include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/location.h"
+#include "lib/ftl/tasks/task_context.h"
+#include "lib/ftl/tasks/task_tracer.h"
 #include "lib/ftl/time/time_delta.h"
 #include "lib/ftl/time/time_point.h"
 
 namespace ftl {
 
+class TimerWheel;
+
+// The priority of a task, for |TaskRunner::PostTaskWithPriority()|.
+enum class TaskPriority {
+  // Work the user (or another latency-sensitive client) is waiting for.
+  kUserBlocking,
+  // The priority of tasks posted with |TaskRunner::PostTask()|.
+  kNormal,
+  // Background work that may be postponed while there is anything else to do.
+  kBestEffort,
+};
+
 // Posts tasks to a task queue.
 class FTL_EXPORT TaskRunner : public RefCountedThreadSafe<TaskRunner> {
  public:
+  // A task to run when the task runner is idle, which is given a |deadline| by
+  // which it should return (e.g., by doing part of its work and reposting
+  // itself).
+  using IdleTask = std::function<void(TimePoint deadline)>;
+
+  // The longest an idle task is given to run.
+  static constexpr TimeDelta kMaxIdleTaskDuration =
+      TimeDelta::FromMilliseconds(50);
+
   // Posts a task to run as soon as possible.
-  virtual void PostTask(Closure task) = 0;
+  virtual void PostTask(UniqueClosure task) = 0;
+
+  // Posts a task to run as soon as possible, unless the task runner is at
+  // capacity (see |BoundedTaskRunner|), in which case |task| is destroyed
+  // without being run and this returns false. This never blocks. The default
+  // implementation calls |PostTask()| and returns true.
+  virtual bool TryPostTask(UniqueClosure task);
 
   // Posts a task to run as soon as possible after the specified |target_time|.
-  virtual void PostTaskForTime(Closure task, TimePoint target_time) = 0;
+  virtual void PostTaskForTime(UniqueClosure task, TimePoint target_time) = 0;
 
   // Posts a task to run as soon as possible after the specified |delay|.
-  virtual void PostDelayedTask(Closure task, TimeDelta delay) = 0;
+  virtual void PostDelayedTask(UniqueClosure task, TimeDelta delay) = 0;
+
+  // Posts a task to run as soon as possible, with the given |priority|.
+  // Implementations may run higher-priority tasks ahead of lower-priority ones
+  // (though they should not starve the latter indefinitely); the default
+  // implementation ignores |priority| and calls |PostTask()|. Tasks of the
+  // same priority are ordered as by |PostTask()|.
+  virtual void PostTaskWithPriority(UniqueClosure task, TaskPriority priority);
+
+  // Posts a task to run when there is nothing else to do (e.g., cache trimming
+  // or flushing logs). Implementations which know when they are idle (like
+  // |MessageLoop|) run it then, with a deadline before the next work is due;
+  // the default implementation posts it with |TaskPriority::kBestEffort|, with
+  // a deadline of |kMaxIdleTaskDuration| after it starts.
+  virtual void PostIdleTask(IdleTask task);
+
+  // Posts |tasks| to run as soon as possible. This behaves like calling
+  // |PostTask()| for each task in turn, but lets implementations enqueue the
+  // whole batch at once (e.g., with a single lock acquisition and wakeup).
+  virtual void PostTasks(std::vector<UniqueClosure> tasks);
+
+  // Posts |tasks| to run as soon as possible after the specified
+  // |target_time|. See |PostTasks()|.
+  virtual void PostTasksForTime(std::vector<UniqueClosure> tasks,
+                                TimePoint target_time);
+
+  // Posts |tasks| to run as soon as possible after the specified |delay|. See
+  // |PostTasks()|.
+  void PostDelayedTasks(std::vector<UniqueClosure> tasks, TimeDelta delay);
+
+  // Like |PostTask()| and |PostDelayedTask()|, but with the location the task
+  // is posted from (use |FTL_FROM_HERE|), for the |TaskTracer| (if any).
+  void PostTask(const Location& posted_from, UniqueClosure task);
+  void PostDelayedTask(const Location& posted_from,
+                       UniqueClosure task,
+                       TimeDelta delay);
+
+  // Like |PostTask()| and |PostDelayedTask()|, but the task is dropped
+  // (destroyed without being run) when it's dequeued if |token| has been
+  // canceled by then, e.g., so that a task posted to a |ThreadPool| may be
+  // canceled from the thread which posted it.
+  void PostCancelableTask(UniqueClosure task, CancellationToken token);
+  void PostCancelableDelayedTask(UniqueClosure task,
+                                 CancellationToken token,
+                                 TimeDelta delay);
+
+  // Like |PostTask()| and |PostDelayedTask()|, but the task is dropped when
+  // it's dequeued if the current |TaskContext| (when it's posted) has expired
+  // by then, by |Now()|, e.g., so that a request's work isn't done after it's
+  // timed out or been canceled. (Other tasks always run, with the context they
+  // were posted with: see |CurrentTaskContext()|.)
+  void PostExpiringTask(UniqueClosure task);
+  void PostExpiringDelayedTask(UniqueClosure task, TimeDelta delay);
 
   // Returns true if the task runner runs tasks on the current thread.
   virtual bool RunsTasksOnCurrentThread() = 0;
 
+  // Returns the current time, by the clock this task runner's delayed tasks are
+  // scheduled by. This is |TimePoint::Now()| by default, but may be virtual
+  // (see |TestTaskRunner|), so timers should use it rather than the real clock.
+  virtual TimePoint Now();
+
+  // Returns a |TimerWheel| whose timers fire on this task runner, or null if it
+  // doesn't have one (the default). The wheel may only be used on a thread
+  // where |RunsTasksOnCurrentThread()| is true.
+  virtual TimerWheel* GetTimerWheel();
+
+  // Sets a tracer which records each task posted from now on (so this should
+  // be called before posting any tasks, and not concurrently with posting).
+  // Only implementations which use |TraceTask()| (|MessageLoop|, |ThreadPool|
+  // and |SequencedTaskRunner|) support this.
+  void SetTaskTracer(RefPtr<TaskTracer> task_tracer);
+  TaskTracer* task_tracer() const { return task_tracer_.get(); }
+
  protected:
   FRIEND_REF_COUNTED_THREAD_SAFE(TaskRunner);
 
+  TaskRunner();
   virtual ~TaskRunner();
+
+  // For implementations, to be called for each task when it is posted: returns
+  // |task| wrapped to run with the current |TaskContext|, if any, and, if there
+  // is a tracer, to record it (with the location it was posted from, if known,
+  // and |target_time| for delayed tasks); otherwise, just returns |task|.
+  UniqueClosure TraceTask(UniqueClosure task,
+                          TimePoint target_time = TimePoint::Min()) {
+    if (!task_tracer_ && !internal::GetCurrentTaskContext())
+      return task;
+    return WrapTask(std::move(task), target_time);
+  }
+  // Like |TraceTask()|, for each of |*tasks|.
+  void TraceTasks(std::vector<UniqueClosure>* tasks,
+                  TimePoint target_time = TimePoint::Min());
+
+ private:
+  UniqueClosure WrapTask(UniqueClosure task, TimePoint target_time);
+  UniqueClosure WrapTaskForTracer(UniqueClosure task, TimePoint target_time);
+
+  RefPtr<TaskTracer> task_tracer_;
 };
 
 }  // namespace ftl
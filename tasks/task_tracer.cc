@@ -0,0 +1,143 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/task_tracer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+
+TimeDelta TaskTracer::TaskRecord::queueing_delay() const {
+  return start_time - std::max(post_time, target_time);
+}
+
+constexpr size_t TaskTracer::Histogram::kBucketCount;
+
+TaskTracer::Histogram::Histogram() {
+  Clear();
+}
+
+void TaskTracer::Histogram::Add(TimeDelta duration) {
+  int64_t micros = std::max<int64_t>(duration.ToMicroseconds(), 0);
+  size_t i = 0u;
+  while (i < kBucketCount - 1u && (int64_t{1} << i) <= micros)
+    i++;
+  buckets_[i]++;
+  count_++;
+  total_ = total_ + duration;
+  max_ = std::max(max_, duration);
+}
+
+void TaskTracer::Histogram::Clear() {
+  std::fill(buckets_, buckets_ + kBucketCount, 0u);
+  count_ = 0u;
+  total_ = TimeDelta::Zero();
+  max_ = TimeDelta::Zero();
+}
+
+TimeDelta TaskTracer::Histogram::mean() const {
+  return count_ ? total_ / static_cast<int64_t>(count_) : TimeDelta::Zero();
+}
+
+// static
+TimeDelta TaskTracer::Histogram::BucketUpperBound(size_t i) {
+  FTL_DCHECK(i < kBucketCount);
+  if (i == kBucketCount - 1u)
+    return TimeDelta::Max();
+  return TimeDelta::FromMicroseconds(int64_t{1} << i);
+}
+
+TimeDelta TaskTracer::Histogram::ApproximatePercentile(
+    double percentile) const {
+  FTL_DCHECK(percentile >= 0.0 && percentile <= 100.0);
+  if (!count_)
+    return TimeDelta::Zero();
+  // The number of durations at or below the percentile (at least one).
+  uint64_t rank = std::max<uint64_t>(
+      static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5), 1u);
+  uint64_t seen = 0u;
+  for (size_t i = 0u; i < kBucketCount; i++) {
+    seen += buckets_[i];
+    if (seen >= rank)
+      return std::min(BucketUpperBound(i), max_);
+  }
+  return max_;
+}
+
+std::string TaskTracer::Histogram::ToString() const {
+  return StringPrintf(
+      "count=%llu mean=%lldus p50<=%lldus p90<=%lldus p99<=%lldus "
+      "max=%lldus",
+      static_cast<unsigned long long>(count_),
+      static_cast<long long>(mean().ToMicroseconds()),
+      static_cast<long long>(ApproximatePercentile(50.0).ToMicroseconds()),
+      static_cast<long long>(ApproximatePercentile(90.0).ToMicroseconds()),
+      static_cast<long long>(ApproximatePercentile(99.0).ToMicroseconds()),
+      static_cast<long long>(max_.ToMicroseconds()));
+}
+
+TaskTracer::TaskTracer(std::string name, Observer observer)
+    : name_(std::move(name)), observer_(std::move(observer)) {}
+
+TaskTracer::~TaskTracer() {}
+
+TaskTracer::Histogram TaskTracer::GetQueueingDelayHistogram() {
+  MutexLocker locker(&mutex_);
+  return queueing_delay_;
+}
+
+TaskTracer::Histogram TaskTracer::GetRunTimeHistogram() {
+  MutexLocker locker(&mutex_);
+  return run_time_;
+}
+
+void TaskTracer::ClearHistograms() {
+  MutexLocker locker(&mutex_);
+  queueing_delay_.Clear();
+  run_time_.Clear();
+}
+
+std::string TaskTracer::ToString() {
+  MutexLocker locker(&mutex_);
+  return StringPrintf("%s: queueing delay: %s; run time: %s", name_.c_str(),
+                      queueing_delay_.ToString().c_str(),
+                      run_time_.ToString().c_str());
+}
+
+UniqueClosure TaskTracer::WrapTask(const Location& posted_from,
+                                   TimePoint target_time,
+                                   UniqueClosure task) {
+  FTL_DCHECK(task);
+
+  RefPtr<TaskTracer> self(this);
+  TimePoint post_time = TimePoint::Now();
+  return [ self, posted_from, post_time, target_time,
+           task = std::move(task) ] {
+    TaskRecord record;
+    record.posted_from = posted_from;
+    record.post_time = post_time;
+    record.target_time = std::max(post_time, target_time);
+    record.start_time = TimePoint::Now();
+    task();
+    record.run_time = TimePoint::Now() - record.start_time;
+    self->Record(record);
+  };
+}
+
+void TaskTracer::Record(const TaskRecord& record) {
+  {
+    MutexLocker locker(&mutex_);
+    queueing_delay_.Add(record.queueing_delay());
+    run_time_.Add(record.run_time);
+  }
+  if (observer_)
+    observer_(record);
+}
+
+}  // namespace ftl
@@ -0,0 +1,130 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_TASK_TRACER_H_
+#define LIB_FTL_TASKS_TASK_TRACER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/location.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Records how long the tasks posted to a |TaskRunner| wait to run (from when
+// they are posted, or their target time if later, until they start) and how
+// long they take to run, as histograms and, optionally, per task. This tells a
+// saturated task runner (long queueing delays) apart from slow tasks (long run
+// times). Use like:
+//
+//   auto tracer = MakeRefCounted<TaskTracer>("io");
+//   loop->SetTaskTracer(tracer);
+//   loop->PostTask(FTL_FROM_HERE, [] { ... });
+//   ...
+//   FTL_LOG(INFO) << tracer->ToString();
+//
+// This class is thread-safe.
+class FTL_EXPORT TaskTracer : public RefCountedThreadSafe<TaskTracer> {
+ public:
+  // What is recorded about each task.
+  struct TaskRecord {
+    // Null if the task wasn't posted with a location.
+    Location posted_from;
+    TimePoint post_time;
+    // The time the task was posted for (the same as |post_time| for immediate
+    // tasks).
+    TimePoint target_time;
+    TimePoint start_time;
+    TimeDelta run_time;
+
+    TimeDelta queueing_delay() const;
+  };
+
+  // A histogram of durations, with power-of-two buckets (in microseconds).
+  class FTL_EXPORT Histogram {
+   public:
+    static constexpr size_t kBucketCount = 32u;
+
+    Histogram();
+
+    void Add(TimeDelta duration);
+    void Clear();
+
+    uint64_t count() const { return count_; }
+    TimeDelta total() const { return total_; }
+    TimeDelta max() const { return max_; }
+    TimeDelta mean() const;
+
+    // Bucket |i| counts durations less than |BucketUpperBound(i)| (and at
+    // least the previous bucket's upper bound). The last bucket also counts
+    // all longer durations.
+    uint64_t bucket(size_t i) const { return buckets_[i]; }
+    static TimeDelta BucketUpperBound(size_t i);
+
+    // Returns an upper bound for the given |percentile| (from 0 to 100) of the
+    // durations: the upper bound of the bucket it falls in (or |max()|, if
+    // less).
+    TimeDelta ApproximatePercentile(double percentile) const;
+
+    // Returns a one-line summary, e.g., "count=3 mean=10us p50<=16us ...".
+    std::string ToString() const;
+
+   private:
+    uint64_t buckets_[kBucketCount];
+    uint64_t count_ = 0u;
+    TimeDelta total_;
+    TimeDelta max_;
+  };
+
+  // Called (on the thread which ran the task) for each task run.
+  using Observer = std::function<void(const TaskRecord&)>;
+
+  const std::string& name() const { return name_; }
+
+  Histogram GetQueueingDelayHistogram();
+  Histogram GetRunTimeHistogram();
+  void ClearHistograms();
+
+  // Returns a summary of both histograms, with the tracer's name.
+  std::string ToString();
+
+  // Returns a task which runs |task| and records it. Called by |TaskRunner|
+  // implementations (see |TaskRunner::TraceTask()|) when the task is posted.
+  UniqueClosure WrapTask(const Location& posted_from,
+                         TimePoint target_time,
+                         UniqueClosure task);
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(TaskTracer);
+  FRIEND_REF_COUNTED_THREAD_SAFE(TaskTracer);
+
+  explicit TaskTracer(std::string name, Observer observer = nullptr);
+  ~TaskTracer();
+
+  void Record(const TaskRecord& record);
+
+  const std::string name_;
+  const Observer observer_;
+
+  Mutex mutex_;
+  Histogram queueing_delay_ FTL_GUARDED_BY(mutex_);
+  Histogram run_time_ FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TaskTracer);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_TASK_TRACER_H_
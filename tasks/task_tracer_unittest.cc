@@ -0,0 +1,118 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/task_tracer.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/message_loop.h"
+#include "lib/ftl/tasks/sequenced_task_runner.h"
+#include "lib/ftl/tasks/thread_pool.h"
+
+namespace ftl {
+namespace {
+
+TEST(TaskTracerTest, Histogram) {
+  TaskTracer::Histogram histogram;
+  EXPECT_EQ(0u, histogram.count());
+  EXPECT_EQ(TimeDelta::Zero(), histogram.ApproximatePercentile(50.0));
+
+  for (int i = 0; i < 9; i++)
+    histogram.Add(TimeDelta::FromMicroseconds(3));
+  histogram.Add(TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(10u, histogram.count());
+  EXPECT_EQ(TimeDelta::FromMilliseconds(1), histogram.max());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1027), histogram.total());
+  // 3us is in the [2us, 4us) bucket.
+  EXPECT_EQ(9u, histogram.bucket(2));
+  EXPECT_EQ(TimeDelta::FromMicroseconds(4),
+            TaskTracer::Histogram::BucketUpperBound(2));
+  EXPECT_EQ(TimeDelta::FromMicroseconds(4),
+            histogram.ApproximatePercentile(50.0));
+  EXPECT_EQ(TimeDelta::FromMilliseconds(1),
+            histogram.ApproximatePercentile(100.0));
+  EXPECT_EQ(
+      "count=10 mean=102us p50<=4us p90<=4us p99<=1000us max=1000us",
+      histogram.ToString());
+
+  histogram.Clear();
+  EXPECT_EQ(0u, histogram.count());
+  EXPECT_EQ(0u, histogram.bucket(2));
+}
+
+TEST(TaskTracerTest, MessageLoop) {
+  std::vector<TaskTracer::TaskRecord> records;
+  auto tracer = MakeRefCounted<TaskTracer>(
+      "loop", [&records](const TaskTracer::TaskRecord& record) {
+        records.push_back(record);
+      });
+  EXPECT_EQ("loop", tracer->name());
+
+  auto loop = MakeRefCounted<MessageLoop>();
+  loop->SetTaskTracer(tracer);
+  EXPECT_EQ(tracer.get(), loop->task_tracer());
+  AutoResetWaitableEvent done;
+  loop->PostTask(FTL_FROM_HERE,
+                 [] { SleepFor(TimeDelta::FromMilliseconds(2)); });
+  const int kDelayedTaskLine = __LINE__ + 1;
+  loop->PostDelayedTask(FTL_FROM_HERE, [] {}, TimeDelta::FromMilliseconds(5));
+  loop->PostDelayedTask([&done] { done.Signal(); },
+                        TimeDelta::FromMilliseconds(10));
+  EXPECT_TRUE(loop->Start());
+  done.Wait();
+  loop->QuitAndJoin();
+
+  ASSERT_EQ(3u, records.size());
+  EXPECT_STREQ("TestBody", records[0].posted_from.function_name());
+  EXPECT_TRUE(strstr(records[0].posted_from.file_name(),
+                     "task_tracer_unittest.cc"));
+  EXPECT_GE(records[0].run_time, TimeDelta::FromMilliseconds(2));
+  EXPECT_EQ(records[0].post_time, records[0].target_time);
+
+  EXPECT_EQ(kDelayedTaskLine, records[1].posted_from.line_number());
+  // (The post time is taken a little after the target time is computed.)
+  EXPECT_GT(records[1].target_time - records[1].post_time,
+            TimeDelta::FromMilliseconds(4));
+  EXPECT_GE(records[1].start_time, records[1].target_time);
+  EXPECT_TRUE(records[2].posted_from.is_null());
+
+  EXPECT_EQ(3u, tracer->GetQueueingDelayHistogram().count());
+  EXPECT_EQ(3u, tracer->GetRunTimeHistogram().count());
+  EXPECT_GE(tracer->GetRunTimeHistogram().max(),
+            TimeDelta::FromMilliseconds(2));
+  EXPECT_EQ(0u, tracer->ToString().find("loop: queueing delay: count=3 "));
+
+  tracer->ClearHistograms();
+  EXPECT_EQ(0u, tracer->GetRunTimeHistogram().count());
+}
+
+TEST(TaskTracerTest, ThreadPoolAndSequence) {
+  auto pool_tracer = MakeRefCounted<TaskTracer>("pool");
+  auto sequence_tracer = MakeRefCounted<TaskTracer>("sequence");
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  pool->SetTaskTracer(pool_tracer);
+  auto sequence = MakeRefCounted<SequencedTaskRunner>(pool);
+  sequence->SetTaskTracer(sequence_tracer);
+
+  for (int i = 0; i < 10; i++)
+    sequence->PostTask(FTL_FROM_HERE, [] {});
+  std::vector<UniqueClosure> tasks;
+  for (int i = 0; i < 5; i++)
+    tasks.push_back([] {});
+  pool->PostTasks(std::move(tasks));
+  EXPECT_TRUE(pool->Start());
+  pool->Shutdown();
+
+  EXPECT_EQ(10u, sequence_tracer->GetRunTimeHistogram().count());
+  // The five tasks, plus at least one slice of the sequence.
+  EXPECT_GE(pool_tracer->GetRunTimeHistogram().count(), 6u);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,644 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/thread_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <utility>
+
+#include "lib/ftl/debug/trace_event.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/threading/cpu_topology.h"
+
+namespace ftl {
+namespace {
+
+// How often (in tasks) a busy worker looks at the shared queue before its own
+// deque, so that tasks posted from outside the pool are not starved by workers
+// which keep feeding themselves.
+constexpr uint32_t kSharedQueueCheckInterval = 61u;
+
+// Likewise, how often a busy worker looks at the best-effort queue first.
+constexpr uint32_t kBestEffortQueueCheckInterval = 127u;
+
+// The pool (and the index of the worker within it) whose worker thread is the
+// current thread, if any.
+thread_local ThreadPool* g_current_pool = nullptr;
+thread_local size_t g_current_worker_index = 0u;
+
+ThreadPool::ElasticOptions FixedSizeOptions(size_t thread_count) {
+  ThreadPool::ElasticOptions options;
+  options.min_thread_count = thread_count;
+  options.max_thread_count = thread_count;
+  return options;
+}
+
+// Returns the NUMA node for each worker of a NUMA-aware pool.
+std::vector<int> GetWorkerNumaNodes(const ThreadPool::NumaOptions& options) {
+  const CpuTopology& topology = CpuTopology::Get();
+  std::vector<int> worker_nodes;
+  for (size_t node : topology.nodes) {
+    size_t count = options.threads_per_node
+                       ? options.threads_per_node
+                       : topology.GetNodeCpus(node).size();
+    worker_nodes.insert(worker_nodes.end(), count, static_cast<int>(node));
+  }
+  return worker_nodes;
+}
+
+}  // namespace
+
+struct ThreadPool::Worker {
+  explicit Worker(size_t index)
+      : index(index),
+        random_state(static_cast<uint32_t>(index) * 2654435761u + 1u) {}
+
+  // Returns a pseudo-random number (xorshift32), for picking steal victims.
+  uint32_t NextRandom() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+  }
+
+  const size_t index;
+  // The NUMA node the worker runs on (in a NUMA-aware pool), or -1.
+  int numa_node = -1;
+  internal::WorkStealingDeque<UniqueClosure*> deque;
+  std::unique_ptr<Thread> thread;
+  uint32_t random_state;
+  // Under the pool's |mutex_|: whether the worker has been started and hasn't
+  // stopped, and whether it has stopped (in an elastic pool) but its thread
+  // hasn't been joined yet.
+  bool active = false;
+  bool exited = false;
+};
+
+ThreadPool::DelayedTask::DelayedTask(UniqueClosure task,
+                                     TimePoint target_time,
+                                     uint64_t sequence_number)
+    : task(std::move(task)),
+      target_time(target_time),
+      sequence_number(sequence_number) {}
+
+bool ThreadPool::DelayedTask::operator>(const DelayedTask& other) const {
+  if (target_time != other.target_time)
+    return target_time > other.target_time;
+  return sequence_number > other.sequence_number;
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : ThreadPool(FixedSizeOptions(thread_count)) {}
+
+ThreadPool::ThreadPool(const ElasticOptions& options)
+    : thread_count_(options.max_thread_count),
+      elastic_(options.min_thread_count < options.max_thread_count),
+      min_thread_count_(options.min_thread_count),
+      spawn_threshold_(options.spawn_threshold),
+      idle_timeout_(options.idle_timeout),
+      live_thread_count_(0u),
+      pending_task_count_(0),
+      idle_worker_count_(0),
+      draining_(false),
+      shared_task_count_(0u),
+      user_blocking_task_count_(0u),
+      best_effort_task_count_(0u),
+      first_delayed_task_time_(
+          TimePoint::Max().ToEpochDelta().ToNanoseconds()) {
+  FTL_DCHECK(min_thread_count_ > 0u);
+  FTL_DCHECK(min_thread_count_ <= thread_count_);
+  FTL_DCHECK(spawn_threshold_ > TimeDelta::Zero());
+  for (size_t i = 0; i < thread_count_; i++)
+    workers_.emplace_back(new Worker(i));
+}
+
+ThreadPool::ThreadPool(const NumaOptions& options)
+    : ThreadPool(GetWorkerNumaNodes(options).size()) {
+  std::vector<int> worker_nodes = GetWorkerNumaNodes(options);
+  for (size_t i = 0; i < thread_count_; i++)
+    workers_[i]->numa_node = worker_nodes[i];
+}
+
+ThreadPool::~ThreadPool() {
+  Shutdown();
+
+  // Anything left was never run (it was posted before |Start()|, or was posted
+  // racily during |Shutdown()|).
+  for (auto& worker : workers_) {
+    UniqueClosure* task = nullptr;
+    while (worker->deque.Pop(&task))
+      delete task;
+  }
+  MutexLocker locker(&mutex_);
+  for (auto* queue :
+       {&shared_tasks_, &user_blocking_tasks_, &best_effort_tasks_}) {
+    for (UniqueClosure* task : *queue)
+      delete task;
+  }
+}
+
+bool ThreadPool::Start(size_t stack_size) {
+  Thread::Options options;
+  options.stack_size = stack_size;
+  return Start(options);
+}
+
+bool ThreadPool::Start(const Thread::Options& options) {
+  if (started_)
+    return false;
+  started_ = true;
+
+  // (So that the child of a fork() can take the lock.)
+  fork_handlers_.reset(
+      new ForkHandlers(&mutex_, [this]() FTL_NO_THREAD_SAFETY_ANALYSIS {
+        // Nothing is run from now on. (In particular, the condition variables
+        // mustn't be signaled, since they still count the parent's threads as
+        // waiting.)
+        forked_ = true;
+        quit_ = true;
+        draining_.store(true);
+      }));
+
+  worker_options_ = options;
+  for (size_t i = 0; i < min_thread_count_; i++) {
+    if (!StartWorker(workers_[i].get())) {
+      Shutdown();
+      return false;
+    }
+  }
+  if (elastic_) {
+    monitor_thread_.reset(new Thread([this] { MonitorMain(); }));
+    if (!monitor_thread_->Run()) {
+      monitor_thread_.reset();
+      Shutdown();
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ThreadPool::StartWorker(Worker* worker) {
+  Thread::Options options = worker_options_;
+  if (!options.name.empty())
+    options.name += "-" + std::to_string(worker->index);
+  // (Only pin workers where there's a choice of node.)
+  if (worker->numa_node >= 0 && CpuTopology::Get().nodes.size() > 1u)
+    options.numa_node = worker->numa_node;
+  worker->thread.reset(new Thread([this, worker] { WorkerMain(worker); }));
+  {
+    MutexLocker locker(&mutex_);
+    worker->active = true;
+    live_thread_count_.fetch_add(1u);
+  }
+  if (!worker->thread->Run(options)) {
+    worker->thread.reset();
+    MutexLocker locker(&mutex_);
+    worker->active = false;
+    live_thread_count_.fetch_sub(1u);
+    return false;
+  }
+  return true;
+}
+
+void ThreadPool::Shutdown() {
+  FTL_DCHECK(!RunsTasksOnCurrentThread());
+  if (!started_)
+    return;
+
+  draining_.store(true);
+  {
+    MutexLocker locker(&mutex_);
+    while (!forked_ && pending_task_count_.load() > 0 &&
+           live_thread_count_.load() > 0u) {
+      drained_cv_.Wait(&mutex_);
+    }
+    quit_ = true;
+    if (!forked_) {
+      work_available_cv_.SignalAll();
+      monitor_cv_.Signal();
+    }
+  }
+
+  // (The monitor starts and joins workers, so it has to go first.)
+  if (monitor_thread_)
+    monitor_thread_->Join();
+  for (auto& worker : workers_) {
+    if (worker->thread)
+      worker->thread->Join();
+  }
+
+  std::vector<DelayedTask> delayed_tasks;
+  {
+    MutexLocker locker(&mutex_);
+    delayed_tasks.swap(delayed_tasks_);
+  }
+}
+
+void ThreadPool::PostTask(UniqueClosure task) {
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task));
+
+  if (g_current_pool == this) {
+    // Fast path: push onto this worker's own deque without locking.
+    pending_task_count_.fetch_add(1);
+    workers_[g_current_worker_index]->deque.Push(
+        new UniqueClosure(std::move(task)));
+    WakeIdleWorkers(1u);
+    return;
+  }
+
+  MutexLocker locker(&mutex_);
+  if (draining_.load())
+    return;
+  pending_task_count_.fetch_add(1);
+  shared_tasks_.push_back(new UniqueClosure(std::move(task)));
+  shared_task_count_.store(shared_tasks_.size(), std::memory_order_relaxed);
+  SignalIdleWorkersLocked(1u);
+}
+
+void ThreadPool::PostTaskForTime(UniqueClosure task, TimePoint target_time) {
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task), target_time);
+
+  MutexLocker locker(&mutex_);
+  if (quit_)
+    return;
+  delayed_tasks_.emplace_back(std::move(task), target_time,
+                              next_sequence_number_++);
+  std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(),
+                 std::greater<DelayedTask>());
+  UpdateFirstDelayedTaskTimeLocked();
+  // Idle workers sleep until the first delayed task is due, so one of them
+  // needs to recompute its deadline.
+  if (idle_worker_count_.load() > 0 &&
+      delayed_tasks_.front().target_time == target_time)
+    work_available_cv_.Signal();
+}
+
+void ThreadPool::PostDelayedTask(UniqueClosure task, TimeDelta delay) {
+  PostTaskForTime(std::move(task), TimePoint::Now() + delay);
+}
+
+void ThreadPool::PostTaskWithPriority(UniqueClosure task,
+                                      TaskPriority priority) {
+  if (priority == TaskPriority::kNormal) {
+    PostTask(std::move(task));
+    return;
+  }
+  FTL_DCHECK(task);
+  task = TraceTask(std::move(task));
+
+  MutexLocker locker(&mutex_);
+  // As with |PostTask()|, tasks posted from workers are still accepted while
+  // draining.
+  if (g_current_pool != this && draining_.load())
+    return;
+  pending_task_count_.fetch_add(1);
+  if (priority == TaskPriority::kUserBlocking) {
+    user_blocking_tasks_.push_back(new UniqueClosure(std::move(task)));
+    user_blocking_task_count_.store(user_blocking_tasks_.size(),
+                                    std::memory_order_relaxed);
+  } else {
+    best_effort_tasks_.push_back(new UniqueClosure(std::move(task)));
+    best_effort_task_count_.store(best_effort_tasks_.size(),
+                                  std::memory_order_relaxed);
+  }
+  SignalIdleWorkersLocked(1u);
+}
+
+void ThreadPool::PostTasks(std::vector<UniqueClosure> tasks) {
+  for (const auto& task : tasks)
+    FTL_DCHECK(task);
+  if (tasks.empty())
+    return;
+  TraceTasks(&tasks);
+
+  if (g_current_pool == this) {
+    pending_task_count_.fetch_add(static_cast<int64_t>(tasks.size()));
+    auto& deque = workers_[g_current_worker_index]->deque;
+    for (auto& task : tasks)
+      deque.Push(new UniqueClosure(std::move(task)));
+    WakeIdleWorkers(tasks.size());
+    return;
+  }
+
+  MutexLocker locker(&mutex_);
+  if (draining_.load())
+    return;
+  pending_task_count_.fetch_add(static_cast<int64_t>(tasks.size()));
+  for (auto& task : tasks)
+    shared_tasks_.push_back(new UniqueClosure(std::move(task)));
+  shared_task_count_.store(shared_tasks_.size(), std::memory_order_relaxed);
+  SignalIdleWorkersLocked(tasks.size());
+}
+
+void ThreadPool::PostTasksForTime(std::vector<UniqueClosure> tasks,
+                                  TimePoint target_time) {
+  if (tasks.empty())
+    return;
+  TraceTasks(&tasks, target_time);
+
+  MutexLocker locker(&mutex_);
+  if (quit_)
+    return;
+  for (auto& task : tasks) {
+    FTL_DCHECK(task);
+    delayed_tasks_.emplace_back(std::move(task), target_time,
+                                next_sequence_number_++);
+    std::push_heap(delayed_tasks_.begin(), delayed_tasks_.end(),
+                   std::greater<DelayedTask>());
+  }
+  UpdateFirstDelayedTaskTimeLocked();
+  if (idle_worker_count_.load() > 0 &&
+      delayed_tasks_.front().target_time == target_time)
+    work_available_cv_.Signal();
+}
+
+bool ThreadPool::RunsTasksOnCurrentThread() {
+  return g_current_pool == this;
+}
+
+int ThreadPool::current_numa_node() const {
+  if (g_current_pool != this)
+    return -1;
+  return workers_[g_current_worker_index]->numa_node;
+}
+
+void ThreadPool::WorkerMain(Worker* worker) {
+  FTL_DCHECK(!g_current_pool);
+  g_current_pool = this;
+  g_current_worker_index = worker->index;
+
+  uint32_t tick = 0u;
+  for (;;) {
+    UniqueClosure* task = FindTask(worker, ++tick);
+    if (task) {
+      RunTask(task);
+      continue;
+    }
+    if (!WaitForWork(worker))
+      break;
+  }
+
+  g_current_pool = nullptr;
+}
+
+UniqueClosure* ThreadPool::FindTask(Worker* worker, uint32_t tick) {
+  UniqueClosure* task = nullptr;
+  if ((task = TakePrioritizedTask(&user_blocking_tasks_,
+                                  &user_blocking_task_count_)))
+    return task;
+  if (tick % kSharedQueueCheckInterval == 0u && (task = TakeSharedTask()))
+    return task;
+  if (tick % kBestEffortQueueCheckInterval == 0u &&
+      (task = TakePrioritizedTask(&best_effort_tasks_,
+                                  &best_effort_task_count_)))
+    return task;
+  if (worker->deque.Pop(&task))
+    return task;
+  if ((task = TakeSharedTask()))
+    return task;
+  if ((task = StealTask(worker)))
+    return task;
+  return TakePrioritizedTask(&best_effort_tasks_, &best_effort_task_count_);
+}
+
+UniqueClosure* ThreadPool::TakeSharedTask() {
+  // Avoid the lock entirely in the common case where workers are only feeding
+  // (and stealing from) each other.
+  TimePoint now = TimePoint::Now();
+  if (shared_task_count_.load(std::memory_order_relaxed) == 0u &&
+      now.ToEpochDelta().ToNanoseconds() <
+          first_delayed_task_time_.load(std::memory_order_relaxed))
+    return nullptr;
+
+  MutexLocker locker(&mutex_);
+  EnqueueDueDelayedTasksLocked(now);
+  if (shared_tasks_.empty())
+    return nullptr;
+  UniqueClosure* task = shared_tasks_.front();
+  shared_tasks_.pop_front();
+  shared_task_count_.store(shared_tasks_.size(), std::memory_order_relaxed);
+  return task;
+}
+
+UniqueClosure* ThreadPool::TakePrioritizedTask(
+    std::deque<UniqueClosure*>* queue,
+    std::atomic<size_t>* queue_size) {
+  if (queue_size->load(std::memory_order_relaxed) == 0u)
+    return nullptr;
+
+  MutexLocker locker(&mutex_);
+  if (queue->empty())
+    return nullptr;
+  UniqueClosure* task = queue->front();
+  queue->pop_front();
+  queue_size->store(queue->size(), std::memory_order_relaxed);
+  return task;
+}
+
+UniqueClosure* ThreadPool::StealTask(Worker* worker) {
+  if (thread_count_ < 2u)
+    return nullptr;
+
+  // Start at a random victim and go around the others once, trying the ones
+  // on the same NUMA node (if any) first.
+  size_t start = worker->NextRandom() % thread_count_;
+  for (bool same_node : {true, false}) {
+    if (same_node && worker->numa_node < 0)
+      continue;
+    for (size_t i = 0; i < thread_count_; i++) {
+      Worker* victim = workers_[(start + i) % thread_count_].get();
+      if (victim == worker ||
+          (worker->numa_node >= 0 &&
+           (victim->numa_node == worker->numa_node) != same_node))
+        continue;
+      UniqueClosure* task = nullptr;
+      if (victim->deque.Steal(&task))
+        return task;
+    }
+  }
+  return nullptr;
+}
+
+void ThreadPool::RunTask(UniqueClosure* task) {
+  {
+    FTL_TRACE_EVENT("ftl", "ThreadPool::RunTask");
+    (*task)();
+    delete task;
+  }
+
+  if (pending_task_count_.fetch_sub(1) == 1 && draining_.load()) {
+    MutexLocker locker(&mutex_);
+    drained_cv_.SignalAll();
+  }
+}
+
+bool ThreadPool::WaitForWork(Worker* worker) {
+  MutexLocker locker(&mutex_);
+  // Announce that we're going idle *before* rechecking the deques: a worker
+  // which pushes onto its deque fences and then checks |idle_worker_count_|
+  // (see |WakeIdleWorkers()|), so one of us is guaranteed to see the other.
+  idle_worker_count_.fetch_add(1);
+  bool keep_running = true;
+  TimePoint idle_start = TimePoint::Now();
+  for (;;) {
+    if (quit_) {
+      worker->active = false;
+      live_thread_count_.fetch_sub(1u);
+      keep_running = false;
+      break;
+    }
+    TimePoint now = TimePoint::Now();
+    EnqueueDueDelayedTasksLocked(now);
+    if (HasQueuedTasksLocked())
+      break;
+
+    TimeDelta timeout = delayed_tasks_.empty()
+                            ? TimeDelta::Max()
+                            : delayed_tasks_.front().target_time - now;
+    if (elastic_ && live_thread_count_.load() > min_thread_count_) {
+      TimeDelta idle_time_left = idle_timeout_ - (now - idle_start);
+      if (idle_time_left <= TimeDelta::Zero()) {
+        // Stop, leaving the thread for the monitor to join.
+        worker->active = false;
+        worker->exited = true;
+        live_thread_count_.fetch_sub(1u);
+        monitor_cv_.Signal();
+        keep_running = false;
+        break;
+      }
+      timeout = std::min(timeout, idle_time_left);
+    }
+
+    if (timeout == TimeDelta::Max())
+      work_available_cv_.Wait(&mutex_);
+    else
+      work_available_cv_.WaitWithTimeout(&mutex_, timeout);
+  }
+  // The monitor only needs to watch for tasks being kept waiting while no
+  // worker is idle.
+  if (idle_worker_count_.fetch_sub(1) == 1 && elastic_ && keep_running)
+    monitor_cv_.Signal();
+  return keep_running;
+}
+
+void ThreadPool::MonitorMain() {
+  // When tasks were first seen to be kept waiting (since a worker was last
+  // started), or |TimePoint::Max()| if they aren't.
+  TimePoint stall_start = TimePoint::Max();
+  TimeDelta poll_interval =
+      std::max(spawn_threshold_ / 4, TimeDelta::FromMilliseconds(1));
+  for (;;) {
+    std::vector<std::unique_ptr<Thread>> exited_threads;
+    Worker* new_worker = nullptr;
+    {
+      MutexLocker locker(&mutex_);
+      if (quit_)
+        return;
+      for (auto& worker : workers_) {
+        if (worker->exited) {
+          worker->exited = false;
+          exited_threads.push_back(std::move(worker->thread));
+        }
+      }
+
+      TimePoint now = TimePoint::Now();
+      if (idle_worker_count_.load() > 0 || !HasQueuedTasksLocked()) {
+        stall_start = TimePoint::Max();
+      } else if (stall_start == TimePoint::Max()) {
+        stall_start = now;
+      } else if (now - stall_start >= spawn_threshold_) {
+        stall_start = now;
+        for (auto& worker : workers_) {
+          if (!worker->active && !worker->exited && !worker->thread) {
+            new_worker = worker.get();
+            break;
+          }
+        }
+      }
+
+      if (exited_threads.empty() && !new_worker) {
+        // Poll while tasks may be kept waiting; otherwise wait for a worker
+        // to become busy (or stop).
+        if (idle_worker_count_.load() > 0)
+          monitor_cv_.Wait(&mutex_);
+        else
+          monitor_cv_.WaitWithTimeout(&mutex_, poll_interval);
+        continue;
+      }
+    }
+
+    for (auto& thread : exited_threads)
+      thread->Join();
+    if (new_worker && !StartWorker(new_worker))
+      FTL_LOG(ERROR) << "Failed to start a thread pool worker";
+  }
+}
+
+void ThreadPool::EnqueueDueDelayedTasksLocked(TimePoint now) {
+  while (!delayed_tasks_.empty() && delayed_tasks_.front().target_time <= now) {
+    std::pop_heap(delayed_tasks_.begin(), delayed_tasks_.end(),
+                  std::greater<DelayedTask>());
+    pending_task_count_.fetch_add(1);
+    shared_tasks_.push_back(
+        new UniqueClosure(std::move(delayed_tasks_.back().task)));
+    delayed_tasks_.pop_back();
+  }
+  shared_task_count_.store(shared_tasks_.size(), std::memory_order_relaxed);
+  UpdateFirstDelayedTaskTimeLocked();
+}
+
+void ThreadPool::UpdateFirstDelayedTaskTimeLocked() {
+  first_delayed_task_time_.store(
+      delayed_tasks_.empty()
+          ? TimePoint::Max().ToEpochDelta().ToNanoseconds()
+          : delayed_tasks_.front().target_time.ToEpochDelta().ToNanoseconds(),
+      std::memory_order_relaxed);
+}
+
+bool ThreadPool::HasQueuedTasksLocked() const {
+  return !shared_tasks_.empty() || !user_blocking_tasks_.empty() ||
+         !best_effort_tasks_.empty() || AnyDequeHasTasks();
+}
+
+bool ThreadPool::AnyDequeHasTasks() const {
+  for (const auto& worker : workers_) {
+    if (!worker->deque.IsEmpty())
+      return true;
+  }
+  return false;
+}
+
+void ThreadPool::WakeIdleWorkers(size_t count) {
+  if (!count)
+    return;
+  // The caller's push onto its deque is only a release store, which could
+  // otherwise be reordered after the load below (e.g., sit in the store
+  // buffer), letting a worker in |WaitForWork()| miss the task while we miss
+  // the worker. The fence pairs with that worker's sequentially consistent
+  // increment of |idle_worker_count_| and its rechecks of the deques: either
+  // it sees the task or we see it idle.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (idle_worker_count_.load() == 0)
+    return;
+  MutexLocker locker(&mutex_);
+  SignalIdleWorkersLocked(count);
+}
+
+void ThreadPool::SignalIdleWorkersLocked(size_t count) {
+  size_t idle_count = static_cast<size_t>(idle_worker_count_.load());
+  if (count >= idle_count) {
+    if (idle_count)
+      work_available_cv_.SignalAll();
+    return;
+  }
+  for (size_t i = 0u; i < count; i++)
+    work_available_cv_.Signal();
+}
+
+}  // namespace ftl
@@ -0,0 +1,239 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_THREAD_POOL_H_
+#define LIB_FTL_TASKS_THREAD_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/cond_var.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/tasks/work_stealing_deque.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A |TaskRunner| that runs tasks concurrently on a fixed number of worker
+// threads. Use like:
+//
+//   auto pool = MakeRefCounted<ThreadPool>(4);
+//   pool->Start();
+//   pool->PostTask([] { ... });
+//   ...
+//   pool->Shutdown();
+//
+// Each worker has its own work-stealing deque: tasks posted from a worker are
+// pushed onto that worker's deque without taking any locks, and idle workers
+// steal from randomly chosen victims. Tasks posted from other threads (and
+// delayed tasks, once due) go through a shared queue. No ordering is guaranteed
+// between tasks.
+//
+// Tasks posted with |TaskPriority::kUserBlocking| go through a separate shared
+// queue, which workers check before anything else. Ones posted with
+// |TaskPriority::kBestEffort| are only run once a worker has run out of other
+// work (or every so often, so that they can't be starved).
+//
+// On machines with several NUMA nodes, a pool may be NUMA-aware (see
+// |NumaOptions|): it has a group of workers for each node, which only run on
+// that node's CPUs, and which steal from each other before they steal from
+// other nodes' workers, so that tasks posted from a worker (and the memory
+// they touch; see |current_numa_node()|) tend to stay on its node.
+//
+// A pool may instead be elastic (see |ElasticOptions|), for tasks which may
+// block (e.g., on disk I/O): it starts with a few workers, starts more while
+// tasks are kept waiting because all of them are busy, and stops the extra
+// ones once they have been idle for a while.
+//
+// In the child of a fork(), a pool which was started in the parent has no
+// workers: tasks posted to it are dropped, as are the ones it was holding,
+// when it's shut down.
+class FTL_EXPORT ThreadPool : public TaskRunner {
+ public:
+  // For |MakeRefCounted<ThreadPool>(elastic_options)|.
+  struct ElasticOptions {
+    // The number of workers started by |Start()|, which are never stopped.
+    size_t min_thread_count = 1u;
+    // The most workers there may be at once.
+    size_t max_thread_count = 64u;
+    // Another worker is started whenever tasks have been queued, with no
+    // worker idle, for this long. (A separate thread checks for this, only
+    // while no worker is idle.)
+    TimeDelta spawn_threshold = TimeDelta::FromMilliseconds(100);
+    // Workers beyond |min_thread_count| stop once they have been idle for this
+    // long.
+    TimeDelta idle_timeout = TimeDelta::FromSeconds(30);
+  };
+
+  // For |MakeRefCounted<ThreadPool>(numa_options)|.
+  struct NumaOptions {
+    // The number of workers for each NUMA node, or 0 for one per CPU of the
+    // node (see |CpuTopology|).
+    size_t threads_per_node = 0u;
+  };
+
+  // Starts the worker threads. Returns false if the pool was already started or
+  // any thread could not be created.
+  bool Start(size_t stack_size = Thread::default_stack_size);
+  // Like |Start()|, but creates the worker threads (including ones an elastic
+  // pool starts later) with the given |options|. If |options.name| is set,
+  // each worker's name is suffixed with its index (e.g., "io-0", "io-1", ...).
+  bool Start(const Thread::Options& options);
+
+  // Waits for all immediate tasks (including ones posted by running tasks) to
+  // complete, then stops the workers and waits for them to exit. Delayed tasks
+  // that are not yet due are dropped, as are tasks posted from other threads
+  // after this is called. Must not be called from a worker thread.
+  void Shutdown();
+
+  // The number of workers (for an elastic pool, the most there may be).
+  size_t thread_count() const { return thread_count_; }
+  // The number of workers which are currently running.
+  size_t live_thread_count() const { return live_thread_count_.load(); }
+
+  // Returns the NUMA node of the calling worker of a NUMA-aware pool (e.g.,
+  // for an |Arena| of node-local memory), or -1 if there isn't one.
+  int current_numa_node() const;
+
+  // |TaskRunner|:
+  using TaskRunner::PostDelayedTask;
+  using TaskRunner::PostTask;
+  void PostTask(UniqueClosure task) override;
+  void PostTaskForTime(UniqueClosure task, TimePoint target_time) override;
+  void PostDelayedTask(UniqueClosure task, TimeDelta delay) override;
+  void PostTaskWithPriority(UniqueClosure task, TaskPriority priority) override;
+  void PostTasks(std::vector<UniqueClosure> tasks) override;
+  void PostTasksForTime(std::vector<UniqueClosure> tasks,
+                        TimePoint target_time) override;
+  // Returns true on any of this pool's worker threads.
+  bool RunsTasksOnCurrentThread() override;
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(ThreadPool);
+  FRIEND_REF_COUNTED_THREAD_SAFE(ThreadPool);
+
+  struct Worker;
+
+  struct DelayedTask {
+    DelayedTask(UniqueClosure task,
+                TimePoint target_time,
+                uint64_t sequence_number);
+
+    // For the min-heap in |delayed_tasks_|: "greater" means "runs later".
+    bool operator>(const DelayedTask& other) const;
+
+    UniqueClosure task;
+    TimePoint target_time;
+    uint64_t sequence_number;
+  };
+
+  explicit ThreadPool(size_t thread_count);
+  explicit ThreadPool(const ElasticOptions& options);
+  explicit ThreadPool(const NumaOptions& options);
+  ~ThreadPool() override;
+
+  // Starts |worker|'s thread (with |worker_options_|).
+  bool StartWorker(Worker* worker);
+  void WorkerMain(Worker* worker);
+  // The body of an elastic pool's monitor thread, which starts workers when
+  // tasks are kept waiting, and joins the ones which have stopped.
+  void MonitorMain();
+
+  // Finds a task to run: a user-blocking task, or else one from |worker|'s own
+  // deque, the shared queue, another worker's deque or the best-effort queue
+  // (in that order, except that the shared and best-effort queues are checked
+  // first every so often so that they can't be starved).
+  UniqueClosure* FindTask(Worker* worker, uint32_t tick);
+  UniqueClosure* TakeSharedTask();
+  // Takes a task from |queue| (one of the prioritized queues), whose size is
+  // mirrored by |queue_size|.
+  UniqueClosure* TakePrioritizedTask(std::deque<UniqueClosure*>* queue,
+                                     std::atomic<size_t>* queue_size);
+  UniqueClosure* StealTask(Worker* worker);
+  void RunTask(UniqueClosure* task);
+
+  // Blocks until there may be work. Returns false if |worker| should exit
+  // (because the pool is quitting, or it was idle for too long).
+  bool WaitForWork(Worker* worker);
+
+  // Moves delayed tasks which are due to |shared_tasks_|.
+  void EnqueueDueDelayedTasksLocked(TimePoint now)
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void UpdateFirstDelayedTaskTimeLocked() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool AnyDequeHasTasks() const;
+  bool HasQueuedTasksLocked() const FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Wakes up to |count| idle workers, if there are any.
+  void WakeIdleWorkers(size_t count);
+  void SignalIdleWorkersLocked(size_t count)
+      FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // For an elastic pool, |workers_| has a slot for each worker there may be,
+  // of which only |live_thread_count_| are running.
+  const size_t thread_count_;
+  const bool elastic_;
+  const size_t min_thread_count_;
+  const TimeDelta spawn_threshold_;
+  const TimeDelta idle_timeout_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  bool started_ = false;
+  Thread::Options worker_options_;
+  std::unique_ptr<Thread> monitor_thread_;
+
+  // Written under |mutex_|.
+  std::atomic<size_t> live_thread_count_;
+
+  // Immediate tasks which have been posted but have not yet completed.
+  std::atomic<int64_t> pending_task_count_;
+  std::atomic<int> idle_worker_count_;
+  std::atomic<bool> draining_;
+  // Lock-free hints (written under |mutex_|) so that workers can skip taking
+  // |mutex_| when there is nothing for them in the shared queue.
+  std::atomic<size_t> shared_task_count_;
+  std::atomic<size_t> user_blocking_task_count_;
+  std::atomic<size_t> best_effort_task_count_;
+  std::atomic<int64_t> first_delayed_task_time_;
+
+  Mutex mutex_;
+  // Signaled when the shared queues or |delayed_tasks_| gain a task, or when
+  // the workers should exit.
+  CondVar work_available_cv_;
+  // Signaled when |pending_task_count_| drops to zero while draining.
+  CondVar drained_cv_;
+  // Signaled (for an elastic pool) when the last idle worker becomes busy, or
+  // a worker stops, or the pool quits.
+  CondVar monitor_cv_;
+  std::deque<UniqueClosure*> shared_tasks_ FTL_GUARDED_BY(mutex_);
+  std::deque<UniqueClosure*> user_blocking_tasks_ FTL_GUARDED_BY(mutex_);
+  std::deque<UniqueClosure*> best_effort_tasks_ FTL_GUARDED_BY(mutex_);
+  // A min-heap (using |std::push_heap()|/|std::pop_heap()|) ordered by target
+  // time.
+  std::vector<DelayedTask> delayed_tasks_ FTL_GUARDED_BY(mutex_);
+  uint64_t next_sequence_number_ FTL_GUARDED_BY(mutex_) = 0u;
+  bool quit_ FTL_GUARDED_BY(mutex_) = false;
+  // Set in the child of a fork(), where the workers are gone.
+  bool forked_ FTL_GUARDED_BY(mutex_) = false;
+  // Once started, keep |mutex_| across fork()s.
+  std::unique_ptr<ForkHandlers> fork_handlers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_THREAD_POOL_H_
@@ -0,0 +1,288 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/test/forked_child.h"
+#include "lib/ftl/test/timeout_tolerance.h"
+#include "lib/ftl/threading/cpu_topology.h"
+#include "lib/ftl/time/stopwatch.h"
+
+namespace ftl {
+namespace {
+
+TEST(ThreadPoolTest, StartAndShutdown) {
+  auto pool = MakeRefCounted<ThreadPool>(4);
+  EXPECT_EQ(4u, pool->thread_count());
+  EXPECT_TRUE(pool->Start());
+  EXPECT_FALSE(pool->Start());
+  EXPECT_FALSE(pool->RunsTasksOnCurrentThread());
+  pool->Shutdown();
+}
+
+TEST(ThreadPoolTest, RunsTasksOnWorkers) {
+  auto pool = MakeRefCounted<ThreadPool>(4);
+  EXPECT_TRUE(pool->Start());
+  std::atomic<int> on_worker_count(0);
+  for (int i = 0; i < 100; i++) {
+    pool->PostTask([&pool, &on_worker_count] {
+      if (pool->RunsTasksOnCurrentThread())
+        on_worker_count.fetch_add(1);
+    });
+  }
+  pool->Shutdown();
+  EXPECT_EQ(100, on_worker_count.load());
+}
+
+// Each task fans out into two more, down to a fixed depth, so that nearly all
+// tasks are posted from workers (and have to be stolen to spread out).
+TEST(ThreadPoolTest, FanOutDrainsOnShutdown) {
+  auto pool = MakeRefCounted<ThreadPool>(4);
+  EXPECT_TRUE(pool->Start());
+  std::atomic<int> run_count(0);
+  std::function<void(int)> fan_out = [&](int depth) {
+    run_count.fetch_add(1);
+    if (depth == 0)
+      return;
+    pool->PostTask([&fan_out, depth] { fan_out(depth - 1); });
+    pool->PostTask([&fan_out, depth] { fan_out(depth - 1); });
+  };
+  pool->PostTask([&fan_out] { fan_out(12); });
+  pool->Shutdown();
+  EXPECT_EQ((1 << 13) - 1, run_count.load());
+}
+
+#if defined(OS_LINUX)
+TEST(ThreadPoolTest, StartWithOptions) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  Thread::Options options;
+  options.name = "pool";
+  options.cpu_affinity.push_back(0u);
+  EXPECT_TRUE(pool->Start(options));
+  std::atomic<int> named_count(0);
+  for (int i = 0; i < 2; i++) {
+    pool->PostTask([&named_count] {
+      char name[16] = {};
+      pthread_getname_np(pthread_self(), name, sizeof(name));
+      if (std::string(name) == "pool-0" || std::string(name) == "pool-1")
+        named_count.fetch_add(1);
+    });
+  }
+  pool->Shutdown();
+  EXPECT_EQ(2, named_count.load());
+}
+#endif  // defined(OS_LINUX)
+
+TEST(ThreadPoolTest, SingleThread) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  EXPECT_TRUE(pool->Start());
+  std::atomic<int> run_count(0);
+  for (int i = 0; i < 10; i++) {
+    pool->PostTask([&pool, &run_count] {
+      run_count.fetch_add(1);
+      pool->PostTask([&run_count] { run_count.fetch_add(1); });
+    });
+  }
+  pool->Shutdown();
+  EXPECT_EQ(20, run_count.load());
+}
+
+TEST(ThreadPoolTest, DelayedTask) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  EXPECT_TRUE(pool->Start());
+  ManualResetWaitableEvent done;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  pool->PostDelayedTask([&done] { done.Signal(); },
+                        TimeDelta::FromMilliseconds(20));
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(),
+            TimeDelta::FromMilliseconds(20) - kTimeoutTolerance);
+  pool->Shutdown();
+}
+
+TEST(ThreadPoolTest, PostTasks) {
+  auto pool = MakeRefCounted<ThreadPool>(4);
+  EXPECT_TRUE(pool->Start());
+  std::atomic<int> run_count(0);
+  std::vector<UniqueClosure> tasks;
+  for (int i = 0; i < 64; i++) {
+    tasks.push_back([&pool, &run_count] {
+      // Batches posted from a worker go onto its own deque.
+      std::vector<UniqueClosure> subtasks;
+      for (int j = 0; j < 4; j++)
+        subtasks.push_back([&run_count] { run_count.fetch_add(1); });
+      pool->PostTasks(std::move(subtasks));
+      run_count.fetch_add(1);
+    });
+  }
+  pool->PostTasks(std::move(tasks));
+  pool->Shutdown();
+  EXPECT_EQ(64 * 5, run_count.load());
+}
+
+TEST(ThreadPoolTest, PostDelayedTasks) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  EXPECT_TRUE(pool->Start());
+  std::atomic<int> run_count(0);
+  AutoResetWaitableEvent done;
+  Stopwatch stopwatch;
+  stopwatch.Start();
+  std::vector<UniqueClosure> tasks;
+  for (int i = 0; i < 10; i++) {
+    tasks.push_back([&run_count, &done] {
+      if (run_count.fetch_add(1) == 9)
+        done.Signal();
+    });
+  }
+  pool->PostDelayedTasks(std::move(tasks), TimeDelta::FromMilliseconds(20));
+  done.Wait();
+  EXPECT_GE(stopwatch.Elapsed(),
+            TimeDelta::FromMilliseconds(20) - kTimeoutTolerance);
+  pool->Shutdown();
+}
+
+TEST(ThreadPoolTest, Priorities) {
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  std::vector<int> order;
+  pool->PostTaskWithPriority([&order] { order.push_back(-1); },
+                             TaskPriority::kBestEffort);
+  for (int i = 1; i <= 3; i++)
+    pool->PostTask([&order, i] { order.push_back(i); });
+  pool->PostTaskWithPriority([&order] { order.push_back(0); },
+                             TaskPriority::kUserBlocking);
+  EXPECT_TRUE(pool->Start());
+  pool->Shutdown();
+  EXPECT_EQ((std::vector<int>{0, 1, 2, 3, -1}), order);
+}
+
+TEST(ThreadPoolTest, CancelableTasks) {
+  // Cancel tasks from another thread while the (single) worker is blocked.
+  auto pool = MakeRefCounted<ThreadPool>(1);
+  EXPECT_TRUE(pool->Start());
+  ManualResetWaitableEvent unblock;
+  pool->PostTask([&unblock] { unblock.Wait(); });
+  CancellationSource canceled;
+  CancellationSource not_canceled;
+  std::atomic<int> run_count(0);
+  for (int i = 0; i < 10; i++) {
+    pool->PostCancelableTask([&run_count] { run_count.fetch_add(1); },
+                             canceled.token());
+    pool->PostCancelableTask([&run_count] { run_count.fetch_add(100); },
+                             not_canceled.token());
+  }
+  std::thread([&canceled] { canceled.Cancel(); }).join();
+  unblock.Signal();
+  pool->Shutdown();
+  EXPECT_EQ(1000, run_count.load());
+}
+
+TEST(ThreadPoolTest, ShutdownDropsFutureDelayedTasks) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  EXPECT_TRUE(pool->Start());
+  bool did_run = false;
+  pool->PostDelayedTask([&did_run] { did_run = true; },
+                        TimeDelta::FromSeconds(100));
+  pool->Shutdown();
+  pool->PostTask([&did_run] { did_run = true; });
+  EXPECT_FALSE(did_run);
+}
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+TEST(ThreadPoolTest, ElasticGrowsAndShrinks) {
+  ThreadPool::ElasticOptions options;
+  options.min_thread_count = 1u;
+  options.max_thread_count = 4u;
+  options.spawn_threshold = TimeDelta::FromMilliseconds(5);
+  options.idle_timeout = TimeDelta::FromMilliseconds(20);
+  auto pool = MakeRefCounted<ThreadPool>(options);
+  EXPECT_EQ(4u, pool->thread_count());
+  EXPECT_TRUE(pool->Start());
+  EXPECT_EQ(1u, pool->live_thread_count());
+
+  // Blocking tasks get a worker each (but no more than the maximum).
+  std::atomic<int> started_count(0);
+  ManualResetWaitableEvent proceed;
+  for (int i = 0; i < 6; i++) {
+    pool->PostTask([&started_count, &proceed] {
+      started_count.fetch_add(1);
+      proceed.Wait();
+    });
+  }
+  while (started_count.load() < 4)
+    SleepFor(TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(4u, pool->live_thread_count());
+
+  // Once they're done, the extra workers stop.
+  proceed.Signal();
+  while (pool->live_thread_count() > 1u)
+    SleepFor(TimeDelta::FromMilliseconds(1));
+  EXPECT_EQ(6, started_count.load());
+
+  // And are restarted as needed.
+  ManualResetWaitableEvent proceed_again;
+  for (int i = 0; i < 2; i++) {
+    pool->PostTask([&started_count, &proceed_again] {
+      started_count.fetch_add(1);
+      proceed_again.Wait();
+    });
+  }
+  while (started_count.load() < 8)
+    SleepFor(TimeDelta::FromMilliseconds(1));
+  proceed_again.Signal();
+  pool->Shutdown();
+  EXPECT_EQ(0u, pool->live_thread_count());
+}
+
+TEST(ThreadPoolTest, NumaAware) {
+  ThreadPool::NumaOptions options;
+  options.threads_per_node = 2u;
+  auto pool = MakeRefCounted<ThreadPool>(options);
+  const CpuTopology& topology = CpuTopology::Get();
+  EXPECT_EQ(2u * topology.nodes.size(), pool->thread_count());
+  EXPECT_EQ(-1, pool->current_numa_node());
+  EXPECT_TRUE(pool->Start());
+
+  std::atomic<int> on_node_count(0);
+  for (int i = 0; i < 100; i++) {
+    pool->PostTask([&pool, &topology, &on_node_count] {
+      int node = pool->current_numa_node();
+      if (std::find(topology.nodes.begin(), topology.nodes.end(),
+                    static_cast<size_t>(node)) != topology.nodes.end())
+        on_node_count.fetch_add(1);
+    });
+  }
+  pool->Shutdown();
+  EXPECT_EQ(100, on_node_count.load());
+}
+
+TEST(ThreadPoolTest, ForkedChildDropsTasks) {
+  auto pool = MakeRefCounted<ThreadPool>(2);
+  EXPECT_TRUE(pool->Start());
+  std::atomic<int> run_count(0);
+  EXPECT_TRUE(RunInForkedChild([&pool, &run_count] {
+    // The child has no workers, so this mustn't wait for them.
+    pool->PostTask([&run_count] { run_count.fetch_add(1); });
+    pool->Shutdown();
+    return run_count.load() == 0;
+  }));
+  pool->PostTask([&run_count] { run_count.fetch_add(1); });
+  pool->Shutdown();
+  EXPECT_EQ(1, run_count.load());
+}
+#endif  // !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,62 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/throttler.h"
+
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+
+Throttler::Throttler(RefPtr<TaskRunner> task_runner,
+                     UniqueClosure task,
+                     TimeDelta interval,
+                     bool trailing)
+    : task_runner_(std::move(task_runner)),
+      task_(std::move(task)),
+      interval_(interval),
+      trailing_(trailing) {
+  FTL_DCHECK(task_runner_);
+  FTL_DCHECK(task_);
+  FTL_DCHECK(interval_ >= TimeDelta::Zero());
+}
+
+Throttler::~Throttler() {
+  if (destroyed_flag_)
+    *destroyed_flag_ = true;
+}
+
+void Throttler::Call() {
+  if (timer_.is_started())
+    return;
+  TimePoint now = task_runner_->Now();
+  if (now >= next_run_time_) {
+    RunTask();
+  } else if (trailing_) {
+    timer_.Start(task_runner_.get(), [this] { RunTask(); },
+                 next_run_time_ - now);
+  }
+}
+
+void Throttler::Cancel() {
+  timer_.Stop();
+}
+
+void Throttler::RunTask() {
+  timer_.Stop();
+  next_run_time_ = task_runner_->Now() + interval_;
+
+  // Run the task from a local, since it may call or destroy this.
+  UniqueClosure task = std::move(task_);
+  bool destroyed = false;
+  destroyed_flag_ = &destroyed;
+  task();
+  if (destroyed)
+    return;
+  destroyed_flag_ = nullptr;
+  task_ = std::move(task);
+}
+
+}  // namespace ftl
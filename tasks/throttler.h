@@ -0,0 +1,64 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_THROTTLER_H_
+#define LIB_FTL_TASKS_THROTTLER_H_
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/tasks/one_shot_timer.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// Runs a task at most once per |interval|, however often it's |Call()|ed, e.g.,
+// to refresh a view as data streams in.
+//
+// A |Call()| at least |interval| after the task last ran runs it immediately.
+// Otherwise, if |trailing| is true, the task runs (on |task_runner|) once the
+// interval is up, so that the last |Call()| of a burst is never lost; if it's
+// false, the |Call()| is dropped.
+//
+// It may only be used on the same thread as the task runner.
+class FTL_EXPORT Throttler {
+ public:
+  Throttler(RefPtr<TaskRunner> task_runner,
+            UniqueClosure task,
+            TimeDelta interval,
+            bool trailing = true);
+  ~Throttler();
+
+  // Returns true if the task is due to run at the end of the interval.
+  bool is_pending() const { return timer_.is_started(); }
+
+  // Runs the task now, or (if |trailing|) at the end of the interval.
+  void Call();
+
+  // Stops a pending task from running.
+  void Cancel();
+
+ private:
+  void RunTask();
+
+  const RefPtr<TaskRunner> task_runner_;
+  UniqueClosure task_;
+  const TimeDelta interval_;
+  const bool trailing_;
+
+  // When the task may next run immediately.
+  TimePoint next_run_time_ = TimePoint::Min();
+  // While the task is running, points to a flag set by the destructor.
+  bool* destroyed_flag_ = nullptr;
+  OneShotTimer timer_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Throttler);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_THROTTLER_H_
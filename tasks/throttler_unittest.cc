@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/throttler.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/test/test_task_runner.h"
+
+namespace ftl {
+namespace {
+
+constexpr TimeDelta kInterval = TimeDelta::FromMilliseconds(100);
+constexpr TimeDelta kTick = TimeDelta::FromMilliseconds(1);
+
+class ThrottlerTest : public ::testing::Test {
+ protected:
+  ThrottlerTest()
+      : task_runner_(MakeRefCounted<TestTaskRunner>()),
+        start_(task_runner_->Now()) {}
+
+  // Calls |throttler| every tick for |duration|.
+  void CallFor(Throttler* throttler, TimeDelta duration) {
+    for (TimeDelta t; t < duration; t = t + kTick) {
+      throttler->Call();
+      task_runner_->AdvanceTimeBy(kTick);
+    }
+  }
+
+  UniqueClosure RecordRunTimes() {
+    return [this] { run_times_.push_back(task_runner_->Now() - start_); };
+  }
+
+  RefPtr<TestTaskRunner> task_runner_;
+  const TimePoint start_;
+  std::vector<TimeDelta> run_times_;
+};
+
+TEST_F(ThrottlerTest, Trailing) {
+  Throttler throttler(task_runner_, RecordRunTimes(), kInterval);
+  CallFor(&throttler, kInterval * 3 - kTick);
+  EXPECT_TRUE(throttler.is_pending());
+  task_runner_->AdvanceTimeBy(kInterval);
+  EXPECT_FALSE(throttler.is_pending());
+  EXPECT_EQ((std::vector<TimeDelta>{TimeDelta::Zero(), kInterval,
+                                    kInterval * 2, kInterval * 3}),
+            run_times_);
+}
+
+TEST_F(ThrottlerTest, NotTrailing) {
+  Throttler throttler(task_runner_, RecordRunTimes(), kInterval, false);
+  CallFor(&throttler, kInterval * 3 - kTick);
+  EXPECT_FALSE(throttler.is_pending());
+  EXPECT_EQ(0u, task_runner_->pending_task_count());
+  EXPECT_EQ(
+      (std::vector<TimeDelta>{TimeDelta::Zero(), kInterval, kInterval * 2}),
+      run_times_);
+}
+
+TEST_F(ThrottlerTest, Cancel) {
+  Throttler throttler(task_runner_, RecordRunTimes(), kInterval);
+  throttler.Call();
+  throttler.Call();
+  EXPECT_TRUE(throttler.is_pending());
+  throttler.Cancel();
+  task_runner_->AdvanceTimeBy(kInterval);
+  EXPECT_EQ(1u, run_times_.size());
+
+  // Once the interval is up, a call runs the task immediately.
+  throttler.Call();
+  EXPECT_EQ(2u, run_times_.size());
+  EXPECT_FALSE(throttler.is_pending());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,295 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/timer_wheel.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+// Returns the index of the lowest set bit of |word|, which must be non-zero.
+size_t LowestSetBit(uint64_t word) {
+  FTL_DCHECK(word);
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctzll(word));
+#else
+  size_t index = 0u;
+  while (!(word & 1u)) {
+    word >>= 1;
+    index++;
+  }
+  return index;
+#endif
+}
+
+}  // namespace
+
+constexpr TimeDelta TimerWheel::kDefaultResolution;
+constexpr size_t TimerWheel::kLevelCount;
+constexpr size_t TimerWheel::kSlotBits;
+constexpr size_t TimerWheel::kSlotCount;
+constexpr int64_t TimerWheel::kSlotMask;
+constexpr size_t TimerWheel::kBitmapWordCount;
+
+TimerWheel::Timer::Timer(Closure callback) : callback_(std::move(callback)) {
+  FTL_DCHECK(callback_);
+}
+
+TimerWheel::Timer::~Timer() {
+  Cancel();
+}
+
+void TimerWheel::Timer::Cancel() {
+  if (wheel_)
+    wheel_->Cancel(this);
+}
+
+TimerWheel::TimerWheel(TimePoint origin, TimeDelta resolution)
+    : origin_(origin), resolution_(resolution) {
+  FTL_DCHECK(resolution_ > TimeDelta::Zero());
+  for (auto& level : levels_) {
+    for (auto& slot : level.slots) {
+      slot.prev = &slot;
+      slot.next = &slot;
+    }
+    for (auto& word : level.occupied)
+      word = 0u;
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  for (size_t l = 0u; l < kLevelCount && size_; l++) {
+    for (auto& slot : levels_[l].slots) {
+      while (slot.next != &slot)
+        Unlink(static_cast<Timer*>(slot.next));
+    }
+  }
+  FTL_DCHECK(!size_);
+}
+
+void TimerWheel::Schedule(Timer* timer, TimePoint deadline) {
+  FTL_DCHECK(timer);
+
+  if (timer->wheel_)
+    timer->wheel_->Unlink(timer);
+  timer->wheel_ = this;
+  timer->deadline_ = deadline;
+  timer->expiration_tick_ = DeadlineToTick(deadline);
+  Place(timer);
+  size_++;
+}
+
+void TimerWheel::Cancel(Timer* timer) {
+  FTL_DCHECK(timer);
+  if (timer->wheel_ != this)
+    return;
+  Unlink(timer);
+}
+
+size_t TimerWheel::Advance(TimePoint now) {
+  if (now < origin_)
+    return 0u;
+  int64_t target_tick = (now - origin_) / resolution_;
+
+  size_t fired_count = 0u;
+  while (current_tick_ < target_tick) {
+    // Jump straight to the next tick at which anything happens.
+    int64_t tick = size_ ? NextEventTick() : target_tick + 1;
+    if (tick > target_tick) {
+      current_tick_ = target_tick;
+      break;
+    }
+
+    // At a boundary, refill lower levels from higher ones (highest first,
+    // since a timer coming down from level l may land in the slot of
+    // level l - 1 that is about to be cascaded).
+    current_tick_ = tick - 1;
+    size_t top_level = 0u;
+    while (top_level + 1u < kLevelCount &&
+           !(tick & (LevelSpan(top_level + 1u) - 1)))
+      top_level++;
+    for (size_t l = top_level; l >= 1u; l--)
+      Cascade(l, static_cast<size_t>((tick >> (kSlotBits * l)) & kSlotMask));
+
+    // Fire the timers in this tick's slot.
+    current_tick_ = tick;
+    size_t slot = static_cast<size_t>(tick & kSlotMask);
+    Link* head = &levels_[0].slots[slot];
+    if (head->next == head)
+      continue;
+
+    // Move the slot's timers to a local list first, so that callbacks may
+    // freely schedule into this slot (which will then be for a later tick).
+    Link expired;
+    expired.next = head->next;
+    expired.prev = head->prev;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    head->next = head;
+    head->prev = head;
+    levels_[0].occupied[slot / 64u] &=
+        ~(static_cast<uint64_t>(1u) << (slot % 64u));
+
+    while (expired.next != &expired) {
+      Timer* timer = static_cast<Timer*>(expired.next);
+      // Unlink from |expired| by hand (the timer's slot is already cleared).
+      timer->prev->next = timer->next;
+      timer->next->prev = timer->prev;
+      timer->prev = nullptr;
+      timer->next = nullptr;
+      if (timer->expiration_tick_ > tick) {
+        // This can only happen for timers beyond the wheel's horizon.
+        Place(timer);
+        continue;
+      }
+      timer->wheel_ = nullptr;
+      size_--;
+      fired_count++;
+      // Note: The callback may destroy |timer|.
+      timer->callback_();
+    }
+  }
+  return fired_count;
+}
+
+TimePoint TimerWheel::NextExpirationTime() const {
+  if (!size_)
+    return TimePoint::Max();
+  return TickToTime(NextEventTick());
+}
+
+int64_t TimerWheel::DeadlineToTick(TimePoint deadline) const {
+  if (deadline <= origin_)
+    return 0;
+  // Round up, so that timers never fire early.
+  TimeDelta delta = deadline - origin_;
+  int64_t tick = delta / resolution_;
+  if (resolution_ * tick < delta)
+    tick++;
+  return tick;
+}
+
+TimePoint TimerWheel::TickToTime(int64_t tick) const {
+  return origin_ + resolution_ * tick;
+}
+
+int64_t TimerWheel::NextEventTick() const {
+  // For each level, the first tick at or after the next one to be processed at
+  // which an occupied slot is reached (fired for level 0, cascaded for upper
+  // levels). Only the rest of the current window of each level needs to be
+  // searched (any later slots would be empty), except for the top level, which
+  // wraps around. The current slot of an upper level has already been
+  // cascaded, unless |base| is at the start of it.
+  int64_t base = current_tick_ + 1;
+  int64_t next_tick = std::numeric_limits<int64_t>::max();
+  for (size_t l = 0u; l < kLevelCount; l++) {
+    const int64_t window = LevelSpan(l + 1u);
+    int64_t window_start = base & ~(window - 1);
+    size_t first = static_cast<size_t>((base >> (kSlotBits * l)) & kSlotMask);
+    if (l > 0u && (base & (LevelSpan(l) - 1)))
+      first++;
+    size_t slot = first < kSlotCount ? FindOccupiedSlot(l, first) : kSlotCount;
+    if (slot == kSlotCount && l + 1u == kLevelCount) {
+      slot = FindOccupiedSlot(l, 0u);
+      window_start += window;
+    }
+    if (slot == kSlotCount)
+      continue;
+    next_tick = std::min(
+        next_tick, window_start + static_cast<int64_t>(slot) * LevelSpan(l));
+  }
+  return next_tick;
+}
+
+void TimerWheel::Place(Timer* timer) {
+  constexpr int64_t kHorizon = LevelSpan(kLevelCount);
+
+  // Put the timer in the lowest level whose current window (i.e., the range
+  // covered by one slot of the level above) contains its expiration tick. Its
+  // slot will then be reached (and cascaded, for upper levels) no later than
+  // that tick.
+  int64_t base = current_tick_ + 1;
+  int64_t tick = std::max(timer->expiration_tick_, base);
+  if (tick - base >= kHorizon) {
+    // Park it as far out as possible; it'll be re-placed when it comes down.
+    tick = base + kHorizon - 1;
+  }
+  size_t level = 0u;
+  while (level + 1u < kLevelCount &&
+         (tick >> (kSlotBits * (level + 1u))) !=
+             (base >> (kSlotBits * (level + 1u))))
+    level++;
+  size_t slot = static_cast<size_t>((tick >> (kSlotBits * level)) & kSlotMask);
+
+  Link* head = &levels_[level].slots[slot];
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+  levels_[level].occupied[slot / 64u] |= static_cast<uint64_t>(1u)
+                                         << (slot % 64u);
+  timer->level_ = static_cast<uint8_t>(level);
+  timer->slot_ = static_cast<uint8_t>(slot);
+}
+
+void TimerWheel::Unlink(Timer* timer) {
+  FTL_DCHECK(timer->wheel_ == this);
+  FTL_DCHECK(size_);
+
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = nullptr;
+  timer->next = nullptr;
+  timer->wheel_ = nullptr;
+  size_--;
+
+  Link* head = &levels_[timer->level_].slots[timer->slot_];
+  if (head->next == head) {
+    levels_[timer->level_].occupied[timer->slot_ / 64u] &=
+        ~(static_cast<uint64_t>(1u) << (timer->slot_ % 64u));
+  }
+}
+
+void TimerWheel::Cascade(size_t level, size_t slot) {
+  Link* head = &levels_[level].slots[slot];
+  if (head->next == head)
+    return;
+
+  Link pending;
+  pending.next = head->next;
+  pending.prev = head->prev;
+  pending.next->prev = &pending;
+  pending.prev->next = &pending;
+  head->next = head;
+  head->prev = head;
+  levels_[level].occupied[slot / 64u] &=
+      ~(static_cast<uint64_t>(1u) << (slot % 64u));
+
+  while (pending.next != &pending) {
+    Timer* timer = static_cast<Timer*>(pending.next);
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    Place(timer);
+  }
+}
+
+size_t TimerWheel::FindOccupiedSlot(size_t level, size_t slot) const {
+  const uint64_t* occupied = levels_[level].occupied;
+  size_t word = slot / 64u;
+  uint64_t bits = occupied[word] & (~static_cast<uint64_t>(0u) << (slot % 64u));
+  for (;;) {
+    if (bits)
+      return word * 64u + LowestSetBit(bits);
+    if (++word == kBitmapWordCount)
+      return kSlotCount;
+    bits = occupied[word];
+  }
+}
+
+}  // namespace ftl
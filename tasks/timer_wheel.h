@@ -0,0 +1,159 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TASKS_TIMER_WHEEL_H_
+#define LIB_FTL_TASKS_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/functional/closure.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A hierarchical timer wheel: a set of timers, each of which runs a callback
+// once its deadline has passed. Scheduling, rescheduling and canceling a timer
+// are O(1) and never allocate, since the wheel links the (caller-owned)
+// |Timer|s together directly. This makes it a good fit for large numbers of
+// timeouts that are frequently rearmed and rarely fire (e.g., per-connection
+// idle timeouts).
+//
+// Time is divided into ticks of |resolution|; a timer fires on the first tick
+// at or after its deadline, so it never fires early but may fire up to one tick
+// late. The wheel has four levels of 256 slots each, covering 2^32 ticks
+// (about 49 days at the default 1 ms resolution); timers further out than that
+// are parked in the last level and re-placed as time advances.
+//
+// A |TimerWheel| does not run on its own: its owner calls |Advance()|
+// periodically (typically whenever |NextExpirationTime()| has been reached).
+// This class is not thread-safe; the wheel and its timers should only be used
+// on a single thread.
+class FTL_EXPORT TimerWheel final {
+ public:
+  static constexpr TimeDelta kDefaultResolution =
+      TimeDelta::FromMilliseconds(1);
+
+  // Intrusive list linkage; an implementation detail of |TimerWheel|.
+  struct Link {
+    Link* prev = nullptr;
+    Link* next = nullptr;
+  };
+
+  // A timer that can be scheduled on a |TimerWheel|. Destroying a scheduled
+  // timer cancels it.
+  class FTL_EXPORT Timer final : private Link {
+   public:
+    explicit Timer(Closure callback);
+    ~Timer();
+
+    // Returns true if the timer is scheduled and has not yet fired or been
+    // canceled.
+    bool is_scheduled() const { return !!wheel_; }
+
+    // Returns the deadline the timer was last scheduled with.
+    TimePoint deadline() const { return deadline_; }
+
+    // Cancels the timer if it is scheduled.
+    void Cancel();
+
+   private:
+    friend class TimerWheel;
+
+    Closure callback_;
+    TimerWheel* wheel_ = nullptr;
+    TimePoint deadline_;
+    int64_t expiration_tick_ = 0;
+    uint8_t level_ = 0u;
+    uint8_t slot_ = 0u;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Timer);
+  };
+
+  // Creates a wheel whose tick zero is at |origin|. Deadlines before |origin|
+  // are treated as having already passed.
+  explicit TimerWheel(TimePoint origin = TimePoint::Now(),
+                      TimeDelta resolution = kDefaultResolution);
+  // Cancels any timers which are still scheduled.
+  ~TimerWheel();
+
+  // Schedules |timer| to fire at (or shortly after) |deadline|. If |timer| is
+  // already scheduled (on this or another wheel), it is moved in place.
+  void Schedule(Timer* timer, TimePoint deadline);
+
+  // Unschedules |timer| if it is scheduled on this wheel.
+  void Cancel(Timer* timer);
+
+  // Fires all timers whose deadline is at or before |now| (rounded down to a
+  // tick), in order of expiration tick. Callbacks may schedule and cancel
+  // timers (including ones due to fire in this call). Returns the number of
+  // timers fired.
+  size_t Advance(TimePoint now);
+
+  // Returns a time by which |Advance()| should next be called: no timer will
+  // fire before then, but (if the next timer is still in an upper level)
+  // possibly none will fire then either. Returns |TimePoint::Max()| if no
+  // timers are scheduled.
+  TimePoint NextExpirationTime() const;
+
+  // Returns the number of scheduled timers.
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0u; }
+
+  TimeDelta resolution() const { return resolution_; }
+
+ private:
+  static constexpr size_t kLevelCount = 4u;
+  static constexpr size_t kSlotBits = 8u;
+  static constexpr size_t kSlotCount = 1u << kSlotBits;
+  static constexpr int64_t kSlotMask = kSlotCount - 1;
+  static constexpr size_t kBitmapWordCount = kSlotCount / 64u;
+
+  struct Level {
+    Link slots[kSlotCount];
+    // Bit i is set iff |slots[i]| is non-empty.
+    uint64_t occupied[kBitmapWordCount];
+  };
+
+  // Returns the number of ticks covered by one slot of |level| (or, for
+  // |level| = |kLevelCount|, by the whole wheel).
+  static constexpr int64_t LevelSpan(size_t level) {
+    return static_cast<int64_t>(1) << (kSlotBits * level);
+  }
+
+  int64_t DeadlineToTick(TimePoint deadline) const;
+  TimePoint TickToTime(int64_t tick) const;
+
+  // Returns the next tick at which |Advance()| has something to do: fire a
+  // level-0 slot or cascade an upper-level one. The wheel must not be empty.
+  int64_t NextEventTick() const;
+
+  // Links |timer| into the slot for its |expiration_tick_|, relative to
+  // |current_tick_| (the last tick that has been processed).
+  void Place(Timer* timer);
+  void Unlink(Timer* timer);
+
+  // Re-places all timers in the given slot (as part of moving to a new tick).
+  void Cascade(size_t level, size_t slot);
+
+  // Returns the index of the first occupied slot in |level| at or after
+  // |slot|, or |kSlotCount| if there is none.
+  size_t FindOccupiedSlot(size_t level, size_t slot) const;
+
+  const TimePoint origin_;
+  const TimeDelta resolution_;
+  // The last tick which has been processed by |Advance()|.
+  int64_t current_tick_ = -1;
+  size_t size_ = 0u;
+  Level levels_[kLevelCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_TIMER_WHEEL_H_
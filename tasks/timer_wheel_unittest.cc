@@ -0,0 +1,207 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/timer_wheel.h"
+
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+// Returns a fake time point, |ms| milliseconds after the (fake) origin.
+TimePoint At(int64_t ms) {
+  return TimePoint::FromEpochDelta(TimeDelta::FromSeconds(1000) +
+                                   TimeDelta::FromMilliseconds(ms));
+}
+
+TEST(TimerWheelTest, FiresAtDeadline) {
+  TimerWheel wheel(At(0));
+  int fired = 0;
+  TimerWheel::Timer timer([&fired] { fired++; });
+  EXPECT_FALSE(timer.is_scheduled());
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(TimePoint::Max(), wheel.NextExpirationTime());
+
+  wheel.Schedule(&timer, At(10));
+  EXPECT_TRUE(timer.is_scheduled());
+  EXPECT_EQ(At(10), timer.deadline());
+  EXPECT_EQ(1u, wheel.size());
+  EXPECT_LE(wheel.NextExpirationTime(), At(10));
+
+  EXPECT_EQ(0u, wheel.Advance(At(9)));
+  EXPECT_EQ(0, fired);
+  EXPECT_EQ(At(10), wheel.NextExpirationTime());
+  EXPECT_EQ(1u, wheel.Advance(At(10)));
+  EXPECT_EQ(1, fired);
+  EXPECT_FALSE(timer.is_scheduled());
+  EXPECT_TRUE(wheel.empty());
+
+  EXPECT_EQ(0u, wheel.Advance(At(100)));
+  EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheelTest, NeverFiresEarly) {
+  // Deadlines between ticks are rounded up.
+  TimerWheel wheel(At(0), TimeDelta::FromMilliseconds(10));
+  int fired = 0;
+  TimerWheel::Timer timer([&fired] { fired++; });
+  wheel.Schedule(&timer, At(15));
+  wheel.Advance(At(19));
+  EXPECT_EQ(0, fired);
+  wheel.Advance(At(20));
+  EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheelTest, PastDeadlineFiresOnNextAdvance) {
+  TimerWheel wheel(At(0));
+  wheel.Advance(At(50));
+  int fired = 0;
+  TimerWheel::Timer timer([&fired] { fired++; });
+  wheel.Schedule(&timer, At(-5));
+  EXPECT_EQ(1u, wheel.Advance(At(51)));
+  EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheelTest, CancelAndReschedule) {
+  TimerWheel wheel(At(0));
+  int fired = 0;
+  TimerWheel::Timer timer([&fired] { fired++; });
+
+  wheel.Schedule(&timer, At(10));
+  timer.Cancel();
+  EXPECT_FALSE(timer.is_scheduled());
+  EXPECT_TRUE(wheel.empty());
+  wheel.Advance(At(20));
+  EXPECT_EQ(0, fired);
+
+  // Rescheduling moves the timer in place.
+  wheel.Schedule(&timer, At(30));
+  wheel.Schedule(&timer, At(40));
+  EXPECT_EQ(1u, wheel.size());
+  wheel.Advance(At(39));
+  EXPECT_EQ(0, fired);
+  wheel.Advance(At(40));
+  EXPECT_EQ(1, fired);
+
+  // Canceling an unscheduled timer is fine.
+  wheel.Cancel(&timer);
+  timer.Cancel();
+}
+
+TEST(TimerWheelTest, FiresInOrder) {
+  TimerWheel wheel(At(0));
+  std::vector<int> order;
+  std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+  const int64_t deadlines[] = {70000, 3, 255, 256, 1000, 65536, 2, 65535, 300};
+  for (int64_t deadline : deadlines) {
+    timers.emplace_back(new TimerWheel::Timer(
+        [&order, deadline] { order.push_back(static_cast<int>(deadline)); }));
+    wheel.Schedule(timers.back().get(), At(deadline));
+  }
+
+  EXPECT_EQ(9u, wheel.Advance(At(100000)));
+  EXPECT_EQ((std::vector<int>{2, 3, 255, 256, 300, 1000, 65535, 65536, 70000}),
+            order);
+}
+
+TEST(TimerWheelTest, CascadesAcrossLevels) {
+  TimerWheel wheel(At(0));
+  int fired = 0;
+  TimerWheel::Timer timer([&fired] { fired++; });
+
+  // Advance in small steps, so each boundary is crossed individually.
+  const int64_t kDeadline = 3 * 65536 + 7 * 256 + 5;
+  wheel.Schedule(&timer, At(kDeadline));
+  for (int64_t t = 0; t < kDeadline; t += 97) {
+    ASSERT_EQ(0u, wheel.Advance(At(t)));
+    ASSERT_LE(wheel.NextExpirationTime(), At(kDeadline));
+  }
+  EXPECT_EQ(0u, wheel.Advance(At(kDeadline - 1)));
+  EXPECT_EQ(1u, wheel.Advance(At(kDeadline)));
+  EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheelTest, BeyondHorizon) {
+  TimerWheel wheel(At(0), TimeDelta::FromSeconds(1));
+  int fired = 0;
+  TimerWheel::Timer timer([&fired] { fired++; });
+
+  // Start somewhere other than a slot boundary.
+  wheel.Advance(At(5000));
+
+  // 2^32 + 10 ticks, past what the wheel can represent directly.
+  const int64_t kDeadlineSeconds = (static_cast<int64_t>(1) << 32) + 10;
+  wheel.Schedule(&timer, At(kDeadlineSeconds * 1000));
+  wheel.Advance(At((kDeadlineSeconds - 1) * 1000));
+  EXPECT_EQ(0, fired);
+  EXPECT_TRUE(timer.is_scheduled());
+  wheel.Advance(At(kDeadlineSeconds * 1000));
+  EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheelTest, CallbacksMayScheduleAndCancel) {
+  TimerWheel wheel(At(0));
+  int fired_a = 0;
+  int fired_b = 0;
+  int fired_c = 0;
+  TimerWheel::Timer c([&fired_c] { fired_c++; });
+  TimerWheel::Timer b([&fired_b] { fired_b++; });
+  TimerWheel::Timer a([&] {
+    if (fired_a++ == 0) {
+      // Rearm ourselves, and cancel |c|, which is due in the same call.
+      wheel.Schedule(&a, At(20));
+      c.Cancel();
+    }
+  });
+
+  wheel.Schedule(&a, At(5));
+  wheel.Schedule(&b, At(5));
+  wheel.Schedule(&c, At(6));
+  EXPECT_EQ(2u, wheel.Advance(At(10)));
+  EXPECT_EQ(1, fired_a);
+  EXPECT_EQ(1, fired_b);
+  EXPECT_EQ(0, fired_c);
+  EXPECT_TRUE(a.is_scheduled());
+  EXPECT_EQ(1u, wheel.Advance(At(20)));
+  EXPECT_EQ(2, fired_a);
+}
+
+TEST(TimerWheelTest, DestroyingWheelCancelsTimers) {
+  TimerWheel::Timer timer([] {});
+  {
+    TimerWheel wheel(At(0));
+    wheel.Schedule(&timer, At(100000));
+    EXPECT_TRUE(timer.is_scheduled());
+  }
+  EXPECT_FALSE(timer.is_scheduled());
+}
+
+TEST(TimerWheelTest, ManyTimers) {
+  constexpr int kTimerCount = 100000;
+  TimerWheel wheel(At(0));
+  int fired = 0;
+  std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+  for (int i = 0; i < kTimerCount; i++) {
+    timers.emplace_back(new TimerWheel::Timer([&fired] { fired++; }));
+    wheel.Schedule(timers.back().get(), At((i * 7919) % 200000));
+  }
+  // Cancel every other timer and rearm every tenth (remaining) one.
+  for (int i = 0; i < kTimerCount; i += 2)
+    timers[i]->Cancel();
+  for (int i = 1; i < kTimerCount; i += 20)
+    wheel.Schedule(timers[i].get(), At(250000));
+  EXPECT_EQ(static_cast<size_t>(kTimerCount / 2), wheel.size());
+
+  EXPECT_EQ(static_cast<size_t>(kTimerCount / 2 - kTimerCount / 20),
+            wheel.Advance(At(200000)));
+  EXPECT_EQ(static_cast<size_t>(kTimerCount / 20), wheel.Advance(At(250000)));
+  EXPECT_EQ(kTimerCount / 2, fired);
+  EXPECT_TRUE(wheel.empty());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,168 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A Chase-Lev work-stealing deque. See "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli, PPoPP 2013), from which
+// the memory orderings below are taken.
+
+#ifndef LIB_FTL_TASKS_WORK_STEALING_DEQUE_H_
+#define LIB_FTL_TASKS_WORK_STEALING_DEQUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+namespace internal {
+
+// A deque of pointers with a single owner thread, which may |Push()| and
+// |Pop()| at the bottom without taking any locks, and any number of other
+// threads, which may |Steal()| from the top. The deque does not own the objects
+// it points to.
+template <typename T>
+class WorkStealingDeque final {
+  static_assert(std::is_pointer<T>::value,
+                "WorkStealingDeque only holds pointers");
+
+ public:
+  explicit WorkStealingDeque(size_t initial_log_capacity = 8u)
+      : top_(0), bottom_(0) {
+    arrays_.emplace_back(new Array(initial_log_capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+  ~WorkStealingDeque() {}
+
+  // Pushes |value| onto the bottom. May only be called by the owner.
+  void Push(T value) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Array* a = array_.load(std::memory_order_relaxed);
+    if (b - t > static_cast<int64_t>(a->capacity()) - 1) {
+      a = Grow(a, t, b);
+      array_.store(a, std::memory_order_release);
+    }
+    a->Put(b, value);
+    // A release store rather than a release fence and a relaxed store: it's
+    // equivalent, but ThreadSanitizer doesn't understand fences.
+    bottom_.store(b + 1, std::memory_order_release);
+  }
+
+  // Pops the most recently pushed value from the bottom. Returns false if the
+  // deque is empty (or the last value was stolen concurrently). May only be
+  // called by the owner.
+  bool Pop(T* value) {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty.
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    T x = a->Get(b);
+    if (t == b) {
+      // Last element: race against stealers for it.
+      bool won = top_.compare_exchange_strong(t, t + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      if (!won)
+        return false;
+    }
+    *value = x;
+    return true;
+  }
+
+  // Steals the least recently pushed value from the top. Returns false if the
+  // deque is empty or the steal lost a race (with the owner or another thief).
+  // May be called from any thread.
+  bool Steal(T* value) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b)
+      return false;
+
+    // Note: This should be |memory_order_consume|, which compilers implement as
+    // |memory_order_acquire| anyway.
+    Array* a = array_.load(std::memory_order_acquire);
+    T x = a->Get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      return false;
+    *value = x;
+    return true;
+  }
+
+  // Returns true if the deque appeared to be empty. This is only a hint unless
+  // called by the owner with no concurrent thieves.
+  bool IsEmpty() const {
+    int64_t b = bottom_.load(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_seq_cst);
+    return t >= b;
+  }
+
+ private:
+  class Array final {
+   public:
+    explicit Array(size_t log_capacity)
+        : log_capacity_(log_capacity),
+          mask_((static_cast<size_t>(1) << log_capacity) - 1u),
+          buffer_(new std::atomic<T>[mask_ + 1u]) {}
+
+    size_t log_capacity() const { return log_capacity_; }
+    size_t capacity() const { return mask_ + 1u; }
+
+    T Get(int64_t i) const {
+      return buffer_[static_cast<size_t>(i) & mask_].load(
+          std::memory_order_relaxed);
+    }
+
+    void Put(int64_t i, T value) {
+      buffer_[static_cast<size_t>(i) & mask_].store(value,
+                                                    std::memory_order_relaxed);
+    }
+
+   private:
+    const size_t log_capacity_;
+    const size_t mask_;
+    std::unique_ptr<std::atomic<T>[]> buffer_;
+
+    FTL_DISALLOW_COPY_AND_ASSIGN(Array);
+  };
+
+  // Replaces |a| with an array of twice the capacity. The old array is kept
+  // alive (in |arrays_|) until the deque is destroyed, since thieves may still
+  // be reading from it.
+  Array* Grow(Array* a, int64_t t, int64_t b) {
+    Array* new_array = new Array(a->log_capacity() + 1u);
+    for (int64_t i = t; i < b; i++)
+      new_array->Put(i, a->Get(i));
+    arrays_.emplace_back(new_array);
+    return new_array;
+  }
+
+  std::atomic<int64_t> top_;
+  std::atomic<int64_t> bottom_;
+  std::atomic<Array*> array_;
+  // Only touched by the owner.
+  std::vector<std::unique_ptr<Array>> arrays_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+}  // namespace internal
+}  // namespace ftl
+
+#endif  // LIB_FTL_TASKS_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/tasks/work_stealing_deque.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace internal {
+namespace {
+
+TEST(WorkStealingDequeTest, PushPopIsLifo) {
+  WorkStealingDeque<int*> deque(1u);
+  int values[10];
+  EXPECT_TRUE(deque.IsEmpty());
+  // Also exercises growing from an initial capacity of two.
+  for (int& value : values)
+    deque.Push(&value);
+  EXPECT_FALSE(deque.IsEmpty());
+  for (int i = 9; i >= 0; i--) {
+    int* value = nullptr;
+    EXPECT_TRUE(deque.Pop(&value));
+    EXPECT_EQ(&values[i], value);
+  }
+  int* value = nullptr;
+  EXPECT_FALSE(deque.Pop(&value));
+  EXPECT_TRUE(deque.IsEmpty());
+}
+
+TEST(WorkStealingDequeTest, StealIsFifo) {
+  WorkStealingDeque<int*> deque;
+  int values[3];
+  for (int& value : values)
+    deque.Push(&value);
+  int* value = nullptr;
+  EXPECT_TRUE(deque.Steal(&value));
+  EXPECT_EQ(&values[0], value);
+  EXPECT_TRUE(deque.Pop(&value));
+  EXPECT_EQ(&values[2], value);
+  EXPECT_TRUE(deque.Steal(&value));
+  EXPECT_EQ(&values[1], value);
+  EXPECT_FALSE(deque.Steal(&value));
+}
+
+// The owner pushes and pops while several thieves steal; every element must be
+// taken exactly once.
+TEST(WorkStealingDequeTest, ConcurrentSteal) {
+  constexpr int kCount = 100000;
+  constexpr int kThiefCount = 3;
+  std::vector<int> values(kCount, 0);
+  std::vector<std::atomic<int>> taken(kCount);
+  for (auto& t : taken)
+    t.store(0);
+
+  WorkStealingDeque<int*> deque(2u);
+  std::atomic<bool> done(false);
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < kThiefCount; i++) {
+    thieves.push_back(std::thread([&] {
+      int* value = nullptr;
+      while (!done.load()) {
+        if (deque.Steal(&value))
+          taken[value - values.data()].fetch_add(1);
+      }
+    }));
+  }
+
+  int* value = nullptr;
+  for (int i = 0; i < kCount; i++) {
+    deque.Push(&values[i]);
+    if (i % 3 == 0 && deque.Pop(&value))
+      taken[value - values.data()].fetch_add(1);
+  }
+  while (deque.Pop(&value))
+    taken[value - values.data()].fetch_add(1);
+  done.store(true);
+  for (auto& thief : thieves)
+    thief.join();
+
+  for (int i = 0; i < kCount; i++)
+    EXPECT_EQ(1, taken[i].load()) << i;
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace ftl
@@ -0,0 +1,41 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/test/benchmark.h"
+
+#include "lib/ftl/debug/perf_counters.h"
+
+namespace ftl {
+
+::benchmark::internal::Benchmark* RegisterBenchmarkWithPerfCounters(
+    const char* name,
+    void (*function)(::benchmark::State& state)) {
+  return ::benchmark::RegisterBenchmark(
+      name, [function](::benchmark::State& state) {
+        PerfCounterValues values;
+        bool valid;
+        {
+          PerfCounterScope scope(&values);
+          valid = scope.is_valid();
+          function(state);
+        }
+        if (!valid)
+          return;
+        using Counter = ::benchmark::Counter;
+        // Summed over the threads, per iteration (except for the IPC, which
+        // is averaged over the threads).
+        state.counters["IPC"] =
+            Counter(values.InstructionsPerCycle(), Counter::kAvgThreads);
+        state.counters["cycles/op"] = Counter(
+            static_cast<double>(values.cycles), Counter::kAvgIterations);
+        state.counters["instrs/op"] = Counter(
+            static_cast<double>(values.instructions), Counter::kAvgIterations);
+        state.counters["cache_misses/op"] = Counter(
+            static_cast<double>(values.cache_misses), Counter::kAvgIterations);
+        state.counters["branch_misses/op"] = Counter(
+            static_cast<double>(values.branch_misses), Counter::kAvgIterations);
+      });
+}
+
+}  // namespace ftl
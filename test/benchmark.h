@@ -0,0 +1,40 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// ftl_benchmarks' benchmarks are registered with |FTL_BENCHMARK()| (instead of
+// |BENCHMARK()|), so that each also reports its hardware performance counters
+// (see debug/perf_counters.h) where they're supported: the instructions per
+// cycle, and the cycles, instructions, cache misses and branch misses per
+// iteration, e.g.:
+//
+//   void BM_Frobnicate(benchmark::State& state) {
+//     while (state.KeepRunning())
+//       Frobnicate();
+//   }
+//   FTL_BENCHMARK(BM_Frobnicate)->Arg(16)->Arg(4096);
+//
+// (The counts include the benchmark's set-up and the harness' loop, spread
+// over the iterations.)
+
+#ifndef LIB_FTL_TEST_BENCHMARK_H_
+#define LIB_FTL_TEST_BENCHMARK_H_
+
+#include "benchmark/benchmark.h"
+
+#define FTL_BENCHMARK(function)                                       \
+  BENCHMARK_UNUSED static ::benchmark::internal::Benchmark* const    \
+      ftl_benchmark_##function =                                      \
+          ::ftl::RegisterBenchmarkWithPerfCounters(#function, function)
+
+namespace ftl {
+
+// Registers |function| as the benchmark |name|, wrapped to report the perf
+// counters.
+::benchmark::internal::Benchmark* RegisterBenchmarkWithPerfCounters(
+    const char* name,
+    void (*function)(::benchmark::State& state));
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TEST_BENCHMARK_H_
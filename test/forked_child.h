@@ -0,0 +1,39 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TEST_FORKED_CHILD_H_
+#define LIB_FTL_TEST_FORKED_CHILD_H_
+
+#include "lib/ftl/build_config.h"
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <functional>
+
+namespace ftl {
+
+// Runs |child| in a fork()ed child process, and returns whether it returned
+// true (within 10 seconds, so that a child which deadlocks fails rather than
+// hanging the test). (gtest's assertions don't work in the child.)
+inline bool RunInForkedChild(const std::function<bool()>& child) {
+  const pid_t pid = fork();
+  if (pid < 0)
+    return false;
+  if (pid == 0) {
+    alarm(10u);
+    _exit(child() ? 0 : 1);
+  }
+  int status = 0;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+}
+
+}  // namespace ftl
+
+#endif  // !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+#endif  // LIB_FTL_TEST_FORKED_CHILD_H_
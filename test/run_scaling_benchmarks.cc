@@ -0,0 +1,207 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Runs each of the workloads below on 1, 2, 4, ... threads, and prints how
+// their throughput and latency scale, e.g.:
+//
+//   ftl_scaling_benchmarks --threads=1,8,32,96 --seconds=2 --filter=Mutex
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lib/ftl/command_line.h"
+#include "lib/ftl/flags.h"
+#include "lib/ftl/log_settings.h"
+#include "lib/ftl/log_sink.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/memory/ref_ptr.h"
+#include "lib/ftl/metrics/metrics.h"
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/tasks/thread_pool.h"
+#include "lib/ftl/test/scaling_benchmark.h"
+
+FTL_FLAG(std::string,
+         threads,
+         "",
+         "Comma-separated thread counts to run each workload with (by default, "
+         "the powers of two up to the number of CPUs, and that number).");
+FTL_FLAG(double, seconds, 1.0, "How long each run lasts.");
+FTL_FLAG(bool, pin_threads, true, "Whether to pin each thread to a CPU.");
+FTL_FLAG(std::string,
+         filter,
+         "",
+         "Only run the workloads whose names contain this.");
+
+namespace ftl {
+namespace {
+
+// The most threads a workload keeps per-thread state for.
+constexpr size_t kMaxThreads = 1024u;
+
+class Counted : public RefCountedThreadSafe<Counted> {};
+
+// Discards messages (see the logging workloads).
+class NullSink : public LogSink {
+ public:
+  void Write(const LogRecord* records, size_t count) override {}
+};
+
+struct Workload {
+  const char* name;
+  // Sets up (and returns) the operation for a run of every thread count.
+  std::function<std::function<void(size_t)>()> set_up;
+  // Undoes what |set_up| did (if anything) after all the runs.
+  std::function<void()> tear_down;
+};
+
+std::vector<Workload> GetWorkloads() {
+  std::vector<Workload> workloads;
+
+  // All threads copying (and dropping) references to one object contend for
+  // its reference count's cache line.
+  workloads.push_back({"RefPtrCopy/shared", [] {
+                         auto object = MakeRefCounted<Counted>();
+                         return [object](size_t) {
+                           RefPtr<Counted> copy = object;
+                         };
+                       }});
+  // The same, with an object per thread, for comparison.
+  workloads.push_back({"RefPtrCopy/per_thread", [] {
+                         auto objects =
+                             std::make_shared<std::vector<RefPtr<Counted>>>();
+                         for (size_t i = 0u; i < kMaxThreads; i++)
+                           objects->push_back(MakeRefCounted<Counted>());
+                         return [objects](size_t thread_index) {
+                           RefPtr<Counted> copy =
+                               (*objects)[thread_index % kMaxThreads];
+                         };
+                       }});
+
+  // A short critical section on one mutex.
+  workloads.push_back({"Mutex/shared", [] {
+                         struct State {
+                           Mutex mutex;
+                           uint64_t counter = 0u;
+                         };
+                         auto state = std::make_shared<State>();
+                         return [state](size_t) {
+                           MutexLocker locker(&state->mutex);
+                           state->counter++;
+                         };
+                       }});
+
+  // Incrementing a (sharded) metrics counter, and a plain shared atomic.
+  workloads.push_back({"Counter/sharded", [] {
+                         auto counter = std::make_shared<metrics::Counter>(
+                             "scaling_benchmark_counter", "");
+                         return [counter](size_t) { counter->Increment(); };
+                       }});
+  workloads.push_back({"Counter/shared_atomic", [] {
+                         auto counter =
+                             std::make_shared<std::atomic<uint64_t>>(0u);
+                         return [counter](size_t) {
+                           counter->fetch_add(1u, std::memory_order_relaxed);
+                         };
+                       }});
+
+  // Each thread posts a task to a pool (of a worker per CPU) and waits for it.
+  workloads.push_back({"ThreadPool/post_and_wait", [] {
+                         struct State {
+                           ~State() { pool->Shutdown(); }
+                           RefPtr<ThreadPool> pool;
+                           AutoResetWaitableEvent events[kMaxThreads];
+                         };
+                         auto state = std::make_shared<State>();
+                         state->pool = MakeRefCounted<ThreadPool>(
+                             std::max(1u, std::thread::hardware_concurrency()));
+                         FTL_CHECK(state->pool->Start());
+                         return [state](size_t thread_index) {
+                           AutoResetWaitableEvent* event =
+                               &state->events[thread_index % kMaxThreads];
+                           state->pool->PostTask([event] { event->Signal(); });
+                           event->Wait();
+                         };
+                       }});
+
+  // Logging a short message, synchronously and asynchronously.
+  for (bool async : {false, true}) {
+    workloads.push_back(
+        {async ? "Log/async" : "Log/sync",
+         [async] {
+           LogSettings settings;
+           settings.sink = std::make_shared<NullSink>();
+           settings.log_thread_ids = true;
+           settings.log_timestamps = true;
+           settings.async = async;
+           SetLogSettings(settings);
+           return [](size_t thread_index) {
+             FTL_LOG(INFO) << "Message from thread " << thread_index;
+           };
+         },
+         [] { SetLogSettings(LogSettings()); }});
+  }
+  return workloads;
+}
+
+bool GetOptions(ScalingBenchmarkOptions* options) {
+  for (StringView count :
+       SplitString(FLAG_threads, ",", kTrimWhitespace, kSplitWantNonEmpty)) {
+    uint32_t value;
+    if (!StringToNumberWithError(count, &value) || !value ||
+        value > kMaxThreads) {
+      fprintf(stderr, "Invalid thread count: %s\n", count.ToString().c_str());
+      return false;
+    }
+    options->thread_counts.push_back(value);
+  }
+  options->duration = TimeDelta::FromSecondsF(FLAG_seconds);
+  options->pin_threads = FLAG_pin_threads;
+  return true;
+}
+
+int RunScalingBenchmarks(int argc, char** argv) {
+  if (!SetFlagsFromCommandLine(CommandLineFromArgcArgv(argc, argv))) {
+    fprintf(stderr, "Options:\n%s", GetFlagsHelp().c_str());
+    return 1;
+  }
+  ScalingBenchmarkOptions options;
+  if (!GetOptions(&options))
+    return 1;
+
+  for (const Workload& workload : GetWorkloads()) {
+    if (std::string(workload.name).find(FLAG_filter) == std::string::npos)
+      continue;
+    std::vector<ScalingBenchmarkResult> results;
+    {
+      std::function<void(size_t)> operation = workload.set_up();
+      results = RunScalingBenchmark(operation, options);
+    }
+    if (workload.tear_down)
+      workload.tear_down();
+    printf("%s\n",
+           FormatScalingBenchmarkResults(StringView(workload.name), results)
+               .c_str());
+    fflush(stdout);
+  }
+  return 0;
+}
+
+}  // namespace
+}  // namespace ftl
+
+int main(int argc, char** argv) {
+  return ftl::RunScalingBenchmarks(argc, argv);
+}
@@ -0,0 +1,144 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/test/scaling_benchmark.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/synchronization/barrier.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/threading/thread.h"
+#include "lib/ftl/time/fast_clock.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+namespace {
+
+size_t GetCpuCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::vector<size_t> DefaultThreadCounts() {
+  const size_t cpu_count = GetCpuCount();
+  std::vector<size_t> thread_counts;
+  for (size_t count = 1u; count < cpu_count; count *= 2u)
+    thread_counts.push_back(count);
+  thread_counts.push_back(cpu_count);
+  return thread_counts;
+}
+
+// What each thread of a run records.
+struct ThreadResult {
+  uint64_t operations = 0u;
+  TimePoint end;
+  LatencyHistogram::Snapshot latency;
+};
+
+ScalingBenchmarkResult RunWithThreads(
+    const std::function<void(size_t thread_index)>& operation,
+    size_t thread_count,
+    const ScalingBenchmarkOptions& options) {
+  std::vector<std::unique_ptr<ThreadResult>> thread_results;
+  std::vector<std::unique_ptr<Thread>> threads;
+  std::atomic<bool> stop(false);
+  // The threads all start at once, when this thread has noted the time.
+  Barrier barrier(static_cast<uint32_t>(thread_count + 1u));
+  for (size_t i = 0u; i < thread_count; i++) {
+    thread_results.emplace_back(new ThreadResult());
+    ThreadResult* result = thread_results.back().get();
+    threads.emplace_back(new Thread([&operation, &stop, &barrier, result, i] {
+      // (Counting on the thread's own stack, not sharing cache lines with the
+      // other threads'.)
+      LatencyHistogram::Snapshot latency;
+      uint64_t operations = 0u;
+      barrier.ArriveAndWait();
+      TimePoint last = FastClock::Now();
+      while (!stop.load(std::memory_order_relaxed)) {
+        operation(i);
+        const TimePoint now = FastClock::Now();
+        latency.Record(now - last);
+        operations++;
+        last = now;
+      }
+      result->operations = operations;
+      result->end = last;
+      result->latency.Merge(latency);
+    }));
+    Thread::Options thread_options;
+    thread_options.name = StringPrintf("scaling-%zu", i);
+#if defined(OS_LINUX)
+    if (options.pin_threads)
+      thread_options.cpu_affinity.push_back(i % GetCpuCount());
+#endif
+    FTL_CHECK(threads.back()->Run(thread_options));
+  }
+
+  const TimePoint start = FastClock::Now();
+  barrier.ArriveAndWait();
+  SleepFor(options.duration);
+  stop.store(true, std::memory_order_relaxed);
+
+  ScalingBenchmarkResult result;
+  result.thread_count = thread_count;
+  TimePoint end = start;
+  for (size_t i = 0u; i < thread_count; i++) {
+    threads[i]->Join();
+    result.operations += thread_results[i]->operations;
+    result.latency.Merge(thread_results[i]->latency);
+    end = std::max(end, thread_results[i]->end);
+  }
+  result.elapsed = end - start;
+  return result;
+}
+
+}  // namespace
+
+double ScalingBenchmarkResult::OperationsPerSecond() const {
+  if (elapsed <= TimeDelta())
+    return 0.0;
+  return static_cast<double>(operations) / elapsed.ToSecondsF();
+}
+
+std::vector<ScalingBenchmarkResult> RunScalingBenchmark(
+    const std::function<void(size_t thread_index)>& operation,
+    const ScalingBenchmarkOptions& options) {
+  const std::vector<size_t> thread_counts = options.thread_counts.empty()
+                                                ? DefaultThreadCounts()
+                                                : options.thread_counts;
+  std::vector<ScalingBenchmarkResult> results;
+  for (size_t thread_count : thread_counts)
+    results.push_back(RunWithThreads(operation, thread_count, options));
+  return results;
+}
+
+std::string FormatScalingBenchmarkResults(
+    StringView name,
+    const std::vector<ScalingBenchmarkResult>& results) {
+  std::string table = name.ToString() + "\n";
+  table += StringPrintf("%8s %12s %8s %9s %9s %9s %9s\n", "threads", "ops/s",
+                        "speedup", "p50 (ns)", "p90", "p99", "p99.9");
+  const double base = results.empty() ? 0.0 : results[0].OperationsPerSecond();
+  for (const ScalingBenchmarkResult& result : results) {
+    const double throughput = result.OperationsPerSecond();
+    table += StringPrintf(
+        "%8zu %12.0f %7.2fx %9" PRId64 " %9" PRId64 " %9" PRId64 " %9" PRId64
+        "\n",
+        result.thread_count, throughput, base > 0.0 ? throughput / base : 0.0,
+        result.latency.Percentile(50.0).ToNanoseconds(),
+        result.latency.Percentile(90.0).ToNanoseconds(),
+        result.latency.Percentile(99.0).ToNanoseconds(),
+        result.latency.Percentile(99.9).ToNanoseconds());
+  }
+  return table;
+}
+
+}  // namespace ftl
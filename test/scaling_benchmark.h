@@ -0,0 +1,74 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A harness for seeing how an operation scales with the number of threads
+// doing it at once, e.g.:
+//
+//   std::vector<ScalingBenchmarkResult> results =
+//       RunScalingBenchmark([&](size_t thread_index) { ... });
+//   printf("%s", FormatScalingBenchmarkResults("MyOp", results).c_str());
+//
+// See test/run_scaling_benchmarks.cc for ftl_scaling_benchmarks' workloads.
+
+#ifndef LIB_FTL_TEST_SCALING_BENCHMARK_H_
+#define LIB_FTL_TEST_SCALING_BENCHMARK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/latency_histogram.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+
+struct ScalingBenchmarkOptions {
+  // The numbers of threads to run the operation on, one run for each. If
+  // empty, the powers of two up to the number of CPUs, and that number.
+  std::vector<size_t> thread_counts;
+
+  // How long each run lasts.
+  TimeDelta duration = TimeDelta::FromSeconds(1);
+
+  // Whether the |i|th thread is pinned to the |i|th CPU (wrapping around if
+  // there are more threads than CPUs), so that runs are repeatable. Linux
+  // only.
+  bool pin_threads = true;
+};
+
+// One run's results.
+struct ScalingBenchmarkResult {
+  size_t thread_count = 0u;
+  // The number of operations done, by all the threads.
+  uint64_t operations = 0u;
+  // From the threads starting to the last of them stopping.
+  TimeDelta elapsed;
+  // The time each operation took, on all the threads (timed with |FastClock|,
+  // so including its overhead of some nanoseconds).
+  LatencyHistogram::Snapshot latency;
+
+  double OperationsPerSecond() const;
+};
+
+// Runs |operation| over and over on each of |options.thread_counts[i]|
+// |ftl::Thread|s at once (passing each its index, from 0), for
+// |options.duration| each time, and returns the results of each run.
+std::vector<ScalingBenchmarkResult> RunScalingBenchmark(
+    const std::function<void(size_t thread_index)>& operation,
+    const ScalingBenchmarkOptions& options = ScalingBenchmarkOptions());
+
+// Returns a table of |results|, titled |name|, with a line for each run: the
+// throughput, its speedup over the first run's (usually one thread), and
+// percentiles of the latency.
+std::string FormatScalingBenchmarkResults(
+    StringView name,
+    const std::vector<ScalingBenchmarkResult>& results);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TEST_SCALING_BENCHMARK_H_
@@ -0,0 +1,152 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TEST_TEST_TASK_RUNNER_H_
+#define LIB_FTL_TEST_TEST_TASK_RUNNER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <thread>
+#include <utility>
+
+#include "lib/ftl/functional/inline_closure.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/memory/ref_counted.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/tasks/task_runner.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A |TaskRunner| for tests, with a virtual clock which only moves when the
+// test says so, so that delayed tasks (and timers built on them) run
+// instantly and deterministically instead of after real sleeps:
+//
+//   auto task_runner = MakeRefCounted<TestTaskRunner>();
+//   OneShotTimer timer;
+//   timer.Start(task_runner.get(), [&] { fired = true; }, kDelay);
+//   task_runner->AdvanceTimeBy(kDelay - TimeDelta::FromMilliseconds(1));
+//   EXPECT_FALSE(fired);
+//   task_runner->AdvanceTimeBy(TimeDelta::FromMilliseconds(1));
+//   EXPECT_TRUE(fired);
+//
+// Tasks only run when the test calls |RunUntilIdle()| or |AdvanceTime...()|,
+// on the calling thread, in order of target time (and then of posting). Tasks
+// may be posted from any thread, but |RunsTasksOnCurrentThread()| is only true
+// on the thread that created the task runner.
+//
+// The clock starts at the real |TimePoint::Now()|, so that target times which
+// code under test computes from the real clock are about right, but only code
+// that reads the clock with |TaskRunner::Now()| sees virtual time pass.
+class TestTaskRunner : public TaskRunner {
+ public:
+  // |TaskRunner|:
+  using TaskRunner::PostDelayedTask;
+  using TaskRunner::PostTask;
+  void PostTask(UniqueClosure task) override {
+    PostTaskForTime(std::move(task), Now());
+  }
+  void PostTaskForTime(UniqueClosure task, TimePoint target_time) override {
+    MutexLocker locker(&mutex_);
+    tasks_.emplace(std::make_pair(target_time, next_sequence_number_++),
+                   TraceTask(std::move(task), target_time));
+  }
+  void PostDelayedTask(UniqueClosure task, TimeDelta delay) override {
+    PostTaskForTime(std::move(task), Now() + delay);
+  }
+  bool RunsTasksOnCurrentThread() override {
+    return std::this_thread::get_id() == thread_;
+  }
+  // The virtual time.
+  TimePoint Now() override {
+    MutexLocker locker(&mutex_);
+    return now_;
+  }
+
+  // The number of tasks which haven't run yet (due or not).
+  size_t pending_task_count() const {
+    MutexLocker locker(&mutex_);
+    return tasks_.size();
+  }
+
+  // The target time of the next task, or |TimePoint::Max()| if there are no
+  // tasks.
+  TimePoint NextTaskTime() const {
+    MutexLocker locker(&mutex_);
+    return tasks_.empty() ? TimePoint::Max() : tasks_.begin()->first.first;
+  }
+
+  // Runs the tasks which are due (including ones posted, for now or earlier,
+  // by the tasks it runs), without moving the clock. Returns how many ran.
+  size_t RunUntilIdle() { return RunTasksUntil(Now()); }
+
+  // Moves the clock forward by |delta|, running each task which becomes due
+  // with the clock at its target time. Returns how many tasks ran.
+  size_t AdvanceTimeBy(TimeDelta delta) {
+    FTL_DCHECK(delta >= TimeDelta::Zero());
+    return AdvanceTimeTo(Now() + delta);
+  }
+
+  // Like |AdvanceTimeBy()|, but to |time| (which mustn't be in the past).
+  size_t AdvanceTimeTo(TimePoint time) {
+    size_t count = RunTasksUntil(time);
+    MutexLocker locker(&mutex_);
+    FTL_DCHECK(time >= now_);
+    now_ = time;
+    return count;
+  }
+
+  // Moves the clock forward, running tasks, until there are none left. (Don't
+  // use this with repeating timers, which always have a task pending.)
+  size_t RunUntilNoTasksRemain() { return RunTasksUntil(TimePoint::Max()); }
+
+ private:
+  FRIEND_MAKE_REF_COUNTED(TestTaskRunner);
+  FRIEND_REF_COUNTED_THREAD_SAFE(TestTaskRunner);
+
+  TestTaskRunner()
+      : thread_(std::this_thread::get_id()), now_(TimePoint::Now()) {}
+  ~TestTaskRunner() override {}
+
+  // Runs the tasks due by |time|, in order, moving the clock (forward) to each
+  // one's target time.
+  size_t RunTasksUntil(TimePoint time) {
+    size_t count = 0u;
+    for (;;) {
+      UniqueClosure task;
+      {
+        MutexLocker locker(&mutex_);
+        if (tasks_.empty() || tasks_.begin()->first.first > time)
+          return count;
+        auto it = tasks_.begin();
+        if (it->first.first > now_)
+          now_ = it->first.first;
+        task = std::move(it->second);
+        tasks_.erase(it);
+      }
+      task();
+      count++;
+    }
+  }
+
+  const std::thread::id thread_;
+
+  mutable Mutex mutex_;
+  TimePoint now_ FTL_GUARDED_BY(mutex_);
+  uint64_t next_sequence_number_ FTL_GUARDED_BY(mutex_) = 0u;
+  // By target time, then sequence number.
+  std::map<std::pair<TimePoint, uint64_t>, UniqueClosure> tasks_
+      FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(TestTaskRunner);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TEST_TEST_TASK_RUNNER_H_
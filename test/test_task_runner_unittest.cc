@@ -0,0 +1,91 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/test/test_task_runner.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/tasks/one_shot_timer.h"
+#include "lib/ftl/tasks/repeating_timer.h"
+
+namespace ftl {
+namespace {
+
+TEST(TestTaskRunnerTest, RunUntilIdle) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  EXPECT_TRUE(task_runner->RunsTasksOnCurrentThread());
+  TimePoint start = task_runner->Now();
+
+  std::vector<int> order;
+  task_runner->PostTask([&task_runner, &order] {
+    order.push_back(0);
+    task_runner->PostTask([&order] { order.push_back(2); });
+  });
+  task_runner->PostTask([&order] { order.push_back(1); });
+  task_runner->PostDelayedTask([&order] { order.push_back(3); },
+                               TimeDelta::FromSeconds(1));
+  EXPECT_EQ(3u, task_runner->pending_task_count());
+
+  EXPECT_EQ(3u, task_runner->RunUntilIdle());
+  EXPECT_EQ((std::vector<int>{0, 1, 2}), order);
+  EXPECT_EQ(start, task_runner->Now());
+  EXPECT_EQ(start + TimeDelta::FromSeconds(1), task_runner->NextTaskTime());
+}
+
+TEST(TestTaskRunnerTest, AdvanceTime) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  TimePoint start = task_runner->Now();
+
+  std::vector<TimeDelta> run_times;
+  auto record = [&task_runner, &run_times, start] {
+    run_times.push_back(task_runner->Now() - start);
+  };
+  task_runner->PostDelayedTask(record, TimeDelta::FromSeconds(3));
+  task_runner->PostDelayedTask(record, TimeDelta::FromSeconds(1));
+  task_runner->PostDelayedTask(
+      [&task_runner, record] {
+        task_runner->PostDelayedTask(record, TimeDelta::FromSeconds(1));
+      },
+      TimeDelta::FromSeconds(2));
+
+  EXPECT_EQ(0u, task_runner->AdvanceTimeBy(TimeDelta::FromMilliseconds(999)));
+  EXPECT_EQ(2u,
+            task_runner->AdvanceTimeBy(TimeDelta::FromMilliseconds(1001)));
+  EXPECT_EQ(start + TimeDelta::FromSeconds(2), task_runner->Now());
+  // The task posted at 2s for 3s runs after the one posted earlier for 3s.
+  EXPECT_EQ(2u, task_runner->RunUntilNoTasksRemain());
+  EXPECT_EQ((std::vector<TimeDelta>{TimeDelta::FromSeconds(1),
+                                    TimeDelta::FromSeconds(3),
+                                    TimeDelta::FromSeconds(3)}),
+            run_times);
+  EXPECT_EQ(start + TimeDelta::FromSeconds(3), task_runner->Now());
+  EXPECT_EQ(TimePoint::Max(), task_runner->NextTaskTime());
+}
+
+TEST(TestTaskRunnerTest, OneShotTimer) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  OneShotTimer timer;
+  bool fired = false;
+  timer.Start(task_runner.get(), [&fired] { fired = true; },
+              TimeDelta::FromSeconds(10));
+  task_runner->AdvanceTimeBy(TimeDelta::FromMilliseconds(9999));
+  EXPECT_FALSE(fired);
+  task_runner->AdvanceTimeBy(TimeDelta::FromMilliseconds(1));
+  EXPECT_TRUE(fired);
+}
+
+// An hour of a repeating timer takes no real time.
+TEST(TestTaskRunnerTest, RepeatingTimer) {
+  auto task_runner = MakeRefCounted<TestTaskRunner>();
+  RepeatingTimer timer;
+  int run_count = 0;
+  timer.Start(task_runner.get(), [&run_count] { run_count++; },
+              TimeDelta::FromSeconds(1));
+  task_runner->AdvanceTimeBy(TimeDelta::FromSeconds(3600));
+  EXPECT_EQ(3600, run_count);
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,163 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/cpu_topology.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <thread>
+#include <utility>
+
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/strings/trim.h"
+
+namespace ftl {
+namespace {
+
+bool ReadList(const std::string& path, std::vector<size_t>* list) {
+  std::string contents;
+  return files::ReadFileToString(path, &contents) &&
+         ParseCpuList(contents, list);
+}
+
+bool ReadNumber(const std::string& path, size_t* number) {
+  std::string contents;
+  uint32_t value = 0u;
+  if (!files::ReadFileToString(path, &contents) ||
+      !StringToNumberWithError(TrimString(contents, " \n"), &value))
+    return false;
+  *number = value;
+  return true;
+}
+
+// Fills in |topology|'s |packages|, |nodes| and |core_count| from its |cpus|
+// (renumbering the cores, which are only read per package).
+void Summarize(CpuTopology* topology) {
+  std::map<std::pair<size_t, size_t>, size_t> cores;
+  for (auto& cpu : topology->cpus) {
+    auto it = cores.emplace(std::make_pair(cpu.package, cpu.core), cores.size())
+                  .first;
+    cpu.core = it->second;
+    topology->packages.push_back(cpu.package);
+    topology->nodes.push_back(cpu.node);
+  }
+  topology->core_count = cores.size();
+  for (auto* list : {&topology->packages, &topology->nodes}) {
+    std::sort(list->begin(), list->end());
+    list->erase(std::unique(list->begin(), list->end()), list->end());
+  }
+}
+
+CpuTopology* GetDefaultTopology() {
+  CpuTopology* topology = new CpuTopology();
+  if (ReadCpuTopology("/sys", topology))
+    return topology;
+
+  *topology = CpuTopology();
+  size_t cpu_count = std::max(std::thread::hardware_concurrency(), 1u);
+  for (size_t i = 0; i < cpu_count; i++) {
+    CpuTopology::Cpu cpu;
+    cpu.id = i;
+    cpu.core = i;
+    topology->cpus.push_back(cpu);
+  }
+  Summarize(topology);
+  return topology;
+}
+
+}  // namespace
+
+// static
+const CpuTopology& CpuTopology::Get() {
+  static const CpuTopology* topology = GetDefaultTopology();
+  return *topology;
+}
+
+std::vector<size_t> CpuTopology::GetNodeCpus(size_t node) const {
+  std::vector<size_t> result;
+  for (const auto& cpu : cpus) {
+    if (cpu.node == node)
+      result.push_back(cpu.id);
+  }
+  return result;
+}
+
+std::vector<size_t> CpuTopology::GetSmtSiblings(size_t cpu_id) const {
+  std::vector<size_t> result;
+  auto it = std::find_if(cpus.begin(), cpus.end(),
+                         [cpu_id](const Cpu& cpu) { return cpu.id == cpu_id; });
+  if (it == cpus.end())
+    return result;
+  for (const auto& cpu : cpus) {
+    if (cpu.core == it->core)
+      result.push_back(cpu.id);
+  }
+  return result;
+}
+
+bool ReadCpuTopology(const std::string& sysfs_root, CpuTopology* topology) {
+  *topology = CpuTopology();
+  std::string cpu_root = sysfs_root + "/devices/system/cpu";
+  std::vector<size_t> cpu_ids;
+  if (!ReadList(cpu_root + "/online", &cpu_ids) || cpu_ids.empty())
+    return false;
+  std::sort(cpu_ids.begin(), cpu_ids.end());
+
+  // Without NUMA (or sysfs's view of it), everything is on node 0.
+  std::map<size_t, size_t> cpu_nodes;
+  std::string node_root = sysfs_root + "/devices/system/node";
+  std::vector<size_t> node_ids;
+  if (ReadList(node_root + "/online", &node_ids)) {
+    for (size_t node : node_ids) {
+      std::vector<size_t> node_cpus;
+      if (!ReadList(StringPrintf("%s/node%zu/cpulist", node_root.c_str(), node),
+                    &node_cpus))
+        return false;
+      for (size_t cpu : node_cpus)
+        cpu_nodes[cpu] = node;
+    }
+  }
+
+  for (size_t id : cpu_ids) {
+    CpuTopology::Cpu cpu;
+    cpu.id = id;
+    std::string topology_dir =
+        StringPrintf("%s/cpu%zu/topology", cpu_root.c_str(), id);
+    if (!ReadNumber(topology_dir + "/physical_package_id", &cpu.package) ||
+        !ReadNumber(topology_dir + "/core_id", &cpu.core))
+      return false;
+    auto it = cpu_nodes.find(id);
+    cpu.node = it == cpu_nodes.end() ? 0u : it->second;
+    topology->cpus.push_back(cpu);
+  }
+  Summarize(topology);
+  return true;
+}
+
+bool ParseCpuList(StringView list, std::vector<size_t>* cpus) {
+  for (StringView range :
+       SplitString(list, ",", kTrimWhitespace, kSplitWantNonEmpty)) {
+    size_t dash = range.find('-');
+    uint32_t first = 0u;
+    uint32_t last = 0u;
+    if (!StringToNumberWithError(range.substr(0, dash), &first))
+      return false;
+    if (dash == StringView::npos)
+      last = first;
+    else if (!StringToNumberWithError(range.substr(dash + 1), &last))
+      return false;
+    if (last < first)
+      return false;
+    for (uint32_t cpu = first; cpu <= last; cpu++)
+      cpus->push_back(cpu);
+  }
+  return true;
+}
+
+}  // namespace ftl
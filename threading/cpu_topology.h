@@ -0,0 +1,63 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_THREADING_CPU_TOPOLOGY_H_
+#define LIB_FTL_THREADING_CPU_TOPOLOGY_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+
+namespace ftl {
+
+// The machine's (online) logical CPUs, and the physical cores (whose SMT
+// siblings share them), packages (sockets) and NUMA nodes they belong to.
+struct FTL_EXPORT CpuTopology {
+  struct Cpu {
+    // The OS's number for the CPU (as used by |Thread::Options::cpu_affinity|).
+    size_t id = 0u;
+    // The OS's number for its package.
+    size_t package = 0u;
+    // Its physical core, numbered from 0 across all packages. CPUs with the
+    // same core are SMT siblings.
+    size_t core = 0u;
+    // The OS's number for its NUMA node (as used by
+    // |Thread::Options::numa_node|).
+    size_t node = 0u;
+  };
+
+  // Returns the machine's topology, which is read on first use. On Linux, it
+  // comes from sysfs; elsewhere (or if that fails), it's one package and one
+  // NUMA node, with a core for each of |std::thread::hardware_concurrency()|
+  // CPUs.
+  static const CpuTopology& Get();
+
+  // Returns the ids of the CPUs in |node| (or which share |cpu|'s core).
+  std::vector<size_t> GetNodeCpus(size_t node) const;
+  std::vector<size_t> GetSmtSiblings(size_t cpu) const;
+
+  // Ordered by id.
+  std::vector<Cpu> cpus;
+  // The distinct |Cpu::package|s and |Cpu::node|s, in order.
+  std::vector<size_t> packages;
+  std::vector<size_t> nodes;
+  size_t core_count = 0u;
+};
+
+// Reads the topology from the sysfs mounted at |sysfs_root| (normally "/sys"),
+// into |*topology|. Returns false if it can't be read (e.g., not on Linux).
+FTL_EXPORT bool ReadCpuTopology(const std::string& sysfs_root,
+                                CpuTopology* topology);
+
+// Parses a Linux CPU (or node) list (e.g., "0-3,8,10-11"), appending the
+// numbers to |*cpus|.
+FTL_EXPORT bool ParseCpuList(StringView list, std::vector<size_t>* cpus);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_THREADING_CPU_TOPOLOGY_H_
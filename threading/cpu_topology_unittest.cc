@@ -0,0 +1,92 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/cpu_topology.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/files/directory.h"
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/files/scoped_temp_dir.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+namespace {
+
+TEST(CpuTopologyTest, ParseCpuList) {
+  std::vector<size_t> cpus;
+  EXPECT_TRUE(ParseCpuList("0-3,8,10-11\n", &cpus));
+  EXPECT_EQ((std::vector<size_t>{0, 1, 2, 3, 8, 10, 11}), cpus);
+
+  cpus.clear();
+  EXPECT_TRUE(ParseCpuList("", &cpus));
+  EXPECT_TRUE(cpus.empty());
+  EXPECT_FALSE(ParseCpuList("3-1", &cpus));
+  EXPECT_FALSE(ParseCpuList("a", &cpus));
+}
+
+TEST(CpuTopologyTest, Get) {
+  const CpuTopology& topology = CpuTopology::Get();
+  ASSERT_FALSE(topology.cpus.empty());
+  EXPECT_FALSE(topology.packages.empty());
+  EXPECT_FALSE(topology.nodes.empty());
+  EXPECT_GE(topology.core_count, topology.packages.size());
+  EXPECT_LE(topology.core_count, topology.cpus.size());
+
+  size_t node_cpu_count = 0u;
+  for (size_t node : topology.nodes)
+    node_cpu_count += topology.GetNodeCpus(node).size();
+  EXPECT_EQ(topology.cpus.size(), node_cpu_count);
+  std::vector<size_t> siblings = topology.GetSmtSiblings(topology.cpus[0].id);
+  ASSERT_FALSE(siblings.empty());
+  EXPECT_EQ(topology.cpus[0].id, siblings[0]);
+}
+
+void WriteSysfsFile(const std::string& path, const std::string& contents) {
+  ASSERT_TRUE(files::CreateDirectory(path.substr(0, path.rfind('/'))));
+  ASSERT_TRUE(files::WriteFile(path, contents.data(), contents.size()));
+}
+
+// Two packages (each a NUMA node) of two cores with two SMT siblings each,
+// numbered like Linux on x86 (siblings are 4 apart).
+TEST(CpuTopologyTest, ReadCpuTopology) {
+  files::ScopedTempDir temp_dir;
+  const std::string& root = temp_dir.path();
+  WriteSysfsFile(root + "/devices/system/cpu/online", "0-7\n");
+  for (size_t cpu = 0; cpu < 8; cpu++) {
+    std::string dir = StringPrintf("%s/devices/system/cpu/cpu%zu/topology",
+                                   root.c_str(), cpu);
+    WriteSysfsFile(dir + "/physical_package_id",
+                   StringPrintf("%zu\n", (cpu / 2) % 2));
+    WriteSysfsFile(dir + "/core_id", StringPrintf("%zu\n", cpu % 2));
+  }
+  WriteSysfsFile(root + "/devices/system/node/online", "0-1\n");
+  WriteSysfsFile(root + "/devices/system/node/node0/cpulist", "0-1,4-5\n");
+  WriteSysfsFile(root + "/devices/system/node/node1/cpulist", "2-3,6-7\n");
+
+  CpuTopology topology;
+  ASSERT_TRUE(ReadCpuTopology(root, &topology));
+  ASSERT_EQ(8u, topology.cpus.size());
+  EXPECT_EQ((std::vector<size_t>{0, 1}), topology.packages);
+  EXPECT_EQ((std::vector<size_t>{0, 1}), topology.nodes);
+  EXPECT_EQ(4u, topology.core_count);
+  EXPECT_EQ(1u, topology.cpus[6].package);
+  EXPECT_EQ(1u, topology.cpus[6].node);
+  EXPECT_EQ((std::vector<size_t>{2, 3, 6, 7}), topology.GetNodeCpus(1));
+  EXPECT_EQ((std::vector<size_t>{1, 5}), topology.GetSmtSiblings(5));
+
+  // Without NUMA information, everything is on node 0.
+  CpuTopology no_numa;
+  WriteSysfsFile(root + "/devices/system/node/online", "");
+  ASSERT_TRUE(ReadCpuTopology(root, &no_numa));
+  EXPECT_EQ((std::vector<size_t>{0}), no_numa.nodes);
+
+  CpuTopology missing;
+  EXPECT_FALSE(ReadCpuTopology(root + "/missing", &missing));
+}
+
+}  // namespace
+}  // namespace ftl
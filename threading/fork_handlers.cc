@@ -0,0 +1,122 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/fork_handlers.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+#include <pthread.h>
+
+#define FTL_CAN_FORK 1
+#endif
+
+namespace ftl {
+namespace internal {
+
+std::atomic<uint32_t> g_fork_generation(0u);
+
+}  // namespace internal
+
+class ForkHandlersRegistry final {
+ public:
+  static ForkHandlersRegistry* Get() {
+    static ForkHandlersRegistry* registry = new ForkHandlersRegistry();
+    return registry;
+  }
+
+  void Add(ForkHandlers* handlers) {
+    MutexLocker locker(&mutex_);
+    handlers_.push_back(handlers);
+  }
+
+  void Remove(ForkHandlers* handlers) {
+    MutexLocker locker(&mutex_);
+    handlers_.erase(std::find(handlers_.begin(), handlers_.end(), handlers));
+  }
+
+ private:
+  ForkHandlersRegistry() {
+#if defined(FTL_CAN_FORK)
+    const int result = pthread_atfork(&Prepare, &Parent, &Child);
+    FTL_CHECK(result == 0) << "pthread_atfork failed: " << result;
+#endif
+  }
+  ~ForkHandlersRegistry() = delete;
+
+  // (The lock is held across the fork(), so that handlers can't come or go
+  // meanwhile.)
+  static void Prepare() FTL_NO_THREAD_SAFETY_ANALYSIS {
+    ForkHandlersRegistry* registry = Get();
+    registry->mutex_.Lock();
+    for (auto it = registry->handlers_.rbegin();
+         it != registry->handlers_.rend(); ++it) {
+      if ((*it)->prepare_)
+        (*it)->prepare_();
+    }
+  }
+
+  static void Parent() FTL_NO_THREAD_SAFETY_ANALYSIS {
+    ForkHandlersRegistry* registry = Get();
+    for (ForkHandlers* handlers : registry->handlers_) {
+      if (handlers->parent_)
+        handlers->parent_();
+    }
+    registry->mutex_.Unlock();
+  }
+
+  static void Child() FTL_NO_THREAD_SAFETY_ANALYSIS {
+    internal::g_fork_generation.fetch_add(1u, std::memory_order_relaxed);
+    ForkHandlersRegistry* registry = Get();
+    for (ForkHandlers* handlers : registry->handlers_) {
+      if (handlers->child_)
+        handlers->child_();
+    }
+    registry->mutex_.UnlockAfterFork();
+  }
+
+  Mutex mutex_;
+  // In the order they were registered.
+  std::vector<ForkHandlers*> handlers_ FTL_GUARDED_BY(mutex_);
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ForkHandlersRegistry);
+};
+
+void TrackForks() {
+  ForkHandlersRegistry::Get();
+}
+
+ForkHandlers::ForkHandlers(std::function<void()> prepare,
+                           std::function<void()> parent,
+                           std::function<void()> child)
+    : prepare_(std::move(prepare)),
+      parent_(std::move(parent)),
+      child_(std::move(child)) {
+  ForkHandlersRegistry::Get()->Add(this);
+}
+
+ForkHandlers::ForkHandlers(Mutex* mutex, std::function<void()> child)
+    : ForkHandlers([mutex]() FTL_NO_THREAD_SAFETY_ANALYSIS { mutex->Lock(); },
+                   [mutex]() FTL_NO_THREAD_SAFETY_ANALYSIS { mutex->Unlock(); },
+                   [mutex, child]() FTL_NO_THREAD_SAFETY_ANALYSIS {
+                     mutex->UnlockAfterFork();
+                     if (child) {
+                       // (Retaken, so that it's held by this thread's new id.)
+                       MutexLocker locker(mutex);
+                       child();
+                     }
+                   }) {}
+
+ForkHandlers::~ForkHandlers() {
+  ForkHandlersRegistry::Get()->Remove(this);
+}
+
+}  // namespace ftl
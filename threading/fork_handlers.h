@@ -0,0 +1,90 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Support for state which has to be fixed up around a fork(), e.g., a lock
+// which another thread may hold as the process forks (leaving it locked
+// forever in the child, which has only the forking thread), or buffered
+// random bytes (which the child mustn't hand out again), e.g.:
+//
+//   Cache::Cache()
+//       : fork_handlers_(&mutex_, [this] { entries_.clear(); }) {}
+//
+// ftl's own state is fork-safe in this way: in the child, the random
+// generators are reseeded, the binary log's and the asynchronous log's writer
+// threads (and the log file rotator) are restarted, without the parent's
+// buffered messages, and |Thread|s (and so |MessageLoop|s and |ThreadPool|s)
+// that were running in the parent are no longer running (a |ThreadPool|'s
+// tasks don't run, and are dropped when it's shut down).
+//
+// (fork() is only supported on POSIX systems; elsewhere these do nothing.)
+
+#ifndef LIB_FTL_THREADING_FORK_HANDLERS_H_
+#define LIB_FTL_THREADING_FORK_HANDLERS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+namespace ftl {
+
+class Mutex;
+
+namespace internal {
+
+FTL_EXPORT extern std::atomic<uint32_t> g_fork_generation;
+
+}  // namespace internal
+
+// Starts counting forks for |GetForkGeneration()| (if it hasn't already). This
+// must be called before the fork()s to be counted, e.g., when creating the
+// state which is to be reset in a child.
+FTL_EXPORT void TrackForks();
+
+// Returns the number of fork()s (since |TrackForks()| was first called) that
+// separate this process from the one which first called it. State which only
+// needs resetting in the child (and isn't touched by the fork()ing thread
+// meanwhile) can note this, and compare it before each use, e.g.:
+//
+//   if (state->fork_generation != ftl::GetForkGeneration())
+//     state->Reset();
+inline uint32_t GetForkGeneration() {
+  return internal::g_fork_generation.load(std::memory_order_relaxed);
+}
+
+// Runs |prepare| just before each fork() (on the fork()ing thread), and then
+// |parent| in the parent and |child| in the child (as |pthread_atfork()| would,
+// but only while this object exists; any of them may be null). Handlers run in
+// the order they're registered, except that |prepare| handlers run in the
+// reverse order (so, e.g., locks are taken in the reverse order of their
+// handlers' registration, and released in the same order). Handlers mustn't
+// create or destroy |ForkHandlers|, and |child| handlers should only do what's
+// safe in a child process (which has only the fork()ing thread).
+class FTL_EXPORT ForkHandlers final {
+ public:
+  ForkHandlers(std::function<void()> prepare,
+               std::function<void()> parent,
+               std::function<void()> child);
+  // Holds |*mutex| across fork()s (so that the child doesn't inherit it locked
+  // by a thread it doesn't have), calling |child| (if not null) in the child
+  // before releasing it.
+  explicit ForkHandlers(Mutex* mutex, std::function<void()> child = nullptr);
+  ~ForkHandlers();
+
+ private:
+  friend class ForkHandlersRegistry;
+
+  const std::function<void()> prepare_;
+  const std::function<void()> parent_;
+  const std::function<void()> child_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ForkHandlers);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_THREADING_FORK_HANDLERS_H_
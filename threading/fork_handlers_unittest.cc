@@ -0,0 +1,84 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/fork_handlers.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/test/forked_child.h"
+#include "lib/ftl/threading/thread.h"
+
+namespace ftl {
+namespace {
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+TEST(ForkHandlers, Order) {
+  std::string calls;
+  ForkHandlers first([&calls] { calls += "prepare1 "; },
+                     [&calls] { calls += "parent1 "; },
+                     [&calls] { calls += "child1 "; });
+  ForkHandlers second([&calls] { calls += "prepare2 "; },
+                      [&calls] { calls += "parent2 "; },
+                      [&calls] { calls += "child2 "; });
+  std::unique_ptr<ForkHandlers> removed(new ForkHandlers(
+      [&calls] { calls += "removed "; }, nullptr, nullptr));
+  removed.reset();
+  // (Null handlers are skipped.)
+  ForkHandlers third(nullptr, nullptr, nullptr);
+
+  const uint32_t generation = GetForkGeneration();
+  EXPECT_TRUE(RunInForkedChild([&calls, generation] {
+    return calls == "prepare2 prepare1 child1 child2 " &&
+           GetForkGeneration() == generation + 1u;
+  }));
+  EXPECT_EQ("prepare2 prepare1 parent1 parent2 ", calls);
+  EXPECT_EQ(generation, GetForkGeneration());
+}
+
+TEST(ForkHandlers, HoldsMutex) {
+  Mutex mutex;
+  ForkHandlers fork_handlers(&mutex);
+
+  // Fork while another thread holds the lock: the fork() waits for it, so
+  // that the child can take it.
+  AutoResetWaitableEvent locked;
+  Thread thread([&mutex, &locked] {
+    MutexLocker locker(&mutex);
+    locked.Signal();
+    SleepFor(TimeDelta::FromMilliseconds(20));
+  });
+  ASSERT_TRUE(thread.Run());
+  locked.Wait();
+  EXPECT_TRUE(RunInForkedChild([&mutex] {
+    MutexLocker locker(&mutex);
+    return true;
+  }));
+  EXPECT_TRUE(thread.Join());
+  MutexLocker locker(&mutex);
+}
+
+TEST(ForkHandlers, ChildHandlerHoldsMutex) {
+  Mutex mutex;
+  bool reset = false;
+  ForkHandlers fork_handlers(&mutex, [&mutex, &reset] {
+    mutex.AssertHeld();
+    reset = true;
+  });
+  EXPECT_TRUE(RunInForkedChild([&mutex, &reset] {
+    MutexLocker locker(&mutex);
+    return reset;
+  }));
+  EXPECT_FALSE(reset);
+}
+
+#endif  // !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+}  // namespace
+}  // namespace ftl
@@ -6,65 +6,342 @@
 
 #include <limits.h>
 
+#if !defined(OS_WIN)
+#include <sched.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+#include <iterator>
+
+#include "lib/ftl/debug/cpu_profiler.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/threading/fork_handlers.h"
+#include "lib/ftl/threading/thread_registry.h"
+
+#if defined(OS_LINUX)
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/threading/cpu_topology.h"
+#endif
 
 namespace ftl {
+namespace {
+
+#if defined(OS_LINUX)
+
+// Computes the CPUs a thread with |options| should be restricted to, in
+// |*cpus| (if empty, there is no restriction).
+bool GetCpuSet(const Thread::Options& options, std::vector<size_t>* cpus) {
+  *cpus = options.cpu_affinity;
+  if (options.numa_node < 0)
+    return true;
+
+  std::string list;
+  std::vector<size_t> node_cpus;
+  if (!files::ReadFileToString(
+          StringPrintf("/sys/devices/system/node/node%d/cpulist",
+                       options.numa_node),
+          &list) ||
+      !ParseCpuList(list, &node_cpus) || node_cpus.empty())
+    return false;
+  if (cpus->empty()) {
+    cpus->swap(node_cpus);
+    return true;
+  }
+  std::vector<size_t> requested = *cpus;
+  std::sort(requested.begin(), requested.end());
+  cpus->clear();
+  std::set_intersection(requested.begin(), requested.end(), node_cpus.begin(),
+                        node_cpus.end(), std::back_inserter(*cpus));
+  return !cpus->empty();
+}
+
+bool SetAffinity(pthread_attr_t* attr, const std::vector<size_t>& cpus) {
+  if (cpus.empty())
+    return true;
+
+  size_t cpu_count = *std::max_element(cpus.begin(), cpus.end()) + 1u;
+  cpu_set_t* set = CPU_ALLOC(cpu_count);
+  if (!set)
+    return false;
+  size_t set_size = CPU_ALLOC_SIZE(cpu_count);
+  CPU_ZERO_S(set_size, set);
+  for (size_t cpu : cpus)
+    CPU_SET_S(cpu, set_size, set);
+  bool result = pthread_attr_setaffinity_np(attr, set_size, set) == 0;
+  CPU_FREE(set);
+  return result;
+}
+
+#endif  // defined(OS_LINUX)
+
+#if !defined(OS_WIN)
+
+bool SetScheduling(pthread_attr_t* attr,
+                   Thread::SchedulingPolicy policy,
+                   int priority) {
+  int native_policy = SCHED_OTHER;
+  switch (policy) {
+    case Thread::SchedulingPolicy::kDefault:
+      return priority == 0;
+    case Thread::SchedulingPolicy::kOther:
+      native_policy = SCHED_OTHER;
+      break;
+    case Thread::SchedulingPolicy::kBatch:
+    case Thread::SchedulingPolicy::kIdle:
+#if defined(OS_LINUX)
+      // These can't be set via |pthread_attr_t|, so the thread switches to them
+      // itself (see |SetCurrentThreadScheduling()|), which doesn't need any
+      // privileges.
+      return priority == 0;
+#else
+      return false;
+#endif
+    case Thread::SchedulingPolicy::kFifo:
+      native_policy = SCHED_FIFO;
+      break;
+    case Thread::SchedulingPolicy::kRoundRobin:
+      native_policy = SCHED_RR;
+      break;
+  }
+
+  struct sched_param param = {};
+  param.sched_priority = priority;
+  return pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) == 0 &&
+         pthread_attr_setschedpolicy(attr, native_policy) == 0 &&
+         pthread_attr_setschedparam(attr, &param) == 0;
+}
+
+void SetCurrentThreadScheduling(Thread::SchedulingPolicy policy) {
+#if defined(OS_LINUX)
+  struct sched_param param = {};
+  if (policy == Thread::SchedulingPolicy::kBatch)
+    pthread_setschedparam(pthread_self(), SCHED_BATCH, &param);
+  else if (policy == Thread::SchedulingPolicy::kIdle)
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+std::string GetCurrentThreadName() {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  char name[16] = {};
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0)
+    return name;
+#endif
+  return std::string();
+}
+
+void SetCurrentThreadName(const std::string& name) {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Names (including the terminating null) are limited to 16 bytes.
+  pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#elif defined(OS_MACOSX)
+  pthread_setname_np(name.c_str());
+#endif
+}
+
+#endif  // !defined(OS_WIN)
+
+}  // namespace
+
+struct Thread::Context {
+  std::function<void(void)> runnable;
+  void (*function)(void* argument) = nullptr;
+  void* argument = nullptr;
+  // Applied by the thread itself, when it starts.
+  std::string name;
+  SchedulingPolicy scheduling_policy = SchedulingPolicy::kDefault;
+#if !defined(OS_WIN) && !defined(LIBC_GLIBC)
+  // Signaled as the thread finishes, for |TryJoinFor()| (which glibc's
+  // |pthread_timedjoin_np()| does directly).
+  ManualResetWaitableEvent finished;
+#endif
+  // The thread's, and this |Thread|'s until it's joined or detached.
+  std::atomic<int> references{2};
+};
 
 Thread::Thread(std::function<void(void)> runnable)
     : runnable_(std::move(runnable)), running_(false) {}
 
+Thread::Thread(void (*function)(void* argument), void* argument)
+    : function_(function), argument_(argument), running_(false) {}
+
 Thread::~Thread() {
   Join();
 }
 
 bool Thread::Run(size_t stack_size) {
-  if (running_) {
+  Options options;
+  options.stack_size = stack_size;
+  return Run(options);
+}
+
+bool Thread::Run(const Options& options) {
+  ForgetThreadIfForked();
+  if (running_ || (!runnable_ && !function_)) {
     return false;
   }
+  TrackForks();
+  fork_generation_ = GetForkGeneration();
 #if defined(OS_WIN)
-  thread_ = CreateThread(NULL, stack_size, (LPTHREAD_START_ROUTINE)&Thread::Entry, this, 0, NULL);
+  if (!options.name.empty() || !options.cpu_affinity.empty() ||
+      options.numa_node >= 0 ||
+      options.scheduling_policy != SchedulingPolicy::kDefault ||
+      options.stack || options.stack_pool) {
+    return false;
+  }
+  Context* context = new Context();
+  context->runnable = std::move(runnable_);
+  context->function = function_;
+  context->argument = argument_;
+  thread_ = CreateThread(NULL, options.stack_size, (LPTHREAD_START_ROUTINE)&Thread::Entry, context, 0, NULL);
   if (thread_ != NULL) {
     running_ = true;
   }
 #else
+#if !defined(OS_LINUX)
+  if (!options.cpu_affinity.empty() || options.numa_node >= 0) {
+    return false;
+  }
+#endif
+  if (options.stack && options.stack_pool) {
+    return false;
+  }
+
   pthread_attr_t attr;
 
   if (pthread_attr_init(&attr) != 0) {
     return false;
   }
 
-  stack_size = std::max<size_t>(PTHREAD_STACK_MIN, stack_size);
+  size_t stack_size = std::max<size_t>(PTHREAD_STACK_MIN, options.stack_size);
 
-  if (pthread_attr_setstacksize(&attr, stack_size) != 0) {
+  if (pthread_attr_setstacksize(&attr, stack_size) != 0 ||
+      !SetScheduling(&attr, options.scheduling_policy,
+                     options.scheduling_priority)) {
     pthread_attr_destroy(&attr);
     return false;
   }
 
-  auto result = pthread_create(&thread_, &attr, &Thread::Entry, this);
+#if defined(OS_LINUX)
+  std::vector<size_t> cpus;
+  if (!GetCpuSet(options, &cpus) || !SetAffinity(&attr, cpus)) {
+    pthread_attr_destroy(&attr);
+    return false;
+  }
+#endif
+
+  ThreadStack* stack = options.stack;
+  std::unique_ptr<ThreadStack> pooled_stack;
+  if (options.stack_pool) {
+    pooled_stack = options.stack_pool->Acquire();
+    stack = pooled_stack.get();
+  }
+  if ((options.stack_pool && !stack) ||
+      (stack &&
+       pthread_attr_setstack(&attr, stack->base(), stack->size()) != 0)) {
+    if (pooled_stack)
+      options.stack_pool->Release(std::move(pooled_stack));
+    pthread_attr_destroy(&attr);
+    return false;
+  }
+
+  Context* context = new Context();
+  context->runnable = std::move(runnable_);
+  context->function = function_;
+  context->argument = argument_;
+  context->name = options.name;
+  context->scheduling_policy = options.scheduling_policy;
+  auto result = pthread_create(&thread_, &attr, &Thread::Entry, context);
   if (result == 0) {
     running_ = true;
+    stack_ = stack;
+    stack_pool_ = options.stack_pool;
+    pooled_stack_ = std::move(pooled_stack);
+  } else if (pooled_stack) {
+    options.stack_pool->Release(std::move(pooled_stack));
   }
 
   pthread_attr_destroy(&attr);
 #endif
 
+  if (running_) {
+    context_ = context;
+  } else {
+    runnable_ = std::move(context->runnable);
+    delete context;
+  }
   return running_;
 }
 
 bool Thread::IsRunning() const {
-  return running_;
+  return running_ && fork_generation_ == GetForkGeneration();
 }
 
-void Thread::Main(void) {
-  runnable_();
+void* Thread::Entry(void* argument) {
+  Context* context = static_cast<Context*>(argument);
+#if !defined(OS_WIN)
+  if (!context->name.empty())
+    SetCurrentThreadName(context->name);
+  SetCurrentThreadScheduling(context->scheduling_policy);
+  RegisterCurrentThread(context->name.empty() ? GetCurrentThreadName()
+                                              : context->name);
+#else
+  RegisterCurrentThread(std::string());
+#endif
+  RegisterThreadForCpuProfiling();
+  if (context->function)
+    context->function(context->argument);
+  else
+    context->runnable();
+#if !defined(OS_WIN) && !defined(LIBC_GLIBC)
+  context->finished.Signal();
+#endif
+  ReleaseContext(context);
+  return nullptr;
 }
 
-void* Thread::Entry(void* context) {
-  ((Thread*)context)->Main();
-  return nullptr;
+// static
+void Thread::ReleaseContext(Context* context) {
+  if (context->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete context;
+}
+
+void Thread::FinishJoin() {
+  running_ = false;
+  // (The thread is done with it.)
+  runnable_ = std::move(context_->runnable);
+  ReleaseContext(context_);
+  context_ = nullptr;
+
+  if (stack_) {
+    stack_high_water_mark_ = stack_->GetHighWaterMark();
+    stack_ = nullptr;
+  }
+  if (pooled_stack_) {
+    stack_pool_->Release(std::move(pooled_stack_));
+    stack_pool_ = nullptr;
+  }
+}
+
+void Thread::ForgetThreadIfForked() {
+  if (!running_ || fork_generation_ == GetForkGeneration())
+    return;
+  // The runnable is taken back (so that this can run again), but its context
+  // (and stack) are leaked, since the parent's thread would have released
+  // them, and the child mustn't use the stack pool (whose lock another of the
+  // parent's threads may have held).
+  running_ = false;
+  runnable_ = std::move(context_->runnable);
+  context_ = nullptr;
+  stack_ = nullptr;
+  stack_pool_ = nullptr;
+  pooled_stack_.release();
 }
 
 bool Thread::Join() {
+  ForgetThreadIfForked();
   if (!running_) {
     return false;
   }
@@ -76,9 +353,61 @@ bool Thread::Join() {
 #endif
 
   if (exit_code == 0) {
-    running_ = false;
+    FinishJoin();
   }
   return !running_;
 }
 
+bool Thread::TryJoinFor(TimeDelta timeout) {
+  ForgetThreadIfForked();
+  if (!running_) {
+    return false;
+  }
+
+#if defined(OS_WIN)
+  // (Rounded up to whole milliseconds.)
+  const int64_t milliseconds = std::min<int64_t>(
+      std::max<int64_t>((timeout.ToMicroseconds() + 999) / 1000, 0),
+      INFINITE - 1);
+  if (WaitForSingleObject(thread_, static_cast<DWORD>(milliseconds)) != 0) {
+    return false;
+  }
+#elif defined(LIBC_GLIBC)
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  TimeDelta deadline =
+      TimeDelta::FromTimespec(now) + std::max(timeout, TimeDelta::Zero());
+  const struct timespec deadline_timespec = deadline.ToTimespec();
+  if (pthread_timedjoin_np(thread_, nullptr, &deadline_timespec) != 0) {
+    return false;
+  }
+#else
+  if (context_->finished.WaitWithTimeout(timeout) ||
+      pthread_join(thread_, nullptr) != 0) {
+    return false;
+  }
+#endif
+
+  FinishJoin();
+  return true;
+}
+
+bool Thread::Detach() {
+  ForgetThreadIfForked();
+  if (!running_ || stack_) {
+    return false;
+  }
+
+#if defined(OS_WIN)
+  CloseHandle(thread_);
+#else
+  pthread_detach(thread_);
+#endif
+  running_ = false;
+  // (The thread keeps the runnable.)
+  ReleaseContext(context_);
+  context_ = nullptr;
+  return true;
+}
+
 }  // namespace ftl
@@ -14,9 +14,14 @@
 #endif
 
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "lib/ftl/ftl_export.h"
 #include "lib/ftl/macros.h"
+#include "lib/ftl/threading/thread_stack.h"
+#include "lib/ftl/time/time_delta.h"
 
 namespace ftl {
 
@@ -24,17 +29,115 @@ class FTL_EXPORT Thread {
  public:
   static constexpr size_t default_stack_size = 1 * 1024 * 1024;
 
+  enum class SchedulingPolicy {
+    // Inherit the scheduling policy and priority of the creating thread.
+    kDefault,
+    // The standard time-sharing policy (|SCHED_OTHER|).
+    kOther,
+    // Time-sharing, but for CPU-bound, non-interactive work (|SCHED_BATCH|;
+    // Linux only).
+    kBatch,
+    // For very low priority background work (|SCHED_IDLE|; Linux only).
+    kIdle,
+    // Real-time policies (|SCHED_FIFO| and |SCHED_RR|). These generally need
+    // elevated privileges.
+    kFifo,
+    kRoundRobin,
+  };
+
+  // Configuration for |Run()|. Options other than |stack_size| are currently
+  // only supported on POSIX systems (and some only on Linux, as noted);
+  // |Run()| fails if an unsupported option is set.
+  struct Options {
+    size_t stack_size = default_stack_size;
+
+    // A stack to run on (instead of one of |stack_size| from the thread
+    // library), which no other thread may use until this one is joined. Or a
+    // pool to take one from, which it's returned to once the thread is joined.
+    // At most one of these may be set. (Detached threads can't use either.)
+    ThreadStack* stack = nullptr;
+    ThreadStackPool* stack_pool = nullptr;
+
+    // The name of the thread, as shown by debuggers and tools like top and
+    // perf. Linux truncates it to 15 characters. If empty, the name is
+    // inherited from the creating thread.
+    std::string name;
+
+    // The CPUs the thread may run on. If empty, the thread may run on any CPU
+    // (or any CPU in |numa_node|). Linux only.
+    std::vector<size_t> cpu_affinity;
+
+    // The NUMA node whose CPUs the thread should run on, or -1 for none. If
+    // |cpu_affinity| is also set, the thread runs on the CPUs in both. Linux
+    // only.
+    int numa_node = -1;
+
+    SchedulingPolicy scheduling_policy = SchedulingPolicy::kDefault;
+    // The static priority for |kFifo| and |kRoundRobin| (see
+    // |sched_get_priority_min()|/|sched_get_priority_max()|); must be zero for
+    // the other policies.
+    int scheduling_priority = 0;
+  };
+
   explicit Thread(std::function<void(void)> runnable);
+  // Runs |function(argument)|, without the allocation that a |std::function|
+  // may need for its target.
+  Thread(void (*function)(void* argument), void* argument);
+  // Joins the thread, if it's running (and wasn't detached).
   ~Thread();
   bool Run(size_t stack_size = default_stack_size);
+  // Starts the thread with the given |options|. Returns false if the thread is
+  // already running, or could not be created as specified (e.g., because the
+  // caller lacks the privileges for a real-time |scheduling_policy|), or was
+  // detached (which gives it the runnable).
+  bool Run(const Options& options);
+  // In the child of a fork(), a thread which was running in the parent isn't
+  // running (so |Join()| returns false), and this may |Run()| again.
   bool IsRunning() const;
   bool Join();
 
+  // Like |Join()|, but gives up (returning false, with the thread still
+  // running) if the thread hasn't finished within |timeout|.
+  bool TryJoinFor(TimeDelta timeout);
+
+  // Lets the thread run to completion on its own, after which this |Thread|
+  // is no longer running, and may be destroyed (while the thread keeps its
+  // runnable). Returns false if it wasn't running, or runs on a stack from
+  // |Options::stack| or |Options::stack_pool| (which it would still be using
+  // as it exits).
+  bool Detach();
+
+  // Returns the most stack (see |ThreadStack::GetHighWaterMark()|) the thread
+  // had used when it was last joined, if it ran on a stack from
+  // |Options::stack| or |Options::stack_pool|; otherwise zero.
+  size_t GetStackHighWaterMark() const { return stack_high_water_mark_; }
+
  private:
+  // What the thread needs, which it shares with this |Thread| until it's
+  // joined or detached.
+  struct Context;
+
   static void* Entry(void* context);
-  void Main();
+  // Drops a reference to |context|, deleting it if it was the last.
+  static void ReleaseContext(Context* context);
+  // After the thread is joined, takes the runnable back from |context_|, and
+  // releases it.
+  void FinishJoin();
+  // In the child of a fork(), forgets the (parent's) thread, if it was running.
+  void ForgetThreadIfForked();
 
   std::function<void(void)> runnable_;
+  void (*function_)(void* argument) = nullptr;
+  void* argument_ = nullptr;
+  Context* context_ = nullptr;
+  // The stack the thread runs on, if it's from |Options|, and the pool it's
+  // from (if any), which |pooled_stack_| is returned to.
+  ThreadStack* stack_ = nullptr;
+  ThreadStackPool* stack_pool_ = nullptr;
+  std::unique_ptr<ThreadStack> pooled_stack_;
+  size_t stack_high_water_mark_ = 0u;
+  // As of |Run()| (see |GetForkGeneration()|).
+  uint32_t fork_generation_ = 0u;
 #if defined(OS_WIN)
   HANDLE thread_;
 #else
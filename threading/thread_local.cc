@@ -0,0 +1,220 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/thread_local.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/threading/fork_handlers.h"
+
+#if !defined(OS_WIN)
+#include <pthread.h>
+#endif
+
+namespace ftl {
+namespace internal {
+
+FTL_THREAD_LOCAL_INITIAL_EXEC_ ThreadLocalSlots g_thread_local_slots = {
+    nullptr, 0u};
+
+namespace {
+
+using Deleter = void (*)(void* value);
+
+// A thread's values, by slot.
+struct ThreadRecord {
+  std::vector<void*> values;
+};
+
+// The calling thread's record (created on its first |SetValue()|).
+FTL_THREAD_LOCAL_INITIAL_EXEC_ ThreadRecord* g_thread_record = nullptr;
+
+class Registry final {
+ public:
+  static Registry* Get() {
+    static Registry* registry = new Registry();
+    return registry;
+  }
+
+  size_t AllocateSlot(Deleter deleter) {
+    MutexLocker locker(&mutex_);
+    if (free_slots_.empty()) {
+      deleters_.push_back(deleter);
+      return deleters_.size() - 1u;
+    }
+    const size_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    deleters_[slot] = deleter;
+    return slot;
+  }
+
+  // Frees |slot|, deleting every thread's value in it.
+  void FreeSlot(size_t slot) {
+    std::vector<void*> values;
+    Deleter deleter;
+    {
+      MutexLocker locker(&mutex_);
+      for (ThreadRecord* record : records_) {
+        if (slot < record->values.size() && record->values[slot]) {
+          values.push_back(record->values[slot]);
+          record->values[slot] = nullptr;
+        }
+      }
+      deleter = deleters_[slot];
+      deleters_[slot] = nullptr;
+      free_slots_.push_back(slot);
+    }
+    for (void* value : values)
+      deleter(value);
+  }
+
+  // Sets the calling thread's value in |slot|, and returns the old one.
+  void* SetValue(size_t slot, void* value) {
+    ThreadRecord* record = GetOrCreateRecord();
+    MutexLocker locker(&mutex_);
+    if (record->values.size() <= slot) {
+      // (Any other thread only reads the vector with the lock held.)
+      record->values.resize(std::max(slot + 1u, 2u * record->values.size()),
+                            nullptr);
+      g_thread_local_slots.values = record->values.data();
+      g_thread_local_slots.size = record->values.size();
+    }
+    std::swap(record->values[slot], value);
+    return value;
+  }
+
+  void ForEachValue(size_t slot,
+                    void (*callback)(void* value, void* context),
+                    void* context) {
+    MutexLocker locker(&mutex_);
+    for (ThreadRecord* record : records_) {
+      if (slot < record->values.size() && record->values[slot])
+        callback(record->values[slot], context);
+    }
+  }
+
+  // Deletes the exiting thread's values, and then its record.
+  void DestroyRecord(ThreadRecord* record) {
+    // Deleting values may set others (or the same ones again), so repeat until
+    // there are none.
+    for (;;) {
+      std::vector<std::pair<void*, Deleter>> values;
+      {
+        MutexLocker locker(&mutex_);
+        for (size_t slot = 0u; slot < record->values.size(); slot++) {
+          if (record->values[slot]) {
+            values.push_back(
+                std::make_pair(record->values[slot], deleters_[slot]));
+            record->values[slot] = nullptr;
+          }
+        }
+      }
+      if (values.empty())
+        break;
+      for (const auto& value : values)
+        value.second(value.first);
+    }
+
+    {
+      MutexLocker locker(&mutex_);
+      records_.erase(std::find(records_.begin(), records_.end(), record));
+    }
+    g_thread_local_slots.values = nullptr;
+    g_thread_local_slots.size = 0u;
+    g_thread_record = nullptr;
+    delete record;
+  }
+
+ private:
+  Registry() : fork_handlers_(&mutex_) {
+#if !defined(OS_WIN)
+    const int result = pthread_key_create(&key_, &OnThreadExit);
+    FTL_CHECK(result == 0) << "pthread_key_create failed: " << result;
+#endif
+  }
+  ~Registry() = delete;
+
+#if defined(OS_WIN)
+  // Destroys the thread's record when it exits.
+  class RecordOwner final {
+   public:
+    RecordOwner() {}
+    ~RecordOwner() {
+      if (g_thread_record)
+        Registry::Get()->DestroyRecord(g_thread_record);
+    }
+
+   private:
+    FTL_DISALLOW_COPY_AND_ASSIGN(RecordOwner);
+  };
+#else
+  static void OnThreadExit(void* record) {
+    Registry::Get()->DestroyRecord(static_cast<ThreadRecord*>(record));
+  }
+#endif
+
+  ThreadRecord* GetOrCreateRecord() {
+    if (g_thread_record)
+      return g_thread_record;
+    ThreadRecord* record = new ThreadRecord();
+    {
+      MutexLocker locker(&mutex_);
+      records_.push_back(record);
+    }
+#if defined(OS_WIN)
+    static thread_local RecordOwner owner;
+#else
+    // (Thread-specific data's destructors run after those of |thread_local|
+    // variables, and again if they set it.)
+    pthread_setspecific(key_, record);
+#endif
+    g_thread_record = record;
+    return record;
+  }
+
+#if !defined(OS_WIN)
+  pthread_key_t key_;
+#endif
+
+  Mutex mutex_;
+  // By slot (null for freed slots).
+  std::vector<Deleter> deleters_ FTL_GUARDED_BY(mutex_);
+  std::vector<size_t> free_slots_ FTL_GUARDED_BY(mutex_);
+  // The records' vectors only change with |mutex_| held.
+  std::vector<ThreadRecord*> records_ FTL_GUARDED_BY(mutex_);
+  // (In the child of a fork(), the parent's other threads' records stay, with
+  // their values, which are never destroyed.)
+  ForkHandlers fork_handlers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(Registry);
+};
+
+}  // namespace
+
+ThreadLocalBase::ThreadLocalBase(Deleter deleter)
+    : deleter_(deleter), slot_(Registry::Get()->AllocateSlot(deleter)) {}
+
+ThreadLocalBase::~ThreadLocalBase() {
+  Registry::Get()->FreeSlot(slot_);
+}
+
+void ThreadLocalBase::SetValue(void* value) {
+  void* old_value = Registry::Get()->SetValue(slot_, value);
+  if (old_value && old_value != value)
+    deleter_(old_value);
+}
+
+void ThreadLocalBase::ForEachValue(void (*callback)(void* value, void* context),
+                                   void* context) const {
+  Registry::Get()->ForEachValue(slot_, callback, context);
+}
+
+}  // namespace internal
+}  // namespace ftl
@@ -0,0 +1,162 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Per-thread values which (unlike |thread_local| variables) can be members of
+// objects, are destroyed when their thread exits, and can all be visited
+// (e.g., to add up per-thread counts), e.g.:
+//
+//   class RequestStats {
+//    public:
+//     void OnRequest() { counts_->fetch_add(1u, std::memory_order_relaxed); }
+//
+//     // (Of the threads which haven't exited.)
+//     uint64_t GetTotal() const {
+//       uint64_t total = 0u;
+//       counts_.ForEach([&total](std::atomic<uint64_t>* count) {
+//         total += count->load(std::memory_order_relaxed);
+//       });
+//       return total;
+//     }
+//
+//    private:
+//     ftl::ThreadLocal<std::atomic<uint64_t>> counts_;
+//   };
+//
+// Getting the calling thread's value, once it has one, is a load from static
+// TLS (the "initial-exec" model, where the compiler supports it), a bounds
+// check and a load. The first access on a thread, and |Reset()|, lock.
+//
+// A thread's values are destroyed after its |thread_local| variables (so those
+// can still use them), when it exits (except for the main thread's, which
+// last until the process exits). Destroying a |ThreadLocal| destroys all the
+// threads' values, so no other thread may be using it by then.
+
+#ifndef LIB_FTL_THREADING_THREAD_LOCAL_H_
+#define LIB_FTL_THREADING_THREAD_LOCAL_H_
+
+#include <stddef.h>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+
+#if defined(__GNUC__)
+#define FTL_THREAD_LOCAL_INITIAL_EXEC_ \
+  __thread __attribute__((tls_model("initial-exec")))
+#else
+#define FTL_THREAD_LOCAL_INITIAL_EXEC_ thread_local
+#endif
+
+namespace ftl {
+namespace internal {
+
+// The calling thread's values, by slot (see |ThreadLocalBase|).
+struct ThreadLocalSlots {
+  void** values;
+  size_t size;
+};
+
+FTL_EXPORT extern FTL_THREAD_LOCAL_INITIAL_EXEC_ ThreadLocalSlots
+    g_thread_local_slots;
+
+// The type-erased part of |ThreadLocalPtr|: each instance has a slot in every
+// thread's values.
+class FTL_EXPORT ThreadLocalBase {
+ protected:
+  using Deleter = void (*)(void* value);
+
+  explicit ThreadLocalBase(Deleter deleter);
+  ~ThreadLocalBase();
+
+  void* GetValue() const {
+    const ThreadLocalSlots& slots = g_thread_local_slots;
+    return slot_ < slots.size ? slots.values[slot_] : nullptr;
+  }
+
+  // Replaces the calling thread's value, deleting the old one (if any).
+  void SetValue(void* value);
+
+  // Calls |callback(value, context)| with each thread's value (if it has one),
+  // while holding a lock which keeps threads from exiting or setting values.
+  void ForEachValue(void (*callback)(void* value, void* context),
+                    void* context) const;
+
+ private:
+  const Deleter deleter_;
+  const size_t slot_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadLocalBase);
+};
+
+}  // namespace internal
+
+// A pointer per thread (null until the thread sets it), which owns what it
+// points to.
+template <typename T>
+class ThreadLocalPtr final : public internal::ThreadLocalBase {
+ public:
+  ThreadLocalPtr() : ThreadLocalBase(&Delete) {}
+  ~ThreadLocalPtr() {}
+
+  // Returns the calling thread's pointer.
+  T* Get() const { return static_cast<T*>(GetValue()); }
+
+  // Sets the calling thread's pointer (which this then owns), deleting the old
+  // one.
+  void Reset(T* value = nullptr) { SetValue(value); }
+
+  // Calls |callback(T*)| with each thread's (non-null) pointer. The threads
+  // may be using their values meanwhile, so |callback| must synchronize with
+  // them (e.g., use atomics), and it mustn't use this |ThreadLocalPtr| (other
+  // than |Get()|).
+  template <typename Callback>
+  void ForEach(Callback callback) const {
+    ForEachValue(
+        [](void* value, void* context) {
+          (*static_cast<Callback*>(context))(static_cast<T*>(value));
+        },
+        &callback);
+  }
+
+ private:
+  static void Delete(void* value) { delete static_cast<T*>(value); }
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadLocalPtr);
+};
+
+// A value per thread, default-constructed on its first use on the thread.
+template <typename T>
+class ThreadLocal final {
+ public:
+  ThreadLocal() {}
+  ~ThreadLocal() {}
+
+  // Returns the calling thread's value.
+  T* Get() const {
+    T* value = pointer_.Get();
+    if (!value) {
+      value = new T();
+      pointer_.Reset(value);
+    }
+    return value;
+  }
+
+  T* operator->() const { return Get(); }
+  T& operator*() const { return *Get(); }
+
+  // Calls |callback(T*)| with each thread's value (for those which have used
+  // it). See |ThreadLocalPtr::ForEach()|.
+  template <typename Callback>
+  void ForEach(Callback callback) const {
+    pointer_.ForEach(callback);
+  }
+
+ private:
+  mutable ThreadLocalPtr<T> pointer_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadLocal);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_THREADING_THREAD_LOCAL_H_
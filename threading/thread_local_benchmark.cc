@@ -0,0 +1,27 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/test/benchmark.h"
+#include "lib/ftl/threading/thread_local.h"
+
+namespace ftl {
+namespace {
+
+void BM_ThreadLocalGet(benchmark::State& state) {
+  static ThreadLocal<int>* value = new ThreadLocal<int>();
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(value->Get());
+}
+FTL_BENCHMARK(BM_ThreadLocalGet)->ThreadRange(1, 4);
+
+// A |thread_local| variable, for comparison.
+void BM_ThreadLocalVariable(benchmark::State& state) {
+  thread_local int value = 0;
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(&value);
+}
+FTL_BENCHMARK(BM_ThreadLocalVariable)->ThreadRange(1, 4);
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,171 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/thread_local.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/threading/thread.h"
+
+namespace ftl {
+namespace {
+
+// Counts its live instances.
+class Tracked {
+ public:
+  Tracked() { count_++; }
+  ~Tracked() { count_--; }
+
+  static int count() { return count_.load(); }
+
+  int value = 0;
+
+ private:
+  static std::atomic<int> count_;
+};
+
+std::atomic<int> Tracked::count_(0);
+
+TEST(ThreadLocal, PerThread) {
+  ThreadLocal<int> value;
+  *value = 1;
+  EXPECT_EQ(1, *value);
+  std::thread([&value] {
+    EXPECT_EQ(0, *value);
+    *value = 2;
+    EXPECT_EQ(2, *value);
+  }).join();
+  EXPECT_EQ(1, *value);
+
+  // Each instance has its own value.
+  ThreadLocal<int> other;
+  EXPECT_EQ(0, *other);
+  EXPECT_NE(value.Get(), other.Get());
+}
+
+TEST(ThreadLocal, DestroyedWhenThreadsExit) {
+  const int initial_count = Tracked::count();
+  ThreadLocal<Tracked> tracked;
+  std::thread([&tracked, initial_count] {
+    tracked->value = 1;
+    EXPECT_EQ(initial_count + 1, Tracked::count());
+  }).join();
+  EXPECT_EQ(initial_count, Tracked::count());
+
+  Thread thread([&tracked] { tracked->value = 2; });
+  ASSERT_TRUE(thread.Run());
+  ASSERT_TRUE(thread.Join());
+  EXPECT_EQ(initial_count, Tracked::count());
+}
+
+TEST(ThreadLocal, DestroyedWithTheThreadLocal) {
+  const int initial_count = Tracked::count();
+  std::unique_ptr<ThreadLocal<Tracked>> tracked(new ThreadLocal<Tracked>());
+  (*tracked)->value = 1;
+  AutoResetWaitableEvent set;
+  AutoResetWaitableEvent done;
+  std::thread thread([&] {
+    (*tracked)->value = 2;
+    set.Signal();
+    done.Wait();
+  });
+  set.Wait();
+  EXPECT_EQ(initial_count + 2, Tracked::count());
+  // Both threads' values go with it (while the other thread isn't using its
+  // value).
+  tracked.reset();
+  EXPECT_EQ(initial_count, Tracked::count());
+  done.Signal();
+  thread.join();
+  EXPECT_EQ(initial_count, Tracked::count());
+
+  // Its slot is reused, without the old values.
+  ThreadLocalPtr<Tracked> pointer;
+  EXPECT_FALSE(pointer.Get());
+}
+
+TEST(ThreadLocal, ForEach) {
+  ThreadLocal<std::atomic<int>> counts;
+  constexpr int kThreads = 4;
+  AutoResetWaitableEvent counted[kThreads];
+  ManualResetWaitableEvent done;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreads; i++) {
+    threads.emplace_back([&counts, &counted, &done, i] {
+      counts->store(i + 1);
+      counted[i].Signal();
+      done.Wait();
+    });
+  }
+  for (auto& event : counted)
+    event.Wait();
+  counts->store(100);
+
+  int total = 0;
+  int instances = 0;
+  counts.ForEach([&total, &instances](std::atomic<int>* count) {
+    total += count->load();
+    instances++;
+  });
+  EXPECT_EQ(kThreads + 1, instances);
+  EXPECT_EQ(1 + 2 + 3 + 4 + 100, total);
+
+  done.Signal();
+  for (auto& thread : threads)
+    thread.join();
+  total = 0;
+  counts.ForEach([&total](std::atomic<int>* count) { total += count->load(); });
+  EXPECT_EQ(100, total);
+}
+
+TEST(ThreadLocalPtr, Reset) {
+  const int initial_count = Tracked::count();
+  ThreadLocalPtr<Tracked> pointer;
+  EXPECT_FALSE(pointer.Get());
+  Tracked* tracked = new Tracked();
+  pointer.Reset(tracked);
+  EXPECT_EQ(tracked, pointer.Get());
+  pointer.Reset(new Tracked());
+  EXPECT_EQ(initial_count + 1, Tracked::count());
+  pointer.Reset();
+  EXPECT_FALSE(pointer.Get());
+  EXPECT_EQ(initial_count, Tracked::count());
+  std::thread([&pointer] { EXPECT_FALSE(pointer.Get()); }).join();
+}
+
+// Sets another |ThreadLocalPtr|'s value from its destructor, as the thread
+// exits.
+class SetsAnother {
+ public:
+  explicit SetsAnother(ThreadLocalPtr<Tracked>* other) : other_(other) {}
+  ~SetsAnother() { other_->Reset(new Tracked()); }
+
+ private:
+  ThreadLocalPtr<Tracked>* const other_;
+};
+
+TEST(ThreadLocalPtr, SetFromDestructors) {
+  const int initial_count = Tracked::count();
+  ThreadLocalPtr<Tracked> tracked;
+  ThreadLocalPtr<SetsAnother> sets_another;
+  std::thread([&tracked, &sets_another] {
+    sets_another.Reset(new SetsAnother(&tracked));
+  }).join();
+  EXPECT_EQ(initial_count, Tracked::count());
+
+  // Also from a |thread_local| variable's destructor.
+  std::thread([&tracked] {
+    thread_local std::unique_ptr<SetsAnother> set_at_exit;
+    set_at_exit.reset(new SetsAnother(&tracked));
+  }).join();
+  EXPECT_EQ(initial_count, Tracked::count());
+}
+
+}  // namespace
+}  // namespace ftl
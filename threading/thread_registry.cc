@@ -0,0 +1,267 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/thread_registry.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/strings/string_printf.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+#include "lib/ftl/threading/fork_handlers.h"
+
+#if defined(OS_LINUX)
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib/ftl/files/file.h"
+#include "lib/ftl/strings/split_string.h"
+#include "lib/ftl/strings/string_number_conversions.h"
+#endif
+
+namespace ftl {
+namespace {
+
+struct RegisteredThread {
+  ThreadInfo info;
+#if defined(OS_LINUX)
+  pthread_t thread;
+#endif
+};
+
+// Returns the calling thread's registration, or null if it isn't registered.
+RegisteredThread* GetCurrentRegisteredThread();
+
+class ThreadRegistry final {
+ public:
+  static ThreadRegistry* Get() {
+    static ThreadRegistry* registry = new ThreadRegistry();
+    return registry;
+  }
+
+  void Add(RegisteredThread* thread) {
+    MutexLocker locker(&mutex_);
+    threads_.push_back(thread);
+  }
+
+  void Remove(RegisteredThread* thread) {
+    MutexLocker locker(&mutex_);
+    threads_.erase(std::find(threads_.begin(), threads_.end(), thread));
+  }
+
+  void Rename(RegisteredThread* thread, const std::string& name) {
+    MutexLocker locker(&mutex_);
+    thread->info.name = name;
+  }
+
+  std::vector<ThreadInfo> GetSnapshot();
+
+ private:
+  ThreadRegistry()
+      : fork_handlers_(&mutex_, [this]() FTL_NO_THREAD_SAFETY_ANALYSIS {
+          OnForkInChild();
+        }) {}
+  ~ThreadRegistry() = delete;
+
+  // Only the fork()ing thread is left in the child (with a new id).
+  void OnForkInChild() FTL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    RegisteredThread* current = GetCurrentRegisteredThread();
+    threads_.clear();
+    if (current) {
+#if defined(OS_LINUX)
+      current->info.native_id = static_cast<uint64_t>(syscall(SYS_gettid));
+#endif
+      threads_.push_back(current);
+    }
+  }
+
+  Mutex mutex_;
+  // In the order they registered. (Each is removed, as its thread exits,
+  // before it's destroyed, so the threads are all still running.)
+  std::vector<RegisteredThread*> threads_ FTL_GUARDED_BY(mutex_);
+  // |mutex_| is held across fork()s.
+  ForkHandlers fork_handlers_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadRegistry);
+};
+
+// Unregisters the thread as it exits.
+class ThreadRegistration final {
+ public:
+  ThreadRegistration() {}
+  ~ThreadRegistration() {
+    if (registered_)
+      ThreadRegistry::Get()->Remove(&thread_);
+  }
+
+  void Register(const std::string& name) {
+    if (registered_) {
+      ThreadRegistry::Get()->Rename(&thread_, name);
+      return;
+    }
+    thread_.info.name = name;
+    thread_.info.start_time = TimePoint::Now();
+#if defined(OS_LINUX)
+    thread_.info.native_id = static_cast<uint64_t>(syscall(SYS_gettid));
+    thread_.thread = pthread_self();
+#else
+    static std::atomic<uint64_t> g_next_id(1u);
+    thread_.info.native_id = g_next_id.fetch_add(1u);
+#endif
+    registered_ = true;
+    ThreadRegistry::Get()->Add(&thread_);
+  }
+
+  RegisteredThread* thread() { return registered_ ? &thread_ : nullptr; }
+
+ private:
+  RegisteredThread thread_;
+  bool registered_ = false;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadRegistration);
+};
+
+#if defined(OS_LINUX)
+
+TimeDelta ToTimeDelta(const struct timeval& time) {
+  return TimeDelta::FromMicroseconds(static_cast<int64_t>(time.tv_sec) *
+                                         1000000 +
+                                     time.tv_usec);
+}
+
+// Reads the context switch counts of the thread |native_id| (of this process)
+// into |*usage|.
+void ReadContextSwitches(uint64_t native_id, ThreadCpuUsage* usage) {
+  std::string status;
+  if (!files::ReadFileToString(
+          StringPrintf("/proc/self/task/%llu/status",
+                       static_cast<unsigned long long>(native_id)),
+          &status)) {
+    return;
+  }
+  for (StringView line :
+       SplitString(StringView(status), "\n", kTrimWhitespace,
+                   kSplitWantNonEmpty)) {
+    const size_t colon = line.find(':');
+    if (colon == StringView::npos)
+      continue;
+    const StringView key = line.substr(0u, colon);
+    StringView value = line.substr(colon + 1u);
+    while (!value.empty() && (value[0] == ' ' || value[0] == '\t'))
+      value.remove_prefix(1u);
+    if (key == StringView("voluntary_ctxt_switches"))
+      StringToNumberWithError(value, &usage->voluntary_context_switches);
+    else if (key == StringView("nonvoluntary_ctxt_switches"))
+      StringToNumberWithError(value, &usage->involuntary_context_switches);
+  }
+}
+
+#endif  // defined(OS_LINUX)
+
+std::vector<ThreadInfo> ThreadRegistry::GetSnapshot() {
+  std::vector<ThreadInfo> threads;
+  MutexLocker locker(&mutex_);
+  for (const RegisteredThread* thread : threads_) {
+    threads.push_back(thread->info);
+#if defined(OS_LINUX)
+    // (The lock keeps the thread from exiting meanwhile, so its clock is
+    // valid.)
+    ThreadCpuUsage* usage = &threads.back().usage;
+    clockid_t clock;
+    struct timespec time;
+    if (pthread_getcpuclockid(thread->thread, &clock) == 0 &&
+        clock_gettime(clock, &time) == 0) {
+      usage->cpu_time = TimeDelta::FromTimespec(time);
+    }
+    ReadContextSwitches(thread->info.native_id, usage);
+#endif
+  }
+  return threads;
+}
+
+ThreadRegistration* GetCurrentThreadRegistration() {
+  thread_local ThreadRegistration registration;
+  return &registration;
+}
+
+RegisteredThread* GetCurrentRegisteredThread() {
+  return GetCurrentThreadRegistration()->thread();
+}
+
+// Formats |duration| as, e.g., "850ms", "57.5s", "1m3.2s" or "2h5m".
+std::string FormatDuration(TimeDelta duration) {
+  const int64_t milliseconds = duration.ToMilliseconds();
+  if (milliseconds < 1000)
+    return StringPrintf("%lldms", static_cast<long long>(milliseconds));
+  const int64_t seconds = milliseconds / 1000;
+  if (seconds < 60)
+    return StringPrintf("%.3gs", milliseconds / 1e3);
+  if (seconds < 3600) {
+    return StringPrintf("%lldm%.3gs", static_cast<long long>(seconds / 60),
+                        (milliseconds % 60000) / 1e3);
+  }
+  return StringPrintf("%lldh%lldm", static_cast<long long>(seconds / 3600),
+                      static_cast<long long>(seconds % 3600 / 60));
+}
+
+}  // namespace
+
+void RegisterCurrentThread(const std::string& name) {
+  GetCurrentThreadRegistration()->Register(name);
+}
+
+bool GetCurrentThreadCpuUsage(ThreadCpuUsage* usage) {
+  *usage = ThreadCpuUsage();
+#if defined(OS_LINUX)
+  struct rusage rusage;
+  if (getrusage(RUSAGE_THREAD, &rusage) != 0)
+    return false;
+  usage->cpu_time = ToTimeDelta(rusage.ru_utime) + ToTimeDelta(rusage.ru_stime);
+  usage->voluntary_context_switches = static_cast<uint64_t>(rusage.ru_nvcsw);
+  usage->involuntary_context_switches =
+      static_cast<uint64_t>(rusage.ru_nivcsw);
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::vector<ThreadInfo> GetThreadSnapshot() {
+  return ThreadRegistry::Get()->GetSnapshot();
+}
+
+std::string FormatThreadSnapshot(const std::vector<ThreadInfo>& threads) {
+  std::vector<const ThreadInfo*> sorted;
+  for (const ThreadInfo& thread : threads)
+    sorted.push_back(&thread);
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const ThreadInfo* a, const ThreadInfo* b) {
+                     return a->usage.cpu_time > b->usage.cpu_time;
+                   });
+
+  const TimePoint now = TimePoint::Now();
+  std::string output = StringPrintf("%8s %-16s %9s %8s %10s  %s\n", "tid",
+                                    "name", "cpu time", "vol. cs",
+                                    "invol. cs", "running for");
+  for (const ThreadInfo* thread : sorted) {
+    output += StringPrintf(
+        "%8llu %-16s %9s %8llu %10llu  %s\n",
+        static_cast<unsigned long long>(thread->native_id),
+        thread->name.c_str(), FormatDuration(thread->usage.cpu_time).c_str(),
+        static_cast<unsigned long long>(
+            thread->usage.voluntary_context_switches),
+        static_cast<unsigned long long>(
+            thread->usage.involuntary_context_switches),
+        FormatDuration(now - thread->start_time).c_str());
+  }
+  return output;
+}
+
+}  // namespace ftl
@@ -0,0 +1,72 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A registry of the process' threads (every |ftl::Thread|, and any other
+// thread which registers itself), with their names, native ids and CPU usage,
+// for mapping what e.g. "top -H" shows back to components, e.g.:
+//
+//   FTL_LOG(INFO) << "\n" << ftl::FormatThreadSnapshot(
+//       ftl::GetThreadSnapshot());
+//
+//          tid name              cpu time  vol. cs  invol. cs  running for
+//        12347 io-loop              57.5s     9315       2201  1m3.1s
+//        12351 worker-0             1.24s      310         12  1m3s
+//     ...
+
+#ifndef LIB_FTL_THREADING_THREAD_REGISTRY_H_
+#define LIB_FTL_THREADING_THREAD_REGISTRY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/time/time_delta.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A thread's CPU usage so far.
+struct ThreadCpuUsage {
+  // The CPU time it has run for (user and system).
+  TimeDelta cpu_time;
+  // The times it gave up the CPU (e.g., to wait), and had it taken away.
+  uint64_t voluntary_context_switches = 0u;
+  uint64_t involuntary_context_switches = 0u;
+};
+
+struct ThreadInfo {
+  std::string name;
+  // The kernel's id for the thread (as shown by tools like top and perf),
+  // where there is one.
+  uint64_t native_id = 0u;
+  // When it registered (or, for an |ftl::Thread|, when it started).
+  TimePoint start_time;
+  ThreadCpuUsage usage;
+};
+
+// Registers the calling thread (if it isn't already) under |name|, until it
+// exits. (|ftl::Thread|s register themselves, with their |Options::name|, or
+// the name they inherited.) Registering again only renames it.
+FTL_EXPORT void RegisterCurrentThread(const std::string& name);
+
+// Gets the calling thread's CPU usage (whether or not it's registered), from
+// |getrusage(RUSAGE_THREAD)|. Returns false (and zeros) where that isn't
+// supported (Linux only).
+FTL_EXPORT bool GetCurrentThreadCpuUsage(ThreadCpuUsage* usage);
+
+// Returns the registered threads (which are still running), in the order they
+// registered, with their CPU usage. (Other threads' context switches are read
+// from /proc, on Linux only.)
+FTL_EXPORT std::vector<ThreadInfo> GetThreadSnapshot();
+
+// Returns a table of |threads|, one per line, with a header line (as above),
+// sorted by CPU time (most first).
+FTL_EXPORT std::string FormatThreadSnapshot(
+    const std::vector<ThreadInfo>& threads);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_THREADING_THREAD_REGISTRY_H_
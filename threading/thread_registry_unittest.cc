@@ -0,0 +1,96 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/thread_registry.h"
+
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/threading/thread.h"
+
+namespace ftl {
+namespace {
+
+#if defined(OS_LINUX)
+
+// Returns the registered thread called |name|, or null.
+const ThreadInfo* Find(const std::vector<ThreadInfo>& threads,
+                       const std::string& name) {
+  for (const ThreadInfo& thread : threads) {
+    if (thread.name == name)
+      return &thread;
+  }
+  return nullptr;
+}
+
+// Burns some CPU time.
+void Spin(TimeDelta duration) {
+  ThreadCpuUsage usage;
+  do {
+    ASSERT_TRUE(GetCurrentThreadCpuUsage(&usage));
+  } while (usage.cpu_time < duration);
+}
+
+TEST(ThreadRegistry, RegistersThreads) {
+  const TimePoint before = TimePoint::Now();
+  AutoResetWaitableEvent spun;
+  ManualResetWaitableEvent done;
+  Thread thread([&spun, &done] {
+    Spin(TimeDelta::FromMilliseconds(20));
+    spun.Signal();
+    done.Wait();
+  });
+  Thread::Options options;
+  options.name = "a-rather-long-thread-name";
+  ASSERT_TRUE(thread.Run(options));
+  spun.Wait();
+
+  std::vector<ThreadInfo> threads = GetThreadSnapshot();
+  // (The whole name, not the 15 characters the kernel keeps.)
+  const ThreadInfo* info = Find(threads, "a-rather-long-thread-name");
+  ASSERT_TRUE(info);
+  EXPECT_NE(0u, info->native_id);
+  EXPECT_LE(before, info->start_time);
+  EXPECT_LE(TimeDelta::FromMilliseconds(20), info->usage.cpu_time);
+  EXPECT_GT(TimeDelta::FromSeconds(10), info->usage.cpu_time);
+  EXPECT_LT(0u, info->usage.voluntary_context_switches +
+                    info->usage.involuntary_context_switches);
+  const std::string table = FormatThreadSnapshot(threads);
+  EXPECT_EQ(0u, table.find("     tid name"));
+  EXPECT_NE(std::string::npos, table.find("a-rather-long-thread-name"));
+
+  done.Signal();
+  ASSERT_TRUE(thread.Join());
+  EXPECT_FALSE(Find(GetThreadSnapshot(), "a-rather-long-thread-name"));
+}
+
+TEST(ThreadRegistry, OtherThreads) {
+  std::thread([] {
+    EXPECT_FALSE(Find(GetThreadSnapshot(), "registered"));
+    RegisterCurrentThread("registered");
+    RegisterCurrentThread("renamed");
+    const std::vector<ThreadInfo> threads = GetThreadSnapshot();
+    EXPECT_FALSE(Find(threads, "registered"));
+    EXPECT_TRUE(Find(threads, "renamed"));
+  }).join();
+  EXPECT_FALSE(Find(GetThreadSnapshot(), "renamed"));
+}
+
+TEST(ThreadRegistry, CurrentThreadCpuUsage) {
+  ThreadCpuUsage before;
+  ASSERT_TRUE(GetCurrentThreadCpuUsage(&before));
+  Spin(before.cpu_time + TimeDelta::FromMilliseconds(10));
+  ThreadCpuUsage after;
+  ASSERT_TRUE(GetCurrentThreadCpuUsage(&after));
+  EXPECT_LE(before.cpu_time + TimeDelta::FromMilliseconds(10),
+            after.cpu_time);
+  EXPECT_LE(before.voluntary_context_switches,
+            after.voluntary_context_switches);
+}
+
+#endif  // defined(OS_LINUX)
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,166 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/thread_stack.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/build_config.h"
+#include "lib/ftl/logging.h"
+
+#if defined(OS_WIN)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ftl {
+namespace {
+
+size_t RoundUpToPage(size_t size) {
+  const size_t page_size = ThreadStack::GetPageSize();
+  return (size + page_size - 1u) / page_size * page_size;
+}
+
+}  // namespace
+
+ThreadStack::ThreadStack(void* mapping,
+                         size_t mapping_size,
+                         void* base,
+                         size_t size)
+    : mapping_(mapping),
+      mapping_size_(mapping_size),
+      base_(base),
+      size_(size) {}
+
+ThreadStack::~ThreadStack() {
+#if !defined(OS_WIN)
+  munmap(mapping_, mapping_size_);
+#endif
+}
+
+// static
+std::unique_ptr<ThreadStack> ThreadStack::Create(size_t size,
+                                                 size_t guard_size) {
+#if defined(OS_WIN)
+  return nullptr;
+#else
+  size = RoundUpToPage(std::max<size_t>(size, 1u));
+  guard_size = RoundUpToPage(std::max<size_t>(guard_size, 1u));
+  if (size + guard_size < size)
+    return nullptr;
+
+  int flags = MAP_PRIVATE | MAP_ANON;
+#if defined(OS_LINUX)
+  // (Stacks only need their address space reserved until they're used.)
+  flags |= MAP_NORESERVE | MAP_STACK;
+#endif
+  void* mapping =
+      mmap(nullptr, size + guard_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+  if (mapping == MAP_FAILED)
+    return nullptr;
+  // Stacks grow down, so the guard goes at the bottom.
+  if (mprotect(mapping, guard_size, PROT_NONE) != 0) {
+    munmap(mapping, size + guard_size);
+    return nullptr;
+  }
+#if defined(OS_LINUX)
+  // Otherwise, transparent huge pages could commit 2 MB at the first touch
+  // (and defeat |GetHighWaterMark()|).
+  madvise(mapping, size + guard_size, MADV_NOHUGEPAGE);
+#endif
+  return std::unique_ptr<ThreadStack>(
+      new ThreadStack(mapping, size + guard_size,
+                      static_cast<char*>(mapping) + guard_size, size));
+#endif
+}
+
+size_t ThreadStack::GetHighWaterMark() const {
+#if defined(OS_WIN)
+  return 0u;
+#else
+  const size_t page_size = GetPageSize();
+  std::vector<unsigned char> resident(size_ / page_size);
+#if defined(OS_LINUX)
+  unsigned char* vector = resident.data();
+#else
+  char* vector = reinterpret_cast<char*>(resident.data());
+#endif
+  if (mincore(base_, size_, vector) != 0)
+    return 0u;
+  // The stack starts at the top, so the lowest page touched marks its depth.
+  for (size_t page = 0u; page < resident.size(); page++) {
+    if (resident[page] & 1u)
+      return size_ - page * page_size;
+  }
+  return 0u;
+#endif
+}
+
+void ThreadStack::Discard() {
+#if !defined(OS_WIN)
+  // (For private anonymous memory, the pages are freed and read back as
+  // zeros.)
+  madvise(base_, size_, MADV_DONTNEED);
+#endif
+}
+
+// static
+size_t ThreadStack::GetPageSize() {
+#if defined(OS_WIN)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwPageSize;
+#else
+  static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return page_size;
+#endif
+}
+
+ThreadStackPool::ThreadStackPool(size_t stack_size, size_t max_idle_stacks)
+    : stack_size_(stack_size), max_idle_stacks_(max_idle_stacks) {}
+
+ThreadStackPool::~ThreadStackPool() {}
+
+std::unique_ptr<ThreadStack> ThreadStackPool::Acquire() {
+  {
+    MutexLocker locker(&mutex_);
+    if (!idle_stacks_.empty()) {
+      std::unique_ptr<ThreadStack> stack = std::move(idle_stacks_.back());
+      idle_stacks_.pop_back();
+      return stack;
+    }
+  }
+  return ThreadStack::Create(stack_size_);
+}
+
+void ThreadStackPool::Release(std::unique_ptr<ThreadStack> stack) {
+  FTL_DCHECK(stack);
+  const size_t high_water_mark = stack->GetHighWaterMark();
+  stack->Discard();
+  {
+    MutexLocker locker(&mutex_);
+    max_high_water_mark_ = std::max(max_high_water_mark_, high_water_mark);
+    if (idle_stacks_.size() < max_idle_stacks_) {
+      idle_stacks_.push_back(std::move(stack));
+      return;
+    }
+  }
+  // (Unmapped without the lock held.)
+  stack.reset();
+}
+
+size_t ThreadStackPool::GetMaxHighWaterMark() const {
+  MutexLocker locker(&mutex_);
+  return max_high_water_mark_;
+}
+
+size_t ThreadStackPool::GetIdleCount() const {
+  MutexLocker locker(&mutex_);
+  return idle_stacks_.size();
+}
+
+}  // namespace ftl
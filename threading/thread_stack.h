@@ -0,0 +1,110 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Stacks for |ftl::Thread|s (see |Thread::Options::stack| and
+// |Thread::Options::stack_pool|), for running many threads: a stack only
+// reserves address space (and no swap) until it's used, has a guard page
+// below it to catch overflows, reports how much of it was used, and can be
+// reused by later threads, e.g.:
+//
+//   // Stacks for a pool's worker threads, sized from a previous run's
+//   // |GetMaxHighWaterMark()|.
+//   ftl::ThreadStackPool stacks(128 * 1024, 64);
+//   ftl::Thread::Options options;
+//   options.stack_pool = &stacks;
+//   ...
+//   FTL_LOG(INFO) << "deepest stack: " << stacks.GetMaxHighWaterMark();
+//
+// POSIX only: elsewhere, |ThreadStack::Create()| returns null.
+
+#ifndef LIB_FTL_THREADING_THREAD_STACK_H_
+#define LIB_FTL_THREADING_THREAD_STACK_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/synchronization/mutex.h"
+#include "lib/ftl/synchronization/thread_annotations.h"
+
+namespace ftl {
+
+class FTL_EXPORT ThreadStack final {
+ public:
+  ~ThreadStack();
+
+  // Maps a stack of |size| bytes (rounded up to whole pages), with
+  // |guard_size| bytes (also rounded up, and at least a page) of inaccessible
+  // memory below it. Returns null on failure.
+  static std::unique_ptr<ThreadStack> Create(size_t size,
+                                             size_t guard_size = 0u);
+
+  // The lowest address of the usable stack (above the guard pages).
+  void* base() const { return base_; }
+  size_t size() const { return size_; }
+
+  // Returns how many bytes (in whole pages, from the top) have been touched
+  // since it was created or last |Discard()|ed. (Includes what the thread
+  // library keeps at the top of the stack, e.g., its TLS.)
+  size_t GetHighWaterMark() const;
+
+  // Returns its pages to the system (so they read as zeros again, and no
+  // longer count towards |GetHighWaterMark()|). It mustn't be in use.
+  void Discard();
+
+  // The system's page size.
+  static size_t GetPageSize();
+
+ private:
+  ThreadStack(void* mapping, size_t mapping_size, void* base, size_t size);
+
+  void* const mapping_;
+  const size_t mapping_size_;
+  void* const base_;
+  const size_t size_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadStack);
+};
+
+// A thread-safe cache of idle stacks of one size, which |Thread|s take
+// stacks from when they start, and return them to once they're joined.
+class FTL_EXPORT ThreadStackPool final {
+ public:
+  // Makes stacks of |stack_size| bytes, and keeps up to |max_idle_stacks| of
+  // them (discarded, so only their address space) for reuse.
+  ThreadStackPool(size_t stack_size, size_t max_idle_stacks);
+  ~ThreadStackPool();
+
+  size_t stack_size() const { return stack_size_; }
+
+  // Returns an idle stack, or a new one (null if that fails).
+  std::unique_ptr<ThreadStack> Acquire();
+
+  // Takes back |stack| (which mustn't be in use), noting its high-water mark,
+  // and discards it.
+  void Release(std::unique_ptr<ThreadStack> stack);
+
+  // The largest high-water mark of the stacks released so far.
+  size_t GetMaxHighWaterMark() const;
+
+  size_t GetIdleCount() const;
+
+ private:
+  const size_t stack_size_;
+  const size_t max_idle_stacks_;
+
+  mutable Mutex mutex_;
+  std::vector<std::unique_ptr<ThreadStack>> idle_stacks_
+      FTL_GUARDED_BY(mutex_);
+  size_t max_high_water_mark_ FTL_GUARDED_BY(mutex_) = 0u;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ThreadStackPool);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_THREADING_THREAD_STACK_H_
@@ -0,0 +1,84 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/threading/thread_stack.h"
+
+#include "gtest/gtest.h"
+#include "lib/ftl/build_config.h"
+
+namespace ftl {
+namespace {
+
+#if !defined(OS_WIN)
+
+TEST(ThreadStack, Create) {
+  const size_t page_size = ThreadStack::GetPageSize();
+  std::unique_ptr<ThreadStack> stack = ThreadStack::Create(page_size * 4 - 1);
+  ASSERT_TRUE(stack);
+  EXPECT_TRUE(stack->base());
+  EXPECT_EQ(page_size * 4, stack->size());
+  EXPECT_EQ(0u, stack->GetHighWaterMark());
+}
+
+TEST(ThreadStack, HighWaterMark) {
+  const size_t page_size = ThreadStack::GetPageSize();
+  std::unique_ptr<ThreadStack> stack = ThreadStack::Create(page_size * 8);
+  ASSERT_TRUE(stack);
+  char* base = static_cast<char*>(stack->base());
+
+  // Like a stack, from the top down.
+  base[stack->size() - 1u] = 1;
+  EXPECT_EQ(page_size, stack->GetHighWaterMark());
+  base[stack->size() - page_size * 3 - 1u] = 1;
+  EXPECT_EQ(page_size * 4, stack->GetHighWaterMark());
+  base[0] = 1;
+  EXPECT_EQ(stack->size(), stack->GetHighWaterMark());
+
+  stack->Discard();
+  EXPECT_EQ(0u, stack->GetHighWaterMark());
+  EXPECT_EQ(0, base[0]);
+}
+
+TEST(ThreadStack, GuardPage) {
+  std::unique_ptr<ThreadStack> stack =
+      ThreadStack::Create(ThreadStack::GetPageSize());
+  ASSERT_TRUE(stack);
+  volatile char* below = static_cast<char*>(stack->base()) - 1;
+  EXPECT_DEATH_IF_SUPPORTED(*below = 1, "");
+}
+
+TEST(ThreadStackPool, Reuse) {
+  const size_t page_size = ThreadStack::GetPageSize();
+  ThreadStackPool pool(page_size * 4, 1u);
+  EXPECT_EQ(page_size * 4, pool.stack_size());
+  EXPECT_EQ(0u, pool.GetIdleCount());
+
+  std::unique_ptr<ThreadStack> first = pool.Acquire();
+  std::unique_ptr<ThreadStack> second = pool.Acquire();
+  ASSERT_TRUE(first);
+  ASSERT_TRUE(second);
+  EXPECT_EQ(page_size * 4, first->size());
+  static_cast<char*>(first->base())[page_size * 2] = 1;
+  ThreadStack* const first_pointer = first.get();
+
+  pool.Release(std::move(first));
+  EXPECT_EQ(1u, pool.GetIdleCount());
+  EXPECT_EQ(page_size * 2, pool.GetMaxHighWaterMark());
+  // Over |max_idle_stacks|, so it's freed.
+  pool.Release(std::move(second));
+  EXPECT_EQ(1u, pool.GetIdleCount());
+  EXPECT_EQ(page_size * 2, pool.GetMaxHighWaterMark());
+
+  // The idle one comes back (discarded).
+  std::unique_ptr<ThreadStack> again = pool.Acquire();
+  EXPECT_EQ(first_pointer, again.get());
+  EXPECT_EQ(0u, again->GetHighWaterMark());
+  EXPECT_EQ(0u, pool.GetIdleCount());
+  pool.Release(std::move(again));
+}
+
+#endif  // !defined(OS_WIN)
+
+}  // namespace
+}  // namespace ftl
@@ -4,7 +4,21 @@
 
 #include "lib/ftl/threading/thread.h"
 
+#if defined(OS_LINUX)
+#include <sched.h>
+#endif
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "lib/ftl/synchronization/sleep.h"
+#include "lib/ftl/synchronization/waitable_event.h"
+#include "lib/ftl/test/forked_child.h"
 
 namespace ftl {
 namespace {
@@ -17,5 +31,243 @@ TEST(Thread, Control) {
   EXPECT_TRUE(thread.Join());
 }
 
+TEST(Thread, RunWithDefaultOptions) {
+  bool did_run = false;
+  Thread thread([&did_run] { did_run = true; });
+  EXPECT_TRUE(thread.Run(Thread::Options()));
+  EXPECT_FALSE(thread.Run(Thread::Options()));
+  EXPECT_TRUE(thread.Join());
+  EXPECT_TRUE(did_run);
+}
+
+TEST(Thread, FunctionPointer) {
+  int value = 0;
+  Thread thread([](void* argument) { *static_cast<int*>(argument) = 1; },
+                &value);
+  EXPECT_TRUE(thread.Run());
+  EXPECT_TRUE(thread.Join());
+  EXPECT_EQ(1, value);
+}
+
+TEST(Thread, TryJoinFor) {
+  Thread idle_thread([] {});
+  EXPECT_FALSE(idle_thread.TryJoinFor(TimeDelta::FromMilliseconds(1)));
+
+  ManualResetWaitableEvent finish;
+  Thread thread([&finish] { finish.Wait(); });
+  EXPECT_TRUE(thread.Run());
+  EXPECT_FALSE(thread.TryJoinFor(TimeDelta::Zero()));
+  EXPECT_FALSE(thread.TryJoinFor(TimeDelta::FromMilliseconds(20)));
+  EXPECT_TRUE(thread.IsRunning());
+  finish.Signal();
+  EXPECT_TRUE(thread.TryJoinFor(TimeDelta::FromSeconds(10)));
+  EXPECT_FALSE(thread.IsRunning());
+  EXPECT_FALSE(thread.Join());
+
+  // It can run again.
+  finish.Reset();
+  EXPECT_TRUE(thread.Run());
+  finish.Signal();
+  EXPECT_TRUE(thread.Join());
+}
+
+TEST(Thread, Detach) {
+  // (Outlives the test, in case the thread doesn't.)
+  ManualResetWaitableEvent* finish = new ManualResetWaitableEvent();
+  ManualResetWaitableEvent* finished = new ManualResetWaitableEvent();
+  std::unique_ptr<Thread> thread(new Thread([finish, finished] {
+    finish->Wait();
+    finished->Signal();
+  }));
+  EXPECT_FALSE(thread->Detach());
+  EXPECT_TRUE(thread->Run());
+  EXPECT_TRUE(thread->Detach());
+  EXPECT_FALSE(thread->IsRunning());
+  EXPECT_FALSE(thread->Join());
+  EXPECT_FALSE(thread->Detach());
+  // The thread kept the runnable.
+  EXPECT_FALSE(thread->Run());
+
+  // The thread outlives its |Thread|.
+  thread.reset();
+  finish->Signal();
+  EXPECT_FALSE(finished->WaitWithTimeout(TimeDelta::FromSeconds(10)));
+}
+
+#if !defined(OS_WIN)
+
+// (Big enough for sanitizers, which take some of a thread's stack.)
+constexpr size_t kStackSize = 1024 * 1024;
+
+// Returns roughly how deep the stack is at its call (in |*depth|), after
+// using about |bytes| more.
+void UseStack(size_t bytes, uintptr_t* depth) {
+  volatile char buffer[1024];
+  buffer[0] = 1;
+  if (bytes > sizeof(buffer)) {
+    UseStack(bytes - sizeof(buffer), depth);
+  } else {
+    *depth = reinterpret_cast<uintptr_t>(&buffer[0]);
+  }
+  buffer[sizeof(buffer) - 1] = buffer[0];
+}
+
+TEST(Thread, Stack) {
+  std::unique_ptr<ThreadStack> stack = ThreadStack::Create(kStackSize);
+  ASSERT_TRUE(stack);
+  uintptr_t depth = 0u;
+  Thread thread([&depth] { UseStack(64 * 1024, &depth); });
+  Thread::Options options;
+  options.stack = stack.get();
+  EXPECT_TRUE(thread.Run(options));
+  EXPECT_FALSE(thread.Detach());
+  EXPECT_TRUE(thread.Join());
+
+  // It ran on |stack|, and used (a little over) 64 KB of it.
+  const uintptr_t base = reinterpret_cast<uintptr_t>(stack->base());
+  EXPECT_GE(depth, base);
+  EXPECT_LT(depth, base + stack->size());
+  EXPECT_GE(thread.GetStackHighWaterMark(), 64u * 1024u);
+  EXPECT_LT(thread.GetStackHighWaterMark(), stack->size());
+  EXPECT_EQ(stack->GetHighWaterMark(), thread.GetStackHighWaterMark());
+
+  // Both can't be set.
+  ThreadStackPool pool(kStackSize, 1u);
+  options.stack_pool = &pool;
+  EXPECT_FALSE(thread.Run(options));
+}
+
+TEST(Thread, StackPool) {
+  ThreadStackPool pool(kStackSize, 4u);
+  Thread::Options options;
+  options.stack_pool = &pool;
+
+  size_t used = 0u;
+  Thread thread([&used] {
+    uintptr_t depth;
+    UseStack(used, &depth);
+  });
+  used = 32 * 1024;
+  EXPECT_TRUE(thread.Run(options));
+  EXPECT_TRUE(thread.Join());
+  EXPECT_EQ(1u, pool.GetIdleCount());
+  const size_t first_mark = thread.GetStackHighWaterMark();
+  EXPECT_GE(first_mark, 32u * 1024u);
+  EXPECT_EQ(first_mark, pool.GetMaxHighWaterMark());
+
+  // Restarting reuses the stack (discarded, so the mark is just this run's).
+  used = 8 * 1024;
+  EXPECT_TRUE(thread.Run(options));
+  EXPECT_EQ(0u, pool.GetIdleCount());
+  EXPECT_TRUE(thread.Join());
+  EXPECT_EQ(1u, pool.GetIdleCount());
+  EXPECT_GE(thread.GetStackHighWaterMark(), 8u * 1024u);
+  EXPECT_LT(thread.GetStackHighWaterMark(), first_mark);
+  EXPECT_EQ(first_mark, pool.GetMaxHighWaterMark());
+}
+
+TEST(Thread, ManyThreadsFromStackPool) {
+  constexpr size_t kThreads = 256u;
+  ThreadStackPool pool(kStackSize, kThreads);
+  Thread::Options options;
+  options.stack_pool = &pool;
+  ManualResetWaitableEvent finish;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (size_t i = 0u; i < kThreads; i++) {
+    threads.emplace_back(new Thread([&finish] { finish.Wait(); }));
+    ASSERT_TRUE(threads.back()->Run(options));
+  }
+  finish.Signal();
+  for (auto& thread : threads)
+    EXPECT_TRUE(thread->Join());
+  EXPECT_EQ(kThreads, pool.GetIdleCount());
+  EXPECT_GT(pool.GetMaxHighWaterMark(), 0u);
+  EXPECT_LT(pool.GetMaxHighWaterMark(), kStackSize);
+}
+
+#endif  // !defined(OS_WIN)
+
+#if !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+TEST(Thread, NotRunningAfterFork) {
+  // (The child mustn't use a waitable event which the parent's thread was
+  // waiting on.)
+  std::atomic<bool> finish(false);
+  std::atomic<int> runs(0);
+  Thread thread([&finish, &runs] {
+    runs++;
+    while (!finish.load())
+      SleepFor(TimeDelta::FromMilliseconds(1));
+  });
+  ASSERT_TRUE(thread.Run());
+  EXPECT_TRUE(RunInForkedChild([&thread, &finish, &runs] {
+    // The thread is gone, but this can run it again.
+    if (thread.IsRunning() || thread.Join())
+      return false;
+    const int runs_before = runs.load();
+    finish.store(true);
+    return thread.Run() && thread.Join() && runs.load() == runs_before + 1;
+  }));
+  EXPECT_TRUE(thread.IsRunning());
+  finish.store(true);
+  EXPECT_TRUE(thread.Join());
+}
+
+#endif  // !defined(OS_FUCHSIA) && !defined(OS_WIN)
+
+#if defined(OS_LINUX)
+
+TEST(Thread, Name) {
+  char name[16] = {};
+  Thread thread(
+      [&name] { pthread_getname_np(pthread_self(), name, sizeof(name)); });
+  Thread::Options options;
+  options.name = "a-rather-long-thread-name";
+  EXPECT_TRUE(thread.Run(options));
+  EXPECT_TRUE(thread.Join());
+  EXPECT_EQ("a-rather-long-t", std::string(name));
+}
+
+TEST(Thread, CpuAffinity) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  Thread thread([&cpus] {
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+  });
+  Thread::Options options;
+  options.cpu_affinity.push_back(0u);
+  EXPECT_TRUE(thread.Run(options));
+  EXPECT_TRUE(thread.Join());
+  EXPECT_EQ(1, CPU_COUNT(&cpus));
+  EXPECT_TRUE(CPU_ISSET(0, &cpus));
+}
+
+TEST(Thread, InvalidOptions) {
+  Thread thread([] {});
+  Thread::Options options;
+  options.numa_node = 1000000;
+  EXPECT_FALSE(thread.Run(options));
+
+  options = Thread::Options();
+  options.scheduling_priority = 1;
+  EXPECT_FALSE(thread.Run(options));
+  EXPECT_FALSE(thread.IsRunning());
+}
+
+TEST(Thread, SchedulingPolicy) {
+  int policy = -1;
+  Thread thread([&policy] {
+    struct sched_param param;
+    pthread_getschedparam(pthread_self(), &policy, &param);
+  });
+  Thread::Options options;
+  options.scheduling_policy = Thread::SchedulingPolicy::kBatch;
+  EXPECT_TRUE(thread.Run(options));
+  EXPECT_TRUE(thread.Join());
+  EXPECT_EQ(SCHED_BATCH, policy);
+}
+
+#endif  // defined(OS_LINUX)
+
 }  // namespace
 }  // namespace ftl
@@ -0,0 +1,205 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/time/fast_clock.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "lib/ftl/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#define FTL_FAST_CLOCK_HAS_COUNTER 1
+#elif defined(ARCH_CPU_ARM64)
+#define FTL_FAST_CLOCK_HAS_COUNTER 1
+#endif
+
+namespace ftl {
+namespace {
+
+#if defined(FTL_FAST_CLOCK_HAS_COUNTER)
+
+// How long to measure the counter's rate for before using it, and how long to
+// use each calibration for.
+constexpr int64_t kWarmUpNs = 10 * 1000 * 1000;
+constexpr int64_t kIntervalNs = 1000 * 1000 * 1000;
+
+bool HasConstantRateCounter() {
+#if defined(ARCH_CPU_X86_FAMILY)
+  // CPUID leaf 0x80000007's EDX bit 8 says the TSC is invariant (ticks at the
+  // same rate in every power state).
+#if defined(_MSC_VER)
+  int registers[4];
+  __cpuid(registers, 0x80000000);
+  if (static_cast<unsigned>(registers[0]) < 0x80000007u)
+    return false;
+  __cpuid(registers, 0x80000007);
+  return (registers[3] & (1 << 8)) != 0;
+#else
+  if (__get_cpuid_max(0x80000000u, nullptr) < 0x80000007u)
+    return false;
+  unsigned eax = 0u, ebx = 0u, ecx = 0u, edx = 0u;
+  return __get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx) &&
+         (edx & (1u << 8)) != 0u;
+#endif
+#else
+  // (ARMv8's generic timer always counts at a constant rate.)
+  return true;
+#endif
+}
+
+inline uint64_t ReadCounter() {
+#if defined(ARCH_CPU_X86_FAMILY)
+  return __rdtsc();
+#else
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#endif
+}
+
+int64_t GetSystemNs() {
+  return TimePoint::Now().ToEpochDelta().ToNanoseconds();
+}
+
+// Maps counter readings to nanoseconds: for up to |limit_ticks_| ticks after
+// |base_ticks_|, |base_ns_| plus the ticks since times |scale_| (nanoseconds
+// per tick, in 32.32 fixed point). Readers see these consistently through the
+// sequence lock |sequence_|, which is odd while a writer changes them.
+// |scale_| is zero until the counter's rate has been measured.
+class Calibration {
+ public:
+  Calibration() : first_ticks_(ReadCounter()), first_ns_(GetSystemNs()) {}
+
+  int64_t Now() {
+    for (;;) {
+      const uint32_t sequence = sequence_.load(std::memory_order_acquire);
+      if (sequence & 1u) {
+        // Another thread is recalibrating (which is quick, unless it's been
+        // preempted).
+        std::this_thread::yield();
+        continue;
+      }
+      const uint64_t scale = scale_.load(std::memory_order_relaxed);
+      const uint64_t base_ticks = base_ticks_.load(std::memory_order_relaxed);
+      const int64_t base_ns = base_ns_.load(std::memory_order_relaxed);
+      const uint64_t limit_ticks =
+          limit_ticks_.load(std::memory_order_relaxed);
+      const uint64_t ticks = ReadCounter();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) != sequence)
+        continue;
+
+      int64_t now_ns;
+      if (scale != 0u) {
+        // (The counter may have been read early, before |base_ticks|.)
+        uint64_t elapsed = ticks - base_ticks;
+        if (static_cast<int64_t>(elapsed) < 0)
+          elapsed = 0u;
+        if (elapsed < limit_ticks)
+          return base_ns + static_cast<int64_t>((elapsed * scale) >> 32);
+      }
+      if (Recalibrate(sequence, &now_ns))
+        return now_ns;
+    }
+  }
+
+ private:
+  // Recalibrates from the system clock, and sets |*now_ns|, unless another
+  // thread beat us to it.
+  bool Recalibrate(uint32_t sequence, int64_t* now_ns) {
+    if (!sequence_.compare_exchange_strong(sequence, sequence + 1u,
+                                           std::memory_order_acquire)) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint64_t ticks = ReadCounter();
+    *now_ns = GetSystemNs();
+    const int64_t measured_ns = *now_ns - first_ns_;
+    const uint64_t scale = scale_.load(std::memory_order_relaxed);
+    if ((scale != 0u || measured_ns >= kWarmUpNs) && ticks > first_ticks_) {
+      // The rate, measured from the start (so ever more precisely).
+      const double ns_per_tick = static_cast<double>(measured_ns) /
+                                 static_cast<double>(ticks - first_ticks_);
+      double new_scale = ns_per_tick * 4294967296.0;
+      if (scale != 0u) {
+        // Readings so far are below where the last calibration ran out. If
+        // that's ahead of the system clock, carry on from it, running slow
+        // enough to meet the system clock an interval later.
+        const int64_t end_ns =
+            base_ns_.load(std::memory_order_relaxed) +
+            static_cast<int64_t>(
+                (limit_ticks_.load(std::memory_order_relaxed) * scale) >> 32);
+        if (end_ns > *now_ns) {
+          const double ahead = static_cast<double>(end_ns - *now_ns) /
+                               static_cast<double>(kIntervalNs);
+          new_scale *= ahead < 0.5 ? 1.0 - ahead : 0.5;
+          *now_ns = end_ns;
+        }
+      }
+      base_ticks_.store(ticks, std::memory_order_relaxed);
+      base_ns_.store(*now_ns, std::memory_order_relaxed);
+      scale_.store(static_cast<uint64_t>(new_scale),
+                   std::memory_order_relaxed);
+      limit_ticks_.store(
+          static_cast<uint64_t>(static_cast<double>(kIntervalNs) /
+                                ns_per_tick),
+          std::memory_order_relaxed);
+    }
+
+    sequence_.store(sequence + 2u, std::memory_order_release);
+    return true;
+  }
+
+  std::atomic<uint32_t> sequence_{0u};
+  std::atomic<uint64_t> base_ticks_{0u};
+  std::atomic<int64_t> base_ns_{0};
+  std::atomic<uint64_t> scale_{0u};
+  std::atomic<uint64_t> limit_ticks_{0u};
+
+  // When measuring the rate started.
+  const uint64_t first_ticks_;
+  const int64_t first_ns_;
+};
+
+Calibration* GetCalibration() {
+  static Calibration* calibration =
+      HasConstantRateCounter() ? new Calibration() : nullptr;
+  return calibration;
+}
+
+#endif  // defined(FTL_FAST_CLOCK_HAS_COUNTER)
+
+}  // namespace
+
+// static
+TimePoint FastClock::Now() {
+#if defined(FTL_FAST_CLOCK_HAS_COUNTER)
+  if (Calibration* calibration = GetCalibration()) {
+    return TimePoint::FromEpochDelta(
+        TimeDelta::FromNanoseconds(calibration->Now()));
+  }
+#endif
+  return TimePoint::Now();
+}
+
+// static
+bool FastClock::IsCounterBased() {
+#if defined(FTL_FAST_CLOCK_HAS_COUNTER)
+  return GetCalibration() != nullptr;
+#else
+  return false;
+#endif
+}
+
+}  // namespace ftl
@@ -0,0 +1,38 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TIME_FAST_CLOCK_H_
+#define LIB_FTL_TIME_FAST_CLOCK_H_
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/time/time_point.h"
+
+namespace ftl {
+
+// A cheaper |TimePoint::Now()|, for timestamping often (e.g., every task
+// posted and run). Where the CPU has a constant-rate counter (the invariant
+// TSC on x86, or the generic timer's virtual count on ARM64), this reads that
+// and scales it to nanoseconds, rather than asking the OS. Elsewhere it's just
+// |TimePoint::Now()|.
+//
+// Its readings don't go backwards, and follow |TimePoint::Now()|: they start
+// out as the same (for the first few milliseconds, while the counter's rate is
+// measured), and are brought back to it (by running a little slow, or
+// stepping forward) about once a second. In between, they may drift from it by
+// some microseconds, so use |TimePoint::Now()| for deadlines that something
+// else waits on (like |CondVar::WaitWithTimeout()|'s).
+class FTL_EXPORT FastClock final {
+ public:
+  static TimePoint Now();
+
+  // Whether |Now()| reads a counter (instead of calling |TimePoint::Now()|).
+  static bool IsCounterBased();
+
+ private:
+  FastClock() = delete;
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TIME_FAST_CLOCK_H_
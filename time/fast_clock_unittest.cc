@@ -0,0 +1,59 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/time/fast_clock.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+// Reads |FastClock::Now()| for a while, checking that it doesn't go backwards.
+void ExpectMonotonic(TimeDelta duration) {
+  const TimePoint end = TimePoint::Now() + duration;
+  TimePoint last = FastClock::Now();
+  while (TimePoint::Now() < end) {
+    for (int i = 0; i < 1000; i++) {
+      const TimePoint now = FastClock::Now();
+      ASSERT_LE(last, now);
+      last = now;
+    }
+  }
+}
+
+void ExpectNear(TimePoint expected, TimePoint actual) {
+  EXPECT_LT((expected - actual).ToMicroseconds(), 1000);
+  EXPECT_LT((actual - expected).ToMicroseconds(), 1000);
+}
+
+TEST(FastClock, FollowsTimePoint) {
+  // Through measuring the counter's rate.
+  ExpectMonotonic(TimeDelta::FromMilliseconds(20));
+  ExpectNear(TimePoint::Now(), FastClock::Now());
+
+  // Through recalibrating.
+  const TimePoint start = FastClock::Now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  ExpectNear(TimePoint::Now(), FastClock::Now());
+  EXPECT_LE(1100, (FastClock::Now() - start).ToMilliseconds());
+  ExpectMonotonic(TimeDelta::FromMilliseconds(20));
+}
+
+TEST(FastClock, Threads) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back(
+        [] { ExpectMonotonic(TimeDelta::FromMilliseconds(50)); });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  ExpectNear(TimePoint::Now(), FastClock::Now());
+}
+
+}  // namespace
+}  // namespace ftl
@@ -0,0 +1,258 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/time/latency_histogram.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "lib/ftl/logging.h"
+#include "lib/ftl/strings/string_printf.h"
+
+namespace ftl {
+namespace {
+
+constexpr size_t kUnassignedShard = static_cast<size_t>(-1);
+
+// Threads are assigned shards round-robin, on first use.
+std::atomic<size_t> g_next_shard(0u);
+thread_local size_t g_shard = kUnassignedShard;
+
+int64_t ToNonNegativeNanoseconds(TimeDelta duration) {
+  return std::max<int64_t>(duration.ToNanoseconds(), 0);
+}
+
+void UpdateMin(std::atomic<int64_t>* min, int64_t value) {
+  int64_t current = min->load(std::memory_order_relaxed);
+  while (value < current &&
+         !min->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+void UpdateMax(std::atomic<int64_t>* max, int64_t value) {
+  int64_t current = max->load(std::memory_order_relaxed);
+  while (value > current &&
+         !max->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+// Formats |duration| in its largest unit that's at least one, e.g.,
+// "850ns", "12.3us" or "4.56ms".
+std::string FormatDuration(TimeDelta duration) {
+  const int64_t nanoseconds = duration.ToNanoseconds();
+  if (nanoseconds < 1000)
+    return StringPrintf("%lldns", static_cast<long long>(nanoseconds));
+  if (nanoseconds < 1000000)
+    return StringPrintf("%.3gus", nanoseconds / 1e3);
+  if (nanoseconds < 1000000000)
+    return StringPrintf("%.3gms", nanoseconds / 1e6);
+  return StringPrintf("%.3gs", nanoseconds / 1e9);
+}
+
+}  // namespace
+
+constexpr size_t LatencyHistogram::kSubBucketBits;
+constexpr size_t LatencyHistogram::kSubBucketCount;
+constexpr size_t LatencyHistogram::kBucketCount;
+constexpr size_t LatencyHistogram::kShardCount;
+
+LatencyHistogram::Snapshot::Snapshot() : buckets_(kBucketCount, 0u) {}
+
+LatencyHistogram::Snapshot::~Snapshot() {}
+
+// static
+LatencyHistogram::Snapshot LatencyHistogram::Snapshot::FromCounts(
+    std::vector<uint64_t> buckets,
+    TimeDelta total,
+    TimeDelta min,
+    TimeDelta max) {
+  FTL_DCHECK(buckets.size() == kBucketCount);
+  Snapshot snapshot;
+  snapshot.buckets_ = std::move(buckets);
+  for (uint64_t count : snapshot.buckets_)
+    snapshot.count_ += count;
+  snapshot.total_ = total.ToNanoseconds();
+  if (snapshot.count_)
+    snapshot.min_ = ToNonNegativeNanoseconds(min);
+  snapshot.max_ = ToNonNegativeNanoseconds(max);
+  return snapshot;
+}
+
+void LatencyHistogram::Snapshot::Record(TimeDelta duration) {
+  const int64_t nanoseconds = ToNonNegativeNanoseconds(duration);
+  buckets_[BucketFor(duration)]++;
+  count_++;
+  total_ += nanoseconds;
+  min_ = std::min(min_, nanoseconds);
+  max_ = std::max(max_, nanoseconds);
+}
+
+void LatencyHistogram::Snapshot::Merge(const Snapshot& other) {
+  for (size_t i = 0u; i < kBucketCount; i++)
+    buckets_[i] += other.buckets_[i];
+  count_ += other.count_;
+  total_ += other.total_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+TimeDelta LatencyHistogram::Snapshot::min() const {
+  return TimeDelta::FromNanoseconds(count_ ? min_ : 0);
+}
+
+TimeDelta LatencyHistogram::Snapshot::mean() const {
+  return TimeDelta::FromNanoseconds(
+      count_ ? total_ / static_cast<int64_t>(count_) : 0);
+}
+
+TimeDelta LatencyHistogram::Snapshot::Percentile(double percentile) const {
+  FTL_DCHECK(percentile >= 0.0 && percentile <= 100.0);
+  if (!count_)
+    return TimeDelta::Zero();
+  // The number of durations at or below the percentile (at least one).
+  const uint64_t rank = std::max<uint64_t>(
+      static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5), 1u);
+  uint64_t seen = 0u;
+  for (size_t i = 0u; i < kBucketCount - 1u; i++) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      const TimeDelta largest =
+          BucketLowerBound(i + 1u) - TimeDelta::FromNanoseconds(1);
+      return std::max(std::min(largest, max()), min());
+    }
+  }
+  return max();
+}
+
+std::string LatencyHistogram::Snapshot::ToString() const {
+  return StringPrintf(
+      "count=%llu mean=%s p50=%s p90=%s p99=%s p999=%s max=%s",
+      static_cast<unsigned long long>(count_), FormatDuration(mean()).c_str(),
+      FormatDuration(Percentile(50.0)).c_str(),
+      FormatDuration(Percentile(90.0)).c_str(),
+      FormatDuration(Percentile(99.0)).c_str(),
+      FormatDuration(Percentile(99.9)).c_str(),
+      FormatDuration(max()).c_str());
+}
+
+LatencyHistogram::LatencyHistogram() {
+  for (auto& shard : shards_)
+    shard.store(nullptr, std::memory_order_relaxed);
+}
+
+LatencyHistogram::~LatencyHistogram() {
+  for (auto& shard : shards_)
+    delete shard.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Record(TimeDelta duration) {
+  const int64_t nanoseconds = ToNonNegativeNanoseconds(duration);
+  Shard* shard = GetShard();
+  shard->buckets[BucketFor(duration)].fetch_add(1u,
+                                                std::memory_order_relaxed);
+  shard->total.fetch_add(nanoseconds, std::memory_order_relaxed);
+  UpdateMin(&shard->min, nanoseconds);
+  UpdateMax(&shard->max, nanoseconds);
+}
+
+void LatencyHistogram::Merge(const Snapshot& snapshot) {
+  if (!snapshot.count_)
+    return;
+  Shard* shard = GetShard();
+  for (size_t i = 0u; i < kBucketCount; i++) {
+    if (snapshot.buckets_[i]) {
+      shard->buckets[i].fetch_add(snapshot.buckets_[i],
+                                  std::memory_order_relaxed);
+    }
+  }
+  shard->total.fetch_add(snapshot.total_, std::memory_order_relaxed);
+  UpdateMin(&shard->min, snapshot.min_);
+  UpdateMax(&shard->max, snapshot.max_);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::GetSnapshot() const {
+  Snapshot snapshot;
+  for (const auto& shard_pointer : shards_) {
+    const Shard* shard = shard_pointer.load(std::memory_order_acquire);
+    if (!shard)
+      continue;
+    for (size_t i = 0u; i < kBucketCount; i++) {
+      const uint64_t count = shard->buckets[i].load(std::memory_order_relaxed);
+      snapshot.buckets_[i] += count;
+      snapshot.count_ += count;
+    }
+    snapshot.total_ += shard->total.load(std::memory_order_relaxed);
+    snapshot.min_ =
+        std::min(snapshot.min_, shard->min.load(std::memory_order_relaxed));
+    snapshot.max_ =
+        std::max(snapshot.max_, shard->max.load(std::memory_order_relaxed));
+  }
+  return snapshot;
+}
+
+void LatencyHistogram::Clear() {
+  for (auto& shard_pointer : shards_) {
+    Shard* shard = shard_pointer.load(std::memory_order_acquire);
+    if (!shard)
+      continue;
+    for (auto& bucket : shard->buckets)
+      bucket.store(0u, std::memory_order_relaxed);
+    shard->total.store(0, std::memory_order_relaxed);
+    shard->min.store(INT64_MAX, std::memory_order_relaxed);
+    shard->max.store(0, std::memory_order_relaxed);
+  }
+}
+
+// static
+size_t LatencyHistogram::BucketFor(TimeDelta duration) {
+  const uint64_t nanoseconds =
+      static_cast<uint64_t>(ToNonNegativeNanoseconds(duration));
+  if (nanoseconds < kSubBucketCount)
+    return static_cast<size_t>(nanoseconds);
+  // Past the first (exact) buckets, each power of two [2^e, 2^(e + 1)) is
+  // split in |kSubBucketCount|, by the bits after the leading one.
+  const size_t exponent =
+      63u - static_cast<size_t>(__builtin_clzll(nanoseconds));
+  const size_t shift = exponent - kSubBucketBits;
+  return (shift + 1u) * kSubBucketCount +
+         static_cast<size_t>((nanoseconds >> shift) & (kSubBucketCount - 1u));
+}
+
+// static
+TimeDelta LatencyHistogram::BucketLowerBound(size_t i) {
+  FTL_DCHECK(i <= kBucketCount);
+  if (i < kSubBucketCount)
+    return TimeDelta::FromNanoseconds(static_cast<int64_t>(i));
+  if (i == kBucketCount)
+    return TimeDelta::Max();
+  const size_t shift = i / kSubBucketCount - 1u;
+  const uint64_t leading = kSubBucketCount + i % kSubBucketCount;
+  return TimeDelta::FromNanoseconds(static_cast<int64_t>(leading << shift));
+}
+
+LatencyHistogram::Shard* LatencyHistogram::GetShard() {
+  if (g_shard == kUnassignedShard)
+    g_shard = g_next_shard.fetch_add(1u, std::memory_order_relaxed);
+  std::atomic<Shard*>& shard_pointer = shards_[g_shard % kShardCount];
+  Shard* shard = shard_pointer.load(std::memory_order_acquire);
+  if (!shard) {
+    Shard* new_shard = new Shard();
+    for (auto& bucket : new_shard->buckets)
+      bucket.store(0u, std::memory_order_relaxed);
+    new_shard->total.store(0, std::memory_order_relaxed);
+    new_shard->min.store(INT64_MAX, std::memory_order_relaxed);
+    new_shard->max.store(0, std::memory_order_relaxed);
+    if (shard_pointer.compare_exchange_strong(shard, new_shard,
+                                              std::memory_order_acq_rel)) {
+      shard = new_shard;
+    } else {
+      delete new_shard;
+    }
+  }
+  return shard;
+}
+
+}  // namespace ftl
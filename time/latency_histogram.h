@@ -0,0 +1,148 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Latency percentiles without keeping the samples, e.g.:
+//
+//   LatencyHistogram g_request_latency;
+//
+//   void HandleRequest(...) {
+//     ScopedTimer timer(&g_request_latency);
+//     ...
+//   }
+//
+//   FTL_LOG(INFO) << g_request_latency.GetSnapshot().ToString();
+
+#ifndef LIB_FTL_TIME_LATENCY_HISTOGRAM_H_
+#define LIB_FTL_TIME_LATENCY_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/macros.h"
+#include "lib/ftl/time/stopwatch.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+
+// A histogram of durations with log-linear buckets (as in HdrHistogram):
+// exact below 32 ns, then 32 buckets for each power of two, so a bucket's
+// values are within 1/32 (about 3%) of each other, from nanoseconds to
+// centuries.
+//
+// |Record()| is lock-free and cheap (a few relaxed atomic adds): threads
+// record into one of a few shards, so they rarely share cache lines.
+// |GetSnapshot()| adds the shards up, for percentiles and such.
+class FTL_EXPORT LatencyHistogram final {
+ public:
+  static constexpr size_t kSubBucketBits = 5u;
+  static constexpr size_t kSubBucketCount = size_t{1} << kSubBucketBits;
+  // Enough for any (non-negative) |TimeDelta|.
+  static constexpr size_t kBucketCount = (64u - kSubBucketBits) *
+                                         kSubBucketCount;
+
+  // A histogram's counts at some point (not thread-safe).
+  class FTL_EXPORT Snapshot final {
+   public:
+    Snapshot();
+    ~Snapshot();
+
+    // Returns a snapshot with the given counts (e.g., decoded from a
+    // serialized one). |buckets| must have |kBucketCount| elements.
+    static Snapshot FromCounts(std::vector<uint64_t> buckets,
+                               TimeDelta total,
+                               TimeDelta min,
+                               TimeDelta max);
+
+    void Record(TimeDelta duration);
+    // Adds |other|'s counts to these.
+    void Merge(const Snapshot& other);
+
+    uint64_t count() const { return count_; }
+    TimeDelta total() const { return TimeDelta::FromNanoseconds(total_); }
+    // (Zero if there are no durations.)
+    TimeDelta min() const;
+    TimeDelta max() const { return TimeDelta::FromNanoseconds(max_); }
+    TimeDelta mean() const;
+
+    uint64_t bucket(size_t i) const { return buckets_[i]; }
+
+    // Returns the given |percentile| (from 0 to 100) of the durations, rounded
+    // up to its bucket's largest value (but no more than |max()|), so it's
+    // at most about 3% high.
+    TimeDelta Percentile(double percentile) const;
+
+    // Returns a one-line summary, e.g.,
+    // "count=3 mean=10us p50=9us p90=12us p99=12us p999=12us max=12us".
+    std::string ToString() const;
+
+   private:
+    friend class LatencyHistogram;
+
+    std::vector<uint64_t> buckets_;
+    uint64_t count_ = 0u;
+    int64_t total_ = 0;
+    int64_t min_ = INT64_MAX;
+    int64_t max_ = 0;
+  };
+
+  LatencyHistogram();
+  ~LatencyHistogram();
+
+  // Negative durations are recorded as zero.
+  void Record(TimeDelta duration);
+  // Records all of |snapshot|'s durations.
+  void Merge(const Snapshot& snapshot);
+
+  Snapshot GetSnapshot() const;
+  // Forgets all the durations. (Those recorded concurrently may or may not
+  // survive.)
+  void Clear();
+
+  // The bucket |duration| is counted in, and the durations it counts:
+  // [|BucketLowerBound(i)|, |BucketLowerBound(i + 1)|).
+  static size_t BucketFor(TimeDelta duration);
+  static TimeDelta BucketLowerBound(size_t i);
+
+ private:
+  struct Shard {
+    std::atomic<uint64_t> buckets[kBucketCount];
+    std::atomic<int64_t> total;
+    std::atomic<int64_t> min;
+    std::atomic<int64_t> max;
+  };
+
+  static constexpr size_t kShardCount = 8u;
+
+  Shard* GetShard();
+
+  // Allocated on first use.
+  std::atomic<Shard*> shards_[kShardCount];
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+// Records the time from its construction to its destruction in a histogram
+// (timed with a |Stopwatch|).
+class FTL_EXPORT ScopedTimer final {
+ public:
+  explicit ScopedTimer(LatencyHistogram* histogram) : histogram_(histogram) {
+    stopwatch_.Start();
+  }
+  ~ScopedTimer() { histogram_->Record(stopwatch_.Elapsed()); }
+
+ private:
+  LatencyHistogram* const histogram_;
+  Stopwatch stopwatch_;
+
+  FTL_DISALLOW_COPY_AND_ASSIGN(ScopedTimer);
+};
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TIME_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,165 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/time/latency_histogram.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+TimeDelta Nanoseconds(int64_t nanoseconds) {
+  return TimeDelta::FromNanoseconds(nanoseconds);
+}
+
+TEST(LatencyHistogram, Buckets) {
+  // Exact, then 32 per power of two.
+  EXPECT_EQ(0u, LatencyHistogram::BucketFor(Nanoseconds(-5)));
+  EXPECT_EQ(31u, LatencyHistogram::BucketFor(Nanoseconds(31)));
+  EXPECT_EQ(32u, LatencyHistogram::BucketFor(Nanoseconds(32)));
+  EXPECT_EQ(63u, LatencyHistogram::BucketFor(Nanoseconds(63)));
+  EXPECT_EQ(64u, LatencyHistogram::BucketFor(Nanoseconds(64)));
+  EXPECT_EQ(64u, LatencyHistogram::BucketFor(Nanoseconds(65)));
+  EXPECT_EQ(65u, LatencyHistogram::BucketFor(Nanoseconds(66)));
+  EXPECT_EQ(LatencyHistogram::kBucketCount - 1u,
+            LatencyHistogram::BucketFor(TimeDelta::Max()));
+
+  for (size_t i = 0u; i < LatencyHistogram::kBucketCount; i++) {
+    const TimeDelta lower = LatencyHistogram::BucketLowerBound(i);
+    const TimeDelta upper = LatencyHistogram::BucketLowerBound(i + 1u);
+    ASSERT_LT(lower, upper);
+    ASSERT_EQ(i, LatencyHistogram::BucketFor(lower));
+    ASSERT_EQ(i, LatencyHistogram::BucketFor(upper - Nanoseconds(1)));
+    // Within about 3%.
+    if (i >= LatencyHistogram::kSubBucketCount &&
+        i + 1u < LatencyHistogram::kBucketCount) {
+      ASSERT_LE((upper - lower).ToNanoseconds() * 32, upper.ToNanoseconds());
+    }
+  }
+}
+
+TEST(LatencyHistogram, Snapshot) {
+  LatencyHistogram::Snapshot empty;
+  EXPECT_EQ(0u, empty.count());
+  EXPECT_EQ(TimeDelta::Zero(), empty.min());
+  EXPECT_EQ(TimeDelta::Zero(), empty.max());
+  EXPECT_EQ(TimeDelta::Zero(), empty.mean());
+  EXPECT_EQ(TimeDelta::Zero(), empty.Percentile(50.0));
+
+  LatencyHistogram::Snapshot snapshot;
+  for (int i = 1; i <= 1000; i++)
+    snapshot.Record(TimeDelta::FromMicroseconds(i));
+  EXPECT_EQ(1000u, snapshot.count());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1), snapshot.min());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1000), snapshot.max());
+  EXPECT_EQ(TimeDelta::FromNanoseconds(500500), snapshot.mean());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(500500), snapshot.total());
+  // At most about 3% high.
+  for (double percentile : {1.0, 50.0, 90.0, 99.0, 99.9}) {
+    const double actual = snapshot.Percentile(percentile).ToMicrosecondsF();
+    EXPECT_LE(percentile * 10.0, actual) << percentile;
+    EXPECT_GE(percentile * 10.0 * 1.035, actual) << percentile;
+  }
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1000), snapshot.Percentile(100.0));
+  EXPECT_LE(TimeDelta::FromMicroseconds(1), snapshot.Percentile(0.0));
+  EXPECT_GE(TimeDelta::FromNanoseconds(1035), snapshot.Percentile(0.0));
+
+  LatencyHistogram::Snapshot other;
+  other.Record(TimeDelta::FromSeconds(2));
+  snapshot.Merge(other);
+  EXPECT_EQ(1001u, snapshot.count());
+  EXPECT_EQ(TimeDelta::FromSeconds(2), snapshot.max());
+  EXPECT_EQ(TimeDelta::FromSeconds(2), snapshot.Percentile(100.0));
+  EXPECT_EQ(
+      "count=1001 mean=2.5ms p50=508us p90=901us p99=999us p999=1.02ms "
+      "max=2s",
+      snapshot.ToString());
+
+  std::vector<uint64_t> buckets;
+  for (size_t i = 0u; i < LatencyHistogram::kBucketCount; i++)
+    buckets.push_back(snapshot.bucket(i));
+  const LatencyHistogram::Snapshot copy =
+      LatencyHistogram::Snapshot::FromCounts(buckets, snapshot.total(),
+                                             snapshot.min(), snapshot.max());
+  EXPECT_EQ(snapshot.ToString(), copy.ToString());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1), copy.min());
+  EXPECT_EQ(snapshot.total(), copy.total());
+}
+
+TEST(LatencyHistogram, Record) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0u, histogram.GetSnapshot().count());
+  std::mt19937_64 random(1u);
+  std::vector<int64_t> samples;
+  LatencyHistogram::Snapshot expected;
+  for (int i = 0; i < 10000; i++) {
+    // Log-uniform, from 1 ns to about a second.
+    const int64_t sample = static_cast<int64_t>(
+        std::exp2(std::uniform_real_distribution<double>(0.0, 30.0)(random)));
+    samples.push_back(sample);
+    histogram.Record(Nanoseconds(sample));
+    expected.Record(Nanoseconds(sample));
+  }
+  const LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(10000u, snapshot.count());
+  EXPECT_EQ(expected.total(), snapshot.total());
+  EXPECT_EQ(expected.min(), snapshot.min());
+  EXPECT_EQ(expected.max(), snapshot.max());
+  for (size_t i = 0u; i < LatencyHistogram::kBucketCount; i++)
+    ASSERT_EQ(expected.bucket(i), snapshot.bucket(i));
+
+  std::sort(samples.begin(), samples.end());
+  for (double percentile : {50.0, 90.0, 99.0}) {
+    const int64_t exact = samples[static_cast<size_t>(percentile * 100) - 1u];
+    const int64_t approximate = snapshot.Percentile(percentile).ToNanoseconds();
+    EXPECT_LE(exact, approximate);
+    EXPECT_GE(exact + exact / 32 + 1, approximate);
+  }
+
+  histogram.Merge(snapshot);
+  EXPECT_EQ(20000u, histogram.GetSnapshot().count());
+  histogram.Clear();
+  EXPECT_EQ(0u, histogram.GetSnapshot().count());
+  EXPECT_EQ(TimeDelta::Zero(), histogram.GetSnapshot().max());
+  histogram.Record(Nanoseconds(7));
+  EXPECT_EQ(Nanoseconds(7), histogram.GetSnapshot().min());
+}
+
+TEST(LatencyHistogram, Threads) {
+  LatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 12; t++) {
+    threads.emplace_back([&histogram, t] {
+      for (int i = 0; i < 10000; i++)
+        histogram.Record(TimeDelta::FromMicroseconds(t + 1));
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  const LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(120000u, snapshot.count());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(1), snapshot.min());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(12), snapshot.max());
+  EXPECT_EQ(TimeDelta::FromMicroseconds(780000), snapshot.total());
+}
+
+TEST(LatencyHistogram, ScopedTimer) {
+  LatencyHistogram histogram;
+  {
+    ScopedTimer timer(&histogram);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  const LatencyHistogram::Snapshot snapshot = histogram.GetSnapshot();
+  EXPECT_EQ(1u, snapshot.count());
+  EXPECT_LE(TimeDelta::FromMilliseconds(5), snapshot.max());
+}
+
+}  // namespace
+}  // namespace ftl
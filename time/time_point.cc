@@ -43,6 +43,13 @@ TimePoint TimePoint::Now() {
                    timebase_info.denom);
 }
 
+// static
+TimePoint TimePoint::NowCoarse() {
+  static mach_timebase_info_data_t timebase_info = GetMachTimebaseInfo();
+  return TimePoint(mach_approximate_time() * timebase_info.numer /
+                   timebase_info.denom);
+}
+
 #elif defined(OS_FUCHSIA)
 
 // static
@@ -50,14 +57,34 @@ TimePoint TimePoint::Now() {
   return TimePoint(mx_time_get(MX_CLOCK_MONOTONIC));
 }
 
+// static
+TimePoint TimePoint::NowCoarse() {
+  return Now();
+}
+
 #elif defined(OS_WIN)
 
-TimePoint TimePoint::Now() {
+uint64_t GetPerformanceFrequency() {
   uint64_t freq = 0;
-  uint64_t count = 0;
   QueryPerformanceFrequency((LARGE_INTEGER *)&freq);
+  FTL_DCHECK(freq > 0);
+  return freq;
+}
+
+TimePoint TimePoint::Now() {
+  // (The frequency is fixed at boot.)
+  static const uint64_t freq = GetPerformanceFrequency();
+  uint64_t count = 0;
   QueryPerformanceCounter((LARGE_INTEGER *)&count);
-  return TimePoint((count * 1000000000) / freq);
+  // Scale the whole seconds and the remainder separately, so that
+  // |count * 1000000000| can't overflow.
+  return TimePoint((count / freq) * 1000000000 +
+                   (count % freq) * 1000000000 / freq);
+}
+
+// static
+TimePoint TimePoint::NowCoarse() {
+  return Now();
 }
 
 #else
@@ -71,6 +98,20 @@ TimePoint TimePoint::Now() {
   return TimePoint::FromEpochDelta(TimeDelta::FromTimespec(ts));
 }
 
+// static
+TimePoint TimePoint::NowCoarse() {
+#if defined(CLOCK_MONOTONIC_COARSE)
+  // The same clock, as of the last timer tick (which the vDSO just reads).
+  struct timespec ts;
+  int res = clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  FTL_DCHECK(res == 0);
+  (void)res;
+  return TimePoint::FromEpochDelta(TimeDelta::FromTimespec(ts));
+#else
+  return Now();
+#endif
+}
+
 #endif  // defined(OS_MACOSX) || defined(OS_IOS)
 
 }  // namespace ftl
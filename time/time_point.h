@@ -27,6 +27,12 @@ class FTL_EXPORT TimePoint {
 
   static TimePoint Now();
 
+  // A cheaper, less precise |Now()|, for timeouts, aging and such that only
+  // need to be accurate to some milliseconds: this may be behind |Now()| by up
+  // to the OS's timer tick (typically 1 to 10 ms), though never ahead of it.
+  // Where there's no cheaper clock, this is just |Now()|.
+  static TimePoint NowCoarse();
+
   static constexpr TimePoint Min() {
     return TimePoint(std::numeric_limits<int64_t>::min());
   }
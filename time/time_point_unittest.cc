@@ -4,6 +4,9 @@
 
 #include "lib/ftl/time/time_point.h"
 
+#include <chrono>
+#include <thread>
+
 #include "gtest/gtest.h"
 
 namespace ftl {
@@ -14,5 +17,16 @@ TEST(TimePoint, Control) {
   EXPECT_GT(TimePoint::Max(), TimePoint::Now());
 }
 
+TEST(TimePoint, NowCoarse) {
+  const TimePoint coarse = TimePoint::NowCoarse();
+  const TimePoint now = TimePoint::Now();
+  EXPECT_LE(coarse, now);
+  EXPECT_GT(TimeDelta::FromMilliseconds(100), now - coarse);
+
+  // It moves on with |Now()| (if only a tick at a time).
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  EXPECT_LE(now + TimeDelta::FromMilliseconds(10), TimePoint::NowCoarse());
+}
+
 }  // namespace
 }  // namespace ftl
@@ -6,6 +6,7 @@
 
 #include "lib/ftl/time/time_delta.h"
 #include "lib/ftl/time/time_point.h"
+#include "lib/ftl/time/wall_time.h"
 
 namespace ftl {
 
@@ -17,4 +18,8 @@ void PrintTo(const TimePoint& time_point, ::std::ostream* os) {
   *os << (time_point - TimePoint()).ToNanoseconds();
 }
 
+void PrintTo(const WallTime& wall_time, ::std::ostream* os) {
+  *os << wall_time.ToRfc3339(9);
+}
+
 }  // namespace ftl
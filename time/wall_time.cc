@@ -0,0 +1,231 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/time/wall_time.h"
+
+#include <string.h>
+
+#include <chrono>
+
+#include "lib/ftl/logging.h"
+
+namespace ftl {
+namespace {
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+constexpr int64_t kSecondsPerDay = 86400;
+
+// The size of "YYYY-MM-DDTHH:MM:SS".
+constexpr size_t kDateTimeSize = 19u;
+
+// These convert between days since the Unix epoch and (proleptic Gregorian)
+// dates, as in http://howardhinnant.github.io/date_algorithms.html.
+int64_t DaysFromCivil(int64_t year, unsigned month, unsigned day) {
+  year -= month <= 2u;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const unsigned year_of_era = static_cast<unsigned>(year - era * 400);
+  const unsigned day_of_year =
+      (153u * (month > 2u ? month - 3u : month + 9u) + 2u) / 5u + day - 1u;
+  const unsigned day_of_era = year_of_era * 365u + year_of_era / 4u -
+                              year_of_era / 100u + day_of_year;
+  return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+void CivilFromDays(int64_t days,
+                   int64_t* year,
+                   unsigned* month,
+                   unsigned* day) {
+  days += 719468;
+  const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const unsigned day_of_era = static_cast<unsigned>(days - era * 146097);
+  const unsigned year_of_era =
+      (day_of_era - day_of_era / 1460u + day_of_era / 36524u -
+       day_of_era / 146096u) /
+      365u;
+  const unsigned day_of_year = day_of_era - (365u * year_of_era +
+                                             year_of_era / 4u -
+                                             year_of_era / 100u);
+  const unsigned shifted_month = (5u * day_of_year + 2u) / 153u;
+  *day = day_of_year - (153u * shifted_month + 2u) / 5u + 1u;
+  *month = shifted_month < 10u ? shifted_month + 3u : shifted_month - 9u;
+  *year = static_cast<int64_t>(year_of_era) + era * 400 + (*month <= 2u);
+}
+
+unsigned DaysInMonth(int64_t year, unsigned month) {
+  static const unsigned kDays[12] = {31u, 28u, 31u, 30u, 31u, 30u,
+                                     31u, 31u, 30u, 31u, 30u, 31u};
+  if (month == 2u && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+    return 29u;
+  return kDays[month - 1u];
+}
+
+// Writes |value| as exactly |count| decimal digits.
+void WriteDigits(uint32_t value, size_t count, char* buffer) {
+  for (size_t i = count; i-- > 0u;) {
+    buffer[i] = static_cast<char>('0' + value % 10u);
+    value /= 10u;
+  }
+}
+
+// Reads exactly |count| decimal digits.
+bool ReadDigits(const char* string, size_t count, unsigned* value) {
+  unsigned result = 0u;
+  for (size_t i = 0u; i < count; i++) {
+    if (string[i] < '0' || string[i] > '9')
+      return false;
+    result = result * 10u + static_cast<unsigned>(string[i] - '0');
+  }
+  *value = result;
+  return true;
+}
+
+// Writes "YYYY-MM-DDTHH:MM:SS" for |second| (since the Unix epoch), which is
+// within |WallTime|'s range, so has a four-digit year.
+void FormatDateTime(int64_t second, char* buffer) {
+  int64_t days = second / kSecondsPerDay;
+  int64_t second_of_day = second % kSecondsPerDay;
+  if (second_of_day < 0) {
+    days--;
+    second_of_day += kSecondsPerDay;
+  }
+  int64_t year;
+  unsigned month;
+  unsigned day;
+  CivilFromDays(days, &year, &month, &day);
+  const uint32_t time = static_cast<uint32_t>(second_of_day);
+  WriteDigits(static_cast<uint32_t>(year), 4u, buffer);
+  buffer[4] = '-';
+  WriteDigits(month, 2u, buffer + 5);
+  buffer[7] = '-';
+  WriteDigits(day, 2u, buffer + 8);
+  buffer[10] = 'T';
+  WriteDigits(time / 3600u, 2u, buffer + 11);
+  buffer[13] = ':';
+  WriteDigits(time / 60u % 60u, 2u, buffer + 14);
+  buffer[16] = ':';
+  WriteDigits(time % 60u, 2u, buffer + 17);
+}
+
+}  // namespace
+
+constexpr size_t WallTime::kMaxRfc3339Size;
+
+// static
+WallTime WallTime::Now() {
+  return WallTime(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count());
+}
+
+size_t WallTime::FormatRfc3339(char* buffer, int fraction_digits) const {
+  FTL_DCHECK(fraction_digits >= 0 && fraction_digits <= 9);
+  int64_t second = ticks_ / kNanosecondsPerSecond;
+  int64_t nanoseconds = ticks_ % kNanosecondsPerSecond;
+  if (nanoseconds < 0) {
+    second--;
+    nanoseconds += kNanosecondsPerSecond;
+  }
+
+  // Consecutive calls are mostly in the same second.
+  struct DateTimeCache {
+    int64_t second;
+    char date_time[kDateTimeSize];
+  };
+  thread_local DateTimeCache cache = {INT64_MIN, {}};
+  if (second != cache.second) {
+    FormatDateTime(second, cache.date_time);
+    cache.second = second;
+  }
+  memcpy(buffer, cache.date_time, kDateTimeSize);
+
+  size_t size = kDateTimeSize;
+  if (fraction_digits > 0) {
+    buffer[size++] = '.';
+    char digits[9];
+    WriteDigits(static_cast<uint32_t>(nanoseconds), sizeof(digits), digits);
+    memcpy(buffer + size, digits, static_cast<size_t>(fraction_digits));
+    size += static_cast<size_t>(fraction_digits);
+  }
+  buffer[size++] = 'Z';
+  return size;
+}
+
+std::string WallTime::ToRfc3339(int fraction_digits) const {
+  std::string result(kMaxRfc3339Size, '\0');
+  result.resize(FormatRfc3339(&result[0], fraction_digits));
+  return result;
+}
+
+// static
+bool WallTime::ParseRfc3339(StringView string, WallTime* wall_time) {
+  // "YYYY-MM-DDTHH:MM:SS", then at least "Z".
+  if (string.size() < kDateTimeSize + 1u)
+    return false;
+  const char* data = string.data();
+  unsigned year, month, day, hour, minute, second;
+  if (!ReadDigits(data, 4u, &year) || data[4] != '-' ||
+      !ReadDigits(data + 5, 2u, &month) || data[7] != '-' ||
+      !ReadDigits(data + 8, 2u, &day) ||
+      (data[10] != 'T' && data[10] != 't' && data[10] != ' ') ||
+      !ReadDigits(data + 11, 2u, &hour) || data[13] != ':' ||
+      !ReadDigits(data + 14, 2u, &minute) || data[16] != ':' ||
+      !ReadDigits(data + 17, 2u, &second)) {
+    return false;
+  }
+  if (month < 1u || month > 12u || day < 1u ||
+      day > DaysInMonth(year, month) || hour > 23u || minute > 59u ||
+      second > 60u) {
+    return false;
+  }
+
+  size_t i = kDateTimeSize;
+  int64_t nanoseconds = 0;
+  if (data[i] == '.') {
+    i++;
+    const size_t start = i;
+    int64_t scale = kNanosecondsPerSecond;
+    for (; i < string.size() && data[i] >= '0' && data[i] <= '9'; i++) {
+      scale /= 10;
+      nanoseconds += (data[i] - '0') * scale;
+    }
+    if (i == start)
+      return false;
+  }
+
+  // The UTC offset.
+  int64_t offset = 0;
+  if (i < string.size() && (data[i] == 'Z' || data[i] == 'z')) {
+    i++;
+  } else if (i + 6u <= string.size() && (data[i] == '+' || data[i] == '-')) {
+    unsigned offset_hour, offset_minute;
+    if (!ReadDigits(data + i + 1, 2u, &offset_hour) || data[i + 3] != ':' ||
+        !ReadDigits(data + i + 4, 2u, &offset_minute) || offset_hour > 23u ||
+        offset_minute > 59u) {
+      return false;
+    }
+    offset = (offset_hour * 60 + offset_minute) * 60;
+    if (data[i] == '-')
+      offset = -offset;
+    i += 6u;
+  } else {
+    return false;
+  }
+  if (i != string.size())
+    return false;
+
+  const int64_t seconds = DaysFromCivil(year, month, day) * kSecondsPerDay +
+                          hour * 3600 + minute * 60 + second - offset;
+  // (The range of whole seconds that fit, give or take a fraction at the
+  // ends.)
+  if (seconds < INT64_MIN / kNanosecondsPerSecond ||
+      seconds > INT64_MAX / kNanosecondsPerSecond ||
+      (seconds == INT64_MAX / kNanosecondsPerSecond &&
+       nanoseconds > INT64_MAX % kNanosecondsPerSecond)) {
+    return false;
+  }
+  *wall_time = WallTime(seconds * kNanosecondsPerSecond + nanoseconds);
+  return true;
+}
+
+}  // namespace ftl
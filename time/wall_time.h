@@ -0,0 +1,90 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FTL_TIME_WALL_TIME_H_
+#define LIB_FTL_TIME_WALL_TIME_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <iosfwd>
+#include <string>
+
+#include "lib/ftl/ftl_export.h"
+#include "lib/ftl/strings/string_view.h"
+#include "lib/ftl/time/time_delta.h"
+
+namespace ftl {
+
+// A WallTime is a calendar time, as an integer number of nanoseconds since the
+// Unix epoch (1970-01-01T00:00:00Z, not counting leap seconds), so it can
+// represent times from 1677 to 2262.
+//
+// Unlike a |TimePoint|, this means the same across processes and devices, but
+// isn't monotonic: the system clock it's read from may be set back, so use
+// |TimePoint| to measure elapsed time.
+class FTL_EXPORT WallTime {
+ public:
+  // The longest string form, e.g., "2017-03-14T15:09:26.535897932Z".
+  static constexpr size_t kMaxRfc3339Size = 30u;
+
+  // Default WallTime, the Unix epoch.
+  constexpr WallTime() = default;
+
+  static WallTime Now();
+
+  static constexpr WallTime FromUnixDelta(TimeDelta delta) {
+    return WallTime(delta.ToNanoseconds());
+  }
+
+  TimeDelta ToUnixDelta() const { return TimeDelta::FromNanoseconds(ticks_); }
+
+  // Writes the RFC 3339 form in UTC, with |fraction_digits| (at most 9) digits
+  // of fractional seconds (none, and no '.', if 0), e.g.,
+  // "2017-03-14T15:09:26.535Z" for 3, to |buffer|, without a terminating null.
+  // Returns the number of characters written, at most |kMaxRfc3339Size|. This
+  // doesn't call into libc: the date is computed directly, and remembered (per
+  // thread) for the rest of its second.
+  size_t FormatRfc3339(char* buffer, int fraction_digits) const;
+  std::string ToRfc3339(int fraction_digits) const;
+
+  // Parses an RFC 3339 time, e.g., "2017-03-14T15:09:26Z", or
+  // "2017-03-14t08:09:26.535897-07:00" (with any number of fractional digits,
+  // of which the first 9 count, and any UTC offset), into |*wall_time|, or
+  // returns false (leaving |*wall_time| alone) if |string| isn't one that
+  // this can represent. (A leap second, :60, is taken as the second after.)
+  static bool ParseRfc3339(StringView string, WallTime* wall_time);
+
+  // Compute the difference between two wall times.
+  TimeDelta operator-(WallTime other) const {
+    return TimeDelta::FromNanoseconds(ticks_ - other.ticks_);
+  }
+
+  WallTime operator+(TimeDelta duration) const {
+    return WallTime(ticks_ + duration.ToNanoseconds());
+  }
+  WallTime operator-(TimeDelta duration) const {
+    return WallTime(ticks_ - duration.ToNanoseconds());
+  }
+
+  bool operator==(WallTime other) const { return ticks_ == other.ticks_; }
+  bool operator!=(WallTime other) const { return ticks_ != other.ticks_; }
+  bool operator<(WallTime other) const { return ticks_ < other.ticks_; }
+  bool operator<=(WallTime other) const { return ticks_ <= other.ticks_; }
+  bool operator>(WallTime other) const { return ticks_ > other.ticks_; }
+  bool operator>=(WallTime other) const { return ticks_ >= other.ticks_; }
+
+ private:
+  explicit constexpr WallTime(int64_t ticks) : ticks_(ticks) {}
+
+  int64_t ticks_ = 0;
+};
+
+// Used to print useful values in gtest assertions. Should not be used in
+// production code.
+void PrintTo(const WallTime& wall_time, ::std::ostream* os);
+
+}  // namespace ftl
+
+#endif  // LIB_FTL_TIME_WALL_TIME_H_
@@ -0,0 +1,150 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "lib/ftl/time/wall_time.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <chrono>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace ftl {
+namespace {
+
+WallTime FromNanoseconds(int64_t nanoseconds) {
+  return WallTime::FromUnixDelta(TimeDelta::FromNanoseconds(nanoseconds));
+}
+
+int64_t GetSystemNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+TEST(WallTime, Now) {
+  const int64_t before = GetSystemNanoseconds();
+  const WallTime now = WallTime::Now();
+  const int64_t after = GetSystemNanoseconds();
+  EXPECT_LE(before, now.ToUnixDelta().ToNanoseconds());
+  EXPECT_GE(after, now.ToUnixDelta().ToNanoseconds());
+}
+
+TEST(WallTime, FormatRfc3339) {
+  EXPECT_EQ("1970-01-01T00:00:00Z", WallTime().ToRfc3339(0));
+  EXPECT_EQ("1970-01-01T00:00:00.000000000Z", WallTime().ToRfc3339(9));
+  const WallTime time = FromNanoseconds(1489504166535897932);
+  EXPECT_EQ("2017-03-14T15:09:26Z", time.ToRfc3339(0));
+  EXPECT_EQ("2017-03-14T15:09:26.5Z", time.ToRfc3339(1));
+  EXPECT_EQ("2017-03-14T15:09:26.535Z", time.ToRfc3339(3));
+  EXPECT_EQ("2017-03-14T15:09:26.535897932Z", time.ToRfc3339(9));
+  EXPECT_EQ("1969-12-31T23:59:59.999999999Z",
+            FromNanoseconds(-1).ToRfc3339(9));
+  EXPECT_EQ("2016-02-29T23:59:59Z",
+            FromNanoseconds(1456790399000000000).ToRfc3339(0));
+  // The ends of the range.
+  EXPECT_EQ("2262-04-11T23:47:16.854775807Z",
+            FromNanoseconds(INT64_MAX).ToRfc3339(9));
+  EXPECT_EQ("1677-09-21T00:12:43.145224192Z",
+            FromNanoseconds(INT64_MIN).ToRfc3339(9));
+
+  char buffer[WallTime::kMaxRfc3339Size + 1u];
+  buffer[WallTime::kMaxRfc3339Size] = 'x';
+  EXPECT_EQ(WallTime::kMaxRfc3339Size, time.FormatRfc3339(buffer, 9));
+  EXPECT_EQ('x', buffer[WallTime::kMaxRfc3339Size]);
+  EXPECT_EQ(24u, time.FormatRfc3339(buffer, 3));
+  EXPECT_EQ("2017-03-14T15:09:26.535Z", std::string(buffer, 24u));
+}
+
+TEST(WallTime, FormatLikeGmtime) {
+  // Including the cached date changing back and forth.
+  std::mt19937_64 random(1u);
+  std::uniform_int_distribution<int64_t> seconds(-9223372036, 9223372035);
+  for (int i = 0; i < 20000; i++) {
+    const int64_t second = seconds(random);
+    const time_t t = static_cast<time_t>(second);
+    struct tm utc;
+    ASSERT_TRUE(gmtime_r(&t, &utc));
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+             utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour,
+             utc.tm_min, utc.tm_sec);
+    ASSERT_EQ(expected, FromNanoseconds(second * 1000000000).ToRfc3339(0));
+  }
+}
+
+TEST(WallTime, ParseRfc3339) {
+  WallTime time;
+  ASSERT_TRUE(WallTime::ParseRfc3339("2017-03-14T15:09:26Z", &time));
+  EXPECT_EQ(FromNanoseconds(1489504166000000000), time);
+  ASSERT_TRUE(
+      WallTime::ParseRfc3339("2017-03-14T15:09:26.535897932Z", &time));
+  EXPECT_EQ(FromNanoseconds(1489504166535897932), time);
+  // Offsets, lowercase, a space, and more or fewer fractional digits.
+  ASSERT_TRUE(
+      WallTime::ParseRfc3339("2017-03-14t08:09:26.5358979329-07:00", &time));
+  EXPECT_EQ(FromNanoseconds(1489504166535897932), time);
+  ASSERT_TRUE(WallTime::ParseRfc3339("2017-03-14 20:39:26.5+05:30", &time));
+  EXPECT_EQ(FromNanoseconds(1489504166500000000), time);
+  ASSERT_TRUE(
+      WallTime::ParseRfc3339("1969-12-31T23:59:59.999999999z", &time));
+  EXPECT_EQ(FromNanoseconds(-1), time);
+  ASSERT_TRUE(WallTime::ParseRfc3339("2016-12-31T23:59:60Z", &time));
+  EXPECT_EQ("2017-01-01T00:00:00Z", time.ToRfc3339(0));
+  ASSERT_TRUE(WallTime::ParseRfc3339("2016-02-29T00:00:00Z", &time));
+  ASSERT_TRUE(WallTime::ParseRfc3339("2000-02-29T00:00:00Z", &time));
+  ASSERT_TRUE(
+      WallTime::ParseRfc3339("2262-04-11T23:47:16.854775807Z", &time));
+  EXPECT_EQ(FromNanoseconds(INT64_MAX), time);
+
+  // Round trips.
+  const WallTime now = WallTime::Now();
+  ASSERT_TRUE(WallTime::ParseRfc3339(now.ToRfc3339(9), &time));
+  EXPECT_EQ(now, time);
+
+  // Failing leaves the time alone.
+  const char* const kInvalid[] = {
+      "",
+      "2017-03-14T15:09:26",
+      "2017-03-14T15:09:26Zx",
+      "2017-03-14T15:09:26.Z",
+      "2017-03-14T15:09:26+0700",
+      "2017-03-14T15:09:26+07:0",
+      "2017-03-14T15:09:26+24:00",
+      "2017-03-14X15:09:26Z",
+      "2017/03/14T15:09:26Z",
+      "2017-3-14T15:09:26Z",
+      "2017-00-14T15:09:26Z",
+      "2017-13-14T15:09:26Z",
+      "2017-02-29T15:09:26Z",
+      "1900-02-29T15:09:26Z",
+      "2017-04-31T15:09:26Z",
+      "2017-03-00T15:09:26Z",
+      "2017-03-14T24:09:26Z",
+      "2017-03-14T15:60:26Z",
+      "2017-03-14T15:09:61Z",
+      "2262-04-11T23:47:16.854775808Z",
+      "2263-01-01T00:00:00Z",
+      "1600-01-01T00:00:00Z",
+  };
+  for (const char* invalid : kInvalid) {
+    EXPECT_FALSE(WallTime::ParseRfc3339(StringView(invalid), &time))
+        << invalid;
+  }
+  EXPECT_EQ(now, time);
+}
+
+TEST(WallTime, Arithmetic) {
+  const WallTime time = FromNanoseconds(1000);
+  EXPECT_EQ(FromNanoseconds(3000), time + TimeDelta::FromNanoseconds(2000));
+  EXPECT_EQ(FromNanoseconds(-1000), time - TimeDelta::FromNanoseconds(2000));
+  EXPECT_EQ(TimeDelta::FromNanoseconds(1000), time - WallTime());
+  EXPECT_LT(WallTime(), time);
+  EXPECT_NE(WallTime(), time);
+}
+
+}  // namespace
+}  // namespace ftl
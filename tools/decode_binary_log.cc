@@ -0,0 +1,34 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Formats a binary log file (see lib/ftl/binary_log.h) to stdout:
+//
+//   decode_binary_log <file>
+
+#include <stdio.h>
+
+#include <string>
+
+#include "lib/ftl/binary_log.h"
+#include "lib/ftl/files/file.h"
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+    return 1;
+  }
+  std::string data;
+  if (!files::ReadFileToString(argv[1], &data)) {
+    fprintf(stderr, "Could not read %s\n", argv[1]);
+    return 1;
+  }
+  std::string output;
+  bool ok = ftl::DecodeBinaryLog(data, &output);
+  fwrite(output.data(), 1u, output.size(), stdout);
+  if (!ok) {
+    fprintf(stderr, "%s is not a well-formed binary log\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}